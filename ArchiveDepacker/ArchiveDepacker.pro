@@ -1,5 +1,9 @@
 include(../Common/Common.pri)
 
+unix {
+	LIBS+= -lpthread
+}
+
 SOURCES+= \
 	main.cpp \
 
@@ -1,10 +1,25 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Include OS-dependend stuff for files mapping.
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../Common/files.hpp"
 using namespace ChasmReverse;
 
@@ -43,10 +58,73 @@ static void DepackFileInfo( const FileInfoPacked& file_info_packed, FileInfo& ou
 	out_file_info.offset= LittleInt4( out_file_info.offset );
 }
 
+// Returns mapping of whole file or null, if file does not exist, is empty or can not be mapped.
+static void* MapWholeFile( const char* const file_name, size_t& out_size )
+{
+#ifdef _WIN32
+	const HANDLE file= ::CreateFileA( file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE )
+		return nullptr;
+
+	LARGE_INTEGER file_size;
+	if( ::GetFileSizeEx( file, &file_size ) == 0 || file_size.QuadPart <= 0 )
+	{
+		::CloseHandle( file );
+		return nullptr;
+	}
+
+	const HANDLE mapping= ::CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	::CloseHandle( file );
+	if( mapping == nullptr )
+		return nullptr;
+
+	// View keeps mapping alive, so, mapping handle is not needed anymore.
+	void* const data= ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	::CloseHandle( mapping );
+	if( data == nullptr )
+		return nullptr;
+
+	out_size= static_cast<size_t>( file_size.QuadPart );
+	return data;
+#else
+	const int file= ::open( file_name, O_RDONLY );
+	if( file == -1 )
+		return nullptr;
+
+	struct stat file_stat;
+	if( ::fstat( file, &file_stat ) != 0 || file_stat.st_size <= 0 )
+	{
+		::close( file );
+		return nullptr;
+	}
+
+	// Mapping stays valid after closing of file.
+	void* const data= ::mmap( nullptr, static_cast<size_t>( file_stat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	::close( file );
+	if( data == MAP_FAILED )
+		return nullptr;
+
+	out_size= static_cast<size_t>( file_stat.st_size );
+	return data;
+#endif
+}
+
+static void UnmapFile( void* const data, const size_t size )
+{
+#ifdef _WIN32
+	(void)size;
+	::UnmapViewOfFile( data );
+#else
+	::munmap( data, size );
+#endif
+}
+
 int main(const int argc, const char* const argv[])
 {
 	const char* archive_file_name= "CSM.BIN";
 	const char* out_dir= "";
+	bool list_only= false;
+	unsigned int thread_count= std::max( std::thread::hardware_concurrency(), 1u );
 
 	for( int i= 1; i < argc; i++ )
 	{
@@ -65,62 +143,115 @@ int main(const int argc, const char* const argv[])
 			else
 				std::cout << "Error, expected directory, after -o" << std::endl;
 		}
+		else if( std::strcmp( arg, "-j" ) == 0 )
+		{
+			if( i < argc - 1 )
+				thread_count= std::max( std::atoi( argv[ i + 1 ] ), 1 );
+			else
+				std::cout << "Error, expected threads count, after -j" << std::endl;
+		}
+		else if( std::strcmp( arg, "--list-only" ) == 0 )
+			list_only= true;
 	}
 
-	std::FILE* const file= std::fopen( archive_file_name, "rb" );
-	if( file == nullptr )
+	size_t archive_size= 0u;
+	void* const archive_mapping= MapWholeFile( archive_file_name, archive_size );
+	if( archive_mapping == nullptr )
 	{
 		std::cout << "Could not read file \"" << archive_file_name << "\"" << std::endl;
 		return -1;
 	}
+	const unsigned char* const archive_data= static_cast<const unsigned char*>( archive_mapping );
 
-	char header[4];
-	FileRead( file, header, sizeof(header) );
-	if( std::strncmp( header, "CSid", sizeof(header) ) != 0 )
+	const size_t c_archive_header_size= 4u + sizeof(unsigned short);
+	if( archive_size < c_archive_header_size || std::strncmp( reinterpret_cast<const char*>( archive_data ), "CSid", 4u ) != 0 )
 	{
 		std::cout << "File \"" << archive_file_name << "\" is not \"Chasm: The Rift\" archive" << std::endl;
+		UnmapFile( archive_mapping, archive_size );
 		return -1;
 	}
 
 	unsigned short files_in_archive_count;
-	FileRead( file, &files_in_archive_count, sizeof(files_in_archive_count) );
+	std::memcpy( &files_in_archive_count, archive_data + 4u, sizeof(files_in_archive_count) );
 	files_in_archive_count= LittleInt2(files_in_archive_count);
 
 	std::cout << "Files count: " << files_in_archive_count << std::endl << std::endl;
 
-	std::vector<FileInfoPacked>	files_info_packed( files_in_archive_count );
+	if( c_archive_header_size + files_in_archive_count * sizeof(FileInfoPacked) > archive_size )
+	{
+		std::cout << "File \"" << archive_file_name << "\" is broken" << std::endl;
+		UnmapFile( archive_mapping, archive_size );
+		return -1;
+	}
 
-	FileRead( file, files_info_packed.data(), files_info_packed.size() * sizeof(FileInfoPacked ) );
+	std::vector<FileInfo> files_info( files_in_archive_count );
+	for( unsigned int i= 0u; i < files_in_archive_count; i++ )
+	{
+		FileInfoPacked file_info_packed;
+		std::memcpy( &file_info_packed, archive_data + c_archive_header_size + i * sizeof(FileInfoPacked), sizeof(FileInfoPacked) );
+		DepackFileInfo( file_info_packed, files_info[i] );
+	}
 
-	std::vector<unsigned char> file_buffer;
+	if( list_only )
+	{
+		for( const FileInfo& file_info : files_info )
+			std::cout << file_info.name << " " << file_info.size << " " << file_info.offset << std::endl;
+
+		UnmapFile( archive_mapping, archive_size );
+		return 0;
+	}
+
+	// Write files in parallel directly from archive mapping.
+	std::atomic<unsigned int> next_file_index( 0u );
+	std::mutex output_mutex;
 
-	for( const FileInfoPacked& file_info_packed : files_info_packed )
+	const auto thread_func=
+	[&]
 	{
-		FileInfo file_info;
-		DepackFileInfo( file_info_packed, file_info );
+		while(true)
+		{
+			const unsigned int file_index= next_file_index.fetch_add( 1u );
+			if( file_index >= files_info.size() )
+				break;
 
-		file_buffer.resize( file_info.size );
+			const FileInfo& file_info= files_info[ file_index ];
 
-		std::fseek( file, file_info.offset, SEEK_SET );
-		FileRead( file, file_buffer.data(), file_buffer.size() );
+			std::string out_file_name( out_dir );
+			if( !out_file_name.empty() && out_file_name.back() != '/' )
+				out_file_name+= "/";
+			out_file_name+= file_info.name;
 
-		std::cout << "Write \"" << file_info.name << "\"" << std::endl;
+			if( file_info.offset > archive_size || file_info.size > archive_size - file_info.offset )
+			{
+				std::unique_lock<std::mutex> lock( output_mutex );
+				std::cout << "File \"" << file_info.name << "\" is out of archive bounds" << std::endl;
+				continue;
+			}
 
-		std::string out_file_name( out_dir );
-		if( !out_file_name.empty() && out_file_name.back() != '/' )
-			out_file_name+= "/";
-		out_file_name+= file_info.name;
+			{
+				std::unique_lock<std::mutex> lock( output_mutex );
+				std::cout << "Write \"" << file_info.name << "\"" << std::endl;
+			}
 
-		std::FILE* file_to_save= std::fopen( out_file_name.c_str(), "wb" );
-		if( file_to_save == nullptr )
-		{
-			std::cout << "Could not write file \"" << out_file_name << "\"" << std::endl;
-			continue;
+			std::FILE* file_to_save= std::fopen( out_file_name.c_str(), "wb" );
+			if( file_to_save == nullptr )
+			{
+				std::unique_lock<std::mutex> lock( output_mutex );
+				std::cout << "Could not write file \"" << out_file_name << "\"" << std::endl;
+				continue;
+			}
+
+			FileWrite( file_to_save, archive_data + file_info.offset, file_info.size );
+			std::fclose( file_to_save );
 		}
+	};
 
-		FileWrite( file_to_save, file_buffer.data(), file_buffer.size() );
-		std::fclose( file_to_save );
-	}
+	std::vector<std::thread> threads;
+	for( unsigned int i= 1u; i < thread_count; i++ )
+		threads.emplace_back( thread_func );
+	thread_func();
+	for( std::thread& thread : threads )
+		thread.join();
 
-	std::fclose( file );
+	UnmapFile( archive_mapping, archive_size );
 }
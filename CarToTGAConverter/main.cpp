@@ -3,22 +3,19 @@
 #include <iostream>
 #include <vector>
 
+#include "../Common/batch.hpp"
 #include "../Common/files.hpp"
 #include "../Common/palette.hpp"
 #include "../Common/tga.hpp"
 using namespace ChasmReverse;
 
-int main( const int argc, const char* const argv[] )
+static bool ConvertCar( const char* const file_name, const Palette& palette )
 {
-	const char* file_name= "WORM.CAR";
-	if( argc > 1 )
-		file_name= argv[1];
-
 	FILE* const file= std::fopen( file_name, "rb" );
 	if( file == nullptr )
 	{
 		std::cout << "Could not read file \"" << file_name << "\"" << std::endl;
-		return -1;
+		return false;
 	}
 
 	std::fseek( file, 0, SEEK_END );
@@ -30,9 +27,6 @@ int main( const int argc, const char* const argv[] )
 
 	std::fclose( file );
 
-	Palette palette;
-	LoadPalette( palette );
-
 	const unsigned int c_texture_bytes_offset= 0x486Au;
 	const unsigned int c_texture_offset= 0x486Cu;
 
@@ -56,4 +50,31 @@ int main( const int argc, const char* const argv[] )
 		file_content.data(),
 		palette.data(),
 		( std::string( file_name ) + ".tga" ).c_str() );
+
+	return true;
+}
+
+int main( const int argc, const char* const argv[] )
+{
+	Palette palette;
+	LoadPalette( palette );
+
+	std::string batch_directory;
+	unsigned int thread_count;
+	if( ParseBatchOptions( argc, argv, batch_directory, thread_count ) )
+	{
+		const std::vector<std::string> files= ListDirectoryFiles( batch_directory.c_str(), "", ".CAR" );
+		const unsigned int failed_files=
+			ProcessFilesBatch(
+				files,
+				[&]( const std::string& file_name ) { return ConvertCar( file_name.c_str(), palette ); },
+				thread_count );
+		return failed_files == 0u ? 0 : -1;
+	}
+
+	const char* file_name= "WORM.CAR";
+	if( argc > 1 )
+		file_name= argv[1];
+
+	return ConvertCar( file_name, palette ) ? 0 : -1;
 }
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Include OS-dependend stuff for directory listing.
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "batch.hpp"
+
+namespace ChasmReverse
+{
+
+static bool NameMatches( const char* const name, const char* const prefix, const char* const suffix )
+{
+	const size_t name_length= std::strlen( name );
+	const size_t prefix_length= std::strlen( prefix );
+	const size_t suffix_length= std::strlen( suffix );
+	if( name_length < prefix_length + suffix_length )
+		return false;
+
+	for( size_t i= 0u; i < prefix_length; i++ )
+		if( std::tolower( name[i] ) != std::tolower( prefix[i] ) )
+			return false;
+
+	for( size_t i= 0u; i < suffix_length; i++ )
+		if( std::tolower( name[ name_length - suffix_length + i ] ) != std::tolower( suffix[i] ) )
+			return false;
+
+	return true;
+}
+
+std::vector<std::string> ListDirectoryFiles( const char* const directory, const char* const name_prefix, const char* const name_suffix )
+{
+	std::string directory_path( directory );
+	if( !directory_path.empty() && directory_path.back() != '/' && directory_path.back() != '\\' )
+		directory_path+= "/";
+
+	std::vector<std::string> result;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA find_data;
+	const HANDLE find_handle= ::FindFirstFileA( ( directory_path + "*" ).c_str(), &find_data );
+	if( find_handle == INVALID_HANDLE_VALUE )
+		return result;
+
+	do
+	{
+		if( ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) == 0 &&
+			NameMatches( find_data.cFileName, name_prefix, name_suffix ) )
+			result.push_back( directory_path + find_data.cFileName );
+	} while( ::FindNextFileA( find_handle, &find_data ) != 0 );
+
+	::FindClose( find_handle );
+#else
+	DIR* const dir= ::opendir( directory_path.c_str() );
+	if( dir == nullptr )
+		return result;
+
+	while( const dirent* const entry= ::readdir( dir ) )
+	{
+		if( entry->d_name[0] != '.' && NameMatches( entry->d_name, name_prefix, name_suffix ) )
+			result.push_back( directory_path + entry->d_name );
+	}
+
+	::closedir( dir );
+#endif
+
+	std::sort( result.begin(), result.end() );
+	return result;
+}
+
+unsigned int ProcessFilesBatch(
+	const std::vector<std::string>& files,
+	const ProcessFileFunc& process_file_func,
+	const unsigned int thread_count )
+{
+	const auto start_time= std::chrono::steady_clock::now();
+
+	std::atomic<unsigned int> next_file_index( 0u );
+	std::atomic<unsigned int> failed_files( 0u );
+
+	const auto thread_func=
+	[&]
+	{
+		while(true)
+		{
+			const unsigned int file_index= next_file_index.fetch_add( 1u );
+			if( file_index >= files.size() )
+				break;
+
+			if( !process_file_func( files[ file_index ] ) )
+				failed_files.fetch_add( 1u );
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( unsigned int i= 1u; i < thread_count; i++ )
+		threads.emplace_back( thread_func );
+	thread_func();
+	for( std::thread& thread : threads )
+		thread.join();
+
+	const double time_s= std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+
+	std::cout << "Processed " << files.size() << " files (" << failed_files.load() << " failed) in " << time_s << " s";
+	if( time_s > 0.0 )
+		std::cout << ", " << double( files.size() ) / time_s << " files/s";
+	std::cout << ", threads: " << std::max( thread_count, 1u ) << std::endl;
+
+	return failed_files.load();
+}
+
+bool ParseBatchOptions(
+	const int argc, const char* const argv[],
+	std::string& out_directory, unsigned int& out_thread_count )
+{
+	bool batch_mode= false;
+	out_thread_count= std::max( std::thread::hardware_concurrency(), 1u );
+
+	for( int i= 1; i < argc; i++ )
+	{
+		if( std::strcmp( argv[i], "-d" ) == 0 )
+		{
+			if( i < argc - 1 )
+			{
+				out_directory= argv[ i + 1 ];
+				batch_mode= true;
+			}
+			else
+				std::cout << "Error, expected directory, after -d" << std::endl;
+		}
+		else if( std::strcmp( argv[i], "-j" ) == 0 )
+		{
+			if( i < argc - 1 )
+				out_thread_count= std::max( std::atoi( argv[ i + 1 ] ), 1 );
+			else
+				std::cout << "Error, expected threads count, after -j" << std::endl;
+		}
+	}
+
+	return batch_mode;
+}
+
+} // namespace ChasmReverse
@@ -0,0 +1,28 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ChasmReverse
+{
+
+// Returns sorted names of files in directory, which start with given prefix and end with given suffix (case-insensitive).
+// Names include directory path.
+std::vector<std::string> ListDirectoryFiles( const char* directory, const char* name_prefix, const char* name_suffix );
+
+// Returns true, if file processed successfully.
+typedef std::function< bool( const std::string& file_name ) > ProcessFileFunc;
+
+// Process files in parallel, using work queue. Prints throughput at end.
+// Returns count of failed files.
+unsigned int ProcessFilesBatch(
+	const std::vector<std::string>& files,
+	const ProcessFileFunc& process_file_func,
+	unsigned int thread_count );
+
+// Parses batch options - "-d [directory]" and "-j [threads count]". Returns true, if batch mode requested.
+bool ParseBatchOptions(
+	int argc, const char* const argv[],
+	std::string& out_directory, unsigned int& out_thread_count );
+
+} // namespace ChasmReverse
@@ -35,12 +35,28 @@ void WriteTGA(
 	const unsigned char* const data,
 	const unsigned char* const palette,
 	const char* const file_name )
+{
+	TGAWriter writer( width, height, palette, file_name, false );
+	if( !writer.IsOpen() )
+		return;
+
+	for( unsigned int y= 0u; y < height; y++ )
+		writer.WriteRow( data + y * width );
+}
+
+TGAWriter::TGAWriter(
+	const unsigned short width, const unsigned short height,
+	const unsigned char* const palette,
+	const char* const file_name,
+	const bool rle_compression )
+	: width_(width), rows_left_(height)
+	, rle_compression_(rle_compression)
 {
 	TGAHeader tga;
 
 	tga.id_length= 0;
 	tga.colormap_type= 1; // image with colormap
-	tga.image_type= 1; // image with palette without compression
+	tga.image_type= rle_compression ? 9 : 1; // image with palette with RLE compression or without compression
 
 	tga.colormap_index= 0;
 	tga.colormap_length= 256;
@@ -55,14 +71,14 @@ void WriteTGA(
 	tga.attributes= 1 << 5; // vertical flip flag
 	tga.attributes|= 8; // bits in alpha-channell
 
-	std::FILE* file= std::fopen( file_name, "wb" );
-	if( file == nullptr )
+	file_= std::fopen( file_name, "wb" );
+	if( file_ == nullptr )
 	{
 		std::cout << "Could not create file \"" << file_name << "\"" << std::endl;
 		return;
 	}
 
-	FileWrite( file, &tga, sizeof(tga) );
+	FileWrite( file_, &tga, sizeof(tga) );
 
 	unsigned char palette_rb_swapped[ 256 * 4 ];
 	for( unsigned int i= 0; i < 256; i++ )
@@ -75,10 +91,80 @@ void WriteTGA(
 	palette_rb_swapped[255 * 4 + 3]= 0;
 
 
-	FileWrite( file, palette_rb_swapped, sizeof(palette_rb_swapped) );
-	FileWrite( file, data, width * height );
+	FileWrite( file_, palette_rb_swapped, sizeof(palette_rb_swapped) );
+
+	// Worst case of RLE - one header byte per 128 raw pixels.
+	encoded_row_.reserve( width + ( width + 127u ) / 128u );
+}
+
+TGAWriter::~TGAWriter()
+{
+	if( file_ == nullptr )
+		return;
+
+	if( rows_left_ > 0u )
+	{
+		const std::vector<unsigned char> zero_row( width_, 0u );
+		while( rows_left_ > 0u )
+			WriteRow( zero_row.data() );
+	}
+
+	std::fclose( file_ );
+}
+
+bool TGAWriter::IsOpen() const
+{
+	return file_ != nullptr;
+}
+
+void TGAWriter::WriteRow( const unsigned char* const row )
+{
+	if( file_ == nullptr || rows_left_ == 0u )
+		return;
+	rows_left_--;
+
+	if( rle_compression_ )
+	{
+		EncodeRowRLE( row );
+		FileWrite( file_, encoded_row_.data(), encoded_row_.size() );
+	}
+	else
+		FileWrite( file_, row, width_ );
+}
+
+void TGAWriter::EncodeRowRLE( const unsigned char* const row )
+{
+	const unsigned int c_max_packet_length= 128u;
+
+	encoded_row_.clear();
 
-	std::fclose( file );
+	unsigned int x= 0u;
+	while( x < width_ )
+	{
+		unsigned int run_length= 1u;
+		while( x + run_length < width_ && run_length < c_max_packet_length && row[ x + run_length ] == row[x] )
+			run_length++;
+
+		if( run_length >= 2u )
+		{
+			// Run-length packet.
+			encoded_row_.push_back( static_cast<unsigned char>( 0x80u | ( run_length - 1u ) ) );
+			encoded_row_.push_back( row[x] );
+			x+= run_length;
+		}
+		else
+		{
+			// Raw packet - until start of next run.
+			unsigned int raw_length= 1u;
+			while( x + raw_length < width_ && raw_length < c_max_packet_length &&
+				!( x + raw_length + 1u < width_ && row[ x + raw_length ] == row[ x + raw_length + 1u ] ) )
+				raw_length++;
+
+			encoded_row_.push_back( static_cast<unsigned char>( raw_length - 1u ) );
+			encoded_row_.insert( encoded_row_.end(), row + x, row + x + raw_length );
+			x+= raw_length;
+		}
+	}
 }
 
 } // namespace ChasmReverse
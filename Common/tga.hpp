@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdio>
+#include <vector>
 
 namespace ChasmReverse
 {
@@ -9,4 +11,36 @@ void WriteTGA(
 	const unsigned char* const palette,
 	const char* const file_name );
 
+// Writes paletted TGA row by row, from top to bottom, without holding whole image in memory.
+// With RLE compression enabled writes compressed image (type 9). Packets never cross rows.
+class TGAWriter final
+{
+public:
+	TGAWriter(
+		unsigned short width, unsigned short height,
+		const unsigned char* palette,
+		const char* file_name,
+		bool rle_compression );
+	// Fills not written rows with zeros.
+	~TGAWriter();
+
+	TGAWriter( const TGAWriter& )= delete;
+	TGAWriter& operator=( const TGAWriter& )= delete;
+
+	bool IsOpen() const;
+
+	// Row must contain "width" pixels.
+	void WriteRow( const unsigned char* row );
+
+private:
+	void EncodeRowRLE( const unsigned char* row );
+
+private:
+	std::FILE* file_= nullptr;
+	const unsigned short width_;
+	unsigned short rows_left_;
+	const bool rle_compression_;
+	std::vector<unsigned char> encoded_row_;
+};
+
 } // namespace ChasmReverse
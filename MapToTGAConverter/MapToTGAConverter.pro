@@ -1,13 +1,18 @@
 include(../Common/Common.pri)
 
+unix {
+	LIBS+= -lpthread
+}
+
 SOURCES+= \
 	main.cpp \
 
 SOURCES+= \
+	../Common/batch.cpp \
 	../Common/files.cpp \
 	../Common/tga.cpp \
 
 HEADERS+= \
+	../Common/batch.hpp \
 	../Common/files.hpp \
 	../Common/tga.hpp \
-
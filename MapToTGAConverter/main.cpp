@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <vector>
 
+#include "../Common/batch.hpp"
 #include "../Common/files.hpp"
 #include "../Common/tga.hpp"
 using namespace ChasmReverse;
@@ -14,22 +16,17 @@ static void GenPalette(unsigned char* palette )
 		//palette[i]= std::rand();
 }
 
-int main( const int argc, const char* const argv[] )
+static bool ConvertMap( const char* const map_file_name, const unsigned char* const palette )
 {
 	const unsigned int c_map_size= 64u;
 	const unsigned int c_lightmap_scale= 4u;
 	const unsigned int c_lightmap_size[2u]= { c_lightmap_scale * c_map_size, c_lightmap_scale * c_map_size };
 
-	const char* map_file_name= "MAP.01";
-	if( argc > 1 )
-		map_file_name= argv[1];
-
-
 	FILE* const file= std::fopen( map_file_name, "rb" );
 	if( file == nullptr )
 	{
 		std::cout << "Could not read file \"" << map_file_name << "\"" << std::endl;
-		return -1;
+		return false;
 	}
 
 	std::vector<unsigned char> file_data( 0x27001u );
@@ -37,66 +34,81 @@ int main( const int argc, const char* const argv[] )
 
 	std::fclose( file );
 
-	std::vector<unsigned char> lightmap_bock( c_lightmap_size[0u] * c_lightmap_size[1u] );
-	std::memcpy(
-		lightmap_bock.data(),
-		file_data.data() + 0x01u,
-		lightmap_bock.size() );
+	// Images are written row by row, directly from file data. Lightmaps are mostly flat, so, use RLE compression.
+	std::vector<unsigned char> row( c_lightmap_size[0u] );
 
-	for( unsigned int y= 0; y < c_lightmap_size[1u]; y++ )
-	for( unsigned int x= 0; x < c_lightmap_size[0u] / 2u; x++ )
-		std::swap(
-			lightmap_bock[ y * c_lightmap_size[0u] + x ],
-			lightmap_bock[ y * c_lightmap_size[0u] + c_lightmap_size[0u] - 1u - x ] );
-
-	std::vector<unsigned char> walls_block( c_map_size * c_map_size * 11u );
-	for( unsigned int b= 0; b < 11; b++ )
 	{
+		TGAWriter writer( c_lightmap_size[0u], c_lightmap_size[1u], palette, ( std::string(map_file_name) + ".lightmap.tga" ).c_str(), true );
+		for( unsigned int y= 0; y < c_lightmap_size[1u]; y++ )
+		{
+			const unsigned char* const src= file_data.data() + 0x01u + y * c_lightmap_size[0u];
+			for( unsigned int x= 0; x < c_lightmap_size[0u]; x++ )
+				row[x]= src[ c_lightmap_size[0u] - 1u - x ];
+			writer.WriteRow( row.data() );
+		}
+	}
+	{
+		TGAWriter writer( c_map_size, c_map_size * 11u, palette, ( std::string(map_file_name) + ".walls.tga" ).c_str(), true );
 		const unsigned char* const src= file_data.data() + 0x18001u;
-		unsigned char* const dst= walls_block.data() + c_map_size * c_map_size * b;
+		for( unsigned int b= 0; b < 11; b++ )
 		for( unsigned int y= 0u; y < c_map_size; y++ )
-		for( unsigned int x= 0u; x < c_map_size; x++ )
-			dst[ x + y * c_map_size ]= src[ ( x + y * c_map_size ) * 11u + b ];
+		{
+			for( unsigned int x= 0u; x < c_map_size; x++ )
+				row[x]= src[ ( x + y * c_map_size ) * 11u + b ];
+			writer.WriteRow( row.data() );
+		}
 	}
-
-	std::vector<unsigned char> second_lightmap_block( c_map_size * c_map_size * 8u );
-	for( unsigned int b= 0u; b < 8u; b++ )
 	{
+		TGAWriter writer( c_map_size, c_map_size * 8u, palette, ( std::string(map_file_name) + ".second_lightmap.tga" ).c_str(), true );
+		for( unsigned int b= 0u; b < 8u; b++ )
 		for( unsigned int y= 0u; y < c_map_size; y++ )
 		{
 			const unsigned char* const src= file_data.data() + 0x10001u + 8u * c_map_size * y;
-			unsigned char* const dst= second_lightmap_block.data() + c_map_size * c_map_size * b + c_map_size * y;
-
 			for( unsigned int x= 0u; x < c_map_size; x++ )
-				dst[x]= src[ (c_map_size - 1u - x ) + b ];
+				row[x]= src[ (c_map_size - 1u - x ) + b ];
+			writer.WriteRow( row.data() );
 		}
 	}
+	{
+		TGAWriter writer( c_map_size, c_map_size * 4u, palette, ( std::string(map_file_name) + ".maps.tga" ).c_str(), true );
+		for( unsigned int y= 0u; y < c_map_size * 4u; y++ )
+			writer.WriteRow( file_data.data() + 0x23001u + y * c_map_size );
+	}
 
+	return true;
+}
+
+int main( const int argc, const char* const argv[] )
+{
 	unsigned char palette[768];
 	GenPalette( palette );
 
-	WriteTGA(
-		c_lightmap_size[0u], c_lightmap_size[1u],
-		lightmap_bock.data(),
-		palette,
-		( std::string(map_file_name) + ".lightmap.tga" ).c_str() );
-
-	WriteTGA(
-		c_map_size, c_map_size * 11u,
-		walls_block.data(),
-		palette,
-		( std::string(map_file_name) + ".walls.tga" ).c_str() );
-
-	WriteTGA(
-		c_map_size, c_map_size * 8u,
-		second_lightmap_block.data(),
-		palette,
-		( std::string(map_file_name) + ".second_lightmap.tga" ).c_str() );
+	std::string batch_directory;
+	unsigned int thread_count;
+	if( ParseBatchOptions( argc, argv, batch_directory, thread_count ) )
+	{
+		std::vector<std::string> files= ListDirectoryFiles( batch_directory.c_str(), "MAP.", "" );
+		// Skip results of previous conversions.
+		files.erase(
+			std::remove_if(
+				files.begin(), files.end(),
+				[]( const std::string& file_name )
+				{
+					return file_name.size() >= 4u && file_name.compare( file_name.size() - 4u, 4u, ".tga" ) == 0;
+				} ),
+			files.end() );
+
+		const unsigned int failed_files=
+			ProcessFilesBatch(
+				files,
+				[&]( const std::string& file_name ) { return ConvertMap( file_name.c_str(), palette ); },
+				thread_count );
+		return failed_files == 0u ? 0 : -1;
+	}
 
-	WriteTGA(
-		c_map_size, c_map_size * 4u,
-		file_data.data() + 0x23001u,
-		palette,
-		( std::string(map_file_name) + ".maps.tga" ).c_str() );
+	const char* map_file_name= "MAP.01";
+	if( argc > 1 )
+		map_file_name= argv[1];
 
+	return ConvertMap( map_file_name, palette ) ? 0 : -1;
 }
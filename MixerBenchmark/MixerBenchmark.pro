@@ -0,0 +1,17 @@
+include(../Common/Common.pri)
+
+#SSE2 instructions here.
+# remove compiler option and define, if you do not need sse2, or if build target is not x86.
+QMAKE_CXXFLAGS += -msse2
+DEFINES+= PC_SSE2_INSTRUCTIONS
+
+SOURCES+= \
+	main.cpp \
+
+SOURCES+= \
+	../PanzerChasm/sound/mixer.cpp \
+
+HEADERS+= \
+	../PanzerChasm/sound/channel.hpp \
+	../PanzerChasm/sound/mixer.hpp \
+	../PanzerChasm/sound/sounds_loader.hpp \
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../PanzerChasm/sound/mixer.hpp"
+#include "../PanzerChasm/sound/sounds_loader.hpp"
+using namespace PanzerChasm::Sound;
+
+namespace
+{
+
+class BenchmarkSoundData final : public ISoundData
+{
+public:
+	BenchmarkSoundData( const DataType data_type, const unsigned int frequency, const unsigned int sample_count )
+		: samples_( sample_count * ( ( data_type == DataType::Signed16 || data_type == DataType::Unsigned16 ) ? 2u : 1u ) )
+	{
+		// Noise is enough for benchmark.
+		unsigned int seed= 1u;
+		for( unsigned char& sample : samples_ )
+		{
+			seed= seed * 1103515245u + 12345u;
+			sample= static_cast<unsigned char>( seed >> 16u );
+		}
+
+		frequency_= frequency;
+		data_type_= data_type;
+		data_= samples_.data();
+		sample_count_= sample_count;
+	}
+
+private:
+	std::vector<unsigned char> samples_;
+};
+
+unsigned int ParseNumber( const char* const str, const unsigned int default_value )
+{
+	const int value= std::atoi( str );
+	return value > 0 ? static_cast<unsigned int>( value ) : default_value;
+}
+
+} // namespace
+
+int main( const int argc, const char* const argv[] )
+{
+	unsigned int voices= Channel::c_max_channels;
+	unsigned int callbacks= 2000u;
+	unsigned int samples_per_callback= 1024u;
+	unsigned int frequency= 44100u;
+
+	for( int i= 1; i < argc; i++ )
+	{
+		const char* const arg= argv[i];
+		if( i == argc - 1 )
+		{
+			std::cout << "Error, expected value, after " << arg << std::endl;
+			break;
+		}
+
+		if( std::strcmp( arg, "-v" ) == 0 )
+			voices= ParseNumber( argv[ i + 1 ], voices );
+		else if( std::strcmp( arg, "-c" ) == 0 )
+			callbacks= ParseNumber( argv[ i + 1 ], callbacks );
+		else if( std::strcmp( arg, "-s" ) == 0 )
+			samples_per_callback= ParseNumber( argv[ i + 1 ], samples_per_callback );
+		else if( std::strcmp( arg, "-f" ) == 0 )
+			frequency= ParseNumber( argv[ i + 1 ], frequency );
+		else
+			continue;
+		i++;
+	}
+
+	if( voices > Channel::c_max_channels )
+	{
+		std::cout << "Too many voices, maximum is " << Channel::c_max_channels << std::endl;
+		voices= Channel::c_max_channels;
+	}
+
+	// Sounds of all mixer paths.
+	const unsigned int c_sound_length_s= 3u;
+	std::vector< std::unique_ptr<BenchmarkSoundData> > sounds;
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Unsigned8, 11025u, 11025u * c_sound_length_s ) );
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Signed8, 11025u, 11025u * c_sound_length_s ) );
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Unsigned8, 22050u, 22050u * c_sound_length_s ) );
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Signed16, frequency, frequency * c_sound_length_s ) );
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Signed16, 44100u, 44100u * c_sound_length_s ) );
+	sounds.emplace_back( new BenchmarkSoundData( ISoundData::DataType::Unsigned16, 11025u, 11025u * c_sound_length_s ) );
+
+	Channels channels;
+	for( unsigned int i= 0u; i < voices; i++ )
+	{
+		Channel& channel= channels[i];
+		channel.is_active= true;
+		channel.looped= true;
+		channel.position_samples= 0u;
+		channel.volume[0]= 0.3f + 0.02f * float(i);
+		channel.volume[1]= 0.9f - 0.02f * float(i);
+		channel.src_sound_data= sounds[ i % sounds.size() ].get();
+	}
+
+	Mixer mixer( frequency, samples_per_callback );
+	std::vector<SampleType> buffer( samples_per_callback * 2u );
+
+	// Warm up caches.
+	mixer.Mix( channels, buffer.data(), samples_per_callback );
+
+	const auto start_time= std::chrono::steady_clock::now();
+	for( unsigned int i= 0u; i < callbacks; i++ )
+		mixer.Mix( channels, buffer.data(), samples_per_callback );
+	const auto end_time= std::chrono::steady_clock::now();
+
+	const double total_ns= double( std::chrono::duration_cast<std::chrono::nanoseconds>( end_time - start_time ).count() );
+	const double total_samples= double( callbacks ) * double( samples_per_callback );
+
+	std::cout << "Voices: " << voices << ", callbacks: " << callbacks << ", samples per callback: " << samples_per_callback
+		<< ", frequency: " << frequency << std::endl;
+	std::cout << "Time per output sample: " << total_ns / total_samples << " ns" << std::endl;
+	std::cout << "Time per callback: " << total_ns / double( callbacks ) / 1000.0 << " us" << std::endl;
+
+	return 0;
+}
@@ -1,15 +1,20 @@
 include(../Common/Common.pri)
 
+unix {
+	LIBS+= -lpthread
+}
+
 SOURCES+= \
 	main.cpp \
 
 SOURCES+= \
+	../Common/batch.cpp \
 	../Common/files.cpp \
 	../Common/palette.cpp \
 	../Common/tga.cpp \
 
 HEADERS+= \
+	../Common/batch.hpp \
 	../Common/files.hpp \
 	../Common/palette.hpp \
 	../Common/tga.hpp \
-
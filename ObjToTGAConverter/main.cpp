@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <vector>
 
+#include "../Common/batch.hpp"
 #include "../Common/files.hpp"
 #include "../Common/palette.hpp"
 #include "../Common/tga.hpp"
@@ -15,22 +17,15 @@ struct SpriteFrame
 	std::vector<unsigned char> data;
 };
 
-int main( const int argc, const char* const argv[] )
+static bool ConvertObj( const char* const file_name, const Palette& palette )
 {
-	const char* file_name= "FLAME.OBJ";
-	if( argc > 1 )
-		file_name= argv[1];
-
 	FILE* const file= std::fopen( file_name, "rb" );
 	if( file == nullptr )
 	{
 		std::cout << "Could not read file \"" << file_name << "\"" << std::endl;
-		return -1;
+		return false;
 	}
 
-	Palette palette;
-	LoadPalette( palette );
-
 	unsigned short frame_count;
 	FileRead( file, &frame_count, sizeof(unsigned short) );
 
@@ -51,29 +46,61 @@ int main( const int argc, const char* const argv[] )
 			if( frame.size[j] > max_size[j] ) max_size[j]= frame.size[j];
 	}
 
+	std::fclose( file );
+
 	for( unsigned int j= 0u; j < 2u; j++ )
 	{
 		max_size[j]+= 2u; // add offsets
 		max_size[j]= ( max_size[j] + 15u ) & (~15u);
 	}
 
-	std::vector<unsigned char> atlas( max_size[0u] * max_size[1u] * frame_count, 255u );
+	// Write atlas row by row, with RLE compression, because atlas contains many transparent pixels.
+	TGAWriter writer( max_size[0u], max_size[1u] * frame_count, palette.data(), ( std::string(file_name) + ".tga" ).c_str(), true );
+	std::vector<unsigned char> row( max_size[0u] );
 
 	for( unsigned int frame= 0u; frame < frame_count; frame++ )
 	{
 		const unsigned char* const src= frames[ frame ].data.data();
-		unsigned char* const dst= atlas.data() + max_size[0u] * max_size[1u] * frame + 1u + max_size[0u];
 
-		for( unsigned int y= 0u; y < frames[ frame ].size[1u]; y++ )
-		for( unsigned int x= 0u; x < frames[ frame ].size[0u]; x++ )
-			dst[ x + y * max_size[0u] ]= src[ y + x * frames[ frame ].size[1u] ];
+		for( unsigned int atlas_y= 0u; atlas_y < max_size[1u]; atlas_y++ )
+		{
+			std::fill( row.begin(), row.end(), 255u );
+
+			const unsigned int y= atlas_y - 1u;
+			if( atlas_y >= 1u && y < frames[ frame ].size[1u] )
+			{
+				for( unsigned int x= 0u; x < frames[ frame ].size[0u]; x++ )
+					row[ 1u + x ]= src[ y + x * frames[ frame ].size[1u] ];
+			}
+
+			writer.WriteRow( row.data() );
+		}
+	}
+
+	return true;
+}
+
+int main( const int argc, const char* const argv[] )
+{
+	Palette palette;
+	LoadPalette( palette );
+
+	std::string batch_directory;
+	unsigned int thread_count;
+	if( ParseBatchOptions( argc, argv, batch_directory, thread_count ) )
+	{
+		const std::vector<std::string> files= ListDirectoryFiles( batch_directory.c_str(), "", ".OBJ" );
+		const unsigned int failed_files=
+			ProcessFilesBatch(
+				files,
+				[&]( const std::string& file_name ) { return ConvertObj( file_name.c_str(), palette ); },
+				thread_count );
+		return failed_files == 0u ? 0 : -1;
 	}
 
-	WriteTGA(
-		max_size[0u], max_size[1u] * frame_count,
-		atlas.data(),
-		palette.data(),
-		( std::string(file_name) + ".tga" ).c_str() );
+	const char* file_name= "FLAME.OBJ";
+	if( argc > 1 )
+		file_name= argv[1];
 
-	std::fclose( file );
+	return ConvertObj( file_name, palette ) ? 0 : -1;
 }
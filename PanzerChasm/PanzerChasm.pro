@@ -18,6 +18,7 @@ else {
 
 	LIBS+= -lSDL2
 	LIBS+= -lGL
+	LIBS+= -lpthread
 }
 
 CONFIG( debug, debug|release ) {
@@ -29,6 +30,11 @@ CONFIG( debug, debug|release ) {
 QMAKE_CXXFLAGS += -mmmx
 DEFINES+= PC_MMX_INSTRUCTIONS
 
+#SSE2 instructions here.
+# remove compiler option and define, if you do not need sse2, or if build target is not x86.
+QMAKE_CXXFLAGS += -msse2
+DEFINES+= PC_SSE2_INSTRUCTIONS
+
 
 win32: RC_FILE= PanzerChasm.rc
 
@@ -36,6 +42,7 @@ INCLUDEPATH+= ../panzer_ogl_lib
 INCLUDEPATH+= $$SDL_INCLUDES_DIR
 
 SOURCES+= \
+	cache_files.cpp \
 	client/client.cpp \
 	client/cutscene_player.cpp \
 	client/cutscene_script.cpp \
@@ -51,23 +58,34 @@ SOURCES+= \
 	client/map_state.cpp \
 	client/movement_controller.cpp \
 	client/opengl_renderer/animations_buffer.cpp \
+	client/opengl_renderer/gpu_passes_profiler.cpp \
 	client/opengl_renderer/map_light.cpp \
 	client/opengl_renderer/models_textures_corrector.cpp \
+	client/opengl_renderer/occlusion_culler.cpp \
+	client/opengl_renderer/texture_compression.cpp \
+	client/opengl_renderer/textures_disk_cache.cpp \
+	client/player_movement_predictor.cpp \
 	client/software_renderer/map_bsp_tree.cpp \
+	client/software_renderer/map_pvs.cpp \
 	client/software_renderer/rasterizer.cpp \
 	client/software_renderer/surfaces_cache.cpp \
+	client/software_renderer/tiled_rasterizer.cpp \
 	client/weapon_state.cpp \
 	commands_processor.cpp \
 	connection_info.cpp \
 	console.cpp \
+	demo.cpp \
 	drawers_factory_gl.cpp \
 	drawers_factory_soft.cpp \
+	frame_pacing.cpp \
 	game_resources.cpp \
 	host.cpp \
 	images.cpp \
 	log.cpp \
 	loopback_buffer.cpp \
+	lz_compression.cpp \
 	main.cpp \
+	map_baking.cpp \
 	map_loader.cpp \
 	math_utils.cpp \
 	menu.cpp \
@@ -75,28 +93,40 @@ SOURCES+= \
 	menu_drawer_gl.cpp \
 	menu_drawer_soft.cpp \
 	messages.cpp \
+	messages_encoding.cpp \
 	messages_extractor.cpp \
 	messages_sender.cpp \
 	model.cpp \
 	net/net.cpp \
+	net/threaded_connections_listener.cpp \
+	net_statistics.cpp \
 	obj.cpp \
 	program_arguments.cpp \
+	profiler.cpp \
+	quads_batcher_gl.cpp \
 	rand.cpp \
+	retained_layer_soft.cpp \
 	save_load.cpp \
 	save_load_streams.cpp \
 	server/collisions.cpp \
 	server/collision_index.cpp \
 	server/map.cpp \
 	server/map_save_load.cpp \
+	server/memory_arena.cpp \
 	server/monster.cpp \
 	server/monster_base.cpp \
+	server/monsters_index.cpp \
 	server/movement_restriction.cpp \
+	server/navigation_grid.cpp \
 	server/player.cpp \
+	server/player_movement.cpp \
 	server/server.cpp \
 	settings.cpp \
+	shader_program_gl.cpp \
 	shared_drawers.cpp \
 	sound/ambient_sound_processor.cpp \
 	sound/driver.cpp \
+	sound/mixer.cpp \
 	sound/objects_sounds_processor.cpp \
 	sound/sound_engine.cpp \
 	sound/sounds_loader.cpp \
@@ -105,15 +135,19 @@ SOURCES+= \
 	ticks_counter.cpp \
 	time.cpp \
 	text_drawers_common.cpp \
+	text_tokenizer.cpp \
 	text_drawer_gl.cpp \
 	text_drawer_soft.cpp \
 	vfs.cpp \
+	workers_pool.cpp \
 
 HEADERS+= \
 	assert.hpp \
+	cache_files.hpp \
 	client/client.hpp \
 	client/cutscene_player.hpp \
 	client/cutscene_script.hpp \
+	client/deferred_messages.hpp \
 	client/fwd.hpp \
 	client/i_hud_drawer.hpp \
 	client/i_map_drawer.hpp \
@@ -129,22 +163,33 @@ HEADERS+= \
 	client/minimap_drawer_gl.hpp \
 	client/minimap_drawer_soft.hpp \
 	client/minimap_state.hpp \
+	client/models_conversion_cache.hpp \
 	client/movement_controller.hpp \
 	client/opengl_renderer/animations_buffer.hpp \
+	client/opengl_renderer/gpu_passes_profiler.hpp \
 	client/opengl_renderer/map_light.hpp \
 	client/opengl_renderer/models_textures_corrector.hpp \
+	client/opengl_renderer/occlusion_culler.hpp \
+	client/opengl_renderer/texture_compression.hpp \
+	client/opengl_renderer/textures_disk_cache.hpp \
+	client/player_movement_predictor.hpp \
 	client/software_renderer/fixed.hpp \
 	client/software_renderer/map_bsp_tree.hpp \
 	client/software_renderer/map_bsp_tree.inl \
+	client/software_renderer/map_pvs.hpp \
 	client/software_renderer/rasterizer.hpp \
 	client/software_renderer/rasterizer.inl \
 	client/software_renderer/surfaces_cache.hpp \
+	client/software_renderer/tiled_rasterizer.hpp \
 	client/weapon_state.hpp \
 	commands_processor.hpp \
 	connection_info.hpp \
 	console.hpp \
+	demo.hpp \
 	drawers_factory_gl.hpp \
 	drawers_factory_soft.hpp \
+	entities_container.hpp \
+	frame_pacing.hpp \
 	fwd.hpp \
 	game_constants.hpp \
 	game_resources.hpp \
@@ -157,6 +202,8 @@ HEADERS+= \
 	images.hpp \
 	log.hpp \
 	loopback_buffer.hpp \
+	lz_compression.hpp \
+	map_baking.hpp \
 	map_loader.hpp \
 	math_utils.hpp \
 	menu.hpp \
@@ -164,17 +211,23 @@ HEADERS+= \
 	menu_drawer_gl.hpp \
 	menu_drawer_soft.hpp \
 	messages.hpp \
+	messages_encoding.hpp \
 	messages_extractor.hpp \
 	messages_extractor.inl \
 	messages_list.h \
 	messages_sender.hpp \
 	model.hpp \
 	net/net.hpp \
+	net/threaded_connections_listener.hpp \
+	net_statistics.hpp \
 	obj.hpp \
 	particles.hpp \
 	program_arguments.hpp \
+	profiler.hpp \
+	quads_batcher_gl.hpp \
 	rand.hpp \
 	rendering_context.hpp \
+	retained_layer_soft.hpp \
 	save_load.hpp \
 	save_load_streams.hpp \
 	server/a_code.hpp \
@@ -184,18 +237,29 @@ HEADERS+= \
 	server/collision_index.inl \
 	server/fwd.hpp \
 	server/map.hpp \
+	server/map_collision.hpp \
+	server/map_collision.inl \
+	server/memory_arena.hpp \
 	server/monster.hpp \
 	server/monster_base.hpp \
+	server/monsters_index.hpp \
+	server/monsters_index.inl \
 	server/movement_restriction.hpp \
+	server/navigation_grid.hpp \
 	server/player.hpp \
+	server/player_movement.hpp \
+	server/relay.hpp \
 	server/server.hpp \
+	server/sparse_map_field.hpp \
 	settings.hpp \
+	shader_program_gl.hpp \
 	shared_drawers.hpp \
 	shared_settings_keys.hpp \
 	size.hpp \
 	sound/ambient_sound_processor.hpp \
 	sound/channel.hpp \
 	sound/driver.hpp \
+	sound/mixer.hpp \
 	sound/objects_sounds_processor.hpp \
 	sound/sound_engine.hpp \
 	sound/sound_id.hpp \
@@ -204,10 +268,12 @@ HEADERS+= \
 	system_window.hpp \
 	ticks_counter.hpp \
 	text_drawers_common.hpp \
+	text_tokenizer.hpp \
 	text_drawer_gl.hpp \
 	text_drawer_soft.hpp \
 	time.hpp \
 	vfs.hpp \
+	workers_pool.hpp \
 
 SOURCES+= \
 	../Common/files.cpp \
@@ -0,0 +1,89 @@
+// cache_builder_main.cpp - entry point of headless cache builder.
+// Walks all maps of game archive (and addon) once and writes precomputed caches into "cache" directory,
+// using same loading code, as game. Intended to be run once at installation time.
+// Produces baked maps and BSP trees of software renderer. Textures and lightmaps caches of OpenGL renderer are
+// not produced here, because they depend on OpenGL driver and are created by game itself at first start.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "client/software_renderer/map_bsp_tree.hpp"
+#include "log.hpp"
+#include "map_loader.hpp"
+#include "program_arguments.hpp"
+#include "vfs.hpp"
+
+using namespace PanzerChasm;
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	const ProgramArguments program_arguments( argc, argv );
+
+	unsigned int thread_count= std::max( std::thread::hardware_concurrency(), 1u );
+	if( const char* const threads_str= program_arguments.GetParamValue( "threads" ) )
+		thread_count= static_cast<unsigned int>( std::max( 1, std::atoi( threads_str ) ) );
+
+	Log::Info( "Read game archive" );
+	const char* csm_file= "CSM.BIN";
+	if( const char* const overrided_csm_file = program_arguments.GetParamValue( "csm" ) )
+		csm_file= overrided_csm_file;
+	const VfsPtr vfs= std::make_shared<Vfs>( csm_file, program_arguments.GetParamValue( "addon" ) );
+
+	const std::vector<MapLoader::MapInfo> maps_info= MapLoader( vfs, 0u, LoadProfile::Full ).GetAllMapsInfo();
+	Log::Info( "Building caches for ", maps_info.size(), " maps, using ", thread_count, " threads" );
+
+	const auto start_time= std::chrono::steady_clock::now();
+
+	std::atomic<unsigned int> next_map_index( 0u );
+	std::atomic<unsigned int> failed_maps( 0u );
+
+	const auto thread_func=
+	[&]
+	{
+		// Each thread has own loader, so, maps are loaded in parallel. Cache is not needed here.
+		MapLoader map_loader( vfs, 0u, LoadProfile::Full );
+
+		while(true)
+		{
+			const unsigned int map_index= next_map_index.fetch_add( 1u );
+			if( map_index >= maps_info.size() )
+				break;
+
+			const MapLoader::MapInfo& map_info= maps_info[ map_index ];
+
+			// Map loading writes baked map, if it is not baked yet.
+			const MapDataConstPtr map_data= map_loader.LoadMap( map_info.number );
+			if( map_data == nullptr )
+			{
+				Log::Warning( "Can not load map ", map_info.number );
+				failed_maps.fetch_add( 1u );
+				continue;
+			}
+
+			// Tree constructor writes cache, if it is not built yet.
+			const MapBSPTree bsp_tree( map_data );
+
+			Log::Info( "Map ", map_info.number, " \"", map_info.name, "\" done" );
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( unsigned int i= 1u; i < thread_count; i++ )
+		threads.emplace_back( thread_func );
+	thread_func();
+	for( std::thread& thread : threads )
+		thread.join();
+
+	const double time_s= std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+	Log::Info( "Caches built in ", time_s, " s, failed maps: ", failed_maps.load() );
+
+	return failed_maps.load() == 0u ? 0 : -1;
+}
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <string>
+
+// Include OS-dependend stuff for "mkdir".
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "../Common/files.hpp"
+using namespace ChasmReverse;
+
+#include "log.hpp"
+
+#include "cache_files.hpp"
+
+namespace PanzerChasm
+{
+
+bool ReadCacheFile(
+	const char* const file_name,
+	void* const out_header, const size_t header_size,
+	std::vector<unsigned char>& out_content )
+{
+	FILE* const f= std::fopen( file_name, "rb" );
+	if( f == nullptr )
+		return false;
+
+	std::fseek( f, 0, SEEK_END );
+	const long file_size= std::ftell( f );
+	std::fseek( f, 0, SEEK_SET );
+
+	if( file_size < 0 || static_cast<unsigned long>(file_size) < header_size )
+	{
+		std::fclose(f);
+		return false;
+	}
+
+	FileRead( f, out_header, header_size );
+
+	out_content.resize( static_cast<size_t>(file_size) - header_size );
+	FileRead( f, out_content.data(), out_content.size() );
+
+	const bool read_failed= std::ferror( f ) != 0;
+	std::fclose(f);
+
+	if( read_failed )
+	{
+		out_content.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool WriteCacheFile( const char* const file_name, const std::initializer_list<CacheFileChunk> chunks )
+{
+#ifdef _WIN32
+	_mkdir( CACHE_FILES_DIR );
+#else
+	mkdir( CACHE_FILES_DIR, 0777 );
+#endif
+
+	const std::string temp_file_name= std::string( file_name ) + ".tmp";
+
+	FILE* const f= std::fopen( temp_file_name.c_str(), "wb" );
+	if( f == nullptr )
+	{
+		Log::Warning( "Can not write cache file \"", file_name, "\"" );
+		return false;
+	}
+
+	for( const CacheFileChunk& chunk : chunks )
+		FileWrite( f, chunk.data, chunk.size );
+
+	const bool write_failed= std::ferror( f ) != 0;
+	if( std::fclose(f) != 0 || write_failed )
+	{
+		Log::Warning( "Can not write cache file \"", file_name, "\"" );
+		std::remove( temp_file_name.c_str() );
+		return false;
+	}
+
+#ifdef _WIN32
+	// "rename" on Windows does not replace existing files.
+	std::remove( file_name );
+#endif
+	if( std::rename( temp_file_name.c_str(), file_name ) != 0 )
+	{
+		Log::Warning( "Can not write cache file \"", file_name, "\"" );
+		std::remove( temp_file_name.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace PanzerChasm
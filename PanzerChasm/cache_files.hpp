@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// Directory for all on-disk caches - baked maps, lightmaps, textures, shaders binaries, BSP trees.
+#define CACHE_FILES_DIR "cache"
+
+namespace PanzerChasm
+{
+
+// Cache file is header of fixed size, followed by content.
+// Headers checking and content hashing are specific for each cache kind, so, callers do it.
+
+struct CacheFileChunk
+{
+	const void* data;
+	size_t size;
+};
+
+// Returns false, if file does not exist or if it is smaller, than header.
+bool ReadCacheFile(
+	const char* file_name,
+	void* out_header, size_t header_size,
+	std::vector<unsigned char>& out_content );
+
+// Creates cache directory, writes chunks into temporary file and than replaces with it file "file_name".
+// So, broken file is never left after crash or write error. Returns false on error.
+bool WriteCacheFile( const char* file_name, std::initializer_list<CacheFileChunk> chunks );
+
+} // namespace PanzerChasm
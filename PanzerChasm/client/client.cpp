@@ -1,10 +1,15 @@
+#include <chrono>
+
 #include "../assert.hpp"
+#include "../frame_pacing.hpp"
 #include "../game_constants.hpp"
 #include "../i_drawers_factory.hpp"
 #include "../i_menu_drawer.hpp"
+#include "../i_text_drawer.hpp"
 #include "../log.hpp"
 #include "../math_utils.hpp"
 #include "../messages_extractor.inl"
+#include "../profiler.hpp"
 #include "../save_load_streams.hpp"
 #include "../settings.hpp"
 #include "../shared_drawers.hpp"
@@ -23,6 +28,9 @@ namespace PanzerChasm
 {
 
 static const char g_small_hud_mode[]= "cl_small_hud_mode";
+static const char g_draw_renderer_stats[]= "cl_draw_renderer_stats";
+static const char g_draw_net_stats[]= "cl_draw_net_stats";
+static const char g_movement_prediction[]= "cl_movement_prediction";
 
 struct Client::LoadedMinimapState
 {
@@ -41,11 +49,15 @@ Client::Client(
 	const Sound::SoundEnginePtr& sound_engine,
 	const DrawLoadingCallback& draw_loading_callback )
 	: settings_(settings)
+	, crosshair_setting_( settings.RegisterBool( SettingsKeys::crosshair, true ) )
+	, small_hud_mode_setting_( settings.RegisterBool( g_small_hud_mode, false ) )
+	, draw_renderer_stats_setting_( settings.RegisterBool( g_draw_renderer_stats, false ) )
+	, draw_net_stats_setting_( settings.RegisterBool( g_draw_net_stats, false ) )
 	, game_resources_(game_resources)
 	, map_loader_(map_loader)
 	, sound_engine_(sound_engine)
 	, draw_loading_callback_(draw_loading_callback)
-	, current_tick_time_( Time::CurrentTime() )
+	, current_tick_time_( Time::FrameTime() )
 	, camera_controller_(
 		settings,
 		m_Vec3( 0.0f, 0.0f, 0.0f ),
@@ -65,6 +77,8 @@ Client::Client(
 	CommandsMapPtr commands= std::make_shared<CommandsMap>();
 	commands->emplace( "fullmap", std::bind( &Client::FullMap, this ) );
 	commands->emplace( "pos", std::bind( &Client::PrintPlayerPos, this ) );
+	commands->emplace( "renderer_stats", std::bind( &Client::PrintRendererStats, this ) );
+	commands->emplace( "net_stats", std::bind( &Client::PrintNetStats, this ) );
 	commands_= std::move( commands );
 	commands_processor.RegisterCommands(commands_);
 
@@ -113,6 +127,28 @@ void Client::VidRestart( IDrawersFactory& drawers_factory )
 	camera_controller_.SetAspect( shared_drawers_->menu->GetViewportSize().GetWidthToHeightRatio() );
 }
 
+void Client::RecreateDrawers( IDrawersFactory& drawers_factory, const bool recreate_map_drawer )
+{
+	hud_drawer_= nullptr;
+	hud_drawer_= drawers_factory.CreateHUDDrawer( shared_drawers_ );
+
+	if( !recreate_map_drawer )
+		return;
+
+	// Cutscene player holds reference to map drawer.
+	if( cutscene_player_ != nullptr )
+	{
+		cutscene_player_= nullptr;
+		if( sound_engine_ != nullptr )
+			sound_engine_->SetMap( current_map_data_ );
+	}
+
+	map_drawer_= nullptr;
+	map_drawer_= drawers_factory.CreateMapDrawer();
+	if( current_map_data_ != nullptr )
+		map_drawer_->SetMap( current_map_data_ );
+}
+
 void Client::Save( SaveLoadBuffer& buffer, SaveComment& out_save_comment )
 {
 	PC_ASSERT( current_map_data_ != nullptr );
@@ -130,13 +166,13 @@ void Client::Save( SaveLoadBuffer& buffer, SaveComment& out_save_comment )
 
 	// TODO - write bools in more compact form
 
-	save_stream.WriteUInt32( static_cast<uint32_t>(static_walls_visibility .size()) );
-	for( const bool& wall_visibility : static_walls_visibility  )
-		save_stream.WriteBool( wall_visibility );
+	save_stream.WriteUInt32( static_cast<uint32_t>(static_walls_visibility .Size()) );
+	for( unsigned int i= 0u; i < static_walls_visibility .Size(); i++ )
+		save_stream.WriteBool( static_walls_visibility .Get(i) );
 
-	save_stream.WriteUInt32( static_cast<uint32_t>(dynamic_walls_visibility.size()) );
-	for( const bool& wall_visibility : dynamic_walls_visibility )
-		save_stream.WriteBool( wall_visibility );
+	save_stream.WriteUInt32( static_cast<uint32_t>(dynamic_walls_visibility.Size()) );
+	for( unsigned int i= 0u; i < dynamic_walls_visibility.Size(); i++ )
+		save_stream.WriteBool( dynamic_walls_visibility.Get(i) );
 
 	// Write comment
 	std::snprintf( out_save_comment.data(), sizeof(SaveComment), "Level%2d  health %03d", current_map_data_->number, player_state_.health );
@@ -154,22 +190,24 @@ void Client::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 
 	unsigned int static_walls_count ;
 	load_stream.ReadUInt32( static_walls_count  );
-	loaded_minimap_state_->static_walls_visibility .resize( static_walls_count  );
+	loaded_minimap_state_->static_walls_visibility = MinimapState::WallsVisibility( static_walls_count  );
 	for( unsigned int i= 0u; i < static_walls_count ; i++ )
 	{
 		bool b;
 		load_stream.ReadBool( b );
-		loaded_minimap_state_->static_walls_visibility [i]= b;
+		if( b )
+			loaded_minimap_state_->static_walls_visibility .Set(i);
 	}
 
 	unsigned int dynamic_walls_count;
 	load_stream.ReadUInt32( dynamic_walls_count );
-	loaded_minimap_state_->dynamic_walls_visibility .resize( dynamic_walls_count );
+	loaded_minimap_state_->dynamic_walls_visibility= MinimapState::WallsVisibility( dynamic_walls_count );
 	for( unsigned int i= 0u; i < dynamic_walls_count; i++ )
 	{
 		bool b;
 		load_stream.ReadBool( b );
-		loaded_minimap_state_->dynamic_walls_visibility[i]= b;
+		if( b )
+			loaded_minimap_state_->dynamic_walls_visibility.Set(i);
 	}
 
 	buffer_pos= load_stream.GetBufferPos();
@@ -177,6 +215,8 @@ void Client::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 
 void Client::SetConnection( IConnectionPtr connection )
 {
+	CancelMapLoading();
+
 	if( connection == nullptr )
 	{
 		connection_info_= nullptr;
@@ -185,10 +225,16 @@ void Client::SetConnection( IConnectionPtr connection )
 	else
 	{
 		connection_info_.reset( new ConnectionInfo( connection ) );
+		net_statistics_= NetStatistics();
 		TransmitPlayerName();
 	}
 }
 
+bool Client::MapIsLoaded() const
+{
+	return current_map_data_ != nullptr && minimap_state_ != nullptr && !map_loading_future_.valid();
+}
+
 bool Client::Disconnected() const
 {
 	if( connection_info_ == nullptr )
@@ -249,7 +295,10 @@ void Client::ProcessEvents( const SystemEvents& events )
 
 void Client::Loop( const InputState& input_state, const bool paused )
 {
-	const Time current_real_time= Time::CurrentTime();
+	PC_PROFILE_SCOPE( "Client::Loop" );
+
+	Time::SampleFrameTime();
+	const Time current_real_time= Time::FrameTime();
 
 	// Calculate time, which we spend in pause.
 	// Subtract time, spended in pauses, from real time.
@@ -274,9 +323,23 @@ void Client::Loop( const InputState& input_state, const bool paused )
 	if( connection_info_ != nullptr )
 	{
 		if( connection_info_->connection->Disconnected() )
+		{
+			CancelMapLoading();
 			StopMap();
+		}
 		else
-			connection_info_->messages_extractor.ProcessMessages( *this );
+		{
+			PC_PROFILE_SCOPE( "Client::ProcessMessages" );
+			MessagesRouter messages_router{ *this };
+			connection_info_->messages_extractor.ProcessMessages( messages_router );
+			TryFinishMapLoading();
+			if( map_state_ != nullptr )
+				map_state_->FlushMonstersStates();
+			net_statistics_.Update(
+				connection_info_->messages_sender.GetTrafficCounters(),
+				connection_info_->messages_extractor.GetTrafficCounters(),
+				current_real_time );
+		}
 	}
 
 	if( cutscene_player_ != nullptr )
@@ -305,6 +368,8 @@ void Client::Loop( const InputState& input_state, const bool paused )
 	}
 
 	shoot_pressed_= input_state.mouse[ static_cast<unsigned int>( SystemEvent::MouseKeyEvent::Button::Left ) ];
+	if( !paused && ( input_state.mouse_dx != 0 || input_state.mouse_dy != 0 ) )
+		camera_controller_.ControllerRotate( input_state.mouse_dy, input_state.mouse_dx );
 	camera_controller_.Tick( input_state.keyboard );
 
 	if( sound_engine_ != nullptr )
@@ -327,6 +392,13 @@ void Client::Loop( const InputState& input_state, const bool paused )
 	{
 		map_state_->Tick( current_tick_time_ );
 
+		if( movement_predictor_ != nullptr )
+		{
+			movement_predictor_->Tick( *map_state_, current_tick_time_ - prev_tick_time );
+			player_position_= movement_predictor_->GetPosition();
+			camera_controller_.SetSpeed( movement_predictor_->GetSpeed() );
+		}
+
 		if( minimap_state_ != nullptr )
 			minimap_state_->Update(
 				*map_state_,
@@ -350,6 +422,7 @@ void Client::Loop( const InputState& input_state, const bool paused )
 			camera_controller_.GetAcceleration( input_state.keyboard, move_direction, move_acceleration );
 
 			Messages::PlayerMove message;
+			message.sequence= ++move_sequence_;
 			message.view_direction= AngleToMessageAngle( camera_controller_.GetViewAngleZ() + Constants::half_pi );
 			message.move_direction= AngleToMessageAngle( move_direction );
 			message.acceleration= static_cast<unsigned char>( move_acceleration * 254.5f );
@@ -361,7 +434,17 @@ void Client::Loop( const InputState& input_state, const bool paused )
 			message.shoot_pressed= shoot_pressed_;
 			message.color= settings_.GetOrSetInt( SettingsKeys::player_color );
 
+			message.view_server_time_ms= 0u;
+			message.view_server_time_valid=
+				map_state_ != nullptr &&
+				map_state_->GetShownServerTimeMs( message.view_server_time_ms );
+
 			connection_info_->messages_sender.SendUnreliableMessage( message );
+			net_statistics_.OnSequenceSent( message.sequence, current_real_time );
+			FramePacing::OnPlayerMoveSent( message.sequence );
+
+			if( movement_predictor_ != nullptr )
+				movement_predictor_->AddMove( message );
 		}
 
 		connection_info_->messages_sender.Flush();
@@ -370,18 +453,24 @@ void Client::Loop( const InputState& input_state, const bool paused )
 
 void Client::Draw()
 {
+	PC_PROFILE_SCOPE( "Client::Draw" );
+
 	if( cutscene_player_ != nullptr )
 	{
 		cutscene_player_->Draw();
 		return;
 	}
 
+	if( map_loading_future_.valid() )
+	{
+		shared_drawers_->menu->DrawLoading( 0.5f );
+		return;
+	}
+
 	if( map_state_ != nullptr )
 	{
 		PC_ASSERT( current_map_data_ != nullptr );
 
-		camera_controller_.UpdateParams();
-
 		m_Vec3 pos= player_position_;
 		const float z_shift= camera_controller_.GetEyeZShift();
 
@@ -442,10 +531,10 @@ void Client::Draw()
 				camera_controller_.GetViewAngleZ() );
 		}
 
-		if( settings_.GetOrSetBool( SettingsKeys::crosshair, true ) )
+		if( settings_.Get( crosshair_setting_ ) )
 			hud_drawer_->DrawCrosshair();
 		hud_drawer_->DrawCurrentMessage( current_tick_time_ );
-		if( settings_.GetOrSetBool( g_small_hud_mode, false ) )
+		if( settings_.Get( small_hud_mode_setting_ ) )
 			hud_drawer_->DrawSmallHud();
 		else
 		{
@@ -470,6 +559,20 @@ void Client::Draw()
 					nullptr );
 			}
 		}
+
+		std::vector<std::string> stats_lines;
+		if( settings_.Get( draw_renderer_stats_setting_ ) )
+			map_drawer_->GetFrameStats( stats_lines );
+		if( settings_.Get( draw_net_stats_setting_ ) && connection_info_ != nullptr )
+			net_statistics_.GetStatsLines( stats_lines, false );
+
+		const unsigned int scale= 1u;
+		int y= 0;
+		for( const std::string& line : stats_lines )
+		{
+			shared_drawers_->text->Print( 4 * int(scale), y, line.c_str(), scale, ITextDrawer::FontColor::Golden );
+			y+= int(shared_drawers_->text->GetLineHeight());
+		}
 	}
 }
 
@@ -482,6 +585,9 @@ void Client::operator()( const Messages::MessageBase& message )
 void Client::operator()( const Messages::ServerState& message )
 {
 	server_state_= message;
+
+	if( map_state_ != nullptr )
+		map_state_->ProcessMessage( message );
 }
 
 void Client::operator()( const Messages::DynamicTextMessage& message )
@@ -495,10 +601,23 @@ void Client::operator()( const Messages::PlayerSpawn& message )
 	MessagePositionToPosition( message.xyz, player_position_ );
 	camera_controller_.SetAngles( MessageAngleToAngle( message.direction ) - Constants::half_pi, 0.0f );
 	player_monster_id_= message.player_monster_id;
+
+	if( movement_predictor_ != nullptr )
+		movement_predictor_->Teleport( player_position_ );
 }
 
 void Client::operator()( const Messages::PlayerPosition& message )
 {
+	net_statistics_.OnSequenceAcknowledged( message.last_move_sequence, Time::FrameTime() );
+	FramePacing::OnPlayerPositionReceived( message.last_move_sequence );
+
+	// Predictor reconciles own position with server position.
+	if( movement_predictor_ != nullptr )
+	{
+		movement_predictor_->ProcessPosition( message );
+		return;
+	}
+
 	MessagePositionToPosition( message.xyz, player_position_ );
 	camera_controller_.SetSpeed( MessageCoordToCoord( message.speed ) );
 }
@@ -554,6 +673,7 @@ void Client::operator()( const Messages::MonsterLinkedSound& message )
 	}
 	else if( map_state_ != nullptr )
 	{
+		map_state_->FlushMonstersStates();
 		const MapState::MonstersContainer& monsters= map_state_->GetMonsters();
 		const auto it= monsters.find( message.monster_id );
 		if( it != monsters.end() )
@@ -568,6 +688,7 @@ void Client::operator()( const Messages::MonsterSound& message )
 
 	if( map_state_ != nullptr )
 	{
+		map_state_->FlushMonstersStates();
 		const MapState::MonstersContainer& monsters= map_state_->GetMonsters();
 		const auto it= monsters.find( message.monster_id );
 		if( it != monsters.end() )
@@ -579,6 +700,48 @@ void Client::operator()( const Messages::MapChange& message )
 {
 	Log::Info( "Changing client map to ", message.map_number );
 
+	// Map change is never processed while previous map is loading, messages are deferred in this case.
+	PC_ASSERT( !map_loading_future_.valid() );
+	StopMap();
+
+	// Load map and build client-side state in background, while initial state of map is received from server.
+	// Drawers are set only after loading, in main thread.
+	const MapLoaderPtr map_loader= map_loader_;
+	const GameResourcesConstPtr game_resources= game_resources_;
+	const unsigned int map_number= message.map_number;
+	const bool movement_prediction= settings_.GetOrSetBool( g_movement_prediction, true );
+
+	map_loading_message_= message;
+	map_loading_future_=
+		std::async(
+			std::launch::async,
+			[map_loader, game_resources, map_number, movement_prediction]() -> LoadedMap
+			{
+				PC_PROFILE_SCOPE( "Client map loading" );
+
+				LoadedMap result;
+				result.map_data= map_loader->LoadMap( map_number );
+				if( result.map_data == nullptr )
+					return result;
+
+				result.map_state.reset( new MapState( result.map_data, game_resources, Time::CurrentTime() ) );
+				result.minimap_state.reset( new MinimapState( result.map_data ) );
+				if( movement_prediction )
+					result.movement_predictor.reset( new PlayerMovementPredictor( result.map_data ) );
+
+				return result;
+			} );
+}
+
+void Client::TryFinishMapLoading()
+{
+	if( !map_loading_future_.valid() ||
+		map_loading_future_.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+		return;
+
+	LoadedMap loaded_map= map_loading_future_.get();
+	const Messages::MapChange& message= map_loading_message_;
+
 	const auto show_progress=
 	[&]( const float progress )
 	{
@@ -586,65 +749,75 @@ void Client::operator()( const Messages::MapChange& message )
 			draw_loading_callback_( progress, "Client" );
 	};
 
-	show_progress( 0.0f );
-
-	const MapDataConstPtr map_data= map_loader_->LoadMap( message.map_number );
-	if( map_data == nullptr )
-	{
+	if( loaded_map.map_data == nullptr )
 		Log::Warning( "Error, server requested map, which does not exist on client" );
-		return;
-	}
+	else
+	{
+		const MapDataConstPtr& map_data= loaded_map.map_data;
 
-	show_progress( 0.5 );
-	map_state_.reset( new MapState( map_data, game_resources_, Time::CurrentTime() ) );
-	minimap_state_.reset( new MinimapState( map_data ) );
+		show_progress( 0.5f );
+		map_state_= std::move( loaded_map.map_state );
+		minimap_state_= std::move( loaded_map.minimap_state );
+		movement_predictor_= std::move( loaded_map.movement_predictor );
 
-	if( loaded_minimap_state_ != nullptr &&
-		loaded_minimap_state_->map_number == message.map_number )
-	{
-		minimap_state_->SetState(
-			loaded_minimap_state_->static_walls_visibility ,
-			loaded_minimap_state_->dynamic_walls_visibility );
-	}
-	loaded_minimap_state_= nullptr;
+		if( loaded_minimap_state_ != nullptr &&
+			loaded_minimap_state_->map_number == message.map_number )
+		{
+			minimap_state_->SetState(
+				loaded_minimap_state_->static_walls_visibility ,
+				loaded_minimap_state_->dynamic_walls_visibility );
+		}
+		loaded_minimap_state_= nullptr;
 
-	show_progress( 0.8f );
+		show_progress( 0.8f );
 
-	hud_drawer_->ResetMessage();
+		hud_drawer_->ResetMessage();
 
-	current_map_data_= map_data;
+		current_map_data_= map_data;
 
-	show_progress( 1.0f );
+		show_progress( 1.0f );
 
-	// Try load cutscene.
-	if( message.need_play_cutscene )
-	{
-		cutscene_player_.reset(
-			new CutscenePlayer(
-				game_resources_,
-				*map_loader_,
-				sound_engine_,
-				shared_drawers_,
-				*map_drawer_,
-				message.map_number ) );
+		// Try load cutscene.
+		if( message.need_play_cutscene )
+		{
+			CutsceneAssetsPtr cutscene_assets;
+			if( cutscene_assets_future_.valid() && cutscene_assets_map_number_ == message.map_number )
+				cutscene_assets= cutscene_assets_future_.get(); // Wait, if preloading is not finished yet.
+			else
+				cutscene_assets= LoadCutsceneAssets( game_resources_, *map_loader_, sound_engine_.get(), message.map_number );
 
-		if( cutscene_player_->IsFinished() ) // No cutscene for this map.
-			cutscene_player_= nullptr;
+			cutscene_player_.reset(
+				new CutscenePlayer(
+					game_resources_,
+					std::move(cutscene_assets),
+					sound_engine_,
+					shared_drawers_,
+					*map_drawer_ ) );
 
-		if( cutscene_player_ != nullptr && sound_engine_ != nullptr ) // Stop sound at cutscene start.
-			sound_engine_->SetMap( nullptr );
-	}
+			if( cutscene_player_->IsFinished() ) // No cutscene for this map.
+				cutscene_player_= nullptr;
 
-	// If no cutscene - set map for MapDrawer, MinimapDrawer, SoundEngine.
-	// Else - set map only after cutscene end.
-	if( cutscene_player_ == nullptr )
-	{
-		if( sound_engine_ != nullptr )
-			sound_engine_->SetMap( map_data );
+			if( cutscene_player_ != nullptr && sound_engine_ != nullptr ) // Stop sound at cutscene start.
+				sound_engine_->SetMap( nullptr );
+		}
+
+		// If no cutscene - set map for MapDrawer, MinimapDrawer, SoundEngine.
+		// Else - set map only after cutscene end.
+		if( cutscene_player_ == nullptr )
+		{
+			if( sound_engine_ != nullptr )
+				sound_engine_->SetMap( map_data );
 
-		map_drawer_->SetMap( map_data );
-		minimap_drawer_->SetMap( map_data );
+			map_drawer_->SetMap( map_data );
+			minimap_drawer_->SetMap( map_data );
+		}
+
+		PreloadNextMapCutscene( message.map_number );
 	}
+
+	// Apply initial state of map and other messages, received while loading.
+	// Deferred messages may contain next map change, which starts new loading, so, stop at it.
+	deferred_messages_.Process( *this, [this]{ return map_loading_future_.valid(); } );
 }
 
 void Client::operator()( const Messages::TextMessage& message )
@@ -662,6 +835,40 @@ void Client::operator()( const Messages::TextMessage& message )
 	}
 }
 
+void Client::PreloadNextMapCutscene( const unsigned int current_map_number )
+{
+	// Map end triggers change to next map only for first maps, like in server.
+	if( current_map_number >= 16u )
+		return;
+
+	const unsigned int next_map_number= map_loader_->GetNextMapInfo( current_map_number ).number;
+	if( next_map_number == cutscene_assets_map_number_ && cutscene_assets_future_.valid() )
+		return;
+
+	Log::Info( "Preloading cutscene for map ", next_map_number );
+
+	const GameResourcesConstPtr game_resources= game_resources_;
+	const MapLoaderPtr map_loader= map_loader_;
+	const Sound::SoundEnginePtr sound_engine= sound_engine_;
+
+	cutscene_assets_map_number_= next_map_number;
+	cutscene_assets_future_=
+		std::async(
+			std::launch::async,
+			[game_resources, map_loader, sound_engine, next_map_number]
+			{
+				return LoadCutsceneAssets( game_resources, *map_loader, sound_engine.get(), next_map_number );
+			} );
+}
+
+void Client::CancelMapLoading()
+{
+	// Wait for map loading and drop it. Messages of this map are not needed too.
+	if( map_loading_future_.valid() )
+		map_loading_future_.get();
+	deferred_messages_.Clear();
+}
+
 void Client::StopMap()
 {
 	if( current_map_data_ != nullptr && sound_engine_ != nullptr )
@@ -670,6 +877,7 @@ void Client::StopMap()
 	current_map_data_= nullptr;
 	map_state_= nullptr;
 	minimap_state_= nullptr;
+	movement_predictor_= nullptr;
 
 	cutscene_player_= nullptr;
 }
@@ -727,4 +935,29 @@ void Client::PrintPlayerPos()
 	Log::Info( "Pos: ", player_position_.x, ", ", player_position_.y, ", ", player_position_.z );
 }
 
+void Client::PrintRendererStats()
+{
+	std::vector<std::string> stats_lines;
+	map_drawer_->GetFrameStats( stats_lines );
+
+	if( stats_lines.empty() )
+		Log::Info( "No renderer stats" );
+	for( const std::string& line : stats_lines )
+		Log::Info( line );
+}
+
+void Client::PrintNetStats()
+{
+	if( connection_info_ == nullptr )
+	{
+		Log::Info( "Not connected" );
+		return;
+	}
+
+	std::vector<std::string> stats_lines;
+	net_statistics_.GetStatsLines( stats_lines, true );
+	for( const std::string& line : stats_lines )
+		Log::Info( line );
+}
+
 } // namespace PanzerChasm
@@ -1,13 +1,18 @@
 #pragma once
+#include <future>
+
 
 #include "../commands_processor.hpp"
 #include "../connection_info.hpp"
 #include "../loopback_buffer.hpp"
 #include "../rendering_context.hpp"
+#include "../settings.hpp"
 #include "../system_event.hpp"
+#include "deferred_messages.hpp"
 #include "map_state.hpp"
 #include "minimap_state.hpp"
 #include "movement_controller.hpp"
+#include "player_movement_predictor.hpp"
 #include "weapon_state.hpp"
 
 namespace PanzerChasm
@@ -33,11 +38,17 @@ public:
 	void VidClear();
 	void VidRestart( IDrawersFactory& drawers_factory );
 
+	// Recreate drawers for same window and rendering context, with new settings.
+	// HUD drawer is always recreated, minimap drawer is kept. Map drawer is kept, if "recreate_map_drawer" is false.
+	void RecreateDrawers( IDrawersFactory& drawers_factory, bool recreate_map_drawer );
+
 	void Save( SaveLoadBuffer& buffer, SaveComment& out_save_comment );
 	void Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos );
 
 	void SetConnection( IConnectionPtr connection );
 	bool Disconnected() const;
+	// Returns true, if map is received from server and game may be saved.
+	bool MapIsLoaded() const;
 	bool PlayingCutscene() const;
 
 	void ProcessEvents( const SystemEvents& events );
@@ -48,6 +59,30 @@ public:
 private:
 	struct LoadedMinimapState;
 
+	// Result of background map loading. Contains everything, which does not need drawers.
+	struct LoadedMap
+	{
+		MapDataConstPtr map_data; // Null, if map does not exist.
+		std::unique_ptr<MapState> map_state;
+		std::unique_ptr<MinimapState> minimap_state;
+		std::unique_ptr<PlayerMovementPredictor> movement_predictor;
+	};
+
+	// Passes messages to client or defers them, while map is loading.
+	struct MessagesRouter
+	{
+		Client& client;
+
+		template<class Message>
+		void operator()( const Message& message )
+		{
+			if( client.map_loading_future_.valid() )
+				client.deferred_messages_( message );
+			else
+				client( message );
+		}
+	};
+
 public: // Messages handlers
 
 	// Default handler for non-client messages.
@@ -79,6 +114,11 @@ public: // Messages handlers
 	void operator()( const Messages::TextMessage& message );
 
 private:
+	// Start background loading of cutscene assets of map, which follows given map.
+	void PreloadNextMapCutscene( unsigned int current_map_number );
+	// If background map loading is finished - set map and process messages, deferred while loading.
+	void TryFinishMapLoading();
+	void CancelMapLoading();
 	void StopMap();
 	void TrySwitchWeaponOnOutOfAmmo();
 	void TransmitPlayerName();
@@ -86,9 +126,17 @@ private:
 
 	void FullMap();
 	void PrintPlayerPos();
+	void PrintRendererStats();
+	void PrintNetStats();
 
 private:
 	Settings& settings_;
+	// Settings, which are read each frame.
+	const Settings::BoolHandle crosshair_setting_;
+	const Settings::BoolHandle small_hud_mode_setting_;
+	const Settings::BoolHandle draw_renderer_stats_setting_;
+	const Settings::BoolHandle draw_net_stats_setting_;
+
 	const GameResourcesConstPtr game_resources_;
 	const MapLoaderPtr map_loader_;
 	const Sound::SoundEnginePtr sound_engine_;
@@ -97,6 +145,7 @@ private:
 	CommandsMapConstPtr commands_;
 
 	std::unique_ptr<ConnectionInfo> connection_info_;
+	NetStatistics net_statistics_;
 
 	std::string player_name_;
 
@@ -112,6 +161,7 @@ private:
 	Messages::PlayerState player_state_;
 	Messages::ServerState server_state_;
 	unsigned int requested_weapon_index_= 0u;
+	unsigned short move_sequence_= 0u;
 	MovementController camera_controller_;
 	bool minimap_mode_= false;
 	bool full_map_= false;
@@ -123,14 +173,24 @@ private:
 	MapDataConstPtr current_map_data_;
 	std::unique_ptr<MapState> map_state_;
 	std::unique_ptr<MinimapState> minimap_state_;
+	std::unique_ptr<PlayerMovementPredictor> movement_predictor_; // Null, if prediction disabled.
 	std::unique_ptr<LoadedMinimapState> loaded_minimap_state_;
 
+	// Map is loaded in background after MapChange. All following messages are deferred until loading is finished.
+	std::future<LoadedMap> map_loading_future_;
+	Messages::MapChange map_loading_message_;
+	DeferredMessages deferred_messages_;
+
 	WeaponState weapon_state_;
 	bool shoot_pressed_= false;
 
 	IHudDrawerPtr hud_drawer_;
 
 	std::unique_ptr<CutscenePlayer> cutscene_player_;
+
+	// Assets of cutscene of next map, loaded in background, while current map is played.
+	std::future<CutsceneAssetsPtr> cutscene_assets_future_;
+	unsigned int cutscene_assets_map_number_= ~0u;
 };
 
 } // PanzerChasm
@@ -15,26 +15,27 @@ static const float g_cam_pos_scale= 0.5f;
 static const float g_cam_shift= 0.4f;
 static const float g_characters_cam_shift= -0.0f;
 
-CutscenePlayer::CutscenePlayer(
+CutsceneAssetsPtr LoadCutsceneAssets(
 	const GameResourcesConstPtr& game_resoruces,
 	MapLoader& map_loader,
-	const Sound::SoundEnginePtr& sound_engine,
-	const SharedDrawersPtr& shared_drawers,
-	IMapDrawer& map_drawer,
+	const Sound::SoundEngine* const sound_engine,
 	const unsigned int map_number )
-	: sound_engine_(sound_engine)
-	, shared_drawers_(shared_drawers)
-	, map_drawer_(map_drawer)
 {
 	const Vfs& vfs= *game_resoruces->vfs;
 
+	CutsceneScriptConstPtr script= LoadCutsceneScript( vfs, map_number );
+	if( script == nullptr )
+		return nullptr;
+
 	MapDataConstPtr map_data= map_loader.LoadMap( 99u );
 	if( map_data == nullptr )
-		return;
+		return nullptr;
 
-	script_= LoadCutsceneScript( vfs, map_number );
-	if( script_ == nullptr )
-		return;
+	CutsceneAssetsPtr assets( new CutsceneAssets );
+	assets->map_number= map_number;
+	assets->script= script;
+	assets->room_pos= m_Vec3( 0.0f, 0.0f, 0.0f );
+	assets->room_angle= 0.0f;
 
 	// Create old map data from new map data.
 	// Add to map characters as map models.
@@ -46,22 +47,18 @@ CutscenePlayer::CutscenePlayer(
 	{
 		if( monster.monster_id == 0u )
 		{
-			if( monster.difficulty_flags == script_->room_number )
+			if( monster.difficulty_flags == script->room_number )
 			{
-				room_pos_= m_Vec3( monster.pos, 0.0f );
-				room_angle_= monster.angle - Constants::half_pi;
+				assets->room_pos= m_Vec3( monster.pos, 0.0f );
+				assets->room_angle= monster.angle - Constants::half_pi;
 				break;
 			}
 		}
 	}
-	m_Mat4 translate_mat, room_mat;
-	room_rotation_matrix_.RotateZ( room_angle_ );
-	translate_mat.Translate( room_pos_ );
-	room_mat= room_rotation_matrix_ * translate_mat;
 
 	// Load characers.
-	first_character_model_index_= map_data_patched->models.size();
-	for( const CutsceneScript::Character& character : script_->characters )
+	assets->first_character_model_index= map_data_patched->models.size();
+	for( const CutsceneScript::Character& character : script->characters )
 	{
 		map_data_patched->models.emplace_back();
 		map_data_patched->models_description.emplace_back();
@@ -69,25 +66,24 @@ CutscenePlayer::CutscenePlayer(
 
 		{ // Load model and animations.
 
-			const Vfs::FileContent model_content= vfs.ReadFile( character.model_file_name );
+			const Vfs::MappedFile model_content= vfs.MapFile( character.model_file_name );
 			if( !model_content.empty() )
 			{
-				std::vector<Vfs::FileContent> animations_content;
+				std::vector<Vfs::MappedFile> animations_content;
 				// Animations.
 				for( unsigned int a= 0u; a < CutsceneScript::c_max_character_animations; a++ )
 				{
 					if( character.animations_file_name[a][0] == '\0' )
 						continue;
-					animations_content.emplace_back();
-					vfs.ReadFile( character.animations_file_name[a], animations_content.back() );
+					animations_content.push_back( vfs.MapFile( character.animations_file_name[a] ) );
 				}
 				// Idle animation.
-				animations_content.emplace_back();
-				vfs.ReadFile( character.idle_animation_file_name, animations_content.back() );
+				animations_content.push_back( vfs.MapFile( character.idle_animation_file_name ) );
 
+				const std::vector<Vfs::FileView> animations_views( animations_content.begin(), animations_content.end() );
 				LoadModel_o3(
 					model_content,
-					animations_content.data(), animations_content.size(),
+					animations_views.data(), animations_views.size(),
 					model );
 
 				const int c_inv_models_scale= 4;
@@ -102,12 +98,56 @@ CutscenePlayer::CutscenePlayer(
 					bbox.min/= float(c_inv_models_scale);
 					bbox.max/= float(c_inv_models_scale);
 				}
+				for( BoundingSphere& sphere : model.animations_bounding_spheres )
+				{
+					sphere.center/= float(c_inv_models_scale);
+					sphere.radius/= float(c_inv_models_scale);
+				}
+				model.bounding_sphere.center/= float(c_inv_models_scale);
+				model.bounding_sphere.radius/= float(c_inv_models_scale);
 			}
 		}
 	}
+	assets->map_data= map_data_patched;
+
+	// Load voices, so, playing of cutscene does not wait for disk.
+	if( sound_engine != nullptr )
+	{
+		for( const CutsceneScript::ActionCommand& command : script->commands )
+		{
+			if( command.type != CutsceneScript::ActionCommand::Type::Voice )
+				continue;
+
+			assets->voices.emplace_back( command.params[1], sound_engine->LoadOneTimeSound( command.params[1].c_str() ) );
+		}
+	}
+
+	return assets;
+}
+
+CutscenePlayer::CutscenePlayer(
+	const GameResourcesConstPtr& game_resoruces,
+	CutsceneAssetsPtr assets,
+	const Sound::SoundEnginePtr& sound_engine,
+	const SharedDrawersPtr& shared_drawers,
+	IMapDrawer& map_drawer )
+	: sound_engine_(sound_engine)
+	, shared_drawers_(shared_drawers)
+	, map_drawer_(map_drawer)
+	, assets_(std::move(assets))
+{
+	if( assets_ == nullptr )
+		return;
+
+	script_= assets_->script;
+	cutscene_map_data_= assets_->map_data;
+	first_character_model_index_= assets_->first_character_model_index;
+	room_pos_= assets_->room_pos;
+	room_angle_= assets_->room_angle;
 
-	cutscene_map_data_= map_data_patched;
-	const Time current_time= Time::CurrentTime();
+	room_rotation_matrix_.RotateZ( room_angle_ );
+
+	const Time current_time= Time::FrameTime();
 	map_state_.reset( new MapState( cutscene_map_data_, game_resoruces, current_time ) );
 	map_drawer.SetMap( cutscene_map_data_ );
 
@@ -138,7 +178,7 @@ void CutscenePlayer::Process( const SystemEvents& events )
 	if( script_ == nullptr )
 		return;
 
-	const Time current_time= Time::CurrentTime();
+	const Time current_time= Time::FrameTime();
 	map_state_->Tick( current_time );
 
 	if( IsFinished() )
@@ -250,7 +290,22 @@ void CutscenePlayer::Process( const SystemEvents& events )
 			break;
 		case CommandType::Voice:
 			if( sound_engine_ != nullptr )
-				sound_engine_->PlayOneTimeSound( command.params[1].c_str() );
+			{
+				Sound::ISoundDataConstPtr voice;
+				for( auto& preloaded_voice : assets_->voices )
+				{
+					if( preloaded_voice.second != nullptr && preloaded_voice.first == command.params[1] )
+					{
+						voice= std::move( preloaded_voice.second );
+						break;
+					}
+				}
+
+				if( voice != nullptr )
+					sound_engine_->PlayOneTimeSound( std::move(voice) );
+				else
+					sound_engine_->PlayOneTimeSound( command.params[1].c_str() );
+			}
 			break;
 
 		case CommandType::Setani:
@@ -1,7 +1,12 @@
 #pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <matrix.hpp>
 
 #include "../fwd.hpp"
+#include "../sound/sounds_loader.hpp"
 #include "../system_event.hpp"
 #include "../time.hpp"
 #include "cutscene_script.hpp"
@@ -11,16 +16,41 @@
 namespace PanzerChasm
 {
 
+// Data of cutscene, which can be loaded in background, before cutscene start.
+struct CutsceneAssets
+{
+	unsigned int map_number;
+	CutsceneScriptConstPtr script;
+
+	// Cutscenes room map with characters models, added to map models.
+	MapDataConstPtr map_data;
+	unsigned int first_character_model_index;
+
+	m_Vec3 room_pos;
+	float room_angle;
+
+	// Voices of "Voice" commands. Sound data is moved out, when voice starts playing.
+	std::vector< std::pair< std::string, Sound::ISoundDataConstPtr > > voices;
+};
+
+// Returns null, if there is no cutscene for given map.
+// May be called from any thread, except of sound engine usage - sounds may be loaded in any thread, but not played.
+CutsceneAssetsPtr LoadCutsceneAssets(
+	const GameResourcesConstPtr& game_resoruces,
+	MapLoader& map_loader,
+	const Sound::SoundEngine* sound_engine,
+	unsigned int map_number );
+
 class CutscenePlayer final
 {
 public:
+	// If assets are null - cutscene is finished immediately.
 	CutscenePlayer(
 		const GameResourcesConstPtr& game_resoruces,
-		MapLoader& map_loader,
+		CutsceneAssetsPtr assets,
 		const Sound::SoundEnginePtr& sound_engine,
 		const SharedDrawersPtr& shared_drawers,
-		IMapDrawer& map_drawer,
-		unsigned int map_number );
+		IMapDrawer& map_drawer );
 	~CutscenePlayer();
 
 	void Process( const SystemEvents& events );
@@ -48,6 +78,7 @@ private:
 	MapDataConstPtr cutscene_map_data_;
 	std::unique_ptr<MapState> map_state_;
 	CutsceneScriptConstPtr script_;
+	CutsceneAssetsPtr assets_;
 
 	unsigned int first_character_model_index_;
 	std::vector<CharacterState> characters_;
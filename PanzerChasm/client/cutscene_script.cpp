@@ -1,45 +1,59 @@
-#include <cctype>
 #include <cstring>
 
 #include "../math_utils.hpp"
+#include "../text_tokenizer.hpp"
 
 #include "cutscene_script.hpp"
 
 namespace PanzerChasm
 {
 
-static void LoadSetupData( const Vfs::FileContent& file_content, CutsceneScript& script )
+// Returns empty span, if there is no section.
+static TextSpan GetSection( const TextSpan& text, const char* const section_name, const char* const section_end_marker )
 {
-	const char* const setup= std::strstr( reinterpret_cast<const char*>(file_content.data()), "#setup" );
-	const char* const setup_end= std::strstr( setup + std::strlen("#setup"), "#" );
+	const char* const section= text.Find( section_name );
+	if( section == nullptr )
+		return TextSpan();
 
-	std::istringstream stream( std::string( setup + std::strlen("#setup"), setup_end ) );
+	const TextSpan rest( section + std::strlen( section_name ), text.end );
+	const char* const section_end= rest.Find( section_end_marker );
+	return TextSpan( rest.begin, section_end == nullptr ? text.end : section_end );
+}
+
+static void LoadSetupData( const TextSpan& text, CutsceneScript& script )
+{
+	TextTokenizer tokenizer( GetSection( text, "#setup", "#" ) );
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512u ];
-		stream.getline( line, sizeof(line), '\n' );
-		if( stream.eof() )
-			break;
+		const TextSpan line= tokenizer.GetLine();
 
-		if( std::strncmp( line, "camera:", std::strlen( "camera:" ) ) == 0 )
+		if( line.StartsWith( "camera:" ) )
 		{
-			std::istringstream line_stream( std::string( line + std::strlen( "camera:" ) ) );
-			line_stream >> script.camera_params.pos.x;
-			line_stream >> script.camera_params.pos.y;
-			line_stream >> script.camera_params.pos.z;
-			line_stream >> script.camera_params.angle;
+			TextTokenizer line_tokenizer( TextSpan( line.begin + std::strlen( "camera:" ), line.end ) );
+			line_tokenizer.NextLine();
+			line_tokenizer.ReadNumber( script.camera_params.pos.x );
+			line_tokenizer.ReadNumber( script.camera_params.pos.y );
+			line_tokenizer.ReadNumber( script.camera_params.pos.z );
+			line_tokenizer.ReadNumber( script.camera_params.angle );
 
 			script.camera_params.pos/= 64.0f;
 			script.camera_params.angle*= Constants::to_rad;
 		}
-		else if( std::strncmp( line, "ambient:", std::strlen( "ambient:" ) ) == 0 )
-			script.ambient_sound_number= std::atoi( line + std::strlen( "ambient:" ) );
-		else if( std::strncmp( line, "room:", std::strlen( "room:" ) ) == 0 )
-			script.room_number= std::atoi( line + std::strlen( "room:" ) );
-		else if( std::strncmp( line, "character", std::strlen( "character" ) ) == 0 )
+		else if( line.StartsWith( "ambient:" ) )
+		{
+			script.ambient_sound_number= 0u;
+			TextSpan( line.begin + std::strlen( "ambient:" ), line.end ).TrimSpaces().ToNumber( script.ambient_sound_number );
+		}
+		else if( line.StartsWith( "room:" ) )
+		{
+			script.room_number= 0u;
+			TextSpan( line.begin + std::strlen( "room:" ), line.end ).TrimSpaces().ToNumber( script.room_number );
+		}
+		else if( line.StartsWith( "character" ) )
 		{
-			const unsigned int character_number= std::atoi( line + std::strlen( "character" ) );
+			unsigned int character_number= 0u;
+			TextSpan( line.begin + std::strlen( "character" ), line.end ).TrimSpaces().ToNumber( character_number );
 			if( character_number >= script.characters.size() )
 				script.characters.resize( character_number + 1u );
 
@@ -48,90 +62,73 @@ static void LoadSetupData( const Vfs::FileContent& file_content, CutsceneScript&
 			std::memset( character.idle_animation_file_name, 0, sizeof( character.idle_animation_file_name ) );
 			std::memset( character.animations_file_name, 0, sizeof( character.animations_file_name ) );
 
-			while( !stream.eof() )
+			while( tokenizer.NextLine() )
 			{
-				char character_line[ 512u ];
-				stream.getline( character_line, sizeof(character_line), '\n' );
-				if( stream.eof() )
-					break;
+				const TextSpan line_start= tokenizer.NextToken();
 
-				std::istringstream line_stream{ std::string( character_line ) };
-				char line_start[ 64 ];
-				line_stream >> line_start;
-
-				if( std::strcmp( line_start, "model" ) == 0 )
+				if( line_start.Equals( "model" ) )
 				{
-					line_stream >> character.model_file_name;
+					tokenizer.NextToken().CopyTo( character.model_file_name, sizeof(character.model_file_name) );
 				}
-				else if( std::strcmp( line_start, "position" ) == 0 )
+				else if( line_start.Equals( "position" ) )
 				{
-					line_stream >> character.pos.x;
-					line_stream >> character.pos.y;
-					line_stream >> character.pos.z;
-					line_stream >> character.angle;
+					tokenizer.ReadNumber( character.pos.x );
+					tokenizer.ReadNumber( character.pos.y );
+					tokenizer.ReadNumber( character.pos.z );
+					tokenizer.ReadNumber( character.angle );
 
 					character.pos.x/= 1.5f * 128.0f;
 					character.pos.y/= 1.5f * 128.0f;
 					character.pos.z/= 1.5f * 4096.0f; // TODO - calibrate z
 					character.angle*= Constants::to_rad;
 				}
-				else if( std::strcmp( line_start, "idle" ) == 0 )
+				else if( line_start.Equals( "idle" ) )
 				{
-					int num;
-					line_stream >> num;
-					line_stream >> character.idle_animation_file_name;
+					tokenizer.NextToken(); // Number
+					tokenizer.NextToken().CopyTo( character.idle_animation_file_name, sizeof(character.idle_animation_file_name) );
 				}
-				else if( std::strcmp( line_start, "ani" ) == 0 )
+				else if( line_start.Equals( "ani" ) )
 				{
 					unsigned int animation_number;
-					line_stream >> animation_number;
-
-					if( animation_number < CutsceneScript::c_max_character_animations )
-						line_stream >> character.animations_file_name[ animation_number ];
+					if( tokenizer.ReadNumber( animation_number ) &&
+						animation_number < CutsceneScript::c_max_character_animations )
+						tokenizer.NextToken().CopyTo(
+							character.animations_file_name[ animation_number ],
+							sizeof(character.animations_file_name[ animation_number ]) );
 				}
-				else if( std::strncmp( line_start, "end", std::strlen( "end" ) ) == 0 )
+				else if( line_start.StartsWith( "end" ) )
 					break;
 			}
 		}
 	} // while stream not ended
 }
 
-static void LoadAction( const Vfs::FileContent& file_content, CutsceneScript& script )
+static void LoadAction( const TextSpan& text, CutsceneScript& script )
 {
-	const char* const action= std::strstr( reinterpret_cast<const char*>(file_content.data()), "#action" );
-	const char* const action_end= std::strstr( action + std::strlen("#action"), "#end" );
+	TextTokenizer tokenizer( GetSection( text, "#action", "#end" ) );
 
-	std::istringstream stream( std::string( action + std::strlen("#action"), action_end ) );
-
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512u ];
-		stream.getline( line, sizeof(line), '\n' );
-		if( stream.eof() )
-			break;
-
-		if( line[0] == ';' ) // comment
+		if( !tokenizer.GetLine().empty() && tokenizer.GetLine().begin[0] == ';' ) // comment
 			continue;
 
-		std::istringstream line_stream{ std::string( line ) };
-		char line_start[ 64 ];
-		line_stream >> line_start;
-		if( line_stream.fail() )
+		const TextSpan line_start= tokenizer.NextToken();
+		if( line_start.empty() )
 			continue;
 
 		CutsceneScript::ActionCommand::Type command_type= CutsceneScript::ActionCommand::Type::None;
 
-		if( std::strcmp( line_start, "delay" ) == 0 )
+		if( line_start.Equals( "delay" ) )
 			command_type= CutsceneScript::ActionCommand::Type::Delay;
-		else if( std::strcmp( line_start, "say" ) == 0 )
+		else if( line_start.Equals( "say" ) )
 			command_type= CutsceneScript::ActionCommand::Type::Say;
-		else if( std::strcmp( line_start, "voice" ) == 0 )
+		else if( line_start.Equals( "voice" ) )
 			command_type= CutsceneScript::ActionCommand::Type::Voice;
-		else if( std::strcmp( line_start, "setani" ) == 0 )
+		else if( line_start.Equals( "setani" ) )
 			command_type= CutsceneScript::ActionCommand::Type::Setani;
-		else if( std::strcmp( line_start, "wait_key" ) == 0 )
+		else if( line_start.Equals( "wait_key" ) )
 			command_type= CutsceneScript::ActionCommand::Type::WaitKey;
-		else if( std::strcmp( line_start, "movecamto" ) == 0 )
+		else if( line_start.Equals( "movecamto" ) )
 			command_type= CutsceneScript::ActionCommand::Type::MoveCamTo;
 
 		if( command_type != CutsceneScript::ActionCommand::Type::None )
@@ -145,27 +142,26 @@ static void LoadAction( const Vfs::FileContent& file_content, CutsceneScript& sc
 			{
 				std::string& out_param= command.params[i];
 
-				char text_line[512];
-				line_stream >> text_line;
-				if (text_line[0] == '"' )
+				const TextSpan param= tokenizer.NextToken();
+				if( param.empty() )
+					break;
+
+				if( param.begin[0] == '"' )
 				{
-					if( std::strcmp( text_line, "\"\"" ) != 0 )
+					if( !param.Equals( "\"\"" ) )
 					{
 						// Read line in ""
-						const int len= std::strlen(text_line);
-						line_stream.getline( text_line + len, sizeof(text_line) - len, '\n' );
+						const TextSpan rest= tokenizer.RestOfLine();
+						TextSpan text_line( param.begin + 1, rest.empty() ? param.end : rest.end );
+						if( !text_line.empty() && text_line.end[-1] == '"' )
+							text_line.end--;
 
-						out_param= text_line + 1u;
-						while( !out_param.empty() && std::isspace( out_param.back() ) ) out_param.pop_back();
-						if( out_param.back() == '"' ) out_param.pop_back();
+						out_param.assign( text_line.begin, text_line.end );
 					}
 					break;
 				}
 				else
-					out_param= text_line;
-
-				if( line_stream.fail() )
-					break;
+					out_param.assign( param.begin, param.end );
 			}
 		}
 	}
@@ -188,8 +184,10 @@ CutsceneScriptPtr LoadCutsceneScript( const Vfs& vfs, unsigned int map_number )
 
 	CutsceneScriptPtr result= std::make_shared<CutsceneScript>();
 
-	LoadSetupData( file_content, *result );
-	LoadAction( file_content, *result );
+	const char* const text_start= reinterpret_cast<const char*>( file_content.data() );
+	const TextSpan text( text_start, text_start + file_content.size() );
+	LoadSetupData( text, *result );
+	LoadAction( text, *result );
 
 	return result;
 }
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstring>
+#include <vector>
+
+#include "../assert.hpp"
+#include "../messages.hpp"
+
+namespace PanzerChasm
+{
+
+// Storage for decoded messages, which can not be processed now.
+// Messages are stored one after another, together with their ids, and later are passed to handler in same order.
+class DeferredMessages final
+{
+public:
+	template<class Message>
+	void operator()( const Message& message )
+	{
+		const size_t offset= data_.size();
+		data_.resize( offset + sizeof(Message) );
+		std::memcpy( data_.data() + offset, &message, sizeof(Message) );
+	}
+
+	bool Empty() const
+	{
+		return read_pos_ == data_.size();
+	}
+
+	void Clear()
+	{
+		data_.clear();
+		read_pos_= 0u;
+	}
+
+	// Passes messages to handler, until "stop" returns true. Rest of messages stays for next call.
+	// Handler must not add new messages into this storage.
+	template<class MessagesHandler, class StopPredicate>
+	void Process( MessagesHandler& messages_handler, const StopPredicate& stop )
+	{
+		while( read_pos_ < data_.size() && !stop() )
+		{
+			const unsigned char* const message_data= data_.data() + read_pos_;
+
+			MessageId message_id;
+			std::memcpy( &message_id, message_data, sizeof(MessageId) );
+
+			switch( message_id )
+			{
+			#define MESSAGE_FUNC(x)\
+			case MessageId::x:\
+				{\
+					Messages::x message;\
+					std::memcpy( &message, message_data, sizeof(Messages::x) );\
+					read_pos_+= sizeof(Messages::x);\
+					messages_handler( message );\
+				}\
+				break;
+			#include "../messages_list.h"
+			#undef MESSAGE_FUNC
+
+			case MessageId::Unknown:
+			case MessageId::NumMessages:
+				PC_ASSERT( false );
+				Clear();
+				return;
+			};
+		}
+
+		if( Empty() )
+			Clear();
+	}
+
+private:
+	std::vector<unsigned char> data_;
+	size_t read_pos_= 0u;
+};
+
+} // namespace PanzerChasm
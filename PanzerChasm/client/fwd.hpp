@@ -11,6 +11,8 @@ struct WeaponState;
 struct MapBSPTree;
 
 class CutscenePlayer;
+struct CutsceneAssets;
+typedef std::unique_ptr<CutsceneAssets> CutsceneAssetsPtr;
 class MovementController;
 
 } // namespace PanzerChasm
@@ -8,6 +8,7 @@
 #include "../images.hpp"
 #include "../i_menu_drawer.hpp"
 #include "../i_text_drawer.hpp"
+#include "../profiler.hpp"
 #include "../settings.hpp"
 #include "../shared_drawers.hpp"
 #include "../shared_settings_keys.hpp"
@@ -33,11 +34,15 @@ HudDrawerGL::HudDrawerGL(
 	Settings& settings,
 	const GameResourcesConstPtr& game_resources,
 	const RenderingContextGL& rendering_context,
-	const SharedDrawersPtr& shared_drawers )
+	const SharedDrawersPtr& shared_drawers,
+	const QuadsBatcherGLPtr& quads_batcher )
 	: HudDrawerBase( game_resources, shared_drawers )
 	, viewport_size_( rendering_context.viewport_size )
 	, filter_textures_( settings.GetOrSetBool( SettingsKeys::opengl_hud_textures_filtering, false ) )
+	, quads_batcher_( quads_batcher )
 {
+	PC_ASSERT( quads_batcher_ != nullptr );
+
 	{ // Crosshair texture
 		unsigned int size[2];
 		std::vector<unsigned char> data, data_rgba;
@@ -70,37 +75,6 @@ HudDrawerGL::HudDrawerGL(
 	LoadTexture( c_hud_background_image_file_name, 0u, hud_background_texture_ );
 	LoadTexture( c_netgame_score_numbers_image_file_name, 0u, netgame_scrore_numbers_texture_ );
 
-	{ // Vertex buffer
-		unsigned short  indeces[ g_max_hud_quads * 6u ];
-		for( unsigned int i= 0u; i < g_max_hud_quads; i++ )
-		{
-			unsigned short* const ind= indeces + 6u * i;
-			ind[0]= 4u * i + 0u;  ind[1]= 4u * i + 1u;  ind[2]= 4u * i + 2u;
-			ind[3]= 4u * i + 0u;  ind[4]= 4u * i + 2u;  ind[5]= 4u * i + 3u;
-		}
-
-		quad_buffer_.VertexData(
-			nullptr,
-			g_max_hud_quads * 4u * sizeof(Vertex),
-			sizeof(Vertex) );
-
-		quad_buffer_.IndexData(
-			indeces,
-			sizeof(indeces),
-			GL_UNSIGNED_SHORT,
-			GL_TRIANGLES );
-
-		Vertex v;
-		quad_buffer_.VertexAttribPointer(
-			0,
-			2, GL_SHORT, false,
-			((char*)v.xy) - (char*)&v );
-		quad_buffer_.VertexAttribPointer(
-			1,
-			2, GL_SHORT, false,
-			((char*)v.tex_coord) - (char*)&v );
-	}
-
 	hud_shader_.ShaderSource(
 		rLoadShader( "hud_f.glsl", rendering_context.glsl_version ),
 		rLoadShader( "hud_v.glsl", rendering_context.glsl_version ) );
@@ -114,8 +88,7 @@ HudDrawerGL::~HudDrawerGL()
 
 void HudDrawerGL::DrawCrosshair()
 {
-	Vertex vertices[ g_max_hud_quads * 4u ];
-	Vertex* v= vertices;
+	Vertex* const v= quads_batcher_->AddQuads( crosshair_texture_, 1u );
 
 	const Size2 viewport_center( viewport_size_.xy[0] >> 1u, viewport_size_.xy[1] >> 1u );
 
@@ -141,31 +114,8 @@ void HudDrawerGL::DrawCrosshair()
 	v[3].xy[1]= v[0].xy[1] + int( scale_ * crosshair_texture_.Height() );
 	v[3].tex_coord[0]= 0;
 	v[3].tex_coord[1]= int( crosshair_texture_.Height() );
-	v+= 4u;
-
-	const unsigned int vertex_count= ( v - vertices );
-	const unsigned int index_count= vertex_count / 4u * 6u;
 
-	quad_buffer_.VertexSubData( vertices, vertex_count * sizeof(Vertex), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_crosshair_gl_state );
-	hud_shader_.Bind();
-
-	crosshair_texture_.Bind(0u);
-	hud_shader_.Uniform( "tex", int(0) );
-
-	hud_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	hud_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(crosshair_texture_.Width ()),
-			1.0f / float(crosshair_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( hud_shader_, g_crosshair_gl_state );
 }
 
 void HudDrawerGL::DrawHud(
@@ -173,6 +123,8 @@ void HudDrawerGL::DrawHud(
 	const char* const map_name,
 	const NetgameScores* const netgame_scores )
 {
+	PC_PROFILE_SCOPE( "HudDrawerGL::DrawHud" );
+
 	Vertex vertices[ g_max_hud_quads * 4u ];
 	Vertex* v= vertices;
 
@@ -391,45 +343,30 @@ void HudDrawerGL::DrawHud(
 
 	const unsigned int numbers_quad_count= ( v - vertices ) / 4u - numbers_first_quad;
 
-	quad_buffer_.VertexSubData( vertices, ( v - vertices ) * sizeof(Vertex), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_hud_gl_state );
-	hud_shader_.Bind();
-	hud_shader_.Uniform( "tex", int(0) );
-	hud_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	const auto draw_quads=
+	// Background must be drawn first, other elements are grouped by texture.
+	const auto add_quads=
 	[&]( const r_Texture& texture, const unsigned int first_quad, const unsigned int quad_count )
 	{
 		if( quad_count == 0u )
 			return;
 
-		texture.Bind(0u);
-		hud_shader_.Uniform(
-			"inv_texture_size",
-			 m_Vec2(
-				1.0f / float(texture.Width ()),
-				1.0f / float(texture.Height()) ) );
-
-		glDrawElements(
-			GL_TRIANGLES,
-			quad_count * 6u,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_quad * 6u * sizeof(unsigned short) ) );
+		std::memcpy(
+			quads_batcher_->AddQuads( texture, quad_count ),
+			vertices + first_quad * 4u,
+			quad_count * 4u * sizeof(Vertex) );
 	};
 
-	draw_quads( hud_background_texture_, first_hud_bg_quad, hud_bg_quad_count );
-	draw_quads( weapon_icons_texture_, weapon_icon_first_quad, weapon_icon_quad_count );
-	draw_quads( hud_numbers_texture_, numbers_first_quad, numbers_quad_count );
+	add_quads( hud_background_texture_, first_hud_bg_quad, hud_bg_quad_count );
+	add_quads( weapon_icons_texture_, weapon_icon_first_quad, weapon_icon_quad_count );
+	add_quads( hud_numbers_texture_, numbers_first_quad, numbers_quad_count );
 	if( netgame_scores != nullptr )
 	{
-		draw_quads( netgame_score_background_texture_, c_first_netgame_score_background_quad, netgame_scores->score_count );
-		draw_quads( netgame_scrore_numbers_texture_, fisrst_netgame_score_number_quad, netgame_score_number_quad_count );
+		add_quads( netgame_score_background_texture_, c_first_netgame_score_background_quad, netgame_scores->score_count );
+		add_quads( netgame_scrore_numbers_texture_, fisrst_netgame_score_number_quad, netgame_score_number_quad_count );
 	}
 
+	quads_batcher_->Flush( hud_shader_, g_hud_gl_state );
+
 	if( draw_second_hud )
 		HudDrawerBase::DrawKeysAndStat( hud_x, map_name );
 }
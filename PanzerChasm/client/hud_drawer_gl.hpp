@@ -1,10 +1,10 @@
 #pragma once
 
-#include <glsl_program.hpp>
-#include <polygon_buffer.hpp>
 #include <texture.hpp>
 
+#include "../quads_batcher_gl.hpp"
 #include "../rendering_context.hpp"
+#include "../shader_program_gl.hpp"
 #include "hud_drawer_base.hpp"
 
 namespace PanzerChasm
@@ -17,7 +17,8 @@ public:
 		Settings& settings,
 		const GameResourcesConstPtr& game_resources,
 		const RenderingContextGL& rendering_context,
-		const SharedDrawersPtr& shared_drawers );
+		const SharedDrawersPtr& shared_drawers,
+		const QuadsBatcherGLPtr& quads_batcher );
 	virtual ~HudDrawerGL() override;
 
 	virtual void DrawCrosshair() override;
@@ -27,11 +28,7 @@ public:
 		const NetgameScores* netgame_scores ) override;
 
 private:
-	struct Vertex
-	{
-		short xy[2];
-		short tex_coord[2];
-	};
+	typedef QuadsBatcherGL::Vertex Vertex;
 
 private:
 	void LoadTexture( const char* file_name, unsigned char alpha_color_index, r_Texture& out_texture );
@@ -40,8 +37,8 @@ private:
 	const Size2 viewport_size_;
 	const bool filter_textures_;
 
-	r_GLSLProgram hud_shader_;
-	r_PolygonBuffer quad_buffer_;
+	ShaderProgramGL hud_shader_;
+	const QuadsBatcherGLPtr quads_batcher_;
 
 	r_Texture crosshair_texture_;
 	r_Texture weapon_icons_texture_;
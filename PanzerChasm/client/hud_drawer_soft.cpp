@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cstring>
 
 #include "../assert.hpp"
+#include "../profiler.hpp"
 
 #include "hud_drawer_soft.hpp"
 
@@ -34,6 +36,17 @@ HudDrawerSoft::HudDrawerSoft(
 
 	for( unsigned char& color_index : netgame_scrore_numbers_image_.data )
 		if( color_index == 0u ) color_index= 255u;
+
+	// Calculate height of hud layer - maximum height of all hud elements.
+	const unsigned int layer_lines=
+		std::max(
+			std::max(
+				c_hud_line_height + c_net_hud_line_height,
+				c_hud_line_height + netgame_score_background_image_.size[1] + 2u ),
+			std::max(
+				c_hud_line_height + netgame_scrore_numbers_image_.size[1] + c_netgame_score_number_y_offset,
+				weapon_icons_image_.size[1] + c_weapon_icon_y_offset ) );
+	hud_layer_height_= std::min( layer_lines * scale_, rendering_context_.viewport_size.Height() );
 }
 
 HudDrawerSoft::~HudDrawerSoft()
@@ -73,12 +86,48 @@ void HudDrawerSoft::DrawHud(
 	const bool draw_second_hud,
 	const char* const map_name,
 	const NetgameScores* const netgame_scores )
+{
+	PC_PROFILE_SCOPE( "HudDrawerSoft::DrawHud" );
+
+	const Size2& viewport_size= rendering_context_.viewport_size;
+
+	// Hud images change rarely, so, redraw it into layer only if hud state changed.
+	HudLayerState state;
+	std::memset( &state, 0, sizeof(state) );
+	state.draw_second_hud= draw_second_hud;
+	state.has_netgame_scores= netgame_scores != nullptr;
+	if( netgame_scores != nullptr )
+		state.netgame_scores= *netgame_scores;
+	state.weapon_number= current_weapon_number_;
+	state.health= player_state_.health;
+	state.armor= player_state_.armor;
+	state.ammo= player_state_.ammo[ current_weapon_number_ ];
+
+	if( hud_layer_.GetSizeX() == 0u || std::memcmp( &state, &hud_layer_state_, sizeof(HudLayerState) ) != 0 )
+	{
+		DrawHudLayer( draw_second_hud, netgame_scores );
+		std::memcpy( &hud_layer_state_, &state, sizeof(HudLayerState) );
+	}
+
+	hud_layer_.Draw( rendering_context_, 0, int( viewport_size.Height() - hud_layer_height_ ) );
+
+	if( draw_second_hud )
+	{
+		const unsigned int hud_x= viewport_size.Width() / 2u - hud_background_image_.size[0] * scale_ / 2u;
+		HudDrawerBase::DrawKeysAndStat( hud_x, map_name );
+	}
+}
+
+void HudDrawerSoft::DrawHudLayer( const bool draw_second_hud, const NetgameScores* const netgame_scores )
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
-	uint32_t* const dst_pixels= rendering_context_.window_surface_data;
-	const int dst_row_pixels= rendering_context_.row_pixels;
 	const Size2& viewport_size= rendering_context_.viewport_size;
 
+	hud_layer_.Reset( viewport_size.Width(), hud_layer_height_ );
+	uint32_t* const dst_pixels= hud_layer_.GetPixels();
+	const int dst_row_pixels= hud_layer_.GetSizeX();
+	const unsigned int layer_y= viewport_size.Height() - hud_layer_height_;
+
 	const auto draw_image=
 	[&]( const unsigned int x_start, const unsigned int y_start,
 		const unsigned char* const img_data, const unsigned int img_data_width,
@@ -95,8 +144,8 @@ void HudDrawerSoft::DrawHud(
 
 			for( unsigned int dy= 0u; dy < scale_; dy++ )
 			{
-				const unsigned int dst_y= y_start + y * scale_ + dy;
-				PC_ASSERT( dst_y < viewport_size.Height() );
+				const unsigned int dst_y= y_start + y * scale_ + dy - layer_y;
+				PC_ASSERT( dst_y < hud_layer_height_ );
 				for( unsigned int dx= 0u; dx < scale_; dx++ )
 				{
 					const unsigned int dst_x= x_start + x * scale_ + dx;
@@ -207,8 +256,7 @@ void HudDrawerSoft::DrawHud(
 		draw_number( hud_x + scale_ * c_armor_x_offset, player_state_.armor, c_armor_red_value );
 	}
 
-	if( draw_second_hud )
-		HudDrawerBase::DrawKeysAndStat( hud_x, map_name );
+	hud_layer_.BuildSpans();
 }
 
 void HudDrawerSoft::LoadImage( const char* const file_name, Image& out_image )
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../rendering_context.hpp"
+#include "../retained_layer_soft.hpp"
 #include "hud_drawer_base.hpp"
 
 namespace PanzerChasm
@@ -28,8 +29,21 @@ private:
 		std::vector<unsigned char> data; // color-indexed.
 	};
 
+	// All parameters, which affect hud layer content.
+	struct HudLayerState
+	{
+		NetgameScores netgame_scores;
+		unsigned int weapon_number;
+		bool draw_second_hud;
+		bool has_netgame_scores;
+		unsigned char health;
+		unsigned char armor;
+		unsigned char ammo;
+	};
+
 private:
 	void LoadImage( const char* file_name, Image& out_image );
+	void DrawHudLayer( bool draw_second_hud, const NetgameScores* netgame_scores );
 
 private:
 	const RenderingContextSoft& rendering_context_;
@@ -40,6 +54,10 @@ private:
 	Image hud_background_image_;
 	Image netgame_score_background_image_;
 	Image netgame_scrore_numbers_image_;
+
+	RetainedLayerSoft hud_layer_;
+	unsigned int hud_layer_height_= 0u;
+	HudLayerState hud_layer_state_;
 };
 
 } // namespace PanzerChasm
@@ -1,5 +1,7 @@
 #pragma once
 #include <array>
+#include <string>
+#include <vector>
 
 #include <matrix.hpp>
 #include <plane.hpp>
@@ -59,6 +61,9 @@ public:
 		const m_Mat4& view_rotation_and_projection_matrix,
 		const m_Vec3& camera_position,
 		const ViewClipPlanes& view_clip_planes )= 0;
+
+	// Get human-readable statistics of last frame drawing. Output may be empty.
+	virtual void GetFrameStats( std::vector<std::string>& out_lines ) const= 0;
 };
 
 } // namespace PanzerChasm
@@ -1,5 +1,11 @@
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <initializer_list>
+#include <utility>
 
 #include <ogl_state_manager.hpp>
 
@@ -8,11 +14,16 @@
 #include "../images.hpp"
 #include "../log.hpp"
 #include "../map_loader.hpp"
+#include "../save_load.hpp"
 #include "../math_utils.hpp"
+#include "../profiler.hpp"
 #include "../settings.hpp"
 #include "../shared_settings_keys.hpp"
 #include  "opengl_renderer/models_textures_corrector.hpp"
+#include "opengl_renderer/texture_compression.hpp"
+#include "opengl_renderer/textures_disk_cache.hpp"
 #include "map_drawers_common.hpp"
+#include "models_conversion_cache.hpp"
 #include "weapon_state.hpp"
 
 #include "map_drawer_gl.hpp"
@@ -25,6 +36,58 @@ namespace
 
 constexpr float g_walls_coords_scale= 256.0f;
 
+// Static walls are grouped into square chunks of map cells for culling.
+constexpr unsigned int g_walls_chunk_size_log2= 3u;
+constexpr unsigned int g_walls_chunks_per_side= MapData::c_map_size >> g_walls_chunk_size_log2;
+
+// Per-instance attributes of instanced models shaders go after per-vertex attributes.
+// Each matrix column takes separate attribute location.
+constexpr GLuint g_instance_model_matrix_attrib= 5u;
+constexpr GLuint g_instance_rotation_matrix_attrib= 9u;
+constexpr GLuint g_instance_lightmap_matrix_attrib= 12u;
+constexpr GLuint g_instance_params_attrib= 15u;
+
+// Sprites have no per-vertex attributes, but per-instance attributes are set for currently bound vertex array object.
+// So, use same free locations, as for models.
+constexpr GLuint g_sprite_instance_model_matrix_attrib= 5u;
+constexpr GLuint g_sprite_instance_params_attrib= 9u;
+constexpr GLuint g_sprite_instance_tex_coord_scale_attrib= 10u;
+
+// Binding point of "ViewParams" uniform block (see "view_params.glsl").
+constexpr GLuint g_view_params_uniform_block_binding= 0u;
+
+// Passes, measured by GPU profiler.
+enum GPUPass : unsigned int
+{
+	GPUPassLightUpdate,
+	GPUPassWalls,
+	GPUPassFloors,
+	GPUPassModels,
+	GPUPassMonsters,
+	GPUPassSky,
+	GPUPassShadows,
+	GPUPassSprites,
+	GPUPassFullscreenBlend,
+	GPUPassOcclusionTests,
+};
+
+// Keys of objects in occlusion culler.
+uint32_t GetMonsterOcclusionKey( const EntityId monster_id )
+{
+	return ( 1u << 24u ) | uint32_t(monster_id);
+}
+
+uint32_t GetItemOcclusionKey( const unsigned int item_index )
+{
+	return ( 2u << 24u ) | item_index;
+}
+
+// Distance from camera plane - "w" of projected point.
+float GetViewDepth( const m_Mat4& view_matrix, const m_Vec3& pos )
+{
+	return pos.x * view_matrix.value[3] + pos.y * view_matrix.value[7] + pos.z * view_matrix.value[11] + view_matrix.value[15];
+}
+
 const GLenum g_gl_state_blend_func[2]= { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
 
 // Draw static walls with back-faces culling.
@@ -58,9 +121,14 @@ const r_OGLState g_sprites_gl_state(
 	true, false, true, false,
 	g_gl_state_blend_func );
 
+// Sky is on far plane, so, depth writes are not needed.
 const r_OGLState g_sky_gl_state(
 	false, false, true, false,
-	g_gl_state_blend_func );
+	g_gl_state_blend_func,
+	r_OGLState::default_clear_color,
+	r_OGLState::default_clear_depth,
+	r_OGLState::default_cull_face_mode,
+	false );
 
 const r_OGLState g_shadows_gl_state(
 	true, true, true, false,
@@ -78,6 +146,33 @@ const r_OGLState g_fullscreen_blend_state(
 	r_OGLState::default_cull_face_mode,
 	false );
 
+// Upscale of scene framebuffer overwrites all pixels of screen.
+const r_OGLState g_scene_upscale_state(
+	false, false, false, false,
+	g_gl_state_blend_func,
+	r_OGLState::default_clear_color,
+	r_OGLState::default_clear_depth,
+	r_OGLState::default_cull_face_mode,
+	false );
+
+// Dynamic resolution parameters.
+// Part of target frame time, which GPU passes of map drawer may take.
+const float g_dynamic_resolution_gpu_time_fraction= 0.8f;
+// Minimal resolution scale numerator, for denominator c_dynamic_resolution_scale_denominator.
+const unsigned int g_dynamic_resolution_min_scale= 4u;
+// Frames without scale change after each change. GPU timers results are late for some frames, also avoid oscillation.
+const unsigned int g_dynamic_resolution_change_cooldown_frames= 30u;
+
+// Progressive loading parameters.
+constexpr unsigned int g_placeholder_floor_texture_size= 8u;
+constexpr unsigned char g_placeholder_wall_color= 128u;
+constexpr std::chrono::milliseconds g_textures_streaming_frame_budget( 4 );
+
+unsigned int CombineHashes( const unsigned int a, const unsigned int b )
+{
+	return a * 31u + b;
+}
+
 } // namespace
 
 struct FloorVertex
@@ -106,6 +201,23 @@ struct WallVertex
 //SIZE_ASSERT( WallVertex, 16u );
 SIZE_ASSERT( WallVertex, 24u );
 
+// Compact GPU copy of Model::Vertex. Texture coordinates are normalized unsigned shorts.
+// Used for models, which texture coordinates are in range [0; 1].
+struct PackedModelVertex
+{
+	unsigned short tex_coord[2];
+	unsigned short vertex_id;
+	unsigned char texture_id;
+	unsigned char alpha_test_mask;
+	unsigned char groups_mask;
+	unsigned char reserved[3];
+};
+
+SIZE_ASSERT( PackedModelVertex, 12u );
+
+// Models textures are placed in array textures of this size. Height of layers can be less, if textures need less space.
+static const unsigned int g_models_texture_size[2]= { 64u, 2048u };
+
 struct ModelsTexturesPlacement
 {
 	struct ModelTexturePlacement
@@ -118,6 +230,7 @@ struct ModelsTexturesPlacement
 
 	ModelTexturePlacement textures_placement[ c_max_textures ];
 	unsigned int layer_count;
+	unsigned int layer_height; // Height of used part of layers, not greater, than maximum texture height.
 };
 
 /* Models textures has fixed width (64) and variative height.
@@ -125,73 +238,75 @@ struct ModelsTexturesPlacement
  * We can not just place single model texture in single layer, because we left useless a lot of texture space.
  * Instead, we place as many as possible textures in each layer of texture array.
  *
- * In this function we try solve "bin packing problem", using "best-fit" algorithm.
+ * In this function we try solve "bin packing problem", using "best-fit decreasing" algorithm:
+ * textures are placed from highest to lowest, each texture goes into layer with smallest space left after placement.
+ * After that layers are cut to height of most filled layer, so, small groups of models do not allocate full-height layers.
  */
 static void CalculateModelsTexturesPlacement(
 	const std::vector<Model>& models,
-	const unsigned int texture_height,
+	const unsigned int max_texture_height,
 	ModelsTexturesPlacement& out_placement )
 {
 	PC_ASSERT( models.size() <= ModelsTexturesPlacement::c_max_textures );
 
-	unsigned int textures_placed= 0u;
-	bool texture_placed[ ModelsTexturesPlacement::c_max_textures ];
-	for( bool& placed : texture_placed )
-		placed= false;
-
 	const unsigned int c_border= 16u;
 
-	unsigned int current_y= c_border;
-	unsigned int current_layer= 0u;
-	const unsigned int no_texture= models.size();
+	unsigned int order[ ModelsTexturesPlacement::c_max_textures ];
+	for( unsigned int i= 0u; i < models.size(); i++ )
+		order[i]= i;
+	std::stable_sort(
+		order, order + models.size(),
+		[&]( const unsigned int a, const unsigned int b )
+		{
+			return models[a].texture_size[1] > models[b].texture_size[1];
+		} );
+
+	// Used height of each layer, including borders. Each texture can require new layer.
+	unsigned int layers_height[ ModelsTexturesPlacement::c_max_textures ];
+	unsigned int layer_count= 0u;
 
-	while( textures_placed < models.size() )
+	for( unsigned int i= 0u; i < models.size(); i++ )
 	{
-		const unsigned int place_left= texture_height - current_y;
+		const unsigned int texture_number= order[i];
+		// TODO - what do, if texture height iz zero?
+		const unsigned int texture_height= models[ texture_number ].texture_size[1];
 
-		unsigned int best_texture_number= no_texture;
-		unsigned int best_texture_delta= texture_height;
-		for( unsigned int i= 0u; i < models.size(); i++ )
+		unsigned int best_layer= layer_count;
+		unsigned int best_layer_space_left= max_texture_height;
+		for( unsigned int l= 0u; l < layer_count; l++ )
 		{
-			if( texture_placed[i] )
+			if( layers_height[l] + texture_height > max_texture_height )
 				continue;
 
-			int delta= int(place_left) - int( models[i].texture_size[1] );
-			if( delta >= 0 && delta < int(best_texture_delta) )
+			const unsigned int space_left= max_texture_height - ( layers_height[l] + texture_height );
+			if( space_left < best_layer_space_left )
 			{
-				best_texture_delta= delta;
-				best_texture_number= i;
+				best_layer_space_left= space_left;
+				best_layer= l;
 			}
 		}
 
-		// Best texture not found - use first unplaced.
-		if( best_texture_number == no_texture )
-		{
-			for( unsigned int i= 0u; i < models.size(); i++ )
-				if( !texture_placed[i] )
-				{
-					best_texture_number= i;
-					break;
-				}
-		}
-
-		// TODO - what do, if texture height iz zero?
-		const unsigned int best_texture_height= models[ best_texture_number ].texture_size[1];
-		if( current_y + best_texture_height > texture_height )
+		if( best_layer == layer_count )
 		{
-			current_y= c_border;
-			current_layer++;
+			layers_height[ layer_count ]= c_border;
+			layer_count++;
 		}
 
-		out_placement.textures_placement[ best_texture_number ].y= current_y;
-		out_placement.textures_placement[ best_texture_number ].layer= current_layer;
+		out_placement.textures_placement[ texture_number ].y= layers_height[ best_layer ];
+		out_placement.textures_placement[ texture_number ].layer= best_layer;
+		layers_height[ best_layer ]+= texture_height + c_border;
+	}
 
-		current_y+= best_texture_height + c_border;
-		texture_placed[ best_texture_number ]= true;
-		textures_placed++;
+	if( layer_count == 0u )
+	{
+		layers_height[0]= c_border;
+		layer_count= 1u;
 	}
 
-	out_placement.layer_count= current_layer + 1u;
+	out_placement.layer_count= layer_count;
+	out_placement.layer_height= 0u;
+	for( unsigned int l= 0u; l < layer_count; l++ )
+		out_placement.layer_height= std::max( out_placement.layer_height, std::min( layers_height[l], max_texture_height ) );
 }
 
 static void CreateModelMatrices(
@@ -216,16 +331,30 @@ MapDrawerGL::MapDrawerGL(
 	const GameResourcesConstPtr& game_resources,
 	const RenderingContextGL& rendering_context )
 	: settings_(settings)
+	, occlusion_culling_setting_( settings.RegisterBool( SettingsKeys::opengl_occlusion_culling, true ) )
+	, shadows_setting_( settings.RegisterBool( SettingsKeys::shadows, true ) )
 	, game_resources_(game_resources)
 	, rendering_context_(rendering_context)
 	, filter_textures_( settings.GetOrSetBool( SettingsKeys::opengl_textures_filtering, false ) )
+	, progressive_loading_( settings.GetOrSetBool( SettingsKeys::opengl_progressive_loading, false ) )
+	, compress_monsters_animations_( settings.GetOrSetBool( SettingsKeys::opengl_compressed_monsters_animations, false ) )
 	, use_hd_dynamic_lightmap_( settings.GetOrSetBool( SettingsKeys::opengl_dynamic_lighting, false ) )
-	, map_light_( game_resources, rendering_context, use_hd_dynamic_lightmap_ )
+	, use_geometry_shaders_( settings.GetOrSetBool( SettingsKeys::opengl_geometry_shaders, false ) )
+	, map_light_( game_resources, rendering_context, use_hd_dynamic_lightmap_, use_geometry_shaders_ )
+	, gpu_passes_profiler_( { "light update", "walls", "floors", "models", "monsters", "sky", "shadows", "sprites", "fullscreen blend", "occlusion tests" } )
+	, occlusion_culler_( rendering_context )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 
 	current_sky_texture_file_name_[0]= '\0';
 
+	if( settings_.GetOrSetBool( SettingsKeys::opengl_textures_compression, false ) )
+	{
+		compress_textures_= IsTexturesCompressionSupported();
+		if( !compress_textures_ )
+			Log::Warning( "Textures compression is not supported" );
+	}
+
 	// Textures
 	glGenTextures( 1, &floor_textures_array_id_ );
 	glGenTextures( 1, &wall_textures_array_id_ );
@@ -235,10 +364,8 @@ MapDrawerGL::MapDrawerGL(
 	glGenTextures( 1, &gibs_textures_array_id_ );
 	glGenTextures( 1, &weapons_textures_array_id_ );
 
-	LoadSprites( game_resources_->effects_sprites, sprites_textures_arrays_ );
-	LoadSprites( game_resources_->bmp_objects_sprites, bmp_objects_sprites_textures_arrays_ );
-	PrepareSkyGeometry();
-
+	LoadSprites( game_resources_->effects_sprites, sprites_textures_ );
+	LoadSprites( game_resources_->bmp_objects_sprites, bmp_objects_sprites_textures_ );
 	// Check buffer textures limitations.
 	// Buffer textures used for models animations vertices.
 	{
@@ -275,6 +402,7 @@ MapDrawerGL::MapDrawerGL(
 
 	// Items
 	LoadModels(
+		game_resources_,
 		game_resources_->items_models,
 		items_geometry_,
 		items_geometry_data_,
@@ -286,6 +414,7 @@ MapDrawerGL::MapDrawerGL(
 
 	// Rockets
 	LoadModels(
+		game_resources_,
 		game_resources_->rockets_models,
 		rockets_geometry_,
 		rockets_geometry_data_,
@@ -294,6 +423,7 @@ MapDrawerGL::MapDrawerGL(
 
 	// Rockets
 	LoadModels(
+		game_resources_,
 		game_resources_->gibs_models,
 		gibs_geometry_,
 		gibs_geometry_data_,
@@ -302,6 +432,7 @@ MapDrawerGL::MapDrawerGL(
 
 	// Weapons
 	LoadModels(
+		game_resources_,
 		game_resources_->weapons_models,
 		weapons_geometry_,
 		weapons_geometry_data_,
@@ -321,6 +452,25 @@ MapDrawerGL::MapDrawerGL(
 		models_defines.emplace_back( "ANIMATION_TEXTURE_WIDTH " + std::to_string( AnimationsBuffer::c_2d_texture_width ) );
 	}
 
+	std::vector<std::string> models_instanced_defines= models_defines;
+	models_instanced_defines.emplace_back( "INSTANCED" );
+
+	std::vector<std::string> monsters_defines= models_defines;
+	if( compress_monsters_animations_ )
+		monsters_defines.emplace_back( "COMPRESSED_ANIMATIONS" );
+
+	std::vector<std::string> monsters_instanced_defines= monsters_defines;
+	monsters_instanced_defines.emplace_back( "INSTANCED" );
+
+	// Without geometry shaders shaders of models with dynamic lighting calculate flat normals in fragment shader.
+	std::vector<std::string> lighted_models_fragment_defines;
+	if( !use_geometry_shaders_ )
+	{
+		lighted_models_fragment_defines.emplace_back( "NO_GEOMETRY_SHADER" );
+		for( std::vector<std::string>* const vertex_defines : { &models_defines, &models_instanced_defines, &monsters_instanced_defines } )
+			vertex_defines->emplace_back( "NO_GEOMETRY_SHADER" );
+	}
+
 	if( use_hd_dynamic_lightmap_ )
 		floors_shader_.ShaderSource(
 			rLoadShader( "floors_f.glsl", rendering_context.glsl_version ),
@@ -348,11 +498,15 @@ MapDrawerGL::MapDrawerGL(
 	walls_shader_.SetAttribLocation( "lightmap_coord", 4u );
 	walls_shader_.Create();
 
-	if( use_hd_dynamic_lightmap_ )
+	if( use_hd_dynamic_lightmap_ && use_geometry_shaders_ )
 		models_shader_.ShaderSource(
 			rLoadShader( "models_f.glsl", rendering_context.glsl_version ),
 			rLoadShader( "models_v.glsl", rendering_context.glsl_version, models_defines ),
 			rLoadShader( "models_g.glsl", rendering_context.glsl_version ) );
+	else if( use_hd_dynamic_lightmap_ )
+		models_shader_.ShaderSource(
+			rLoadShader( "models_f.glsl", rendering_context.glsl_version, lighted_models_fragment_defines ),
+			rLoadShader( "models_v.glsl", rendering_context.glsl_version, models_defines ) );
 	else
 		models_shader_.ShaderSource(
 			rLoadShader( "static_light/models_f.glsl", rendering_context.glsl_version ),
@@ -363,6 +517,34 @@ MapDrawerGL::MapDrawerGL(
 	models_shader_.SetAttribLocation( "alpha_test_mask", 3u );
 	models_shader_.Create();
 
+	if( use_hd_dynamic_lightmap_ && use_geometry_shaders_ )
+		models_instanced_shader_.ShaderSource(
+			rLoadShader( "models_f.glsl", rendering_context.glsl_version ),
+			rLoadShader( "models_v.glsl", rendering_context.glsl_version, models_instanced_defines ),
+			rLoadShader( "models_g.glsl", rendering_context.glsl_version ) );
+	else if( use_hd_dynamic_lightmap_ )
+		models_instanced_shader_.ShaderSource(
+			rLoadShader( "models_f.glsl", rendering_context.glsl_version, lighted_models_fragment_defines ),
+			rLoadShader( "models_v.glsl", rendering_context.glsl_version, models_instanced_defines ) );
+	else
+		models_instanced_shader_.ShaderSource(
+			rLoadShader( "static_light/models_f.glsl", rendering_context.glsl_version ),
+			rLoadShader( "static_light/models_v.glsl", rendering_context.glsl_version, models_instanced_defines ));
+	models_instanced_shader_.SetAttribLocation( "vertex_id", 0u );
+	models_instanced_shader_.SetAttribLocation( "tex_coord", 1u );
+	models_instanced_shader_.SetAttribLocation( "tex_id", 2u );
+	models_instanced_shader_.SetAttribLocation( "alpha_test_mask", 3u );
+	models_instanced_shader_.SetAttribLocation( "model_matrix", g_instance_model_matrix_attrib );
+	models_instanced_shader_.SetAttribLocation( "rotation_matrix", g_instance_rotation_matrix_attrib );
+	models_instanced_shader_.SetAttribLocation( "lightmap_matrix", g_instance_lightmap_matrix_attrib );
+	models_instanced_shader_.SetAttribLocation( "instance_params", g_instance_params_attrib );
+	models_instanced_shader_.Create();
+
+	glGenBuffers( 1, &models_instances_buffer_id_ );
+	glGenBuffers( 1, &static_models_transforms_buffer_id_ );
+	glGenBuffers( 1, &static_models_params_buffer_id_ );
+	glGenBuffers( 1, &sprites_instances_buffer_id_ );
+
 	models_shadow_shader_.ShaderSource(
 		rLoadShader( "models_shadow_f.glsl", rendering_context.glsl_version ),
 		rLoadShader( "models_shadow_v.glsl", rendering_context.glsl_version, models_defines ) );
@@ -370,6 +552,13 @@ MapDrawerGL::MapDrawerGL(
 	models_shadow_shader_.SetAttribLocation( "groups_mask", 4u );
 	models_shadow_shader_.Create();
 
+	monsters_shadow_shader_.ShaderSource(
+		rLoadShader( "models_shadow_f.glsl", rendering_context.glsl_version ),
+		rLoadShader( "models_shadow_v.glsl", rendering_context.glsl_version, monsters_defines ) );
+	monsters_shadow_shader_.SetAttribLocation( "vertex_id", 0u );
+	monsters_shadow_shader_.SetAttribLocation( "groups_mask", 4u );
+	monsters_shadow_shader_.Create();
+
 	if( use_hd_dynamic_lightmap_ )
 		sprites_shader_.ShaderSource(
 			rLoadShader( "sprites_f.glsl", rendering_context.glsl_version ),
@@ -378,35 +567,94 @@ MapDrawerGL::MapDrawerGL(
 		sprites_shader_.ShaderSource(
 			rLoadShader( "sprites_f.glsl", rendering_context.glsl_version ),
 			rLoadShader( "static_light/sprites_v.glsl", rendering_context.glsl_version ) );
-	sprites_shader_.SetAttribLocation( "pos", 0u );
+	sprites_shader_.SetAttribLocation( "model_matrix", g_sprite_instance_model_matrix_attrib );
+	sprites_shader_.SetAttribLocation( "sprite_params", g_sprite_instance_params_attrib );
+	sprites_shader_.SetAttribLocation( "tex_coord_scale", g_sprite_instance_tex_coord_scale_attrib );
 	sprites_shader_.Create();
 
-	if( use_hd_dynamic_lightmap_ )
+	if( use_hd_dynamic_lightmap_ && use_geometry_shaders_ )
 		monsters_shader_.ShaderSource(
 			rLoadShader( "monsters_f.glsl", rendering_context.glsl_version ),
-			rLoadShader( "monsters_v.glsl", rendering_context.glsl_version, models_defines ),
+			rLoadShader( "monsters_v.glsl", rendering_context.glsl_version, monsters_instanced_defines ),
 			rLoadShader( "monsters_g.glsl", rendering_context.glsl_version ) );
+	else if( use_hd_dynamic_lightmap_ )
+		monsters_shader_.ShaderSource(
+			rLoadShader( "monsters_f.glsl", rendering_context.glsl_version, lighted_models_fragment_defines ),
+			rLoadShader( "monsters_v.glsl", rendering_context.glsl_version, monsters_instanced_defines ) );
 	else
 		monsters_shader_.ShaderSource(
 			rLoadShader( "static_light/monsters_f.glsl", rendering_context.glsl_version ),
-			rLoadShader( "static_light/monsters_v.glsl", rendering_context.glsl_version, models_defines ) );
+			rLoadShader( "static_light/monsters_v.glsl", rendering_context.glsl_version, monsters_instanced_defines ) );
 	monsters_shader_.SetAttribLocation( "vertex_id", 0u );
 	monsters_shader_.SetAttribLocation( "tex_coord", 1u );
 	monsters_shader_.SetAttribLocation( "tex_id", 2u );
 	monsters_shader_.SetAttribLocation( "alpha_test_mask", 3u );
 	monsters_shader_.SetAttribLocation( "groups_mask", 4u );
+	monsters_shader_.SetAttribLocation( "model_matrix", g_instance_model_matrix_attrib );
+	monsters_shader_.SetAttribLocation( "rotation_matrix", g_instance_rotation_matrix_attrib );
+	monsters_shader_.SetAttribLocation( "lightmap_matrix", g_instance_lightmap_matrix_attrib );
+	monsters_shader_.SetAttribLocation( "instance_params", g_instance_params_attrib );
 	monsters_shader_.Create();
 
 	sky_shader_.ShaderSource(
 		rLoadShader( "sky_f.glsl", rendering_context.glsl_version ),
 		rLoadShader( "sky_v.glsl", rendering_context.glsl_version ) );
-	sky_shader_.SetAttribLocation( "pos", 0u );
 	sky_shader_.Create();
 
 	fullscreen_blend_shader_.ShaderSource(
 		rLoadShader( "fullscreen_blend_f.glsl", rendering_context.glsl_version ),
 		rLoadShader( "fullscreen_blend_v.glsl", rendering_context.glsl_version ) );
 	fullscreen_blend_shader_.Create();
+
+	dynamic_resolution_.enabled= settings_.GetOrSetBool( SettingsKeys::opengl_dynamic_resolution, false );
+	if( dynamic_resolution_.enabled )
+	{
+		const int target_fps= std::max( 1, settings_.GetOrSetInt( SettingsKeys::opengl_dynamic_resolution_fps, 60 ) );
+		dynamic_resolution_.target_gpu_time_s= g_dynamic_resolution_gpu_time_fraction / float(target_fps);
+
+		GLint samples= 0;
+		glGetIntegerv( GL_SAMPLES, &samples );
+		dynamic_resolution_.samples= static_cast<unsigned int>( std::max( 0, samples ) );
+
+		scene_upscale_shader_.ShaderSource(
+			rLoadShader( "scene_upscale_f.glsl", rendering_context.glsl_version ),
+			rLoadShader( "texture_copy_v.glsl", rendering_context.glsl_version ) );
+		scene_upscale_shader_.Create();
+	}
+
+	// Per-frame parameters are shared between shaders via uniform buffer.
+	glGenBuffers( 1, &view_params_uniform_buffer_id_ );
+	glBindBuffer( GL_UNIFORM_BUFFER, view_params_uniform_buffer_id_ );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof(m_Mat4), nullptr, GL_DYNAMIC_DRAW );
+
+	// Textures units are constant, so, set samplers only once.
+	const auto setup_shader=
+	[]( ShaderProgramGL& shader, const bool use_view_params, const std::initializer_list< std::pair<const char*, int> >& samplers )
+	{
+		shader.Bind();
+		for( const std::pair<const char*, int>& sampler : samplers )
+			shader.Uniform( sampler.first, sampler.second );
+
+		if( use_view_params )
+		{
+			GLint program_id= 0;
+			glGetIntegerv( GL_CURRENT_PROGRAM, &program_id );
+
+			const GLuint block_index= glGetUniformBlockIndex( GLuint(program_id), "ViewParams" );
+			if( block_index != GL_INVALID_INDEX )
+				glUniformBlockBinding( GLuint(program_id), block_index, g_view_params_uniform_block_binding );
+		}
+	};
+
+	setup_shader( floors_shader_, true, { { "tex", 0 }, { "lightmap", 1 } } );
+	setup_shader( walls_shader_, true, { { "tex", 0 }, { "lightmap", 1 } } );
+	setup_shader( models_shader_, false, { { "tex", 0 }, { "lightmap", 1 }, { "animations_vertices_buffer", 2 } } );
+	setup_shader( models_instanced_shader_, true, { { "tex", 0 }, { "lightmap", 1 }, { "animations_vertices_buffer", 2 } } );
+	setup_shader( models_shadow_shader_, false, { { "animations_vertices_buffer", 0 } } );
+	setup_shader( monsters_shadow_shader_, false, { { "animations_vertices_buffer", 0 } } );
+	setup_shader( sprites_shader_, true, { { "tex", 0 }, { "lightmap", 1 }, { "fullbright_lightmap", 2 } } );
+	setup_shader( monsters_shader_, true, { { "tex", 0 }, { "lightmap", 1 }, { "animations_vertices_buffer", 2 } } );
+	setup_shader( sky_shader_, false, { { "tex", 0 } } );
 }
 
 MapDrawerGL::~MapDrawerGL()
@@ -419,8 +667,16 @@ MapDrawerGL::~MapDrawerGL()
 	glDeleteTextures( 1, &gibs_textures_array_id_ );
 	glDeleteTextures( 1, &weapons_textures_array_id_ );
 
-	glDeleteTextures( sprites_textures_arrays_.size(), sprites_textures_arrays_.data() );
-	glDeleteTextures( bmp_objects_sprites_textures_arrays_.size(), bmp_objects_sprites_textures_arrays_.data() );
+	glDeleteTextures( sprites_textures_.arrays.size(), sprites_textures_.arrays.data() );
+	glDeleteTextures( bmp_objects_sprites_textures_.arrays.size(), bmp_objects_sprites_textures_.arrays.data() );
+
+	glDeleteBuffers( 1, &models_instances_buffer_id_ );
+	glDeleteBuffers( 1, &static_models_transforms_buffer_id_ );
+	glDeleteBuffers( 1, &static_models_params_buffer_id_ );
+	glDeleteBuffers( 1, &sprites_instances_buffer_id_ );
+	glDeleteBuffers( 1, &view_params_uniform_buffer_id_ );
+
+	ReleaseDynamicResolutionFramebuffer();
 }
 
 void MapDrawerGL::SetMap( const MapDataConstPtr& map_data )
@@ -430,25 +686,70 @@ void MapDrawerGL::SetMap( const MapDataConstPtr& map_data )
 	if( map_data == current_map_data_ )
 		return;
 
-	map_light_.SetMap( map_data );
+	PC_PROFILE_LOAD_STEP( "MapDrawerGL::SetMap" );
+
+	{
+		PC_PROFILE_LOAD_STEP( "lightmaps" );
+		map_light_.SetMap( map_data );
+	}
 
 	current_map_data_= map_data;
+	static_lights_grid_.Build( *map_data );
+	occlusion_culler_.Reset();
 
-	LoadFloorsTextures( *map_data );
-	LoadWallsTextures( *map_data );
-	LoadFloors( *map_data );
-	LoadWalls( *map_data );
+	if( progressive_loading_ )
+	{
+		PC_PROFILE_LOAD_STEP( "placeholder textures" );
+
+		// Start level with placeholders, load real textures later, in Draw.
+		LoadPlaceholderTextures( *map_data );
+		textures_streaming_.floors_pending= true;
+		textures_streaming_.walls_pending= true;
+		textures_streaming_.walls_files_read= 0u;
+		textures_streaming_.walls_files.resize( MapData::c_max_walls_textures );
+	}
+	else
+	{
+		PC_PROFILE_LOAD_STEP( "textures" );
 
-	LoadModels(
-		map_data->models,
-		models_geometry_,
-		models_geometry_data_,
-		models_animations_,
-		models_textures_array_id_ );
+		textures_streaming_= TexturesStreaming();
+
+		LoadFloorsTextures( *map_data );
+
+		// Vfs is not thread-safe, so, read files on this thread.
+		std::vector<Vfs::FileContent> walls_textures_files( MapData::c_max_walls_textures );
+		for( unsigned int t= 0u; t < MapData::c_max_walls_textures; t++ )
+			ReadWallTexture( *map_data, t, walls_textures_files[t] );
+		LoadWallsTextures( walls_textures_files );
+	}
+
+	{
+		PC_PROFILE_LOAD_STEP( "floors and walls" );
+		LoadFloors( *map_data );
+		LoadWalls( *map_data );
+	}
+
+	{
+		PC_PROFILE_LOAD_STEP( "models" );
+		LoadModels(
+			map_data,
+			map_data->models,
+			models_geometry_,
+			models_geometry_data_,
+			models_animations_,
+			models_textures_array_id_,
+			&map_models_content_hash_ );
+	}
+
+	// Force rebuilding of static models instances.
+	static_models_instances_source_.clear();
+	static_models_batches_.clear();
 
 	// Sky
 	if( std::strcmp( current_sky_texture_file_name_, current_map_data_->sky_texture_name ) != 0 )
 	{
+		PC_PROFILE_LOAD_STEP( "sky" );
+
 		std::strncpy( current_sky_texture_file_name_, current_map_data_->sky_texture_name, sizeof(current_sky_texture_file_name_) );
 
 		char sky_texture_file_path[ MapData::c_max_file_path_size ];
@@ -488,11 +789,26 @@ void MapDrawerGL::Draw(
 	const ViewClipPlanes& view_clip_planes,
 	const EntityId player_monster_id )
 {
+	PC_PROFILE_SCOPE( "MapDrawerGL::Draw" );
+
 	if( current_map_data_ == nullptr )
 		return;
 
+	gpu_passes_profiler_.BeginFrame();
+
+	StreamTextures();
+
 	UpdateDynamicWalls( map_state.GetDynamicWalls() );
+
+	gpu_passes_profiler_.BeginPass( GPUPassLightUpdate );
 	map_light_.Update( map_state );
+	gpu_passes_profiler_.EndPass();
+
+	// Light update uses own framebuffers, so, bind scene framebuffer after it.
+	BeginDynamicResolutionFrame();
+
+	models_instances_in_frame_= 0u;
+	models_draw_calls_in_frame_= 0u;
 
 	m_Mat4 translate;
 	translate.Translate( -camera_position );
@@ -501,47 +817,76 @@ void MapDrawerGL::Draw(
 
 	glClear( GL_DEPTH_BUFFER_BIT );
 
-	DrawWalls( view_matrix );
+	glBindBuffer( GL_UNIFORM_BUFFER, view_params_uniform_buffer_id_ );
+	glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(view_matrix.value), view_matrix.value );
+	glBindBufferBase( GL_UNIFORM_BUFFER, g_view_params_uniform_block_binding, view_params_uniform_buffer_id_ );
+
+	gpu_passes_profiler_.BeginPass( GPUPassWalls );
+	DrawWalls( view_clip_planes );
+	gpu_passes_profiler_.EndPass();
 
+	gpu_passes_profiler_.BeginPass( GPUPassFloors );
 	r_OGLStateManager::UpdateState( g_floors_gl_state );
-	DrawFloors( view_matrix );
+	DrawFloors();
+	gpu_passes_profiler_.EndPass();
 
-	r_OGLStateManager::UpdateState( g_models_gl_state );
-	DrawModels( map_state, view_matrix, view_clip_planes, false );
-	DrawItems( map_state, view_matrix, view_clip_planes, false );
-	DrawDynamicItems( map_state, view_matrix, view_clip_planes, false );
-	DrawMonsters( map_state, view_matrix, view_clip_planes, player_monster_id, false, true );
-	DrawMonstersBodyParts( map_state, view_matrix, view_clip_planes, false );
-	DrawRockets( map_state, view_matrix, view_clip_planes, false );
-	DrawGibs( map_state, view_matrix, view_clip_planes, false );
+	occlusion_culling_in_frame_= settings_.Get( occlusion_culling_setting_ );
+	if( occlusion_culling_in_frame_ )
+	{
+		gpu_passes_profiler_.BeginPass( GPUPassOcclusionTests );
+		TestOcclusion( map_state, view_matrix, camera_position, view_clip_planes, player_monster_id );
+		gpu_passes_profiler_.EndPass();
+	}
 
+	gpu_passes_profiler_.BeginPass( GPUPassModels );
+	r_OGLStateManager::UpdateState( g_models_gl_state );
+	PrepareStaticModels( map_state, view_clip_planes );
+	DrawModels( false );
+	// Entities are culled once here, visible entities with transparent polygons are collected for transparent pass.
+	transparent_models_instances_.clear();
+	DrawItems( map_state, view_matrix, view_clip_planes );
+	DrawDynamicItems( map_state, view_matrix, view_clip_planes );
+	gpu_passes_profiler_.EndPass();
+
+	gpu_passes_profiler_.BeginPass( GPUPassMonsters );
+	DrawMonsters( map_state, view_matrix, view_clip_planes, player_monster_id );
+	DrawMonstersBodyParts( map_state, view_matrix, view_clip_planes );
+	gpu_passes_profiler_.EndPass();
+
+	gpu_passes_profiler_.BeginPass( GPUPassModels );
+	DrawRockets( map_state, view_matrix, view_clip_planes );
+	DrawGibs( map_state, view_matrix, view_clip_planes );
+	gpu_passes_profiler_.EndPass();
+
+	gpu_passes_profiler_.BeginPass( GPUPassSky );
 	r_OGLStateManager::UpdateState( g_sky_gl_state );
 	DrawSky( view_rotation_and_projection_matrix );
+	gpu_passes_profiler_.EndPass();
 
-	if( settings_.GetOrSetBool( SettingsKeys::shadows, true ) )
+	if( settings_.Get( shadows_setting_ ) )
 	{
+		gpu_passes_profiler_.BeginPass( GPUPassShadows );
 		r_OGLStateManager::UpdateState( g_shadows_gl_state );
 		DrawMapModelsShadows( map_state, view_matrix, view_clip_planes );
 		DrawItemsShadows( map_state, view_matrix, view_clip_planes );
 		DrawMonstersShadows( map_state, view_matrix, view_clip_planes, player_monster_id );
+		gpu_passes_profiler_.EndPass();
 	}
 
 	/*
 	TRANSPARENT SECTION
 	*/
+	gpu_passes_profiler_.BeginPass( GPUPassModels );
 	r_OGLStateManager::UpdateState( g_transparent_models_gl_state );
-	DrawModels( map_state, view_matrix, view_clip_planes, true );
-	DrawItems( map_state, view_matrix, view_clip_planes, true );
-	DrawDynamicItems( map_state, view_matrix, view_clip_planes, true );
-	DrawMonsters( map_state, view_matrix, view_clip_planes, player_monster_id, true, false );
-	DrawMonsters( map_state, view_matrix, view_clip_planes, player_monster_id, false, false );
-	DrawMonstersBodyParts( map_state, view_matrix, view_clip_planes, true );
-	DrawRockets( map_state, view_matrix, view_clip_planes, true );
-	DrawGibs( map_state, view_matrix, view_clip_planes, true );
+	DrawModels( true );
+	DrawTransparentModels();
+	gpu_passes_profiler_.EndPass();
 
+	gpu_passes_profiler_.BeginPass( GPUPassSprites );
 	r_OGLStateManager::UpdateState( g_sprites_gl_state );
-	DrawBMPObjectsSprites( map_state, view_matrix, camera_position );
-	DrawEffectsSprites( map_state, view_matrix, camera_position );
+	DrawBMPObjectsSprites( map_state, camera_position );
+	DrawEffectsSprites( map_state, camera_position );
+	gpu_passes_profiler_.EndPass();
 }
 
 void MapDrawerGL::DrawWeapon(
@@ -557,11 +902,8 @@ void MapDrawerGL::DrawWeapon(
 	glActiveTexture( GL_TEXTURE0 + 0 );
 	glBindTexture( GL_TEXTURE_2D_ARRAY, weapons_textures_array_id_ );
 	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
 
 	weapons_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
 
 	m_Mat4 shift_mat;
 	const m_Vec3 additional_shift=
@@ -651,9 +993,6 @@ void MapDrawerGL::DrawActiveItemIcon(
 	glBindTexture( GL_TEXTURE_2D_ARRAY, items_textures_array_id_ );
 	map_light_.GetFullbrightLightmapDummy().Bind(1);
 	items_animations_.Bind( 2 );
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
 
 	m_Mat4 model_matrix, rotation_matrix;
 	m_Mat3 lightmap_matrix;
@@ -699,12 +1038,54 @@ void MapDrawerGL::DoFullscreenPostprocess( const MapState& map_state )
 	m_Vec3 blend_color;
 	float blend_alpha;
 	map_state.GetFullscreenBlend( blend_color, blend_alpha );
+
+	if( dynamic_resolution_.scene_framebuffer_active )
+	{
+		// Resolve and upscale scene framebuffer and apply fullscreen blend in single pass.
+		DynamicResolution& dr= dynamic_resolution_;
+		dr.scene_framebuffer_active= false;
+
+		gpu_passes_profiler_.BeginPass( GPUPassFullscreenBlend );
+
+		dr.resolve_framebuffer.Bind();
+		glBindFramebuffer( GL_READ_FRAMEBUFFER, dr.framebuffer_id );
+		glBlitFramebuffer(
+			0, 0, dr.size.Width(), dr.size.Height(),
+			0, 0, dr.size.Width(), dr.size.Height(),
+			GL_COLOR_BUFFER_BIT, GL_NEAREST );
+
+		r_Framebuffer::BindScreenFramebuffer();
+
+		r_OGLStateManager::UpdateState( g_scene_upscale_state );
+		scene_upscale_shader_.Bind();
+		dr.resolve_framebuffer.GetTextures().front().Bind(0);
+		scene_upscale_shader_.Uniform( "tex", 0 );
+		scene_upscale_shader_.Uniform(
+			"blend_color",
+			blend_color.x, blend_color.y, blend_color.z, blend_alpha > 0.001f ? blend_alpha : 0.0f );
+		glDrawArrays( GL_TRIANGLES, 0, 6 );
+
+		// HUD and menus are drawn over screen after it.
+		glClear( GL_DEPTH_BUFFER_BIT );
+
+		gpu_passes_profiler_.EndPass();
+		return;
+	}
+
 	if( blend_alpha > 0.001f )
 	{
+		// Profiler frames are started in map drawing.
+		const bool profile= current_map_data_ != nullptr;
+		if( profile )
+			gpu_passes_profiler_.BeginPass( GPUPassFullscreenBlend );
+
 		r_OGLStateManager::UpdateState( g_fullscreen_blend_state );
 		fullscreen_blend_shader_.Bind();
 		fullscreen_blend_shader_.Uniform( "blend_color", blend_color.x, blend_color.y, blend_color.z, blend_alpha );
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
+		glDrawArrays( GL_TRIANGLES, 0, 3 );
+
+		if( profile )
+			gpu_passes_profiler_.EndPass();
 	}
 
 }
@@ -731,11 +1112,8 @@ void MapDrawerGL::DrawMapRelatedModels(
 	glActiveTexture( GL_TEXTURE0 + 0 );
 	glBindTexture( GL_TEXTURE_2D_ARRAY, models_textures_array_id_ );
 	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
 
 	models_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
 
 	for( unsigned int t= 0u; t < 2u; t++ )
 	{
@@ -770,7 +1148,7 @@ void MapDrawerGL::DrawMapRelatedModels(
 			PC_ASSERT( map_model.frame < model.frame_count );
 
 			const m_BBox3& bbox= model.animations_bboxes[ map_model.frame ];
-			if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
+			if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ map_model.frame ], bbox, model_matrix ) )
 				continue;
 
 			models_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
@@ -788,45 +1166,111 @@ void MapDrawerGL::DrawMapRelatedModels(
 	} // for transparent/untransparent
 }
 
-void MapDrawerGL::LoadSprites( const std::vector<ObjSprite>& sprites, std::vector<GLuint>& out_textures )
+void MapDrawerGL::LoadSprites( const std::vector<ObjSprite>& sprites, SpritesTextures& out_textures )
 {
-	const Palette& palette= game_resources_->palette;
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( game_resources_->palette, 255u, palette_rgba );
 
-	std::vector<unsigned char> data_rgba;
+	GLint max_layers= 256;
+	glGetIntegerv( GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers );
+
+	const auto round_up_to_power_of_two=
+	[]( const unsigned int x ) -> unsigned int
+	{
+		unsigned int result= 1u;
+		while( result < x )
+			result<<= 1u;
+		return result;
+	};
+
+	// Put sprites with same power of two size into same arrays.
+	struct ArrayInfo
+	{
+		unsigned int size[2];
+		unsigned int layer_count;
+	};
+	std::vector<ArrayInfo> arrays;
 
-	out_textures.resize( sprites.size() );
-	glGenTextures( out_textures.size(), out_textures.data() );
-	for( unsigned int i= 0u; i < out_textures.size(); i++ )
+	out_textures.sprites.resize( sprites.size() );
+	for( unsigned int i= 0u; i < sprites.size(); i++ )
 	{
 		const ObjSprite& sprite= sprites[i];
+		const unsigned int layer_size[2]= { round_up_to_power_of_two( sprite.size[0] ), round_up_to_power_of_two( sprite.size[1] ) };
+
+		unsigned int array_index= 0u;
+		while( array_index < arrays.size() &&
+			!( arrays[array_index].size[0] == layer_size[0] && arrays[array_index].size[1] == layer_size[1] &&
+			   arrays[array_index].layer_count + sprite.frame_count <= static_cast<unsigned int>(max_layers) ) )
+			array_index++;
+
+		if( array_index == arrays.size() )
+		{
+			ArrayInfo array_info;
+			array_info.size[0]= layer_size[0];
+			array_info.size[1]= layer_size[1];
+			array_info.layer_count= 0u;
+			arrays.push_back( array_info );
+		}
+
+		SpriteTexture& sprite_texture= out_textures.sprites[i];
+		sprite_texture.array_index= array_index;
+		sprite_texture.first_layer= arrays[array_index].layer_count;
+		sprite_texture.tex_coord_scale[0]= float(sprite.size[0]) / float(layer_size[0]);
+		sprite_texture.tex_coord_scale[1]= float(sprite.size[1]) / float(layer_size[1]);
+
+		arrays[array_index].layer_count+= sprite.frame_count;
+	}
+
+	std::vector<unsigned char> data_rgba;
+
+	out_textures.arrays.resize( arrays.size() );
+	glGenTextures( out_textures.arrays.size(), out_textures.arrays.data() );
+	for( unsigned int a= 0u; a < arrays.size(); a++ )
+	{
+		const ArrayInfo& array_info= arrays[a];
+		const unsigned int layer_texels= array_info.size[0] * array_info.size[1];
 
 		data_rgba.clear();
-		data_rgba.resize( sprite.data.size() * 4u, 0u );
+		data_rgba.resize( 4u * layer_texels * array_info.layer_count, 0u );
 
-		for( unsigned int j= 0u; j < sprite.data.size(); j++ )
+		for( unsigned int i= 0u; i < sprites.size(); i++ )
 		{
-			const unsigned char color_index= sprite.data[j];
+			const SpriteTexture& sprite_texture= out_textures.sprites[i];
+			if( sprite_texture.array_index != a )
+				continue;
 
-			unsigned char* const dst= data_rgba.data() + 4u * j;
+			const ObjSprite& sprite= sprites[i];
+			for( unsigned int f= 0u; f < sprite.frame_count; f++ )
+			{
+				const unsigned char* const src= sprite.data.data() + sprite.size[0] * sprite.size[1] * f;
+				unsigned char* const dst= data_rgba.data() + 4u * layer_texels * ( sprite_texture.first_layer + f );
+
+				// Repeat last column and row in free space of layer, for proper filtration on sprite borders.
+				const unsigned int dst_size_x= std::min( sprite.size[0] + 1u, array_info.size[0] );
+				const unsigned int dst_size_y= std::min( sprite.size[1] + 1u, array_info.size[1] );
+				for( unsigned int y= 0u; y < dst_size_y; y++ )
+				for( unsigned int x= 0u; x < dst_size_x; x++ )
+				{
+					const unsigned char color_index=
+						src[ std::min( x, sprite.size[0] - 1u ) + std::min( y, sprite.size[1] - 1u ) * sprite.size[0] ];
 
-			dst[0]= palette[ 3u * color_index + 0u ];
-			dst[1]= palette[ 3u * color_index + 1u ];
-			dst[2]= palette[ 3u * color_index + 2u ];
-			dst[3]= color_index == 255u ? 0u : 255u;
+					std::memcpy( dst + 4u * ( x + y * array_info.size[0] ), &palette_rgba[ color_index ], sizeof(uint32_t) );
+				}
+			}
 		}
 
 		if( filter_textures_ )
 		{
-			for( unsigned int j= 0u; j < sprite.frame_count; j++ )
+			for( unsigned int l= 0u; l < array_info.layer_count; l++ )
 				FillAlphaTexelsColorRGBA(
-					sprite.size[0], sprite.size[1],
-					data_rgba.data() + 4u * sprite.size[0] * sprite.size[1] * j );
+					array_info.size[0], array_info.size[1],
+					data_rgba.data() + 4u * layer_texels * l );
 		}
 
-		glBindTexture( GL_TEXTURE_2D_ARRAY, out_textures[i] );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, out_textures.arrays[a] );
 		glTexImage3D(
 			GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-			sprite.size[0], sprite.size[1], sprite.frame_count,
+			array_info.size[0], array_info.size[1], array_info.layer_count,
 			0, GL_RGBA, GL_UNSIGNED_BYTE, data_rgba.data() );
 
 		if( filter_textures_ )
@@ -845,32 +1289,6 @@ void MapDrawerGL::LoadSprites( const std::vector<ObjSprite>& sprites, std::vecto
 	}
 }
 
-void MapDrawerGL::PrepareSkyGeometry()
-{
-	static const float c_scene_radius= 64.0f;
-	static const float c_bottom_z_level= -c_scene_radius * 0.5f;
-	static const float c_sky_vertices[]=
-	{
-		c_scene_radius,  c_scene_radius,   c_scene_radius,  -c_scene_radius,  c_scene_radius,   c_scene_radius,
-		c_scene_radius, -c_scene_radius,   c_scene_radius,  -c_scene_radius, -c_scene_radius,   c_scene_radius,
-		c_scene_radius,  c_scene_radius, c_bottom_z_level,  -c_scene_radius,  c_scene_radius, c_bottom_z_level,
-		c_scene_radius, -c_scene_radius, c_bottom_z_level,  -c_scene_radius, -c_scene_radius, c_bottom_z_level,
-	};
-	static const unsigned short c_sky_indeces[]=
-	{
-		0, 1, 5,  0, 5, 4,
-		0, 4, 6,  0, 6, 2,
-		//4, 5, 7,  4, 7, 6, // bottom
-		0, 3, 1,  0, 2, 3, // top
-		2, 7, 3,  2, 6, 7,
-		1, 3, 7,  1, 7, 5,
-	};
-
-	sky_geometry_data_.VertexData( c_sky_vertices, sizeof(c_sky_vertices), sizeof(float) * 3u );
-	sky_geometry_data_.IndexData( c_sky_indeces, sizeof(c_sky_indeces), GL_UNSIGNED_SHORT, GL_TRIANGLES );
-	sky_geometry_data_.VertexAttribPointer( 0u, 3u, GL_FLOAT, false, 0u );
-}
-
 const r_Texture& MapDrawerGL::GetPlayerTexture( const unsigned char color )
 {
 	// Should be done after monsters loading.
@@ -929,37 +1347,44 @@ const r_Texture& MapDrawerGL::GetPlayerTexture( const unsigned char color )
 void MapDrawerGL::LoadFloorsTextures( const MapData& map_data )
 {
 	const Palette& palette= game_resources_->palette;
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, c_no_transparent_color_index, palette_rgba );
 
 	const unsigned int texture_texels= MapData::c_floor_texture_size * MapData::c_floor_texture_size;
 
-	glBindTexture( GL_TEXTURE_2D_ARRAY, floor_textures_array_id_ );
-	glTexImage3D(
-		GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-		MapData::c_floor_texture_size, MapData::c_floor_texture_size, MapData::c_floors_textures_count,
-		0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	const unsigned int palette_hash= SaveHeader::CalculateHash( palette.data(), palette.size() );
+	const unsigned int source_hash=
+		CombineHashes(
+			SaveHeader::CalculateHash( map_data.floor_textures_data.front().data(), map_data.floor_textures_data.size() * sizeof(MapData::FloorTextureData) ),
+			palette_hash );
 
+	std::vector<unsigned int> layers_hashes( MapData::c_floors_textures_count );
 	for( unsigned int t= 0u; t < MapData::c_floors_textures_count; t++ )
-	{
-		const unsigned char* const in_data= map_data.floor_textures_data[t];
-
-		unsigned char texture_data[ 4u * texture_texels ];
+		layers_hashes[t]=
+			CombineHashes(
+				SaveHeader::CalculateHash( map_data.floor_textures_data[t].data(), sizeof(map_data.floor_textures_data[t]) ),
+				palette_hash );
 
-		for( unsigned int i= 0u; i < texture_texels; i++ )
+	glBindTexture( GL_TEXTURE_2D_ARRAY, floor_textures_array_id_ );
+	UploadTextureArray(
+		"floors", source_hash, CompressedTextureFormat::BC1,
+		MapData::c_floor_texture_size, MapData::c_floor_texture_size, MapData::c_floors_textures_count,
+		layers_hashes, floor_textures_layers_hashes_,
+		[&]( std::vector<unsigned char>& textures_data )
 		{
-			const unsigned char color_index= in_data[i];
-			for( unsigned int j= 0u; j < 3u; j++ )
-				texture_data[ (i << 2u) + j ]= palette[ color_index * 3u + j ];
-			texture_data[ (i << 2u) + 3u ]= 255u;
-		}
-
-		glTexSubImage3D(
-			GL_TEXTURE_2D_ARRAY, 0,
-			0, 0, t,
-			MapData::c_floor_texture_size, MapData::c_floor_texture_size, 1,
-			GL_RGBA, GL_UNSIGNED_BYTE,
-			texture_data );
-
-	} // for textures
+			// Convert textures on all threads, upload all layers at once.
+			textures_data.resize( 4u * texture_texels * MapData::c_floors_textures_count );
+			workers_pool_.ParallelFor(
+				MapData::c_floors_textures_count,
+				[&]( const unsigned int t )
+				{
+					ConvertToRGBA(
+						texture_texels,
+						map_data.floor_textures_data[t].data(),
+						palette_rgba,
+						textures_data.data() + 4u * texture_texels * t );
+				} );
+		} );
 
 	if( filter_textures_ )
 	{
@@ -971,85 +1396,103 @@ void MapDrawerGL::LoadFloorsTextures( const MapData& map_data )
 		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
 		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
 	}
-
-	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
 }
 
-void MapDrawerGL::LoadWallsTextures( const MapData& map_data )
+void MapDrawerGL::ReadWallTexture( const MapData& map_data, const unsigned int t, Vfs::FileContent& out_file ) const
 {
-	Log::Info( "Loading walls textures for map" );
-
-	const Palette& palette= game_resources_->palette;
+	out_file.clear();
+	if( map_data.walls_textures[t].file_path[0] == '\0' )
+		return;
 
-	Vfs::FileContent texture_file;
+	game_resources_->vfs->ReadFile( map_data.walls_textures[t].file_path, out_file );
+	if( out_file.empty() )
+		return;
 
-	glBindTexture( GL_TEXTURE_2D_ARRAY, wall_textures_array_id_ );
-	glTexImage3D(
-		GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-		g_max_wall_texture_width, g_wall_texture_height, MapData::c_max_walls_textures,
-		0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	unsigned short src_width, src_height;
+	std::memcpy( &src_width , out_file.data() + 0x2u, sizeof(unsigned short) );
+	std::memcpy( &src_height, out_file.data() + 0x4u, sizeof(unsigned short) );
 
-	for( unsigned int t= 0u; t < MapData::c_max_walls_textures; t++ )
+	if( src_width == 0u ||
+		g_max_wall_texture_width / src_width * src_width != g_max_wall_texture_width ||
+		src_height < g_wall_texture_height )
 	{
-		if( map_data.walls_textures[t].file_path[0] == '\0' )
-			continue;
-
-		game_resources_->vfs->ReadFile( map_data.walls_textures[t].file_path, texture_file );
-		if( texture_file.empty() )
-			continue;
+		Log::Warning( "Invalid wall texture size: ", src_width, "x", src_height );
+		out_file.clear();
+	}
+}
 
-		unsigned char texture_data[ g_max_wall_texture_width * g_wall_texture_height * 4u ];
+void MapDrawerGL::LoadWallsTextures( const std::vector<Vfs::FileContent>& textures_files )
+{
+	Log::Info( "Loading walls textures for map" );
 
-		unsigned short src_width, src_height;
-		std::memcpy( &src_width , texture_file.data() + 0x2u, sizeof(unsigned short) );
-		std::memcpy( &src_height, texture_file.data() + 0x4u, sizeof(unsigned short) );
+	PC_ASSERT( textures_files.size() == MapData::c_max_walls_textures );
 
-		if( g_max_wall_texture_width / src_width * src_width != g_max_wall_texture_width ||
-			src_height < g_wall_texture_height )
-		{
-			Log::Warning( "Invalid wall texture size: ", src_width, "x", src_height );
-			continue;
-		}
+	const Palette& palette= game_resources_->palette;
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, 255u, palette_rgba );
 
-		const unsigned char* const src= texture_file.data() + 0x320u;
+	// Result depends on all source files, palette and alpha texels filling.
+	const unsigned int palette_hash= SaveHeader::CalculateHash( palette.data(), palette.size() );
+	unsigned int source_hash= palette_hash;
+	std::vector<unsigned int> layers_hashes( MapData::c_max_walls_textures );
+	for( unsigned int t= 0u; t < MapData::c_max_walls_textures; t++ )
+	{
+		const unsigned int file_hash= SaveHeader::CalculateHash( textures_files[t].data(), textures_files[t].size() );
+		source_hash= CombineHashes( source_hash, file_hash );
+		layers_hashes[t]= CombineHashes( CombineHashes( file_hash, palette_hash ), filter_textures_ ? 1u : 0u );
+	}
+	source_hash= CombineHashes( source_hash, filter_textures_ ? 1u : 0u );
 
-		for( unsigned int y= 0u; y < g_wall_texture_height; y++ )
+	glBindTexture( GL_TEXTURE_2D_ARRAY, wall_textures_array_id_ );
+	UploadTextureArray(
+		"walls", source_hash, CompressedTextureFormat::BC3, // Some walls textures have alpha.
+		g_max_wall_texture_width, g_wall_texture_height, MapData::c_max_walls_textures,
+		layers_hashes, wall_textures_layers_hashes_,
+		[&]( std::vector<unsigned char>& textures_data )
 		{
-			const unsigned int y_flipped= g_wall_texture_height - 1u - y;
-
-			for( unsigned int x= 0u; x < src_width; x++ )
-			{
-				const unsigned int color_index= src[ x + y_flipped * src_width ];
-				const unsigned int i= ( x + y * g_max_wall_texture_width ) << 2;
-
-				for( unsigned int j= 0u; j < 3u; j++ )
-					texture_data[ i + j ]= palette[ color_index * 3u + j ];
-
-				texture_data[ i + 3u ]= color_index == 255u ? 0u : 255u;
-			}
-
-			const unsigned int repeats= g_max_wall_texture_width / src_width;
-			unsigned char* const line= texture_data + g_max_wall_texture_width * 4u * y;
-			for( unsigned int r= 1u; r < repeats; r++ )
-				std::memcpy(
-					line + r * src_width * 4u,
-					line,
-					src_width * 4u );
-		}
-
-		// Fill alpha-texels with color of neighbor texels.
-		// This needs only if textures filtering is enabled, for prevention of ugly dark outlines around nonalpha texels.
-		if( filter_textures_ )
-			FillAlphaTexelsColorRGBA( g_max_wall_texture_width, g_wall_texture_height, texture_data );
-
-		glTexSubImage3D(
-			GL_TEXTURE_2D_ARRAY, 0,
-			0, 0, t,
-			g_max_wall_texture_width, g_wall_texture_height, 1,
-			GL_RGBA, GL_UNSIGNED_BYTE,
-			texture_data );
-
-	} // for wall textures
+			// Convert textures on all threads, upload all layers at once. Layers of missing textures are transparent.
+			const unsigned int c_layer_size= g_max_wall_texture_width * g_wall_texture_height * 4u;
+			textures_data.resize( c_layer_size * MapData::c_max_walls_textures, 0u );
+			workers_pool_.ParallelFor(
+				MapData::c_max_walls_textures,
+				[&]( const unsigned int t )
+				{
+					const Vfs::FileContent& texture_file= textures_files[t];
+					if( texture_file.empty() )
+						return;
+
+					unsigned char* const texture_data= textures_data.data() + c_layer_size * t;
+
+					unsigned short src_width;
+					std::memcpy( &src_width , texture_file.data() + 0x2u, sizeof(unsigned short) );
+
+					const unsigned char* const src= texture_file.data() + 0x320u;
+
+					for( unsigned int y= 0u; y < g_wall_texture_height; y++ )
+					{
+						const unsigned int y_flipped= g_wall_texture_height - 1u - y;
+
+						ConvertToRGBA(
+							src_width,
+							src + y_flipped * src_width,
+							palette_rgba,
+							texture_data + g_max_wall_texture_width * 4u * y );
+
+						const unsigned int repeats= g_max_wall_texture_width / src_width;
+						unsigned char* const line= texture_data + g_max_wall_texture_width * 4u * y;
+						for( unsigned int r= 1u; r < repeats; r++ )
+							std::memcpy(
+								line + r * src_width * 4u,
+								line,
+								src_width * 4u );
+					}
+
+					// Fill alpha-texels with color of neighbor texels.
+					// This needs only if textures filtering is enabled, for prevention of ugly dark outlines around nonalpha texels.
+					if( filter_textures_ )
+						FillAlphaTexelsColorRGBA( g_max_wall_texture_width, g_wall_texture_height, texture_data );
+				} );
+		} );
 
 	if( filter_textures_ )
 	{
@@ -1062,39 +1505,203 @@ void MapDrawerGL::LoadWallsTextures( const MapData& map_data )
 		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
 		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
 	}
-
-	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
 }
 
-void MapDrawerGL::LoadFloors( const MapData& map_data )
+void MapDrawerGL::LoadPlaceholderTextures( const MapData& map_data )
 {
-	std::vector<FloorVertex> floors_vertices;
-	for( unsigned int floor_or_ceiling= 0u; floor_or_ceiling < 2u; floor_or_ceiling++ )
-	{
-		floors_geometry_info[ floor_or_ceiling ].first_vertex_number= floors_vertices.size();
-
-		const unsigned char* const in_data= floor_or_ceiling == 0u ? map_data.floor_textures : map_data.ceiling_textures;
+	const Palette& palette= game_resources_->palette;
 
-		for( unsigned int x= 0u; x < MapData::c_map_size; x++ )
-		for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+	// Floors data is already in memory, so, use downscaled floors textures.
+	{
+		const unsigned int c_scale= MapData::c_floor_texture_size / g_placeholder_floor_texture_size;
+
+		std::vector<unsigned char> textures_data(
+			4u * g_placeholder_floor_texture_size * g_placeholder_floor_texture_size * MapData::c_floors_textures_count );
+		unsigned char* dst= textures_data.data();
+		for( unsigned int t= 0u; t < MapData::c_floors_textures_count; t++ )
+		for( unsigned int y= 0u; y < g_placeholder_floor_texture_size; y++ )
+		for( unsigned int x= 0u; x < g_placeholder_floor_texture_size; x++, dst+= 4u )
 		{
-			const unsigned char texture_number= in_data[ x + y * MapData::c_map_size ];
+			unsigned int color[3]= { 0u, 0u, 0u };
+			for( unsigned int dy= 0u; dy < c_scale; dy++ )
+			for( unsigned int dx= 0u; dx < c_scale; dx++ )
+			{
+				const unsigned char color_index=
+					map_data.floor_textures_data[t][ x * c_scale + dx + ( y * c_scale + dy ) * MapData::c_floor_texture_size ];
+				for( unsigned int j= 0u; j < 3u; j++ )
+					color[j]+= palette[ color_index * 3u + j ];
+			}
+			for( unsigned int j= 0u; j < 3u; j++ )
+				dst[j]= color[j] / ( c_scale * c_scale );
+			dst[3]= 255u;
+		}
 
-			if( texture_number == MapData::c_empty_floor_texture_id ||
-				texture_number == MapData::c_sky_floor_texture_id )
-				continue;
+		floor_textures_layers_hashes_.clear();
+		glBindTexture( GL_TEXTURE_2D_ARRAY, floor_textures_array_id_ );
+		glTexImage3D(
+			GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+			g_placeholder_floor_texture_size, g_placeholder_floor_texture_size, MapData::c_floors_textures_count,
+			0, GL_RGBA, GL_UNSIGNED_BYTE, textures_data.data() );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	}
 
-			floors_vertices.resize( floors_vertices.size() + 6u );
-			FloorVertex* v= floors_vertices.data() + floors_vertices.size() - 6u;
+	// Walls textures are not loaded yet, so, use flat opaque color.
+	{
+		const std::vector<unsigned char> textures_data( 4u * MapData::c_max_walls_textures, g_placeholder_wall_color );
 
-			v[0].xy[0]= x   ;  v[0].xy[1]= y;
-			v[1].xy[0]= x+1u;  v[1].xy[1]= y;
-			v[2].xy[0]= x+1u;  v[2].xy[1]= y+1u;
-			v[3].xy[0]= x   ;  v[3].xy[1]= y+1u;
+		wall_textures_layers_hashes_.clear();
+		glBindTexture( GL_TEXTURE_2D_ARRAY, wall_textures_array_id_ );
+		glTexImage3D(
+			GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+			1, 1, MapData::c_max_walls_textures,
+			0, GL_RGBA, GL_UNSIGNED_BYTE, textures_data.data() );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	}
+}
 
-			v[0].texture_id= v[1].texture_id= v[2].texture_id= v[3].texture_id= texture_number;
-			v[4]= v[0];
-			v[5]= v[2];
+void MapDrawerGL::StreamTextures()
+{
+	if( !( textures_streaming_.floors_pending || textures_streaming_.walls_pending ) )
+		return;
+
+	// Do at least one step per frame. Steps are coarse, so, budget may be exceeded by last step.
+	const auto start_time= std::chrono::steady_clock::now();
+	do
+	{
+		if( textures_streaming_.floors_pending )
+		{
+			LoadFloorsTextures( *current_map_data_ );
+			textures_streaming_.floors_pending= false;
+		}
+		else if( textures_streaming_.walls_files_read < MapData::c_max_walls_textures )
+		{
+			ReadWallTexture(
+				*current_map_data_,
+				textures_streaming_.walls_files_read,
+				textures_streaming_.walls_files[ textures_streaming_.walls_files_read ] );
+			textures_streaming_.walls_files_read++;
+		}
+		else
+		{
+			LoadWallsTextures( textures_streaming_.walls_files );
+			textures_streaming_= TexturesStreaming();
+		}
+	} while(
+		( textures_streaming_.floors_pending || textures_streaming_.walls_pending ) &&
+		std::chrono::steady_clock::now() - start_time < g_textures_streaming_frame_budget );
+}
+
+void MapDrawerGL::UploadTextureArray(
+	const char* const cache_kind,
+	const unsigned int source_hash,
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int layer_count,
+	const std::vector<unsigned int>& layers_hashes,
+	std::vector<unsigned int>& resident_layers_hashes,
+	const std::function< void( std::vector<unsigned char>& out_data_rgba ) >& convert_func ) const
+{
+	PC_ASSERT( layers_hashes.size() == layer_count );
+
+	// Texture storage is same for all maps, so, update only changed layers.
+	// Layers are matched by index, because layer index is texture number in map.
+	const bool update_layers= resident_layers_hashes.size() == layer_count;
+	std::vector<bool> changed_layers( layer_count, true );
+	unsigned int changed_layer_count= layer_count;
+	if( update_layers )
+	{
+		for( unsigned int l= 0u; l < layer_count; l++ )
+		{
+			changed_layers[l]= layers_hashes[l] != resident_layers_hashes[l];
+			if( !changed_layers[l] )
+				changed_layer_count--;
+		}
+	}
+	resident_layers_hashes= layers_hashes;
+
+	Log::Info( "Upload ", changed_layer_count, " of ", layer_count, " ", cache_kind, " textures" );
+	if( changed_layer_count == 0u )
+		return;
+
+	if( !compress_textures_ )
+	{
+		std::vector<unsigned char> data_rgba;
+		convert_func( data_rgba );
+
+		if( update_layers )
+		{
+			const unsigned int layer_size= size_x * size_y * 4u;
+			for( unsigned int l= 0u; l < layer_count; l++ )
+			{
+				if( changed_layers[l] )
+					glTexSubImage3D(
+						GL_TEXTURE_2D_ARRAY, 0,
+						0, 0, l,
+						size_x, size_y, 1,
+						GL_RGBA, GL_UNSIGNED_BYTE, data_rgba.data() + layer_size * l );
+			}
+		}
+		else
+			glTexImage3D(
+				GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+				size_x, size_y, layer_count,
+				0, GL_RGBA, GL_UNSIGNED_BYTE, data_rgba.data() );
+		glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
+		return;
+	}
+
+	// Compression is slow, so, compressed textures with all mips are cached on disk.
+	char kind[64];
+	std::snprintf( kind, sizeof(kind), "%s_%s", cache_kind, format == CompressedTextureFormat::BC1 ? "bc1" : "bc3" );
+
+	std::vector<unsigned char> compressed_mips;
+	if( !LoadTexturesFromDiskCache(
+			kind, source_hash,
+			GetCompressedTextureArraySize( format, size_x, size_y, layer_count ),
+			compressed_mips ) )
+	{
+		std::vector<unsigned char> data_rgba;
+		convert_func( data_rgba );
+		CompressTextureArray( format, size_x, size_y, layer_count, data_rgba.data(), workers_pool_, compressed_mips );
+		SaveTexturesToDiskCache( kind, source_hash, compressed_mips );
+	}
+
+	if( update_layers )
+		UploadCompressedTextureArrayLayersMips( format, size_x, size_y, layer_count, compressed_mips.data(), changed_layers );
+	else
+		UploadCompressedTextureArrayMips( format, size_x, size_y, layer_count, compressed_mips.data() );
+}
+
+void MapDrawerGL::LoadFloors( const MapData& map_data )
+{
+	std::vector<FloorVertex> floors_vertices;
+	for( unsigned int floor_or_ceiling= 0u; floor_or_ceiling < 2u; floor_or_ceiling++ )
+	{
+		floors_geometry_info[ floor_or_ceiling ].first_vertex_number= floors_vertices.size();
+
+		const unsigned char* const in_data= floor_or_ceiling == 0u ? map_data.floor_textures : map_data.ceiling_textures;
+
+		for( unsigned int x= 0u; x < MapData::c_map_size; x++ )
+		for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+		{
+			const unsigned char texture_number= in_data[ x + y * MapData::c_map_size ];
+
+			if( texture_number == MapData::c_empty_floor_texture_id ||
+				texture_number == MapData::c_sky_floor_texture_id )
+				continue;
+
+			floors_vertices.resize( floors_vertices.size() + 6u );
+			FloorVertex* v= floors_vertices.data() + floors_vertices.size() - 6u;
+
+			v[0].xy[0]= x   ;  v[0].xy[1]= y;
+			v[1].xy[0]= x+1u;  v[1].xy[1]= y;
+			v[2].xy[0]= x+1u;  v[2].xy[1]= y+1u;
+			v[3].xy[0]= x   ;  v[3].xy[1]= y+1u;
+
+			v[0].texture_id= v[1].texture_id= v[2].texture_id= v[3].texture_id= texture_number;
+			v[4]= v[0];
+			v[5]= v[2];
 		} // for xy
 
 		floors_geometry_info[ floor_or_ceiling ].vertex_count=
@@ -1125,11 +1732,51 @@ void MapDrawerGL::LoadWalls( const MapData& map_data )
 	walls_vertices.reserve( map_data.static_walls.size() * 4u );
 	walls_indeces.reserve( map_data.static_walls.size() * 6u );
 
+	// Sort walls by chunk and by texture inside chunk.
+	// High bits of key - chunk number, low bits - texture id, then wall index.
+	std::vector< std::pair<unsigned int, unsigned int> > sorted_walls;
+	sorted_walls.reserve( map_data.static_walls.size() );
 	for( const MapData::Wall& wall : map_data.static_walls )
 	{
 		if( map_data.walls_textures[ wall.texture_id ].file_path[0] == '\0' )
 			continue; // Wall has no texture - do not draw it.
 
+		const m_Vec2 center= ( wall.vert_pos[0] + wall.vert_pos[1] ) * 0.5f;
+		unsigned int chunk_xy[2];
+		for( unsigned int j= 0u; j < 2u; j++ )
+			chunk_xy[j]=
+				std::min(
+					g_walls_chunks_per_side - 1u,
+					static_cast<unsigned int>( std::max( 0.0f, center.ToArr()[j] ) ) >> g_walls_chunk_size_log2 );
+
+		const unsigned int chunk_number= chunk_xy[0] + chunk_xy[1] * g_walls_chunks_per_side;
+		sorted_walls.emplace_back(
+			( chunk_number << 8u ) | wall.texture_id,
+			static_cast<unsigned int>( &wall - map_data.static_walls.data() ) );
+	}
+	std::sort( sorted_walls.begin(), sorted_walls.end() );
+
+	walls_chunks_.clear();
+	unsigned int current_chunk_number= ~0u;
+
+	for( const std::pair<unsigned int, unsigned int>& sorted_wall : sorted_walls )
+	{
+		const MapData::Wall& wall= map_data.static_walls[ sorted_wall.second ];
+
+		const unsigned int chunk_number= sorted_wall.first >> 8u;
+		if( chunk_number != current_chunk_number )
+		{
+			current_chunk_number= chunk_number;
+			walls_chunks_.emplace_back();
+			WallsChunk& chunk= walls_chunks_.back();
+			chunk.bbox.min= chunk.bbox.max= m_Vec3( wall.vert_pos[0], 0.0f );
+			chunk.first_index= walls_indeces.size();
+			chunk.index_count= 0u;
+		}
+		WallsChunk& chunk= walls_chunks_.back();
+		chunk.bbox+= m_Vec3( wall.vert_pos[0], 0.0f );
+		chunk.bbox+= m_Vec3( wall.vert_pos[1], 2.0f );
+
 		const unsigned int first_vertex_index= walls_vertices.size();
 		walls_vertices.resize( walls_vertices.size() + 4u );
 		WallVertex* const v= walls_vertices.data() + first_vertex_index;
@@ -1151,7 +1798,7 @@ void MapDrawerGL::LoadWalls( const MapData& map_data )
 		v[2].tex_coord[1]= v[3].tex_coord[1]= 256;
 
 		map_light_.GetStaticWallLightmapCoord(
-			&wall - map_data.static_walls.data(),
+			sorted_wall.second,
 			v[0].lightmap_coord );
 
 		v[2].lightmap_coord[0]= v[0].lightmap_coord[0];
@@ -1197,6 +1844,8 @@ void MapDrawerGL::LoadWalls( const MapData& map_data )
 			ind[4]= first_vertex_index + 3u;
 			ind[5]= first_vertex_index + 2u;
 		}
+
+		chunk.index_count= walls_indeces.size() - chunk.first_index;
 	} // for walls
 
 	const auto setup_attribs=
@@ -1240,6 +1889,7 @@ void MapDrawerGL::LoadWalls( const MapData& map_data )
 
 	// Reserve place for dynamic walls geometry
 	dynamc_walls_vertices_.resize( map_data.dynamic_walls.size() * 4u );
+	uploaded_dynamic_walls_.clear(); // Upload all walls at first update.
 
 	// Prepare indeces for dynamic walls.
 	walls_indeces.clear();
@@ -1271,77 +1921,139 @@ void MapDrawerGL::LoadWalls( const MapData& map_data )
 }
 
 void MapDrawerGL::LoadModels(
+	const std::shared_ptr<const void>& models_owner,
 	const std::vector<Model>& models,
 	std::vector<ModelGeometry>& out_geometry,
 	r_PolygonBuffer& out_geometry_data,
 	AnimationsBuffer& out_animations_buffer,
-	GLuint& out_textures_array ) const
+	GLuint& out_textures_array,
+	unsigned int* const resident_content_hash ) const
 {
-	ModelsTexturesCorrector textures_corrector;
-
-	const Palette& palette= game_resources_->palette;
+	static ModelsConversionCache<PreparedModels> cache;
 
-	const unsigned int model_count= models.size();
-	out_geometry.resize( model_count );
+	const std::shared_ptr<const PreparedModels> prepared_models=
+		cache.Get(
+			models_owner, models, filter_textures_ ? 1u : 0u,
+			[this]( const std::vector<Model>& in_models, PreparedModels& out_prepared_models )
+			{
+				PrepareModels( in_models, out_prepared_models );
+			} );
 
-	const unsigned int c_texture_size[2]= { 64u, 2048u };
-	ModelsTexturesPlacement textures_placement;
-	CalculateModelsTexturesPlacement( models, c_texture_size[1], textures_placement );
+	out_geometry= prepared_models->geometry;
 
-	const unsigned int c_texels_in_layer= c_texture_size[0u] * c_texture_size[1u];
-	std::vector<unsigned char> textures_data_rgba( 4u * c_texels_in_layer * textures_placement.layer_count, 0u );
+	if( resident_content_hash != nullptr )
+	{
+		if( *resident_content_hash == prepared_models->content_hash )
+			return;
+		*resident_content_hash= prepared_models->content_hash;
+	}
 
-	std::vector<unsigned  short> indeces;
-	std::vector<Model::Vertex> vertices;
-	std::vector<Model::AnimationVertex> animations_vertices;
+	// Prepare texture.
+	glBindTexture( GL_TEXTURE_2D_ARRAY, out_textures_array );
+	glTexImage3D(
+		GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+		g_models_texture_size[0u], prepared_models->textures_layer_height, prepared_models->textures_layer_count,
+		0, GL_RGBA, GL_UNSIGNED_BYTE, prepared_models->textures_data_rgba.data() );
 
-	for( unsigned int m= 0u; m < model_count; m++ )
+	if( filter_textures_ )
 	{
-		const Model& model= models[m];
-		ModelGeometry& model_geometry= out_geometry[m];
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+	else
+	{
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
+	}
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LOD, 1 );
+	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
 
-		unsigned int model_texture_height= model.texture_size[1];
-		if( model.texture_size[1u] > c_texture_size[1u] )
-		{
-			Log::Warning( "Model texture height is too big: ", model.texture_size[1u] );
-			model_texture_height= c_texture_size[1u];
-		}
+	// Prepare animations buffer
+	if( use_2d_textures_for_animations_ )
+		out_animations_buffer= AnimationsBuffer::As2dTexture( prepared_models->animations_vertices );
+	else
+		out_animations_buffer= AnimationsBuffer::AsTextureBuffer( prepared_models->animations_vertices );
 
-		// Copy texture into atlas.
-		unsigned char* const texture_dst=
-			textures_data_rgba.data() +
-			4u * textures_placement.textures_placement[m].layer * c_texels_in_layer +
-			4u * textures_placement.textures_placement[m].y * c_texture_size[0];
-		for( unsigned int y= 0u; y < model_texture_height; y++ )
-		for( unsigned int x= 0u; x < model.texture_size[0u]; x++ )
-		{
-			const unsigned int i= ( x + y * c_texture_size[0u] ) << 2u;
-			const unsigned char color_index= model.texture_data[ x + y * model.texture_size[0u] ];
-			for( unsigned int j= 0u; j < 3u; j++ )
-				texture_dst[ i + j ]= palette[ color_index * 3u + j ];
-			texture_dst[ i + 3u ]= color_index == 0u ? 0u : 255u;
-		}
+	PrepareModelsPolygonBuffer( prepared_models->vertices, prepared_models->indeces, out_geometry_data );
+}
 
-		if( filter_textures_ )
-			textures_corrector.CorrectModelTexture( model, texture_dst );
+void MapDrawerGL::PrepareModels( const std::vector<Model>& models, PreparedModels& out_prepared_models ) const
+{
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( game_resources_->palette, 0u, palette_rgba );
+
+	const unsigned int model_count= models.size();
+	std::vector<ModelGeometry>& out_geometry= out_prepared_models.geometry;
+	out_geometry.resize( model_count );
 
-		if( model_texture_height > 0u )
+	ModelsTexturesPlacement textures_placement;
+	CalculateModelsTexturesPlacement( models, g_models_texture_size[1], textures_placement );
+	out_prepared_models.textures_layer_count= textures_placement.layer_count;
+	out_prepared_models.textures_layer_height= textures_placement.layer_height;
+	const unsigned int layer_height= textures_placement.layer_height;
+
+	const unsigned int c_texels_in_layer= g_models_texture_size[0u] * layer_height;
+	std::vector<unsigned char>& textures_data_rgba= out_prepared_models.textures_data_rgba;
+	textures_data_rgba.resize( 4u * c_texels_in_layer * textures_placement.layer_count, 0u );
+
+	std::vector<unsigned short>& indeces= out_prepared_models.indeces;
+	std::vector<Model::Vertex>& vertices= out_prepared_models.vertices;
+	std::vector<Model::AnimationVertex>& animations_vertices= out_prepared_models.animations_vertices;
+
+	// Convert textures on all threads. Textures in atlas are separated by borders, so, threads write into different texels.
+	workers_pool_.ParallelFor(
+		model_count,
+		[&]( const unsigned int m )
 		{
-			// Fill lower border
-			for( unsigned int dy= 1u; dy < std::min( textures_placement.textures_placement[m].y, 4u ); dy++ )
+			const Model& model= models[m];
+			const unsigned int model_texture_height= std::min( model.texture_size[1u], layer_height - textures_placement.textures_placement[m].y );
+
+			// Copy texture into atlas.
+			unsigned char* const texture_dst=
+				textures_data_rgba.data() +
+				4u * textures_placement.textures_placement[m].layer * c_texels_in_layer +
+				4u * textures_placement.textures_placement[m].y * g_models_texture_size[0];
+			for( unsigned int y= 0u; y < model_texture_height; y++ )
+				ConvertToRGBA(
+					model.texture_size[0u],
+					model.texture_data.data() + y * model.texture_size[0u],
+					palette_rgba,
+					texture_dst + 4u * y * g_models_texture_size[0u] );
+
+			if( filter_textures_ )
 			{
-				const unsigned char* const src= texture_dst;
-				unsigned char* const dst= texture_dst - 4u * dy * c_texture_size[0];
-				std::memcpy( dst, src, model.texture_size[0u] * 4u );
+				ModelsTexturesCorrector textures_corrector;
+				textures_corrector.CorrectModelTexture( model, texture_dst );
 			}
-			// Fill upper border
-			for( unsigned int dy= 0u; dy < 4u && textures_placement.textures_placement[m].y + model_texture_height + dy < c_texture_size[1]; dy++ )
+
+			if( model_texture_height > 0u )
 			{
-				const unsigned char* const src= texture_dst + 4u * c_texture_size[0] * ( model_texture_height - 1u );
-				unsigned char* const dst= texture_dst +  4u * c_texture_size[0] * ( model_texture_height + dy );
-				std::memcpy( dst, src, model.texture_size[0u] * 4u );
+				// Fill lower border
+				for( unsigned int dy= 1u; dy < std::min( textures_placement.textures_placement[m].y, 4u ); dy++ )
+				{
+					const unsigned char* const src= texture_dst;
+					unsigned char* const dst= texture_dst - 4u * dy * g_models_texture_size[0];
+					std::memcpy( dst, src, model.texture_size[0u] * 4u );
+				}
+				// Fill upper border
+				for( unsigned int dy= 0u; dy < 4u && textures_placement.textures_placement[m].y + model_texture_height + dy < layer_height; dy++ )
+				{
+					const unsigned char* const src= texture_dst + 4u * g_models_texture_size[0] * ( model_texture_height - 1u );
+					unsigned char* const dst= texture_dst +  4u * g_models_texture_size[0] * ( model_texture_height + dy );
+					std::memcpy( dst, src, model.texture_size[0u] * 4u );
+				}
 			}
-		}
+		} );
+
+	for( unsigned int m= 0u; m < model_count; m++ )
+	{
+		const Model& model= models[m];
+		ModelGeometry& model_geometry= out_geometry[m];
+
+		if( model.texture_size[1u] > g_models_texture_size[1u] )
+			Log::Warning( "Model texture height is too big: ", model.texture_size[1u] );
 
 		// Copy vertices, transform textures coordinates, set texture layer.
 		const unsigned int first_vertex_index= vertices.size();
@@ -1350,8 +2062,8 @@ void MapDrawerGL::LoadModels(
 
 		const float tex_coord_scaler[2u]=
 		{
-			float(model.texture_size[0u]) / float(c_texture_size[0u]),
-			float(model.texture_size[1u]) / float(c_texture_size[1u]),
+			float(model.texture_size[0u]) / float(g_models_texture_size[0u]),
+			float(model.texture_size[1u]) / float(layer_height),
 		};
 		for( unsigned int v= 0u; v < model.vertices.size(); v++ )
 		{
@@ -1361,7 +2073,7 @@ void MapDrawerGL::LoadModels(
 				vertex[v].tex_coord[j]*= tex_coord_scaler[j];
 
 			vertex[v].tex_coord[1]+=
-				float(textures_placement.textures_placement[m].y) / float(c_texture_size[1]);
+				float(textures_placement.textures_placement[m].y) / float(layer_height);
 		}
 
 		// Copy animations vertices.
@@ -1403,78 +2115,49 @@ void MapDrawerGL::LoadModels(
 
 	} // for models
 
-	// Prepare texture.
-	glBindTexture( GL_TEXTURE_2D_ARRAY, out_textures_array );
-	glTexImage3D(
-		GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-		c_texture_size[0u], c_texture_size[1u], textures_placement.layer_count,
-		0, GL_RGBA, GL_UNSIGNED_BYTE, textures_data_rgba.data() );
-
-	if( filter_textures_ )
+	// Hash data, uploaded into GPU. Geometry descriptions are copied at each load, so, do not hash them.
+	unsigned int content_hash= CombineHashes( textures_placement.layer_count, textures_placement.layer_height );
+	const auto hash_data=
+	[&]( const void* const data, const size_t data_size )
 	{
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-	}
-	else
-	{
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
-	}
-	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LOD, 1 );
-	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
-
-	// Prepare animations buffer
-	if( use_2d_textures_for_animations_ )
-		out_animations_buffer= AnimationsBuffer::As2dTexture( animations_vertices );
-	else
-		out_animations_buffer= AnimationsBuffer::AsTextureBuffer( animations_vertices );
-
-	PrepareModelsPolygonBuffer( vertices, indeces, out_geometry_data );
+		content_hash=
+			CombineHashes(
+				content_hash,
+				SaveHeader::CalculateHash( static_cast<const unsigned char*>( data ), static_cast<unsigned int>( data_size ) ) );
+	};
+	hash_data( textures_data_rgba.data(), textures_data_rgba.size() );
+	hash_data( vertices.data(), vertices.size() * sizeof(Model::Vertex) );
+	hash_data( indeces.data(), indeces.size() * sizeof(unsigned short) );
+	hash_data( animations_vertices.data(), animations_vertices.size() * sizeof(Model::AnimationVertex) );
+	out_prepared_models.content_hash= content_hash;
 }
 
 void MapDrawerGL::LoadMonstersModels()
 {
-	ModelsTexturesCorrector textures_corrector;
-
 	const std::vector<Model>& in_models= game_resources_->monsters_models;
-	const Palette& palette= game_resources_->palette;
-
-	monsters_models_.resize( in_models.size() );
 
-	std::vector<unsigned char> texture_data_rgba;
+	static ModelsConversionCache<PreparedMonstersModels> cache;
 
-	std::vector<unsigned  short> indeces;
-	std::vector<Model::Vertex> vertices;
-	std::vector<Model::AnimationVertex> animations_vertices;
+	const std::shared_ptr<const PreparedMonstersModels> prepared_models=
+		cache.Get(
+			game_resources_, in_models, filter_textures_ ? 1u : 0u,
+			[this]( const std::vector<Model>& models, PreparedMonstersModels& out_prepared_models )
+			{
+				PrepareMonstersModels( models, out_prepared_models );
+			} );
 
-	// TODO - load gibs from models.
+	monsters_models_.resize( in_models.size() );
 	for( unsigned int m= 0u; m < monsters_models_.size(); m++ )
 	{
 		const Model& in_model= in_models[m];
 		MonsterModel& out_model= monsters_models_[m];
 
 		// Prepare texture.
-		texture_data_rgba.clear();
-		texture_data_rgba.resize( in_model.texture_data.size() * 4u );
-		for( unsigned int i= 0u; i < in_model.texture_data.size(); i++ )
-		{
-			const unsigned char color_index= in_model.texture_data[i];
-			unsigned char* const out_pixel= texture_data_rgba.data() + i * 4u;
-			for( unsigned int j= 0u; j < 3u; j++ )
-				out_pixel[ j ]= palette[ color_index * 3u + j ];
-			out_pixel[ 3u ]= color_index == 0u ? 0u : 255u;
-		}
-
-		if( filter_textures_ )
-			textures_corrector.CorrectModelTexture( in_model, texture_data_rgba.data() );
-
 		out_model.texture=
 			r_Texture(
 				r_Texture::PixelFormat::RGBA8,
 				in_model.texture_size[0], in_model.texture_size[1],
-				texture_data_rgba.data() );
+				prepared_models->textures_data_rgba[m].data() );
 
 		if( filter_textures_ )
 			out_model.texture.SetFiltration( r_Texture::Filtration::LinearMipmapLinear, r_Texture::Filtration::Linear );
@@ -1482,6 +2165,69 @@ void MapDrawerGL::LoadMonstersModels()
 			out_model.texture.SetFiltration( r_Texture::Filtration::NearestMipmapLinear, r_Texture::Filtration::Nearest );
 		out_model.texture.BuildMips();
 
+		out_model.geometry_description= prepared_models->geometry[ m * 4u ];
+		for( unsigned int s= 0u; s < 3u; s++ )
+			out_model.submodels_geometry_description[s]= prepared_models->geometry[ m * 4u + 1u + s ];
+	}
+
+	// Prepare animations buffer
+	if( compress_monsters_animations_ )
+	{
+		if( use_2d_textures_for_animations_ )
+			monsters_animations_= AnimationsBuffer::As2dTexture( prepared_models->compressed_animations );
+		else
+			monsters_animations_= AnimationsBuffer::AsTextureBuffer( prepared_models->compressed_animations );
+	}
+	else
+	{
+		if( use_2d_textures_for_animations_ )
+			monsters_animations_= AnimationsBuffer::As2dTexture( prepared_models->animations_vertices );
+		else
+			monsters_animations_= AnimationsBuffer::AsTextureBuffer( prepared_models->animations_vertices );
+	}
+
+	PrepareModelsPolygonBuffer( prepared_models->vertices, prepared_models->indeces, monsters_geometry_data_ );
+}
+
+void MapDrawerGL::PrepareMonstersModels( const std::vector<Model>& in_models, PreparedMonstersModels& out_prepared_models ) const
+{
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( game_resources_->palette, 0u, palette_rgba );
+
+	// Convert textures on all threads.
+	std::vector< std::vector<unsigned char> >& textures_data_rgba= out_prepared_models.textures_data_rgba;
+	textures_data_rgba.resize( in_models.size() );
+	workers_pool_.ParallelFor(
+		in_models.size(),
+		[&]( const unsigned int m )
+		{
+			const Model& in_model= in_models[m];
+			std::vector<unsigned char>& texture_data_rgba= textures_data_rgba[m];
+
+			texture_data_rgba.resize( in_model.texture_data.size() * 4u );
+			ConvertToRGBA( in_model.texture_data.size(), in_model.texture_data.data(), palette_rgba, texture_data_rgba.data() );
+
+			if( filter_textures_ )
+			{
+				ModelsTexturesCorrector textures_corrector;
+				textures_corrector.CorrectModelTexture( in_model, texture_data_rgba.data() );
+			}
+		} );
+
+	std::vector<unsigned short>& indeces= out_prepared_models.indeces;
+	std::vector<Model::Vertex>& vertices= out_prepared_models.vertices;
+	std::vector<Model::AnimationVertex>& animations_vertices= out_prepared_models.animations_vertices;
+	std::vector<uint32_t>& compressed_animations= out_prepared_models.compressed_animations;
+	CompressedAnimations submodel_compressed_animations;
+
+	// Geometry of model and 3 submodels for each monster.
+	out_prepared_models.geometry.resize( in_models.size() * 4u );
+
+	// TODO - load gibs from models.
+	for( unsigned int m= 0u; m < in_models.size(); m++ )
+	{
+		const Model& in_model= in_models[m];
+
 		const auto prepare_geometry=
 		[&]( const Submodel& submodel, ModelGeometry& model_geometry )
 		{
@@ -1494,12 +2240,41 @@ void MapDrawerGL::LoadMonstersModels()
 				submodel.vertices.size() * sizeof(Model::Vertex) );
 
 			// Copy animations vertices.
-			const unsigned int first_animation_vertex_index= animations_vertices.size();
-			animations_vertices.resize( animations_vertices.size() + submodel.animations_vertices.size() );
-			std::memcpy(
-				animations_vertices.data() + first_animation_vertex_index,
-				submodel.animations_vertices.data(),
-				submodel.animations_vertices.size() * sizeof( Model::AnimationVertex ) );
+			unsigned int first_animation_vertex_index;
+			unsigned int animations_vertex_count;
+			if( compress_monsters_animations_ )
+			{
+				// Each frame is frame quantization (6 words) and packed vertices.
+				// Geometry frame start points to first vertex, so, shader finds quantization just before it.
+				const unsigned int c_header_words= sizeof(CompressedAnimations::FrameQuantization) / sizeof(uint32_t);
+				static_assert( c_header_words == 6u, "Shaders expect 6 words of frame quantization" );
+
+				CompressAnimations( submodel, submodel_compressed_animations );
+				animations_vertex_count= submodel_compressed_animations.vertex_count + c_header_words;
+				first_animation_vertex_index= compressed_animations.size() + c_header_words;
+
+				compressed_animations.resize( compressed_animations.size() + animations_vertex_count * submodel_compressed_animations.frames.size() );
+				uint32_t* dst= compressed_animations.data() + first_animation_vertex_index - c_header_words;
+				for( unsigned int f= 0u; f < submodel_compressed_animations.frames.size(); f++ )
+				{
+					std::memcpy( dst, &submodel_compressed_animations.frames[f], sizeof(CompressedAnimations::FrameQuantization) );
+					std::memcpy(
+						dst + c_header_words,
+						submodel_compressed_animations.vertices.data() + f * submodel_compressed_animations.vertex_count,
+						submodel_compressed_animations.vertex_count * sizeof(uint32_t) );
+					dst+= animations_vertex_count;
+				}
+			}
+			else
+			{
+				first_animation_vertex_index= animations_vertices.size();
+				animations_vertex_count= submodel.frame_count == 0u ? 0u : submodel.animations_vertices.size() / submodel.frame_count;
+				animations_vertices.resize( animations_vertices.size() + submodel.animations_vertices.size() );
+				std::memcpy(
+					animations_vertices.data() + first_animation_vertex_index,
+					submodel.animations_vertices.data(),
+					submodel.animations_vertices.size() * sizeof( Model::AnimationVertex ) );
+			}
 
 			// Copy indeces.
 			const unsigned int first_index= indeces.size();
@@ -1518,7 +2293,7 @@ void MapDrawerGL::LoadMonstersModels()
 
 			// Setup geometry info.
 			model_geometry.frame_count= submodel.frame_count;
-			model_geometry.animations_vertex_count= submodel.frame_count == 0u ? 0u : submodel.animations_vertices.size() / submodel.frame_count;
+			model_geometry.animations_vertex_count= animations_vertex_count;
 			model_geometry.first_animations_vertex= first_animation_vertex_index;
 
 			model_geometry.vertex_count= submodel.vertices.size();
@@ -1531,34 +2306,64 @@ void MapDrawerGL::LoadMonstersModels()
 			model_geometry.transparent_index_count= submodel.transparent_triangles_indeces.size();
 		};
 
-		prepare_geometry( in_model, out_model.geometry_description );
+		prepare_geometry( in_model, out_prepared_models.geometry[ m * 4u ] );
 
 		PC_ASSERT( in_model.submodels.size() == 3u );
 		for( unsigned int s= 0u; s < 3u; s++ )
 		{
-			prepare_geometry( in_model.submodels[s], out_model.submodels_geometry_description[s] );
+			prepare_geometry( in_model.submodels[s], out_prepared_models.geometry[ m * 4u + 1u + s ] );
 		}
 	}
-
-	// Prepare animations buffer
-	if( use_2d_textures_for_animations_ )
-		monsters_animations_= AnimationsBuffer::As2dTexture( animations_vertices );
-	else
-		monsters_animations_= AnimationsBuffer::AsTextureBuffer( animations_vertices );
-
-	PrepareModelsPolygonBuffer( vertices, indeces, monsters_geometry_data_ );
 }
 
 void MapDrawerGL::UpdateDynamicWalls( const MapState::DynamicWalls& dynamic_walls )
 {
 	PC_ASSERT( current_map_data_->dynamic_walls.size() == dynamic_walls.size() );
 
+	// Usually only few walls move, so write and upload only changed walls.
+	// Contiguous ranges of changed walls are uploaded together.
+	const bool upload_all= uploaded_dynamic_walls_.size() != dynamic_walls.size();
+	uploaded_dynamic_walls_.resize( dynamic_walls.size() );
+	dynamic_walls_uploaded_in_frame_= 0u;
+
+	unsigned int dirty_walls_begin= 0u, dirty_walls_end= 0u;
+	const auto upload_dirty_walls=
+	[&]()
+	{
+		if( dirty_walls_begin == dirty_walls_end )
+			return;
+
+		dynamic_walls_geometry_.VertexSubData(
+			dynamc_walls_vertices_.data() + dirty_walls_begin * 4u,
+			( dirty_walls_end - dirty_walls_begin ) * 4u * sizeof(WallVertex),
+			dirty_walls_begin * 4u * sizeof(WallVertex) );
+
+		dynamic_walls_uploaded_in_frame_+= dirty_walls_end - dirty_walls_begin;
+		dirty_walls_begin= dirty_walls_end= 0u;
+	};
+
 	for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
 	{
 		const MapData::Wall& map_wall= current_map_data_->dynamic_walls[w];
 		const MapState::DynamicWall wall= dynamic_walls[w];
 		// TODO - discard walls without textures.
 
+		MapState::DynamicWall& uploaded_wall= uploaded_dynamic_walls_[w];
+		if( !upload_all &&
+			uploaded_wall.vert_pos[0] == wall.vert_pos[0] &&
+			uploaded_wall.vert_pos[1] == wall.vert_pos[1] &&
+			uploaded_wall.texture_id == wall.texture_id &&
+			uploaded_wall.z == wall.z )
+		{
+			upload_dirty_walls();
+			continue;
+		}
+		uploaded_wall= wall;
+
+		if( dirty_walls_begin == dirty_walls_end )
+			dirty_walls_begin= w;
+		dirty_walls_end= w + 1u;
+
 		WallVertex* const v= dynamc_walls_vertices_.data() + w * 4u;
 
 		v[0].xyz[0]= v[2].xyz[0]= short( wall.vert_pos[0].x * 256.0f );
@@ -1599,21 +2404,49 @@ void MapDrawerGL::UpdateDynamicWalls( const MapState::DynamicWalls& dynamic_wall
 		}
 	}
 
-	dynamic_walls_geometry_.VertexSubData(
-		dynamc_walls_vertices_.data(),
-		dynamc_walls_vertices_.size() * sizeof(WallVertex),
-		0u );
+	upload_dirty_walls();
 }
 
 void MapDrawerGL::PrepareModelsPolygonBuffer(
-	std::vector<Model::Vertex>& vertices,
-	std::vector<unsigned short>& indeces,
+	const std::vector<Model::Vertex>& vertices,
+	const std::vector<unsigned short>& indeces,
 	r_PolygonBuffer& buffer )
 {
-	buffer.VertexData(
-		vertices.data(),
-		vertices.size() * sizeof(Model::Vertex),
-		sizeof(Model::Vertex) );
+	bool can_pack= true;
+	for( const Model::Vertex& vertex : vertices )
+	for( unsigned int j= 0u; j < 2u; j++ )
+	{
+		if( !( vertex.tex_coord[j] >= 0.0f && vertex.tex_coord[j] <= 1.0f ) )
+			can_pack= false;
+	}
+
+	if( can_pack )
+	{
+		std::vector<PackedModelVertex> packed_vertices( vertices.size() );
+		for( unsigned int i= 0u; i < vertices.size(); i++ )
+		{
+			const Model::Vertex& in_v= vertices[i];
+			PackedModelVertex& out_v= packed_vertices[i];
+
+			for( unsigned int j= 0u; j < 2u; j++ )
+				out_v.tex_coord[j]= static_cast<unsigned short>( in_v.tex_coord[j] * 65535.0f + 0.5f );
+			out_v.vertex_id= in_v.vertex_id;
+			out_v.texture_id= in_v.texture_id;
+			out_v.alpha_test_mask= in_v.alpha_test_mask;
+			out_v.groups_mask= in_v.groups_mask;
+			out_v.reserved[0]= out_v.reserved[1]= out_v.reserved[2]= 0u;
+		}
+
+		buffer.VertexData(
+			packed_vertices.data(),
+			packed_vertices.size() * sizeof(PackedModelVertex),
+			sizeof(PackedModelVertex) );
+	}
+	else
+		buffer.VertexData(
+			vertices.data(),
+			vertices.size() * sizeof(Model::Vertex),
+			sizeof(Model::Vertex) );
 
 	buffer.IndexData(
 		indeces.data(),
@@ -1621,29 +2454,530 @@ void MapDrawerGL::PrepareModelsPolygonBuffer(
 		GL_UNSIGNED_SHORT,
 		GL_TRIANGLES );
 
-	Model::Vertex v;
-	buffer.VertexAttribPointerInt(
-		0, 1, GL_UNSIGNED_SHORT,
-		((char*)&v.vertex_id) - ((char*)&v) );
+	if( can_pack )
+	{
+		buffer.VertexAttribPointerInt(
+			0, 1, GL_UNSIGNED_SHORT,
+			offsetof( PackedModelVertex, vertex_id ) );
 
-	buffer.VertexAttribPointer(
-		1, 3, GL_FLOAT, false,
-		((char*)v.tex_coord) - ((char*)&v) );
+		buffer.VertexAttribPointer(
+			1, 2, GL_UNSIGNED_SHORT, true,
+			offsetof( PackedModelVertex, tex_coord ) );
 
-	buffer.VertexAttribPointerInt(
-		2, 1, GL_UNSIGNED_BYTE,
-		((char*)&v.texture_id) - ((char*)&v) );
+		buffer.VertexAttribPointerInt(
+			2, 1, GL_UNSIGNED_BYTE,
+			offsetof( PackedModelVertex, texture_id ) );
 
-	buffer.VertexAttribPointer(
-		3, 1, GL_UNSIGNED_BYTE, true,
-		((char*)&v.alpha_test_mask) - ((char*)&v) );
+		buffer.VertexAttribPointer(
+			3, 1, GL_UNSIGNED_BYTE, true,
+			offsetof( PackedModelVertex, alpha_test_mask ) );
 
-	buffer.VertexAttribPointerInt(
-		4, 1, GL_UNSIGNED_BYTE,
-		((char*)&v.groups_mask) - ((char*)&v) );
+		buffer.VertexAttribPointerInt(
+			4, 1, GL_UNSIGNED_BYTE,
+			offsetof( PackedModelVertex, groups_mask ) );
+	}
+	else
+	{
+		Model::Vertex v;
+		buffer.VertexAttribPointerInt(
+			0, 1, GL_UNSIGNED_SHORT,
+			((char*)&v.vertex_id) - ((char*)&v) );
+
+		buffer.VertexAttribPointer(
+			1, 2, GL_FLOAT, false,
+			((char*)v.tex_coord) - ((char*)&v) );
+
+		buffer.VertexAttribPointerInt(
+			2, 1, GL_UNSIGNED_BYTE,
+			((char*)&v.texture_id) - ((char*)&v) );
+
+		buffer.VertexAttribPointer(
+			3, 1, GL_UNSIGNED_BYTE, true,
+			((char*)&v.alpha_test_mask) - ((char*)&v) );
+
+		buffer.VertexAttribPointerInt(
+			4, 1, GL_UNSIGNED_BYTE,
+			((char*)&v.groups_mask) - ((char*)&v) );
+	}
 }
 
-void MapDrawerGL::DrawWalls( const m_Mat4& view_matrix )
+void MapDrawerGL::FillModelInstanceTransform(
+	const m_Mat4& model_matrix,
+	const m_Mat4& rotation_matrix,
+	const m_Mat3& lightmap_matrix,
+	ModelInstanceTransform& out_transform )
+{
+	std::memcpy( out_transform.model_matrix, model_matrix.value, sizeof(out_transform.model_matrix) );
+	// Take only rotation part of matrix.
+	for( unsigned int i= 0u; i < 3u; i++ )
+	for( unsigned int j= 0u; j < 3u; j++ )
+		out_transform.rotation_matrix[ i * 3u + j ]= rotation_matrix.value[ i * 4u + j ];
+	std::memcpy( out_transform.lightmap_matrix, lightmap_matrix.value, sizeof(out_transform.lightmap_matrix) );
+}
+
+void MapDrawerGL::SetInstanceTransformAttribs( const std::size_t offset, const unsigned int stride )
+{
+	const auto column_offset=
+	[offset]( const std::size_t field_offset, const unsigned int column, const unsigned int column_size ) -> void*
+	{
+		return reinterpret_cast<void*>( offset + field_offset + column * column_size * sizeof(float) );
+	};
+
+	for( unsigned int i= 0u; i < 4u; i++ )
+		glVertexAttribPointer(
+			g_instance_model_matrix_attrib + i, 4, GL_FLOAT, GL_FALSE, stride,
+			column_offset( offsetof( ModelInstanceTransform, model_matrix ), i, 4u ) );
+	for( unsigned int i= 0u; i < 3u; i++ )
+		glVertexAttribPointer(
+			g_instance_rotation_matrix_attrib + i, 3, GL_FLOAT, GL_FALSE, stride,
+			column_offset( offsetof( ModelInstanceTransform, rotation_matrix ), i, 3u ) );
+	for( unsigned int i= 0u; i < 3u; i++ )
+		glVertexAttribPointer(
+			g_instance_lightmap_matrix_attrib + i, 3, GL_FLOAT, GL_FALSE, stride,
+			column_offset( offsetof( ModelInstanceTransform, lightmap_matrix ), i, 3u ) );
+}
+
+void MapDrawerGL::SetInstanceParamsAttrib( const std::size_t offset, const unsigned int stride )
+{
+	glVertexAttribIPointer(
+		g_instance_params_attrib, 4, GL_INT, stride,
+		reinterpret_cast<void*>( offset ) );
+}
+
+void MapDrawerGL::SetInstanceAttribsEnabled( const bool enabled )
+{
+	for( GLuint i= g_instance_model_matrix_attrib; i <= g_instance_params_attrib; i++ )
+	{
+		if( enabled )
+			glEnableVertexAttribArray( i );
+		else
+			glDisableVertexAttribArray( i );
+		glVertexAttribDivisor( i, enabled ? 1u : 0u );
+	}
+}
+
+void MapDrawerGL::SetSpriteInstanceAttribsEnabled( const bool enabled )
+{
+	for( GLuint i= g_sprite_instance_model_matrix_attrib; i <= g_sprite_instance_tex_coord_scale_attrib; i++ )
+	{
+		if( enabled )
+			glEnableVertexAttribArray( i );
+		else
+			glDisableVertexAttribArray( i );
+		glVertexAttribDivisor( i, enabled ? 1u : 0u );
+	}
+}
+
+void MapDrawerGL::FillModelInstance(
+	const m_Mat4& model_matrix,
+	const m_Mat4& rotation_matrix,
+	const m_Mat3& lightmap_matrix,
+	const unsigned int first_animation_vertex,
+	const unsigned int groups_mask,
+	const unsigned int next_animation_vertex,
+	const float animation_lerp,
+	ModelInstance& out_instance )
+{
+	FillModelInstanceTransform( model_matrix, rotation_matrix, lightmap_matrix, out_instance.transform );
+	out_instance.params.first_animation_vertex= int(first_animation_vertex);
+	out_instance.params.groups_mask= int(groups_mask);
+	out_instance.params.next_animation_vertex= int(next_animation_vertex);
+	out_instance.params.animation_lerp= static_cast<int>( animation_lerp * 65536.0f );
+}
+
+void MapDrawerGL::AddModelInstance( const unsigned int batch_key, const ModelInstance& instance )
+{
+	models_instances_.push_back( instance );
+
+	ModelInstanceBatchItem batch_item;
+	batch_item.batch_key= batch_key;
+	batch_item.instance_index= models_instances_.size() - 1u;
+	models_instances_batch_items_.push_back( batch_item );
+}
+
+void MapDrawerGL::AddTransparentModelInstance(
+	const ModelsKind kind,
+	const unsigned int batch_key,
+	const float depth,
+	const ModelInstance& instance )
+{
+	transparent_models_instances_.emplace_back();
+	TransparentModelInstance& transparent_instance= transparent_models_instances_.back();
+	transparent_instance.instance= instance;
+	transparent_instance.depth= depth;
+	transparent_instance.kind= kind;
+	transparent_instance.batch_key= batch_key;
+}
+
+void MapDrawerGL::BindModelsKind( const ModelsKind kind )
+{
+	switch( kind )
+	{
+	case ModelsKind::Items:
+	case ModelsKind::DynamicItems:
+		models_instanced_shader_.Bind();
+		items_geometry_data_.Bind();
+		glActiveTexture( GL_TEXTURE0 + 0 );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, items_textures_array_id_ );
+		active_lightmap_->Bind(1);
+		items_animations_.Bind( 2 );
+		break;
+
+	case ModelsKind::Monsters:
+	case ModelsKind::InvisibleMonsters:
+	case ModelsKind::MonstersBodyParts:
+		monsters_shader_.Bind();
+		monsters_geometry_data_.Bind();
+		active_lightmap_->Bind(1);
+		monsters_animations_.Bind(2);
+		break;
+
+	case ModelsKind::Rockets:
+		models_instanced_shader_.Bind();
+		rockets_geometry_data_.Bind();
+		glActiveTexture( GL_TEXTURE0 + 0 );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, rockets_textures_array_id_ );
+		rockets_animations_.Bind( 2 );
+		break;
+
+	case ModelsKind::Gibs:
+		models_instanced_shader_.Bind();
+		gibs_geometry_data_.Bind();
+		glActiveTexture( GL_TEXTURE0 + 0 );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, gibs_textures_array_id_ );
+		active_lightmap_->Bind(1);
+		gibs_animations_.Bind( 2 );
+		break;
+	};
+}
+
+const MapDrawerGL::ModelGeometry& MapDrawerGL::SetupModelsBatch( const ModelsKind kind, const unsigned int batch_key )
+{
+	switch( kind )
+	{
+	case ModelsKind::Items:
+		return items_geometry_[ batch_key ];
+
+	case ModelsKind::DynamicItems:
+		// Lowest bit of batch key - fullbright flag.
+		( ( batch_key & 1u ) != 0u ? map_light_.GetFullbrightLightmapDummy() : *active_lightmap_ ).Bind(1);
+		return items_geometry_[ batch_key >> 1u ];
+
+	case ModelsKind::Monsters:
+	case ModelsKind::InvisibleMonsters:
+		{
+			// Players have different textures for different colors. Lowest byte of batch key - player color.
+			const unsigned int monster_id= batch_key >> 8u;
+			const MonsterModel& monster_model= monsters_models_[ monster_id ];
+
+			if( monster_id == 0u )
+				GetPlayerTexture( static_cast<unsigned char>( batch_key & 255u ) ).Bind(0);
+			else
+				monster_model.texture.Bind(0);
+
+			return monster_model.geometry_description;
+		}
+
+	case ModelsKind::MonstersBodyParts:
+		{
+			const MonsterModel& monster_model= monsters_models_[ batch_key / 3u ];
+			monster_model.texture.Bind(0);
+			return monster_model.submodels_geometry_description[ batch_key % 3u ];
+		}
+
+	case ModelsKind::Rockets:
+		if( game_resources_->rockets_description[ batch_key ].fullbright )
+			map_light_.GetFullbrightLightmapDummy().Bind(1);
+		else
+			active_lightmap_->Bind(1);
+		return rockets_geometry_[ batch_key ];
+
+	case ModelsKind::Gibs:
+		break;
+	};
+
+	return gibs_geometry_[ batch_key ];
+}
+
+void MapDrawerGL::FlushModelsInstances( const ModelsKind kind )
+{
+	if( models_instances_batch_items_.empty() )
+		return;
+
+	std::sort(
+		models_instances_batch_items_.begin(),
+		models_instances_batch_items_.end(),
+		[]( const ModelInstanceBatchItem& a, const ModelInstanceBatchItem& b )
+		{
+			if( a.batch_key != b.batch_key )
+				return a.batch_key < b.batch_key;
+			return a.instance_index < b.instance_index;
+		} );
+
+	models_instances_sorted_.resize( models_instances_batch_items_.size() );
+	for( unsigned int i= 0u; i < models_instances_batch_items_.size(); i++ )
+		models_instances_sorted_[i]= models_instances_[ models_instances_batch_items_[i].instance_index ];
+
+	glBindBuffer( GL_ARRAY_BUFFER, models_instances_buffer_id_ );
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		models_instances_sorted_.size() * sizeof(ModelInstance),
+		models_instances_sorted_.data(),
+		GL_STREAM_DRAW );
+
+	SetInstanceAttribsEnabled( true );
+
+	unsigned int batch_begin= 0u;
+	while( batch_begin < models_instances_batch_items_.size() )
+	{
+		const unsigned int batch_key= models_instances_batch_items_[ batch_begin ].batch_key;
+		unsigned int batch_end= batch_begin + 1u;
+		while( batch_end < models_instances_batch_items_.size() &&
+			models_instances_batch_items_[ batch_end ].batch_key == batch_key )
+			batch_end++;
+
+		const ModelGeometry& model_geometry= SetupModelsBatch( kind, batch_key );
+
+		// There is no "base instance" in OpenGL 3.3, so, point instance attributes to first instance of batch.
+		const std::size_t batch_offset= batch_begin * sizeof(ModelInstance);
+		SetInstanceTransformAttribs( batch_offset + offsetof( ModelInstance, transform ), sizeof(ModelInstance) );
+		SetInstanceParamsAttrib( batch_offset + offsetof( ModelInstance, params ), sizeof(ModelInstance) );
+
+		glDrawElementsInstancedBaseVertex(
+			GL_TRIANGLES,
+			model_geometry.index_count,
+			GL_UNSIGNED_SHORT,
+			reinterpret_cast<void*>( model_geometry.first_index * sizeof(unsigned short) ),
+			batch_end - batch_begin,
+			model_geometry.first_vertex_index );
+
+		models_draw_calls_in_frame_++;
+		batch_begin= batch_end;
+	}
+
+	SetInstanceAttribsEnabled( false );
+
+	models_instances_in_frame_+= models_instances_batch_items_.size();
+	models_instances_.clear();
+	models_instances_batch_items_.clear();
+}
+
+void MapDrawerGL::DrawTransparentModels()
+{
+	if( transparent_models_instances_.empty() )
+		return;
+
+	// Transparent models are drawn without depth-write, so, draw them back to front.
+	// Stable sort keeps order of parts of same entity.
+	std::stable_sort(
+		transparent_models_instances_.begin(),
+		transparent_models_instances_.end(),
+		[]( const TransparentModelInstance& a, const TransparentModelInstance& b )
+		{
+			return a.depth > b.depth;
+		} );
+
+	models_instances_sorted_.resize( transparent_models_instances_.size() );
+	for( unsigned int i= 0u; i < transparent_models_instances_.size(); i++ )
+		models_instances_sorted_[i]= transparent_models_instances_[i].instance;
+
+	glBindBuffer( GL_ARRAY_BUFFER, models_instances_buffer_id_ );
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		models_instances_sorted_.size() * sizeof(ModelInstance),
+		models_instances_sorted_.data(),
+		GL_STREAM_DRAW );
+
+	// Neighbor instances with same kind and batch key are drawn with one call.
+	// Shader, geometry and textures are rebound only if kind is changed.
+	bool kind_bound= false;
+	ModelsKind bound_kind= ModelsKind::Items;
+
+	unsigned int batch_begin= 0u;
+	while( batch_begin < transparent_models_instances_.size() )
+	{
+		const ModelsKind kind= transparent_models_instances_[ batch_begin ].kind;
+		const unsigned int batch_key= transparent_models_instances_[ batch_begin ].batch_key;
+		unsigned int batch_end= batch_begin + 1u;
+		while( batch_end < transparent_models_instances_.size() &&
+			transparent_models_instances_[ batch_end ].kind == kind &&
+			transparent_models_instances_[ batch_end ].batch_key == batch_key )
+			batch_end++;
+
+		if( !kind_bound || kind != bound_kind )
+		{
+			// Instance attributes are state of vertex array object of geometry.
+			if( kind_bound )
+				SetInstanceAttribsEnabled( false );
+			BindModelsKind( kind );
+			SetInstanceAttribsEnabled( true );
+			glBindBuffer( GL_ARRAY_BUFFER, models_instances_buffer_id_ );
+
+			kind_bound= true;
+			bound_kind= kind;
+		}
+
+		const ModelGeometry& model_geometry= SetupModelsBatch( kind, batch_key );
+
+		// Invisible monsters are drawn in this pass with all polygons.
+		const bool regular_polygons= kind == ModelsKind::InvisibleMonsters;
+		const unsigned int index_count= regular_polygons ? model_geometry.index_count : model_geometry.transparent_index_count;
+		const unsigned int first_index= regular_polygons ? model_geometry.first_index : model_geometry.first_transparent_index;
+
+		const std::size_t batch_offset= batch_begin * sizeof(ModelInstance);
+		SetInstanceTransformAttribs( batch_offset + offsetof( ModelInstance, transform ), sizeof(ModelInstance) );
+		SetInstanceParamsAttrib( batch_offset + offsetof( ModelInstance, params ), sizeof(ModelInstance) );
+
+		glDrawElementsInstancedBaseVertex(
+			GL_TRIANGLES,
+			index_count,
+			GL_UNSIGNED_SHORT,
+			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
+			batch_end - batch_begin,
+			model_geometry.first_vertex_index );
+
+		models_draw_calls_in_frame_++;
+		batch_begin= batch_end;
+	}
+
+	SetInstanceAttribsEnabled( false );
+
+	models_instances_in_frame_+= transparent_models_instances_.size();
+	transparent_models_instances_.clear();
+}
+
+void MapDrawerGL::PrepareStaticModels( const MapState& map_state, const ViewClipPlanes& view_clip_planes )
+{
+	const MapState::StaticModels& static_models= map_state.GetStaticModels();
+
+	// Static models may be moved or replaced by map procedures, but this happens rarely.
+	bool layout_changed= static_models.size() != static_models_instances_source_.size();
+	bool transforms_changed= layout_changed;
+	for( unsigned int i= 0u; i < static_models.size() && !layout_changed; i++ )
+	{
+		const MapState::StaticModel& static_model= static_models[i];
+		const MapState::StaticModel& source_model= static_models_instances_source_[i];
+		if( static_model.model_id != source_model.model_id )
+			layout_changed= true;
+		if( static_model.pos != source_model.pos || static_model.angle != source_model.angle )
+			transforms_changed= true;
+	}
+
+	if( layout_changed )
+	{
+		// Place instances with same model together, one batch for each model.
+		static_models_batches_.clear();
+		static_models_instances_indeces_.resize( static_models.size() );
+
+		std::vector<unsigned int> sorted_static_models;
+		for( unsigned int i= 0u; i < static_models.size(); i++ )
+			if( static_models[i].model_id < models_geometry_.size() )
+				sorted_static_models.push_back(i);
+
+		std::stable_sort(
+			sorted_static_models.begin(),
+			sorted_static_models.end(),
+			[&static_models]( const unsigned int a, const unsigned int b )
+			{
+				return static_models[a].model_id < static_models[b].model_id;
+			} );
+
+		for( unsigned int i= 0u; i < sorted_static_models.size(); i++ )
+		{
+			const unsigned int model_id= static_models[ sorted_static_models[i] ].model_id;
+			if( static_models_batches_.empty() || static_models_batches_.back().model_id != model_id )
+			{
+				static_models_batches_.emplace_back();
+				StaticModelsBatch& batch= static_models_batches_.back();
+				batch.model_id= model_id;
+				batch.first_instance= i;
+				batch.instance_count= 0u;
+				batch.visible_instance_count= 0u;
+			}
+
+			static_models_batches_.back().instance_count++;
+			static_models_instances_indeces_[ sorted_static_models[i] ]= i;
+		}
+
+		static_models_instances_params_.resize( sorted_static_models.size() );
+	}
+
+	if( transforms_changed )
+	{
+		static_models_instances_source_= static_models;
+		static_models_matrices_.resize( static_models.size() );
+
+		std::vector<ModelInstanceTransform> transforms( static_models_instances_params_.size() );
+		for( unsigned int i= 0u; i < static_models.size(); i++ )
+		{
+			const MapState::StaticModel& static_model= static_models[i];
+			if( static_model.model_id >= models_geometry_.size() )
+				continue;
+
+			m_Mat4 rotation_matrix;
+			m_Mat3 lightmap_matrix;
+			CreateModelMatrices( static_model.pos, static_model.angle, static_models_matrices_[i], lightmap_matrix );
+			rotation_matrix.RotateZ( static_model.angle );
+
+			FillModelInstanceTransform(
+				static_models_matrices_[i], rotation_matrix, lightmap_matrix,
+				transforms[ static_models_instances_indeces_[i] ] );
+		}
+
+		glBindBuffer( GL_ARRAY_BUFFER, static_models_transforms_buffer_id_ );
+		glBufferData(
+			GL_ARRAY_BUFFER,
+			transforms.size() * sizeof(ModelInstanceTransform),
+			transforms.data(),
+			GL_STATIC_DRAW );
+	}
+
+	// Each frame rewrite only visibility and animation frames.
+	for( unsigned int i= 0u; i < static_models.size(); i++ )
+	{
+		const MapState::StaticModel& static_model= static_models[i];
+		if( static_model.model_id >= models_geometry_.size() )
+			continue;
+
+		const ModelGeometry& model_geometry= models_geometry_[ static_model.model_id ];
+		const Model& model= current_map_data_->models[ static_model.model_id ];
+
+		PC_ASSERT( static_model.animation_frame < model.frame_count );
+
+		const unsigned int instance_index= static_models_instances_indeces_[i];
+		ModelInstanceParams& params= static_models_instances_params_[ instance_index ];
+
+		params.first_animation_vertex=
+			int( model_geometry.first_animations_vertex +
+			model_geometry.animations_vertex_count * static_model.animation_frame );
+		// Frames of static models come from server, so, there is nothing to interpolate.
+		params.next_animation_vertex= params.first_animation_vertex;
+		params.animation_lerp= 0;
+
+		const m_BBox3& bbox= model.animations_bboxes[ static_model.animation_frame ];
+		const bool visible=
+			static_model.visible &&
+			!ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ static_model.animation_frame ], bbox, static_models_matrices_[i] );
+		params.groups_mask= visible ? 255 : 0;
+	}
+
+	for( StaticModelsBatch& batch : static_models_batches_ )
+	{
+		batch.visible_instance_count= 0u;
+		for( unsigned int i= batch.first_instance; i < batch.first_instance + batch.instance_count; i++ )
+			if( static_models_instances_params_[i].groups_mask != 0 )
+				batch.visible_instance_count++;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, static_models_params_buffer_id_ );
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		static_models_instances_params_.size() * sizeof(ModelInstanceParams),
+		static_models_instances_params_.data(),
+		GL_STREAM_DRAW );
+}
+
+void MapDrawerGL::DrawWalls( const ViewClipPlanes& view_clip_planes )
 {
 	walls_shader_.Bind();
 
@@ -1652,23 +2986,49 @@ void MapDrawerGL::DrawWalls( const m_Mat4& view_matrix )
 	//active_lightmap_->Bind(1);
 	map_light_.GetWallsLightmap().Bind(1);
 
-	walls_shader_.Uniform( "tex", int(0) );
-	walls_shader_.Uniform( "lightmap", int(1) );
+	// Cull chunks of static walls and draw visible chunks by one call.
+	// Ranges of adjacent visible chunks are merged.
+	m_Mat4 identity_mat;
+	identity_mat.Identity();
+
+	walls_draw_index_counts_.clear();
+	walls_draw_index_offsets_.clear();
+	walls_chunks_drawn_in_frame_= 0u;
+	unsigned int prev_chunk_end= ~0u;
+	for( const WallsChunk& chunk : walls_chunks_ )
+	{
+		if( BBoxIsOutsideView( view_clip_planes, chunk.bbox, identity_mat ) )
+			continue;
 
-	m_Mat4 scale_mat;
-	scale_mat.Scale( 1.0f / 256.0f );
-	walls_shader_.Uniform( "view_matrix", scale_mat * view_matrix );
+		walls_chunks_drawn_in_frame_++;
+		if( chunk.first_index == prev_chunk_end )
+			walls_draw_index_counts_.back()+= GLsizei(chunk.index_count);
+		else
+		{
+			walls_draw_index_counts_.push_back( GLsizei(chunk.index_count) );
+			walls_draw_index_offsets_.push_back( reinterpret_cast<const GLvoid*>( chunk.first_index * sizeof(unsigned short) ) );
+		}
+		prev_chunk_end= chunk.first_index + chunk.index_count;
+	}
 
 	r_OGLStateManager::UpdateState( g_static_walls_gl_state );
-	walls_geometry_.Bind();
-	walls_geometry_.Draw();
+	if( !walls_draw_index_counts_.empty() )
+	{
+		walls_geometry_.Bind();
+		glMultiDrawElements(
+			GL_TRIANGLES,
+			walls_draw_index_counts_.data(),
+			GL_UNSIGNED_SHORT,
+			walls_draw_index_offsets_.data(),
+			GLsizei(walls_draw_index_counts_.size()) );
+	}
 
 	r_OGLStateManager::UpdateState( g_dynamic_walls_gl_state );
 	dynamic_walls_geometry_.Bind();
 	dynamic_walls_geometry_.Draw();
 }
 
-void MapDrawerGL::DrawFloors( const m_Mat4& view_matrix )
+void MapDrawerGL::DrawFloors()
 {
 	floors_geometry_.Bind();
 	floors_shader_.Bind();
@@ -1677,11 +3037,6 @@ void MapDrawerGL::DrawFloors( const m_Mat4& view_matrix )
 	glBindTexture( GL_TEXTURE_2D_ARRAY, floor_textures_array_id_ );
 	active_lightmap_->Bind(1);
 
-	floors_shader_.Uniform( "tex", int(0) );
-	floors_shader_.Uniform( "lightmap", int(1) );
-
-	floors_shader_.Uniform( "view_matrix", view_matrix );
-
 	for( unsigned int z= 0u; z < 2u; z++ )
 	{
 		floors_shader_.Uniform( "pos_z", float(z) * 2.0f );
@@ -1693,85 +3048,58 @@ void MapDrawerGL::DrawFloors( const m_Mat4& view_matrix )
 	}
 }
 
-void MapDrawerGL::DrawModels(
-	const MapState& map_state,
-	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	const bool transparent )
+void MapDrawerGL::DrawModels( const bool transparent )
 {
 	models_geometry_data_.Bind();
-	models_shader_.Bind();
+	models_instanced_shader_.Bind();
 
 	glActiveTexture( GL_TEXTURE0 + 0 );
 	glBindTexture( GL_TEXTURE_2D_ARRAY, models_textures_array_id_ );
 	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
 
 	models_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
 
-	for( const MapState::StaticModel& static_model : map_state.GetStaticModels() )
+	SetInstanceAttribsEnabled( true );
+
+	for( const StaticModelsBatch& batch : static_models_batches_ )
 	{
-		if( static_model.model_id >= models_geometry_.size() ||
-			!static_model.visible )
+		if( batch.visible_instance_count == 0u )
 			continue;
 
-		const ModelGeometry& model_geometry= models_geometry_[ static_model.model_id ];
-		const Model& model= current_map_data_->models[ static_model.model_id ];
+		const ModelGeometry& model_geometry= models_geometry_[ batch.model_id ];
 
 		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
 		if( index_count == 0u )
 			continue;
 
 		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
-		const unsigned int first_animation_vertex=
-			model_geometry.first_animations_vertex +
-			model_geometry.animations_vertex_count * static_model.animation_frame;
-
-		m_Mat4 model_matrix, rotation_matrix;
-		m_Mat3 lightmap_matrix;
-		CreateModelMatrices( static_model.pos, static_model.angle, model_matrix, lightmap_matrix );
-		rotation_matrix.RotateZ( static_model.angle );
-
-		PC_ASSERT( static_model.animation_frame < model.frame_count );
-
-		const m_BBox3& bbox= model.animations_bboxes[ static_model.animation_frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
-			continue;
 
-		models_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		models_shader_.Uniform( "lightmap_matrix", lightmap_matrix );
-		models_shader_.Uniform( "rotation_matrix", rotation_matrix );
-		models_shader_.Uniform( "first_animation_vertex_number", int(first_animation_vertex) );
+		// Culled instances are drawn too, but vertex shader moves them outside clip volume.
+		glBindBuffer( GL_ARRAY_BUFFER, static_models_transforms_buffer_id_ );
+		SetInstanceTransformAttribs( batch.first_instance * sizeof(ModelInstanceTransform), sizeof(ModelInstanceTransform) );
+		glBindBuffer( GL_ARRAY_BUFFER, static_models_params_buffer_id_ );
+		SetInstanceParamsAttrib( batch.first_instance * sizeof(ModelInstanceParams), sizeof(ModelInstanceParams) );
 
-		glDrawElementsBaseVertex(
+		glDrawElementsInstancedBaseVertex(
 			GL_TRIANGLES,
 			index_count,
 			GL_UNSIGNED_SHORT,
 			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
+			batch.instance_count,
 			model_geometry.first_vertex_index );
-	}
-}
 
-void MapDrawerGL::DrawItems(
-	const MapState& map_state,
-	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	const bool transparent )
-{
-	items_geometry_data_.Bind();
-	models_shader_.Bind();
-
-	glActiveTexture( GL_TEXTURE0 + 0 );
-	glBindTexture( GL_TEXTURE_2D_ARRAY, items_textures_array_id_ );
-	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
+		models_instances_in_frame_+= batch.visible_instance_count;
+		models_draw_calls_in_frame_++;
+	}
 
-	items_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
+	SetInstanceAttribsEnabled( false );
+}
 
+void MapDrawerGL::DrawItems(
+	const MapState& map_state,
+	const m_Mat4& view_matrix,
+	const ViewClipPlanes& view_clip_planes )
+{
 	for( const MapState::Item& item : map_state.GetItems() )
 	{
 		if( item.picked_up || item.item_id >= items_geometry_.size() )
@@ -1780,14 +3108,15 @@ void MapDrawerGL::DrawItems(
 		const ModelGeometry& model_geometry= items_geometry_[ item.item_id ];
 		const Model& model= game_resources_->items_models[ item.item_id ];
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animation_vertex=
 			model_geometry.first_animations_vertex +
 			model_geometry.animations_vertex_count * item.animation_frame;
+		const unsigned int next_animation_vertex=
+			model_geometry.first_animations_vertex +
+			model_geometry.animations_vertex_count * item.next_animation_frame;
 
 		m_Mat4 model_matrix, rotation_matrix;
 		m_Mat3 lightmap_matrix;
@@ -1797,40 +3126,35 @@ void MapDrawerGL::DrawItems(
 		PC_ASSERT( item.animation_frame < model.frame_count );
 
 		const m_BBox3& bbox= model.animations_bboxes[ item.animation_frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ item.animation_frame ], bbox, model_matrix ) )
 			continue;
 
-		models_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		models_shader_.Uniform( "lightmap_matrix", lightmap_matrix );
-		models_shader_.Uniform( "rotation_matrix", rotation_matrix );
-		models_shader_.Uniform( "first_animation_vertex_number", int(first_animation_vertex) );
+		if( occlusion_culling_in_frame_ &&
+			!occlusion_culler_.IsVisible( GetItemOcclusionKey( static_cast<unsigned int>( &item - map_state.GetItems().data() ) ) ) )
+			continue;
 
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		ModelInstance instance;
+		FillModelInstance(
+			model_matrix, rotation_matrix, lightmap_matrix,
+			first_animation_vertex, 255u,
+			next_animation_vertex, item.animation_frame_lerp,
+			instance );
+
+		if( model_geometry.index_count > 0u )
+			AddModelInstance( item.item_id, instance );
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::Items, item.item_id, GetViewDepth( view_matrix, item.pos ), instance );
 	}
+
+	BindModelsKind( ModelsKind::Items );
+	FlushModelsInstances( ModelsKind::Items );
 }
 
 void MapDrawerGL::DrawDynamicItems(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	const bool transparent )
+	const ViewClipPlanes& view_clip_planes )
 {
-	items_geometry_data_.Bind();
-	models_shader_.Bind();
-
-	glActiveTexture( GL_TEXTURE0 + 0 );
-	glBindTexture( GL_TEXTURE_2D_ARRAY, items_textures_array_id_ );
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
-
-	items_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
-
 	for( const MapState::DynamicItemsContainer::value_type& item_value : map_state.GetDynamicItems() )
 	{
 		const MapState::DynamicItem& item= item_value.second;
@@ -1838,14 +3162,15 @@ void MapDrawerGL::DrawDynamicItems(
 		const ModelGeometry& model_geometry= items_geometry_[ item.item_type_id ];
 		const Model& model= game_resources_->items_models[ item.item_type_id ];
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animation_vertex=
 			model_geometry.first_animations_vertex +
 			model_geometry.animations_vertex_count * item.frame;
+		const unsigned int next_animation_vertex=
+			model_geometry.first_animations_vertex +
+			model_geometry.animations_vertex_count * item.next_frame;
 
 		m_Mat4 model_matrix, rotation_matrix;
 		m_Mat3 lightmap_matrix;
@@ -1855,42 +3180,34 @@ void MapDrawerGL::DrawDynamicItems(
 		PC_ASSERT( item.frame < model.frame_count );
 
 		const m_BBox3& bbox= model.animations_bboxes[ item.frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ item.frame ], bbox, model_matrix ) )
 			continue;
 
-		models_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		models_shader_.Uniform( "lightmap_matrix", lightmap_matrix );
-		models_shader_.Uniform( "rotation_matrix", rotation_matrix );
-		models_shader_.Uniform( "first_animation_vertex_number", int(first_animation_vertex) );
-
-		( item.fullbright ? map_light_.GetFullbrightLightmapDummy() : *active_lightmap_ ).Bind(1);
-
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		ModelInstance instance;
+		FillModelInstance(
+			model_matrix, rotation_matrix, lightmap_matrix,
+			first_animation_vertex, 255u,
+			next_animation_vertex, item.frame_lerp,
+			instance );
+
+		// Lowest bit of batch key - fullbright flag.
+		const unsigned int batch_key= ( item.item_type_id << 1u ) | ( item.fullbright ? 1u : 0u );
+		if( model_geometry.index_count > 0u )
+			AddModelInstance( batch_key, instance );
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::DynamicItems, batch_key, GetViewDepth( view_matrix, item.pos ), instance );
 	}
+
+	BindModelsKind( ModelsKind::DynamicItems );
+	FlushModelsInstances( ModelsKind::DynamicItems );
 }
 
 void MapDrawerGL::DrawMonsters(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
 	const ViewClipPlanes& view_clip_planes,
-	const EntityId player_monster_id,
-	const bool transparent,
-	const bool skip_invisible_monsters )
+	const EntityId player_monster_id )
 {
-	monsters_shader_.Bind();
-	monsters_geometry_data_.Bind();
-
-	active_lightmap_->Bind(1);
-	monsters_shader_.Uniform( "lightmap", int(1) );
-
-	monsters_animations_.Bind(2);
-	monsters_shader_.Uniform( "animations_vertices_buffer", int(2) );
-
 	for( const MapState::MonstersContainer::value_type& monster_value : map_state.GetMonsters() )
 	{
 		if( monster_value.first == player_monster_id )
@@ -1902,9 +3219,6 @@ void MapDrawerGL::DrawMonsters(
 			monster.body_parts_mask == 0u ) // Monster is invisible.
 			continue;
 
-		if( skip_invisible_monsters && monster.is_invisible )
-			continue;
-
 		const MonsterModel& monster_model= monsters_models_[ monster.monster_id ];
 		const ModelGeometry& model_geometry= monster_model.geometry_description;
 		const Model& model= game_resources_->monsters_models[ monster.monster_id ];
@@ -1913,11 +3227,9 @@ void MapDrawerGL::DrawMonsters(
 		PC_ASSERT( monster.animation_frame < model.animations[ monster.animation ].frame_count );
 		const unsigned int frame= model.animations[ monster.animation ].first_frame + monster.animation_frame;
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animations_vertex=
 			model_geometry.first_animations_vertex +
 			frame * model_geometry.animations_vertex_count;
@@ -1928,45 +3240,45 @@ void MapDrawerGL::DrawMonsters(
 		rotation_matrix.RotateZ( monster.angle + Constants::half_pi );
 
 		const m_BBox3& bbox= model.animations_bboxes[ frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ frame ], bbox, model_matrix ) )
 			continue;
 
-		monsters_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		monsters_shader_.Uniform( "lightmap_matrix", lightmap_matrix );
-		monsters_shader_.Uniform( "enabled_groups_mask", int(monster.body_parts_mask) );
-		monsters_shader_.Uniform( "rotation_matrix", rotation_matrix );
-		monsters_shader_.Uniform( "first_animation_vertex_number", int(first_animations_vertex) );
+		if( occlusion_culling_in_frame_ && !occlusion_culler_.IsVisible( GetMonsterOcclusionKey( monster_value.first ) ) )
+			continue;
 
-		if( monster.monster_id == 0u )
-			GetPlayerTexture( monster.color ).Bind(0);
-		else
-			monster_model.texture.Bind(0);
-		monsters_shader_.Uniform( "tex", int(0) );
+		ModelInstance instance;
+		FillModelInstance(
+			model_matrix, rotation_matrix, lightmap_matrix,
+			first_animations_vertex, monster.body_parts_mask,
+			first_animations_vertex, 0.0f, // Frames of monsters come from server, so, there is nothing to interpolate.
+			instance );
 
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		// Players have different textures for different colors. Lowest byte of batch key - player color.
+		const unsigned int batch_key= ( monster.monster_id << 8u ) | ( monster.monster_id == 0u ? monster.color : 0u );
+		const float depth= GetViewDepth( view_matrix, monster.pos );
+
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::Monsters, batch_key, depth, instance );
+
+		// Regular polygons of invisible monsters are drawn in transparent pass.
+		if( model_geometry.index_count > 0u )
+		{
+			if( monster.is_invisible )
+				AddTransparentModelInstance( ModelsKind::InvisibleMonsters, batch_key, depth, instance );
+			else
+				AddModelInstance( batch_key, instance );
+		}
 	}
+
+	BindModelsKind( ModelsKind::Monsters );
+	FlushModelsInstances( ModelsKind::Monsters );
 }
 
 void MapDrawerGL::DrawMonstersBodyParts(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	const bool transparent )
+	const ViewClipPlanes& view_clip_planes )
 {
-	monsters_shader_.Bind();
-	monsters_geometry_data_.Bind();
-
-	active_lightmap_->Bind(1);
-	monsters_shader_.Uniform( "lightmap", int(1) );
-
-	monsters_animations_.Bind(2);
-	monsters_shader_.Uniform( "animations_vertices_buffer", int(2) );
-
 	for( const MapState::MonsterBodyPart& part : map_state.GetMonstersBodyParts() )
 	{
 		if( part.monster_type >= monsters_models_.size() || part.body_part_id >= 3u )
@@ -1980,60 +3292,51 @@ void MapDrawerGL::DrawMonstersBodyParts(
 		PC_ASSERT( part.animation_frame < model.animations[ part.animation ].frame_count );
 		const unsigned int frame= model.animations[ part.animation ].first_frame + part.animation_frame;
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animations_vertex=
 			model_geometry.first_animations_vertex +
 			frame * model_geometry.animations_vertex_count;
 
+		PC_ASSERT( part.next_animation < model.animations.size() );
+		PC_ASSERT( part.next_animation_frame < model.animations[ part.next_animation ].frame_count );
+		const unsigned int next_animations_vertex=
+			model_geometry.first_animations_vertex +
+			( model.animations[ part.next_animation ].first_frame + part.next_animation_frame ) * model_geometry.animations_vertex_count;
+
 		m_Mat4 model_matrix, rotation_matrix;
 		m_Mat3 lightmap_matrix;
 		CreateModelMatrices( part.pos, part.angle + Constants::half_pi, model_matrix, lightmap_matrix );
 		rotation_matrix.RotateZ( part.angle + Constants::half_pi );
 
 		const m_BBox3& bbox= model.animations_bboxes[ frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_matrix ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ frame ], bbox, model_matrix ) )
 			continue;
 
-		monsters_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		monsters_shader_.Uniform( "lightmap_matrix", lightmap_matrix );
-		monsters_shader_.Uniform( "enabled_groups_mask", int(255) );
-		monsters_shader_.Uniform( "rotation_matrix", rotation_matrix );
-		monsters_shader_.Uniform( "first_animation_vertex_number", int(first_animations_vertex) );
-
-		monster_model.texture.Bind(0);
-		monsters_shader_.Uniform( "tex", int(0) );
-
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		ModelInstance instance;
+		FillModelInstance(
+			model_matrix, rotation_matrix, lightmap_matrix,
+			first_animations_vertex, 255u,
+			next_animations_vertex, part.animation_frame_lerp,
+			instance );
+
+		const unsigned int batch_key= part.monster_type * 3u + part.body_part_id;
+		if( model_geometry.index_count > 0u )
+			AddModelInstance( batch_key, instance );
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::MonstersBodyParts, batch_key, GetViewDepth( view_matrix, part.pos ), instance );
 	}
+
+	BindModelsKind( ModelsKind::MonstersBodyParts );
+	FlushModelsInstances( ModelsKind::MonstersBodyParts );
 }
 
 void MapDrawerGL::DrawRockets(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	const bool transparent )
+	const ViewClipPlanes& view_clip_planes )
 {
-	models_shader_.Bind();
-	rockets_geometry_data_.Bind();
-
-	glActiveTexture( GL_TEXTURE0 + 0 );
-	glBindTexture( GL_TEXTURE_2D_ARRAY, rockets_textures_array_id_ );
-	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-	models_shader_.Uniform( "lightmap", int(1) );
-
-	rockets_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
-
 	for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
 	{
 		const MapState::Rocket& rocket= rocket_value.second;
@@ -2042,14 +3345,15 @@ void MapDrawerGL::DrawRockets(
 		const ModelGeometry& model_geometry= rockets_geometry_[ rocket.rocket_id ];
 		const Model& model= game_resources_->rockets_models[ rocket.rocket_id ];
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animation_vertex=
 			model_geometry.first_animations_vertex +
 			rocket.frame * model_geometry.animations_vertex_count;
+		const unsigned int next_animation_vertex=
+			model_geometry.first_animations_vertex +
+			rocket.next_frame * model_geometry.animations_vertex_count;
 
 		m_Mat4 rotate_max_x, rotate_mat_z, shift_mat, scale_mat;
 		rotate_max_x.RotateX( rocket.angle[1] );
@@ -2069,48 +3373,31 @@ void MapDrawerGL::DrawRockets(
 		PC_ASSERT( rocket.frame < model.frame_count );
 
 		const m_BBox3& bbox= model.animations_bboxes[ rocket.frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_mat ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ rocket.frame ], bbox, model_mat ) )
 			continue;
 
-		models_shader_.Uniform( "view_matrix", model_mat * view_matrix );
-		models_shader_.Uniform( "lightmap_matrix", lightmap_mat );
-		models_shader_.Uniform( "rotation_matrix", rotate_mat );
-		models_shader_.Uniform( "first_animation_vertex_number", int(first_animation_vertex) );
-
-		if( game_resources_->rockets_description[ rocket.rocket_id ].fullbright )
-			map_light_.GetFullbrightLightmapDummy().Bind(1);
-		else
-			active_lightmap_->Bind(1);
-
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		ModelInstance instance;
+		FillModelInstance(
+			model_mat, rotate_mat, lightmap_mat,
+			first_animation_vertex, 255u,
+			next_animation_vertex, rocket.frame_lerp,
+			instance );
+
+		if( model_geometry.index_count > 0u )
+			AddModelInstance( rocket.rocket_id, instance );
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::Rockets, rocket.rocket_id, GetViewDepth( view_matrix, rocket.pos ), instance );
 	}
+
+	BindModelsKind( ModelsKind::Rockets );
+	FlushModelsInstances( ModelsKind::Rockets );
 }
 
 void MapDrawerGL::DrawGibs(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
-	const ViewClipPlanes& view_clip_planes,
-	bool transparent )
+	const ViewClipPlanes& view_clip_planes )
 {
-	models_shader_.Bind();
-	gibs_geometry_data_.Bind();
-
-	glActiveTexture( GL_TEXTURE0 + 0 );
-	glBindTexture( GL_TEXTURE_2D_ARRAY, gibs_textures_array_id_ );
-	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "tex", int(0) );
-
-	active_lightmap_->Bind(1);
-	models_shader_.Uniform( "lightmap", int(1) );
-
-	gibs_animations_.Bind( 2 );
-	models_shader_.Uniform( "animations_vertices_buffer", int(2) );
-
 	for( const MapState::Gib& gib : map_state.GetGibs() )
 	{
 		if( gib.gib_id >= game_resources_->gibs_models.size() )
@@ -2119,13 +3406,11 @@ void MapDrawerGL::DrawGibs(
 		const ModelGeometry& model_geometry= gibs_geometry_[ gib.gib_id  ];
 		const Model& model= game_resources_->gibs_models[ gib.gib_id ];
 
-		const unsigned int index_count= transparent ? model_geometry.transparent_index_count : model_geometry.index_count;
-		if( index_count == 0u )
+		if( model_geometry.index_count == 0u && model_geometry.transparent_index_count == 0u )
 			continue;
 
 		const unsigned int frame= 0u;
 
-		const unsigned int first_index= transparent ? model_geometry.first_transparent_index : model_geometry.first_index;
 		const unsigned int first_animation_vertex=
 			model_geometry.first_animations_vertex +
 			frame * model_geometry.animations_vertex_count;
@@ -2148,32 +3433,32 @@ void MapDrawerGL::DrawGibs(
 		PC_ASSERT( frame< model.frame_count );
 
 		const m_BBox3& bbox= model.animations_bboxes[ frame ];
-		if( BBoxIsOutsideView( view_clip_planes, bbox, model_mat ) )
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ frame ], bbox, model_mat ) )
 			continue;
 
-		models_shader_.Uniform( "view_matrix", model_mat * view_matrix );
-		models_shader_.Uniform( "lightmap_matrix", lightmap_mat );
-		models_shader_.Uniform( "rotation_matrix", rotate_mat );
-		models_shader_.Uniform( "first_animation_vertex_number", int(first_animation_vertex) );
-
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			index_count,
-			GL_UNSIGNED_SHORT,
-			reinterpret_cast<void*>( first_index * sizeof(unsigned short) ),
-			model_geometry.first_vertex_index );
+		ModelInstance instance;
+		FillModelInstance(
+			model_mat, rotate_mat, lightmap_mat,
+			first_animation_vertex, 255u,
+			first_animation_vertex, 0.0f,
+			instance );
+
+		if( model_geometry.index_count > 0u )
+			AddModelInstance( gib.gib_id, instance );
+		if( model_geometry.transparent_index_count > 0u )
+			AddTransparentModelInstance( ModelsKind::Gibs, gib.gib_id, GetViewDepth( view_matrix, gib.pos ), instance );
 	}
+
+	BindModelsKind( ModelsKind::Gibs );
+	FlushModelsInstances( ModelsKind::Gibs );
 }
 
 void MapDrawerGL::DrawBMPObjectsSprites(
 	const MapState& map_state,
-	const m_Mat4& view_matrix,
 	const m_Vec3& camera_position )
 {
 	const float sprites_frame= map_state.GetSpritesFrame();
 
-	sprites_shader_.Bind();
-
 	for( const MapState::StaticModel& model : map_state.GetStaticModels() )
 	{
 		if( model.model_id >= current_map_data_->models_description.size() )
@@ -2187,12 +3472,6 @@ void MapDrawerGL::DrawBMPObjectsSprites(
 		const GameResources::BMPObjectDescription& bmp_description= game_resources_->bmp_objects_description[ bmp_obj_id ];
 		const ObjSprite& sprite_picture= game_resources_->bmp_objects_sprites[ bmp_obj_id ];
 
-		glActiveTexture( GL_TEXTURE0 + 0 );
-		glBindTexture( GL_TEXTURE_2D_ARRAY, bmp_objects_sprites_textures_arrays_[ bmp_obj_id ] );
-
-		// Force fullbright. Fetch light, as with outher sprites, if this needed.
-		map_light_.GetFullbrightLightmapDummy().Bind(1);
-
 		const float additional_scale= ( bmp_description.half_size ? 0.5f : 1.0f ) / 128.0f;
 		const m_Vec3 scale_vec(
 			float(sprite_picture.size[0]) * additional_scale,
@@ -2211,27 +3490,27 @@ void MapDrawerGL::DrawBMPObjectsSprites(
 		shift_mat.Translate( pos );
 		scale_mat.Scale( scale_vec );
 
-		sprites_shader_.Uniform( "view_matrix", scale_mat * rotate_z * shift_mat * view_matrix );
-		sprites_shader_.Uniform( "tex", int(0) );
-		sprites_shader_.Uniform( "lightmap", int(1) );
-
 		const unsigned int phase= GetModelBMPSpritePhase( model );
 		const unsigned int frame= static_cast<unsigned int>( sprites_frame + phase ) % sprite_picture.frame_count;
-		sprites_shader_.Uniform( "frame", float(frame) );
-		sprites_shader_.Uniform( "lightmap_coord", pos.xy() / float(MapData::c_map_size) );
 
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
+		// Force fullbright. Fetch light, as with outher sprites, if this needed.
+		AddSpriteInstance(
+			bmp_objects_sprites_textures_.sprites[ bmp_obj_id ],
+			frame,
+			scale_mat * rotate_z * shift_mat,
+			pos.xy() / float(MapData::c_map_size),
+			true );
 	}
+
+	sprites_shader_.Bind();
+	FlushSpritesInstances( bmp_objects_sprites_textures_ );
 }
 
 void MapDrawerGL::DrawEffectsSprites(
 	const MapState& map_state,
-	const m_Mat4& view_matrix,
 	const m_Vec3& camera_position )
 {
-	SortEffectsSprites( map_state.GetSpriteEffects(), camera_position, sorted_sprites_ );
-
-	sprites_shader_.Bind();
+	SortEffectsSprites( map_state.GetSpriteEffects(), camera_position, sprites_sort_buffer_, sorted_sprites_ );
 
 	for( const MapState::SpriteEffect* const sprite_ptr : sorted_sprites_ )
 	{
@@ -2240,14 +3519,6 @@ void MapDrawerGL::DrawEffectsSprites(
 		const GameResources::SpriteEffectDescription& sprite_description= game_resources_->sprites_effects_description[ sprite.effect_id ];
 		const ObjSprite& sprite_picture= game_resources_->effects_sprites[ sprite.effect_id ];
 
-		glActiveTexture( GL_TEXTURE0 + 0 );
-		glBindTexture( GL_TEXTURE_2D_ARRAY, sprites_textures_arrays_[ sprite.effect_id ] );
-
-		if( !sprite_description.light_on )
-			map_light_.GetFloorLightmap().Bind(1);
-		else
-			map_light_.GetFullbrightLightmapDummy().Bind(1);
-
 		const m_Vec3 vec_to_sprite= sprite.pos - camera_position;
 		float sprite_angles[2];
 		VecToAngles( vec_to_sprite, sprite_angles );
@@ -2264,14 +3535,96 @@ void MapDrawerGL::DrawEffectsSprites(
 				1.0f,
 				float(sprite_picture.size[1]) * additional_scale ) );
 
-		sprites_shader_.Uniform( "view_matrix", scale_mat * rotate_x * rotate_z * shift_mat * view_matrix );
-		sprites_shader_.Uniform( "tex", int(0) );
-		sprites_shader_.Uniform( "lightmap", int(1) );
-		sprites_shader_.Uniform( "frame", sprite.frame );
-		sprites_shader_.Uniform( "lightmap_coord", sprite.pos.xy() / float(MapData::c_map_size) );
+		// Select nearest frame, like array texture fetch with float layer does.
+		const unsigned int frame=
+			std::min(
+				static_cast<unsigned int>( std::max( sprite.frame + 0.5f, 0.0f ) ),
+				sprite_picture.frame_count - 1u );
+
+		AddSpriteInstance(
+			sprites_textures_.sprites[ sprite.effect_id ],
+			frame,
+			scale_mat * rotate_x * rotate_z * shift_mat,
+			sprite.pos.xy() / float(MapData::c_map_size),
+			sprite_description.light_on );
+	}
+
+	sprites_shader_.Bind();
+	FlushSpritesInstances( sprites_textures_ );
+}
 
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
+void MapDrawerGL::AddSpriteInstance(
+	const SpriteTexture& sprite_texture,
+	const unsigned int frame,
+	const m_Mat4& model_matrix,
+	const m_Vec2& lightmap_coord,
+	const bool fullbright )
+{
+	sprites_instances_.emplace_back();
+	SpriteInstance& instance= sprites_instances_.back();
+
+	std::memcpy( instance.model_matrix, model_matrix.value, sizeof(instance.model_matrix) );
+	instance.lightmap_coord[0]= lightmap_coord.x;
+	instance.lightmap_coord[1]= lightmap_coord.y;
+	instance.layer= float( sprite_texture.first_layer + frame );
+	instance.fullbright= fullbright ? 1.0f : 0.0f;
+	instance.tex_coord_scale[0]= sprite_texture.tex_coord_scale[0];
+	instance.tex_coord_scale[1]= sprite_texture.tex_coord_scale[1];
+
+	sprites_instances_arrays_.push_back( sprite_texture.array_index );
+}
+
+void MapDrawerGL::FlushSpritesInstances( const SpritesTextures& textures )
+{
+	if( sprites_instances_.empty() )
+		return;
+
+	// Lightmap for lit sprites and fullbright lightmap are both bound, shader selects one of them for each instance.
+	map_light_.GetFloorLightmap().Bind(1);
+	map_light_.GetFullbrightLightmapDummy().Bind(2);
+
+	glBindBuffer( GL_ARRAY_BUFFER, sprites_instances_buffer_id_ );
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		sprites_instances_.size() * sizeof(SpriteInstance),
+		sprites_instances_.data(),
+		GL_STREAM_DRAW );
+
+	SetSpriteInstanceAttribsEnabled( true );
+
+	unsigned int run_begin= 0u;
+	while( run_begin < sprites_instances_.size() )
+	{
+		const unsigned int array_index= sprites_instances_arrays_[ run_begin ];
+		unsigned int run_end= run_begin + 1u;
+		while( run_end < sprites_instances_.size() && sprites_instances_arrays_[ run_end ] == array_index )
+			run_end++;
+
+		glActiveTexture( GL_TEXTURE0 + 0 );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, textures.arrays[ array_index ] );
+
+		// There is no "base instance" in OpenGL 3.3, so, point instance attributes to first instance of run.
+		const std::size_t run_offset= run_begin * sizeof(SpriteInstance);
+		for( unsigned int i= 0u; i < 4u; i++ )
+			glVertexAttribPointer(
+				g_sprite_instance_model_matrix_attrib + i, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+				reinterpret_cast<void*>( run_offset + offsetof( SpriteInstance, model_matrix ) + i * 4u * sizeof(float) ) );
+		glVertexAttribPointer(
+			g_sprite_instance_params_attrib, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+			reinterpret_cast<void*>( run_offset + offsetof( SpriteInstance, lightmap_coord ) ) );
+		glVertexAttribPointer(
+			g_sprite_instance_tex_coord_scale_attrib, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+			reinterpret_cast<void*>( run_offset + offsetof( SpriteInstance, tex_coord_scale ) ) );
+
+		glDrawArraysInstanced( GL_TRIANGLES, 0, 6, run_end - run_begin );
+
+		run_begin= run_end;
 	}
+
+	SetSpriteInstanceAttribsEnabled( false );
+
+	sprites_instances_.clear();
+	sprites_instances_arrays_.clear();
 }
 
 void MapDrawerGL::DrawSky( const m_Mat4& view_rotation_matrix )
@@ -2280,13 +3633,79 @@ void MapDrawerGL::DrawSky( const m_Mat4& view_rotation_matrix )
 
 	sky_texture_.Bind(0);
 
-	sky_shader_.Uniform( "tex", int(0) );
 	sky_shader_.Uniform( "view_matrix", view_rotation_matrix );
 
-	sky_geometry_data_.Draw();
+	// Sky is drawn on far plane, only over pixels without geometry.
+	glDepthFunc( GL_LEQUAL );
+	glDrawArrays( GL_TRIANGLES, 0, 3 );
+	glDepthFunc( GL_LESS );
 }
 
 
+void MapDrawerGL::TestOcclusion(
+	const MapState& map_state,
+	const m_Mat4& view_matrix,
+	const m_Vec3& camera_position,
+	const ViewClipPlanes& view_clip_planes,
+	const EntityId player_monster_id )
+{
+	// Bound vertex array object is not used by test shader, but bind something with enough vertices.
+	floors_geometry_.Bind();
+
+	occlusion_culler_.BeginTests( view_matrix, camera_position );
+
+	for( const MapState::MonstersContainer::value_type& monster_value : map_state.GetMonsters() )
+	{
+		if( monster_value.first == player_monster_id )
+			continue;
+
+		const MapState::Monster& monster= monster_value.second;
+		if( monster.monster_id >= monsters_models_.size() || monster.body_parts_mask == 0u )
+			continue;
+
+		const Model& model= game_resources_->monsters_models[ monster.monster_id ];
+		const unsigned int frame= model.animations[ monster.animation ].first_frame + monster.animation_frame;
+
+		m_Mat4 model_matrix;
+		m_Mat3 lightmap_matrix;
+		CreateModelMatrices( monster.pos, monster.angle + Constants::half_pi, model_matrix, lightmap_matrix );
+
+		const m_BBox3& bbox= model.animations_bboxes[ frame ];
+		if( ModelIsOutsideView( view_clip_planes, model.animations_bounding_spheres[ frame ], bbox, model_matrix ) )
+			continue;
+
+		occlusion_culler_.Test( GetMonsterOcclusionKey( monster_value.first ), bbox, model_matrix );
+	}
+
+	const MapState::Items& items= map_state.GetItems();
+	for( unsigned int i= 0u; i < items.size(); i++ )
+	{
+		const MapState::Item& item= items[i];
+		if( item.picked_up || item.item_id >= items_geometry_.size() )
+			continue;
+
+		const Model& model= game_resources_->items_models[ item.item_id ];
+
+		m_Mat4 model_matrix;
+		m_Mat3 lightmap_matrix;
+		CreateModelMatrices( item.pos, item.angle, model_matrix, lightmap_matrix );
+
+		// Frames are interpolated, so, test both frames.
+		m_BBox3 bbox= model.animations_bboxes[ item.animation_frame ];
+		const m_BBox3& next_bbox= model.animations_bboxes[ item.next_animation_frame ];
+		bbox+= next_bbox.min;
+		bbox+= next_bbox.max;
+
+		// Frames are interpolated, so, use sphere of all frames.
+		if( ModelIsOutsideView( view_clip_planes, model.bounding_sphere, bbox, model_matrix ) )
+			continue;
+
+		occlusion_culler_.Test( GetItemOcclusionKey(i), bbox, model_matrix );
+	}
+
+	occlusion_culler_.EndTests();
+}
+
 void MapDrawerGL::DrawMapModelsShadows(
 	const MapState& map_state,
 	const m_Mat4& view_matrix,
@@ -2298,7 +3717,6 @@ void MapDrawerGL::DrawMapModelsShadows(
 	models_shadow_shader_.Bind();
 
 	models_animations_.Bind( 0 );
-	models_shadow_shader_.Uniform( "animations_vertices_buffer", int(0) );
 
 	models_shadow_shader_.Uniform( "enabled_groups_mask", int(255) );
 
@@ -2314,7 +3732,7 @@ void MapDrawerGL::DrawMapModelsShadows(
 			continue;
 
 		m_Vec3 light_pos;
-		if( !GetNearestLightSourcePos( static_model.pos, *current_map_data_, map_state, false, light_pos ) )
+		if( !GetNearestLightSourcePos( static_model.pos, *current_map_data_, static_lights_grid_, map_state, false, light_pos ) )
 			continue;
 
 		const ModelGeometry& model_geometry= models_geometry_[ static_model.model_id ];
@@ -2358,7 +3776,6 @@ void MapDrawerGL::DrawItemsShadows(
 	models_shadow_shader_.Bind();
 
 	items_animations_.Bind( 0 );
-	models_shadow_shader_.Uniform( "animations_vertices_buffer", int(0) );
 
 	models_shadow_shader_.Uniform( "enabled_groups_mask", int(255) );
 
@@ -2373,7 +3790,7 @@ void MapDrawerGL::DrawItemsShadows(
 			continue;
 
 		m_Vec3 light_pos;
-		if( !GetNearestLightSourcePos( item.pos, *current_map_data_, map_state, true, light_pos ) )
+		if( !GetNearestLightSourcePos( item.pos, *current_map_data_, static_lights_grid_, map_state, true, light_pos ) )
 			continue;
 
 		const ModelGeometry& model_geometry= items_geometry_[ item.item_id ];
@@ -2415,10 +3832,9 @@ void MapDrawerGL::DrawMonstersShadows(
 	PC_UNUSED(view_clip_planes);
 
 	monsters_geometry_data_.Bind();
-	models_shadow_shader_.Bind();
+	monsters_shadow_shader_.Bind();
 
 	monsters_animations_.Bind( 0 );
-	models_shadow_shader_.Uniform( "animations_vertices_buffer", int(0) );
 
 	const bool transparent= false;
 	for( const MapState::MonstersContainer::value_type& monster_value : map_state.GetMonsters() )
@@ -2433,7 +3849,7 @@ void MapDrawerGL::DrawMonstersShadows(
 			continue;
 
 		m_Vec3 light_pos;
-		if( !GetNearestLightSourcePos( monster.pos, *current_map_data_, map_state, true, light_pos ) )
+		if( !GetNearestLightSourcePos( monster.pos, *current_map_data_, static_lights_grid_, map_state, true, light_pos ) )
 			continue;
 
 		// TODO - monsters cast shadows allways?
@@ -2461,10 +3877,10 @@ void MapDrawerGL::DrawMonstersShadows(
 		CreateModelMatrices( monster.pos, monster.angle + Constants::half_pi, model_matrix, lightmap_matrix );
 		rotation_matrix.RotateZ( -( monster.angle + Constants::half_pi ) );
 
-		models_shadow_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
-		models_shadow_shader_.Uniform( "enabled_groups_mask", int(monster.body_parts_mask) );
-		models_shadow_shader_.Uniform( "first_animation_vertex_number", int(first_animations_vertex) );
-		models_shadow_shader_.Uniform( "light_pos", ( light_pos - monster.pos ) * rotation_matrix );
+		monsters_shadow_shader_.Uniform( "view_matrix", model_matrix * view_matrix );
+		monsters_shadow_shader_.Uniform( "enabled_groups_mask", int(monster.body_parts_mask) );
+		monsters_shadow_shader_.Uniform( "first_animation_vertex_number", int(first_animations_vertex) );
+		monsters_shadow_shader_.Uniform( "light_pos", ( light_pos - monster.pos ) * rotation_matrix );
 
 		glDrawElementsBaseVertex(
 			GL_TRIANGLES,
@@ -2475,4 +3891,132 @@ void MapDrawerGL::DrawMonstersShadows(
 	}
 }
 
+void MapDrawerGL::BeginDynamicResolutionFrame()
+{
+	DynamicResolution& dr= dynamic_resolution_;
+	if( !dr.enabled )
+		return;
+
+	// Select scale. GPU time is nearly proportional to pixel count.
+	if( dr.change_cooldown_frames > 0u )
+		dr.change_cooldown_frames--;
+	else
+	{
+		const float gpu_time_s= float( double( gpu_passes_profiler_.GetTotalTime() ) / 1000000000.0 );
+		const float next_scale_ratio= float( dr.scale + 1u ) / float( dr.scale );
+
+		unsigned int new_scale= dr.scale;
+		if( gpu_time_s > dr.target_gpu_time_s && dr.scale > g_dynamic_resolution_min_scale )
+			new_scale= dr.scale - 1u;
+		else if(
+			dr.scale < c_dynamic_resolution_scale_denominator &&
+			gpu_time_s * next_scale_ratio * next_scale_ratio < dr.target_gpu_time_s * 0.9f )
+			new_scale= dr.scale + 1u;
+
+		if( new_scale != dr.scale )
+		{
+			dr.scale= new_scale;
+			dr.change_cooldown_frames= g_dynamic_resolution_change_cooldown_frames;
+		}
+	}
+
+	if( dr.scale == c_dynamic_resolution_scale_denominator )
+	{
+		ReleaseDynamicResolutionFramebuffer();
+		return;
+	}
+
+	const Size2& viewport_size= rendering_context_.viewport_size;
+	const Size2 size(
+		std::max( 1u, viewport_size.Width () * dr.scale / c_dynamic_resolution_scale_denominator ),
+		std::max( 1u, viewport_size.Height() * dr.scale / c_dynamic_resolution_scale_denominator ) );
+
+	if( dr.framebuffer_id == 0u || size != dr.size )
+	{
+		ReleaseDynamicResolutionFramebuffer();
+		dr.size= size;
+
+		glGenRenderbuffers( 1, &dr.color_renderbuffer_id );
+		glBindRenderbuffer( GL_RENDERBUFFER, dr.color_renderbuffer_id );
+		glRenderbufferStorageMultisample( GL_RENDERBUFFER, dr.samples, GL_RGBA8, size.Width(), size.Height() );
+
+		glGenRenderbuffers( 1, &dr.depth_renderbuffer_id );
+		glBindRenderbuffer( GL_RENDERBUFFER, dr.depth_renderbuffer_id );
+		glRenderbufferStorageMultisample( GL_RENDERBUFFER, dr.samples, GL_DEPTH24_STENCIL8, size.Width(), size.Height() );
+
+		glGenFramebuffers( 1, &dr.framebuffer_id );
+		glBindFramebuffer( GL_FRAMEBUFFER, dr.framebuffer_id );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, dr.color_renderbuffer_id );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, dr.depth_renderbuffer_id );
+
+		if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		{
+			Log::Warning( "Can not create scene framebuffer, dynamic resolution disabled" );
+			ReleaseDynamicResolutionFramebuffer();
+			r_Framebuffer::BindScreenFramebuffer();
+			dr.enabled= false;
+			return;
+		}
+
+		dr.resolve_framebuffer=
+			r_Framebuffer(
+				{ r_Texture::PixelFormat::RGBA8 }, r_Texture::PixelFormat::Unknown,
+				size.Width(), size.Height() );
+		dr.resolve_framebuffer.GetTextures().front().SetFiltration( r_Texture::Filtration::Linear, r_Texture::Filtration::Linear );
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, dr.framebuffer_id );
+	glViewport( 0, 0, size.Width(), size.Height() );
+	dr.scene_framebuffer_active= true;
+}
+
+void MapDrawerGL::ReleaseDynamicResolutionFramebuffer()
+{
+	DynamicResolution& dr= dynamic_resolution_;
+	if( dr.framebuffer_id == 0u )
+		return;
+
+	glDeleteFramebuffers( 1, &dr.framebuffer_id );
+	glDeleteRenderbuffers( 1, &dr.color_renderbuffer_id );
+	glDeleteRenderbuffers( 1, &dr.depth_renderbuffer_id );
+	dr.framebuffer_id= 0u;
+	dr.color_renderbuffer_id= 0u;
+	dr.depth_renderbuffer_id= 0u;
+	dr.resolve_framebuffer= r_Framebuffer();
+}
+
+void MapDrawerGL::GetFrameStats( std::vector<std::string>& out_lines ) const
+{
+	char str[128];
+	std::snprintf(
+		str, sizeof(str), "models: %u instances, %u draw calls",
+		models_instances_in_frame_, models_draw_calls_in_frame_ );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "static walls chunks: %u/%u",
+		walls_chunks_drawn_in_frame_, static_cast<unsigned int>( walls_chunks_.size() ) );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "dynamic walls uploaded: %u",
+		dynamic_walls_uploaded_in_frame_ );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "occlusion culled: %u",
+		occlusion_culling_in_frame_ ? occlusion_culler_.GetOccludedObjectCount() : 0u );
+	out_lines.emplace_back( str );
+
+	if( dynamic_resolution_.enabled )
+	{
+		std::snprintf(
+			str, sizeof(str), "dynamic resolution: %u/%u",
+			dynamic_resolution_.scale, c_dynamic_resolution_scale_denominator );
+		out_lines.emplace_back( str );
+	}
+
+	gpu_passes_profiler_.GetStats( out_lines );
+}
+
 } // PanzerChasm
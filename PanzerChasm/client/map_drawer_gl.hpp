@@ -1,17 +1,26 @@
 #pragma once
+#include <cstddef>
+#include <functional>
 
 #include <framebuffer.hpp>
-#include <glsl_program.hpp>
 #include <polygon_buffer.hpp>
 #include <texture.hpp>
 
 #include "../fwd.hpp"
 #include "../rendering_context.hpp"
+#include "../settings.hpp"
+#include "../shader_program_gl.hpp"
+#include "../vfs.hpp"
+#include "../workers_pool.hpp"
 #include "i_map_drawer.hpp"
+#include "map_drawers_common.hpp"
 #include "fwd.hpp"
 #include "map_state.hpp"
 #include "opengl_renderer/animations_buffer.hpp"
+#include "opengl_renderer/gpu_passes_profiler.hpp"
 #include "opengl_renderer/map_light.hpp"
+#include "opengl_renderer/occlusion_culler.hpp"
+#include "opengl_renderer/texture_compression.hpp"
 
 namespace PanzerChasm
 {
@@ -56,6 +65,8 @@ public:
 		const m_Vec3& camera_position,
 		const ViewClipPlanes& view_clip_planes ) override;
 
+	virtual void GetFrameStats( std::vector<std::string>& out_lines ) const override;
+
 private:
 	struct FloorGeometryInfo
 	{
@@ -63,6 +74,14 @@ private:
 		unsigned int vertex_count;
 	};
 
+	// Static walls in square area of map. Chunks are stored in static walls buffer one after another.
+	struct WallsChunk
+	{
+		m_BBox3 bbox;
+		unsigned int first_index;
+		unsigned int index_count;
+	};
+
 	struct ModelGeometry
 	{
 		unsigned int frame_count;
@@ -79,6 +98,29 @@ private:
 		unsigned int transparent_index_count;
 	};
 
+	// Models data, converted and ready for uploading into GPU.
+	struct PreparedModels
+	{
+		std::vector<ModelGeometry> geometry;
+		unsigned int textures_layer_count= 0u;
+		unsigned int textures_layer_height= 0u;
+		std::vector<unsigned char> textures_data_rgba; // Array texture of all models.
+		std::vector<unsigned short> indeces;
+		std::vector<Model::Vertex> vertices;
+		std::vector<Model::AnimationVertex> animations_vertices;
+		unsigned int content_hash= 0u; // Hash of all data above.
+	};
+
+	struct PreparedMonstersModels
+	{
+		std::vector<ModelGeometry> geometry; // Model and 3 submodels for each monster.
+		std::vector< std::vector<unsigned char> > textures_data_rgba; // Separate texture for each monster.
+		std::vector<unsigned short> indeces;
+		std::vector<Model::Vertex> vertices;
+		std::vector<Model::AnimationVertex> animations_vertices;
+		std::vector<uint32_t> compressed_animations; // Used instead of "animations_vertices" with compressed animations.
+	};
+
 	struct MonsterModel
 	{
 		ModelGeometry geometry_description;
@@ -87,92 +129,276 @@ private:
 		r_Texture texture;
 	};
 
+	// Per-instance vertex attributes of instanced models and monsters shaders.
+	struct ModelInstanceTransform
+	{
+		float model_matrix[16];
+		float rotation_matrix[9];
+		float lightmap_matrix[9];
+	};
+
+	struct ModelInstanceParams
+	{
+		int first_animation_vertex;
+		int groups_mask; // Zero mask - instance is culled.
+		int next_animation_vertex; // Vertices of first and next frames are interpolated.
+		int animation_lerp; // Interpolation factor in 16.16 fixed format.
+	};
+
+	struct ModelInstance
+	{
+		ModelInstanceTransform transform;
+		ModelInstanceParams params;
+	};
+
+	struct ModelInstanceBatchItem
+	{
+		unsigned int batch_key;
+		unsigned int instance_index;
+	};
+
+	// Kinds of entities models. Each kind has own shader, geometry, textures and meaning of batch key.
+	enum class ModelsKind : unsigned int
+	{
+		Items,
+		DynamicItems,
+		Monsters,
+		InvisibleMonsters, // Same as monsters, but regular polygons are drawn in transparent pass.
+		MonstersBodyParts,
+		Rockets,
+		Gibs,
+	};
+
+	struct TransparentModelInstance
+	{
+		ModelInstance instance;
+		float depth;
+		ModelsKind kind;
+		unsigned int batch_key;
+	};
+
+	// Range of static map models instances with same model.
+	struct StaticModelsBatch
+	{
+		unsigned int model_id;
+		unsigned int first_instance;
+		unsigned int instance_count;
+		unsigned int visible_instance_count;
+	};
+
+	// Sprites frames are packed into few texture arrays. Layer of array is not less, than sprite size.
+	struct SpriteTexture
+	{
+		unsigned int array_index;
+		unsigned int first_layer;
+		float tex_coord_scale[2];
+	};
+
+	struct SpritesTextures
+	{
+		std::vector<GLuint> arrays;
+		std::vector<SpriteTexture> sprites;
+	};
+
+	struct SpriteInstance
+	{
+		float model_matrix[16];
+		float lightmap_coord[2];
+		float layer;
+		float fullbright; // 0 or 1
+		float tex_coord_scale[2];
+	};
+
+	SIZE_ASSERT( SpriteInstance, 88u );
+
+	// World, weapon and items icons may be drawn with reduced resolution, for holding of target frame rate.
+	// Reduced frame is drawn into scene framebuffer, than upscaled into screen in DoFullscreenPostprocess.
+	struct DynamicResolution
+	{
+		bool enabled= false;
+		float target_gpu_time_s= 0.0f;
+
+		unsigned int scale= c_dynamic_resolution_scale_denominator; // Numerator of resolution scale.
+		unsigned int change_cooldown_frames= 0u;
+
+		// Scene framebuffer has same samples count, as screen, so, msaa works in reduced resolution too.
+		unsigned int samples= 0u;
+		Size2 size;
+		GLuint framebuffer_id= 0u; // Zero, if scale is 1.
+		GLuint color_renderbuffer_id= 0u;
+		GLuint depth_renderbuffer_id= 0u;
+		r_Framebuffer resolve_framebuffer; // Single-sample color texture, used for upscaling.
+
+		bool scene_framebuffer_active= false; // True between Draw and DoFullscreenPostprocess.
+	};
+
+	static constexpr unsigned int c_dynamic_resolution_scale_denominator= 8u;
+
 private:
-	void LoadSprites( const std::vector<ObjSprite>& sprites, std::vector<GLuint>& out_textures );
-	void PrepareSkyGeometry();
+	void LoadSprites( const std::vector<ObjSprite>& sprites, SpritesTextures& out_textures );
 	const r_Texture& GetPlayerTexture( unsigned char color );
 
 	void LoadFloorsTextures( const MapData& map_data );
-	void LoadWallsTextures( const MapData& map_data );
+	void ReadWallTexture( const MapData& map_data, unsigned int t, Vfs::FileContent& out_file ) const;
+	void LoadWallsTextures( const std::vector<Vfs::FileContent>& textures_files );
+
+	// Low-res textures for progressive loading. Cheap - does not read any files.
+	void LoadPlaceholderTextures( const MapData& map_data );
+	// Continue loading of real textures, instead of placeholders, within per-frame time budget.
+	void StreamTextures();
+
+	// Select scale, based on GPU time of previous frames, bind scene framebuffer, if scale is less, than 1.
+	void BeginDynamicResolutionFrame();
+	void ReleaseDynamicResolutionFramebuffer();
+
+	// Uploads textures array with mips into bound texture. Compressed textures are taken from disk cache, if possible.
+	// "convert_func" produces RGBA8 data for all layers and is called only if needed.
+	// Layers with same hashes, as in "resident_layers_hashes", are already in texture and are not uploaded again.
+	// Empty "resident_layers_hashes" means unknown texture content.
+	void UploadTextureArray(
+		const char* cache_kind,
+		unsigned int source_hash,
+		CompressedTextureFormat format,
+		unsigned int size_x, unsigned int size_y, unsigned int layer_count,
+		const std::vector<unsigned int>& layers_hashes,
+		std::vector<unsigned int>& resident_layers_hashes,
+		const std::function< void( std::vector<unsigned char>& out_data_rgba ) >& convert_func ) const;
 
 	void LoadFloors( const MapData& map_data );
 	void LoadWalls( const MapData& map_data );
 
+	// CPU-side data of models is shared between all OpenGL drawers in process.
 	void LoadModels(
+		const std::shared_ptr<const void>& models_owner,
 		const std::vector<Model>& models,
 		std::vector<ModelGeometry>& out_geometry,
 		r_PolygonBuffer& out_geometry_data,
 		AnimationsBuffer& out_animations_buffer,
-		GLuint& out_textures_array ) const;
+		GLuint& out_textures_array,
+		unsigned int* resident_content_hash= nullptr ) const; // If hash of models is same, only geometry description is updated.
+	void PrepareModels( const std::vector<Model>& models, PreparedModels& out_prepared_models ) const;
 
 	void LoadMonstersModels();
+	void PrepareMonstersModels( const std::vector<Model>& models, PreparedMonstersModels& out_prepared_models ) const;
 
 	void UpdateDynamicWalls( const MapState::DynamicWalls& dynamic_walls );
 
 	static void PrepareModelsPolygonBuffer(
-		std::vector<Model::Vertex>& vertices,
-		std::vector<unsigned short>& indeces,
+		const std::vector<Model::Vertex>& vertices,
+		const std::vector<unsigned short>& indeces,
 		r_PolygonBuffer& buffer );
 
-	void DrawWalls( const m_Mat4& view_matrix );
-	void DrawFloors( const m_Mat4& view_matrix );
-
-	void DrawModels(
-		const MapState& map_state,
-		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
-
+	static void FillModelInstanceTransform(
+		const m_Mat4& model_matrix,
+		const m_Mat4& rotation_matrix,
+		const m_Mat3& lightmap_matrix,
+		ModelInstanceTransform& out_transform );
+
+	// Point per-instance attributes to currently bound array buffer.
+	static void SetInstanceTransformAttribs( std::size_t offset, unsigned int stride );
+	static void SetInstanceParamsAttrib( std::size_t offset, unsigned int stride );
+	// Enable per-instance attributes for bound vertex array object. Disable them after drawing,
+	// because vertex array objects are used for non-instanced drawing too.
+	static void SetInstanceAttribsEnabled( bool enabled );
+	static void SetSpriteInstanceAttribsEnabled( bool enabled );
+
+	static void FillModelInstance(
+		const m_Mat4& model_matrix,
+		const m_Mat4& rotation_matrix,
+		const m_Mat3& lightmap_matrix,
+		unsigned int first_animation_vertex,
+		unsigned int groups_mask,
+		unsigned int next_animation_vertex,
+		float animation_lerp,
+		ModelInstance& out_instance );
+
+	void AddModelInstance( unsigned int batch_key, const ModelInstance& instance );
+	// Depth - distance from camera plane.
+	void AddTransparentModelInstance( ModelsKind kind, unsigned int batch_key, float depth, const ModelInstance& instance );
+
+	// Bind shader, geometry and common textures of models kind.
+	void BindModelsKind( ModelsKind kind );
+	// Bind textures for batch and return geometry of batch model.
+	const ModelGeometry& SetupModelsBatch( ModelsKind kind, unsigned int batch_key );
+
+	// Sort added instances by batch key, upload it and draw regular polygons of each batch with one instanced draw call.
+	// Models kind must be bound before call.
+	void FlushModelsInstances( ModelsKind kind );
+
+	// Sort transparent instances of all kinds back to front and draw them.
+	// Neighbor instances with same kind and batch key are drawn with one call.
+	void DrawTransparentModels();
+
+	// Update instances of static map models. Rebuild transformations only if models are changed,
+	// cull models each frame. Call once per frame.
+	void PrepareStaticModels( const MapState& map_state, const ViewClipPlanes& view_clip_planes );
+
+	void DrawWalls( const ViewClipPlanes& view_clip_planes );
+	void DrawFloors();
+
+	void DrawModels( bool transparent );
+
+	// Entities drawing functions cull entities, draw regular polygons of visible entities
+	// and add visible entities with transparent polygons into list for "DrawTransparentModels".
 	void DrawItems(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
+		const ViewClipPlanes& view_clip_planes );
 
 	void DrawDynamicItems(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
+		const ViewClipPlanes& view_clip_planes );
 
 	void DrawMonsters(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
 		const ViewClipPlanes& view_clip_planes,
-		EntityId player_mosnter_id,
-		bool transparent,
-		bool skip_invisible_monsters );
+		EntityId player_mosnter_id );
 
 	void DrawMonstersBodyParts(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
+		const ViewClipPlanes& view_clip_planes );
 
 	void DrawRockets(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
+		const ViewClipPlanes& view_clip_planes );
 
 	void DrawGibs(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
-		const ViewClipPlanes& view_clip_planes,
-		bool transparent );
+		const ViewClipPlanes& view_clip_planes );
 
 	void DrawBMPObjectsSprites(
 		const MapState& map_state,
-		const m_Mat4& view_matrix,
 		const m_Vec3& camera_position );
 
 	void DrawEffectsSprites(
 		const MapState& map_state,
-		const m_Mat4& view_matrix,
 		const m_Vec3& camera_position );
 
+	void AddSpriteInstance(
+		const SpriteTexture& sprite_texture,
+		unsigned int frame,
+		const m_Mat4& model_matrix,
+		const m_Vec2& lightmap_coord,
+		bool fullbright );
+	// Draw instances with one call for each run of instances with same texture array.
+	// Instances order is preserved.
+	void FlushSpritesInstances( const SpritesTextures& textures );
+
 	void DrawSky( const m_Mat4& view_rotation_and_projection_matrix );
 
+	// Test bounding boxes of monsters and items against depth of walls and floors.
+	void TestOcclusion(
+		const MapState& map_state,
+		const m_Mat4& view_matrix,
+		const m_Vec3& camera_position,
+		const ViewClipPlanes& view_clip_planes,
+		EntityId player_monster_id );
+
 	void DrawMapModelsShadows(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
@@ -191,40 +417,98 @@ private:
 
 private:
 	Settings& settings_;
+	// Settings, which are read each frame.
+	const Settings::BoolHandle occlusion_culling_setting_;
+	const Settings::BoolHandle shadows_setting_;
+
 	const GameResourcesConstPtr game_resources_;
 	const RenderingContextGL rendering_context_;
 	const bool filter_textures_;
+	// Compress floors and walls textures into BC1/BC3. Saves video memory and textures bandwidth.
+	bool compress_textures_= false;
+	// Start level with placeholder floors and walls textures, stream real textures during first frames.
+	const bool progressive_loading_;
+	// Store monsters animations quantized - 4 bytes per vertex instead of 8. Saves video memory.
+	const bool compress_monsters_animations_;
+	// Threads for CPU-side conversion of textures and models. Used in const preparation methods too.
+	mutable WorkersPool workers_pool_;
+
+	struct TexturesStreaming
+	{
+		bool floors_pending= false;
+		bool walls_pending= false;
+		unsigned int walls_files_read= 0u;
+		std::vector<Vfs::FileContent> walls_files;
+	};
+	TexturesStreaming textures_streaming_;
 
 	MapDataConstPtr current_map_data_;
+	StaticLightsGrid static_lights_grid_;
 
 	bool use_2d_textures_for_animations_= false;
 	bool use_hd_dynamic_lightmap_;
+	// Geometry shaders are slow on many GPUs, so, by default flat normals are calculated in fragment shaders.
+	bool use_geometry_shaders_;
 	const r_Texture* active_lightmap_= nullptr; // Build-in or hd lightmap
 
 	GLuint floor_textures_array_id_= ~0;
 	GLuint wall_textures_array_id_= ~0;
 	GLuint models_textures_array_id_= ~0;
+
+	// Content of map textures and models, which are now in GPU memory. Neighbor maps often share most of it.
+	std::vector<unsigned int> floor_textures_layers_hashes_;
+	std::vector<unsigned int> wall_textures_layers_hashes_;
+	unsigned int map_models_content_hash_= 0u;
 	GLuint items_textures_array_id_= ~0;
 	GLuint rockets_textures_array_id_= ~0;
 	GLuint gibs_textures_array_id_= ~0;
 	GLuint weapons_textures_array_id_= ~0;
 
-	std::vector<GLuint> sprites_textures_arrays_;
-	std::vector<GLuint> bmp_objects_sprites_textures_arrays_;
+	SpritesTextures sprites_textures_;
+	SpritesTextures bmp_objects_sprites_textures_;
 
-	r_GLSLProgram floors_shader_;
+	ShaderProgramGL floors_shader_;
 	r_PolygonBuffer floors_geometry_;
 	// 0 - floor, 1 - ceiling
 	FloorGeometryInfo floors_geometry_info[2];
 
-	r_GLSLProgram walls_shader_;
+	ShaderProgramGL walls_shader_;
 	r_PolygonBuffer walls_geometry_;
+	std::vector<WallsChunk> walls_chunks_;
+	// Temp buffers for ranges of visible chunks.
+	std::vector<GLsizei> walls_draw_index_counts_;
+	std::vector<const GLvoid*> walls_draw_index_offsets_;
+	unsigned int walls_chunks_drawn_in_frame_= 0u;
 
 	r_PolygonBuffer dynamic_walls_geometry_;
 	std::vector<WallVertex> dynamc_walls_vertices_;
-
-	r_GLSLProgram models_shader_;
-	r_GLSLProgram models_shadow_shader_;
+	// Walls state, which is currently in GPU buffer.
+	MapState::DynamicWalls uploaded_dynamic_walls_;
+	unsigned int dynamic_walls_uploaded_in_frame_= 0u;
+
+	ShaderProgramGL models_shader_;
+	ShaderProgramGL models_instanced_shader_;
+	ShaderProgramGL models_shadow_shader_;
+	ShaderProgramGL monsters_shadow_shader_; // Same, as models shadow shader, but for monsters animations format.
+
+	GLuint models_instances_buffer_id_= ~0;
+	std::vector<ModelInstance> models_instances_;
+	std::vector<ModelInstance> models_instances_sorted_;
+	std::vector<ModelInstanceBatchItem> models_instances_batch_items_;
+	// Visible entities with transparent polygons, collected while drawing regular polygons.
+	std::vector<TransparentModelInstance> transparent_models_instances_;
+	// Instances of static map models, grouped by model.
+	// Source models are used for detection of changes.
+	std::vector<MapState::StaticModel> static_models_instances_source_;
+	std::vector<m_Mat4> static_models_matrices_;
+	std::vector<unsigned int> static_models_instances_indeces_;
+	std::vector<ModelInstanceParams> static_models_instances_params_;
+	std::vector<StaticModelsBatch> static_models_batches_;
+	GLuint static_models_transforms_buffer_id_= ~0;
+	GLuint static_models_params_buffer_id_= ~0;
+
+	unsigned int models_instances_in_frame_= 0u;
+	unsigned int models_draw_calls_in_frame_= 0u;
 
 	std::vector<ModelGeometry> models_geometry_;
 	r_PolygonBuffer models_geometry_data_;
@@ -246,9 +530,15 @@ private:
 	r_PolygonBuffer weapons_geometry_data_;
 	AnimationsBuffer weapons_animations_;
 
-	r_GLSLProgram sprites_shader_;
+	ShaderProgramGL sprites_shader_;
+	GLuint sprites_instances_buffer_id_= ~0;
+	std::vector<SpriteInstance> sprites_instances_;
+	std::vector<unsigned int> sprites_instances_arrays_;
+
+	// Uniform buffer with view matrix of current frame.
+	GLuint view_params_uniform_buffer_id_= ~0u;
 
-	r_GLSLProgram monsters_shader_;
+	ShaderProgramGL monsters_shader_;
 	std::vector<MonsterModel> monsters_models_;
 	r_PolygonBuffer monsters_geometry_data_;
 	AnimationsBuffer monsters_animations_;
@@ -256,16 +546,24 @@ private:
 	std::vector<r_Texture> player_textures_;
 
 	char current_sky_texture_file_name_[32];
-	r_GLSLProgram sky_shader_;
+	ShaderProgramGL sky_shader_;
 	r_Texture sky_texture_;
-	r_PolygonBuffer sky_geometry_data_;
 
-	r_GLSLProgram fullscreen_blend_shader_;
+	ShaderProgramGL fullscreen_blend_shader_;
+
+	DynamicResolution dynamic_resolution_;
+	ShaderProgramGL scene_upscale_shader_;
 
 	MapLight map_light_;
 
+	GPUPassesProfiler gpu_passes_profiler_;
+
+	OcclusionCuller occlusion_culler_;
+	bool occlusion_culling_in_frame_= false;
+
 	// Reuse vector (do not create new vector each frame).
 	std::vector<const MapState::SpriteEffect*> sorted_sprites_;
+	EffectsSpritesSortBuffer sprites_sort_buffer_;
 };
 
 } // PanzerChasm
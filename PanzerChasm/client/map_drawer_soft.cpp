@@ -1,13 +1,23 @@
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <thread>
+
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
 
 #include "../assert.hpp"
 #include "../game_constants.hpp"
 #include "../log.hpp"
 #include "../map_loader.hpp"
 #include "../math_utils.hpp"
+#include "../profiler.hpp"
+#include "../save_load.hpp"
 #include "../settings.hpp"
 #include "../shared_settings_keys.hpp"
 #include "map_drawers_common.hpp"
+#include "models_conversion_cache.hpp"
 #include "software_renderer/map_bsp_tree.hpp"
 #include "software_renderer/map_bsp_tree.inl"
 #include "software_renderer/rasterizer.inl"
@@ -17,6 +27,22 @@
 namespace PanzerChasm
 {
 
+static constexpr float g_models_shadows_z_offset= 0.02f;
+
+// Part of target frame time, which drawing of world may take. Other time is used for HUD, menu, presenting, etc.
+static constexpr float g_dynamic_resolution_draw_time_fraction= 0.7f;
+// Minimal resolution scale numerator, for denominator c_dynamic_resolution_scale_denominator.
+static constexpr unsigned int g_dynamic_resolution_min_scale= 4u;
+// Frames without scale change after each change, for avoiding of oscillation.
+static constexpr unsigned int g_dynamic_resolution_change_cooldown_frames= 30u;
+
+// Converted sprites, not used in current frame, are released, if total size is greater, than this.
+static constexpr size_t g_sprites_textures_cache_budget= 8u * 1024u * 1024u;
+
+// Dynamic lights levels are rounded to this step, for rarer rebuilding of surfaces of fading lights.
+static constexpr unsigned int g_dynamic_light_level_step= 8u;
+static constexpr unsigned int g_dynamic_light_max_level= 128u;
+
 static void BuildMip(
 	const uint32_t* const in_data, const unsigned int in_size_x, const unsigned int in_size_y,
 	uint32_t* const out_data )
@@ -94,6 +120,93 @@ static void BuildMipAlphaCorrected(
 	}
 }
 
+// Returns mips count (including mip0) for texture. Mips with size less, than 2 pixels are useless.
+static unsigned int GetTextureMipCount( const unsigned int size_x, const unsigned int size_y, const unsigned int max_mips )
+{
+	unsigned int mip_count= 1u;
+	while( mip_count < max_mips && ( size_x >> mip_count ) >= 2u && ( size_y >> mip_count ) >= 2u )
+		mip_count++;
+	return mip_count;
+}
+
+// Calculates offsets of mips, returns total size of all mips. All frames of each mip are placed together.
+// Offsets and sizes are in pixels.
+static unsigned int CalculateTextureMipsOffsets(
+	const unsigned int size_x, const unsigned int size_y, const unsigned int frame_count,
+	const unsigned int mip_count,
+	unsigned int* const out_offsets )
+{
+	unsigned int offset= 0u;
+	for( unsigned int i= 0u; i < mip_count; i++ )
+	{
+		out_offsets[i]= offset;
+		offset+= ( size_x >> i ) * ( size_y >> i ) * frame_count;
+	}
+	return offset;
+}
+
+// Builds mips 1-N for each frame. Mip0 must be already filled.
+static void BuildTextureMips(
+	uint32_t* const data,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int frame_count,
+	const unsigned int mip_count, const unsigned int* const mips_offsets,
+	const bool alpha_corrected )
+{
+	for( unsigned int i= 1u; i < mip_count; i++ )
+	{
+		const unsigned int src_size_x= size_x >> ( i - 1u ), src_size_y= size_y >> ( i - 1u );
+		const unsigned int dst_size_x= size_x >> i, dst_size_y= size_y >> i;
+		for( unsigned int f= 0u; f < frame_count; f++ )
+		{
+			const uint32_t* const src= data + mips_offsets[ i - 1u ] + src_size_x * src_size_y * f;
+			uint32_t* const dst= data + mips_offsets[i] + dst_size_x * dst_size_y * f;
+			if( alpha_corrected )
+				BuildMipAlphaCorrected( src, src_size_x, src_size_y, dst );
+			else
+				BuildMip( src, src_size_x, src_size_y, dst );
+		}
+	}
+}
+
+// Selects texture mip for polygon, comparing its area in texture space with its area in screen space.
+// Scales texture coordinates of polygon for selected mip.
+static unsigned int SelectPolygonTextureMip(
+	RasterizerVertex* const vertices, const unsigned int vertex_count,
+	const unsigned int mip_count )
+{
+	// Doubled areas. Calculate it relative to first vertex, for better precision.
+	float screen_area= 0.0f, texture_area= 0.0f;
+	const RasterizerVertex& v0= vertices[0];
+	for( unsigned int i= 2u; i < vertex_count; i++ )
+	{
+		const RasterizerVertex& v1= vertices[ i - 1u ];
+		const RasterizerVertex& v2= vertices[i];
+		screen_area += float( v1.x - v0.x ) * float( v2.y - v0.y ) - float( v2.x - v0.x ) * float( v1.y - v0.y );
+		texture_area+= float( v1.u - v0.u ) * float( v2.v - v0.v ) - float( v2.u - v0.u ) * float( v1.v - v0.v );
+	}
+	screen_area= std::abs( screen_area );
+	texture_area= std::abs( texture_area );
+
+	// Select first mip, where pixel covers less, than 2x2 texels.
+	unsigned int mip= 0u;
+	while( mip + 1u < mip_count && texture_area >= 4.0f * screen_area )
+	{
+		mip++;
+		texture_area*= 0.25f;
+	}
+
+	if( mip > 0u )
+	{
+		for( unsigned int i= 0u; i < vertex_count; i++ )
+		{
+			vertices[i].u>>= mip;
+			vertices[i].v>>= mip;
+		}
+	}
+
+	return mip;
+}
+
 static void MakeBinaryAlpha( uint32_t* const pixels, const unsigned int pixel_count )
 {
 	for( unsigned int i= 0u; i < pixel_count; i++ )
@@ -104,13 +217,128 @@ static void MakeBinaryAlpha( uint32_t* const pixels, const unsigned int pixel_co
 	}
 }
 
+// Overbright constant must be equal to same constant in shader. See shaders/constants.glsl.
+static constexpr float g_lightmap_overbright= 1.3f;
+// Light of one lightmap level unit, in 16.16 format.
+static constexpr fixed16_t g_lightmap_level_light= static_cast<fixed16_t>( ( g_lightmap_overbright * 65536.0f ) / 255.0f );
+
 static fixed16_t ScaleLightmapLight( const unsigned char lightmap_value )
 {
-	// Overbright constant must be equal to same constant in shader. See shaders/constants.glsl.
-	static constexpr float c_overbright= 1.3f;
-	static constexpr fixed16_t scale= static_cast<fixed16_t>( ( c_overbright * 65536.0f ) / 255.0f );
+	return lightmap_value * g_lightmap_level_light;
+}
+
+// Maximum size of surface row with lighting, built per row.
+static constexpr unsigned int g_max_surface_light_row_size= 128u;
+
+// Produces row of light levels in 8.8 format for blocks of equal light.
+// "levels" are in 8.8 format too and contain "count" block values, preceded by left neighbor and followed by right neighbor.
+// If interpolation enabled, light is linearly interpolated between blocks centers. Steps are computed once per segment.
+static void BuildLightLevelsRow(
+	const int* const levels,
+	const unsigned int count,
+	const unsigned int block_size_log2,
+	const bool interpolate,
+	uint16_t* const out_row )
+{
+	const unsigned int block_size= 1u << block_size_log2;
+	PC_ASSERT( count * block_size <= g_max_surface_light_row_size );
+
+	if( !interpolate || block_size == 1u )
+	{
+		for( unsigned int i= 0u; i < count; i++ )
+		for( unsigned int j= 0u; j < block_size; j++ )
+			out_row[ ( i << block_size_log2 ) + j ]= static_cast<uint16_t>( levels[ i + 1u ] );
+		return;
+	}
+
+	const unsigned int half_block_size= block_size >> 1u;
+	const int half_texel_scale= int( 128u >> block_size_log2 );
+	const int texel_scale= int( 256u >> block_size_log2 );
+
+	for( unsigned int i= 0u; i < count; i++ )
+	{
+		uint16_t* const out= out_row + ( i << block_size_log2 );
+		const int prev= levels[i], cur= levels[ i + 1u ], next= levels[ i + 2u ];
+
+		// First half of block - from center of previous block to center of current block.
+		// Accumulator has 8 extra fractional bits.
+		int value= ( prev << 8 ) + ( cur - prev ) * int( block_size + 1u ) * half_texel_scale;
+		int step= ( cur - prev ) * texel_scale;
+		for( unsigned int j= 0u; j < half_block_size; j++, value+= step )
+			out[j]= static_cast<uint16_t>( value >> 8 );
+
+		// Second half of block - from center of current block to center of next block.
+		value= ( cur << 8 ) + ( next - cur ) * half_texel_scale;
+		step= ( next - cur ) * texel_scale;
+		for( unsigned int j= half_block_size; j < block_size; j++, value+= step )
+			out[j]= static_cast<uint16_t>( value >> 8 );
+	}
+}
+
+// Converts light levels in 8.8 format into light multipliers in 8.8 format.
+static void ConvertLightLevelsToLight( uint16_t* const row, const unsigned int count )
+{
+	for( unsigned int i= 0u; i < count; i++ )
+		row[i]= static_cast<uint16_t>( ( row[i] * static_cast<unsigned int>(g_lightmap_level_light) ) >> 16u );
+}
+
+// Multiplies color components of texels by light in 8.8 format, with saturation. Alpha is kept.
+static void LightTexelsRow(
+	const uint32_t* const in_texels,
+	const uint16_t* const light,
+	uint32_t* const out_texels,
+	const unsigned int count,
+	const bool use_simd )
+{
+	unsigned int x= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	if( use_simd )
+	{
+		const __m128i zero= _mm_setzero_si128();
+		const __m128i color_mask= _mm_setr_epi16( -1, -1, -1, 0, -1, -1, -1, 0 );
+		const __m128i alpha_one= _mm_setr_epi16( 0, 0, 0, 256, 0, 0, 0, 256 );
+
+		for( ; x + 4u <= count; x+= 4u )
+		{
+			const __m128i texels= _mm_loadu_si128( reinterpret_cast<const __m128i*>( in_texels + x ) );
+
+			// l0 l0 l1 l1 l2 l2 l3 l3
+			const __m128i light4= _mm_loadl_epi64( reinterpret_cast<const __m128i*>( light + x ) );
+			const __m128i light_pairs= _mm_unpacklo_epi16( light4, light4 );
+			// Duplicate light for each component, replace alpha multiplier with 1.0.
+			const __m128i light_lo= _mm_or_si128( _mm_and_si128( _mm_unpacklo_epi32( light_pairs, light_pairs ), color_mask ), alpha_one );
+			const __m128i light_hi= _mm_or_si128( _mm_and_si128( _mm_unpackhi_epi32( light_pairs, light_pairs ), color_mask ), alpha_one );
+
+			// ( c << 8 ) * l >> 16 == c * l >> 8.
+			const __m128i texels_lo= _mm_slli_epi16( _mm_unpacklo_epi8( texels, zero ), 8 );
+			const __m128i texels_hi= _mm_slli_epi16( _mm_unpackhi_epi8( texels, zero ), 8 );
+
+			const __m128i result=
+				_mm_packus_epi16(
+					_mm_mulhi_epu16( texels_lo, light_lo ),
+					_mm_mulhi_epu16( texels_hi, light_hi ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( out_texels + x ), result );
+		}
+	}
+#else
+	PC_UNUSED( use_simd );
+#endif
+
+	for( ; x < count; x++ )
+	{
+		const uint32_t texel= in_texels[x];
+		const unsigned int l= light[x];
+		unsigned char components[4];
+		for( unsigned int i= 0u; i < 3u; i++ )
+		{
+			const unsigned int c= ( reinterpret_cast<const unsigned char*>(&texel)[i] * l ) >> 8u;
+			components[i]= std::min( c, 255u );
+		}
+		components[3]= reinterpret_cast<const unsigned char*>(&texel)[3];
 
-	return lightmap_value * scale;
+		std::memcpy( &out_texels[x], components, sizeof(uint32_t) );
+	}
 }
 
 MapDrawerSoft::MapDrawerSoft(
@@ -118,6 +346,12 @@ MapDrawerSoft::MapDrawerSoft(
 	const GameResourcesConstPtr& game_resources,
 	const RenderingContextSoft& rendering_context )
 	: settings_(settings)
+	, pvs_setting_( settings.RegisterBool( SettingsKeys::software_pvs, false ) )
+	, shadows_setting_( settings.RegisterBool( SettingsKeys::shadows, true ) )
+	, surfaces_prefetch_setting_( settings.RegisterBool( SettingsKeys::software_surfaces_prefetch, true ) )
+	, dynamic_lights_setting_( settings.RegisterBool( SettingsKeys::software_dynamic_lights, true ) )
+	, debug_draw_depth_hierarchy_setting_( settings.RegisterBool( "r_debug_draw_depth_hierarchy", false ) )
+	, debug_draw_occlusion_buffer_setting_( settings.RegisterBool( "r_debug_draw_occlusion_buffer", false ) )
 	, game_resources_( game_resources )
 	, rendering_context_( rendering_context )
 	, screen_transform_x_( 0.5f * float( rendering_context_.viewport_size.Width () ) )
@@ -125,21 +359,65 @@ MapDrawerSoft::MapDrawerSoft(
 	, rasterizer_(
 		rendering_context.viewport_size.Width(), rendering_context.viewport_size.Height(),
 		rendering_context.row_pixels, rendering_context.window_surface_data )
-	, surfaces_cache_( rendering_context_.viewport_size )
+	, current_rasterizer_( &rasterizer_ )
+	, surfaces_cache_(
+		rendering_context_.viewport_size,
+		static_cast<unsigned int>( std::max( 0, settings.GetOrSetInt( SettingsKeys::software_surfaces_cache_size, 0 ) ) ) )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 
+	// Zero or negative threads count means "use all hardware threads".
+	int threads_count= settings_.GetOrSetInt( SettingsKeys::software_rendering_threads, 1 );
+	if( threads_count <= 0 )
+		threads_count= static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) );
+	threads_count= std::min( threads_count, 64 );
+	rendering_threads_count_= static_cast<unsigned int>(threads_count);
+
+	if( threads_count > 1 )
+	{
+		rendering_workers_pool_.reset( new WorkersPool( rendering_threads_count_ ) );
+		tiled_rasterizer_.reset(
+			new TiledRasterizer(
+				rasterizer_,
+				rendering_context_.viewport_size.Height(),
+				*rendering_workers_pool_ ) );
+	}
+
+	dynamic_resolution_.enabled= settings_.GetOrSetBool( SettingsKeys::software_dynamic_resolution, false );
+	if( dynamic_resolution_.enabled )
+	{
+		const int target_fps= std::max( 1, settings_.GetOrSetInt( SettingsKeys::software_dynamic_resolution_fps, 60 ) );
+		dynamic_resolution_.target_draw_time_s= g_dynamic_resolution_draw_time_fraction / float(target_fps);
+	}
+
+	// Disabled by default, because original game and OpenGL renderer have blocky lighting.
+	smooth_lighting_= settings_.GetOrSetBool( SettingsKeys::software_smooth_lighting, false );
+
+	Rasterizer::InstructionSet instruction_set= Rasterizer::GetBestInstructionSet();
+	if( !settings_.GetOrSetBool( SettingsKeys::software_rendering_simd, true ) )
+		instruction_set= Rasterizer::InstructionSet::Scalar;
+	SelectRasterizerKernels( instruction_set );
+
+	// Recorded commands of tiled rasterizer may use surfaces of current frame.
+	surfaces_cache_.SetBeforeUsedSurfaceChangeCallback(
+		[this]
+		{
+			FlushTiledRasterizer();
+		} );
+
+	std::memset( &surfaces_stats_, 0, sizeof(surfaces_stats_) );
+
 	sky_texture_.file_name[0]= '\0';
 
-	LoadModelsGroup( game_resources_->items_models, items_models_ );
-	LoadModelsGroup( game_resources_->rockets_models, rockets_models_ );
-	LoadModelsGroup( game_resources_->gibs_models, gibs_models_ );
-	LoadModelsGroup( game_resources_->weapons_models, weapons_models_ );
-	LoadModelsGroup( game_resources_->monsters_models, monsters_models_ );
+	BuildLightingColormap();
 
-	// Load effects sprites.
+	LoadModelsGroup( game_resources_, game_resources_->items_models, items_models_ );
+	LoadModelsGroup( game_resources_, game_resources_->rockets_models, rockets_models_ );
+	LoadModelsGroup( game_resources_, game_resources_->gibs_models, gibs_models_ );
+	LoadModelsGroup( game_resources_, game_resources_->weapons_models, weapons_models_ );
+	LoadModelsGroup( game_resources_, game_resources_->monsters_models, monsters_models_ );
 
-	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
+	// Prepare effects sprites. Sprites data is converted on first use, because most of sprites are not used on each map.
 
 	sprite_effects_textures_.resize( game_resources_->effects_sprites.size() );
 	for( unsigned int i= 0u; i < sprite_effects_textures_.size(); i++ )
@@ -150,11 +428,7 @@ MapDrawerSoft::MapDrawerSoft(
 		out_sprite_texture.size[0]= in_sprite.size[0];
 		out_sprite_texture.size[1]= in_sprite.size[1];
 		out_sprite_texture.size[2]= in_sprite.frame_count;
-
-		const unsigned int pixel_count= in_sprite.size[0] * in_sprite.size[1] * in_sprite.frame_count;
-		out_sprite_texture.data.resize( pixel_count );
-		for( unsigned int j= 0u; j < pixel_count; j++ )
-			out_sprite_texture.data[j]= palette[in_sprite.data[j]];
+		out_sprite_texture.source= &in_sprite;
 	}
 
 	bmp_objects_sprites_.resize( game_resources_->bmp_objects_sprites.size() );
@@ -166,17 +440,136 @@ MapDrawerSoft::MapDrawerSoft(
 		out_sprite_texture.size[0]= in_sprite.size[0];
 		out_sprite_texture.size[1]= in_sprite.size[1];
 		out_sprite_texture.size[2]= in_sprite.frame_count;
-
-		const unsigned int pixel_count= in_sprite.size[0] * in_sprite.size[1] * in_sprite.frame_count;
-		out_sprite_texture.data.resize( pixel_count );
-		for( unsigned int j= 0u; j < pixel_count; j++ )
-			out_sprite_texture.data[j]= palette[in_sprite.data[j]];
+		out_sprite_texture.source= &in_sprite;
 	}
 }
 
 MapDrawerSoft::~MapDrawerSoft()
 {}
 
+void MapDrawerSoft::SelectRasterizerKernels( const Rasterizer::InstructionSet instruction_set )
+{
+	Log::Info( "Software rasterizer instruction set: ", instruction_set == Rasterizer::InstructionSet::SSE2 ? "SSE2" : "scalar" );
+	instruction_set_= instruction_set;
+
+	// Weapon.
+	kernels_.weapon[0][0]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>( instruction_set );
+	kernels_.weapon[0][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>( instruction_set );
+	kernels_.weapon[1][0]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>( instruction_set );
+	kernels_.weapon[1][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>( instruction_set );
+
+	// Active item icon. Regular polygons are drawn with alpha test too.
+	kernels_.item_icon[0][0]=
+	kernels_.item_icon[0][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::No, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>( instruction_set );
+	kernels_.item_icon[1][0]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::No, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>( instruction_set );
+	kernels_.item_icon[1][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::No, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>( instruction_set );
+
+	// Models.
+	kernels_.models[0][0]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::No>( instruction_set );
+	kernels_.models[0][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::No>( instruction_set );
+	kernels_.models[1][0]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::No,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>( instruction_set );
+	kernels_.models[1][1]=
+		Rasterizer::GetTexturedTriangleSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>( instruction_set );
+
+	// Walls. Static walls are drawn front to back with occlusion test, dynamic walls - with depth test.
+	kernels_.static_walls[0]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::No, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::Yes>( instruction_set );
+	kernels_.static_walls[1]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::No, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::Yes>( instruction_set );
+	kernels_.dynamic_walls[0]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::Yes>( instruction_set );
+	kernels_.dynamic_walls[1]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::Yes>( instruction_set );
+
+	// Sky.
+	kernels_.sky=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::No, Rasterizer::DepthWrite::No,
+			Rasterizer::AlphaTest::No,
+			Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::No>( instruction_set );
+
+	// Sprites.
+	kernels_.effects_sprites[0]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::No, Rasterizer::Blending::Yes>( instruction_set );
+	kernels_.effects_sprites[1]=
+		Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc<
+			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
+			Rasterizer::AlphaTest::Yes,
+			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
+			Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>( instruction_set );
+	kernels_.bmp_objects_sprites= kernels_.effects_sprites[0];
+}
+
 void MapDrawerSoft::SetMap( const MapDataConstPtr& map_data )
 {
 	if( map_data == current_map_data_ )
@@ -186,19 +579,43 @@ void MapDrawerSoft::SetMap( const MapDataConstPtr& map_data )
 	if( map_data == nullptr )
 		return; // TODO - if map is null - clear resources, etc.
 
-	surfaces_cache_.Clear();
+	PC_PROFILE_LOAD_STEP( "MapDrawerSoft::SetMap" );
 
-	map_bsp_tree_.reset( new MapBSPTree( map_data ) );
+	static_lights_grid_.Build( *map_data );
+	surfaces_cache_.Clear();
+	dynamic_lights_.clear();
+	prev_dynamic_lights_.clear();
+	static_models_shadows_.clear();
+	temp_model_shadow_.model= nullptr;
 
-	LoadModelsGroup( map_data->models, map_models_ );
-	LoadWallsTextures( *map_data );
-	LoadFloorsTextures( *map_data );
-	LoadWalls( *map_data );
-	LoadFloorsAndCeilings( *map_data );
+	{
+		PC_PROFILE_LOAD_STEP( "BSP tree" );
+		map_bsp_tree_.reset( new MapBSPTree( map_data ) );
+	}
+	{
+		PC_PROFILE_LOAD_STEP( "models" );
+		LoadModelsGroup( map_data, map_data->models, map_models_ );
+	}
+	{
+		PC_PROFILE_LOAD_STEP( "textures" );
+		LoadWallsTextures( *map_data );
+		LoadFloorsTextures( *map_data );
+	}
+	{
+		PC_PROFILE_LOAD_STEP( "walls and floors" );
+		LoadWalls( *map_data );
+		LoadFloorsAndCeilings( *map_data );
+	}
+	{
+		PC_PROFILE_LOAD_STEP( "PVS" );
+		BuildMapPVS( map_data );
+	}
 
 	// Sky
 	if( std::strcmp( sky_texture_.file_name, current_map_data_->sky_texture_name ) != 0 )
 	{
+		PC_PROFILE_LOAD_STEP( "sky" );
+
 		std::strncpy( sky_texture_.file_name, current_map_data_->sky_texture_name, sizeof(sky_texture_.file_name) );
 
 		char sky_texture_file_path[ MapData::c_max_file_path_size ];
@@ -207,8 +624,15 @@ void MapDrawerSoft::SetMap( const MapDataConstPtr& map_data )
 		const Vfs::FileContent sky_texture_data= game_resources_->vfs->ReadFile( sky_texture_file_path );
 		const CelTextureHeader& cel_header= *reinterpret_cast<const CelTextureHeader*>( sky_texture_data.data() );
 
+		sky_texture_.size[0]= cel_header.size[0];
+		sky_texture_.size[1]= cel_header.size[1];
+		sky_texture_.mip_count= GetTextureMipCount( sky_texture_.size[0], sky_texture_.size[1], c_max_textures_mips );
+
 		const unsigned int sky_pixel_count= cel_header.size[0] * cel_header.size[1];
-		sky_texture_.data.resize( sky_pixel_count );
+		sky_texture_.data.resize(
+			CalculateTextureMipsOffsets(
+				sky_texture_.size[0], sky_texture_.size[1], 1u,
+				sky_texture_.mip_count, sky_texture_.mips_data_offsets ) );
 
 		const PaletteTransformed& palette= *rendering_context_.palette_transformed;
 		const unsigned char* const src= sky_texture_data.data() + sizeof(CelTextureHeader);
@@ -216,8 +640,11 @@ void MapDrawerSoft::SetMap( const MapDataConstPtr& map_data )
 		for( unsigned int i= 0u; i < sky_pixel_count; i++ )
 			sky_texture_.data[i]= palette[src[i]];
 
-		sky_texture_.size[0]= cel_header.size[0];
-		sky_texture_.size[1]= cel_header.size[1];
+		BuildTextureMips(
+			sky_texture_.data.data(),
+			sky_texture_.size[0], sky_texture_.size[1], 1u,
+			sky_texture_.mip_count, sky_texture_.mips_data_offsets,
+			false );
 	}
 }
 
@@ -228,18 +655,40 @@ void MapDrawerSoft::Draw(
 	const ViewClipPlanes& view_clip_planes,
 	const EntityId player_monster_id )
 {
+	PC_PROFILE_SCOPE( "MapDrawerSoft::Draw" );
+
 	PC_UNUSED( player_monster_id );
 
 	if( current_map_data_ == nullptr )
 		return;
 
-	rasterizer_.ClearDepthBuffer();
-	rasterizer_.ClearOcclusionBuffer();
+	const Time draw_start_time= Time::CurrentTime();
+	BeginDynamicResolutionFrame();
+
+	current_rasterizer_->ClearDepthBuffer();
+	current_rasterizer_->ClearOcclusionBuffer();
+
+	surfaces_cache_.BeginFrame();
+	frame_number_++;
+	UpdateDynamicLights( map_state );
+	shadows_built_in_frame_= 0u;
+	model_vertices_cache_.clear();
+	projected_model_vertices_.clear();
+	std::memset( &surfaces_stats_, 0, sizeof(surfaces_stats_) );
+
+	active_tiled_rasterizer_=
+		current_rasterizer_ == &rasterizer_
+			? tiled_rasterizer_.get()
+			: dynamic_resolution_.tiled_rasterizer.get();
+
+	if( map_pvs_ != nullptr && settings_.Get( pvs_setting_ ) )
+		view_cell_visibility_= map_pvs_->GetCellVisibility( camera_position.xy() );
 
 	m_Mat4 cam_shift_mat, cam_mat, screen_flip_mat;
 	cam_shift_mat.Translate( -camera_position );
 	screen_flip_mat.Scale( m_Vec3( 1.0f, -1.0f, 1.0f ) );
 	cam_mat= cam_shift_mat * view_rotation_and_projection_matrix * screen_flip_mat;
+	SetupGuardBandClipPlanes( cam_mat, view_clip_planes );
 
 	// Draw objects front to back with occlusion test.
 	// Occlusion test uses walls, floors/ceilings, sky.
@@ -247,30 +696,232 @@ void MapDrawerSoft::Draw(
 	DrawFloorsAndCeilings( cam_mat, view_clip_planes );
 	DrawSky( cam_mat, camera_position, view_clip_planes );
 
-	rasterizer_.BuildDepthBufferHierarchy();
+	// Depth hierarchy needs depth buffer with all world.
+	FlushTiledRasterizer();
+	BuildDepthBufferHierarchy();
 
-	// Draw regular polygons of models, than transparent
-	for( unsigned int t= 0u; t < 2u; t++ )
+	// Collect models once for both drawing passes.
+	models_draw_requests_.clear();
+
+	for( const MapState::StaticModel& static_model : map_state.GetStaticModels() )
+	{
+		if( static_model.model_id >= current_map_data_->models_description.size() ||
+			!static_model.visible )
+			continue;
+
+		m_Mat4 rotate_mat;
+		rotate_mat.RotateZ( static_model.angle );
+
+		AddModelDrawRequest(
+			*map_models_, current_map_data_->models, static_model.model_id,
+			static_model.animation_frame,
+			static_model.pos, rotate_mat,
+			255u );
+	}
+
+	for( const MapState::Item& item : map_state.GetItems() )
+	{
+		if( item.item_id >= game_resources_->items_models.size() ||
+			item.picked_up )
+			continue;
+
+		m_Mat4 rotate_mat;
+		rotate_mat.RotateZ( item.angle );
+
+		AddModelDrawRequest(
+			*items_models_, game_resources_->items_models, item.item_id,
+			item.animation_frame,
+			item.pos, rotate_mat,
+			255u );
+	}
+
+	for( const MapState::DynamicItemsContainer::value_type& dynamic_item_value : map_state.GetDynamicItems() )
+	{
+		const MapState::DynamicItem& item= dynamic_item_value.second;
+		if( item.item_type_id >= game_resources_->items_models.size() )
+			continue;
+
+		m_Mat4 rotate_mat;
+		rotate_mat.RotateZ( item.angle );
+
+		AddModelDrawRequest(
+			*items_models_, game_resources_->items_models, item.item_type_id,
+			item.frame,
+			item.pos, rotate_mat,
+			255u, false, item.fullbright );
+	}
+
+	for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
+	{
+		const MapState::Rocket& rocket= rocket_value.second;
+		if( rocket.rocket_id >= game_resources_->rockets_models.size() )
+			continue;
+
+		m_Mat4 rotate_max_x, rotate_mat_z;
+		rotate_max_x.RotateX( rocket.angle[1] );
+		rotate_mat_z.RotateZ( rocket.angle[0] - Constants::half_pi );
+
+		AddModelDrawRequest(
+			*rockets_models_, game_resources_->rockets_models, rocket.rocket_id,
+			rocket.frame,
+			rocket.pos, rotate_max_x * rotate_mat_z,
+			255u, false, game_resources_->rockets_description[ rocket.rocket_id ].fullbright );
+	}
+
+	for( const MapState::Gib& gib : map_state.GetGibs() )
+	{
+		if( gib.gib_id >= gibs_models_->models.size() )
+			continue;
+
+		m_Mat4 rotate_max_x, rotate_mat_z;
+		rotate_max_x.RotateX( gib.angle_x );
+		rotate_mat_z.RotateZ( gib.angle_z );
+
+		AddModelDrawRequest(
+			*gibs_models_, game_resources_->gibs_models, gib.gib_id,
+			0u,
+			gib.pos, rotate_max_x * rotate_mat_z,
+			255u );
+	}
+
+	for( const MapState::MonstersContainer::value_type& monster_value : map_state.GetMonsters() )
+	{
+		const MapState::Monster& monster= monster_value.second;
+		if( monster.monster_id >= game_resources_->monsters_models.size() )
+			continue;
+
+		if( monster_value.first == player_monster_id )
+			continue;
+
+		const unsigned int frame=
+			game_resources_->monsters_models[ monster.monster_id ].animations[ monster.animation ].first_frame +
+			monster.animation_frame;
+
+		m_Mat4 rotate_mat;
+		rotate_mat.RotateZ( monster.angle + Constants::half_pi );
+
+		AddModelDrawRequest(
+			*monsters_models_, game_resources_->monsters_models, monster.monster_id,
+			frame,
+			monster.pos, rotate_mat,
+			monster.body_parts_mask, monster.is_invisible, false, ~0u, monster.color );
+	}
+
+	for( const MapState::MonsterBodyPart& part : map_state.GetMonstersBodyParts() )
+	{
+		if( part.monster_type >= game_resources_->monsters_models.size() )
+			continue;
+
+		PC_ASSERT( part.body_part_id <= game_resources_->monsters_models[ part.monster_type ].submodels.size() );
+
+		const Submodel& submodel= game_resources_->monsters_models[ part.monster_type ].submodels[ part.body_part_id ];
+		const unsigned int frame= submodel.animations[ part.animation ].first_frame + part.animation_frame;
+
+		m_Mat4 rotate_mat;
+		rotate_mat.RotateZ( part.angle + Constants::half_pi );
+
+		AddModelDrawRequest(
+			*monsters_models_, game_resources_->monsters_models, part.monster_type,
+			frame,
+			part.pos, rotate_mat,
+			255u, false, false, part.body_part_id );
+	}
+
+	CheckModelsDepthOcclusion( cam_mat );
+
+	// Draw regular polygons of models.
+	// Collect models with transparent polygons and models with forced transparency for transparent pass.
+	transparent_models_draw_order_.clear();
+	for( unsigned int r= 0u; r < models_draw_requests_.size(); r++ )
+	{
+		ModelDrawRequest& request= models_draw_requests_[r];
+		if( request.occluded )
+			continue;
+
+		const Model& base_model= (*request.model_group_models)[ request.model_id ];
+		const Submodel& model= ( request.submodel_id == ~0u ) ? base_model : base_model.submodels[ request.submodel_id ];
+
+		if( !model.transparent_triangles_indeces.empty() || request.force_transparent_nontransparent_polygons )
+		{
+			request.depth=
+				request.position.x * cam_mat.value[3] + request.position.y * cam_mat.value[7] +
+				request.position.z * cam_mat.value[11] + cam_mat.value[15];
+			transparent_models_draw_order_.push_back(r);
+		}
+
+		if( request.force_transparent_nontransparent_polygons )
+			continue;
+
+		DrawModel(
+			*request.models_group, *request.model_group_models, request.model_id,
+			request.animation_frame,
+			view_clip_planes,
+			request.position, request.rotation_matrix,
+			cam_mat, camera_position,
+			request.visible_groups_mask,
+			false, false,
+			request.fullbright,
+			request.submodel_id, request.color );
+	}
+
+	// Draw transparent polygons back to front, because blending result depends on order.
+	std::stable_sort(
+		transparent_models_draw_order_.begin(),
+		transparent_models_draw_order_.end(),
+		[this]( const unsigned int a, const unsigned int b )
+		{
+			return models_draw_requests_[a].depth > models_draw_requests_[b].depth;
+		} );
+
+	for( const unsigned int r : transparent_models_draw_order_ )
 	{
-		const bool transparent= t == 1u;
+		const ModelDrawRequest& request= models_draw_requests_[r];
+
+		const unsigned int first_pass= request.force_transparent_nontransparent_polygons ? 0u : 1u;
+		for( unsigned int t= first_pass; t < 2u; t++ )
+			DrawModel(
+				*request.models_group, *request.model_group_models, request.model_id,
+				request.animation_frame,
+				view_clip_planes,
+				request.position, request.rotation_matrix,
+				cam_mat, camera_position,
+				request.visible_groups_mask,
+				t == 1u, request.force_transparent_nontransparent_polygons,
+				request.fullbright,
+				request.submodel_id, request.color );
+	}
 
-		for( const MapState::StaticModel& static_model : map_state.GetStaticModels() )
+	// Shadows.
+	if( settings_.Get( shadows_setting_ ) )
+	{
+		const MapState::StaticModels& static_models= map_state.GetStaticModels();
+		static_models_shadows_.resize( static_models.size() );
+		for( const MapState::StaticModel& static_model : static_models )
 		{
 			if( static_model.model_id >= current_map_data_->models_description.size() ||
 				!static_model.visible )
 				continue;
 
+			const MapData::ModelDescription& description= current_map_data_->models_description[ static_model.model_id ];
+			if( !description.cast_shadow )
+				continue;
+
+			m_Vec3 light_pos;
+			if( !GetNearestLightSourcePos( static_model.pos, *current_map_data_, static_lights_grid_, map_state, false, light_pos ) )
+				continue;
+
 			m_Mat4 rotate_mat;
 			rotate_mat.RotateZ( static_model.angle );
 
-			DrawModel(
-				map_models_, current_map_data_->models, static_model.model_id,
+			DrawModelShadow(
+				current_map_data_->models[ static_model.model_id ],
 				static_model.animation_frame,
 				view_clip_planes,
 				static_model.pos, rotate_mat,
-				cam_mat, camera_position,
+				cam_mat, camera_position, light_pos,
 				255u,
-				transparent, false );
+				~0u,
+				&static_models_shadows_[ &static_model - static_models.data() ] );
 		}
 
 		for( const MapState::Item& item : map_state.GetItems() )
@@ -279,172 +930,12 @@ void MapDrawerSoft::Draw(
 				item.picked_up )
 				continue;
 
-			m_Mat4 rotate_mat;
-			rotate_mat.RotateZ( item.angle );
-
-			DrawModel(
-				items_models_, game_resources_->items_models, item.item_id,
-				item.animation_frame,
-				view_clip_planes,
-				item.pos, rotate_mat,
-				cam_mat, camera_position,
-				255u,
-				transparent, false );
-		}
-
-		for( const MapState::DynamicItemsContainer::value_type& dynamic_item_value : map_state.GetDynamicItems() )
-		{
-			const MapState::DynamicItem& item= dynamic_item_value.second;
-			if( item.item_type_id >= game_resources_->items_models.size() )
-				continue;
-
-			m_Mat4 rotate_mat;
-			rotate_mat.RotateZ( item.angle );
-
-			DrawModel(
-				items_models_, game_resources_->items_models, item.item_type_id,
-				item.frame,
-				view_clip_planes,
-				item.pos, rotate_mat,
-				cam_mat, camera_position,
-				255u,
-				transparent, false,
-				item.fullbright );
-		}
-
-		for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
-		{
-			const MapState::Rocket& rocket= rocket_value.second;
-			if( rocket.rocket_id >= game_resources_->rockets_models.size() )
-				continue;
-
-			m_Mat4 rotate_max_x, rotate_mat_z;
-			rotate_max_x.RotateX( rocket.angle[1] );
-			rotate_mat_z.RotateZ( rocket.angle[0] - Constants::half_pi );
-
-			DrawModel(
-				rockets_models_, game_resources_->rockets_models, rocket.rocket_id,
-				rocket.frame,
-				view_clip_planes,
-				rocket.pos, rotate_max_x * rotate_mat_z,
-				cam_mat, camera_position,
-				255u,
-				transparent, false,
-				game_resources_->rockets_description[ rocket.rocket_id ].fullbright );
-		}
-
-		for( const MapState::Gib& gib : map_state.GetGibs() )
-		{
-			if( gib.gib_id >= gibs_models_.models.size() )
-				continue;
-
-			m_Mat4 rotate_max_x, rotate_mat_z;
-			rotate_max_x.RotateX( gib.angle_x );
-			rotate_mat_z.RotateZ( gib.angle_z );
-
-			DrawModel(
-				gibs_models_, game_resources_->gibs_models, gib.gib_id,
-				0u,
-				view_clip_planes,
-				gib.pos, rotate_max_x * rotate_mat_z,
-				cam_mat, camera_position,
-				255u, transparent );
-		}
-
-		for( const MapState::MonstersContainer::value_type& monster_value : map_state.GetMonsters() )
-		{
-			const MapState::Monster& monster= monster_value.second;
-			if( monster.monster_id >= game_resources_->monsters_models.size() )
-				continue;
-
-			if( monster_value.first == player_monster_id )
-				continue;
-
-			const unsigned int frame=
-				game_resources_->monsters_models[ monster.monster_id ].animations[ monster.animation ].first_frame +
-				monster.animation_frame;
-
-			m_Mat4 rotate_mat;
-			rotate_mat.RotateZ( monster.angle + Constants::half_pi );
-
-			DrawModel(
-				monsters_models_, game_resources_->monsters_models, monster.monster_id,
-				frame,
-				view_clip_planes,
-				monster.pos, rotate_mat,
-				cam_mat, camera_position,
-				monster.body_parts_mask,
-				transparent, monster.is_invisible,
-				false, ~0u, monster.color );
-		}
-
-		for( const MapState::MonsterBodyPart& part : map_state.GetMonstersBodyParts() )
-		{
-			if( part.monster_type >= game_resources_->monsters_models.size() )
-				continue;
-
-			PC_ASSERT( part.body_part_id <= game_resources_->monsters_models[ part.monster_type ].submodels.size() );
-
-			const Submodel& submodel= game_resources_->monsters_models[ part.monster_type ].submodels[ part.body_part_id ];
-			const unsigned int frame= submodel.animations[ part.animation ].first_frame + part.animation_frame;
-
-			m_Mat4 rotate_mat;
-			rotate_mat.RotateZ( part.angle + Constants::half_pi );
-
-			DrawModel(
-				monsters_models_, game_resources_->monsters_models, part.monster_type,
-				frame,
-				view_clip_planes,
-				part.pos, rotate_mat,
-				cam_mat, camera_position,
-				255u,
-				transparent, false,
-				false,
-				part.body_part_id );
-		}
-	}
-
-	// Shadows.
-	if( settings_.GetOrSetBool( SettingsKeys::shadows, true ) )
-	{
-		for( const MapState::StaticModel& static_model : map_state.GetStaticModels() )
-		{
-			if( static_model.model_id >= current_map_data_->models_description.size() ||
-				!static_model.visible )
-				continue;
-
-			const MapData::ModelDescription& description= current_map_data_->models_description[ static_model.model_id ];
-			if( !description.cast_shadow )
-				continue;
-
-			m_Vec3 light_pos;
-			if( !GetNearestLightSourcePos( static_model.pos, *current_map_data_, map_state, false, light_pos ) )
-				continue;
-
-			m_Mat4 rotate_mat;
-			rotate_mat.RotateZ( static_model.angle );
-
-			DrawModelShadow(
-				current_map_data_->models[ static_model.model_id ],
-				static_model.animation_frame,
-				view_clip_planes,
-				static_model.pos, rotate_mat,
-				cam_mat, camera_position, light_pos,
-				255u );
-		}
-
-		for( const MapState::Item& item : map_state.GetItems() )
-		{
-			if( item.item_id >= game_resources_->items_models.size() ||
-				item.picked_up )
-				continue;
-
-			const GameResources::ItemDescription& description= game_resources_->items_description[ item.item_id ];
-			if( !description.cast_shadow )
-				continue;
+			const GameResources::ItemDescription& description= game_resources_->items_description[ item.item_id ];
+			if( !description.cast_shadow )
+				continue;
 
 			m_Vec3 light_pos;
-			if( !GetNearestLightSourcePos( item.pos, *current_map_data_, map_state, true, light_pos ) )
+			if( !GetNearestLightSourcePos( item.pos, *current_map_data_, static_lights_grid_, map_state, true, light_pos ) )
 				continue;
 
 			m_Mat4 rotate_mat;
@@ -470,7 +961,7 @@ void MapDrawerSoft::Draw(
 				continue;
 
 			m_Vec3 light_pos;
-			if( !GetNearestLightSourcePos( monster.pos, *current_map_data_, map_state, true, light_pos ) )
+			if( !GetNearestLightSourcePos( monster.pos, *current_map_data_, static_lights_grid_, map_state, true, light_pos ) )
 				continue;
 
 			const unsigned int frame=
@@ -495,10 +986,20 @@ void MapDrawerSoft::Draw(
 	DrawEffectsSprites( map_state, cam_mat, camera_position, view_clip_planes );
 	DrawBMPObjectsSprites( map_state, cam_mat, camera_position, view_clip_planes );
 
-	if( settings_.GetOrSetBool( "r_debug_draw_depth_hierarchy", false ) )
-		rasterizer_.DebugDrawDepthHierarchy( static_cast<unsigned int>(map_state.GetSpritesFrame()) / 16u );
-	if( settings_.GetOrSetBool( "r_debug_draw_occlusion_buffer", false ) )
-		rasterizer_.DebugDrawOcclusionBuffer( static_cast<unsigned int>(map_state.GetSpritesFrame()) / 32u );
+	// Prefetch before last flush, because in tiled mode prefetched surfaces are built in parallel at flush.
+	if( settings_.Get( surfaces_prefetch_setting_ ) )
+		PrefetchSurfaces( camera_position, view_rotation_and_projection_matrix );
+
+	FlushTiledRasterizer();
+	active_tiled_rasterizer_= nullptr;
+	view_cell_visibility_= nullptr;
+
+	if( settings_.Get( debug_draw_depth_hierarchy_setting_ ) )
+		current_rasterizer_->DebugDrawDepthHierarchy( static_cast<unsigned int>(map_state.GetSpritesFrame()) / 16u );
+	if( settings_.Get( debug_draw_occlusion_buffer_setting_ ) )
+		current_rasterizer_->DebugDrawOcclusionBuffer( static_cast<unsigned int>(map_state.GetSpritesFrame()) / 32u );
+
+	EndDynamicResolutionFrame( draw_start_time );
 }
 
 void MapDrawerSoft::DrawWeapon(
@@ -531,10 +1032,10 @@ void MapDrawerSoft::DrawWeapon(
 
 	const unsigned int first_animation_vertex= model.animations_vertices.size() / model.frame_count * frame;
 
-	const ModelsGroup::ModelEntry& model_entry= weapons_models_.models[ weapon_state.CurrentWeaponIndex() ];
-	rasterizer_.SetTexture(
+	const ModelsGroup::ModelEntry& model_entry= weapons_models_->models[ weapon_state.CurrentWeaponIndex() ];
+	SetTexture(
 		model_entry.texture_size[0], model_entry.texture_size[1],
-		weapons_models_.textures_data.data() + model_entry.texture_data_offset );
+		weapons_models_->textures_data.data() + model_entry.mips_data_offsets[0] );
 
 	{ // Set light.
 		fixed16_t light= g_fixed16_one;
@@ -543,40 +1044,11 @@ void MapDrawerSoft::DrawWeapon(
 		if( lightmap_x < MapData::c_lightmap_size && lightmap_y < MapData::c_lightmap_size )
 				light= ScaleLightmapLight( current_map_data_->lightmap[ lightmap_x + lightmap_y * MapData::c_lightmap_size ] );
 
-		rasterizer_.SetLight( light );
+		SetLight( light );
 	}
 
-	Rasterizer::TriangleDrawFunc draw_func, alpha_draw_func;
-	if( invisible )
-	{
-		draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>;
-		alpha_draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>;
-	}
-	else
-	{
-		draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>;
-		alpha_draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>;
-	}
+	const Rasterizer::TriangleDrawFunc draw_func= kernels_.weapon[ invisible ? 1u : 0u ][0];
+	const Rasterizer::TriangleDrawFunc alpha_draw_func= kernels_.weapon[ invisible ? 1u : 0u ][1];
 
 	for( unsigned int t= 0u; t < model.regular_triangles_indeces.size(); t+= 3u )
 	{
@@ -637,7 +1109,7 @@ void MapDrawerSoft::DrawWeapon(
 		{
 			traingle_vertices[1]= verties_projected[ i + 1u ];
 			traingle_vertices[2]= verties_projected[ i + 2u ];
-			(rasterizer_.*triangle_func)( traingle_vertices );
+			DrawTriangle( triangle_func, traingle_vertices );
 		}
 	} // for model triangles
 }
@@ -666,10 +1138,10 @@ void MapDrawerSoft::DrawActiveItemIcon(
 	view_mat= rotate_mat * shift_mat * proj_mat;
 
 	const Model& model= game_resources_->items_models[ icon_item_id ];
-	const ModelsGroup::ModelEntry& model_entry= items_models_.models[ icon_item_id ];
-	rasterizer_.SetTexture(
+	const ModelsGroup::ModelEntry& model_entry= items_models_->models[ icon_item_id ];
+	SetTexture(
 		model_entry.texture_size[0], model_entry.texture_size[1],
-		items_models_.textures_data.data() + model_entry.texture_data_offset );
+		items_models_->textures_data.data() + model_entry.mips_data_offsets[0] );
 
 	const unsigned int frame_number=
 		static_cast<unsigned int>(map_state.GetSpritesFrame()) %
@@ -678,37 +1150,8 @@ void MapDrawerSoft::DrawActiveItemIcon(
 
 	for( unsigned int transparent= 0u; transparent < 2u; ++transparent )
 	{
-		Rasterizer::TriangleDrawFunc draw_func, alpha_draw_func;
-		if( transparent == 1u )
-		{
-			draw_func=
-				&Rasterizer::DrawTexturedTriangleSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::No,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::No, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>;
-			alpha_draw_func=
-				&Rasterizer::DrawTexturedTriangleSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::Yes,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::No, Rasterizer::Blending::Yes, Rasterizer::DepthHack::Yes>;
-		}
-		else
-		{
-			draw_func=
-				&Rasterizer::DrawTexturedTriangleSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::Yes,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::No, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>;
-			alpha_draw_func=
-				&Rasterizer::DrawTexturedTriangleSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::Yes,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::No, Rasterizer::Blending::No, Rasterizer::DepthHack::Yes>;
-		}
+		const Rasterizer::TriangleDrawFunc draw_func= kernels_.item_icon[ transparent ][0];
+		const Rasterizer::TriangleDrawFunc alpha_draw_func= kernels_.item_icon[ transparent ][1];
 
 		const std::vector<unsigned short>& indeces=
 			transparent == 1u ? model.transparent_triangles_indeces : model.regular_triangles_indeces;
@@ -742,9 +1185,9 @@ void MapDrawerSoft::DrawActiveItemIcon(
 
 			const bool triangle_needs_alpha_test= model.vertices[ indeces[t] ].alpha_test_mask != 0u;
 			if( triangle_needs_alpha_test )
-				(rasterizer_.*alpha_draw_func)( verties_projected );
+				DrawTriangle( alpha_draw_func, verties_projected );
 			else
-				(rasterizer_.*draw_func)( verties_projected );
+				DrawTriangle( draw_func, verties_projected );
 		} // for model triangles
 	} // for transparent and nontransparent
 }
@@ -782,11 +1225,14 @@ void MapDrawerSoft::DrawMapRelatedModels(
 		return;
 
 	rasterizer_.ClearDepthBuffer();
+	model_vertices_cache_.clear();
+	projected_model_vertices_.clear();
 
 	m_Mat4 cam_shift_mat, cam_mat, screen_flip_mat;
 	cam_shift_mat.Translate( -camera_position );
 	screen_flip_mat.Scale( m_Vec3( 1.0f, -1.0f, 1.0f ) );
 	cam_mat= cam_shift_mat * view_rotation_and_projection_matrix * screen_flip_mat;
+	SetupGuardBandClipPlanes( cam_mat, view_clip_planes );
 
 	for( unsigned int t= 0u; t < 2u; t++ )
 	{
@@ -802,7 +1248,7 @@ void MapDrawerSoft::DrawMapRelatedModels(
 			rotate_mat.RotateZ( model.angle_z );
 
 			DrawModel(
-				map_models_, current_map_data_->models, model.model_id,
+				*map_models_, current_map_data_->models, model.model_id,
 				model.frame,
 				view_clip_planes,
 				model.pos, rotate_mat,
@@ -812,18 +1258,122 @@ void MapDrawerSoft::DrawMapRelatedModels(
 	}
 }
 
-void MapDrawerSoft::LoadModelsGroup( const std::vector<Model>& models, ModelsGroup& out_group )
+void MapDrawerSoft::GetFrameStats( std::vector<std::string>& out_lines ) const
+{
+	static const char* const c_kind_names[ SurfacesStats::KindCount ]= { "walls", "floors" };
+
+	char str[128];
+
+	std::snprintf(
+		str, sizeof(str), "surfaces cache: %ukb",
+		( surfaces_cache_.GetStorageSize() + 1023u ) / 1024u );
+	out_lines.emplace_back( str );
+
+	for( unsigned int kind= 0u; kind < SurfacesStats::KindCount; kind++ )
+	for( unsigned int mip= 0u; mip < 4u; mip++ )
+	{
+		std::snprintf(
+			str, sizeof(str), "%s mip%u: allocated %u, texels %u, rebuilt %u",
+			c_kind_names[kind], mip,
+			surfaces_stats_.allocated_surfaces[kind][mip],
+			surfaces_stats_.built_texels[kind][mip],
+			surfaces_stats_.rebuilt_surfaces[kind][mip] );
+		out_lines.emplace_back( str );
+	}
+
+	const SurfacesCache::FrameStats& cache_stats= surfaces_cache_.GetFrameStats();
+	std::snprintf(
+		str, sizeof(str), "recycled: %u surfaces, %ukb, %u used in frame",
+		cache_stats.recycled_surfaces,
+		( cache_stats.recycled_bytes + 1023u ) / 1024u,
+		cache_stats.recycled_used_surfaces );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "moved: %u surfaces, %ukb",
+		cache_stats.moved_surfaces,
+		( cache_stats.moved_bytes + 1023u ) / 1024u );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "models: %u, depth tested %u, occluded %u",
+		static_cast<unsigned int>( models_draw_requests_.size() ),
+		static_cast<unsigned int>( models_depth_queries_.size() ),
+		models_occluded_count_ );
+	out_lines.emplace_back( str );
+
+	std::snprintf( str, sizeof(str), "shadows rebuilt: %u", shadows_built_in_frame_ );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "dynamic lights: %u, freed surfaces: %u",
+		static_cast<unsigned int>( dynamic_lights_.size() ),
+		dynamic_lights_freed_surfaces_ );
+	out_lines.emplace_back( str );
+
+	if( dynamic_resolution_.enabled )
+	{
+		std::snprintf(
+			str, sizeof(str), "dynamic resolution: %u/%u, world draw %.2f ms",
+			dynamic_resolution_.scale, c_dynamic_resolution_scale_denominator,
+			1000.0f * dynamic_resolution_.average_draw_time_s );
+		out_lines.emplace_back( str );
+	}
+}
+
+void MapDrawerSoft::BuildLightingColormap()
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
 
-	unsigned int texel_count= 0u;
-	for( const Model& model : models )
-		texel_count+= model.texture_data.size();
+	lighting_colormap_.resize( 256u * 256u );
+	for( unsigned int l= 0u; l < 256u; l++ )
+	{
+		const fixed16_t light= ScaleLightmapLight( static_cast<unsigned char>(l) );
+		uint32_t* const dst= lighting_colormap_.data() + l * 256u;
+
+		for( unsigned int i= 0u; i < 256u; i++ )
+		{
+			const uint32_t color= palette[i];
+			unsigned char components[4];
+			for( unsigned int j= 0u; j < 3u; j++ )
+			{
+				const unsigned int c= reinterpret_cast<const unsigned char*>(&color)[j] * static_cast<unsigned int>(light) >> 16u;
+				components[j]= std::min( c, 255u );
+			}
+			components[3]= reinterpret_cast<const unsigned char*>(&color)[3];
+
+			std::memcpy( &dst[i], components, sizeof(uint32_t) );
+		}
+	}
+}
+
+void MapDrawerSoft::LoadModelsGroup(
+	const std::shared_ptr<const void>& models_owner,
+	const std::vector<Model>& models,
+	ModelsGroupConstPtr& out_group )
+{
+	static ModelsConversionCache<ModelsGroup> cache;
+
+	// Result depends only on pixel format, because palette is same for all drawers.
+	unsigned int params= 0u;
+	std::memcpy( &params, rendering_context_.color_indeces_rgba, sizeof(params) );
+
+	out_group=
+		cache.Get(
+			models_owner, models, params,
+			[this]( const std::vector<Model>& in_models, ModelsGroup& out_converted_group )
+			{
+				ConvertModelsGroup( in_models, out_converted_group );
+			} );
+}
+
+void MapDrawerSoft::ConvertModelsGroup( const std::vector<Model>& models, ModelsGroup& out_group ) const
+{
+	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
 
-	out_group.textures_data.resize( texel_count );
 	out_group.models.resize( models.size() );
 
-	unsigned int texture_data_offset= 0u;
+	unsigned int texel_count= 0u;
 	for( unsigned int m= 0u; m < out_group.models.size(); m++ )
 	{
 		const Model& in_model= models[m];
@@ -831,17 +1381,38 @@ void MapDrawerSoft::LoadModelsGroup( const std::vector<Model>& models, ModelsGro
 
 		model_entry.texture_size[0]= in_model.texture_size[0];
 		model_entry.texture_size[1]= in_model.texture_size[1];
-		model_entry.texture_data_offset= texture_data_offset;
+		model_entry.mip_count= GetTextureMipCount( in_model.texture_size[0], in_model.texture_size[1], c_max_textures_mips );
+
+		const unsigned int mips_size=
+			CalculateTextureMipsOffsets(
+				in_model.texture_size[0], in_model.texture_size[1], 1u,
+				model_entry.mip_count, model_entry.mips_data_offsets );
+		for( unsigned int i= 0u; i < model_entry.mip_count; i++ )
+			model_entry.mips_data_offsets[i]+= texel_count;
+		texel_count+= mips_size;
+	}
+
+	out_group.textures_data.resize( texel_count );
+
+	for( unsigned int m= 0u; m < out_group.models.size(); m++ )
+	{
+		const Model& in_model= models[m];
+		const ModelsGroup::ModelEntry& model_entry= out_group.models[m];
+		uint32_t* const texture_data= out_group.textures_data.data() + model_entry.mips_data_offsets[0];
 
 		for( unsigned int t= 0u; t < in_model.texture_data.size(); t++ )
 		{
 			const unsigned char color_index= in_model.texture_data[t];
 			uint32_t color= palette[ color_index ];
 			if( color_index == 0u ) color&= ~Rasterizer::c_alpha_mask; // For models color #0 is transparent.
-			out_group.textures_data[ texture_data_offset + t ]= color;
+			texture_data[t]= color;
 		}
 
-		texture_data_offset+= in_model.texture_data.size();
+		BuildTextureMips(
+			out_group.textures_data.data(),
+			model_entry.texture_size[0], model_entry.texture_size[1], 1u,
+			model_entry.mip_count, model_entry.mips_data_offsets,
+			true );
 	}
 }
 
@@ -850,11 +1421,20 @@ void MapDrawerSoft::LoadWallsTextures( const MapData& map_data )
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
 
 	std::vector<unsigned char> file_content;
+	std::vector<uint32_t> mip0_rgba;
+
+	// Neighbor maps often share most of textures. Reuse textures of previous map with same source file content.
+	// Moving does not change data buffers, so, mips pointers stay valid.
+	std::vector<WallTexture> prev_textures( MapData::c_max_walls_textures );
+	for( unsigned int i= 0u; i < MapData::c_max_walls_textures; i++ )
+		prev_textures[i]= std::move( wall_textures_[i] );
+	unsigned int reused_texture_count= 0u;
 
 	for( unsigned int i= 0u; i < MapData::c_max_walls_textures; i++ )
 	{
 		WallTexture& out_texture= wall_textures_[i];
 		out_texture.size[0]= out_texture.size[1]= 0u;
+		out_texture.content_hash= 0u;
 
 		const char* const texture_file_path= map_data.walls_textures[i].file_path;
 		if( texture_file_path[0] == '\n' )
@@ -872,22 +1452,44 @@ void MapDrawerSoft::LoadWallsTextures( const MapData& map_data )
 			continue;
 		}
 
+		const unsigned int content_hash= SaveHeader::CalculateHash( file_content.data(), file_content.size() );
+		bool reused= false;
+		for( WallTexture& prev_texture : prev_textures )
+		{
+			if( prev_texture.content_hash == content_hash && content_hash != 0u )
+			{
+				out_texture= std::move( prev_texture );
+				prev_texture.content_hash= 0u; // Each texture may be taken only once.
+				reused= true;
+				break;
+			}
+		}
+		if( reused )
+		{
+			reused_texture_count++;
+			continue;
+		}
+		out_texture.content_hash= content_hash;
+
 		out_texture.size[0]= header.size[0];
 		out_texture.size[1]= g_wall_texture_height;
 
 		const unsigned int pixel_count= header.size[0] * g_wall_texture_height;
-		const unsigned int storage_size= pixel_count + pixel_count / 4u + pixel_count / 16u + pixel_count / 64u;
+		const unsigned int storage_size= pixel_count / 4u + pixel_count / 16u + pixel_count / 64u;
 		const unsigned char* const src= file_content.data() + sizeof(CelTextureHeader);
 
+		out_texture.mip0.assign( src, src + pixel_count );
+
 		out_texture.data.resize( storage_size );
-		out_texture.mip0= out_texture.data.data();
-		out_texture.mips[0]= out_texture.mip0 + pixel_count;
+		out_texture.mips[0]= out_texture.data.data();
 		out_texture.mips[1]= out_texture.mips[0] + pixel_count /  4u;
 		out_texture.mips[2]= out_texture.mips[1] + pixel_count / 16u;
 
+		// Mips are not indexed, so, build it from true color mip0.
+		mip0_rgba.resize( pixel_count );
 		for( unsigned int j= 0u; j < pixel_count; j++ )
-			out_texture.mip0[j]= palette[ src[j] ];
-		BuildMipAlphaCorrected( out_texture.mip0   , out_texture.size[0]     , out_texture.size[1]     , out_texture.mips[0] );
+			mip0_rgba[j]= palette[ src[j] ];
+		BuildMipAlphaCorrected( mip0_rgba.data()   , out_texture.size[0]     , out_texture.size[1]     , out_texture.mips[0] );
 		BuildMipAlphaCorrected( out_texture.mips[0], out_texture.size[0] / 2u, out_texture.size[1] / 2u, out_texture.mips[1] );
 		BuildMipAlphaCorrected( out_texture.mips[1], out_texture.size[0] / 4u, out_texture.size[1] / 4u, out_texture.mips[2] );
 		MakeBinaryAlpha( out_texture.mips[0], pixel_count /  4u );
@@ -959,20 +1561,25 @@ void MapDrawerSoft::LoadWallsTextures( const MapData& map_data )
 		}
 		out_texture.has_alpha= has_alpha;
 	}
+
+	Log::Info( "Reused ", reused_texture_count, " walls textures of previous map" );
 }
 
 void MapDrawerSoft::LoadFloorsTextures( const MapData& map_data )
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
 
+	uint32_t mip0_rgba[ MapData::c_floor_texture_size * MapData::c_floor_texture_size ];
+
 	for( unsigned int i= 0u; i < MapData::c_floors_textures_count; i++ )
 	{
-		const unsigned char* const src= map_data.floor_textures_data[i];
-		uint32_t* const dst= floor_textures_[i].data;
+		const unsigned char* const src= map_data.floor_textures_data[i].data();
+		std::memcpy( floor_textures_[i].mip0, src, sizeof(floor_textures_[i].mip0) );
+
 		for( unsigned int j= 0u; j < MapData::c_floor_texture_size * MapData::c_floor_texture_size; j++ )
-			dst[j]= palette[ src[j] ];
+			mip0_rgba[j]= palette[ src[j] ];
 
-		BuildMip( floor_textures_[i].data, MapData::c_floor_texture_size     , MapData::c_floor_texture_size     , floor_textures_[i].mip1 );
+		BuildMip( mip0_rgba, MapData::c_floor_texture_size     , MapData::c_floor_texture_size     , floor_textures_[i].mip1 );
 		BuildMip( floor_textures_[i].mip1, MapData::c_floor_texture_size / 2u, MapData::c_floor_texture_size / 2u, floor_textures_[i].mip2 );
 		BuildMip( floor_textures_[i].mip2, MapData::c_floor_texture_size / 4u, MapData::c_floor_texture_size / 4u, floor_textures_[i].mip3 );
 	}
@@ -991,9 +1598,12 @@ void MapDrawerSoft::LoadWalls( const MapData& map_data )
 
 		out_wall.texture_id= in_wall.texture_id;
 		std::memcpy( out_wall.lightmap, in_wall.lightmap, 8u );
+		std::memset( out_wall.dynamic_light, 0, sizeof(out_wall.dynamic_light) );
 
 		for( SurfacesCache::Surface*& surf_ptr : out_wall.mips_surfaces )
 			surf_ptr= nullptr;
+		for( unsigned int& build_frame : out_wall.mips_build_frame )
+			build_frame= 0u;
 	};
 
 	for( unsigned int i= 0u; i < static_walls_ .size(); i++ )
@@ -1006,18 +1616,21 @@ void MapDrawerSoft::LoadWalls( const MapData& map_data )
 MapDrawerSoft::TextureView MapDrawerSoft::GetPlayerTexture( const unsigned char color )
 {
 	// Should be done after monsters loading.
-	PC_ASSERT( !monsters_models_.models.empty() );
+	PC_ASSERT( !monsters_models_->models.empty() );
 
 	const unsigned char color_corrected= color % GameConstants::player_colors_count;
 
+	TextureView result;
+
 	// Default texture (unshifted).
 	if( color_corrected == 0u )
 	{
-		TextureView result;
-		const ModelsGroup::ModelEntry& model_entry= monsters_models_.models.front();
+		const ModelsGroup::ModelEntry& model_entry= monsters_models_->models.front();
 		result.size[0]= model_entry.texture_size[0];
 		result.size[1]= model_entry.texture_size[1];
-		result.data= monsters_models_.textures_data.data() + model_entry.texture_data_offset;
+		result.mip_count= model_entry.mip_count;
+		for( unsigned int i= 0u; i < model_entry.mip_count; i++ )
+			result.mips[i]= monsters_models_->textures_data.data() + model_entry.mips_data_offsets[i];
 		return result;
 	}
 
@@ -1031,9 +1644,16 @@ MapDrawerSoft::TextureView MapDrawerSoft::GetPlayerTexture( const unsigned char
 		const Model& model= game_resources_->monsters_models.front();
 		const unsigned int pixel_count= model.texture_data.size();
 
+		texture.size[0]= model.texture_size[0];
+		texture.size[1]= model.texture_size[1];
+		texture.mip_count= GetTextureMipCount( texture.size[0], texture.size[1], c_max_textures_mips );
+
 		// TODO - maybe cache buffers?
 		std::vector<unsigned char> data_shifted( pixel_count );
-		texture.data.resize( pixel_count );
+		texture.data.resize(
+			CalculateTextureMipsOffsets(
+				texture.size[0], texture.size[1], 1u,
+				texture.mip_count, texture.mips_data_offsets ) );
 
 		ColorShift(
 			14 * 16u, 14 * 16u + 16u,
@@ -1046,14 +1666,18 @@ MapDrawerSoft::TextureView MapDrawerSoft::GetPlayerTexture( const unsigned char
 		for( unsigned int i= 0u; i < pixel_count; i++ )
 			texture.data[i]= palette[ data_shifted[i] ];
 
-		texture.size[0]= model.texture_size[0];
-		texture.size[1]= model.texture_size[1];
+		BuildTextureMips(
+			texture.data.data(),
+			texture.size[0], texture.size[1], 1u,
+			texture.mip_count, texture.mips_data_offsets,
+			true );
 	}
 
-	TextureView result;
 	result.size[0]= texture.size[0];
 	result.size[1]= texture.size[1];
-	result.data= texture.data.data();
+	result.mip_count= texture.mip_count;
+	for( unsigned int i= 0u; i < texture.mip_count; i++ )
+		result.mips[i]= texture.data.data() + texture.mips_data_offsets[i];
 	return result;
 }
 
@@ -1082,71 +1706,259 @@ void MapDrawerSoft::LoadFloorsAndCeilings( const MapData& map_data )
 			cell.xy[0]= x;
 			cell.xy[1]= y;
 			cell.texture_id= texture_number;
+			std::memset( cell.dynamic_light, 0, sizeof(cell.dynamic_light) );
 
 			for( SurfacesCache::Surface*& surf_ptr : cell.mips_surfaces )
 				surf_ptr= nullptr;
+			for( unsigned int& build_frame : cell.mips_build_frame )
+				build_frame= 0u;
 		}
 	}
 }
 
-template< bool is_dynamic_wall >
-void MapDrawerSoft::DrawWallSegment(
-	DrawWall& wall,
-	const m_Vec2& vert_pos0, const m_Vec2& vert_pos1, const float z,
-	const float tc_0, const float tc_1,
-	const m_Mat4& matrix,
-	const m_Vec2& camera_position_xy,
-	const ViewClipPlanes& view_clip_planes )
+void MapDrawerSoft::BuildMapPVS( const MapDataConstPtr& map_data )
 {
-	PC_ASSERT( z >= 0.0f );
+	// Only fully opaque one-sided walls occlude view.
+	std::vector<bool> opaque_walls( map_data->static_walls.size() );
+	for( unsigned int w= 0u; w < opaque_walls.size(); w++ )
+	{
+		const unsigned char texture_id= map_data->static_walls[w].texture_id;
+		if( texture_id >= MapData::c_first_transparent_texture_id )
+		{
+			opaque_walls[w]= false;
+			continue;
+		}
 
-	PC_ASSERT( wall.texture_id < MapData::c_max_walls_textures );
-	const WallTexture& texture= wall_textures_[ wall.texture_id ];
-	if( texture.size[0] == 0u || texture.size[1] == 0u )
-		return;
-	if( texture.full_alpha_row[0] == texture.full_alpha_row[1] )
-		return;
+		const WallTexture& texture= wall_textures_[ texture_id ];
+		opaque_walls[w]=
+			texture.size[0] > 0u && !texture.has_alpha &&
+			texture.full_alpha_row[0] == 0u && texture.full_alpha_row[1] == g_wall_texture_height;
+	}
 
-	// Discard back faces.
-	// TODO - know, what discard criteria was in original game.
-	const bool is_back= mVec2Cross( camera_position_xy - vert_pos0, vert_pos1 - vert_pos0 ) > 0.0f;
-	if( !is_dynamic_wall &&
-		wall.texture_id < MapData::c_first_transparent_texture_id &&
-		is_back )
-		return;
+	map_pvs_.reset( new MapPVS( map_data, opaque_walls ) );
+}
 
-	const float z_bottom_top[]=
+void MapDrawerSoft::UpdateDynamicLights( const MapState& map_state )
+{
+	PC_PROFILE_SCOPE( "MapDrawerSoft::UpdateDynamicLights" );
+
+	dynamic_lights_freed_surfaces_= 0u;
+	prev_dynamic_lights_.swap( dynamic_lights_ );
+	dynamic_lights_.clear();
+
+	const auto add_light=
+	[&]( const m_Vec2& pos, const float outer_radius, const float inner_radius, const float level )
 	{
-		GameConstants::walls_height - float(texture.full_alpha_row[0]) * ( GameConstants::walls_height / float(g_wall_texture_height) ),
-		z + GameConstants::walls_height - float(texture.full_alpha_row[1]) * ( GameConstants::walls_height / float(g_wall_texture_height) )
+		const unsigned int level_rounded=
+			std::min(
+				g_dynamic_light_max_level,
+				static_cast<unsigned int>( std::max( 0.0f, level ) ) / g_dynamic_light_level_step * g_dynamic_light_level_step );
+		if( level_rounded == 0u || outer_radius <= 0.0f )
+			return;
+
+		DynamicLight light;
+		light.pos= pos;
+		light.outer_radius= outer_radius;
+		light.inner_radius= inner_radius;
+		light.level= level_rounded;
+		dynamic_lights_.push_back( light );
 	};
-	const float tc_top= float( texture.full_alpha_row[0] << 16u ) + z * ( 65536.0f * float(g_wall_texture_height) / float(GameConstants::walls_height) );
 
-	const float tc_scale= float( wall.surface_width << 16u );
+	if( settings_.Get( dynamic_lights_setting_ ) )
+	{
+		// Same params, as in OpenGL renderer.
+		for( const MapState::LightFlash& flash : map_state.GetLightFlashes() )
+		{
+			const float outer_radius= 1.7f * ( flash.intensity * 0.6f + 0.4f );
+			add_light( flash.pos, outer_radius, 0.5f * outer_radius, 96.0f * flash.intensity );
+		}
+		for( const MapState::LightSourcesContainer::value_type& light_source_value : map_state.GetLightSources() )
+		{
+			const MapState::LightSource& light_source= light_source_value.second;
+			add_light( light_source.pos, light_source.radius, 0.25f * light_source.radius, 8.0f * light_source.intensity );
+		}
+	}
 
-	clipped_vertices_[0].pos= m_Vec3( vert_pos0, z_bottom_top[0] );
-	clipped_vertices_[1].pos= m_Vec3( vert_pos0, z_bottom_top[1] );
-	clipped_vertices_[2].pos= m_Vec3( vert_pos1, z_bottom_top[1] );
-	clipped_vertices_[3].pos= m_Vec3( vert_pos1, z_bottom_top[0] );
-	clipped_vertices_[0].tc= m_Vec2( tc_1 * tc_scale, tc_top );
-	clipped_vertices_[1].tc= m_Vec2( tc_1 * tc_scale, float( texture.full_alpha_row[1] << 16u ) );
-	clipped_vertices_[2].tc= m_Vec2( tc_0 * tc_scale, float( texture.full_alpha_row[1] << 16u ) );
-	clipped_vertices_[3].tc= m_Vec2( tc_0 * tc_scale, tc_top );
-	clipped_vertices_[0].next= &clipped_vertices_[1];
-	clipped_vertices_[1].next= &clipped_vertices_[2];
+	// Lights, which exist only in one of frames, change light around them.
+	changed_dynamic_lights_.clear();
+	for( const DynamicLight& light : dynamic_lights_ )
+		if( std::find( prev_dynamic_lights_.begin(), prev_dynamic_lights_.end(), light ) == prev_dynamic_lights_.end() )
+			changed_dynamic_lights_.push_back( light );
+	for( const DynamicLight& light : prev_dynamic_lights_ )
+		if( std::find( dynamic_lights_.begin(), dynamic_lights_.end(), light ) == dynamic_lights_.end() )
+			changed_dynamic_lights_.push_back( light );
+
+	// Recalculate light and free surfaces only if light really changed.
+	const auto update_wall=
+	[&]( DrawWall& wall, const m_Vec2& v0, const m_Vec2& v1 )
+	{
+		unsigned char dynamic_light[8];
+		for( unsigned int i= 0u; i < 8u; i++ )
+			dynamic_light[i]= GetDynamicLight( v0 + ( v1 - v0 ) * ( ( float(i) + 0.5f ) / 8.0f ) );
+
+		if( std::memcmp( dynamic_light, wall.dynamic_light, sizeof(dynamic_light) ) == 0 )
+			return;
+
+		std::memcpy( wall.dynamic_light, dynamic_light, sizeof(dynamic_light) );
+		for( SurfacesCache::Surface*& surface : wall.mips_surfaces )
+		{
+			if( surface != nullptr )
+				dynamic_lights_freed_surfaces_++;
+			surfaces_cache_.FreeSurface( &surface );
+		}
+	};
+
+	const auto segment_is_near_changed_light=
+	[&]( const m_Vec2& v0, const m_Vec2& v1 ) -> bool
+	{
+		const m_Vec2 segment_vec= v1 - v0;
+		const float segment_square_length= segment_vec.SquareLength();
+		for( const DynamicLight& light : changed_dynamic_lights_ )
+		{
+			float k= 0.0f;
+			if( segment_square_length > 0.0f )
+				k= std::max( 0.0f, std::min( ( light.pos - v0 ) * segment_vec / segment_square_length, 1.0f ) );
+			if( ( v0 + segment_vec * k - light.pos ).SquareLength() < light.outer_radius * light.outer_radius )
+				return true;
+		}
+		return false;
+	};
+
+	if( !changed_dynamic_lights_.empty() )
+	{
+		for( unsigned int w= 0u; w < static_walls_.size(); w++ )
+		{
+			const MapData::Wall& map_wall= current_map_data_->static_walls[w];
+			if( segment_is_near_changed_light( map_wall.vert_pos[0], map_wall.vert_pos[1] ) )
+				update_wall( static_walls_[w], map_wall.vert_pos[0], map_wall.vert_pos[1] );
+		}
+
+		for( FloorCeilingCell& cell : map_floors_and_ceilings_ )
+		{
+			bool near_changed_light= false;
+			for( const DynamicLight& light : changed_dynamic_lights_ )
+			{
+				const m_Vec2 nearest_point(
+					std::max( float(cell.xy[0]), std::min( light.pos.x, float(cell.xy[0] + 1u) ) ),
+					std::max( float(cell.xy[1]), std::min( light.pos.y, float(cell.xy[1] + 1u) ) ) );
+				if( ( nearest_point - light.pos ).SquareLength() < light.outer_radius * light.outer_radius )
+				{
+					near_changed_light= true;
+					break;
+				}
+			}
+			if( !near_changed_light )
+				continue;
+
+			unsigned char dynamic_light[ MapData::c_lightmap_scale * MapData::c_lightmap_scale ];
+			for( unsigned int y= 0u; y < MapData::c_lightmap_scale; y++ )
+			for( unsigned int x= 0u; x < MapData::c_lightmap_scale; x++ )
+				dynamic_light[ x + y * MapData::c_lightmap_scale ]=
+					GetDynamicLight(
+						m_Vec2(
+							float(cell.xy[0]) + ( float(x) + 0.5f ) / float(MapData::c_lightmap_scale),
+							float(cell.xy[1]) + ( float(y) + 0.5f ) / float(MapData::c_lightmap_scale) ) );
+
+			if( std::memcmp( dynamic_light, cell.dynamic_light, sizeof(dynamic_light) ) == 0 )
+				continue;
+
+			std::memcpy( cell.dynamic_light, dynamic_light, sizeof(dynamic_light) );
+			for( SurfacesCache::Surface*& surface : cell.mips_surfaces )
+			{
+				if( surface != nullptr )
+					dynamic_lights_freed_surfaces_++;
+				surfaces_cache_.FreeSurface( &surface );
+			}
+		}
+	}
+
+	// Dynamic walls move, so, check them each frame, while there are any lights.
+	// There are few dynamic walls, so, this is cheap.
+	if( !dynamic_lights_.empty() || !changed_dynamic_lights_.empty() )
+	{
+		const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
+		for( unsigned int w= 0u; w < dynamic_walls_.size() && w < dynamic_walls.size(); w++ )
+			update_wall( dynamic_walls_[w], dynamic_walls[w].vert_pos[0], dynamic_walls[w].vert_pos[1] );
+	}
+}
+
+unsigned char MapDrawerSoft::GetDynamicLight( const m_Vec2& pos ) const
+{
+	unsigned int result= 0u;
+	for( const DynamicLight& light : dynamic_lights_ )
+	{
+		const float distance= ( pos - light.pos ).Length();
+		if( distance >= light.outer_radius )
+			continue;
+
+		float k= 1.0f;
+		if( distance > light.inner_radius )
+			k= ( light.outer_radius - distance ) / ( light.outer_radius - light.inner_radius );
+		result+= static_cast<unsigned int>( k * float(light.level) );
+	}
+
+	return static_cast<unsigned char>( std::min( result, 255u ) );
+}
+
+bool MapDrawerSoft::IsAreaPotentiallyVisible( const m_Vec2& area_min, const m_Vec2& area_max ) const
+{
+	if( view_cell_visibility_ == nullptr )
+		return true;
+	return MapPVS::IsAreaVisible( *view_cell_visibility_, area_min, area_max );
+}
+
+template< bool is_dynamic_wall >
+void MapDrawerSoft::DrawWallSegment(
+	DrawWall& wall,
+	const m_Vec2& vert_pos0, const m_Vec2& vert_pos1, const float z,
+	const float tc_0, const float tc_1,
+	const m_Mat4& matrix,
+	const m_Vec2& camera_position_xy,
+	const ViewClipPlanes& view_clip_planes )
+{
+	PC_ASSERT( z >= 0.0f );
+
+	PC_ASSERT( wall.texture_id < MapData::c_max_walls_textures );
+	const WallTexture& texture= wall_textures_[ wall.texture_id ];
+	if( texture.size[0] == 0u || texture.size[1] == 0u )
+		return;
+	if( texture.full_alpha_row[0] == texture.full_alpha_row[1] )
+		return;
+
+	// Discard back faces.
+	// TODO - know, what discard criteria was in original game.
+	const bool is_back= mVec2Cross( camera_position_xy - vert_pos0, vert_pos1 - vert_pos0 ) > 0.0f;
+	if( !is_dynamic_wall &&
+		wall.texture_id < MapData::c_first_transparent_texture_id &&
+		is_back )
+		return;
+
+	const float z_bottom_top[]=
+	{
+		GameConstants::walls_height - float(texture.full_alpha_row[0]) * ( GameConstants::walls_height / float(g_wall_texture_height) ),
+		z + GameConstants::walls_height - float(texture.full_alpha_row[1]) * ( GameConstants::walls_height / float(g_wall_texture_height) )
+	};
+	const float tc_top= float( texture.full_alpha_row[0] << 16u ) + z * ( 65536.0f * float(g_wall_texture_height) / float(GameConstants::walls_height) );
+
+	const float tc_scale= float( wall.surface_width << 16u );
+
+	clipped_vertices_[0].pos= m_Vec3( vert_pos0, z_bottom_top[0] );
+	clipped_vertices_[1].pos= m_Vec3( vert_pos0, z_bottom_top[1] );
+	clipped_vertices_[2].pos= m_Vec3( vert_pos1, z_bottom_top[1] );
+	clipped_vertices_[3].pos= m_Vec3( vert_pos1, z_bottom_top[0] );
+	clipped_vertices_[0].tc= m_Vec2( tc_1 * tc_scale, tc_top );
+	clipped_vertices_[1].tc= m_Vec2( tc_1 * tc_scale, float( texture.full_alpha_row[1] << 16u ) );
+	clipped_vertices_[2].tc= m_Vec2( tc_0 * tc_scale, float( texture.full_alpha_row[1] << 16u ) );
+	clipped_vertices_[3].tc= m_Vec2( tc_0 * tc_scale, tc_top );
+	clipped_vertices_[0].next= &clipped_vertices_[1];
+	clipped_vertices_[1].next= &clipped_vertices_[2];
 	clipped_vertices_[2].next= &clipped_vertices_[3];
 	clipped_vertices_[3].next= &clipped_vertices_[0];
 	fisrt_clipped_vertex_= &clipped_vertices_[0];
 	next_new_clipped_vertex_= 4u;
 
 	unsigned int polygon_vertex_count= 4u;
-	for( const m_Plane3& plane : view_clip_planes )
-	{
-		polygon_vertex_count= ClipPolygon( plane, polygon_vertex_count );
-		PC_ASSERT( polygon_vertex_count == 0u || polygon_vertex_count >= 3u );
-		if( polygon_vertex_count == 0u )
-			break;
-	}
+	polygon_vertex_count= ClipPolygonByView( view_clip_planes, polygon_vertex_count );
 	if( polygon_vertex_count == 0u )
 		return;
 
@@ -1185,7 +1997,7 @@ void MapDrawerSoft::DrawWallSegment(
 		out_v.z= fixed16_t( w * 65536.0f );
 	}
 
-	if( !is_dynamic_wall && rasterizer_.IsOccluded( verties_projected, polygon_vertex_count ) )
+	if( !is_dynamic_wall && IsOccluded( verties_projected, polygon_vertex_count ) )
 		return;
 
 	int mip= 0;
@@ -1233,36 +2045,15 @@ void MapDrawerSoft::DrawWallSegment(
 	else
 		surface= GetWallSurface<3>( wall );
 
-	rasterizer_.SetTexture( surface->size[0], surface->size[1], surface->GetData() );
+	SetTexture( surface->size[0], surface->size[1], surface->GetData() );
 
-	if( is_dynamic_wall )
-	{
-		if( texture.has_alpha )
-			rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::Yes>( verties_projected, polygon_vertex_count, !is_back );
-		else
-			rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::Yes>( verties_projected, polygon_vertex_count, !is_back );
-	}
-	else
-	{
-		if( texture.has_alpha )
-			rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-				Rasterizer::DepthTest::No, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::Yes>( verties_projected, polygon_vertex_count, !is_back );
-		else
-			rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-				Rasterizer::DepthTest::No, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::Yes>( verties_projected, polygon_vertex_count, !is_back );
-	}
+	const Rasterizer::ConvexPolygonDrawFunc draw_func=
+		is_dynamic_wall
+			? kernels_.dynamic_walls[ texture.has_alpha ? 1u : 0u ]
+			: kernels_.static_walls [ texture.has_alpha ? 1u : 0u ];
+	DrawConvexPolygon( draw_func, verties_projected, polygon_vertex_count, !is_back );
 
-	rasterizer_.UpdateOcclusionHierarchy( verties_projected, polygon_vertex_count, texture.has_alpha );
+	UpdateOcclusionHierarchy( verties_projected, polygon_vertex_count, texture.has_alpha );
 }
 
 void MapDrawerSoft::DrawWalls(
@@ -1281,6 +2072,10 @@ void MapDrawerSoft::DrawWalls(
 				segment.vert_pos[0], segment.vert_pos[1], 0.0f,
 				segment.start, segment.end,
 				matrix, camera_position_xy, view_clip_planes );
+		},
+		[&]( const m_Vec2& bb_min, const m_Vec2& bb_max ) -> bool
+		{
+			return IsAreaPotentiallyVisible( bb_min, bb_max );
 		} );
 
 
@@ -1303,8 +2098,20 @@ void MapDrawerSoft::DrawWalls(
 					surf_ptr= nullptr;
 				}
 			}
+			// Rebuilding after texture change is not a cache miss.
+			for( unsigned int& build_frame : draw_wall.mips_build_frame )
+				build_frame= 0u;
 		}
 
+		const m_Vec2 wall_bb_min(
+			std::min( wall.vert_pos[0].x, wall.vert_pos[1].x ),
+			std::min( wall.vert_pos[0].y, wall.vert_pos[1].y ) );
+		const m_Vec2 wall_bb_max(
+			std::max( wall.vert_pos[0].x, wall.vert_pos[1].x ),
+			std::max( wall.vert_pos[0].y, wall.vert_pos[1].y ) );
+		if( !IsAreaPotentiallyVisible( wall_bb_min, wall_bb_max ) )
+			continue;
+
 		DrawWallSegment<true>(
 			draw_wall,
 			wall.vert_pos[0], wall.vert_pos[1], wall.z,
@@ -1323,6 +2130,10 @@ void MapDrawerSoft::DrawFloorsAndCeilings( const m_Mat4& matrix, const ViewClipP
 
 		PC_ASSERT( cell.texture_id < MapData::c_floors_textures_count );
 
+		if( view_cell_visibility_ != nullptr &&
+			!MapPVS::IsCellVisible( *view_cell_visibility_, cell.xy[0], cell.xy[1] ) )
+			continue;
+
 		clipped_vertices_[0].pos= m_Vec3( float(cell.xy[0]   ), float(cell.xy[1]   ), z );
 		clipped_vertices_[1].pos= m_Vec3( float(cell.xy[0]+1u), float(cell.xy[1]   ), z );
 		clipped_vertices_[2].pos= m_Vec3( float(cell.xy[0]+1u), float(cell.xy[1]+1u), z );
@@ -1339,13 +2150,7 @@ void MapDrawerSoft::DrawFloorsAndCeilings( const m_Mat4& matrix, const ViewClipP
 		next_new_clipped_vertex_= 4u;
 
 		unsigned int polygon_vertex_count= 4u;
-		for( const m_Plane3& plane : view_clip_planes )
-		{
-			polygon_vertex_count= ClipPolygon( plane, polygon_vertex_count );
-			PC_ASSERT( polygon_vertex_count == 0u || polygon_vertex_count >= 3u );
-			if( polygon_vertex_count == 0u )
-				break;
-		}
+		polygon_vertex_count= ClipPolygonByView( view_clip_planes, polygon_vertex_count );
 		if( polygon_vertex_count == 0u )
 			continue;
 
@@ -1370,7 +2175,7 @@ void MapDrawerSoft::DrawFloorsAndCeilings( const m_Mat4& matrix, const ViewClipP
 			out_v.z= fixed16_t( w * 65536.0f );
 		}
 
-		if( rasterizer_.IsOccluded( verties_projected, polygon_vertex_count ) )
+		if( IsOccluded( verties_projected, polygon_vertex_count ) )
 			continue;
 
 		// Search longest edge for mip calculation.
@@ -1427,19 +2232,243 @@ void MapDrawerSoft::DrawFloorsAndCeilings( const m_Mat4& matrix, const ViewClipP
 			}
 		}
 
-		rasterizer_.SetTexture(
+		SetTexture(
 			surface->size[0], surface->size[1],
 			surface->GetData() );
 
-		rasterizer_.DrawTexturedConvexPolygonPerLineCorrected<
-			Rasterizer::DepthTest::No, Rasterizer::DepthWrite::Yes,
-			Rasterizer::AlphaTest::No,
-			Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::Yes>( verties_projected, polygon_vertex_count, is_ceiling );
+		DrawConvexPolygon(
+			&Rasterizer::DrawFloorConvexPolygon<Rasterizer::OcclusionTest::Yes>,
+			verties_projected, polygon_vertex_count, is_ceiling );
 
 		// TODO - does this needs?
 		// Maybe update whole screen hierarchy after floors and ceilings?
-		rasterizer_.UpdateOcclusionHierarchy( verties_projected, polygon_vertex_count, false );
+		UpdateOcclusionHierarchy( verties_projected, polygon_vertex_count, false );
+	}
+}
+
+void MapDrawerSoft::AddModelDrawRequest(
+	const ModelsGroup& models_group,
+	const std::vector<Model>& model_group_models,
+	const unsigned int model_id,
+	const unsigned int animation_frame,
+	const m_Vec3& position,
+	const m_Mat4& rotation_matrix,
+	const unsigned char visible_groups_mask,
+	const bool force_transparent_nontransparent_polygons,
+	const bool fullbright,
+	const unsigned int submodel_id,
+	const unsigned char color )
+{
+	models_draw_requests_.emplace_back();
+	ModelDrawRequest& request= models_draw_requests_.back();
+
+	request.models_group= &models_group;
+	request.model_group_models= &model_group_models;
+	request.model_id= model_id;
+	request.animation_frame= animation_frame;
+	request.position= position;
+	request.rotation_matrix= rotation_matrix;
+	request.visible_groups_mask= visible_groups_mask;
+	request.force_transparent_nontransparent_polygons= force_transparent_nontransparent_polygons;
+	request.fullbright= fullbright;
+	request.submodel_id= submodel_id;
+	request.color= color;
+	request.occluded= false;
+	request.depth= 0.0f;
+}
+
+void MapDrawerSoft::CheckModelsDepthOcclusion( const m_Mat4& view_matrix )
+{
+	models_depth_queries_.clear();
+	models_depth_queries_requests_.clear();
+
+	for( unsigned int r= 0u; r < models_draw_requests_.size(); r++ )
+	{
+		const ModelDrawRequest& request= models_draw_requests_[r];
+
+		const Model& base_model= (*request.model_group_models)[ request.model_id ];
+		const Submodel& model= ( request.submodel_id == ~0u ) ? base_model : base_model.submodels[ request.submodel_id ];
+		PC_ASSERT( request.animation_frame < model.frame_count );
+		const m_BBox3& bbox= model.animations_bboxes[ request.animation_frame ];
+
+		m_Mat4 translate_mat;
+		translate_mat.Translate( request.position );
+		const m_Mat4 final_mat= request.rotation_matrix * translate_mat * view_matrix;
+
+		// Calculate screen-space bounding box.
+		float x_min= Constants::max_float, x_max= Constants::min_float;
+		float y_min= Constants::max_float, y_max= Constants::min_float;
+		float w_min= Constants::max_float;
+		for( unsigned int z= 0u; z < 2u; z++ )
+		for( unsigned int y= 0u; y < 2u; y++ )
+		for( unsigned int x= 0u; x < 2u; x++ )
+		{
+			const m_Vec3 point(
+				x == 0 ? bbox.min.x : bbox.max.x,
+				y == 0 ? bbox.min.y : bbox.max.y,
+				z == 0 ? bbox.min.z : bbox.max.z );
+
+			const float w= point.x * final_mat.value[3] + point.y * final_mat.value[7] + point.z * final_mat.value[11] + final_mat.value[15];
+			if( w < w_min ) w_min= w;
+
+			if( w > 0.0f )
+			{
+				m_Vec2 vertex_projected= ( point * final_mat ).xy();
+				vertex_projected/= w;
+				const float screen_x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
+				const float screen_y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
+				if( screen_x < x_min ) x_min= screen_x;
+				if( screen_x > x_max ) x_max= screen_x;
+				if( screen_y < y_min ) y_min= screen_y;
+				if( screen_y > y_max ) y_max= screen_y;
+			}
+		}
+
+		// Model must be not so near for hierarchical depth-test - farther, then z_near.
+		if( !( w_min > 1.1f / float( 1u << Rasterizer::c_max_inv_z_min_log2 ) ) )
+			continue;
+
+		x_min= std::min( std::max( x_min, 0.0f ), screen_transform_x_ * 2.0f );
+		y_min= std::min( std::max( y_min, 0.0f ), screen_transform_y_ * 2.0f );
+		x_max= std::min( std::max( x_max, 0.0f ), screen_transform_x_ * 2.0f );
+		y_max= std::min( std::max( y_max, 0.0f ), screen_transform_y_ * 2.0f );
+
+		models_depth_queries_.emplace_back();
+		Rasterizer::DepthOcclusionQuery& query= models_depth_queries_.back();
+		query.x_min= fixed16_t(x_min * 65536.0f);
+		query.y_min= fixed16_t(y_min * 65536.0f);
+		query.x_max= fixed16_t(x_max * 65536.0f);
+		query.y_max= fixed16_t(y_max * 65536.0f);
+		query.z_min= fixed16_t(w_min * 65536.0f);
+		models_depth_queries_requests_.push_back(r);
+	}
+
+	models_occluded_mask_.resize( ( models_depth_queries_.size() + 31u ) / 32u );
+	current_rasterizer_->CheckDepthOcclusion(
+		models_depth_queries_.data(), models_depth_queries_.size(),
+		models_occluded_mask_.data(),
+		instruction_set_ );
+
+	models_occluded_count_= 0u;
+	for( unsigned int q= 0u; q < models_depth_queries_.size(); q++ )
+	{
+		if( ( models_occluded_mask_[ q >> 5u ] & ( 1u << ( q & 31u ) ) ) != 0u )
+		{
+			models_draw_requests_[ models_depth_queries_requests_[q] ].occluded= true;
+			models_occluded_count_++;
+		}
+	}
+}
+
+bool MapDrawerSoft::ModelVerticesCacheKey::operator==( const ModelVerticesCacheKey& other ) const
+{
+	return
+		model == other.model &&
+		animation_frame == other.animation_frame &&
+		std::memcmp( matrix.value, other.matrix.value, sizeof(matrix.value) ) == 0;
+}
+
+size_t MapDrawerSoft::ModelVerticesCacheKeyHasher::operator()( const ModelVerticesCacheKey& key ) const
+{
+	// FNV-1a for model pointer, frame and matrix bits.
+	size_t hash= static_cast<size_t>( 2166136261u );
+	const auto combine=
+	[&]( const void* const data, const size_t size )
+	{
+		const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+		for( size_t i= 0u; i < size; i++ )
+			hash= ( hash ^ bytes[i] ) * static_cast<size_t>( 16777619u );
+	};
+	combine( &key.model, sizeof(key.model) );
+	combine( &key.animation_frame, sizeof(key.animation_frame) );
+	combine( key.matrix.value, sizeof(key.matrix.value) );
+	return hash;
+}
+
+const MapDrawerSoft::ProjectedModelVertex* MapDrawerSoft::GetProjectedModelVertices(
+	const Submodel& model,
+	const unsigned int animation_frame,
+	const m_Mat4& matrix )
+{
+	PC_ASSERT( animation_frame < model.frame_count );
+	const unsigned int vertex_count= model.animations_vertices.size() / model.frame_count;
+
+	ModelVerticesCacheKey key;
+	key.model= &model;
+	key.animation_frame= animation_frame;
+	key.matrix= matrix;
+
+	const auto it= model_vertices_cache_.find( key );
+	if( it != model_vertices_cache_.end() )
+		return projected_model_vertices_.data() + it->second;
+
+	const unsigned int offset= projected_model_vertices_.size();
+	model_vertices_cache_.emplace( key, offset );
+	projected_model_vertices_.resize( offset + vertex_count );
+
+	const Submodel::AnimationVertex* const in_vertices= model.animations_vertices.data() + vertex_count * animation_frame;
+	ProjectedModelVertex* const out_vertices= projected_model_vertices_.data() + offset;
+
+	unsigned int v= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	if( instruction_set_ == Rasterizer::InstructionSet::SSE2 )
+	{
+		// Transform all four components of vertex at once.
+		const __m128 row_x= _mm_loadu_ps( matrix.value +  0u );
+		const __m128 row_y= _mm_loadu_ps( matrix.value +  4u );
+		const __m128 row_z= _mm_loadu_ps( matrix.value +  8u );
+		const __m128 row_w= _mm_loadu_ps( matrix.value + 12u );
+		const __m128 pos_scale= _mm_set1_ps( 1.0f / 2048.0f );
+		const __m128 screen_scale= _mm_setr_ps( screen_transform_x_ * 65536.0f, screen_transform_y_ * 65536.0f, 0.0f, 65536.0f );
+		const __m128 one_xy= _mm_setr_ps( 1.0f, 1.0f, 0.0f, 0.0f );
+		const __m128 w_select= _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+
+		for( ; v < vertex_count; v++ )
+		{
+			const Submodel::AnimationVertex& in_vertex= in_vertices[v];
+			const __m128 pos=
+				_mm_mul_ps(
+					_mm_cvtepi32_ps( _mm_setr_epi32( in_vertex.pos[0], in_vertex.pos[1], in_vertex.pos[2], 0 ) ),
+					pos_scale );
+
+			__m128 transformed= row_w;
+			transformed= _mm_add_ps( transformed, _mm_mul_ps( row_x, _mm_shuffle_ps( pos, pos, _MM_SHUFFLE( 0, 0, 0, 0 ) ) ) );
+			transformed= _mm_add_ps( transformed, _mm_mul_ps( row_y, _mm_shuffle_ps( pos, pos, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) );
+			transformed= _mm_add_ps( transformed, _mm_mul_ps( row_z, _mm_shuffle_ps( pos, pos, _MM_SHUFFLE( 2, 2, 2, 2 ) ) ) );
+
+			// ( x / w + 1, y / w + 1, 0, w ) * screen scale.
+			const __m128 w= _mm_shuffle_ps( transformed, transformed, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+			__m128 projected= _mm_add_ps( _mm_div_ps( transformed, w ), one_xy );
+			projected= _mm_or_ps( _mm_andnot_ps( w_select, projected ), _mm_and_ps( w_select, w ) );
+
+			alignas(16) int32_t result[4];
+			_mm_store_si128( reinterpret_cast<__m128i*>( result ), _mm_cvttps_epi32( _mm_mul_ps( projected, screen_scale ) ) );
+
+			ProjectedModelVertex& out_vertex= out_vertices[v];
+			out_vertex.x= result[0];
+			out_vertex.y= result[1];
+			out_vertex.z= result[3];
+		}
+	}
+#endif
+
+	for( ; v < vertex_count; v++ )
+	{
+		const Submodel::AnimationVertex& in_vertex= in_vertices[v];
+		const m_Vec3 pos= m_Vec3( float(in_vertex.pos[0]), float(in_vertex.pos[1]), float(in_vertex.pos[2]) ) / 2048.0f;
+
+		m_Vec3 vertex_projected= pos * matrix;
+		const float w= pos.x * matrix.value[3] + pos.y * matrix.value[7] + pos.z * matrix.value[11] + matrix.value[15];
+		vertex_projected/= w;
+
+		ProjectedModelVertex& out_vertex= out_vertices[v];
+		out_vertex.x= fixed16_t( ( vertex_projected.x + 1.0f ) * screen_transform_x_ * 65536.0f );
+		out_vertex.y= fixed16_t( ( vertex_projected.y + 1.0f ) * screen_transform_y_ * 65536.0f );
+		out_vertex.z= fixed16_t( w * 65536.0f );
 	}
+
+	return out_vertices;
 }
 
 void MapDrawerSoft::DrawModel(
@@ -1470,13 +2499,61 @@ void MapDrawerSoft::DrawModel(
 	PC_ASSERT( animation_frame < model.frame_count );
 	const m_BBox3& bbox= model.animations_bboxes[ animation_frame ];
 
+	// PVS test for circle around model bounding box.
+	if( view_cell_visibility_ != nullptr )
+	{
+		const float max_x= std::max( std::abs( bbox.min.x ), std::abs( bbox.max.x ) );
+		const float max_y= std::max( std::abs( bbox.min.y ), std::abs( bbox.max.y ) );
+		const float radius= std::sqrt( max_x * max_x + max_y * max_y );
+		if( !IsAreaPotentiallyVisible(
+				position.xy() - m_Vec2( radius, radius ),
+				position.xy() + m_Vec2( radius, radius ) ) )
+			return;
+	}
+
 	m_Mat4 translate_mat, bbox_mat;
 	translate_mat.Translate( position );
 	bbox_mat= rotation_matrix * translate_mat;
 
+	// Fast bounding sphere test. Bounding box tests are needed only for spheres, crossing planes.
+	// Sphere center is transformed with bounding box matrix, because it contains only rotation and translation.
+	const BoundingSphere& sphere= model.animations_bounding_spheres[ animation_frame ];
+	const m_Vec3 sphere_center= sphere.center * bbox_mat;
+	const int view_sphere_test_result= SphereViewTest( view_clip_planes, sphere_center, sphere.radius );
+	if( view_sphere_test_result < 0 )
+		return; // Discard model - it is fully outside view
+
 	// Clip-planes bounding box test
-	for( const m_Plane3& clip_plane : view_clip_planes )
+	if( view_sphere_test_result == 0 )
+	{
+		for( const m_Plane3& clip_plane : view_clip_planes )
+		{
+			unsigned int vertices_inside= 0u;
+			for( unsigned int z= 0u; z < 2u; z++ )
+			for( unsigned int y= 0u; y < 2u; y++ )
+			for( unsigned int x= 0u; x < 2u; x++ )
+			{
+				const m_Vec3 point(
+					x == 0 ? bbox.min.x : bbox.max.x,
+					y == 0 ? bbox.min.y : bbox.max.y,
+					z == 0 ? bbox.min.z : bbox.max.z );
+
+				if( clip_plane.IsPointAheadPlane( point * bbox_mat ) )
+					vertices_inside++;
+			}
+
+			if( vertices_inside == 0u )
+				return; // Discard model - it is fully outside view
+		} // For clip planes
+	}
+
+	// Rasterizer accepts vertices inside guard band, so, clip model only by near plane and guard band planes.
+	for( const m_Plane3& clip_plane : guard_band_clip_planes_ )
 	{
+		const float sphere_distance= clip_plane.normal * sphere_center + clip_plane.dist;
+		if( sphere_distance > sphere.radius )
+			continue; // Fully inside.
+
 		unsigned int vertices_inside= 0u;
 		for( unsigned int z= 0u; z < 2u; z++ )
 		for( unsigned int y= 0u; y < 2u; y++ )
@@ -1491,12 +2568,9 @@ void MapDrawerSoft::DrawModel(
 				vertices_inside++;
 		}
 
-		if( vertices_inside == 0u )
-			return; // Discard model - it is fully outside view
-
 		if( vertices_inside != 8u )
-			active_clip_planes_mask|= 1u << ( &clip_plane - &view_clip_planes[0] );
-	} // For clip planes
+			active_clip_planes_mask|= 1u << ( &clip_plane - &guard_band_clip_planes_[0] );
+	}
 
 	// Transform clip planes into model space.
 	ViewClipPlanes clip_planes_transformed;
@@ -1505,12 +2579,12 @@ void MapDrawerSoft::DrawModel(
 	m_Mat4 inv_rotation_mat= rotation_matrix;
 	inv_rotation_mat.Transpose(); // For rotation matrix transpose is euqivalent for inverse.
 
-	for( unsigned int i= 0u; i < view_clip_planes.size(); i++ )
+	for( unsigned int i= 0u; i < guard_band_clip_planes_.size(); i++ )
 	{
 		if( ( active_clip_planes_mask & ( 1 << i ) ) == 0u )
 			continue;
 
-		const m_Plane3& in_plane= view_clip_planes[i];
+		const m_Plane3& in_plane= guard_band_clip_planes_[i];
 		m_Plane3& out_plane= clip_planes_transformed[ clip_planes_transformed_count ];
 		clip_planes_transformed_count++;
 
@@ -1524,10 +2598,9 @@ void MapDrawerSoft::DrawModel(
 
 	// Select triangle rasterization func.
 	// Calculate bounding box w_min/w_max.
+	// Hierarchical depth-test is already done for all models at once, in CheckModelsDepthOcclusion.
 	// TODO - maybe use clipped bounding box? Maybe use maximum polygon size of model for w_ratio calculation?
 
-	float x_min= Constants::max_float, x_max= Constants::min_float;
-	float y_min= Constants::max_float, y_max= Constants::min_float;
 	float w_min= Constants::max_float, w_max= Constants::min_float;
 	for( unsigned int z= 0u; z < 2u; z++ )
 	for( unsigned int y= 0u; y < 2u; y++ )
@@ -1541,69 +2614,11 @@ void MapDrawerSoft::DrawModel(
 		const float w= point.x * final_mat.value[3] + point.y * final_mat.value[7] + point.z * final_mat.value[11] + final_mat.value[15];
 		if( w < w_min ) w_min= w;
 		if( w > w_max ) w_max= w;
-
-		if( w > 0.0f )
-		{
-			m_Vec2 vertex_projected= ( point * final_mat ).xy();
-			vertex_projected/= w;
-			const float screen_x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
-			const float screen_y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
-			if( screen_x < x_min ) x_min= screen_x;
-			if( screen_x > x_max ) x_max= screen_x;
-			if( screen_y < y_min ) y_min= screen_y;
-			if( screen_y > y_max ) y_max= screen_y;
-		}
-	}
-
-	// Try to reject model, using hierarchical depth-test.
-	// Model must be not so near for thist test - farther, then z_near.
-	if( w_min > 1.1f / float( 1u << Rasterizer::c_max_inv_z_min_log2 ) )
-	{
-		PC_ASSERT( w_max >= w_min );
-
-		x_min= std::min( std::max( x_min, 0.0f ), screen_transform_x_ * 2.0f );
-		y_min= std::min( std::max( y_min, 0.0f ), screen_transform_y_ * 2.0f );
-		x_max= std::min( std::max( x_max, 0.0f ), screen_transform_x_ * 2.0f );
-		y_max= std::min( std::max( y_max, 0.0f ), screen_transform_y_ * 2.0f );
-		if( rasterizer_.IsDepthOccluded(
-			fixed16_t(x_min * 65536.0f), fixed16_t(y_min * 65536.0f),
-			fixed16_t(x_max * 65536.0f), fixed16_t(y_max * 65536.0f),
-			fixed16_t(w_min * 65536.0f), fixed16_t(w_max * 65536.0f) ) )
-			return;
 	}
 
-	Rasterizer::TriangleDrawFunc draw_func, alpha_draw_func;
-
-	if( transparent || force_transparent_nontransparent_polygons )
-	{
-		draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::No,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>;
-		alpha_draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>;
-	}
-	else
-	{
-		draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::No,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::No>;
-		alpha_draw_func=
-			&Rasterizer::DrawTexturedTriangleSpanCorrected<
-				Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-				Rasterizer::AlphaTest::Yes,
-				Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-				Rasterizer::Lighting::Yes, Rasterizer::Blending::No>;
-	}
+	const unsigned int kernels_transparency= ( transparent || force_transparent_nontransparent_polygons ) ? 1u : 0u;
+	Rasterizer::TriangleDrawFunc draw_func= kernels_.models[ kernels_transparency ][0];
+	Rasterizer::TriangleDrawFunc alpha_draw_func= kernels_.models[ kernels_transparency ][1];
 
 	if( w_min > 0.0f /* && w_max > 0.0f */ )
 	{
@@ -1645,25 +2660,98 @@ void MapDrawerSoft::DrawModel(
 
 	const unsigned int first_animation_vertex= model.animations_vertices.size() / model.frame_count * animation_frame;
 
-	if( &models_group == &monsters_models_ && model_id == 0u )
+	TextureView texture_view;
+	if( &models_group == monsters_models_.get() && model_id == 0u )
 	{
 		// Detect player - set colored texture.
-		const TextureView texture_view= GetPlayerTexture( color );
-		rasterizer_.SetTexture( texture_view.size[0], texture_view.size[1], texture_view.data );
+		texture_view= GetPlayerTexture( color );
 	}
 	else
 	{
 		const ModelsGroup::ModelEntry& model_entry= models_group.models[ model_id ];
-		rasterizer_.SetTexture(
-			model_entry.texture_size[0], model_entry.texture_size[1],
-			models_group.textures_data.data() + model_entry.texture_data_offset );
+		texture_view.size[0]= model_entry.texture_size[0];
+		texture_view.size[1]= model_entry.texture_size[1];
+		texture_view.mip_count= model_entry.mip_count;
+		for( unsigned int i= 0u; i < model_entry.mip_count; i++ )
+			texture_view.mips[i]= models_group.textures_data.data() + model_entry.mips_data_offsets[i];
 	}
 
-	// TODO - make other branch, if clip_planes_transformed_count == 0
-	// Transform animation vertices, then rasterize trianglez directly, without clipping.
+	// Mip is selected for each triangle. Change texture only if mip changes.
+	unsigned int current_mip= ~0u;
+	const auto set_triangle_mip=
+	[&]( RasterizerVertex* const vertices, const unsigned int vertex_count )
+	{
+		const unsigned int mip= SelectPolygonTextureMip( vertices, vertex_count, texture_view.mip_count );
+		if( mip != current_mip )
+		{
+			current_mip= mip;
+			SetTexture( texture_view.size[0] >> mip, texture_view.size[1] >> mip, texture_view.mips[mip] );
+		}
+	};
+
+	const auto get_triangle_light=
+	[&]( const m_Vec3& triangle_center ) -> fixed16_t
+	{
+		if( fullbright )
+			return g_fixed16_one;
+
+		const m_Vec2 triangle_center_world_space= ( triangle_center * to_world_mat ).xy();
+		const unsigned int lightmap_x= static_cast<unsigned int>( triangle_center_world_space.x * float(MapData::c_lightmap_scale) );
+		const unsigned int lightmap_y= static_cast<unsigned int>( triangle_center_world_space.y * float(MapData::c_lightmap_scale) );
+
+		if( lightmap_x < MapData::c_lightmap_size && lightmap_y < MapData::c_lightmap_size )
+			return ScaleLightmapLight( current_map_data_->lightmap[ lightmap_x + lightmap_y * MapData::c_lightmap_size ] );
+		return g_fixed16_one;
+	};
 
 	// TODO - use original QUADS from .3o/.car models.
 
+	if( clip_planes_transformed_count == 0u )
+	{
+		// Model is inside near plane and guard band. Use projected vertices of whole animation frame and rasterize triangles without clipping.
+		const ProjectedModelVertex* const projected_vertices= GetProjectedModelVertices( model, animation_frame, final_mat );
+
+		for( unsigned int t= 0u; t < indeces.size(); t+= 3u )
+		{
+			const Model::Vertex& first_vertex= model.vertices[ indeces[t] ];
+
+			if( ( first_vertex.groups_mask & visible_groups_mask ) == 0u )
+				continue;
+
+			m_Vec3 positions[3];
+			RasterizerVertex traingle_vertices[3];
+			for( unsigned int tv= 0u; tv < 3u; tv++ )
+			{
+				const Model::Vertex& vertex= model.vertices[ indeces[t + tv] ];
+				const Model::AnimationVertex& animation_vertex= model.animations_vertices[ first_animation_vertex + vertex.vertex_id ];
+				positions[tv]= m_Vec3( float(animation_vertex.pos[0]), float(animation_vertex.pos[1]), float(animation_vertex.pos[2]) ) / 2048.0f;
+
+				const ProjectedModelVertex& projected_vertex= projected_vertices[ vertex.vertex_id ];
+				RasterizerVertex& out_v= traingle_vertices[tv];
+				out_v.x= projected_vertex.x;
+				out_v.y= projected_vertex.y;
+				out_v.z= projected_vertex.z;
+				out_v.u= fixed16_t( vertex.tex_coord[0] * float(base_model.texture_size[0]) * 65536.0f );
+				out_v.v= fixed16_t( vertex.tex_coord[1] * float(base_model.texture_size[1]) * 65536.0f );
+			}
+			{ // Try reject back faces
+				const m_Vec3 v0= positions[1] - positions[0];
+				const m_Vec3 v1= positions[2] - positions[0];
+				const m_Vec3 vec_to_cam= cam_pos_model_space - positions[0];
+				if( mVec3Cross( v0, v1 ) * vec_to_cam < 0.0f )
+					continue;
+			}
+
+			set_triangle_mip( traingle_vertices, 3u );
+			SetLight( get_triangle_light( ( positions[0] + positions[1] + positions[2] ) * ( 1.0f / 3.0f ) ) );
+
+			const bool triangle_needs_alpha_test= first_vertex.alpha_test_mask != 0u;
+			DrawTriangle( triangle_needs_alpha_test ? alpha_draw_func : draw_func, traingle_vertices );
+		} // for model triangles
+
+		return;
+	}
+
 	for( unsigned int t= 0u; t < indeces.size(); t+= 3u )
 	{
 		const Model::Vertex& first_vertex= model.vertices[ indeces[t] ];
@@ -1728,18 +2816,8 @@ void MapDrawerSoft::DrawModel(
 			out_v.z= fixed16_t( w * 65536.0f );
 		}
 
-		fixed16_t light= g_fixed16_one;
-		if( !fullbright )
-		{
-			triangle_center*= 1.0f / 3.0f;
-			const m_Vec2 triangle_center_world_space= ( triangle_center * to_world_mat ).xy();
-			const unsigned int lightmap_x= static_cast<unsigned int>( triangle_center_world_space.x * float(MapData::c_lightmap_scale) );
-			const unsigned int lightmap_y= static_cast<unsigned int>( triangle_center_world_space.y * float(MapData::c_lightmap_scale) );
-
-			if( lightmap_x < MapData::c_lightmap_size && lightmap_y < MapData::c_lightmap_size )
-				light= ScaleLightmapLight( current_map_data_->lightmap[ lightmap_x + lightmap_y * MapData::c_lightmap_size ] );
-		}
-		rasterizer_.SetLight( light );
+		set_triangle_mip( verties_projected, polygon_vertex_count );
+		SetLight( get_triangle_light( triangle_center * ( 1.0f / 3.0f ) ) );
 
 		const bool triangle_needs_alpha_test= first_vertex.alpha_test_mask != 0u;
 		const Rasterizer::TriangleDrawFunc triangle_func= triangle_needs_alpha_test ? alpha_draw_func : draw_func;
@@ -1750,7 +2828,7 @@ void MapDrawerSoft::DrawModel(
 		{
 			traingle_vertices[1]= verties_projected[ i + 1u ];
 			traingle_vertices[2]= verties_projected[ i + 2u ];
-			(rasterizer_.*triangle_func)( traingle_vertices );
+			DrawTriangle( triangle_func, traingle_vertices );
 		}
 	} // for model triangles
 }
@@ -1765,13 +2843,11 @@ void MapDrawerSoft::DrawModelShadow(
 	const m_Vec3& camera_position,
 	const m_Vec3& light_pos,
 	const unsigned char visible_groups_mask,
-	const unsigned int submodel_id )
+	const unsigned int submodel_id,
+	ModelShadow* const shadow_cache )
 {
-	const float c_shadow_z_offset= 0.02f;
-
 	const Submodel& model= (submodel_id == ~0u) ? base_model : base_model.submodels[ submodel_id ];
-	const std::vector<unsigned short>& indeces=  model.regular_triangles_indeces;
-	if( indeces.size() == 0u )
+	if( model.regular_triangles_indeces.size() == 0u )
 		return;
 
 	m_Mat4 inv_rotation_mat= rotation_matrix;
@@ -1779,30 +2855,25 @@ void MapDrawerSoft::DrawModelShadow(
 
 	const m_Vec3 light_pos_model_space= ( light_pos - position ) * inv_rotation_mat;
 
-	PC_ASSERT( animation_frame < model.frame_count );
-	const m_BBox3& bbox= model.animations_bboxes[ animation_frame ];
-
-	const auto project_model_vertex=
-	[&]( const m_Vec3& v ) -> m_Vec3
+	// Shadow geometry in model space depends only on model, frame and light position relative to model.
+	ModelShadow& shadow= shadow_cache != nullptr ? *shadow_cache : temp_model_shadow_;
+	if( !(
+		shadow.model == &model &&
+		shadow.animation_frame == animation_frame &&
+		shadow.visible_groups_mask == visible_groups_mask &&
+		shadow.light_pos_model_space.x == light_pos_model_space.x &&
+		shadow.light_pos_model_space.y == light_pos_model_space.y &&
+		shadow.light_pos_model_space.z == light_pos_model_space.z ) )
 	{
-		const m_Vec3 vec_from_light= v - light_pos_model_space;
-		return m_Vec3( light_pos_model_space.xy() + vec_from_light.xy() / vec_from_light.z * (-light_pos_model_space.z), c_shadow_z_offset );
-	};
+		BuildModelShadow( model, animation_frame, light_pos_model_space, visible_groups_mask, shadow );
+		shadows_built_in_frame_++;
+	}
 
-	// Project bouning box to 2d bounding box.
-	m_BBox2 bbox_projected;
-	bbox_projected.min= bbox_projected.max= project_model_vertex( bbox.min ).xy();
-	for( unsigned int z= 0u; z < 2u; z++ )
-	for( unsigned int y= 0u; y < 2u; y++ )
-	for( unsigned int x= 0u; x < 2u; x++ )
-	{
-		const m_Vec3 point(
-			x == 0 ? bbox.min.x : bbox.max.x,
-			y == 0 ? bbox.min.y : bbox.max.y,
-			z == 0 ? bbox.min.z : bbox.max.z );
+	if( shadow.triangles_vertices.empty() )
+		return;
 
-		bbox_projected+= project_model_vertex( point ).xy();
-	}
+	const m_BBox2& bbox_projected= shadow.bbox_projected;
+	const float c_shadow_z_offset= g_models_shadows_z_offset;
 
 	unsigned int active_clip_planes_mask= 0u;
 
@@ -1828,21 +2899,38 @@ void MapDrawerSoft::DrawModelShadow(
 
 		if( vertices_inside == 0u )
 			return; // Discard model - it is fully outside view
-
-		if( vertices_inside != 8u )
-			active_clip_planes_mask|= 1u << ( &clip_plane - &view_clip_planes[0] );
 	} // For clip planes
 
+	// Rasterizer accepts vertices inside guard band, so, clip shadow only by near plane and guard band planes.
+	for( const m_Plane3& clip_plane : guard_band_clip_planes_ )
+	{
+		unsigned int vertices_inside= 0u;
+		for( unsigned int y= 0u; y < 2u; y++ )
+		for( unsigned int x= 0u; x < 2u; x++ )
+		{
+			const m_Vec3 point(
+				x == 0 ? bbox_projected.min.x : bbox_projected.max.x,
+				y == 0 ? bbox_projected.min.y : bbox_projected.max.y,
+				c_shadow_z_offset );
+
+			if( clip_plane.IsPointAheadPlane( point * bbox_mat ) )
+				vertices_inside++;
+		}
+
+		if( vertices_inside != 4u )
+			active_clip_planes_mask|= 1u << ( &clip_plane - &guard_band_clip_planes_[0] );
+	}
+
 	// Transform clip planes into model space.
 	ViewClipPlanes clip_planes_transformed;
 	unsigned int clip_planes_transformed_count= 0u;
 
-	for( unsigned int i= 0u; i < view_clip_planes.size(); i++ )
+	for( unsigned int i= 0u; i < guard_band_clip_planes_.size(); i++ )
 	{
 		if( ( active_clip_planes_mask & ( 1 << i ) ) == 0u )
 			continue;
 
-		const m_Plane3& in_plane= view_clip_planes[i];
+		const m_Plane3& in_plane= guard_band_clip_planes_[i];
 		m_Plane3& out_plane= clip_planes_transformed[ clip_planes_transformed_count ];
 		clip_planes_transformed_count++;
 
@@ -1893,7 +2981,7 @@ void MapDrawerSoft::DrawModelShadow(
 		y_min= std::min( std::max( y_min, 0.0f ), screen_transform_y_ * 2.0f );
 		x_max= std::min( std::max( x_max, 0.0f ), screen_transform_x_ * 2.0f );
 		y_max= std::min( std::max( y_max, 0.0f ), screen_transform_y_ * 2.0f );
-		if( rasterizer_.IsDepthOccluded(
+		if( current_rasterizer_->IsDepthOccluded(
 			fixed16_t(x_min * 65536.0f), fixed16_t(y_min * 65536.0f),
 			fixed16_t(x_max * 65536.0f), fixed16_t(y_max * 65536.0f),
 			fixed16_t(w_min * 65536.0f), fixed16_t(w_max * 65536.0f) ) )
@@ -1904,28 +2992,14 @@ void MapDrawerSoft::DrawModelShadow(
 	if( cam_pos_model_space.z < 0.0f )
 		return; // We can not see shadow from bottom.
 
-	const unsigned int first_animation_vertex= model.animations_vertices.size() / model.frame_count * animation_frame;
-
 	// Draw shadow triangles.
-	for( unsigned int t= 0u; t < indeces.size(); t+= 3u )
+	for( unsigned int t= 0u; t < shadow.triangles_vertices.size(); t+= 3u )
 	{
-		const Model::Vertex& first_vertex= model.vertices[ indeces[t] ];
-
-		if( ( first_vertex.groups_mask & visible_groups_mask ) == 0u )
-			continue;
-
-		m_Vec3 triangle_center( 0.0f, 0.0f, 0.0f );
 		for( unsigned int tv= 0u; tv < 3u; tv++ )
 		{
-			const Model::Vertex& vertex= model.vertices[ indeces[t + tv] ];
-			const Model::AnimationVertex& animation_vertex= model.animations_vertices[ first_animation_vertex + vertex.vertex_id ];
-			const m_Vec3 vert_pos= m_Vec3( float(animation_vertex.pos[0]), float(animation_vertex.pos[1]), float(animation_vertex.pos[2]) ) / 2048.0f;
-
-			clipped_vertices_[tv].pos= project_model_vertex( vert_pos );
+			clipped_vertices_[tv].pos= shadow.triangles_vertices[ t + tv ];
 			clipped_vertices_[tv].tc.x= 0.0f;
 			clipped_vertices_[tv].tc.y= 0.0f;
-
-			triangle_center+= clipped_vertices_[tv].pos;
 		}
 		{ // Try reject back faces
 			const m_Vec3 v0= clipped_vertices_[1].pos - clipped_vertices_[0].pos;
@@ -1978,11 +3052,70 @@ void MapDrawerSoft::DrawModelShadow(
 		{
 			traingle_vertices[1]= verties_projected[ i + 1u ];
 			traingle_vertices[2]= verties_projected[ i + 2u ];
-			rasterizer_.DrawShadowTriangle( traingle_vertices );
+			DrawTriangle( &Rasterizer::DrawShadowTriangle, traingle_vertices );
 		}
 	} // for model triangles
 }
 
+void MapDrawerSoft::BuildModelShadow(
+	const Submodel& model,
+	const unsigned int animation_frame,
+	const m_Vec3& light_pos_model_space,
+	const unsigned char visible_groups_mask,
+	ModelShadow& out_shadow )
+{
+	out_shadow.model= &model;
+	out_shadow.animation_frame= animation_frame;
+	out_shadow.visible_groups_mask= visible_groups_mask;
+	out_shadow.light_pos_model_space= light_pos_model_space;
+	out_shadow.triangles_vertices.clear();
+
+	PC_ASSERT( animation_frame < model.frame_count );
+	const m_BBox3& bbox= model.animations_bboxes[ animation_frame ];
+
+	const auto project_model_vertex=
+	[&]( const m_Vec3& v ) -> m_Vec3
+	{
+		const m_Vec3 vec_from_light= v - light_pos_model_space;
+		return m_Vec3( light_pos_model_space.xy() + vec_from_light.xy() / vec_from_light.z * (-light_pos_model_space.z), g_models_shadows_z_offset );
+	};
+
+	// Project bouning box to 2d bounding box.
+	m_BBox2& bbox_projected= out_shadow.bbox_projected;
+	bbox_projected.min= bbox_projected.max= project_model_vertex( bbox.min ).xy();
+	for( unsigned int z= 0u; z < 2u; z++ )
+	for( unsigned int y= 0u; y < 2u; y++ )
+	for( unsigned int x= 0u; x < 2u; x++ )
+	{
+		const m_Vec3 point(
+			x == 0 ? bbox.min.x : bbox.max.x,
+			y == 0 ? bbox.min.y : bbox.max.y,
+			z == 0 ? bbox.min.z : bbox.max.z );
+
+		bbox_projected+= project_model_vertex( point ).xy();
+	}
+
+	const std::vector<unsigned short>& indeces=  model.regular_triangles_indeces;
+	const unsigned int first_animation_vertex= model.animations_vertices.size() / model.frame_count * animation_frame;
+
+	for( unsigned int t= 0u; t < indeces.size(); t+= 3u )
+	{
+		const Model::Vertex& first_vertex= model.vertices[ indeces[t] ];
+
+		if( ( first_vertex.groups_mask & visible_groups_mask ) == 0u )
+			continue;
+
+		for( unsigned int tv= 0u; tv < 3u; tv++ )
+		{
+			const Model::Vertex& vertex= model.vertices[ indeces[t + tv] ];
+			const Model::AnimationVertex& animation_vertex= model.animations_vertices[ first_animation_vertex + vertex.vertex_id ];
+			const m_Vec3 vert_pos= m_Vec3( float(animation_vertex.pos[0]), float(animation_vertex.pos[1]), float(animation_vertex.pos[2]) ) / 2048.0f;
+
+			out_shadow.triangles_vertices.push_back( project_model_vertex( vert_pos ) );
+		}
+	}
+}
+
 void MapDrawerSoft::DrawSky(
 	const m_Mat4& matrix,
 	const m_Vec3& sky_pos,
@@ -2001,9 +3134,7 @@ void MapDrawerSoft::DrawSky(
 	const fixed16_t tex_size_x= fixed16_t( sky_texture_.size[0] << 16u );
 	const fixed16_t tex_size_y= fixed16_t( sky_texture_.size[1] << 16u );
 
-	rasterizer_.SetTexture(
-		sky_texture_.size[0], sky_texture_.size[1],
-		sky_texture_.data.data() );
+	unsigned int current_mip= ~0u;
 
 	// TODO - optimize this
 	// 180 quads is too many for sky.
@@ -2041,13 +3172,7 @@ void MapDrawerSoft::DrawSky(
 		next_new_clipped_vertex_= 4u;
 
 		unsigned int polygon_vertex_count= 4u;
-		for( const m_Plane3& plane : view_clip_planes )
-		{
-			polygon_vertex_count= ClipPolygon( plane, polygon_vertex_count );
-			PC_ASSERT( polygon_vertex_count == 0u || polygon_vertex_count >= 3u );
-			if( polygon_vertex_count == 0u )
-				break;
-		}
+		polygon_vertex_count= ClipPolygonByView( view_clip_planes, polygon_vertex_count );
 		if( polygon_vertex_count == 0u )
 			continue;
 
@@ -2072,151 +3197,284 @@ void MapDrawerSoft::DrawSky(
 			out_v.z= fixed16_t( w * 65536.0f );
 		}
 
-		if( rasterizer_.IsOccluded( verties_projected, polygon_vertex_count ) )
+		if( IsOccluded( verties_projected, polygon_vertex_count ) )
 			continue;
 
-		rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-			Rasterizer::DepthTest::No, Rasterizer::DepthWrite::No,
-			Rasterizer::AlphaTest::No,
-			Rasterizer::OcclusionTest::Yes, Rasterizer::OcclusionWrite::No>( verties_projected, polygon_vertex_count, true );
+		const unsigned int mip= SelectPolygonTextureMip( verties_projected, polygon_vertex_count, sky_texture_.mip_count );
+		if( mip != current_mip )
+		{
+			current_mip= mip;
+			SetTexture(
+				sky_texture_.size[0] >> mip, sky_texture_.size[1] >> mip,
+				sky_texture_.data.data() + sky_texture_.mips_data_offsets[mip] );
+		}
+
+		DrawConvexPolygon( kernels_.sky, verties_projected, polygon_vertex_count, true );
 	}
 }
 
-void MapDrawerSoft::DrawEffectsSprites(
-	const MapState& map_state,
-	const m_Mat4& view_matrix,
-	const m_Vec3& camera_position,
-	const ViewClipPlanes& view_clip_planes )
+void MapDrawerSoft::CullSprites( const m_Mat4& view_matrix, const ViewClipPlanes& view_clip_planes )
 {
-	SortEffectsSprites( map_state.GetSpriteEffects(), camera_position, sorted_sprites_ );
+	sprites_depth_queries_.clear();
+	sprites_depth_queries_sprites_.clear();
 
-	for( const MapState::SpriteEffect* const sprite_ptr : sorted_sprites_ )
+	for( unsigned int i= 0u; i < sprites_quads_.size(); i++ )
 	{
-		const MapState::SpriteEffect& sprite= *sprite_ptr;
-
-		const GameResources::SpriteEffectDescription& sprite_description= game_resources_->sprites_effects_description[ sprite.effect_id ];
-		const SpriteTexture& sprite_texture= sprite_effects_textures_[ sprite.effect_id ];
-
-		// TODO - optimize this. Use less matrix multiplications.
-		// TODO - maybe add hierarchical depth-test ?
-
-		const m_Vec3 vec_to_sprite= sprite.pos - camera_position;
-		float sprite_angles[2];
-		VecToAngles( vec_to_sprite, sprite_angles );
-
-		m_Mat4 rotate_z, rotate_x, shift_mat, sprite_mat;
-		rotate_z.RotateZ( sprite_angles[0] - Constants::half_pi );
-		rotate_x.RotateX( sprite_angles[1] );
-		shift_mat.Translate( sprite.pos );
-		sprite_mat= rotate_x * rotate_z * shift_mat;
-
-		const float additional_scale= ( sprite_description.half_size ? 0.5f : 1.0f ) / 128.0f;
-		const float size_x= additional_scale * float(sprite_texture.size[0]);
-		const float size_z= additional_scale * float(sprite_texture.size[1]) ;
+		if( IsSpriteSkipped(i) )
+			continue;
 
-		clipped_vertices_[0].pos= m_Vec3( -size_x, 0.0f, -size_z ) * sprite_mat;
-		clipped_vertices_[1].pos= m_Vec3( +size_x, 0.0f, -size_z ) * sprite_mat;
-		clipped_vertices_[2].pos= m_Vec3( +size_x, 0.0f, +size_z ) * sprite_mat;
-		clipped_vertices_[3].pos= m_Vec3( -size_x, 0.0f, +size_z ) * sprite_mat;
-		clipped_vertices_[0].tc= m_Vec2( 0.0f, 0.0f );
-		clipped_vertices_[1].tc= m_Vec2( float(sprite_texture.size[0] << 16), 0.0f );
-		clipped_vertices_[2].tc= m_Vec2( float(sprite_texture.size[0] << 16), float(sprite_texture.size[1] << 16) );
-		clipped_vertices_[3].tc= m_Vec2( 0.0f, float(sprite_texture.size[1] << 16) );
-		clipped_vertices_[0].next= &clipped_vertices_[1];
-		clipped_vertices_[1].next= &clipped_vertices_[2];
-		clipped_vertices_[2].next= &clipped_vertices_[3];
-		clipped_vertices_[3].next= &clipped_vertices_[0];
-		fisrt_clipped_vertex_= &clipped_vertices_[0];
-		next_new_clipped_vertex_= 4u;
+		const SpriteQuad& quad= sprites_quads_[i];
 
-		unsigned int polygon_vertex_count= 4u;
+		// Sprite is outside view, if all vertices are behind one of clip planes.
+		bool outside_view= false;
 		for( const m_Plane3& plane : view_clip_planes )
 		{
-			polygon_vertex_count= ClipPolygon( plane, polygon_vertex_count );
-			PC_ASSERT( polygon_vertex_count == 0u || polygon_vertex_count >= 3u );
-			if( polygon_vertex_count == 0u )
+			bool is_inside= false;
+			for( const m_Vec3& vertex : quad )
+				is_inside= is_inside || plane.IsPointAheadPlane( vertex );
+			if( !is_inside )
+			{
+				outside_view= true;
 				break;
+			}
 		}
-		if( polygon_vertex_count == 0u )
+		if( outside_view )
+		{
+			SkipSprite(i);
 			continue;
+		}
 
-		RasterizerVertex verties_projected[ c_max_clip_vertices_ ];
-		ClippedVertex* v= fisrt_clipped_vertex_;
-		for( unsigned int i= 0u; i < polygon_vertex_count; i++, v= v->next )
+		// Calculate screen-space bounding box.
+		float x_min= Constants::max_float, x_max= Constants::min_float;
+		float y_min= Constants::max_float, y_max= Constants::min_float;
+		float w_min= Constants::max_float;
+		for( const m_Vec3& vertex : quad )
 		{
-			m_Vec3 vertex_projected= v->pos * view_matrix;
-			const float w= v->pos.x * view_matrix.value[3] + v->pos.y * view_matrix.value[7] + v->pos.z * view_matrix.value[11] + view_matrix.value[15];
-
-			vertex_projected/= w;
-			vertex_projected.z= w;
-
-			vertex_projected.x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
-			vertex_projected.y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
+			const float w= vertex.x * view_matrix.value[3] + vertex.y * view_matrix.value[7] + vertex.z * view_matrix.value[11] + view_matrix.value[15];
+			if( w < w_min ) w_min= w;
 
-			RasterizerVertex& out_v= verties_projected[ i ];
-			out_v.x= fixed16_t( vertex_projected.x * 65536.0f );
-			out_v.y= fixed16_t( vertex_projected.y * 65536.0f );
-			out_v.u= fixed16_t( v->tc.x );
-			out_v.v= fixed16_t( v->tc.y );
-			out_v.z= fixed16_t( w * 65536.0f );
+			if( w > 0.0f )
+			{
+				m_Vec2 vertex_projected= ( vertex * view_matrix ).xy();
+				vertex_projected/= w;
+				const float screen_x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
+				const float screen_y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
+				if( screen_x < x_min ) x_min= screen_x;
+				if( screen_x > x_max ) x_max= screen_x;
+				if( screen_y < y_min ) y_min= screen_y;
+				if( screen_y > y_max ) y_max= screen_y;
+			}
 		}
 
-		const unsigned int frame= static_cast<unsigned int>( sprite.frame ) % sprite_texture.size[2];
-		rasterizer_.SetTexture(
-			sprite_texture.size[0], sprite_texture.size[1],
-			sprite_texture.data.data() + sprite_texture.size[0] * sprite_texture.size[1] * frame );
+		// Sprite must be not so near for hierarchical depth-test - farther, then z_near.
+		if( !( w_min > 1.1f / float( 1u << Rasterizer::c_max_inv_z_min_log2 ) ) )
+			continue;
 
-		Rasterizer::ConvexPolygonDrawFunc draw_func;
+		x_min= std::min( std::max( x_min, 0.0f ), screen_transform_x_ * 2.0f );
+		y_min= std::min( std::max( y_min, 0.0f ), screen_transform_y_ * 2.0f );
+		x_max= std::min( std::max( x_max, 0.0f ), screen_transform_x_ * 2.0f );
+		y_max= std::min( std::max( y_max, 0.0f ), screen_transform_y_ * 2.0f );
 
-		if( !sprite_description.light_on )
-		{
-			fixed16_t light= g_fixed16_one;
-			const unsigned int lightmap_x= static_cast<unsigned int>( sprite.pos.x * float(MapData::c_lightmap_scale) );
-			const unsigned int lightmap_y= static_cast<unsigned int>( sprite.pos.y * float(MapData::c_lightmap_scale) );
-			if( lightmap_x < MapData::c_lightmap_size && lightmap_y < MapData::c_lightmap_size )
-				light= ScaleLightmapLight( current_map_data_->lightmap[ lightmap_x + lightmap_y * MapData::c_lightmap_size ] );
-			rasterizer_.SetLight( light );
+		sprites_depth_queries_.emplace_back();
+		Rasterizer::DepthOcclusionQuery& query= sprites_depth_queries_.back();
+		query.x_min= fixed16_t(x_min * 65536.0f);
+		query.y_min= fixed16_t(y_min * 65536.0f);
+		query.x_max= fixed16_t(x_max * 65536.0f);
+		query.y_max= fixed16_t(y_max * 65536.0f);
+		query.z_min= fixed16_t(w_min * 65536.0f);
+		sprites_depth_queries_sprites_.push_back(i);
+	}
 
-			draw_func=
-				&Rasterizer::DrawTexturedConvexPolygonSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::Yes,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::Yes, Rasterizer::Blending::Yes>;
-		}
-		else
-			draw_func=
-				&Rasterizer::DrawTexturedConvexPolygonSpanCorrected<
-					Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-					Rasterizer::AlphaTest::Yes,
-					Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-					Rasterizer::Lighting::No, Rasterizer::Blending::Yes>;
+	sprites_occluded_mask_.resize( ( sprites_depth_queries_.size() + 31u ) / 32u );
+	current_rasterizer_->CheckDepthOcclusion(
+		sprites_depth_queries_.data(), sprites_depth_queries_.size(),
+		sprites_occluded_mask_.data(),
+		instruction_set_ );
 
-		(rasterizer_.*draw_func)( verties_projected, polygon_vertex_count, false );
+	for( unsigned int q= 0u; q < sprites_depth_queries_.size(); q++ )
+	{
+		if( ( sprites_occluded_mask_[ q >> 5u ] & ( 1u << ( q & 31u ) ) ) != 0u )
+			SkipSprite( sprites_depth_queries_sprites_[q] );
 	}
 }
 
-void MapDrawerSoft::DrawBMPObjectsSprites(
-	const MapState& map_state,
+bool MapDrawerSoft::IsSpriteSkipped( const unsigned int sprite_index ) const
+{
+	return ( sprites_skip_mask_[ sprite_index >> 5u ] & ( 1u << ( sprite_index & 31u ) ) ) != 0u;
+}
+
+void MapDrawerSoft::SkipSprite( const unsigned int sprite_index )
+{
+	sprites_skip_mask_[ sprite_index >> 5u ]|= 1u << ( sprite_index & 31u );
+}
+
+bool MapDrawerSoft::ClipAndProjectSprite(
+	const SpriteQuad& quad,
+	const SpriteTexture& sprite_texture,
+	const ViewClipPlanes& view_clip_planes,
 	const m_Mat4& view_matrix,
-	const m_Vec3& camera_position,
-	const ViewClipPlanes& view_clip_planes )
+	RasterizerVertex* const out_vertices,
+	unsigned int& out_vertex_count )
 {
-	const float sprites_frame= map_state.GetSpritesFrame();
+	for( unsigned int i= 0u; i < 4u; i++ )
+		clipped_vertices_[i].pos= quad[i];
+	clipped_vertices_[0].tc= m_Vec2( 0.0f, 0.0f );
+	clipped_vertices_[1].tc= m_Vec2( float(sprite_texture.size[0] << 16), 0.0f );
+	clipped_vertices_[2].tc= m_Vec2( float(sprite_texture.size[0] << 16), float(sprite_texture.size[1] << 16) );
+	clipped_vertices_[3].tc= m_Vec2( 0.0f, float(sprite_texture.size[1] << 16) );
+	clipped_vertices_[0].next= &clipped_vertices_[1];
+	clipped_vertices_[1].next= &clipped_vertices_[2];
+	clipped_vertices_[2].next= &clipped_vertices_[3];
+	clipped_vertices_[3].next= &clipped_vertices_[0];
+	fisrt_clipped_vertex_= &clipped_vertices_[0];
+	next_new_clipped_vertex_= 4u;
 
-	// TODO - maybe add hierarchical depth test?
-	for( const MapState::StaticModel& model : map_state.GetStaticModels() )
+	out_vertex_count= ClipPolygonByView( view_clip_planes, 4u );
+	if( out_vertex_count == 0u )
+		return false;
+
+	ClippedVertex* v= fisrt_clipped_vertex_;
+	for( unsigned int i= 0u; i < out_vertex_count; i++, v= v->next )
 	{
+		m_Vec3 vertex_projected= v->pos * view_matrix;
+		const float w= v->pos.x * view_matrix.value[3] + v->pos.y * view_matrix.value[7] + v->pos.z * view_matrix.value[11] + view_matrix.value[15];
+
+		vertex_projected/= w;
+		vertex_projected.z= w;
+
+		vertex_projected.x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
+		vertex_projected.y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
+
+		RasterizerVertex& out_v= out_vertices[ i ];
+		out_v.x= fixed16_t( vertex_projected.x * 65536.0f );
+		out_v.y= fixed16_t( vertex_projected.y * 65536.0f );
+		out_v.u= fixed16_t( v->tc.x );
+		out_v.v= fixed16_t( v->tc.y );
+		out_v.z= fixed16_t( w * 65536.0f );
+	}
+
+	return true;
+}
+
+void MapDrawerSoft::DrawEffectsSprites(
+	const MapState& map_state,
+	const m_Mat4& view_matrix,
+	const m_Vec3& camera_position,
+	const ViewClipPlanes& view_clip_planes )
+{
+	const MapState::SpriteEffects& sprite_effects= map_state.GetSpriteEffects();
+
+	// Build quads and cull sprites before sorting. Only sizes of sprites are needed here, textures are prepared only for visible sprites.
+	sprites_quads_.resize( sprite_effects.size() );
+	sprites_skip_mask_.assign( ( sprite_effects.size() + 31u ) / 32u, 0u );
+	for( unsigned int i= 0u; i < sprite_effects.size(); i++ )
+	{
+		const MapState::SpriteEffect& sprite= sprite_effects[i];
+
+		const GameResources::SpriteEffectDescription& sprite_description= game_resources_->sprites_effects_description[ sprite.effect_id ];
+		const SpriteTexture& sprite_texture= sprite_effects_textures_[ sprite.effect_id ];
+
+		const float additional_scale= ( sprite_description.half_size ? 0.5f : 1.0f ) / 128.0f;
+		const float size_x= additional_scale * float(sprite_texture.size[0]);
+		const float size_z= additional_scale * float(sprite_texture.size[1]) ;
+
+		if( !IsAreaPotentiallyVisible(
+				sprite.pos.xy() - m_Vec2( size_x, size_x ),
+				sprite.pos.xy() + m_Vec2( size_x, size_x ) ) )
+		{
+			SkipSprite(i);
+			continue;
+		}
+
+		const m_Vec3 vec_to_sprite= sprite.pos - camera_position;
+		float sprite_angles[2];
+		VecToAngles( vec_to_sprite, sprite_angles );
+
+		m_Mat4 rotate_z, rotate_x, shift_mat, sprite_mat;
+		rotate_z.RotateZ( sprite_angles[0] - Constants::half_pi );
+		rotate_x.RotateX( sprite_angles[1] );
+		shift_mat.Translate( sprite.pos );
+		sprite_mat= rotate_x * rotate_z * shift_mat;
+
+		SpriteQuad& quad= sprites_quads_[i];
+		quad[0]= m_Vec3( -size_x, 0.0f, -size_z ) * sprite_mat;
+		quad[1]= m_Vec3( +size_x, 0.0f, -size_z ) * sprite_mat;
+		quad[2]= m_Vec3( +size_x, 0.0f, +size_z ) * sprite_mat;
+		quad[3]= m_Vec3( -size_x, 0.0f, +size_z ) * sprite_mat;
+	}
+
+	CullSprites( view_matrix, view_clip_planes );
+
+	SortEffectsSprites( sprite_effects, camera_position, sprites_sort_buffer_, sorted_sprites_, sprites_skip_mask_.data() );
+
+	for( const MapState::SpriteEffect* const sprite_ptr : sorted_sprites_ )
+	{
+		const MapState::SpriteEffect& sprite= *sprite_ptr;
+
+		const GameResources::SpriteEffectDescription& sprite_description= game_resources_->sprites_effects_description[ sprite.effect_id ];
+		const SpriteTexture& sprite_texture= GetSpriteTexture( sprite_effects_textures_[ sprite.effect_id ] );
+
+		RasterizerVertex verties_projected[ c_max_clip_vertices_ ];
+		unsigned int polygon_vertex_count;
+		if( !ClipAndProjectSprite(
+				sprites_quads_[ static_cast<unsigned int>( sprite_ptr - sprite_effects.data() ) ],
+				sprite_texture, view_clip_planes, view_matrix,
+				verties_projected, polygon_vertex_count ) )
+			continue;
+
+		const unsigned int frame= static_cast<unsigned int>( sprite.frame ) % sprite_texture.size[2];
+		SetSpriteTextureFrame( sprite_texture, frame, verties_projected, polygon_vertex_count );
+
+		Rasterizer::ConvexPolygonDrawFunc draw_func;
+
+		if( !sprite_description.light_on )
+		{
+			fixed16_t light= g_fixed16_one;
+			const unsigned int lightmap_x= static_cast<unsigned int>( sprite.pos.x * float(MapData::c_lightmap_scale) );
+			const unsigned int lightmap_y= static_cast<unsigned int>( sprite.pos.y * float(MapData::c_lightmap_scale) );
+			if( lightmap_x < MapData::c_lightmap_size && lightmap_y < MapData::c_lightmap_size )
+				light= ScaleLightmapLight( current_map_data_->lightmap[ lightmap_x + lightmap_y * MapData::c_lightmap_size ] );
+			SetLight( light );
+
+			draw_func= kernels_.effects_sprites[1];
+		}
+		else
+			draw_func= kernels_.effects_sprites[0];
+
+		DrawConvexPolygon( draw_func, verties_projected, polygon_vertex_count, false );
+	}
+}
+
+void MapDrawerSoft::DrawBMPObjectsSprites(
+	const MapState& map_state,
+	const m_Mat4& view_matrix,
+	const m_Vec3& camera_position,
+	const ViewClipPlanes& view_clip_planes )
+{
+	const float sprites_frame= map_state.GetSpritesFrame();
+	const MapState::StaticModels& static_models= map_state.GetStaticModels();
+
+	// Build quads for models with sprites and cull them in one batch.
+	sprites_quads_.resize( static_models.size() );
+	sprites_skip_mask_.assign( ( static_models.size() + 31u ) / 32u, 0u );
+	for( unsigned int i= 0u; i < static_models.size(); i++ )
+	{
+		const MapState::StaticModel& model= static_models[i];
 		if( model.model_id >= current_map_data_->models_description.size() )
+		{
+			SkipSprite(i);
 			continue;
+		}
 
 		const MapData::ModelDescription& model_description= current_map_data_->models_description[ model.model_id ];
 		const int bmp_obj_id= model_description.bobj - 1u;
 		if( bmp_obj_id < 0 || bmp_obj_id > static_cast<int>( game_resources_->bmp_objects_description.size() ) )
+		{
+			SkipSprite(i);
 			continue;
+		}
 
 		const GameResources::BMPObjectDescription& bmp_description= game_resources_->bmp_objects_description[ bmp_obj_id ];
-		const ObjSprite& sprite_picture= game_resources_->bmp_objects_sprites[ bmp_obj_id ];
 		const SpriteTexture& sprite_texture= bmp_objects_sprites_[ bmp_obj_id ];
 
 		const float additional_scale= ( bmp_description.half_size ? 0.5f : 1.0f ) / 128.0f;
@@ -2225,6 +3483,14 @@ void MapDrawerSoft::DrawBMPObjectsSprites(
 			1.0f,
 			float(sprite_texture.size[1]) * additional_scale );
 
+		if( !IsAreaPotentiallyVisible(
+				model.pos.xy() - m_Vec2( scale_vec.x, scale_vec.x ),
+				model.pos.xy() + m_Vec2( scale_vec.x, scale_vec.x ) ) )
+		{
+			SkipSprite(i);
+			continue;
+		}
+
 		m_Vec3 pos= model.pos;
 		pos.z+= float( model_description.bmpz ) / 64.0f + scale_vec.z;
 
@@ -2237,69 +3503,292 @@ void MapDrawerSoft::DrawBMPObjectsSprites(
 		shift_mat.Translate( pos );
 		sprite_mat= rotate_z * shift_mat;
 
-		clipped_vertices_[0].pos= m_Vec3( -scale_vec.x, 0.0f, -scale_vec.z ) * sprite_mat;
-		clipped_vertices_[1].pos= m_Vec3( +scale_vec.x, 0.0f, -scale_vec.z ) * sprite_mat;
-		clipped_vertices_[2].pos= m_Vec3( +scale_vec.x, 0.0f, +scale_vec.z ) * sprite_mat;
-		clipped_vertices_[3].pos= m_Vec3( -scale_vec.x, 0.0f, +scale_vec.z ) * sprite_mat;
-		clipped_vertices_[0].tc= m_Vec2( 0.0f, 0.0f );
-		clipped_vertices_[1].tc= m_Vec2( float(sprite_texture.size[0] << 16), 0.0f );
-		clipped_vertices_[2].tc= m_Vec2( float(sprite_texture.size[0] << 16), float(sprite_texture.size[1] << 16) );
-		clipped_vertices_[3].tc= m_Vec2( 0.0f, float(sprite_texture.size[1] << 16) );
-		clipped_vertices_[0].next= &clipped_vertices_[1];
-		clipped_vertices_[1].next= &clipped_vertices_[2];
-		clipped_vertices_[2].next= &clipped_vertices_[3];
-		clipped_vertices_[3].next= &clipped_vertices_[0];
-		fisrt_clipped_vertex_= &clipped_vertices_[0];
-		next_new_clipped_vertex_= 4u;
+		SpriteQuad& quad= sprites_quads_[i];
+		quad[0]= m_Vec3( -scale_vec.x, 0.0f, -scale_vec.z ) * sprite_mat;
+		quad[1]= m_Vec3( +scale_vec.x, 0.0f, -scale_vec.z ) * sprite_mat;
+		quad[2]= m_Vec3( +scale_vec.x, 0.0f, +scale_vec.z ) * sprite_mat;
+		quad[3]= m_Vec3( -scale_vec.x, 0.0f, +scale_vec.z ) * sprite_mat;
+	}
 
-		unsigned int polygon_vertex_count= 4u;
-		for( const m_Plane3& plane : view_clip_planes )
-		{
-			polygon_vertex_count= ClipPolygon( plane, polygon_vertex_count );
-			PC_ASSERT( polygon_vertex_count == 0u || polygon_vertex_count >= 3u );
-			if( polygon_vertex_count == 0u )
-				break;
-		}
-		if( polygon_vertex_count == 0u )
+	CullSprites( view_matrix, view_clip_planes );
+
+	for( unsigned int i= 0u; i < static_models.size(); i++ )
+	{
+		if( IsSpriteSkipped(i) )
 			continue;
 
+		const MapState::StaticModel& model= static_models[i];
+		const int bmp_obj_id= current_map_data_->models_description[ model.model_id ].bobj - 1u;
+
+		const ObjSprite& sprite_picture= game_resources_->bmp_objects_sprites[ bmp_obj_id ];
+		const SpriteTexture& sprite_texture= GetSpriteTexture( bmp_objects_sprites_[ bmp_obj_id ] );
+
 		RasterizerVertex verties_projected[ c_max_clip_vertices_ ];
-		ClippedVertex* v= fisrt_clipped_vertex_;
-		for( unsigned int i= 0u; i < polygon_vertex_count; i++, v= v->next )
+		unsigned int polygon_vertex_count;
+		if( !ClipAndProjectSprite(
+				sprites_quads_[i],
+				sprite_texture, view_clip_planes, view_matrix,
+				verties_projected, polygon_vertex_count ) )
+			continue;
+
+		const unsigned int phase= GetModelBMPSpritePhase( model );
+		const unsigned int frame= static_cast<unsigned int>( sprites_frame + phase ) % sprite_picture.frame_count;
+
+		SetSpriteTextureFrame( sprite_texture, frame, verties_projected, polygon_vertex_count );
+
+		DrawConvexPolygon( kernels_.bmp_objects_sprites, verties_projected, polygon_vertex_count, false );
+	}
+}
+
+void MapDrawerSoft::BeginDynamicResolutionFrame()
+{
+	DynamicResolution& dr= dynamic_resolution_;
+	if( !dr.enabled || dr.scale == c_dynamic_resolution_scale_denominator )
+	{
+		// Draw directly into viewport. Release reduced buffers, if scale returned to native.
+		if( dr.rasterizer != nullptr )
 		{
-			m_Vec3 vertex_projected= v->pos * view_matrix;
-			const float w= v->pos.x * view_matrix.value[3] + v->pos.y * view_matrix.value[7] + v->pos.z * view_matrix.value[11] + view_matrix.value[15];
+			dr.tiled_rasterizer.reset();
+			dr.rasterizer.reset();
+			dr.color_buffer= std::vector<uint32_t>();
+		}
+		return;
+	}
 
-			vertex_projected/= w;
-			vertex_projected.z= w;
+	const Size2& viewport_size= rendering_context_.viewport_size;
+	const Size2 size(
+		std::max( 1u, viewport_size.Width () * dr.scale / c_dynamic_resolution_scale_denominator ),
+		std::max( 1u, viewport_size.Height() * dr.scale / c_dynamic_resolution_scale_denominator ) );
 
-			vertex_projected.x= ( vertex_projected.x + 1.0f ) * screen_transform_x_;
-			vertex_projected.y= ( vertex_projected.y + 1.0f ) * screen_transform_y_;
+	if( dr.rasterizer == nullptr || size != dr.size )
+	{
+		// Tiled rasterizer references main rasterizer buffers, destroy it first.
+		dr.tiled_rasterizer.reset();
+		dr.rasterizer.reset();
+
+		dr.size= size;
+		dr.color_buffer.resize( size.Width() * size.Height() );
+		dr.rasterizer.reset( new Rasterizer( size.Width(), size.Height(), size.Width(), dr.color_buffer.data() ) );
+		if( rendering_workers_pool_ != nullptr )
+			dr.tiled_rasterizer.reset( new TiledRasterizer( *dr.rasterizer, size.Height(), *rendering_workers_pool_ ) );
+
+		dr.upscale_src_x.resize( viewport_size.Width() );
+		for( unsigned int x= 0u; x < viewport_size.Width(); x++ )
+			dr.upscale_src_x[x]= x * size.Width() / viewport_size.Width();
+	}
 
-			RasterizerVertex& out_v= verties_projected[ i ];
-			out_v.x= fixed16_t( vertex_projected.x * 65536.0f );
-			out_v.y= fixed16_t( vertex_projected.y * 65536.0f );
-			out_v.u= fixed16_t( v->tc.x );
-			out_v.v= fixed16_t( v->tc.y );
-			out_v.z= fixed16_t( w * 65536.0f );
+	current_rasterizer_= dr.rasterizer.get();
+	screen_transform_x_= 0.5f * float( size.Width () );
+	screen_transform_y_= 0.5f * float( size.Height() );
+}
+
+void MapDrawerSoft::EndDynamicResolutionFrame( const Time& draw_start_time )
+{
+	DynamicResolution& dr= dynamic_resolution_;
+	if( !dr.enabled )
+		return;
+
+	if( current_rasterizer_ != &rasterizer_ )
+	{
+		UpscaleDynamicResolutionFrame();
+
+		current_rasterizer_= &rasterizer_;
+		screen_transform_x_= 0.5f * float( rendering_context_.viewport_size.Width () );
+		screen_transform_y_= 0.5f * float( rendering_context_.viewport_size.Height() );
+	}
+
+	const float draw_time_s= ( Time::CurrentTime() - draw_start_time ).ToSeconds();
+	if( dr.average_draw_time_s < 0.0f )
+		dr.average_draw_time_s= draw_time_s;
+	else
+		dr.average_draw_time_s= dr.average_draw_time_s * 0.9f + draw_time_s * 0.1f;
+
+	if( dr.change_cooldown_frames > 0u )
+	{
+		dr.change_cooldown_frames--;
+		return;
+	}
+
+	// Drawing time is nearly proportional to pixel count.
+	const auto square_ratio=
+	[]( const unsigned int a, const unsigned int b ) -> float
+	{
+		const float ratio= float(a) / float(b);
+		return ratio * ratio;
+	};
+
+	unsigned int new_scale= dr.scale;
+	if( dr.average_draw_time_s > dr.target_draw_time_s && dr.scale > g_dynamic_resolution_min_scale )
+		new_scale= dr.scale - 1u;
+	else if(
+		dr.scale < c_dynamic_resolution_scale_denominator &&
+		dr.average_draw_time_s * square_ratio( dr.scale + 1u, dr.scale ) < dr.target_draw_time_s * 0.9f )
+		new_scale= dr.scale + 1u;
+
+	if( new_scale != dr.scale )
+	{
+		dr.average_draw_time_s*= square_ratio( new_scale, dr.scale );
+		dr.scale= new_scale;
+		dr.change_cooldown_frames= g_dynamic_resolution_change_cooldown_frames;
+	}
+}
+
+void MapDrawerSoft::UpscaleDynamicResolutionFrame()
+{
+	const DynamicResolution& dr= dynamic_resolution_;
+	const Size2& viewport_size= rendering_context_.viewport_size;
+
+	unsigned int prev_src_y= ~0u;
+	for( unsigned int y= 0u; y < viewport_size.Height(); y++ )
+	{
+		uint32_t* const dst= rendering_context_.window_surface_data + y * rendering_context_.row_pixels;
+		const unsigned int src_y= y * dr.size.Height() / viewport_size.Height();
+		if( src_y == prev_src_y )
+		{
+			// Same source row - just copy previous destination row.
+			std::memcpy( dst, dst - rendering_context_.row_pixels, viewport_size.Width() * sizeof(uint32_t) );
+			continue;
 		}
+		prev_src_y= src_y;
 
-		const unsigned int phase= GetModelBMPSpritePhase( model );
-		const unsigned int frame= static_cast<unsigned int>( sprites_frame + phase ) % sprite_picture.frame_count;
+		const uint32_t* const src= dr.color_buffer.data() + src_y * dr.size.Width();
+		for( unsigned int x= 0u; x < viewport_size.Width(); x++ )
+			dst[x]= src[ dr.upscale_src_x[x] ];
+	}
+}
 
-		rasterizer_.SetTexture(
-			sprite_texture.size[0], sprite_texture.size[1],
-			sprite_texture.data.data() + sprite_texture.size[0] * sprite_texture.size[1] * frame );
+const MapDrawerSoft::SpriteTexture& MapDrawerSoft::GetSpriteTexture( SpriteTexture& sprite_texture )
+{
+	sprite_texture.last_used_frame= frame_number_;
+	if( !sprite_texture.data.empty() )
+		return sprite_texture;
 
-		rasterizer_.DrawTexturedConvexPolygonSpanCorrected<
-			Rasterizer::DepthTest::Yes, Rasterizer::DepthWrite::Yes,
-			Rasterizer::AlphaTest::Yes,
-			Rasterizer::OcclusionTest::No, Rasterizer::OcclusionWrite::No,
-			Rasterizer::Lighting::No, Rasterizer::Blending::Yes>
-				( verties_projected, polygon_vertex_count, false );
+	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
+	const ObjSprite& in_sprite= *sprite_texture.source;
+
+	sprite_texture.mip_count= GetTextureMipCount( in_sprite.size[0], in_sprite.size[1], c_max_textures_mips );
+	sprite_texture.data.resize(
+		CalculateTextureMipsOffsets(
+			in_sprite.size[0], in_sprite.size[1], in_sprite.frame_count,
+			sprite_texture.mip_count, sprite_texture.mips_data_offsets ) );
+
+	const unsigned int pixel_count= in_sprite.size[0] * in_sprite.size[1] * in_sprite.frame_count;
+	for( unsigned int j= 0u; j < pixel_count; j++ )
+		sprite_texture.data[j]= palette[in_sprite.data[j]];
+
+	BuildTextureMips(
+		sprite_texture.data.data(),
+		in_sprite.size[0], in_sprite.size[1], in_sprite.frame_count,
+		sprite_texture.mip_count, sprite_texture.mips_data_offsets,
+		true );
+
+	sprites_textures_data_size_+= sprite_texture.data.size() * sizeof(uint32_t);
+	if( sprites_textures_data_size_ > g_sprites_textures_cache_budget )
+		ReleaseUnusedSpritesTextures();
+
+	return sprite_texture;
+}
+
+void MapDrawerSoft::SetSpriteTextureFrame(
+	const SpriteTexture& sprite_texture,
+	const unsigned int frame,
+	RasterizerVertex* const vertices, const unsigned int vertex_count )
+{
+	const unsigned int mip= SelectPolygonTextureMip( vertices, vertex_count, sprite_texture.mip_count );
+	const unsigned int mip_size_x= sprite_texture.size[0] >> mip;
+	const unsigned int mip_size_y= sprite_texture.size[1] >> mip;
+	SetTexture(
+		mip_size_x, mip_size_y,
+		sprite_texture.data.data() + sprite_texture.mips_data_offsets[mip] + mip_size_x * mip_size_y * frame );
+}
+
+void MapDrawerSoft::ReleaseUnusedSpritesTextures()
+{
+	// Release least recently used sprites first.
+	// Do not touch sprites of current frame - rasterizer may still reference their data.
+	while( sprites_textures_data_size_ > g_sprites_textures_cache_budget )
+	{
+		SpriteTexture* oldest_sprite= nullptr;
+		for( std::vector<SpriteTexture>* const textures : { &sprite_effects_textures_, &bmp_objects_sprites_ } )
+		for( SpriteTexture& sprite_texture : *textures )
+		{
+			if( sprite_texture.data.empty() || sprite_texture.last_used_frame == frame_number_ )
+				continue;
+			if( oldest_sprite == nullptr || sprite_texture.last_used_frame < oldest_sprite->last_used_frame )
+				oldest_sprite= &sprite_texture;
+		}
+
+		if( oldest_sprite == nullptr )
+			break;
+
+		sprites_textures_data_size_-= oldest_sprite->data.size() * sizeof(uint32_t);
+		std::vector<uint32_t>().swap( oldest_sprite->data );
 	}
 }
 
+void MapDrawerSoft::SetupGuardBandClipPlanes( const m_Mat4& matrix, const ViewClipPlanes& view_clip_planes )
+{
+	// Near plane clipping is always needed.
+	guard_band_clip_planes_[0]= view_clip_planes[0];
+
+	// Guard band planes - planes, where screen x or y is equal to guard band border.
+	// For left border: ( x / w + 1 ) * screen_transform_x = -guard_band, so, x + w * ( 1 + guard_band / screen_transform_x ) = 0.
+	const float k[2]=
+	{
+		1.0f + float(Rasterizer::c_guard_band_size) / screen_transform_x_,
+		1.0f + float(Rasterizer::c_guard_band_size) / screen_transform_y_,
+	};
+
+	const m_Vec3 w_normal( matrix.value[3], matrix.value[7], matrix.value[11] );
+	const float w_dist= matrix.value[15];
+
+	for( unsigned int i= 0u; i < 2u; i++ )
+	{
+		const m_Vec3 normal( matrix.value[i], matrix.value[4u + i], matrix.value[8u + i] );
+		const float dist= matrix.value[12u + i];
+
+		m_Plane3& min_plane= guard_band_clip_planes_[ 1u + i * 2u ];
+		m_Plane3& max_plane= guard_band_clip_planes_[ 2u + i * 2u ];
+		min_plane.normal= w_normal * k[i] + normal;
+		min_plane.dist= w_dist * k[i] + dist;
+		max_plane.normal= w_normal * k[i] - normal;
+		max_plane.dist= w_dist * k[i] - dist;
+	}
+}
+
+unsigned int MapDrawerSoft::ClipPolygonByView(
+	const ViewClipPlanes& view_clip_planes,
+	unsigned int vertex_count )
+{
+	// Discard polygon, if it is fully outside view.
+	for( const m_Plane3& plane : view_clip_planes )
+	{
+		bool is_ahead= false;
+		const ClippedVertex* v= fisrt_clipped_vertex_;
+		for( unsigned int i= 0u; i < vertex_count; i++, v= v->next )
+		{
+			if( plane.IsPointAheadPlane( v->pos ) )
+			{
+				is_ahead= true;
+				break;
+			}
+		}
+		if( !is_ahead )
+			return 0u;
+	}
+
+	// Rasterizer accepts vertices inside guard band, so, clip polygon only by near plane and guard band planes.
+	for( const m_Plane3& plane : guard_band_clip_planes_ )
+	{
+		vertex_count= ClipPolygon( plane, vertex_count );
+		PC_ASSERT( vertex_count == 0u || vertex_count >= 3u );
+		if( vertex_count == 0u )
+			break;
+	}
+
+	return vertex_count;
+}
+
 unsigned int MapDrawerSoft::ClipPolygon(
 	const m_Plane3& clip_plane,
 	unsigned int vertex_count )
@@ -2388,6 +3877,273 @@ unsigned int MapDrawerSoft::ClipPolygon(
 	return vertex_count - vertices_behind + 2u;
 }
 
+void MapDrawerSoft::PrefetchSurfaces( const m_Vec3& camera_position, const m_Mat4& view_rotation_and_projection_matrix )
+{
+	// Predict camera position this time ahead.
+	constexpr float c_prediction_time= 0.3f;
+	constexpr float c_max_frame_time= 0.25f;
+	// Prefetch only surfaces near predicted position.
+	constexpr float c_prefetch_radius= 6.0f;
+	// Do not spend on prefetch more, than this part of surfaces cache per frame.
+	constexpr unsigned int c_cache_part_per_frame= 32u;
+
+	const Time current_time= Time::CurrentTime();
+	const bool prev_frame_camera_valid= prev_frame_camera_valid_;
+	const m_Vec3 prev_camera_position= prev_camera_position_;
+	const float frame_time= ( current_time - prev_frame_time_ ).ToSeconds();
+
+	prev_camera_position_= camera_position;
+	prev_frame_time_= current_time;
+	prev_frame_camera_valid_= true;
+
+	if( !prev_frame_camera_valid || frame_time <= 0.0f || frame_time > c_max_frame_time )
+		return;
+
+	const m_Vec3 camera_shift= ( camera_position - prev_camera_position ) * ( c_prediction_time / frame_time );
+	if( camera_shift.SquareLength() < 0.25f * 0.25f )
+		return; // Camera does not move fast - surfaces of current view are enough.
+
+	const m_Vec3 predicted_position= camera_position + camera_shift;
+
+	// Length of 'y' column of view and projection matrix is vertical projection scale, because rotation does not change length.
+	const float projection_scale_y=
+		m_Vec3(
+			view_rotation_and_projection_matrix.value[1],
+			view_rotation_and_projection_matrix.value[5],
+			view_rotation_and_projection_matrix.value[9] ).Length() * screen_transform_y_;
+	if( projection_scale_y <= 0.0f )
+		return;
+
+	// Select mip, like walls and floors drawing code does, using distance instead of real projection.
+	const auto select_mip=
+	[&]( const float distance, const float texels_per_unit, const float first_mip_threshold ) -> unsigned int
+	{
+		const float texels_per_pixel= distance * texels_per_unit / projection_scale_y;
+		if( texels_per_pixel < first_mip_threshold * 1.0f ) return 0u;
+		if( texels_per_pixel < first_mip_threshold * 2.0f ) return 1u;
+		if( texels_per_pixel < first_mip_threshold * 4.0f ) return 2u;
+		return 3u;
+	};
+
+	unsigned int budget= surfaces_cache_.GetStorageSize() / c_cache_part_per_frame;
+	const auto take_budget=
+	[&]( const unsigned int size_x, const unsigned int size_y ) -> bool
+	{
+		const unsigned int allocation_size= SurfacesCache::GetSurfaceAllocationSize( size_x, size_y );
+		if( allocation_size > budget )
+		{
+			budget= 0u;
+			return false;
+		}
+		budget-= allocation_size;
+		return true;
+	};
+
+	const m_Vec2 predicted_position_xy= predicted_position.xy();
+
+	// Walls. Enumerate front to back, for prefetching of nearest walls first.
+	map_bsp_tree_->EnumerateSegmentsFrontToBack(
+		predicted_position_xy,
+		[&]( const MapBSPTree::WallSegment& segment )
+		{
+			if( budget == 0u )
+				return;
+
+			DrawWall& wall= static_walls_[ segment.wall_index ];
+			const WallTexture& texture= wall_textures_[ wall.texture_id ];
+			if( texture.size[0] == 0u || texture.size[1] == 0u ||
+				texture.full_alpha_row[0] == texture.full_alpha_row[1] )
+				return;
+
+			const bool is_back= mVec2Cross( predicted_position_xy - segment.vert_pos[0], segment.vert_pos[1] - segment.vert_pos[0] ) > 0.0f;
+			if( wall.texture_id < MapData::c_first_transparent_texture_id && is_back )
+				return;
+
+			// Distance to segment.
+			const m_Vec2 segment_vec= segment.vert_pos[1] - segment.vert_pos[0];
+			const float segment_square_length= segment_vec.SquareLength();
+			float k= 0.0f;
+			if( segment_square_length > 0.0f )
+				k= std::max( 0.0f, std::min( ( predicted_position_xy - segment.vert_pos[0] ) * segment_vec / segment_square_length, 1.0f ) );
+			const float distance= ( segment.vert_pos[0] + segment_vec * k - predicted_position_xy ).Length();
+			if( distance > c_prefetch_radius )
+				return;
+
+			const unsigned int mip=
+				select_mip(
+					distance,
+					float(g_wall_texture_height) / GameConstants::walls_height,
+					2.0f );
+			if( wall.mips_surfaces[mip] != nullptr )
+				return;
+
+			const unsigned int surface_height= ( texture.full_alpha_row[1] + ( (1u << mip) - 1u ) ) >> mip;
+			if( !take_budget( wall.surface_width >> mip, surface_height ) )
+				return;
+
+			switch( mip )
+			{
+			case 0u: GetWallSurface<0u>( wall ); break;
+			case 1u: GetWallSurface<1u>( wall ); break;
+			case 2u: GetWallSurface<2u>( wall ); break;
+			case 3u: GetWallSurface<3u>( wall ); break;
+			};
+		} );
+
+	// Floors and ceilings.
+	for( unsigned int i= 0u; i < map_floors_and_ceilings_.size() && budget > 0u; i++ )
+	{
+		FloorCeilingCell& cell= map_floors_and_ceilings_[i];
+		const float z= i >= first_ceiling_ ? GameConstants::walls_height : 0.0f;
+
+		const m_Vec3 cell_nearest_point(
+			std::max( float(cell.xy[0]), std::min( predicted_position.x, float(cell.xy[0] + 1u) ) ),
+			std::max( float(cell.xy[1]), std::min( predicted_position.y, float(cell.xy[1] + 1u) ) ),
+			z );
+		const float distance= ( cell_nearest_point - predicted_position ).Length();
+		if( distance > c_prefetch_radius )
+			continue;
+
+		const unsigned int mip= select_mip( distance, float(MapData::c_floor_texture_size), 1.0f );
+		if( cell.mips_surfaces[mip] != nullptr )
+			continue;
+
+		const unsigned int texture_size= MapData::c_floor_texture_size >> mip;
+		if( !take_budget( texture_size, texture_size ) )
+			break;
+
+		switch( mip )
+		{
+		case 0u: GetFloorCeilingSurface<0u>( cell ); break;
+		case 1u: GetFloorCeilingSurface<1u>( cell ); break;
+		case 2u: GetFloorCeilingSurface<2u>( cell ); break;
+		case 3u: GetFloorCeilingSurface<3u>( cell ); break;
+		};
+	}
+}
+
+void MapDrawerSoft::SetTexture( const unsigned int size_x, const unsigned int size_y, const uint32_t* const data )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		active_tiled_rasterizer_->SetTexture( size_x, size_y, data );
+	else
+		current_rasterizer_->SetTexture( size_x, size_y, data );
+}
+
+void MapDrawerSoft::SetLight( const fixed16_t light )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		active_tiled_rasterizer_->SetLight( light );
+	else
+		current_rasterizer_->SetLight( light );
+}
+
+void MapDrawerSoft::DrawTriangle( const Rasterizer::TriangleDrawFunc func, const RasterizerVertex* const vertices )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		active_tiled_rasterizer_->DrawTriangle( func, vertices );
+	else
+		(current_rasterizer_->*func)( vertices );
+}
+
+void MapDrawerSoft::DrawConvexPolygon(
+	const Rasterizer::ConvexPolygonDrawFunc func,
+	const RasterizerVertex* const vertices,
+	const unsigned int vertex_count,
+	const bool is_anticlockwise )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		active_tiled_rasterizer_->DrawConvexPolygon( func, vertices, vertex_count, is_anticlockwise );
+	else
+		(current_rasterizer_->*func)( vertices, vertex_count, is_anticlockwise );
+}
+
+bool MapDrawerSoft::IsOccluded( const RasterizerVertex* const vertices, const unsigned int vertex_count )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		return false;
+	return current_rasterizer_->IsOccluded( vertices, vertex_count );
+}
+
+void MapDrawerSoft::UpdateOcclusionHierarchy( const RasterizerVertex* const vertices, const unsigned int vertex_count, const bool has_alpha )
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		return;
+	current_rasterizer_->UpdateOcclusionHierarchy( vertices, vertex_count, has_alpha );
+}
+
+void MapDrawerSoft::FlushTiledRasterizer()
+{
+	if( active_tiled_rasterizer_ != nullptr )
+	{
+		// Build all surfaces, requested by recorded commands, before commands drawing.
+		rendering_workers_pool_->ParallelFor(
+			surfaces_build_tasks_.size(),
+			[this]( const unsigned int task_index )
+			{
+				BuildSurface( surfaces_build_tasks_[ task_index ] );
+			} );
+		surfaces_build_tasks_.clear();
+
+		active_tiled_rasterizer_->Flush();
+	}
+}
+
+void MapDrawerSoft::BuildDepthBufferHierarchy()
+{
+	if( active_tiled_rasterizer_ != nullptr )
+		rendering_workers_pool_->ParallelFor(
+			current_rasterizer_->GetDepthBufferHierarchyBandCount(),
+			[this]( const unsigned int band )
+			{
+				current_rasterizer_->BuildDepthBufferHierarchyBand( band, instruction_set_ );
+			} );
+	else
+		current_rasterizer_->BuildDepthBufferHierarchy( instruction_set_ );
+}
+
+void MapDrawerSoft::BuildSurface( const SurfaceBuildTask& task ) const
+{
+	if( task.wall != nullptr )
+	{
+		switch( task.mip )
+		{
+		case 0u: BuildWallSurface<0u>( *task.wall, *task.surface ); break;
+		case 1u: BuildWallSurface<1u>( *task.wall, *task.surface ); break;
+		case 2u: BuildWallSurface<2u>( *task.wall, *task.surface ); break;
+		case 3u: BuildWallSurface<3u>( *task.wall, *task.surface ); break;
+		default: PC_ASSERT(false); break;
+		};
+	}
+	else
+	{
+		PC_ASSERT( task.floor_ceiling_cell != nullptr );
+		switch( task.mip )
+		{
+		case 0u: BuildFloorCeilingSurface<0u>( *task.floor_ceiling_cell, *task.surface ); break;
+		case 1u: BuildFloorCeilingSurface<1u>( *task.floor_ceiling_cell, *task.surface ); break;
+		case 2u: BuildFloorCeilingSurface<2u>( *task.floor_ceiling_cell, *task.surface ); break;
+		case 3u: BuildFloorCeilingSurface<3u>( *task.floor_ceiling_cell, *task.surface ); break;
+		default: PC_ASSERT(false); break;
+		};
+	}
+}
+
+void MapDrawerSoft::CountSurfaceAllocation(
+	const unsigned int kind, const unsigned int mip,
+	const SurfacesCache::Surface& surface,
+	unsigned int& build_frame )
+{
+	PC_ASSERT( kind < SurfacesStats::KindCount );
+	PC_ASSERT( mip < 4u );
+
+	surfaces_stats_.allocated_surfaces[kind][mip]++;
+	surfaces_stats_.built_texels[kind][mip]+= surface.size[0] * surface.size[1];
+	if( build_frame == frame_number_ )
+		surfaces_stats_.rebuilt_surfaces[kind][mip]++;
+	build_frame= frame_number_;
+}
+
 template<unsigned int mip>
 const SurfacesCache::Surface* MapDrawerSoft::GetWallSurface( DrawWall& wall )
 {
@@ -2395,59 +4151,99 @@ const SurfacesCache::Surface* MapDrawerSoft::GetWallSurface( DrawWall& wall )
 	PC_ASSERT( wall.texture_id < MapData::c_max_walls_textures );
 
 	if( wall.mips_surfaces[mip] != nullptr )
+	{
+		surfaces_cache_.MarkSurfaceUsed( *wall.mips_surfaces[mip] );
 		return wall.mips_surfaces[mip];
+	}
 
 	const WallTexture& texture= wall_textures_[wall.texture_id];
 
 	// Do not generate cache pixels for alpha-texels.
 	// TODO - maybe cut surface below full_alpha_row[0] too?
-	const unsigned int y_start= texture.full_alpha_row[0] >> mip;
 	const unsigned int y_end= ( texture.full_alpha_row[1] + ( (1u << mip) - 1u ) ) >> mip;
 
 	const unsigned int surface_height= y_end;
 	const unsigned int surface_width = wall.surface_width >> mip;
-	const unsigned int lightmap_x_shift= ( wall.surface_width == 128u ? 4u : 3u ) - mip;
 
 	surfaces_cache_.AllocateSurface( surface_width, surface_height, &wall.mips_surfaces[mip] );
 	SurfacesCache::Surface* const surface= wall.mips_surfaces[mip];
-	uint32_t* const out_data= surface->GetData();
+	CountSurfaceAllocation( SurfacesStats::Walls, mip, *surface, wall.mips_build_frame[mip] );
 
-	const uint32_t* in_data;
-	if( mip == 0u )
-		in_data= texture.mip0;
-	if( mip == 1u )
-		in_data= texture.mips[0];
-	if( mip == 2u )
-		in_data= texture.mips[1];
-	if( mip == 3u )
-		in_data= texture.mips[2];
+	if( active_tiled_rasterizer_ != nullptr )
+	{
+		// Surface data is needed only at commands flush, so, build it later, in parallel with other surfaces.
+		SurfaceBuildTask task;
+		task.wall= &wall;
+		task.floor_ceiling_cell= nullptr;
+		task.mip= mip;
+		task.surface= surface;
+		surfaces_build_tasks_.push_back( task );
+	}
+	else
+		BuildWallSurface<mip>( wall, *surface );
+
+	return surface;
+}
+
+template<unsigned int mip>
+void MapDrawerSoft::BuildWallSurface( const DrawWall& wall, SurfacesCache::Surface& surface ) const
+{
+	const WallTexture& texture= wall_textures_[wall.texture_id];
+
+	const unsigned int y_start= texture.full_alpha_row[0] >> mip;
+	const unsigned int y_end= ( texture.full_alpha_row[1] + ( (1u << mip) - 1u ) ) >> mip;
+
+	const unsigned int surface_width = wall.surface_width >> mip;
+	const unsigned int lightmap_x_shift= ( wall.surface_width == 128u ? 4u : 3u ) - mip;
+
+	PC_ASSERT( surface.size[0] == surface_width );
+	PC_ASSERT( surface.size[1] == y_end );
+	PC_ASSERT( ( 8u << lightmap_x_shift ) == surface_width );
+
+	uint32_t* const out_data= surface.GetData();
 
 	const unsigned int texture_width= texture.size[0] >> mip;
 	const unsigned int texture_x_wrap_mask= texture_width - 1u;
 
-	fixed16_t lightmap_scaled[8];
+	// Wall light changes only along wall, so, build light row once and use it for all surface rows.
+	int levels[ 8u + 2u ];
 	for( unsigned int i= 0u; i < 8u; i++ )
-		lightmap_scaled[i]= ScaleLightmapLight( wall.lightmap[i] );
+		levels[ i + 1u ]= int( std::min( 255u, static_cast<unsigned int>( wall.lightmap[i] + wall.dynamic_light[i] ) ) << 8u );
+	levels[0]= levels[1];
+	levels[9]= levels[8];
 
-	// TODO - check twice lightmap fetching.
-	for( unsigned int y= y_start; y < y_end; y++ )
-	for( unsigned int x= 0u; x < surface_width ; x++ )
+	uint16_t light_row[ g_max_surface_light_row_size ];
+	BuildLightLevelsRow( levels, 8u, lightmap_x_shift, smooth_lighting_, light_row );
+
+	if( mip == 0u )
 	{
-		const uint32_t texel= in_data[ ( x & texture_x_wrap_mask ) + y * texture_width ];
-		const fixed16_t light= lightmap_scaled[ (x >> lightmap_x_shift) ];
-		unsigned char components[4];
-		for( unsigned int i= 0u; i < 3u; i++ )
-		{
-			const unsigned int c= reinterpret_cast<const unsigned char*>(&texel)[i] * static_cast<unsigned int>(light) >> 16u;
-			components[i]= std::min( c, 255u );
-		}
+		// Indexed texture - just fetch lighted colors from colormap.
+		const unsigned char* const in_data= texture.mip0.data();
 
-		components[3]= reinterpret_cast<const unsigned char*>(&texel)[3];
+		const uint32_t* colormap_rows[ g_max_surface_light_row_size ];
+		for( unsigned int x= 0u; x < surface_width; x++ )
+			colormap_rows[x]= lighting_colormap_.data() + ( light_row[x] >> 8u ) * 256u;
 
-		std::memcpy( &out_data[ x + y * surface_width ], components, sizeof(uint32_t) );
+		for( unsigned int y= y_start; y < y_end; y++ )
+		for( unsigned int x= 0u; x < surface_width ; x++ )
+			out_data[ x + y * surface_width ]=
+				colormap_rows[x][ in_data[ ( x & texture_x_wrap_mask ) + y * texture_width ] ];
+		return;
 	}
 
-	return surface;
+	const uint32_t* const in_data= texture.mips[ mip > 0u ? ( mip - 1u ) : 0u ];
+	const bool use_simd= instruction_set_ == Rasterizer::InstructionSet::SSE2;
+
+	ConvertLightLevelsToLight( light_row, surface_width );
+
+	for( unsigned int y= y_start; y < y_end; y++ )
+	for( unsigned int x= 0u; x < surface_width; x+= texture_width )
+		LightTexelsRow(
+			in_data + y * texture_width,
+			light_row + x,
+			out_data + x + y * surface_width,
+			std::min( texture_width, surface_width - x ),
+			use_simd );
 }
 
 template<unsigned int mip>
@@ -2456,22 +4252,100 @@ const SurfacesCache::Surface* MapDrawerSoft::GetFloorCeilingSurface( FloorCeilin
 	PC_ASSERT( mip < 4u );
 
 	if( cell.mips_surfaces[mip] != nullptr )
+	{
+		surfaces_cache_.MarkSurfaceUsed( *cell.mips_surfaces[mip] );
 		return cell.mips_surfaces[mip];
+	}
 
 	PC_ASSERT( cell.xy[0] < MapData::c_map_size );
 	PC_ASSERT( cell.xy[1] < MapData::c_map_size );
 	PC_ASSERT( cell.texture_id < MapData::c_floors_textures_count );
 
 	const unsigned int texture_size= MapData::c_floor_texture_size >> mip;
-	const unsigned int monolighted_block_size= ( MapData::c_floor_texture_size / MapData::c_lightmap_scale ) >> mip;
 
 	surfaces_cache_.AllocateSurface( texture_size, texture_size, &cell.mips_surfaces[mip] );
 	SurfacesCache::Surface* const surface= cell.mips_surfaces[mip];
-	uint32_t* const out_data= surface->GetData();
+	CountSurfaceAllocation( SurfacesStats::FloorsCeilings, mip, *surface, cell.mips_build_frame[mip] );
+
+	if( active_tiled_rasterizer_ != nullptr )
+	{
+		SurfaceBuildTask task;
+		task.wall= nullptr;
+		task.floor_ceiling_cell= &cell;
+		task.mip= mip;
+		task.surface= surface;
+		surfaces_build_tasks_.push_back( task );
+	}
+	else
+		BuildFloorCeilingSurface<mip>( cell, *surface );
+
+	return surface;
+}
+
+template<unsigned int mip>
+void MapDrawerSoft::BuildFloorCeilingSurface( const FloorCeilingCell& cell, SurfacesCache::Surface& surface ) const
+{
+	static_assert( MapData::c_lightmap_scale == 4u, "Unexpected lightmap scale" );
+	constexpr unsigned int c_levels_size= MapData::c_lightmap_scale + 2u;
+
+	const unsigned int texture_size= MapData::c_floor_texture_size >> mip;
+	const unsigned int monolighted_block_size_log2= MapData::c_floor_texture_size_log2 - 2u - mip;
+
+	uint32_t* const out_data= surface.GetData();
+
+	// Fetch lightmap texels of cell with one texel border around.
+	// Dynamic light of neighbor cells is unknown here, so, take it from texels on border of cell.
+	int levels[ c_levels_size ][ c_levels_size ]; // [x][y]
+	for( unsigned int lightmap_cell_x= 0u; lightmap_cell_x < c_levels_size; lightmap_cell_x++ )
+	for( unsigned int lightmap_cell_y= 0u; lightmap_cell_y < c_levels_size; lightmap_cell_y++ )
+	{
+		const int local_x= int(lightmap_cell_x) - 1;
+		const int local_y= int(lightmap_cell_y) - 1;
+		const int lightmap_global_x= std::max( 0, std::min( int( MapData::c_lightmap_size - 1u ), local_x + int( MapData::c_lightmap_scale * cell.xy[0] ) ) );
+		const int lightmap_global_y= std::max( 0, std::min( int( MapData::c_lightmap_size - 1u ), local_y + int( MapData::c_lightmap_scale * cell.xy[1] ) ) );
+		const int dynamic_x= std::max( 0, std::min( int( MapData::c_lightmap_scale - 1u ), local_x ) );
+		const int dynamic_y= std::max( 0, std::min( int( MapData::c_lightmap_scale - 1u ), local_y ) );
+
+		// TODO - Maybe scale light?
+		const unsigned int lightmap_value=
+			std::min(
+				255u,
+				static_cast<unsigned int>(
+					current_map_data_->lightmap[ lightmap_global_x + lightmap_global_y * int(MapData::c_lightmap_size) ] +
+					cell.dynamic_light[ dynamic_x + dynamic_y * int(MapData::c_lightmap_scale) ] ) );
+		levels[lightmap_cell_x][lightmap_cell_y]= int( lightmap_value << 8u );
+	}
+
+	// Interpolate light along columns once, then interpolate each row between columns.
+	uint16_t columns_light[ c_levels_size ][ MapData::c_floor_texture_size ];
+	for( unsigned int lightmap_cell_x= 0u; lightmap_cell_x < c_levels_size; lightmap_cell_x++ )
+		BuildLightLevelsRow(
+			levels[lightmap_cell_x], MapData::c_lightmap_scale, monolighted_block_size_log2,
+			smooth_lighting_, columns_light[lightmap_cell_x] );
+
+	uint16_t light_row[ g_max_surface_light_row_size ];
+	int row_levels[ c_levels_size ];
 
-	const uint32_t* in_data;
 	if( mip == 0u )
-		in_data= floor_textures_[cell.texture_id].data;
+	{
+		// Indexed texture - just fetch lighted colors from colormap.
+		const unsigned char* const in_data= floor_textures_[cell.texture_id].mip0;
+
+		for( unsigned int y= 0u; y < texture_size; y++ )
+		{
+			for( unsigned int i= 0u; i < c_levels_size; i++ )
+				row_levels[i]= columns_light[i][y];
+			BuildLightLevelsRow( row_levels, MapData::c_lightmap_scale, monolighted_block_size_log2, smooth_lighting_, light_row );
+
+			const unsigned char* const in_row= in_data + y * texture_size;
+			uint32_t* const out_row= out_data + y * texture_size;
+			for( unsigned int x= 0u; x < texture_size; x++ )
+				out_row[x]= lighting_colormap_[ ( light_row[x] >> 8u ) * 256u + in_row[x] ];
+		}
+		return;
+	}
+
+	const uint32_t* in_data;
 	if( mip == 1u )
 		in_data= floor_textures_[cell.texture_id].mip1;
 	if( mip == 2u )
@@ -2479,35 +4353,22 @@ const SurfacesCache::Surface* MapDrawerSoft::GetFloorCeilingSurface( FloorCeilin
 	if( mip == 3u )
 		in_data= floor_textures_[cell.texture_id].mip3;
 
-	for( unsigned int lightmap_cell_y= 0u; lightmap_cell_y < MapData::c_lightmap_scale; lightmap_cell_y++ )
-	for( unsigned int lightmap_cell_x= 0u; lightmap_cell_x < MapData::c_lightmap_scale; lightmap_cell_x++ )
-	{
-		const unsigned int lightmap_global_x= lightmap_cell_x + MapData::c_lightmap_scale * cell.xy[0];
-		const unsigned int lightmap_global_y= lightmap_cell_y + MapData::c_lightmap_scale * cell.xy[1];
-
-		// TODO - Maybe scale light?
-		const unsigned char lightmap_value= current_map_data_->lightmap[ lightmap_global_x + lightmap_global_y * MapData::c_lightmap_size ];
-		const fixed16_t light= ScaleLightmapLight( lightmap_value );
-
-		for( unsigned int texel_y= 0u; texel_y < monolighted_block_size; texel_y++ )
-		for( unsigned int texel_x= 0u; texel_x < monolighted_block_size; texel_x++ )
-		{
-			const unsigned int texture_x= texel_x + lightmap_cell_x * monolighted_block_size;
-			const unsigned int texture_y= texel_y + lightmap_cell_y * monolighted_block_size;
-			const unsigned int texel_address= texture_x + texture_y * texture_size;
-			const uint32_t texel= in_data[ texel_address ];
-			unsigned char components[4];
-			for( unsigned int i= 0u; i < 3u; i++ )
-			{
-				const unsigned int c= reinterpret_cast<const unsigned char*>(&texel)[i] * static_cast<unsigned int>(light) >> 16u;
-				components[i]= std::min( c, 255u );
-			}
-
-			std::memcpy( &out_data[ texel_address ], components, sizeof(uint32_t) );
-		}
-	} // for lightmap cells
+	const bool use_simd= instruction_set_ == Rasterizer::InstructionSet::SSE2;
 
-	return surface;
+	for( unsigned int y= 0u; y < texture_size; y++ )
+	{
+		for( unsigned int i= 0u; i < c_levels_size; i++ )
+			row_levels[i]= columns_light[i][y];
+		BuildLightLevelsRow( row_levels, MapData::c_lightmap_scale, monolighted_block_size_log2, smooth_lighting_, light_row );
+		ConvertLightLevelsToLight( light_row, texture_size );
+
+		LightTexelsRow(
+			in_data + y * texture_size,
+			light_row,
+			out_data + y * texture_size,
+			texture_size,
+			use_simd );
+	}
 }
 
 } // PanzerChasm
@@ -1,12 +1,19 @@
 #pragma once
+#include <array>
+#include <unordered_map>
 
 #include "../map_loader.hpp"
 #include "../model.hpp"
 #include "../rendering_context.hpp"
+#include "../settings.hpp"
+#include "../time.hpp"
 #include "fwd.hpp"
 #include "i_map_drawer.hpp"
+#include "map_drawers_common.hpp"
+#include "software_renderer/map_pvs.hpp"
 #include "software_renderer/rasterizer.hpp"
 #include "software_renderer/surfaces_cache.hpp"
+#include "software_renderer/tiled_rasterizer.hpp"
 
 namespace PanzerChasm
 {
@@ -49,26 +56,36 @@ public:
 		const m_Vec3& camera_position,
 		const ViewClipPlanes& view_clip_planes ) override;
 
+	virtual void GetFrameStats( std::vector<std::string>& out_lines ) const override;
+
 private:
+	// Maximum mips count (including mip0) of models, sprites and sky textures. Mip "i" has size "size >> i".
+	static constexpr unsigned int c_max_textures_mips= 4u;
+
 	struct ModelsGroup
 	{
 		struct ModelEntry
 		{
 			unsigned int texture_size[2];
-			unsigned int texture_data_offset; // in pixels
+			unsigned int mip_count;
+			unsigned int mips_data_offsets[ c_max_textures_mips ]; // in pixels
 		};
 
 		std::vector<ModelEntry> models;
 
-		// TODO - add mips support
 		std::vector<uint32_t> textures_data;
 	};
 
+	typedef std::shared_ptr<const ModelsGroup> ModelsGroupConstPtr;
+
 	struct FloorCeilingCell
 	{
 		unsigned char xy[2];
 		unsigned char texture_id;
+		// Light of dynamic light sources, added to lightmap in surface building.
+		unsigned char dynamic_light[ MapData::c_lightmap_scale * MapData::c_lightmap_scale ];
 		SurfacesCache::Surface* mips_surfaces[4];
+		unsigned int mips_build_frame[4];
 	};
 
 	struct DrawWall
@@ -76,14 +93,16 @@ private:
 		unsigned int surface_width; // In pixels. must be 64 or 128
 		unsigned char texture_id;
 		unsigned char lightmap[8];
+		unsigned char dynamic_light[8]; // Added to lightmap in surface building.
 
 		SurfacesCache::Surface* mips_surfaces[4];
+		unsigned int mips_build_frame[4];
 	};
 
 	struct FloorTexture
 	{
-		// TODO - do not store mip0 32bit texture.
-		uint32_t data[ MapData::c_floor_texture_size * MapData::c_floor_texture_size ];
+		// Palette indices. Converted to color via lighting colormap.
+		unsigned char mip0[ MapData::c_floor_texture_size * MapData::c_floor_texture_size ];
 		uint32_t mip1[ MapData::c_floor_texture_size * MapData::c_floor_texture_size /  4u ];
 		uint32_t mip2[ MapData::c_floor_texture_size * MapData::c_floor_texture_size / 16u ];
 		uint32_t mip3[ MapData::c_floor_texture_size * MapData::c_floor_texture_size / 64u ];
@@ -92,13 +111,14 @@ private:
 	struct WallTexture
 	{
 		unsigned int size[2];
+		unsigned int content_hash= 0u; // Hash of source file. Zero for missing textures.
 
 		unsigned char full_alpha_row[2];
 		bool has_alpha; // Except low and bottom rejected rows.
 
-		// TODO - do not store mip0 32bit texture.
+		// Palette indices. Converted to color via lighting colormap.
+		std::vector<unsigned char> mip0;
 		std::vector<uint32_t> data;
-		uint32_t* mip0;
 		uint32_t* mips[3]; // 1, 2, 3
 	};
 
@@ -106,8 +126,9 @@ private:
 	{
 		char file_name[32];
 		unsigned int size[2];
+		unsigned int mip_count;
+		unsigned int mips_data_offsets[ c_max_textures_mips ]; // in pixels
 
-		// TODO - add mips support.
 		// TODO - do not store mip0 32bit texture.
 		std::vector<uint32_t> data;
 	};
@@ -116,29 +137,172 @@ private:
 	{
 		unsigned int size[3]; // Contains several frames
 
-		// TODO - add mips support.
+		// Converted on first use, may be released, if sprites cache is over budget.
+		// Use GetSpriteTexture to access data.
+		// Frames of each mip are placed together, offsets are offsets of first frame of mip.
 		// TODO - do not store mip0 32bit texture.
 		std::vector<uint32_t> data;
+		unsigned int mip_count= 0u;
+		unsigned int mips_data_offsets[ c_max_textures_mips ]; // in pixels
+
+		const ObjSprite* source= nullptr;
+		unsigned int last_used_frame= 0u;
 	};
 
+	// World may be drawn with reduced resolution, for holding of target frame rate.
+	// Reduced frame is drawn into own buffer and upscaled into viewport.
+	struct DynamicResolution
+	{
+		bool enabled= false;
+		float target_draw_time_s= 0.0f;
+
+		unsigned int scale= c_dynamic_resolution_scale_denominator; // Numerator of resolution scale.
+		unsigned int change_cooldown_frames= 0u;
+		float average_draw_time_s= -1.0f;
+
+		// Buffers of reduced resolution. Exist only if scale is less, than 1.
+		Size2 size;
+		std::vector<uint32_t> color_buffer;
+		std::unique_ptr<Rasterizer> rasterizer;
+		std::unique_ptr<TiledRasterizer> tiled_rasterizer;
+		std::vector<unsigned int> upscale_src_x; // Source x for each x of viewport.
+	};
+
+	static constexpr unsigned int c_dynamic_resolution_scale_denominator= 8u;
+
 	struct TextureView
 	{
 		unsigned int size[2];
-		const uint32_t* data;
+		unsigned int mip_count;
+		const uint32_t* mips[ c_max_textures_mips ];
 	};
 
 	struct PlayerTexture
 	{
 		unsigned int size[2];
+		unsigned int mip_count;
+		unsigned int mips_data_offsets[ c_max_textures_mips ]; // in pixels
 		std::vector<uint32_t> data;
 	};
 
+	// Surface, allocated in cache, but not yet filled.
+	// Exactly one of "wall" and "floor_ceiling_cell" is not null.
+	struct SurfaceBuildTask
+	{
+		const DrawWall* wall;
+		const FloorCeilingCell* floor_ceiling_cell;
+		unsigned int mip;
+		SurfacesCache::Surface* surface;
+	};
+
+	// Vertices of sprite polygon in world space.
+	typedef std::array<m_Vec3, 4u> SpriteQuad;
+
+	// Model, collected for drawing in current frame.
+	struct ModelDrawRequest
+	{
+		const ModelsGroup* models_group;
+		const std::vector<Model>* model_group_models;
+		unsigned int model_id;
+		unsigned int animation_frame;
+		m_Vec3 position;
+		m_Mat4 rotation_matrix;
+		unsigned char visible_groups_mask;
+		bool force_transparent_nontransparent_polygons;
+		bool fullbright;
+		unsigned int submodel_id;
+		unsigned char color;
+		bool occluded;
+		float depth; // Distance from camera plane. Calculated only for models in transparent pass.
+	};
+
+	// Projected to screen vertex of model.
+	struct ProjectedModelVertex
+	{
+		fixed16_t x, y, z;
+	};
+
+	struct ModelVerticesCacheKey
+	{
+		const Submodel* model;
+		unsigned int animation_frame;
+		m_Mat4 matrix;
+
+		bool operator==( const ModelVerticesCacheKey& other ) const;
+	};
+
+	struct ModelVerticesCacheKeyHasher
+	{
+		size_t operator()( const ModelVerticesCacheKey& key ) const;
+	};
+
+	// Shadow triangles of model, projected to floor, in model space.
+	struct ModelShadow
+	{
+		// Shadow source parameters.
+		const Submodel* model= nullptr;
+		unsigned int animation_frame= 0u;
+		unsigned char visible_groups_mask= 0u;
+		m_Vec3 light_pos_model_space;
+
+		m_BBox2 bbox_projected;
+		std::vector<m_Vec3> triangles_vertices;
+	};
+
+	// Per-frame counters of surfaces building.
+	struct SurfacesStats
+	{
+		enum : unsigned int { Walls= 0u, FloorsCeilings= 1u, KindCount= 2u };
+
+		unsigned int allocated_surfaces[KindCount][4]; // [ kind ][ mip ]
+		unsigned int built_texels[KindCount][4];
+		// Surfaces, built more, than one time in frame, because cache is too small.
+		unsigned int rebuilt_surfaces[KindCount][4];
+	};
+
+	// Point light of map state light source or light flash, converted to lightmap scale.
+	struct DynamicLight
+	{
+		m_Vec2 pos;
+		float inner_radius; // Light is constant inside.
+		float outer_radius; // Light fades to zero at this radius.
+		unsigned int level; // Light, added to lightmap inside inner radius.
+
+		bool operator==( const DynamicLight& other ) const
+		{
+			return pos == other.pos && inner_radius == other.inner_radius && outer_radius == other.outer_radius && level == other.level;
+		}
+	};
+
+	// Rasterizer functions, selected for current instruction set.
+	struct RasterizerKernels
+	{
+		Rasterizer::TriangleDrawFunc weapon[2][2]; // [ invisible ][ alpha test ]
+		Rasterizer::TriangleDrawFunc item_icon[2][2]; // [ transparent ][ alpha test ]
+		Rasterizer::TriangleDrawFunc models[2][2]; // [ transparent ][ alpha test ]
+		Rasterizer::ConvexPolygonDrawFunc static_walls[2]; // [ alpha test ]
+		Rasterizer::ConvexPolygonDrawFunc dynamic_walls[2]; // [ alpha test ]
+		Rasterizer::ConvexPolygonDrawFunc sky;
+		Rasterizer::ConvexPolygonDrawFunc effects_sprites[2]; // [ lighting ]
+		Rasterizer::ConvexPolygonDrawFunc bmp_objects_sprites;
+	};
+
 private:
-	void LoadModelsGroup( const std::vector<Model>& models, ModelsGroup& out_group );
+	void SelectRasterizerKernels( Rasterizer::InstructionSet instruction_set );
+
+	void BuildLightingColormap();
+	// Models groups are shared between all software drawers in process.
+	void LoadModelsGroup( const std::shared_ptr<const void>& models_owner, const std::vector<Model>& models, ModelsGroupConstPtr& out_group );
+	void ConvertModelsGroup( const std::vector<Model>& models, ModelsGroup& out_group ) const;
 	void LoadWallsTextures( const MapData& map_data );
 	void LoadFloorsTextures( const MapData& map_data );
 	void LoadWalls( const MapData& map_data );
 	void LoadFloorsAndCeilings( const MapData& map_data );
+	void BuildMapPVS( const MapDataConstPtr& map_data );
+
+	// Collect dynamic lights of frame and free surfaces of walls and floors, where light of these lights changed.
+	void UpdateDynamicLights( const MapState& map_state );
+	unsigned char GetDynamicLight( const m_Vec2& pos ) const;
 	TextureView GetPlayerTexture( unsigned char color );
 
 	template< bool is_dynamic_wall >
@@ -150,6 +314,9 @@ private:
 		const m_Vec2& camera_position_xy,
 		const ViewClipPlanes& view_clip_planes );
 
+	// Returns true, if PVS is not active.
+	bool IsAreaPotentiallyVisible( const m_Vec2& area_min, const m_Vec2& area_max ) const;
+
 	void DrawWalls( const MapState& map_state, const m_Mat4& matrix, const m_Vec2& camera_position_xy, const ViewClipPlanes& view_clip_planes );
 	void DrawFloorsAndCeilings( const m_Mat4& matrix, const ViewClipPlanes& view_clip_planes  );
 
@@ -170,6 +337,26 @@ private:
 		unsigned int submodel_id= ~0u,  /* Submodel of model to draw. ~0 means base model. */
 		unsigned char color= 0u /* For players only. */ );
 
+	void AddModelDrawRequest(
+		const ModelsGroup& models_group,
+		const std::vector<Model>& model_group_models,
+		unsigned int model_id,
+		unsigned int animation_frame,
+		const m_Vec3& position,
+		const m_Mat4& rotation_matrix,
+		unsigned char visible_groups_mask,
+		bool force_transparent_nontransparent_polygons= false,
+		bool fullbright= false,
+		unsigned int submodel_id= ~0u,
+		unsigned char color= 0u );
+
+	// Returns projected vertices of model animation frame. Result is cached until end of frame.
+	// Model must be fully inside near plane and guard band.
+	const ProjectedModelVertex* GetProjectedModelVertices( const Submodel& model, unsigned int animation_frame, const m_Mat4& matrix );
+
+	// Test all collected models against depth hierarchy in one batch.
+	void CheckModelsDepthOcclusion( const m_Mat4& view_matrix );
+
 	void DrawModelShadow(
 		const Model& base_model,
 		unsigned int animation_frame,
@@ -180,13 +367,35 @@ private:
 		const m_Vec3& camera_position,
 		const m_Vec3& light_pos,
 		unsigned char visible_groups_mask,
-		unsigned int submodel_id= ~0u  /* Submodel of model to draw. ~0 means base model. */ );
+		unsigned int submodel_id= ~0u  /* Submodel of model to draw. ~0 means base model. */,
+		ModelShadow* shadow_cache= nullptr /* If not null, shadow geometry is reused, while it is actual. */ );
+
+	void BuildModelShadow(
+		const Submodel& model,
+		unsigned int animation_frame,
+		const m_Vec3& light_pos_model_space,
+		unsigned char visible_groups_mask,
+		ModelShadow& out_shadow );
 
 	void DrawSky(
 		const m_Mat4& matrix,
 		const m_Vec3& sky_pos,
 		const ViewClipPlanes& view_clip_planes );
 
+	// Test quads of sprites in "sprites_quads_" against view and depth hierarchy in one batch.
+	// Set bits in "sprites_skip_mask_" for sprites outside view or occluded by world.
+	void CullSprites( const m_Mat4& view_matrix, const ViewClipPlanes& view_clip_planes );
+	bool IsSpriteSkipped( unsigned int sprite_index ) const;
+	void SkipSprite( unsigned int sprite_index );
+	// Clip sprite quad by view, project and draw. Returns false, if sprite is outside view.
+	bool ClipAndProjectSprite(
+		const SpriteQuad& quad,
+		const SpriteTexture& sprite_texture,
+		const ViewClipPlanes& view_clip_planes,
+		const m_Mat4& view_matrix,
+		RasterizerVertex* out_vertices,
+		unsigned int& out_vertex_count );
+
 	void DrawEffectsSprites(
 		const MapState& map_state,
 		const m_Mat4& view_matrix,
@@ -199,11 +408,44 @@ private:
 		const m_Vec3& camera_position,
 		const ViewClipPlanes& view_clip_planes );
 
+	// Select drawing target for world, based on current dynamic resolution scale.
+	void BeginDynamicResolutionFrame();
+	// Upscale world into viewport, update dynamic resolution scale.
+	void EndDynamicResolutionFrame( const Time& draw_start_time );
+	void UpscaleDynamicResolutionFrame();
+
+	// Converts sprite, if it is not converted yet.
+	const SpriteTexture& GetSpriteTexture( SpriteTexture& sprite_texture );
+	// Selects mip for sprite polygon and sets texture of given frame of this mip.
+	void SetSpriteTextureFrame(
+		const SpriteTexture& sprite_texture,
+		unsigned int frame,
+		RasterizerVertex* vertices, unsigned int vertex_count );
+	void ReleaseUnusedSpritesTextures();
+
+	void SetupGuardBandClipPlanes( const m_Mat4& matrix, const ViewClipPlanes& view_clip_planes );
+
 	// Returns new vertex count.
 	// clipped_vertices_ used
 	unsigned int ClipPolygon(
 		const m_Plane3& clip_plane,
 		unsigned int vertex_count );
+	// Discard polygon outside view, clip it by near plane and by guard band.
+	unsigned int ClipPolygonByView(
+		const ViewClipPlanes& view_clip_planes,
+		unsigned int vertex_count );
+
+	// Rasterizer commands wrappers. Commands go into tiled rasterizer, if it is active.
+	void SetTexture( unsigned int size_x, unsigned int size_y, const uint32_t* data );
+	void SetLight( fixed16_t light );
+	void DrawTriangle( Rasterizer::TriangleDrawFunc func, const RasterizerVertex* vertices );
+	void DrawConvexPolygon( Rasterizer::ConvexPolygonDrawFunc func, const RasterizerVertex* vertices, unsigned int vertex_count, bool is_anticlockwise );
+	// Builds hierarchy in rendering threads, if tiled rasterizer is active.
+	void BuildDepthBufferHierarchy();
+	// Occlusion hierarchy is not actual, while tiled rasterizer commands are not flushed, so, check is conservative in this case.
+	bool IsOccluded( const RasterizerVertex* vertices, unsigned int vertex_count );
+	void UpdateOcclusionHierarchy( const RasterizerVertex* vertices, unsigned int vertex_count, bool has_alpha );
+	void FlushTiledRasterizer();
 
 	template<unsigned int mip>
 	const SurfacesCache::Surface* GetWallSurface( DrawWall& wall );
@@ -211,6 +453,19 @@ private:
 	template<unsigned int mip>
 	const SurfacesCache::Surface* GetFloorCeilingSurface( FloorCeilingCell& cell );
 
+	// Build surfaces for walls and floors near camera position, predicted from camera velocity.
+	void PrefetchSurfaces( const m_Vec3& camera_position, const m_Mat4& view_rotation_and_projection_matrix );
+
+	template<unsigned int mip>
+	void BuildWallSurface( const DrawWall& wall, SurfacesCache::Surface& surface ) const;
+
+	template<unsigned int mip>
+	void BuildFloorCeilingSurface( const FloorCeilingCell& cell, SurfacesCache::Surface& surface ) const;
+
+	void BuildSurface( const SurfaceBuildTask& task ) const;
+
+	void CountSurfaceAllocation( unsigned int kind, unsigned int mip, const SurfacesCache::Surface& surface, unsigned int& build_frame );
+
 private:
 	struct ClippedVertex
 	{
@@ -221,23 +476,89 @@ private:
 
 private:
 	Settings& settings_;
+	// Settings, which are read each frame.
+	const Settings::BoolHandle pvs_setting_; // Off by default, because PVS is approximate.
+	const Settings::BoolHandle shadows_setting_;
+	const Settings::BoolHandle surfaces_prefetch_setting_;
+	const Settings::BoolHandle dynamic_lights_setting_;
+	const Settings::BoolHandle debug_draw_depth_hierarchy_setting_;
+	const Settings::BoolHandle debug_draw_occlusion_buffer_setting_;
+
 	const GameResourcesConstPtr game_resources_;
 	const RenderingContextSoft rendering_context_;
-	const float screen_transform_x_;
-	const float screen_transform_y_;
+	// Transformation for current drawing target - viewport or dynamic resolution buffer.
+	float screen_transform_x_;
+	float screen_transform_y_;
 
+	// Rasterizer of viewport.
 	Rasterizer rasterizer_;
+	// Rasterizer of current drawing target.
+	Rasterizer* current_rasterizer_;
+	RasterizerKernels kernels_;
+	Rasterizer::InstructionSet instruction_set_= Rasterizer::InstructionSet::Scalar;
+	// Interpolate lightmap between texels in surfaces building.
+	bool smooth_lighting_= false;
 	SurfacesCache surfaces_cache_;
 
+	unsigned int rendering_threads_count_= 1u;
+	// Exist only if rendering threads count > 1. Pool is shared between all tiled rasterizers and surfaces building.
+	std::unique_ptr<WorkersPool> rendering_workers_pool_;
+	std::unique_ptr<TiledRasterizer> tiled_rasterizer_;
+	// Not null while drawing world.
+	TiledRasterizer* active_tiled_rasterizer_= nullptr;
+	// Surfaces, which must be built before next tiled rasterizer flush.
+	std::vector<SurfaceBuildTask> surfaces_build_tasks_;
+
+	unsigned int frame_number_= 0u;
+	SurfacesStats surfaces_stats_;
+
+	// Dynamic lights of current and previous frames. Lights, which differ between frames, are "changed".
+	std::vector<DynamicLight> dynamic_lights_;
+	std::vector<DynamicLight> prev_dynamic_lights_;
+	std::vector<DynamicLight> changed_dynamic_lights_;
+	unsigned int dynamic_lights_freed_surfaces_= 0u; // In current frame.
+
+	DynamicResolution dynamic_resolution_;
+
+	// Models of current frame. Collected once for both opaque and transparent passes.
+	std::vector<ModelDrawRequest> models_draw_requests_;
+	std::vector<unsigned int> transparent_models_draw_order_; // Indeces of requests, sorted back to front.
+	std::vector<Rasterizer::DepthOcclusionQuery> models_depth_queries_;
+	std::vector<unsigned int> models_depth_queries_requests_; // Request index for each query.
+	std::vector<uint32_t> models_occluded_mask_;
+	unsigned int models_occluded_count_= 0u;
+
+	// Projected vertices of models, shared between drawing passes of same model instance.
+	// Key contains full matrix with translation, so, different instances of same model never share vertices.
+	std::unordered_map< ModelVerticesCacheKey, unsigned int, ModelVerticesCacheKeyHasher > model_vertices_cache_;
+	std::vector<ProjectedModelVertex> projected_model_vertices_;
+
+	// Shadows of map static models, indexed as static models. Most static models never move, so, shadows are rebuilt rarely.
+	std::vector<ModelShadow> static_models_shadows_;
+	ModelShadow temp_model_shadow_;
+	unsigned int shadows_built_in_frame_= 0u;
+
+	// Previous frame camera, for surfaces prefetch.
+	m_Vec3 prev_camera_position_;
+	Time prev_frame_time_= Time::FromSeconds(0);
+	bool prev_frame_camera_valid_= false;
+
 	MapDataConstPtr current_map_data_;
+	StaticLightsGrid static_lights_grid_;
 	std::unique_ptr<MapBSPTree> map_bsp_tree_;
+	std::unique_ptr<MapPVS> map_pvs_;
+	// Near plane and planes of rasterizer guard band borders.
+	ViewClipPlanes guard_band_clip_planes_;
+
+	// Visibility of camera cell. Not null only inside Draw, if PVS is enabled.
+	const MapPVS::CellVisibility* view_cell_visibility_= nullptr;
 
-	ModelsGroup map_models_;
-	ModelsGroup items_models_;
-	ModelsGroup rockets_models_;
-	ModelsGroup gibs_models_;
-	ModelsGroup weapons_models_;
-	ModelsGroup monsters_models_;
+	ModelsGroupConstPtr map_models_;
+	ModelsGroupConstPtr items_models_;
+	ModelsGroupConstPtr rockets_models_;
+	ModelsGroupConstPtr gibs_models_;
+	ModelsGroupConstPtr weapons_models_;
+	ModelsGroupConstPtr monsters_models_;
 
 	std::vector<DrawWall> static_walls_;
 	std::vector<DrawWall> dynamic_walls_;
@@ -248,12 +569,21 @@ private:
 
 	std::vector<SpriteTexture> sprite_effects_textures_;
 	std::vector<SpriteTexture> bmp_objects_sprites_;
+	size_t sprites_textures_data_size_= 0u; // Size of all converted sprites.
 	SkyTexture sky_texture_;
 
 	std::vector<PlayerTexture> player_textures_;
 
 	// Reuse vector (do not create new vector each frame).
 	std::vector<const MapState::SpriteEffect*> sorted_sprites_;
+	EffectsSpritesSortBuffer sprites_sort_buffer_;
+
+	// Quads of sprites, turned to camera, indexed as sprite effects or as static models. Built before culling.
+	std::vector<SpriteQuad> sprites_quads_;
+	std::vector<uint32_t> sprites_skip_mask_;
+	std::vector<Rasterizer::DepthOcclusionQuery> sprites_depth_queries_;
+	std::vector<unsigned int> sprites_depth_queries_sprites_; // Sprite index for each query.
+	std::vector<uint32_t> sprites_occluded_mask_;
 
 	// Put large arrays at back.
 
@@ -264,6 +594,11 @@ private:
 	ClippedVertex* fisrt_clipped_vertex_= nullptr;
 	unsigned int next_new_clipped_vertex_= 0u;
 
+	// Palette colors, scaled by each lightmap value - like colormaps of original game.
+	// Row for one light level is 1kb, so, surfaces building with indexed mip0 reads not much memory.
+	// [ lightmap value ][ palette index ]
+	std::vector<uint32_t> lighting_colormap_;
+
 	WallTexture wall_textures_[ MapData::c_max_walls_textures ];
 
 	FloorTexture floor_textures_[ MapData::c_floors_textures_count ];
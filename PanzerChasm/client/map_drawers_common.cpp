@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "../map_loader.hpp"
 #include "../math_utils.hpp"
@@ -8,25 +10,66 @@
 namespace PanzerChasm
 {
 
+static constexpr float g_max_distance_to_light_source= 2.5f;
+
 void SortEffectsSprites(
 	const MapState::SpriteEffects& effects_sprites,
 	const m_Vec3& camera_position,
-	std::vector<const MapState::SpriteEffect*>& out_sorted_sprites )
+	EffectsSpritesSortBuffer& sort_buffer,
+	std::vector<const MapState::SpriteEffect*>& out_sorted_sprites,
+	const uint32_t* const skip_mask )
 {
-	// Sort from far to near
-	out_sorted_sprites.resize( effects_sprites.size() );
+	std::vector<uint64_t>& keys= sort_buffer.keys[0];
+	std::vector<uint64_t>& keys_temp= sort_buffer.keys[1];
+	keys.clear();
+
+	// Bits of non-negative float have same order, as float values.
+	// Invert bits, because we need sort from far to near.
+	static_assert( sizeof(float) == sizeof(uint32_t), "Unexpected float size" );
 	for( unsigned int i= 0u; i < effects_sprites.size(); i++ )
-		out_sorted_sprites[i]= & effects_sprites[i];
+	{
+		if( skip_mask != nullptr && ( skip_mask[ i >> 5u ] & ( 1u << ( i & 31u ) ) ) != 0u )
+			continue;
+
+		const float square_distance= ( camera_position - effects_sprites[i].pos ).SquareLength();
+		uint32_t distance_bits;
+		std::memcpy( &distance_bits, &square_distance, sizeof(uint32_t) );
+		keys.push_back( ( uint64_t( ~distance_bits ) << 32u ) | uint64_t(i) );
+	}
+	keys_temp.resize( keys.size() );
+
+	// LSD radix sort by bytes of distance. It is stable and has linear complexity.
+	constexpr unsigned int c_digits= 4u;
+	constexpr unsigned int c_digit_values= 256u;
+	unsigned int counts[ c_digits ][ c_digit_values ];
+	std::memset( counts, 0, sizeof(counts) );
+	for( const uint64_t key : keys )
+	for( unsigned int d= 0u; d < c_digits; d++ )
+		counts[d][ ( key >> ( 32u + d * 8u ) ) & ( c_digit_values - 1u ) ]++;
+
+	for( unsigned int d= 0u; d < c_digits; d++ )
+	{
+		// Skip digit, if it is same for all keys. High digit is usually same for all sprites.
+		if( !keys.empty() && counts[d][ ( keys.front() >> ( 32u + d * 8u ) ) & ( c_digit_values - 1u ) ] == keys.size() )
+			continue;
 
-	std::sort(
-		out_sorted_sprites.begin(),
-		out_sorted_sprites.end(),
-		[&]( const MapState::SpriteEffect* const a, const MapState::SpriteEffect* const b )
+		unsigned int offsets[ c_digit_values ];
+		unsigned int offset= 0u;
+		for( unsigned int v= 0u; v < c_digit_values; v++ )
 		{
-			const m_Vec3 dir_a= camera_position - a->pos;
-			const m_Vec3 dir_b= camera_position - b->pos;
-			return dir_a.SquareLength() > dir_b.SquareLength();
-		});
+			offsets[v]= offset;
+			offset+= counts[d][v];
+		}
+
+		for( const uint64_t key : keys )
+			keys_temp[ offsets[ ( key >> ( 32u + d * 8u ) ) & ( c_digit_values - 1u ) ]++ ]= key;
+
+		keys.swap( keys_temp );
+	}
+
+	out_sorted_sprites.resize( keys.size() );
+	for( unsigned int i= 0u; i < keys.size(); i++ )
+		out_sorted_sprites[i]= &effects_sprites[ static_cast<unsigned int>( keys[i] & 0xFFFFFFFFu ) ];
 }
 
 bool BBoxIsOutsideView(
@@ -61,15 +104,72 @@ bool BBoxIsOutsideView(
 	return false;
 }
 
+bool ModelIsOutsideView(
+	const ViewClipPlanes& clip_planes,
+	const BoundingSphere& sphere,
+	const m_BBox3& bbox,
+	const m_Mat4& model_mat )
+{
+	const int sphere_test_result= SphereViewTest( clip_planes, sphere.center * model_mat, sphere.radius );
+	if( sphere_test_result != 0 )
+		return sphere_test_result < 0;
+
+	return BBoxIsOutsideView( clip_planes, bbox, model_mat );
+}
+
 unsigned int GetModelBMPSpritePhase( const MapState::StaticModel& model )
 {
 	// Generate pseudo-random animation phase for sprite, because synchronous animation of nearby sprites looks ugly.
 	return static_cast<unsigned int>( model.pos.x * 13.0f + model.pos.y * 19.0f + model.angle * 29.0f );
 }
 
+void StaticLightsGrid::Build( const MapData& map_data )
+{
+	const unsigned int c_size= MapData::c_map_size;
+	const float c_square_max_distance= g_max_distance_to_light_source * g_max_distance_to_light_source;
+
+	cells_lights_offsets_.clear();
+	cells_lights_offsets_.reserve( c_size * c_size + 1u );
+	cells_lights_.clear();
+
+	for( unsigned int y= 0u; y < c_size; y++ )
+	for( unsigned int x= 0u; x < c_size; x++ )
+	{
+		cells_lights_offsets_.push_back( cells_lights_.size() );
+
+		// Border cells are extended to infinity, because positions outside map are clamped to border cells.
+		const float cell_min_x= x == 0u          ? -Constants::max_float : float(x);
+		const float cell_max_x= x == c_size - 1u ? +Constants::max_float : float(x + 1u);
+		const float cell_min_y= y == 0u          ? -Constants::max_float : float(y);
+		const float cell_max_y= y == c_size - 1u ? +Constants::max_float : float(y + 1u);
+
+		// Take lights, which are close enough to any point of cell.
+		// Keep lights order, so, result of search is same as result of search in all lights.
+		for( unsigned int l= 0u; l < map_data.lights.size(); l++ )
+		{
+			const m_Vec2& light_pos= map_data.lights[l].pos;
+			const float dx= std::max( 0.0f, std::max( cell_min_x - light_pos.x, light_pos.x - cell_max_x ) );
+			const float dy= std::max( 0.0f, std::max( cell_min_y - light_pos.y, light_pos.y - cell_max_y ) );
+			if( dx * dx + dy * dy < c_square_max_distance )
+				cells_lights_.push_back( l );
+		}
+	}
+
+	cells_lights_offsets_.push_back( cells_lights_.size() );
+}
+
+unsigned int StaticLightsGrid::GetCellIndex( const m_Vec2& pos )
+{
+	const int c_max= int(MapData::c_map_size) - 1;
+	const int x= std::max( 0, std::min( int( std::floor( std::max( -1.0f, std::min( pos.x, float(MapData::c_map_size) ) ) ) ), c_max ) );
+	const int y= std::max( 0, std::min( int( std::floor( std::max( -1.0f, std::min( pos.y, float(MapData::c_map_size) ) ) ) ), c_max ) );
+	return static_cast<unsigned int>( x + y * int(MapData::c_map_size) );
+}
+
 bool GetNearestLightSourcePos(
 	const m_Vec3& pos,
 	const MapData& map_data,
+	const StaticLightsGrid& static_lights_grid,
 	const MapState& map_state,
 	const bool use_dynamic_lights,
 	m_Vec3& out_light_pos )
@@ -77,16 +177,19 @@ bool GetNearestLightSourcePos(
 	float nearest_source_square_distance= Constants::max_float;
 	m_Vec3 nearest_source( 0.0f, 0.0f, 0.0f );
 
-	for( const MapData::Light& light : map_data.lights )
-	{
-		const float square_distance= ( light.pos - pos.xy() ).SquareLength();
-		if( square_distance < nearest_source_square_distance )
+	static_lights_grid.ForEachCellLight(
+		pos.xy(),
+		[&]( const unsigned int light_index )
 		{
-			nearest_source.x= light.pos.x;
-			nearest_source.y= light.pos.y;
-			nearest_source_square_distance= square_distance;
-		}
-	}
+			const MapData::Light& light= map_data.lights[ light_index ];
+			const float square_distance= ( light.pos - pos.xy() ).SquareLength();
+			if( square_distance < nearest_source_square_distance )
+			{
+				nearest_source.x= light.pos.x;
+				nearest_source.y= light.pos.y;
+				nearest_source_square_distance= square_distance;
+			}
+		} );
 
 	if( use_dynamic_lights )
 	{
@@ -115,8 +218,7 @@ bool GetNearestLightSourcePos(
 		}
 	}
 
-	const float c_max_distance_to_light_source= 2.5f;
-	if( nearest_source_square_distance < c_max_distance_to_light_source* c_max_distance_to_light_source )
+	if( nearest_source_square_distance < g_max_distance_to_light_source * g_max_distance_to_light_source )
 	{
 		nearest_source.z= GameConstants::walls_height * 2.0f; // Lit from abowe.
 		out_light_pos= nearest_source;
@@ -1,6 +1,10 @@
 #pragma once
+#include <cstdint>
+#include <vector>
+
 #include <bbox.hpp>
 
+#include "../model.hpp"
 #include "map_state.hpp"
 #include "i_map_drawer.hpp"
 
@@ -25,23 +29,86 @@ constexpr float y_shift= 0.45f;
 
 }
 
+// Temporary storage for sprites sorting. Keep it between frames, for avoiding of reallocations.
+struct EffectsSpritesSortBuffer
+{
+	// Distance key in high 32 bits, sprite index in low 32 bits.
+	std::vector<uint64_t> keys[2];
+};
+
+// Sort from far to near, using radix sort by distance.
+// If "skip_mask" is not null, sprites with set bit in it ( bit i of element i / 32 ) are not added into result.
 void SortEffectsSprites(
 	const MapState::SpriteEffects& effects_sprites,
 	const m_Vec3& camera_position,
-	std::vector<const MapState::SpriteEffect*>& out_sorted_sprites );
+	EffectsSpritesSortBuffer& sort_buffer,
+	std::vector<const MapState::SpriteEffect*>& out_sorted_sprites,
+	const uint32_t* skip_mask= nullptr );
 
 bool BBoxIsOutsideView(
 	const ViewClipPlanes& clip_planes,
 	const m_BBox3& bbox,
 	const m_Mat4& bbox_mat );
 
+// Returns -1, if sphere is fully behind one of planes, +1, if fully ahead of all planes, 0 otherwise.
+template<class Planes>
+int SphereViewTest( const Planes& clip_planes, const m_Vec3& center, const float radius )
+{
+	int result= 1;
+	for( const m_Plane3& plane : clip_planes )
+	{
+		const float distance= plane.normal * center + plane.dist;
+		if( distance < -radius )
+			return -1;
+		if( distance < radius )
+			result= 0;
+	}
+	return result;
+}
+
+// Tests bounding sphere first and bounding box only if sphere crosses clip planes.
+// Matrix must contain only rotation and translation.
+bool ModelIsOutsideView(
+	const ViewClipPlanes& clip_planes,
+	const BoundingSphere& sphere,
+	const m_BBox3& bbox,
+	const m_Mat4& model_mat );
+
 unsigned int GetModelBMPSpritePhase( const MapState::StaticModel& model );
 
+// Lists of static map lights, which may be nearest light source for positions inside each map cell.
+// Built once per map, for fast search of light sources for shadows.
+class StaticLightsGrid final
+{
+public:
+	void Build( const MapData& map_data );
+
+	template<class Func>
+	void ForEachCellLight( const m_Vec2& pos, const Func& func ) const
+	{
+		if( cells_lights_offsets_.empty() )
+			return;
+
+		const unsigned int cell= GetCellIndex( pos );
+		for( unsigned int i= cells_lights_offsets_[cell]; i < cells_lights_offsets_[ cell + 1u ]; i++ )
+			func( cells_lights_[i] );
+	}
+
+private:
+	static unsigned int GetCellIndex( const m_Vec2& pos );
+
+private:
+	// Offsets array has one extra element at end.
+	std::vector<unsigned int> cells_lights_offsets_;
+	std::vector<unsigned int> cells_lights_;
+};
+
 // Returns false, if no near light source.
 // TODO - maybe return "upper" light source in this case?
 bool GetNearestLightSourcePos(
 	const m_Vec3& pos,
 	const MapData& map_data,
+	const StaticLightsGrid& static_lights_grid,
 	const MapState& map_state,
 	bool use_dynamic_lights,
 	m_Vec3& out_light_pos );
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "../game_constants.hpp"
 #include "../game_resources.hpp"
 #include "../map_loader.hpp"
@@ -9,6 +12,137 @@
 namespace PanzerChasm
 {
 
+// Particles are stored in pools with fixed capacity.
+// Memory for pools is allocated once, so, big bursts of particles do not cause reallocations.
+// Pools keep particles in order of birth - new particles are appended, dead particles are removed without reordering.
+// Allocation never shifts pool, so, pool may temporarily exceed capacity. Oldest particles above capacity
+// are killed in next tick, in same compaction pass, which removes dead particles.
+// Storage has reserve for one capacity of particles, spawned between ticks.
+static const unsigned int g_max_sprite_effects= 4096u;
+static const unsigned int g_max_gibs= 512u;
+static const unsigned int g_max_monsters_body_parts= 256u;
+
+// Positions are not interpolated after teleportations.
+static const float g_max_position_interpolation_distance= 4.0f;
+// Entities are shown in past for this number of intervals between snapshots, but not longer, than maximum delay.
+static const float g_interpolation_delay_intervals= 2.0f;
+static const float g_max_interpolation_delay_s= 0.2f;
+static const float g_max_extrapolation_time_s= 0.1f;
+// Estimation of server time is reset after big jumps (pauses, map loading).
+static const float g_max_server_time_offset_error_s= 0.5f;
+
+static const float g_light_flash_life_time_s= 0.4f; // TODO - calibrate this
+
+// Removes elements, replacing them with last element.
+template<class T, class Pred>
+static void RemoveIf( std::vector<T>& container, const Pred& pred )
+{
+	for( unsigned int i= 0u; i < container.size(); )
+	{
+		if( pred( container[i] ) )
+		{
+			if( i + 1u != container.size() )
+				container[i]= std::move( container.back() );
+			container.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+template<class T>
+static T* AllocateFromPool( std::vector<T>& pool, const unsigned int capacity, unsigned int count )
+{
+	PC_ASSERT( count <= capacity );
+
+	const unsigned int size= pool.size();
+	if( size + count > capacity * 2u )
+	{
+		// More, than whole capacity, spawned since last tick. Kill oldest particles here. This is rare.
+		const unsigned int kill_count= size + count - capacity * 2u;
+		pool.erase( pool.begin(), pool.begin() + kill_count );
+	}
+
+	pool.resize( pool.size() + count );
+	return pool.data() + pool.size() - count;
+}
+
+// Removes dead particles and oldest particles above capacity, preserving order of others.
+// Kill predicate may also update particle.
+template<class T, class Pred>
+static void CompactPool( std::vector<T>& pool, const unsigned int capacity, const Pred& pred )
+{
+	unsigned int dst= 0u;
+	for( unsigned int src= pool.size() > capacity ? pool.size() - capacity : 0u; src < pool.size(); src++ )
+	{
+		if( pred( pool[src] ) )
+			continue;
+		if( dst != src )
+			pool[dst]= std::move( pool[src] );
+		dst++;
+	}
+	pool.erase( pool.begin() + dst, pool.end() );
+}
+
+void MapState::PositionSnapshots::AddSnapshot( const m_Vec3& pos, const Time server_time )
+{
+	if( count > 0u )
+	{
+		Snapshot& last= snapshots[ ( first + count - 1u ) % c_max_snapshots ];
+		if( server_time < last.server_time )
+			return; // Late message.
+		if( server_time == last.server_time )
+		{
+			// Messages without new server time are applied to last snapshot.
+			last.pos= pos;
+			return;
+		}
+		if( ( pos - last.pos ).SquareLength() > g_max_position_interpolation_distance * g_max_position_interpolation_distance )
+			count= 0u; // Teleported.
+	}
+
+	if( count == c_max_snapshots )
+	{
+		first= ( first + 1u ) % c_max_snapshots;
+		count--;
+	}
+
+	Snapshot& snapshot= snapshots[ ( first + count ) % c_max_snapshots ];
+	snapshot.pos= pos;
+	snapshot.server_time= server_time;
+	count++;
+}
+
+m_Vec3 MapState::PositionSnapshots::GetPos( const Time server_time ) const
+{
+	if( count == 0u )
+		return m_Vec3( 0.0f, 0.0f, 0.0f );
+
+	const Snapshot& first_snapshot= snapshots[ first ];
+	if( server_time <= first_snapshot.server_time )
+		return first_snapshot.pos;
+
+	for( unsigned int i= 1u; i < count; i++ )
+	{
+		const Snapshot& s0= snapshots[ ( first + i - 1u ) % c_max_snapshots ];
+		const Snapshot& s1= snapshots[ ( first + i ) % c_max_snapshots ];
+		if( server_time < s1.server_time )
+		{
+			const float k= ( server_time - s0.server_time ).ToSeconds() / ( s1.server_time - s0.server_time ).ToSeconds();
+			return s0.pos + ( s1.pos - s0.pos ) * k;
+		}
+	}
+
+	// Snapshots are late - extrapolate.
+	const Snapshot& last= snapshots[ ( first + count - 1u ) % c_max_snapshots ];
+	if( count < 2u )
+		return last.pos;
+
+	const Snapshot& prev= snapshots[ ( first + count - 2u ) % c_max_snapshots ];
+	const float extrapolation_time_s= std::min( ( server_time - last.server_time ).ToSeconds(), g_max_extrapolation_time_s );
+	return last.pos + ( last.pos - prev.pos ) * ( extrapolation_time_s / ( last.server_time - prev.server_time ).ToSeconds() );
+}
+
 MapState::MapState(
 	const MapDataConstPtr& map,
 	const GameResourcesConstPtr& game_resources,
@@ -20,6 +154,31 @@ MapState::MapState(
 {
 	PC_ASSERT( map_data_ != nullptr );
 
+	sprite_effects_.reserve( g_max_sprite_effects * 2u );
+	gibs_.reserve( g_max_gibs * 2u );
+	monsters_body_parts_.reserve( g_max_monsters_body_parts * 2u );
+
+	// Copy per-type parameters, needed in Tick, into flat arrays.
+	// Types ids are bytes in messages, so, arrays cover all possible ids and ones without resources get zero frames.
+	items_frame_counts_.resize( 256u, 0u );
+	for( unsigned int i= 0u; i < game_resources_->items_models.size() && i < items_frame_counts_.size(); i++ )
+		items_frame_counts_[i]= game_resources_->items_models[i].frame_count;
+
+	rockets_frame_counts_.resize( 256u, 0u );
+	for( unsigned int i= 0u; i < game_resources_->rockets_models.size() && i < rockets_frame_counts_.size(); i++ )
+		rockets_frame_counts_[i]= game_resources_->rockets_models[i].frame_count;
+
+	sprite_effects_params_.resize( game_resources_->sprites_effects_description.size() );
+	for( unsigned int i= 0u; i < sprite_effects_params_.size(); i++ )
+	{
+		const GameResources::SpriteEffectDescription& description= game_resources_->sprites_effects_description[i];
+		SpriteEffectParams& params= sprite_effects_params_[i];
+		params.frame_count= float( game_resources_->effects_sprites[i].frame_count );
+		params.gravity= description.gravity;
+		params.jump= description.jump;
+		params.looped= description.looped;
+	}
+
 	dynamic_walls_.resize( map_data_->dynamic_walls.size() );
 
 	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
@@ -57,6 +216,8 @@ MapState::MapState(
 		out_item.item_id= in_item.item_id;
 		out_item.picked_up= false;
 		out_item.animation_frame= 0;
+		out_item.next_animation_frame= 0;
+		out_item.animation_frame_lerp= 0.0f;
 	}
 }
 
@@ -161,44 +322,83 @@ float MapState::GetSpritesFrame() const
 	return ( last_tick_time_ - map_start_time_ ).ToSeconds() * GameConstants::sprites_animations_frames_per_second;
 }
 
+bool MapState::GetShownServerTimeMs( unsigned int& out_time_ms ) const
+{
+	out_time_ms=
+		static_cast<unsigned int>(
+			shown_server_time_.GetInternalRepresentation() * 1000 /
+			Time::FromSeconds(1).GetInternalRepresentation() );
+	return server_time_initialized_;
+}
+
 void MapState::Tick( const Time current_time )
 {
+	FlushMonstersStates();
+
 	const float time_since_map_start_s= ( current_time - map_start_time_ ).ToSeconds();
 	const float tick_delta_s= ( current_time - last_tick_time_ ).ToSeconds();
 
 	last_tick_time_= current_time;
 
-	for( Item& item : items_ )
+	// Show entities with interpolation delay.
+	if( server_time_initialized_ )
 	{
-		if( item.item_id < game_resources_->items_models.size() )
+		const float interpolation_delay_s=
+			std::min( snapshots_interval_s_ * g_interpolation_delay_intervals, g_max_interpolation_delay_s );
+		shown_server_time_= current_time + server_time_offset_ - Time::FromSeconds( double( interpolation_delay_s ) );
+	}
+	else
+		shown_server_time_= snapshot_server_time_;
+
+	// Animations of all entities are computed from their birth time, so, each entity is updated independently.
+	// Dead entities are removed first, and after that each kind of entities is updated in separate tight pass.
+
+	const auto kill_older_than=
+	[&]( const Time birth_time, const float life_time_s ) -> bool
+	{
+		return ( current_time - birth_time ).ToSeconds() > life_time_s;
+	};
+
+	CompactPool( gibs_, g_max_gibs, [&]( const Gib& gib ) { return kill_older_than( gib.start_time, 8.0f ); } );
+	CompactPool( monsters_body_parts_, g_max_monsters_body_parts, [&]( const MonsterBodyPart& part ) { return kill_older_than( part.start_time, 20.0f ); } );
+	RemoveIf( light_flashes_, [&]( const LightFlash& flash ) { return kill_older_than( flash.birth_time, g_light_flash_life_time_s ); } );
+	RemoveIf( fullscreen_blend_effects_, [&]( const FullscreenBlendEffect& effect ) { return kill_older_than( effect.birth_time, 4.0f ); } );
+
+	{ // All items have same animation phase, so, compute it once.
+		const float frame= GameConstants::animations_frames_per_second * time_since_map_start_s;
+		const unsigned int animation_frame= static_cast<unsigned int>( frame );
+		const float frame_lerp= frame - std::floor( frame );
+
+		for( Item& item : items_ )
 		{
-			const unsigned int frame_count= game_resources_->items_models[ item.item_id ].frame_count;
+			const unsigned int frame_count= items_frame_counts_[ item.item_id ];
 			if( frame_count > 1u )
 			{
 				// I don't know why, but in original game first and last frames of looped animations are same.
 				// So, just skip last frame.
-				const unsigned int animation_frame=
-					static_cast<unsigned int>( GameConstants::animations_frames_per_second * time_since_map_start_s );
-				item.animation_frame= animation_frame % ( game_resources_->items_models[ item.item_id ].frame_count - 1u );
+				item.animation_frame= animation_frame % ( frame_count - 1u );
+				item.next_animation_frame= ( animation_frame + 1u ) % ( frame_count - 1u );
+				item.animation_frame_lerp= frame_lerp;
 			}
 			else
-				item.animation_frame= 0u;
+			{
+				item.animation_frame= item.next_animation_frame= 0u;
+				item.animation_frame_lerp= 0.0f;
+			}
 		}
-		else
-			item.animation_frame= 0;
 	}
 
-	for( unsigned int i= 0u; i < sprite_effects_.size(); )
+	// Sprite effects are updated and killed in same pass.
+	const auto update_sprite_effect=
+	[&]( SpriteEffect& effect ) -> bool
 	{
-		SpriteEffect& effect= sprite_effects_[i];
+		const SpriteEffectParams& params= sprite_effects_params_[ effect.effect_id ];
 
 		const float time_delta_s= ( current_time - effect.start_time ).ToSeconds();
 
 		effect.frame= time_delta_s * GameConstants::sprites_animations_frames_per_second;
 
-		const GameResources::SpriteEffectDescription& description= game_resources_->sprites_effects_description[ effect.effect_id ];
-
-		if( description.gravity )
+		if( params.gravity )
 			effect.speed.z+= tick_delta_s * GameConstants::particles_vertical_acceleration;
 		effect.pos+= tick_delta_s * effect.speed;
 
@@ -206,7 +406,7 @@ void MapState::Tick( const Time current_time )
 
 		if( effect.pos.z < 0.0f )
 		{
-			if( description.jump )
+			if( params.jump )
 			{
 				effect.pos.z= 0.0f;
 
@@ -216,32 +416,22 @@ void MapState::Tick( const Time current_time )
 				effect.speed.z*= -c_speed_scale;
 			}
 
-			if( !description.looped || std::abs( effect.speed.z ) < 0.2f )
+			if( !params.looped || std::abs( effect.speed.z ) < 0.2f )
 				force_kill= true;
 		}
 
-		const float sprite_frame_count= float( game_resources_->effects_sprites[ effect.effect_id ].frame_count );
-
 		if( force_kill ||
-			( !description.looped && effect.frame >= sprite_frame_count ) ||
+			( !params.looped && effect.frame >= params.frame_count ) ||
 			time_delta_s > 10.0f )
-		{
-			if( i < sprite_effects_.size() -1u )
-				sprite_effects_[i]= sprite_effects_.back();
+			return true;
 
-			sprite_effects_.pop_back();
-		}
-		else
-		{
-			effect.frame= std::fmod( effect.frame, sprite_frame_count );
-			i++;
-		}
-	}
+		effect.frame= std::fmod( effect.frame, params.frame_count );
+		return false;
+	};
+	CompactPool( sprite_effects_, g_max_sprite_effects, update_sprite_effect );
 
-	for( unsigned int g= 0u; g < gibs_.size(); )
+	for( Gib& gib : gibs_ )
 	{
-		Gib& gib= gibs_[g];
-
 		gib.speed.z+= tick_delta_s * GameConstants::particles_vertical_acceleration;
 		gib.pos+= tick_delta_s * gib.speed;
 
@@ -254,41 +444,36 @@ void MapState::Tick( const Time current_time )
 			gib.pos.z= 0.0f;
 		}
 
-		const float time_delta_s= ( current_time - gib.start_time ).ToSeconds();
-
 		// Update gib angles, if it is not totaly on floor.
 		if( !( gib.pos.z < 0.2f && std::abs( gib.speed.z ) < 0.3f ) )
 		{
+			const float time_delta_s= ( current_time - gib.start_time ).ToSeconds();
 			gib.angle_x= ( time_delta_s + gib.time_phase ) * 7.0f;
 			gib.angle_z= ( time_delta_s + gib.time_phase ) * 5.0f;
 		}
-
-		if( time_delta_s > 8.0f )
-		{
-			if( g < gibs_.size() - 1u )
-				gibs_[g]= gibs_.back();
-			gibs_.pop_back();
-		}
-		else
-			g++;
 	}
 
-	for( unsigned int p= 0u; p < monsters_body_parts_.size(); )
+	for( MonsterBodyPart& part : monsters_body_parts_ )
 	{
-		MonsterBodyPart& part= monsters_body_parts_[p];
-		const float time_delta_s= ( current_time - part.start_time ).ToSeconds();
+		part.speed.z+= GameConstants::vertical_acceleration * tick_delta_s;
+		part.pos+= part.speed * tick_delta_s;
 
-		if( time_delta_s > 20.0f ) // Kill old part
+		if( part.pos.z < 0.0f )
 		{
-			if( &part != &monsters_body_parts_.back() )
-				part= monsters_body_parts_.back();
-			monsters_body_parts_.pop_back();
+			part.pos.z= 0.0f;
+			part.speed.z= std::abs( part.speed.z );
 
-			continue;
+			const float c_speed_scale= 0.8f;
+			part.speed*= c_speed_scale;
 		}
 
-		// Animate part.
+		if( part.speed.xy().SquareLength() < 0.05f * 0.05f )
+			part.speed.x= part.speed.y= 0.0f;
+	}
 
+	for( MonsterBodyPart& part : monsters_body_parts_ )
+	{
+		// Play animation 0, then play animation 1, then stop.
 		PC_ASSERT( part.monster_type < game_resources_->monsters_models.size() );
 		const auto& animations= game_resources_->monsters_models[ part.monster_type ].submodels[ part.body_part_id ].animations;
 
@@ -296,62 +481,64 @@ void MapState::Tick( const Time current_time )
 		{
 			const unsigned int frame_count_0= animations[0].frame_count;
 			const unsigned int frame_count_1= animations[1].frame_count;
-			const unsigned int frame= static_cast<unsigned int>( std::round( time_delta_s * GameConstants::animations_frames_per_second ) );
+			const float frame_f= ( current_time - part.start_time ).ToSeconds() * GameConstants::animations_frames_per_second;
+			const unsigned int frame= static_cast<unsigned int>( frame_f );
 
-			// Play animation 0, then play animation 1, then stop.
-			if( frame < frame_count_0 )
-			{
-				part.animation= 0u;
-				part.animation_frame= frame;
-			}
-			else
+			const auto select_frame=
+			[&]( const unsigned int f, unsigned int& out_animation, unsigned int& out_animation_frame )
 			{
-				part.animation= 1u;
-				if( frame_count_1 > 0u )
-					part.animation_frame= std::min( frame - frame_count_0, frame_count_1 - 1u );
+				if( f < frame_count_0 )
+				{
+					out_animation= 0u;
+					out_animation_frame= f;
+				}
 				else
-					part.animation_frame= 0u;
-			}
+				{
+					out_animation= 1u;
+					if( frame_count_1 > 0u )
+						out_animation_frame= std::min( f - frame_count_0, frame_count_1 - 1u );
+					else
+						out_animation_frame= 0u;
+				}
+			};
+
+			select_frame( frame, part.animation, part.animation_frame );
+			select_frame( frame + 1u, part.next_animation, part.next_animation_frame );
+			part.animation_frame_lerp= frame_f - std::floor( frame_f );
 		}
 		else
 		{
-			part.animation= 0u;
-			part.animation_frame= 0u;
-		}
-
-		// Move part.
-		part.speed.z+= GameConstants::vertical_acceleration * tick_delta_s;
-		part.pos+= part.speed * tick_delta_s;
-
-		if( part.pos.z < 0.0f )
-		{
-			part.pos.z= 0.0f;
-			part.speed.z= std::abs( part.speed.z );
-
-			const float c_speed_scale= 0.8f;
-			part.speed*= c_speed_scale;
+			part.animation= part.next_animation= 0u;
+			part.animation_frame= part.next_animation_frame= 0u;
+			part.animation_frame_lerp= 0.0f;
 		}
+	}
 
-		if( part.speed.xy().SquareLength() < 0.05f * 0.05f )
-			part.speed.x= part.speed.y= 0.0f;
-
-		p++;
+	for( MonstersContainer::value_type& monster_value : monsters_ )
+	{
+		Monster& monster= monster_value.second;
+		monster.pos= monster.position_snapshots.GetPos( shown_server_time_ );
 	}
 
 	for( RocketsContainer::value_type& rocket_value : rockets_ )
 	{
 		Rocket& rocket= rocket_value.second;
+		rocket.pos= rocket.position_snapshots.GetPos( shown_server_time_ );
 
-		const float time_delta_s= ( current_time - rocket.start_time ).ToSeconds();
-		const float frame= time_delta_s * GameConstants::animations_frames_per_second;
-
-		PC_ASSERT( rocket.rocket_id < game_resources_->rockets_models.size() );
+		const float frame= ( current_time - rocket.start_time ).ToSeconds() * GameConstants::animations_frames_per_second;
 
-		unsigned int model_frame_count= game_resources_->rockets_models[ rocket.rocket_id ].frame_count;
+		const unsigned int model_frame_count= rockets_frame_counts_[ rocket.rocket_id ];
 		if( model_frame_count != 0u )
-			rocket.frame= static_cast<unsigned int>( std::round( frame ) ) % model_frame_count;
+		{
+			rocket.frame= static_cast<unsigned int>( frame ) % model_frame_count;
+			rocket.next_frame= ( rocket.frame + 1u ) % model_frame_count;
+			rocket.frame_lerp= frame - std::floor( frame );
+		}
 		else
-			rocket.frame= 0u;
+		{
+			rocket.frame= rocket.next_frame= 0u;
+			rocket.frame_lerp= 0.0f;
+		}
 	}
 
 	for( DynamicItemsContainer::value_type& item_value : dynamic_items_ )
@@ -360,13 +547,21 @@ void MapState::Tick( const Time current_time )
 
 		const float time_delta_s= ( current_time - item.birth_time ).ToSeconds();
 
-		const unsigned int animation_frame=
-			static_cast<unsigned int>( std::round( GameConstants::animations_frames_per_second * time_delta_s ) );
+		const float frame= GameConstants::animations_frames_per_second * time_delta_s;
+		const unsigned int animation_frame= static_cast<unsigned int>( frame );
 
-		if( item.item_type_id < game_resources_->items_models.size() )
-			item.frame= animation_frame % game_resources_->items_models[ item.item_type_id ].frame_count;
+		const unsigned int frame_count= items_frame_counts_[ item.item_type_id ];
+		if( frame_count != 0u )
+		{
+			item.frame= animation_frame % frame_count;
+			item.next_frame= ( animation_frame + 1u ) % frame_count;
+			item.frame_lerp= frame - std::floor( frame );
+		}
 		else
-			item.frame= 0u;
+		{
+			item.frame= item.next_frame= 0u;
+			item.frame_lerp= 0.0f;
+		}
 
 		if( item.item_type_id == GameConstants::mine_item_id )
 		{
@@ -386,28 +581,15 @@ void MapState::Tick( const Time current_time )
 			item.angle= 0.0f;
 	}
 
-	for( unsigned int i= 0u; i < light_flashes_.size(); )
+	for( LightFlash& light_flash : light_flashes_ )
 	{
-		LightFlash& light_flash= light_flashes_[i];
-
-		const float c_light_life_time_s= 0.4f; // TODO - calibrate this
 		const float age_s= ( current_time - light_flash.birth_time ).ToSeconds();
 
-		if( age_s > c_light_life_time_s )
-		{
-			if( i + 1u != light_flashes_.size() )
-				light_flash= light_flashes_.back();
-			light_flashes_.pop_back();
-			continue;
-		}
-
-		if( age_s < c_light_life_time_s * 0.5f )
-			light_flash.intensity= age_s * 2.0f / c_light_life_time_s;
+		if( age_s < g_light_flash_life_time_s * 0.5f )
+			light_flash.intensity= age_s * 2.0f / g_light_flash_life_time_s;
 		else
-			light_flash.intensity= ( c_light_life_time_s - age_s ) * 2.0f / c_light_life_time_s;
+			light_flash.intensity= ( g_light_flash_life_time_s - age_s ) * 2.0f / g_light_flash_life_time_s;
 		light_flash.intensity= light_flash.intensity * light_flash.intensity; // Make quadratic.
-
-		i++;
 	}
 
 	for( DirectedLightSourcesContainer::value_type& light_value : directed_light_sources_ )
@@ -416,25 +598,76 @@ void MapState::Tick( const Time current_time )
 
 		light_source.direction= static_models_[ light_value.first ].angle;
 	}
+}
+
+void MapState::ProcessMessage( const Messages::ServerState& message )
+{
+	// Pending states belong to previous snapshot.
+	FlushMonstersStates();
 
-	for( unsigned int i= 0u; i < fullscreen_blend_effects_.size(); )
+	const Time prev_snapshot_server_time= snapshot_server_time_;
+	if( !server_time_initialized_ )
+		snapshot_server_time_= Time::FromSeconds( double( message.server_time_ms ) / 1000.0 );
+	else
 	{
-		FullscreenBlendEffect& effect= fullscreen_blend_effects_[i];
+		// Time is transmitted with wraparound, so, accumulate only delta.
+		const int delta_ms= static_cast<int>( message.server_time_ms - last_server_time_ms_ );
+		if( delta_ms <= 0 )
+			return; // Late message.
 
-		// Kill old effects.
-		if( ( current_time - effect.birth_time ).ToSeconds() > 4.0f )
-		{
-			if( i + 1u != fullscreen_blend_effects_.size() )
-				effect= fullscreen_blend_effects_.back();
-			fullscreen_blend_effects_.pop_back();
-			continue;
-		}
-		else
-			i++;
+		snapshot_server_time_+= Time::FromSeconds( double( delta_ms ) / 1000.0 );
+	}
+	last_server_time_ms_= message.server_time_ms;
+
+	// Estimate offset between server and client time.
+	// Late snapshots give lower offset, so, offset grows fast and decreases slowly.
+	const Time offset= snapshot_server_time_ - last_tick_time_;
+	const int64_t offset_error= offset.GetInternalRepresentation() - server_time_offset_.GetInternalRepresentation();
+	if( !server_time_initialized_ ||
+		std::abs( Time::FromInternalRepresentation( offset_error ).ToSeconds() ) > g_max_server_time_offset_error_s )
+	{
+		server_time_offset_= offset;
+		snapshots_interval_s_= 0.0f;
+	}
+	else
+	{
+		server_time_offset_=
+			Time::FromInternalRepresentation(
+				server_time_offset_.GetInternalRepresentation() + offset_error / ( offset_error > 0 ? 4 : 16 ) );
+
+		const float interval_s= std::min( ( snapshot_server_time_ - prev_snapshot_server_time ).ToSeconds(), g_max_interpolation_delay_s );
+		snapshots_interval_s_+= ( interval_s - snapshots_interval_s_ ) * 0.1f;
 	}
+
+	server_time_initialized_= true;
 }
 
 void MapState::ProcessMessage( const Messages::MonsterState& message )
+{
+	if( message.monster_id >= pending_monsters_states_indices_.size() )
+		pending_monsters_states_indices_.resize( message.monster_id + 1u, 0u );
+
+	unsigned int& index= pending_monsters_states_indices_[ message.monster_id ];
+	if( index == 0u )
+	{
+		pending_monsters_states_.push_back( message );
+		index= static_cast<unsigned int>( pending_monsters_states_.size() );
+	}
+	else
+		pending_monsters_states_[ index - 1u ]= message; // Previous state is stale.
+}
+
+void MapState::FlushMonstersStates()
+{
+	for( const Messages::MonsterState& message : pending_monsters_states_ )
+	{
+		ApplyMonsterState( message );
+		pending_monsters_states_indices_[ message.monster_id ]= 0u;
+	}
+	pending_monsters_states_.clear();
+}
+
+void MapState::ApplyMonsterState( const Messages::MonsterState& message )
 {
 	const auto it= monsters_.find( message.monster_id );
 	if( it == monsters_.end() )
@@ -446,7 +679,10 @@ void MapState::ProcessMessage( const Messages::MonsterState& message )
 
 	Monster& monster= it->second;
 
-	MessagePositionToPosition( message.xyz, monster.pos );
+	m_Vec3 pos;
+	MessagePositionToPosition( message.xyz, pos );
+	monster.position_snapshots.AddSnapshot( pos, snapshot_server_time_ );
+	monster.pos= monster.position_snapshots.GetPos( shown_server_time_ );
 	monster.angle= MessageAngleToAngle( message.angle );
 	monster.monster_id= message.monster_type;
 	monster.body_parts_mask= message.body_parts_mask;
@@ -513,8 +749,7 @@ void MapState::ProcessMessage( const Messages::SpriteEffectBirth& message )
 	if( message.effect_id >= game_resources_->sprites_effects_description.size() )
 		return;
 
-	sprite_effects_.emplace_back();
-	SpriteEffect& effect= sprite_effects_.back();
+	SpriteEffect& effect= *AllocateSpriteEffects( 1u );
 
 	effect.effect_id= message.effect_id;
 	effect.frame= 0.0f;
@@ -537,8 +772,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 	case ParticleEffect::Blood:
 	{
 		const unsigned int c_particle_count= 12u;
-		sprite_effects_.resize( sprite_effects_.size() + c_particle_count );
-		SpriteEffect* const effects= sprite_effects_.data() + sprite_effects_.size() - c_particle_count;
+		SpriteEffect* const effects= AllocateSpriteEffects( c_particle_count );
 
 		m_Vec3 pos;
 		MessagePositionToPosition( message.xyz, pos );
@@ -562,8 +796,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 		break;
 	case ParticleEffect::Bullet:
 	{
-		sprite_effects_.emplace_back();
-		SpriteEffect& flash_effect= sprite_effects_.back();
+		SpriteEffect& flash_effect= *AllocateSpriteEffects( 1u );
 
 		flash_effect.effect_id= static_cast<unsigned char>(Particels::Bullet);
 		flash_effect.frame= 0.0f;
@@ -576,8 +809,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 		flash_effect.start_time= last_tick_time_;
 
 		const unsigned int c_particle_count= 3u;
-		sprite_effects_.resize( sprite_effects_.size() + c_particle_count );
-		SpriteEffect* const effects= sprite_effects_.data() + sprite_effects_.size() - c_particle_count;
+		SpriteEffect* const effects= AllocateSpriteEffects( c_particle_count );
 
 		for( unsigned int i= 0u; i < c_particle_count; i++ )
 		{
@@ -600,8 +832,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 		MessagePositionToPosition( message.xyz, pos );
 
 		const unsigned int c_sparcle_count= 48u;
-		sprite_effects_.resize( sprite_effects_.size() + c_sparcle_count );
-		SpriteEffect* const effects= sprite_effects_.data() + sprite_effects_.size() - c_sparcle_count;
+		SpriteEffect* const effects= AllocateSpriteEffects( c_sparcle_count );
 
 
 		for( unsigned int i= 0u; i < c_sparcle_count; i++ )
@@ -621,8 +852,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 		}
 
 		const unsigned int c_smoke_particle_count= 5u;
-		sprite_effects_.resize( sprite_effects_.size() + c_sparcle_count );
-		SpriteEffect* const smoke_effects= sprite_effects_.data() + sprite_effects_.size() - c_smoke_particle_count;
+		SpriteEffect* const smoke_effects= AllocateSpriteEffects( c_smoke_particle_count );
 		for( unsigned int i= 0u; i < c_smoke_particle_count; i++ )
 		{
 			SpriteEffect& effect= smoke_effects[i];
@@ -639,8 +869,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 	case ParticleEffect::Explosion:
 	{
 		const unsigned int c_fireball_count= 16u;
-		sprite_effects_.resize( sprite_effects_.size() + c_fireball_count );
-		SpriteEffect* const effects= sprite_effects_.data() + sprite_effects_.size() - c_fireball_count;
+		SpriteEffect* const effects= AllocateSpriteEffects( c_fireball_count );
 
 		m_Vec3 pos;
 		MessagePositionToPosition( message.xyz, pos );
@@ -669,8 +898,7 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 			if( blow_effect_id < game_resources_->sprites_effects_description.size() )
 			{
 				const unsigned int c_particle_count= 16u;
-				sprite_effects_.resize( sprite_effects_.size() + c_particle_count );
-				SpriteEffect* const effects= sprite_effects_.data() + sprite_effects_.size() - c_particle_count;
+				SpriteEffect* const effects= AllocateSpriteEffects( c_particle_count );
 
 				m_Vec3 pos;
 				MessagePositionToPosition( message.xyz, pos );
@@ -688,31 +916,6 @@ void MapState::ProcessMessage( const Messages::ParticleEffectBirth& message )
 					effect.start_time= last_tick_time_;
 				}
 			}
-			else
-			{
-				const unsigned int gibs_effect_id=
-					static_cast<unsigned int>(effect) - static_cast<unsigned int>(ParticleEffect::FirstBlowEffect);
-				if( gibs_effect_id >= GameResources::c_first_gib_number )
-				{
-					const unsigned int c_gibs_count= 8u;
-					gibs_.resize( gibs_.size() + c_gibs_count );
-					Gib* const gibs= gibs_.data() + gibs_.size() - c_gibs_count;
-
-					m_Vec3 pos;
-					MessagePositionToPosition( message.xyz, pos );
-
-					for( unsigned int i= 0u; i < c_gibs_count; i++ )
-					{
-						Gib& gib= gibs[i];
-						gib.start_time= last_tick_time_;
-						gib.speed= random_generator_.RandDirection() * random_generator_.RandValue( 1.0f, 1.5f );
-						gib.pos= pos + random_generator_.RandPointInSphere( 0.01f );
-						gib.angle_x= gib.angle_z= 0.0f;
-						gib.time_phase= random_generator_.RandValue( 16.0f );
-						gib.gib_id= gibs_effect_id - GameResources::c_first_gib_number;
-					}
-				}
-			}
 		}
 		break;
 	};
@@ -756,8 +959,8 @@ void MapState::ProcessMessage( const Messages::MonsterPartBirth& message )
 	if( monster_model.submodels[ message.part_id ].frame_count == 0u )
 		return;
 
-	monsters_body_parts_.emplace_back();
-	MonsterBodyPart& part= monsters_body_parts_.back();
+	// If pool is full, oldest parts are killed in next tick.
+	MonsterBodyPart& part= *AllocateFromPool( monsters_body_parts_, g_max_monsters_body_parts, 1u );
 
 	part.monster_type= message.monster_type;
 	part.body_part_id= message.part_id;
@@ -765,10 +968,12 @@ void MapState::ProcessMessage( const Messages::MonsterPartBirth& message )
 	part.angle= MessageAngleToAngle( message.angle );
 	MessagePositionToPosition( message.xyz, part.pos );
 
-	part.animation= 0u;
-	part.animation_frame= 0u;
+	part.animation= part.next_animation= 0u;
+	part.animation_frame= part.next_animation_frame= 0u;
+	part.animation_frame_lerp= 0.0f;
 
-	const float rand_speed= random_generator_.RandValue( 0.3f, 0.6f );
+	LongRand random_generator( message.seed );
+	const float rand_speed= random_generator.RandValue( 0.3f, 0.6f );
 	part.speed.x= std::cos( -part.angle ) * rand_speed;
 	part.speed.y= std::sin( -part.angle ) * rand_speed;
 	part.speed.z= 0.0f;
@@ -776,8 +981,36 @@ void MapState::ProcessMessage( const Messages::MonsterPartBirth& message )
 	part.start_time= last_tick_time_;
 }
 
+void MapState::ProcessMessage( const Messages::GibsBirth& message )
+{
+	if( message.gib_id >= game_resources_->gibs_models.size() )
+		return;
+
+	const unsigned int c_gibs_count= 8u;
+	Gib* const gibs= AllocateGibs( c_gibs_count );
+
+	m_Vec3 pos;
+	MessagePositionToPosition( message.xyz, pos );
+
+	// Generate gibs from seed, so, gibs are same on all clients.
+	LongRand random_generator( message.seed );
+	for( unsigned int i= 0u; i < c_gibs_count; i++ )
+	{
+		Gib& gib= gibs[i];
+		gib.start_time= last_tick_time_;
+		gib.speed= random_generator.RandDirection() * random_generator.RandValue( 1.0f, 1.5f );
+		gib.pos= pos + random_generator.RandPointInSphere( 0.01f );
+		gib.angle_x= gib.angle_z= 0.0f;
+		gib.time_phase= random_generator.RandValue( 16.0f );
+		gib.gib_id= message.gib_id;
+	}
+}
+
 void MapState::ProcessMessage( const Messages::MonsterBirth& message )
 {
+	// States, recieved before birth, must not be applied to new monster.
+	FlushMonstersStates();
+
 	auto it= monsters_.find( message.monster_id );
 	if( it == monsters_.end() )
 		it= monsters_.emplace( message.monster_id, Monster() ).first;
@@ -798,7 +1031,10 @@ void MapState::ProcessMessage( const Messages::RocketState& message )
 
 	Rocket& rocket= it->second;
 
-	MessagePositionToPosition( message.xyz, rocket.pos );
+	m_Vec3 pos;
+	MessagePositionToPosition( message.xyz, pos );
+	rocket.position_snapshots.AddSnapshot( pos, snapshot_server_time_ );
+	rocket.pos= rocket.position_snapshots.GetPos( shown_server_time_ );
 
 	for( unsigned int j= 0u; j < 2u; j++ )
 		rocket.angle[j]= MessageAngleToAngle( message.angle[j] );
@@ -814,7 +1050,8 @@ void MapState::ProcessMessage( const Messages::RocketBirth& message )
 	inserted_it->second.rocket_id= message.rocket_type;
 
 	inserted_it->second.start_time= last_tick_time_;
-	inserted_it->second.frame= 0u;
+	inserted_it->second.frame= inserted_it->second.next_frame= 0u;
+	inserted_it->second.frame_lerp= 0.0f;
 
 	ProcessMessage( static_cast<const Messages::RocketState&>( message ) );
 }
@@ -834,7 +1071,8 @@ void MapState::ProcessMessage( const Messages::DynamicItemBirth& message )
 
 	MessagePositionToPosition( message.xyz, item.pos );
 	item.birth_time= last_tick_time_;
-	item.frame= 0u;
+	item.frame= item.next_frame= 0u;
+	item.frame_lerp= 0.0f;
 	item.item_type_id= message.item_type_id;
 	item.angle= 0.0f;
 	item.fullbright= false;
@@ -873,6 +1111,16 @@ void MapState::ProcessMessage( const Messages::LightSourceDeath& message )
 	light_sources_.erase( message.light_source_id );
 }
 
+MapState::SpriteEffect* MapState::AllocateSpriteEffects( const unsigned int count )
+{
+	return AllocateFromPool( sprite_effects_, g_max_sprite_effects, count );
+}
+
+MapState::Gib* MapState::AllocateGibs( const unsigned int count )
+{
+	return AllocateFromPool( gibs_, g_max_gibs, count );
+}
+
 void MapState::SpawnLightFlash( const m_Vec2& pos )
 {
 	light_flashes_.emplace_back();
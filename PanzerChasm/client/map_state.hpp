@@ -1,6 +1,5 @@
 #pragma once
-#include <unordered_map>
-
+#include "../entities_container.hpp"
 #include "../fwd.hpp"
 #include "../messages.hpp"
 #include "../rand.hpp"
@@ -40,6 +39,9 @@ public:
 		unsigned char item_id;
 		bool picked_up;
 		unsigned int animation_frame;
+		// Drawers can interpolate between current and next frame.
+		unsigned int next_animation_frame;
+		float animation_frame_lerp; // [ 0; 1 )
 	};
 
 	typedef std::vector<Item> Items;
@@ -79,13 +81,39 @@ public:
 
 		unsigned int animation;
 		unsigned int animation_frame;
+		unsigned int next_animation;
+		unsigned int next_animation_frame;
+		float animation_frame_lerp; // [ 0; 1 )
 	};
 
 	typedef std::vector<MonsterBodyPart> MonstersBodyParts;
 
+	// Positions of entity, recieved from server, with server time of each snapshot.
+	// Entities are shown with small delay, with interpolation between snapshots around shown time.
+	// So, motion stays smooth with low server send rate and with lost or late packets.
+	// If snapshots are late, position is extrapolated for limited time.
+	struct PositionSnapshots
+	{
+		static constexpr unsigned int c_max_snapshots= 8u;
+
+		struct Snapshot
+		{
+			m_Vec3 pos;
+			Time server_time= Time::FromSeconds(0);
+		};
+
+		Snapshot snapshots[ c_max_snapshots ]; // Ring buffer, ordered by time.
+		unsigned int first= 0u;
+		unsigned int count= 0u;
+
+		void AddSnapshot( const m_Vec3& pos, Time server_time );
+		m_Vec3 GetPos( Time server_time ) const;
+	};
+
 	struct Monster
 	{
 		m_Vec3 pos;
+		PositionSnapshots position_snapshots;
 		float angle;
 		unsigned char monster_id;
 		unsigned char body_parts_mask;
@@ -96,20 +124,23 @@ public:
 		unsigned char color;
 	};
 
-	typedef std::unordered_map< EntityId, Monster > MonstersContainer;
+	typedef EntitiesContainer<Monster> MonstersContainer;
 
 	struct Rocket
 	{
 		m_Vec3 start_pos;
 		m_Vec3 pos;
+		PositionSnapshots position_snapshots;
 		float angle[2]; // 0 - z, 1 - x
 		unsigned char rocket_id;
 		Time start_time= Time::FromSeconds(0);
 
 		unsigned int frame;
+		unsigned int next_frame;
+		float frame_lerp; // [ 0; 1 )
 	};
 
-	typedef std::unordered_map< EntityId, Rocket > RocketsContainer;
+	typedef EntitiesContainer<Rocket> RocketsContainer;
 
 	struct DynamicItem
 	{
@@ -117,11 +148,13 @@ public:
 		float angle;
 		Time birth_time= Time::FromSeconds(0); // TODO - does this need?
 		unsigned int frame;
+		unsigned int next_frame;
+		float frame_lerp; // [ 0; 1 )
 		unsigned char item_type_id;
 		bool fullbright;
 	};
 
-	typedef std::unordered_map< EntityId, DynamicItem > DynamicItemsContainer;
+	typedef EntitiesContainer<DynamicItem> DynamicItemsContainer;
 
 	struct LightFlash
 	{
@@ -140,7 +173,7 @@ public:
 		float radius;
 	};
 
-	typedef std::unordered_map<EntityId, LightSource> LightSourcesContainer;
+	typedef EntitiesContainer<LightSource> LightSourcesContainer;
 
 	struct DirectedLightSource
 	{
@@ -150,7 +183,7 @@ public:
 		float direction;
 	};
 
-	typedef std::unordered_map<EntityId, DirectedLightSource> DirectedLightSourcesContainer;
+	typedef EntitiesContainer<DirectedLightSource> DirectedLightSourcesContainer;
 
 public:
 	MapState(
@@ -177,8 +210,13 @@ public:
 
 	float GetSpritesFrame() const;
 
+	// Server time (with wraparound, like in messages), for which entities are shown now.
+	// Returns false, if server time is not known yet.
+	bool GetShownServerTimeMs( unsigned int& out_time_ms ) const;
+
 	void Tick( Time current_time );
 
+	void ProcessMessage( const Messages::ServerState& message );
 	void ProcessMessage( const Messages::MonsterState& message );
 	void ProcessMessage( const Messages::WallPosition& message );
 	void ProcessMessage( const Messages::ItemState& message );
@@ -187,6 +225,7 @@ public:
 	void ProcessMessage( const Messages::ParticleEffectBirth& message );
 	void ProcessMessage( const Messages::FullscreenBlendEffect& message );
 	void ProcessMessage( const Messages::MonsterPartBirth& message );
+	void ProcessMessage( const Messages::GibsBirth& message );
 	void ProcessMessage( const Messages::MonsterBirth& message );
 	void ProcessMessage( const Messages::MonsterDeath& message );
 	void ProcessMessage( const Messages::RocketState& message );
@@ -200,7 +239,19 @@ public:
 	void ProcessMessage( const Messages::RotatingLightSourceDeath& message );
 	void ProcessMessage( const Messages::DynamicItemDeath& message );
 
+	// Monsters states are collected and applied together, only last state of each monster is applied.
+	// Call this before reading monsters, while messages are processed. Tick calls this itself.
+	void FlushMonstersStates();
+
 private:
+	struct SpriteEffectParams
+	{
+		float frame_count;
+		bool gravity;
+		bool jump;
+		bool looped;
+	};
+
 	struct FullscreenBlendEffect
 	{
 		Time birth_time= Time::FromSeconds(0);
@@ -209,14 +260,34 @@ private:
 	};
 
 private:
+	// Returns pointer to "count" new default-initialized elements.
+	SpriteEffect* AllocateSpriteEffects( unsigned int count );
+	Gib* AllocateGibs( unsigned int count );
+
 	void SpawnLightFlash( const m_Vec2& pos );
 
+	void ApplyMonsterState( const Messages::MonsterState& message );
+
 private:
 	const MapDataConstPtr map_data_;
 	const GameResourcesConstPtr game_resources_;
 	const Time map_start_time_;
 	Time last_tick_time_;
 
+	// Per-type parameters, used in Tick.
+	std::vector<unsigned int> items_frame_counts_;
+	std::vector<unsigned int> rockets_frame_counts_;
+	std::vector<SpriteEffectParams> sprite_effects_params_;
+
+	// Server time of snapshot, which is recieved now.
+	Time snapshot_server_time_= Time::FromSeconds(0);
+	unsigned int last_server_time_ms_= 0u;
+	bool server_time_initialized_= false;
+
+	Time server_time_offset_= Time::FromSeconds(0); // Server time minus client time.
+	float snapshots_interval_s_= 0.0f; // Average interval between snapshots.
+	Time shown_server_time_= Time::FromSeconds(0); // Server time, for which entities are shown now.
+
 	LongRand random_generator_;
 
 	DynamicWalls dynamic_walls_;
@@ -226,6 +297,8 @@ private:
 	Gibs gibs_;
 	MonstersBodyParts monsters_body_parts_;
 	MonstersContainer monsters_;
+	std::vector<Messages::MonsterState> pending_monsters_states_;
+	std::vector<unsigned int> pending_monsters_states_indices_; // For each monster id - index in pending states plus one, or zero.
 	RocketsContainer rockets_;
 	DynamicItemsContainer dynamic_items_;
 
@@ -5,6 +5,7 @@
 
 #include "../assert.hpp"
 #include "../map_loader.hpp"
+#include "../profiler.hpp"
 #include "map_state.hpp"
 #include "minimap_drawers_common.hpp"
 
@@ -130,6 +131,7 @@ void MinimapDrawerGL::SetMap( const MapDataConstPtr& map_data )
 	walls_buffer_.SetPrimitiveType( GL_LINES );
 
 	// Prepare visibility texture.
+	visibility_texture_revision_= 0u;
 	visibility_texture_data_.resize( line_count );
 	glBindTexture( GL_TEXTURE_1D, visibility_texture_id_ );
 	glTexImage1D( GL_TEXTURE_1D, 0, GL_R8, line_count, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
@@ -152,6 +154,8 @@ void MinimapDrawerGL::Draw(
 	const m_Vec2& camera_position,
 	const float world_scale, const float view_angle )
 {
+	PC_PROFILE_SCOPE( "MinimapDrawerGL::Draw" );
+
 	if( current_map_data_ == nullptr )
 		return;
 
@@ -281,8 +285,14 @@ void MinimapDrawerGL::UpdateWallsVisibility( const MinimapState& minimap_state,
 	const MinimapState::WallsVisibility& static_walls_visibility = minimap_state.GetStaticWallsVisibility ();
 	const MinimapState::WallsVisibility& dynamic_walls_visibility= minimap_state.GetDynamicWallsVisibility();
 
-	PC_ASSERT( static_walls_visibility .size() == current_map_data_->static_walls .size() );
-	PC_ASSERT( dynamic_walls_visibility.size() == current_map_data_->dynamic_walls.size() );
+	PC_ASSERT( static_walls_visibility .Size() == current_map_data_->static_walls .size() );
+	PC_ASSERT( dynamic_walls_visibility.Size() == current_map_data_->dynamic_walls.size() );
+
+	if( minimap_state.GetRevision() == visibility_texture_revision_ &&
+		force_all_visible == visibility_texture_all_visible_ )
+		return;
+	visibility_texture_revision_= minimap_state.GetRevision();
+	visibility_texture_all_visible_= force_all_visible;
 
 	if( force_all_visible )
 	{
@@ -290,10 +300,10 @@ void MinimapDrawerGL::UpdateWallsVisibility( const MinimapState& minimap_state,
 	}
 	else
 	{
-		for( unsigned int w= 0u; w < static_walls_visibility .size(); w++ )
-			visibility_texture_data_[ first_static_walls_vertex_  / 2u + w ]= static_walls_visibility [w] ? 255u : 0u;
-		for( unsigned int w= 0u; w < dynamic_walls_visibility.size(); w++ )
-			visibility_texture_data_[ first_dynamic_walls_vertex_ / 2u + w ]= dynamic_walls_visibility[w] ? 255u : 0u;
+		std::memset( visibility_texture_data_.data() + first_static_walls_vertex_  / 2u, 0, static_walls_visibility .Size() );
+		std::memset( visibility_texture_data_.data() + first_dynamic_walls_vertex_ / 2u, 0, dynamic_walls_visibility.Size() );
+		static_walls_visibility .ForEachSetBit( [&]( const unsigned int w ){ visibility_texture_data_[ first_static_walls_vertex_  / 2u + w ]= 255u; } );
+		dynamic_walls_visibility.ForEachSetBit( [&]( const unsigned int w ){ visibility_texture_data_[ first_dynamic_walls_vertex_ / 2u + w ]= 255u; } );
 	}
 
 	// Set arrow and framing visible.
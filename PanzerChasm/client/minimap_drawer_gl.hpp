@@ -1,10 +1,10 @@
 #pragma once
 
-#include <glsl_program.hpp>
 #include <polygon_buffer.hpp>
 
 #include "../fwd.hpp"
 #include "../rendering_context.hpp"
+#include "../shader_program_gl.hpp"
 #include "fwd.hpp"
 #include "i_minimap_drawer.hpp"
 
@@ -45,11 +45,14 @@ private:
 
 	MapDataConstPtr current_map_data_;
 
-	r_GLSLProgram lines_shader_;
+	ShaderProgramGL lines_shader_;
 
 	r_PolygonBuffer walls_buffer_;
 	std::vector<WallLineVertex> dynamic_walls_vertices_;
 	std::vector<unsigned char> visibility_texture_data_;
+	// Visibility texture is uploaded only if minimap state revision changed.
+	unsigned int visibility_texture_revision_= 0u;
+	bool visibility_texture_all_visible_= false;
 
 	unsigned int first_static_walls_vertex_= 0u;
 	unsigned int first_dynamic_walls_vertex_= 0u;
@@ -3,7 +3,9 @@
 #include "../assert.hpp"
 #include "../map_loader.hpp"
 #include "../math_utils.hpp"
+#include "../profiler.hpp"
 #include "minimap_drawers_common.hpp"
+#include "minimap_state.hpp"
 
 #include "minimap_drawer_soft.hpp"
 
@@ -29,6 +31,9 @@ MinimapDrawerSoft::~MinimapDrawerSoft()
 void MinimapDrawerSoft::SetMap( const MapDataConstPtr& map_data )
 {
 	current_map_data_= map_data;
+
+	visible_static_walls_vertices_.clear();
+	visible_static_walls_revision_= 0u;
 }
 
 void MinimapDrawerSoft::Draw(
@@ -37,6 +42,8 @@ void MinimapDrawerSoft::Draw(
 	const m_Vec2& camera_position,
 	const float world_scale, const float view_angle )
 {
+	PC_PROFILE_SCOPE( "MinimapDrawerSoft::Draw" );
+
 	if( current_map_data_ == nullptr )
 		return;
 
@@ -78,18 +85,15 @@ void MinimapDrawerSoft::Draw(
 	final_mat3.value[6]= final_mat.value[12];
 	final_mat3.value[7]= final_mat.value[13];
 
-	const MinimapState::WallsVisibility& static_walls_visibility = minimap_state.GetStaticWallsVisibility ();
+	UpdateVisibleStaticWalls( minimap_state, force_all_visible );
+
 	const MinimapState::WallsVisibility& dynamic_walls_visibility= minimap_state.GetDynamicWallsVisibility();
 
 	line_color_= palette[ MinimapParams::walls_color ];
-	for( unsigned int w= 0u; w < current_map_data_->static_walls.size(); w++ )
+	for( unsigned int v= 0u; v < visible_static_walls_vertices_.size(); v+= 2u )
 	{
-		if( !force_all_visible && !static_walls_visibility[w] )
-			continue;
-
-		const MapData::Wall& wall= current_map_data_->static_walls[w];
-		const m_Vec2 v0= wall.vert_pos[0] * final_mat3;
-		const m_Vec2 v1= wall.vert_pos[1] * final_mat3;
+		const m_Vec2 v0= visible_static_walls_vertices_[v     ] * final_mat3;
+		const m_Vec2 v1= visible_static_walls_vertices_[v + 1u] * final_mat3;
 
 		DrawLine(
 			fixed16_t( v0.x * 65536.0f ), fixed16_t( v0.y * 65536.0f ),
@@ -99,7 +103,7 @@ void MinimapDrawerSoft::Draw(
 	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
 	for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
 	{
-		if( !dynamic_walls_visibility[w] )
+		if( !dynamic_walls_visibility.Get(w) )
 			continue;
 
 		const MapState::DynamicWall& wall= dynamic_walls[w];
@@ -160,6 +164,35 @@ void MinimapDrawerSoft::Draw(
 
 }
 
+void MinimapDrawerSoft::UpdateVisibleStaticWalls( const MinimapState& minimap_state, const bool force_all_visible )
+{
+	if( minimap_state.GetRevision() == visible_static_walls_revision_ &&
+		force_all_visible == visible_static_walls_all_visible_ )
+		return;
+	visible_static_walls_revision_= minimap_state.GetRevision();
+	visible_static_walls_all_visible_= force_all_visible;
+
+	const MinimapState::WallsVisibility& static_walls_visibility= minimap_state.GetStaticWallsVisibility();
+	PC_ASSERT( static_walls_visibility.Size() == current_map_data_->static_walls.size() );
+
+	const auto add_wall=
+	[&]( const unsigned int w )
+	{
+		const MapData::Wall& wall= current_map_data_->static_walls[w];
+		visible_static_walls_vertices_.push_back( wall.vert_pos[0] );
+		visible_static_walls_vertices_.push_back( wall.vert_pos[1] );
+	};
+
+	visible_static_walls_vertices_.clear();
+	if( force_all_visible )
+	{
+		for( unsigned int w= 0u; w < current_map_data_->static_walls.size(); w++ )
+			add_wall( w );
+	}
+	else
+		static_walls_visibility.ForEachSetBit( add_wall );
+}
+
 void MinimapDrawerSoft::DrawLine(
 	const fixed16_t x0, const fixed16_t y0,
 	const fixed16_t x1, const fixed16_t y1 )
@@ -1,4 +1,7 @@
 #pragma once
+#include <vector>
+
+#include <vec.hpp>
 
 #include "../rendering_context.hpp"
 #include "i_minimap_drawer.hpp"
@@ -28,12 +31,20 @@ public:
 		fixed16_t x0, fixed16_t y0,
 		fixed16_t x1, fixed16_t y1 );
 
+private:
+	void UpdateVisibleStaticWalls( const MinimapState& minimap_state, bool force_all_visible );
+
 private:
 	const RenderingContextSoft rendering_context_;
 	const GameResourcesConstPtr game_resources_;
 
 	MapDataConstPtr current_map_data_;
 
+	// Vertices of visible static walls. Rebuilt only if minimap state revision changed.
+	std::vector<m_Vec2> visible_static_walls_vertices_;
+	unsigned int visible_static_walls_revision_= 0u;
+	bool visible_static_walls_all_visible_= false;
+
 	int x_min_, y_min_, x_max_, y_max_;
 	fixed16_t x_min_f_, y_min_f_, x_max_f_, y_max_f_;
 
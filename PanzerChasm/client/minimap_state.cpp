@@ -1,4 +1,8 @@
-#include <matrix.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
 #include <plane.hpp>
 
 #include "../assert.hpp"
@@ -15,27 +19,10 @@ namespace PanzerChasm
 {
 
 static const float g_z_near= 1.0f / 16.0f;
-static const unsigned int g_view_buffer_size= GameConstants::min_screen_width;
+// Visibility is computed via one ray for each column of screen with minimal width.
+static const unsigned int g_view_rays= GameConstants::min_screen_width;
 
-static void BuildViewMatrix(
-	const m_Vec2& camera_position,
-	const float view_angle_z,
-	const float fov,
-	m_Mat4& out_matrix )
-{
-	m_Mat4 translate, rotate, perspective, basis_change;
-	translate.Translate( m_Vec3( -camera_position, 0.0f ) );
-	rotate.RotateZ( -view_angle_z );
-	perspective.PerspectiveProjection( 1.0f, fov, g_z_near, 128.0f );
-
-	basis_change.Identity();
-	basis_change[5]= 0.0f;
-	basis_change[6]= 1.0f;
-	basis_change[9]= 1.0f;
-	basis_change[10]= 0.0f;
-
-	out_matrix= translate * rotate * basis_change * perspective;
-}
+static unsigned int g_next_revision= 1u;
 
 // Returns -1, if fully clipped
 // Returns +1, if fully accepted
@@ -70,13 +57,72 @@ static int ClipLineSegment(
 	return 0;
 }
 
+// Returns ray parameter of intersection or infinity.
+static float RayCastWall( const m_Vec2& ray_pos, const m_Vec2& ray_dir, const m_Vec2& v0, const m_Vec2& v1 )
+{
+	const m_Vec2 edge= v1 - v0;
+	const float denominator= ray_dir.x * edge.y - ray_dir.y * edge.x;
+	if( denominator == 0.0f )
+		return std::numeric_limits<float>::infinity();
+
+	const m_Vec2 to_v0= v0 - ray_pos;
+	const float t= ( to_v0.x * edge.y - to_v0.y * edge.x ) / denominator;
+	const float s= ( to_v0.x * ray_dir.y - to_v0.y * ray_dir.x ) / denominator;
+	if( s < 0.0f || s > 1.0f || t <= 0.0f )
+		return std::numeric_limits<float>::infinity();
+
+	return t;
+}
+
+MinimapState::WallsVisibility::WallsVisibility()
+	: size_(0u)
+{}
+
+MinimapState::WallsVisibility::WallsVisibility( const unsigned int size )
+	: words_( ( size + 31u ) >> 5u, 0u )
+	, size_(size)
+{}
+
 MinimapState::MinimapState( const MapDataConstPtr& map_data )
 	: map_data_( map_data )
+	, static_walls_visibility_( static_cast<unsigned int>( map_data->static_walls.size() ) )
+	, dynamic_walls_visibility_( static_cast<unsigned int>( map_data->dynamic_walls.size() ) )
+	, revision_( g_next_revision++ )
 {
 	PC_ASSERT( map_data != nullptr );
 
-	static_walls_visibility_.resize( map_data->static_walls.size(), false );
-	dynamic_walls_visibility_.resize( map_data->dynamic_walls.size(), false );
+	// Build lists of opaque static walls for each cell.
+	// Wall is added into all cells of its bounding box (with small expansion for walls on cells borders).
+	const float c_eps= 1.0f / 256.0f;
+	const auto for_each_wall_cell=
+	[&]( const MapData::Wall& wall, const std::function<void(unsigned int)>& func )
+	{
+		const int x_min= std::max( 0, int( std::floor( std::min( wall.vert_pos[0].x, wall.vert_pos[1].x ) - c_eps ) ) );
+		const int y_min= std::max( 0, int( std::floor( std::min( wall.vert_pos[0].y, wall.vert_pos[1].y ) - c_eps ) ) );
+		const int x_max= std::min( int(MapData::c_map_size) - 1, int( std::floor( std::max( wall.vert_pos[0].x, wall.vert_pos[1].x ) + c_eps ) ) );
+		const int y_max= std::min( int(MapData::c_map_size) - 1, int( std::floor( std::max( wall.vert_pos[0].y, wall.vert_pos[1].y ) + c_eps ) ) );
+		for( int y= y_min; y <= y_max; y++ )
+		for( int x= x_min; x <= x_max; x++ )
+			func( static_cast<unsigned int>( x + y * int(MapData::c_map_size) ) );
+	};
+
+	cells_walls_offsets_.resize( MapData::c_map_size * MapData::c_map_size + 1u, 0u );
+	for( const MapData::Wall& wall : map_data_->static_walls )
+	{
+		if( wall.texture_id < MapData::c_first_transparent_texture_id )
+			for_each_wall_cell( wall, [&]( const unsigned int cell ){ cells_walls_offsets_[ cell + 1u ]++; } );
+	}
+	for( unsigned int cell= 0u; cell < MapData::c_map_size * MapData::c_map_size; cell++ )
+		cells_walls_offsets_[ cell + 1u ]+= cells_walls_offsets_[cell];
+
+	cells_walls_.resize( cells_walls_offsets_.back() );
+	std::vector<unsigned int> cells_fill( cells_walls_offsets_.begin(), cells_walls_offsets_.end() - 1 );
+	for( const MapData::Wall& wall : map_data_->static_walls )
+	{
+		const unsigned int wall_index= static_cast<unsigned int>( &wall - map_data_->static_walls.data() );
+		if( wall.texture_id < MapData::c_first_transparent_texture_id )
+			for_each_wall_cell( wall, [&]( const unsigned int cell ){ cells_walls_[ cells_fill[cell]++ ]= wall_index; } );
+	}
 }
 
 MinimapState::~MinimapState()
@@ -87,8 +133,8 @@ void MinimapState::SetState(
 	const WallsVisibility& static_walls_visibility ,
 	const WallsVisibility& dynamic_walls_visibility )
 {
-	if( static_walls_visibility .size() != static_walls_visibility_ .size() ||
-		dynamic_walls_visibility.size() != dynamic_walls_visibility_.size() )
+	if( static_walls_visibility .Size() != static_walls_visibility_ .Size() ||
+		dynamic_walls_visibility.Size() != dynamic_walls_visibility_.Size() )
 	{
 		Log::Warning( "Invalide minimap state" );
 		return;
@@ -96,6 +142,8 @@ void MinimapState::SetState(
 
 	static_walls_visibility_ = static_walls_visibility ;
 	dynamic_walls_visibility_= dynamic_walls_visibility;
+	have_prev_view_= false;
+	revision_= g_next_revision++;
 }
 
 void MinimapState::Update(
@@ -103,24 +151,13 @@ void MinimapState::Update(
 	const m_Vec2& camera_position,
 	const float view_angle_z )
 {
+	// Visibility only grows, so, nothing new can be visible from same view.
+	if( !ViewChanged( map_state, camera_position, view_angle_z ) )
+		return;
+
 	// TODO - use real field of view.
 	const float c_fov= Constants::half_pi;
 
-	// Setup buffer
-	typedef float DepthType;
-	MapData::IndexElement screen_buffer[ g_view_buffer_size ];
-	DepthType depth_buffer[ g_view_buffer_size ];
-
-	for( unsigned int i= 0u; i < g_view_buffer_size; i++ )
-	{
-		screen_buffer[i].type= MapData::IndexElement::None;
-		depth_buffer[i]= 1.0f;
-	}
-
-	// Create view matrix
-	m_Mat4 view_matrix;
-	BuildViewMatrix( camera_position, view_angle_z, c_fov, view_matrix );
-
 	// Setup clip planes
 	const unsigned int c_clip_planes= 3u;
 	m_Plane2 clip_planes[ c_clip_planes ];
@@ -139,94 +176,105 @@ void MinimapState::Update(
 		clip_planes[2].dist= -( clip_planes[2].normal * camera_position );
 	}
 
-	const auto draw_wall=
-	[&]( const m_Vec2& v0, const m_Vec2& v1, const MapData::IndexElement& wall_index )
+	// Dynamic walls are few, so, test for each ray all dynamic walls in view.
+	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
+	dynamic_walls_in_view_.clear();
+	for( const MapState::DynamicWall& wall : dynamic_walls )
 	{
-		m_Vec2 v0_clipped= v0;
-		m_Vec2 v1_clipped= v1;
+		if( wall.texture_id >= MapData::c_first_transparent_texture_id )
+			continue;
 
-		for( unsigned int p= 0u; p < 3u; p++ )
-		{
-			const int clip_result= ClipLineSegment( clip_planes[p], v0_clipped, v1_clipped );
-			if( clip_result == -1 )
-				return;
-		}
+		m_Vec2 v0= wall.vert_pos[0];
+		m_Vec2 v1= wall.vert_pos[1];
+		bool clipped= false;
+		for( unsigned int p= 0u; p < c_clip_planes && !clipped; p++ )
+			clipped= ClipLineSegment( clip_planes[p], v0, v1 ) == -1;
+		if( !clipped )
+			dynamic_walls_in_view_.push_back( static_cast<unsigned int>( &wall - dynamic_walls.data() ) );
+	}
 
-		m_Vec3 v0_projected= m_Vec3( v0_clipped, 0.0f ) * view_matrix;
-		m_Vec3 v1_projected= m_Vec3( v1_clipped, 0.0f ) * view_matrix;
-		// TODO - move W calculation to function.
-		const float w0= v0_clipped.x * view_matrix.value[3] + v0_clipped.y * view_matrix.value[7] + view_matrix.value[15];
-		const float w1= v1_clipped.x * view_matrix.value[3] + v1_clipped.y * view_matrix.value[7] + view_matrix.value[15];
-		PC_ASSERT( w0 > 0.0f );
-		PC_ASSERT( w1 > 0.0f );
-		v0_projected/= w0;
-		v1_projected/= w1;
-
-		float v0_depth, v1_depth;
-		float v0_x= ( v0_projected.x + 1.0f ) * ( 0.5f * float(g_view_buffer_size) );
-		float v1_x= ( v1_projected.x + 1.0f ) * ( 0.5f * float(g_view_buffer_size) );
-		if( v0_x < v1_x )
-		{
-			v0_depth= v0_projected.z;
-			v1_depth= v1_projected.z;
-		}
-		else if( v0_x > v1_x )
-		{
-			std::swap( v0_x, v1_x );
-			v0_depth= v1_projected.z;
-			v1_depth= v0_projected.z;
-		}
-		else
-			return;
+	const m_Vec2 forward_dir= clip_planes[0].normal;
+	const m_Vec2 side_dir( forward_dir.y, -forward_dir.x );
+	const float side_scale= std::tan( 0.5f * c_fov );
+
+	bool visibility_changed= false;
+	for( unsigned int ray= 0u; ray < g_view_rays; ray++ )
+	{
+		const float screen_x= ( float(ray) + 0.5f ) / float(g_view_rays) * 2.0f - 1.0f;
+		const m_Vec2 ray_dir= forward_dir + side_dir * ( screen_x * side_scale );
+		// Ray parameter is equal to distance along view direction, so, near plane is same for all rays.
+		const float t_min= g_z_near;
 
-		const float d_depth_dx= ( v1_depth - v0_depth ) / ( v1_x - v0_x );
-		const int x_start= std::max( 0, static_cast<int>(std::round(v0_x)) );
-		const int x_end= std::min( static_cast<int>(std::round(v1_x)), int(g_view_buffer_size) );
-		const float depth_start= v0_depth + ( float(x_start) + 0.5f - v0_x ) * d_depth_dx;
-		for( int x= x_start; x < x_end; x++ )
+		float nearest_t= std::numeric_limits<float>::infinity();
+		bool nearest_is_dynamic= false;
+		unsigned int nearest_wall= 0u;
+
+		for( const unsigned int wall_index : dynamic_walls_in_view_ )
 		{
-			const float depth= depth_start + float( x - x_start ) * d_depth_dx;
-			if( depth < depth_buffer[x] )
+			const MapState::DynamicWall& wall= dynamic_walls[ wall_index ];
+			const float t= RayCastWall( camera_position, ray_dir, wall.vert_pos[0], wall.vert_pos[1] );
+			if( t > t_min && t < nearest_t )
 			{
-				depth_buffer[x]= depth;
-				screen_buffer[x]= wall_index;
+				nearest_t= t;
+				nearest_is_dynamic= true;
+				nearest_wall= wall_index;
 			}
 		}
-	};
 
-	// Draw static walls
-	for( const MapData::Wall& wall : map_data_->static_walls )
-	{
-		if( wall.texture_id >= MapData::c_first_transparent_texture_id )
-			continue;
+		// Walk through cells of map along ray, until cell is farther, than nearest hit.
+		int cell_x= static_cast<int>( std::floor( camera_position.x ) );
+		int cell_y= static_cast<int>( std::floor( camera_position.y ) );
+		const int step_x= ray_dir.x >= 0.0f ? 1 : -1;
+		const int step_y= ray_dir.y >= 0.0f ? 1 : -1;
+		const float t_delta_x= ray_dir.x != 0.0f ? std::abs( 1.0f / ray_dir.x ) : std::numeric_limits<float>::infinity();
+		const float t_delta_y= ray_dir.y != 0.0f ? std::abs( 1.0f / ray_dir.y ) : std::numeric_limits<float>::infinity();
+		float t_next_x= ray_dir.x != 0.0f ? ( float( cell_x + ( step_x > 0 ? 1 : 0 ) ) - camera_position.x ) / ray_dir.x : std::numeric_limits<float>::infinity();
+		float t_next_y= ray_dir.y != 0.0f ? ( float( cell_y + ( step_y > 0 ? 1 : 0 ) ) - camera_position.y ) / ray_dir.y : std::numeric_limits<float>::infinity();
+		float t_cell_enter= 0.0f;
+
+		while(
+			t_cell_enter < nearest_t &&
+			cell_x >= 0 && cell_x < int(MapData::c_map_size) &&
+			cell_y >= 0 && cell_y < int(MapData::c_map_size) )
+		{
+			const unsigned int cell= static_cast<unsigned int>( cell_x + cell_y * int(MapData::c_map_size) );
+			for( unsigned int i= cells_walls_offsets_[cell]; i < cells_walls_offsets_[ cell + 1u ]; i++ )
+			{
+				const MapData::Wall& wall= map_data_->static_walls[ cells_walls_[i] ];
+				const float t= RayCastWall( camera_position, ray_dir, wall.vert_pos[0], wall.vert_pos[1] );
+				if( t > t_min && t < nearest_t )
+				{
+					nearest_t= t;
+					nearest_is_dynamic= false;
+					nearest_wall= cells_walls_[i];
+				}
+			}
 
-		MapData::IndexElement index;
-		index.type= MapData::IndexElement::StaticWall;
-		index.index= &wall - map_data_->static_walls.data();
-		draw_wall( wall.vert_pos[0], wall.vert_pos[1], index );
-	}
+			if( t_next_x < t_next_y )
+			{
+				t_cell_enter= t_next_x;
+				t_next_x+= t_delta_x;
+				cell_x+= step_x;
+			}
+			else
+			{
+				t_cell_enter= t_next_y;
+				t_next_y+= t_delta_y;
+				cell_y+= step_y;
+			}
+		}
 
-	// Draw dynamic walls
-	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
-	for( const MapState::DynamicWall& wall : dynamic_walls )
-	{
-		if( wall.texture_id >= MapData::c_first_transparent_texture_id )
+		if( nearest_t == std::numeric_limits<float>::infinity() )
 			continue;
 
-		MapData::IndexElement index;
-		index.type= MapData::IndexElement::DynamicWall;
-		index.index= &wall - dynamic_walls.data();
-		draw_wall( wall.vert_pos[0], wall.vert_pos[1], index );
+		if( nearest_is_dynamic )
+			visibility_changed|= dynamic_walls_visibility_.Set( nearest_wall );
+		else
+			visibility_changed|= static_walls_visibility_.Set( nearest_wall );
 	}
 
-	// Update visibility.
-	for( const MapData::IndexElement& index_element : screen_buffer )
-	{
-		if( index_element.type == MapData::IndexElement::StaticWall )
-			static_walls_visibility_[ index_element.index ]= true;
-		else if( index_element.type == MapData::IndexElement::DynamicWall )
-			dynamic_walls_visibility_[ index_element.index ]= true;
-	}
+	if( visibility_changed )
+		revision_= g_next_revision++;
 }
 
 const MinimapState::WallsVisibility& MinimapState::GetStaticWallsVisibility() const
@@ -239,4 +287,44 @@ const MinimapState::WallsVisibility& MinimapState::GetDynamicWallsVisibility() c
 	return dynamic_walls_visibility_;
 }
 
+unsigned int MinimapState::GetRevision() const
+{
+	return revision_;
+}
+
+bool MinimapState::ViewChanged( const MapState& map_state, const m_Vec2& camera_position, const float view_angle_z )
+{
+	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
+
+	bool changed=
+		!have_prev_view_ ||
+		camera_position.x != prev_camera_position_.x || camera_position.y != prev_camera_position_.y ||
+		view_angle_z != prev_view_angle_z_ ||
+		dynamic_walls.size() * 2u != prev_dynamic_walls_vertices_.size();
+
+	for( unsigned int w= 0u; w < dynamic_walls.size() && !changed; w++ )
+	{
+		for( unsigned int j= 0u; j < 2u; j++ )
+		{
+			const m_Vec2& prev_pos= prev_dynamic_walls_vertices_[ w * 2u + j ];
+			if( dynamic_walls[w].vert_pos[j].x != prev_pos.x || dynamic_walls[w].vert_pos[j].y != prev_pos.y )
+				changed= true;
+		}
+	}
+
+	if( !changed )
+		return false;
+
+	have_prev_view_= true;
+	prev_camera_position_= camera_position;
+	prev_view_angle_z_= view_angle_z;
+	prev_dynamic_walls_vertices_.resize( dynamic_walls.size() * 2u );
+	for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
+	{
+		prev_dynamic_walls_vertices_[ w * 2u      ]= dynamic_walls[w].vert_pos[0];
+		prev_dynamic_walls_vertices_[ w * 2u + 1u ]= dynamic_walls[w].vert_pos[1];
+	}
+	return true;
+}
+
 } // namespace PanzerChasm
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 
 #include <vec.hpp>
@@ -12,7 +13,48 @@ namespace PanzerChasm
 class MinimapState final
 {
 public:
-	typedef std::vector<bool> WallsVisibility;
+	// Packed bitset of walls visibility.
+	class WallsVisibility final
+	{
+	public:
+		WallsVisibility();
+		explicit WallsVisibility( unsigned int size );
+
+		unsigned int Size() const { return size_; }
+
+		bool Get( const unsigned int index ) const
+		{
+			return ( words_[ index >> 5u ] & ( 1u << ( index & 31u ) ) ) != 0u;
+		}
+
+		// Returns true, if bit was not set before.
+		bool Set( const unsigned int index )
+		{
+			uint32_t& word= words_[ index >> 5u ];
+			const uint32_t bit= 1u << ( index & 31u );
+			const bool was_set= ( word & bit ) != 0u;
+			word|= bit;
+			return !was_set;
+		}
+
+		template<class Func>
+		void ForEachSetBit( const Func& func ) const
+		{
+			for( unsigned int w= 0u; w < words_.size(); w++ )
+			{
+				uint32_t word= words_[w];
+				while( word != 0u )
+				{
+					func( ( w << 5u ) + static_cast<unsigned int>( __builtin_ctz( word ) ) );
+					word&= word - 1u; // Clear lowest set bit.
+				}
+			}
+		}
+
+	private:
+		std::vector<uint32_t> words_; // Bits after size are always zero.
+		unsigned int size_;
+	};
 
 	explicit MinimapState( const MapDataConstPtr& map_data );
 	~MinimapState();
@@ -29,11 +71,33 @@ public:
 	const WallsVisibility& GetStaticWallsVisibility() const;
 	const WallsVisibility& GetDynamicWallsVisibility() const;
 
+	// Revision changes each time, when visibility of walls changes.
+	// Revisions are unique across all minimap states, so, drawers can cache data, based on revision.
+	unsigned int GetRevision() const;
+
+private:
+	// Returns true, if camera or dynamic walls moved since last update.
+	bool ViewChanged( const MapState& map_state, const m_Vec2& camera_position, float view_angle_z );
+
 private:
 	const MapDataConstPtr map_data_;
 
+	// Opaque static walls, touching each map cell. Offsets array has one extra element at end.
+	std::vector<unsigned int> cells_walls_offsets_;
+	std::vector<unsigned int> cells_walls_;
+
 	WallsVisibility static_walls_visibility_;
 	WallsVisibility dynamic_walls_visibility_;
+
+	// View of last update. Update does nothing, if view is same.
+	bool have_prev_view_= false;
+	m_Vec2 prev_camera_position_;
+	float prev_view_angle_z_= 0.0f;
+	std::vector<m_Vec2> prev_dynamic_walls_vertices_;
+
+	std::vector<unsigned int> dynamic_walls_in_view_; // Temp buffer for Update.
+
+	unsigned int revision_;
 };
 
 } // namespace PanzerChasm
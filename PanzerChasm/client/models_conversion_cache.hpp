@@ -0,0 +1,73 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../model.hpp"
+
+namespace PanzerChasm
+{
+
+// Cache of data, converted from immutable models (textures with applied palette, atlases, vertex buffers data).
+// Converted data is shared between all drawers in process, so, models are not converted again after drawers recreation
+// or after map reloading. Converted data lives while source models owner (map data, game resources) lives.
+// Thread-safe.
+template<class T>
+class ModelsConversionCache final
+{
+public:
+	typedef std::shared_ptr<const T> DataConstPtr;
+	typedef std::function< void( const std::vector<Model>& models, T& out_data ) > ConvertFunc;
+
+	// "models" must belong to "models_owner". "params" - all parameters of conversion, which affect result.
+	DataConstPtr Get(
+		const std::shared_ptr<const void>& models_owner,
+		const std::vector<Model>& models,
+		const unsigned int params,
+		const ConvertFunc& convert_func )
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+
+		// Drop data for destroyed models.
+		entries_.erase(
+			std::remove_if(
+				entries_.begin(), entries_.end(),
+				[]( const Entry& entry ) { return entry.models_owner.expired(); } ),
+			entries_.end() );
+
+		for( const Entry& entry : entries_ )
+		{
+			if( entry.models == &models && entry.params == params )
+				return entry.data;
+		}
+
+		const std::shared_ptr<T> data= std::make_shared<T>();
+		convert_func( models, *data );
+
+		entries_.emplace_back();
+		Entry& entry= entries_.back();
+		entry.models_owner= models_owner;
+		entry.models= &models;
+		entry.params= params;
+		entry.data= data;
+
+		return data;
+	}
+
+private:
+	struct Entry
+	{
+		std::weak_ptr<const void> models_owner;
+		const std::vector<Model>* models;
+		unsigned int params;
+		DataConstPtr data;
+	};
+
+private:
+	std::mutex mutex_;
+	std::vector<Entry> entries_;
+};
+
+} // namespace PanzerChasm
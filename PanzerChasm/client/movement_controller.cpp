@@ -16,38 +16,65 @@ using KeyCode= SystemEvent::KeyEvent::KeyCode;
 class KeyChecker
 {
 public:
-	KeyChecker( Settings& settings, const KeyboardState& keyboard_state )
+	KeyChecker( const Settings& settings, const KeyboardState& keyboard_state )
 		: settings_(settings), keyboard_state_(keyboard_state)
 	{}
 
-	bool operator()( const char* const key_setting_name, const KeyCode default_value ) const
+	bool operator()( const Settings::IntHandle key_setting ) const
 	{
-		const KeyCode key= static_cast<KeyCode>( settings_.GetOrSetInt( key_setting_name, static_cast<int>(default_value) ) );
+		const KeyCode key= static_cast<KeyCode>( settings_.Get( key_setting ) );
 		if( key > KeyCode::Unknown && key < KeyCode::KeyCount )
 			return keyboard_state_[ static_cast<unsigned int>( key ) ];
 		return false;
 	}
 
 private:
-	Settings& settings_;
+	const Settings& settings_;
 	const KeyboardState& keyboard_state_;
 };
 
+MovementController::SettingsHandles::SettingsHandles( Settings& settings )
+	: key_forward( settings.RegisterInt( SettingsKeys::key_forward, static_cast<int>(KeyCode::W) ) )
+	, key_backward( settings.RegisterInt( SettingsKeys::key_backward, static_cast<int>(KeyCode::S) ) )
+	, key_step_left( settings.RegisterInt( SettingsKeys::key_step_left, static_cast<int>(KeyCode::A) ) )
+	, key_step_right( settings.RegisterInt( SettingsKeys::key_step_right, static_cast<int>(KeyCode::D) ) )
+	, key_turn_left( settings.RegisterInt( SettingsKeys::key_turn_left, static_cast<int>(KeyCode::Left) ) )
+	, key_turn_right( settings.RegisterInt( SettingsKeys::key_turn_right, static_cast<int>(KeyCode::Right) ) )
+	, key_look_up( settings.RegisterInt( SettingsKeys::key_look_up, static_cast<int>(KeyCode::Up) ) )
+	, key_look_down( settings.RegisterInt( SettingsKeys::key_look_down, static_cast<int>(KeyCode::Down) ) )
+	, key_jump( settings.RegisterInt( SettingsKeys::key_jump, static_cast<int>(KeyCode::Space) ) )
+	, fov( settings.RegisterFloat( SettingsKeys::fov, 90.0f ) )
+	, old_style_perspective( settings.RegisterBool( SettingsKeys::old_style_perspective, false ) )
+	, mouse_sensetivity( settings.RegisterFloat( SettingsKeys::mouse_sensetivity, 0.5f ) )
+	, mouse_filter( settings.RegisterBool( "cl_mouse_filter", true ) )
+	, mouse_acceleration( settings.RegisterBool( "cl_mouse_acceleration", true ) )
+	, reverse_mouse( settings.RegisterBool( SettingsKeys::reverse_mouse, false ) )
+{}
+
 MovementController::MovementController(
 	Settings& settings,
 	const m_Vec3& angle,
 	float aspect )
 	: settings_( settings )
+	, settings_handles_( settings )
 	, angle_(angle), aspect_(aspect)
 	, speed_(0.0f)
-	, start_tick_( Time::CurrentTime() )
-	, prev_calc_tick_( Time::CurrentTime() )
+	, start_tick_( Time::FrameTime() )
+	, prev_calc_tick_( Time::FrameTime() )
 {
+	fov_change_callback_id_=
+		settings_.AddChangeCallback( settings_handles_.fov, std::bind( &MovementController::UpdateParams, this ) );
+	old_style_perspective_change_callback_id_=
+		settings_.AddChangeCallback( settings_handles_.old_style_perspective, std::bind( &MovementController::UpdateParams, this ) );
+
 	UpdateParams();
 }
 
 MovementController::~MovementController()
-{}
+{
+	settings_.RemoveChangeCallback( fov_change_callback_id_ );
+	settings_.RemoveChangeCallback( old_style_perspective_change_callback_id_ );
+}
 
 void MovementController::SetAspect( const float aspect )
 {
@@ -56,18 +83,18 @@ void MovementController::SetAspect( const float aspect )
 
 void MovementController::UpdateParams()
 {
-	fov_= settings_.GetOrSetFloat( SettingsKeys::fov, 90.0f );
-	fov_= std::max( 10.0f, std::min( fov_, 150.0f ) );
-	settings_.SetSetting( SettingsKeys::fov, fov_ );
+	is_old_style_perspective_= settings_.Get( settings_handles_.old_style_perspective );
 
-	is_old_style_perspective_= settings_.GetOrSetBool( SettingsKeys::old_style_perspective, false );
+	fov_= std::max( 10.0f, std::min( settings_.Get( settings_handles_.fov ), 150.0f ) );
+	if( fov_ != settings_.Get( settings_handles_.fov ) )
+		settings_.SetSetting( SettingsKeys::fov, fov_ ); // Calls this method again.
 
 	ClipCameraAngles();
 }
 
 void MovementController::Tick( const KeyboardState& keyboard_state )
 {
-	const Time new_tick= Time::CurrentTime();
+	const Time new_tick= Time::FrameTime();
 
 	const float dt_s= ( new_tick - prev_calc_tick_ ).ToSeconds();
 
@@ -76,17 +103,17 @@ void MovementController::Tick( const KeyboardState& keyboard_state )
 	const KeyChecker key_pressed( settings_,keyboard_state );
 
 	m_Vec3 rotate_vec( 0.0f ,0.0f, 0.0f );
-	if( key_pressed( SettingsKeys::key_turn_left , KeyCode::Left  ) ) rotate_vec.z+= +1.0f;
-	if( key_pressed( SettingsKeys::key_turn_right, KeyCode::Right ) ) rotate_vec.z+= -1.0f;
-	if( key_pressed( SettingsKeys::key_look_up   , KeyCode::Up    ) ) rotate_vec.x+= +1.0f;
-	if( key_pressed( SettingsKeys::key_look_down , KeyCode::Down  ) ) rotate_vec.x+= -1.0f;
+	if( key_pressed( settings_handles_.key_turn_left ) ) rotate_vec.z+= +1.0f;
+	if( key_pressed( settings_handles_.key_turn_right ) ) rotate_vec.z+= -1.0f;
+	if( key_pressed( settings_handles_.key_look_up ) ) rotate_vec.x+= +1.0f;
+	if( key_pressed( settings_handles_.key_look_down ) ) rotate_vec.x+= -1.0f;
 
 	const float rot_speed= 1.75f;
 	angle_+= dt_s * rot_speed * rotate_vec;
 	
 	ClipCameraAngles();
 
-	jump_pressed_= key_pressed( SettingsKeys::key_jump, KeyCode::Space );
+	jump_pressed_= key_pressed( settings_handles_.key_jump );
 }
 
 void MovementController::SetSpeed( const float speed )
@@ -108,10 +135,10 @@ void MovementController::GetAcceleration(
 
 	const KeyChecker key_pressed( settings_,keyboard_state );
 
-	if( key_pressed( SettingsKeys::key_forward   , KeyCode::W ) ) move_vector.y+= +1.0f;
-	if( key_pressed( SettingsKeys::key_backward  , KeyCode::S ) ) move_vector.y+= -1.0f;
-	if( key_pressed( SettingsKeys::key_step_left , KeyCode::A ) ) move_vector.x+= -1.0f;
-	if( key_pressed( SettingsKeys::key_step_right, KeyCode::D ) ) move_vector.x+= +1.0f;
+	if( key_pressed( settings_handles_.key_forward ) ) move_vector.y+= +1.0f;
+	if( key_pressed( settings_handles_.key_backward ) ) move_vector.y+= -1.0f;
+	if( key_pressed( settings_handles_.key_step_left ) ) move_vector.x+= -1.0f;
+	if( key_pressed( settings_handles_.key_step_right ) ) move_vector.x+= +1.0f;
 
 	m_Mat4 move_vector_rot_mat;
 	move_vector_rot_mat.RotateZ( angle_.z );
@@ -265,12 +292,12 @@ bool MovementController::JumpPressed() const
 
 void MovementController::ControllerRotate( const int delta_x, const int delta_z )
 {
-	float base_sensetivity= settings_.GetOrSetFloat( SettingsKeys::mouse_sensetivity, 0.5f );
-	base_sensetivity= std::max( 0.0f, std::min( base_sensetivity, 1.0f ) );
-	settings_.SetSetting( SettingsKeys::mouse_sensetivity, base_sensetivity );
+	const float base_sensetivity= std::max( 0.0f, std::min( settings_.Get( settings_handles_.mouse_sensetivity ), 1.0f ) );
+	if( base_sensetivity != settings_.Get( settings_handles_.mouse_sensetivity ) )
+		settings_.SetSetting( SettingsKeys::mouse_sensetivity, base_sensetivity );
 
 	float d_x_f, d_z_f;
-	if( settings_.GetOrSetBool( "cl_mouse_filter", true ) )
+	if( settings_.Get( settings_handles_.mouse_filter ) )
 	{
 		d_x_f= float( delta_x + prev_controller_delta_x_ ) * 0.5f;
 		d_z_f= float( delta_z + prev_controller_delta_z_ ) * 0.5f;
@@ -281,7 +308,7 @@ void MovementController::ControllerRotate( const int delta_x, const int delta_z
 		d_z_f= float(delta_z);
 	}
 
-	if( settings_.GetOrSetBool( "cl_mouse_acceleration", true ) )
+	if( settings_.Get( settings_handles_.mouse_acceleration ) )
 	{
 		const float c_acceleration= 0.25f;
 		const float c_max_acceleration_factor= 2.0f;
@@ -293,7 +320,7 @@ void MovementController::ControllerRotate( const int delta_x, const int delta_z
 	const float exp_sensetivity= std::exp( base_sensetivity * std::log(c_max_exp_sensetivity) ); // [ 1; c_max_exp_sensetivity ]
 
 	const float c_pix_scale= 1.0f / 1024.0f;
-	const float z_direction= settings_.GetOrSetBool( SettingsKeys::reverse_mouse ) ? -1.0f : +1.0f;
+	const float z_direction= settings_.Get( settings_handles_.reverse_mouse ) ? -1.0f : +1.0f;
 
 	angle_.x-= exp_sensetivity * c_pix_scale * d_x_f * z_direction;
 	angle_.z-= exp_sensetivity * c_pix_scale * d_z_f * 0.5f;
@@ -4,6 +4,7 @@
 #include <matrix.hpp>
 
 #include "../fwd.hpp"
+#include "../settings.hpp"
 #include "i_map_drawer.hpp"
 #include "math_utils.hpp"
 #include "system_event.hpp"
@@ -20,6 +21,9 @@ public:
 		const m_Vec3& angle= m_Vec3(0.0f, 0.0f, 0.0f),
 		float aspect= 1.0f );
 
+	MovementController( const MovementController& )= delete;
+	MovementController& operator=( const MovementController& )= delete;
+
 	~MovementController();
 
 	void SetAspect( float aspect );
@@ -52,13 +56,32 @@ public:
 private:
 	void ClipCameraAngles();
 
+private:
+	// Handles of settings, which are read each frame.
+	struct SettingsHandles
+	{
+		explicit SettingsHandles( Settings& settings );
+
+		Settings::IntHandle key_forward, key_backward, key_step_left, key_step_right;
+		Settings::IntHandle key_turn_left, key_turn_right, key_look_up, key_look_down;
+		Settings::IntHandle key_jump;
+
+		Settings::FloatHandle fov;
+		Settings::BoolHandle old_style_perspective;
+
+		Settings::FloatHandle mouse_sensetivity;
+		Settings::BoolHandle mouse_filter, mouse_acceleration, reverse_mouse;
+	};
+
 private:
 	Settings& settings_;
+	const SettingsHandles settings_handles_;
+	unsigned int fov_change_callback_id_, old_style_perspective_change_callback_id_;
 
 	m_Vec3 angle_;
 	float aspect_;
 
-	// Settings variables. Fetch it once per frame.
+	// Settings variables. Updated on settings change.
 	float fov_; // Degrees
 	bool is_old_style_perspective_;
 
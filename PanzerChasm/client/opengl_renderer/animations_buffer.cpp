@@ -5,7 +5,7 @@
 namespace PanzerChasm
 {
 
-AnimationsBuffer AnimationsBuffer::AsTextureBuffer( Model::AnimationsVertices& vertices )
+AnimationsBuffer AnimationsBuffer::AsTextureBuffer( const Model::AnimationsVertices& vertices )
 {
 	AnimationsBuffer result;
 
@@ -18,22 +18,63 @@ AnimationsBuffer AnimationsBuffer::AsTextureBuffer( Model::AnimationsVertices& v
 	return result;
 }
 
-AnimationsBuffer AnimationsBuffer::As2dTexture( Model::AnimationsVertices& vertices )
+AnimationsBuffer AnimationsBuffer::As2dTexture( const Model::AnimationsVertices& vertices )
 {
 	AnimationsBuffer result;
 
 	const unsigned int height= ( vertices.size() + (c_2d_texture_width-1u) ) / c_2d_texture_width;
 
-	// Resize vector. We must have valid memory block of size width * height.
-	const Model::AnimationVertex zero_vertex{ 0, 0, 0, 0 };
-	vertices.resize( c_2d_texture_width * height, zero_vertex );
+	// We must have valid memory block of size width * height. Make resized copy, if needed.
+	Model::AnimationsVertices vertices_resized;
+	const Model::AnimationsVertices* texture_vertices= &vertices;
+	if( vertices.size() < c_2d_texture_width * height )
+	{
+		const Model::AnimationVertex zero_vertex{ 0, 0, 0, 0 };
+		vertices_resized= vertices;
+		vertices_resized.resize( c_2d_texture_width * height, zero_vertex );
+		texture_vertices= &vertices_resized;
+	}
 
 	result.texture_2d_=
 		r_Texture(
 			r_Texture::PixelFormat::RGBA16I,
 			c_2d_texture_width,
 			height,
-			reinterpret_cast<const unsigned char*>(vertices.data()) );
+			reinterpret_cast<const unsigned char*>(texture_vertices->data()) );
+
+	result.texture_2d_.SetFiltration( r_Texture::Filtration::Nearest, r_Texture::Filtration::Nearest );
+
+	return result;
+}
+
+AnimationsBuffer AnimationsBuffer::AsTextureBuffer( const std::vector<uint32_t>& packed_words )
+{
+	AnimationsBuffer result;
+
+	result.buffer_texture_=
+		r_BufferTexture(
+			r_Texture::PixelFormat::RGBA8,
+			packed_words.size() * sizeof(uint32_t),
+			packed_words.data() );
+
+	return result;
+}
+
+AnimationsBuffer AnimationsBuffer::As2dTexture( const std::vector<uint32_t>& packed_words )
+{
+	AnimationsBuffer result;
+
+	const unsigned int height= ( packed_words.size() + (c_2d_texture_width-1u) ) / c_2d_texture_width;
+
+	std::vector<uint32_t> words_resized= packed_words;
+	words_resized.resize( c_2d_texture_width * height, 0u );
+
+	result.texture_2d_=
+		r_Texture(
+			r_Texture::PixelFormat::RGBA8,
+			c_2d_texture_width,
+			height,
+			reinterpret_cast<const unsigned char*>(words_resized.data()) );
 
 	result.texture_2d_.SetFiltration( r_Texture::Filtration::Nearest, r_Texture::Filtration::Nearest );
 
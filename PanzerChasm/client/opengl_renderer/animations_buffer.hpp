@@ -14,8 +14,12 @@ public:
 	static constexpr unsigned int c_2d_texture_width= 1024u;
 
 	// Functions can modyfy input vertices vector.
-	static AnimationsBuffer AsTextureBuffer( Model::AnimationsVertices& vertices );
-	static AnimationsBuffer As2dTexture( Model::AnimationsVertices& vertices  );
+	static AnimationsBuffer AsTextureBuffer( const Model::AnimationsVertices& vertices );
+	static AnimationsBuffer As2dTexture( const Model::AnimationsVertices& vertices  );
+
+	// Packed 32-bit words of compressed animations, stored as RGBA8 texels.
+	static AnimationsBuffer AsTextureBuffer( const std::vector<uint32_t>& packed_words );
+	static AnimationsBuffer As2dTexture( const std::vector<uint32_t>& packed_words );
 
 	AnimationsBuffer();
 	AnimationsBuffer( AnimationsBuffer&& other );
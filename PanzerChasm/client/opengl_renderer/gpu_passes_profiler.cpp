@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <utility>
+
+#include "../../assert.hpp"
+
+#include "gpu_passes_profiler.hpp"
+
+namespace PanzerChasm
+{
+
+GPUPassesProfiler::GPUPassesProfiler( std::vector<std::string> passes_names )
+	: passes_names_( std::move(passes_names) )
+	, passes_time_( passes_names_.size(), 0u )
+{}
+
+GPUPassesProfiler::~GPUPassesProfiler()
+{
+	for( FrameQueries& frame_queries : frames_queries_ )
+	for( const PassQuery& query : frame_queries.queries )
+		glDeleteQueries( 1, &query.query_id );
+}
+
+void GPUPassesProfiler::BeginFrame()
+{
+	PC_ASSERT( !pass_active_ );
+
+	// Queries of current frame slot were issued "c_frames_in_flight" frames ago.
+	current_frame_= ( current_frame_ + 1u ) % c_frames_in_flight;
+	FrameQueries& frame_queries= frames_queries_[ current_frame_ ];
+
+	ReadResults( frame_queries );
+	frame_queries.used_queries= 0u;
+}
+
+void GPUPassesProfiler::BeginPass( const unsigned int pass_index )
+{
+	PC_ASSERT( pass_index < passes_names_.size() );
+	PC_ASSERT( !pass_active_ );
+
+	FrameQueries& frame_queries= frames_queries_[ current_frame_ ];
+	if( frame_queries.used_queries == frame_queries.queries.size() )
+	{
+		PassQuery query;
+		glGenQueries( 1, &query.query_id );
+		frame_queries.queries.push_back( query );
+	}
+
+	PassQuery& query= frame_queries.queries[ frame_queries.used_queries ];
+	frame_queries.used_queries++;
+
+	query.pass_index= pass_index;
+	glBeginQuery( GL_TIME_ELAPSED, query.query_id );
+	pass_active_= true;
+}
+
+void GPUPassesProfiler::EndPass()
+{
+	PC_ASSERT( pass_active_ );
+
+	glEndQuery( GL_TIME_ELAPSED );
+	pass_active_= false;
+}
+
+GLuint64 GPUPassesProfiler::GetTotalTime() const
+{
+	GLuint64 total_time= 0u;
+	for( const GLuint64 time : passes_time_ )
+		total_time+= time;
+	return total_time;
+}
+
+void GPUPassesProfiler::GetStats( std::vector<std::string>& out_lines ) const
+{
+	GLuint64 total_time= 0u;
+	char str[128];
+	for( unsigned int i= 0u; i < passes_names_.size(); i++ )
+	{
+		std::snprintf(
+			str, sizeof(str), "gpu %s: %.3f ms",
+			passes_names_[i].c_str(), double(passes_time_[i]) / 1000000.0 );
+		out_lines.emplace_back( str );
+
+		total_time+= passes_time_[i];
+	}
+
+	std::snprintf( str, sizeof(str), "gpu total: %.3f ms", double(total_time) / 1000000.0 );
+	out_lines.emplace_back( str );
+}
+
+void GPUPassesProfiler::ReadResults( FrameQueries& frame_queries )
+{
+	if( frame_queries.used_queries == 0u )
+		return;
+
+	// Queries are finished in order, so, it is enough to check last query.
+	GLint available= 0;
+	glGetQueryObjectiv(
+		frame_queries.queries[ frame_queries.used_queries - 1u ].query_id,
+		GL_QUERY_RESULT_AVAILABLE,
+		&available );
+	if( available == 0 )
+		return;
+
+	for( GLuint64& time : passes_time_ )
+		time= 0u;
+
+	for( unsigned int i= 0u; i < frame_queries.used_queries; i++ )
+	{
+		const PassQuery& query= frame_queries.queries[i];
+
+		GLuint64 time= 0u;
+		glGetQueryObjectui64v( query.query_id, GL_QUERY_RESULT, &time );
+		passes_time_[ query.pass_index ]+= time;
+	}
+}
+
+} // namespace PanzerChasm
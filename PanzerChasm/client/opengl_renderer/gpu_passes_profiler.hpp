@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <panzer_ogl_lib.hpp>
+
+namespace PanzerChasm
+{
+
+// Measures GPU time of rendering passes, using GL_TIME_ELAPSED queries.
+// Queries of frame are read back two frames later, so, reading does not stall pipeline.
+// If results are still not available, they are dropped and previous results are kept.
+// Pass can be measured several times per frame - times are summed.
+// Only one pass can be active at same time.
+class GPUPassesProfiler final
+{
+public:
+	explicit GPUPassesProfiler( std::vector<std::string> passes_names );
+	GPUPassesProfiler( const GPUPassesProfiler& other )= delete;
+	~GPUPassesProfiler();
+
+	GPUPassesProfiler& operator=( const GPUPassesProfiler& other )= delete;
+
+	// Call it before first pass of frame.
+	void BeginFrame();
+
+	void BeginPass( unsigned int pass_index );
+	void EndPass();
+
+	// Total time of all passes of last frame with available results, in nanoseconds.
+	GLuint64 GetTotalTime() const;
+
+	// Adds lines with passes times to output.
+	void GetStats( std::vector<std::string>& out_lines ) const;
+
+private:
+	static constexpr unsigned int c_frames_in_flight= 2u;
+
+	struct PassQuery
+	{
+		GLuint query_id;
+		unsigned int pass_index;
+	};
+
+	struct FrameQueries
+	{
+		std::vector<PassQuery> queries;
+		unsigned int used_queries= 0u;
+	};
+
+private:
+	void ReadResults( FrameQueries& frame_queries );
+
+private:
+	const std::vector<std::string> passes_names_;
+
+	FrameQueries frames_queries_[ c_frames_in_flight ];
+	unsigned int current_frame_= 0u;
+	bool pass_active_= false;
+
+	// Time in nanoseconds.
+	std::vector<GLuint64> passes_time_;
+};
+
+} // namespace PanzerChasm
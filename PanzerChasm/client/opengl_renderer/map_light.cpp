@@ -1,10 +1,16 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
 
 #include <ogl_state_manager.hpp>
 
+#include "../../cache_files.hpp"
 #include "../../game_resources.hpp"
+#include "../../log.hpp"
 #include "../../map_loader.hpp"
 #include "../../math_utils.hpp"
+#include "../../save_load.hpp"
 #include "../map_state.hpp"
 
 #include "map_light.hpp"
@@ -12,6 +18,8 @@
 namespace PanzerChasm
 {
 
+const char MapLight::BaseLightmapsCacheHeader::c_expected_id[8]= "PanLmap";
+
 namespace
 {
 
@@ -26,6 +34,10 @@ const Size2 g_walls_lightmap_atlas_size(
 	MapData::c_map_size * g_wall_lightmap_size,
 	MapData::c_map_size );
 
+// Shadowmaps of static lights are packed into atlas. Lights, which do not fit, use common shadowmap.
+const int g_shadowmaps_atlas_width= 2048;
+const int g_shadowmaps_atlas_max_height= 4096;
+
 const float g_lightmap_clear_color[4u]= { 0.0f, 0.0f, 0.0f, 0.0f };
 const GLenum g_gl_state_blend_func[2]= { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
 
@@ -59,9 +71,11 @@ static void CreateFullbrightLightmapDummy( r_Texture& texture, const bool use_hd
 MapLight::MapLight(
 	const GameResourcesConstPtr& game_resources,
 	const RenderingContextGL& rendering_context,
-	const bool use_hd_dynamic_lightmap )
+	const bool use_hd_dynamic_lightmap,
+	const bool use_geometry_shaders )
 	: game_resources_(game_resources)
 	, use_hd_dynamic_lightmap_(use_hd_dynamic_lightmap)
+	, use_geometry_shaders_(use_geometry_shaders)
 {
 	PC_ASSERT( game_resources_ != nullptr );
 
@@ -130,11 +144,18 @@ MapLight::MapLight(
 		rLoadShader( "texture_copy_v.glsl", rendering_context.glsl_version ) );
 	copy_shader_.Create();
 
-	shadowmap_shader_.ShaderSource(
-		rLoadShader( "shadowmap_f.glsl", rendering_context.glsl_version ),
-		rLoadShader( "shadowmap_v.glsl", rendering_context.glsl_version ),
-		rLoadShader( "shadowmap_g.glsl", rendering_context.glsl_version ) );
+	const std::vector<std::string> no_geometry_shader_defines{ "NO_GEOMETRY_SHADER" };
+	if( use_geometry_shaders_ )
+		shadowmap_shader_.ShaderSource(
+			rLoadShader( "shadowmap_f.glsl", rendering_context.glsl_version ),
+			rLoadShader( "shadowmap_v.glsl", rendering_context.glsl_version ),
+			rLoadShader( "shadowmap_g.glsl", rendering_context.glsl_version ) );
+	else
+		shadowmap_shader_.ShaderSource(
+			rLoadShader( "shadowmap_f.glsl", rendering_context.glsl_version ),
+			rLoadShader( "shadowmap_v.glsl", rendering_context.glsl_version, no_geometry_shader_defines ) );
 	shadowmap_shader_.SetAttribLocation( "pos", 0u );
+	shadowmap_shader_.SetAttribLocation( "extrude", 1u );
 	shadowmap_shader_.Create();
 }
 
@@ -154,7 +175,7 @@ void MapLight::SetMap( const MapDataConstPtr& map_data )
 			r_Texture(
 				r_Texture::PixelFormat::R8,
 				MapData::c_lightmap_size, MapData::c_lightmap_size,
-				map_data->lightmap );
+				map_data->lightmap.data() );
 		static_lightmap_.SetFiltration( r_Texture::Filtration::Nearest, r_Texture::Filtration::Nearest );
 
 		return;
@@ -164,8 +185,8 @@ void MapLight::SetMap( const MapDataConstPtr& map_data )
 
 	// Occludders buffer.
 	r_PolygonBuffer walls_buffer;
+	std::vector<short> vertices;
 	{
-		std::vector<short> vertices;
 
 		for( const MapData::Wall& wall : map_data_->static_walls )
 		{
@@ -183,28 +204,108 @@ void MapLight::SetMap( const MapDataConstPtr& map_data )
 			v[3]= static_cast<short>( wall.vert_pos[1].y * 256.0f );
 		}
 
-		walls_buffer.VertexData( vertices.data(), vertices.size() * sizeof(short), sizeof(short) * 2u );
-		walls_buffer.VertexAttribPointer( 0, 2, GL_SHORT, false, 0 );
-		walls_buffer.SetPrimitiveType( GL_LINES );
+		if( use_geometry_shaders_ )
+		{
+			walls_buffer.VertexData( vertices.data(), vertices.size() * sizeof(short), sizeof(short) * 2u );
+			walls_buffer.VertexAttribPointer( 0, 2, GL_SHORT, false, 0 );
+			walls_buffer.SetPrimitiveType( GL_LINES );
+		}
+		else
+		{
+			// Each segment becomes two triangles, same, as in geometry shader. Vertices - x, y, extrude flag, padding.
+			const unsigned int segment_count= vertices.size() / 4u;
+			std::vector<short> extruded_vertices( segment_count * 4u * 4u );
+			std::vector<unsigned short> indeces( segment_count * 6u );
+			for( unsigned int s= 0u; s < segment_count; s++ )
+			{
+				const short* const in_v= vertices.data() + s * 4u;
+				short* const v= extruded_vertices.data() + s * 16u;
+				for( unsigned int j= 0u; j < 4u; j++ )
+				{
+					v[ j * 4u + 0u ]= in_v[ ( j & 1u ) * 2u + 0u ];
+					v[ j * 4u + 1u ]= in_v[ ( j & 1u ) * 2u + 1u ];
+					v[ j * 4u + 2u ]= short( j >> 1u );
+					v[ j * 4u + 3u ]= 0;
+				}
+
+				unsigned short* const ind= indeces.data() + s * 6u;
+				const unsigned int first_vertex= s * 4u;
+				ind[0]= first_vertex + 0u; ind[1]= first_vertex + 1u; ind[2]= first_vertex + 2u;
+				ind[3]= first_vertex + 1u; ind[4]= first_vertex + 3u; ind[5]= first_vertex + 2u;
+			}
+
+			walls_buffer.VertexData( extruded_vertices.data(), extruded_vertices.size() * sizeof(short), sizeof(short) * 4u );
+			walls_buffer.IndexData( indeces.data(), indeces.size() * sizeof(unsigned short), GL_UNSIGNED_SHORT, GL_TRIANGLES );
+			walls_buffer.VertexAttribPointer( 0, 2, GL_SHORT, false, 0 );
+			walls_buffer.VertexAttribPointer( 1, 1, GL_SHORT, false, sizeof(short) * 2u );
+		}
 	}
 
-	base_floor_lightmap_.Bind();
-	r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-	glClear( GL_COLOR_BUFFER_BIT );
+	// Base lightmaps depend on occluders, walls lightmap layout and static lights. Key cache by them.
+	const unsigned int map_hash=
+		SaveHeader::CalculateHash(
+			reinterpret_cast<const unsigned char*>( vertices.data() ),
+			vertices.size() * sizeof(short) ) ^
+		( SaveHeader::CalculateHash(
+			reinterpret_cast<const unsigned char*>( walls_vertices_.data() ),
+			walls_vertices_.size() * sizeof(WallVertex) ) * 31u ) ^
+		( SaveHeader::CalculateHash(
+			reinterpret_cast<const unsigned char*>( map_data_->lights.data() ),
+			map_data_->lights.size() * sizeof(MapData::Light) ) * 961u );
+
+	char cache_file_name[64];
+	std::snprintf(
+		cache_file_name, sizeof(cache_file_name),
+		CACHE_FILES_DIR"/lightmaps_%08x_%u.pcl", map_hash, static_cast<unsigned int>( map_data_->lights.size() ) );
+
+	const bool base_lightmaps_loaded= LoadBaseLightmapsFromCache( cache_file_name, map_hash );
+	if( !base_lightmaps_loaded )
+	{
+		base_floor_lightmap_.Bind();
+		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+		glClear( GL_COLOR_BUFFER_BIT );
 
-	base_walls_lightmap_.Bind();
-	r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-	glClear( GL_COLOR_BUFFER_BIT );
+		base_walls_lightmap_.Bind();
+		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+		glClear( GL_COLOR_BUFFER_BIT );
+	}
 
-	for( const MapData::Light& light : map_data_->lights )
+	// Shadowmaps of static lights are still needed for lighting of dynamic walls, so, build them even if base lightmaps are loaded.
+	PlaceLightsShadowmaps();
+	if( shadowmaps_atlas_height_ > 0 )
 	{
+		shadowmaps_atlas_.Bind();
+		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+		glClear( GL_COLOR_BUFFER_BIT );
+	}
+
+	for( unsigned int l= 0u; l < map_data_->lights.size(); l++ )
+	{
+		const MapData::Light& light= map_data_->lights[l];
 		if( light.power <= 1.0f )
 			continue;
 
-		// Bind and clear shadowmam.
-		shadowmap_.Bind();
-		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-		glClear( GL_COLOR_BUFFER_BIT );
+		const LightShadowmap& light_shadowmap= lights_shadowmaps_[l];
+		if( base_lightmaps_loaded && !light_shadowmap.in_atlas )
+			continue; // Common shadowmap is needed only for light pass.
+
+		if( light_shadowmap.in_atlas )
+		{
+			// Shift viewport, so light region of shadowmap lands into place of light in atlas.
+			shadowmaps_atlas_.Bind();
+			r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+			glViewport(
+				light_shadowmap.atlas_x - light_shadowmap.region_x,
+				light_shadowmap.atlas_y - light_shadowmap.region_y,
+				shadowmap_.Width(), shadowmap_.Height() );
+		}
+		else
+		{
+			// Bind and clear shadowmam.
+			shadowmap_.Bind();
+			r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+			glClear( GL_COLOR_BUFFER_BIT );
+		}
 
 		// Draw walls into shadowmap.
 		shadowmap_shader_.Bind();
@@ -225,37 +326,44 @@ void MapLight::SetMap( const MapDataConstPtr& map_data )
 		// Draw occluders with scissor test.
 		// We can not just extend polygons in geometry shaer, ising light radius.
 		glEnable( GL_SCISSOR_TEST );
-		{
-			const unsigned int shadowmap_scale= shadowmap_.GetTextures().front().Width() / MapData::c_map_size;
-			const int center_x= int( light.pos.x * float(shadowmap_scale) );
-			const int center_y= int( light.pos.y * float(shadowmap_scale) );
-			const int radius= int( light.outer_radius * float(shadowmap_scale) ) + 4;
-			glScissor( center_x - radius, center_y - radius, radius * 2, radius * 2 );
-		}
+		if( light_shadowmap.in_atlas )
+			glScissor( light_shadowmap.atlas_x, light_shadowmap.atlas_y, light_shadowmap.size, light_shadowmap.size );
+		else
+			glScissor( light_shadowmap.region_x, light_shadowmap.region_y, light_shadowmap.size, light_shadowmap.size );
 		walls_buffer.Draw();
 		glDisable( GL_SCISSOR_TEST );
 
+		if( base_lightmaps_loaded )
+			continue;
+
 		r_OGLStateManager::UpdateState( g_light_pass_state );
 
 		// Add light to floor lightmap.
 		base_floor_lightmap_.Bind();
 		floor_light_pass_shader_.Bind();
-		DrawFloorLight( light );
+		DrawFloorLight( light, &light_shadowmap );
 
 		// Add light to walls lightmap.
 		base_walls_lightmap_.Bind();
 		walls_light_pass_shader_.Bind();
-		DrawWallsLight( light );
+		DrawWallsLight( light, &light_shadowmap );
 	}
 
+	if( !base_lightmaps_loaded )
+		SaveBaseLightmapsToCache( cache_file_name, map_hash );
+
 	r_Framebuffer::BindScreenFramebuffer();
 
+	final_lightmaps_valid_= false;
+	floor_lit_rects_.clear();
+	walls_lit_flags_.clear();
+
 	// Update ambient light texture.
 	ambient_lightmap_texture_=
 		r_Texture(
 			r_Texture::PixelFormat::R8,
 			MapData::c_map_size, MapData::c_map_size,
-			map_data->ambient_lightmap );
+			map_data->ambient_lightmap.data() );
 	ambient_lightmap_texture_.SetFiltration( r_Texture::Filtration::Nearest, r_Texture::Filtration::Nearest );
 }
 
@@ -324,113 +432,213 @@ void MapLight::Update( const MapState& map_state )
 		}
 	};
 
-	// Clear shadowmap.
-	shadowmap_.Bind();
-	r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-	glClear( GL_COLOR_BUFFER_BIT );
+	dynamic_lights_.clear();
+	for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
+	{
+		MapData::Light light;
+		if( gen_light_for_rocket( rocket_value.second, light ) )
+			dynamic_lights_.push_back( light );
+	}
+	for( const MapState::LightFlash& light_flash : map_state.GetLightFlashes() )
+	{
+		MapData::Light light;
+		gen_light_for_flash( light_flash, light );
+		dynamic_lights_.push_back( light );
+	}
+	for( const MapState::LightSourcesContainer::value_type& light_source_value : map_state.GetLightSources() )
+	{
+		MapData::Light light;
+		gen_light_for_source( light_source_value.second, light );
+		dynamic_lights_.push_back( light );
+	}
+	for( const MapState::DirectedLightSourcesContainer::value_type& directed_light_source_value : map_state.GetDirectedLightSources() )
+	{
+		MapData::Light lights[ c_cone_light_circles ];
+		gen_lights_for_directed_source( directed_light_source_value.second, lights );
+		for( const MapData::Light& light : lights )
+			dynamic_lights_.push_back( light );
+	}
 
-	// Draw to floor lightmap.
-	final_floor_lightmap_.Bind();
+	// Final lightmap is base lightmap, mixed with ambient light, plus dynamic lights.
+	// Restore final lightmaps from base lightmaps only in regions, lit by dynamic lights in previous or in current frame.
+	// Also restore walls with recalculated base light.
+	const unsigned int floor_lightmap_size= final_floor_lightmap_.Width();
+	const unsigned int floor_lightmap_scale= floor_lightmap_size / MapData::c_map_size;
 
-	{ // Copy base floor lightmap.
-		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-		copy_shader_.Bind();
-		base_floor_lightmap_.GetTextures().front().Bind(0);
-		copy_shader_.Uniform( "tex", 0 );
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
-	}
+	floor_restore_rects_.clear();
+	if( final_lightmaps_valid_ )
+		floor_restore_rects_= floor_lit_rects_;
+	else
+		floor_restore_rects_.push_back( LightmapRect{ 0, 0, int(floor_lightmap_size), int(floor_lightmap_size) } );
 
-	{ // Mix with ambient light texture.
-		r_OGLStateManager::UpdateState( g_light_pass_state );
-		floor_ambient_light_pass_shader_.Bind();
-		ambient_lightmap_texture_.Bind(0);
-		floor_ambient_light_pass_shader_.Uniform( "tex", 0 );
+	floor_lit_rects_.clear();
+	for( const MapData::Light& light : dynamic_lights_ )
+	{
+		// Light quad is extended by one texel, add one more texel for filtration.
+		const float radius= ( light.outer_radius + 2.0f / float(floor_lightmap_scale) ) * float(floor_lightmap_scale);
+		const int x_min= std::max( int( std::floor( light.pos.x * float(floor_lightmap_scale) - radius ) ), 0 );
+		const int y_min= std::max( int( std::floor( light.pos.y * float(floor_lightmap_scale) - radius ) ), 0 );
+		const int x_max= std::min( int( std::ceil( light.pos.x * float(floor_lightmap_scale) + radius ) ), int(floor_lightmap_size) );
+		const int y_max= std::min( int( std::ceil( light.pos.y * float(floor_lightmap_scale) + radius ) ), int(floor_lightmap_size) );
+		if( x_min >= x_max || y_min >= y_max )
+			continue;
 
-		glBlendEquation( GL_MAX );
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
-		glBlendEquation( GL_FUNC_ADD );
+		floor_lit_rects_.push_back( LightmapRect{ x_min, y_min, x_max - x_min, y_max - y_min } );
 	}
+	floor_restore_rects_.insert( floor_restore_rects_.end(), floor_lit_rects_.begin(), floor_lit_rects_.end() );
 
-	{ // Dynamic lights.
-		r_OGLStateManager::UpdateState( g_light_pass_state );
-		floor_light_pass_shader_.Bind();
+	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
+	const unsigned int static_walls_count= map_data_->static_walls.size();
+	const unsigned int walls_count= static_walls_count + dynamic_walls.size();
 
-		for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
-		{
-			MapData::Light light;
-			if( gen_light_for_rocket( rocket_value.second, light ) )
-				DrawFloorLight( light );
-		}
-		for( const MapState::LightFlash& light_flash : map_state.GetLightFlashes() )
+	walls_restore_flags_.assign( walls_count, !final_lightmaps_valid_ );
+	for( unsigned int w= 0u; w < walls_count && w < walls_lit_flags_.size(); w++ )
+		if( walls_lit_flags_[w] )
+			walls_restore_flags_[w]= true;
+	for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
+		if( updated_dynamic_walls_flags_[w] )
+			walls_restore_flags_[ static_walls_count + w ]= true;
+
+	walls_lit_flags_.assign( walls_count, false );
+	for( const MapData::Light& light : dynamic_lights_ )
+	{
+		for( unsigned int w= 0u; w < static_walls_count; w++ )
 		{
-			MapData::Light light;
-			gen_light_for_flash( light_flash, light );
-			DrawFloorLight( light );
+			const MapData::Wall& wall= map_data_->static_walls[w];
+			if( DistanceToLineSegment( light.pos, wall.vert_pos[0], wall.vert_pos[1] ) <= light.outer_radius )
+				walls_lit_flags_[w]= walls_restore_flags_[w]= true;
 		}
-		for( const MapState::LightSourcesContainer::value_type& light_source_value : map_state.GetLightSources() )
+		for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
 		{
-			MapData::Light light;
-			gen_light_for_source( light_source_value.second, light );
-			DrawFloorLight( light );
+			const MapState::DynamicWall& wall= dynamic_walls[w];
+			if( DistanceToLineSegment( light.pos, wall.vert_pos[0], wall.vert_pos[1] ) <= light.outer_radius )
+				walls_lit_flags_[ static_walls_count + w ]= walls_restore_flags_[ static_walls_count + w ]= true;
 		}
-		for( const MapState::DirectedLightSourcesContainer::value_type& directed_light_source_value : map_state.GetDirectedLightSources() )
+	}
+
+	// Each wall has own row segment in lightmap atlas. Merge segments of neighbor walls.
+	walls_restore_rects_.clear();
+	for( unsigned int w= 0u; w < walls_count; )
+	{
+		if( !walls_restore_flags_[w] )
 		{
-			MapData::Light lights[ c_cone_light_circles ];
-			gen_lights_for_directed_source( directed_light_source_value.second, lights );
-			for( const MapData::Light& light : lights )
-				DrawFloorLight( light );
+			w++;
+			continue;
 		}
+
+		const unsigned int row= w / MapData::c_map_size;
+		const unsigned int first_wall= w;
+		while( w < walls_count && walls_restore_flags_[w] && w / MapData::c_map_size == row )
+			w++;
+
+		walls_restore_rects_.push_back(
+			LightmapRect{
+				int( ( first_wall % MapData::c_map_size ) * g_wall_lightmap_size ), int(row),
+				int( ( w - first_wall ) * g_wall_lightmap_size ), 1 } );
 	}
 
-	// Draw to walls lightmap.
-	final_walls_lightmap_.Bind();
+	final_lightmaps_valid_= true;
 
-	{ // Copy base walls lightmap.
+	if( floor_restore_rects_.empty() && walls_restore_rects_.empty() )
+		return; // Nothing changed since previous frame.
+
+	if( !dynamic_lights_.empty() )
+	{
+		// Clear shadowmap.
+		shadowmap_.Bind();
 		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
-		copy_shader_.Bind();
-		base_walls_lightmap_.GetTextures().front().Bind(0);
-		copy_shader_.Uniform( "tex", 0 );
-		glDrawArrays( GL_TRIANGLES, 0, 6 );
+		glClear( GL_COLOR_BUFFER_BIT );
 	}
 
-	{ // Mix with ambient light texture.
-		r_OGLStateManager::UpdateState( g_light_pass_state );
-		walls_ambient_light_pass_shader_.Bind();
-		ambient_lightmap_texture_.Bind(0);
-		walls_ambient_light_pass_shader_.Uniform( "tex", 0 );
+	// Draw to floor lightmap.
+	if( !floor_restore_rects_.empty() )
+	{
+		final_floor_lightmap_.Bind();
+
+		{ // Copy base floor lightmap.
+			r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+			copy_shader_.Bind();
+			base_floor_lightmap_.GetTextures().front().Bind(0);
+			copy_shader_.Uniform( "tex", 0 );
+
+			glEnable( GL_SCISSOR_TEST );
+			for( const LightmapRect& rect : floor_restore_rects_ )
+			{
+				glScissor( rect.x, rect.y, rect.width, rect.height );
+				glDrawArrays( GL_TRIANGLES, 0, 6 );
+			}
+			glDisable( GL_SCISSOR_TEST );
+		}
 
-		glBlendEquation( GL_MAX );
-		walls_vertex_buffer_.Draw();
-		glBlendEquation( GL_FUNC_ADD );
-	}
+		{ // Mix with ambient light texture.
+			r_OGLStateManager::UpdateState( g_light_pass_state );
+			floor_ambient_light_pass_shader_.Bind();
+			ambient_lightmap_texture_.Bind(0);
+			floor_ambient_light_pass_shader_.Uniform( "tex", 0 );
+
+			glBlendEquation( GL_MAX );
+			glEnable( GL_SCISSOR_TEST );
+			for( const LightmapRect& rect : floor_restore_rects_ )
+			{
+				glScissor( rect.x, rect.y, rect.width, rect.height );
+				glDrawArrays( GL_TRIANGLES, 0, 6 );
+			}
+			glDisable( GL_SCISSOR_TEST );
+			glBlendEquation( GL_FUNC_ADD );
+		}
 
-	{ // Dynamic lights.
-		r_OGLStateManager::UpdateState( g_light_pass_state );
-		walls_light_pass_shader_.Bind();
+		{ // Dynamic lights.
+			r_OGLStateManager::UpdateState( g_light_pass_state );
+			floor_light_pass_shader_.Bind();
 
-		for( const MapState::RocketsContainer::value_type& rocket_value : map_state.GetRockets() )
-		{
-			MapData::Light light;
-			if( gen_light_for_rocket( rocket_value.second, light ) )
-				DrawWallsLight( light );
+			for( const MapData::Light& light : dynamic_lights_ )
+				DrawFloorLight( light );
 		}
-		for( const MapState::LightFlash& light_flash : map_state.GetLightFlashes() )
-		{
-			MapData::Light light;
-			gen_light_for_flash( light_flash, light );
-			DrawWallsLight( light );
+	}
+
+	// Draw to walls lightmap.
+	if( !walls_restore_rects_.empty() )
+	{
+		final_walls_lightmap_.Bind();
+
+		{ // Copy base walls lightmap.
+			r_OGLStateManager::UpdateState( g_lightmap_clear_state );
+			copy_shader_.Bind();
+			base_walls_lightmap_.GetTextures().front().Bind(0);
+			copy_shader_.Uniform( "tex", 0 );
+
+			glEnable( GL_SCISSOR_TEST );
+			for( const LightmapRect& rect : walls_restore_rects_ )
+			{
+				glScissor( rect.x, rect.y, rect.width, rect.height );
+				glDrawArrays( GL_TRIANGLES, 0, 6 );
+			}
+			glDisable( GL_SCISSOR_TEST );
 		}
-		for( const MapState::LightSourcesContainer::value_type& light_source_value : map_state.GetLightSources() )
-		{
-			MapData::Light light;
-			gen_light_for_source( light_source_value.second, light );
-			DrawWallsLight( light );
+
+		{ // Mix with ambient light texture.
+			r_OGLStateManager::UpdateState( g_light_pass_state );
+			walls_ambient_light_pass_shader_.Bind();
+			ambient_lightmap_texture_.Bind(0);
+			walls_ambient_light_pass_shader_.Uniform( "tex", 0 );
+
+			// Transparent walls have segments with reverse normal in the end of buffer, so, draw whole buffer for each rect.
+			glBlendEquation( GL_MAX );
+			glEnable( GL_SCISSOR_TEST );
+			for( const LightmapRect& rect : walls_restore_rects_ )
+			{
+				glScissor( rect.x, rect.y, rect.width, rect.height );
+				walls_vertex_buffer_.Draw();
+			}
+			glDisable( GL_SCISSOR_TEST );
+			glBlendEquation( GL_FUNC_ADD );
 		}
-		for( const MapState::DirectedLightSourcesContainer::value_type& directed_light_source_value : map_state.GetDirectedLightSources() )
-		{
-			MapData::Light lights[ c_cone_light_circles ];
-			gen_lights_for_directed_source( directed_light_source_value.second, lights );
-			for( const MapData::Light& light : lights )
+
+		{ // Dynamic lights. Light is zero outside light radius, so, lit walls outside restored regions are not changed.
+			r_OGLStateManager::UpdateState( g_light_pass_state );
+			walls_light_pass_shader_.Bind();
+
+			for( const MapData::Light& light : dynamic_lights_ )
 				DrawWallsLight( light );
 		}
 	}
@@ -666,9 +874,7 @@ void MapLight::UpdateLightOnDynamicWalls( const MapState& map_state )
 		// Clear individual wall lightmap with "black" light.
 		r_OGLStateManager::UpdateState( g_lightmap_clear_state );
 
-		shadowmap_.GetTextures().front().Bind(0);
-
-		walls_light_pass_shader_.Uniform( "shadowmap", int(0) );
+		SetupShadowmap( walls_light_pass_shader_, nullptr );
 		walls_light_pass_shader_.Uniform( "light_pos", m_Vec2( 0.0f, 0.0f ));
 		walls_light_pass_shader_.Uniform( "light_power", 0.0f );
 		walls_light_pass_shader_.Uniform( "max_light_level", 0.0f );
@@ -679,12 +885,14 @@ void MapLight::UpdateLightOnDynamicWalls( const MapState& map_state )
 
 		// Add light from nearest sources.
 		r_OGLStateManager::UpdateState( g_light_pass_state );
-		for( const MapData::Light& light : map_data_->lights )
+		for( unsigned int l= 0u; l < map_data_->lights.size(); l++ )
 		{
+			const MapData::Light& light= map_data_->lights[l];
 			if( DistanceToLineSegment( light.pos, wall.vert_pos[0], wall.vert_pos[1] ) > light.outer_radius )
 				continue;
 
-			walls_light_pass_shader_.Uniform( "shadowmap", int(0) );
+			// Use cached shadowmap of static light. Only static walls cast shadows, so, it is still valid.
+			SetupShadowmap( walls_light_pass_shader_, &lights_shadowmaps_[l] );
 			walls_light_pass_shader_.Uniform( "light_pos", light.pos );
 			walls_light_pass_shader_.Uniform( "light_power", light.power * g_walls_light_scale );
 			walls_light_pass_shader_.Uniform( "max_light_level", light.max_light_level * g_walls_light_scale );
@@ -698,9 +906,184 @@ void MapLight::UpdateLightOnDynamicWalls( const MapState& map_state )
 	r_Framebuffer::BindScreenFramebuffer();
 }
 
-void MapLight::DrawFloorLight( const MapData::Light& light )
+void MapLight::PlaceLightsShadowmaps()
+{
+	const int shadowmap_scale= int( shadowmap_.Width() / MapData::c_map_size );
+
+	lights_shadowmaps_.resize( map_data_->lights.size() );
+
+	std::vector<unsigned int> sorted_lights;
+	for( unsigned int l= 0u; l < map_data_->lights.size(); l++ )
+	{
+		const MapData::Light& light= map_data_->lights[l];
+		LightShadowmap& light_shadowmap= lights_shadowmaps_[l];
+
+		const int center_x= int( light.pos.x * float(shadowmap_scale) );
+		const int center_y= int( light.pos.y * float(shadowmap_scale) );
+		const int radius= int( light.outer_radius * float(shadowmap_scale) ) + 4;
+		light_shadowmap.region_x= center_x - radius;
+		light_shadowmap.region_y= center_y - radius;
+		light_shadowmap.size= radius * 2;
+		light_shadowmap.atlas_x= light_shadowmap.atlas_y= 0;
+		light_shadowmap.in_atlas= false;
+
+		if( light.power > 1.0f && light_shadowmap.size <= g_shadowmaps_atlas_width )
+			sorted_lights.push_back(l);
+	}
+
+	// Place shadowmaps in shelves, starting from biggest.
+	std::sort(
+		sorted_lights.begin(), sorted_lights.end(),
+		[&]( const unsigned int a, const unsigned int b )
+		{
+			return lights_shadowmaps_[a].size > lights_shadowmaps_[b].size;
+		} );
+
+	int shelf_x= 0, shelf_y= 0, shelf_height= 0;
+	for( const unsigned int l : sorted_lights )
+	{
+		LightShadowmap& light_shadowmap= lights_shadowmaps_[l];
+
+		if( shelf_x + light_shadowmap.size > g_shadowmaps_atlas_width )
+		{
+			shelf_y+= shelf_height;
+			shelf_x= 0;
+			shelf_height= 0;
+		}
+		if( shelf_y + light_shadowmap.size > g_shadowmaps_atlas_max_height )
+			break;
+
+		light_shadowmap.atlas_x= shelf_x;
+		light_shadowmap.atlas_y= shelf_y;
+		light_shadowmap.in_atlas= true;
+
+		shelf_x+= light_shadowmap.size;
+		shelf_height= std::max( shelf_height, light_shadowmap.size );
+	}
+
+	shadowmaps_atlas_height_= shelf_y + shelf_height;
+	if( shadowmaps_atlas_height_ > 0 )
+		shadowmaps_atlas_=
+			r_Framebuffer(
+				{ r_Texture::PixelFormat::R8 }, r_Texture::PixelFormat::Unknown,
+				g_shadowmaps_atlas_width, shadowmaps_atlas_height_ );
+}
+
+void MapLight::SetupShadowmap( ShaderProgramGL& shader, const LightShadowmap* const light_shadowmap )
+{
+	if( light_shadowmap == nullptr || !light_shadowmap->in_atlas )
+	{
+		shadowmap_.GetTextures().front().Bind(0);
+		shader.Uniform( "shadowmap_scale", m_Vec2( 1.0f, 1.0f ) / float(MapData::c_map_size) );
+		shader.Uniform( "shadowmap_shift", m_Vec2( 0.0f, 0.0f ) );
+	}
+	else
+	{
+		// Convert world coordinates to coordinates in common shadowmap, then to coordinates in atlas.
+		const float shadowmap_scale= float( shadowmap_.Width() / MapData::c_map_size );
+		const m_Vec2 atlas_size( static_cast<float>(g_shadowmaps_atlas_width), static_cast<float>(shadowmaps_atlas_height_) );
+
+		shadowmaps_atlas_.GetTextures().front().Bind(0);
+		shader.Uniform(
+			"shadowmap_scale",
+			m_Vec2( shadowmap_scale / atlas_size.x, shadowmap_scale / atlas_size.y ) );
+		shader.Uniform(
+			"shadowmap_shift",
+			m_Vec2(
+				float( light_shadowmap->atlas_x - light_shadowmap->region_x ) / atlas_size.x,
+				float( light_shadowmap->atlas_y - light_shadowmap->region_y ) / atlas_size.y ) );
+	}
+
+	shader.Uniform( "shadowmap", int(0) );
+}
+
+bool MapLight::LoadBaseLightmapsFromCache( const char* const file_name, const unsigned int map_hash )
+{
+	const unsigned int floor_data_size= base_floor_lightmap_.Width() * base_floor_lightmap_.Height() * 4u;
+	const unsigned int walls_data_size= base_walls_lightmap_.Width() * base_walls_lightmap_.Height();
+
+	BaseLightmapsCacheHeader header;
+	std::vector<unsigned char> data;
+	if( !ReadCacheFile( file_name, &header, sizeof(BaseLightmapsCacheHeader), data ) ||
+		data.size() != floor_data_size + walls_data_size )
+		return false;
+
+	if( std::memcmp( header.id, BaseLightmapsCacheHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != BaseLightmapsCacheHeader::c_expected_version ||
+		header.map_hash != map_hash ||
+		header.floor_lightmap_size[0] != base_floor_lightmap_.Width () ||
+		header.floor_lightmap_size[1] != base_floor_lightmap_.Height() ||
+		header.walls_lightmap_size[0] != base_walls_lightmap_.Width () ||
+		header.walls_lightmap_size[1] != base_walls_lightmap_.Height() )
+		return false;
+
+	if( header.content_hash != SaveHeader::CalculateHash( data.data(), data.size() ) )
+	{
+		Log::Warning( "Lightmaps cache \"", file_name, "\" is broken" );
+		return false;
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	base_floor_lightmap_.GetTextures().front().Bind(0);
+	glTexSubImage2D(
+		GL_TEXTURE_2D, 0,
+		0, 0, base_floor_lightmap_.Width(), base_floor_lightmap_.Height(),
+		GL_RGBA, GL_UNSIGNED_BYTE, data.data() );
+
+	base_walls_lightmap_.GetTextures().front().Bind(0);
+	glTexSubImage2D(
+		GL_TEXTURE_2D, 0,
+		0, 0, base_walls_lightmap_.Width(), base_walls_lightmap_.Height(),
+		GL_RED, GL_UNSIGNED_BYTE, data.data() + floor_data_size );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	return true;
+}
+
+void MapLight::SaveBaseLightmapsToCache( const char* const file_name, const unsigned int map_hash )
+{
+	const unsigned int floor_data_size= base_floor_lightmap_.Width() * base_floor_lightmap_.Height() * 4u;
+	const unsigned int walls_data_size= base_walls_lightmap_.Width() * base_walls_lightmap_.Height();
+
+	std::vector<unsigned char> data( floor_data_size + walls_data_size );
+
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+	base_floor_lightmap_.Bind();
+	glReadPixels(
+		0, 0, base_floor_lightmap_.Width(), base_floor_lightmap_.Height(),
+		GL_RGBA, GL_UNSIGNED_BYTE, data.data() );
+
+	base_walls_lightmap_.Bind();
+	glReadPixels(
+		0, 0, base_walls_lightmap_.Width(), base_walls_lightmap_.Height(),
+		GL_RED, GL_UNSIGNED_BYTE, data.data() + floor_data_size );
+
+	glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+
+	BaseLightmapsCacheHeader header;
+	std::memcpy( header.id, BaseLightmapsCacheHeader::c_expected_id, sizeof(header.id) );
+	header.version= BaseLightmapsCacheHeader::c_expected_version;
+	header.map_hash= map_hash;
+	header.floor_lightmap_size[0]= base_floor_lightmap_.Width ();
+	header.floor_lightmap_size[1]= base_floor_lightmap_.Height();
+	header.walls_lightmap_size[0]= base_walls_lightmap_.Width ();
+	header.walls_lightmap_size[1]= base_walls_lightmap_.Height();
+	header.content_hash= SaveHeader::CalculateHash( data.data(), data.size() );
+
+	WriteCacheFile(
+		file_name,
+		{
+			{ &header, sizeof(BaseLightmapsCacheHeader) },
+			{ data.data(), data.size() },
+		} );
+}
+
+void MapLight::DrawFloorLight( const MapData::Light& light, const LightShadowmap* const light_shadowmap )
 {
-	shadowmap_.GetTextures().front().Bind(0);
+	SetupShadowmap( floor_light_pass_shader_, light_shadowmap );
 
 	const float lightmap_texel_size= float( MapData::c_map_size ) / float( base_floor_lightmap_.Width() );
 	const float half_map_size= 0.5f * float(MapData::c_map_size);
@@ -719,7 +1102,6 @@ void MapLight::DrawFloorLight( const MapData::Light& light )
 	world_mat= world_scale_mat * world_shift_mat;
 	viewport_mat= viewport_scale_mat * viewport_shift_mat;
 
-	floor_light_pass_shader_.Uniform( "shadowmap", int(0) );
 	floor_light_pass_shader_.Uniform( "view_matrix", viewport_mat );
 	floor_light_pass_shader_.Uniform( "world_matrix", world_mat );
 	floor_light_pass_shader_.Uniform( "light_pos", light.pos );
@@ -731,11 +1113,10 @@ void MapLight::DrawFloorLight( const MapData::Light& light )
 	glDrawArrays( GL_TRIANGLES, 0, 6 );
 }
 
-void MapLight::DrawWallsLight( const MapData::Light& light )
+void MapLight::DrawWallsLight( const MapData::Light& light, const LightShadowmap* const light_shadowmap )
 {
-	shadowmap_.GetTextures().front().Bind(0);
+	SetupShadowmap( walls_light_pass_shader_, light_shadowmap );
 
-	walls_light_pass_shader_.Uniform( "shadowmap", int(0) );
 	walls_light_pass_shader_.Uniform( "light_pos", light.pos );
 	walls_light_pass_shader_.Uniform( "light_power", light.power * g_walls_light_scale );
 	walls_light_pass_shader_.Uniform( "max_light_level", light.max_light_level * g_walls_light_scale );
@@ -1,13 +1,13 @@
 #pragma once
 
 #include <framebuffer.hpp>
-#include <glsl_program.hpp>
 #include <polygon_buffer.hpp>
 #include <texture.hpp>
 
 #include "../../fwd.hpp"
 #include "../../map_loader.hpp"
 #include "../../rendering_context.hpp"
+#include "../../shader_program_gl.hpp"
 #include "fwd.hpp"
 
 namespace PanzerChasm
@@ -19,7 +19,8 @@ public:
 	MapLight(
 		const GameResourcesConstPtr& game_resources,
 		const RenderingContextGL& rendering_context,
-		bool use_hd_dynamic_lightmap );
+		bool use_hd_dynamic_lightmap,
+		bool use_geometry_shaders );
 	~MapLight();
 
 	void SetMap( const MapDataConstPtr& map_data );
@@ -43,15 +44,52 @@ private:
 
 	SIZE_ASSERT( WallVertex, 8u );
 
+	// Shadowmap of static light. Region of common shadowmap, affected by light, is stored in atlas.
+	struct LightShadowmap
+	{
+		int region_x, region_y; // In texels of common shadowmap.
+		int size;
+		int atlas_x, atlas_y;
+		bool in_atlas;
+	};
+
+	struct LightmapRect
+	{
+		int x, y;
+		int width, height;
+	};
+
+	// Base lightmaps are baked once for map and cached on disk.
+	struct BaseLightmapsCacheHeader
+	{
+		static const char c_expected_id[8];
+		static constexpr unsigned int c_expected_version= 1u; // Change each time, when format or light passes changed.
+
+		char id[8];
+		unsigned int version;
+		unsigned int map_hash;
+		unsigned int floor_lightmap_size[2];
+		unsigned int walls_lightmap_size[2];
+		unsigned int content_hash;
+	};
+
 private:
 	void PrepareMapWalls( const MapData& map_data );
 	void UpdateLightOnDynamicWalls( const MapState& map_state );
-	void DrawFloorLight( const MapData::Light& light );
-	void DrawWallsLight( const MapData::Light& light );
+	void PlaceLightsShadowmaps();
+	// Bind shadowmap of static light, or common shadowmap, if light is null, and set shader uniforms.
+	void SetupShadowmap( ShaderProgramGL& shader, const LightShadowmap* light_shadowmap );
+	void DrawFloorLight( const MapData::Light& light, const LightShadowmap* light_shadowmap= nullptr );
+	void DrawWallsLight( const MapData::Light& light, const LightShadowmap* light_shadowmap= nullptr );
+
+	// Returns true, if all ok.
+	bool LoadBaseLightmapsFromCache( const char* file_name, unsigned int map_hash );
+	void SaveBaseLightmapsToCache( const char* file_name, unsigned int map_hash );
 
 private:
 	const GameResourcesConstPtr game_resources_;
 	const bool use_hd_dynamic_lightmap_;
+	const bool use_geometry_shaders_; // If false, shadow polygons are extruded in vertex shader.
 
 	r_Texture fullbright_lightmap_dummy_;
 	r_Texture static_lightmap_;
@@ -73,18 +111,36 @@ private:
 	// Shadowmap
 	r_Framebuffer shadowmap_;
 
+	// Shadowmaps of static lights. Occluders are static walls only, so, shadowmaps are built once for map.
+	r_Framebuffer shadowmaps_atlas_;
+	int shadowmaps_atlas_height_= 0;
+	std::vector<LightShadowmap> lights_shadowmaps_;
+
 	// Shaders
-	r_GLSLProgram floor_light_pass_shader_;
-	r_GLSLProgram floor_ambient_light_pass_shader_;
-	r_GLSLProgram walls_light_pass_shader_;
-	r_GLSLProgram walls_ambient_light_pass_shader_;
+	ShaderProgramGL floor_light_pass_shader_;
+	ShaderProgramGL floor_ambient_light_pass_shader_;
+	ShaderProgramGL walls_light_pass_shader_;
+	ShaderProgramGL walls_ambient_light_pass_shader_;
 
-	r_GLSLProgram copy_shader_;
-	r_GLSLProgram shadowmap_shader_;
+	ShaderProgramGL copy_shader_;
+	ShaderProgramGL shadowmap_shader_;
 
 	MapDataConstPtr map_data_;
 
 	std::vector<bool> updated_dynamic_walls_flags_;
+
+	// Dynamic lights of current frame.
+	std::vector<MapData::Light> dynamic_lights_;
+
+	// Regions of final lightmaps, lit by dynamic lights in previous frame.
+	bool final_lightmaps_valid_= false;
+	std::vector<LightmapRect> floor_lit_rects_;
+	std::vector<bool> walls_lit_flags_; // For static walls, then for dynamic walls.
+
+	// Reuse vectors (do not create new vectors each frame).
+	std::vector<LightmapRect> floor_restore_rects_;
+	std::vector<LightmapRect> walls_restore_rects_;
+	std::vector<bool> walls_restore_flags_;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,174 @@
+#include <ogl_state_manager.hpp>
+
+#include "occlusion_culler.hpp"
+
+namespace PanzerChasm
+{
+
+namespace
+{
+
+// Camera may be inside bbox, or bbox may be clipped by near plane. Objects with such bboxes are always visible.
+const float g_camera_bbox_margin= 0.5f;
+
+// Objects forgotten only after some frames without tests, for reusing of queries.
+const unsigned int g_max_untested_frames= 16u;
+
+const GLenum g_gl_state_blend_func[2]= { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
+
+// Test both front and back faces, without depth writes.
+const r_OGLState g_occlusion_test_gl_state(
+	false, false, true, false,
+	g_gl_state_blend_func,
+	r_OGLState::default_clear_color,
+	r_OGLState::default_clear_depth,
+	r_OGLState::default_cull_face_mode,
+	false );
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller( const RenderingContextGL& rendering_context )
+{
+	shader_.ShaderSource(
+		rLoadShader( "occlusion_test_f.glsl", rendering_context.glsl_version ),
+		rLoadShader( "occlusion_test_v.glsl", rendering_context.glsl_version ) );
+	shader_.Create();
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	for( const auto& object_value : objects_ )
+	{
+		if( object_value.second.query_id != 0u )
+			glDeleteQueries( 1, &object_value.second.query_id );
+	}
+	glDeleteQueries( free_queries_.size(), free_queries_.data() );
+}
+
+void OcclusionCuller::BeginTests( const m_Mat4& view_matrix, const m_Vec3& camera_position )
+{
+	frame_++;
+	view_matrix_= view_matrix;
+	camera_position_= camera_position;
+
+	r_OGLStateManager::UpdateState( g_occlusion_test_gl_state );
+	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+
+	shader_.Bind();
+}
+
+void OcclusionCuller::Test( const uint32_t object_key, const m_BBox3& bbox, const m_Mat4& bbox_matrix )
+{
+	ObjectState& state= objects_[ object_key ];
+	state.last_test_frame= frame_;
+
+	if( state.query_pending )
+	{
+		GLuint available= 0u;
+		glGetQueryObjectuiv( state.query_id, GL_QUERY_RESULT_AVAILABLE, &available );
+		if( available == 0u )
+			return; // Keep previous result.
+
+		GLuint any_samples_passed= 0u;
+		glGetQueryObjectuiv( state.query_id, GL_QUERY_RESULT, &any_samples_passed );
+		state.visible= any_samples_passed != 0u;
+		state.query_pending= false;
+	}
+
+	m_BBox3 world_bbox;
+	for( unsigned int z= 0u; z < 2u; z++ )
+	for( unsigned int y= 0u; y < 2u; y++ )
+	for( unsigned int x= 0u; x < 2u; x++ )
+	{
+		const m_Vec3 point(
+			x == 0 ? bbox.min.x : bbox.max.x,
+			y == 0 ? bbox.min.y : bbox.max.y,
+			z == 0 ? bbox.min.z : bbox.max.z );
+		const m_Vec3 world_point= point * bbox_matrix;
+
+		if( x == 0u && y == 0u && z == 0u )
+			world_bbox.min= world_bbox.max= world_point;
+		else
+			world_bbox+= world_point;
+	}
+
+	if( camera_position_.x >= world_bbox.min.x - g_camera_bbox_margin && camera_position_.x <= world_bbox.max.x + g_camera_bbox_margin &&
+		camera_position_.y >= world_bbox.min.y - g_camera_bbox_margin && camera_position_.y <= world_bbox.max.y + g_camera_bbox_margin &&
+		camera_position_.z >= world_bbox.min.z - g_camera_bbox_margin && camera_position_.z <= world_bbox.max.z + g_camera_bbox_margin )
+	{
+		state.visible= true;
+		return;
+	}
+
+	if( state.query_id == 0u )
+	{
+		if( free_queries_.empty() )
+			glGenQueries( 1, &state.query_id );
+		else
+		{
+			state.query_id= free_queries_.back();
+			free_queries_.pop_back();
+		}
+	}
+
+	shader_.Uniform( "view_matrix", bbox_matrix * view_matrix_ );
+	shader_.Uniform( "bbox_min", bbox.min );
+	shader_.Uniform( "bbox_max", bbox.max );
+
+	glBeginQuery( GL_ANY_SAMPLES_PASSED, state.query_id );
+	glDrawArrays( GL_TRIANGLES, 0, 36 );
+	glEndQuery( GL_ANY_SAMPLES_PASSED );
+	state.query_pending= true;
+}
+
+void OcclusionCuller::EndTests()
+{
+	glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+
+	occluded_object_count_= 0u;
+	for( auto it= objects_.begin(); it != objects_.end(); )
+	{
+		const ObjectState& state= it->second;
+		if( frame_ - state.last_test_frame > g_max_untested_frames )
+		{
+			// Pending results of reused query will be discarded at next use.
+			if( state.query_id != 0u )
+				free_queries_.push_back( state.query_id );
+			it= objects_.erase( it );
+			continue;
+		}
+
+		if( state.last_test_frame == frame_ && !state.visible )
+			occluded_object_count_++;
+		++it;
+	}
+}
+
+void OcclusionCuller::Reset()
+{
+	// Pending results of reused queries will be discarded at next use.
+	for( const auto& object_value : objects_ )
+	{
+		if( object_value.second.query_id != 0u )
+			free_queries_.push_back( object_value.second.query_id );
+	}
+	objects_.clear();
+	occluded_object_count_= 0u;
+}
+
+bool OcclusionCuller::IsVisible( const uint32_t object_key ) const
+{
+	const auto it= objects_.find( object_key );
+	if( it == objects_.end() )
+		return true;
+
+	// Result of object, which was not tested in this frame, may be outdated.
+	return it->second.visible || it->second.last_test_frame != frame_;
+}
+
+unsigned int OcclusionCuller::GetOccludedObjectCount() const
+{
+	return occluded_object_count_;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <bbox.hpp>
+#include <matrix.hpp>
+
+#include "../../rendering_context.hpp"
+#include "../../shader_program_gl.hpp"
+
+namespace PanzerChasm
+{
+
+// Conservative occlusion culling, using hardware occlusion queries.
+// Bounding boxes of objects are tested against depth buffer after drawing of occluders (walls, floors).
+// Result of test is used until next test of object finishes, so, there are no stalls for waiting of query results.
+// Objects, which are not tested yet, are visible. Becoming visible objects may appear with small delay.
+class OcclusionCuller final
+{
+public:
+	explicit OcclusionCuller( const RenderingContextGL& rendering_context );
+	OcclusionCuller( const OcclusionCuller& other )= delete;
+	~OcclusionCuller();
+
+	OcclusionCuller& operator=( const OcclusionCuller& other )= delete;
+
+	// Call it after drawing of occluders. Changes OpenGL state.
+	void BeginTests( const m_Mat4& view_matrix, const m_Vec3& camera_position );
+	// Object key - unique number of object. bbox_matrix - transformation of bbox into world space.
+	void Test( uint32_t object_key, const m_BBox3& bbox, const m_Mat4& bbox_matrix );
+	// Forget objects, which were not tested in this frame.
+	void EndTests();
+
+	// Forget all objects. Call it at map change, because objects keys of new map may be same, as keys of previous map.
+	void Reset();
+
+	// Returns false, if object is occluded. Unknown objects are visible.
+	bool IsVisible( uint32_t object_key ) const;
+
+	unsigned int GetOccludedObjectCount() const;
+
+private:
+	struct ObjectState
+	{
+		GLuint query_id= 0u;
+		unsigned int last_test_frame= 0u;
+		bool query_pending= false;
+		bool visible= true;
+	};
+
+private:
+	ShaderProgramGL shader_;
+
+	std::unordered_map< uint32_t, ObjectState > objects_;
+	std::vector<GLuint> free_queries_;
+
+	m_Mat4 view_matrix_;
+	m_Vec3 camera_position_;
+	unsigned int frame_= 0u;
+	unsigned int occluded_object_count_= 0u;
+};
+
+} // namespace PanzerChasm
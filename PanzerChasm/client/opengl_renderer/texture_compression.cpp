@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../../assert.hpp"
+
+#include "texture_compression.hpp"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace PanzerChasm
+{
+
+namespace
+{
+
+const unsigned int g_block_size= 4u;
+const unsigned int g_block_texels= g_block_size * g_block_size;
+
+unsigned int GetBlockBytes( const CompressedTextureFormat format )
+{
+	return format == CompressedTextureFormat::BC1 ? 8u : 16u;
+}
+
+GLenum GetGLFormat( const CompressedTextureFormat format )
+{
+	return format == CompressedTextureFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+uint16_t PackColor565( const int* const color )
+{
+	const int r= ( color[0] * 31 + 127 ) / 255;
+	const int g= ( color[1] * 63 + 127 ) / 255;
+	const int b= ( color[2] * 31 + 127 ) / 255;
+	return static_cast<uint16_t>( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+void UnpackColor565( const uint16_t packed, int* const out_color )
+{
+	const int r= ( packed >> 11 ) & 31;
+	const int g= ( packed >>  5 ) & 63;
+	const int b= packed & 31;
+	out_color[0]= ( r << 3 ) | ( r >> 2 );
+	out_color[1]= ( g << 2 ) | ( g >> 4 );
+	out_color[2]= ( b << 3 ) | ( b >> 2 );
+}
+
+// Colors are always in four-colors mode (color0 > color1), so, block is valid for both BC1 and BC3.
+void CompressColorBlock( const unsigned char* const texels_rgba, unsigned char* const out_block )
+{
+	int min_color[3]= { 255, 255, 255 };
+	int max_color[3]= { 0, 0, 0 };
+	int mean[3]= { 0, 0, 0 };
+	for( unsigned int i= 0u; i < g_block_texels; i++ )
+	for( unsigned int j= 0u; j < 3u; j++ )
+	{
+		const int c= texels_rgba[ i * 4u + j ];
+		min_color[j]= std::min( min_color[j], c );
+		max_color[j]= std::max( max_color[j], c );
+		mean[j]+= c;
+	}
+	for( unsigned int j= 0u; j < 3u; j++ )
+		mean[j]/= int(g_block_texels);
+
+	// Select diagonal of colors bounding box, using sign of covariance with red channel.
+	int covariance[3]= { 0, 0, 0 };
+	for( unsigned int i= 0u; i < g_block_texels; i++ )
+	{
+		const int dr= int(texels_rgba[ i * 4u + 0u ]) - mean[0];
+		covariance[1]+= dr * ( int(texels_rgba[ i * 4u + 1u ]) - mean[1] );
+		covariance[2]+= dr * ( int(texels_rgba[ i * 4u + 2u ]) - mean[2] );
+	}
+	for( unsigned int j= 1u; j < 3u; j++ )
+		if( covariance[j] < 0 )
+			std::swap( min_color[j], max_color[j] );
+
+	// Inset bounding box, for reducing of error in middle of range.
+	for( unsigned int j= 0u; j < 3u; j++ )
+	{
+		const int inset= ( max_color[j] - min_color[j] ) / 16;
+		max_color[j]-= inset;
+		min_color[j]+= inset;
+	}
+
+	uint16_t color0= PackColor565( max_color );
+	uint16_t color1= PackColor565( min_color );
+	if( color0 < color1 )
+		std::swap( color0, color1 );
+
+	uint32_t indeces= 0u;
+	if( color0 != color1 )
+	{
+		int palette[4][3];
+		UnpackColor565( color0, palette[0] );
+		UnpackColor565( color1, palette[1] );
+		for( unsigned int j= 0u; j < 3u; j++ )
+		{
+			palette[2][j]= ( palette[0][j] * 2 + palette[1][j] ) / 3;
+			palette[3][j]= ( palette[0][j] + palette[1][j] * 2 ) / 3;
+		}
+
+		for( unsigned int i= 0u; i < g_block_texels; i++ )
+		{
+			unsigned int best_index= 0u;
+			int best_distance= 0x7FFFFFFF;
+			for( unsigned int p= 0u; p < 4u; p++ )
+			{
+				int distance= 0;
+				for( unsigned int j= 0u; j < 3u; j++ )
+				{
+					const int d= int(texels_rgba[ i * 4u + j ]) - palette[p][j];
+					distance+= d * d;
+				}
+				if( distance < best_distance )
+				{
+					best_distance= distance;
+					best_index= p;
+				}
+			}
+			indeces|= best_index << ( i * 2u );
+		}
+	}
+
+	std::memcpy( out_block + 0u, &color0, sizeof(uint16_t) );
+	std::memcpy( out_block + 2u, &color1, sizeof(uint16_t) );
+	std::memcpy( out_block + 4u, &indeces, sizeof(uint32_t) );
+}
+
+void CompressAlphaBlock( const unsigned char* const texels_rgba, unsigned char* const out_block )
+{
+	int min_alpha= 255, max_alpha= 0;
+	for( unsigned int i= 0u; i < g_block_texels; i++ )
+	{
+		min_alpha= std::min( min_alpha, int(texels_rgba[ i * 4u + 3u ]) );
+		max_alpha= std::max( max_alpha, int(texels_rgba[ i * 4u + 3u ]) );
+	}
+
+	// Eight-values mode (alpha0 > alpha1). For blocks with single alpha all indeces are zero.
+	uint64_t indeces= 0u;
+	if( max_alpha != min_alpha )
+	{
+		int palette[8];
+		palette[0]= max_alpha;
+		palette[1]= min_alpha;
+		for( int p= 1; p < 7; p++ )
+			palette[ p + 1 ]= ( max_alpha * ( 7 - p ) + min_alpha * p ) / 7;
+
+		for( unsigned int i= 0u; i < g_block_texels; i++ )
+		{
+			const int alpha= texels_rgba[ i * 4u + 3u ];
+			unsigned int best_index= 0u;
+			for( unsigned int p= 1u; p < 8u; p++ )
+				if( std::abs( palette[p] - alpha ) < std::abs( palette[best_index] - alpha ) )
+					best_index= p;
+
+			indeces|= uint64_t(best_index) << ( i * 3u );
+		}
+	}
+
+	out_block[0]= static_cast<unsigned char>( max_alpha );
+	out_block[1]= static_cast<unsigned char>( min_alpha );
+	for( unsigned int i= 0u; i < 6u; i++ )
+		out_block[ 2u + i ]= static_cast<unsigned char>( indeces >> ( i * 8u ) );
+}
+
+// Box filter. Output may be same as input.
+void DownscaleImage(
+	const unsigned int size_x, const unsigned int size_y,
+	const unsigned char* const in_data_rgba,
+	unsigned char* const out_data_rgba )
+{
+	const unsigned int out_size_x= std::max( 1u, size_x >> 1u );
+	const unsigned int out_size_y= std::max( 1u, size_y >> 1u );
+
+	// Each output texel is written after reading of all input texels with same or smaller address, so, downscaling in place is correct.
+	for( unsigned int y= 0u; y < out_size_y; y++ )
+	for( unsigned int x= 0u; x < out_size_x; x++ )
+	{
+		const unsigned int src_x[2]= { std::min( x * 2u, size_x - 1u ), std::min( x * 2u + 1u, size_x - 1u ) };
+		const unsigned int src_y[2]= { std::min( y * 2u, size_y - 1u ), std::min( y * 2u + 1u, size_y - 1u ) };
+
+		for( unsigned int j= 0u; j < 4u; j++ )
+		{
+			const unsigned int sum=
+				in_data_rgba[ ( src_x[0] + src_y[0] * size_x ) * 4u + j ] +
+				in_data_rgba[ ( src_x[1] + src_y[0] * size_x ) * 4u + j ] +
+				in_data_rgba[ ( src_x[0] + src_y[1] * size_x ) * 4u + j ] +
+				in_data_rgba[ ( src_x[1] + src_y[1] * size_x ) * 4u + j ];
+			out_data_rgba[ ( x + y * out_size_x ) * 4u + j ]= static_cast<unsigned char>( ( sum + 2u ) >> 2u );
+		}
+	}
+}
+
+} // namespace
+
+bool IsTexturesCompressionSupported()
+{
+	GLint extension_count= 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &extension_count );
+	for( GLint i= 0; i < extension_count; i++ )
+	{
+		const char* const extension= reinterpret_cast<const char*>( glGetStringi( GL_EXTENSIONS, i ) );
+		if( extension != nullptr && std::strcmp( extension, "GL_EXT_texture_compression_s3tc" ) == 0 )
+			return true;
+	}
+	return false;
+}
+
+unsigned int GetCompressedImageSize( const CompressedTextureFormat format, const unsigned int size_x, const unsigned int size_y )
+{
+	const unsigned int blocks_x= ( size_x + g_block_size - 1u ) / g_block_size;
+	const unsigned int blocks_y= ( size_y + g_block_size - 1u ) / g_block_size;
+	return blocks_x * blocks_y * GetBlockBytes( format );
+}
+
+void CompressImage(
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y,
+	const unsigned char* const in_data_rgba,
+	unsigned char* const out_data )
+{
+	PC_ASSERT( size_x > 0u && size_y > 0u );
+
+	const unsigned int blocks_x= ( size_x + g_block_size - 1u ) / g_block_size;
+	const unsigned int blocks_y= ( size_y + g_block_size - 1u ) / g_block_size;
+	const unsigned int block_bytes= GetBlockBytes( format );
+
+	unsigned char block_texels[ g_block_texels * 4u ];
+	for( unsigned int by= 0u; by < blocks_y; by++ )
+	for( unsigned int bx= 0u; bx < blocks_x; bx++ )
+	{
+		for( unsigned int y= 0u; y < g_block_size; y++ )
+		for( unsigned int x= 0u; x < g_block_size; x++ )
+		{
+			const unsigned int src_x= std::min( bx * g_block_size + x, size_x - 1u );
+			const unsigned int src_y= std::min( by * g_block_size + y, size_y - 1u );
+			std::memcpy(
+				block_texels + ( x + y * g_block_size ) * 4u,
+				in_data_rgba + ( src_x + src_y * size_x ) * 4u,
+				4u );
+		}
+
+		unsigned char* const block= out_data + ( bx + by * blocks_x ) * block_bytes;
+		if( format == CompressedTextureFormat::BC1 )
+			CompressColorBlock( block_texels, block );
+		else
+		{
+			CompressAlphaBlock( block_texels, block );
+			CompressColorBlock( block_texels, block + 8u );
+		}
+	}
+}
+
+void CompressTextureArray(
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int layer_count,
+	unsigned char* const data_rgba,
+	WorkersPool& workers_pool,
+	std::vector<unsigned char>& out_compressed_mips )
+{
+	const unsigned int layer_size= size_x * size_y * 4u;
+
+	out_compressed_mips.clear();
+	unsigned int level_size[2]= { size_x, size_y };
+	unsigned int prev_level_size[2]= { size_x, size_y };
+	for( unsigned int level= 0u; ; level++ )
+	{
+		const unsigned int compressed_layer_size= GetCompressedImageSize( format, level_size[0], level_size[1] );
+		const size_t level_offset= out_compressed_mips.size();
+		out_compressed_mips.resize( level_offset + compressed_layer_size * layer_count );
+		unsigned char* const level_data= out_compressed_mips.data() + level_offset;
+
+		workers_pool.ParallelFor(
+			layer_count,
+			[&]( const unsigned int layer )
+			{
+				unsigned char* const layer_data= data_rgba + layer_size * layer;
+				if( level > 0u )
+					DownscaleImage( prev_level_size[0], prev_level_size[1], layer_data, layer_data );
+
+				CompressImage(
+					format,
+					level_size[0], level_size[1],
+					layer_data,
+					level_data + compressed_layer_size * layer );
+			} );
+
+		if( level_size[0] == 1u && level_size[1] == 1u )
+			break;
+		prev_level_size[0]= level_size[0];
+		prev_level_size[1]= level_size[1];
+		level_size[0]= std::max( 1u, level_size[0] >> 1u );
+		level_size[1]= std::max( 1u, level_size[1] >> 1u );
+	}
+}
+
+unsigned int GetCompressedTextureArraySize(
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int layer_count )
+{
+	unsigned int result= 0u;
+	unsigned int level_size[2]= { size_x, size_y };
+	while( true )
+	{
+		result+= GetCompressedImageSize( format, level_size[0], level_size[1] ) * layer_count;
+		if( level_size[0] == 1u && level_size[1] == 1u )
+			break;
+		level_size[0]= std::max( 1u, level_size[0] >> 1u );
+		level_size[1]= std::max( 1u, level_size[1] >> 1u );
+	}
+	return result;
+}
+
+void UploadCompressedTextureArrayMips(
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int layer_count,
+	const unsigned char* compressed_mips )
+{
+	unsigned int level_size[2]= { size_x, size_y };
+	for( unsigned int level= 0u; ; level++ )
+	{
+		const unsigned int compressed_level_size= GetCompressedImageSize( format, level_size[0], level_size[1] ) * layer_count;
+
+		glCompressedTexImage3D(
+			GL_TEXTURE_2D_ARRAY, level, GetGLFormat( format ),
+			level_size[0], level_size[1], layer_count,
+			0, compressed_level_size, compressed_mips );
+		compressed_mips+= compressed_level_size;
+
+		if( level_size[0] == 1u && level_size[1] == 1u )
+			break;
+		level_size[0]= std::max( 1u, level_size[0] >> 1u );
+		level_size[1]= std::max( 1u, level_size[1] >> 1u );
+	}
+}
+
+void UploadCompressedTextureArrayLayersMips(
+	const CompressedTextureFormat format,
+	const unsigned int size_x, const unsigned int size_y, const unsigned int layer_count,
+	const unsigned char* compressed_mips,
+	const std::vector<bool>& layers_mask )
+{
+	PC_ASSERT( layers_mask.size() == layer_count );
+
+	unsigned int level_size[2]= { size_x, size_y };
+	for( unsigned int level= 0u; ; level++ )
+	{
+		const unsigned int compressed_layer_size= GetCompressedImageSize( format, level_size[0], level_size[1] );
+
+		for( unsigned int layer= 0u; layer < layer_count; layer++ )
+		{
+			if( !layers_mask[layer] )
+				continue;
+
+			glCompressedTexSubImage3D(
+				GL_TEXTURE_2D_ARRAY, level,
+				0, 0, layer,
+				level_size[0], level_size[1], 1,
+				GetGLFormat( format ), compressed_layer_size, compressed_mips + compressed_layer_size * layer );
+		}
+		compressed_mips+= compressed_layer_size * layer_count;
+
+		if( level_size[0] == 1u && level_size[1] == 1u )
+			break;
+		level_size[0]= std::max( 1u, level_size[0] >> 1u );
+		level_size[1]= std::max( 1u, level_size[1] >> 1u );
+	}
+}
+
+} // namespace PanzerChasm
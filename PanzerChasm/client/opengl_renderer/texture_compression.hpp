@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+
+#include <panzer_ogl_lib.hpp>
+
+#include "../../workers_pool.hpp"
+
+namespace PanzerChasm
+{
+
+// Block compression of RGBA8 textures, for textures arrays of map.
+// BC1 - for opaque textures, BC3 - for textures with alpha.
+enum class CompressedTextureFormat
+{
+	BC1,
+	BC3,
+};
+
+// Returns true, if GL_EXT_texture_compression_s3tc is supported.
+bool IsTexturesCompressionSupported();
+
+unsigned int GetCompressedImageSize( CompressedTextureFormat format, unsigned int size_x, unsigned int size_y );
+
+// Compress image. Image size may be not multiple of 4 - edge texels are repeated into partial blocks.
+void CompressImage(
+	CompressedTextureFormat format,
+	unsigned int size_x, unsigned int size_y,
+	const unsigned char* in_data_rgba,
+	unsigned char* out_data );
+
+// Build full mip chain for each layer and compress it.
+// Result contains all mip levels, from biggest to smallest. Each level contains all layers.
+// Input data is modified. Layers are processed in parallel on threads of given pool.
+void CompressTextureArray(
+	CompressedTextureFormat format,
+	unsigned int size_x, unsigned int size_y, unsigned int layer_count,
+	unsigned char* data_rgba,
+	WorkersPool& workers_pool,
+	std::vector<unsigned char>& out_compressed_mips );
+
+// Size of result of "CompressTextureArray".
+unsigned int GetCompressedTextureArraySize(
+	CompressedTextureFormat format,
+	unsigned int size_x, unsigned int size_y, unsigned int layer_count );
+
+// Upload result of "CompressTextureArray" into currently bound GL_TEXTURE_2D_ARRAY.
+void UploadCompressedTextureArrayMips(
+	CompressedTextureFormat format,
+	unsigned int size_x, unsigned int size_y, unsigned int layer_count,
+	const unsigned char* compressed_mips );
+
+// Upload into currently bound GL_TEXTURE_2D_ARRAY only layers from mask. Texture storage must be already allocated.
+void UploadCompressedTextureArrayLayersMips(
+	CompressedTextureFormat format,
+	unsigned int size_x, unsigned int size_y, unsigned int layer_count,
+	const unsigned char* compressed_mips,
+	const std::vector<bool>& layers_mask );
+
+} // namespace PanzerChasm
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstring>
+
+#include "../../cache_files.hpp"
+#include "../../log.hpp"
+#include "../../save_load.hpp"
+
+#include "textures_disk_cache.hpp"
+
+namespace PanzerChasm
+{
+
+const char TexturesCacheHeader::c_expected_id[8]= "PanTexC";
+
+static void GetCacheFileName( const char* const kind, const unsigned int source_hash, char* const out_file_name, const size_t size )
+{
+	std::snprintf( out_file_name, size, CACHE_FILES_DIR"/%s_%08x.pct", kind, source_hash );
+}
+
+bool LoadTexturesFromDiskCache(
+	const char* const kind, const unsigned int source_hash, const unsigned int expected_size,
+	std::vector<unsigned char>& out_data )
+{
+	char file_name[128];
+	GetCacheFileName( kind, source_hash, file_name, sizeof(file_name) );
+
+	TexturesCacheHeader header;
+	if( !ReadCacheFile( file_name, &header, sizeof(TexturesCacheHeader), out_data ) )
+		return false;
+
+	if( std::memcmp( header.id, TexturesCacheHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != TexturesCacheHeader::c_expected_version ||
+		header.source_hash != source_hash ||
+		header.data_size != expected_size ||
+		header.data_size != out_data.size() )
+	{
+		out_data.clear();
+		return false;
+	}
+
+	if( SaveHeader::CalculateHash( out_data.data(), out_data.size() ) != header.content_hash )
+	{
+		Log::Warning( "Textures cache \"", file_name, "\" is broken" );
+		out_data.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void SaveTexturesToDiskCache(
+	const char* const kind, const unsigned int source_hash,
+	const std::vector<unsigned char>& data )
+{
+	char file_name[128];
+	GetCacheFileName( kind, source_hash, file_name, sizeof(file_name) );
+
+	TexturesCacheHeader header;
+	std::memcpy( header.id, TexturesCacheHeader::c_expected_id, sizeof(header.id) );
+	header.version= TexturesCacheHeader::c_expected_version;
+	header.source_hash= source_hash;
+	header.data_size= data.size();
+	header.content_hash= SaveHeader::CalculateHash( data.data(), data.size() );
+
+	WriteCacheFile(
+		file_name,
+		{
+			{ &header, sizeof(TexturesCacheHeader) },
+			{ data.data(), data.size() },
+		} );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "../../assert.hpp"
+
+namespace PanzerChasm
+{
+
+// Disk cache for results of expensive textures conversions, like compression with mips generation.
+// Data is keyed by kind of textures and hash of all source data and conversion parameters.
+struct TexturesCacheHeader
+{
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 1u; // Change each time, when conversion algorithms changed.
+
+	char id[8];
+	unsigned int version;
+	unsigned int source_hash;
+	unsigned int data_size;
+	unsigned int content_hash;
+};
+
+SIZE_ASSERT( TexturesCacheHeader, 24u );
+
+// Returns false, if there is no valid data of expected size in cache.
+bool LoadTexturesFromDiskCache(
+	const char* kind, unsigned int source_hash, unsigned int expected_size,
+	std::vector<unsigned char>& out_data );
+
+void SaveTexturesToDiskCache(
+	const char* kind, unsigned int source_hash,
+	const std::vector<unsigned char>& data );
+
+} // namespace PanzerChasm
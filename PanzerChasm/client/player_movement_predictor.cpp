@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "../server/map_collision.inl"
+
+#include "player_movement_predictor.hpp"
+
+namespace PanzerChasm
+{
+
+// Moves are stored approximately for round trip time. Older moves are dropped.
+static const unsigned int g_max_moves= 128u;
+
+// Long frames are divided into steps, like server does with long ticks.
+static const float g_max_step_duration_s= 30.0f / 1000.0f;
+
+// Returns true, if "a" is newer, than "b", with wraparound.
+static bool SequenceIsNewer( const unsigned short a, const unsigned short b )
+{
+	return static_cast<short>( static_cast<unsigned short>( a - b ) ) > 0;
+}
+
+PlayerMovementPredictor::PlayerMovementPredictor( const MapDataConstPtr& map_data )
+	: map_data_(map_data)
+	, collision_index_(map_data)
+	, pos_( 0.0f, 0.0f, 0.0f )
+	, speed_( 0.0f, 0.0f, 0.0f )
+{
+	PC_ASSERT( map_data_ != nullptr );
+}
+
+PlayerMovementPredictor::~PlayerMovementPredictor()
+{}
+
+void PlayerMovementPredictor::AddMove( const Messages::PlayerMove& message )
+{
+	if( moves_.size() >= g_max_moves )
+		moves_.erase( moves_.begin() );
+
+	// Convert input exactly like server does.
+	moves_.emplace_back();
+	Move& move= moves_.back();
+	move.input.acceleration= float(message.acceleration) / 255.0f;
+	move.input.direction= MessageAngleToAngle( message.move_direction );
+	move.input.jump_pressed= message.jump_pressed;
+	move.sequence= message.sequence;
+}
+
+void PlayerMovementPredictor::ProcessPosition( const Messages::PlayerPosition& message )
+{
+	// Unreliable messages may come out of order. Ignore old positions.
+	if( have_acknowledged_sequence_ &&
+		SequenceIsNewer( last_acknowledged_sequence_, message.last_move_sequence ) )
+		return;
+
+	last_position_message_= message;
+	have_position_message_= true;
+	have_acknowledged_sequence_= true;
+	last_acknowledged_sequence_= message.last_move_sequence;
+}
+
+void PlayerMovementPredictor::Teleport( const m_Vec3& pos )
+{
+	pos_= pos;
+	speed_= m_Vec3( 0.0f, 0.0f, 0.0f );
+	moves_.clear();
+
+	// Sequence of server player may be reset after respawn.
+	have_position_message_= false;
+	have_acknowledged_sequence_= false;
+}
+
+void PlayerMovementPredictor::Tick( const MapState& map_state, const Time time_delta )
+{
+	UpdateCollisionIndex( map_state );
+
+	if( have_position_message_ )
+	{
+		Reconcile( map_state );
+		have_position_message_= false;
+	}
+
+	// Last move continues until next move.
+	if( !moves_.empty() )
+	{
+		moves_.back().duration+= time_delta;
+		Step( moves_.back().input, time_delta, map_state );
+	}
+}
+
+const m_Vec3& PlayerMovementPredictor::GetPosition() const
+{
+	return pos_;
+}
+
+float PlayerMovementPredictor::GetSpeed() const
+{
+	return speed_.xy().Length();
+}
+
+void PlayerMovementPredictor::Reconcile( const MapState& map_state )
+{
+	const Messages::PlayerPosition& message= last_position_message_;
+
+	MessagePositionToPosition( message.xyz, pos_ );
+	MessagePositionToPosition( message.speed_xyz, speed_ );
+	on_floor_= message.on_floor;
+	alive_= message.alive;
+	noclip_= message.noclip;
+
+	// Remove moves, processed by server.
+	const auto it=
+		std::find_if(
+			moves_.begin(), moves_.end(),
+			[&]( const Move& move ) { return move.sequence == message.last_move_sequence; } );
+	if( it == moves_.end() )
+	{
+		// Server processed unknown move - just use server position.
+		moves_.clear();
+		return;
+	}
+	moves_.erase( moves_.begin(), it + 1 );
+
+	// Reapply rest of moves.
+	for( const Move& move : moves_ )
+		Step( move.input, move.duration, map_state );
+}
+
+void PlayerMovementPredictor::Step( const PlayerMovementInput& input, const Time time_delta, const MapState& map_state )
+{
+	if( !alive_ )
+		return;
+
+	const float time_delta_s= time_delta.ToSeconds();
+	if( time_delta_s <= 0.0f )
+		return;
+
+	const unsigned int step_count= static_cast<unsigned int>( std::ceil( time_delta_s / g_max_step_duration_s ) );
+	const Time step_duration= Time::FromSeconds( double( time_delta_s ) / double( step_count ) );
+
+	for( unsigned int i= 0u; i < step_count; i++ )
+	{
+		MovePlayer( input, alive_, noclip_, on_floor_, step_duration, pos_, speed_ );
+
+		// Server does not collide noclip players.
+		if( noclip_ )
+			continue;
+
+		MovementRestriction movement_restriction;
+		const m_Vec3 new_pos=
+			CollideCylinderWithMap(
+				*map_data_, collision_index_,
+				map_state.GetStaticModels(), map_state.GetDynamicWalls(),
+				pos_, GameConstants::player_height, GameConstants::player_radius, step_duration,
+				on_floor_, movement_restriction );
+
+		// Clamp speed, like server map does.
+		const m_Vec3 position_delta= new_pos - pos_;
+		if( position_delta.z != 0.0f )
+			ClampPlayerSpeed( m_Vec3( 0.0f, 0.0f, position_delta.z > 0.0f ? 1.0f : -1.0f ), speed_ );
+
+		const float position_delta_length= position_delta.xy().Length();
+		if( position_delta_length != 0.0f )
+			ClampPlayerSpeed( m_Vec3( position_delta.xy() / position_delta_length, 0.0f ), speed_ );
+
+		pos_= new_pos;
+		SetPlayerOnFloor( on_floor_, speed_ );
+	}
+}
+
+void PlayerMovementPredictor::UpdateCollisionIndex( const MapState& map_state )
+{
+	const MapState::DynamicWalls& dynamic_walls= map_state.GetDynamicWalls();
+	for( unsigned int w= 0u; w < dynamic_walls.size(); w++ )
+		collision_index_.UpdateDynamicWall( w, dynamic_walls[w].vert_pos[0], dynamic_walls[w].vert_pos[1] );
+
+	const MapState::StaticModels& static_models= map_state.GetStaticModels();
+	for( unsigned int m= 0u; m < static_models.size(); m++ )
+	{
+		const MapState::StaticModel& model= static_models[m];
+		const float radius=
+			model.model_id < map_data_->models_description.size()
+				? map_data_->models_description[ model.model_id ].radius
+				: 0.0f;
+
+		collision_index_.UpdateDynamicModel( m, model.pos.xy(), radius );
+	}
+}
+
+} // namespace PanzerChasm
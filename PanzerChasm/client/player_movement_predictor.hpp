@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../map_loader.hpp"
+#include "../messages.hpp"
+#include "../time.hpp"
+#include "../server/collision_index.hpp"
+#include "../server/player_movement.hpp"
+#include "map_state.hpp"
+
+namespace PanzerChasm
+{
+
+// Client-side prediction of player movement.
+// Client moves player immediately by own input, using same movement and collision logic, as server.
+// Moves, not yet processed by server, are stored and reapplied to each position, recieved from server.
+class PlayerMovementPredictor final
+{
+public:
+	explicit PlayerMovementPredictor( const MapDataConstPtr& map_data );
+	~PlayerMovementPredictor();
+
+	// Call for each PlayerMove message, sent to server.
+	void AddMove( const Messages::PlayerMove& message );
+
+	void ProcessPosition( const Messages::PlayerPosition& message );
+	void Teleport( const m_Vec3& pos );
+
+	// Reconcile with last recieved position and continue movement by last move.
+	void Tick( const MapState& map_state, Time time_delta );
+
+	const m_Vec3& GetPosition() const;
+	float GetSpeed() const; // Horizontal speed.
+
+private:
+	struct Move
+	{
+		PlayerMovementInput input;
+		unsigned short sequence;
+		Time duration= Time::FromSeconds(0); // Time, during which move was applied on client.
+	};
+
+private:
+	void Reconcile( const MapState& map_state );
+	void Step( const PlayerMovementInput& input, Time time_delta, const MapState& map_state );
+	void UpdateCollisionIndex( const MapState& map_state );
+
+private:
+	const MapDataConstPtr map_data_;
+	CollisionIndex collision_index_;
+
+	std::vector<Move> moves_; // Oldest first.
+
+	m_Vec3 pos_;
+	m_Vec3 speed_;
+	bool on_floor_= false;
+	bool alive_= false;
+	bool noclip_= false;
+
+	Messages::PlayerPosition last_position_message_;
+	bool have_position_message_= false;
+	bool have_acknowledged_sequence_= false;
+	unsigned short last_acknowledged_sequence_= 0u;
+};
+
+} // namespace PanzerChasm
@@ -121,6 +121,13 @@ inline fixed16_t Fixed16Invert( fixed16_t x )
 	return FixedInvert<16>( x );
 }
 
+// x * y / z, with 64-bit intermediate value.
+inline fixed_base_t FixedMulDiv( fixed_base_t x, fixed_base_t y, fixed_base_t z )
+{
+	PC_ASSERT( z != 0 );
+	return fixed_base_t( fixed_base_square_t(x) * y / z );
+}
+
 #undef ASSERT_INVALID_BASE
 
 } // namespace PanzerChasm
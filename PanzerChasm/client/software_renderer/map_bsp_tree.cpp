@@ -1,16 +1,55 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
 #include "../../assert.hpp"
+#include "../../cache_files.hpp"
+#include "../../log.hpp"
 #include "../../map_loader.hpp"
+#include "../../math_utils.hpp"
+#include "../../save_load.hpp"
 
 #include "map_bsp_tree.hpp"
 
 namespace PanzerChasm
 {
 
+const char MapBSPTree::CacheHeader::c_expected_id[8]= "PanBSPt";
+
+// Nodes and segments are written as is, so, they must have no padding.
+SIZE_ASSERT( MapBSPTree::Node, 44u );
+SIZE_ASSERT( MapBSPTree::WallSegment, 28u );
+
 MapBSPTree::MapBSPTree( const MapDataConstPtr& map_data )
 	: map_data_(map_data)
 {
 	PC_ASSERT( map_data_ != nullptr );
 
+	// Tree depends only on static walls geometry, so, key cache by it.
+	std::vector<float> walls_coords;
+	walls_coords.reserve( map_data_->static_walls.size() * 4u );
+	for( const MapData::Wall& wall : map_data_->static_walls )
+	{
+		walls_coords.push_back( wall.vert_pos[0].x );
+		walls_coords.push_back( wall.vert_pos[0].y );
+		walls_coords.push_back( wall.vert_pos[1].x );
+		walls_coords.push_back( wall.vert_pos[1].y );
+	}
+	const unsigned int walls_hash=
+		SaveHeader::CalculateHash(
+			reinterpret_cast<const unsigned char*>( walls_coords.data() ),
+			walls_coords.size() * sizeof(float) );
+
+	char cache_file_name[64];
+	std::snprintf(
+		cache_file_name, sizeof(cache_file_name),
+		CACHE_FILES_DIR"/bsp_%08x_%u.pcb", walls_hash, static_cast<unsigned int>( map_data_->static_walls.size() ) );
+
+	if( LoadFromCache( cache_file_name, walls_hash ) )
+		return;
+
+	nodes_.clear();
+	segments_.clear();
 	nodes_.emplace_back(); // Dummy node
 
 	BuildSegments segments;
@@ -26,6 +65,8 @@ MapBSPTree::MapBSPTree( const MapDataConstPtr& map_data )
 	}
 
 	root_node_= BuildTree_r( segments );
+
+	SaveToCache( cache_file_name, walls_hash );
 }
 
 MapBSPTree::~MapBSPTree()
@@ -214,7 +255,113 @@ unsigned int MapBSPTree::BuildTree_r( const BuildSegments& build_segments )
 	node->node_front= node_front;
 	node->node_back= node_back;
 
+	// Calculate bounding box of subtree.
+	node->bb_min= m_Vec2( Constants::max_float, Constants::max_float );
+	node->bb_max= m_Vec2( Constants::min_float, Constants::min_float );
+	for( unsigned int i= 0u; i < node->segment_count; i++ )
+	{
+		const WallSegment& segment= segments_[ node->first_segment + i ];
+		for( const m_Vec2& v : segment.vert_pos )
+		{
+			node->bb_min.x= std::min( node->bb_min.x, v.x );
+			node->bb_min.y= std::min( node->bb_min.y, v.y );
+			node->bb_max.x= std::max( node->bb_max.x, v.x );
+			node->bb_max.y= std::max( node->bb_max.y, v.y );
+		}
+	}
+	for( const unsigned int child : { node_front, node_back } )
+	{
+		if( child == c_null_node )
+			continue;
+
+		const Node& child_node= nodes_[child];
+		node->bb_min.x= std::min( node->bb_min.x, child_node.bb_min.x );
+		node->bb_min.y= std::min( node->bb_min.y, child_node.bb_min.y );
+		node->bb_max.x= std::max( node->bb_max.x, child_node.bb_max.x );
+		node->bb_max.y= std::max( node->bb_max.y, child_node.bb_max.y );
+	}
+
 	return node_number;
 }
 
+bool MapBSPTree::LoadFromCache( const char* const file_name, const unsigned int walls_hash )
+{
+	CacheHeader header;
+	std::vector<unsigned char> content;
+	if( !ReadCacheFile( file_name, &header, sizeof(CacheHeader), content ) )
+		return false;
+
+	if( std::memcmp( header.id, CacheHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != CacheHeader::c_expected_version ||
+		header.walls_hash != walls_hash ||
+		header.walls_count != map_data_->static_walls.size() ||
+		header.node_count == 0u ||
+		header.root_node >= header.node_count ||
+		header.node_count > content.size() / sizeof(Node) ||
+		header.segment_count > content.size() / sizeof(WallSegment) )
+		return false;
+
+	// Calculate expected size in 64 bits, because counts are read from file and product may overflow 32-bit size_t.
+	const uint64_t expected_content_size=
+		uint64_t(header.node_count) * uint64_t(sizeof(Node)) + uint64_t(header.segment_count) * uint64_t(sizeof(WallSegment));
+	if( expected_content_size != uint64_t(content.size()) )
+		return false;
+
+	nodes_.resize( header.node_count );
+	segments_.resize( header.segment_count );
+	std::memcpy( nodes_.data(), content.data(), nodes_.size() * sizeof(Node) );
+	std::memcpy( segments_.data(), content.data() + nodes_.size() * sizeof(Node), segments_.size() * sizeof(WallSegment) );
+
+	bool valid= header.content_hash == CalculateContentHash();
+
+	// Check indices, even if hash is correct. Broken file must not crash us.
+	for( unsigned int i= 1u; valid && i < nodes_.size(); i++ )
+	{
+		const Node& node= nodes_[i];
+		valid=
+			node.node_front < nodes_.size() && node.node_back < nodes_.size() &&
+			node.first_segment <= segments_.size() && node.segment_count <= segments_.size() - node.first_segment;
+	}
+	for( unsigned int i= 0u; valid && i < segments_.size(); i++ )
+		valid= segments_[i].wall_index < map_data_->static_walls.size();
+
+	if( !valid )
+	{
+		Log::Warning( "BSP tree cache \"", file_name, "\" is broken" );
+		return false;
+	}
+
+	root_node_= header.root_node;
+	return true;
+}
+
+void MapBSPTree::SaveToCache( const char* const file_name, const unsigned int walls_hash ) const
+{
+	CacheHeader header;
+	std::memcpy( header.id, CacheHeader::c_expected_id, sizeof(header.id) );
+	header.version= CacheHeader::c_expected_version;
+	header.walls_hash= walls_hash;
+	header.walls_count= map_data_->static_walls.size();
+	header.root_node= root_node_;
+	header.node_count= nodes_.size();
+	header.segment_count= segments_.size();
+	header.content_hash= CalculateContentHash();
+
+	WriteCacheFile(
+		file_name,
+		{
+			{ &header, sizeof(CacheHeader) },
+			{ nodes_.data(), nodes_.size() * sizeof(Node) },
+			{ segments_.data(), segments_.size() * sizeof(WallSegment) },
+		} );
+}
+
+unsigned int MapBSPTree::CalculateContentHash() const
+{
+	// Combine hashes of nodes and segments.
+	return
+		SaveHeader::CalculateHash( reinterpret_cast<const unsigned char*>( nodes_.data() ), nodes_.size() * sizeof(Node) ) ^
+		( SaveHeader::CalculateHash( reinterpret_cast<const unsigned char*>( segments_.data() ), segments_.size() * sizeof(WallSegment) ) * 31u );
+}
+
 } // namespace PanzerChasm
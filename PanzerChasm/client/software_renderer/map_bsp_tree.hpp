@@ -28,6 +28,9 @@ public:
 
 		// Zero - if has no child.
 		unsigned int node_front, node_back;
+
+		// Bounding box of all segments of node and its children.
+		m_Vec2 bb_min, bb_max;
 	};
 
 public:
@@ -38,6 +41,10 @@ public:
 	template<class Func>
 	void EnumerateSegmentsFrontToBack( const m_Vec2& camera_position, const Func& func ) const;
 
+	// NodeFilter - bool( const m_Vec2& bb_min, const m_Vec2& bb_max ). If returns false - whole subtree is skipped.
+	template<class Func, class NodeFilter>
+	void EnumerateSegmentsFrontToBack( const m_Vec2& camera_position, const Func& func, const NodeFilter& node_filter ) const;
+
 private:
 	struct BuildSegment
 	{
@@ -46,12 +53,32 @@ private:
 	};
 	typedef std::vector<BuildSegment> BuildSegments;
 
+	struct CacheHeader
+	{
+		static const char c_expected_id[8];
+		static constexpr unsigned int c_expected_version= 1u; // Change each time, when format or build algorithm changed.
+
+		char id[8];
+		unsigned int version;
+		unsigned int walls_hash;
+		unsigned int walls_count;
+		unsigned int root_node;
+		unsigned int node_count;
+		unsigned int segment_count;
+		unsigned int content_hash;
+	};
+
 private:
 	// Returns new node number.
 	unsigned int BuildTree_r( const BuildSegments& build_segments );
 
-	template<class Func>
-	void EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2& camera_position, const Func& func ) const;
+	// Returns true, if all ok.
+	bool LoadFromCache( const char* file_name, unsigned int walls_hash );
+	void SaveToCache( const char* file_name, unsigned int walls_hash ) const;
+	unsigned int CalculateContentHash() const;
+
+	template<class Func, class NodeFilter>
+	void EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2& camera_position, const Func& func, const NodeFilter& node_filter ) const;
 
 private:
 	const MapDataConstPtr map_data_;
@@ -8,12 +8,28 @@ namespace PanzerChasm
 template<class Func>
 void MapBSPTree::EnumerateSegmentsFrontToBack( const m_Vec2& camera_position, const Func& func ) const
 {
-	EnumerateSegmentsFrontToBack_r( nodes_[root_node_], camera_position, func );
+	EnumerateSegmentsFrontToBack(
+		camera_position, func,
+		[]( const m_Vec2& bb_min, const m_Vec2& bb_max ) -> bool
+		{
+			PC_UNUSED( bb_min );
+			PC_UNUSED( bb_max );
+			return true;
+		} );
 }
 
-template<class Func>
-void MapBSPTree::EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2& camera_position, const Func& func ) const
+template<class Func, class NodeFilter>
+void MapBSPTree::EnumerateSegmentsFrontToBack( const m_Vec2& camera_position, const Func& func, const NodeFilter& node_filter ) const
 {
+	EnumerateSegmentsFrontToBack_r( nodes_[root_node_], camera_position, func, node_filter );
+}
+
+template<class Func, class NodeFilter>
+void MapBSPTree::EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2& camera_position, const Func& func, const NodeFilter& node_filter ) const
+{
+	if( !node_filter( node.bb_min, node.bb_max ) )
+		return;
+
 	const bool at_front= node.plane.IsPointAheadPlane( camera_position );
 
 	unsigned int node_front, node_back;
@@ -31,7 +47,7 @@ void MapBSPTree::EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2&
 	if( node_front != c_null_node )
 	{
 		PC_ASSERT( node_front < nodes_.size() );
-		EnumerateSegmentsFrontToBack_r( nodes_[ node_front ], camera_position, func );
+		EnumerateSegmentsFrontToBack_r( nodes_[ node_front ], camera_position, func, node_filter );
 	}
 
 	for( unsigned int segment= 0u; segment < node.segment_count; segment++ )
@@ -44,7 +60,7 @@ void MapBSPTree::EnumerateSegmentsFrontToBack_r( const Node& node, const m_Vec2&
 	if(  node_back != c_null_node )
 	{
 		PC_ASSERT(  node_back < nodes_.size() );
-		EnumerateSegmentsFrontToBack_r( nodes_[  node_back ], camera_position, func );
+		EnumerateSegmentsFrontToBack_r( nodes_[  node_back ], camera_position, func, node_filter );
 	}
 }
 
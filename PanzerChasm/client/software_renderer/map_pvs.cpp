@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../../assert.hpp"
+#include "../../math_utils.hpp"
+
+#include "map_pvs.hpp"
+
+namespace PanzerChasm
+{
+
+static constexpr unsigned int g_rays_per_point= 384u;
+// Sample points are moved inside cell, because walls usually lie on cells borders.
+static constexpr float g_sample_point_inset= 1.0f / 16.0f;
+static constexpr float g_ray_eps= 1.0f / 1024.0f;
+// Extend walls a bit, for closing of gaps between adjacent walls.
+static constexpr float g_wall_extend_eps= 1.0f / 256.0f;
+
+MapPVS::MapPVS( const MapDataConstPtr& map_data, const std::vector<bool>& opaque_walls )
+	: map_data_(map_data)
+{
+	PC_ASSERT( map_data_ != nullptr );
+	PC_ASSERT( opaque_walls.size() == map_data_->static_walls.size() );
+
+	constexpr int c_max_cell= int(MapData::c_map_size - 1u);
+
+	// Build index of opaque walls. Use cells of wall bounding box - it is simple and conservative.
+	std::vector< std::pair<unsigned int, unsigned short> > cell_wall_pairs;
+	for( unsigned int w= 0u; w < map_data_->static_walls.size(); w++ )
+	{
+		if( !opaque_walls[w] )
+			continue;
+
+		const MapData::Wall& wall= map_data_->static_walls[w];
+		if( wall.vert_pos[0] == wall.vert_pos[1] )
+			continue;
+
+		const int x_min= std::max( static_cast<int>( std::floor( std::min( wall.vert_pos[0].x, wall.vert_pos[1].x ) - g_wall_extend_eps ) ), 0 );
+		const int x_max= std::min( static_cast<int>( std::floor( std::max( wall.vert_pos[0].x, wall.vert_pos[1].x ) + g_wall_extend_eps ) ), c_max_cell );
+		const int y_min= std::max( static_cast<int>( std::floor( std::min( wall.vert_pos[0].y, wall.vert_pos[1].y ) - g_wall_extend_eps ) ), 0 );
+		const int y_max= std::min( static_cast<int>( std::floor( std::max( wall.vert_pos[0].y, wall.vert_pos[1].y ) + g_wall_extend_eps ) ), c_max_cell );
+
+		for( int y= y_min; y <= y_max; y++ )
+		for( int x= x_min; x <= x_max; x++ )
+			cell_wall_pairs.emplace_back( static_cast<unsigned int>( x + y * int(MapData::c_map_size) ), static_cast<unsigned short>(w) );
+	}
+
+	std::sort( cell_wall_pairs.begin(), cell_wall_pairs.end() );
+
+	cells_walls_.resize( cell_wall_pairs.size() );
+	unsigned int pair_index= 0u;
+	for( unsigned int cell= 0u; cell < MapData::c_map_size * MapData::c_map_size; cell++ )
+	{
+		cells_walls_offsets_[cell]= pair_index;
+		while( pair_index < cell_wall_pairs.size() && cell_wall_pairs[pair_index].first == cell )
+		{
+			cells_walls_[pair_index]= cell_wall_pairs[pair_index].second;
+			pair_index++;
+		}
+	}
+	cells_walls_offsets_[ MapData::c_map_size * MapData::c_map_size ]= pair_index;
+
+	cells_visibility_.resize( MapData::c_map_size * MapData::c_map_size );
+	cells_visibility_calculated_.resize( MapData::c_map_size * MapData::c_map_size, false );
+}
+
+MapPVS::~MapPVS()
+{
+}
+
+const MapPVS::CellVisibility* MapPVS::GetCellVisibility( const m_Vec2& pos )
+{
+	if( !( pos.x >= 0.0f && pos.y >= 0.0f && pos.x < float(MapData::c_map_size) && pos.y < float(MapData::c_map_size) ) )
+		return nullptr;
+
+	const unsigned int x= static_cast<unsigned int>(pos.x);
+	const unsigned int y= static_cast<unsigned int>(pos.y);
+	const unsigned int cell= x + y * MapData::c_map_size;
+
+	if( !cells_visibility_calculated_[cell] )
+	{
+		CalculateCellVisibility( x, y, cells_visibility_[cell] );
+		cells_visibility_calculated_[cell]= true;
+	}
+
+	return &cells_visibility_[cell];
+}
+
+bool MapPVS::IsCellVisible( const CellVisibility& visibility, const unsigned int x, const unsigned int y )
+{
+	PC_ASSERT( x < MapData::c_map_size );
+	PC_ASSERT( y < MapData::c_map_size );
+	return ( visibility.rows[y] & ( CellsRow(1u) << x ) ) != 0u;
+}
+
+bool MapPVS::IsAreaVisible( const CellVisibility& visibility, const m_Vec2& area_min, const m_Vec2& area_max )
+{
+	constexpr int c_max_cell= int(MapData::c_map_size - 1u);
+
+	// Area outside map is not covered by PVS - treat it as visible.
+	if( area_min.x < 0.0f || area_min.y < 0.0f ||
+		area_max.x >= float(MapData::c_map_size) || area_max.y >= float(MapData::c_map_size) )
+		return true;
+
+	const int x_min= std::max( static_cast<int>( area_min.x ), 0 );
+	const int x_max= std::min( static_cast<int>( area_max.x ), c_max_cell );
+	const int y_min= std::max( static_cast<int>( area_min.y ), 0 );
+	const int y_max= std::min( static_cast<int>( area_max.y ), c_max_cell );
+	if( x_max < x_min || y_max < y_min )
+		return false;
+
+	const CellsRow row_mask=
+		( x_max - x_min + 1 == int(MapData::c_map_size) )
+			? ~CellsRow(0u)
+			: ( ( ( CellsRow(1u) << ( x_max - x_min + 1 ) ) - 1u ) << x_min );
+
+	for( int y= y_min; y <= y_max; y++ )
+		if( ( visibility.rows[y] & row_mask ) != 0u )
+			return true;
+
+	return false;
+}
+
+void MapPVS::CalculateCellVisibility( const unsigned int cell_x, const unsigned int cell_y, CellVisibility& out_visibility ) const
+{
+	CellVisibility visibility;
+	std::memset( &visibility, 0, sizeof(visibility) );
+
+	const m_Vec2 cell_min( static_cast<float>(cell_x), static_cast<float>(cell_y) );
+	const m_Vec2 sample_points[5]=
+	{
+		cell_min + m_Vec2( g_sample_point_inset, g_sample_point_inset ),
+		cell_min + m_Vec2( 1.0f - g_sample_point_inset, g_sample_point_inset ),
+		cell_min + m_Vec2( g_sample_point_inset, 1.0f - g_sample_point_inset ),
+		cell_min + m_Vec2( 1.0f - g_sample_point_inset, 1.0f - g_sample_point_inset ),
+		cell_min + m_Vec2( 0.5f, 0.5f ),
+	};
+
+	for( unsigned int p= 0u; p < 5u; p++ )
+	{
+		// Shift rays of each point, for better coverage.
+		const float angle_step= Constants::two_pi / float(g_rays_per_point);
+		const float angle_shift= angle_step * float(p) / 5.0f;
+		for( unsigned int r= 0u; r < g_rays_per_point; r++ )
+		{
+			const float angle= angle_shift + angle_step * float(r);
+			CastRay( sample_points[p], m_Vec2( std::cos(angle), std::sin(angle) ), visibility );
+		}
+	}
+
+	// Expand visible cells by one cell.
+	CellsRow rows_expanded_x[ MapData::c_map_size ];
+	for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+	{
+		const CellsRow row= visibility.rows[y];
+		rows_expanded_x[y]= row | ( row << 1u ) | ( row >> 1u );
+	}
+	for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+	{
+		CellsRow row= rows_expanded_x[y];
+		if( y > 0u )
+			row|= rows_expanded_x[ y - 1u ];
+		if( y + 1u < MapData::c_map_size )
+			row|= rows_expanded_x[ y + 1u ];
+		out_visibility.rows[y]= row;
+	}
+}
+
+void MapPVS::CastRay( const m_Vec2& pos, const m_Vec2& dir, CellVisibility& out_visibility ) const
+{
+	int cell_x= static_cast<int>( std::floor(pos.x) );
+	int cell_y= static_cast<int>( std::floor(pos.y) );
+
+	const int step_x= dir.x >= 0.0f ? 1 : -1;
+	const int step_y= dir.y >= 0.0f ? 1 : -1;
+
+	const float t_delta_x= dir.x != 0.0f ? std::abs( 1.0f / dir.x ) : Constants::max_float;
+	const float t_delta_y= dir.y != 0.0f ? std::abs( 1.0f / dir.y ) : Constants::max_float;
+
+	float t_max_x, t_max_y; // Ray parameter for next cell border.
+	if( dir.x > 0.0f )
+		t_max_x= ( float(cell_x + 1) - pos.x ) * t_delta_x;
+	else if( dir.x < 0.0f )
+		t_max_x= ( pos.x - float(cell_x) ) * t_delta_x;
+	else
+		t_max_x= Constants::max_float;
+	if( dir.y > 0.0f )
+		t_max_y= ( float(cell_y + 1) - pos.y ) * t_delta_y;
+	else if( dir.y < 0.0f )
+		t_max_y= ( pos.y - float(cell_y) ) * t_delta_y;
+	else
+		t_max_y= Constants::max_float;
+
+	while(
+		cell_x >= 0 && cell_x < int(MapData::c_map_size) &&
+		cell_y >= 0 && cell_y < int(MapData::c_map_size) )
+	{
+		out_visibility.rows[cell_y]|= CellsRow(1u) << cell_x;
+
+		const float t_cell_exit= std::min( t_max_x, t_max_y );
+
+		// Stop at first opaque wall inside current cell.
+		const unsigned int cell= static_cast<unsigned int>( cell_x + cell_y * int(MapData::c_map_size) );
+		for( unsigned int i= cells_walls_offsets_[cell]; i < cells_walls_offsets_[ cell + 1u ]; i++ )
+		{
+			const MapData::Wall& wall= map_data_->static_walls[ cells_walls_[i] ];
+			const m_Vec2 edge= wall.vert_pos[1] - wall.vert_pos[0];
+
+			// Back faces of walls are not drawn - ray passes through it.
+			if( mVec2Cross( pos - wall.vert_pos[0], edge ) > 0.0f )
+				continue;
+
+			const m_Vec2 to_wall= wall.vert_pos[0] - pos;
+
+			const float denominator= dir.x * edge.y - dir.y * edge.x;
+			if( std::abs(denominator) < 1.0e-6f )
+				continue; // Ray is parallel to wall.
+
+			const float t= ( to_wall.x * edge.y - to_wall.y * edge.x ) / denominator;
+			const float s= ( to_wall.x *  dir.y - to_wall.y *  dir.x ) / denominator;
+
+			const float s_eps= g_wall_extend_eps / std::sqrt( edge.SquareLength() );
+			if( s >= -s_eps && s <= 1.0f + s_eps && t > g_ray_eps && t <= t_cell_exit + g_ray_eps )
+				return;
+		}
+
+		if( t_max_x < t_max_y )
+		{
+			cell_x+= step_x;
+			t_max_x+= t_delta_x;
+		}
+		else
+		{
+			cell_y+= step_y;
+			t_max_y+= t_delta_y;
+		}
+	}
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../../map_loader.hpp"
+
+namespace PanzerChasm
+{
+
+// Potentially visible set of map cells.
+// Visibility for cell is calculated at first request, by casting rays from several points of cell.
+// Only front faces of opaque static walls occlude view. Result is expanded by one cell, for rays gaps compensation.
+// Visibility is approximate, not conservative - cells, visible only through narrow gaps, may be missed by rays.
+// First request for cell costs about millisecond. So, PVS is an optional optimization, disabled by default.
+class MapPVS final
+{
+public:
+	// Bit-mask of visible cells. Bit x of row y - cell ( x, y ).
+	typedef uint64_t CellsRow;
+	static_assert( sizeof(CellsRow) * 8u == MapData::c_map_size, "Invalid cells row size" );
+
+	struct CellVisibility
+	{
+		CellsRow rows[ MapData::c_map_size ];
+	};
+
+public:
+	// opaque_walls - flags for map static walls, which fully occlude view from front side.
+	MapPVS( const MapDataConstPtr& map_data, const std::vector<bool>& opaque_walls );
+	~MapPVS();
+
+	// Returns null, if position is outside map. Calculates visibility, if it is not calculated yet.
+	const CellVisibility* GetCellVisibility( const m_Vec2& pos );
+
+	static bool IsCellVisible( const CellVisibility& visibility, unsigned int x, unsigned int y );
+	// Returns true, if at least one cell, touched by area, is visible.
+	static bool IsAreaVisible( const CellVisibility& visibility, const m_Vec2& area_min, const m_Vec2& area_max );
+
+private:
+	void CalculateCellVisibility( unsigned int cell_x, unsigned int cell_y, CellVisibility& out_visibility ) const;
+	void CastRay( const m_Vec2& pos, const m_Vec2& dir, CellVisibility& out_visibility ) const;
+
+private:
+	const MapDataConstPtr map_data_;
+
+	// Opaque walls, which touch each cell.
+	std::vector<unsigned short> cells_walls_;
+	unsigned int cells_walls_offsets_[ MapData::c_map_size * MapData::c_map_size + 1u ];
+
+	std::vector<CellVisibility> cells_visibility_;
+	std::vector<bool> cells_visibility_calculated_;
+};
+
+} // namespace PanzerChasm
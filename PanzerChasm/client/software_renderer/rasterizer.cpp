@@ -5,6 +5,12 @@
 #ifdef PC_MMX_INSTRUCTIONS
 #include <mmintrin.h>
 #endif
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
+#if defined(PC_SSE2_INSTRUCTIONS) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "rasterizer.hpp"
 
@@ -20,7 +26,12 @@ Rasterizer::Rasterizer(
 	, viewport_size_y_( int(viewport_size_y) )
 	, row_size_( int(row_size) )
 	, color_buffer_( color_buffer )
+	, y_clip_start_( 0 )
+	, y_clip_end_( int(viewport_size_y) )
 {
+	PC_ASSERT( int(viewport_size_x) + c_guard_band_size * 2 <= c_max_viewport_size_with_guard_band );
+	PC_ASSERT( int(viewport_size_y) + c_guard_band_size * 2 <= c_max_viewport_size_with_guard_band );
+
 	{ // Setup depth buffer and depth buffer hierarchy.
 		unsigned int memory_for_depth_required= 0u;
 		depth_buffer_width_= ( viewport_size_x + 1u ) & (~1u);
@@ -83,9 +94,52 @@ Rasterizer::Rasterizer(
 	}
 }
 
+Rasterizer::Rasterizer(
+	const Rasterizer& buffers_owner,
+	const unsigned int y_start,
+	const unsigned int y_end )
+	: viewport_size_x_( buffers_owner.viewport_size_x_ )
+	, viewport_size_y_( buffers_owner.viewport_size_y_ )
+	, row_size_( buffers_owner.row_size_ )
+	, color_buffer_( buffers_owner.color_buffer_ )
+	, y_clip_start_( std::max( 0, int(y_start) ) )
+	, y_clip_end_( std::min( buffers_owner.viewport_size_y_, int(y_end) ) )
+	, depth_buffer_( buffers_owner.depth_buffer_ )
+	, depth_buffer_width_( buffers_owner.depth_buffer_width_ )
+	, occlusion_buffer_( buffers_owner.occlusion_buffer_ )
+	, occlusion_buffer_width_( buffers_owner.occlusion_buffer_width_ )
+	, occlusion_buffer_height_( buffers_owner.occlusion_buffer_height_ )
+{
+	PC_ASSERT( y_clip_start_ <= y_clip_end_ );
+
+	// Share hierarchy too, but only for reading.
+	for( unsigned int i= 0u; i < c_depth_buffer_hierarchy_levels; i++ )
+		depth_buffer_hierarchy_[i]= buffers_owner.depth_buffer_hierarchy_[i];
+	for( unsigned int i= 0u; i < c_occlusion_hierarchy_levels; i++ )
+		occlusion_hierarchy_levels_[i]= buffers_owner.occlusion_hierarchy_levels_[i];
+}
+
 Rasterizer::~Rasterizer()
 {}
 
+Rasterizer::InstructionSet Rasterizer::GetBestInstructionSet()
+{
+#ifdef PC_SSE2_INSTRUCTIONS
+	#if defined(__GNUC__)
+	if( __builtin_cpu_supports( "sse2" ) )
+		return InstructionSet::SSE2;
+	#elif defined(_MSC_VER)
+	int cpu_info[4];
+	__cpuid( cpu_info, 1 );
+	if( ( cpu_info[3] & ( 1 << 26 ) ) != 0 ) // SSE2 bit in edx.
+		return InstructionSet::SSE2;
+	#else
+	return InstructionSet::SSE2;
+	#endif
+#endif
+	return InstructionSet::Scalar;
+}
+
 void Rasterizer::ClearDepthBuffer()
 {
 	std::memset(
@@ -177,14 +231,59 @@ void Rasterizer::ClearOcclusionBuffer()
 	}
 }
 
-void Rasterizer::BuildDepthBufferHierarchy()
+fixed16_t Rasterizer::GetTrianglePartEdgeX( const unsigned int edge, const fixed16_t y_cut ) const
+{
+	const RasterizerVertexCoord& v0= triangle_part_vertices_[ edge * 2u      ];
+	const RasterizerVertexCoord& v1= triangle_part_vertices_[ edge * 2u + 1u ];
+
+	const fixed16_t dy= v1.y - v0.y;
+	if( dy == 0 )
+		return v0.x;
+	return v0.x + FixedMulDiv( y_cut, v1.x - v0.x, dy );
+}
+
+unsigned int Rasterizer::GetDepthBufferHierarchyBandCount() const
+{
+	return depth_buffer_hierarchy_[ c_depth_buffer_hierarchy_levels - 1u ].height;
+}
+
+void Rasterizer::BuildDepthBufferHierarchy( const InstructionSet instruction_set )
+{
+	BuildDepthBufferHierarchyFirstLevelRows( 0u, depth_buffer_hierarchy_[0].height, instruction_set );
+	for( unsigned int i= 1u; i < c_depth_buffer_hierarchy_levels; i++ )
+		BuildDepthBufferHierarchyLevelRows( i, 0u, depth_buffer_hierarchy_[i].height, instruction_set );
+}
+
+void Rasterizer::BuildDepthBufferHierarchyBand( const unsigned int band, const InstructionSet instruction_set )
+{
+	PC_ASSERT( band < GetDepthBufferHierarchyBandCount() );
+
+	// Each row of level depends only on two rows of previous level, so, bands of last level rows are independent.
+	for( unsigned int i= 0u; i < c_depth_buffer_hierarchy_levels; i++ )
+	{
+		const unsigned int band_rows_log2= c_depth_buffer_hierarchy_levels - 1u - i;
+		const unsigned int y_start= band << band_rows_log2;
+		const unsigned int y_end= std::min( ( band + 1u ) << band_rows_log2, depth_buffer_hierarchy_[i].height );
+
+		if( i == 0u )
+			BuildDepthBufferHierarchyFirstLevelRows( y_start, y_end, instruction_set );
+		else
+			BuildDepthBufferHierarchyLevelRows( i, y_start, y_end, instruction_set );
+	}
+}
+
+void Rasterizer::BuildDepthBufferHierarchyFirstLevelRows(
+	const unsigned int y_start, const unsigned int y_end,
+	const InstructionSet instruction_set )
 {
+	PC_UNUSED( instruction_set );
+
 	const unsigned int first_level_size_truncated_x= static_cast<unsigned int>( viewport_size_x_ ) / c_first_depth_hierarchy_level_size;
 	const unsigned int first_level_size_truncated_y= static_cast<unsigned int>( viewport_size_y_ ) / c_first_depth_hierarchy_level_size;
 	const unsigned int first_level_x_left= static_cast<unsigned int>( viewport_size_x_ ) % c_first_depth_hierarchy_level_size;
 	const unsigned int first_level_y_left= static_cast<unsigned int>( viewport_size_y_ ) % c_first_depth_hierarchy_level_size;
 
-	for( unsigned int y= 0u; y < first_level_size_truncated_y; y++ )
+	for( unsigned int y= y_start; y < std::min( y_end, first_level_size_truncated_y ); y++ )
 	{
 		const unsigned short* src[ c_first_depth_hierarchy_level_size ];
 		for( unsigned int i= 0u; i < c_first_depth_hierarchy_level_size; i++ )
@@ -192,7 +291,35 @@ void Rasterizer::BuildDepthBufferHierarchy()
 
 		unsigned short* const dst= depth_buffer_hierarchy_[0].data + y * depth_buffer_hierarchy_[0].width;
 
-		for( unsigned int x= 0u; x < first_level_size_truncated_x; x++ )
+		unsigned int x= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+		if( instruction_set == InstructionSet::SSE2 )
+		{
+			// SSE2 has only signed 16-bit min, so, shift values range to signed.
+			const __m128i sign_bias= _mm_set1_epi16( static_cast<short>(0x8000) );
+
+			// Two cells per step.
+			for( ; x + 2u <= first_level_size_truncated_x; x+= 2u )
+			{
+				const unsigned int src_x= x * c_first_depth_hierarchy_level_size;
+				const __m128i r0= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[0] + src_x ) ), sign_bias );
+				const __m128i r1= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[1] + src_x ) ), sign_bias );
+				const __m128i r2= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[2] + src_x ) ), sign_bias );
+				const __m128i r3= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[3] + src_x ) ), sign_bias );
+
+				// Min of rows, than min inside each 64-bit lane - results are in words 0 and 4.
+				__m128i m= _mm_min_epi16( _mm_min_epi16( r0, r1 ), _mm_min_epi16( r2, r3 ) );
+				m= _mm_min_epi16( m, _mm_srli_epi64( m, 16 ) );
+				m= _mm_min_epi16( m, _mm_srli_epi64( m, 32 ) );
+
+				dst[x     ]= static_cast<unsigned short>( _mm_extract_epi16( m, 0 ) ^ 0x8000 );
+				dst[x + 1u]= static_cast<unsigned short>( _mm_extract_epi16( m, 4 ) ^ 0x8000 );
+			}
+		}
+#endif
+
+		for( ; x < first_level_size_truncated_x; x++ )
 		{
 			const unsigned int src_x= x * c_first_depth_hierarchy_level_size;
 			/*
@@ -253,7 +380,7 @@ void Rasterizer::BuildDepthBufferHierarchy()
 	}
 
 	// Last partial row.
-	if( first_level_y_left > 0u )
+	if( first_level_y_left > 0u && first_level_size_truncated_y >= y_start && first_level_size_truncated_y < y_end )
 	{
 		const unsigned int y= first_level_size_truncated_y;
 		PC_ASSERT( y == depth_buffer_hierarchy_[0].height - 1u );
@@ -285,59 +412,95 @@ void Rasterizer::BuildDepthBufferHierarchy()
 			dst[x]= min_depth;
 		}
 	}
+}
 
-	// Fill hierarchy levels
-	for( unsigned int i= 1u; i < c_depth_buffer_hierarchy_levels; i++ )
+void Rasterizer::BuildDepthBufferHierarchyLevelRows(
+	const unsigned int level,
+	const unsigned int y_start, const unsigned int y_end,
+	const InstructionSet instruction_set )
+{
+	PC_ASSERT( level > 0u && level < c_depth_buffer_hierarchy_levels );
+	PC_UNUSED( instruction_set );
+
+	const unsigned int size_truncated_x= depth_buffer_hierarchy_[level-1u].width  / 2u;
+	const unsigned int size_truncated_y= depth_buffer_hierarchy_[level-1u].height / 2u;
+	const unsigned int x_left= depth_buffer_hierarchy_[level-1u].width  % 2u;
+	const unsigned int y_left= depth_buffer_hierarchy_[level-1u].height % 2u;
+
+	for( unsigned int y= y_start; y < std::min( y_end, size_truncated_y ); y++ )
 	{
-		const unsigned int size_truncated_x= depth_buffer_hierarchy_[i-1u].width  / 2u;
-		const unsigned int size_truncated_y= depth_buffer_hierarchy_[i-1u].height / 2u;
-		const unsigned int x_left= depth_buffer_hierarchy_[i-1u].width  % 2u;
-		const unsigned int y_left= depth_buffer_hierarchy_[i-1u].height % 2u;
+		const unsigned short* const src[2]=
+		{
+			depth_buffer_hierarchy_[level-1u].data + (y*2u   ) * depth_buffer_hierarchy_[level-1u].width,
+			depth_buffer_hierarchy_[level-1u].data + (y*2u+1u) * depth_buffer_hierarchy_[level-1u].width,
+		};
+		unsigned short* const dst= depth_buffer_hierarchy_[level].data + y * depth_buffer_hierarchy_[level].width;
 
-		for( unsigned int y= 0u; y < size_truncated_y; y++ )
+		unsigned int x= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+		if( instruction_set == InstructionSet::SSE2 )
 		{
-			const unsigned short* const src[2]=
-			{
-				depth_buffer_hierarchy_[i-1u].data + (y*2u   ) * depth_buffer_hierarchy_[i-1u].width,
-				depth_buffer_hierarchy_[i-1u].data + (y*2u+1u) * depth_buffer_hierarchy_[i-1u].width,
-			};
-			unsigned short* const dst= depth_buffer_hierarchy_[i].data + y * depth_buffer_hierarchy_[i].width;
-
-			for( unsigned int x= 0u; x < size_truncated_x; x++ )
-				dst[x]=
-					std::min(
-						std::min( src[0][x*2u], src[0][x*2u+1u] ),
-						std::min( src[1][x*2u], src[1][x*2u+1u] ) );
-
-			// Last partial column.
-			if( x_left > 0u )
+			const __m128i sign_bias= _mm_set1_epi16( static_cast<short>(0x8000) );
+
+			// Eight cells per step.
+			for( ; x + 8u <= size_truncated_x; x+= 8u )
 			{
-				PC_ASSERT( x_left == 1u );
-				dst[ size_truncated_x ]=
-					std::min( src[0][ size_truncated_x * 2u ], src[1][ size_truncated_x * 2u ] );
+				const __m128i a0= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[0] + x * 2u      ) ), sign_bias );
+				const __m128i a1= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[0] + x * 2u + 8u ) ), sign_bias );
+				const __m128i b0= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[1] + x * 2u      ) ), sign_bias );
+				const __m128i b1= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src[1] + x * 2u + 8u ) ), sign_bias );
+
+				// Min of rows, than min of words pairs - results are in low words of 32-bit lanes.
+				__m128i m0= _mm_min_epi16( a0, b0 );
+				__m128i m1= _mm_min_epi16( a1, b1 );
+				m0= _mm_min_epi16( m0, _mm_srli_epi32( m0, 16 ) );
+				m1= _mm_min_epi16( m1, _mm_srli_epi32( m1, 16 ) );
+
+				// Sign-extend low words, than pack it - values are in range, so, saturation does nothing.
+				m0= _mm_srai_epi32( _mm_slli_epi32( m0, 16 ), 16 );
+				m1= _mm_srai_epi32( _mm_slli_epi32( m1, 16 ), 16 );
+				const __m128i result= _mm_xor_si128( _mm_packs_epi32( m0, m1 ), sign_bias );
+
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( dst + x ), result );
 			}
 		}
+#endif
+
+		for( ; x < size_truncated_x; x++ )
+			dst[x]=
+				std::min(
+					std::min( src[0][x*2u], src[0][x*2u+1u] ),
+					std::min( src[1][x*2u], src[1][x*2u+1u] ) );
 
-		// Last partial row.
-		if( y_left > 0u )
+		// Last partial column.
+		if( x_left > 0u )
 		{
-			PC_ASSERT( y_left == 1u );
-			const unsigned int y= size_truncated_y;
+			PC_ASSERT( x_left == 1u );
+			dst[ size_truncated_x ]=
+				std::min( src[0][ size_truncated_x * 2u ], src[1][ size_truncated_x * 2u ] );
+		}
+	}
 
-			const unsigned short* const src= depth_buffer_hierarchy_[i-1u].data + (y*2u) * depth_buffer_hierarchy_[i-1u].width;
-			unsigned short* const dst= depth_buffer_hierarchy_[i].data + y * depth_buffer_hierarchy_[i].width;
+	// Last partial row.
+	if( y_left > 0u && size_truncated_y >= y_start && size_truncated_y < y_end )
+	{
+		PC_ASSERT( y_left == 1u );
+		const unsigned int y= size_truncated_y;
 
-			for( unsigned int x= 0u; x < size_truncated_x; x++ )
-				dst[x]= std::min( src[x*2u], src[x*2u+1u] );
+		const unsigned short* const src= depth_buffer_hierarchy_[level-1u].data + (y*2u) * depth_buffer_hierarchy_[level-1u].width;
+		unsigned short* const dst= depth_buffer_hierarchy_[level].data + y * depth_buffer_hierarchy_[level].width;
 
-			// Last partial column.
-			if( x_left > 0u )
-			{
-				PC_ASSERT( x_left == 1u );
-				dst[ size_truncated_x ]= src[ size_truncated_x * 2u ];
-			}
+		for( unsigned int x= 0u; x < size_truncated_x; x++ )
+			dst[x]= std::min( src[x*2u], src[x*2u+1u] );
+
+		// Last partial column.
+		if( x_left > 0u )
+		{
+			PC_ASSERT( x_left == 1u );
+			dst[ size_truncated_x ]= src[ size_truncated_x * 2u ];
 		}
-	} // for hierarchy levels
+	}
 }
 
 bool Rasterizer::IsDepthOccluded(
@@ -350,6 +513,34 @@ bool Rasterizer::IsDepthOccluded(
 
 	const unsigned short depth= Fixed16Div( g_fixed16_one >> c_max_inv_z_min_log2, z_min );
 
+	return IsDepthOccludedImpl( x_min, y_min, x_max, y_max, depth, InstructionSet::Scalar );
+}
+
+void Rasterizer::CheckDepthOcclusion(
+	const DepthOcclusionQuery* const queries, const unsigned int query_count,
+	uint32_t* const out_occluded_mask,
+	const InstructionSet instruction_set ) const
+{
+	std::memset( out_occluded_mask, 0, ( ( query_count + 31u ) / 32u ) * sizeof(uint32_t) );
+
+	for( unsigned int i= 0u; i < query_count; i++ )
+	{
+		const DepthOcclusionQuery& query= queries[i];
+		PC_ASSERT( query.z_min > ( g_fixed16_one >> c_max_inv_z_min_log2 ) );
+
+		const unsigned short depth= Fixed16Div( g_fixed16_one >> c_max_inv_z_min_log2, query.z_min );
+		if( IsDepthOccludedImpl( query.x_min, query.y_min, query.x_max, query.y_max, depth, instruction_set ) )
+			out_occluded_mask[ i >> 5u ]|= 1u << ( i & 31u );
+	}
+}
+
+bool Rasterizer::IsDepthOccludedImpl(
+	const fixed16_t x_min, const fixed16_t y_min, const fixed16_t x_max, const fixed16_t y_max,
+	const unsigned short depth,
+	const InstructionSet instruction_set ) const
+{
+	PC_UNUSED( instruction_set );
+
 	PC_ASSERT( x_min <= x_max );
 	PC_ASSERT( y_min <= y_max );
 	// Ceil delta to nearest integer.
@@ -375,10 +566,30 @@ bool Rasterizer::IsDepthOccluded(
 	const int hierarchy_y_max= std::min( ( y_max >> ( 16 + hierarchy_level ) ) / int(c_first_depth_hierarchy_level_size), int(depth_hierarchy.height) - 1 );
 
 	for( int y= hierarchy_y_min; y <= hierarchy_y_max; y++ )
-	for( int x= hierarchy_x_min; x <= hierarchy_x_max; x++ )
 	{
-		if( depth_hierarchy.data[ x + y * int(depth_hierarchy.width) ] < depth )
-			return false;
+		const unsigned short* const row= depth_hierarchy.data + y * int(depth_hierarchy.width);
+		int x= hierarchy_x_min;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+		if( instruction_set == InstructionSet::SSE2 )
+		{
+			// Compare eight cells per step. Use signed compare for biased values.
+			const __m128i sign_bias= _mm_set1_epi16( static_cast<short>(0x8000) );
+			const __m128i depth_biased= _mm_set1_epi16( static_cast<short>( depth ^ 0x8000u ) );
+			for( ; x + 8 <= hierarchy_x_max + 1; x+= 8 )
+			{
+				const __m128i cells= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( row + x ) ), sign_bias );
+				if( _mm_movemask_epi8( _mm_cmplt_epi16( cells, depth_biased ) ) != 0 )
+					return false;
+			}
+		}
+#endif
+
+		for( ; x <= hierarchy_x_max; x++ )
+		{
+			if( row[x] < depth )
+				return false;
+		}
 	}
 
 	// Debug output - draw screen space bounding box if occluded.
@@ -881,7 +1092,38 @@ void Rasterizer::DrawFullscreenBlend(
 	unsigned char color_components4[4]= { 0u };
 	std::memcpy( color_components4, color_components, 3u );
 
-#ifdef PC_MMX_INSTRUCTIONS
+#if defined(PC_SSE2_INSTRUCTIONS)
+	const __m128i zero= _mm_setzero_si128();
+	const __m128i blend_color= _mm_cvtsi32_si128( *reinterpret_cast<int*>( color_components4 ) );
+	const __m128i blend_color_depacked= _mm_unpacklo_epi8( _mm_shuffle_epi32( blend_color, 0 ), zero );
+	const __m128i premultiplied_blend_color= _mm_mullo_epi16( blend_color_depacked, _mm_set1_epi16( alpha ) );
+	const __m128i one_minus_alpha= _mm_set1_epi16( 256u - alpha );
+
+	const auto blend=
+	[&]( const __m128i dst_color_depacked ) -> __m128i
+	{
+		const __m128i dst_color_scaled= _mm_mullo_epi16( dst_color_depacked, one_minus_alpha );
+		return _mm_srli_epi16( _mm_add_epi16( dst_color_scaled, premultiplied_blend_color ), 8 );
+	};
+
+	// Process 4 pixels per iteration.
+	const unsigned int vector_count= pixel_count / 4u;
+	for( unsigned int i= 0u; i < vector_count; i++ )
+	{
+		__m128i* const dst= reinterpret_cast<__m128i*>( color_buffer_ + i * 4u );
+		const __m128i dst_color= _mm_loadu_si128( dst );
+		const __m128i result_lo= blend( _mm_unpacklo_epi8( dst_color, zero ) );
+		const __m128i result_hi= blend( _mm_unpackhi_epi8( dst_color, zero ) );
+		_mm_storeu_si128( dst, _mm_packus_epi16( result_lo, result_hi ) );
+	}
+
+	for( unsigned int i= vector_count * 4u; i < pixel_count; i++ )
+	{
+		const __m128i dst_color= _mm_cvtsi32_si128( color_buffer_[i] );
+		const __m128i result= blend( _mm_unpacklo_epi8( dst_color, zero ) );
+		color_buffer_[i]= _mm_cvtsi128_si32( _mm_packus_epi16( result, zero ) );
+	}
+#elif defined(PC_MMX_INSTRUCTIONS)
 	__m64 mm_zero= _mm_setzero_si64();
 	__m64 mm_blend_color= _mm_cvtsi32_si64( *reinterpret_cast<int*>( color_components4 ) );
 	__m64 mm_blend_color_depacked= _mm_unpacklo_pi8( mm_blend_color, mm_zero );
@@ -1261,13 +1503,13 @@ void Rasterizer::DrawAffineColoredTrianglePart( const uint32_t color )
 {
 	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
 	const fixed16_t y_end_f  = std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
-	const int y_start= std::max( 0, Fixed16RoundToInt( y_start_f ) );
-	const int y_end  = std::min( viewport_size_y_, Fixed16RoundToInt( y_end_f ) );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
 
 	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
 	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
-	fixed16_t x_left = triangle_part_vertices_[0].x + Fixed16Mul( y_cut_left , triangle_part_x_step_left_  );
-	fixed16_t x_right= triangle_part_vertices_[2].x + Fixed16Mul( y_cut_right, triangle_part_x_step_right_ );
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
 	for(
 		int y= y_start;
 		y< y_end;
@@ -1290,13 +1532,13 @@ void Rasterizer::DrawShadowTrianglePart()
 {
 	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
 	const fixed16_t y_end_f  = std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
-	const int y_start= std::max( 0, Fixed16RoundToInt( y_start_f ) );
-	const int y_end  = std::min( viewport_size_y_, Fixed16RoundToInt( y_end_f ) );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
 
 	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
 	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
-	fixed16_t x_left = triangle_part_vertices_[0].x + Fixed16Mul( y_cut_left , triangle_part_x_step_left_  );
-	fixed16_t x_right= triangle_part_vertices_[2].x + Fixed16Mul( y_cut_right, triangle_part_x_step_right_ );
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
 	fixed_base_t inv_z_scaled_left= triangle_part_inv_z_scaled_left_ + Fixed16Mul( y_cut_left, triangle_part_inv_z_scaled_step_left_ );
 
 	for(
@@ -44,6 +44,11 @@ public:
 
 	static constexpr unsigned int c_max_polygon_vertices= 14u;
 
+	// Vertices may lie outside viewport, but not farther, than guard band size.
+	// Such vertices are safe for fixed16 setup math, so, callers may skip clipping by side planes of view.
+	static constexpr int c_guard_band_size= 2048;
+	static constexpr int c_max_viewport_size_with_guard_band= 8192;
+
 	typedef void (Rasterizer::*TriangleDrawFunc)(const RasterizerVertex*);
 	typedef void (Rasterizer::*ConvexPolygonDrawFunc)(const RasterizerVertex*, unsigned int, bool);
 
@@ -63,6 +68,8 @@ public:
 	{ Yes, No };
 	enum class DepthHack
 	{ Yes, No };
+	enum class InstructionSet
+	{ Scalar, SSE2 };
 
 	Rasterizer(
 		unsigned int viewport_size_x,
@@ -70,16 +77,43 @@ public:
 		unsigned int row_size /* Greater or equal to viewport_size_x */,
 		uint32_t* color_buffer );
 
+	// Create rasterizer, which draws into buffers of "buffers_owner", but only rows in range [ y_start; y_end ).
+	// Rasterizers with non-overlapping rows ranges may draw into same buffers in parallel.
+	// Do not clear buffers or use hierarchy methods of such rasterizer - do it with buffers owner.
+	Rasterizer( const Rasterizer& buffers_owner, unsigned int y_start, unsigned int y_end );
+
 	~Rasterizer();
 
+	// Returns best instruction set, supported by both build and current CPU.
+	static InstructionSet GetBestInstructionSet();
+
 	void ClearDepthBuffer();
 	void ClearOcclusionBuffer();
-	void BuildDepthBufferHierarchy();
+	void BuildDepthBufferHierarchy( InstructionSet instruction_set= InstructionSet::Scalar );
+
+	// Depth buffer hierarchy may be built by independent horizontal bands - one band for each row of last hierarchy level.
+	// Different bands may be built in parallel.
+	unsigned int GetDepthBufferHierarchyBandCount() const;
+	void BuildDepthBufferHierarchyBand( unsigned int band, InstructionSet instruction_set= InstructionSet::Scalar );
 
 	bool IsDepthOccluded(
 		fixed16_t x_min, fixed16_t y_min, fixed16_t x_max, fixed16_t y_max,
 		fixed16_t z_min, fixed16_t z_max ) const;
 
+	// Screen-space box for batched depth occlusion test.
+	struct DepthOcclusionQuery
+	{
+		fixed16_t x_min, y_min, x_max, y_max;
+		fixed16_t z_min;
+	};
+
+	// Test many boxes against depth hierarchy. Bit i of "out_occluded_mask" is set, if box i is occluded.
+	// "out_occluded_mask" must contain at least ( query_count + 31 ) / 32 elements.
+	void CheckDepthOcclusion(
+		const DepthOcclusionQuery* queries, unsigned int query_count,
+		uint32_t* out_occluded_mask,
+		InstructionSet instruction_set= InstructionSet::Scalar ) const;
+
 	void UpdateOcclusionHierarchy( const RasterizerVertex* polygon_vertices, unsigned int polygon_vertex_count, bool has_alpha );
 	bool IsOccluded( const RasterizerVertex* polygon_vertices, unsigned int polygon_vertex_count ) const;
 
@@ -120,7 +154,8 @@ public:
 		DepthTest depth_test, DepthWrite depth_write,
 		AlphaTest alpha_test,
 		OcclusionTest occlusion_test, OcclusionWrite occlusion_write,
-		Lighting lighting= Lighting::No, Blending blending= Blending::No, DepthHack depth_hack= DepthHack::No>
+		Lighting lighting= Lighting::No, Blending blending= Blending::No, DepthHack depth_hack= DepthHack::No,
+		InstructionSet instruction_set= InstructionSet::Scalar>
 	void DrawTexturedTriangleSpanCorrected( const RasterizerVertex* trianlge_vertices );
 
 	template<
@@ -134,13 +169,49 @@ public:
 		DepthTest depth_test, DepthWrite depth_write,
 		AlphaTest alpha_test,
 		OcclusionTest occlusion_test, OcclusionWrite occlusion_write,
-		Lighting lighting= Lighting::No, Blending= Blending::No>
+		Lighting lighting= Lighting::No, Blending= Blending::No,
+		InstructionSet instruction_set= InstructionSet::Scalar>
 	void DrawTexturedConvexPolygonSpanCorrected( const RasterizerVertex* trianlge_vertices, unsigned int vertex_count, bool is_anticlockwise );
 
+	// Specialized function for floors and ceilings - opaque polygons with prelit textures, without depth test, with depth write and occlusion write.
+	// Pixels are processed in groups of 8, for which occlusion buffer has single byte,
+	// so, fully occluded and fully unoccluded groups are drawn without per-pixel occlusion checks.
+	template<OcclusionTest occlusion_test>
+	void DrawFloorConvexPolygon( const RasterizerVertex* polygon_vertices, unsigned int vertex_count, bool is_anticlockwise );
+
+	// Kernels dispatch - select instantiation of span-corrected functions for instruction set, known only at runtime.
+	template<
+		DepthTest depth_test, DepthWrite depth_write,
+		AlphaTest alpha_test,
+		OcclusionTest occlusion_test, OcclusionWrite occlusion_write,
+		Lighting lighting= Lighting::No, Blending blending= Blending::No, DepthHack depth_hack= DepthHack::No>
+	static TriangleDrawFunc GetTexturedTriangleSpanCorrectedFunc( InstructionSet instruction_set );
+
+	template<
+		DepthTest depth_test, DepthWrite depth_write,
+		AlphaTest alpha_test,
+		OcclusionTest occlusion_test, OcclusionWrite occlusion_write,
+		Lighting lighting= Lighting::No, Blending blending= Blending::No>
+	static ConvexPolygonDrawFunc GetTexturedConvexPolygonSpanCorrectedFunc( InstructionSet instruction_set );
+
 private:
 	typedef void (Rasterizer::*TrianglePartDrawFunc)();
 
 private:
+	// Build rows in range [ y_start; y_end ) of depth hierarchy level.
+	void BuildDepthBufferHierarchyFirstLevelRows( unsigned int y_start, unsigned int y_end, InstructionSet instruction_set );
+	void BuildDepthBufferHierarchyLevelRows( unsigned int level, unsigned int y_start, unsigned int y_end, InstructionSet instruction_set );
+
+	// "depth" - depth buffer value of nearest box point.
+	bool IsDepthOccludedImpl(
+		fixed16_t x_min, fixed16_t y_min, fixed16_t x_max, fixed16_t y_max,
+		unsigned short depth,
+		InstructionSet instruction_set ) const;
+
+	// Returns x of triangle part edge ( 0 - left, 1 - right ) for given y offset from start of edge.
+	// Uses 64-bit math, so, result is exact even for steep edges with imprecise steps and for vertices inside guard band.
+	fixed16_t GetTrianglePartEdgeX( unsigned int edge, fixed16_t y_cut ) const;
+
 	// Returns 1, if cell fully occluded, else - 0
 	template<unsigned int level>
 	unsigned int UpdateOcclusionHierarchyCell_r( unsigned int cell_x, unsigned int cell_y );
@@ -179,9 +250,28 @@ private:
 		DepthTest depth_test, DepthWrite depth_write,
 		AlphaTest alpha_test,
 		OcclusionTest occlusion_test, OcclusionWrite occlusion_write,
-		Lighting lighting, Blending blending= Blending::No, DepthHack depth_hack= DepthHack::No>
+		Lighting lighting, Blending blending= Blending::No, DepthHack depth_hack= DepthHack::No,
+		InstructionSet instruction_set= InstructionSet::Scalar>
 	void DrawTexturedTriangleSpanCorrectedPart();
 
+	template<OcclusionTest occlusion_test>
+	void DrawFloorTrianglePart();
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	// Draw full span with linear texture coordinates. Returns new span occlusion value.
+	template<
+		DepthTest depth_test, DepthWrite depth_write,
+		AlphaTest alpha_test,
+		OcclusionWrite occlusion_write,
+		Lighting lighting, Blending blending, DepthHack depth_hack>
+	SpanOcclusionType DrawTexturedSpanSSE2(
+		uint32_t* dst, unsigned short* depth_dst,
+		fixed_base_t inv_z_scaled,
+		const fixed16_t* tc, const fixed16_t* tc_step,
+		SpanOcclusionType occlusion_value,
+		SpanOcclusionType pixels_mask );
+#endif
+
 private:
 	// Use only SIGNED types inside rasterizer.
 
@@ -191,6 +281,10 @@ private:
 	const int row_size_;
 	uint32_t* const color_buffer_;
 
+	// Rows range for triangles drawing.
+	const int y_clip_start_;
+	const int y_clip_end_;
+
 	// Depth buffer
 	std::vector<unsigned short> depth_buffer_storage_;
 	unsigned short* depth_buffer_;
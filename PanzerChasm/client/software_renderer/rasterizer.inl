@@ -4,6 +4,9 @@
 #ifdef PC_MMX_INSTRUCTIONS
 #include <mmintrin.h>
 #endif
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
 
 static constexpr bool g_rasterizer_use_faster_tex_coord_z_div= true;
 
@@ -496,8 +499,8 @@ void Rasterizer::DrawConvexPolygonPerspectiveCorrectedImpl(
 			const fixed16_t middle_dy_right= middle_y - triangle_part_vertices_[2].y;
 
 			// Calculate middle line start/end values.
-			const fixed16_t x_left = vertices[ left_index  ].x + Fixed16Mul( middle_dy_left , triangle_part_x_step_left_  );
-			const fixed16_t x_right= vertices[ right_index ].x + Fixed16Mul( middle_dy_right, triangle_part_x_step_right_ );
+			const fixed16_t x_left = GetTrianglePartEdgeX( 0u, middle_dy_left  );
+			const fixed16_t x_right= GetTrianglePartEdgeX( 1u, middle_dy_right );
 			const fixed16_t dx= x_right - x_left;
 			if( dx > 0 )
 			{
@@ -531,13 +534,13 @@ void Rasterizer::DrawAffineTexturedTrianglePart()
 {
 	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
 	const fixed16_t y_end_f  = std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
-	const int y_start= std::max( 0, Fixed16RoundToInt( y_start_f ) );
-	const int y_end  = std::min( viewport_size_y_, Fixed16RoundToInt( y_end_f ) );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
 
 	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
 	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
-	fixed16_t x_left = triangle_part_vertices_[0].x + Fixed16Mul( y_cut_left , triangle_part_x_step_left_  );
-	fixed16_t x_right= triangle_part_vertices_[2].x + Fixed16Mul( y_cut_right, triangle_part_x_step_right_ );
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
 
 	fixed16_t tc_left[2], inv_z_scaled_left;
 	tc_left[0]= trianlge_part_tc_left_.u + Fixed16Mul( y_cut_left, traingle_part_tc_step_left_[0] );
@@ -642,13 +645,13 @@ void Rasterizer::DrawTexturedTrianglePerLineCorrectedPart()
 {
 	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
 	const fixed16_t y_end_f  = std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
-	const int y_start= std::max( 0, Fixed16RoundToInt( y_start_f ) );
-	const int y_end  = std::min( viewport_size_y_, Fixed16RoundToInt( y_end_f ) );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
 
 	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
 	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
-	fixed16_t x_left = triangle_part_vertices_[0].x + Fixed16Mul( y_cut_left , triangle_part_x_step_left_  );
-	fixed16_t x_right= triangle_part_vertices_[2].x + Fixed16Mul( y_cut_right, triangle_part_x_step_right_ );
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
 
 	fixed16_t tc_div_z_left[2], inv_z_scaled_left;
 	tc_div_z_left[0]= trianlge_part_tc_left_.u + Fixed16Mul( y_cut_left, traingle_part_tc_step_left_[0] );
@@ -779,11 +782,166 @@ void Rasterizer::DrawTexturedTrianglePerLineCorrectedPart()
 	} // for y
 }
 
+template<Rasterizer::OcclusionTest occlusion_test>
+void Rasterizer::DrawFloorTrianglePart()
+{
+	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
+	const fixed16_t y_end_f  = std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
+
+	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
+	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
+
+	fixed16_t tc_div_z_left[2], inv_z_scaled_left;
+	tc_div_z_left[0]= trianlge_part_tc_left_.u + Fixed16Mul( y_cut_left, traingle_part_tc_step_left_[0] );
+	tc_div_z_left[1]= trianlge_part_tc_left_.v + Fixed16Mul( y_cut_left, traingle_part_tc_step_left_[1] );
+	inv_z_scaled_left= triangle_part_inv_z_scaled_left_ + Fixed16Mul( y_cut_left, triangle_part_inv_z_scaled_step_left_ );
+
+	for(
+		int y= y_start;
+		y< y_end;
+		y++,
+		x_left += triangle_part_x_step_left_ ,
+		x_right+= triangle_part_x_step_right_,
+		tc_div_z_left[0]+= traingle_part_tc_step_left_[0],
+		tc_div_z_left[1]+= traingle_part_tc_step_left_[1],
+		inv_z_scaled_left+= triangle_part_inv_z_scaled_step_left_ )
+	{
+		int x_start= std::max( 0, Fixed16RoundToInt( x_left ) );
+		int x_end= std::min( viewport_size_x_, Fixed16RoundToInt( x_right ) );
+		if( x_end <= x_start ) continue;
+
+		uint8_t* const occlusion_dst= occlusion_buffer_ + y * occlusion_buffer_width_;
+
+		if( occlusion_test == OcclusionTest::Yes )
+		{
+			if( occlusion_dst[ x_start >> 3 ] == 0xFFu ) x_start= (x_start + 7) & (~7);
+			while( x_start < x_end && occlusion_dst[ x_start >> 3 ] == 0xFFu ) x_start+= 8;
+			if( occlusion_dst[ (x_end-1) >> 3 ] == 0xFFu ) x_end&= (~7);
+			while( x_start < x_end && occlusion_dst[ (x_end-1) >> 3 ] == 0xFFu ) x_end-= 8;
+			if( x_end <= x_start ) continue;
+		}
+
+		// Perspective division only for line start and end. Plane is horizontal, so, texture coordinates are nearly linear along line.
+		const int effective_dx= x_end - x_start - 1;
+		const fixed16_t x_cut= ( x_start << 16 ) + g_fixed16_half - x_left;
+
+		fixed16_t tc_div_z_start[2], tc_div_z_end[2], inv_z_scaled_start, inv_z_scaled_end, tc_start[2], tc_end[2], line_tc_step[2];
+
+		tc_div_z_start[0]= tc_div_z_left[0] + Fixed16Mul( x_cut, line_tc_step_[0] );
+		tc_div_z_start[1]= tc_div_z_left[1] + Fixed16Mul( x_cut, line_tc_step_[1] );
+
+		inv_z_scaled_start= inv_z_scaled_left  + Fixed16Mul( x_cut, line_inv_z_scaled_step_ );
+		if( inv_z_scaled_start < 0 ) inv_z_scaled_start= 0;
+
+		if( g_rasterizer_use_faster_tex_coord_z_div )
+		{
+			const fixed16_t z= FixedDiv< 16 + c_inv_z_scaler_log2 >( g_fixed16_one, inv_z_scaled_start );
+			tc_start[0]= Fixed16Mul( tc_div_z_start[0], z );
+			tc_start[1]= Fixed16Mul( tc_div_z_start[1], z );
+		}
+		else
+		{
+			tc_start[0]= FixedDiv< 16 + c_inv_z_scaler_log2 >( tc_div_z_start[0], inv_z_scaled_start );
+			tc_start[1]= FixedDiv< 16 + c_inv_z_scaler_log2 >( tc_div_z_start[1], inv_z_scaled_start );
+		}
+
+		if( tc_start[0] < 0 ) tc_start[0]= 0;
+		if( tc_start[0] > max_valid_tc_u_ ) tc_start[0]= max_valid_tc_u_;
+		if( tc_start[1] < 0 ) tc_start[1]= 0;
+		if( tc_start[1] > max_valid_tc_v_ ) tc_start[1]= max_valid_tc_v_;
+
+		if( effective_dx != 0 )
+		{
+			tc_div_z_end[0]= tc_div_z_start[0] + effective_dx * line_tc_step_[0];
+			tc_div_z_end[1]= tc_div_z_start[1] + effective_dx * line_tc_step_[1];
+
+			inv_z_scaled_end= inv_z_scaled_start + effective_dx * line_inv_z_scaled_step_;
+			if( inv_z_scaled_end < 0 ) inv_z_scaled_end= 0;
+
+			if( g_rasterizer_use_faster_tex_coord_z_div )
+			{
+				const fixed16_t z= FixedDiv< 16 + c_inv_z_scaler_log2 >( g_fixed16_one, inv_z_scaled_end );
+				tc_end[0]= Fixed16Mul( tc_div_z_end[0], z );
+				tc_end[1]= Fixed16Mul( tc_div_z_end[1], z );
+			}
+			else
+			{
+				tc_end[0]= FixedDiv< 16 + c_inv_z_scaler_log2 >( tc_div_z_end[0], inv_z_scaled_end );
+				tc_end[1]= FixedDiv< 16 + c_inv_z_scaler_log2 >( tc_div_z_end[1], inv_z_scaled_end );
+			}
+
+			if( tc_end[0] < 0 ) tc_end[0]= 0;
+			if( tc_end[0] > max_valid_tc_u_ ) tc_end[0]= max_valid_tc_u_;
+			if( tc_end[1] < 0 ) tc_end[1]= 0;
+			if( tc_end[1] > max_valid_tc_v_ ) tc_end[1]= max_valid_tc_v_;
+
+			line_tc_step[0]= ( tc_end[0] - tc_start[0] ) / effective_dx;
+			line_tc_step[1]= ( tc_end[1] - tc_start[1] ) / effective_dx;
+		}
+		else
+			line_tc_step[0]= line_tc_step[1]= 0;
+
+		fixed16_t line_tc[2], line_inv_z_scaled;
+		line_tc[0]= tc_start[0];
+		line_tc[1]= tc_start[1];
+		line_inv_z_scaled= inv_z_scaled_left + Fixed16Mul( x_cut, line_inv_z_scaled_step_ );
+
+		uint32_t* const dst= color_buffer_ + y * row_size_;
+		unsigned short* const depth_dst= depth_buffer_ + y * depth_buffer_width_;
+
+		// Process line by groups of pixels, which share one byte of occlusion buffer.
+		int x= x_start;
+		while( x < x_end )
+		{
+			const int group_start= x & (~7);
+			const int group_end= std::min( x_end, group_start + 8 );
+			uint8_t& occlusion_byte= occlusion_dst[ x >> 3 ];
+			const unsigned int group_mask= ( ( 1u << ( group_end - group_start ) ) - 1u ) & ~( ( 1u << ( x - group_start ) ) - 1u );
+
+			const unsigned int group_occlusion= occlusion_test == OcclusionTest::Yes ? ( occlusion_byte & group_mask ) : 0u;
+			if( group_occlusion == group_mask )
+			{
+				// Whole group is occluded.
+				const int count= group_end - x;
+				line_tc[0]+= count * line_tc_step[0];
+				line_tc[1]+= count * line_tc_step[1];
+				line_inv_z_scaled+= count * line_inv_z_scaled_step_;
+				x= group_end;
+				continue;
+			}
+
+			for( ; x < group_end; x++,
+				line_tc[0]+= line_tc_step[0], line_tc[1]+= line_tc_step[1],
+				line_inv_z_scaled+= line_inv_z_scaled_step_ )
+			{
+				// Per-pixel check only for partially occluded groups.
+				if( group_occlusion != 0u && ( group_occlusion & ( 1u << ( x & 7 ) ) ) != 0u )
+					continue;
+
+				const int u= line_tc[0] >> 16;
+				const int v= line_tc[1] >> 16;
+				PC_ASSERT( u >= 0 && u < texture_size_x_ );
+				PC_ASSERT( v >= 0 && v < texture_size_y_ );
+
+				depth_dst[x]= line_inv_z_scaled >> ( c_inv_z_scaler_log2 + c_max_inv_z_min_log2 );
+				dst[x]= texture_data_[ u + v * texture_size_x_ ];
+			}
+
+			occlusion_byte|= static_cast<uint8_t>( group_mask );
+		}
+	} // for y
+}
+
 template<
 	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
 	Rasterizer::AlphaTest alpha_test,
 	Rasterizer::OcclusionTest occlusion_test, Rasterizer::OcclusionWrite occlusion_write,
-	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack>
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack,
+	Rasterizer::InstructionSet instruction_set>
 void Rasterizer::DrawTexturedTriangleSpanCorrectedPart()
 {
 	// TODO - maybe add mmx lighting support for other triangle-filling functions?
@@ -815,13 +973,13 @@ void Rasterizer::DrawTexturedTriangleSpanCorrectedPart()
 
 	const fixed16_t y_start_f= std::max( triangle_part_vertices_[0].y, triangle_part_vertices_[2].y );
 	const fixed16_t y_end_f= std::min( triangle_part_vertices_[1].y, triangle_part_vertices_[3].y );
-	const int y_start= std::max( 0, Fixed16RoundToInt( y_start_f ) );
-	const int y_end  = std::min( viewport_size_y_, Fixed16RoundToInt( y_end_f ) );
+	const int y_start= std::max( y_clip_start_, Fixed16RoundToInt( y_start_f ) );
+	const int y_end  = std::min( y_clip_end_, Fixed16RoundToInt( y_end_f ) );
 
 	const fixed16_t y_cut_left = ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[0].y;
 	const fixed16_t y_cut_right= ( y_start << 16 ) + g_fixed16_half - triangle_part_vertices_[2].y;
-	fixed16_t x_left = triangle_part_vertices_[0].x + Fixed16Mul( y_cut_left , triangle_part_x_step_left_  );
-	fixed16_t x_right= triangle_part_vertices_[2].x + Fixed16Mul( y_cut_right, triangle_part_x_step_right_ );
+	fixed16_t x_left = GetTrianglePartEdgeX( 0u, y_cut_left  );
+	fixed16_t x_right= GetTrianglePartEdgeX( 1u, y_cut_right );
 
 	fixed16_t tc_div_z_left[2], inv_z_scaled_left;
 	tc_div_z_left[0]= trianlge_part_tc_left_.u + Fixed16Mul( y_cut_left, traingle_part_tc_step_left_[0] );
@@ -993,6 +1151,20 @@ void Rasterizer::DrawTexturedTriangleSpanCorrectedPart()
 			span_tc[0]= tc_current[0];
 			span_tc[1]= tc_current[1];
 
+#ifdef PC_SSE2_INSTRUCTIONS
+			if( instruction_set == InstructionSet::SSE2 )
+			{
+				occlusion_value=
+					DrawTexturedSpanSSE2< depth_test, depth_write, alpha_test, occlusion_write, lighting, blending, depth_hack >(
+						dst + span_x, depth_dst + span_x,
+						line_inv_z_scaled,
+						span_tc, tc_step,
+						occlusion_value,
+						occlusion_test == OcclusionTest::Yes ? SpanOcclusionType(~occlusion_value) : c_span_occlusion_value );
+				line_inv_z_scaled+= line_inv_z_scaled_step_ << c_z_correct_span_size_log2;
+			}
+			else
+#endif
 			for( int x= 0; x < c_z_correct_span_size;
 				x++, line_inv_z_scaled+= line_inv_z_scaled_step_,
 				span_tc[0]+= tc_step[0], span_tc[1]+= tc_step[1] )
@@ -1098,6 +1270,137 @@ void Rasterizer::DrawTexturedTriangleSpanCorrectedPart()
 	#undef DO_LIGHTING // Remove function-local macro.
 }
 
+#ifdef PC_SSE2_INSTRUCTIONS
+
+template<
+	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
+	Rasterizer::AlphaTest alpha_test,
+	Rasterizer::OcclusionWrite occlusion_write,
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack>
+inline Rasterizer::SpanOcclusionType Rasterizer::DrawTexturedSpanSSE2(
+	uint32_t* const dst, unsigned short* const depth_dst,
+	const fixed_base_t inv_z_scaled,
+	const fixed16_t* const tc, const fixed16_t* const tc_step,
+	SpanOcclusionType occlusion_value,
+	const SpanOcclusionType pixels_mask )
+{
+	static_assert( c_z_correct_span_size == 16, "This code works only for 16-pixels spans" );
+
+	if( pixels_mask == 0u )
+		return occlusion_value;
+
+	// Calculate depth for all span pixels. Each iteration calculates 8 pixels.
+	alignas(16) unsigned short depth[ c_z_correct_span_size ];
+	unsigned int mask= pixels_mask;
+	{
+		const __m128i inv_z_step4= _mm_set1_epi32( line_inv_z_scaled_step_ << 2 );
+		__m128i inv_z=
+			_mm_setr_epi32(
+				inv_z_scaled,
+				inv_z_scaled + line_inv_z_scaled_step_,
+				inv_z_scaled + line_inv_z_scaled_step_ * 2,
+				inv_z_scaled + line_inv_z_scaled_step_ * 3 );
+
+		__m128i depth_test_result[2];
+		for( unsigned int i= 0u; i < 2u; i++ )
+		{
+			__m128i d[2];
+			for( unsigned int j= 0u; j < 2u; j++, inv_z= _mm_add_epi32( inv_z, inv_z_step4 ) )
+			{
+				d[j]= _mm_srli_epi32( inv_z, c_inv_z_scaler_log2 + c_max_inv_z_min_log2 );
+				if( depth_hack == DepthHack::Yes )
+				{
+					d[j]= _mm_and_si128( d[j], _mm_set1_epi32( 0xFFFF ) );
+					d[j]= _mm_srli_epi32( _mm_add_epi32( d[j], _mm_set1_epi32( 65536 * 3 ) ), 2 );
+				}
+				// Sign-extend lower 16 bits, because SSE2 has only signed 32 to 16 bit pack.
+				d[j]= _mm_srai_epi32( _mm_slli_epi32( d[j], 16 ), 16 );
+			}
+
+			const __m128i depth8= _mm_packs_epi32( d[0], d[1] );
+			_mm_store_si128( reinterpret_cast<__m128i*>( depth + i * 8u ), depth8 );
+
+			if( depth_test == DepthTest::Yes )
+			{
+				// SSE2 has no unsigned 16-bit compare, so, flip sign bit and compare as signed.
+				const __m128i sign= _mm_set1_epi16( -32768 );
+				const __m128i old_depth= _mm_loadu_si128( reinterpret_cast<const __m128i*>( depth_dst + i * 8u ) );
+				depth_test_result[i]= _mm_cmpgt_epi16( _mm_xor_si128( depth8, sign ), _mm_xor_si128( old_depth, sign ) );
+			}
+		}
+
+		if( depth_test == DepthTest::Yes )
+			mask&= static_cast<unsigned int>( _mm_movemask_epi8( _mm_packs_epi16( depth_test_result[0], depth_test_result[1] ) ) );
+	}
+
+	if( mask == 0u )
+		return occlusion_value;
+
+	// Fetch texels. Texture fetch is scattered, so, do it in scalar code.
+	alignas(16) uint32_t texels[ c_z_correct_span_size ];
+	for( int x= 0; x < c_z_correct_span_size; x++ )
+	{
+		if( ( mask & ( 1u << x ) ) == 0u )
+		{
+			texels[x]= 0u;
+			continue;
+		}
+
+		const int u= ( tc[0] + tc_step[0] * x ) >> 16;
+		const int v= ( tc[1] + tc_step[1] * x ) >> 16;
+		PC_ASSERT( u >= 0 && u < texture_size_x_ );
+		PC_ASSERT( v >= 0 && v < texture_size_y_ );
+		const uint32_t tex_value= texture_data_[ u + v * texture_size_x_ ];
+		texels[x]= tex_value;
+
+		if( alpha_test == AlphaTest::Yes && (tex_value & c_alpha_mask) == 0u )
+		{
+			mask&= ~( 1u << x );
+			continue;
+		}
+		if( depth_write == DepthWrite::Yes ) depth_dst[x]= depth[x];
+		if( occlusion_write == OcclusionWrite::Yes && alpha_test == AlphaTest::Yes ) occlusion_value|= 1 << x;
+	}
+
+	// Light, blend and write 4 pixels per iteration.
+	const __m128i zero= _mm_setzero_si128();
+	const __m128i light= _mm_set1_epi16( static_cast<short>( light_ >> 2 ) ); // Store light in 10.6 fixed format.
+	const __m128i lane_bits= _mm_setr_epi32( 1, 2, 4, 8 );
+	for( unsigned int i= 0u; i < 16u; i+= 4u )
+	{
+		const unsigned int quad_mask= ( mask >> i ) & 15u;
+		if( quad_mask == 0u )
+			continue;
+
+		__m128i color= _mm_load_si128( reinterpret_cast<const __m128i*>( texels + i ) );
+		if( lighting == Lighting::Yes )
+		{
+			const __m128i lo= _mm_slli_epi16( _mm_mulhi_epi16( _mm_unpacklo_epi8( color, zero ), light ), 2 );
+			const __m128i hi= _mm_slli_epi16( _mm_mulhi_epi16( _mm_unpackhi_epi8( color, zero ), light ), 2 );
+			color= _mm_packus_epi16( lo, hi );
+		}
+
+		__m128i* const dst_quad= reinterpret_cast<__m128i*>( dst + i );
+		if( blending == Blending::Yes || quad_mask != 15u )
+		{
+			const __m128i old_color= _mm_loadu_si128( dst_quad );
+			if( blending == Blending::Yes )
+				color=
+					_mm_add_epi32(
+						_mm_srli_epi32( _mm_and_si128( _mm_xor_si128( old_color, color ), _mm_set1_epi32( 0xFEFEFEFE ) ), 1 ),
+						_mm_and_si128( old_color, color ) );
+
+			const __m128i write_mask= _mm_cmpeq_epi32( _mm_and_si128( _mm_set1_epi32( quad_mask ), lane_bits ), lane_bits );
+			color= _mm_or_si128( _mm_and_si128( write_mask, color ), _mm_andnot_si128( write_mask, old_color ) );
+		}
+		_mm_storeu_si128( dst_quad, color );
+	}
+
+	return occlusion_value;
+}
+
+#endif // PC_SSE2_INSTRUCTIONS
+
 template<
 	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
 	Rasterizer::AlphaTest alpha_test,
@@ -1115,12 +1418,13 @@ template<
 	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
 	Rasterizer::AlphaTest alpha_test,
 	Rasterizer::OcclusionTest occlusion_test, Rasterizer::OcclusionWrite occlusion_write,
-	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack>
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack,
+	Rasterizer::InstructionSet instruction_set>
 void Rasterizer::DrawTexturedTriangleSpanCorrected( const RasterizerVertex* vertices )
 {
 	DrawTrianglePerspectiveCorrectedImpl<
 		TrianglePartDrawFunc,
-		&Rasterizer::DrawTexturedTriangleSpanCorrectedPart<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, depth_hack > >
+		&Rasterizer::DrawTexturedTriangleSpanCorrectedPart<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, depth_hack, instruction_set > >
 			( vertices );
 }
 
@@ -1137,17 +1441,59 @@ void Rasterizer::DrawTexturedConvexPolygonPerLineCorrected(  const RasterizerVer
 			( vertices, vertex_count, is_anticlockwise );
 }
 
+template<Rasterizer::OcclusionTest occlusion_test>
+void Rasterizer::DrawFloorConvexPolygon( const RasterizerVertex* vertices, unsigned int vertex_count, bool is_anticlockwise )
+{
+	DrawConvexPolygonPerspectiveCorrectedImpl<
+		TrianglePartDrawFunc,
+		&Rasterizer::DrawFloorTrianglePart<occlusion_test> >
+			( vertices, vertex_count, is_anticlockwise );
+}
+
 template<
 	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
 	Rasterizer::AlphaTest alpha_test,
 	Rasterizer::OcclusionTest occlusion_test, Rasterizer::OcclusionWrite occlusion_write,
-	Rasterizer::Lighting lighting, Rasterizer::Blending blending>
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending,
+	Rasterizer::InstructionSet instruction_set>
 void Rasterizer::DrawTexturedConvexPolygonSpanCorrected(  const RasterizerVertex* vertices, unsigned int vertex_count, bool is_anticlockwise )
 {
 	DrawConvexPolygonPerspectiveCorrectedImpl<
 		TrianglePartDrawFunc,
-		&Rasterizer::DrawTexturedTriangleSpanCorrectedPart<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending > >
+		&Rasterizer::DrawTexturedTriangleSpanCorrectedPart<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, DepthHack::No, instruction_set > >
 			( vertices, vertex_count, is_anticlockwise );
 }
 
+template<
+	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
+	Rasterizer::AlphaTest alpha_test,
+	Rasterizer::OcclusionTest occlusion_test, Rasterizer::OcclusionWrite occlusion_write,
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending, Rasterizer::DepthHack depth_hack>
+Rasterizer::TriangleDrawFunc Rasterizer::GetTexturedTriangleSpanCorrectedFunc( const InstructionSet instruction_set )
+{
+#ifdef PC_SSE2_INSTRUCTIONS
+	if( instruction_set == InstructionSet::SSE2 )
+		return &Rasterizer::DrawTexturedTriangleSpanCorrected<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, depth_hack, InstructionSet::SSE2>;
+#else
+	PC_UNUSED( instruction_set );
+#endif
+	return &Rasterizer::DrawTexturedTriangleSpanCorrected<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, depth_hack, InstructionSet::Scalar>;
+}
+
+template<
+	Rasterizer::DepthTest depth_test, Rasterizer::DepthWrite depth_write,
+	Rasterizer::AlphaTest alpha_test,
+	Rasterizer::OcclusionTest occlusion_test, Rasterizer::OcclusionWrite occlusion_write,
+	Rasterizer::Lighting lighting, Rasterizer::Blending blending>
+Rasterizer::ConvexPolygonDrawFunc Rasterizer::GetTexturedConvexPolygonSpanCorrectedFunc( const InstructionSet instruction_set )
+{
+#ifdef PC_SSE2_INSTRUCTIONS
+	if( instruction_set == InstructionSet::SSE2 )
+		return &Rasterizer::DrawTexturedConvexPolygonSpanCorrected<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, InstructionSet::SSE2>;
+#else
+	PC_UNUSED( instruction_set );
+#endif
+	return &Rasterizer::DrawTexturedConvexPolygonSpanCorrected<depth_test, depth_write, alpha_test, occlusion_test, occlusion_write, lighting, blending, InstructionSet::Scalar>;
+}
+
 } // namespace PanzerChasm
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstring>
 
 #include "../../assert.hpp"
 #include "../../log.hpp"
@@ -16,25 +17,49 @@ inline unsigned int SurfaceDataSizeAligned(
 	return ( (pixels + 3u) & (~3u) ) * sizeof(uint32_t);
 }
 
-SurfacesCache::SurfacesCache( const Size2& viewport_size )
+SurfacesCache::SurfacesCache( const Size2& viewport_size, const unsigned int size_kb )
 {
-	// For lower resolutions we need more surface cache, relative screen area.
-	// For bigger resolutions ( 1024x768 or more ) we need less relative cache size.
-	const unsigned int viewport_pixels= viewport_size.Width() * viewport_size.Height();
-	const float viewport_pixels_f= float(viewport_pixels);
-	const unsigned int cache_size_pixels=
-		static_cast<unsigned int>( viewport_pixels_f * 2.5f / std::sqrt( viewport_pixels_f / ( 1024.0f * 768.0f ) ) );
+	std::memset( &frame_stats_, 0, sizeof(frame_stats_) );
 
-	storage_.resize( cache_size_pixels * sizeof(uint32_t) );
+	if( size_kb > 0u )
+		storage_.resize( size_kb * 1024u );
+	else
+	{
+		// For lower resolutions we need more surface cache, relative screen area.
+		// For bigger resolutions ( 1024x768 or more ) we need less relative cache size.
+		const unsigned int viewport_pixels= viewport_size.Width() * viewport_size.Height();
+		const float viewport_pixels_f= float(viewport_pixels);
+		const unsigned int cache_size_pixels=
+			static_cast<unsigned int>( viewport_pixels_f * 2.5f / std::sqrt( viewport_pixels_f / ( 1024.0f * 768.0f ) ) );
+
+		storage_.resize( cache_size_pixels * sizeof(uint32_t) );
+	}
 
-	const unsigned int size_kb= (storage_.size() + 1023u) / 1024u;
-	Log::Info( "Surfaces cache size: ", size_kb, "kb ( ", size_kb / sizeof(uint32_t), " kilotexels )." );
+	const unsigned int result_size_kb= (storage_.size() + 1023u) / 1024u;
+	Log::Info( "Surfaces cache size: ", result_size_kb, "kb ( ", result_size_kb / sizeof(uint32_t), " kilotexels )." );
 }
 
 SurfacesCache::~SurfacesCache()
 {
 }
 
+void SurfacesCache::BeginFrame()
+{
+	current_frame_++;
+	moved_in_frame_size_= 0u;
+	std::memset( &frame_stats_, 0, sizeof(frame_stats_) );
+}
+
+void SurfacesCache::MarkSurfaceUsed( Surface& surface )
+{
+	surface.last_used_frame= current_frame_;
+}
+
+void SurfacesCache::SetBeforeUsedSurfaceChangeCallback( std::function<void()> callback )
+{
+	before_used_surface_change_callback_= std::move( callback );
+}
+
 void SurfacesCache::AllocateSurface(
 	const unsigned int size_x, const unsigned int size_y,
 	Surface** out_surface_ptr )
@@ -42,47 +67,55 @@ void SurfacesCache::AllocateSurface(
 	PC_ASSERT( size_x > 0u );
 	PC_ASSERT( size_y > 0u );
 
-	unsigned int surface_data_size= sizeof(Surface) + SurfaceDataSizeAligned( size_x, size_y );
+	const unsigned int surface_data_size= GetSurfaceAllocationSize( size_x, size_y );
 
 	PC_ASSERT( surface_data_size < storage_.size() );
 
-	const auto recylce_next_surface=
-	[this]
+	while( true )
 	{
-		Surface* const recycled_surface= reinterpret_cast<Surface*>( storage_.data() + next_recycled_surface_offset_ );
-		if( recycled_surface->owner != nullptr )
-			*recycled_surface->owner= nullptr;
-
-		next_recycled_surface_offset_+=
-			sizeof(Surface) + SurfaceDataSizeAligned( recycled_surface->size[0], recycled_surface->size[1] );
-	};
-
-	if( next_allocated_surface_offset_ + surface_data_size > storage_.size() )
-	{
-		// Recycle surfaces at end.
-		while( next_recycled_surface_offset_ < last_surface_in_buffer_end_offset_ )
-			recylce_next_surface();
-
-		last_surface_in_buffer_end_offset_= next_allocated_surface_offset_;
-		next_allocated_surface_offset_= 0u;
-		next_recycled_surface_offset_= 0u;
+		if( next_allocated_surface_offset_ + surface_data_size > storage_.size() )
+		{
+			// Recycle surfaces at end.
+			while( next_recycled_surface_offset_ < last_surface_in_buffer_end_offset_ )
+				RecycleNextSurface( false );
+
+			last_surface_in_buffer_end_offset_= next_allocated_surface_offset_;
+			next_allocated_surface_offset_= 0u;
+			next_recycled_surface_offset_= 0u;
+		}
+
+		// Recycle old surfaces, while we have no space for new surface.
+		while( next_recycled_surface_offset_ < last_surface_in_buffer_end_offset_ &&
+			next_recycled_surface_offset_ < next_allocated_surface_offset_ + surface_data_size )
+			RecycleNextSurface( true );
+
+		// Moving of surfaces may shift allocation point to buffer end.
+		if( next_allocated_surface_offset_ + surface_data_size <= storage_.size() )
+			break;
 	}
 
-	// Recycle old surfaces, while we have no space for new surface.
-	while( next_recycled_surface_offset_ < last_surface_in_buffer_end_offset_ &&
-		next_recycled_surface_offset_ < next_allocated_surface_offset_ + surface_data_size )
-		recylce_next_surface();
-
 	Surface* const surface= reinterpret_cast<Surface*>( storage_.data() + next_allocated_surface_offset_ );
 	surface->size[0]= size_x;
 	surface->size[1]= size_y;
 	surface->owner= out_surface_ptr;
+	surface->last_used_frame= current_frame_;
 
 	*out_surface_ptr= surface;
 
 	next_allocated_surface_offset_+= surface_data_size;
 }
 
+void SurfacesCache::FreeSurface( Surface** const surface_ptr )
+{
+	PC_ASSERT( surface_ptr != nullptr );
+	if( *surface_ptr == nullptr )
+		return;
+
+	PC_ASSERT( (*surface_ptr)->owner == surface_ptr );
+	(*surface_ptr)->owner= nullptr;
+	*surface_ptr= nullptr;
+}
+
 void SurfacesCache::Clear()
 {
 	next_allocated_surface_offset_= 0u;
@@ -90,4 +123,59 @@ void SurfacesCache::Clear()
 	next_recycled_surface_offset_= ~0u;
 }
 
+unsigned int SurfacesCache::GetStorageSize() const
+{
+	return storage_.size();
+}
+
+const SurfacesCache::FrameStats& SurfacesCache::GetFrameStats() const
+{
+	return frame_stats_;
+}
+
+unsigned int SurfacesCache::GetSurfaceAllocationSize( const unsigned int size_x, const unsigned int size_y )
+{
+	return sizeof(Surface) + SurfaceDataSizeAligned( size_x, size_y );
+}
+
+void SurfacesCache::RecycleNextSurface( const bool allow_move )
+{
+	Surface* const recycled_surface= reinterpret_cast<Surface*>( storage_.data() + next_recycled_surface_offset_ );
+	const unsigned int recycled_surface_size= GetSurfaceAllocationSize( recycled_surface->size[0], recycled_surface->size[1] );
+	next_recycled_surface_offset_+= recycled_surface_size;
+
+	if( recycled_surface->owner == nullptr )
+		return;
+
+	if( recycled_surface->last_used_frame == current_frame_ )
+	{
+		if( before_used_surface_change_callback_ != nullptr )
+			before_used_surface_change_callback_();
+
+		// Do not recycle surface, used in current frame, because it will be rebuilt again soon - move it to allocation point.
+		// Allocation point is always before recycled surface, so, surfaces order does not change.
+		if( allow_move && moved_in_frame_size_ + recycled_surface_size <= storage_.size() )
+		{
+			moved_in_frame_size_+= recycled_surface_size;
+			frame_stats_.moved_surfaces++;
+			frame_stats_.moved_bytes+= recycled_surface_size;
+
+			Surface* const moved_surface= reinterpret_cast<Surface*>( storage_.data() + next_allocated_surface_offset_ );
+			if( moved_surface != recycled_surface )
+			{
+				std::memmove( moved_surface, recycled_surface, recycled_surface_size );
+				*moved_surface->owner= moved_surface;
+			}
+			next_allocated_surface_offset_+= recycled_surface_size;
+			return;
+		}
+
+		frame_stats_.recycled_used_surfaces++;
+	}
+
+	frame_stats_.recycled_surfaces++;
+	frame_stats_.recycled_bytes+= recycled_surface_size;
+	*recycled_surface->owner= nullptr;
+}
+
 } // namespace PanzerChasm
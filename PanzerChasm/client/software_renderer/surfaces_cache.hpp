@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 #include "../../size.hpp"
@@ -19,6 +20,9 @@ public:
 		// If zero - surface was freed.
 		Surface** owner;
 
+		// Number of last frame, where surface was used.
+		unsigned int last_used_frame;
+
 		uint32_t* GetData()
 		{
 			return reinterpret_cast<uint32_t*>(this + 1);
@@ -30,20 +34,56 @@ public:
 		}
 	};
 
+	// Counters of cache work, reset at frame begin.
+	struct FrameStats
+	{
+		unsigned int recycled_surfaces;
+		unsigned int recycled_bytes;
+		// Surfaces, used in current frame and recycled - it will be rebuilt in this frame again.
+		unsigned int recycled_used_surfaces;
+		unsigned int moved_surfaces;
+		unsigned int moved_bytes;
+	};
+
 public:
-	explicit SurfacesCache( const Size2& viewport_size );
+	// size_kb - cache size in kilobytes. If zero - size is calculated from viewport size.
+	SurfacesCache( const Size2& viewport_size, unsigned int size_kb );
 	~SurfacesCache();
 
+	// Surfaces, used in current frame, are not recycled, but moved, while it is possible.
+	void BeginFrame();
+	void MarkSurfaceUsed( Surface& surface );
+
+	// Callback is called before moving or recycling of any surface, used in current frame.
+	void SetBeforeUsedSurfaceChangeCallback( std::function<void()> callback );
+
 	void AllocateSurface( unsigned int size_x, unsigned int size_y, Surface** out_surface_ptr );
+	// Mark surface as freed and reset pointer to it. Space of surface is reused later, in usual recycling order.
+	void FreeSurface( Surface** surface_ptr );
 
 	// Clears surface cache, but not notify surfaces owners.
 	void Clear();
 
+	// Returns size in bytes.
+	unsigned int GetStorageSize() const;
+	const FrameStats& GetFrameStats() const;
+	static unsigned int GetSurfaceAllocationSize( unsigned int size_x, unsigned int size_y );
+
+private:
+	// Recycle or move next surface.
+	void RecycleNextSurface( bool allow_move );
+
 private:
 	std::vector<uint8_t> storage_;
 	unsigned int next_allocated_surface_offset_= 0u;
 	unsigned int last_surface_in_buffer_end_offset_= 0u;
 	unsigned int next_recycled_surface_offset_= ~0u;
+
+	unsigned int current_frame_= 0u;
+	// Limit moved surfaces size per frame, for case, when surfaces of frame does not fit into cache.
+	unsigned int moved_in_frame_size_= 0u;
+	FrameStats frame_stats_;
+	std::function<void()> before_used_surface_change_callback_;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "../../log.hpp"
+
+#include "tiled_rasterizer.hpp"
+
+namespace PanzerChasm
+{
+
+// Make bands more, than threads, for better balancing of uneven bands.
+static constexpr unsigned int g_bands_per_thread= 2u;
+
+TiledRasterizer::TiledRasterizer(
+	Rasterizer& main_rasterizer,
+	const unsigned int viewport_size_y,
+	WorkersPool& workers_pool )
+	: workers_pool_(workers_pool)
+	, band_height_( ( viewport_size_y + workers_pool.GetThreadCount() * g_bands_per_thread - 1u ) / ( workers_pool.GetThreadCount() * g_bands_per_thread ) )
+{
+	const unsigned int band_count= ( viewport_size_y + band_height_ - 1u ) / band_height_;
+	bands_.resize( band_count );
+	for( unsigned int i= 0u; i < band_count; i++ )
+		bands_[i].rasterizer.reset( new Rasterizer( main_rasterizer, i * band_height_, ( i + 1u ) * band_height_ ) );
+
+	Log::Info( "Tiled software rasterizer: ", workers_pool_.GetThreadCount(), " threads, ", band_count, " bands" );
+}
+
+TiledRasterizer::~TiledRasterizer()
+{}
+
+void TiledRasterizer::SetTexture(
+	const unsigned int size_x,
+	const unsigned int size_y,
+	const uint32_t* const data )
+{
+	if( !textures_.empty() )
+	{
+		const Texture& last_texture= textures_.back();
+		if( last_texture.data == data && last_texture.size[0] == size_x && last_texture.size[1] == size_y )
+			return;
+	}
+
+	textures_.emplace_back();
+	Texture& texture= textures_.back();
+	texture.size[0]= size_x;
+	texture.size[1]= size_y;
+	texture.data= data;
+}
+
+void TiledRasterizer::SetLight( const fixed16_t light )
+{
+	current_light_= light;
+}
+
+void TiledRasterizer::DrawTriangle( const Rasterizer::TriangleDrawFunc func, const RasterizerVertex* const vertices )
+{
+	Command command;
+	command.triangle_func= func;
+	command.polygon_func= nullptr;
+	command.is_anticlockwise= false;
+	AddCommand( command, vertices, 3u );
+}
+
+void TiledRasterizer::DrawConvexPolygon(
+	const Rasterizer::ConvexPolygonDrawFunc func,
+	const RasterizerVertex* const vertices,
+	const unsigned int vertex_count,
+	const bool is_anticlockwise )
+{
+	Command command;
+	command.triangle_func= nullptr;
+	command.polygon_func= func;
+	command.is_anticlockwise= is_anticlockwise;
+	AddCommand( command, vertices, vertex_count );
+}
+
+void TiledRasterizer::Flush()
+{
+	if( commands_.empty() )
+		return;
+
+	workers_pool_.ParallelFor(
+		bands_.size(),
+		[this]( const unsigned int band_index )
+		{
+			DrawBand( bands_[ band_index ] );
+		} );
+
+	for( Band& band : bands_ )
+		band.commands.clear();
+	commands_.clear();
+	vertices_.clear();
+
+	// Keep last texture, because it may be used for next commands.
+	if( textures_.size() > 1u )
+	{
+		textures_.front()= textures_.back();
+		textures_.resize( 1u );
+	}
+}
+
+unsigned int TiledRasterizer::GetRecordedCommandCount() const
+{
+	return commands_.size();
+}
+
+void TiledRasterizer::AddCommand( const Command& command, const RasterizerVertex* const vertices, const unsigned int vertex_count )
+{
+	// Bin command into bands, touched by it.
+	fixed16_t y_min= vertices[0].y, y_max= vertices[0].y;
+	for( unsigned int v= 1u; v < vertex_count; v++ )
+	{
+		y_min= std::min( y_min, vertices[v].y );
+		y_max= std::max( y_max, vertices[v].y );
+	}
+
+	// Take conservative rows range - rasterizer itself clips rows precisely.
+	const int y_min_i= std::max( 0, ( y_min >> 16 ) - 1 );
+	const int y_max_i= ( ( y_max + g_fixed16_one - 1 ) >> 16 ) + 1;
+	if( y_max_i <= y_min_i )
+		return;
+
+	const unsigned int first_band= static_cast<unsigned int>(y_min_i) / band_height_;
+	const unsigned int last_band=
+		std::min(
+			static_cast<unsigned int>( y_max_i - 1 ) / band_height_,
+			static_cast<unsigned int>( bands_.size() - 1u ) );
+	if( first_band >= bands_.size() )
+		return;
+
+	const unsigned int command_index= commands_.size();
+	commands_.push_back( command );
+	Command& new_command= commands_.back();
+	new_command.texture_index= textures_.empty() ? c_no_texture : ( textures_.size() - 1u );
+	new_command.light= current_light_;
+	new_command.first_vertex= vertices_.size();
+	new_command.vertex_count= vertex_count;
+
+	vertices_.insert( vertices_.end(), vertices, vertices + vertex_count );
+
+	for( unsigned int b= first_band; b <= last_band; b++ )
+		bands_[b].commands.push_back( command_index );
+}
+
+void TiledRasterizer::DrawBand( Band& band )
+{
+	Rasterizer& rasterizer= *band.rasterizer;
+
+	unsigned int current_texture_index= ~0u;
+	for( const unsigned int command_index : band.commands )
+	{
+		const Command& command= commands_[ command_index ];
+
+		if( command.texture_index != current_texture_index && command.texture_index != c_no_texture )
+		{
+			current_texture_index= command.texture_index;
+			const Texture& texture= textures_[ current_texture_index ];
+			rasterizer.SetTexture( texture.size[0], texture.size[1], texture.data );
+		}
+		rasterizer.SetLight( command.light );
+
+		const RasterizerVertex* const vertices= vertices_.data() + command.first_vertex;
+		if( command.triangle_func != nullptr )
+			(rasterizer.*command.triangle_func)( vertices );
+		else
+			(rasterizer.*command.polygon_func)( vertices, command.vertex_count, command.is_anticlockwise );
+	}
+}
+
+} // namespace PanzerChasm
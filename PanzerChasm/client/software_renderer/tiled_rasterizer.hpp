@@ -0,0 +1,77 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "../../workers_pool.hpp"
+#include "rasterizer.hpp"
+
+namespace PanzerChasm
+{
+
+// Records rasterizer commands, sorts them into horizontal screen bands, then draws bands in parallel.
+// Each band has own rasterizer, which draws into band rows of main rasterizer buffers.
+// Bands are drawn on threads of given workers pool, which must outlive tiled rasterizer.
+// Commands are executed in order of recording inside each band, so result is same as for main rasterizer.
+class TiledRasterizer final
+{
+public:
+	TiledRasterizer( Rasterizer& main_rasterizer, unsigned int viewport_size_y, WorkersPool& workers_pool );
+	~TiledRasterizer();
+
+	void SetTexture(
+		unsigned int size_x,
+		unsigned int size_y,
+		const uint32_t* data );
+
+	void SetLight( fixed16_t light );
+
+	void DrawTriangle( Rasterizer::TriangleDrawFunc func, const RasterizerVertex* vertices );
+	void DrawConvexPolygon( Rasterizer::ConvexPolygonDrawFunc func, const RasterizerVertex* vertices, unsigned int vertex_count, bool is_anticlockwise );
+
+	// Draw all recorded commands, wait for all bands and clear commands.
+	void Flush();
+
+	unsigned int GetRecordedCommandCount() const;
+
+private:
+	struct Texture
+	{
+		unsigned int size[2];
+		const uint32_t* data;
+	};
+
+	static constexpr unsigned int c_no_texture= ~0u;
+
+	struct Command
+	{
+		Rasterizer::TriangleDrawFunc triangle_func;
+		Rasterizer::ConvexPolygonDrawFunc polygon_func;
+		unsigned int texture_index;
+		fixed16_t light;
+		unsigned int first_vertex;
+		unsigned int vertex_count;
+		bool is_anticlockwise;
+	};
+
+	struct Band
+	{
+		std::unique_ptr<Rasterizer> rasterizer;
+		std::vector<unsigned int> commands;
+	};
+
+private:
+	void AddCommand( const Command& command, const RasterizerVertex* vertices, unsigned int vertex_count );
+	void DrawBand( Band& band );
+
+private:
+	WorkersPool& workers_pool_;
+	const unsigned int band_height_;
+
+	std::vector<Band> bands_;
+	std::vector<Command> commands_;
+	std::vector<RasterizerVertex> vertices_;
+	std::vector<Texture> textures_;
+	fixed16_t current_light_= g_fixed16_one;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,292 @@
+// collision_benchmark_main.cpp - entry point of headless collision benchmark.
+// Loads maps, builds collision index and map logic, and runs fixed random sets of collision queries:
+// ray casts, radius queries, visibility checks, shots and movement collisions.
+// Reports queries per second and latency percentiles of each query type for each map.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "game_resources.hpp"
+#include "log.hpp"
+#include "map_loader.hpp"
+#include "program_arguments.hpp"
+#include "rand.hpp"
+#include "server/collision_index.inl"
+#include "server/map.hpp"
+#include "server/movement_restriction.hpp"
+#include "vfs.hpp"
+#include "workers_pool.hpp"
+
+using namespace PanzerChasm;
+
+namespace
+{
+
+const float g_max_ray_distance= 64.0f;
+const float g_max_see_distance= 24.0f;
+const float g_min_query_z= 0.2f;
+const float g_max_query_z= 1.5f;
+
+// Random query points, located near map objects, so, most of them are inside playable space.
+struct QueryPoint
+{
+	m_Vec3 pos;
+	m_Vec3 dir; // Normalized.
+	m_Vec3 target; // Point for visibility checks, not far from pos.
+	float radius;
+};
+
+struct QueryStats
+{
+	const char* name;
+	double queries_per_second;
+	float latency_ns_50, latency_ns_95, latency_ns_99;
+	unsigned int positive_results;
+};
+
+std::vector<QueryPoint> GenerateQueryPoints( const MapData& map_data, const unsigned int count, const unsigned int seed )
+{
+	std::vector<m_Vec2> base_points;
+	for( const MapData::Monster& monster : map_data.monsters )
+		base_points.push_back( monster.pos );
+	for( const MapData::Item& item : map_data.items )
+		base_points.push_back( item.pos );
+	for( const MapData::StaticModel& model : map_data.static_models )
+		base_points.push_back( model.pos );
+	if( base_points.empty() )
+		base_points.emplace_back( float(MapData::c_map_size) * 0.5f, float(MapData::c_map_size) * 0.5f );
+
+	LongRand rand( seed );
+	std::vector<QueryPoint> points( count );
+	for( QueryPoint& point : points )
+	{
+		const m_Vec2& base_point= base_points[ rand.Rand() % base_points.size() ];
+		point.pos=
+			m_Vec3(
+				base_point.x + rand.RandValue( -1.0f, 1.0f ),
+				base_point.y + rand.RandValue( -1.0f, 1.0f ),
+				rand.RandValue( g_min_query_z, g_max_query_z ) );
+
+		// Mostly horizontal directions, like shots of players and monsters.
+		const float angle= rand.RandAngle();
+		point.dir= m_Vec3( std::cos(angle), std::sin(angle), rand.RandValue( -0.2f, 0.2f ) );
+		point.dir.Normalize();
+
+		const m_Vec2& target_base_point= base_points[ rand.Rand() % base_points.size() ];
+		point.target= m_Vec3( target_base_point, rand.RandValue( g_min_query_z, g_max_query_z ) );
+		const m_Vec3 to_target= point.target - point.pos;
+		if( to_target.SquareLength() > g_max_see_distance * g_max_see_distance )
+			point.target= point.pos + to_target * ( g_max_see_distance / to_target.Length() );
+
+		point.radius= rand.RandValue( 0.5f, 4.0f );
+	}
+
+	return points;
+}
+
+// Query returns true for positive result (hit, visible, etc.).
+typedef std::function<bool(const QueryPoint&)> QueryFunc;
+
+QueryStats RunQueries( const char* const name, const std::vector<QueryPoint>& points, const QueryFunc& query )
+{
+	QueryStats stats;
+	stats.name= name;
+	stats.positive_results= 0u;
+
+	// Throughput pass - without per-query time measurement.
+	const auto start_time= std::chrono::steady_clock::now();
+	for( const QueryPoint& point : points )
+		stats.positive_results+= query( point ) ? 1u : 0u;
+	const double time_s= std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+	stats.queries_per_second= double( points.size() ) / std::max( time_s, 1.0e-9 );
+
+	// Latency pass. Time of clock call is included into results.
+	std::vector<float> latencies_ns;
+	latencies_ns.reserve( points.size() );
+	for( const QueryPoint& point : points )
+	{
+		const auto query_start_time= std::chrono::steady_clock::now();
+		query( point );
+		const auto query_end_time= std::chrono::steady_clock::now();
+		latencies_ns.push_back( float( std::chrono::duration<double, std::nano>( query_end_time - query_start_time ).count() ) );
+	}
+
+	std::sort( latencies_ns.begin(), latencies_ns.end() );
+	const auto percentile=
+	[&]( const unsigned int p ) -> float
+	{
+		return latencies_ns[ ( latencies_ns.size() - 1u ) * p / 100u ];
+	};
+	stats.latency_ns_50= percentile(50u);
+	stats.latency_ns_95= percentile(95u);
+	stats.latency_ns_99= percentile(99u);
+
+	return stats;
+}
+
+void PrintStats( const QueryStats& stats, const unsigned int query_count )
+{
+	Log::Info(
+		"  ", stats.name, ": ", static_cast<unsigned int>( stats.queries_per_second ), " q/s, latency ns - 50%: ", stats.latency_ns_50,
+		" 95%: ", stats.latency_ns_95, " 99%: ", stats.latency_ns_99,
+		", positive: ", stats.positive_results * 100u / std::max( query_count, 1u ), "%" );
+}
+
+} // namespace
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	const ProgramArguments program_arguments( argc, argv );
+
+	unsigned int query_count= 100000u;
+	if( const char* const queries_str= program_arguments.GetParamValue( "queries" ) )
+		query_count= static_cast<unsigned int>( std::max( 1, std::atoi( queries_str ) ) );
+
+	Log::Info( "Read game archive" );
+	const char* csm_file= "CSM.BIN";
+	if( const char* const overrided_csm_file = program_arguments.GetParamValue( "csm" ) )
+		csm_file= overrided_csm_file;
+	const VfsPtr vfs= std::make_shared<Vfs>( csm_file, program_arguments.GetParamValue( "addon" ) );
+
+	Log::Info( "Loading game resources" );
+	const GameResourcesConstPtr game_resources= LoadGameResources( vfs, LoadProfile::ServerOnly );
+	MapLoader map_loader( vfs, 0u, LoadProfile::ServerOnly );
+
+	std::vector<MapLoader::MapInfo> maps_info;
+	if( const char* const map_number_str= program_arguments.GetParamValue( "map" ) )
+	{
+		MapLoader::MapInfo map_info;
+		map_info.number= static_cast<unsigned int>( std::atoi( map_number_str ) );
+		maps_info.push_back( map_info );
+	}
+	else
+		maps_info= map_loader.GetAllMapsInfo();
+
+	// Map logic may use workers for ticks, but queries here are single-threaded.
+	WorkersPool workers_pool( 1u );
+
+	Log::Info( "Running ", query_count, " queries of each type for ", maps_info.size(), " maps" );
+
+	unsigned int failed_maps= 0u;
+	for( const MapLoader::MapInfo& map_info : maps_info )
+	{
+		const MapDataConstPtr map_data= map_loader.LoadMap( map_info.number );
+		if( map_data == nullptr )
+		{
+			Log::Warning( "Can not load map ", map_info.number );
+			failed_maps++;
+			continue;
+		}
+
+		const auto index_build_start_time= std::chrono::steady_clock::now();
+		const CollisionIndex collision_index( map_data );
+		const double index_build_time_ms=
+			std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - index_build_start_time ).count();
+
+		const Map map(
+			Difficulty::Normal,
+			GameRules::Cooperative,
+			map_data,
+			game_resources,
+			Time::CurrentTime(),
+			workers_pool,
+			[]{},
+			[]( const char* ){} );
+
+		Log::Info( "Map ", map_info.number, " \"", map_info.name, "\", collision index built in ", index_build_time_ms, " ms" );
+
+		const std::vector<QueryPoint> points= GenerateQueryPoints( *map_data, query_count, map_info.number );
+
+		PrintStats(
+			RunQueries(
+				"CollisionIndex::RayCastStaticWalls", points,
+				[&]( const QueryPoint& point )
+				{
+					float distance;
+					unsigned int wall_index;
+					return collision_index.RayCastStaticWalls( point.pos, point.dir, g_max_ray_distance, distance, wall_index );
+				} ),
+			query_count );
+
+		PrintStats(
+			RunQueries(
+				"CollisionIndex::RayCast", points,
+				[&]( const QueryPoint& point )
+				{
+					unsigned int elements= 0u;
+					collision_index.RayCast(
+						point.pos, point.dir,
+						[&]( const MapData::IndexElement& element ) -> bool
+						{
+							PC_UNUSED( element );
+							elements++;
+							return false;
+						},
+						g_max_ray_distance );
+					return elements > 0u;
+				} ),
+			query_count );
+
+		PrintStats(
+			RunQueries(
+				"CollisionIndex::ProcessElementsInRadius", points,
+				[&]( const QueryPoint& point )
+				{
+					unsigned int elements= 0u;
+					collision_index.ProcessElementsInRadius(
+						point.pos.xy(), point.radius,
+						[&]( const MapData::IndexElement& element )
+						{
+							PC_UNUSED( element );
+							elements++;
+						} );
+					return elements > 0u;
+				} ),
+			query_count );
+
+		PrintStats(
+			RunQueries(
+				"Map::CanSee", points,
+				[&]( const QueryPoint& point )
+				{
+					return map.CanSee( point.pos, point.target );
+				} ),
+			query_count );
+
+		PrintStats(
+			RunQueries(
+				"Map::TraceShot", points,
+				[&]( const QueryPoint& point )
+				{
+					m_Vec3 hit_pos;
+					return map.TraceShot( point.pos, point.dir, g_max_ray_distance, hit_pos );
+				} ),
+			query_count );
+
+		PrintStats(
+			RunQueries(
+				"Map::CollideWithMap", points,
+				[&]( const QueryPoint& point )
+				{
+					bool on_floor;
+					MovementRestriction movement_restriction;
+					const m_Vec3 new_pos=
+						map.CollideWithMap(
+							point.pos, 1.0f, point.radius * 0.25f,
+							Time::FromSeconds( 1.0 / 60.0 ),
+							on_floor, movement_restriction );
+					return ( new_pos - point.pos ).SquareLength() > 0.0f;
+				} ),
+			query_count );
+	}
+
+	return failed_maps == 0u ? 0 : -1;
+}
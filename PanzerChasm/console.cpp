@@ -13,12 +13,17 @@ namespace PanzerChasm
 {
 
 static const float g_user_message_show_time_s= 5.0f;
-static const size_t g_max_user_messages= 4u;
+
+static void CopyLine( char* const dst, const char* const src, const size_t dst_size )
+{
+	std::strncpy( dst, src, dst_size - 1u );
+	dst[ dst_size - 1u ]= '\0';
+}
 
 Console::Console( CommandsProcessor& commands_processor, const SharedDrawersPtr& shared_drawers )
 	: commands_processor_(commands_processor)
 	, shared_drawers_(shared_drawers)
-	, last_draw_time_(Time::CurrentTime())
+	, last_draw_time_(Time::FrameTime())
 {
 	PC_ASSERT( shared_drawers_ != nullptr );
 
@@ -124,7 +129,7 @@ void Console::ProcessEvents( const SystemEvents& events )
 		else if( key_code == KeyCode::PageUp )
 		{
 			lines_position_+= 3u;
-			lines_position_= std::min( lines_position_, static_cast<unsigned int>(lines_.size()) );
+			lines_position_= std::min( lines_position_, lines_count_ );
 		}
 		else if( key_code == KeyCode::PageDown )
 		{
@@ -137,7 +142,7 @@ void Console::ProcessEvents( const SystemEvents& events )
 
 void Console::Draw()
 {
-	const Time current_time= Time::CurrentTime();
+	const Time current_time= Time::FrameTime();
 	const float time_delta_s= ( current_time - last_draw_time_ ).ToSeconds();
 	last_draw_time_= current_time;
 
@@ -184,16 +189,14 @@ void Console::Draw()
 		y-= letter_height * scale;
 	}
 
-	auto it= lines_.rbegin();
-	it= std::next( it, std::min( lines_position_, static_cast<unsigned int>(lines_.size()) ) );
-	for( ; it != lines_.rend(); ++it )
+	for( unsigned int i= lines_position_; i < lines_count_; i++ )
 	{
 		if( y < -letter_height * scale )
 			break;
 
 		shared_drawers_->text->Print(
 			scale * c_x_offset, y,
-			it->c_str(), scale,
+			GetLine(i), scale,
 			ITextDrawer::FontColor::White, ITextDrawer::Alignment::Left );
 		y-= letter_height * scale;
 	}
@@ -201,12 +204,12 @@ void Console::Draw()
 
 void Console::RemoveOldUserMessages( const Time current_time )
 {
-	while( user_messages_.size() > g_max_user_messages )
-		user_messages_.pop_front();
-
-	while( ! user_messages_.empty() &&
-		( current_time - user_messages_.front().time ).ToSeconds() > g_user_message_show_time_s )
-		user_messages_.pop_front();
+	while( user_messages_count_ > 0u &&
+		( current_time - user_messages_[ first_user_message_ ].time ).ToSeconds() > g_user_message_show_time_s )
+	{
+		first_user_message_= ( first_user_message_ + 1u ) % c_max_user_messages;
+		user_messages_count_--;
+	}
 }
 
 void Console::DrawUserMessages()
@@ -216,11 +219,11 @@ void Console::DrawUserMessages()
 
 	int y= 0;
 	const int c_offset= 5;
-	for( const UserMessage& message : user_messages_ )
+	for( unsigned int i= 0u; i < user_messages_count_; i++ )
 	{
 		shared_drawers_->text->Print(
 			scale * c_offset, y,
-			message.text.c_str(), scale,
+			user_messages_[ ( first_user_message_ + i ) % c_max_user_messages ].text, scale,
 			ITextDrawer::FontColor::YellowGreen, ITextDrawer::Alignment::Left );
 
 		y+= letter_height * scale;
@@ -229,21 +232,35 @@ void Console::DrawUserMessages()
 
 void Console::LogCallback( std::string str, const Log::LogLevel log_level )
 {
-	lines_.emplace_back( std::move(str) );
-
-	if( lines_.size() == c_max_lines )
-		lines_.pop_front();
+	CopyLine( lines_[ next_line_ ], str.c_str(), sizeof(lines_[ next_line_ ]) );
+	next_line_= ( next_line_ + 1u ) % c_max_lines;
+	lines_count_= std::min( lines_count_ + 1u, c_max_lines );
 
 	lines_position_= 0u;
 
 	if( log_level == Log::LogLevel::User )
 	{
-		user_messages_.emplace_back();
-		user_messages_.back().text= lines_.back();
-		user_messages_.back().time= Time::CurrentTime();
+		// Overwrite oldest message, if ring is full.
+		if( user_messages_count_ == c_max_user_messages )
+		{
+			first_user_message_= ( first_user_message_ + 1u ) % c_max_user_messages;
+			user_messages_count_--;
+		}
+
+		UserMessage& message= user_messages_[ ( first_user_message_ + user_messages_count_ ) % c_max_user_messages ];
+		user_messages_count_++;
+
+		CopyLine( message.text, str.c_str(), sizeof(message.text) );
+		message.time= Time::FrameTime();
 	}
 }
 
+const char* Console::GetLine( const unsigned int index_from_newest ) const
+{
+	PC_ASSERT( index_from_newest < lines_count_ );
+	return lines_[ ( next_line_ + c_max_lines - 1u - index_from_newest ) % c_max_lines ];
+}
+
 void Console::WriteHistory()
 {
 	history_[ next_history_line_index_ ]= input_line_;
@@ -1,5 +1,4 @@
 #pragma once
-#include <list>
 #include <string>
 
 #include "commands_processor.hpp"
@@ -23,9 +22,11 @@ public:
 	void Draw();
 
 private:
+	static constexpr unsigned int c_max_line_length= 191u; // Longer lines are truncated.
+
 	struct UserMessage
 	{
-		std::string text;
+		char text[ c_max_line_length + 1u ];
 		Time time= Time::FromSeconds(0);
 	};
 
@@ -35,6 +36,9 @@ private:
 
 	void LogCallback( std::string str, Log::LogLevel log_level );
 
+	// 0 - newest line.
+	const char* GetLine( unsigned int index_from_newest ) const;
+
 	void WriteHistory();
 	void CopyLineFromHistory();
 
@@ -42,6 +46,7 @@ private:
 	static constexpr unsigned int c_max_input_line_length= 64u;
 	static constexpr unsigned int c_max_lines= 128u;
 	static constexpr unsigned int c_max_history= 64u;
+	static constexpr unsigned int c_max_user_messages= 4u;
 
 	CommandsProcessor& commands_processor_;
 	const SharedDrawersPtr shared_drawers_;
@@ -50,7 +55,11 @@ private:
 	float current_speed_= -1.0f;
 	Time last_draw_time_;
 
-	std::list<std::string> lines_;
+	// Ring buffer of lines with fixed-size slots. Adding of line does not allocate memory,
+	// drawing accesses only visible lines.
+	char lines_[ c_max_lines ][ c_max_line_length + 1u ];
+	unsigned int lines_count_= 0u;
+	unsigned int next_line_= 0u;
 	unsigned int lines_position_= 0u;
 
 	// TODO - Maybe use raw array or std::array, instead std::string.
@@ -62,7 +71,10 @@ private:
 	char input_line_[ c_max_input_line_length + 1u ];
 	unsigned int input_cursor_pos_= 0u;
 
-	std::list<UserMessage> user_messages_;
+	// Ring buffer of user messages, from older to newer.
+	UserMessage user_messages_[ c_max_user_messages ];
+	unsigned int first_user_message_= 0u;
+	unsigned int user_messages_count_= 0u;
 };
 
 } // namespace PanzerChasm
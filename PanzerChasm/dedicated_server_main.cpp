@@ -0,0 +1,291 @@
+// dedicated_server_main.cpp - entry point of headless dedicated server.
+// This executable contains only server, network and resources loading code, without any window, sound or drawing code.
+// One process may host several independent rooms. Each room has own server, map and ports and runs in own thread.
+// Game resources and map data are immutable and shared between rooms.
+// In relay mode process does not run any game. It connects to other server and resends its world state to spectators.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "commands_processor.hpp"
+#include "game_constants.hpp"
+#include "game_resources.hpp"
+#include "log.hpp"
+#include "map_loader.hpp"
+#include "net/net.hpp"
+#include "net/threaded_connections_listener.hpp"
+#include "profiler.hpp"
+#include "program_arguments.hpp"
+#include "server/relay.hpp"
+#include "server/server.hpp"
+#include "settings.hpp"
+#include "shared_settings_keys.hpp"
+#include "vfs.hpp"
+
+using namespace PanzerChasm;
+
+// Server blocks on network between loops, until next map tick.
+// If listener can not wait (threaded listener), server sleeps. Server loop is cheap, when there is no ticks for simulation.
+static const std::chrono::milliseconds g_loop_sleep_time( 1 );
+
+static const unsigned int g_max_rooms= 64u;
+
+static std::atomic<bool> g_quit_requested( false );
+
+static void QuitSignalHandler( int )
+{
+	g_quit_requested.store( true );
+}
+
+struct Room
+{
+	std::unique_ptr<CommandsProcessor> commands_processor;
+	std::unique_ptr<Server> server;
+	std::thread thread;
+};
+
+static void RoomThreadFunc( Server* const server )
+{
+	while( !g_quit_requested.load() )
+	{
+		server->Loop( false );
+		if( !server->WaitForEvents() )
+			std::this_thread::sleep_for( g_loop_sleep_time );
+	}
+
+	server->DisconnectAllClients();
+}
+
+static DifficultyType DifficultyNumberToDifficulty( const unsigned int n )
+{
+	switch( n )
+	{
+	case 0: return Difficulty::Easy;
+	case 1: return Difficulty::Normal;
+	case 2: return Difficulty::Hard;
+	default: return Difficulty::Normal;
+	};
+}
+
+static uint16_t GetPortParam( const ProgramArguments& program_arguments, const char* const param_name, const uint16_t default_port )
+{
+	const char* const value= program_arguments.GetParamValue( param_name );
+	if( value == nullptr )
+		return default_port;
+
+	const int port= std::atoi( value );
+	if( port <= 0 || port > 65535 )
+	{
+		Log::Warning( "Invalid port \"", value, "\", using default port ", default_port );
+		return default_port;
+	}
+
+	return static_cast<uint16_t>( port );
+}
+
+static int RunRelay( const ProgramArguments& program_arguments, Settings& settings, const char* const server_address_str )
+{
+	InetAddress server_address;
+	if( !InetAddress::Parse( server_address_str, server_address ) )
+	{
+		Log::Warning( "Invalid relay server address \"", server_address_str, "\"" );
+		return -1;
+	}
+	if( server_address.port == 0 )
+		server_address.port= Net::c_default_server_tcp_port;
+
+	const uint16_t tcp_port= GetPortParam( program_arguments, "port", Net::c_default_server_tcp_port );
+	const uint16_t udp_port= GetPortParam( program_arguments, "udp-port", Net::c_default_server_udp_base_port );
+
+	Log::Info( "Initialize net subsystem" );
+	Net net;
+
+	Log::Info( "Connecting to ", server_address.ToString() );
+	const IConnectionPtr server_connection=
+		net.ConnectToServer( server_address, Net::c_default_client_tcp_port, Net::c_default_client_udp_port );
+	if( server_connection == nullptr )
+	{
+		Log::Warning( "Can not connect to server" );
+		return -1;
+	}
+
+	// Relay has many spectators, so, always use one udp socket for all of them.
+	IConnectionsListenerPtr listener= net.CreateServerListener( tcp_port, udp_port, true );
+	if( listener == nullptr )
+	{
+		Log::Warning( "Can not start relay: network error." );
+		return -1;
+	}
+	if( settings.GetOrSetBool( SettingsKeys::server_net_thread, false ) )
+		listener= std::make_shared<ThreadedConnectionsListener>( listener );
+
+	Relay relay(
+		server_connection,
+		settings.GetOrSetString( SettingsKeys::server_relay_password, "" ),
+		listener );
+
+	std::signal( SIGINT, QuitSignalHandler );
+	std::signal( SIGTERM, QuitSignalHandler );
+
+	Log::Info( "Relay started at tcp port ", tcp_port );
+	while( !g_quit_requested.load() && relay.Loop() )
+		std::this_thread::sleep_for( g_loop_sleep_time );
+
+	Log::Info( "Stopping relay" );
+	relay.DisconnectAllSpectators();
+
+	return 0;
+}
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	const ProgramArguments program_arguments( argc, argv );
+
+	// Profile whole server run, write trace at exit.
+	const char* const profile_file_name= program_arguments.GetParamValue( "profile" );
+	if( profile_file_name != nullptr )
+		Profiler::Start();
+
+	Profiler::SetLoadProfilingEnabled( program_arguments.HasParam( "load-profile" ) );
+
+	Settings settings( "PanzerChasmServer.cfg" );
+
+	if( const char* const relay_server_address= program_arguments.GetParamValue( "relay" ) )
+	{
+		const int result= RunRelay( program_arguments, settings, relay_server_address );
+		if( profile_file_name != nullptr )
+		{
+			Profiler::Stop();
+			Profiler::DumpChromeTrace( profile_file_name );
+		}
+		return result;
+	}
+
+	unsigned int room_count= 1u;
+	if( const char* const rooms_str= program_arguments.GetParamValue( "rooms" ) )
+		room_count= static_cast<unsigned int>( std::max( 1, std::min( std::atoi( rooms_str ), int(g_max_rooms) ) ) );
+
+	// Dedicated server has no client in same process, so, use fixed ticks and limited send rate by default.
+	if( !settings.IsValue( SettingsKeys::server_tick_rate ) )
+		settings.SetSetting( SettingsKeys::server_tick_rate, 60 );
+	if( !settings.IsValue( SettingsKeys::server_send_rate ) )
+		settings.SetSetting( SettingsKeys::server_send_rate, 30 );
+	// Rooms already run in parallel, so, do not create extra threads for each room.
+	if( room_count > 1u && !settings.IsValue( SettingsKeys::server_workers_threads ) )
+		settings.SetSetting( SettingsKeys::server_workers_threads, 1 );
+
+	// Settings are shared between rooms. Fix values here, so, rooms threads only read settings.
+	settings.GetOrSetInt( SettingsKeys::server_tick_rate, 0 );
+	settings.GetOrSetInt( SettingsKeys::server_send_rate, 0 );
+	settings.GetOrSetInt( SettingsKeys::server_workers_threads, 0 );
+	settings.GetOrSetString( SettingsKeys::server_relay_password, "" );
+	settings.GetOrSetInt( SettingsKeys::server_metrics_interval, 10 );
+	settings.GetOrSetString( SettingsKeys::server_metrics_file, "" );
+	const bool shared_udp_socket= settings.GetOrSetBool( SettingsKeys::server_shared_udp_socket, false );
+	const bool net_thread= settings.GetOrSetBool( SettingsKeys::server_net_thread, false );
+
+	Log::Info( "Read game archive" );
+	const char* csm_file= "CSM.BIN";
+	if( const char* const overrided_csm_file = program_arguments.GetParamValue( "csm" ) )
+		csm_file= overrided_csm_file;
+	const VfsPtr vfs= std::make_shared<Vfs>( csm_file, program_arguments.GetParamValue( "addon" ) );
+
+	// Dedicated server never draws anything, so, do not load render-only data.
+	Log::Info( "Loading game resources" );
+	const GameResourcesConstPtr game_resources= LoadGameResources( vfs, LoadProfile::ServerOnly );
+	const MapLoaderPtr map_loader=
+		std::make_shared<MapLoader>(
+			vfs,
+			size_t( std::max( settings.GetOrSetInt( SettingsKeys::map_cache_size, 64 ), 0 ) ) << 20u,
+			LoadProfile::ServerOnly );
+
+	const char* const map_number_str= program_arguments.GetParamValue( "map" );
+	const char* const difficulty_str= program_arguments.GetParamValue( "difficulty" );
+	const unsigned int map_number= map_number_str == nullptr ? 1u : static_cast<unsigned int>( std::atoi( map_number_str ) );
+	const DifficultyType difficulty=
+		difficulty_str == nullptr ? Difficulty::Normal : DifficultyNumberToDifficulty( std::atoi( difficulty_str ) );
+	const GameRules game_rules= program_arguments.HasParam( "coop" ) ? GameRules::Cooperative : GameRules::Deathmatch;
+
+	const uint16_t base_tcp_port= GetPortParam( program_arguments, "port", Net::c_default_server_tcp_port );
+	const uint16_t base_udp_port= GetPortParam( program_arguments, "udp-port", Net::c_default_server_udp_base_port );
+
+	Log::Info( "Initialize net subsystem" );
+	Net net;
+
+	// Each room listens own tcp port. Each client of room gets own udp port, so, rooms have ranges of udp ports.
+	// With shared udp socket each room needs only one udp port.
+	const unsigned int room_udp_ports= shared_udp_socket ? 1u : GameConstants::max_players;
+	std::vector< std::unique_ptr<Room> > rooms;
+	for( unsigned int r= 0u; r < room_count; r++ )
+	{
+		const unsigned int tcp_port= base_tcp_port + r;
+		const unsigned int udp_port= base_udp_port + r * room_udp_ports;
+		if( tcp_port > 65535u || udp_port + room_udp_ports > 65535u )
+		{
+			Log::Warning( "Can not start room ", r, ": ports are out of range." );
+			break;
+		}
+
+		IConnectionsListenerPtr listener=
+			net.CreateServerListener( static_cast<uint16_t>( tcp_port ), static_cast<uint16_t>( udp_port ), shared_udp_socket );
+		if( listener == nullptr )
+		{
+			Log::Warning( "Can not start room ", r, ": network error." );
+			break;
+		}
+		if( net_thread )
+			listener= std::make_shared<ThreadedConnectionsListener>( listener );
+
+		std::unique_ptr<Room> room( new Room );
+		room->commands_processor.reset( new CommandsProcessor( settings ) );
+		room->server.reset(
+			new Server(
+				settings,
+				*room->commands_processor,
+				game_resources,
+				map_loader,
+				listener,
+				nullptr ) );
+		// Rooms write metrics into same file, so, tag lines with room number.
+		room->server->SetRoomNumber( r );
+
+		if( !room->server->ChangeMap( map_number, difficulty, game_rules ) )
+			break;
+
+		Log::Info( "Room ", r, " started at tcp port ", tcp_port );
+		rooms.push_back( std::move( room ) );
+	}
+
+	if( rooms.empty() )
+		return -1;
+
+	std::signal( SIGINT, QuitSignalHandler );
+	std::signal( SIGTERM, QuitSignalHandler );
+
+	for( const std::unique_ptr<Room>& room : rooms )
+		room->thread= std::thread( RoomThreadFunc, room->server.get() );
+
+	while( !g_quit_requested.load() )
+		std::this_thread::sleep_for( g_loop_sleep_time * 100 );
+
+	Log::Info( "Stopping server" );
+	for( const std::unique_ptr<Room>& room : rooms )
+		room->thread.join();
+
+	if( profile_file_name != nullptr )
+	{
+		Profiler::Stop();
+		Profiler::DumpChromeTrace( profile_file_name );
+	}
+
+	return 0;
+}
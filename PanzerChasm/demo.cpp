@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstring>
+
+#include "../Common/files.hpp"
+using namespace ChasmReverse;
+
+#include "log.hpp"
+#include "messages.hpp"
+
+#include "demo.hpp"
+
+namespace PanzerChasm
+{
+
+const char DemoHeader::c_expected_id[8]= "PanDemo";
+
+std::shared_ptr<DemoRecordingConnection> DemoRecordingConnection::Create( const IConnectionPtr& connection, const char* const file_name )
+{
+	PC_ASSERT( connection != nullptr );
+
+	std::FILE* const file= std::fopen( file_name, "wb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not create demo file \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	DemoHeader header;
+	std::memcpy( header.id, DemoHeader::c_expected_id, sizeof(header.id) );
+	header.version= DemoHeader::c_expected_version;
+	header.protocol_version= Messages::c_protocol_version;
+	FileWrite( file, &header, sizeof(header) );
+
+	return std::make_shared<DemoRecordingConnection>( connection, file );
+}
+
+DemoRecordingConnection::DemoRecordingConnection( const IConnectionPtr& connection, std::FILE* const file )
+	: connection_(connection), file_(file)
+{}
+
+DemoRecordingConnection::~DemoRecordingConnection()
+{
+	StopRecording();
+}
+
+void DemoRecordingConnection::EndFrame()
+{
+	if( file_ == nullptr )
+		return;
+
+	DemoFrameHeader header;
+	header.reliable_data_size= reliable_data_.size();
+	header.unreliable_chunk_count= unreliable_chunk_count_;
+
+	FileWrite( file_, &header, sizeof(header) );
+	FileWrite( file_, reliable_data_.data(), reliable_data_.size() );
+	FileWrite( file_, unreliable_chunks_.data(), unreliable_chunks_.size() );
+
+	reliable_data_.clear();
+	unreliable_chunks_.clear();
+	unreliable_chunk_count_= 0u;
+}
+
+void DemoRecordingConnection::StopRecording()
+{
+	if( file_ == nullptr )
+		return;
+
+	EndFrame();
+	std::fclose( file_ );
+	file_= nullptr;
+}
+
+void DemoRecordingConnection::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	connection_->SendReliablePacket( data, data_size );
+}
+
+void DemoRecordingConnection::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	connection_->SendUnreliablePacket( data, data_size );
+}
+
+unsigned int DemoRecordingConnection::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int result= connection_->ReadRealiableData( out_data, buffer_size );
+	if( file_ != nullptr )
+		reliable_data_.insert(
+			reliable_data_.end(),
+			static_cast<const unsigned char*>(out_data),
+			static_cast<const unsigned char*>(out_data) + result );
+	return result;
+}
+
+unsigned int DemoRecordingConnection::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int result= connection_->ReadUnrealiableData( out_data, buffer_size );
+	if( file_ != nullptr && result > 0u )
+	{
+		const unsigned char* const size_bytes= reinterpret_cast<const unsigned char*>( &result );
+		unreliable_chunks_.insert( unreliable_chunks_.end(), size_bytes, size_bytes + sizeof(unsigned int) );
+		unreliable_chunks_.insert(
+			unreliable_chunks_.end(),
+			static_cast<const unsigned char*>(out_data),
+			static_cast<const unsigned char*>(out_data) + result );
+		unreliable_chunk_count_++;
+	}
+	return result;
+}
+
+void DemoRecordingConnection::Disconnect()
+{
+	connection_->Disconnect();
+}
+
+bool DemoRecordingConnection::Disconnected()
+{
+	return connection_->Disconnected();
+}
+
+std::string DemoRecordingConnection::GetConnectionInfo()
+{
+	return connection_->GetConnectionInfo();
+}
+
+std::shared_ptr<DemoPlaybackConnection> DemoPlaybackConnection::Create( const char* const file_name )
+{
+	std::FILE* const file= std::fopen( file_name, "rb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not open demo file \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	std::fseek( file, 0, SEEK_END );
+	const unsigned int file_size= std::ftell( file );
+	std::fseek( file, 0, SEEK_SET );
+
+	std::vector<unsigned char> demo_data( file_size );
+	FileRead( file, demo_data.data(), demo_data.size() );
+	std::fclose( file );
+
+	DemoHeader header;
+	if( demo_data.size() < sizeof(DemoHeader) )
+	{
+		Log::Warning( "Demo file \"", file_name, "\" is broken" );
+		return nullptr;
+	}
+	std::memcpy( &header, demo_data.data(), sizeof(DemoHeader) );
+
+	if( std::memcmp( header.id, DemoHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != DemoHeader::c_expected_version )
+	{
+		Log::Warning( "Demo file \"", file_name, "\" is broken or has unsupported version" );
+		return nullptr;
+	}
+	if( header.protocol_version != Messages::c_protocol_version )
+	{
+		Log::Warning( "Demo file \"", file_name, "\" is recorded with different protocol version" );
+		return nullptr;
+	}
+
+	return std::make_shared<DemoPlaybackConnection>( std::move(demo_data) );
+}
+
+DemoPlaybackConnection::DemoPlaybackConnection( std::vector<unsigned char> demo_data )
+	: demo_data_( std::move(demo_data) )
+{}
+
+DemoPlaybackConnection::~DemoPlaybackConnection()
+{}
+
+bool DemoPlaybackConnection::NextFrame()
+{
+	if( finished_ )
+		return false;
+
+	// Skip unreaded unreliable data of previous frame, like lost packets.
+	unreliable_chunks_pos_= unreliable_chunks_end_= next_frame_pos_;
+	unreliable_chunk_data_pos_= 0u;
+
+	DemoFrameHeader header;
+	if( demo_data_.size() - next_frame_pos_ < sizeof(DemoFrameHeader) )
+	{
+		finished_= true;
+		return false;
+	}
+	std::memcpy( &header, demo_data_.data() + next_frame_pos_, sizeof(DemoFrameHeader) );
+	unsigned int pos= next_frame_pos_ + sizeof(DemoFrameHeader);
+
+	if( demo_data_.size() - pos < header.reliable_data_size )
+	{
+		finished_= true;
+		return false;
+	}
+
+	// Keep unreaded reliable data of previous frame - reliable data is stream.
+	reliable_data_.erase( reliable_data_.begin(), reliable_data_.begin() + reliable_data_pos_ );
+	reliable_data_pos_= 0u;
+	reliable_data_.insert(
+		reliable_data_.end(),
+		demo_data_.data() + pos,
+		demo_data_.data() + pos + header.reliable_data_size );
+	pos+= header.reliable_data_size;
+
+	const unsigned int unreliable_chunks_begin= pos;
+	for( unsigned int i= 0u; i < header.unreliable_chunk_count; i++ )
+	{
+		unsigned int chunk_size;
+		if( demo_data_.size() - pos < sizeof(unsigned int) )
+		{
+			finished_= true;
+			return false;
+		}
+		std::memcpy( &chunk_size, demo_data_.data() + pos, sizeof(unsigned int) );
+		pos+= sizeof(unsigned int);
+
+		if( demo_data_.size() - pos < chunk_size )
+		{
+			finished_= true;
+			return false;
+		}
+		pos+= chunk_size;
+	}
+
+	unreliable_chunks_pos_= unreliable_chunks_begin;
+	unreliable_chunks_end_= pos;
+	next_frame_pos_= pos;
+	return true;
+}
+
+bool DemoPlaybackConnection::Finished() const
+{
+	return finished_;
+}
+
+void DemoPlaybackConnection::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	PC_UNUSED( data );
+	PC_UNUSED( data_size );
+}
+
+void DemoPlaybackConnection::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	PC_UNUSED( data );
+	PC_UNUSED( data_size );
+}
+
+unsigned int DemoPlaybackConnection::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	if( disconnected_ ) return 0u;
+
+	const unsigned int result_size= std::min( buffer_size, static_cast<unsigned int>( reliable_data_.size() - reliable_data_pos_ ) );
+	std::memcpy( out_data, reliable_data_.data() + reliable_data_pos_, result_size );
+	reliable_data_pos_+= result_size;
+	return result_size;
+}
+
+unsigned int DemoPlaybackConnection::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	if( disconnected_ || unreliable_chunks_pos_ >= unreliable_chunks_end_ ) return 0u;
+
+	unsigned int chunk_size;
+	std::memcpy( &chunk_size, demo_data_.data() + unreliable_chunks_pos_, sizeof(unsigned int) );
+
+	const unsigned int result_size= std::min( buffer_size, chunk_size - unreliable_chunk_data_pos_ );
+	std::memcpy(
+		out_data,
+		demo_data_.data() + unreliable_chunks_pos_ + sizeof(unsigned int) + unreliable_chunk_data_pos_,
+		result_size );
+
+	unreliable_chunk_data_pos_+= result_size;
+	if( unreliable_chunk_data_pos_ == chunk_size )
+	{
+		unreliable_chunks_pos_+= sizeof(unsigned int) + chunk_size;
+		unreliable_chunk_data_pos_= 0u;
+	}
+
+	return result_size;
+}
+
+void DemoPlaybackConnection::Disconnect()
+{
+	disconnected_= true;
+}
+
+bool DemoPlaybackConnection::Disconnected()
+{
+	return disconnected_;
+}
+
+std::string DemoPlaybackConnection::GetConnectionInfo()
+{
+	return "demo";
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+#include "assert.hpp"
+#include "fwd.hpp"
+#include "i_connection.hpp"
+
+namespace PanzerChasm
+{
+
+// Demo - recorded stream of data, received by client from server.
+// Demo consists of frames. Each frame contains all data, which client read from connection in one loop.
+// Data is stored as is, so, demo is valid only for same protocol version.
+
+struct DemoHeader
+{
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 1u; // Change each time, when format changed.
+
+	char id[8];
+	unsigned int version;
+	unsigned int protocol_version;
+};
+
+SIZE_ASSERT( DemoHeader, 16u );
+
+// Frame header is followed by reliable data, and by unreliable chunks - each chunk is size (unsigned int) and data.
+struct DemoFrameHeader
+{
+	unsigned int reliable_data_size;
+	unsigned int unreliable_chunk_count;
+};
+
+SIZE_ASSERT( DemoFrameHeader, 8u );
+
+// Connection wrapper, which writes all received data into demo file.
+class DemoRecordingConnection final : public IConnection
+{
+public:
+	// Returns null, if can not create file.
+	static std::shared_ptr<DemoRecordingConnection> Create( const IConnectionPtr& connection, const char* file_name );
+
+	DemoRecordingConnection( const IConnectionPtr& connection, std::FILE* file );
+	virtual ~DemoRecordingConnection() override;
+
+	// Call it after each client loop.
+	void EndFrame();
+	// Closes file. Connection continues working after it.
+	void StopRecording();
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+
+private:
+	const IConnectionPtr connection_;
+	std::FILE* file_;
+
+	// Data of current frame.
+	std::vector<unsigned char> reliable_data_;
+	std::vector<unsigned char> unreliable_chunks_;
+	unsigned int unreliable_chunk_count_= 0u;
+};
+
+typedef std::shared_ptr<DemoRecordingConnection> DemoRecordingConnectionPtr;
+
+// Connection, which gives to client data from demo file. All sent data is discarded.
+class DemoPlaybackConnection final : public IConnection
+{
+public:
+	// Returns null, if file does not exist or is broken.
+	static std::shared_ptr<DemoPlaybackConnection> Create( const char* file_name );
+
+	explicit DemoPlaybackConnection( std::vector<unsigned char> demo_data );
+	virtual ~DemoPlaybackConnection() override;
+
+	// Makes data of next frame available for reading. Returns false, if there are no more frames.
+	bool NextFrame();
+	bool Finished() const;
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+
+private:
+	const std::vector<unsigned char> demo_data_;
+	unsigned int next_frame_pos_= sizeof(DemoHeader);
+	bool finished_= false;
+	bool disconnected_= false;
+
+	// Not readed data of current frame.
+	std::vector<unsigned char> reliable_data_;
+	unsigned int reliable_data_pos_= 0u;
+
+	unsigned int unreliable_chunks_pos_= 0u;
+	unsigned int unreliable_chunks_end_= 0u;
+	unsigned int unreliable_chunk_data_pos_= 0u; // Position inside current chunk, if chunk was not readed whole.
+};
+
+typedef std::shared_ptr<DemoPlaybackConnection> DemoPlaybackConnectionPtr;
+
+} // namespace PanzerChasm
@@ -16,6 +16,7 @@ DrawersFactoryGL::DrawersFactoryGL(
 	: settings_(settings)
 	, game_resources_(game_resources)
 	, rendering_context_(rendering_context)
+	, quads_batcher_( std::make_shared<QuadsBatcherGL>( rendering_context.viewport_size ) )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 }
@@ -30,7 +31,7 @@ ITextDrawerPtr DrawersFactoryGL::CreateTextDrawer()
 
 IMenuDrawerPtr DrawersFactoryGL::CreateMenuDrawer()
 {
-	return IMenuDrawerPtr( new MenuDrawerGL( settings_, rendering_context_, *game_resources_ ) );
+	return IMenuDrawerPtr( new MenuDrawerGL( settings_, rendering_context_, *game_resources_, quads_batcher_ ) );
 }
 
 IHudDrawerPtr DrawersFactoryGL::CreateHUDDrawer( const SharedDrawersPtr& shared_drawers )
@@ -43,7 +44,8 @@ IHudDrawerPtr DrawersFactoryGL::CreateHUDDrawer( const SharedDrawersPtr& shared_
 				settings_,
 				game_resources_,
 				rendering_context_,
-				shared_drawers ) );
+				shared_drawers,
+				quads_batcher_ ) );
 }
 
 IMapDrawerPtr DrawersFactoryGL::CreateMapDrawer()
@@ -1,5 +1,6 @@
 #pragma once
 #include "i_drawers_factory.hpp"
+#include "quads_batcher_gl.hpp"
 #include "rendering_context.hpp"
 
 namespace PanzerChasm
@@ -25,6 +26,7 @@ private:
 	Settings& settings_;
 	const GameResourcesConstPtr game_resources_;
 	const RenderingContextGL rendering_context_;
+	const QuadsBatcherGLPtr quads_batcher_; // Shared between 2d drawers.
 };
 
 } // namespace PanzerChasm
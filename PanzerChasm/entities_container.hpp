@@ -0,0 +1,174 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+#include "assert.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Container of entities, indexed by EntityId. Replacement for std::unordered_map.
+// Values are stored densely in array, so, iteration over container is fast.
+// Lookup by id is O(1) - via sparse array of indeces in dense array.
+// Generations are not needed - ids are unique numbers, assigned by server.
+//
+// Erasing moves last element into place of erased element, so, iteration order is not stable.
+// Inserting and erasing invalidate iterators and references to elements.
+// erase( iterator ) returns iterator to element, moved into erased place, so, erasing in loop visits all elements.
+template<class T>
+class EntitiesContainer final
+{
+public:
+	typedef std::pair<EntityId, T> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+	iterator begin();
+	iterator end();
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	unsigned int size() const;
+	bool empty() const;
+	void clear();
+
+	iterator find( EntityId id );
+	const_iterator find( EntityId id ) const;
+
+	// Returns iterator to element with given id and true, if element was inserted.
+	std::pair<iterator, bool> emplace( EntityId id, T value );
+	T& operator[]( EntityId id );
+
+	// Returns number of erased elements.
+	unsigned int erase( EntityId id );
+	iterator erase( iterator it );
+
+private:
+	static constexpr unsigned short c_invalid_index= 0xFFFFu;
+
+private:
+	std::vector<value_type> dense_;
+	std::vector<unsigned short> sparse_; // Index of element in dense array for each id.
+};
+
+template<class T>
+typename EntitiesContainer<T>::iterator EntitiesContainer<T>::begin()
+{
+	return dense_.begin();
+}
+
+template<class T>
+typename EntitiesContainer<T>::iterator EntitiesContainer<T>::end()
+{
+	return dense_.end();
+}
+
+template<class T>
+typename EntitiesContainer<T>::const_iterator EntitiesContainer<T>::begin() const
+{
+	return dense_.begin();
+}
+
+template<class T>
+typename EntitiesContainer<T>::const_iterator EntitiesContainer<T>::end() const
+{
+	return dense_.end();
+}
+
+template<class T>
+unsigned int EntitiesContainer<T>::size() const
+{
+	return dense_.size();
+}
+
+template<class T>
+bool EntitiesContainer<T>::empty() const
+{
+	return dense_.empty();
+}
+
+template<class T>
+void EntitiesContainer<T>::clear()
+{
+	dense_.clear();
+	sparse_.clear();
+}
+
+template<class T>
+typename EntitiesContainer<T>::iterator EntitiesContainer<T>::find( const EntityId id )
+{
+	if( id >= sparse_.size() || sparse_[id] == c_invalid_index )
+		return dense_.end();
+	return dense_.begin() + sparse_[id];
+}
+
+template<class T>
+typename EntitiesContainer<T>::const_iterator EntitiesContainer<T>::find( const EntityId id ) const
+{
+	if( id >= sparse_.size() || sparse_[id] == c_invalid_index )
+		return dense_.end();
+	return dense_.begin() + sparse_[id];
+}
+
+template<class T>
+std::pair<typename EntitiesContainer<T>::iterator, bool> EntitiesContainer<T>::emplace( const EntityId id, T value )
+{
+	const iterator it= find( id );
+	if( it != dense_.end() )
+		return std::make_pair( it, false );
+
+	PC_ASSERT( dense_.size() < c_invalid_index );
+
+	if( id >= sparse_.size() )
+	{
+		const unsigned int old_size= sparse_.size();
+		sparse_.resize( id + 1u );
+		for( unsigned int i= old_size; i < sparse_.size(); i++ )
+			sparse_[i]= c_invalid_index;
+	}
+
+	sparse_[id]= static_cast<unsigned short>( dense_.size() );
+	dense_.emplace_back( id, std::move(value) );
+	return std::make_pair( dense_.end() - 1, true );
+}
+
+template<class T>
+T& EntitiesContainer<T>::operator[]( const EntityId id )
+{
+	const iterator it= find( id );
+	if( it != dense_.end() )
+		return it->second;
+	return emplace( id, T() ).first->second;
+}
+
+template<class T>
+unsigned int EntitiesContainer<T>::erase( const EntityId id )
+{
+	const iterator it= find( id );
+	if( it == dense_.end() )
+		return 0u;
+
+	erase( it );
+	return 1u;
+}
+
+template<class T>
+typename EntitiesContainer<T>::iterator EntitiesContainer<T>::erase( const iterator it )
+{
+	PC_ASSERT( it != dense_.end() );
+
+	const unsigned int index= static_cast<unsigned int>( it - dense_.begin() );
+	sparse_[ it->first ]= c_invalid_index;
+
+	if( index + 1u != dense_.size() )
+	{
+		*it= std::move( dense_.back() );
+		sparse_[ it->first ]= static_cast<unsigned short>( index );
+	}
+	dense_.pop_back();
+
+	return dense_.begin() + index;
+}
+
+} // namespace PanzerChasm
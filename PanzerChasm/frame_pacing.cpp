@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+#include "assert.hpp"
+#include "profiler.hpp"
+
+#include "frame_pacing.hpp"
+
+namespace PanzerChasm
+{
+
+namespace FramePacing
+{
+
+namespace
+{
+
+// Intervals are kept for this number of last frames (or moves).
+const unsigned int g_samples_count= 256u;
+const unsigned int g_max_moves_in_flight= 64u;
+
+enum class Interval
+{
+	Frame, // Swap to swap.
+	InputToSwap, // Approximation of input to photon latency - display latency is unknown.
+	DrawToSwap,
+	InputToMove,
+	MoveToPosition, // Round trip of move through server.
+	PositionToSwap, // Time until received position is shown.
+	NumIntervals,
+};
+
+const char* const g_intervals_names[ size_t(Interval::NumIntervals) ]=
+{
+	"frame",
+	"input to swap",
+	"draw to swap",
+	"input to move",
+	"move to position",
+	"position to swap",
+};
+
+const char* const g_events_names[ size_t(Event::NumEvents) ]=
+{
+	"input poll",
+	"draw start",
+	"swap",
+};
+
+// Upper bounds of frame time histogram buckets. Last bucket is unbounded.
+const float g_histogram_buckets_ms[]= { 4.0f, 8.0f, 12.0f, 17.0f, 21.0f, 25.0f, 34.0f, 50.0f };
+const unsigned int g_histogram_buckets_count= sizeof(g_histogram_buckets_ms) / sizeof(g_histogram_buckets_ms[0]) + 1u;
+
+struct Samples
+{
+	float ms[ g_samples_count ]; // Ring buffer.
+	unsigned int written= 0u;
+};
+
+Samples g_samples[ size_t(Interval::NumIntervals) ];
+
+// Times of events in current frame. Zero, if event did not happen yet.
+uint64_t g_frame_events_time_ns[ size_t(Event::NumEvents) ]= { 0u, 0u, 0u };
+uint64_t g_frame_first_position_time_ns= 0u;
+uint64_t g_prev_swap_time_ns= 0u;
+
+uint64_t g_moves_send_times_ns[ g_max_moves_in_flight ]= { 0u };
+unsigned short g_last_sent_sequence= 0u;
+unsigned short g_last_acknowledged_sequence= 0u;
+
+void AddSample( const Interval interval, const uint64_t start_time_ns, const uint64_t end_time_ns )
+{
+	Samples& samples= g_samples[ size_t(interval) ];
+	samples.ms[ samples.written % g_samples_count ]= float( double( end_time_ns - start_time_ns ) / 1000000.0 );
+	samples.written++;
+}
+
+void AddTraceEvent( const char* const name, const uint64_t time_ns )
+{
+	if( Profiler::IsEnabled() )
+		Profiler::AddZone( name, time_ns, time_ns, Profiler::g_thread_allocations );
+}
+
+} // namespace
+
+void MarkEvent( const Event event )
+{
+	PC_ASSERT( event < Event::NumEvents );
+
+	const uint64_t time_ns= Profiler::GetTimeNs();
+	AddTraceEvent( g_events_names[ size_t(event) ], time_ns );
+
+	if( event != Event::Swap )
+	{
+		g_frame_events_time_ns[ size_t(event) ]= time_ns;
+		return;
+	}
+
+	if( g_prev_swap_time_ns != 0u )
+		AddSample( Interval::Frame, g_prev_swap_time_ns, time_ns );
+	g_prev_swap_time_ns= time_ns;
+
+	if( const uint64_t input_time_ns= g_frame_events_time_ns[ size_t(Event::InputPoll) ] )
+		AddSample( Interval::InputToSwap, input_time_ns, time_ns );
+	if( const uint64_t draw_time_ns= g_frame_events_time_ns[ size_t(Event::DrawStart) ] )
+		AddSample( Interval::DrawToSwap, draw_time_ns, time_ns );
+	if( g_frame_first_position_time_ns != 0u )
+		AddSample( Interval::PositionToSwap, g_frame_first_position_time_ns, time_ns );
+
+	for( uint64_t& event_time_ns : g_frame_events_time_ns )
+		event_time_ns= 0u;
+	g_frame_first_position_time_ns= 0u;
+}
+
+void OnPlayerMoveSent( const unsigned short sequence )
+{
+	const uint64_t time_ns= Profiler::GetTimeNs();
+	AddTraceEvent( "player move", time_ns );
+
+	g_moves_send_times_ns[ sequence % g_max_moves_in_flight ]= time_ns;
+	g_last_sent_sequence= sequence;
+
+	if( const uint64_t input_time_ns= g_frame_events_time_ns[ size_t(Event::InputPoll) ] )
+		AddSample( Interval::InputToMove, input_time_ns, time_ns );
+}
+
+void OnPlayerPositionReceived( const unsigned short last_move_sequence )
+{
+	// Measure only first acknowledgement of each move, like NetStatistics does.
+	const short since_last_acknowledged= static_cast<short>( static_cast<unsigned short>( last_move_sequence - g_last_acknowledged_sequence ) );
+	const unsigned short in_flight= static_cast<unsigned short>( g_last_sent_sequence - last_move_sequence );
+	if( since_last_acknowledged <= 0 || in_flight >= g_max_moves_in_flight )
+		return;
+
+	g_last_acknowledged_sequence= last_move_sequence;
+
+	const uint64_t time_ns= Profiler::GetTimeNs();
+	AddTraceEvent( "player position", time_ns );
+
+	AddSample( Interval::MoveToPosition, g_moves_send_times_ns[ last_move_sequence % g_max_moves_in_flight ], time_ns );
+	if( g_frame_first_position_time_ns == 0u )
+		g_frame_first_position_time_ns= time_ns;
+}
+
+void GetStatsLines( std::vector<std::string>& out_lines )
+{
+	char str[128];
+
+	std::snprintf( str, sizeof(str), "%-18s %7s %7s %7s %7s", "pacing, ms", "50%", "95%", "99%", "max" );
+	out_lines.emplace_back( str );
+
+	std::vector<float> sorted_samples;
+	for( unsigned int i= 0u; i < size_t(Interval::NumIntervals); i++ )
+	{
+		const Samples& samples= g_samples[i];
+		const unsigned int count= std::min( samples.written, g_samples_count );
+		if( count == 0u )
+			continue;
+
+		sorted_samples.assign( samples.ms, samples.ms + count );
+		std::sort( sorted_samples.begin(), sorted_samples.end() );
+		const auto percentile=
+		[&]( const unsigned int p ) -> float
+		{
+			return sorted_samples[ ( count - 1u ) * p / 100u ];
+		};
+
+		std::snprintf(
+			str, sizeof(str), "%-18s %7.2f %7.2f %7.2f %7.2f",
+			g_intervals_names[i], percentile(50u), percentile(95u), percentile(99u), sorted_samples.back() );
+		out_lines.emplace_back( str );
+	}
+
+	// Frame time histogram.
+	const Samples& frame_samples= g_samples[ size_t(Interval::Frame) ];
+	const unsigned int frame_count= std::min( frame_samples.written, g_samples_count );
+	if( frame_count == 0u )
+		return;
+
+	unsigned int histogram[ g_histogram_buckets_count ]= { 0u };
+	for( unsigned int i= 0u; i < frame_count; i++ )
+	{
+		unsigned int bucket= 0u;
+		while( bucket + 1u < g_histogram_buckets_count && frame_samples.ms[i] >= g_histogram_buckets_ms[bucket] )
+			bucket++;
+		histogram[bucket]++;
+	}
+
+	for( unsigned int bucket= 0u; bucket < g_histogram_buckets_count; bucket++ )
+	{
+		if( histogram[bucket] == 0u )
+			continue;
+
+		const unsigned int percents= histogram[bucket] * 100u / frame_count;
+		if( bucket + 1u < g_histogram_buckets_count )
+			std::snprintf(
+				str, sizeof(str), "frame %2.0f-%2.0f ms: %3u%%, %3u frames",
+				bucket == 0u ? 0.0f : g_histogram_buckets_ms[ bucket - 1u ], g_histogram_buckets_ms[bucket],
+				percents, histogram[bucket] );
+		else
+			std::snprintf(
+				str, sizeof(str), "frame %2.0f+ ms:    %3u%%, %3u frames",
+				g_histogram_buckets_ms[ bucket - 1u ],
+				percents, histogram[bucket] );
+		out_lines.emplace_back( str );
+	}
+}
+
+} // namespace FramePacing
+
+} // namespace PanzerChasm
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace PanzerChasm
+{
+
+// Frame pacing and input latency statistics of client.
+// Timestamps of pipeline events are collected for each frame, intervals between them are kept for last frames.
+// Events are also written into profiler trace (as zero-length zones), when profiler is enabled.
+// All functions must be called only from main thread.
+namespace FramePacing
+{
+
+enum class Event
+{
+	InputPoll,
+	DrawStart,
+	Swap, // Finishes frame.
+	NumEvents,
+};
+
+void MarkEvent( Event event );
+
+// Move send and position receive are matched via move sequence numbers.
+void OnPlayerMoveSent( unsigned short sequence );
+void OnPlayerPositionReceived( unsigned short last_move_sequence );
+
+// Lines with percentiles of frame time and latencies and frame time histogram.
+void GetStatsLines( std::vector<std::string>& out_lines );
+
+} // namespace FramePacing
+
+} // namespace PanzerChasm
@@ -5,6 +5,8 @@
 
 #include "assert.hpp"
 #include "log.hpp"
+#include "profiler.hpp"
+#include "workers_pool.hpp"
 
 #include "game_resources.hpp"
 
@@ -459,205 +461,229 @@ static void LoadSoundsDescription(
 	LoadSoundsDescriptionFromFileData( start, end, 0u, game_resources.sounds );
 }
 
-static void LoadItemsModels(
+// Each model or sprite is loaded by separate task. Tasks are independent and may run in parallel.
+// Containers for results must be resized before tasks start.
+static void LoadItemModel(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.items_models.resize( game_resources.items_description.size() );
-
-	Vfs::FileContent file_content;
-	Vfs::FileContent animation_file_content;
-
-	for( unsigned int i= 0u; i < game_resources.items_models.size(); i++ )
-	{
-		const GameResources::ItemDescription& item_description= game_resources.items_description[i];
+	const GameResources::ItemDescription& item_description= game_resources.items_description[i];
 
-		char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
-		char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/";
+	char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
+	char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/";
 
-		std::strcat( model_file_path, item_description.model_file_name );
-		std::strcat( animation_file_path, item_description.animation_file_name );
+	std::strcat( model_file_path, item_description.model_file_name );
+	std::strcat( animation_file_path, item_description.animation_file_name );
 
-		vfs.ReadFile( model_file_path, file_content );
+	const Vfs::MappedFile file_content= vfs.MapFile( model_file_path );
 
-		if( item_description.animation_file_name[0u] != '\0' )
-			vfs.ReadFile( animation_file_path, animation_file_content );
-		else
-			animation_file_content.clear();
+	Vfs::MappedFile animation_file_content;
+	if( item_description.animation_file_name[0u] != '\0' )
+		animation_file_content= vfs.MapFile( animation_file_path );
 
-		LoadModel_o3( file_content, animation_file_content, game_resources.items_models[i] );
-	}
+	LoadModel_o3( file_content, animation_file_content, game_resources.items_models[i] );
 }
 
-static void LoadMonstersModels(
+static void LoadMonsterModel(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.monsters_models.resize( game_resources.monsters_description.size() );
+	const GameResources::MonsterDescription& monster_description= game_resources.monsters_description[i];
 
-	Vfs::FileContent file_content;
+	char model_file_path[ GameResources::c_max_file_path_size ]= "CARACTER/";
+	std::strcat( model_file_path, monster_description.model_file_name );
 
-	for( unsigned int i= 0u; i < game_resources.monsters_models.size(); i++ )
-	{
-		const GameResources::MonsterDescription& monster_description= game_resources.monsters_description[i];
-
-		char model_file_path[ GameResources::c_max_file_path_size ]= "CARACTER/";
-		std::strcat( model_file_path, monster_description.model_file_name );
-
-		vfs.ReadFile( model_file_path, file_content );
-		LoadModel_car( file_content, game_resources.monsters_models[i] );
-	}
+	LoadModel_car( vfs.MapFile( model_file_path ), game_resources.monsters_models[i] );
 }
 
-static void LoadEffectsSprites(
+static void LoadEffectSprite(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.effects_sprites.resize( game_resources.sprites_effects_description.size() );
-
-	Vfs::FileContent file_content;
-
-	for( unsigned int i= 0u; i < game_resources.effects_sprites.size(); i++ )
-	{
-		vfs.ReadFile( game_resources.sprites_effects_description[i].sprite_file_name, file_content );
-		LoadObjSprite( file_content, game_resources.effects_sprites[i] );
-	}
+	LoadObjSprite(
+		vfs.MapFile( game_resources.sprites_effects_description[i].sprite_file_name ),
+		game_resources.effects_sprites[i] );
 }
 
-static void LoadBMPObjectsSprites(
+static void LoadBMPObjectSprite(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.bmp_objects_sprites.resize( game_resources.bmp_objects_description.size() );
-
-	Vfs::FileContent file_content;
-
-	for( unsigned int i= 0u; i < game_resources.bmp_objects_sprites.size(); i++ )
-	{
-		vfs.ReadFile( game_resources.bmp_objects_description[i].sprite_file_name, file_content );
-		LoadObjSprite( file_content, game_resources.bmp_objects_sprites[i] );
-	}
+	LoadObjSprite(
+		vfs.MapFile( game_resources.bmp_objects_description[i].sprite_file_name ),
+		game_resources.bmp_objects_sprites[i] );
 }
 
-
-static void LoadWeaponsModels(
+static void LoadWeaponModel(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.weapons_models.resize( game_resources.weapons_description.size() );
+	const GameResources::WeaponDescription& weapon_description= game_resources.weapons_description[i];
 
-	Vfs::FileContent file_content;
-	Vfs::FileContent animation_file_content[2u];
+	char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
+	char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/WEAPON/";
+	char reloading_animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/WEAPON/";
 
-	for( unsigned int i= 0u; i < game_resources.weapons_models.size(); i++ )
-	{
-		const GameResources::WeaponDescription& weapon_description= game_resources.weapons_description[i];
-
-		char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
-		char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/WEAPON/";
-		char reloading_animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/WEAPON/";
-
-		std::strcat( model_file_path, weapon_description.model_file_name );
-		std::strcat( animation_file_path, weapon_description.animation_file_name );
-		std::strcat( reloading_animation_file_path, weapon_description.reloading_animation_file_name );
+	std::strcat( model_file_path, weapon_description.model_file_name );
+	std::strcat( animation_file_path, weapon_description.animation_file_name );
+	std::strcat( reloading_animation_file_path, weapon_description.reloading_animation_file_name );
 
-		vfs.ReadFile( model_file_path, file_content );
-		vfs.ReadFile( animation_file_path, animation_file_content[0] );
-		vfs.ReadFile( reloading_animation_file_path, animation_file_content[1] );
+	const Vfs::MappedFile file_content= vfs.MapFile( model_file_path );
+	const Vfs::MappedFile animation_file_content= vfs.MapFile( animation_file_path );
+	const Vfs::MappedFile reloading_animation_file_content= vfs.MapFile( reloading_animation_file_path );
+	const Vfs::FileView animations[2u]= { animation_file_content, reloading_animation_file_content };
 
-		LoadModel_o3( file_content, animation_file_content, 2u, game_resources.weapons_models[i] );
-	}
+	LoadModel_o3( file_content, animations, 2u, game_resources.weapons_models[i] );
 }
 
-static void LoadRocketsModels(
+static void LoadRocketModel(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const unsigned int i )
 {
-	game_resources.rockets_models.resize( game_resources.rockets_description.size() );
+	const GameResources::RocketDescription& rocket_description= game_resources.rockets_description[i];
 
-	Vfs::FileContent file_content;
-	Vfs::FileContent animation_file_content;
+	if( rocket_description.model_file_name[0] == '\0' )
+		return;
 
-	for( unsigned int i= 0u; i < game_resources.rockets_models.size(); i++ )
-	{
-		const GameResources::RocketDescription& rocket_description= game_resources.rockets_description[i];
+	char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
+	char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/";
 
-		if( rocket_description.model_file_name[0] == '\0' )
-			continue;
+	std::strcat( model_file_path, rocket_description.model_file_name );
+	std::strcat( animation_file_path, rocket_description.animation_file_name );
 
-		char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
-		char animation_file_path[ GameResources::c_max_file_path_size ]= "ANI/";
+	LoadModel_o3(
+		vfs.MapFile( model_file_path ),
+		vfs.MapFile( animation_file_path ),
+		game_resources.rockets_models[i] );
+}
 
-		std::strcat( model_file_path, rocket_description.model_file_name );
-		std::strcat( animation_file_path, rocket_description.animation_file_name );
+static void LoadGibModel(
+	const Vfs& vfs,
+	GameResources& game_resources,
+	const unsigned int i )
+{
+	const GameResources::GibDescription& gib_description= game_resources.gibs_description[i];
 
-		vfs.ReadFile( model_file_path, file_content );
-		vfs.ReadFile( animation_file_path, animation_file_content );
+	if( gib_description.model_file_name[0] == '\0' )
+		return;
 
-		LoadModel_o3( file_content, animation_file_content, game_resources.rockets_models[i] );
-	}
+	char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
+	std::strcat( model_file_path, gib_description.model_file_name );
+
+	LoadModel_o3( vfs.MapFile( model_file_path ), Vfs::FileView(), game_resources.gibs_models[i] );
+}
+
+struct LoadingTask
+{
+	void (*func)( const Vfs& vfs, GameResources& game_resources, unsigned int i );
+	unsigned int index;
+};
+
+static void AddLoadingTasks(
+	std::vector<LoadingTask>& tasks,
+	void (* const func)( const Vfs& vfs, GameResources& game_resources, unsigned int i ),
+	const unsigned int count )
+{
+	for( unsigned int i= 0u; i < count; i++ )
+		tasks.push_back( LoadingTask{ func, i } );
 }
 
-static void LoadGibsModels(
+static void LoadModelsAndSprites(
 	const Vfs& vfs,
-	GameResources& game_resources )
+	GameResources& game_resources,
+	const LoadProfile load_profile )
 {
+	game_resources.items_models.resize( game_resources.items_description.size() );
+	game_resources.monsters_models.resize( game_resources.monsters_description.size() );
+	game_resources.effects_sprites.resize( game_resources.sprites_effects_description.size() );
+	game_resources.bmp_objects_sprites.resize( game_resources.bmp_objects_description.size() );
+	game_resources.weapons_models.resize( game_resources.weapons_description.size() );
+	game_resources.rockets_models.resize( game_resources.rockets_description.size() );
 	game_resources.gibs_models.resize( game_resources.gibs_description.size() );
 
-	Vfs::FileContent model_file_content;
-
-	for( unsigned int i= 0u; i < game_resources.gibs_models.size(); i++ )
+	std::vector<LoadingTask> tasks;
+	AddLoadingTasks( tasks, LoadItemModel, game_resources.items_models.size() );
+	AddLoadingTasks( tasks, LoadMonsterModel, game_resources.monsters_models.size() );
+	if( load_profile == LoadProfile::Full )
 	{
-		const GameResources::GibDescription& gib_description= game_resources.gibs_description[i];
-
-		if( gib_description.model_file_name[0] == '\0' )
-			continue;
-
-		char model_file_path[ GameResources::c_max_file_path_size ]= "MODELS/";
-		std::strcat( model_file_path, gib_description.model_file_name );
+		// Sprites are needed only for drawing.
+		AddLoadingTasks( tasks, LoadEffectSprite, game_resources.effects_sprites.size() );
+		AddLoadingTasks( tasks, LoadBMPObjectSprite, game_resources.bmp_objects_sprites.size() );
+	}
+	AddLoadingTasks( tasks, LoadWeaponModel, game_resources.weapons_models.size() );
+	AddLoadingTasks( tasks, LoadRocketModel, game_resources.rockets_models.size() );
+	AddLoadingTasks( tasks, LoadGibModel, game_resources.gibs_models.size() );
+
+	// Pool lives only during loading - threads are not needed after it.
+	WorkersPool workers_pool;
+	workers_pool.ParallelFor(
+		tasks.size(),
+		[&]( const unsigned int t )
+		{
+			tasks[t].func( vfs, game_resources, tasks[t].index );
+		} );
 
-		vfs.ReadFile( model_file_path, model_file_content );
-		LoadModel_o3( model_file_content, Vfs::FileContent(), game_resources.gibs_models[i] );
+	if( load_profile == LoadProfile::ServerOnly )
+	{
+		for( std::vector<Model>* const models :
+			{
+				&game_resources.items_models, &game_resources.monsters_models, &game_resources.weapons_models,
+				&game_resources.rockets_models, &game_resources.gibs_models,
+			} )
+		for( Model& model : *models )
+			FreeModelRenderData( model );
 	}
 }
 
-GameResourcesConstPtr LoadGameResources( const VfsPtr& vfs )
+GameResourcesConstPtr LoadGameResources( const VfsPtr& vfs, const LoadProfile load_profile )
 {
+	PC_PROFILE_LOAD_STEP( "LoadGameResources" );
+
 	PC_ASSERT( vfs != nullptr );
 
 	const GameResourcesPtr result= std::make_shared<GameResources>();
 
 	result->vfs= vfs;
 
-	LoadPalette( *vfs, result->palette );
+	{
+		PC_PROFILE_LOAD_STEP( "palette" );
+		LoadPalette( *vfs, result->palette );
+	}
+
+	{
+		PC_PROFILE_LOAD_STEP( "descriptions" );
 
-	const Vfs::FileContent inf_file= vfs->ReadFile( "CHASM.INF" );
+		const Vfs::FileContent inf_file= vfs->ReadFile( "CHASM.INF" );
 
-	if( inf_file.empty() )
-		Log::FatalError( "Can not read CHASM.INF" );
+		if( inf_file.empty() )
+			Log::FatalError( "Can not read CHASM.INF" );
 
-	LoadItemsDescription( inf_file, *result );
-	LoadMonstersDescription( inf_file, *result );
-	LoadSpriteEffectsDescription( inf_file, *result );
-	LoadBMPObjectsDescription( inf_file, *result );
-	LoadWeaponsDescription( inf_file, *result );
-	LoadRocketsDescription( inf_file, *result );
-	LoadGibsDescription( inf_file, *result );
-	LoadSoundsDescription( inf_file, *result );
+		LoadItemsDescription( inf_file, *result );
+		LoadMonstersDescription( inf_file, *result );
+		LoadSpriteEffectsDescription( inf_file, *result );
+		LoadBMPObjectsDescription( inf_file, *result );
+		LoadWeaponsDescription( inf_file, *result );
+		LoadRocketsDescription( inf_file, *result );
+		LoadGibsDescription( inf_file, *result );
+		LoadSoundsDescription( inf_file, *result );
+	}
 
-	LoadItemsModels( *vfs, *result );
-	LoadMonstersModels( *vfs, *result );
-	LoadEffectsSprites( *vfs, *result );
-	LoadBMPObjectsSprites( *vfs, *result );
-	LoadWeaponsModels( *vfs, *result );
-	LoadRocketsModels( *vfs, *result );
-	LoadGibsModels( *vfs, *result );
+	{
+		PC_PROFILE_LOAD_STEP( "models and sprites" );
+		LoadModelsAndSprites( *vfs, *result, load_profile );
+	}
 
 	return result;
 }
 
 void LoadSoundsDescriptionFromMapResourcesFile(
-	const Vfs::FileContent& resoure_file,
+	const Vfs::FileView& resoure_file,
 	GameResources::SoundDescription* const out_sounds,
 	const unsigned int max_sound_count )
 {
@@ -675,13 +701,14 @@ void LoadSoundsDescriptionFromMapResourcesFile(
 	if( start == file_end )
 		return;
 
-	const char* const end= std::strstr( start, "#end" );
+	const char* const end_str= "#end";
+	const char* const end= std::search( start, file_end, end_str, end_str + std::strlen(end_str) );
 
 	LoadSoundsDescriptionFromFileData( start, end, GameResources::c_max_global_sounds, out_sounds );
 }
 
 void LoadAmbientSoundsDescriptionFromMapResourcesFile(
-	const Vfs::FileContent& resoure_file,
+	const Vfs::FileView& resoure_file,
 	GameResources::SoundDescription* out_sounds,
 	unsigned int max_sound_count )
 {
@@ -691,11 +718,16 @@ void LoadAmbientSoundsDescriptionFromMapResourcesFile(
 		out_sounds[s].volume= 0u;
 	}
 
-	const char* const start= std::strstr( reinterpret_cast<const char*>(resoure_file.data()), "#ambients" );
-	if( start == nullptr )
+	// Search only inside file, because file may be mapped and followed by other data.
+	const char* const file_begin= reinterpret_cast<const char*>(resoure_file.data());
+	const char* const file_end= file_begin + resoure_file.size();
+	const char* const str= "#ambients";
+	const char* const start= std::search( file_begin, file_end, str, str + std::strlen(str) );
+	if( start == file_end )
 		return;
 
-	const char* const end= std::strstr( start, "#end" );
+	const char* const end_str= "#end";
+	const char* const end= std::search( start, file_end, end_str, end_str + std::strlen(end_str) );
 
 	LoadSoundsDescriptionFromFileData( start, end, 0u, out_sounds );
 }
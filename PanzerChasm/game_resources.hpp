@@ -8,6 +8,14 @@
 namespace PanzerChasm
 {
 
+// Dedicated server (and server benchmarks) need only geometry, collisions, scripts and sounds numbers.
+// With server-only profile render-only data - models textures, sprites, lightmaps, floors textures - is not loaded.
+enum class LoadProfile
+{
+	Full,
+	ServerOnly,
+};
+
 // Commnon resources for different subsystems of client/server.
 struct GameResources
 {
@@ -168,15 +176,15 @@ public:
 	SoundDescription sounds[ c_max_global_sounds ];
 };
 
-GameResourcesConstPtr LoadGameResources( const VfsPtr& vfs );
+GameResourcesConstPtr LoadGameResources( const VfsPtr& vfs, LoadProfile load_profile );
 
 void LoadSoundsDescriptionFromMapResourcesFile(
-	const Vfs::FileContent& resoure_file,
+	const Vfs::FileView& resoure_file,
 	GameResources::SoundDescription* out_sounds,
 	unsigned int max_sound_count );
 
 void LoadAmbientSoundsDescriptionFromMapResourcesFile(
-	const Vfs::FileContent& resoure_file,
+	const Vfs::FileView& resoure_file,
 	GameResources::SoundDescription* out_sounds,
 	unsigned int max_sound_count );
 
@@ -1,26 +1,96 @@
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 
 #include <framebuffer.hpp>
-#include <glsl_program.hpp>
 #include <ogl_state_manager.hpp>
 #include <shaders_loading.hpp>
 
 #include "drawers_factory_gl.hpp"
 #include "drawers_factory_soft.hpp"
+#include "frame_pacing.hpp"
 #include "game_resources.hpp"
 #include "i_menu_drawer.hpp"
 #include "i_text_drawer.hpp"
 #include "log.hpp"
 #include "map_loader.hpp"
+#include "net/threaded_connections_listener.hpp"
+#include "profiler.hpp"
+#include "shader_program_gl.hpp"
 #include "shared_drawers.hpp"
 #include "save_load.hpp"
+#include "shared_settings_keys.hpp"
 #include "sound/sound_engine.hpp"
+#include "time.hpp"
 
 #include "host.hpp"
 
 namespace PanzerChasm
 {
 
+// Free-running local server sleeps between loops, like dedicated server.
+static const std::chrono::milliseconds g_free_running_server_sleep_time( 1 );
+
+// Classification of video settings for vid_restart.
+// Settings, not listed here (brightness, shadows, occlusion culling, etc.), are applied without any restart.
+
+// Changing of these settings requires recreation of system window and rendering context.
+static const char* const g_vid_window_settings[]=
+{
+	SettingsKeys::software_rendering,
+	SettingsKeys::fullscreen,
+	SettingsKeys::fullscreen_display,
+	SettingsKeys::fullscreen_width,
+	SettingsKeys::fullscreen_height,
+	SettingsKeys::fullscreen_frequency,
+	SettingsKeys::window_width,
+	SettingsKeys::window_height,
+	SettingsKeys::software_scale,
+	SettingsKeys::opengl_msaa_level,
+	"r_software_use_gl_screen_update",
+	"r_software_gl_update_smooth",
+	"r_software_async_present",
+};
+
+// Changing of these settings requires recreation of map drawer, but not window.
+static const char* const g_vid_map_drawer_settings[]=
+{
+	SettingsKeys::opengl_dynamic_lighting,
+	SettingsKeys::opengl_geometry_shaders,
+	SettingsKeys::opengl_textures_filtering,
+	SettingsKeys::opengl_textures_compression,
+	SettingsKeys::opengl_progressive_loading,
+	SettingsKeys::opengl_compressed_monsters_animations,
+	SettingsKeys::opengl_dynamic_resolution,
+	SettingsKeys::opengl_dynamic_resolution_fps,
+	"r_animations_storage",
+	SettingsKeys::software_rendering_threads,
+	SettingsKeys::software_rendering_simd,
+	SettingsKeys::software_surfaces_cache_size,
+	SettingsKeys::software_dynamic_resolution,
+	SettingsKeys::software_dynamic_resolution_fps,
+	SettingsKeys::software_smooth_lighting,
+};
+
+// Changing of these settings requires recreation of menu, text and hud drawers only.
+static const char* const g_vid_2d_drawers_settings[]=
+{
+	SettingsKeys::opengl_menu_textures_filtering,
+	SettingsKeys::opengl_hud_textures_filtering,
+};
+
+template<size_t N>
+static std::string GetSettingsValues( const Settings& settings, const char* const (&keys)[N] )
+{
+	std::string result;
+	for( const char* const key : keys )
+	{
+		result+= settings.GetString( key );
+		result+= '\n';
+	}
+	return result;
+}
+
 // Proxy for connections listeners.
 class Host::ConnectionsListenerProxy final : public IConnectionsListener
 {
@@ -49,6 +119,18 @@ public: // IConnectionsListener
 		return nullptr;
 	}
 
+	virtual void PollEvents() override
+	{
+		for( const IConnectionsListenerPtr& listener : connections_listeners_ )
+			listener->PollEvents();
+	}
+
+	virtual void SendQueuedPackets() override
+	{
+		for( const IConnectionsListenerPtr& listener : connections_listeners_ )
+			listener->SendQueuedPackets();
+	}
+
 private:
 	std::vector<IConnectionsListenerPtr> connections_listeners_;
 };
@@ -68,6 +150,7 @@ Host::Host( const int argc, const char* const* const argv )
 	: program_arguments_( argc, argv )
 	, settings_( "PanzerChasm.cfg" )
 	, commands_processor_( settings_ )
+	, main_thread_id_( std::this_thread::get_id() )
 {
 	{ // Register host commands
 		CommandsMapPtr commands= std::make_shared<CommandsMap>();
@@ -80,7 +163,15 @@ Host::Host( const int argc, const char* const* const argv )
 		commands->emplace( "runserver", std::bind( &Host::RunServerCommand, this, std::placeholders::_1 ) );
 		commands->emplace( "save", std::bind( &Host::SaveCommand, this, std::placeholders::_1 ) );
 		commands->emplace( "load", std::bind( &Host::LoadCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "rewind", std::bind( &Host::RewindCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "record", std::bind( &Host::RecordCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "stoprecord", std::bind( &Host::StopRecordCommand, this ) );
+		commands->emplace( "timedemo", std::bind( &Host::TimedemoCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "profiler_start", std::bind( &Host::ProfilerStartCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "profiler_stop", std::bind( &Host::ProfilerStopCommand, this ) );
+		commands->emplace( "profiler_dump", std::bind( &Host::ProfilerDumpCommand, this, std::placeholders::_1 ) );
 		commands->emplace( "vid_restart", std::bind( &Host::VidRestart, this ) );
+		commands->emplace( "bake_maps", std::bind( &Host::BakeMapsCommand, this ) );
 
 		host_commands_= std::move( commands );
 		commands_processor_.RegisterCommands( host_commands_ );
@@ -88,6 +179,11 @@ Host::Host( const int argc, const char* const* const argv )
 
 	base_window_title_= "PanzerChasm";
 
+	// Log time, read bytes and allocations of each step of resources and maps loading.
+	Profiler::SetLoadProfilingEnabled(
+		program_arguments_.HasParam( "load-profile" ) ||
+		settings_.GetOrSetBool( "load_profile", false ) );
+
 	{
 		Log::Info( "Read game archive" );
 
@@ -115,7 +211,7 @@ Host::Host( const int argc, const char* const* const argv )
 	CreateSlotSavesDir();
 
 	Log::Info( "Loading game resources" );
-	game_resources_= LoadGameResources( vfs_ );
+	game_resources_= LoadGameResources( vfs_, LoadProfile::Full );
 
 	VidRestart();
 
@@ -130,7 +226,11 @@ Host::Host( const int argc, const char* const* const argv )
 	else
 		Log::Info( "Sound disabled in settings" );
 
-	map_loader_= std::make_shared<MapLoader>( vfs_ );
+	map_loader_=
+		std::make_shared<MapLoader>(
+			vfs_,
+			size_t( std::max( settings_.GetOrSetInt( SettingsKeys::map_cache_size, 64 ), 0 ) ) << 20u,
+			LoadProfile::Full );
 
 	Log::Info( "Initialize menu" );
 	menu_.reset(
@@ -142,11 +242,36 @@ Host::Host( const int argc, const char* const* const argv )
 
 Host::~Host()
 {
+	if( server_thread_.joinable() )
+	{
+		{
+			std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+			server_thread_quit_= true;
+		}
+		server_thread_condition_.notify_all();
+		server_thread_.join();
+	}
 }
 
 bool Host::Loop()
 {
-	const Time tick_start_time= Time::CurrentTime();
+	// Previous loop is whole frame for profiler.
+	Profiler::EndFrame();
+
+	PC_PROFILE_SCOPE( "Host::Loop" );
+	Profiler::ScopedPhases phases( "wait server access" );
+
+	// Free-running server may tick now. Wait for it, before touching server or its connections.
+	std::unique_lock<std::mutex> server_access_lock( server_access_mutex_ );
+
+	phases.Next( "events" );
+
+	Time::SampleFrameTime();
+	const Time tick_start_time= Time::FrameTime();
+
+	// Measure in timedemo only frames after map loading.
+	const bool measure_timedemo_frame=
+		demo_playback_connection_ != nullptr && client_ != nullptr && client_->MapIsLoaded();
 
 	// Events processing
 	InputState input_state;
@@ -197,27 +322,64 @@ bool Host::Loop()
 	if( client_ != nullptr && !input_goes_to_console && !input_goes_to_menu && !really_paused )
 		client_->ProcessEvents( events_ );
 
+	phases.Next( "sound" );
 	if( sound_engine_ != nullptr )
 		sound_engine_->Tick();
 
+	phases.Next( "snapshot" );
+	if( !really_paused && !playing_cutscene )
+		TakeSnapshotIfNeeded();
+
 	// Loop operations
+	phases.Next( "server loop" );
+	const int async_server_mode= local_server_ != nullptr ? settings_.GetOrSetInt( "host_async_server", 0 ) : 0;
+	const bool async_server_loop= async_server_mode == 1;
+	const bool free_running_server= async_server_mode == 2;
+	if( loopback_buffer_ != nullptr )
+		loopback_buffer_->SetThreadSafe( free_running_server );
+	// Server thread must not read settings, because main thread may change them. So, update server settings here, under access lock.
 	if( local_server_ != nullptr )
+		local_server_->UpdateSettings();
+	if( local_server_ != nullptr && !async_server_loop && !free_running_server )
 		local_server_->Loop( really_paused || needs_pause_server );
 
+	SetServerFreeRunning( free_running_server, really_paused || needs_pause_server );
+	if( free_running_server )
+		server_access_lock.unlock();
+
+	phases.Next( "client loop" );
+	if( demo_playback_connection_ != nullptr )
+		demo_playback_connection_->NextFrame();
+
 	if( client_ != nullptr )
 	{
-		if( input_goes_to_console || input_goes_to_menu )
+		// Ignore input in timedemo, because view is controlled by demo.
+		if( input_goes_to_console || input_goes_to_menu || demo_playback_connection_ != nullptr )
 		{
 			InputState dummy_input_state;
 			client_->Loop( dummy_input_state, really_paused );
 		}
 		else
+		{
+			// Take mouse motion, made while server loop, in this frame, not in next one.
+			if( system_window_ != nullptr )
+				system_window_->SampleMouseMove( input_state );
 			client_->Loop( input_state, really_paused );
+		}
 	}
 
+	if( demo_recording_connection_ != nullptr )
+		demo_recording_connection_->EndFrame();
+
+	// Server reads messages of client, so, start it after client loop.
+	if( async_server_loop )
+		StartServerLoopAsync( really_paused || needs_pause_server );
+
 	// Draw operations
+	phases.Next( "draw" );
 	if( system_window_ && !system_window_->IsMinimized() )
 	{
+		FramePacing::MarkEvent( FramePacing::Event::DrawStart );
 		system_window_->BeginFrame();
 
 		if( client_ != nullptr && !client_->Disconnected() )
@@ -253,22 +415,119 @@ bool Host::Loop()
 				str, scale, ITextDrawer::FontColor::Golden, ITextDrawer::Alignment::Right );
 		}
 
+		const bool draw_frame_pacing= settings_.GetOrSetBool( "cl_draw_frame_pacing", false );
+		const bool draw_profiler_stats= settings_.GetOrSetBool( "cl_draw_profiler_stats", false );
+		if( draw_frame_pacing || draw_profiler_stats )
+		{
+			// Overlay itself allocates strings, so, give it own zone.
+			PC_PROFILE_SCOPE( "profiler overlay" );
+
+			std::vector<std::string> stats_lines;
+			if( draw_frame_pacing )
+				FramePacing::GetStatsLines( stats_lines );
+			if( draw_profiler_stats )
+				Profiler::GetFrameStats( stats_lines );
+
+			const unsigned int scale= 1u;
+			const unsigned int offset= shared_drawers_->menu->GetViewportSize().Width() - 4u * scale;
+			unsigned int y= 3u * shared_drawers_->text->GetLineHeight();
+			for( const std::string& line : stats_lines )
+			{
+				shared_drawers_->text->Print(
+					offset, y,
+					line.c_str(), scale, ITextDrawer::FontColor::Golden, ITextDrawer::Alignment::Right );
+				y+= shared_drawers_->text->GetLineHeight();
+			}
+		}
+
+		phases.Next( "end frame" );
 		system_window_->EndFrame();
 	}
 
+	phases.Next( "wait server" );
+	if( async_server_loop )
+	{
+		// Release access mutex - after mode switch server thread may still finish free-running loop.
+		server_access_lock.unlock();
+		WaitForServerLoop();
+	}
+	if( !server_access_lock.owns_lock() )
+		server_access_lock.lock();
+	Log::FlushDeferredMessages();
 
-	// Try sleep just a bit, if we run too fast.
 	const Time tick_end_time= Time::CurrentTime();
 	const double tick_duration_ms= ( tick_end_time - tick_start_time ).ToSeconds() * 1000.0f;
-	const float c_min_acceptable_tick_duration_ms= 5.0f;
-	if( tick_duration_ms < 0.9f * c_min_acceptable_tick_duration_ms )
-		SDL_Delay( static_cast<Uint32>( std::max( c_min_acceptable_tick_duration_ms - tick_duration_ms, 1.0 ) ) );
+
+	phases.Next( "sleep" );
+	if( demo_playback_connection_ != nullptr )
+	{
+		// Timedemo runs as fast as possible, without sleeping.
+		if( measure_timedemo_frame )
+			timedemo_frame_times_ms_.push_back( float( tick_duration_ms ) );
+		if( demo_playback_connection_->Finished() )
+			FinishTimedemo();
+	}
+	else
+	{
+		if( free_running_server )
+			server_access_lock.unlock();
+		WaitForNextFrame();
+	}
 
 	loops_counter_.Tick();
 
 	return !quit_requested_;
 }
 
+void Host::WaitForNextFrame()
+{
+	int max_fps= settings_.GetOrSetInt( "host_max_fps", 200 );
+	if( system_window_ != nullptr && system_window_->IsMinimized() )
+	{
+		// Nothing is drawn, so, do not waste CPU.
+		const int minimized_fps= settings_.GetOrSetInt( "host_minimized_fps", 30 );
+		if( minimized_fps > 0 && ( max_fps <= 0 || minimized_fps < max_fps ) )
+			max_fps= minimized_fps;
+	}
+
+	Time current_time= Time::CurrentTime();
+	if( max_fps <= 0 )
+	{
+		next_frame_time_= current_time;
+		return;
+	}
+
+	const Time frame_period= Time::FromSeconds( 1.0 / double( max_fps ) );
+	next_frame_time_+= frame_period;
+
+	// Do not try to catch up after slow frames. Also reset frame time after change of rate.
+	if( next_frame_time_ <= current_time || next_frame_time_ > current_time + frame_period )
+	{
+		next_frame_time_= current_time;
+		return;
+	}
+
+	// System sleep is not precise. Sleep for only part of remaining time, which will not be overslept, usually.
+	const float c_min_sleep_s= 0.0005f;
+	const float sleep_s= ( next_frame_time_ - current_time ).ToSeconds() - sleep_overshoot_s_;
+	if( sleep_s >= c_min_sleep_s )
+	{
+		std::this_thread::sleep_for( std::chrono::microseconds( static_cast<int>( sleep_s * 1.0e6f ) ) );
+
+		const Time sleep_end_time= Time::CurrentTime();
+		const float overshoot_s= std::max( 0.0f, ( sleep_end_time - current_time ).ToSeconds() - sleep_s );
+		// Grow fast, decrease slowly.
+		sleep_overshoot_s_+= ( overshoot_s - sleep_overshoot_s_ ) * ( overshoot_s > sleep_overshoot_s_ ? 0.5f : 0.05f );
+		current_time= sleep_end_time;
+	}
+
+	while( current_time < next_frame_time_ )
+	{
+		std::this_thread::yield();
+		current_time= Time::CurrentTime();
+	}
+}
+
 Settings& Host::GetSettings()
 {
 	return settings_;
@@ -323,7 +582,7 @@ void Host::ConnectToServer(
 		return;
 	}
 
-	client_->SetConnection( connection );
+	SetClientConnection( connection );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - multiplayer client" );
@@ -347,16 +606,19 @@ void Host::StartServer(
 
 	ClearBeforeGameStart();
 
-	const IConnectionsListenerPtr listener=
+	IConnectionsListenerPtr listener=
 		net_->CreateServerListener(
 			server_tcp_port != 0u ? server_tcp_port : Net::c_default_server_tcp_port,
-			server_base_udp_port != 0u ? server_base_udp_port : Net::c_default_server_udp_base_port );
+			server_base_udp_port != 0u ? server_base_udp_port : Net::c_default_server_udp_base_port,
+			settings_.GetOrSetBool( SettingsKeys::server_shared_udp_socket, false ) );
 
 	if( listener == nullptr )
 	{
 		Log::User( "Can not start server: network error." );
 		return;
 	}
+	if( settings_.GetOrSetBool( SettingsKeys::server_net_thread, false ) )
+		listener= std::make_shared<ThreadedConnectionsListener>( listener );
 
 	const bool map_changed=
 		local_server_->ChangeMap( map_number, difficulty, game_rules );
@@ -371,7 +633,7 @@ void Host::StartServer(
 	if( !dedicated )
 	{
 		loopback_buffer_->RequestConnect();
-		client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+		SetClientConnection( loopback_buffer_->GetClientSideConnection() );
 	}
 
 	if( system_window_ != nullptr )
@@ -385,6 +647,8 @@ bool Host::SaveAvailable() const
 
 void Host::GetSavesNames( SavesNames& out_saves_names )
 {
+	saves_writer_.Flush();
+
 	//for( SaveComment& save_comment : out_saves_names )
 	for( unsigned int slot= 0u; slot < c_save_slots; slot++ )
 	{
@@ -491,8 +755,201 @@ void Host::LoadCommand( const CommandsArguments& args )
 	DoLoad( args.front().c_str() );
 }
 
+void Host::RewindCommand( const CommandsArguments& args )
+{
+	unsigned int steps= 1u;
+	if( !args.empty() )
+		steps= std::max( std::atoi( args.front().c_str() ), 1 );
+
+	if( !is_single_player_ || snapshots_.empty() )
+	{
+		Log::Info( "No snapshots for rewind" );
+		return;
+	}
+
+	// Drop snapshots, newer, than restored snapshot.
+	// Keep older snapshots, because loading clears snapshots.
+	std::deque<SaveLoadBuffer> snapshots;
+	snapshots.swap( snapshots_ );
+	snapshots.resize( snapshots.size() - std::min( steps, static_cast<unsigned int>( snapshots.size() ) ) + 1u );
+
+	Log::Info( "Rewind game" );
+	const bool ok= LoadFromBuffer( snapshots.back() );
+
+	if( ok )
+	{
+		snapshots_= std::move( snapshots );
+		last_snapshot_time_= Time::CurrentTime();
+		Log::User( "Game rewound." );
+	}
+	else
+		Log::User( "Rewind failed." );
+}
+
+void Host::RecordCommand( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Warning( "Expected demo name" );
+		return;
+	}
+
+	demo_record_file_name_= args.front();
+	Log::User( "Demo recording starts with next game start." );
+}
+
+void Host::StopRecordCommand()
+{
+	demo_record_file_name_.clear();
+
+	if( demo_recording_connection_ == nullptr )
+	{
+		Log::Info( "Not recording demo" );
+		return;
+	}
+
+	// Client continues working with wrapped connection, only recording is stopped.
+	demo_recording_connection_->StopRecording();
+	demo_recording_connection_= nullptr;
+	Log::User( "Demo recording stopped." );
+}
+
+void Host::TimedemoCommand( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Warning( "Expected demo name" );
+		return;
+	}
+
+	const DemoPlaybackConnectionPtr connection= DemoPlaybackConnection::Create( args.front().c_str() );
+	if( connection == nullptr )
+	{
+		Log::User( "Can not play demo." );
+		return;
+	}
+
+	EnsureClient();
+	ClearBeforeGameStart();
+
+	demo_playback_connection_= connection;
+	timedemo_frame_times_ms_.clear();
+	client_->SetConnection( demo_playback_connection_ );
+
+	if( system_window_ != nullptr )
+		system_window_->SetTitle( base_window_title_ + " - timedemo" );
+}
+
+void Host::ProfilerStartCommand( const CommandsArguments& args )
+{
+	const bool track_allocations= !args.empty() && args.front() == "allocations";
+
+	Profiler::SetAllocationsTrackingEnabled( track_allocations );
+	Profiler::Start();
+	Log::User( track_allocations ? "Profiler started with allocations tracking." : "Profiler started." );
+}
+
+void Host::ProfilerStopCommand()
+{
+	Profiler::Stop();
+	Profiler::SetAllocationsTrackingEnabled( false );
+	Log::User( "Profiler stopped." );
+}
+
+void Host::ProfilerDumpCommand( const CommandsArguments& args )
+{
+	const char* const file_name= args.empty() ? "profile.json" : args.front().c_str();
+	if( Profiler::DumpChromeTrace( file_name ) )
+		Log::User( "Profiler trace written to \"", file_name, "\"." );
+}
+
+void Host::SetClientConnection( const IConnectionPtr& connection )
+{
+	PC_ASSERT( client_ != nullptr );
+
+	if( !demo_record_file_name_.empty() && connection != nullptr )
+	{
+		demo_recording_connection_= DemoRecordingConnection::Create( connection, demo_record_file_name_.c_str() );
+		demo_record_file_name_.clear();
+
+		if( demo_recording_connection_ != nullptr )
+		{
+			Log::User( "Recording demo." );
+			client_->SetConnection( demo_recording_connection_ );
+			return;
+		}
+	}
+
+	client_->SetConnection( connection );
+}
+
+void Host::FinishTimedemo()
+{
+	std::vector<float>& frame_times= timedemo_frame_times_ms_;
+	const char* const renderer_name=
+		system_window_ != nullptr && system_window_->IsOpenGLRenderer() ? "OpenGL" : "software";
+
+	if( frame_times.empty() )
+		Log::User( "Timedemo finished, no frames drawn." );
+	else
+	{
+		float total_time_ms= 0.0f;
+		for( const float frame_time : frame_times )
+			total_time_ms+= frame_time;
+
+		std::sort( frame_times.begin(), frame_times.end() );
+		const auto percentile=
+		[&]( const unsigned int p ) -> float
+		{
+			return frame_times[ ( frame_times.size() - 1u ) * p / 100u ];
+		};
+
+		Log::User( "Timedemo (", renderer_name, " renderer): ", frame_times.size(), " frames in ", total_time_ms / 1000.0f, " s, ", 1000.0f * float(frame_times.size()) / total_time_ms, " fps" );
+		Log::User( "Frame time ms - avg: ", total_time_ms / float(frame_times.size()), " min: ", frame_times.front(), " max: ", frame_times.back() );
+		Log::User( "Frame time ms - 50%: ", percentile(50u), " 95%: ", percentile(95u), " 99%: ", percentile(99u) );
+	}
+
+	ClearBeforeGameStart();
+}
+
+void Host::BakeMapsCommand()
+{
+	map_loader_->BakeMaps();
+}
+
 void Host::DoVidRestart()
 {
+	if( system_window_ != nullptr && drawers_factory_ != nullptr &&
+		GetSettingsValues( settings_, g_vid_window_settings ) == vid_window_settings_ )
+	{
+		// Window and context are same - keep them and recreate only drawers, which settings are changed.
+		system_window_->UpdateVsync();
+
+		const std::string map_drawer_settings= GetSettingsValues( settings_, g_vid_map_drawer_settings );
+		const std::string drawers_2d_settings= GetSettingsValues( settings_, g_vid_2d_drawers_settings );
+		const bool recreate_map_drawer= map_drawer_settings != vid_map_drawer_settings_;
+		const bool recreate_2d_drawers= drawers_2d_settings != vid_2d_drawers_settings_;
+		vid_map_drawer_settings_= map_drawer_settings;
+		vid_2d_drawers_settings_= drawers_2d_settings;
+
+		if( !recreate_map_drawer && !recreate_2d_drawers )
+		{
+			Log::Info( "Video settings applied without vid_restart" );
+			return;
+		}
+
+		Log::Info( "Recreate drawers without window recreation", recreate_map_drawer ? ", including map drawer" : "" );
+		if( recreate_2d_drawers )
+		{
+			shared_drawers_->VidClear();
+			shared_drawers_->VidRestart( *drawers_factory_ );
+		}
+		if( client_ != nullptr )
+			client_->RecreateDrawers( *drawers_factory_, recreate_map_drawer );
+
+		return;
+	}
+
 	// Clear old resources.
 	if( shared_drawers_ != nullptr )
 		shared_drawers_->VidClear();
@@ -527,15 +984,20 @@ void Host::DoVidRestart()
 			};
 
 			rSetShaderLoadingLogCallback( shaders_log_callback );
-			r_GLSLProgram::SetProgramBuildLogOutCallback( shaders_log_callback );
+			ShaderProgramGL::SetProgramBuildLogOutCallback( shaders_log_callback );
 		}
 		r_Framebuffer::SetScreenFramebufferSize( system_window_->GetViewportSize().Width(), system_window_->GetViewportSize().Height() );
 
+		// Log time of drawers creation, because most of it is shaders compilation, if shaders binaries are not cached yet.
+		const Time drawers_creation_start_time= Time::CurrentTime();
+
 		drawers_factory_=
 			std::make_shared<DrawersFactoryGL>(
 				settings_,
 				game_resources_,
 				system_window_->GetRenderingContextGL() );
+
+		Log::Info( "OpenGL drawers created in ", ( Time::CurrentTime() - drawers_creation_start_time ).ToSeconds(), " s" );
 	}
 	else
 	{
@@ -570,6 +1032,10 @@ void Host::DoVidRestart()
 
 	if( client_ != nullptr )
 		client_->VidRestart( *drawers_factory_ );
+
+	vid_window_settings_= GetSettingsValues( settings_, g_vid_window_settings );
+	vid_map_drawer_settings_= GetSettingsValues( settings_, g_vid_map_drawer_settings );
+	vid_2d_drawers_settings_= GetSettingsValues( settings_, g_vid_2d_drawers_settings );
 }
 
 void Host::DoRunLevel( const unsigned int map_number, const DifficultyType difficulty )
@@ -590,7 +1056,7 @@ void Host::DoRunLevel( const unsigned int map_number, const DifficultyType diffi
 	loopback_buffer_->RequestConnect();
 
 	// Make client working with loopback buffer connection.
-	client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+	SetClientConnection( loopback_buffer_->GetClientSideConnection() );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - singleplayer" );
@@ -614,38 +1080,44 @@ void Host::DoSave( const char* const save_file_name )
 	local_server_->Save( buffer );
 	client_->Save( buffer, save_comment );
 
-	if( SaveData( save_file_name, save_comment, buffer ) )
-		Log::User( "Game saved." );
-	else
-		Log::User( "Game save failed." );
+	// Hashing and writing are done in background.
+	saves_writer_.Write( save_file_name, save_comment, std::move(buffer) );
 }
 
 void Host::DoLoad( const char* const save_file_name )
 {
 	SaveLoadBuffer save_buffer;
-	unsigned int save_buffer_pos= 0u;
 
 	Log::Info( "Load game" );
 
+	saves_writer_.Flush();
 	if( !LoadData( save_file_name, save_buffer ) )
 	{
 		Log::User( "Loading failed." );
 		return;
 	}
 
+	if( LoadFromBuffer( save_buffer ) )
+		Log::User( "Game loaded." );
+	else
+		Log::User( "Loading failed." );
+}
+
+bool Host::LoadFromBuffer( const SaveLoadBuffer& save_buffer )
+{
+	unsigned int save_buffer_pos= 0u;
+
 	EnsureClient();
 	EnsureServer();
 	EnsureLoopbackBuffer();
 
 	ClearBeforeGameStart();
 
+	// Map data and map drawers state are reused, if map is same.
 	const bool map_changed=
 		local_server_->Load( save_buffer, save_buffer_pos );
 	if( !map_changed )
-	{
-		Log::User( "Loading failed." );
-		return;
-	}
+		return false;
 
 	client_->Load( save_buffer, save_buffer_pos );
 
@@ -654,14 +1126,44 @@ void Host::DoLoad( const char* const save_file_name )
 	loopback_buffer_->RequestConnect();
 
 	// Make client working with loopback buffer connection.
-	client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+	SetClientConnection( loopback_buffer_->GetClientSideConnection() );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - singleplayer" );
 
 	is_single_player_= true;
 
-	Log::User( "Game loaded." );
+	return true;
+}
+
+void Host::TakeSnapshotIfNeeded()
+{
+	if( !( local_server_ != nullptr && client_ != nullptr && is_single_player_ && client_->MapIsLoaded() ) )
+		return;
+
+	const unsigned int max_snapshots= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "host_snapshots_count", 8 ) ) );
+	const float snapshots_period_s= std::max( 1.0f, settings_.GetOrSetFloat( "host_snapshots_period", 15.0f ) );
+
+	const Time current_time= Time::CurrentTime();
+	if( max_snapshots == 0u || ( current_time - last_snapshot_time_ ).ToSeconds() < snapshots_period_s )
+		return;
+	last_snapshot_time_= current_time;
+
+	// Reuse memory of oldest snapshot.
+	SaveLoadBuffer buffer;
+	while( snapshots_.size() >= max_snapshots )
+	{
+		buffer.swap( snapshots_.front() );
+		snapshots_.pop_front();
+	}
+	buffer.clear();
+
+	// Save comment is not needed for snapshots.
+	SaveComment save_comment;
+	local_server_->Save( buffer );
+	client_->Save( buffer, save_comment );
+
+	snapshots_.push_back( std::move( buffer ) );
 }
 
 void Host::DrawLoadingFrame( const float progress, const char* const caption )
@@ -669,6 +1171,10 @@ void Host::DrawLoadingFrame( const float progress, const char* const caption )
 	// TODO - use this.
 	PC_UNUSED( caption );
 
+	// Server may change map in asynchronous loop. Draw only in main thread.
+	if( std::this_thread::get_id() != main_thread_id_ )
+		return;
+
 	if( system_window_ != nullptr && shared_drawers_ != nullptr )
 	{
 		system_window_->BeginFrame();
@@ -677,6 +1183,88 @@ void Host::DrawLoadingFrame( const float progress, const char* const caption )
 	}
 }
 
+void Host::StartServerLoopAsync( const bool paused )
+{
+	if( !server_thread_.joinable() )
+		server_thread_= std::thread( &Host::ServerThreadFunc, this );
+
+	{
+		std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+		PC_ASSERT( !server_loop_requested_ );
+		server_loop_paused_= paused;
+		server_loop_requested_= true;
+	}
+	server_thread_condition_.notify_all();
+}
+
+void Host::WaitForServerLoop()
+{
+	std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+	server_thread_condition_.wait( lock, [this]{ return !server_loop_requested_; } );
+}
+
+void Host::SetServerFreeRunning( const bool free_running, const bool paused )
+{
+	if( !free_running && !server_free_running_ )
+		return;
+
+	if( !server_thread_.joinable() )
+		server_thread_= std::thread( &Host::ServerThreadFunc, this );
+
+	{
+		std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+		server_free_running_= free_running;
+		server_loop_paused_= paused;
+	}
+	server_thread_condition_.notify_all();
+}
+
+void Host::ServerThreadFunc()
+{
+	while(true)
+	{
+		bool paused;
+		bool free_running;
+		{
+			std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+			server_thread_condition_.wait(
+				lock,
+				[this]{ return server_thread_quit_ || server_loop_requested_ || server_free_running_; } );
+			if( server_thread_quit_ )
+				return;
+			paused= server_loop_paused_;
+			free_running= !server_loop_requested_;
+		}
+
+		if( free_running )
+		{
+			{
+				// Main thread does not touch server, while it does not hold access mutex.
+				std::unique_lock<std::mutex> server_access_lock( server_access_mutex_ );
+				if( local_server_ != nullptr )
+					local_server_->Loop( paused );
+			}
+
+			std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+			server_thread_condition_.wait_for(
+				lock,
+				g_free_running_server_sleep_time,
+				[this]{ return server_thread_quit_ || !server_free_running_; } );
+			continue;
+		}
+
+		// Main thread does not touch server, while loop is requested.
+		if( local_server_ != nullptr )
+			local_server_->Loop( paused );
+
+		{
+			std::unique_lock<std::mutex> lock( server_thread_mutex_ );
+			server_loop_requested_= false;
+		}
+		server_thread_condition_.notify_all();
+	}
+}
+
 void Host::EnsureClient()
 {
 	if( client_ != nullptr )
@@ -714,6 +1302,7 @@ void Host::EnsureServer()
 
 	local_server_.reset(
 		new Server(
+			settings_,
 			commands_processor_,
 			game_resources_,
 			map_loader_,
@@ -747,6 +1336,14 @@ void Host::ClearBeforeGameStart()
 	if( client_ != nullptr )
 		client_->SetConnection( nullptr );
 
+	if( demo_recording_connection_ != nullptr )
+	{
+		demo_recording_connection_->StopRecording();
+		demo_recording_connection_= nullptr;
+	}
+	demo_playback_connection_= nullptr;
+	timedemo_frame_times_ms_.clear();
+
 	if( local_server_ != nullptr )
 	{
 		local_server_->DisconnectAllClients();
@@ -765,6 +1362,9 @@ void Host::ClearBeforeGameStart()
 
 	is_single_player_= false;
 	paused_= false;
+
+	snapshots_.clear();
+	last_snapshot_time_= Time::CurrentTime();
 }
 
 } // namespace PanzerChasm
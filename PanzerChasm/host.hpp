@@ -1,13 +1,19 @@
 #pragma once
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "client/client.hpp"
 #include "commands_processor.hpp"
 #include "console.hpp"
+#include "demo.hpp"
 #include "host_commands.hpp"
 #include "menu.hpp"
 #include "net/net.hpp"
 #include "program_arguments.hpp"
+#include "save_load.hpp"
 #include "server/server.hpp"
 #include "settings.hpp"
 #include "system_event.hpp"
@@ -64,15 +70,36 @@ private:
 	void RunServerCommand( const CommandsArguments& args );
 	void SaveCommand( const CommandsArguments& args );
 	void LoadCommand( const CommandsArguments& args );
+	void RewindCommand( const CommandsArguments& args );
+	void RecordCommand( const CommandsArguments& args );
+	void StopRecordCommand();
+	void TimedemoCommand( const CommandsArguments& args );
+	void ProfilerStartCommand( const CommandsArguments& args );
+	void ProfilerStopCommand();
+	void ProfilerDumpCommand( const CommandsArguments& args );
+	void BakeMapsCommand();
 
 	void DoVidRestart();
 
 	void DoRunLevel( unsigned int map_number, DifficultyType difficulty );
 	void DoSave( const char* save_file_name );
 	void DoLoad( const char* save_file_name );
+	// Returns true, if all ok.
+	bool LoadFromBuffer( const SaveLoadBuffer& save_buffer );
+
+	void TakeSnapshotIfNeeded();
+
+	// Starts demo recording, if it was requested.
+	void SetClientConnection( const IConnectionPtr& connection );
+	void FinishTimedemo();
 
 	void DrawLoadingFrame( float progress, const char* caption );
 
+	void StartServerLoopAsync( bool paused );
+	void WaitForServerLoop();
+	void SetServerFreeRunning( bool free_running, bool paused );
+	void ServerThreadFunc();
+
 	void EnsureClient();
 	void EnsureServer();
 	void EnsureLoopbackBuffer();
@@ -80,6 +107,9 @@ private:
 
 	void ClearBeforeGameStart();
 
+	// Limits frame rate by setting "host_max_fps" (or "host_minimized_fps", if window is minimized).
+	void WaitForNextFrame();
+
 private:
 	// Put members here in reverse deinitialization order.
 
@@ -92,6 +122,10 @@ private:
 
 	TicksCounter loops_counter_;
 
+	// Frames are started with fixed period. Waiting is system sleep for most of time, and spinning for rest of it.
+	Time next_frame_time_= Time::FromSeconds(0);
+	float sleep_overshoot_s_= 0.001f; // Average excess of system sleep over requested time.
+
 	VfsPtr vfs_;
 	GameResourcesConstPtr game_resources_;
 
@@ -104,6 +138,10 @@ private:
 
 	IDrawersFactoryPtr drawers_factory_;
 	std::shared_ptr<SharedDrawers> shared_drawers_;
+	// Values of video settings groups at last vid_restart. Used for selection of things to recreate.
+	std::string vid_window_settings_;
+	std::string vid_map_drawer_settings_;
+	std::string vid_2d_drawers_settings_;
 	std::unique_ptr<Console> console_;
 	std::unique_ptr<Menu> menu_;
 
@@ -114,6 +152,35 @@ private:
 	std::unique_ptr<Server> local_server_;
 	std::unique_ptr<Client> client_;
 
+	SavesWriter saves_writer_;
+
+	// Ring of last game state snapshots in memory, taken periodically in single player game.
+	// Oldest snapshot is first. Snapshots are cleared at each game start.
+	std::deque<SaveLoadBuffer> snapshots_;
+	Time last_snapshot_time_= Time::FromSeconds(0);
+
+	// Recording of requested demo starts with next connection of client.
+	std::string demo_record_file_name_;
+	DemoRecordingConnectionPtr demo_recording_connection_;
+	// Timedemo - playback of demo as fast as possible, with measurement of frames time.
+	DemoPlaybackConnectionPtr demo_playback_connection_;
+	std::vector<float> timedemo_frame_times_ms_;
+
+	// Asynchronous loop of local server (setting "host_async_server").
+	// Mode 1: server tick runs in separate thread, while frame is drawing. Client sees results of tick in next frame.
+	// Host waits for server tick at end of each loop, so, outside drawing server may be accessed directly.
+	// Mode 2: server loops in separate thread all the time, with its own rate, and talks to client via thread-safe loopback buffer.
+	// Host holds server access mutex all the time, except client loop, drawing and sleeping.
+	const std::thread::id main_thread_id_;
+	std::thread server_thread_;
+	std::mutex server_thread_mutex_;
+	std::condition_variable server_thread_condition_;
+	std::mutex server_access_mutex_;
+	bool server_loop_requested_= false;
+	bool server_loop_paused_= false;
+	bool server_free_running_= false;
+	bool server_thread_quit_= false;
+
 	std::string base_window_title_;
 	bool is_single_player_= false;
 	bool paused_= false;
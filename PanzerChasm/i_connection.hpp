@@ -24,6 +24,18 @@ public:
 
 	// Returns address or something like this.
 	virtual std::string GetConnectionInfo()= 0;
+
+	// Bytes of reliable data, accepted by connection, but not yet transmitted. Zero, if unknown.
+	virtual unsigned int GetReliableBacklogSize() { return 0u; }
+
+	// Optional zero-copy receiving for in-process connections.
+	// Returns contiguous part of received data, without removing it from connection, or nullptr, if this is not supported.
+	// Data is valid until next call of other connection methods or until peer sends something.
+	// Processed part of data must be removed via Skip method.
+	virtual const unsigned char* PeekReliableData( unsigned int& out_data_size ) { out_data_size= 0u; return nullptr; }
+	virtual const unsigned char* PeekUnreliableData( unsigned int& out_data_size ) { out_data_size= 0u; return nullptr; }
+	virtual void SkipReliableData( unsigned int /*data_size*/ ) {}
+	virtual void SkipUnreliableData( unsigned int /*data_size*/ ) {}
 };
 
 } // namespace PanzerChasm
@@ -1,4 +1,9 @@
 #include <cmath>
+#include <cstring>
+
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
 
 #include "assert.hpp"
 #include "vfs.hpp"
@@ -8,6 +13,25 @@
 namespace PanzerChasm
 {
 
+void BuildPaletteRGBA(
+	const Palette& palette,
+	const unsigned int transpareny_color_index,
+	PaletteRGBA& out_palette_rgba )
+{
+	for( unsigned int i= 0u; i < 256u; i++ )
+	{
+		const unsigned char texel[4]=
+		{
+			palette[ i * 3u + 0u ],
+			palette[ i * 3u + 1u ],
+			palette[ i * 3u + 2u ],
+			static_cast<unsigned char>( i == transpareny_color_index ? 0u : 255u ),
+		};
+		// Copy bytes, so, byte order of texel in memory is RGBA on any platform.
+		std::memcpy( &out_palette_rgba[i], texel, sizeof(texel) );
+	}
+}
+
 void ConvertToRGBA(
 	const unsigned int pixel_count,
 	const unsigned char* const in_data,
@@ -15,13 +39,33 @@ void ConvertToRGBA(
 	unsigned char* const out_data,
 	const unsigned char transpareny_color_index )
 {
-	for( unsigned int p= 0u; p < pixel_count; p++ )
-	{
-		for( unsigned int j= 0u; j < 3u; j++ )
-			out_data[ p * 4u + j ]= palette[ in_data[p] * 3u + j ];
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, transpareny_color_index, palette_rgba );
+	ConvertToRGBA( pixel_count, in_data, palette_rgba, out_data );
+}
 
-		out_data[ p * 4u + 3 ]= in_data[p] == transpareny_color_index ? 0u : 255u;
+void ConvertToRGBA(
+	const unsigned int pixel_count,
+	const unsigned char* const in_data,
+	const PaletteRGBA& palette_rgba,
+	unsigned char* const out_data )
+{
+	// One table fetch for each pixel instead of three bytes fetches and alpha comparison.
+	// Process 4 pixels for one 16-byte store.
+	unsigned int p= 0u;
+	for( ; p + 4u <= pixel_count; p+= 4u )
+	{
+		const uint32_t texels[4]=
+		{
+			palette_rgba[ in_data[ p + 0u ] ],
+			palette_rgba[ in_data[ p + 1u ] ],
+			palette_rgba[ in_data[ p + 2u ] ],
+			palette_rgba[ in_data[ p + 3u ] ],
+		};
+		std::memcpy( out_data + p * 4u, texels, sizeof(texels) );
 	}
+	for( ; p < pixel_count; p++ )
+		std::memcpy( out_data + p * 4u, &palette_rgba[ in_data[p] ], sizeof(uint32_t) );
 }
 
 void FlipAndConvertToRGBA(
@@ -30,18 +74,15 @@ void FlipAndConvertToRGBA(
 	const Palette& palette,
 	unsigned char* const out_data )
 {
-	for( unsigned int y= 0u; y < height; y++ )
-	{
-		const unsigned char* const src= in_data + (height - y - 1u) * width;
-		unsigned char* const dst= out_data + 4u * y * width;
-		for( unsigned int x= 0u; x < width; x++ )
-		{
-			for( unsigned int j= 0u; j < 3u; j++ )
-				dst[ x * 4u + j ]= palette[ src[x] * 3u + j ];
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, 255u, palette_rgba );
 
-			dst[ x * 4u + 3 ]= src[x] == 255u ? 0u : 255u;
-		}
-	}
+	for( unsigned int y= 0u; y < height; y++ )
+		ConvertToRGBA(
+			width,
+			in_data + (height - y - 1u) * width,
+			palette_rgba,
+			out_data + 4u * y * width );
 }
 
 void ColorShift(
@@ -51,7 +92,29 @@ void ColorShift(
 	const unsigned char* in_data,
 	unsigned char* out_data )
 {
-	for( unsigned int i= 0u; i < pixel_count; i++ )
+	unsigned int i= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	if( end_color > start_color )
+	{
+		// Color is in range, if unsigned "color - start_color" is not greater, than range size minus one.
+		const __m128i start= _mm_set1_epi8( static_cast<char>( start_color ) );
+		const __m128i range_max= _mm_set1_epi8( static_cast<char>( end_color - start_color - 1u ) );
+		const __m128i shift_vec= _mm_set1_epi8( shift );
+
+		for( ; i + 16u <= pixel_count; i+= 16u )
+		{
+			const __m128i c= _mm_loadu_si128( reinterpret_cast<const __m128i*>( in_data + i ) );
+			const __m128i c_relative= _mm_sub_epi8( c, start );
+			const __m128i in_range= _mm_cmpeq_epi8( _mm_min_epu8( c_relative, range_max ), c_relative );
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i*>( out_data + i ),
+				_mm_add_epi8( c, _mm_and_si128( in_range, shift_vec ) ) );
+		}
+	}
+#endif
+
+	for( ; i < pixel_count; i++ )
 	{
 		const unsigned char c= in_data[i];
 		if( c >= start_color && c < end_color )
@@ -210,14 +273,9 @@ void CreateConsoleBackgroundRGBA(
 	CreateConsoleBackground( size, vfs, data_indexed );
 	out_data_rgba.resize( data_indexed.size() * 4u );
 
-	for( unsigned int i= 0u; i < data_indexed.size(); i++ )
-	{
-		const unsigned char color_index= data_indexed[i];
-		out_data_rgba[ i * 4u + 0u ]= palette[ color_index * 3u + 0u ];
-		out_data_rgba[ i * 4u + 1u ]= palette[ color_index * 3u + 1u ];
-		out_data_rgba[ i * 4u + 2u ]= palette[ color_index * 3u + 2u ];
-		out_data_rgba[ i * 4u + 3u ]= 255u;
-	}
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, c_no_transparent_color_index, palette_rgba );
+	ConvertToRGBA( data_indexed.size(), data_indexed.data(), palette_rgba, out_data_rgba.data() );
 }
 
 void CreateBriefbarTexture(
@@ -272,14 +330,10 @@ void CreateBriefbarTextureRGBA(
 	CreateBriefbarTexture( viewport_size, vfs, data_indexed, out_size );
 
 	out_data_rgba.resize( data_indexed.size() * 4u );
-	for( unsigned int i= 0u; i < data_indexed.size(); i++ )
-	{
-		const unsigned char color_index= data_indexed[i];
-		out_data_rgba[ i * 4u + 0u ]= palette[ color_index * 3u + 0u ];
-		out_data_rgba[ i * 4u + 1u ]= palette[ color_index * 3u + 1u ];
-		out_data_rgba[ i * 4u + 2u ]= palette[ color_index * 3u + 2u ];
-		out_data_rgba[ i * 4u + 3u ]= 255u;
-	}
+
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, c_no_transparent_color_index, palette_rgba );
+	ConvertToRGBA( data_indexed.size(), data_indexed.data(), palette_rgba, out_data_rgba.data() );
 }
 
 void CreateNetgameScoreBackgroundTexture(
@@ -302,12 +356,10 @@ void CreateNetgameScoreBackgroundTextureRGBA(
 	CreateNetgameScoreBackgroundTexture( data, out_size );
 
 	out_data_rgba.resize( data.size() * 4u );
-	for( unsigned int i= 0u; i < out_size.Width() * out_size.Height(); i++ )
-	{
-		for( unsigned int c= 0u; c < 3u; c++ )
-			out_data_rgba[ i * 4u + c ]= palette[ data[i] * 3u + c ];
-		out_data_rgba[ i * 4u + 3u ]= 255u;
-	}
+
+	PaletteRGBA palette_rgba;
+	BuildPaletteRGBA( palette, c_no_transparent_color_index, palette_rgba );
+	ConvertToRGBA( data.size(), data.data(), palette_rgba, out_data_rgba.data() );
 }
 
 void FillAlphaTexelsColorRGBA(
@@ -321,6 +373,17 @@ void FillAlphaTexelsColorRGBA(
 	for( unsigned int x= 1u; x < width  - 1u; x++ )
 	{
 		unsigned char* const texel= data + ( x + y * width ) * 4u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+		// Most texels are not alpha. Skip 4 nonalpha texels with one check of sign bits of alpha bytes.
+		if( x + 4u <= width - 1u &&
+			( _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( texel ) ) ) & 0x8888 ) == 0x8888 )
+		{
+			x+= 3u;
+			continue;
+		}
+#endif
+
 		if( texel[3] >= c_alpha_edge ) // Not alpha
 			continue;
 
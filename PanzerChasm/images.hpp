@@ -1,5 +1,6 @@
 #pragma once
 #include <array>
+#include <cstdint>
 #include <vector>
 
 #include "fwd.hpp"
@@ -10,6 +11,12 @@ namespace PanzerChasm
 
 typedef std::array<unsigned char, 768> Palette;
 
+// Palette, expanded to RGBA texels. Build it once and reuse for conversion of many images with same palette.
+typedef std::array<uint32_t, 256> PaletteRGBA;
+
+// Pass this as transparent color index for palette without transparent color.
+const unsigned int c_no_transparent_color_index= 256u;
+
 struct CelTextureHeader
 {
 	unsigned short unknown0;
@@ -20,6 +27,11 @@ struct CelTextureHeader
 
 static_assert( sizeof(CelTextureHeader) == 800u, "Invalid size" );
 
+void BuildPaletteRGBA(
+	const Palette& palette,
+	unsigned int transpareny_color_index,
+	PaletteRGBA& out_palette_rgba );
+
 void ConvertToRGBA(
 	unsigned int pixel_count,
 	const unsigned char* in_data,
@@ -27,6 +39,12 @@ void ConvertToRGBA(
 	unsigned char* out_data,
 	unsigned char transpareny_color_index= 255u );
 
+void ConvertToRGBA(
+	unsigned int pixel_count,
+	const unsigned char* in_data,
+	const PaletteRGBA& palette_rgba,
+	unsigned char* out_data );
+
 void FlipAndConvertToRGBA(
 	unsigned int width, unsigned int height,
 	const unsigned char* in_data,
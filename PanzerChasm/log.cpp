@@ -1,25 +1,161 @@
+#ifndef PC_DEDICATED_SERVER
 #include <SDL_messagebox.h>
+#endif
 
+#include <condition_variable>
+
+#include "assert.hpp"
 #include "log.hpp"
 
 namespace PanzerChasm
 {
 
+namespace
+{
+
+// Writes lines into stdout and log file in own thread.
+// Thread is started on first line and stopped at exit, after writing of all queued lines.
+class LogWriter final
+{
+public:
+	LogWriter()
+		: file_( "panzer_chasm.log" )
+	{}
+
+	~LogWriter()
+	{
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			stop_requested_= true;
+		}
+		queue_condition_.notify_one();
+
+		if( thread_.joinable() )
+			thread_.join();
+	}
+
+	void Write( std::string line )
+	{
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			if( !thread_.joinable() )
+				thread_= std::thread( &LogWriter::ThreadFunc, this );
+
+			queue_.push_back( std::move(line) );
+		}
+		queue_condition_.notify_one();
+	}
+
+	void Flush()
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		written_condition_.wait( lock, [this]{ return queue_.empty() && !writing_; } );
+	}
+
+private:
+	void ThreadFunc()
+	{
+		std::vector<std::string> lines;
+
+		std::unique_lock<std::mutex> lock( mutex_ );
+		while(true)
+		{
+			queue_condition_.wait( lock, [this]{ return !queue_.empty() || stop_requested_; } );
+			if( queue_.empty() )
+				break; // Stop requested and all lines are written.
+
+			lines.swap( queue_ );
+			writing_= true;
+			lock.unlock();
+
+			// Write all queued lines and flush only once.
+			for( const std::string& line : lines )
+			{
+				std::cout << line << '\n';
+				file_ << line << '\n';
+			}
+			std::cout.flush();
+			file_.flush();
+			lines.clear();
+
+			lock.lock();
+			writing_= false;
+			written_condition_.notify_all();
+		}
+	}
+
+private:
+	std::ofstream file_;
+
+	std::mutex mutex_;
+	std::condition_variable queue_condition_;
+	std::condition_variable written_condition_;
+	std::vector<std::string> queue_;
+	bool writing_= false;
+	bool stop_requested_= false;
+
+	std::thread thread_;
+};
+
+LogWriter& GetLogWriter()
+{
+	// Construct on first use, for logging during static initialization.
+	static LogWriter writer;
+	return writer;
+}
+
+} // namespace
+
 Log::LogCallback Log::log_callback_;
-std::ofstream Log::log_file_{ "panzer_chasm.log" };
+std::thread::id Log::log_callback_thread_id_;
+std::vector< std::pair< std::string, Log::LogLevel > > Log::deferred_messages_;
+std::mutex Log::mutex_;
 
 void Log::SetLogCallback( LogCallback callback )
 {
+	std::unique_lock<std::mutex> lock( mutex_ );
 	log_callback_= std::move(callback);
+	log_callback_thread_id_= std::this_thread::get_id();
+	deferred_messages_.clear();
+}
+
+void Log::FlushDeferredMessages()
+{
+	std::vector< std::pair< std::string, LogLevel > > messages;
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		messages.swap( deferred_messages_ );
+	}
+
+	if( log_callback_ == nullptr )
+		return;
+
+	for( std::pair< std::string, LogLevel >& message : messages )
+		log_callback_( std::move(message.first), message.second );
+}
+
+void Log::WriteLine( std::string str )
+{
+	GetLogWriter().Write( std::move(str) );
+}
+
+void Log::FlushWrittenLines()
+{
+	GetLogWriter().Flush();
 }
 
 void Log::ShowFatalMessageBox( const std::string& error_message )
 {
+#ifdef PC_DEDICATED_SERVER
+	// Dedicated server has no windows. Message is already printed into stdout.
+	PC_UNUSED( error_message );
+#else
 	SDL_ShowSimpleMessageBox(
 		SDL_MESSAGEBOX_ERROR,
 		"Fatal error",
 		error_message.c_str(),
 		nullptr );
+#endif
 }
 
 } // namespace PanzerChasm
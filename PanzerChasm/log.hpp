@@ -3,13 +3,19 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace PanzerChasm
 {
 
 // Simple logger. You can write messages to it.
-// Not thread-safe.
+// Messages may be written from any thread, but callback is called only in thread, which set it.
+// Messages from other threads are passed to callback in FlushDeferredMessages call.
+// Messages are written into stdout and log file in background thread, so, logging does not block on I/O.
 class Log
 {
 public:
@@ -26,6 +32,9 @@ public:
 
 	static void SetLogCallback( LogCallback callback );
 
+	// Call it in thread, which set callback.
+	static void FlushDeferredMessages();
+
 	template<class...Args>
 	static void User(const Args&... args );
 
@@ -48,11 +57,18 @@ private:
 	template<class... Args>
 	static void PrinLine( LogLevel log_level, const Args&... args );
 
+	// Queue message for writing into stdout and log file.
+	static void WriteLine( std::string str );
+	// Blocks until all queued messages are written.
+	static void FlushWrittenLines();
+
 	static void ShowFatalMessageBox( const std::string& error_message );
 
 private:
 	static LogCallback log_callback_;
-	static std::ofstream log_file_;
+	static std::thread::id log_callback_thread_id_;
+	static std::vector< std::pair< std::string, LogLevel > > deferred_messages_;
+	static std::mutex mutex_;
 };
 
 template<class...Args>
@@ -80,8 +96,8 @@ void Log::FatalError( const Args&... args )
 	Print( stream, args... );
 	const std::string str= stream.str();
 
-	std::cout << str << std::endl;
-	log_file_ << str << std::endl;
+	WriteLine( str );
+	FlushWrittenLines();
 	ShowFatalMessageBox( str );
 
 	std::exit(-1);
@@ -101,11 +117,19 @@ void Log::PrinLine( const LogLevel log_level, const Args&... args )
 	Print( stream, args... );
 	const std::string str= stream.str();
 
-	std::cout << str << std::endl;
-	log_file_ << str << std::endl;
+	WriteLine( str );
 
+	std::unique_lock<std::mutex> lock( mutex_ );
 	if( log_callback_ != nullptr )
-		log_callback_( std::move(str), log_level );
+	{
+		if( std::this_thread::get_id() == log_callback_thread_id_ )
+		{
+			lock.unlock();
+			log_callback_( std::move(str), log_level );
+		}
+		else
+			deferred_messages_.emplace_back( std::move(str), log_level );
+	}
 }
 
 } // namespace PanzerChasm
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include "assert.hpp"
@@ -12,6 +13,7 @@ class LoopbackBuffer::Connection final : public IConnection
 {
 public:
 	Connection(
+		LoopbackBuffer& loopback_buffer,
 		Queue& in_reliable_buffer,
 		Queue& in_unreliable_buffer,
 		Queue& out_reliable_buffer,
@@ -31,7 +33,13 @@ public: // IConnection
 
 	virtual std::string GetConnectionInfo() override;
 
+	virtual const unsigned char* PeekReliableData( unsigned int& out_data_size ) override;
+	virtual const unsigned char* PeekUnreliableData( unsigned int& out_data_size ) override;
+	virtual void SkipReliableData( unsigned int data_size ) override;
+	virtual void SkipUnreliableData( unsigned int data_size ) override;
+
 private:
+	LoopbackBuffer& loopback_buffer_;
 	Queue& in_reliable_buffer_;
 	Queue& in_unreliable_buffer_;
 	Queue& out_reliable_buffer_;
@@ -41,11 +49,13 @@ private:
 };
 
 LoopbackBuffer::Connection::Connection(
+	LoopbackBuffer& loopback_buffer,
 	Queue& in_reliable_buffer,
 	Queue& in_unreliable_buffer,
 	Queue& out_reliable_buffer,
 	Queue& out_unreliable_buffer )
-	: in_reliable_buffer_(in_reliable_buffer)
+	: loopback_buffer_(loopback_buffer)
+	, in_reliable_buffer_(in_reliable_buffer)
 	, in_unreliable_buffer_(in_unreliable_buffer)
 	, out_reliable_buffer_(out_reliable_buffer)
 	, out_unreliable_buffer_(out_unreliable_buffer)
@@ -57,12 +67,14 @@ LoopbackBuffer::Connection::~Connection()
 void LoopbackBuffer::Connection::SendReliablePacket( const void *data, unsigned int data_size )
 {
 	if( disconnected_ ) return;
+	const auto lock= loopback_buffer_.LockQueues();
 	in_reliable_buffer_.PushBytes( data, data_size );
 }
 
 void LoopbackBuffer::Connection::SendUnreliablePacket( const void *data, unsigned int data_size )
 {
 	if( disconnected_ ) return;
+	const auto lock= loopback_buffer_.LockQueues();
 	in_unreliable_buffer_.PushBytes( data, data_size );
 }
 
@@ -70,6 +82,7 @@ unsigned int LoopbackBuffer::Connection::ReadRealiableData( void* out_data, unsi
 {
 	if( disconnected_ ) return 0u;
 
+	const auto lock= loopback_buffer_.LockQueues();
 	unsigned int result_size= std::min( buffer_size, out_reliable_buffer_.Size() );
 	out_reliable_buffer_.PopBytes( out_data, result_size );
 	return result_size;
@@ -79,6 +92,7 @@ unsigned int LoopbackBuffer::Connection::ReadUnrealiableData( void* out_data, un
 {
 	if( disconnected_ ) return 0u;
 
+	const auto lock= loopback_buffer_.LockQueues();
 	unsigned int result_size= std::min( buffer_size, out_unreliable_buffer_.Size() );
 	out_unreliable_buffer_.PopBytes( out_data, result_size );
 	return result_size;
@@ -99,8 +113,38 @@ std::string LoopbackBuffer::Connection::GetConnectionInfo()
 	return "loopback";
 }
 
+const unsigned char* LoopbackBuffer::Connection::PeekReliableData( unsigned int& out_data_size )
+{
+	out_data_size= 0u;
+	if( disconnected_ || loopback_buffer_.thread_safe_ ) return nullptr;
+
+	return out_reliable_buffer_.Peek( out_data_size );
+}
+
+const unsigned char* LoopbackBuffer::Connection::PeekUnreliableData( unsigned int& out_data_size )
+{
+	out_data_size= 0u;
+	if( disconnected_ || loopback_buffer_.thread_safe_ ) return nullptr;
+
+	return out_unreliable_buffer_.Peek( out_data_size );
+}
+
+void LoopbackBuffer::Connection::SkipReliableData( const unsigned int data_size )
+{
+	if( disconnected_ ) return;
+	const auto lock= loopback_buffer_.LockQueues();
+	out_reliable_buffer_.Skip( std::min( data_size, out_reliable_buffer_.Size() ) );
+}
+
+void LoopbackBuffer::Connection::SkipUnreliableData( const unsigned int data_size )
+{
+	if( disconnected_ ) return;
+	const auto lock= loopback_buffer_.LockQueues();
+	out_unreliable_buffer_.Skip( std::min( data_size, out_unreliable_buffer_.Size() ) );
+}
+
 LoopbackBuffer::Queue::Queue()
-	: pos_(0u)
+	: start_(0u), size_(0u)
 {}
 
 LoopbackBuffer::Queue::~Queue()
@@ -108,51 +152,78 @@ LoopbackBuffer::Queue::~Queue()
 
 unsigned int LoopbackBuffer::Queue::Size() const
 {
-	return buffer_.size() - pos_;
+	return size_;
 }
 
 void LoopbackBuffer::Queue::Clear()
 {
-	buffer_.clear();
-	pos_= 0u;
+	start_= 0u;
+	size_= 0u;
 }
 
 void LoopbackBuffer::Queue::PushBytes( const void* data, const unsigned int data_size )
 {
-	buffer_.insert(
-		buffer_.end(),
-		static_cast<const unsigned char*>(data),
-		static_cast<const unsigned char*>(data) + data_size );
+	if( size_ + data_size > buffer_.size() )
+		Grow( size_ + data_size );
+
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	const unsigned int offset= ( start_ + size_ ) & ( buffer_.size() - 1u );
+	const unsigned int first_part_size= std::min( data_size, static_cast<unsigned int>( buffer_.size() ) - offset );
+
+	std::memcpy( buffer_.data() + offset, bytes, first_part_size );
+	std::memcpy( buffer_.data(), bytes + first_part_size, data_size - first_part_size );
+	size_+= data_size;
 }
 
 void LoopbackBuffer::Queue::PopBytes( void* out_data, const unsigned int data_size )
 {
 	PC_ASSERT( data_size <= Size() );
+	if( data_size == 0u )
+		return;
 
-	std::memcpy(
-		out_data,
-		buffer_.data() + pos_,
-		data_size );
+	unsigned char* const bytes= static_cast<unsigned char*>(out_data);
+	const unsigned int first_part_size= std::min( data_size, static_cast<unsigned int>( buffer_.size() ) - start_ );
 
-	pos_+= data_size;
+	std::memcpy( bytes, buffer_.data() + start_, first_part_size );
+	std::memcpy( bytes + first_part_size, buffer_.data(), data_size - first_part_size );
 
-	TryShrink();
+	Skip( data_size );
 }
 
-void LoopbackBuffer::Queue::TryShrink()
+const unsigned char* LoopbackBuffer::Queue::Peek( unsigned int& out_data_size ) const
 {
-	// Some magic constants here.
-	const unsigned int c_min_buffer_size_to_shrink= 64u;
-	const unsigned int c_rate_mult= 16u;
+	out_data_size= std::min( size_, static_cast<unsigned int>( buffer_.size() ) - start_ );
+	return buffer_.data() + start_;
+}
 
-	if( buffer_.size() < c_min_buffer_size_to_shrink )
-		return;
+void LoopbackBuffer::Queue::Skip( const unsigned int data_size )
+{
+	PC_ASSERT( data_size <= Size() );
 
-	if( Size() * c_rate_mult < buffer_.size() )
-	{
-		buffer_.erase( buffer_.begin(), buffer_.begin() + pos_ );
-		pos_= 0u;
-	}
+	size_-= data_size;
+	if( size_ == 0u )
+		start_= 0u; // Start again from beginning, so, next data will be contiguous.
+	else
+		start_= ( start_ + data_size ) & ( buffer_.size() - 1u );
+}
+
+void LoopbackBuffer::Queue::Grow( const unsigned int min_capacity )
+{
+	// Usually, map start sends largest portion of data. Initial size is enough for ordinary frames.
+	const unsigned int c_initial_capacity= 16u * 1024u;
+
+	unsigned int new_capacity= std::max( c_initial_capacity, static_cast<unsigned int>( buffer_.size() ) );
+	while( new_capacity < min_capacity )
+		new_capacity<<= 1u;
+
+	// Move data into beginning of new buffer.
+	std::vector<unsigned char> new_buffer( new_capacity );
+	const unsigned int size= size_;
+	PopBytes( new_buffer.data(), size );
+
+	buffer_.swap( new_buffer );
+	start_= 0u;
+	size_= size;
 }
 
 LoopbackBuffer::LoopbackBuffer()
@@ -170,6 +241,7 @@ void LoopbackBuffer::RequestConnect()
 
 	client_side_connection_=
 		std::make_shared<Connection>(
+			*this,
 			client_to_server_reliable_buffer_,
 			client_to_server_unreliable_buffer_,
 			server_to_client_reliable_buffer_,
@@ -177,6 +249,7 @@ void LoopbackBuffer::RequestConnect()
 
 	server_side_connection_=
 		std::make_shared<Connection>(
+			*this,
 			server_to_client_reliable_buffer_,
 			server_to_client_unreliable_buffer_,
 			client_to_server_reliable_buffer_,
@@ -199,10 +272,13 @@ void LoopbackBuffer::RequestDisconnect()
 		server_side_connection_.reset();
 	}
 
-	client_to_server_reliable_buffer_.Clear();
-	client_to_server_unreliable_buffer_.Clear();
-	server_to_client_reliable_buffer_.Clear();
-	server_to_client_unreliable_buffer_.Clear();
+	{
+		const auto lock= LockQueues();
+		client_to_server_reliable_buffer_.Clear();
+		client_to_server_unreliable_buffer_.Clear();
+		server_to_client_reliable_buffer_.Clear();
+		server_to_client_unreliable_buffer_.Clear();
+	}
 
 	state_ = State::Unconnected;
 }
@@ -212,6 +288,19 @@ IConnectionPtr LoopbackBuffer::GetClientSideConnection()
 	return client_side_connection_;
 }
 
+void LoopbackBuffer::SetThreadSafe( const bool thread_safe )
+{
+	thread_safe_= thread_safe;
+}
+
+std::unique_lock<std::mutex> LoopbackBuffer::LockQueues()
+{
+	std::unique_lock<std::mutex> lock( queues_mutex_, std::defer_lock );
+	if( thread_safe_ )
+		lock.lock();
+	return lock;
+}
+
 IConnectionPtr LoopbackBuffer::GetNewConnection()
 {
 	if( state_ == State::WaitingForConnection )
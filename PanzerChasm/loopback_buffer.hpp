@@ -1,4 +1,5 @@
 #pragma once
+#include <mutex>
 #include <vector>
 
 #include "server/i_connections_listener.hpp"
@@ -17,12 +18,18 @@ public:
 
 	IConnectionPtr GetClientSideConnection();
 
+	// In thread-safe mode client and server sides may be used from different threads.
+	// Zero-copy receiving is not available in this mode.
+	// Change mode only when no connection methods are running.
+	void SetThreadSafe( bool thread_safe );
+
 public: // IConnectionsListener
 	virtual IConnectionPtr GetNewConnection() override;
 
 private:
 	class Connection;
 
+	// Ring buffer of bytes. Grows only if data does not fit, never shrinks, so, in steady state there are no allocations.
 	class Queue final
 	{
 	public:
@@ -30,19 +37,26 @@ private:
 		~Queue();
 
 		unsigned int Size() const;
-		void Clear();
+		void Clear(); // Keeps allocated memory.
 
 		void PushBytes( const void* data, unsigned int data_size );
 		void PopBytes( void* out_data, unsigned int data_size );
 
+		// Returns contiguous part of data from queue start - up to end of ring.
+		const unsigned char* Peek( unsigned int& out_data_size ) const;
+		void Skip( unsigned int data_size );
+
 	private:
-		void TryShrink();
+		void Grow( unsigned int min_capacity );
 
 	private:
-		std::vector<unsigned char> buffer_;
-		unsigned int pos_;
+		std::vector<unsigned char> buffer_; // Size is zero or power of two.
+		unsigned int start_; // Offset of first byte in buffer.
+		unsigned int size_;
 	};
 
+	std::unique_lock<std::mutex> LockQueues();
+
 	enum class State
 	{
 		Unconnected,
@@ -53,6 +67,9 @@ private:
 private:
 	State state_= State::Unconnected;
 
+	bool thread_safe_= false;
+	std::mutex queues_mutex_;
+
 	IConnectionPtr client_side_connection_;
 	IConnectionPtr server_side_connection_;
 
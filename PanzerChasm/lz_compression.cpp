@@ -0,0 +1,197 @@
+#include <cstdint>
+#include <cstring>
+
+#include "assert.hpp"
+
+#include "lz_compression.hpp"
+
+namespace PanzerChasm
+{
+
+// Format of compressed block - sequence of literals and matches.
+// Each sequence starts with token byte - 4 high bits for literals length, 4 low bits for match length minus minimal match.
+// Value 15 means, that length continues in next bytes, while byte is 255.
+// Token is followed by literals, 2 bytes of match offset and rest of match length.
+// Last sequence contains only literals.
+
+static const unsigned int g_min_match= 4u;
+static const unsigned int g_max_offset= 0xFFFFu;
+static const unsigned int g_hash_table_size_log2= 12u;
+
+static uint32_t Read32( const unsigned char* const data )
+{
+	uint32_t result;
+	std::memcpy( &result, data, sizeof(uint32_t) );
+	return result;
+}
+
+static unsigned int Hash( const uint32_t value )
+{
+	return ( value * 2654435761u ) >> ( 32u - g_hash_table_size_log2 );
+}
+
+static bool WriteLength( unsigned int length, unsigned char* const out_data, unsigned int& out_pos, const unsigned int out_buffer_size )
+{
+	while( length >= 255u )
+	{
+		if( out_pos >= out_buffer_size )
+			return false;
+		out_data[ out_pos++ ]= 255u;
+		length-= 255u;
+	}
+
+	if( out_pos >= out_buffer_size )
+		return false;
+	out_data[ out_pos++ ]= static_cast<unsigned char>( length );
+	return true;
+}
+
+static bool ReadLength( const unsigned char* const data, const unsigned int data_size, unsigned int& pos, unsigned int& length )
+{
+	while(true)
+	{
+		if( pos >= data_size )
+			return false;
+
+		const unsigned char byte= data[ pos++ ];
+		length+= byte;
+		if( byte != 255u )
+			return true;
+	}
+}
+
+static bool WriteSequence(
+	const unsigned char* const literals, const unsigned int literals_length,
+	const unsigned int match_offset, const unsigned int match_length, // Zero match length for last sequence.
+	unsigned char* const out_data, unsigned int& out_pos, const unsigned int out_buffer_size )
+{
+	if( out_pos >= out_buffer_size )
+		return false;
+
+	const unsigned int match_length_code= match_length == 0u ? 0u : match_length - g_min_match;
+
+	unsigned char& token= out_data[ out_pos++ ];
+	token= static_cast<unsigned char>(
+		( ( literals_length < 15u ? literals_length : 15u ) << 4u ) |
+		( match_length_code < 15u ? match_length_code : 15u ) );
+
+	if( literals_length >= 15u && !WriteLength( literals_length - 15u, out_data, out_pos, out_buffer_size ) )
+		return false;
+
+	if( out_pos + literals_length > out_buffer_size )
+		return false;
+	std::memcpy( out_data + out_pos, literals, literals_length );
+	out_pos+= literals_length;
+
+	if( match_length == 0u )
+		return true;
+
+	if( out_pos + 2u > out_buffer_size )
+		return false;
+	out_data[ out_pos++ ]= static_cast<unsigned char>( match_offset & 255u );
+	out_data[ out_pos++ ]= static_cast<unsigned char>( match_offset >> 8u );
+
+	if( match_length_code >= 15u && !WriteLength( match_length_code - 15u, out_data, out_pos, out_buffer_size ) )
+		return false;
+
+	return true;
+}
+
+unsigned int LzCompress(
+	const unsigned char* const data, const unsigned int data_size,
+	unsigned char* const out_data, const unsigned int out_buffer_size )
+{
+	PC_ASSERT( data_size <= g_max_offset );
+
+	// Positions of last occurrence of each 4-byte hash.
+	int32_t hash_table[ 1u << g_hash_table_size_log2 ];
+	for( int32_t& position : hash_table )
+		position= -1;
+
+	unsigned int out_pos= 0u;
+	unsigned int literals_start= 0u;
+	unsigned int pos= 0u;
+	while( pos + g_min_match <= data_size )
+	{
+		const uint32_t value= Read32( data + pos );
+		int32_t& table_position= hash_table[ Hash( value ) ];
+		const int32_t candidate= table_position;
+		table_position= static_cast<int32_t>( pos );
+
+		if( candidate < 0 || pos - candidate > g_max_offset || Read32( data + candidate ) != value )
+		{
+			pos++;
+			continue;
+		}
+
+		unsigned int match_length= g_min_match;
+		while( pos + match_length < data_size && data[ candidate + match_length ] == data[ pos + match_length ] )
+			match_length++;
+
+		if( !WriteSequence(
+				data + literals_start, pos - literals_start,
+				pos - candidate, match_length,
+				out_data, out_pos, out_buffer_size ) )
+			return 0u;
+
+		pos+= match_length;
+		literals_start= pos;
+	}
+
+	if( !WriteSequence(
+			data + literals_start, data_size - literals_start,
+			0u, 0u,
+			out_data, out_pos, out_buffer_size ) )
+		return 0u;
+
+	return out_pos;
+}
+
+unsigned int LzDecompress(
+	const unsigned char* const data, const unsigned int data_size,
+	unsigned char* const out_data, const unsigned int out_buffer_size )
+{
+	unsigned int pos= 0u;
+	unsigned int out_pos= 0u;
+	while( pos < data_size )
+	{
+		const unsigned char token= data[ pos++ ];
+
+		unsigned int literals_length= token >> 4u;
+		if( literals_length == 15u && !ReadLength( data, data_size, pos, literals_length ) )
+			return 0u;
+
+		if( pos + literals_length > data_size || out_pos + literals_length > out_buffer_size )
+			return 0u;
+		std::memcpy( out_data + out_pos, data + pos, literals_length );
+		pos+= literals_length;
+		out_pos+= literals_length;
+
+		// Last sequence.
+		if( pos == data_size )
+			break;
+
+		if( pos + 2u > data_size )
+			return 0u;
+		const unsigned int match_offset= data[pos] | ( data[ pos + 1u ] << 8u );
+		pos+= 2u;
+		if( match_offset == 0u || match_offset > out_pos )
+			return 0u;
+
+		unsigned int match_length= token & 15u;
+		if( match_length == 15u && !ReadLength( data, data_size, pos, match_length ) )
+			return 0u;
+		match_length+= g_min_match;
+
+		if( out_pos + match_length > out_buffer_size )
+			return 0u;
+
+		// Match may overlap with itself, so, copy bytes one by one.
+		for( unsigned int i= 0u; i < match_length; i++, out_pos++ )
+			out_data[ out_pos ]= out_data[ out_pos - match_offset ];
+	}
+
+	return out_pos;
+}
+
+} // namespace PanzerChasm
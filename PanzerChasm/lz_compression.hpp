@@ -0,0 +1,19 @@
+#pragma once
+
+namespace PanzerChasm
+{
+
+// Simple and fast LZ77 block compression, similar to LZ4 block format.
+// Block size must be less, than 64 KB.
+
+// Returns compressed size. Returns zero, if compressed data does not fit into output buffer.
+unsigned int LzCompress(
+	const unsigned char* data, unsigned int data_size,
+	unsigned char* out_data, unsigned int out_buffer_size );
+
+// Returns decompressed size. Returns zero, if data is broken or does not fit into output buffer.
+unsigned int LzDecompress(
+	const unsigned char* data, unsigned int data_size,
+	unsigned char* out_data, unsigned int out_buffer_size );
+
+} // namespace PanzerChasm
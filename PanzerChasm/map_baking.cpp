@@ -0,0 +1,487 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "cache_files.hpp"
+#include "log.hpp"
+#include "save_load.hpp"
+
+#include "map_baking.hpp"
+
+namespace PanzerChasm
+{
+
+const char BakedMapHeader::c_expected_id[8]= "PanBMap"; // PanzerChasmBakedMap
+
+namespace
+{
+
+class BakedMapWriter final
+{
+public:
+	explicit BakedMapWriter( std::vector<unsigned char>& out_data )
+		: data_(out_data)
+	{}
+
+	template<class T>
+	void WritePod( const T& t )
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "Expected trivially copyable type" );
+		WriteBytes( &t, sizeof(T) );
+	}
+
+	template<class T>
+	void WritePodVector( const std::vector<T>& v )
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "Expected trivially copyable type" );
+		WriteSize( v.size() );
+		WriteBytes( v.data(), v.size() * sizeof(T) );
+	}
+
+	void WriteString( const std::string& s )
+	{
+		WriteSize( s.size() );
+		WriteBytes( s.data(), s.size() );
+	}
+
+	void WriteSize( const size_t size )
+	{
+		WritePod( static_cast<uint32_t>(size) );
+	}
+
+private:
+	void WriteBytes( const void* const bytes, const size_t size )
+	{
+		const size_t pos= data_.size();
+		data_.resize( pos + size );
+		if( size > 0u )
+			std::memcpy( data_.data() + pos, bytes, size );
+	}
+
+private:
+	std::vector<unsigned char>& data_;
+};
+
+// All reads are checked. After first error reader returns zeros and empty containers.
+class BakedMapReader final
+{
+public:
+	BakedMapReader( const unsigned char* const data, const size_t size )
+		: data_(data), size_(size)
+	{}
+
+	bool IsOk() const
+	{
+		return ok_ && pos_ == size_;
+	}
+
+	template<class T>
+	void ReadPod( T& t )
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "Expected trivially copyable type" );
+		ReadBytes( &t, sizeof(T) );
+	}
+
+	template<class T>
+	void ReadPodVector( std::vector<T>& v )
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "Expected trivially copyable type" );
+		const size_t count= ReadSize( sizeof(T) );
+		v.resize( count );
+		ReadBytes( v.data(), count * sizeof(T) );
+	}
+
+	// Skips vector, written via WritePodVector.
+	template<class T>
+	void SkipPodVector()
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "Expected trivially copyable type" );
+		const size_t count= ReadSize( sizeof(T) );
+		SkipBytes( count * sizeof(T) );
+	}
+
+	void ReadString( std::string& s )
+	{
+		const size_t length= ReadSize( 1u );
+		s.resize( length );
+		ReadBytes( &s[0], length );
+	}
+
+	// Returns zero, if there are no data for "size" elements of given size.
+	size_t ReadSize( const size_t element_size )
+	{
+		uint32_t size= 0u;
+		ReadPod( size );
+		if( element_size > 0u && size > ( size_ - pos_ ) / element_size )
+		{
+			ok_= false;
+			return 0u;
+		}
+		return size;
+	}
+
+private:
+	void ReadBytes( void* const out_bytes, const size_t size )
+	{
+		if( !ok_ || size > size_ - pos_ )
+		{
+			ok_= false;
+			if( size > 0u )
+				std::memset( out_bytes, 0, size );
+			return;
+		}
+
+		if( size > 0u )
+			std::memcpy( out_bytes, data_ + pos_, size );
+		pos_+= size;
+	}
+
+	void SkipBytes( const size_t size )
+	{
+		if( !ok_ || size > size_ - pos_ )
+		{
+			ok_= false;
+			return;
+		}
+		pos_+= size;
+	}
+
+private:
+	const unsigned char* const data_;
+	const size_t size_;
+	size_t pos_= 0u;
+	bool ok_= true;
+};
+
+void WriteSubmodel( BakedMapWriter& writer, const Submodel& submodel )
+{
+	writer.WritePod( submodel.frame_count );
+	writer.WritePodVector( submodel.animations );
+	writer.WritePodVector( submodel.vertices );
+	writer.WritePodVector( submodel.animations_vertices );
+	writer.WritePodVector( submodel.regular_triangles_indeces );
+	writer.WritePodVector( submodel.transparent_triangles_indeces );
+	writer.WritePodVector( submodel.animations_bboxes );
+	writer.WritePodVector( submodel.animations_bounding_spheres );
+	writer.WritePod( submodel.bounding_sphere );
+
+	writer.WriteSize( submodel.sounds.size() );
+	for( const std::vector<unsigned char>& sound : submodel.sounds )
+		writer.WritePodVector( sound );
+
+	writer.WritePod( submodel.z_min );
+	writer.WritePod( submodel.z_max );
+}
+
+void ReadSubmodel( BakedMapReader& reader, Submodel& submodel )
+{
+	reader.ReadPod( submodel.frame_count );
+	reader.ReadPodVector( submodel.animations );
+	reader.ReadPodVector( submodel.vertices );
+	reader.ReadPodVector( submodel.animations_vertices );
+	reader.ReadPodVector( submodel.regular_triangles_indeces );
+	reader.ReadPodVector( submodel.transparent_triangles_indeces );
+	reader.ReadPodVector( submodel.animations_bboxes );
+	reader.ReadPodVector( submodel.animations_bounding_spheres );
+	reader.ReadPod( submodel.bounding_sphere );
+
+	submodel.sounds.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( std::vector<unsigned char>& sound : submodel.sounds )
+		reader.ReadPodVector( sound );
+
+	reader.ReadPod( submodel.z_min );
+	reader.ReadPod( submodel.z_max );
+}
+
+void WriteModel( BakedMapWriter& writer, const Model& model )
+{
+	WriteSubmodel( writer, model );
+
+	writer.WritePod( model.texture_size );
+	writer.WritePodVector( model.texture_data );
+
+	writer.WriteSize( model.submodels.size() );
+	for( const Submodel& submodel : model.submodels )
+		WriteSubmodel( writer, submodel );
+}
+
+void ReadModel( BakedMapReader& reader, Model& model, const bool read_render_data )
+{
+	ReadSubmodel( reader, model );
+
+	reader.ReadPod( model.texture_size );
+	if( read_render_data )
+		reader.ReadPodVector( model.texture_data );
+	else
+		reader.SkipPodVector<unsigned char>();
+
+	model.submodels.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( Submodel& submodel : model.submodels )
+		ReadSubmodel( reader, submodel );
+}
+
+void WriteProcedure( BakedMapWriter& writer, const MapData::Procedure& procedure )
+{
+	writer.WritePod( procedure.start_delay_s );
+	writer.WritePod( procedure.end_delay_s );
+	writer.WritePod( procedure.back_wait_s );
+	writer.WritePod( procedure.speed );
+	writer.WritePod( procedure.check_go );
+	writer.WritePod( procedure.check_back );
+	writer.WritePod( procedure.mortal );
+	writer.WritePod( procedure.light_remap );
+	writer.WritePod( procedure.locked );
+	writer.WritePod( procedure.on_message_number );
+	writer.WritePod( procedure.first_message_number );
+	writer.WritePod( procedure.lock_message_number );
+	writer.WritePod( procedure.sfx_id );
+	writer.WritePodVector( procedure.linked_switches );
+	writer.WritePodVector( procedure.sfx_pos );
+	writer.WritePod( procedure.red_key_required );
+	writer.WritePod( procedure.green_key_required );
+	writer.WritePod( procedure.blue_key_required );
+	writer.WritePodVector( procedure.action_commands );
+}
+
+void ReadProcedure( BakedMapReader& reader, MapData::Procedure& procedure )
+{
+	reader.ReadPod( procedure.start_delay_s );
+	reader.ReadPod( procedure.end_delay_s );
+	reader.ReadPod( procedure.back_wait_s );
+	reader.ReadPod( procedure.speed );
+	reader.ReadPod( procedure.check_go );
+	reader.ReadPod( procedure.check_back );
+	reader.ReadPod( procedure.mortal );
+	reader.ReadPod( procedure.light_remap );
+	reader.ReadPod( procedure.locked );
+	reader.ReadPod( procedure.on_message_number );
+	reader.ReadPod( procedure.first_message_number );
+	reader.ReadPod( procedure.lock_message_number );
+	reader.ReadPod( procedure.sfx_id );
+	reader.ReadPodVector( procedure.linked_switches );
+	reader.ReadPodVector( procedure.sfx_pos );
+	reader.ReadPod( procedure.red_key_required );
+	reader.ReadPod( procedure.green_key_required );
+	reader.ReadPod( procedure.blue_key_required );
+	reader.ReadPodVector( procedure.action_commands );
+}
+
+void WriteMessage( BakedMapWriter& writer, const MapData::Message& message )
+{
+	writer.WritePod( message.delay_s );
+	writer.WriteSize( message.texts.size() );
+	for( const MapData::Message::Text& text : message.texts )
+	{
+		writer.WritePod( text.x );
+		writer.WritePod( text.y );
+		writer.WriteString( text.data );
+	}
+}
+
+void ReadMessage( BakedMapReader& reader, MapData::Message& message )
+{
+	reader.ReadPod( message.delay_s );
+	message.texts.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( MapData::Message::Text& text : message.texts )
+	{
+		reader.ReadPod( text.x );
+		reader.ReadPod( text.y );
+		reader.ReadString( text.data );
+	}
+}
+
+void WriteMapData( BakedMapWriter& writer, const MapData& map_data )
+{
+	writer.WritePod( map_data.number );
+	writer.WritePod( map_data.map_name );
+	writer.WritePod( map_data.sky_texture_name );
+	writer.WritePod( map_data.map_sounds );
+	writer.WritePod( map_data.ambients );
+	writer.WritePod( map_data.map_index );
+	writer.WritePod( map_data.walls_textures );
+	writer.WritePod( map_data.floor_textures );
+	writer.WritePod( map_data.ceiling_textures );
+	writer.WritePod( map_data.ambient_sounds_map );
+
+	writer.WritePodVector( map_data.ambient_lightmap );
+	writer.WritePodVector( map_data.lightmap );
+	writer.WritePodVector( map_data.floor_textures_data );
+
+	writer.WritePodVector( map_data.static_walls );
+	writer.WritePodVector( map_data.dynamic_walls );
+	writer.WritePodVector( map_data.static_models );
+	writer.WritePodVector( map_data.items );
+	writer.WritePodVector( map_data.monsters );
+	writer.WritePodVector( map_data.lights );
+	writer.WritePodVector( map_data.models_description );
+	writer.WritePodVector( map_data.stopani_commands );
+	writer.WritePodVector( map_data.links );
+	writer.WritePodVector( map_data.teleports );
+
+	writer.WriteSize( map_data.models.size() );
+	for( const Model& model : map_data.models )
+		WriteModel( writer, model );
+
+	writer.WriteSize( map_data.messages.size() );
+	for( const MapData::Message& message : map_data.messages )
+		WriteMessage( writer, message );
+
+	writer.WriteSize( map_data.procedures.size() );
+	for( const MapData::Procedure& procedure : map_data.procedures )
+		WriteProcedure( writer, procedure );
+}
+
+void ReadMapData( BakedMapReader& reader, MapData& map_data, const bool read_render_data )
+{
+	reader.ReadPod( map_data.number );
+	reader.ReadPod( map_data.map_name );
+	reader.ReadPod( map_data.sky_texture_name );
+	reader.ReadPod( map_data.map_sounds );
+	reader.ReadPod( map_data.ambients );
+	reader.ReadPod( map_data.map_index );
+	reader.ReadPod( map_data.walls_textures );
+	reader.ReadPod( map_data.floor_textures );
+	reader.ReadPod( map_data.ceiling_textures );
+	reader.ReadPod( map_data.ambient_sounds_map );
+
+	if( read_render_data )
+	{
+		reader.ReadPodVector( map_data.ambient_lightmap );
+		reader.ReadPodVector( map_data.lightmap );
+		reader.ReadPodVector( map_data.floor_textures_data );
+	}
+	else
+	{
+		reader.SkipPodVector<unsigned char>();
+		reader.SkipPodVector<unsigned char>();
+		reader.SkipPodVector< MapData::FloorTextureData >();
+	}
+
+	reader.ReadPodVector( map_data.static_walls );
+	reader.ReadPodVector( map_data.dynamic_walls );
+	reader.ReadPodVector( map_data.static_models );
+	reader.ReadPodVector( map_data.items );
+	reader.ReadPodVector( map_data.monsters );
+	reader.ReadPodVector( map_data.lights );
+	reader.ReadPodVector( map_data.models_description );
+	reader.ReadPodVector( map_data.stopani_commands );
+	reader.ReadPodVector( map_data.links );
+	reader.ReadPodVector( map_data.teleports );
+
+	map_data.models.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( Model& model : map_data.models )
+		ReadModel( reader, model, read_render_data );
+
+	map_data.messages.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( MapData::Message& message : map_data.messages )
+		ReadMessage( reader, message );
+
+	map_data.procedures.resize( reader.ReadSize( sizeof(uint32_t) ) );
+	for( MapData::Procedure& procedure : map_data.procedures )
+		ReadProcedure( reader, procedure );
+}
+
+// Check indices, even if hash is correct. Broken file must not crash us.
+bool MapIndexIsValid( const MapData& map_data )
+{
+	for( const MapData::IndexElement& el : map_data.map_index )
+	{
+		size_t container_size;
+		switch( el.type )
+		{
+		case MapData::IndexElement::None: continue;
+		case MapData::IndexElement::StaticWall: container_size= map_data.static_walls.size(); break;
+		case MapData::IndexElement::DynamicWall: container_size= map_data.dynamic_walls.size(); break;
+		case MapData::IndexElement::StaticModel: container_size= map_data.static_models.size(); break;
+		case MapData::IndexElement::Item: container_size= map_data.items.size(); break;
+		default: return false;
+		}
+
+		if( el.index >= container_size )
+			return false;
+	}
+
+	return map_data.models.size() <= map_data.models_description.size();
+}
+
+// Drawers index render data without checks.
+bool RenderDataIsValid( const MapData& map_data )
+{
+	return
+		map_data.ambient_lightmap.size() == MapData::c_map_size * MapData::c_map_size &&
+		map_data.lightmap.size() == MapData::c_lightmap_size * MapData::c_lightmap_size &&
+		map_data.floor_textures_data.size() == MapData::c_floors_textures_count;
+}
+
+void GetBakedMapFileName( const unsigned int map_number, const unsigned int source_hash, char* const out_file_name, const size_t size )
+{
+	std::snprintf( out_file_name, size, CACHE_FILES_DIR"/map_%02u_%08x.pcm", map_number, source_hash );
+}
+
+} // namespace
+
+bool SaveBakedMap( const MapData& map_data, const unsigned int source_hash )
+{
+	char file_name[64];
+	GetBakedMapFileName( map_data.number, source_hash, file_name, sizeof(file_name) );
+
+	std::vector<unsigned char> content;
+	BakedMapWriter writer( content );
+	WriteMapData( writer, map_data );
+
+	BakedMapHeader header;
+	std::memcpy( header.id, BakedMapHeader::c_expected_id, sizeof(header.id) );
+	header.version= BakedMapHeader::c_expected_version;
+	header.source_hash= source_hash;
+	header.content_size= content.size();
+	header.content_hash= SaveHeader::CalculateHash( content.data(), content.size() );
+
+	return
+		WriteCacheFile(
+			file_name,
+			{
+				{ &header, sizeof(BakedMapHeader) },
+				{ content.data(), content.size() },
+			} );
+}
+
+MapDataPtr LoadBakedMap( const unsigned int map_number, const unsigned int source_hash, const LoadProfile load_profile )
+{
+	char file_name[64];
+	GetBakedMapFileName( map_number, source_hash, file_name, sizeof(file_name) );
+
+	BakedMapHeader header;
+	std::vector<unsigned char> content;
+	if( !ReadCacheFile( file_name, &header, sizeof(BakedMapHeader), content ) )
+		return nullptr;
+
+	if( std::memcmp( header.id, BakedMapHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != BakedMapHeader::c_expected_version ||
+		header.source_hash != source_hash ||
+		header.content_size != content.size() )
+		return nullptr;
+
+	if( SaveHeader::CalculateHash( content.data(), content.size() ) != header.content_hash )
+	{
+		Log::Warning( "Baked map \"", file_name, "\" is broken" );
+		return nullptr;
+	}
+
+	const bool read_render_data= load_profile == LoadProfile::Full;
+
+	const MapDataPtr result= std::make_shared<MapData>();
+	BakedMapReader reader( content.data(), content.size() );
+	ReadMapData( reader, *result, read_render_data );
+
+	if( !reader.IsOk() || result->number != map_number || !MapIndexIsValid( *result ) ||
+		( read_render_data && !RenderDataIsValid( *result ) ) )
+	{
+		Log::Warning( "Baked map \"", file_name, "\" is broken" );
+		return nullptr;
+	}
+
+	return result;
+}
+
+} // namespace PanzerChasm
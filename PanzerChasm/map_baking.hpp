@@ -0,0 +1,32 @@
+#pragma once
+#include "map_loader.hpp"
+
+namespace PanzerChasm
+{
+
+// Baked map - binary file with final layout of MapData, including models.
+// Loading of baked map is just copying of data blocks, without parsing of original files.
+// Baked map is valid only for exact original files, which hash is stored in file.
+
+struct BakedMapHeader
+{
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 3u; // Change each time, when format or MapData changed.
+
+	char id[8];
+	unsigned int version;
+	unsigned int source_hash; // Hash of original map files, models and animations.
+	unsigned int content_size;
+	unsigned int content_hash;
+};
+
+SIZE_ASSERT( BakedMapHeader, 24u );
+
+// Baked maps are stored in "cache" directory. Returns true, if all ok.
+bool SaveBakedMap( const MapData& map_data, unsigned int source_hash );
+
+// Returns null, if file does not exist, is broken, or is baked from other original files.
+// Render-only data is skipped for server-only profile.
+MapDataPtr LoadBakedMap( unsigned int map_number, unsigned int source_hash, LoadProfile load_profile );
+
+} // namespace PanzerChasm
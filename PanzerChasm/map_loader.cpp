@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cstring>
+#include <thread>
 
 #include "assert.hpp"
 #include "log.hpp"
+#include "map_baking.hpp"
 #include "math_utils.hpp"
+#include "profiler.hpp"
+#include "save_load.hpp"
 
 #include "map_loader.hpp"
 
@@ -15,6 +21,8 @@ namespace
 
 const unsigned int g_max_map_number= 30u;
 
+const unsigned int g_max_models_loading_threads= 8u;
+
 constexpr unsigned int g_bytes_per_floor_in_file= 86u * MapData::c_floor_texture_size;
 constexpr unsigned int g_floors_file_header_size= 64u;
 
@@ -60,100 +68,84 @@ SIZE_ASSERT( MapMonster, 8 );
 namespace
 {
 
-// Case-unsensitive strings equality-comparision
-static bool StringEquals( const char* const s0, const char* const s1 )
+static TextSpan GetFileText( const Vfs::FileView& file )
 {
-	unsigned int i= 0;
-	while( s0[i] != '\0' && s1[i] != '\0' )
-	{
-		if( std::tolower( s0[i] ) != std::tolower( s1[i] ) )
-			return false;
-		i++;
-	}
-
-	return std::tolower( s0[i] ) == std::tolower( s1[i] );
+	const char* const start= reinterpret_cast<const char*>( file.data() );
+	return TextSpan( start, start + file.size() );
 }
 
-// Case-unsensitive substring search
-static const char* GetSubstring( const char* const search_where, const char* const search_what )
+// Returns whole lines of text before "end_marker". Partial line before marker is dropped.
+static TextSpan GetLinesBefore( const TextSpan& text, const char* const end_marker )
 {
-	const char* str= search_where;
-	while( *str != '\0' )
-	{
-		unsigned int i= 0u;
+	const char* end= text.FindIgnoreCase( end_marker );
+	if( end == nullptr )
+		end= text.end;
 
-		while( str[i] != '\0' && search_what[i] != '\0' &&
-				std::tolower( str[i] ) == std::tolower( search_what [i] ) )
-			i++;
+	while( end > text.begin && end[-1] != '\n' )
+		end--;
 
-		if( search_what [i] == '\0' )
-			return str;
-
-		str++;
-	}
-
-	return nullptr;
+	return TextSpan( text.begin, end );
 }
 
-static decltype(MapData::Link::type) LinkTypeFromString( const char* const str )
+static decltype(MapData::Link::type) LinkTypeFromString( const TextSpan& str )
 {
-	if( StringEquals( str, "link" ) )
+	if( str.EqualsIgnoreCase( "link" ) )
 		return MapData::Link::Link_;
-	if( StringEquals( str, "floor" ) )
+	if( str.EqualsIgnoreCase( "floor" ) )
 		return MapData::Link::Floor;
-	if( StringEquals( str, "shoot" ) )
+	if( str.EqualsIgnoreCase( "shoot" ) )
 		return MapData::Link::Shoot;
-	if( StringEquals( str, "return" ) )
+	if( str.EqualsIgnoreCase( "return" ) )
 		return MapData::Link::Return;
-	if( StringEquals( str, "returnf" ) )
+	if( str.EqualsIgnoreCase( "returnf" ) )
 		return MapData::Link::ReturnFloor;
-	if(StringEquals( str, "destroy" ) )
+	if( str.EqualsIgnoreCase( "destroy" ) )
 		return MapData::Link::Destroy;
 
 	return MapData::Link::None;
 }
 
-MapData::Procedure::ActionCommandId ActionCommandFormString( const char* const str )
+MapData::Procedure::ActionCommandId ActionCommandFormString( const TextSpan& str )
 {
 	using Command= MapData::Procedure::ActionCommandId;
 
-	if( StringEquals( str, "lock" ) )
+	if( str.EqualsIgnoreCase( "lock" ) )
 		return Command::Lock;
-	if( StringEquals( str, "unlock" ) )
+	if( str.EqualsIgnoreCase( "unlock" ) )
 		return Command::Unlock;
-	if( StringEquals( str, "playani" ) )
+	if( str.EqualsIgnoreCase( "playani" ) )
 		return Command::PlayAnimation;
-	if( StringEquals( str, "stopani" ) )
+	if( str.EqualsIgnoreCase( "stopani" ) )
 		return Command::StopAnimation;
-	if( StringEquals( str, "move" ) )
+	if( str.EqualsIgnoreCase( "move" ) )
 		return Command::Move;
-	if( StringEquals( str, "xmove" ) )
+	if( str.EqualsIgnoreCase( "xmove" ) )
 		return Command::XMove;
-	if( StringEquals( str, "ymove" ) )
+	if( str.EqualsIgnoreCase( "ymove" ) )
 		return Command::YMove;
-	if( StringEquals( str, "rotate" ) )
+	if( str.EqualsIgnoreCase( "rotate" ) )
 		return Command::Rotate;
-	if( StringEquals( str, "up" ) )
+	if( str.EqualsIgnoreCase( "up" ) )
 		return Command::Up;
-	if( StringEquals( str, "light" ) )
+	if( str.EqualsIgnoreCase( "light" ) )
 		return Command::Light;
-	if( StringEquals( str, "change" ) )
+	if( str.EqualsIgnoreCase( "change" ) )
 		return Command::Change;
-	if( StringEquals( str, "death" ) )
+	if( str.EqualsIgnoreCase( "death" ) )
 		return Command::Death;
-	if( StringEquals( str, "explode" ) )
+	if( str.EqualsIgnoreCase( "explode" ) )
 		return Command::Explode;
-	if( StringEquals( str, "quake" ) )
+	if( str.EqualsIgnoreCase( "quake" ) )
 		return Command::Quake;
-	if( StringEquals( str, "ambient" ) )
+	if( str.EqualsIgnoreCase( "ambient" ) )
 		return Command::Ambient;
-	if( StringEquals( str, "wind" ) )
+	if( str.EqualsIgnoreCase( "wind" ) )
 		return Command::Wind;
-	if( StringEquals( str, "source" ) )
+	if( str.EqualsIgnoreCase( "source" ) )
 		return Command::Source;
-	if( StringEquals( str, "waitout" ) )
+	if( str.EqualsIgnoreCase( "waitout" ) )
 		return Command::Waitout;
-	if( StringEquals( str, "nonstop" ) )
+	if( str.EqualsIgnoreCase( "nonstop" ) )
 		return Command::Nonstop;
 
 	return Command::Unknown;
@@ -166,23 +158,148 @@ static unsigned char ConvertMapLight( const unsigned char map_light )
 
 } // namespace
 
-MapLoader::MapLoader( const VfsPtr& vfs )
+template<class T>
+static size_t GetVectorMemorySize( const std::vector<T>& v )
+{
+	return v.capacity() * sizeof(T);
+}
+
+static size_t GetModelMemorySize( const Model& model )
+{
+	size_t result= sizeof(Model);
+	result+= GetVectorMemorySize( model.texture_data );
+	result+= GetVectorMemorySize( model.animations );
+	result+= GetVectorMemorySize( model.vertices );
+	result+= GetVectorMemorySize( model.animations_vertices );
+	result+= GetVectorMemorySize( model.regular_triangles_indeces );
+	result+= GetVectorMemorySize( model.transparent_triangles_indeces );
+	result+= GetVectorMemorySize( model.animations_bboxes );
+	result+= GetVectorMemorySize( model.animations_bounding_spheres );
+	for( const std::vector<unsigned char>& sound : model.sounds )
+		result+= GetVectorMemorySize( sound );
+	return result;
+}
+
+// Approximate - only big containers are counted.
+static size_t GetMapDataMemorySize( const MapData& map_data )
+{
+	size_t result= sizeof(MapData);
+	result+= GetVectorMemorySize( map_data.static_walls );
+	result+= GetVectorMemorySize( map_data.dynamic_walls );
+	result+= GetVectorMemorySize( map_data.static_models );
+	result+= GetVectorMemorySize( map_data.items );
+	result+= GetVectorMemorySize( map_data.monsters );
+	result+= GetVectorMemorySize( map_data.lights );
+	result+= GetVectorMemorySize( map_data.models_description );
+	result+= GetVectorMemorySize( map_data.messages );
+	result+= GetVectorMemorySize( map_data.procedures );
+	result+= GetVectorMemorySize( map_data.links );
+	result+= GetVectorMemorySize( map_data.teleports );
+	result+= GetVectorMemorySize( map_data.ambient_lightmap );
+	result+= GetVectorMemorySize( map_data.lightmap );
+	result+= GetVectorMemorySize( map_data.floor_textures_data );
+	for( const Model& model : map_data.models )
+		result+= GetModelMemorySize( model );
+	return result;
+}
+
+// Hash of models and animations files is calculated separately, because their names are known only after resource file parsing.
+static unsigned int CalculateMapSourceHash(
+	const Vfs::FileView& map_file,
+	const Vfs::FileView& resource_file,
+	const Vfs::FileView& floors_file,
+	const Vfs::FileView& process_file )
+{
+	unsigned int result= 0u;
+	for( const Vfs::FileView* const file : { &map_file, &resource_file, &floors_file, &process_file } )
+		result= result * 31u + SaveHeader::CalculateHash( file->data(), file->size() );
+	return result;
+}
+
+MapLoader::MapLoader( const VfsPtr& vfs, const size_t cache_memory_budget, const LoadProfile load_profile )
 	: vfs_(vfs)
+	, load_profile_(load_profile)
+	, cache_memory_budget_(cache_memory_budget)
 {}
 
 MapLoader::~MapLoader()
-{}
+{
+	std::unique_lock<std::mutex> lock( prefetch_mutex_ );
+	if( prefetch_future_.valid() )
+		prefetch_future_.wait();
+}
 
 MapDataConstPtr MapLoader::LoadMap( const unsigned int map_number )
 {
+	return LoadMapImpl( map_number, false );
+}
+
+void MapLoader::PrefetchMap( const unsigned int map_number )
+{
+	std::unique_lock<std::mutex> lock( prefetch_mutex_ );
+
+	if( prefetch_future_.valid() &&
+		prefetch_future_.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+		return;
+
+	Log::Info( "Prefetching map ", map_number );
+	prefetch_future_=
+		std::async(
+			std::launch::async,
+			[this, map_number]
+			{
+				LoadMapImpl( map_number, true );
+			} );
+}
+
+MapDataConstPtr MapLoader::LoadMapImpl( const unsigned int map_number, const bool is_prefetch )
+{
+	PC_PROFILE_SCOPE( "MapLoader::LoadMap" );
+
 	if( map_number >= 100 )
 		return nullptr;
 
-	if( last_loaded_map_ != nullptr && last_loaded_map_->number == map_number )
-		return last_loaded_map_;
+	std::unique_lock<std::mutex> lock( mutex_ );
+
+	if( prefetched_map_ != nullptr && prefetched_map_->number == map_number )
+	{
+		if( is_prefetch )
+			return prefetched_map_;
+
+		// Prefetched map is used now, move it into cache of recently used maps.
+		MapDataConstPtr result= std::move( prefetched_map_ );
+		prefetched_map_= nullptr;
+		AddMapToCache( result );
+		return result;
+	}
+
+	for( auto it= cached_maps_.begin(); it != cached_maps_.end(); ++it )
+	{
+		if( it->map_data->number == map_number )
+		{
+			// Mark as most recently used.
+			cached_maps_.splice( cached_maps_.begin(), cached_maps_, it );
+			return cached_maps_.front().map_data;
+		}
+	}
+
+	const auto loaded_map_it= loaded_maps_.find( map_number );
+	if( loaded_map_it != loaded_maps_.end() )
+	{
+		if( const MapDataConstPtr loaded_map= loaded_map_it->second.lock() )
+		{
+			if( is_prefetch )
+				prefetched_map_= loaded_map;
+			else
+				AddMapToCache( loaded_map );
+			return loaded_map;
+		}
+	}
 
 	Log::Info( "Loading map ", map_number );
 
+	PC_PROFILE_LOAD_STEP( "MapLoader::LoadMapData" );
+
 	char level_path[ MapData::c_max_file_path_size ];
 	char map_file_name[ MapData::c_max_file_path_size ];
 	char resource_file_name[ MapData::c_max_file_path_size ];
@@ -195,10 +312,14 @@ MapDataConstPtr MapLoader::LoadMap( const unsigned int map_number )
 	std::snprintf( floors_file_name, sizeof(floors_file_name), "%sFLOORS.%02u", level_path, map_number );
 	std::snprintf( process_file_name, sizeof(process_file_name), "%sPROCESS.%02u", level_path, map_number );
 
-	const Vfs::FileContent map_file_content= vfs_->ReadFile( map_file_name );
-	const Vfs::FileContent resource_file_content= vfs_->ReadFile( resource_file_name );
-	const Vfs::FileContent floors_file_content= vfs_->ReadFile( floors_file_name );
-	const Vfs::FileContent process_file_content= vfs_->ReadFile( process_file_name );
+	Vfs::MappedFile map_file_content, resource_file_content, floors_file_content, process_file_content;
+	{
+		PC_PROFILE_LOAD_STEP( "map files" );
+		map_file_content= vfs_->MapFile( map_file_name );
+		resource_file_content= vfs_->MapFile( resource_file_name );
+		floors_file_content= vfs_->MapFile( floors_file_name );
+		process_file_content= vfs_->MapFile( process_file_name );
+	}
 
 	if( map_file_content.empty() ||
 		resource_file_content.empty() ||
@@ -215,44 +336,143 @@ MapDataConstPtr MapLoader::LoadMap( const unsigned int map_number )
 
 	MapDataPtr result= std::make_shared<MapData>();
 
-	LoadLevelScripts( process_file_content, *result );
+	// Models description is needed for baked map key, so, parse it before everything else.
+	LoadModelsDescription( resource_file_content, *result );
 
-	DynamicWallsMask dynamic_walls_mask;
-	MarkDynamicWalls( *result, dynamic_walls_mask );
+	// Use baked map, if it is baked from exactly same files.
+	// Models and animations are part of key too - addon may replace their content without changing of map files.
+	unsigned int source_hash;
+	MapDataPtr baked_map;
+	{
+		PC_PROFILE_LOAD_STEP( "baked map" );
+		source_hash= CalculateMapSourceHash( map_file_content, resource_file_content, floors_file_content, process_file_content );
+		source_hash= source_hash * 31u + CalculateModelsSourceHash( *result );
+		baked_map= LoadBakedMap( map_number, source_hash, load_profile_ );
+	}
+	if( baked_map != nullptr )
+	{
+		loaded_maps_[ map_number ]= baked_map;
+		if( is_prefetch )
+			prefetched_map_= baked_map;
+		else
+			AddMapToCache( baked_map );
+		return baked_map;
+	}
 
-	for( MapData::IndexElement & el : result->map_index )
-		el.type= MapData::IndexElement::None;
+	const bool load_render_data= load_profile_ == LoadProfile::Full;
 
-	// Scan map file
-	LoadLightmap( map_file_content, *result );
-	const unsigned char* const walls_lightmaps_data= GetWallsLightmapData( map_file_content );
-	LoadWalls( map_file_content, *result, dynamic_walls_mask, walls_lightmaps_data );
-	LoadFloorsAndCeilings( map_file_content,*result );
-	LoadAmbientLight( map_file_content,*result );
-	LoadAmbientSoundsMap( map_file_content,*result );
-	LoadMonstersAndLights( map_file_content, *result );
+	// Most stages read only raw files and write separate parts of map data, so, run them in parallel.
+	// Load steps are logged per thread, so, use profiler zones inside tasks.
+	std::future<void> map_file_future=
+		std::async(
+			std::launch::async,
+			[&]
+			{
+				PC_PROFILE_SCOPE( "map file" );
+				if( load_render_data )
+				{
+					LoadLightmap( map_file_content, *result );
+					LoadAmbientLight( map_file_content,*result );
+				}
+				LoadFloorsAndCeilings( map_file_content,*result );
+				LoadAmbientSoundsMap( map_file_content,*result );
+				LoadMonstersAndLights( map_file_content, *result );
+			} );
+
+	std::future<void> resource_file_future=
+		std::async(
+			std::launch::async,
+			[&]
+			{
+				PC_PROFILE_SCOPE( "resource file and models" );
+				LoadMapName( resource_file_content, result->map_name );
+				LoadSkyTextureName( resource_file_content, *result );
+				LoadWallsTexturesDescription( resource_file_content, *result );
+				LoadSoundsDescriptionFromMapResourcesFile( resource_file_content, result->map_sounds, MapData::c_max_map_sounds );
+				LoadAmbientSoundsDescriptionFromMapResourcesFile( resource_file_content, result->ambients, MapData::c_max_map_ambients );
+				LoadModels( *result );
+			} );
+
+	std::future<void> floors_file_future;
+	if( load_render_data )
+		floors_file_future=
+			std::async(
+				std::launch::async,
+				[&]
+				{
+					PC_PROFILE_SCOPE( "floors textures" );
+					LoadFloorsTexturesData( floors_file_content, *result );
+				} );
 
-	// Scan resource file
-	LoadMapName( resource_file_content, result->map_name );
-	LoadSkyTextureName( resource_file_content, *result );
-	LoadModelsDescription( resource_file_content, *result );
-	LoadWallsTexturesDescription( resource_file_content, *result );
-	LoadSoundsDescriptionFromMapResourcesFile( resource_file_content, result->map_sounds, MapData::c_max_map_sounds );
-	LoadAmbientSoundsDescriptionFromMapResourcesFile( resource_file_content, result->ambients, MapData::c_max_map_ambients );
+	// Walls need dynamic walls mask from level scripts, so, load them after scripts in this thread.
+	// Walls also fill map index and static models and items lists, which are not touched by other tasks.
+	{
+		PC_PROFILE_LOAD_STEP( "level scripts and walls" );
 
-	// Scan floors file
-	LoadFloorsTexturesData( floors_file_content, *result );
+		DynamicWallsMask dynamic_walls_mask;
+		LoadLevelScripts( process_file_content, *result );
+		MarkDynamicWalls( *result, dynamic_walls_mask );
 
-	LoadModels( *result );
+		for( MapData::IndexElement & el : result->map_index )
+			el.type= MapData::IndexElement::None;
+
+		const unsigned char* const walls_lightmaps_data= GetWallsLightmapData( map_file_content );
+		LoadWalls( map_file_content, *result, dynamic_walls_mask, walls_lightmaps_data );
+	}
+
+	{
+		PC_PROFILE_LOAD_STEP( "wait for loading tasks" );
+		map_file_future.get();
+		resource_file_future.get();
+		if( floors_file_future.valid() )
+			floors_file_future.get();
+	}
 
-	// Cache result and return it.
 	result->number= map_number;
-	last_loaded_map_= result;
+
+	// Baked map must contain all data, so, do not bake maps without render data.
+	if( load_render_data )
+	{
+		PC_PROFILE_LOAD_STEP( "save baked map" );
+		if( SaveBakedMap( *result, source_hash ) )
+			Log::Info( "Map ", map_number, " baked" );
+	}
+
+	// Cache result and return it.
+	loaded_maps_[ map_number ]= result;
+	if( is_prefetch )
+		prefetched_map_= result; // Do not touch cache - prefetched map is not used yet.
+	else
+		AddMapToCache( result );
 	return result;
 }
 
+void MapLoader::AddMapToCache( const MapDataConstPtr& map_data )
+{
+	CachedMap cached_map;
+	cached_map.map_data= map_data;
+	cached_map.memory_size= GetMapDataMemorySize( *map_data );
+
+	cached_maps_.push_front( std::move(cached_map) );
+	cached_maps_memory_size_+= cached_maps_.front().memory_size;
+
+	// Remove least recently used maps, but keep last used map.
+	while( cached_maps_memory_size_ > cache_memory_budget_ && cached_maps_.size() > 1u )
+	{
+		cached_maps_memory_size_-= cached_maps_.back().memory_size;
+		cached_maps_.pop_back();
+	}
+}
+
+void MapLoader::BakeMaps()
+{
+	for( const MapInfo& map_info : GetAllMapsInfo() )
+		LoadMap( map_info.number );
+}
+
 MapLoader::MapInfo MapLoader::GetNextMapInfo( unsigned int map_number )
 {
+	// Map info reading does not touch loader state, so, lock is not needed. Do not wait here for map prefetching.
 	MapInfo result;
 
 	// TODO - check if there are no maps?
@@ -284,12 +504,26 @@ MapLoader::MapInfo MapLoader::GetPrevMapInfo( unsigned int map_number )
 	return result;
 }
 
-void MapLoader::LoadLightmap( const Vfs::FileContent& map_file, MapData& map_data )
+std::vector<MapLoader::MapInfo> MapLoader::GetAllMapsInfo()
+{
+	std::vector<MapInfo> result;
+	for( unsigned int map_number= 1u; map_number <= g_max_map_number; map_number++ )
+	{
+		MapInfo map_info;
+		if( GetMapInfoImpl( map_number, map_info ) )
+			result.push_back( std::move( map_info ) );
+	}
+	return result;
+}
+
+void MapLoader::LoadLightmap( const Vfs::FileView& map_file, MapData& map_data )
 {
 	const unsigned int c_lightmap_data_offset= 0x01u;
 
 	const unsigned char* const in_data= map_file.data() + c_lightmap_data_offset;
 
+	map_data.lightmap.assign( MapData::c_lightmap_size * MapData::c_lightmap_size, 0u );
+
 	// TODO - tune formula
 	for( unsigned int y= 0u; y < MapData::c_lightmap_size; y++ )
 	for( unsigned int x= 0u; x < MapData::c_lightmap_size - 1u; x++ )
@@ -299,14 +533,14 @@ void MapLoader::LoadLightmap( const Vfs::FileContent& map_file, MapData& map_dat
 	}
 }
 
-const unsigned char* MapLoader::GetWallsLightmapData( const Vfs::FileContent& map_file )
+const unsigned char* MapLoader::GetWallsLightmapData( const Vfs::FileView& map_file )
 {
 	const unsigned int c_walls_lightmap_data_offset= 0x01u + MapData::c_lightmap_size * MapData::c_lightmap_size;
 	return map_file.data() + c_walls_lightmap_data_offset;
 }
 
 void MapLoader::LoadWalls(
-	const Vfs::FileContent& map_file,
+	const Vfs::FileView& map_file,
 	MapData& map_data,
 	const DynamicWallsMask& dynamic_walls_mask,
 	const unsigned char* walls_lightmap_data )
@@ -402,7 +636,7 @@ void MapLoader::LoadWalls(
 	} // for xy
 }
 
-void MapLoader::LoadFloorsAndCeilings( const Vfs::FileContent& map_file, MapData& map_data )
+void MapLoader::LoadFloorsAndCeilings( const Vfs::FileView& map_file, MapData& map_data )
 {
 	const unsigned int c_offset= 0x23001u;
 
@@ -425,11 +659,12 @@ void MapLoader::LoadFloorsAndCeilings( const Vfs::FileContent& map_file, MapData
 	}
 }
 
-void MapLoader::LoadAmbientLight( const Vfs::FileContent& map_file, MapData& map_data )
+void MapLoader::LoadAmbientLight( const Vfs::FileView& map_file, MapData& map_data )
 {
 	const unsigned int c_ambient_lightmap_offset= 0x23001u + MapData::c_map_size * MapData::c_map_size * 2u;
 
 	const unsigned char* in_ambient_lightmap_data= map_file.data() + c_ambient_lightmap_offset;
+	map_data.ambient_lightmap.resize( MapData::c_map_size * MapData::c_map_size );
 	for( unsigned int x= 0u; x < MapData::c_map_size; x++ )
 	for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
 	{
@@ -439,7 +674,7 @@ void MapLoader::LoadAmbientLight( const Vfs::FileContent& map_file, MapData& map
 	}
 }
 
-void MapLoader::LoadAmbientSoundsMap( const Vfs::FileContent& map_file, MapData& map_data )
+void MapLoader::LoadAmbientSoundsMap( const Vfs::FileView& map_file, MapData& map_data )
 {
 	const unsigned int c_offset= 0x23001u + MapData::c_map_size * MapData::c_map_size * 3u;
 
@@ -449,7 +684,7 @@ void MapLoader::LoadAmbientSoundsMap( const Vfs::FileContent& map_file, MapData&
 		map_data.ambient_sounds_map[ x + y * MapData::c_map_size ]= in_data[ x * MapData::c_map_size + y ];
 }
 
-void MapLoader::LoadMonstersAndLights( const Vfs::FileContent& map_file, MapData& map_data )
+void MapLoader::LoadMonstersAndLights( const Vfs::FileView& map_file, MapData& map_data )
 {
 	const unsigned int c_lights_count_offset= 0x27001u;
 	const unsigned int c_lights_offset= 0x27003u;
@@ -498,19 +733,23 @@ void MapLoader::LoadMonstersAndLights( const Vfs::FileContent& map_file, MapData
 	}
 }
 
-void MapLoader::LoadMapName( const Vfs::FileContent& resource_file, char* const out_map_name )
+void MapLoader::LoadMapName( const Vfs::FileView& resource_file, char* const out_map_name )
 {
 	out_map_name[0]= '\0';
 
-	const char* s= GetSubstring( reinterpret_cast<const char*>( resource_file.data() ), "#name" );
+	const TextSpan text= GetFileText( resource_file );
+	const char* s= text.FindIgnoreCase( "#name" );
+	if( s == nullptr )
+		return;
 	s+= std::strlen( "#name" );
 
 	// Skip '=' and spaces before '='
-	while( std::isspace(*s) ) s++;
+	while( s < text.end && std::isspace(*s) ) s++;
 	s++;
 
 	char* dst= out_map_name;
 	while(
+		s < text.end &&
 		*s != '\0' &&
 		! ( *s == '\n' || *s == '\r' ) &&
 		dst < out_map_name + MapData::c_max_map_name_size - 1u )
@@ -521,22 +760,26 @@ void MapLoader::LoadMapName( const Vfs::FileContent& resource_file, char* const
 
 }
 
-void MapLoader::LoadSkyTextureName( const Vfs::FileContent& resource_file, MapData& map_data )
+void MapLoader::LoadSkyTextureName( const Vfs::FileView& resource_file, MapData& map_data )
 {
 	map_data.sky_texture_name[0]= '\0';
 
-	const char* s= GetSubstring( reinterpret_cast<const char*>( resource_file.data() ), "#sky" );
+	const TextSpan text= GetFileText( resource_file );
+	const char* s= text.FindIgnoreCase( "#sky" );
+	if( s == nullptr )
+		return;
 	s+= std::strlen( "#sky" );
 
-	while( std::isspace(*s) ) s++;
+	while( s < text.end && std::isspace(*s) ) s++;
 
 	// =
 	s++;
 
-	while( std::isspace(*s) )s++;
+	while( s < text.end && std::isspace(*s) )s++;
 
 	char* dst= map_data.sky_texture_name;
 	while(
+		s < text.end &&
 		*s != '\0' &&
 		!std::isspace( *s ) &&
 		dst < map_data.sky_texture_name + sizeof(map_data.sky_texture_name) - 1u )
@@ -546,54 +789,53 @@ void MapLoader::LoadSkyTextureName( const Vfs::FileContent& resource_file, MapDa
 	*dst= '\0';
 }
 
-void MapLoader::LoadModelsDescription( const Vfs::FileContent& resource_file, MapData& map_data )
+void MapLoader::LoadModelsDescription( const Vfs::FileView& resource_file, MapData& map_data )
 {
-	const char* start= GetSubstring( reinterpret_cast<const char*>( resource_file.data() ), "#newobjects" );
+	const TextSpan text= GetFileText( resource_file );
+	const char* start= text.FindIgnoreCase( "#newobjects" );
+	if( start == nullptr )
+		return;
 
-	while( *start != '\n' ) start++;
+	while( start < text.end && *start != '\n' ) start++;
 	start++;
+	if( start >= text.end )
+		return;
 
-	const char* const end= GetSubstring( start, "#end" );
-
-	std::istringstream stream( std::string( start, end ) );
+	const TextSpan section= GetLinesBefore( TextSpan( start, text.end ), "#end" );
+	TextTokenizer tokenizer( section );
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512u ];
-		stream.getline( line, sizeof(line), '\n' );
-
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
 		map_data.models_description.emplace_back();
 		MapData::ModelDescription& model_description= map_data.models_description.back();
 
-		line_stream >> model_description.radius; // GoRad
+		model_description.radius= 0.0f;
+		tokenizer.ReadNumber( model_description.radius ); // GoRad
 
 		int shadow= 0;
-		line_stream >> shadow; // Shad
-		model_description.cast_shadow= shadow != 0; // Stream fails if number is not zero or not one
+		tokenizer.ReadNumber( shadow ); // Shad
+		model_description.cast_shadow= shadow != 0;
 
-		line_stream >> model_description.bobj; // BObj
-		line_stream >> model_description.bmpz; // BMPz
-		line_stream >> model_description.ac; // AC
-		line_stream >> model_description.blow_effect; // Blw
-		line_stream >> model_description.break_limit; // BLmt
-		line_stream >> model_description.ambient_sfx_number; // SFX
-		line_stream >> model_description.break_sfx_number; // BSfx
+		model_description.bobj= model_description.bmpz= model_description.ac= 0;
+		model_description.blow_effect= model_description.break_limit= 0;
+		model_description.ambient_sfx_number= model_description.break_sfx_number= 0u;
 
-		line_stream >> model_description.file_name; // FileName
+		tokenizer.ReadNumber( model_description.bobj ); // BObj
+		tokenizer.ReadNumber( model_description.bmpz ); // BMPz
+		tokenizer.ReadNumber( model_description.ac ); // AC
+		tokenizer.ReadNumber( model_description.blow_effect ); // Blw
+		tokenizer.ReadNumber( model_description.break_limit ); // BLmt
+		tokenizer.ReadNumber( model_description.ambient_sfx_number ); // SFX
+		tokenizer.ReadNumber( model_description.break_sfx_number ); // BSfx
 
-		model_description.animation_file_name[0u]= '\0';
-		line_stream >> model_description.animation_file_name;
+		tokenizer.NextToken().CopyTo( model_description.file_name, sizeof(model_description.file_name) ); // FileName
+		tokenizer.NextToken().CopyTo( model_description.animation_file_name, sizeof(model_description.animation_file_name) );
 
 		model_description.radius*= g_map_coords_scale;
 	}
 }
 
-void MapLoader::LoadWallsTexturesDescription( const Vfs::FileContent& resource_file, MapData& map_data )
+void MapLoader::LoadWallsTexturesDescription( const Vfs::FileView& resource_file, MapData& map_data )
 {
 	for( MapData::WallTextureDescription& tex: map_data.walls_textures )
 	{
@@ -601,130 +843,109 @@ void MapLoader::LoadWallsTexturesDescription( const Vfs::FileContent& resource_f
 		tex.gso[0]= tex.gso[1]= tex.gso[2]= false;
 	}
 
-	const char* start= GetSubstring( reinterpret_cast<const char*>( resource_file.data() ), "#GFX" );
+	const TextSpan text= GetFileText( resource_file );
+	const char* start= text.FindIgnoreCase( "#GFX" );
+	if( start == nullptr )
+		return;
 	start+= std::strlen( "#GFX" );
-	const char* const end= GetSubstring( start, "#end" );
 
-	std::istringstream stream( std::string( start, end ) );
+	TextTokenizer tokenizer( GetLinesBefore( TextSpan( start, text.end ), "#end" ) );
 
-	char line[ 512u ];
-	stream.getline( line, sizeof(line), '\n' );
+	// Skip rest of "#GFX" line.
+	tokenizer.NextLine();
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		stream.getline( line, sizeof(line), '\n' );
-
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		unsigned int texture_number;
-		line_stream >> texture_number;
+		unsigned int texture_number= 0u;
+		const bool texture_number_ok= tokenizer.ReadNumber( texture_number );
 
-		char colon[8];
-		line_stream >> colon;
-		if( line_stream.fail() )
+		const TextSpan colon= tokenizer.NextToken();
+		if( !texture_number_ok || colon.empty() || texture_number >= MapData::c_max_walls_textures )
 			continue;
 
 		MapData::WallTextureDescription& texture_description= map_data.walls_textures[ texture_number ];
 
-		char texture_name[ MapData::c_max_file_name_size ];
-		line_stream >> texture_name;
-		if( line_stream.fail() )
+		const TextSpan texture_name_span= tokenizer.NextToken();
+		if( texture_name_span.empty() )
 			continue;
 
-		if( texture_name[0] != '\0' )
-			std::snprintf(
-				texture_description.file_path,
-				sizeof(MapData::WallTextureDescription::file_path),
-				"%s%s", textures_path_, texture_name );
-		else
-			texture_description.file_path[0]= '\0';
-
-		char gso[16];
-		line_stream >> gso;
-		if( !line_stream.fail() )
-		{
-			for( unsigned int j= 0u; j < 3u; j++ )
-				if( gso[j] != '.' )
-					texture_description.gso[j]= true;
-		}
+		char texture_name[ MapData::c_max_file_name_size ];
+		texture_name_span.CopyTo( texture_name, sizeof(texture_name) );
+		std::snprintf(
+			texture_description.file_path,
+			sizeof(MapData::WallTextureDescription::file_path),
+			"%s%s", textures_path_, texture_name );
+
+		const TextSpan gso= tokenizer.NextToken();
+		for( unsigned int j= 0u; j < 3u && j < gso.size(); j++ )
+			if( gso.begin[j] != '.' )
+				texture_description.gso[j]= true;
 	}
 }
 
-void MapLoader::LoadFloorsTexturesData( const Vfs::FileContent& floors_file, MapData& map_data )
+void MapLoader::LoadFloorsTexturesData( const Vfs::FileView& floors_file, MapData& map_data )
 {
+	map_data.floor_textures_data.resize( MapData::c_floors_textures_count );
 	for( unsigned int t= 0u; t < MapData::c_floors_textures_count; t++ )
 	{
 		const unsigned char* const in_data=
 			floors_file.data() + g_floors_file_header_size + g_bytes_per_floor_in_file * t;
 
 		std::memcpy(
-			map_data.floor_textures_data[t],
+			map_data.floor_textures_data[t].data(),
 			in_data,
 			MapData::c_floor_texture_size * MapData::c_floor_texture_size );
 	}
 }
 
 
-void MapLoader::LoadLevelScripts( const Vfs::FileContent& process_file, MapData& map_data )
+void MapLoader::LoadLevelScripts( const Vfs::FileView& process_file, MapData& map_data )
 {
 	const char* const start= reinterpret_cast<const char*>( process_file.data() );
 	const char* const end= start + process_file.size();
 
-	std::istringstream stream( std::string( start, end ) );
-
-	char line[ 512 ];
+	TextTokenizer tokenizer{ TextSpan( start, end ) };
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		stream.getline( line, sizeof(line), '\n' );
-		if( stream.eof() || stream.fail() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		char thing_type[ sizeof(line) ];
-		line_stream >> thing_type;
+		const TextSpan thing_type= tokenizer.NextToken();
 
-		if( line_stream.fail() || thing_type[0] != '#' )
+		if( thing_type.empty() || thing_type.begin[0] != '#' )
 			continue;
-		else if( StringEquals( thing_type, "#mess" ) )
+		else if( thing_type.EqualsIgnoreCase( "#mess" ) )
 		{
 			unsigned int message_number= 0;
-			line_stream >> message_number;
-			if( !line_stream.fail() && message_number != 0 )
-				LoadMessage( message_number, stream, map_data );
+			if( tokenizer.ReadNumber( message_number ) && message_number != 0 )
+				LoadMessage( message_number, tokenizer, map_data );
 		}
-		else if( std::strncmp( thing_type, "#proc", std::strlen("#proc" ) ) == 0 )
+		else if( thing_type.StartsWith( "#proc" ) )
 		{
 			const unsigned int c_max_procedure_number= 1000;
 
 			// catch something, like #proc42
-			if( std::strlen( thing_type ) > std::strlen( "#proc" ) )
+			if( thing_type.size() > std::strlen( "#proc" ) )
 			{
-				const char* const num_str= thing_type + std::strlen( "#proc" );
-				const unsigned int procedure_number= std::atoi( num_str );
-				if( std::isdigit(*num_str) && procedure_number < c_max_procedure_number )
-					LoadProcedure( procedure_number, stream, map_data );
+				const TextSpan num_str( thing_type.begin + std::strlen( "#proc" ), thing_type.end );
+				unsigned int procedure_number= 0u;
+				if( std::isdigit( *num_str.begin ) && num_str.ToNumber( procedure_number ) && procedure_number < c_max_procedure_number )
+					LoadProcedure( procedure_number, tokenizer, map_data );
 			}
 			else
 			{
 				unsigned int procedure_number;
-				line_stream >> procedure_number;
-				if( !line_stream.fail() && procedure_number < c_max_procedure_number )
-					LoadProcedure( procedure_number, stream, map_data );
+				if( tokenizer.ReadNumber( procedure_number ) && procedure_number < c_max_procedure_number )
+					LoadProcedure( procedure_number, tokenizer, map_data );
 			}
 		}
-		else if( StringEquals( thing_type, "#links" ) )
-			LoadLinks( stream, map_data );
-		else if( StringEquals( thing_type, "#teleports" ) )
-			LoadTeleports( stream, map_data );
-		else if( StringEquals( thing_type, "#stopani" ) )
+		else if( thing_type.EqualsIgnoreCase( "#links" ) )
+			LoadLinks( tokenizer, map_data );
+		else if( thing_type.EqualsIgnoreCase( "#teleports" ) )
+			LoadTeleports( tokenizer, map_data );
+		else if( thing_type.EqualsIgnoreCase( "#stopani" ) )
 		{
-			map_data.stopani_commands.emplace_back();
-			line_stream >> map_data.stopani_commands.back();
+			unsigned int animation_number= 0u;
+			tokenizer.ReadNumber( animation_number );
+			map_data.stopani_commands.push_back( static_cast<unsigned short>( animation_number ) );
 		}
 
 	} // for file
@@ -732,53 +953,45 @@ void MapLoader::LoadLevelScripts( const Vfs::FileContent& process_file, MapData&
 
 void MapLoader::LoadMessage(
 	const unsigned int message_number,
-	std::istringstream& stream,
+	TextTokenizer& tokenizer,
 	MapData& map_data )
 {
 	if( message_number >= map_data.messages.size() )
 		map_data.messages.resize( message_number + 1u );
 	MapData::Message& message= map_data.messages[ message_number ];
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512 ];
-		stream.getline( line, sizeof(line), '\n' );
-
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		char thing[64];
-		line_stream >> thing;
-		if( StringEquals( thing, "#end" ) )
+		const TextSpan thing= tokenizer.NextToken();
+		if( thing.EqualsIgnoreCase( "#end" ) )
 			break;
 
-		else if( StringEquals( thing, "Delay" )  )
-			line_stream >> message.delay_s;
+		else if( thing.EqualsIgnoreCase( "Delay" )  )
+			tokenizer.ReadNumber( message.delay_s );
 
-		else if( std::strncmp( thing, "Text", std::strlen("Text") ) == 0 )
+		else if( thing.StartsWith( "Text" ) )
 		{
 			message.texts.emplace_back();
 			MapData::Message::Text& text= message.texts.back();
 
-			line_stream >> text.x;
-			line_stream >> text.y;
+			tokenizer.ReadNumber( text.x );
+			tokenizer.ReadNumber( text.y );
 
 			// Read line in ""
-			char text_line[512];
-			line_stream >> text_line;
-			const int len= std::strlen(text_line);
-			line_stream.getline( text_line + len, sizeof(text_line) - len, '\n' );
+			TextSpan text_line= tokenizer.RestOfLine();
+			if( !text_line.empty() && text_line.begin[0] == '"' )
+				text_line.begin++;
+			if( !text_line.empty() && text_line.end[-1] == '"' )
+				text_line.end--;
 
-			text.data= std::string( text_line + 1u, text_line + std::strlen( text_line ) - 2u );
+			text.data= std::string( text_line.begin, text_line.end );
 		}
 	}
 }
 
 void MapLoader::LoadProcedure(
 	const unsigned int procedure_number,
-	std::istringstream& stream,
+	TextTokenizer& tokenizer,
 	MapData& map_data )
 {
 	if( procedure_number >= map_data.procedures.size() )
@@ -787,82 +1000,77 @@ void MapLoader::LoadProcedure(
 
 	bool has_action= false;
 
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512 ];
-		stream.getline( line, sizeof(line), '\n' );
+		const TextSpan thing= tokenizer.NextToken();
 
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		char thing[64];
-		line_stream >> thing;
-
-		if( line_stream.fail() )
+		if( thing.empty() )
 			continue;
-		if( StringEquals( thing, "#end" ) )
+		if( thing.EqualsIgnoreCase( "#end" ) )
 			break;
-		if( thing[0] == ';' )
+		if( thing.begin[0] == ';' )
 			continue;
 
-		else if( StringEquals( thing, "StartDelay" ) )
-			line_stream >> procedure.start_delay_s;
-		else if( StringEquals( thing, "EndDelay" ) )
-			line_stream >> procedure.end_delay_s;
-		else if( StringEquals( thing, "BackWait" ) )
-			line_stream >> procedure.back_wait_s;
-		else if( StringEquals( thing, "Speed" ) )
-			line_stream >> procedure.speed;
-		else if( StringEquals( thing, "checkgo" ) )
+		else if( thing.EqualsIgnoreCase( "StartDelay" ) )
+			tokenizer.ReadNumber( procedure.start_delay_s );
+		else if( thing.EqualsIgnoreCase( "EndDelay" ) )
+			tokenizer.ReadNumber( procedure.end_delay_s );
+		else if( thing.EqualsIgnoreCase( "BackWait" ) )
+			tokenizer.ReadNumber( procedure.back_wait_s );
+		else if( thing.EqualsIgnoreCase( "Speed" ) )
+			tokenizer.ReadNumber( procedure.speed );
+		else if( thing.EqualsIgnoreCase( "checkgo" ) )
 			procedure.check_go= true;
-		else if( StringEquals( thing, "checkback" ) )
+		else if( thing.EqualsIgnoreCase( "checkback" ) )
 			procedure.check_back= true;
-		else if( StringEquals( thing, "Mortal" ) )
+		else if( thing.EqualsIgnoreCase( "Mortal" ) )
 			procedure.mortal= true;
-		else if( StringEquals( thing, "LightRemap" ) )
-			line_stream >> procedure.light_remap;
-		else if( StringEquals( thing, "Lock" ) && !has_action ) // Distinguish property "lock" and action command "lock".
+		else if( thing.EqualsIgnoreCase( "LightRemap" ) )
+		{
+			int light_remap= 0;
+			tokenizer.ReadNumber( light_remap );
+			procedure.light_remap= light_remap != 0;
+		}
+		else if( thing.EqualsIgnoreCase( "Lock" ) && !has_action ) // Distinguish property "lock" and action command "lock".
 			procedure.locked= true;
-		else if( StringEquals( thing, "OnMessage" ) )
-			line_stream >> procedure.on_message_number;
-		else if( StringEquals( thing, "FirstMessage" ) )
-			line_stream >> procedure.first_message_number;
-		else if( StringEquals( thing, "LockMessage" ) )
-			line_stream >> procedure.lock_message_number;
-		else if( StringEquals( thing, "SfxId" ) )
-			line_stream >> procedure.sfx_id;
-		else if( StringEquals( thing, "SfxPosxy" ) )
+		else if( thing.EqualsIgnoreCase( "OnMessage" ) )
+			tokenizer.ReadNumber( procedure.on_message_number );
+		else if( thing.EqualsIgnoreCase( "FirstMessage" ) )
+			tokenizer.ReadNumber( procedure.first_message_number );
+		else if( thing.EqualsIgnoreCase( "LockMessage" ) )
+			tokenizer.ReadNumber( procedure.lock_message_number );
+		else if( thing.EqualsIgnoreCase( "SfxId" ) )
+			tokenizer.ReadNumber( procedure.sfx_id );
+		else if( thing.EqualsIgnoreCase( "SfxPosxy" ) )
 		{
-			int x, y;
-			line_stream >> x; line_stream >> y;
+			int x= 0, y= 0;
+			tokenizer.ReadNumber( x ); tokenizer.ReadNumber( y );
 			procedure.sfx_pos.emplace_back();
 			procedure.sfx_pos.back().x= x;
 			procedure.sfx_pos.back().y= y;
 		}
-		else if( StringEquals( thing, "LinkSwitchAt" ) )
+		else if( thing.EqualsIgnoreCase( "LinkSwitchAt" ) )
 		{
-			int x, y;
-			line_stream >> x; line_stream >> y;
+			int x= 0, y= 0;
+			tokenizer.ReadNumber( x ); tokenizer.ReadNumber( y );
 			procedure.linked_switches.emplace_back();
 			procedure.linked_switches.back().x= x;
 			procedure.linked_switches.back().y= y;
 		}
-		else if( StringEquals( thing, "RedKey" ) )
+		else if( thing.EqualsIgnoreCase( "RedKey" ) )
 			procedure.red_key_required= true;
-		else if( StringEquals( thing, "GreenKey" ) )
+		else if( thing.EqualsIgnoreCase( "GreenKey" ) )
 			procedure.green_key_required= true;
-		else if( StringEquals( thing, "BlueKey" ) )
+		else if( thing.EqualsIgnoreCase( "BlueKey" ) )
 			procedure.blue_key_required= true;
 
-		else if( StringEquals( thing, "#action" ) )
+		else if( thing.EqualsIgnoreCase( "#action" ) )
 			has_action= true;
 		else if( has_action )
 		{
 			const auto commnd_id= ActionCommandFormString( thing );
 			if( commnd_id == MapData::Procedure::ActionCommandId::Unknown )
-				Log::Warning( "Unknown coommand: ", thing );
+				Log::Warning( "Unknown coommand: ", std::string( thing.begin, thing.end ) );
 			else
 			{
 				procedure.action_commands.emplace_back();
@@ -870,11 +1078,10 @@ void MapLoader::LoadProcedure(
 
 				command.id= commnd_id;
 
-				unsigned int arg= 0u;
-				while( !line_stream.fail() )
+				for( float& arg : command.args )
 				{
-					line_stream >> command.args[arg];
-					arg++;
+					if( !tokenizer.ReadNumber( arg ) )
+						break;
 				}
 			}
 		} // if has_action
@@ -882,34 +1089,25 @@ void MapLoader::LoadProcedure(
 	} // for procedure
 }
 
-void MapLoader::LoadLinks( std::istringstream& stream, MapData& map_data )
+void MapLoader::LoadLinks( TextTokenizer& tokenizer, MapData& map_data )
 {
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512 ];
-		stream.getline( line, sizeof(line), '\n' );
-
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		char link_type[512];
-		line_stream >> link_type;
-		if( line_stream.fail() )
+		const TextSpan link_type= tokenizer.NextToken();
+		if( link_type.empty() )
 			continue;
-		if( link_type[0] == ';' )
+		if( link_type.begin[0] == ';' )
 			continue;
-		if( StringEquals( link_type, "#end" ) )
+		if( link_type.EqualsIgnoreCase( "#end" ) )
 			break;
 
 		map_data.links.emplace_back();
 		MapData::Link& link= map_data.links.back();
 
-		unsigned short x, y, proc_id;
-		line_stream >> x;
-		line_stream >> y;
-		line_stream >> proc_id;
+		unsigned int x= 0u, y= 0u, proc_id= 0u;
+		tokenizer.ReadNumber( x );
+		tokenizer.ReadNumber( y );
+		tokenizer.ReadNumber( proc_id );
 
 		link.x= x;
 		link.y= y;
@@ -918,37 +1116,32 @@ void MapLoader::LoadLinks( std::istringstream& stream, MapData& map_data )
 	}
 }
 
-void MapLoader::LoadTeleports( std::istringstream& stream, MapData& map_data )
+void MapLoader::LoadTeleports( TextTokenizer& tokenizer, MapData& map_data )
 {
-	while( !stream.eof() )
+	while( tokenizer.NextLine() )
 	{
-		char line[ 512 ];
-		stream.getline( line, sizeof(line), '\n' );
-
-		if( stream.eof() )
-			break;
-
-		std::istringstream line_stream{ std::string( line ) };
-
-		char str[512]; // must be "tcenter"
-		line_stream >> str;
-		if( line_stream.fail() )
+		const TextSpan str= tokenizer.NextToken(); // must be "tcenter"
+		if( str.empty() )
 			continue;
-		if( str[0] == ';' )
+		if( str.begin[0] == ';' )
 			continue;
-		if( StringEquals( str, "#end" ) )
+		if( str.EqualsIgnoreCase( "#end" ) )
 			break;
 
 		map_data.teleports.emplace_back();
 		MapData::Teleport& teleport= map_data.teleports.back();
 
-		line_stream >> teleport.from[0];
-		line_stream >> teleport.from[1];
-		line_stream >> teleport.to[0];
-		line_stream >> teleport.to[1];
+		unsigned int coords[4]= { 0u, 0u, 0u, 0u };
+		for( unsigned int& coord : coords )
+			tokenizer.ReadNumber( coord );
+
+		teleport.from[0]= coords[0];
+		teleport.from[1]= coords[1];
+		teleport.to[0]= coords[2];
+		teleport.to[1]= coords[3];
 
-		unsigned int angle;
-		line_stream >> angle;
+		unsigned int angle= 0u;
+		tokenizer.ReadNumber( angle );
 		teleport.angle= -float(angle) / 4.0f * Constants::two_pi - Constants::half_pi;
 	}
 }
@@ -988,33 +1181,79 @@ void MapLoader::LoadModels( MapData& map_data )
 
 	map_data.models.resize( map_data.models_description.size() );
 
-	Vfs::FileContent file_content;
-	Vfs::FileContent animation_file_content;
+	const unsigned int thread_count=
+		std::min(
+			std::min( std::max( std::thread::hardware_concurrency(), 1u ), g_max_models_loading_threads ),
+			static_cast<unsigned int>( std::max( map_data.models.size(), size_t(1u) ) ) );
 
-	for( unsigned int m= 0u; m < map_data.models.size(); m++ )
+	std::atomic<unsigned int> next_model( 0u );
+	const auto load_models_func=
+	[&]
 	{
-		const MapData::ModelDescription& model_description= map_data.models_description[m];
-
-		char model_file_path[ MapData::c_max_file_path_size ];
-		std::snprintf( model_file_path, sizeof(model_file_path), "%s%s", models_path_, model_description.file_name );
-		vfs_->ReadFile( model_file_path, file_content );
-
-		if( model_description.animation_file_name[0u] != '\0' )
+		while(true)
 		{
-			// TODO - know, why some models animations file names have % prefix.
-			const char* file_name= model_description.animation_file_name;
-			if( file_name[0] == '%' )
-				file_name++;
-
-			char animation_file_path[ MapData::c_max_file_path_size ];
-			std::snprintf( animation_file_path, sizeof(animation_file_path), "%s%s", animations_path_, file_name );
-			vfs_->ReadFile( animation_file_path, animation_file_content );
+			const unsigned int m= next_model.fetch_add( 1u );
+			if( m >= map_data.models.size() )
+				break;
+			LoadModel( map_data, m );
 		}
-		else
-			animation_file_content.clear();
+	};
+
+	// Calling thread loads models too.
+	std::vector< std::future<void> > futures;
+	for( unsigned int i= 1u; i < thread_count; i++ )
+		futures.push_back( std::async( std::launch::async, load_models_func ) );
 
-		LoadModel_o3( file_content, animation_file_content, map_data.models[m] );
-	} // for models
+	load_models_func();
+	for( std::future<void>& future : futures )
+		future.get();
+}
+
+void MapLoader::LoadModel( MapData& map_data, const unsigned int model_index )
+{
+	const MapData::ModelDescription& model_description= map_data.models_description[model_index];
+
+	const Vfs::MappedFile file_content= MapModelFile( model_description );
+	const Vfs::MappedFile animation_file_content= MapModelAnimationFile( model_description );
+
+	LoadModel_o3( file_content, animation_file_content, map_data.models[model_index] );
+	if( load_profile_ == LoadProfile::ServerOnly )
+		FreeModelRenderData( map_data.models[model_index] );
+}
+
+Vfs::MappedFile MapLoader::MapModelFile( const MapData::ModelDescription& model_description ) const
+{
+	char model_file_path[ MapData::c_max_file_path_size ];
+	std::snprintf( model_file_path, sizeof(model_file_path), "%s%s", models_path_, model_description.file_name );
+	return vfs_->MapFile( model_file_path );
+}
+
+Vfs::MappedFile MapLoader::MapModelAnimationFile( const MapData::ModelDescription& model_description ) const
+{
+	if( model_description.animation_file_name[0u] == '\0' )
+		return Vfs::MappedFile();
+
+	// TODO - know, why some models animations file names have % prefix.
+	const char* file_name= model_description.animation_file_name;
+	if( file_name[0] == '%' )
+		file_name++;
+
+	char animation_file_path[ MapData::c_max_file_path_size ];
+	std::snprintf( animation_file_path, sizeof(animation_file_path), "%s%s", animations_path_, file_name );
+	return vfs_->MapFile( animation_file_path );
+}
+
+unsigned int MapLoader::CalculateModelsSourceHash( const MapData& map_data ) const
+{
+	unsigned int result= 0u;
+	for( const MapData::ModelDescription& model_description : map_data.models_description )
+	{
+		const Vfs::MappedFile model_file= MapModelFile( model_description );
+		const Vfs::MappedFile animation_file= MapModelAnimationFile( model_description );
+		result= result * 31u + SaveHeader::CalculateHash( model_file.data(), model_file.size() );
+		result= result * 31u + SaveHeader::CalculateHash( animation_file.data(), animation_file.size() );
+	}
+	return result;
 }
 
 bool MapLoader::GetMapInfoImpl( const unsigned int map_number, MapInfo& out_map_info )
@@ -1025,7 +1264,7 @@ bool MapLoader::GetMapInfoImpl( const unsigned int map_number, MapInfo& out_map_
 	std::snprintf( level_path, sizeof(level_path), "LEVEL%02u/", map_number );
 	std::snprintf( resource_file_name, sizeof(resource_file_name), "%sRESOURCE.%02u", level_path, map_number );
 
-	const Vfs::FileContent resource_file_content= vfs_->ReadFile( resource_file_name );
+	const Vfs::MappedFile resource_file_content= vfs_->MapFile( resource_file_name );
 
 	if( resource_file_content.empty() )
 		return false;
@@ -1,6 +1,10 @@
 #pragma once
+#include <array>
+#include <future>
+#include <list>
 #include <memory>
-#include <sstream>
+#include <mutex>
+#include <unordered_map>
 
 #include <vec.hpp>
 
@@ -8,6 +12,7 @@
 #include "fwd.hpp"
 #include "game_resources.hpp"
 #include "model.hpp"
+#include "text_tokenizer.hpp"
 #include "vfs.hpp"
 
 namespace PanzerChasm
@@ -42,6 +47,9 @@ public:
 	static constexpr unsigned int c_first_transparent_texture_id= 86u;
 
 public:
+	// Palette indices.
+	typedef std::array< unsigned char, c_floor_texture_size * c_floor_texture_size > FloorTextureData;
+
 	struct Wall
 	{
 		m_Vec2 vert_pos[2];
@@ -283,22 +291,31 @@ public:
 
 	unsigned char floor_textures[ c_map_size * c_map_size ];
 	unsigned char ceiling_textures[ c_map_size * c_map_size ];
-	unsigned char ambient_lightmap[ c_map_size * c_map_size ];
 	unsigned char ambient_sounds_map[ c_map_size * c_map_size ];
 
-	unsigned char lightmap[ c_lightmap_size * c_lightmap_size ];
-
-	unsigned char floor_textures_data[ c_floors_textures_count ][ c_floor_texture_size * c_floor_texture_size ];
+	// Render-only data. Empty for maps, loaded with server-only profile.
+	std::vector<unsigned char> ambient_lightmap; // c_map_size * c_map_size
+	std::vector<unsigned char> lightmap; // c_lightmap_size * c_lightmap_size
+	std::vector<FloorTextureData> floor_textures_data; // c_floors_textures_count
 };
 
 class MapLoader final
 {
 public:
-	explicit MapLoader( const VfsPtr& vfs );
+	// Recently used maps are cached, while their total memory fits into budget. Last used map is always cached.
+	// With server-only profile render-only data of maps is not loaded and baked maps are not saved.
+	MapLoader( const VfsPtr& vfs, size_t cache_memory_budget, LoadProfile load_profile );
 	~MapLoader();
 
 	MapDataConstPtr LoadMap( unsigned int map_number );
 
+	// Start loading of map in background thread. Next LoadMap call for this map returns prefetched map.
+	// Does nothing, if previous prefetch is not finished yet.
+	void PrefetchMap( unsigned int map_number );
+
+	// Load all maps, so baked files for them are created. Useful for packaging.
+	void BakeMaps();
+
 	struct MapInfo
 	{
 		unsigned int number;
@@ -307,48 +324,83 @@ public:
 
 	MapInfo GetNextMapInfo( unsigned int map_number );
 	MapInfo GetPrevMapInfo( unsigned int map_number );
+	std::vector<MapInfo> GetAllMapsInfo();
 
 private:
 	typedef std::array< bool, MapData::c_map_size * MapData::c_map_size > DynamicWallsMask;
 
+	struct CachedMap
+	{
+		MapDataConstPtr map_data;
+		size_t memory_size;
+	};
+
 private:
-	void LoadLightmap( const Vfs::FileContent& map_file, MapData& map_data );
-	const unsigned char* GetWallsLightmapData( const Vfs::FileContent& map_file );
-	void LoadWalls( const Vfs::FileContent& map_file, MapData& map_data, const DynamicWallsMask& dynamic_walls_mask, const unsigned char* walls_lightmap_data );
-	void LoadFloorsAndCeilings( const Vfs::FileContent& map_file, MapData& map_data );
-	void LoadAmbientLight( const Vfs::FileContent& map_file, MapData& map_data );
-	void LoadAmbientSoundsMap( const Vfs::FileContent& map_file, MapData& map_data );
-	void LoadMonstersAndLights( const Vfs::FileContent& map_file, MapData& map_data );
+	MapDataConstPtr LoadMapImpl( unsigned int map_number, bool is_prefetch );
+	void AddMapToCache( const MapDataConstPtr& map_data );
 
-	void LoadMapName( const Vfs::FileContent& resource_file, char* out_map_name );
-	void LoadSkyTextureName( const Vfs::FileContent& resource_file, MapData& map_data );
-	void LoadModelsDescription( const Vfs::FileContent& resource_file, MapData& map_data );
-	void LoadWallsTexturesDescription( const Vfs::FileContent& resource_file, MapData& map_data );
+	void LoadLightmap( const Vfs::FileView& map_file, MapData& map_data );
+	const unsigned char* GetWallsLightmapData( const Vfs::FileView& map_file );
+	void LoadWalls( const Vfs::FileView& map_file, MapData& map_data, const DynamicWallsMask& dynamic_walls_mask, const unsigned char* walls_lightmap_data );
+	void LoadFloorsAndCeilings( const Vfs::FileView& map_file, MapData& map_data );
+	void LoadAmbientLight( const Vfs::FileView& map_file, MapData& map_data );
+	void LoadAmbientSoundsMap( const Vfs::FileView& map_file, MapData& map_data );
+	void LoadMonstersAndLights( const Vfs::FileView& map_file, MapData& map_data );
 
-	void LoadFloorsTexturesData( const Vfs::FileContent& floors_file, MapData& map_data );
+	void LoadMapName( const Vfs::FileView& resource_file, char* out_map_name );
+	void LoadSkyTextureName( const Vfs::FileView& resource_file, MapData& map_data );
+	void LoadModelsDescription( const Vfs::FileView& resource_file, MapData& map_data );
+	void LoadWallsTexturesDescription( const Vfs::FileView& resource_file, MapData& map_data );
 
-	void LoadLevelScripts( const Vfs::FileContent& process_file, MapData& map_data );
+	void LoadFloorsTexturesData( const Vfs::FileView& floors_file, MapData& map_data );
 
-	void LoadMessage( unsigned int message_number, std::istringstream& stream, MapData& map_data );
-	void LoadProcedure( unsigned int procedure_number, std::istringstream& stream, MapData& map_data );
-	void LoadLinks( std::istringstream& stream, MapData& map_data );
-	void LoadTeleports( std::istringstream& stream, MapData& map_data );
+	void LoadLevelScripts( const Vfs::FileView& process_file, MapData& map_data );
+
+	void LoadMessage( unsigned int message_number, TextTokenizer& tokenizer, MapData& map_data );
+	void LoadProcedure( unsigned int procedure_number, TextTokenizer& tokenizer, MapData& map_data );
+	void LoadLinks( TextTokenizer& tokenizer, MapData& map_data );
+	void LoadTeleports( TextTokenizer& tokenizer, MapData& map_data );
 
 	void MarkDynamicWalls( const MapData& map_data, DynamicWallsMask& out_dynamic_walls );
 
+	// Models are loaded in parallel.
 	void LoadModels( MapData& map_data );
+	void LoadModel( MapData& map_data, unsigned int model_index );
+
+	// Returns empty file, if model has no animation file.
+	Vfs::MappedFile MapModelFile( const MapData::ModelDescription& model_description ) const;
+	Vfs::MappedFile MapModelAnimationFile( const MapData::ModelDescription& model_description ) const;
+
+	// Requires loaded models description.
+	unsigned int CalculateModelsSourceHash( const MapData& map_data ) const;
 
 	// Returns false, if failed to load map.
 	bool GetMapInfoImpl( unsigned int map_number, MapInfo& out_map_info );
 
 private:
 	const VfsPtr vfs_;
+	const LoadProfile load_profile_;
 
-	MapDataConstPtr last_loaded_map_;
+	// Methods may be called from different threads, for example, from several servers in one process.
+	std::mutex mutex_;
+
+	// Most recently used first. Models are part of map data, so, they are cached together with maps.
+	// Loader is created for one vfs, so, cache is valid only for one addon.
+	std::list<CachedMap> cached_maps_;
+	size_t cached_maps_memory_size_= 0u;
+	const size_t cache_memory_budget_;
+
+	MapDataConstPtr prefetched_map_; // Hold prefetched map until somebody takes it.
+	// Map data is immutable, so, it is shared between all users, while somebody holds it.
+	std::unordered_map< unsigned int, std::weak_ptr<const MapData> > loaded_maps_;
 
 	char textures_path_[ MapData::c_max_file_name_size ];
 	char models_path_[ MapData::c_max_file_name_size ];
 	char animations_path_[ MapData::c_max_file_name_size ];
+
+	// Separate mutex, because prefetch thread holds main mutex while loading.
+	std::mutex prefetch_mutex_;
+	std::future<void> prefetch_future_;
 };
 
 } // namespace PanzerChasm
@@ -3,6 +3,7 @@
 #include <ogl_state_manager.hpp>
 #include <shaders_loading.hpp>
 
+#include "assert.hpp"
 #include "game_constants.hpp"
 #include "game_resources.hpp"
 #include "menu_drawers_common.hpp"
@@ -15,7 +16,8 @@
 namespace PanzerChasm
 {
 
-static const unsigned int g_max_quads= 512u;
+// Menu background with framing is 3x3 quads. Other quads are drawn via quads batcher.
+static const unsigned int g_max_quads= 9u;
 
 static const GLenum g_gl_state_blend_func[2]= { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
 static const r_OGLState g_gl_state(
@@ -26,11 +28,15 @@ static const r_OGLState g_gl_state(
 MenuDrawerGL::MenuDrawerGL(
 	Settings& settings,
 	const RenderingContextGL& rendering_context,
-	const GameResources& game_resources )
+	const GameResources& game_resources,
+	const QuadsBatcherGLPtr& quads_batcher )
 	: viewport_size_(rendering_context.viewport_size)
 	, menu_scale_( CalculateMenuScale( rendering_context.viewport_size ) )
 	, console_scale_( CalculateConsoleScale( rendering_context.viewport_size ) )
+	, quads_batcher_( quads_batcher )
 {
+	PC_ASSERT( quads_batcher_ != nullptr );
+
 	const bool filter_textures= settings.GetOrSetBool( SettingsKeys::opengl_menu_textures_filtering, false );
 
 	std::vector<unsigned char> textures_data_rgba;
@@ -487,15 +493,15 @@ void MenuDrawerGL::DrawMenuPicture(
 {
 	const r_Texture& picture= menu_pictures_[ size_t(pic) ];
 
+	const unsigned int row_count= picture.Height() / ( MenuParams::menu_picture_row_height * MenuParams::menu_pictures_shifts_count );
+
 	// Gen quad
-	Vertex vertices[ g_max_quads * 4u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( picture, row_count );
 
 	const int height= int( picture.Height() / MenuParams::menu_pictures_shifts_count );
 	const int scale_i= int(menu_scale_);
 	const int raw_height= int(MenuParams::menu_picture_row_height);
 
-	const unsigned int row_count= picture.Height() / ( MenuParams::menu_picture_row_height * MenuParams::menu_pictures_shifts_count );
-
 	for( unsigned int r= 0u; r < row_count; r++ )
 	{
 		Vertex* const v= vertices + r * 4u;
@@ -523,38 +529,12 @@ void MenuDrawerGL::DrawMenuPicture(
 		v[3].tex_coord[1]= tc_y;
 	}
 
-	const unsigned int vertex_count= row_count * 4u;
-	const unsigned int index_count= row_count * 6u;
-
-	polygon_buffer_.VertexSubData(
-		vertices,
-		vertex_count * sizeof(Vertex),
-		0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	picture.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(picture.Width()),
-			1.0f / float(picture.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawConsoleBackground( float console_pos )
 {
-	Vertex vertices[ 4u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( console_background_texture_, 1u );
 
 	const int y= static_cast<int>( float(viewport_size_.Height() ) * ( 1.0f - 0.5f * console_pos ) );
 	const int tc_top= y;
@@ -579,34 +559,14 @@ void MenuDrawerGL::DrawConsoleBackground( float console_pos )
 	vertices[3].tex_coord[0]= 0;
 	vertices[3].tex_coord[1]= tc_top / int(console_scale_);
 
-	polygon_buffer_.VertexSubData( vertices, sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	console_background_texture_.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(console_background_texture_.Width ()),
-			1.0f / float(console_background_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawLoading( const float progress )
 {
 	const float progress_corrected= std::min( std::max( progress, 0.0f ), 1.0f );
 
-	Vertex vertices[ 8u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( loading_texture_, 2u );
 
 	const int scale= int( menu_scale_ );
 	const int x0= ( int(viewport_size_.Width ()) - int(loading_texture_.Width()) * scale ) / 2;
@@ -654,32 +614,12 @@ void MenuDrawerGL::DrawLoading( const float progress )
 	vertices[7].tex_coord[0]= mid_tc;
 	vertices[7].tex_coord[1]= 0;
 
-	polygon_buffer_.VertexSubData( vertices , sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	loading_texture_.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(loading_texture_.Width ()),
-			1.0f / float(loading_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 2u * 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawPaused()
 {
-	Vertex vertices[ 4u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( pause_texture_, 1u );
 
 	const int scale= int( menu_scale_ );
 	const int x0= ( int(viewport_size_.Width ()) - int(pause_texture_.Width ()) * scale ) / 2;
@@ -707,32 +647,12 @@ void MenuDrawerGL::DrawPaused()
 	vertices[3].tex_coord[0]= 0;
 	vertices[3].tex_coord[1]= 0;
 
-	polygon_buffer_.VertexSubData( vertices , sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	pause_texture_.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(pause_texture_.Width ()),
-			1.0f / float(pause_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawGameBackground()
 {
-	Vertex vertices[ 4u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( game_background_texture_, 1u );
 
 	vertices[0].xy[0]= 0;
 	vertices[0].xy[1]= 0;
@@ -754,32 +674,12 @@ void MenuDrawerGL::DrawGameBackground()
 	vertices[3].tex_coord[0]= 0;
 	vertices[3].tex_coord[1]= 0;
 
-	polygon_buffer_.VertexSubData( vertices, sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	game_background_texture_.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(game_background_texture_.Width ()),
-			1.0f / float(game_background_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawBriefBar()
 {
-	Vertex vertices[ 4u ];
+	Vertex* const vertices= quads_batcher_->AddQuads( briefbar_texture_, 1u );
 
 	const int scale= int( menu_scale_ );
 	const int x0= ( int(viewport_size_.Width ()) - int(briefbar_texture_.Width ()) * scale ) / 2;
@@ -807,35 +707,14 @@ void MenuDrawerGL::DrawBriefBar()
 	vertices[3].tex_coord[0]= 0;
 	vertices[3].tex_coord[1]= 0;
 
-	polygon_buffer_.VertexSubData( vertices , sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	briefbar_texture_.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(briefbar_texture_.Width ()),
-			1.0f / float(briefbar_texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 void MenuDrawerGL::DrawPlayerTorso(
 	const int x, const int y, const unsigned char color )
 {
-	Vertex vertices[ 4u ];
-
 	const r_Texture& texture= player_torso_textures_[ color % GameConstants::player_colors_count ];
+	Vertex* const vertices= quads_batcher_->AddQuads( texture, 1u );
 
 	const int scale= int( menu_scale_ );
 	const int x0= x;
@@ -863,27 +742,7 @@ void MenuDrawerGL::DrawPlayerTorso(
 	vertices[3].tex_coord[0]= 0;
 	vertices[3].tex_coord[1]= 0;
 
-	polygon_buffer_.VertexSubData( vertices , sizeof(vertices), 0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	menu_picture_shader_.Bind();
-
-	texture.Bind(0u);
-	menu_picture_shader_.Uniform( "tex", int(0) );
-
-	menu_picture_shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	menu_picture_shader_.Uniform(
-		"inv_texture_size",
-		 m_Vec2(
-			1.0f / float(texture.Width ()),
-			1.0f / float(texture.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, 6u, GL_UNSIGNED_SHORT, nullptr );
+	quads_batcher_->Flush( menu_picture_shader_, g_gl_state );
 }
 
 } // namespace PanzerChasm
@@ -1,13 +1,14 @@
 #pragma once
 
-#include <glsl_program.hpp>
 #include <polygon_buffer.hpp>
 #include <texture.hpp>
 
 #include "fwd.hpp"
 #include "game_constants.hpp"
 #include "i_menu_drawer.hpp"
+#include "quads_batcher_gl.hpp"
 #include "rendering_context.hpp"
+#include "shader_program_gl.hpp"
 
 namespace PanzerChasm
 {
@@ -18,7 +19,8 @@ public:
 	MenuDrawerGL(
 		Settings& settings,
 		const RenderingContextGL& rendering_context,
-		const GameResources& game_resources );
+		const GameResources& game_resources,
+		const QuadsBatcherGLPtr& quads_batcher );
 
 	virtual ~MenuDrawerGL();
 
@@ -45,24 +47,20 @@ public:
 	virtual void DrawPlayerTorso( int x, int y, unsigned char color ) override;
 
 private:
-	struct Vertex
-	{
-		short xy[2];
-		short tex_coord[2];
-	};
+	typedef QuadsBatcherGL::Vertex Vertex;
 
 private:
 	const Size2 viewport_size_;
 	const unsigned int menu_scale_;
 	const unsigned int console_scale_;
 
-	r_GLSLProgram menu_background_shader_;
+	ShaderProgramGL menu_background_shader_;
 	r_Texture tiles_texture_;
 	r_Texture loading_texture_;
 	r_Texture game_background_texture_;
 	r_Texture pause_texture_;
 
-	r_GLSLProgram menu_picture_shader_;
+	ShaderProgramGL menu_picture_shader_;
 	r_Texture menu_pictures_[ size_t(MenuPicture::PicturesCount) ];
 
 	r_Texture framing_texture_;
@@ -73,8 +71,8 @@ private:
 
 	r_Texture player_torso_textures_[ GameConstants::player_colors_count ];
 
-	r_PolygonBuffer polygon_buffer_;
-
+	r_PolygonBuffer polygon_buffer_; // For menu background.
+	const QuadsBatcherGLPtr quads_batcher_;
 };
 
 } // namespace PanzerChasm
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include "assert.hpp"
@@ -138,10 +139,31 @@ Size2 MenuDrawerSoft::GetPictureSize( const MenuPicture picture ) const
 void MenuDrawerSoft::DrawMenuBackground(
 	const int start_x, const int start_y,
 	const unsigned int width, const unsigned int height )
+{
+	// Menu background is same in most frames, so, draw it into layer only if it changed.
+	if( !(
+		background_layer_.GetSizeX() != 0u &&
+		background_layer_params_[0] == start_x && background_layer_params_[1] == start_y &&
+		background_layer_params_[2] == int(width) && background_layer_params_[3] == int(height) ) )
+	{
+		DrawMenuBackgroundLayer( start_x, start_y, width, height );
+		background_layer_params_[0]= start_x;
+		background_layer_params_[1]= start_y;
+		background_layer_params_[2]= int(width );
+		background_layer_params_[3]= int(height);
+	}
+
+	background_layer_.Draw(
+		rendering_context_,
+		start_x - int( MenuParams::menu_border ) * int(menu_scale_),
+		start_y - int( MenuParams::menu_border + MenuParams::menu_caption ) * int(menu_scale_) );
+}
+
+void MenuDrawerSoft::DrawMenuBackgroundLayer(
+	const int start_x, const int start_y,
+	const unsigned int width, const unsigned int height )
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
-	uint32_t* const dst_pixels= rendering_context_.window_surface_data;
-	const int dst_row_pixels= rendering_context_.row_pixels;
 
 	// TODO - rewrite this method.
 	// Use more fast tiles texturing. Accept tiles texture with any size, not only 64x64.
@@ -155,6 +177,11 @@ void MenuDrawerSoft::DrawMenuBackground(
 	const int start_y_corrected= start_y - int( MenuParams::menu_border + MenuParams::menu_caption ) * int(menu_scale_);
 	const int end_y= start_y_corrected + int(height) + int( MenuParams::menu_border * 2u + MenuParams::menu_caption ) * int(menu_scale_);
 
+	// Texture coordinates are calculated from screen coordinates, so, layer content depends on position.
+	background_layer_.Reset( static_cast<unsigned int>( end_x - start_x_corrected ), static_cast<unsigned int>( end_y - start_y_corrected ) );
+	uint32_t* const dst_pixels= background_layer_.GetPixels();
+	const int dst_row_pixels= int( background_layer_.GetSizeX() );
+
 	// Tone borders
 	const unsigned char c_low= 128u;
 	const unsigned char c_middle= 192u;
@@ -178,7 +205,7 @@ void MenuDrawerSoft::DrawMenuBackground(
 			std::memcpy( components, &palette[ pic.data[ tc_y_warped * 64 + tc_x_warped ] ], sizeof(uint32_t) );
 			for( unsigned int j= 0u; j < 3u; j++ )
 				components[j]= ( components[j] * c_middle ) >> 8u;
-			std::memcpy( &dst_pixels[ x + y * dst_row_pixels ], components, sizeof(uint32_t) );
+			std::memcpy( &dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ], components, sizeof(uint32_t) );
 		}
 	}
 
@@ -204,51 +231,78 @@ void MenuDrawerSoft::DrawMenuBackground(
 	// Upper border.
 	for( int y= start_y_corrected; y < start_y_corrected + int(menu_scale_); y++ )
 	for( int x= start_x_corrected; x < end_x; x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
 	// Upper border inner.
 	for( int y= start_y_corrected + int(menu_scale_*12u); y < start_y_corrected + int(menu_scale_*12u) + int(menu_scale_); y++ )
 	for( int x= start_x_corrected + int(menu_scale_* 2u); x < end_x - int(menu_scale_* 2u); x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
 	// Lower border.
 	for( int y= end_y - int(menu_scale_); y < end_y; y++ )
 	for( int x= start_x_corrected; x < end_x; x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
 	// Lower border inner.
 	for( int y= end_y - int(menu_scale_ * 3u); y < end_y - int(menu_scale_ * 2u); y++ )
 	for( int x= start_x_corrected + int(menu_scale_* 2u); x < end_x - int(menu_scale_* 2u); x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
 	// Left border.
 	for( int y= start_y_corrected + int(menu_scale_); y < end_y - int(menu_scale_); y++ )
 	for( int x= start_x_corrected; x < start_x_corrected + int(menu_scale_); x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
 	// Left border inner.
 	for( int y= start_y_corrected + int(menu_scale_*13u); y < end_y - int(menu_scale_*2u); y++ )
 	for( int x= start_x_corrected + int(menu_scale_* 2u); x < start_x_corrected + int(menu_scale_*3u); x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
 	// Right border.
 	for( int y= start_y_corrected + int(menu_scale_); y < end_y - int(menu_scale_); y++ )
 	for( int x= end_x - int(menu_scale_); x < end_x; x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_low );
 	// Right border inner.
 	for( int y= start_y_corrected + int(menu_scale_*13u); y < end_y - int(menu_scale_*2u); y++ )
 	for( int x= end_x - int(menu_scale_*3u); x < end_x  - int(menu_scale_*2u); x++ )
-		dst_pixels[ x + y * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
+		dst_pixels[ ( x - start_x_corrected ) + ( y - start_y_corrected ) * dst_row_pixels ]= toned_texel_fetch( x, y, c_height );
+
+	background_layer_.BuildOpaqueSpans();
 }
 
 void MenuDrawerSoft::DrawMenuPicture(
 	const int start_x, const int start_y,
 	const MenuPicture picture,
 	const PictureColor* const rows_colors )
+{
+	const Picture& pic= menu_pictures_[ static_cast<size_t>(picture) ] ;
+	PictureLayer& picture_layer= menu_pictures_layers_[ static_cast<size_t>(picture) ];
+
+	const unsigned int row_count= pic.size[1] / ( MenuParams::menu_picture_row_height * MenuParams::menu_pictures_shifts_count );
+
+	// Picture changes only if rows colors changed ( selection changed ).
+	if( picture_layer.layer.GetSizeX() == 0u ||
+		!std::equal( rows_colors, rows_colors + row_count, picture_layer.rows_colors.begin() ) )
+	{
+		picture_layer.rows_colors.assign( rows_colors, rows_colors + row_count );
+		DrawMenuPictureLayer( picture, rows_colors );
+	}
+
+	PC_ASSERT( start_x >= 0 && start_x + int(picture_layer.layer.GetSizeX()) <= int(rendering_context_.viewport_size.Width ()) );
+	PC_ASSERT( start_y >= 0 && start_y + int(picture_layer.layer.GetSizeY()) <= int(rendering_context_.viewport_size.Height()) );
+	picture_layer.layer.Draw( rendering_context_, start_x, start_y );
+}
+
+void MenuDrawerSoft::DrawMenuPictureLayer(
+	const MenuPicture picture,
+	const PictureColor* const rows_colors )
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
-	uint32_t* const dst_pixels= rendering_context_.window_surface_data;
-	const int dst_row_pixels= rendering_context_.row_pixels;
 
 	const Picture& pic= menu_pictures_[ static_cast<size_t>(picture) ] ;
+	RetainedLayerSoft& layer= menu_pictures_layers_[ static_cast<size_t>(picture) ].layer;
 
 	const int picture_height= pic.size[1] / MenuParams::menu_pictures_shifts_count;
 	const int row_count= int( pic.size[1] / ( MenuParams::menu_picture_row_height * MenuParams::menu_pictures_shifts_count ) );
 
+	layer.Reset( pic.size[0] * menu_scale_, static_cast<unsigned int>( row_count ) * MenuParams::menu_picture_row_height * menu_scale_ );
+	uint32_t* const dst_pixels= layer.GetPixels();
+	const int dst_row_pixels= int( layer.GetSizeX() );
+
 	for( int row= 0; row < row_count; row++ )
 	{
 		const unsigned char* const src= pic.data.data() + int(pic.size[0]) * picture_height * int(rows_colors[row]);
@@ -264,19 +318,21 @@ void MenuDrawerSoft::DrawMenuPicture(
 
 				for( int sy= 0; sy < int(menu_scale_); sy++ )
 				{
-					const int dst_y= start_y + y * int(menu_scale_) + sy;
-					PC_ASSERT( dst_y >= 0 && dst_y < int(rendering_context_.viewport_size.Height()) );
+					const int dst_y= y * int(menu_scale_) + sy;
+					PC_ASSERT( dst_y >= 0 && dst_y < int(layer.GetSizeY()) );
 
 					for( int sx= 0; sx < int(menu_scale_); sx++ )
 					{
-						const int dst_x= start_x + x * int(menu_scale_) + sx;
-						PC_ASSERT( dst_x >= 0 && dst_x < int(rendering_context_.viewport_size.Width()) );
+						const int dst_x= x * int(menu_scale_) + sx;
+						PC_ASSERT( dst_x >= 0 && dst_x < int(layer.GetSizeX()) );
 						dst_pixels[ dst_x + dst_y * dst_row_pixels ]= color;
 					}
 				}
 			}
 		}
 	}
+
+	layer.BuildSpans();
 }
 
 void MenuDrawerSoft::DrawConsoleBackground( const float console_pos )
@@ -3,6 +3,7 @@
 #include "fwd.hpp"
 #include "i_menu_drawer.hpp"
 #include "rendering_context.hpp"
+#include "retained_layer_soft.hpp"
 
 namespace PanzerChasm
 {
@@ -45,6 +46,21 @@ private:
 		std::vector<unsigned char> data;
 	};
 
+	struct PictureLayer
+	{
+		RetainedLayerSoft layer;
+		std::vector<PictureColor> rows_colors;
+	};
+
+private:
+	void DrawMenuBackgroundLayer(
+		int x, int y,
+		unsigned int width, unsigned int height );
+
+	void DrawMenuPictureLayer(
+		MenuPicture picture,
+		const PictureColor* rows_colors );
+
 private:
 	const RenderingContextSoft rendering_context_;
 	const unsigned int menu_scale_;
@@ -60,6 +76,11 @@ private:
 	Picture console_background_picture_;
 	Picture briefbar_picture_;
 	Picture player_torso_picutre_;
+
+	// Retained layers for menu elements, redrawn only if changed.
+	PictureLayer menu_pictures_layers_[ size_t(MenuPicture::PicturesCount) ];
+	RetainedLayerSoft background_layer_;
+	int background_layer_params_[4]; // x, y, width, height
 };
 
 } // namespace PanzerChasm
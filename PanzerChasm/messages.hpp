@@ -24,7 +24,7 @@ enum class MessageId : unsigned char
 namespace Messages
 {
 
-constexpr unsigned int c_protocol_version= 106u; // Increment each time, when protocol changed.
+constexpr unsigned int c_protocol_version= 115u; // Increment each time, when protocol changed.
 
 typedef short CoordType;
 typedef unsigned short AngleType;
@@ -44,7 +44,16 @@ struct DummyNetMessage : public MessageBase
 {
 	DEFINE_MESSAGE_CONSTRUCTOR(DummyNetMessage)
 
-	char filler[7u];
+	uint32_t connection_token; // Recieved from server via tcp. Used by server for recognition of new udp connections.
+	char filler[3u];
+};
+
+// First message of each unreliable packet. Processed by messages extractor itself, handlers never get it.
+struct UnreliablePacketBegin : public MessageBase
+{
+	DEFINE_MESSAGE_CONSTRUCTOR(UnreliablePacketBegin)
+
+	unsigned short sequence; // Incremented for each packet. Used for detection of lost packets.
 };
 
 struct ServerState : public MessageBase
@@ -53,6 +62,7 @@ struct ServerState : public MessageBase
 
 	unsigned char frags[ GameConstants::max_players ];
 	unsigned short map_time_s;
+	unsigned int server_time_ms; // Time of server tick, for which update is sent. Wraps around.
 	unsigned char player_count;
 	GameRules game_rules;
 };
@@ -98,6 +108,11 @@ struct PlayerPosition : public MessageBase
 
 	CoordType xyz[3];
 	CoordType speed; // Units/s
+	CoordType speed_xyz[3]; // Units/s. Full speed vector, for client movement prediction.
+	unsigned short last_move_sequence; // Sequence number of last PlayerMove message, processed by server.
+	bool on_floor : 1;
+	bool alive : 1; // Player can move.
+	bool noclip : 1;
 };
 
 struct PlayerState : public MessageBase
@@ -195,6 +210,17 @@ struct MonsterPartBirth : public MessageBase
 	AngleType angle;
 	unsigned char monster_type;
 	unsigned char part_id;
+	unsigned char seed; // Seed for random parameters of part, generated on client.
+};
+
+// Bunch of gibs. Parameters of each gib are generated on client from seed, so, all clients see same gibs.
+struct GibsBirth : public MessageBase
+{
+	DEFINE_MESSAGE_CONSTRUCTOR(GibsBirth)
+
+	CoordType xyz[3];
+	unsigned char gib_id;
+	unsigned char seed;
 };
 
 struct MapEventSound : public MessageBase
@@ -344,14 +370,17 @@ struct PlayerMove : public MessageBase
 {
 	DEFINE_MESSAGE_CONSTRUCTOR(PlayerMove)
 
+	unsigned short sequence; // Incremented by client for each message.
 	AngleType view_direction;
 	AngleType move_direction;
 	unsigned char acceleration; // 0 - stay, 128 - walk, 255 - run
 	unsigned char weapon_index;
 	AngleType view_dir_angle_x;
 	AngleType view_dir_angle_z;
+	unsigned int view_server_time_ms; // Server time, for which client shows entities. Used for lag compensation of shots.
 	bool shoot_pressed : 1;
 	bool jump_pressed : 1;
+	bool view_server_time_valid : 1;
 	unsigned char color : 4;
 };
 
@@ -362,6 +391,14 @@ struct PlayerName : public MessageBase
 	char name[64u]; // Null-terminated
 };
 
+// Client to server. Transmited by spectator relay right after connection.
+// Server removes player of this client and sends to it full world state, not filtered for some player.
+struct RelayJoin : public MessageBase
+{
+	DEFINE_MESSAGE_CONSTRUCTOR(RelayJoin)
+	char password[32u]; // Null-terminated
+};
+
 #undef DEFINE_MESSAGE_CONSTRUCTOR
 
 #pragma pack(pop)
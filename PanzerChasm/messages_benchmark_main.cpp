@@ -0,0 +1,368 @@
+// messages_benchmark_main.cpp - entry point of headless network messages benchmark.
+// Generates streams of messages of all types, sends them via MessagesSender into loopback connection
+// and reads them back via MessagesExtractor.
+// Reports messages and bytes per second for sending and receiving and memory allocations.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "assert.hpp"
+#include "log.hpp"
+#include "loopback_buffer.hpp"
+#include "messages_extractor.inl"
+#include "messages_sender.hpp"
+#include "profiler.hpp"
+#include "program_arguments.hpp"
+#include "rand.hpp"
+
+using namespace PanzerChasm;
+
+namespace
+{
+
+const unsigned int g_default_frame_count= 20000u;
+const unsigned int g_single_type_messages_per_frame= 32u;
+
+const char* const g_messages_names[ size_t(MessageId::NumMessages) ]=
+{
+	"Unknown",
+	#define MESSAGE_FUNC(x) #x,
+	#include "messages_list.h"
+	#undef MESSAGE_FUNC
+};
+
+// Average count of messages in one server frame of multiplayer game with several players and many monsters.
+float MessagesPerFrame( const MessageId message_id )
+{
+	switch( message_id )
+	{
+	case MessageId::Unknown:
+	case MessageId::NumMessages:
+	case MessageId::UnreliablePacketBegin: // Added by sender itself.
+		return 0.0f;
+
+	case MessageId::DummyNetMessage: return 0.01f;
+	case MessageId::ServerState: return 1.0f;
+	case MessageId::MonsterState: return 30.0f;
+	case MessageId::WallPosition: return 6.0f;
+	case MessageId::PlayerSpawn: return 0.02f;
+	case MessageId::PlayerPosition: return 1.0f;
+	case MessageId::PlayerState: return 1.0f;
+	case MessageId::PlayerWeapon: return 1.0f;
+	case MessageId::PlayerItemPickup: return 0.05f;
+	case MessageId::ItemState: return 4.0f;
+	case MessageId::StaticModelState: return 6.0f;
+	case MessageId::SpriteEffectBirth: return 2.0f;
+	case MessageId::ParticleEffectBirth: return 1.0f;
+	case MessageId::FullscreenBlendEffect: return 0.1f;
+	case MessageId::MonsterPartBirth: return 0.2f;
+	case MessageId::GibsBirth: return 0.1f;
+	case MessageId::MapEventSound: return 0.5f;
+	case MessageId::MonsterLinkedSound: return 1.0f;
+	case MessageId::MonsterSound: return 0.5f;
+	case MessageId::RocketState: return 6.0f;
+	case MessageId::RocketBirth: return 0.5f;
+	case MessageId::RocketDeath: return 0.5f;
+	case MessageId::DynamicItemBirth: return 0.1f;
+	case MessageId::DynamicItemUpdate: return 2.0f;
+	case MessageId::DynamicItemDeath: return 0.1f;
+	case MessageId::LightSourceBirth: return 0.2f;
+	case MessageId::LightSourceDeath: return 0.2f;
+	case MessageId::RotatingLightSourceBirth: return 0.05f;
+	case MessageId::RotatingLightSourceDeath: return 0.05f;
+	case MessageId::MapChange: return 0.001f;
+	case MessageId::MonsterBirth: return 0.05f;
+	case MessageId::MonsterDeath: return 0.05f;
+	case MessageId::TextMessage: return 0.05f;
+	case MessageId::DynamicTextMessage: return 0.02f;
+	case MessageId::PlayerMove: return 1.0f;
+	case MessageId::PlayerName: return 0.001f;
+	case MessageId::RelayJoin: return 0.0f;
+	};
+
+	return 0.0f;
+}
+
+bool IsReliableMessage( const MessageId message_id )
+{
+	switch( message_id )
+	{
+	case MessageId::MapChange:
+	case MessageId::MonsterBirth:
+	case MessageId::MonsterDeath:
+	case MessageId::TextMessage:
+	case MessageId::DynamicTextMessage:
+	case MessageId::PlayerName:
+	case MessageId::RelayJoin:
+		return true;
+	default:
+		return false;
+	};
+}
+
+// Messages of all frames, stored in decoded form one after another.
+struct MessagesStream
+{
+	struct MessageRecord
+	{
+		MessageId id;
+		unsigned int offset;
+	};
+
+	std::vector<unsigned char> storage;
+	std::vector<MessageRecord> messages;
+	std::vector<unsigned int> frames_ends; // Indeces in messages.
+};
+
+void AddRandomMessage( const MessageId message_id, LongRand& rand, MessagesStream& stream )
+{
+	// Decode random encoded data, so, all fields (including bit-packed) have valid values.
+	unsigned char encoded_message[ 1024u ];
+	const unsigned int encoded_size= GetEncodedMessageSize( message_id );
+	PC_ASSERT( encoded_size <= sizeof(encoded_message) );
+	encoded_message[0]= static_cast<unsigned char>( message_id );
+	for( unsigned int i= 1u; i < encoded_size; i++ )
+		encoded_message[i]= static_cast<unsigned char>( rand.Rand() );
+
+	MessagesStream::MessageRecord record;
+	record.id= message_id;
+	record.offset= stream.storage.size();
+
+	switch( message_id )
+	{
+	case MessageId::Unknown:
+	case MessageId::NumMessages:
+		PC_ASSERT( false );
+		return;
+
+	#define MESSAGE_FUNC(x)\
+	case MessageId::x:\
+		{\
+			Messages::x message;\
+			Messages::DecodeMessage( encoded_message, message );\
+			stream.storage.resize( stream.storage.size() + sizeof(message) );\
+			std::memcpy( stream.storage.data() + record.offset, &message, sizeof(message) );\
+		}\
+		break;
+
+	#include "messages_list.h"
+	#undef MESSAGE_FUNC
+	};
+
+	stream.messages.push_back( record );
+}
+
+MessagesStream GenerateMixedStream( const unsigned int frame_count, const unsigned int seed )
+{
+	MessagesStream stream;
+	LongRand rand( seed );
+
+	for( unsigned int f= 0u; f < frame_count; f++ )
+	{
+		for( unsigned int id= 1u; id < size_t(MessageId::NumMessages); id++ )
+		{
+			const float messages_per_frame= MessagesPerFrame( MessageId(id) );
+			unsigned int count= static_cast<unsigned int>( messages_per_frame );
+			if( rand.RandValue( 1.0f ) < messages_per_frame - float(count) )
+				count++;
+
+			for( unsigned int i= 0u; i < count; i++ )
+				AddRandomMessage( MessageId(id), rand, stream );
+		}
+		stream.frames_ends.push_back( stream.messages.size() );
+	}
+
+	return stream;
+}
+
+MessagesStream GenerateSingleTypeStream( const MessageId message_id, const unsigned int frame_count, const unsigned int seed )
+{
+	MessagesStream stream;
+	LongRand rand( seed );
+
+	for( unsigned int f= 0u; f < frame_count; f++ )
+	{
+		for( unsigned int i= 0u; i < g_single_type_messages_per_frame; i++ )
+			AddRandomMessage( message_id, rand, stream );
+		stream.frames_ends.push_back( stream.messages.size() );
+	}
+
+	return stream;
+}
+
+template<class Message>
+void SendMessage( MessagesSender& sender, const Message& message, const bool reliable, std::true_type /* fits into unreliable packet */ )
+{
+	if( reliable )
+		sender.SendReliableMessage( message );
+	else
+		sender.SendUnreliableMessage( message );
+}
+
+template<class Message>
+void SendMessage( MessagesSender& sender, const Message& message, const bool reliable, std::false_type /* fits into unreliable packet */ )
+{
+	PC_UNUSED( reliable );
+	sender.SendReliableMessage( message );
+}
+
+void SendStreamMessage( MessagesSender& sender, const MessagesStream& stream, const MessagesStream::MessageRecord& record )
+{
+	const bool reliable= IsReliableMessage( record.id );
+
+	switch( record.id )
+	{
+	case MessageId::Unknown:
+	case MessageId::NumMessages:
+		PC_ASSERT( false );
+		break;
+
+	#define MESSAGE_FUNC(x)\
+	case MessageId::x:\
+		{\
+			Messages::x message;\
+			std::memcpy( &message, stream.storage.data() + record.offset, sizeof(message) );\
+			SendMessage(\
+				sender, message, reliable,\
+				std::integral_constant< bool, sizeof(Messages::x) <= c_max_unreliable_packet_messages_size >() );\
+		}\
+		break;
+
+	#include "messages_list.h"
+	#undef MESSAGE_FUNC
+	};
+}
+
+struct MessagesCounter
+{
+	uint64_t count= 0u;
+
+	template<class Message>
+	void operator()( const Message& message )
+	{
+		PC_UNUSED( message );
+		count++;
+	}
+};
+
+struct RunStats
+{
+	uint64_t messages;
+	uint64_t bytes; // Encoded, after compression.
+	uint64_t received_messages;
+	uint64_t send_time_ns;
+	uint64_t receive_time_ns;
+	Profiler::AllocationsCounters allocations;
+	bool broken;
+};
+
+RunStats RunStream( const MessagesStream& stream )
+{
+	LoopbackBuffer loopback_buffer;
+	loopback_buffer.RequestConnect();
+	const IConnectionPtr server_connection= loopback_buffer.GetNewConnection();
+	const IConnectionPtr client_connection= loopback_buffer.GetClientSideConnection();
+	PC_ASSERT( server_connection != nullptr && client_connection != nullptr );
+
+	MessagesSender sender( server_connection );
+	MessagesExtractor extractor( client_connection );
+	MessagesCounter counter;
+
+	RunStats stats;
+	stats.messages= stream.messages.size();
+	stats.send_time_ns= 0u;
+	stats.receive_time_ns= 0u;
+
+	const Profiler::AllocationsCounters start_allocations= Profiler::GetTotalAllocations();
+
+	unsigned int message_index= 0u;
+	for( const unsigned int frame_end : stream.frames_ends )
+	{
+		const uint64_t send_start_time_ns= Profiler::GetTimeNs();
+		for( ; message_index < frame_end; message_index++ )
+			SendStreamMessage( sender, stream, stream.messages[ message_index ] );
+		sender.Flush();
+
+		const uint64_t receive_start_time_ns= Profiler::GetTimeNs();
+		extractor.ProcessMessages( counter );
+		const uint64_t end_time_ns= Profiler::GetTimeNs();
+
+		stats.send_time_ns+= receive_start_time_ns - send_start_time_ns;
+		stats.receive_time_ns+= end_time_ns - receive_start_time_ns;
+	}
+
+	const Profiler::AllocationsCounters end_allocations= Profiler::GetTotalAllocations();
+	stats.allocations.count= end_allocations.count - start_allocations.count;
+	stats.allocations.bytes= end_allocations.bytes - start_allocations.bytes;
+
+	const NetTrafficCounters& traffic_counters= sender.GetTrafficCounters();
+	stats.bytes= traffic_counters.reliable_bytes + traffic_counters.unreliable_bytes;
+	stats.received_messages= counter.count;
+	stats.broken= extractor.IsBroken();
+
+	return stats;
+}
+
+bool PrintStats( const char* const name, const RunStats& stats, const unsigned int frame_count )
+{
+	const double send_time_s= std::max( double(stats.send_time_ns) * 1.0e-9, 1.0e-9 );
+	const double receive_time_s= std::max( double(stats.receive_time_ns) * 1.0e-9, 1.0e-9 );
+
+	Log::Info(
+		"  ", name, ": ", stats.messages, " messages, ", stats.bytes / stats.messages, " bytes/message",
+		", send: ", static_cast<unsigned int>( double(stats.messages) / send_time_s / 1000.0 ), " kmsg/s ",
+		static_cast<unsigned int>( double(stats.bytes) / send_time_s / ( 1024.0 * 1024.0 ) ), " MB/s",
+		", receive: ", static_cast<unsigned int>( double(stats.messages) / receive_time_s / 1000.0 ), " kmsg/s ",
+		static_cast<unsigned int>( double(stats.bytes) / receive_time_s / ( 1024.0 * 1024.0 ) ), " MB/s",
+		", allocations per frame: ", float( double(stats.allocations.count) / double(frame_count) ),
+		" (", stats.allocations.bytes / frame_count, " bytes)" );
+
+	if( stats.broken || stats.received_messages != stats.messages )
+	{
+		Log::Warning( "  ", name, ": stream is broken, received ", stats.received_messages, " messages of ", stats.messages );
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	const ProgramArguments program_arguments( argc, argv );
+
+	unsigned int frame_count= g_default_frame_count;
+	if( const char* const frames_str= program_arguments.GetParamValue( "frames" ) )
+		frame_count= static_cast<unsigned int>( std::max( 1, std::atoi( frames_str ) ) );
+
+	Profiler::SetAllocationsTrackingEnabled( true );
+
+	bool all_ok= true;
+
+	Log::Info( "Mixed stream of ", frame_count, " frames" );
+	{
+		const MessagesStream stream= GenerateMixedStream( frame_count, 0u );
+		all_ok&= PrintStats( "mixed", RunStream( stream ), frame_count );
+	}
+
+	// Use less frames for single type streams, because there are many types.
+	const unsigned int single_type_frame_count= std::max( 1u, frame_count / 10u );
+	Log::Info( "Single type streams of ", single_type_frame_count, " frames, ", g_single_type_messages_per_frame, " messages per frame" );
+	for( unsigned int id= 1u; id < size_t(MessageId::NumMessages); id++ )
+	{
+		if( MessageId(id) == MessageId::UnreliablePacketBegin )
+			continue;
+
+		const MessagesStream stream= GenerateSingleTypeStream( MessageId(id), single_type_frame_count, id );
+		all_ok&= PrintStats( g_messages_names[id], RunStream( stream ), single_type_frame_count );
+	}
+
+	return all_ok ? 0 : -1;
+}
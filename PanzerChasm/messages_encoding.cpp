@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "assert.hpp"
+
+#include "messages_encoding.hpp"
+
+namespace PanzerChasm
+{
+
+namespace
+{
+
+// Quantization profile of positions and angles.
+// Map coordinates are in range [0; 64], so, 1/128 precision with 15 bits is enough for xy.
+// Heights are small, so, keep full precision for z.
+const unsigned int g_xy_bits= 15u;
+const unsigned int g_xy_dropped_bits= 1u;
+const unsigned int g_z_bits= 13u;
+const unsigned int g_z_dropped_bits= 0u;
+const unsigned int g_angle_bits= 10u;
+
+class BitWriter final
+{
+public:
+	explicit BitWriter( unsigned char* const data )
+		: data_(data)
+	{}
+
+	void Write( const uint32_t value, const unsigned int bits )
+	{
+		for( unsigned int i= 0u; i < bits; i++, bit_pos_++ )
+		{
+			unsigned char& byte= data_[ bit_pos_ >> 3u ];
+			if( ( bit_pos_ & 7u ) == 0u )
+				byte= 0u;
+			byte|= static_cast<unsigned char>( ( ( value >> i ) & 1u ) << ( bit_pos_ & 7u ) );
+		}
+	}
+
+	template<class T>
+	void UnsignedField( const T& value, const unsigned int bits )
+	{
+		const uint32_t max_value= ( 1u << bits ) - 1u;
+		Write( std::min( static_cast<uint32_t>(value), max_value ), bits );
+	}
+
+	template<class T>
+	void SignedField( const T& value, const unsigned int bits, const unsigned int dropped_bits )
+	{
+		const int32_t half_range= 1 << ( bits - 1u );
+		const int32_t rounded= ( int32_t(value) + ( ( 1 << dropped_bits ) >> 1 ) ) >> dropped_bits;
+		const int32_t quantized= std::max( -half_range, std::min( rounded, half_range - 1 ) );
+		Write( static_cast<uint32_t>( quantized + half_range ), bits );
+	}
+
+	void AngleField( const Messages::AngleType& angle, const unsigned int bits )
+	{
+		// Round angle to nearest value. Wrapping of angle is fine.
+		const unsigned int dropped_bits= 16u - bits;
+		const uint32_t rounded= ( uint32_t(angle) + ( ( 1u << dropped_bits ) >> 1u ) ) & 0xFFFFu;
+		Write( rounded >> dropped_bits, bits );
+	}
+
+	void BoolField( const bool value )
+	{
+		Write( value ? 1u : 0u, 1u );
+	}
+
+	unsigned int GetSize() const
+	{
+		return ( bit_pos_ + 7u ) >> 3u;
+	}
+
+private:
+	unsigned char* const data_;
+	unsigned int bit_pos_= 0u;
+};
+
+class BitReader final
+{
+public:
+	explicit BitReader( const unsigned char* const data )
+		: data_(data)
+	{}
+
+	uint32_t Read( const unsigned int bits )
+	{
+		uint32_t result= 0u;
+		for( unsigned int i= 0u; i < bits; i++, bit_pos_++ )
+			result|= uint32_t( ( data_[ bit_pos_ >> 3u ] >> ( bit_pos_ & 7u ) ) & 1u ) << i;
+		return result;
+	}
+
+	template<class T>
+	void UnsignedField( T& value, const unsigned int bits )
+	{
+		value= static_cast<T>( Read( bits ) );
+	}
+
+	template<class T>
+	void SignedField( T& value, const unsigned int bits, const unsigned int dropped_bits )
+	{
+		const int32_t half_range= 1 << ( bits - 1u );
+		value= static_cast<T>( ( int32_t( Read( bits ) ) - half_range ) * ( 1 << dropped_bits ) );
+	}
+
+	void AngleField( Messages::AngleType& angle, const unsigned int bits )
+	{
+		angle= static_cast<Messages::AngleType>( Read( bits ) << ( 16u - bits ) );
+	}
+
+	void BoolField( bool& value )
+	{
+		value= Read( 1u ) != 0u;
+	}
+
+private:
+	const unsigned char* const data_;
+	unsigned int bit_pos_= 0u;
+};
+
+template<class Stream, class Coord>
+void SerializePosition( Stream& stream, Coord* const xyz )
+{
+	stream.SignedField( xyz[0], g_xy_bits, g_xy_dropped_bits );
+	stream.SignedField( xyz[1], g_xy_bits, g_xy_dropped_bits );
+	stream.SignedField( xyz[2], g_z_bits, g_z_dropped_bits );
+}
+
+// Bit-field members can not be passed by reference, so, process flags via temporary variables.
+#define SERIALIZE_BOOL( stream, m ) { bool b= m; stream.BoolField( b ); m= b; }
+#define SERIALIZE_UNSIGNED_BIT_FIELD( stream, m, bits ) { unsigned int v= m; stream.UnsignedField( v, bits ); m= v; }
+
+template<class Stream, class Message>
+void SerializeMessageId( Stream& stream, Message& message )
+{
+	unsigned char id= static_cast<unsigned char>( message.message_id );
+	stream.UnsignedField( id, 8u );
+	message.message_id= static_cast<MessageId>( id );
+}
+
+template<class Stream>
+void SerializeFields( Stream& stream, Messages::MonsterState& message )
+{
+	SerializeMessageId( stream, message );
+	stream.UnsignedField( message.monster_id, 16u );
+	SerializePosition( stream, message.xyz );
+	stream.AngleField( message.angle, g_angle_bits );
+	stream.UnsignedField( message.monster_type, 8u );
+	stream.UnsignedField( message.body_parts_mask, 8u );
+	stream.UnsignedField( message.animation, 8u );
+	stream.UnsignedField( message.animation_frame, 10u );
+	SERIALIZE_BOOL( stream, message.is_fully_dead );
+	SERIALIZE_BOOL( stream, message.is_invisible );
+	SERIALIZE_UNSIGNED_BIT_FIELD( stream, message.color, 4u );
+}
+
+template<class Stream>
+void SerializeFields( Stream& stream, Messages::WallPosition& message )
+{
+	SerializeMessageId( stream, message );
+	stream.UnsignedField( message.wall_index, 16u );
+	for( unsigned int i= 0u; i < 2u; i++ )
+	for( unsigned int j= 0u; j < 2u; j++ )
+		stream.SignedField( message.vertices_xy[i][j], g_xy_bits, g_xy_dropped_bits );
+	stream.SignedField( message.z, g_z_bits, g_z_dropped_bits );
+	stream.UnsignedField( message.texture_id, 8u );
+}
+
+template<class Stream>
+void SerializeFields( Stream& stream, Messages::StaticModelState& message )
+{
+	SerializeMessageId( stream, message );
+	stream.UnsignedField( message.static_model_index, 16u );
+	SerializePosition( stream, message.xyz );
+	stream.AngleField( message.angle, g_angle_bits );
+	stream.UnsignedField( message.animation_frame, 12u );
+	stream.BoolField( message.visible );
+	stream.BoolField( message.animation_playing );
+	stream.UnsignedField( message.model_id, 8u );
+}
+
+template<class Stream>
+void SerializeFields( Stream& stream, Messages::RocketState& message )
+{
+	SerializeMessageId( stream, message );
+	stream.UnsignedField( message.rocket_id, 16u );
+	SerializePosition( stream, message.xyz );
+	stream.AngleField( message.angle[0], g_angle_bits );
+	stream.AngleField( message.angle[1], g_angle_bits );
+}
+
+// Needed, because RocketBirth is derived from RocketState.
+// Without exact overload, RocketBirth would be encoded as RocketState.
+template<class Stream>
+void SerializeFields( Stream& stream, Messages::RocketBirth& message )
+{
+	SerializeFields( stream, static_cast<Messages::RocketState&>( message ) );
+	stream.UnsignedField( message.rocket_type, 8u );
+}
+
+#undef SERIALIZE_BOOL
+#undef SERIALIZE_UNSIGNED_BIT_FIELD
+
+// Messages without profile are transmitted as is.
+template<class Message>
+unsigned int EncodeMessageImpl( const Message& message, unsigned char* const out_data, ... )
+{
+	std::memcpy( out_data, &message, sizeof(Message) );
+	return sizeof(Message);
+}
+
+template<class Message>
+void DecodeMessageImpl( const unsigned char* const data, Message& out_message, ... )
+{
+	std::memcpy( &out_message, data, sizeof(Message) );
+}
+
+template<class Message>
+auto EncodeMessageImpl( const Message& message, unsigned char* const out_data, int )
+	-> decltype( SerializeFields( std::declval<BitWriter&>(), std::declval<Message&>() ), 0u )
+{
+	Message message_copy= message;
+	BitWriter writer( out_data );
+	SerializeFields( writer, message_copy );
+	return writer.GetSize();
+}
+
+template<class Message>
+auto DecodeMessageImpl( const unsigned char* const data, Message& out_message, int )
+	-> decltype( SerializeFields( std::declval<BitReader&>(), out_message ), void() )
+{
+	BitReader reader( data );
+	SerializeFields( reader, out_message );
+}
+
+class EncodedMessagesSizes final
+{
+public:
+	EncodedMessagesSizes()
+	{
+		sizes_[ size_t(MessageId::Unknown) ]= sizeof(Messages::MessageBase);
+
+		#define MESSAGE_FUNC(x)\
+		{\
+			Messages::x message;\
+			std::memset( static_cast<void*>( &message ), 0, sizeof(message) );\
+			unsigned char buffer[ sizeof(Messages::x) ];\
+			sizes_[ size_t(MessageId::x) ]= EncodeMessageImpl( message, buffer, 0 );\
+			PC_ASSERT( sizes_[ size_t(MessageId::x) ] <= sizeof(Messages::x) );\
+		}
+
+		#include "messages_list.h"
+		#undef MESSAGE_FUNC
+	}
+
+	unsigned int GetSize( const MessageId message_id ) const
+	{
+		PC_ASSERT( message_id < MessageId::NumMessages );
+		return sizes_[ size_t(message_id) ];
+	}
+
+private:
+	unsigned int sizes_[ size_t(MessageId::NumMessages) ];
+};
+
+const EncodedMessagesSizes g_encoded_messages_sizes;
+
+} // namespace
+
+namespace Messages
+{
+
+#define MESSAGE_FUNC(x)\
+	unsigned int EncodeMessage( const x& message, unsigned char* const out_data )\
+	{\
+		return EncodeMessageImpl( message, out_data, 0 );\
+	}\
+	void DecodeMessage( const unsigned char* const data, x& out_message )\
+	{\
+		DecodeMessageImpl( data, out_message, 0 );\
+	}
+
+#include "messages_list.h"
+#undef MESSAGE_FUNC
+
+} // namespace Messages
+
+unsigned int GetEncodedMessageSize( const MessageId message_id )
+{
+	return g_encoded_messages_sizes.GetSize( message_id );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,38 @@
+#pragma once
+#include "messages.hpp"
+
+namespace PanzerChasm
+{
+
+// Messages are transmitted in encoded form.
+// Frequent entity updates are bit-packed, with reduced bit width and quantization of fields.
+// Other messages are transmitted as is.
+// Encoded form of each message type has fixed size, not bigger, than size of message structure.
+// First byte of encoded message is always message id.
+namespace Messages
+{
+
+#define MESSAGE_FUNC(x)\
+	unsigned int EncodeMessage( const x& message, unsigned char* out_data );\
+	void DecodeMessage( const unsigned char* data, x& out_message );
+
+#include "messages_list.h"
+#undef MESSAGE_FUNC
+
+} // namespace Messages
+
+unsigned int GetEncodedMessageSize( MessageId message_id );
+
+// Reliable messages are transmitted in frames. Each frame contains only whole messages.
+// Frame data may be compressed.
+constexpr unsigned int c_max_reliable_frame_data_size= 8192u;
+
+#pragma pack(push, 1)
+struct ReliableFrameHeader
+{
+	uint16_t data_size;
+	uint16_t compressed_size; // Zero, if data is not compressed.
+};
+#pragma pack(pop)
+
+} // namespace PanzerChasm
@@ -3,15 +3,6 @@
 namespace PanzerChasm
 {
 
-size_t MessagesExtractor::c_messages_size[ size_t(MessageId::NumMessages) ]=
-{
-	sizeof(Messages::MessageBase),
-
-	#define MESSAGE_FUNC(x) sizeof(Messages::x),
-	#include "messages_list.h"
-	#undef MESSAGE_FUNC
-};
-
 MessagesExtractor::MessagesExtractor( IConnectionPtr connection )
 	: connection_(std::move(connection))
 {}
@@ -19,4 +10,36 @@ MessagesExtractor::MessagesExtractor( IConnectionPtr connection )
 MessagesExtractor::~MessagesExtractor()
 {}
 
+const NetTrafficCounters& MessagesExtractor::GetTrafficCounters() const
+{
+	return traffic_counters_;
+}
+
+void MessagesExtractor::ProcessUnreliablePacketBegin( const Messages::UnreliablePacketBegin& message )
+{
+	traffic_counters_.unreliable_packets++;
+
+	if( !have_unreliable_packet_sequence_ )
+	{
+		have_unreliable_packet_sequence_= true;
+		expected_unreliable_packet_sequence_= static_cast<unsigned short>( message.sequence + 1u );
+		return;
+	}
+
+	const short sequence_delta= static_cast<short>( static_cast<unsigned short>( message.sequence - expected_unreliable_packet_sequence_ ) );
+	if( sequence_delta >= 0 )
+	{
+		// Packets between expected and recieved are lost - or will come later.
+		traffic_counters_.lost_unreliable_packets+= static_cast<unsigned int>(sequence_delta);
+		expected_unreliable_packet_sequence_= static_cast<unsigned short>( message.sequence + 1u );
+	}
+	else
+	{
+		// Packet, counted as lost, came out of order.
+		traffic_counters_.late_unreliable_packets++;
+		if( traffic_counters_.lost_unreliable_packets > 0u )
+			traffic_counters_.lost_unreliable_packets--;
+	}
+}
+
 } // namespace PanzerChasm
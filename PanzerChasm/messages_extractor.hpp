@@ -3,6 +3,8 @@
 #include "fwd.hpp"
 #include "i_connection.hpp"
 #include "messages.hpp"
+#include "messages_encoding.hpp"
+#include "net_statistics.hpp"
 
 namespace PanzerChasm
 {
@@ -21,18 +23,45 @@ public:
 		return broken_;
 	}
 
+	const NetTrafficCounters& GetTrafficCounters() const;
+
+private:
+	// Returns size of processed data.
+	template<class MessagesHandler>
+	unsigned int ProcessReliableFrames( const unsigned char* buffer, unsigned int buffer_size, MessagesHandler& messages_handler );
+
+	template<class MessagesHandler>
+	unsigned int ProcessMessagesInBuffer( const unsigned char* buffer, unsigned int buffer_size, MessagesHandler& messages_handler );
+
+	// Entries of per-handler dispatch table.
+	template<class MessagesHandler, class Message>
+	void DecodeAndProcessMessage( const unsigned char* data, MessagesHandler& messages_handler );
+
+	template<class MessagesHandler, class Message>
+	void ProcessMessage( const Message& message, MessagesHandler& messages_handler );
+	template<class MessagesHandler>
+	void ProcessMessage( const Messages::UnreliablePacketBegin& message, MessagesHandler& messages_handler );
+
+	void ProcessUnreliablePacketBegin( const Messages::UnreliablePacketBegin& message );
+
 private:
-	static size_t c_messages_size[ size_t(MessageId::NumMessages) ];
 	static constexpr unsigned int c_buffer_size= IConnection::c_max_unreliable_packet_size * 2u;
 
 	IConnectionPtr connection_;
 	bool broken_= false;
 
-	unsigned char reliable_buffer_[ c_buffer_size ];
+	// Buffer for one compressed frame and buffer for its decompressed data.
+	unsigned char reliable_buffer_[ sizeof(ReliableFrameHeader) + c_max_reliable_frame_data_size ];
 	unsigned int reliable_buffer_pos_= 0u;
+	unsigned char reliable_frame_data_[ c_max_reliable_frame_data_size ];
 
 	unsigned char unreliable_buffer_[ c_buffer_size ];
 	unsigned int unreliable_buffer_pos_= 0u;
+
+	bool have_unreliable_packet_sequence_= false;
+	unsigned short expected_unreliable_packet_sequence_= 0u;
+
+	NetTrafficCounters traffic_counters_;
 };
 
 } // namespace PanzerChasm
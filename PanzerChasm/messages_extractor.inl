@@ -2,7 +2,9 @@
 
 #include "assert.hpp"
 #include "i_connection.hpp"
+#include "lz_compression.hpp"
 #include "messages.hpp"
+#include "messages_encoding.hpp"
 
 #include "messages_extractor.hpp"
 
@@ -14,77 +16,198 @@ void MessagesExtractor::ProcessMessages( MessagesHandler& messages_handler )
 {
 	if( broken_ ) return;
 
-	for( unsigned int i= 0u; i < 2u; i++ ) // for reliable and unreliable messages
+	// Fast path for in-process connections - process data right in connection buffer.
+	// Data, which can not be processed in place (partial frame or message at end of contiguous part), is read in regular way.
+	while( reliable_buffer_pos_ == 0u )
 	{
-		unsigned char* const buffer= i == 0u ? reliable_buffer_ : unreliable_buffer_;
-		unsigned int& buffer_pos= i == 0u ? reliable_buffer_pos_ : unreliable_buffer_pos_;
-		const unsigned int max_buffer_size= i == 0u ? sizeof(reliable_buffer_) : sizeof(unreliable_buffer_);
+		unsigned int data_size;
+		const unsigned char* const data= connection_->PeekReliableData( data_size );
+		if( data == nullptr || data_size == 0u )
+			break;
+
+		const unsigned int processed_size= ProcessReliableFrames( data, data_size, messages_handler );
+		if( broken_ )
+			return;
+
+		connection_->SkipReliableData( processed_size );
+		if( processed_size < data_size )
+			break;
+	}
 
-		while(1)
-		{
-			unsigned int bytes_to_process= buffer_pos;
-			unsigned int bytes_read= 0u;
-			if( i == 0u )
-				bytes_read=
-					connection_->ReadRealiableData(
-						buffer + buffer_pos,
-						max_buffer_size - buffer_pos );
-			else
-				bytes_read=
-					connection_->ReadUnrealiableData(
-						buffer + buffer_pos,
-						max_buffer_size - buffer_pos );
-
-			bytes_to_process+= bytes_read;
-
-			if( bytes_to_process == 0u || bytes_read == 0u )
-				break;
-
-			unsigned int pos= 0u;
-			while(1)
-			{
-				if( bytes_to_process - pos < sizeof(MessageId) )
-					break;
+	// Reliable messages are transmitted in frames.
+	while(1)
+	{
+		const unsigned int bytes_read=
+			connection_->ReadRealiableData(
+				reliable_buffer_ + reliable_buffer_pos_,
+				sizeof(reliable_buffer_) - reliable_buffer_pos_ );
 
-				const unsigned char* const msg_ptr= buffer + pos;
+		const unsigned int bytes_to_process= reliable_buffer_pos_ + bytes_read;
+		if( bytes_to_process == 0u || bytes_read == 0u )
+			break;
 
-				MessageId message_id;
-				std::memcpy( &message_id, msg_ptr, sizeof(MessageId) );
+		const unsigned int pos= ProcessReliableFrames( reliable_buffer_, bytes_to_process, messages_handler );
+		if( broken_ )
+			return;
 
-				if( message_id >= MessageId::NumMessages || message_id <= MessageId::Unknown )
-				{
-					// TODO - handel error
-					PC_ASSERT( false );
-				}
+		std::memmove( reliable_buffer_, reliable_buffer_ + pos, bytes_to_process - pos );
+		reliable_buffer_pos_= bytes_to_process - pos;
+	}
 
-				const unsigned int message_size= c_messages_size[ size_t(message_id) ];
-				if( pos + message_size > bytes_to_process )
-					break;
+	while( unreliable_buffer_pos_ == 0u )
+	{
+		unsigned int data_size;
+		const unsigned char* const data= connection_->PeekUnreliableData( data_size );
+		if( data == nullptr || data_size == 0u )
+			break;
+
+		const unsigned int processed_size= ProcessMessagesInBuffer( data, data_size, messages_handler );
+		if( broken_ )
+			return;
+
+		traffic_counters_.unreliable_bytes+= processed_size;
+		connection_->SkipUnreliableData( processed_size );
+		if( processed_size < data_size )
+			break;
+	}
 
-				switch(message_id)
-				{
-				case MessageId::Unknown:
-				case MessageId::NumMessages:
-					broken_= true;
-					return;
+	while(1)
+	{
+		const unsigned int bytes_read=
+			connection_->ReadUnrealiableData(
+				unreliable_buffer_ + unreliable_buffer_pos_,
+				sizeof(unreliable_buffer_) - unreliable_buffer_pos_ );
 
-				#define MESSAGE_FUNC(x)\
-				case MessageId::x:\
-					messages_handler( *reinterpret_cast<const Messages::x*>( msg_ptr ) );\
-					break;
+		const unsigned int bytes_to_process= unreliable_buffer_pos_ + bytes_read;
+		if( bytes_to_process == 0u || bytes_read == 0u )
+			break;
 
-				#include "messages_list.h"
-				#undef MESSAGE_FUNC
+		traffic_counters_.unreliable_bytes+= bytes_read;
 
-				};
+		const unsigned int pos= ProcessMessagesInBuffer( unreliable_buffer_, bytes_to_process, messages_handler );
+		if( broken_ )
+			return;
 
-				pos+= message_size;
-			} // for messages in buffer
+		std::memmove( unreliable_buffer_, unreliable_buffer_ + pos, bytes_to_process - pos );
+		unreliable_buffer_pos_= bytes_to_process - pos;
+	}
+}
 
-			std::memmove( buffer, buffer + pos, bytes_to_process - pos );
-			buffer_pos= bytes_to_process - pos;
+template<class MessagesHandler>
+unsigned int MessagesExtractor::ProcessReliableFrames(
+	const unsigned char* const buffer, const unsigned int buffer_size,
+	MessagesHandler& messages_handler )
+{
+	unsigned int pos= 0u;
+	while( buffer_size - pos >= sizeof(ReliableFrameHeader) )
+	{
+		ReliableFrameHeader header;
+		std::memcpy( &header, buffer + pos, sizeof(ReliableFrameHeader) );
+
+		const unsigned int frame_payload_size= header.compressed_size == 0u ? header.data_size : header.compressed_size;
+		if( header.data_size > c_max_reliable_frame_data_size || frame_payload_size > c_max_reliable_frame_data_size )
+		{
+			broken_= true;
+			return pos;
+		}
+		if( pos + sizeof(ReliableFrameHeader) + frame_payload_size > buffer_size )
+			break;
+
+		traffic_counters_.reliable_frames++;
+		traffic_counters_.reliable_bytes+= sizeof(ReliableFrameHeader) + frame_payload_size;
+
+		const unsigned char* frame_data= buffer + pos + sizeof(ReliableFrameHeader);
+		if( header.compressed_size != 0u )
+		{
+			if( LzDecompress( frame_data, header.compressed_size, reliable_frame_data_, sizeof(reliable_frame_data_) ) != header.data_size )
+			{
+				broken_= true;
+				return pos;
+			}
+			frame_data= reliable_frame_data_;
 		}
+
+		// Frame must contain only whole messages.
+		if( ProcessMessagesInBuffer( frame_data, header.data_size, messages_handler ) != header.data_size )
+			broken_= true;
+		if( broken_ )
+			return pos;
+
+		pos+= sizeof(ReliableFrameHeader) + frame_payload_size;
 	}
+
+	return pos;
+}
+
+template<class MessagesHandler>
+unsigned int MessagesExtractor::ProcessMessagesInBuffer(
+	const unsigned char* const buffer, const unsigned int buffer_size,
+	MessagesHandler& messages_handler )
+{
+	// Table of decode functions for each message id, specialized for this handler type.
+	// Contains only function pointers, so, it is initialized at compile time.
+	typedef void (MessagesExtractor::*ProcessFunc)( const unsigned char*, MessagesHandler& );
+	static const ProcessFunc c_process_funcs[ size_t(MessageId::NumMessages) ]=
+	{
+		nullptr, // Unknown
+		#define MESSAGE_FUNC(x) &MessagesExtractor::DecodeAndProcessMessage<MessagesHandler, Messages::x>,
+		#include "messages_list.h"
+		#undef MESSAGE_FUNC
+	};
+
+	unsigned int pos= 0u;
+	while(1)
+	{
+		if( buffer_size - pos < sizeof(MessageId) )
+			break;
+
+		const unsigned char* const msg_ptr= buffer + pos;
+
+		MessageId message_id;
+		std::memcpy( &message_id, msg_ptr, sizeof(MessageId) );
+
+		// Single unsigned comparison for both "Unknown" and out of range ids.
+		if( static_cast<unsigned int>(message_id) - 1u >= static_cast<unsigned int>(MessageId::NumMessages) - 1u )
+		{
+			// TODO - handel error
+			PC_ASSERT( false );
+			broken_= true;
+			return pos;
+		}
+
+		const unsigned int message_size= GetEncodedMessageSize( message_id );
+		if( pos + message_size > buffer_size )
+			break;
+
+		traffic_counters_.AddMessage( msg_ptr, message_size );
+
+		( this->*c_process_funcs[ size_t(message_id) ] )( msg_ptr, messages_handler );
+
+		pos+= message_size;
+	} // for messages in buffer
+
+	return pos;
+}
+
+template<class MessagesHandler, class Message>
+void MessagesExtractor::DecodeAndProcessMessage( const unsigned char* const data, MessagesHandler& messages_handler )
+{
+	Message message;
+	Messages::DecodeMessage( data, message );
+	ProcessMessage<MessagesHandler>( message, messages_handler );
+}
+
+template<class MessagesHandler, class Message>
+void MessagesExtractor::ProcessMessage( const Message& message, MessagesHandler& messages_handler )
+{
+	messages_handler( message );
+}
+
+template<class MessagesHandler>
+void MessagesExtractor::ProcessMessage( const Messages::UnreliablePacketBegin& message, MessagesHandler& messages_handler )
+{
+	PC_UNUSED( messages_handler );
+	ProcessUnreliablePacketBegin( message );
 }
 
 } // namespace PanzerChasm
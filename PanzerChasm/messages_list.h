@@ -4,6 +4,7 @@
 #endif
 
 MESSAGE_FUNC(DummyNetMessage)
+MESSAGE_FUNC(UnreliablePacketBegin)
 
 MESSAGE_FUNC(ServerState)
 MESSAGE_FUNC(MonsterState)
@@ -19,6 +20,7 @@ MESSAGE_FUNC(SpriteEffectBirth)
 MESSAGE_FUNC(ParticleEffectBirth)
 MESSAGE_FUNC(FullscreenBlendEffect)
 MESSAGE_FUNC(MonsterPartBirth)
+MESSAGE_FUNC(GibsBirth)
 MESSAGE_FUNC(MapEventSound)
 MESSAGE_FUNC(MonsterLinkedSound)
 MESSAGE_FUNC(MonsterSound)
@@ -45,3 +47,4 @@ MESSAGE_FUNC(PlayerMove)
 
 // Reliable client to server
 MESSAGE_FUNC(PlayerName)
+MESSAGE_FUNC(RelayJoin)
@@ -2,31 +2,120 @@
 
 #include "assert.hpp"
 #include "i_connection.hpp"
+#include "lz_compression.hpp"
 
 #include "messages_sender.hpp"
 
 namespace PanzerChasm
 {
 
+// Small frames are not compressed - usually, there is nothing to compress.
+static const unsigned int g_min_compressed_frame_size= 128u;
+
+void MessagesBuffer::Clear()
+{
+	reliable_messages_.clear();
+	unreliable_messages_.clear();
+	unreliable_packets_ends_.clear();
+}
+
+void MessagesBuffer::AddReliableMessageImpl( const void* const data, const unsigned int size )
+{
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	reliable_messages_.insert( reliable_messages_.end(), bytes, bytes + size );
+}
+
+void MessagesBuffer::AddUnreliableMessageImpl( const void* const data, const unsigned int size )
+{
+	// Start new packet, if message does not fit into last packet.
+	const unsigned int packet_count= unreliable_packets_ends_.size();
+	const unsigned int last_packet_start= packet_count >= 2u ? unreliable_packets_ends_[ packet_count - 2u ] : 0u;
+	if( packet_count == 0u ||
+		unreliable_messages_.size() + size - last_packet_start > c_max_unreliable_packet_messages_size )
+		unreliable_packets_ends_.push_back( unreliable_messages_.size() );
+
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	unreliable_messages_.insert( unreliable_messages_.end(), bytes, bytes + size );
+	unreliable_packets_ends_.back()= unreliable_messages_.size();
+}
+
 MessagesSender::MessagesSender( IConnectionPtr connection )
 	: connection_( std::move(connection) )
-{}
+{
+	reliable_frame_data_.reserve( c_max_reliable_frame_data_size );
+}
 
 MessagesSender::~MessagesSender()
-{}
+{
+	FlushReliableFrame();
+}
+
+void MessagesSender::SendMessages( const MessagesBuffer& messages_buffer )
+{
+	// Add messages one by one, because frames must contain only whole messages.
+	const std::vector<unsigned char>& reliable_messages= messages_buffer.reliable_messages_;
+	for( unsigned int pos= 0u; pos < reliable_messages.size(); )
+	{
+		const unsigned int message_size= GetEncodedMessageSize( static_cast<MessageId>( reliable_messages[pos] ) );
+		SendReliableMessageImpl( reliable_messages.data() + pos, message_size );
+		pos+= message_size;
+	}
+
+	unsigned int packet_start= 0u;
+	for( const unsigned int packet_end : messages_buffer.unreliable_packets_ends_ )
+	{
+		const unsigned int packet_size= packet_end - packet_start;
+		if( unreliable_messages_buffer_pos_ + packet_size > sizeof(unreliable_messages_buffer_) )
+			Flush();
+		if( unreliable_messages_buffer_pos_ == 0u )
+			BeginUnreliablePacket();
+
+		const unsigned char* const packet_data= messages_buffer.unreliable_messages_.data() + packet_start;
+		for( unsigned int pos= 0u; pos < packet_size; )
+		{
+			const unsigned int message_size= GetEncodedMessageSize( static_cast<MessageId>( packet_data[pos] ) );
+			traffic_counters_.AddMessage( packet_data + pos, message_size );
+			pos+= message_size;
+		}
+
+		std::memcpy(
+			unreliable_messages_buffer_ + unreliable_messages_buffer_pos_,
+			packet_data,
+			packet_size );
+		unreliable_messages_buffer_pos_+= packet_size;
+
+		packet_start= packet_end;
+	}
+}
 
 void MessagesSender::Flush()
 {
+	FlushReliableFrame();
+
 	if( unreliable_messages_buffer_pos_ > 0u )
 	{
 		connection_->SendUnreliablePacket( unreliable_messages_buffer_, unreliable_messages_buffer_pos_ );
+		traffic_counters_.unreliable_packets++;
+		traffic_counters_.unreliable_bytes+= unreliable_messages_buffer_pos_;
 		unreliable_messages_buffer_pos_= 0u;
 	}
 }
 
+const NetTrafficCounters& MessagesSender::GetTrafficCounters() const
+{
+	return traffic_counters_;
+}
+
 void MessagesSender::SendReliableMessageImpl( const void* const data, const unsigned int size )
 {
-	connection_->SendReliablePacket( data, size );
+	PC_ASSERT( size <= c_max_reliable_frame_data_size );
+
+	if( reliable_frame_data_.size() + size > c_max_reliable_frame_data_size )
+		FlushReliableFrame();
+
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	reliable_frame_data_.insert( reliable_frame_data_.end(), bytes, bytes + size );
+	traffic_counters_.AddMessage( bytes, size );
 }
 
 void MessagesSender::SendUnreliableMessageImpl( const void* const data, const unsigned int size )
@@ -35,6 +124,8 @@ void MessagesSender::SendUnreliableMessageImpl( const void* const data, const un
 	{
 		Flush();
 	}
+	if( unreliable_messages_buffer_pos_ == 0u )
+		BeginUnreliablePacket();
 
 	std::memcpy(
 		unreliable_messages_buffer_ + unreliable_messages_buffer_pos_,
@@ -42,6 +133,53 @@ void MessagesSender::SendUnreliableMessageImpl( const void* const data, const un
 		size );
 
 	unreliable_messages_buffer_pos_+= size;
+	traffic_counters_.AddMessage( static_cast<const unsigned char*>(data), size );
+}
+
+void MessagesSender::BeginUnreliablePacket()
+{
+	PC_ASSERT( unreliable_messages_buffer_pos_ == 0u );
+
+	Messages::UnreliablePacketBegin message;
+	message.sequence= unreliable_packet_sequence_;
+	unreliable_packet_sequence_++;
+
+	unreliable_messages_buffer_pos_= Messages::EncodeMessage( message, unreliable_messages_buffer_ );
+	traffic_counters_.AddMessage( unreliable_messages_buffer_, unreliable_messages_buffer_pos_ );
+}
+
+void MessagesSender::FlushReliableFrame()
+{
+	if( reliable_frame_data_.empty() )
+		return;
+
+	unsigned char frame[ sizeof(ReliableFrameHeader) + c_max_reliable_frame_data_size ];
+	unsigned char* const frame_data= frame + sizeof(ReliableFrameHeader);
+
+	ReliableFrameHeader header;
+	header.data_size= static_cast<uint16_t>( reliable_frame_data_.size() );
+	header.compressed_size= 0u;
+
+	// Use compressed data only if it is smaller, than source data.
+	if( reliable_frame_data_.size() >= g_min_compressed_frame_size )
+		header.compressed_size=
+			static_cast<uint16_t>(
+				LzCompress(
+					reliable_frame_data_.data(), reliable_frame_data_.size(),
+					frame_data, reliable_frame_data_.size() - 1u ) );
+
+	if( header.compressed_size == 0u )
+		std::memcpy( frame_data, reliable_frame_data_.data(), reliable_frame_data_.size() );
+
+	std::memcpy( frame, &header, sizeof(ReliableFrameHeader) );
+	const unsigned int frame_size=
+		sizeof(ReliableFrameHeader) + ( header.compressed_size == 0u ? header.data_size : header.compressed_size );
+	connection_->SendReliablePacket( frame, frame_size );
+
+	traffic_counters_.reliable_frames++;
+	traffic_counters_.reliable_bytes+= frame_size;
+
+	reliable_frame_data_.clear();
 }
 
 } // namespace PanzerChasm
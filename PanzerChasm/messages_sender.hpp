@@ -1,13 +1,67 @@
 #pragma once
 #include <type_traits>
+#include <vector>
 
 #include "fwd.hpp"
 #include "i_connection.hpp"
 #include "messages.hpp"
+#include "messages_encoding.hpp"
+#include "net_statistics.hpp"
 
 namespace PanzerChasm
 {
 
+// Each unreliable packet starts with UnreliablePacketBegin message. Rest of packet space is used for other messages.
+constexpr unsigned int c_max_unreliable_packet_messages_size=
+	IConnection::c_max_unreliable_packet_size - sizeof(Messages::UnreliablePacketBegin);
+
+// Buffer for messages, same for many clients.
+// Messages are serialized into buffer once and than sent via many senders.
+class MessagesBuffer final
+{
+public:
+	template<class Message>
+	void AddReliableMessage( const Message& message )
+	{
+		static_assert(
+			std::is_base_of< Messages::MessageBase, Message >::value,
+			"Invalid message type" );
+
+		unsigned char encoded_message[ sizeof(Message) ];
+		AddReliableMessageImpl( encoded_message, Messages::EncodeMessage( message, encoded_message ) );
+	}
+
+	template<class Message>
+	void AddUnreliableMessage( const Message& message )
+	{
+		static_assert(
+			std::is_base_of< Messages::MessageBase, Message >::value,
+			"Invalid message type" );
+
+		static_assert(
+			sizeof(Message) <= c_max_unreliable_packet_messages_size,
+			"Message is too big" );
+
+		unsigned char encoded_message[ sizeof(Message) ];
+		AddUnreliableMessageImpl( encoded_message, Messages::EncodeMessage( message, encoded_message ) );
+	}
+
+	void Clear();
+
+private:
+	friend class MessagesSender;
+
+	void AddReliableMessageImpl( const void* data, unsigned int size );
+	void AddUnreliableMessageImpl( const void* data, unsigned int size );
+
+private:
+	std::vector<unsigned char> reliable_messages_;
+
+	// Unreliable messages are grouped into packets, which are not bigger, than max unreliable packet size.
+	std::vector<unsigned char> unreliable_messages_;
+	std::vector<unsigned int> unreliable_packets_ends_;
+};
+
 class MessagesSender final
 {
 public:
@@ -21,7 +75,8 @@ public:
 			std::is_base_of< Messages::MessageBase, Message >::value,
 			"Invalid message type" );
 
-		SendReliableMessageImpl( &message, sizeof(Message) );
+		unsigned char encoded_message[ sizeof(Message) ];
+		SendReliableMessageImpl( encoded_message, Messages::EncodeMessage( message, encoded_message ) );
 	}
 
 	template<class Message>
@@ -32,24 +87,37 @@ public:
 			"Invalid message type" );
 
 		static_assert(
-			sizeof(Message) <= sizeof(unreliable_messages_buffer_),
+			sizeof(Message) <= c_max_unreliable_packet_messages_size,
 			"Message is too big" );
 
-		SendUnreliableMessageImpl( &message, sizeof(Message) );
+		unsigned char encoded_message[ sizeof(Message) ];
+		SendUnreliableMessageImpl( encoded_message, Messages::EncodeMessage( message, encoded_message ) );
 	}
 
+	void SendMessages( const MessagesBuffer& messages_buffer );
+
 	void Flush();
 
+	const NetTrafficCounters& GetTrafficCounters() const;
+
 private:
 	void SendReliableMessageImpl( const void* data, unsigned int size );
 	void SendUnreliableMessageImpl( const void* data, unsigned int size );
+	void BeginUnreliablePacket();
+	void FlushReliableFrame();
 
 private:
 	const IConnectionPtr connection_;
 
+	// Reliable messages are collected until flush and sent together, in one frame.
+	std::vector<unsigned char> reliable_frame_data_;
+
 	// Bufferize unreliable messages, which works via UDP.
 	unsigned char unreliable_messages_buffer_[ IConnection::c_max_unreliable_packet_size ];
 	unsigned int unreliable_messages_buffer_pos_= 0u;
+	unsigned short unreliable_packet_sequence_= 0u;
+
+	NetTrafficCounters traffic_counters_;
 };
 
 } // namespace PanzerChasm
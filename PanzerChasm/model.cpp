@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <limits>
 
 #include "assert.hpp"
 #include "math_utils.hpp"
@@ -100,13 +103,57 @@ static void CalculateBoundingBox(
 				float( vertices[i].xyz[2] ) ) * g_3o_model_coords_scale;
 }
 
+// Bounding boxes must be calculated before.
+static void CalculateBoundingSpheres( Submodel& submodel )
+{
+	submodel.animations_bounding_spheres.resize( submodel.frame_count );
+	submodel.bounding_sphere.center= m_Vec3( 0.0f, 0.0f, 0.0f );
+	submodel.bounding_sphere.radius= 0.0f;
+	if( submodel.frame_count == 0u )
+		return;
+
+	const unsigned int vertex_count= submodel.animations_vertices.size() / submodel.frame_count;
+
+	m_BBox3 all_frames_bbox= submodel.animations_bboxes[0];
+	for( const m_BBox3& bbox : submodel.animations_bboxes )
+	{
+		all_frames_bbox+= bbox.min;
+		all_frames_bbox+= bbox.max;
+	}
+	submodel.bounding_sphere.center= ( all_frames_bbox.min + all_frames_bbox.max ) * 0.5f;
+
+	float all_frames_square_radius= 0.0f;
+	for( unsigned int f= 0u; f < submodel.frame_count; f++ )
+	{
+		const m_BBox3& bbox= submodel.animations_bboxes[f];
+		BoundingSphere& sphere= submodel.animations_bounding_spheres[f];
+		sphere.center= ( bbox.min + bbox.max ) * 0.5f;
+
+		float square_radius= 0.0f;
+		for( unsigned int v= 0u; v < vertex_count; v++ )
+		{
+			const Submodel::AnimationVertex& animation_vertex= submodel.animations_vertices[ f * vertex_count + v ];
+			const m_Vec3 pos=
+				m_Vec3(
+					float( animation_vertex.pos[0] ),
+					float( animation_vertex.pos[1] ),
+					float( animation_vertex.pos[2] ) ) * g_3o_model_coords_scale;
+
+			square_radius= std::max( square_radius, ( pos - sphere.center ).SquareLength() );
+			all_frames_square_radius= std::max( all_frames_square_radius, ( pos - submodel.bounding_sphere.center ).SquareLength() );
+		}
+		sphere.radius= std::sqrt( square_radius );
+	}
+	submodel.bounding_sphere.radius= std::sqrt( all_frames_square_radius );
+}
+
 static unsigned char GroupIdToGroupsMask( const unsigned char group_id )
 {
 	// 64 is unsused. Map to it "zero".
 	return group_id == 0 ? 64u : group_id;
 }
 
-void LoadModel_o3( const Vfs::FileContent& model_file, const Vfs::FileContent& animation_file, Model& out_model )
+void LoadModel_o3( const Vfs::FileView& model_file, const Vfs::FileView& animation_file, Model& out_model )
 {
 	ClearModel( out_model );
 
@@ -239,11 +286,12 @@ void LoadModel_o3( const Vfs::FileContent& model_file, const Vfs::FileContent& a
 	out_model.animations_bboxes.resize( out_model.frame_count );
 	for( unsigned int i= 0u; i < out_model.frame_count; i++ )
 		CalculateBoundingBox( vertices + i * vertex_count, vertex_count, out_model.animations_bboxes[i] );
+	CalculateBoundingSpheres( out_model );
 }
 
 void LoadModel_o3(
-	const Vfs::FileContent& model_file,
-	const Vfs::FileContent* const animation_files, const unsigned int animation_files_count,
+	const Vfs::FileView& model_file,
+	const Vfs::FileView* const animation_files, const unsigned int animation_files_count,
 	Model& out_model )
 {
 	constexpr unsigned int c_max_animations= 32;
@@ -289,7 +337,7 @@ void LoadModel_o3(
 	std::memcpy( out_model.animations.data(), animations, sizeof(Model::Animation) * animation_files_count );
 }
 
-void LoadModel_car( const Vfs::FileContent& model_file, Model& out_model )
+void LoadModel_car( const Vfs::FileView& model_file, Model& out_model )
 {
 	ClearModel( out_model );
 
@@ -412,6 +460,7 @@ void LoadModel_car( const Vfs::FileContent& model_file, Model& out_model )
 		out_submodel.animations_bboxes.resize( out_submodel.frame_count );
 		for( unsigned int i= 0u; i < out_submodel.frame_count; i++ )
 			CalculateBoundingBox( vertices + i * vertex_count, vertex_count, out_submodel.animations_bboxes[i] );
+		CalculateBoundingSpheres( out_submodel );
 	};
 
 	{ // Main model
@@ -499,4 +548,80 @@ void LoadModel_car( const Vfs::FileContent& model_file, Model& out_model )
 	PC_ASSERT( sounds_offset == model_file.size() );
 }
 
+void CompressAnimations( const Submodel& submodel, CompressedAnimations& out_animations )
+{
+	const unsigned int c_bits[3]=
+		{ CompressedAnimations::c_x_bits, CompressedAnimations::c_y_bits, CompressedAnimations::c_z_bits };
+	const unsigned int c_shifts[3]= { 0u, c_bits[0], c_bits[0] + c_bits[1] };
+
+	out_animations.frames.clear();
+	out_animations.vertices.clear();
+	out_animations.vertex_count= submodel.frame_count == 0u ? 0u : submodel.animations_vertices.size() / submodel.frame_count;
+	if( out_animations.vertex_count == 0u )
+		return;
+
+	out_animations.frames.resize( submodel.frame_count );
+	out_animations.vertices.resize( submodel.frame_count * out_animations.vertex_count );
+
+	for( unsigned int f= 0u; f < submodel.frame_count; f++ )
+	{
+		const Submodel::AnimationVertex* const in_vertices= submodel.animations_vertices.data() + f * out_animations.vertex_count;
+		uint32_t* const out_vertices= out_animations.vertices.data() + f * out_animations.vertex_count;
+		CompressedAnimations::FrameQuantization& quantization= out_animations.frames[f];
+
+		for( unsigned int j= 0u; j < 3u; j++ )
+		{
+			int min_value= std::numeric_limits<int>::max();
+			int max_value= std::numeric_limits<int>::min();
+			for( unsigned int v= 0u; v < out_animations.vertex_count; v++ )
+			{
+				min_value= std::min( min_value, int(in_vertices[v].pos[j]) );
+				max_value= std::max( max_value, int(in_vertices[v].pos[j]) );
+			}
+
+			const unsigned int max_quantized= ( 1u << c_bits[j] ) - 1u;
+			quantization.min[j]= float(min_value);
+			quantization.step[j]= float( max_value - min_value ) / float(max_quantized);
+		}
+
+		for( unsigned int v= 0u; v < out_animations.vertex_count; v++ )
+		{
+			uint32_t packed= 0u;
+			for( unsigned int j= 0u; j < 3u; j++ )
+			{
+				const unsigned int max_quantized= ( 1u << c_bits[j] ) - 1u;
+				unsigned int quantized= 0u;
+				if( quantization.step[j] > 0.0f )
+				{
+					const float value= std::round( ( float(in_vertices[v].pos[j]) - quantization.min[j] ) / quantization.step[j] );
+					quantized= std::min( static_cast<unsigned int>( std::max( value, 0.0f ) ), max_quantized );
+				}
+				packed|= quantized << c_shifts[j];
+			}
+			out_vertices[v]= packed;
+		}
+	}
+}
+
+void DecompressAnimationVertex(
+	const CompressedAnimations::FrameQuantization& quantization,
+	const uint32_t packed_vertex,
+	float* const out_pos )
+{
+	const unsigned int c_bits[3]=
+		{ CompressedAnimations::c_x_bits, CompressedAnimations::c_y_bits, CompressedAnimations::c_z_bits };
+	const unsigned int c_shifts[3]= { 0u, c_bits[0], c_bits[0] + c_bits[1] };
+
+	for( unsigned int j= 0u; j < 3u; j++ )
+	{
+		const unsigned int quantized= ( packed_vertex >> c_shifts[j] ) & ( ( 1u << c_bits[j] ) - 1u );
+		out_pos[j]= quantization.min[j] + float(quantized) * quantization.step[j];
+	}
+}
+
+void FreeModelRenderData( Model& model )
+{
+	std::vector<unsigned char>().swap( model.texture_data );
+}
+
 } // namespace ChasmReverse
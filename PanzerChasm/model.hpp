@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 
 #include <bbox.hpp>
@@ -9,6 +10,12 @@
 namespace PanzerChasm
 {
 
+struct BoundingSphere
+{
+	m_Vec3 center;
+	float radius;
+};
+
 struct Submodel
 {
 	// All vertex structures are in GPU-friendly format.
@@ -53,6 +60,9 @@ struct Submodel
 
 	// Store separate bounding box for each frame for better culling.
 	std::vector<m_BBox3> animations_bboxes;
+	// Spheres for fast rejection before bounding box test - for each frame and for all frames together.
+	std::vector<BoundingSphere> animations_bounding_spheres;
+	BoundingSphere bounding_sphere;
 
 	// Associated with models sounds (raw PCM)
 	std::vector< std::vector<unsigned char> > sounds;
@@ -68,12 +78,41 @@ struct Model final : public Submodel
 	std::vector<Submodel> submodels;
 };
 
-void LoadModel_o3( const Vfs::FileContent& model_file, const Vfs::FileContent& animation_file, Model& out_model );
+// Compact form of animations vertices of submodel.
+// Each frame is quantized into own bounding box: 11 bits for x, 11 bits for y, 10 bits for z, packed into 32-bit word.
+// So, vertex takes 4 bytes instead of 8. Frames are independent, so, any frame can be decompressed without others.
+struct CompressedAnimations
+{
+	static constexpr unsigned int c_x_bits= 11u;
+	static constexpr unsigned int c_y_bits= 11u;
+	static constexpr unsigned int c_z_bits= 10u;
+
+	struct FrameQuantization
+	{
+		float min[3];
+		float step[3];
+	};
+
+	unsigned int vertex_count= 0u; // Per frame
+	std::vector<FrameQuantization> frames;
+	std::vector<uint32_t> vertices;
+};
+
+void CompressAnimations( const Submodel& submodel, CompressedAnimations& out_animations );
+void DecompressAnimationVertex(
+	const CompressedAnimations::FrameQuantization& quantization,
+	uint32_t packed_vertex,
+	float* out_pos );
+
+void LoadModel_o3( const Vfs::FileView& model_file, const Vfs::FileView& animation_file, Model& out_model );
 void LoadModel_o3(
-	const Vfs::FileContent& model_file,
-	const Vfs::FileContent* animation_files, unsigned int animation_files_count,
+	const Vfs::FileView& model_file,
+	const Vfs::FileView* animation_files, unsigned int animation_files_count,
 	Model& out_model );
 
-void LoadModel_car( const Vfs::FileContent& model_file, Model& out_model );
+void LoadModel_car( const Vfs::FileView& model_file, Model& out_model );
+
+// Releases data, needed only for drawing (texture). Geometry, animations and sounds are kept.
+void FreeModelRenderData( Model& model );
 
 } // namespace ChasmReverse
@@ -1,5 +1,7 @@
 #include <cctype>
 #include <cstring>
+#include <random>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -14,7 +16,16 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#else
+#include <poll.h>
+#endif
 
 #define INVALID_SOCKET (-1)
 typedef int SOCKET;
@@ -79,6 +90,686 @@ static bool IsSocketReady( const SOCKET& socket )
 #endif
 }
 
+// Checks readiness of all sockets of server with one system call per server loop.
+// epoll is used on Linux, select on Windows, poll on other systems.
+class SocketsPoller final
+{
+public:
+	SocketsPoller();
+	~SocketsPoller();
+
+	SocketsPoller( const SocketsPoller& )= delete;
+	SocketsPoller& operator=( const SocketsPoller& )= delete;
+
+	void AddSocket( SOCKET socket );
+	void RemoveSocket( SOCKET socket );
+
+	// Check all sockets without waiting.
+	void Poll();
+
+	// Block until some socket is ready or until timeout. Sockets states are not changed - call Poll after it.
+	void Wait( unsigned int timeout_ms );
+
+	// First check after poll returns result of poll. If socket was ready, all next checks are done directly,
+	// because socket may still have data after reading.
+	bool IsSocketReady( SOCKET socket );
+
+private:
+	struct SocketState
+	{
+		SOCKET socket;
+		bool ready;
+		bool ready_checked;
+	};
+
+	SocketState* FindSocket( SOCKET socket );
+
+private:
+	std::vector<SocketState> sockets_;
+
+#ifdef __linux__
+	int epoll_fd_= -1;
+	std::vector<epoll_event> events_;
+#elif !defined(_WIN32)
+	std::vector<pollfd> poll_fds_;
+#endif
+};
+
+typedef std::shared_ptr<SocketsPoller> SocketsPollerPtr;
+
+SocketsPoller::SocketsPoller()
+{
+#ifdef __linux__
+	epoll_fd_= ::epoll_create1( 0 );
+	if( epoll_fd_ == -1 )
+		Log::Warning( FUNC_NAME, " - ::epoll_create1 call error: ", errno );
+#endif
+}
+
+SocketsPoller::~SocketsPoller()
+{
+#ifdef __linux__
+	if( epoll_fd_ != -1 )
+		::close( epoll_fd_ );
+#endif
+}
+
+void SocketsPoller::AddSocket( const SOCKET socket )
+{
+	if( socket == INVALID_SOCKET || FindSocket( socket ) != nullptr )
+		return;
+
+	SocketState state;
+	state.socket= socket;
+	state.ready= false;
+	state.ready_checked= false;
+	sockets_.push_back( state );
+
+#ifdef __linux__
+	if( epoll_fd_ != -1 )
+	{
+		epoll_event event;
+		std::memset( &event, 0, sizeof(event) );
+		event.events= EPOLLIN;
+		event.data.fd= socket;
+		if( ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, socket, &event ) != 0 )
+			Log::Warning( FUNC_NAME, " - ::epoll_ctl call error: ", errno );
+	}
+	events_.resize( sockets_.size() );
+#endif
+}
+
+void SocketsPoller::RemoveSocket( const SOCKET socket )
+{
+	SocketState* const state= FindSocket( socket );
+	if( state == nullptr )
+		return;
+
+	*state= sockets_.back();
+	sockets_.pop_back();
+
+#ifdef __linux__
+	if( epoll_fd_ != -1 )
+	{
+		epoll_event event; // Needed for old kernels.
+		::epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, socket, &event );
+	}
+#endif
+}
+
+void SocketsPoller::Poll()
+{
+	for( SocketState& state : sockets_ )
+		state.ready= state.ready_checked= false;
+
+	if( sockets_.empty() )
+		return;
+
+#ifdef __linux__
+	if( epoll_fd_ == -1 )
+		return;
+
+	const int event_count= ::epoll_wait( epoll_fd_, events_.data(), static_cast<int>( events_.size() ), 0 );
+	if( event_count == -1 )
+	{
+		if( errno != EINTR )
+			Log::Warning( FUNC_NAME, " - ::epoll_wait call error: ", errno );
+		return;
+	}
+
+	for( int i= 0; i < event_count; i++ )
+	{
+		if( SocketState* const state= FindSocket( events_[i].data.fd ) )
+			state->ready= true;
+	}
+#elif defined(_WIN32)
+	// Windows fd_set is array of sockets, so, we can check many sockets in one call.
+	fd_set set;
+	set.fd_count= 0u;
+	for( const SocketState& state : sockets_ )
+	{
+		if( set.fd_count == FD_SETSIZE )
+			break;
+		set.fd_array[ set.fd_count ]= state.socket;
+		set.fd_count++;
+	}
+
+	timeval wait_time;
+	wait_time.tv_sec= 0u;
+	wait_time.tv_usec= 0u;
+
+	const int result= ::select( 0, &set, nullptr, nullptr, &wait_time );
+	if( result == SOCKET_ERROR )
+	{
+		Log::Warning( FUNC_NAME, " -  ::select call error: ", ::WSAGetLastError() );
+		return;
+	}
+
+	for( unsigned int i= 0u; i < set.fd_count; i++ )
+	{
+		if( SocketState* const state= FindSocket( set.fd_array[i] ) )
+			state->ready= true;
+	}
+#else
+	poll_fds_.resize( sockets_.size() );
+	for( unsigned int i= 0u; i < sockets_.size(); i++ )
+	{
+		poll_fds_[i].fd= sockets_[i].socket;
+		poll_fds_[i].events= POLLIN;
+		poll_fds_[i].revents= 0;
+	}
+
+	const int result= ::poll( poll_fds_.data(), poll_fds_.size(), 0 );
+	if( result == -1 )
+	{
+		if( errno != EINTR )
+			Log::Warning( FUNC_NAME, " - ::poll call error: ", errno );
+		return;
+	}
+
+	for( unsigned int i= 0u; i < sockets_.size(); i++ )
+		sockets_[i].ready= ( poll_fds_[i].revents & ( POLLIN | POLLHUP | POLLERR ) ) != 0;
+#endif
+}
+
+void SocketsPoller::Wait( const unsigned int timeout_ms )
+{
+	if( sockets_.empty() )
+		return;
+
+	// Events are level-triggered, so, ready sockets are reported again by next poll.
+#ifdef __linux__
+	if( epoll_fd_ == -1 )
+		return;
+
+	const int event_count= ::epoll_wait( epoll_fd_, events_.data(), static_cast<int>( events_.size() ), static_cast<int>( timeout_ms ) );
+	if( event_count == -1 && errno != EINTR )
+		Log::Warning( FUNC_NAME, " - ::epoll_wait call error: ", errno );
+#elif defined(_WIN32)
+	fd_set set;
+	set.fd_count= 0u;
+	for( const SocketState& state : sockets_ )
+	{
+		if( set.fd_count == FD_SETSIZE )
+			break;
+		set.fd_array[ set.fd_count ]= state.socket;
+		set.fd_count++;
+	}
+
+	timeval wait_time;
+	wait_time.tv_sec= timeout_ms / 1000u;
+	wait_time.tv_usec= ( timeout_ms % 1000u ) * 1000u;
+
+	if( ::select( 0, &set, nullptr, nullptr, &wait_time ) == SOCKET_ERROR )
+		Log::Warning( FUNC_NAME, " -  ::select call error: ", ::WSAGetLastError() );
+#else
+	poll_fds_.resize( sockets_.size() );
+	for( unsigned int i= 0u; i < sockets_.size(); i++ )
+	{
+		poll_fds_[i].fd= sockets_[i].socket;
+		poll_fds_[i].events= POLLIN;
+		poll_fds_[i].revents= 0;
+	}
+
+	if( ::poll( poll_fds_.data(), poll_fds_.size(), static_cast<int>( timeout_ms ) ) == -1 && errno != EINTR )
+		Log::Warning( FUNC_NAME, " - ::poll call error: ", errno );
+#endif
+}
+
+bool SocketsPoller::IsSocketReady( const SOCKET socket )
+{
+	SocketState* const state= FindSocket( socket );
+	if( state == nullptr )
+		return PanzerChasm::IsSocketReady( socket );
+
+	if( !state->ready )
+		return false;
+
+	if( !state->ready_checked )
+	{
+		state->ready_checked= true;
+		return true;
+	}
+
+	return PanzerChasm::IsSocketReady( socket );
+}
+
+SocketsPoller::SocketState* SocketsPoller::FindSocket( const SOCKET socket )
+{
+	// Count of sockets is small - only few for each player.
+	for( SocketState& state : sockets_ )
+	{
+		if( state.socket == socket )
+			return &state;
+	}
+	return nullptr;
+}
+
+// Outgoing datagrams of server connections. Datagrams are queued and sent together, once per server loop.
+// On Linux consecutive datagrams for same socket are sent with one system call.
+class DatagramsSendQueue final
+{
+public:
+	void AddDatagram( SOCKET socket, const sockaddr_in& address, const void* data, unsigned int data_size );
+	void Flush();
+
+private:
+	struct Datagram
+	{
+		SOCKET socket;
+		sockaddr_in address;
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	static void SendDatagram( const Datagram& datagram, const unsigned char* data );
+
+private:
+	static constexpr unsigned int c_send_batch_size= 64u;
+
+	std::vector<Datagram> datagrams_;
+	std::vector<unsigned char> data_;
+};
+
+typedef std::shared_ptr<DatagramsSendQueue> DatagramsSendQueuePtr;
+
+constexpr unsigned int DatagramsSendQueue::c_send_batch_size;
+
+void DatagramsSendQueue::AddDatagram( const SOCKET socket, const sockaddr_in& address, const void* const data, const unsigned int data_size )
+{
+	Datagram datagram;
+	datagram.socket= socket;
+	datagram.address= address;
+	datagram.offset= data_.size();
+	datagram.size= data_size;
+	datagrams_.push_back( datagram );
+
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	data_.insert( data_.end(), bytes, bytes + data_size );
+}
+
+void DatagramsSendQueue::Flush()
+{
+#ifdef __linux__
+	mmsghdr messages[ c_send_batch_size ];
+	iovec buffers[ c_send_batch_size ];
+
+	unsigned int i= 0u;
+	while( i < datagrams_.size() )
+	{
+		// Collect batch of datagrams for same socket.
+		const SOCKET socket= datagrams_[i].socket;
+		unsigned int batch_size= 0u;
+		while( batch_size < c_send_batch_size && i + batch_size < datagrams_.size() && datagrams_[ i + batch_size ].socket == socket )
+		{
+			Datagram& datagram= datagrams_[ i + batch_size ];
+			buffers[ batch_size ].iov_base= data_.data() + datagram.offset;
+			buffers[ batch_size ].iov_len= datagram.size;
+
+			msghdr& header= messages[ batch_size ].msg_hdr;
+			std::memset( &header, 0, sizeof(header) );
+			header.msg_name= &datagram.address;
+			header.msg_namelen= sizeof(datagram.address);
+			header.msg_iov= &buffers[ batch_size ];
+			header.msg_iovlen= 1u;
+			batch_size++;
+		}
+
+		const int result= ::sendmmsg( socket, messages, batch_size, 0 );
+		if( result <= 0 )
+		{
+			// Skip failed datagram and try send rest.
+			Log::Warning( FUNC_NAME, " error: ", errno );
+			i++;
+		}
+		else
+			i+= static_cast<unsigned int>(result);
+	}
+#else
+	for( const Datagram& datagram : datagrams_ )
+		SendDatagram( datagram, data_.data() + datagram.offset );
+#endif
+
+	datagrams_.clear();
+	data_.clear();
+}
+
+void DatagramsSendQueue::SendDatagram( const Datagram& datagram, const unsigned char* const data )
+{
+#ifdef _WIN32
+	const int result=
+		::sendto( datagram.socket, (const char*) data, datagram.size, 0, (const sockaddr*) &datagram.address, sizeof(datagram.address) );
+
+	if( result == SOCKET_ERROR )
+		Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+	else if( result < static_cast<int>(datagram.size) )
+		Log::Warning( FUNC_NAME, " not all data transmited: ", result, " from ", datagram.size );
+#else
+	const int result=
+		::sendto( datagram.socket, (const char*) data, datagram.size, 0, (const sockaddr*) &datagram.address, sizeof(datagram.address) );
+
+	if( result == -1 )
+		Log::Warning( FUNC_NAME, " error: ", errno );
+	else if( result < static_cast<int>(datagram.size) )
+		Log::Warning( FUNC_NAME, " not all data transmited: ", result, " from ", datagram.size );
+#endif
+}
+
+// One udp socket for all connections of server listener.
+// Incoming datagrams are routed to connections by source address.
+// Address of new connection is recognized by token in first message of client.
+class SharedUdpSocket final
+{
+public:
+	explicit SharedUdpSocket( uint16_t port );
+	~SharedUdpSocket();
+
+	SharedUdpSocket( const SharedUdpSocket& )= delete;
+	SharedUdpSocket& operator=( const SharedUdpSocket& )= delete;
+
+	bool IsOk() const;
+	SOCKET GetSocket() const;
+	uint16_t GetPort() const;
+
+	// Read all pending datagrams. Call it after poll.
+	void ReceiveDatagrams( SocketsPoller& poller );
+
+	void RegisterToken( uint32_t token );
+	void UnregisterToken( uint32_t token );
+	// Returns true, if first message with given token was recieved from given ip address.
+	bool GetTokenAddress( uint32_t token, IpAddress expected_ip_address, sockaddr_in& out_address ) const;
+
+	void RegisterConnection( const sockaddr_in& address );
+	void UnregisterConnection( const sockaddr_in& address );
+
+	// Returns size of next datagram from given address, or zero, if there are no datagrams.
+	unsigned int ReadDatagram( const sockaddr_in& address, void* out_data, unsigned int buffer_size );
+
+private:
+	struct IncomingQueue
+	{
+		std::vector<unsigned char> data;
+		std::vector<unsigned int> datagrams_sizes;
+		unsigned int next_datagram= 0u;
+		unsigned int next_datagram_offset= 0u;
+	};
+
+	struct TokenAddress
+	{
+		bool recieved;
+		sockaddr_in address;
+	};
+
+	static uint64_t GetAddressKey( const sockaddr_in& address );
+	void RouteDatagram( const sockaddr_in& address, const unsigned char* data, unsigned int data_size );
+
+private:
+	// Datagrams over limit are dropped, if connection does not read them.
+	static constexpr unsigned int c_max_queued_datagrams= 256u;
+	static constexpr unsigned int c_recieve_batch_size= 16u;
+
+	const uint16_t port_;
+	SOCKET socket_= INVALID_SOCKET;
+
+	std::unordered_map<uint64_t, IncomingQueue> connections_queues_;
+	std::unordered_map<uint32_t, TokenAddress> tokens_;
+
+	std::vector<unsigned char> recieve_buffer_;
+};
+
+typedef std::shared_ptr<SharedUdpSocket> SharedUdpSocketPtr;
+
+constexpr unsigned int SharedUdpSocket::c_max_queued_datagrams;
+constexpr unsigned int SharedUdpSocket::c_recieve_batch_size;
+
+SharedUdpSocket::SharedUdpSocket( const uint16_t port )
+	: port_(port)
+	, recieve_buffer_( c_recieve_batch_size * IConnection::c_max_unreliable_packet_size )
+{
+	socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
+	if( socket_ == INVALID_SOCKET )
+	{
+#ifdef _WIN32
+		Log::Warning( "Can not create udp socket. Error code: ", ::WSAGetLastError() );
+#else
+		Log::Warning( "Can not create udp socket. Error code: ", errno );
+#endif
+		return;
+	}
+
+	sockaddr_in udp_address;
+	std::memset( &udp_address, 0, sizeof(udp_address) );
+	udp_address.sin_family= AF_INET;
+	udp_address.sin_addr.s_addr= INADDR_ANY;
+	udp_address.sin_port= htons( port_ );
+	if( ::bind( socket_, (sockaddr*) &udp_address, sizeof(udp_address) ) != 0 )
+	{
+#ifdef _WIN32
+		Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", ::WSAGetLastError() );
+		::closesocket( socket_ );
+#else
+		Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", errno );
+		::close( socket_ );
+#endif
+		socket_= INVALID_SOCKET;
+	}
+}
+
+SharedUdpSocket::~SharedUdpSocket()
+{
+	if( socket_ == INVALID_SOCKET )
+		return;
+#ifdef _WIN32
+	::closesocket( socket_ );
+#else
+	::close( socket_ );
+#endif
+}
+
+bool SharedUdpSocket::IsOk() const
+{
+	return socket_ != INVALID_SOCKET;
+}
+
+SOCKET SharedUdpSocket::GetSocket() const
+{
+	return socket_;
+}
+
+uint16_t SharedUdpSocket::GetPort() const
+{
+	return port_;
+}
+
+void SharedUdpSocket::ReceiveDatagrams( SocketsPoller& poller )
+{
+	if( !poller.IsSocketReady( socket_ ) )
+		return;
+
+#ifdef __linux__
+	// Read many datagrams with one system call.
+	mmsghdr messages[ c_recieve_batch_size ];
+	iovec buffers[ c_recieve_batch_size ];
+	sockaddr_in addresses[ c_recieve_batch_size ];
+
+	std::memset( messages, 0, sizeof(messages) );
+	for( unsigned int i= 0u; i < c_recieve_batch_size; i++ )
+	{
+		buffers[i].iov_base= recieve_buffer_.data() + i * IConnection::c_max_unreliable_packet_size;
+		buffers[i].iov_len= IConnection::c_max_unreliable_packet_size;
+		messages[i].msg_hdr.msg_iov= &buffers[i];
+		messages[i].msg_hdr.msg_iovlen= 1u;
+		messages[i].msg_hdr.msg_name= &addresses[i];
+	}
+
+	while(true)
+	{
+		for( unsigned int i= 0u; i < c_recieve_batch_size; i++ )
+			messages[i].msg_hdr.msg_namelen= sizeof(sockaddr_in);
+
+		const int count= ::recvmmsg( socket_, messages, c_recieve_batch_size, MSG_DONTWAIT, nullptr );
+		if( count == -1 )
+		{
+			if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+				Log::Warning( FUNC_NAME, " error: ", errno );
+			break;
+		}
+
+		for( int i= 0; i < count; i++ )
+			RouteDatagram( addresses[i], static_cast<const unsigned char*>( buffers[i].iov_base ), messages[i].msg_len );
+
+		if( count < static_cast<int>( c_recieve_batch_size ) )
+			break;
+	}
+#else
+	do
+	{
+		sockaddr_in reciever_address;
+#ifdef _WIN32
+		int reciever_address_length= sizeof(reciever_address);
+		const int result=
+			::recvfrom(
+				socket_,
+				(char*) recieve_buffer_.data(), IConnection::c_max_unreliable_packet_size, 0,
+				(sockaddr*) &reciever_address, &reciever_address_length );
+		if( result == SOCKET_ERROR )
+		{
+			Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+			break;
+		}
+#else
+		socklen_t reciever_address_length= sizeof(reciever_address);
+		const int result=
+			::recvfrom(
+				socket_,
+				(char*) recieve_buffer_.data(), IConnection::c_max_unreliable_packet_size, 0,
+				(sockaddr*) &reciever_address, &reciever_address_length );
+		if( result == -1 )
+		{
+			Log::Warning( FUNC_NAME, " error: ", errno );
+			break;
+		}
+#endif
+		RouteDatagram( reciever_address, recieve_buffer_.data(), static_cast<unsigned int>(result) );
+
+	} while( poller.IsSocketReady( socket_ ) );
+#endif
+}
+
+void SharedUdpSocket::RegisterToken( const uint32_t token )
+{
+	TokenAddress& token_address= tokens_[token];
+	token_address.recieved= false;
+}
+
+void SharedUdpSocket::UnregisterToken( const uint32_t token )
+{
+	tokens_.erase( token );
+}
+
+bool SharedUdpSocket::GetTokenAddress( const uint32_t token, const IpAddress expected_ip_address, sockaddr_in& out_address ) const
+{
+	const auto it= tokens_.find( token );
+	if( it == tokens_.end() || !it->second.recieved )
+		return false;
+
+	if( it->second.address.sin_addr.s_addr != expected_ip_address )
+	{
+		Log::Info( "Unknown user ", inet_ntoa( it->second.address.sin_addr ), " trying to connect. Discard him." );
+		return false;
+	}
+
+	out_address= it->second.address;
+	return true;
+}
+
+void SharedUdpSocket::RegisterConnection( const sockaddr_in& address )
+{
+	connections_queues_[ GetAddressKey( address ) ];
+}
+
+void SharedUdpSocket::UnregisterConnection( const sockaddr_in& address )
+{
+	connections_queues_.erase( GetAddressKey( address ) );
+}
+
+unsigned int SharedUdpSocket::ReadDatagram( const sockaddr_in& address, void* const out_data, const unsigned int buffer_size )
+{
+	const auto it= connections_queues_.find( GetAddressKey( address ) );
+	if( it == connections_queues_.end() )
+		return 0u;
+
+	IncomingQueue& queue= it->second;
+	if( queue.next_datagram == queue.datagrams_sizes.size() )
+		return 0u;
+
+	// Like recvfrom, drop part of datagram, which does not fit into buffer.
+	const unsigned int datagram_size= queue.datagrams_sizes[ queue.next_datagram ];
+	const unsigned int result_size= std::min( datagram_size, buffer_size );
+	std::memcpy( out_data, queue.data.data() + queue.next_datagram_offset, result_size );
+
+	queue.next_datagram++;
+	queue.next_datagram_offset+= datagram_size;
+	if( queue.next_datagram == queue.datagrams_sizes.size() )
+	{
+		queue.data.clear();
+		queue.datagrams_sizes.clear();
+		queue.next_datagram= 0u;
+		queue.next_datagram_offset= 0u;
+	}
+
+	return result_size;
+}
+
+uint64_t SharedUdpSocket::GetAddressKey( const sockaddr_in& address )
+{
+	return ( uint64_t( address.sin_addr.s_addr ) << 16u ) | uint64_t( address.sin_port );
+}
+
+void SharedUdpSocket::RouteDatagram( const sockaddr_in& address, const unsigned char* const data, const unsigned int data_size )
+{
+	const auto it= connections_queues_.find( GetAddressKey( address ) );
+	if( it != connections_queues_.end() )
+	{
+		IncomingQueue& queue= it->second;
+		if( queue.datagrams_sizes.size() - queue.next_datagram >= c_max_queued_datagrams )
+			return;
+
+		queue.data.insert( queue.data.end(), data, data + data_size );
+		queue.datagrams_sizes.push_back( data_size );
+		return;
+	}
+
+	// Datagram from unknown address. Check, if this is first message of new connection.
+	Messages::DummyNetMessage message;
+	if( data_size != sizeof(message) )
+		return;
+	std::memcpy( &message, data, sizeof(message) );
+	if( message.message_id != MessageId::DummyNetMessage )
+		return;
+
+	const auto token_it= tokens_.find( message.connection_token );
+	if( token_it == tokens_.end() )
+		return;
+
+	token_it->second.recieved= true;
+	token_it->second.address= address;
+}
+
+// Reliable messages are coalesced by messages sender and flushed once per loop.
+// So, send each packet immediately - Nagle's algorithm only adds delay here.
+static void DisableNagleAlgorithm( const SOCKET& socket )
+{
+	const int flag= 1;
+#ifdef _WIN32
+	if( ::setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &flag, sizeof(flag) ) != 0 )
+		Log::Warning( FUNC_NAME, " - ::setsockopt call error: ", ::WSAGetLastError() );
+#else
+	if( ::setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &flag, sizeof(flag) ) != 0 )
+		Log::Warning( FUNC_NAME, " - ::setsockopt call error: ", errno );
+#endif
+}
+
 bool InetAddress::Parse( const std::string& address_string, InetAddress& out_address )
 {
 	unsigned char addr[4];
@@ -139,11 +830,35 @@ std::string InetAddress::ToString() const
 class NetConnection final : public IConnection
 {
 public:
-	NetConnection( const SOCKET& tcp_socket, const SOCKET& udp_socket, const sockaddr_in& destination_udp_address )
+	NetConnection(
+		const SOCKET& tcp_socket, const SOCKET& udp_socket, const sockaddr_in& destination_udp_address,
+		SocketsPollerPtr sockets_poller= nullptr, DatagramsSendQueuePtr send_queue= nullptr )
 		: tcp_socket_( tcp_socket )
 		, udp_socket_( udp_socket )
 		, destination_udp_address_( destination_udp_address )
+		, sockets_poller_( std::move(sockets_poller) )
+		, send_queue_( std::move(send_queue) )
+	{
+		if( sockets_poller_ != nullptr )
+		{
+			sockets_poller_->AddSocket( tcp_socket_ );
+			sockets_poller_->AddSocket( udp_socket_ );
+		}
+	}
+
+	// Connection without own udp socket. Datagrams are sended and recieved via shared socket of listener.
+	NetConnection(
+		const SOCKET& tcp_socket, SharedUdpSocketPtr shared_udp_socket, const sockaddr_in& destination_udp_address,
+		SocketsPollerPtr sockets_poller, DatagramsSendQueuePtr send_queue )
+		: tcp_socket_( tcp_socket )
+		, destination_udp_address_( destination_udp_address )
+		, sockets_poller_( std::move(sockets_poller) )
+		, send_queue_( std::move(send_queue) )
+		, shared_udp_socket_( std::move(shared_udp_socket) )
 	{
+		sockets_poller_->AddSocket( tcp_socket_ );
+		shared_udp_socket_->RegisterConnection( destination_udp_address_ );
+
 		// TEST - use nonblocking sockets.
 		//u_long socket_mode= 1;
 		//::ioctlsocket( tcp_socket_, FIONBIO, &socket_mode );
@@ -152,13 +867,22 @@ public:
 
 	virtual ~NetConnection() override
 	{
+		if( sockets_poller_ != nullptr )
+		{
+			sockets_poller_->RemoveSocket( tcp_socket_ );
+			sockets_poller_->RemoveSocket( udp_socket_ );
+		}
+		if( shared_udp_socket_ != nullptr )
+			shared_udp_socket_->UnregisterConnection( destination_udp_address_ );
 		Disconnect();
 #ifdef _WIN32
 		::closesocket( tcp_socket_ );
-		::closesocket( udp_socket_ );
+		if( udp_socket_ != INVALID_SOCKET )
+			::closesocket( udp_socket_ );
 #else
 		::close( tcp_socket_ );
-		::close( udp_socket_ );
+		if( udp_socket_ != INVALID_SOCKET )
+			::close( udp_socket_ );
 #endif
 	}
 
@@ -168,21 +892,44 @@ public: // IConnection
 		if( disconnected_ ) return;
 		if( data_size == 0u ) return;
 
+		// Send may transmit only part of data, so, send rest of data.
+		const char* bytes= static_cast<const char*>(data);
+		while( data_size > 0u )
+		{
 #ifdef _WIN32
-		const int result= ::send( tcp_socket_, (const char*) data, data_size, 0 );
-		if( result == SOCKET_ERROR )
-			Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+			const int result= ::send( tcp_socket_, bytes, data_size, 0 );
+			if( result == SOCKET_ERROR )
+			{
+				Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+				return;
+			}
 #else
-		const int result= ::send( tcp_socket_, (const char*) data, data_size, 0 );
-		if( result == -1 )
-			Log::Warning( FUNC_NAME, " error: ", errno );
+			const int result= ::send( tcp_socket_, bytes, data_size, 0 );
+			if( result == -1 )
+			{
+				if( errno == EINTR )
+					continue;
+				Log::Warning( FUNC_NAME, " error: ", errno );
+				return;
+			}
 #endif
+			bytes+= result;
+			data_size-= static_cast<unsigned int>(result);
+		}
 	}
 
 	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override
 	{
 		if( disconnected_ ) return;
 
+		// Server connections send datagrams later, together with datagrams of other connections.
+		if( send_queue_ != nullptr )
+		{
+			const SOCKET udp_socket= shared_udp_socket_ != nullptr ? shared_udp_socket_->GetSocket() : udp_socket_;
+			send_queue_->AddDatagram( udp_socket, destination_udp_address_, data, data_size );
+			return;
+		}
+
 #ifdef _WIN32
 		const int result=
 			::sendto( udp_socket_, (const char*) data, data_size, 0, (sockaddr*) &destination_udp_address_, sizeof(destination_udp_address_) );
@@ -206,7 +953,7 @@ public: // IConnection
 	{
 		if( disconnected_ ) return 0u;
 
-		if( IsSocketReady( tcp_socket_ ) )
+		if( IsReadyForRead( tcp_socket_ ) )
 		{
 #ifdef _WIN32
 			int result= ::recv( tcp_socket_, (char*) out_data, buffer_size, 0 );
@@ -230,7 +977,11 @@ public: // IConnection
 	{
 		if( disconnected_ ) return 0u;
 
-		if( IsSocketReady( udp_socket_ ) )
+		// Datagrams of shared socket are already recieved by listener.
+		if( shared_udp_socket_ != nullptr )
+			return shared_udp_socket_->ReadDatagram( destination_udp_address_, out_data, buffer_size );
+
+		if( IsReadyForRead( udp_socket_ ) )
 		{
 #ifdef _WIN32
 			sockaddr_in reciever_address;
@@ -280,15 +1031,19 @@ public: // IConnection
 		if( disconnected_ ) return;
 		disconnected_= true;
 
+		// Send queued datagrams, before socket will be closed.
+		if( send_queue_ != nullptr )
+			send_queue_->Flush();
+
 #ifdef _WIN32
 		if( ::shutdown( tcp_socket_, SD_BOTH ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing tcp connection: ", ::WSAGetLastError() );
-		if( ::shutdown( udp_socket_, SD_BOTH ) != 0 )
+		if( udp_socket_ != INVALID_SOCKET && ::shutdown( udp_socket_, SD_BOTH ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing udp connection: ", ::WSAGetLastError() );
 #else
 		if( ::shutdown( tcp_socket_, SHUT_RDWR ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing tcp connection: ", errno );
-		if( ::shutdown( udp_socket_, SHUT_RDWR ) != 0 )
+		if( udp_socket_ != INVALID_SOCKET && ::shutdown( udp_socket_, SHUT_RDWR ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing udp connection: ", errno );
 #endif
 	}
@@ -309,10 +1064,33 @@ public: // IConnection
 		return result;
 	}
 
+	virtual unsigned int GetReliableBacklogSize() override
+	{
+#ifdef __linux__
+		// Unsent bytes in tcp send queue of socket.
+		int unsent_bytes= 0;
+		if( !disconnected_ && ::ioctl( tcp_socket_, SIOCOUTQ, &unsent_bytes ) == 0 )
+			return static_cast<unsigned int>( std::max( unsent_bytes, 0 ) );
+#endif
+		return 0u;
+	}
+
+private:
+	bool IsReadyForRead( const SOCKET& socket )
+	{
+		// Server connections use poller of listener. Client has only one connection, so, check it directly.
+		if( sockets_poller_ != nullptr )
+			return sockets_poller_->IsSocketReady( socket );
+		return IsSocketReady( socket );
+	}
+
 private:
 	const SOCKET tcp_socket_= INVALID_SOCKET;
 	const SOCKET udp_socket_= INVALID_SOCKET;
 	const sockaddr_in destination_udp_address_;
+	const SocketsPollerPtr sockets_poller_;
+	const DatagramsSendQueuePtr send_queue_; // Null for client connection - client sends datagrams immediately.
+	const SharedUdpSocketPtr shared_udp_socket_; // Null, if connection has own udp socket.
 
 	bool disconnected_= false;
 };
@@ -323,18 +1101,30 @@ public:
 	EstablishingConnection(
 		const SOCKET tcp_socket,
 		const IpAddress client_ip_address,
-		const uint16_t udp_port )
+		const uint16_t udp_port,
+		const uint32_t connection_token,
+		SocketsPollerPtr sockets_poller,
+		DatagramsSendQueuePtr send_queue,
+		SharedUdpSocketPtr shared_udp_socket )
 		: tcp_socket_(tcp_socket)
 		, client_ip_address_(client_ip_address)
+		, connection_token_(connection_token)
+		, sockets_poller_( std::move(sockets_poller) )
+		, send_queue_( std::move(send_queue) )
+		, shared_udp_socket_( std::move(shared_udp_socket) )
 	{
-#ifdef _WIN32
-		// Send to client protocol version, wia tcp.
-		uint32_t protocol_version= Messages::c_protocol_version;
-		::send( tcp_socket_, (char*) &protocol_version, sizeof(protocol_version), 0 ); // TODO - check errors.
+		if( shared_udp_socket_ != nullptr )
+		{
+			if( !SendHandshake( shared_udp_socket_->GetPort() ) )
+				return;
+			shared_udp_socket_->RegisterToken( connection_token_ );
+			return;
+		}
 
-		// Send to client input udp address, wia tcp.
-		::send( tcp_socket_, (char*) &udp_port, sizeof(udp_port), 0 ); // TODO - check errors.
+		if( !SendHandshake( udp_port ) )
+			return;
 
+#ifdef _WIN32
 		udp_socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
 		if( udp_socket_ == INVALID_SOCKET )
 		{
@@ -354,13 +1144,6 @@ public:
 			return;
 		}
 #else
-		// Send to client protocol version, wia tcp.
-		uint32_t protocol_version= Messages::c_protocol_version;
-		::send( tcp_socket_, (char*) &protocol_version, sizeof(protocol_version), 0 ); // TODO - check errors.
-
-		// Send to client input udp address, wia tcp.
-		::send( tcp_socket_, (char*) &udp_port, sizeof(udp_port), 0 ); // TODO - check errors.
-
 		udp_socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
 		if( udp_socket_ == -1 )
 		{
@@ -380,11 +1163,36 @@ public:
 			return;
 		}
 #endif
+
+		sockets_poller_->AddSocket( udp_socket_ );
+	}
+
+	~EstablishingConnection()
+	{
+		if( shared_udp_socket_ != nullptr )
+			shared_udp_socket_->UnregisterToken( connection_token_ );
+		sockets_poller_->RemoveSocket( udp_socket_ );
+	}
+
+	// Returns false, if handshake was not sent and connection must be discarded.
+	bool IsOk() const
+	{
+		return tcp_socket_ != INVALID_SOCKET;
 	}
 
 	IConnectionPtr TryCompleteConnection()
 	{
-		if( !IsSocketReady( udp_socket_ ) )
+		if( shared_udp_socket_ != nullptr )
+		{
+			sockaddr_in reciever_address;
+			if( !shared_udp_socket_->GetTokenAddress( connection_token_, client_ip_address_, reciever_address ) )
+				return nullptr;
+
+			const SOCKET tcp_socket= tcp_socket_; tcp_socket_= INVALID_SOCKET;
+			return std::make_shared<NetConnection>( tcp_socket, shared_udp_socket_, reciever_address, sockets_poller_, send_queue_ );
+		}
+
+		if( !sockets_poller_->IsSocketReady( udp_socket_ ) )
 			return nullptr;
 
 		// Recieve any message from client to estabelishing of connection.
@@ -436,13 +1244,52 @@ public:
 
 		const SOCKET tcp_socket= tcp_socket_; tcp_socket_= INVALID_SOCKET;
 		const SOCKET udp_socket= udp_socket_; udp_socket_= INVALID_SOCKET;
-		return std::make_shared<NetConnection>( tcp_socket, udp_socket, reciever_address );
+		return std::make_shared<NetConnection>( tcp_socket, udp_socket, reciever_address, sockets_poller_, send_queue_ );
+	}
+
+private:
+	// Returns false and closes tcp socket, if handshake can not be sent.
+	bool SendHandshake( const uint16_t udp_port )
+	{
+		// Send to client protocol version, input udp address and token for first udp message, wia tcp.
+		const uint32_t protocol_version= Messages::c_protocol_version;
+		if( SendHandshakeData( &protocol_version, sizeof(protocol_version) ) &&
+			SendHandshakeData( &udp_port, sizeof(udp_port) ) &&
+			SendHandshakeData( &connection_token_, sizeof(connection_token_) ) )
+			return true;
+
+#ifdef _WIN32
+		::closesocket( tcp_socket_ );
+#else
+		::close( tcp_socket_ );
+#endif
+		tcp_socket_= INVALID_SOCKET;
+		return false;
+	}
+
+	bool SendHandshakeData( const void* const data, const unsigned int data_size )
+	{
+		const int result= ::send( tcp_socket_, (const char*) data, data_size, 0 );
+		if( result != int(data_size) )
+		{
+#ifdef _WIN32
+			Log::Warning( FUNC_NAME, " can not send handshake to client. Error code: ", ::WSAGetLastError() );
+#else
+			Log::Warning( FUNC_NAME, " can not send handshake to client. Error code: ", errno );
+#endif
+			return false;
+		}
+		return true;
 	}
 
 private:
 	SOCKET tcp_socket_= INVALID_SOCKET;
 	SOCKET udp_socket_= INVALID_SOCKET;
 	const IpAddress client_ip_address_;
+	const uint32_t connection_token_;
+	const SocketsPollerPtr sockets_poller_;
+	const DatagramsSendQueuePtr send_queue_;
+	const SharedUdpSocketPtr shared_udp_socket_; // Null, if each connection has own udp socket.
 };
 
 typedef std::unique_ptr<EstablishingConnection> EstablishingConnectionPtr;
@@ -452,10 +1299,22 @@ class ServerListener final : public IConnectionsListener
 public:
 	ServerListener(
 		const uint16_t tcp_port,
-		const uint16_t base_udp_port )
+		const uint16_t base_udp_port,
+		const bool shared_udp_socket )
 		: listen_port_( tcp_port )
 		, next_in_udp_port_( base_udp_port )
+		, sockets_poller_( std::make_shared<SocketsPoller>() )
+		, send_queue_( std::make_shared<DatagramsSendQueue>() )
+		, tokens_generator_( std::random_device()() )
 	{
+		if( shared_udp_socket )
+		{
+			shared_udp_socket_= std::make_shared<SharedUdpSocket>( base_udp_port );
+			if( !shared_udp_socket_->IsOk() )
+				return;
+			sockets_poller_->AddSocket( shared_udp_socket_->GetSocket() );
+		}
+
 #ifdef _WIN32
 		listen_socket_= ::socket( PF_INET, SOCK_STREAM, 0 );
 		if( listen_socket_ == INVALID_SOCKET )
@@ -514,11 +1373,16 @@ public:
 		}
 #endif
 
+		sockets_poller_->AddSocket( listen_socket_ );
 		all_ok_= true;
 	}
 
 	~ServerListener()
 	{
+		send_queue_->Flush();
+		sockets_poller_->RemoveSocket( listen_socket_ );
+		if( shared_udp_socket_ != nullptr )
+			sockets_poller_->RemoveSocket( shared_udp_socket_->GetSocket() );
 #ifdef _WIN32
 		if( listen_socket_ != INVALID_SOCKET )
 			::closesocket( listen_socket_ );
@@ -534,9 +1398,27 @@ public:
 	}
 
 public: // IConnectionsListener
+	virtual void PollEvents() override
+	{
+		sockets_poller_->Poll();
+		if( shared_udp_socket_ != nullptr )
+			shared_udp_socket_->ReceiveDatagrams( *sockets_poller_ );
+	}
+
+	virtual void SendQueuedPackets() override
+	{
+		send_queue_->Flush();
+	}
+
+	virtual bool WaitForEvents( const unsigned int timeout_ms ) override
+	{
+		sockets_poller_->Wait( timeout_ms );
+		return true;
+	}
+
 	virtual IConnectionPtr GetNewConnection() override
 	{
-		if( IsSocketReady( listen_socket_ ) )
+		if( sockets_poller_->IsSocketReady( listen_socket_ ) )
 		{
 #ifdef _WIN32
 			sockaddr_in client_address;
@@ -565,14 +1447,27 @@ public: // IConnectionsListener
 
 			const IpAddress client_ip_address= client_address.sin_addr.s_addr;
 #endif
-			const uint16_t connection_in_udp_port= next_in_udp_port_;
-			++next_in_udp_port_;
+			DisableNagleAlgorithm( client_tcp_socket );
+
+			uint16_t connection_in_udp_port= 0u;
+			if( shared_udp_socket_ == nullptr )
+			{
+				connection_in_udp_port= next_in_udp_port_;
+				++next_in_udp_port_;
+			}
 
-			establishing_connections_.emplace_back(
-			new EstablishingConnection(
-				client_tcp_socket,
-				client_ip_address,
-				connection_in_udp_port ) );
+			EstablishingConnectionPtr establishing_connection(
+				new EstablishingConnection(
+					client_tcp_socket,
+					client_ip_address,
+					connection_in_udp_port,
+					tokens_generator_(),
+					sockets_poller_,
+					send_queue_,
+					shared_udp_socket_ ) );
+
+			if( establishing_connection->IsOk() )
+				establishing_connections_.push_back( std::move( establishing_connection ) );
 		}
 
 		// Try complete establishing connections.
@@ -596,6 +1491,13 @@ private:
 	uint16_t next_in_udp_port_;
 	bool all_ok_= false;
 
+	// Shared with connections. Connections may live longer, than listener.
+	const SocketsPollerPtr sockets_poller_;
+	const DatagramsSendQueuePtr send_queue_;
+	SharedUdpSocketPtr shared_udp_socket_; // Null, if each connection has own udp port.
+
+	std::mt19937 tokens_generator_;
+
 	std::vector< EstablishingConnectionPtr> establishing_connections_;
 };
 
@@ -699,6 +1601,7 @@ IConnectionPtr Net::ConnectToServer(
 		::closesocket( udp_socket );
 		return nullptr;
 	}
+	DisableNagleAlgorithm( tcp_socket );
 
 	// Recive protocol version.
 	uint32_t protocol_version;
@@ -718,12 +1621,24 @@ IConnectionPtr Net::ConnectToServer(
 	std::memcpy( &server_udp_address, &server_tcp_address, sizeof(sockaddr_in) );
 	server_udp_address.sin_port= ::htons( server_udp_port );
 
+	// Recieve token for first udp message.
+	uint32_t connection_token;
+	if( ::recv( tcp_socket, (char*) &connection_token, sizeof(connection_token), 0 ) != int(sizeof(connection_token)) )
+	{
+		Log::Warning( FUNC_NAME, "Can not connect to server - connection token not recieved." );
+		::closesocket( tcp_socket );
+		::closesocket( udp_socket );
+		return nullptr;
+	}
+
 	// Send to server first udp message for establishing of connection.
 	// Make NAT happy.
 	// Make this multiple times, for better reliability.
 	for( unsigned int n= 0u; n < 4u; n++ )
 	{
 		Messages::DummyNetMessage first_message;
+		first_message.connection_token= connection_token;
+		std::memset( first_message.filler, 0, sizeof(first_message.filler) );
 		::sendto( udp_socket, (char*) &first_message, sizeof(first_message), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
 	}
 #else
@@ -782,6 +1697,7 @@ IConnectionPtr Net::ConnectToServer(
 		::close( udp_socket );
 		return nullptr;
 	}
+	DisableNagleAlgorithm( tcp_socket );
 
 	// Recive protocol version.
 	uint32_t protocol_version;
@@ -801,12 +1717,24 @@ IConnectionPtr Net::ConnectToServer(
 	std::memcpy( &server_udp_address, &server_tcp_address, sizeof(sockaddr_in) );
 	server_udp_address.sin_port= htons( server_udp_port );
 
+	// Recieve token for first udp message.
+	uint32_t connection_token;
+	if( ::recv( tcp_socket, (char*) &connection_token, sizeof(connection_token), 0 ) != int(sizeof(connection_token)) )
+	{
+		Log::Warning( FUNC_NAME, "Can not connect to server - connection token not recieved." );
+		::close( tcp_socket );
+		::close( udp_socket );
+		return nullptr;
+	}
+
 	// Send to server first udp message for establishing of connection.
 	// Make NAT happy.
 	// Make this multiple times, for better reliability.
 	for( unsigned int n= 0u; n < 4u; n++ )
 	{
 		Messages::DummyNetMessage first_message;
+		first_message.connection_token= connection_token;
+		std::memset( first_message.filler, 0, sizeof(first_message.filler) );
 		::sendto( udp_socket, (char*) &first_message, sizeof(first_message), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
 	}
 #endif
@@ -816,9 +1744,10 @@ IConnectionPtr Net::ConnectToServer(
 
 IConnectionsListenerPtr Net::CreateServerListener(
 	const uint16_t tcp_port,
-	const uint16_t base_udp_port )
+	const uint16_t base_udp_port,
+	const bool shared_udp_socket )
 {
-	const auto listener= std::make_shared<ServerListener>( tcp_port, base_udp_port );
+	const auto listener= std::make_shared<ServerListener>( tcp_port, base_udp_port, shared_udp_socket );
 
 	if( listener->IsOk() )
 		return listener;
@@ -33,9 +33,12 @@ public:
 		uint16_t in_udp_port= c_default_client_tcp_port,
 		uint16_t in_tcp_port= c_default_client_udp_port );
 
+	// If "shared_udp_socket" is true, listener uses one udp socket at "base_udp_port" for all clients.
+	// Otherwise, each client gets own udp port, starting from "base_udp_port".
 	IConnectionsListenerPtr CreateServerListener(
 		uint16_t tcp_port= c_default_server_tcp_port,
-		uint16_t base_udp_port= c_default_server_udp_base_port );
+		uint16_t base_udp_port= c_default_server_udp_base_port,
+		bool shared_udp_socket= false );
 
 private:
 	struct PlatformData;
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../i_connection.hpp"
+#include "../log.hpp"
+
+#include "threaded_connections_listener.hpp"
+
+namespace PanzerChasm
+{
+
+// Network thread sleeps between loops.
+static const std::chrono::milliseconds g_network_thread_sleep_time( 1 );
+
+// Reliable output must be big enough for all messages of map change.
+static const unsigned int g_in_buffers_size_log2= 16u;
+static const unsigned int g_out_reliable_buffer_size_log2= 20u;
+static const unsigned int g_out_unreliable_buffer_size_log2= 16u;
+
+class ThreadedConnectionsListener::Connection final : public IConnection
+{
+public:
+	Connection( ConnectionBuffersPtr buffers, std::string connection_info );
+	virtual ~Connection() override;
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+	virtual unsigned int GetReliableBacklogSize() override;
+
+private:
+	const ConnectionBuffersPtr buffers_;
+	const std::string connection_info_;
+
+	bool disconnected_= false;
+};
+
+ThreadedConnectionsListener::Connection::Connection( ConnectionBuffersPtr buffers, std::string connection_info )
+	: buffers_( std::move(buffers) )
+	, connection_info_( std::move(connection_info) )
+{}
+
+ThreadedConnectionsListener::Connection::~Connection()
+{
+	buffers_->released.store( true );
+}
+
+void ThreadedConnectionsListener::Connection::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	if( disconnected_ ) return;
+
+	// Reliable data can not be dropped. If network thread can not send data so fast, client is too slow.
+	if( !buffers_->out_reliable_buffer.Write( data, data_size ) )
+	{
+		Log::Warning( "Send buffer overflow for client \"", connection_info_, "\"" );
+		Disconnect();
+	}
+}
+
+void ThreadedConnectionsListener::Connection::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	if( disconnected_ ) return;
+	buffers_->out_unreliable_buffer.WritePacket( data, data_size );
+}
+
+unsigned int ThreadedConnectionsListener::Connection::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	if( disconnected_ ) return 0u;
+	return buffers_->in_reliable_buffer.Read( out_data, buffer_size );
+}
+
+unsigned int ThreadedConnectionsListener::Connection::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	if( disconnected_ ) return 0u;
+	return buffers_->in_unreliable_buffer.ReadPacket( out_data, buffer_size );
+}
+
+void ThreadedConnectionsListener::Connection::Disconnect()
+{
+	disconnected_= true;
+	buffers_->disconnect_requested.store( true );
+}
+
+bool ThreadedConnectionsListener::Connection::Disconnected()
+{
+	return disconnected_ || buffers_->disconnected.load();
+}
+
+std::string ThreadedConnectionsListener::Connection::GetConnectionInfo()
+{
+	return connection_info_;
+}
+
+unsigned int ThreadedConnectionsListener::Connection::GetReliableBacklogSize()
+{
+	// Only data, not yet taken by network thread. Backlog of underlying connection is owned by network thread.
+	return buffers_->out_reliable_buffer.UsedSpace();
+}
+
+ThreadedConnectionsListener::RingBuffer::RingBuffer( const unsigned int size_log2 )
+	: buffer_( 1u << size_log2 )
+	, mask_( ( 1u << size_log2 ) - 1u )
+	, write_pos_( 0u )
+	, read_pos_( 0u )
+{}
+
+ThreadedConnectionsListener::RingBuffer::~RingBuffer()
+{}
+
+bool ThreadedConnectionsListener::RingBuffer::Write( const void* const data, const unsigned int data_size )
+{
+	if( data_size > FreeSpace() )
+		return false;
+
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	CopyIn( write_pos, data, data_size );
+	write_pos_.store( write_pos + data_size, std::memory_order_release );
+	return true;
+}
+
+bool ThreadedConnectionsListener::RingBuffer::WritePacket( const void* const data, const unsigned int data_size )
+{
+	PC_ASSERT( data_size <= 0xFFFFu );
+
+	const uint16_t packet_size= static_cast<uint16_t>( data_size );
+	if( sizeof(packet_size) + data_size > FreeSpace() )
+		return false;
+
+	// Publish size and data together.
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	CopyIn( write_pos, &packet_size, sizeof(packet_size) );
+	CopyIn( write_pos + sizeof(packet_size), data, data_size );
+	write_pos_.store( write_pos + sizeof(packet_size) + data_size, std::memory_order_release );
+	return true;
+}
+
+unsigned int ThreadedConnectionsListener::RingBuffer::FreeSpace() const
+{
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	const unsigned int read_pos= read_pos_.load( std::memory_order_acquire );
+	return buffer_.size() - ( write_pos - read_pos );
+}
+
+unsigned int ThreadedConnectionsListener::RingBuffer::UsedSpace() const
+{
+	return buffer_.size() - FreeSpace();
+}
+
+unsigned int ThreadedConnectionsListener::RingBuffer::Read( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+	const unsigned int write_pos= write_pos_.load( std::memory_order_acquire );
+
+	const unsigned int result_size= std::min( buffer_size, write_pos - read_pos );
+	CopyOut( read_pos, out_data, result_size );
+	read_pos_.store( read_pos + result_size, std::memory_order_release );
+	return result_size;
+}
+
+unsigned int ThreadedConnectionsListener::RingBuffer::ReadPacket( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+	const unsigned int write_pos= write_pos_.load( std::memory_order_acquire );
+	if( write_pos == read_pos )
+		return 0u;
+
+	uint16_t packet_size;
+	CopyOut( read_pos, &packet_size, sizeof(packet_size) );
+
+	// Like recvfrom, drop part of packet, which does not fit into buffer.
+	const unsigned int result_size= std::min( buffer_size, static_cast<unsigned int>(packet_size) );
+	CopyOut( read_pos + sizeof(packet_size), out_data, result_size );
+	read_pos_.store( read_pos + sizeof(packet_size) + packet_size, std::memory_order_release );
+	return result_size;
+}
+
+void ThreadedConnectionsListener::RingBuffer::CopyIn( const unsigned int pos, const void* const data, const unsigned int data_size )
+{
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	const unsigned int offset= pos & mask_;
+	const unsigned int first_part_size= std::min( data_size, static_cast<unsigned int>( buffer_.size() ) - offset );
+
+	std::memcpy( buffer_.data() + offset, bytes, first_part_size );
+	std::memcpy( buffer_.data(), bytes + first_part_size, data_size - first_part_size );
+}
+
+void ThreadedConnectionsListener::RingBuffer::CopyOut( const unsigned int pos, void* const out_data, const unsigned int data_size ) const
+{
+	unsigned char* const bytes= static_cast<unsigned char*>(out_data);
+	const unsigned int offset= pos & mask_;
+	const unsigned int first_part_size= std::min( data_size, static_cast<unsigned int>( buffer_.size() ) - offset );
+
+	std::memcpy( bytes, buffer_.data() + offset, first_part_size );
+	std::memcpy( bytes + first_part_size, buffer_.data(), data_size - first_part_size );
+}
+
+ThreadedConnectionsListener::ConnectionBuffers::ConnectionBuffers()
+	: in_reliable_buffer( g_in_buffers_size_log2 )
+	, in_unreliable_buffer( g_in_buffers_size_log2 )
+	, out_reliable_buffer( g_out_reliable_buffer_size_log2 )
+	, out_unreliable_buffer( g_out_unreliable_buffer_size_log2 )
+	, disconnect_requested( false )
+	, released( false )
+	, disconnected( false )
+{}
+
+ThreadedConnectionsListener::ThreadedConnectionsListener( IConnectionsListenerPtr listener )
+	: listener_( std::move(listener) )
+	, quit_requested_( false )
+{
+	PC_ASSERT( listener_ != nullptr );
+
+	thread_= std::thread( &ThreadedConnectionsListener::ThreadFunc, this );
+}
+
+ThreadedConnectionsListener::~ThreadedConnectionsListener()
+{
+	quit_requested_.store( true );
+	thread_.join();
+}
+
+IConnectionPtr ThreadedConnectionsListener::GetNewConnection()
+{
+	std::lock_guard<std::mutex> lock( new_connections_mutex_ );
+	if( new_connections_.empty() )
+		return nullptr;
+
+	const IConnectionPtr connection= new_connections_.front();
+	new_connections_.erase( new_connections_.begin() );
+	return connection;
+}
+
+void ThreadedConnectionsListener::ThreadFunc()
+{
+	while( !quit_requested_.load() )
+	{
+		listener_->PollEvents();
+
+		while( const IConnectionPtr connection= listener_->GetNewConnection() )
+		{
+			const ConnectionBuffersPtr buffers= std::make_shared<ConnectionBuffers>();
+			buffers->connection= connection;
+			connections_.push_back( buffers );
+
+			const IConnectionPtr threaded_connection= std::make_shared<Connection>( buffers, connection->GetConnectionInfo() );
+
+			std::lock_guard<std::mutex> lock( new_connections_mutex_ );
+			new_connections_.push_back( threaded_connection );
+		}
+
+		for( unsigned int c= 0u; c < connections_.size(); )
+		{
+			if( ProcessConnection( *connections_[c] ) )
+				c++;
+			else
+			{
+				if( c != connections_.size() - 1u )
+					connections_[c]= std::move( connections_.back() );
+				connections_.pop_back();
+			}
+		}
+
+		listener_->SendQueuedPackets();
+
+		std::this_thread::sleep_for( g_network_thread_sleep_time );
+	}
+
+	for( const ConnectionBuffersPtr& buffers : connections_ )
+	{
+		buffers->connection->Disconnect();
+		buffers->disconnected.store( true );
+	}
+	connections_.clear();
+
+	listener_->SendQueuedPackets();
+}
+
+bool ThreadedConnectionsListener::ProcessConnection( ConnectionBuffers& buffers )
+{
+	IConnection& connection= *buffers.connection;
+
+	// Read flags before sending, because connection sets flags only after writing of all data.
+	const bool released= buffers.released.load();
+	const bool disconnect_requested= buffers.disconnect_requested.load();
+
+	unsigned char buffer[ 4096u ];
+
+	while( const unsigned int size= buffers.out_reliable_buffer.Read( buffer, sizeof(buffer) ) )
+		connection.SendReliablePacket( buffer, size );
+	while( const unsigned int size= buffers.out_unreliable_buffer.ReadPacket( buffer, sizeof(buffer) ) )
+		connection.SendUnreliablePacket( buffer, size );
+
+	if( released || disconnect_requested )
+		connection.Disconnect();
+	if( connection.Disconnected() )
+		buffers.disconnected.store( true );
+
+	if( released )
+		return false;
+	if( buffers.disconnected.load() )
+		return true;
+
+	// Read only data, which fits into buffers. Rest of data waits in system buffers.
+	while( true )
+	{
+		const unsigned int free_space= buffers.in_reliable_buffer.FreeSpace();
+		if( free_space == 0u )
+			break;
+
+		const unsigned int size= connection.ReadRealiableData( buffer, std::min( free_space, static_cast<unsigned int>( sizeof(buffer) ) ) );
+		if( size == 0u )
+			break;
+		buffers.in_reliable_buffer.Write( buffer, size );
+	}
+
+	// Unreliable packets are dropped, if server loop does not read them.
+	while( const unsigned int size= connection.ReadUnrealiableData( buffer, sizeof(buffer) ) )
+		buffers.in_unreliable_buffer.WritePacket( buffer, size );
+
+	return true;
+}
+
+} // namespace PanzerChasm
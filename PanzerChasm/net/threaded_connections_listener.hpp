@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../server/i_connections_listener.hpp"
+
+namespace PanzerChasm
+{
+
+// Listener, which performs all input and output of wrapped listener and its connections in own thread.
+// Connections of this listener exchange data with network thread via lock-free queues,
+// so, server loop never waits for system calls.
+class ThreadedConnectionsListener final : public IConnectionsListener
+{
+public:
+	explicit ThreadedConnectionsListener( IConnectionsListenerPtr listener );
+	virtual ~ThreadedConnectionsListener() override;
+
+public: // IConnectionsListener
+	virtual IConnectionPtr GetNewConnection() override;
+
+private:
+	class Connection;
+
+	// Lock-free queue of bytes for one producer thread and one consumer thread.
+	class RingBuffer final
+	{
+	public:
+		explicit RingBuffer( unsigned int size_log2 );
+		~RingBuffer();
+
+		// Producer methods. Data is written only if whole data fits into buffer.
+		bool Write( const void* data, unsigned int data_size );
+		bool WritePacket( const void* data, unsigned int data_size );
+		unsigned int FreeSpace() const;
+		unsigned int UsedSpace() const;
+
+		// Consumer methods. Returns size of readed data.
+		// Do not mix packets and raw bytes in same buffer.
+		unsigned int Read( void* out_data, unsigned int buffer_size );
+		unsigned int ReadPacket( void* out_data, unsigned int buffer_size );
+
+	private:
+		void CopyIn( unsigned int pos, const void* data, unsigned int data_size );
+		void CopyOut( unsigned int pos, void* out_data, unsigned int data_size ) const;
+
+	private:
+		std::vector<unsigned char> buffer_;
+		const unsigned int mask_;
+
+		// Free-running positions. Difference of positions is count of bytes in buffer.
+		std::atomic<unsigned int> write_pos_;
+		std::atomic<unsigned int> read_pos_;
+	};
+
+	// Shared between connection and network thread.
+	struct ConnectionBuffers
+	{
+		ConnectionBuffers();
+
+		IConnectionPtr connection; // Used only by network thread.
+
+		RingBuffer in_reliable_buffer;
+		RingBuffer in_unreliable_buffer;
+		RingBuffer out_reliable_buffer;
+		RingBuffer out_unreliable_buffer;
+
+		std::atomic<bool> disconnect_requested;
+		std::atomic<bool> released; // Connection was destroyed.
+		std::atomic<bool> disconnected;
+	};
+
+	typedef std::shared_ptr<ConnectionBuffers> ConnectionBuffersPtr;
+
+private:
+	void ThreadFunc();
+	static bool ProcessConnection( ConnectionBuffers& buffers ); // Returns false, if connection must be removed.
+
+private:
+	const IConnectionsListenerPtr listener_;
+
+	// New connections are rare, so, just use mutex here.
+	std::mutex new_connections_mutex_;
+	std::vector<IConnectionPtr> new_connections_;
+
+	std::vector<ConnectionBuffersPtr> connections_; // Used only by network thread.
+
+	std::atomic<bool> quit_requested_;
+	std::thread thread_;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,176 @@
+#include <cstdio>
+
+#include "assert.hpp"
+
+#include "net_statistics.hpp"
+
+namespace PanzerChasm
+{
+
+static const char* const g_messages_names[ size_t(MessageId::NumMessages) ]=
+{
+	"Unknown",
+	#define MESSAGE_FUNC(x) #x,
+	#include "messages_list.h"
+	#undef MESSAGE_FUNC
+};
+
+static const float g_rates_update_interval_s= 1.0f;
+static const float g_rtt_smooth_factor= 0.125f;
+
+static NetTrafficCounters SubtractCounters( const NetTrafficCounters& a, const NetTrafficCounters& b )
+{
+	NetTrafficCounters result;
+	for( unsigned int i= 0u; i < size_t(MessageId::NumMessages); i++ )
+	{
+		result.messages[i].count= a.messages[i].count - b.messages[i].count;
+		result.messages[i].bytes= a.messages[i].bytes - b.messages[i].bytes;
+	}
+
+	result.reliable_frames= a.reliable_frames - b.reliable_frames;
+	result.reliable_bytes= a.reliable_bytes - b.reliable_bytes;
+	result.unreliable_packets= a.unreliable_packets - b.unreliable_packets;
+	result.unreliable_bytes= a.unreliable_bytes - b.unreliable_bytes;
+	result.lost_unreliable_packets= a.lost_unreliable_packets - b.lost_unreliable_packets;
+	result.late_unreliable_packets= a.late_unreliable_packets - b.late_unreliable_packets;
+	return result;
+}
+
+static uint64_t CountMessages( const NetTrafficCounters& counters )
+{
+	uint64_t count= 0u;
+	for( const NetTrafficCounters::MessageCounters& message_counters : counters.messages )
+		count+= message_counters.count;
+	return count;
+}
+
+static float KilobytesPerSecond( const uint64_t bytes, const float interval_s )
+{
+	return interval_s > 0.0f ? float(bytes) / ( 1024.0f * interval_s ) : 0.0f;
+}
+
+static float PerSecond( const uint64_t count, const float interval_s )
+{
+	return interval_s > 0.0f ? float(count) / interval_s : 0.0f;
+}
+
+void NetTrafficCounters::AddMessage( const unsigned char* const encoded_message, const unsigned int size )
+{
+	const unsigned int message_id= encoded_message[0];
+	PC_ASSERT( message_id < size_t(MessageId::NumMessages) );
+
+	messages[ message_id ].count++;
+	messages[ message_id ].bytes+= size;
+}
+
+NetStatistics::NetStatistics()
+	: last_rates_update_time_( Time::FrameTime() )
+	, sequences_send_times_( c_max_sequences_in_flight, Time::FromSeconds(0) )
+{}
+
+NetStatistics::~NetStatistics()
+{}
+
+void NetStatistics::Update( const NetTrafficCounters& sent, const NetTrafficCounters& recieved, const Time current_time )
+{
+	sent_= sent;
+	recieved_= recieved;
+
+	const float interval_s= ( current_time - last_rates_update_time_ ).ToSeconds();
+	if( interval_s < g_rates_update_interval_s )
+		return;
+
+	sent_delta_= SubtractCounters( sent_, prev_sent_ );
+	recieved_delta_= SubtractCounters( recieved_, prev_recieved_ );
+	prev_sent_= sent_;
+	prev_recieved_= recieved_;
+
+	rates_interval_s_= interval_s;
+	last_rates_update_time_= current_time;
+}
+
+void NetStatistics::OnSequenceSent( const unsigned short sequence, const Time current_time )
+{
+	sequences_send_times_[ sequence % c_max_sequences_in_flight ]= current_time;
+	last_sent_sequence_= sequence;
+}
+
+void NetStatistics::OnSequenceAcknowledged( const unsigned short sequence, const Time current_time )
+{
+	// Measure only first acknowledgement of each sequence.
+	// Skip too old sequences - their send times are already overwritten.
+	const short since_last_acknowledged= static_cast<short>( static_cast<unsigned short>( sequence - last_acknowledged_sequence_ ) );
+	const unsigned short in_flight= static_cast<unsigned short>( last_sent_sequence_ - sequence );
+	if( since_last_acknowledged <= 0 || in_flight >= c_max_sequences_in_flight )
+		return;
+
+	last_acknowledged_sequence_= sequence;
+
+	const float rtt_s= ( current_time - sequences_send_times_[ sequence % c_max_sequences_in_flight ] ).ToSeconds();
+	if( have_rtt_ )
+		rtt_s_+= ( rtt_s - rtt_s_ ) * g_rtt_smooth_factor;
+	else
+		rtt_s_= rtt_s;
+	have_rtt_= true;
+}
+
+void NetStatistics::GetStatsLines( std::vector<std::string>& out_lines, const bool per_message_type ) const
+{
+	char str[128];
+
+	if( have_rtt_ )
+		std::snprintf( str, sizeof(str), "rtt: %3.0fms", rtt_s_ * 1000.0f );
+	else
+		std::snprintf( str, sizeof(str), "rtt: unknown" );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "out: %6.2fkb/s, %4.0f packets/s, %5.0f msg/s",
+		KilobytesPerSecond( sent_delta_.reliable_bytes + sent_delta_.unreliable_bytes, rates_interval_s_ ),
+		PerSecond( sent_delta_.reliable_frames + sent_delta_.unreliable_packets, rates_interval_s_ ),
+		PerSecond( CountMessages( sent_delta_ ), rates_interval_s_ ) );
+	out_lines.emplace_back( str );
+
+	std::snprintf(
+		str, sizeof(str), "in:  %6.2fkb/s, %4.0f packets/s, %5.0f msg/s",
+		KilobytesPerSecond( recieved_delta_.reliable_bytes + recieved_delta_.unreliable_bytes, rates_interval_s_ ),
+		PerSecond( recieved_delta_.reliable_frames + recieved_delta_.unreliable_packets, rates_interval_s_ ),
+		PerSecond( CountMessages( recieved_delta_ ), rates_interval_s_ ) );
+	out_lines.emplace_back( str );
+
+	const uint64_t expected_packets= recieved_.unreliable_packets + recieved_.lost_unreliable_packets;
+	std::snprintf(
+		str, sizeof(str), "lost: %u/s, total %u (%4.2f%%), late: %u",
+		static_cast<unsigned int>( recieved_delta_.lost_unreliable_packets ),
+		static_cast<unsigned int>( recieved_.lost_unreliable_packets ),
+		expected_packets > 0u ? 100.0f * float(recieved_.lost_unreliable_packets) / float(expected_packets) : 0.0f,
+		static_cast<unsigned int>( recieved_.late_unreliable_packets ) );
+	out_lines.emplace_back( str );
+
+	if( !per_message_type )
+		return;
+
+	const auto add_messages_lines=
+	[&]( const char* const direction, const NetTrafficCounters& total, const NetTrafficCounters& delta )
+	{
+		for( unsigned int i= 0u; i < size_t(MessageId::NumMessages); i++ )
+		{
+			if( total.messages[i].count == 0u )
+				continue;
+
+			std::snprintf(
+				str, sizeof(str), "%s %-24s %6.0f msg/s, %6.2fkb/s, total %u msg, %ukb",
+				direction, g_messages_names[i],
+				PerSecond( delta.messages[i].count, rates_interval_s_ ),
+				KilobytesPerSecond( delta.messages[i].bytes, rates_interval_s_ ),
+				static_cast<unsigned int>( total.messages[i].count ),
+				static_cast<unsigned int>( ( total.messages[i].bytes + 1023u ) / 1024u ) );
+			out_lines.emplace_back( str );
+		}
+	};
+
+	add_messages_lines( "out", sent_, sent_delta_ );
+	add_messages_lines( "in ", recieved_, recieved_delta_ );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "messages.hpp"
+#include "time.hpp"
+
+namespace PanzerChasm
+{
+
+// Traffic counters for one direction of connection.
+struct NetTrafficCounters
+{
+	struct MessageCounters
+	{
+		uint64_t count= 0u;
+		uint64_t bytes= 0u;
+	};
+
+	MessageCounters messages[ size_t(MessageId::NumMessages) ];
+
+	uint64_t reliable_frames= 0u;
+	uint64_t reliable_bytes= 0u; // Size of frames, after compression.
+	uint64_t unreliable_packets= 0u;
+	uint64_t unreliable_bytes= 0u;
+
+	// Only for recieved packets.
+	uint64_t lost_unreliable_packets= 0u;
+	uint64_t late_unreliable_packets= 0u;
+
+	void AddMessage( const unsigned char* encoded_message, unsigned int size );
+};
+
+// Statistics of connection - traffic rates, lost packets, round trip time.
+class NetStatistics final
+{
+public:
+	NetStatistics();
+	~NetStatistics();
+
+	// Rates are recalculated once per second.
+	void Update( const NetTrafficCounters& sent, const NetTrafficCounters& recieved, Time current_time );
+
+	// Round trip time is measured via any sequence numbers, which other side acknowledges.
+	void OnSequenceSent( unsigned short sequence, Time current_time );
+	void OnSequenceAcknowledged( unsigned short sequence, Time current_time );
+
+	// Short summary, or summary with rates of each message type.
+	void GetStatsLines( std::vector<std::string>& out_lines, bool per_message_type ) const;
+
+private:
+	static constexpr unsigned int c_max_sequences_in_flight= 64u;
+
+private:
+	NetTrafficCounters sent_;
+	NetTrafficCounters recieved_;
+
+	// Counters and its increments for last interval.
+	NetTrafficCounters prev_sent_;
+	NetTrafficCounters prev_recieved_;
+	NetTrafficCounters sent_delta_;
+	NetTrafficCounters recieved_delta_;
+	Time last_rates_update_time_;
+	float rates_interval_s_= 0.0f;
+
+	std::vector<Time> sequences_send_times_;
+	unsigned short last_sent_sequence_= 0u;
+	unsigned short last_acknowledged_sequence_= 0u;
+	float rtt_s_= 0.0f; // Smoothed.
+	bool have_rtt_= false;
+};
+
+} // namespace PanzerChasm
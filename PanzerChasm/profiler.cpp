@@ -0,0 +1,594 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define PC_PROFILER_USE_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include "log.hpp"
+
+#include "profiler.hpp"
+
+namespace PanzerChasm
+{
+
+namespace Profiler
+{
+
+namespace
+{
+
+// Zones count for each thread. Older zones are overwritten.
+const unsigned int g_zones_per_thread= 1u << 16u;
+
+struct Zone
+{
+	const char* name;
+	uint64_t start_time_ns;
+	uint64_t end_time_ns;
+	AllocationsCounters allocations;
+};
+
+struct ZoneFrameStats
+{
+	const char* name;
+	unsigned int calls;
+	uint64_t time_ns;
+	AllocationsCounters allocations;
+};
+
+struct ThreadZones
+{
+	unsigned int thread_number;
+	// Mutex is locked only by owner thread, except dumping, so, it is almost always free.
+	std::mutex mutex;
+	std::vector<Zone> zones; // Ring buffer.
+	uint64_t zones_written= 0u;
+	uint64_t frame_start_zone= 0u; // First zone of current frame.
+};
+
+typedef std::shared_ptr<ThreadZones> ThreadZonesPtr;
+
+std::mutex g_threads_zones_mutex;
+// Buffers are kept after threads exit, so, zones of finished threads are available too.
+std::vector<ThreadZonesPtr> g_threads_zones;
+
+std::atomic<uint64_t> g_total_allocations_count( 0u );
+std::atomic<uint64_t> g_total_allocations_bytes( 0u );
+
+std::mutex g_frame_stats_mutex;
+std::vector<ZoneFrameStats> g_frame_stats; // Capacity is reused between frames.
+AllocationsCounters g_frame_allocations= { 0u, 0u };
+AllocationsCounters g_prev_frame_total_allocations= { 0u, 0u };
+
+struct LoadStepRecord
+{
+	const char* name;
+	unsigned int depth;
+	uint64_t start_time_ns;
+	uint64_t time_ns;
+	uint64_t start_file_bytes;
+	uint64_t file_bytes;
+	AllocationsCounters start_allocations;
+	AllocationsCounters allocations;
+};
+
+// Report of outermost load step of thread. Records are stored in order of steps start.
+struct LoadReport
+{
+	std::vector<LoadStepRecord> records;
+	unsigned int depth= 0u;
+	bool prev_allocations_tracking_enabled= false;
+};
+
+// Few hundreds of steps is enough for any load.
+const unsigned int g_load_report_reserved_records= 256u;
+
+std::atomic<bool> g_load_profiling_enabled( false );
+std::atomic<uint64_t> g_file_bytes_read( 0u );
+thread_local LoadReport* g_thread_load_report= nullptr;
+
+ThreadZones& GetThreadZones()
+{
+	thread_local ThreadZonesPtr thread_zones;
+	if( thread_zones == nullptr )
+	{
+		thread_zones= std::make_shared<ThreadZones>();
+		thread_zones->zones.resize( g_zones_per_thread );
+
+		std::unique_lock<std::mutex> lock( g_threads_zones_mutex );
+		thread_zones->thread_number= g_threads_zones.size();
+		g_threads_zones.push_back( thread_zones );
+	}
+	return *thread_zones;
+}
+
+void CountAllocation( const std::size_t size )
+{
+	g_thread_allocations.count++;
+	g_thread_allocations.bytes+= size;
+	g_total_allocations_count.fetch_add( 1u, std::memory_order_relaxed );
+	g_total_allocations_bytes.fetch_add( size, std::memory_order_relaxed );
+}
+
+void LogLoadReport( const LoadReport& report )
+{
+	Log::Info( "Load profile of \"", report.records.front().name, "\":" );
+
+	char str[192];
+	std::snprintf( str, sizeof(str), "%-40s %10s %10s %10s %8s", "step", "time ms", "vfs KB", "alloc KB", "allocs" );
+	Log::Info( str );
+
+	for( const LoadStepRecord& record : report.records )
+	{
+		char name[64];
+		std::snprintf( name, sizeof(name), "%*s%s", int(record.depth * 2u), "", record.name );
+		std::snprintf(
+			str, sizeof(str), "%-40s %10.2f %10.1f %10.1f %8llu",
+			name,
+			double(record.time_ns) / 1000000.0,
+			double(record.file_bytes) / 1024.0,
+			double(record.allocations.bytes) / 1024.0,
+			static_cast<unsigned long long>( record.allocations.count ) );
+		Log::Info( str );
+	}
+}
+
+uint64_t GetSteadyClockTimeNs()
+{
+	return
+		static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch() ).count() );
+}
+
+#ifdef PC_PROFILER_USE_TSC
+
+// Zones are measured often, so, use time stamp counter instead of steady clock, if counter rate is constant.
+// Counter is calibrated against steady clock once, at first profiler start.
+const uint64_t g_tsc_calibration_time_ns= 10u * 1000000u;
+
+std::atomic<bool> g_tsc_calibrated( false );
+double g_tsc_tick_ns= 0.0;
+uint64_t g_tsc_base= 0u;
+uint64_t g_tsc_base_time_ns= 0u;
+
+bool InvariantTscSupported()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if( __get_cpuid( 0x80000000u, &eax, &ebx, &ecx, &edx ) == 0 || eax < 0x80000007u )
+		return false;
+	if( __get_cpuid( 0x80000007u, &eax, &ebx, &ecx, &edx ) == 0 )
+		return false;
+	return ( edx & ( 1u << 8u ) ) != 0u;
+}
+
+void CalibrateTsc()
+{
+	if( g_tsc_calibrated.load( std::memory_order_acquire ) || !InvariantTscSupported() )
+		return;
+
+	const uint64_t start_time_ns= GetSteadyClockTimeNs();
+	const uint64_t start_tsc= __rdtsc();
+
+	uint64_t end_time_ns;
+	do
+	{
+		end_time_ns= GetSteadyClockTimeNs();
+	} while( end_time_ns - start_time_ns < g_tsc_calibration_time_ns );
+	const uint64_t end_tsc= __rdtsc();
+
+	if( end_tsc <= start_tsc )
+		return;
+
+	g_tsc_tick_ns= double( end_time_ns - start_time_ns ) / double( end_tsc - start_tsc );
+	g_tsc_base= end_tsc;
+	g_tsc_base_time_ns= end_time_ns;
+	g_tsc_calibrated.store( true, std::memory_order_release );
+
+	Log::Info( "Profiler uses time stamp counter, ", 1.0 / g_tsc_tick_ns, " ticks per ns" );
+}
+
+#endif // PC_PROFILER_USE_TSC
+
+void* Allocate( const std::size_t size )
+{
+	if( g_allocations_tracking_enabled.load( std::memory_order_relaxed ) )
+		CountAllocation( size );
+	return std::malloc( size == 0u ? 1u : size );
+}
+
+} // namespace
+
+std::atomic<bool> g_enabled( false );
+std::atomic<bool> g_allocations_tracking_enabled( false );
+thread_local AllocationsCounters g_thread_allocations;
+
+void Start()
+{
+	#ifdef PC_PROFILER_USE_TSC
+	CalibrateTsc();
+	#endif
+
+	{
+		std::unique_lock<std::mutex> lock( g_threads_zones_mutex );
+		for( const ThreadZonesPtr& thread_zones : g_threads_zones )
+		{
+			std::unique_lock<std::mutex> thread_lock( thread_zones->mutex );
+			thread_zones->zones_written= 0u;
+			thread_zones->frame_start_zone= 0u;
+		}
+	}
+
+	g_enabled.store( true );
+}
+
+void Stop()
+{
+	g_enabled.store( false );
+}
+
+bool IsEnabled()
+{
+	return g_enabled.load( std::memory_order_relaxed );
+}
+
+void SetAllocationsTrackingEnabled( const bool enabled )
+{
+	g_allocations_tracking_enabled.store( enabled );
+}
+
+bool AllocationsTrackingEnabled()
+{
+	return g_allocations_tracking_enabled.load( std::memory_order_relaxed );
+}
+
+AllocationsCounters GetTotalAllocations()
+{
+	AllocationsCounters result;
+	result.count= g_total_allocations_count.load( std::memory_order_relaxed );
+	result.bytes= g_total_allocations_bytes.load( std::memory_order_relaxed );
+	return result;
+}
+
+void EndFrame()
+{
+	const AllocationsCounters total_allocations= GetTotalAllocations();
+
+	std::unique_lock<std::mutex> stats_lock( g_frame_stats_mutex );
+
+	g_frame_allocations.count= total_allocations.count - g_prev_frame_total_allocations.count;
+	g_frame_allocations.bytes= total_allocations.bytes - g_prev_frame_total_allocations.bytes;
+	g_prev_frame_total_allocations= total_allocations;
+
+	g_frame_stats.clear();
+	if( !IsEnabled() )
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock( g_threads_zones_mutex );
+		for( const ThreadZonesPtr& thread_zones : g_threads_zones )
+		{
+			std::unique_lock<std::mutex> thread_lock( thread_zones->mutex );
+
+			const uint64_t oldest_zone=
+				thread_zones->zones_written - std::min( thread_zones->zones_written, uint64_t(g_zones_per_thread) );
+			for( uint64_t i= std::max( thread_zones->frame_start_zone, oldest_zone ); i < thread_zones->zones_written; i++ )
+			{
+				const Zone& zone= thread_zones->zones[ i % g_zones_per_thread ];
+
+				ZoneFrameStats* stats= nullptr;
+				for( ZoneFrameStats& s : g_frame_stats )
+				{
+					if( s.name == zone.name || std::strcmp( s.name, zone.name ) == 0 )
+					{
+						stats= &s;
+						break;
+					}
+				}
+				if( stats == nullptr )
+				{
+					g_frame_stats.emplace_back();
+					stats= &g_frame_stats.back();
+					stats->name= zone.name;
+					stats->calls= 0u;
+					stats->time_ns= 0u;
+					stats->allocations.count= stats->allocations.bytes= 0u;
+				}
+
+				stats->calls++;
+				stats->time_ns+= zone.end_time_ns - zone.start_time_ns;
+				stats->allocations.count+= zone.allocations.count;
+				stats->allocations.bytes+= zone.allocations.bytes;
+			}
+
+			thread_zones->frame_start_zone= thread_zones->zones_written;
+		}
+	}
+
+	std::sort(
+		g_frame_stats.begin(), g_frame_stats.end(),
+		[]( const ZoneFrameStats& l, const ZoneFrameStats& r )
+		{
+			return l.time_ns > r.time_ns;
+		} );
+}
+
+void GetFrameStats( std::vector<std::string>& out_lines )
+{
+	std::unique_lock<std::mutex> stats_lock( g_frame_stats_mutex );
+
+	const bool allocations_tracking= AllocationsTrackingEnabled();
+
+	char str[160];
+	if( allocations_tracking )
+	{
+		std::snprintf(
+			str, sizeof(str), "frame allocations: %llu, %llu bytes",
+			static_cast<unsigned long long>( g_frame_allocations.count ),
+			static_cast<unsigned long long>( g_frame_allocations.bytes ) );
+		out_lines.emplace_back( str );
+	}
+
+	if( !IsEnabled() )
+	{
+		out_lines.emplace_back( "profiler is not started" );
+		return;
+	}
+
+	for( const ZoneFrameStats& stats : g_frame_stats )
+	{
+		if( allocations_tracking )
+			std::snprintf(
+				str, sizeof(str), "%s: %.3f ms, calls: %u, allocs: %llu, %llu bytes",
+				stats.name, double(stats.time_ns) / 1000000.0, stats.calls,
+				static_cast<unsigned long long>( stats.allocations.count ),
+				static_cast<unsigned long long>( stats.allocations.bytes ) );
+		else
+			std::snprintf(
+				str, sizeof(str), "%s: %.3f ms, calls: %u",
+				stats.name, double(stats.time_ns) / 1000000.0, stats.calls );
+		out_lines.emplace_back( str );
+	}
+}
+
+bool DumpChromeTrace( const char* const file_name )
+{
+	std::FILE* const file= std::fopen( file_name, "w" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not write profiler trace \"", file_name, "\"" );
+		return false;
+	}
+
+	struct ThreadDump
+	{
+		unsigned int thread_number;
+		std::vector<Zone> zones;
+	};
+	std::vector<ThreadDump> threads_dumps;
+
+	uint64_t min_time_ns= ~uint64_t(0);
+	{
+		std::unique_lock<std::mutex> lock( g_threads_zones_mutex );
+		for( const ThreadZonesPtr& thread_zones : g_threads_zones )
+		{
+			std::unique_lock<std::mutex> thread_lock( thread_zones->mutex );
+
+			threads_dumps.emplace_back();
+			ThreadDump& dump= threads_dumps.back();
+			dump.thread_number= thread_zones->thread_number;
+
+			const uint64_t count= std::min( thread_zones->zones_written, uint64_t(g_zones_per_thread) );
+			const uint64_t first= thread_zones->zones_written - count;
+			dump.zones.reserve( count );
+			for( uint64_t i= first; i < thread_zones->zones_written; i++ )
+			{
+				const Zone& zone= thread_zones->zones[ i % g_zones_per_thread ];
+				dump.zones.push_back( zone );
+				min_time_ns= std::min( min_time_ns, zone.start_time_ns );
+			}
+		}
+	}
+
+	std::fprintf( file, "{\"traceEvents\":[\n" );
+
+	bool first_event= true;
+	unsigned int zones_count= 0u;
+	for( const ThreadDump& dump : threads_dumps )
+	{
+		for( const Zone& zone : dump.zones )
+		{
+			std::fprintf(
+				file,
+				"%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				first_event ? "" : ",\n",
+				zone.name,
+				dump.thread_number,
+				double( zone.start_time_ns - min_time_ns ) / 1000.0,
+				double( zone.end_time_ns - zone.start_time_ns ) / 1000.0 );
+			if( zone.allocations.count > 0u )
+				std::fprintf(
+					file,
+					",\"args\":{\"allocations\":%llu,\"allocated_bytes\":%llu}",
+					static_cast<unsigned long long>( zone.allocations.count ),
+					static_cast<unsigned long long>( zone.allocations.bytes ) );
+			std::fprintf( file, "}" );
+			first_event= false;
+			zones_count++;
+		}
+	}
+
+	std::fprintf( file, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+
+	const bool ok= std::ferror( file ) == 0;
+	if( std::fclose( file ) != 0 || !ok )
+	{
+		Log::Warning( "Error while writing profiler trace \"", file_name, "\"" );
+		return false;
+	}
+
+	Log::Info( "Profiler trace with ", zones_count, " zones of ", threads_dumps.size(), " threads written to \"", file_name, "\"" );
+	return true;
+}
+
+void SetLoadProfilingEnabled( const bool enabled )
+{
+	g_load_profiling_enabled.store( enabled );
+}
+
+bool LoadProfilingEnabled()
+{
+	return g_load_profiling_enabled.load( std::memory_order_relaxed );
+}
+
+void CountFileBytesRead( const uint64_t bytes )
+{
+	g_file_bytes_read.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+uint64_t GetTimeNs()
+{
+	#ifdef PC_PROFILER_USE_TSC
+	if( g_tsc_calibrated.load( std::memory_order_acquire ) )
+	{
+		const int64_t ticks= static_cast<int64_t>( __rdtsc() - g_tsc_base );
+		return static_cast<uint64_t>( int64_t(g_tsc_base_time_ns) + static_cast<int64_t>( double(ticks) * g_tsc_tick_ns ) );
+	}
+	#endif
+
+	return GetSteadyClockTimeNs();
+}
+
+void AddZone( const char* const name, const uint64_t start_time_ns, const uint64_t end_time_ns, const AllocationsCounters& start_allocations )
+{
+	// Read counters before possible allocation of thread buffer.
+	const AllocationsCounters end_allocations= g_thread_allocations;
+
+	ThreadZones& thread_zones= GetThreadZones();
+	std::unique_lock<std::mutex> lock( thread_zones.mutex );
+
+	Zone& zone= thread_zones.zones[ thread_zones.zones_written % g_zones_per_thread ];
+	zone.name= name;
+	zone.start_time_ns= start_time_ns;
+	zone.end_time_ns= end_time_ns;
+	zone.allocations.count= end_allocations.count - start_allocations.count;
+	zone.allocations.bytes= end_allocations.bytes - start_allocations.bytes;
+	thread_zones.zones_written++;
+}
+
+ScopedLoadStep::ScopedLoadStep( const char* const name )
+	: zone_( name )
+	, record_index_( -1 )
+{
+	if( !LoadProfilingEnabled() )
+		return;
+
+	if( g_thread_load_report == nullptr )
+	{
+		// Allocate report before allocations tracking start, so, report itself is not counted.
+		g_thread_load_report= new LoadReport;
+		g_thread_load_report->records.reserve( g_load_report_reserved_records );
+		g_thread_load_report->prev_allocations_tracking_enabled= AllocationsTrackingEnabled();
+		SetAllocationsTrackingEnabled( true );
+	}
+
+	LoadReport& report= *g_thread_load_report;
+	record_index_= int( report.records.size() );
+
+	report.records.emplace_back();
+	LoadStepRecord& record= report.records.back();
+	record.name= name;
+	record.depth= report.depth;
+	report.depth++;
+
+	// Use global counters, because steps may use worker threads.
+	record.start_file_bytes= g_file_bytes_read.load( std::memory_order_relaxed );
+	record.start_allocations= GetTotalAllocations();
+	record.start_time_ns= GetTimeNs();
+}
+
+ScopedLoadStep::~ScopedLoadStep()
+{
+	if( record_index_ < 0 || g_thread_load_report == nullptr )
+		return;
+
+	const uint64_t end_time_ns= GetTimeNs();
+	const AllocationsCounters end_allocations= GetTotalAllocations();
+	const uint64_t end_file_bytes= g_file_bytes_read.load( std::memory_order_relaxed );
+
+	LoadReport& report= *g_thread_load_report;
+	LoadStepRecord& record= report.records[ record_index_ ];
+	record.time_ns= end_time_ns - record.start_time_ns;
+	record.file_bytes= end_file_bytes - record.start_file_bytes;
+	record.allocations.count= end_allocations.count - record.start_allocations.count;
+	record.allocations.bytes= end_allocations.bytes - record.start_allocations.bytes;
+	report.depth--;
+
+	if( report.depth == 0u )
+	{
+		SetAllocationsTrackingEnabled( report.prev_allocations_tracking_enabled );
+		g_thread_load_report= nullptr;
+		LogLoadReport( report );
+		delete &report;
+	}
+}
+
+} // namespace Profiler
+
+} // namespace PanzerChasm
+
+// Replace global allocation functions for allocations tracking.
+
+void* operator new( const std::size_t size )
+{
+	if( void* const ptr= PanzerChasm::Profiler::Allocate( size ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[]( const std::size_t size )
+{
+	if( void* const ptr= PanzerChasm::Profiler::Allocate( size ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new( const std::size_t size, const std::nothrow_t& ) noexcept
+{
+	return PanzerChasm::Profiler::Allocate( size );
+}
+
+void* operator new[]( const std::size_t size, const std::nothrow_t& ) noexcept
+{
+	return PanzerChasm::Profiler::Allocate( size );
+}
+
+void operator delete( void* const ptr ) noexcept
+{
+	std::free( ptr );
+}
+
+void operator delete[]( void* const ptr ) noexcept
+{
+	std::free( ptr );
+}
+
+void operator delete( void* const ptr, const std::nothrow_t& ) noexcept
+{
+	std::free( ptr );
+}
+
+void operator delete[]( void* const ptr, const std::nothrow_t& ) noexcept
+{
+	std::free( ptr );
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PanzerChasm
+{
+
+// Lightweight CPU profiler with scoped zones.
+// Zones are written into thread-local ring buffers, so, only last zones are kept.
+// When profiler is disabled, zone costs only one atomic load.
+// Results can be written in Chrome trace format ("chrome://tracing", "Perfetto").
+// Optionally, profiler counts heap allocations (via global operator new) inside each zone.
+namespace Profiler
+{
+
+struct AllocationsCounters
+{
+	uint64_t count;
+	uint64_t bytes;
+};
+
+void Start();
+void Stop();
+bool IsEnabled();
+
+// Allocations tracking works independently from zones recording.
+// When tracking is disabled, operator new costs only one atomic load.
+void SetAllocationsTrackingEnabled( bool enabled );
+bool AllocationsTrackingEnabled();
+// Allocations of all threads since tracking start.
+AllocationsCounters GetTotalAllocations();
+
+// Call it once per frame. Aggregates zones of all threads, recorded since previous call.
+void EndFrame();
+// Adds lines with stats of last frame - time, calls and allocations of each zone name.
+// Counters of zone include counters of nested zones.
+void GetFrameStats( std::vector<std::string>& out_lines );
+
+// Writes zones of all threads. Returns true, if all ok.
+bool DumpChromeTrace( const char* file_name );
+
+// Load steps profiling. Works independently from zones recording.
+// Outermost load step of thread logs table with time, bytes read from Vfs and bytes allocated by each nested step.
+// Allocations tracking is enabled while outermost step is active.
+void SetLoadProfilingEnabled( bool enabled );
+bool LoadProfilingEnabled();
+
+// Called by Vfs for each read or mapped file.
+void CountFileBytesRead( uint64_t bytes );
+
+// Internal stuff.
+extern std::atomic<bool> g_enabled;
+extern std::atomic<bool> g_allocations_tracking_enabled;
+// Counters of current thread. Changed only while tracking is enabled.
+extern thread_local AllocationsCounters g_thread_allocations;
+
+uint64_t GetTimeNs();
+void AddZone( const char* name, uint64_t start_time_ns, uint64_t end_time_ns, const AllocationsCounters& start_allocations );
+
+class ScopedZone final
+{
+public:
+	// Name must be string literal.
+	explicit ScopedZone( const char* const name )
+		: name_( g_enabled.load( std::memory_order_relaxed ) ? name : nullptr )
+		, start_allocations_( name_ == nullptr ? AllocationsCounters{ 0u, 0u } : g_thread_allocations )
+		, start_time_ns_( name_ == nullptr ? 0u : GetTimeNs() )
+	{}
+
+	~ScopedZone()
+	{
+		if( name_ != nullptr )
+			AddZone( name_, start_time_ns_, GetTimeNs(), start_allocations_ );
+	}
+
+	ScopedZone( const ScopedZone& )= delete;
+	ScopedZone& operator=( const ScopedZone& )= delete;
+
+private:
+	const char* const name_;
+	const AllocationsCounters start_allocations_;
+	const uint64_t start_time_ns_;
+};
+
+// Sequence of zones for consecutive phases of long function.
+class ScopedPhases final
+{
+public:
+	// Names must be string literals.
+	explicit ScopedPhases( const char* const first_phase_name )
+		: phase_name_( g_enabled.load( std::memory_order_relaxed ) ? first_phase_name : nullptr )
+		, phase_start_allocations_( phase_name_ == nullptr ? AllocationsCounters{ 0u, 0u } : g_thread_allocations )
+		, phase_start_time_ns_( phase_name_ == nullptr ? 0u : GetTimeNs() )
+	{}
+
+	~ScopedPhases()
+	{
+		if( phase_name_ != nullptr )
+			AddZone( phase_name_, phase_start_time_ns_, GetTimeNs(), phase_start_allocations_ );
+	}
+
+	void Next( const char* const phase_name )
+	{
+		if( phase_name_ == nullptr )
+			return;
+
+		const uint64_t time_ns= GetTimeNs();
+		AddZone( phase_name_, phase_start_time_ns_, time_ns, phase_start_allocations_ );
+		phase_name_= phase_name;
+		phase_start_allocations_= g_thread_allocations; // Read after AddZone, which may allocate.
+		phase_start_time_ns_= time_ns;
+	}
+
+	ScopedPhases( const ScopedPhases& )= delete;
+	ScopedPhases& operator=( const ScopedPhases& )= delete;
+
+private:
+	const char* phase_name_;
+	AllocationsCounters phase_start_allocations_;
+	uint64_t phase_start_time_ns_;
+};
+
+// Load step - zone, which also is recorded into load report, if load profiling is enabled.
+class ScopedLoadStep final
+{
+public:
+	// Name must be string literal.
+	explicit ScopedLoadStep( const char* name );
+	~ScopedLoadStep();
+
+	ScopedLoadStep( const ScopedLoadStep& )= delete;
+	ScopedLoadStep& operator=( const ScopedLoadStep& )= delete;
+
+private:
+	const ScopedZone zone_;
+	int record_index_; // Negative, if load profiling is disabled.
+};
+
+} // namespace Profiler
+
+#define PC_PROFILER_CONCAT_IMPL( a, b ) a##b
+#define PC_PROFILER_CONCAT( a, b ) PC_PROFILER_CONCAT_IMPL( a, b )
+
+// Profile code until end of current scope.
+#define PC_PROFILE_SCOPE( name ) const ::PanzerChasm::Profiler::ScopedZone PC_PROFILER_CONCAT( profiler_zone_, __LINE__ )( name )
+
+// Profile load step until end of current scope.
+#define PC_PROFILE_LOAD_STEP( name ) const ::PanzerChasm::Profiler::ScopedLoadStep PC_PROFILER_CONCAT( profiler_load_step_, __LINE__ )( name )
+
+} // namespace PanzerChasm
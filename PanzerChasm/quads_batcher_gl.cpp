@@ -0,0 +1,137 @@
+#include <algorithm>
+
+#include "quads_batcher_gl.hpp"
+
+namespace PanzerChasm
+{
+
+// Size of vertex buffer. Must be not greater, than 65536 / 4, because indeces are 16bit.
+static const unsigned int g_max_quads= 4096u;
+
+QuadsBatcherGL::QuadsBatcherGL( const Size2& viewport_size )
+	: viewport_size_(viewport_size)
+{
+	std::vector<unsigned short> indeces( 6u * g_max_quads );
+	for( unsigned int i= 0u; i < g_max_quads; i++ )
+	{
+		unsigned short* const ind= indeces.data() + 6u * i;
+		ind[0]= 4u * i + 0u;  ind[1]= 4u * i + 1u;  ind[2]= 4u * i + 2u;
+		ind[3]= 4u * i + 0u;  ind[4]= 4u * i + 2u;  ind[5]= 4u * i + 3u;
+	}
+
+	polygon_buffer_.VertexData( nullptr, 4u * g_max_quads * sizeof(Vertex), sizeof(Vertex) );
+	polygon_buffer_.IndexData(
+		indeces.data(),
+		indeces.size() * sizeof(unsigned short),
+		GL_UNSIGNED_SHORT,
+		GL_TRIANGLES );
+
+	Vertex v;
+	polygon_buffer_.VertexAttribPointer(
+		0,
+		2, GL_SHORT, false,
+		((char*)v.xy) - (char*)&v );
+	polygon_buffer_.VertexAttribPointer(
+		1,
+		2, GL_SHORT, false,
+		((char*)v.tex_coord) - (char*)&v );
+
+	vertices_.reserve( 4u * 256u );
+	batches_.reserve( 64u );
+}
+
+QuadsBatcherGL::~QuadsBatcherGL()
+{}
+
+QuadsBatcherGL::Vertex* QuadsBatcherGL::AddQuads( const r_Texture& texture, const unsigned int quad_count )
+{
+	const unsigned int first_quad= vertices_.size() / 4u;
+
+	if( !batches_.empty() && batches_.back().texture == &texture )
+		batches_.back().quad_count+= quad_count;
+	else
+		batches_.push_back( Batch{ &texture, first_quad, quad_count } );
+
+	vertices_.resize( vertices_.size() + 4u * quad_count );
+	return vertices_.data() + 4u * first_quad;
+}
+
+void QuadsBatcherGL::Flush( ShaderProgramGL& shader, const r_OGLState& state )
+{
+	if( batches_.empty() )
+		return;
+
+	r_OGLStateManager::UpdateState( state );
+
+	shader.Bind();
+	shader.Uniform( "tex", int(0) );
+	shader.Uniform(
+		"inv_viewport_size",
+		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
+
+	polygon_buffer_.Bind();
+
+	const unsigned int total_quads= vertices_.size() / 4u;
+	unsigned int uploaded_end= 0u; // End of uploaded range of source quads.
+	unsigned int upload_source_begin= 0u;
+	unsigned int upload_buffer_begin= 0u;
+	const r_Texture* current_texture= nullptr;
+
+	for( const Batch& batch : batches_ )
+	{
+		unsigned int quad= batch.first_quad;
+		unsigned int quads_left= batch.quad_count;
+		while( quads_left > 0u )
+		{
+			if( quad >= uploaded_end )
+			{
+				// Orphan buffer storage, if rest of quads does not fit into it.
+				// Driver gives us new storage, while previous draws still read old storage.
+				if( buffer_used_quads_ > 0u && total_quads - quad > g_max_quads - buffer_used_quads_ )
+				{
+					polygon_buffer_.VertexData( nullptr, 4u * g_max_quads * sizeof(Vertex), sizeof(Vertex) );
+					buffer_used_quads_= 0u;
+				}
+
+				const unsigned int quads_to_upload= std::min( total_quads - quad, g_max_quads - buffer_used_quads_ );
+				polygon_buffer_.VertexSubData(
+					vertices_.data() + 4u * quad,
+					4u * quads_to_upload * sizeof(Vertex),
+					4u * buffer_used_quads_ * sizeof(Vertex) );
+
+				upload_source_begin= quad;
+				upload_buffer_begin= buffer_used_quads_;
+				uploaded_end= quad + quads_to_upload;
+				buffer_used_quads_+= quads_to_upload;
+			}
+
+			if( batch.texture != current_texture )
+			{
+				current_texture= batch.texture;
+				current_texture->Bind(0u);
+				shader.Uniform(
+					"inv_texture_size",
+					m_Vec2(
+						1.0f / float(current_texture->Width ()),
+						1.0f / float(current_texture->Height()) ) );
+			}
+
+			const unsigned int quads_to_draw= std::min( quads_left, uploaded_end - quad );
+			const unsigned int first_buffer_quad= upload_buffer_begin + ( quad - upload_source_begin );
+
+			glDrawElements(
+				GL_TRIANGLES,
+				quads_to_draw * 6u,
+				GL_UNSIGNED_SHORT,
+				reinterpret_cast<void*>( first_buffer_quad * 6u * sizeof(unsigned short) ) );
+
+			quad+= quads_to_draw;
+			quads_left-= quads_to_draw;
+		}
+	}
+
+	vertices_.clear();
+	batches_.clear();
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include <ogl_state_manager.hpp>
+#include <polygon_buffer.hpp>
+#include <texture.hpp>
+
+#include "shader_program_gl.hpp"
+#include "size.hpp"
+
+namespace PanzerChasm
+{
+
+// Accumulates textured 2d quads and draws them with as few draw calls, as possible.
+// All quads are streamed into one dynamic vertex buffer. Each flush appends data after data of previous flush,
+// buffer storage is orphaned only when it is full, so, gpu never waits for previous draws.
+// Shared between 2d drawers, shader must have "tex", "inv_viewport_size" and "inv_texture_size" uniforms.
+class QuadsBatcherGL final
+{
+public:
+	struct Vertex
+	{
+		short xy[2];
+		short tex_coord[2]; // In texels.
+	};
+
+	explicit QuadsBatcherGL( const Size2& viewport_size );
+	~QuadsBatcherGL();
+
+	// Returns pointer to 4 * quad_count vertices for filling.
+	// Texture must live until flush.
+	Vertex* AddQuads( const r_Texture& texture, unsigned int quad_count );
+
+	// Draw all quads, added after previous flush.
+	// Drawing order is preserved, adjacent quads with same texture are drawn by one draw call.
+	// So, callers should add quads grouped by texture, where order does not matter.
+	void Flush( ShaderProgramGL& shader, const r_OGLState& state );
+
+private:
+	struct Batch
+	{
+		const r_Texture* texture;
+		unsigned int first_quad;
+		unsigned int quad_count;
+	};
+
+private:
+	const Size2 viewport_size_;
+
+	r_PolygonBuffer polygon_buffer_;
+	unsigned int buffer_used_quads_= 0u;
+
+	std::vector<Vertex> vertices_;
+	std::vector<Batch> batches_;
+};
+
+typedef std::shared_ptr<QuadsBatcherGL> QuadsBatcherGLPtr;
+
+} // namespace PanzerChasm
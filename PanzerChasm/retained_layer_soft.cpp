@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cstring>
+
+#include "retained_layer_soft.hpp"
+
+namespace PanzerChasm
+{
+
+void RetainedLayerSoft::Reset( const unsigned int size_x, const unsigned int size_y )
+{
+	size_[0]= size_x;
+	size_[1]= size_y;
+	pixels_.resize( size_x * size_y );
+	std::fill( pixels_.begin(), pixels_.end(), 0u );
+	spans_.clear();
+}
+
+void RetainedLayerSoft::BuildSpans()
+{
+	spans_.clear();
+
+	for( unsigned int y= 0u; y < size_[1]; y++ )
+	{
+		const uint32_t* const src= pixels_.data() + y * size_[0];
+
+		unsigned int x= 0u;
+		while( x < size_[0] )
+		{
+			while( x < size_[0] && src[x] == 0u )
+				x++;
+			if( x == size_[0] )
+				break;
+
+			Span span;
+			span.y= y;
+			span.x_begin= x;
+			while( x < size_[0] && src[x] != 0u )
+				x++;
+			span.x_end= x;
+			spans_.push_back( span );
+		}
+	}
+}
+
+void RetainedLayerSoft::BuildOpaqueSpans()
+{
+	spans_.resize( size_[0] > 0u ? size_[1] : 0u );
+	for( unsigned int y= 0u; y < spans_.size(); y++ )
+	{
+		spans_[y].y= y;
+		spans_[y].x_begin= 0u;
+		spans_[y].x_end= size_[0];
+	}
+}
+
+void RetainedLayerSoft::Draw( const RenderingContextSoft& rendering_context, const int x, const int y ) const
+{
+	uint32_t* const dst_pixels= rendering_context.window_surface_data;
+	const int dst_row_pixels= rendering_context.row_pixels;
+	const int max_x= int( rendering_context.viewport_size.Width () );
+	const int max_y= int( rendering_context.viewport_size.Height() );
+
+	for( const Span& span : spans_ )
+	{
+		const int dst_y= y + int(span.y);
+		if( dst_y < 0 || dst_y >= max_y )
+			continue;
+
+		const int dst_x_begin= std::max( x + int(span.x_begin), 0 );
+		const int dst_x_end= std::min( x + int(span.x_end), max_x );
+		if( dst_x_begin >= dst_x_end )
+			continue;
+
+		std::memcpy(
+			dst_pixels + dst_x_begin + dst_y * dst_row_pixels,
+			pixels_.data() + ( dst_x_begin - x ) + int(span.y * size_[0]),
+			sizeof(uint32_t) * static_cast<unsigned int>( dst_x_end - dst_x_begin ) );
+	}
+}
+
+} // namespace PanzerChasm
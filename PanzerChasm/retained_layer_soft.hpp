@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "rendering_context.hpp"
+
+namespace PanzerChasm
+{
+
+// Retained image for software drawers.
+// Owner draws image content only when it changes, then image is composited into frame each frame.
+// Pixels with value 0 are transparent. Opaque colors from transformed palette always have nonzero alpha,
+// so, this key does not conflict with them.
+// Image stores spans of opaque pixels, so, compositing is just copying of them.
+class RetainedLayerSoft final
+{
+public:
+	// Resize and clear image - make all pixels transparent.
+	void Reset( unsigned int size_x, unsigned int size_y );
+
+	unsigned int GetSizeX() const { return size_[0]; }
+	unsigned int GetSizeY() const { return size_[1]; }
+	uint32_t* GetPixels() { return pixels_.data(); }
+
+	// Call after drawing into pixels.
+	void BuildSpans();
+	// Treat all pixels as opaque, including zero pixels.
+	void BuildOpaqueSpans();
+
+	// Copy opaque pixels into target. Image is clipped by target viewport.
+	void Draw( const RenderingContextSoft& rendering_context, int x, int y ) const;
+
+private:
+	struct Span
+	{
+		unsigned int y;
+		unsigned int x_begin;
+		unsigned int x_end;
+	};
+
+private:
+	unsigned int size_[2]= { 0u, 0u };
+	std::vector<uint32_t> pixels_;
+	std::vector<Span> spans_;
+};
+
+} // namespace PanzerChasm
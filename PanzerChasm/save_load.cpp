@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cctype>
+#include <cstdio>
 #include <cstring>
 
 // Include OS-dependend stuff for "mkdir".
@@ -13,6 +15,7 @@
 using namespace ChasmReverse;
 
 #include "log.hpp"
+#include "lz_compression.hpp"
 
 #include "save_load.hpp"
 
@@ -23,7 +26,10 @@ namespace PanzerChasm
 
 const char SaveHeader::c_expected_id[8]= "PanChSv"; // PanzerChasmSave
 
-static unsigned int g_crc_table[256u];
+// Tables for "slicing-by-8" CRC calculation. First table is ordinary byte-at-a-time table.
+// Each next table is table for byte, followed by one more zero byte.
+static const unsigned int g_crc_slices= 8u;
+static unsigned int g_crc_table[g_crc_slices][256u];
 
 static void InitCRCTable()
 {
@@ -35,8 +41,12 @@ static void InitCRCTable()
 		for(unsigned int j= 0u; j < 8u; j++ )
 			crc= ( ( crc & 1u ) != 0u ) ? ( (crc>>1u) ^ 0xEDB88320u ) : ( crc >> 1u );
 
-		g_crc_table[i]= crc;
+		g_crc_table[0][i]= crc;
 	}
+
+	for( unsigned int k= 1u; k < g_crc_slices; k++ )
+	for( unsigned int i= 0u; i < 256u; i++ )
+		g_crc_table[k][i]= ( g_crc_table[k-1u][i] >> 8u ) ^ g_crc_table[0][ g_crc_table[k-1u][i] & 0xFFu ];
 }
 
 // TODO - init table at compile time.
@@ -50,39 +60,151 @@ static const bool g_crc_table_init=
 SaveHeader::HashType SaveHeader::CalculateHash( const unsigned char* data, unsigned int data_size )
 {
 	// Calculate CRC-32 here.
+	// Process 8 bytes per iteration, using "slicing-by-8". Result is same, as for byte-at-a-time calculation.
 
 	unsigned int crc= 0xFFFFFFFFu;
-	for( unsigned int i= 0u; i < data_size; i++ )
+	unsigned int i= 0u;
+	for( ; i + g_crc_slices <= data_size; i+= g_crc_slices )
+	{
+		const unsigned char* const d= data + i;
+		const unsigned int lo= crc ^ ( d[0] | ( d[1] << 8u ) | ( d[2] << 16u ) | ( static_cast<unsigned int>( d[3] ) << 24u ) );
+
+		crc=
+			g_crc_table[7][ lo & 0xFFu ] ^
+			g_crc_table[6][ ( lo >> 8u ) & 0xFFu ] ^
+			g_crc_table[5][ ( lo >> 16u ) & 0xFFu ] ^
+			g_crc_table[4][ lo >> 24u ] ^
+			g_crc_table[3][ d[4] ] ^
+			g_crc_table[2][ d[5] ] ^
+			g_crc_table[1][ d[6] ] ^
+			g_crc_table[0][ d[7] ];
+	}
+
+	for( ; i < data_size; i++ )
 	{
-		crc= g_crc_table[ ( crc ^ data[i] ) & 0xFFu ] ^ (crc >> 8u);
+		crc= g_crc_table[0][ ( crc ^ data[i] ) & 0xFFu ] ^ (crc >> 8u);
 	}
 
 	return crc;
 }
 
+// Save content is compressed by blocks, because LZ compression supports only small blocks.
+// Each block starts with 2 bytes of compressed size and 2 bytes of uncompressed size.
+// Zero compressed size means, that block is stored without compression.
+static const unsigned int g_compression_block_size= 32768u;
+static const unsigned int g_compression_block_header_size= 4u;
+
+static void CompressSaveContent( const SaveLoadBuffer& data, std::vector<unsigned char>& out_compressed )
+{
+	out_compressed.resize(
+		( data.size() + g_compression_block_size - 1u ) / g_compression_block_size * g_compression_block_header_size +
+		data.size() );
+
+	unsigned int out_pos= 0u;
+	for( unsigned int block_start= 0u; block_start < data.size(); block_start+= g_compression_block_size )
+	{
+		const unsigned int block_size= std::min( static_cast<unsigned int>( data.size() ) - block_start, g_compression_block_size );
+		unsigned char* const block_header= out_compressed.data() + out_pos;
+		out_pos+= g_compression_block_header_size;
+
+		// Compressed data must be smaller, than source data, else - store data without compression.
+		const unsigned int compressed_size=
+			LzCompress(
+				data.data() + block_start, block_size,
+				out_compressed.data() + out_pos, block_size - 1u );
+		if( compressed_size == 0u )
+			std::memcpy( out_compressed.data() + out_pos, data.data() + block_start, block_size );
+
+		block_header[0]= compressed_size & 0xFFu;
+		block_header[1]= compressed_size >> 8u;
+		block_header[2]= block_size & 0xFFu;
+		block_header[3]= block_size >> 8u;
+		out_pos+= compressed_size == 0u ? block_size : compressed_size;
+	}
+
+	out_compressed.resize( out_pos );
+}
+
+// Decompress block by block directly into result buffer. Returns true, if all ok.
+static bool DecompressSaveContent( const std::vector<unsigned char>& compressed, SaveLoadBuffer& out_data )
+{
+	unsigned int pos= 0u;
+	unsigned int out_pos= 0u;
+	while( pos < compressed.size() )
+	{
+		if( pos + g_compression_block_header_size > compressed.size() )
+			return false;
+
+		const unsigned int compressed_size= compressed[ pos + 0u ] | ( compressed[ pos + 1u ] << 8u );
+		const unsigned int block_size= compressed[ pos + 2u ] | ( compressed[ pos + 3u ] << 8u );
+		pos+= g_compression_block_header_size;
+
+		const unsigned int stored_size= compressed_size == 0u ? block_size : compressed_size;
+		if( pos + stored_size > compressed.size() || out_pos + block_size > out_data.size() )
+			return false;
+
+		if( compressed_size == 0u )
+			std::memcpy( out_data.data() + out_pos, compressed.data() + pos, block_size );
+		else if(
+			LzDecompress(
+				compressed.data() + pos, compressed_size,
+				out_data.data() + out_pos, block_size ) != block_size )
+			return false;
+
+		pos+= stored_size;
+		out_pos+= block_size;
+	}
+
+	return out_pos == out_data.size();
+}
+
 bool SaveData(
 	const char* file_name,
 	const SaveComment& save_comment,
 	const SaveLoadBuffer& data )
 {
-	FILE* f= std::fopen( file_name, "wb" );
+	const std::string temp_file_name= std::string( file_name ) + ".tmp";
+
+	FILE* f= std::fopen( temp_file_name.c_str(), "wb" );
 	if( f == nullptr )
 	{
 		Log::Warning( "Can not write save \"", file_name, "\"" );
 		return false;
 	}
 
+	std::vector<unsigned char> compressed_data;
+	CompressSaveContent( data, compressed_data );
+
 	SaveHeader header;
 	std::memcpy( header.id, SaveHeader::c_expected_id, sizeof(header.id) );
 	header.version= SaveHeader::c_expected_version;
-	header.content_size= data.size();
-	header.content_hash= SaveHeader::CalculateHash( data.data(), data.size() );
+	header.content_size= compressed_data.size();
+	header.content_hash= SaveHeader::CalculateHash( compressed_data.data(), compressed_data.size() );
+	header.uncompressed_content_size= data.size();
 
 	FileWrite( f, &header, sizeof(SaveHeader) );
 	FileWrite( f, save_comment.data(), sizeof(SaveComment) );
-	FileWrite( f, data.data(), data.size() );
+	FileWrite( f, compressed_data.data(), compressed_data.size() );
+
+	const bool write_failed= std::ferror( f ) != 0;
+	if( std::fclose(f) != 0 || write_failed )
+	{
+		Log::Warning( "Can not write save \"", file_name, "\"" );
+		std::remove( temp_file_name.c_str() );
+		return false;
+	}
+
+#ifdef _WIN32
+	// "rename" on Windows does not replace existing files.
+	std::remove( file_name );
+#endif
+	if( std::rename( temp_file_name.c_str(), file_name ) != 0 )
+	{
+		Log::Warning( "Can not write save \"", file_name, "\"" );
+		std::remove( temp_file_name.c_str() );
+		return false;
+	}
 
-	std::fclose(f);
 	return true;
 }
 
@@ -136,19 +258,32 @@ bool LoadData(
 	SaveComment save_comment;
 	FileRead( f, save_comment.data(), sizeof(SaveComment) );
 
-	out_data.resize( content_size );
-	FileRead( f, out_data.data(), out_data.size() );
+	std::vector<unsigned char> compressed_data( content_size );
+	FileRead( f, compressed_data.data(), compressed_data.size() );
+	std::fclose(f);
+
+	if( header.content_hash != SaveHeader::CalculateHash( compressed_data.data(), compressed_data.size() ) )
+	{
+		Log::Warning( "Save file is broken - saved content hash is different from actual content hash." );
+		return false;
+	}
+
+	// Each compressed block contains at least one byte per 255 decompressed bytes.
+	if( header.uncompressed_content_size / 256u > content_size )
+	{
+		Log::Warning( "Save file is broken - invalid uncompressed size." );
+		return false;
+	}
 
-	if( header.content_hash != SaveHeader::CalculateHash( out_data.data(), out_data.size() ) )
+	out_data.resize( header.uncompressed_content_size );
+	if( !DecompressSaveContent( compressed_data, out_data ) )
 	{
 		out_data.clear();
 
-		Log::Warning( "Save file is broken - saved content hash is different from actual content hash." );
-		std::fclose(f);
+		Log::Warning( "Save file is broken - can not decompress content." );
 		return false;
 	}
 
-	std::fclose(f);
 	return true;
 }
 
@@ -196,4 +331,38 @@ void CreateSlotSavesDir()
 #endif
 }
 
+SavesWriter::SavesWriter()
+{}
+
+SavesWriter::~SavesWriter()
+{
+	Flush();
+}
+
+void SavesWriter::Write( const char* const file_name, const SaveComment& save_comment, SaveLoadBuffer data )
+{
+	// Keep order of writes into same file.
+	Flush();
+
+	write_future_=
+		std::async(
+			std::launch::async,
+			[]( const std::string& file_name, const SaveComment& save_comment, const SaveLoadBuffer& data )
+			{
+				if( SaveData( file_name.c_str(), save_comment, data ) )
+					Log::User( "Game saved." );
+				else
+					Log::User( "Game save failed." );
+			},
+			std::string( file_name ),
+			save_comment,
+			std::move(data) );
+}
+
+void SavesWriter::Flush()
+{
+	if( write_future_.valid() )
+		write_future_.get();
+}
+
 } // namespace PanzerChasm
@@ -1,4 +1,7 @@
 #pragma once
+#include <future>
+#include <string>
+
 #include "assert.hpp"
 #include "fwd.hpp"
 
@@ -11,7 +14,7 @@ public:
 	typedef unsigned int HashType;
 
 	static const char c_expected_id[8];
-	static constexpr unsigned int c_expected_version= 0x109u; // Change each time, when format changed.
+	static constexpr unsigned int c_expected_version= 0x10Du; // Change each time, when format changed.
 
 public:
 	static HashType CalculateHash( const unsigned char* data, unsigned int data_size );
@@ -19,13 +22,16 @@ public:
 public:
 	unsigned char id[8]; // must be equal to c_expected_id
 	unsigned int version;
-	unsigned int content_size;
-	unsigned int content_hash;
+	unsigned int content_size; // Size of compressed content.
+	unsigned int content_hash; // Hash of compressed content.
+	unsigned int uncompressed_content_size;
 };
 
-SIZE_ASSERT( SaveHeader, 20u );
+SIZE_ASSERT( SaveHeader, 24u );
 
-// Returns true, if all ok
+// Returns true, if all ok.
+// Data is written into temporary file, which is renamed to "file_name" after successful writing.
+// So, old save is not lost, if writing fails.
 bool SaveData(
 	const char* file_name,
 	const SaveComment& save_comment,
@@ -47,4 +53,20 @@ void GetSaveFileNameForSlot(
 
 void CreateSlotSavesDir();
 
+// Writes saves in background. Caller may continue right after passing save data snapshot.
+class SavesWriter final
+{
+public:
+	SavesWriter();
+	~SavesWriter();
+
+	void Write( const char* file_name, const SaveComment& save_comment, SaveLoadBuffer data );
+
+	// Wait for finishing of all started writes. Call it before reading saves.
+	void Flush();
+
+private:
+	std::future<void> write_future_;
+};
+
 } // namespace PanzerChasm
@@ -5,6 +5,7 @@
 
 #include <vec.hpp>
 
+#include "assert.hpp"
 #include "fwd.hpp"
 #include "time.hpp"
 
@@ -45,6 +46,13 @@ public:
 
 	void WriteTime( const Time& time );
 
+	// Write array of basic type values with one copying.
+	template<class T>
+	void WriteArray( const T* data, unsigned int count );
+
+	// Reserve space for approximately "size" more bytes, to prevent buffer reallocations.
+	void Reserve( unsigned int size );
+
 private:
 	template<class T>
 	void Write( const T& t );
@@ -79,6 +87,9 @@ public:
 
 	void ReadTime( Time& time );
 
+	template<class T>
+	void ReadArray( T* data, unsigned int count );
+
 private:
 	template<class T>
 	void Read( T& t );
@@ -179,6 +190,26 @@ inline void SaveStream::WriteTime( const Time& time )
 	Write( ( time - base_time_ ).GetInternalRepresentation() );
 }
 
+template<class T>
+void SaveStream::WriteArray( const T* const data, const unsigned int count )
+{
+	static_assert(
+		std::is_integral<T>::value || std::is_floating_point<T>::value,
+		"Expected basic types" );
+
+	const size_t pos= buffer_.size();
+	buffer_.resize( pos + sizeof(T) * count );
+	std::memcpy(
+		buffer_.data() + pos,
+		data,
+		sizeof(T) * count );
+}
+
+inline void SaveStream::Reserve( const unsigned int size )
+{
+	buffer_.reserve( buffer_.size() + size );
+}
+
 template<class T>
 void SaveStream::Write( const T& t )
 {
@@ -194,4 +225,21 @@ void SaveStream::Write( const T& t )
 		sizeof(T) );
 }
 
+template<class T>
+void LoadStream::ReadArray( T* const data, const unsigned int count )
+{
+	static_assert(
+		std::is_integral<T>::value || std::is_floating_point<T>::value,
+		"Expected basic types" );
+
+	PC_ASSERT( buffer_pos_ + sizeof(T) * count <= buffer_.size() );
+
+	std::memcpy(
+		data,
+		buffer_.data() + buffer_pos_,
+		sizeof(T) * count );
+
+	buffer_pos_+= sizeof(T) * count;
+}
+
 } // PanzerChasm
@@ -1,8 +1,7 @@
 #pragma once
-#include <memory>
-
 #include <vec.hpp>
 
+#include "../entities_container.hpp"
 #include "../game_constants.hpp"
 
 namespace PanzerChasm
@@ -25,7 +24,6 @@ struct Backpack final
 	unsigned char armor= 0;
 };
 
-typedef std::unique_ptr<Backpack> BackpackPtr;
-typedef std::unique_ptr<const Backpack> BackpackConstPtr;
+typedef EntitiesContainer<Backpack> BackpacksContainer;
 
 } // namespace PanzerChasm
@@ -1,6 +1,11 @@
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
+
 #include "../assert.hpp"
+#include "../game_constants.hpp"
 
-#include "collision_index.hpp"
+#include "collision_index.inl"
 
 namespace PanzerChasm
 {
@@ -94,10 +99,29 @@ CollisionIndex::CollisionIndex( const MapDataConstPtr& map_data )
 		}
 	} // for static walls
 
+	dynamic_index_field_.resize( MapData::c_map_size * MapData::c_map_size );
+
+	dynamic_walls_count_= map_data->dynamic_walls.size();
+	dynamic_elements_.resize( dynamic_walls_count_ );
+	for( unsigned int w= 0u; w < dynamic_walls_count_; w++ )
+	{
+		dynamic_elements_[w].index_element.type= MapData::IndexElement::DynamicWall;
+		dynamic_elements_[w].index_element.index= w;
+	}
+
+	models_dynamic_elements_.resize( map_data->static_models.size() );
+	for( unsigned short& i : models_dynamic_elements_ )
+		i= IndexElement::c_dummy_next;
+
 	const auto add_model_to_dynamics_list=
 	[&]( const MapData::StaticModel& model )
 	{
-		dynamic_models_indeces_.emplace_back( &model - map_data->static_models.data() );
+		const unsigned int model_index= &model - map_data->static_models.data();
+		models_dynamic_elements_[ model_index ]= dynamic_elements_.size();
+
+		dynamic_elements_.emplace_back();
+		dynamic_elements_.back().index_element.type= MapData::IndexElement::StaticModel;
+		dynamic_elements_.back().index_element.index= model_index;
 	};
 
 	for( const MapData::StaticModel& model : map_data->static_models )
@@ -130,6 +154,83 @@ CollisionIndex::CollisionIndex( const MapDataConstPtr& map_data )
 		for( int x= x_start; x <= x_end; x++ )
 			AddElementToIndex( x, y, model_index_element );
 	} // for models
+
+	PC_ASSERT( dynamic_elements_.size() < IndexElement::c_dummy_next );
+
+	// Copy walls from linked lists into batches.
+	ray_walls_cells_offsets_.resize( MapData::c_map_size * MapData::c_map_size + 1u );
+	for( unsigned int cell_index= 0u; cell_index < MapData::c_map_size * MapData::c_map_size; cell_index++ )
+	{
+		ray_walls_cells_offsets_[ cell_index ]= ray_walls_indeces_.size();
+
+		unsigned short i= index_field_[ cell_index ];
+		while( i != IndexElement::c_dummy_next )
+		{
+			const MapData::IndexElement& element= index_elements_[i].index_element;
+			i= index_elements_[i].next;
+
+			if( element.type != MapData::IndexElement::StaticWall )
+				continue;
+
+			const MapData::Wall& wall= map_data->static_walls[ element.index ];
+			if( map_data->walls_textures[ wall.texture_id ].gso[1] )
+				continue;
+
+			ray_walls_x_.push_back( wall.vert_pos[0].x );
+			ray_walls_y_.push_back( wall.vert_pos[0].y );
+			ray_walls_dx_.push_back( wall.vert_pos[1].x - wall.vert_pos[0].x );
+			ray_walls_dy_.push_back( wall.vert_pos[1].y - wall.vert_pos[0].y );
+			ray_walls_indeces_.push_back( element.index );
+		}
+
+		while( ray_walls_indeces_.size() % c_ray_walls_batch_size != 0u )
+		{
+			ray_walls_x_.push_back( 0.0f );
+			ray_walls_y_.push_back( 0.0f );
+			ray_walls_dx_.push_back( 0.0f );
+			ray_walls_dy_.push_back( 0.0f );
+			ray_walls_indeces_.push_back( 0u );
+		}
+	}
+	ray_walls_cells_offsets_.back()= ray_walls_indeces_.size();
+
+	// Same for collision batches.
+	const float c_padding_wall_pos= -1.0e6f;
+	collision_walls_cells_offsets_.resize( MapData::c_map_size * MapData::c_map_size + 1u );
+	for( unsigned int cell_index= 0u; cell_index < MapData::c_map_size * MapData::c_map_size; cell_index++ )
+	{
+		collision_walls_cells_offsets_[ cell_index ]= collision_walls_indeces_.size();
+
+		unsigned short i= index_field_[ cell_index ];
+		while( i != IndexElement::c_dummy_next )
+		{
+			const MapData::IndexElement& element= index_elements_[i].index_element;
+			i= index_elements_[i].next;
+
+			if( element.type != MapData::IndexElement::StaticWall )
+				continue;
+
+			const MapData::Wall& wall= map_data->static_walls[ element.index ];
+			if( map_data->walls_textures[ wall.texture_id ].gso[0] )
+				continue;
+
+			collision_walls_x_.push_back( wall.vert_pos[0].x );
+			collision_walls_y_.push_back( wall.vert_pos[0].y );
+			collision_walls_dx_.push_back( wall.vert_pos[1].x - wall.vert_pos[0].x );
+			collision_walls_dy_.push_back( wall.vert_pos[1].y - wall.vert_pos[0].y );
+			collision_walls_indeces_.push_back( element.index );
+		}
+
+		while( collision_walls_indeces_.size() % c_line_segments_batch_size != 0u )
+		{
+			collision_walls_x_.push_back( c_padding_wall_pos );
+			collision_walls_y_.push_back( c_padding_wall_pos );
+			collision_walls_dx_.push_back( 0.0f );
+			collision_walls_dy_.push_back( 0.0f );
+			collision_walls_indeces_.push_back( 0u );
+		}
+	}
+	collision_walls_cells_offsets_.back()= collision_walls_indeces_.size();
 }
 
 CollisionIndex::~CollisionIndex()
@@ -153,4 +254,219 @@ void CollisionIndex::AddElementToIndex( unsigned int x, unsigned int y, const Ma
 	index_field_[ x + y * MapData::c_map_size ]= index_elements_.size() - 1u;
 }
 
+bool CollisionIndex::RayCastStaticWalls(
+	const m_Vec3& pos, const m_Vec3& dir_normalized,
+	const float max_cast_distance,
+	float& out_distance, unsigned int& out_wall_index ) const
+{
+	/* Solve "pos.xy + dir.xy * t = wall_v0 + wall_d * s".
+	 * Intersection exists for t > 0, s in [0; 1] and intersection z inside walls height.
+	 */
+	float nearest_t= max_cast_distance;
+	bool found= false;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	const __m128 pos_x= _mm_set1_ps( pos.x );
+	const __m128 pos_y= _mm_set1_ps( pos.y );
+	const __m128 pos_z= _mm_set1_ps( pos.z );
+	const __m128 dir_x= _mm_set1_ps( dir_normalized.x );
+	const __m128 dir_y= _mm_set1_ps( dir_normalized.y );
+	const __m128 dir_z= _mm_set1_ps( dir_normalized.z );
+	const __m128 zero= _mm_setzero_ps();
+	const __m128 one= _mm_set1_ps( 1.0f );
+	const __m128 walls_height= _mm_set1_ps( GameConstants::walls_height );
+#endif
+
+	TraverseRayCells(
+		pos, dir_normalized, max_cast_distance,
+		[&]( const unsigned int cell_index, const float t_cell_exit ) -> bool
+		{
+			const unsigned int begin= ray_walls_cells_offsets_[ cell_index     ];
+			const unsigned int end  = ray_walls_cells_offsets_[ cell_index + 1u];
+
+			for( unsigned int i= begin; i < end; i+= c_ray_walls_batch_size )
+			{
+#ifdef PC_SSE2_INSTRUCTIONS
+				const __m128 vec_x= _mm_sub_ps( _mm_loadu_ps( ray_walls_x_.data() + i ), pos_x );
+				const __m128 vec_y= _mm_sub_ps( _mm_loadu_ps( ray_walls_y_.data() + i ), pos_y );
+				const __m128 wall_dx= _mm_loadu_ps( ray_walls_dx_.data() + i );
+				const __m128 wall_dy= _mm_loadu_ps( ray_walls_dy_.data() + i );
+
+				const __m128 denominator= _mm_sub_ps( _mm_mul_ps( dir_x, wall_dy ), _mm_mul_ps( dir_y, wall_dx ) );
+				const __m128 t= _mm_div_ps( _mm_sub_ps( _mm_mul_ps( vec_x, wall_dy ), _mm_mul_ps( vec_y, wall_dx ) ), denominator );
+				const __m128 s= _mm_div_ps( _mm_sub_ps( _mm_mul_ps( vec_x, dir_y ), _mm_mul_ps( vec_y, dir_x ) ), denominator );
+				const __m128 z= _mm_add_ps( pos_z, _mm_mul_ps( dir_z, t ) );
+
+				__m128 mask= _mm_cmpneq_ps( denominator, zero );
+				mask= _mm_and_ps( mask, _mm_cmpgt_ps( t, zero ) );
+				mask= _mm_and_ps( mask, _mm_cmple_ps( t, _mm_set1_ps( nearest_t ) ) );
+				mask= _mm_and_ps( mask, _mm_cmpge_ps( s, zero ) );
+				mask= _mm_and_ps( mask, _mm_cmple_ps( s, one ) );
+				mask= _mm_and_ps( mask, _mm_cmpge_ps( z, zero ) );
+				mask= _mm_and_ps( mask, _mm_cmple_ps( z, walls_height ) );
+
+				const int hit_mask= _mm_movemask_ps( mask );
+				if( hit_mask == 0 )
+					continue;
+
+				float t_values[ c_ray_walls_batch_size ];
+				_mm_storeu_ps( t_values, t );
+				for( unsigned int j= 0u; j < c_ray_walls_batch_size; j++ )
+				{
+					if( ( hit_mask & ( 1 << j ) ) != 0 && t_values[j] <= nearest_t )
+					{
+						nearest_t= t_values[j];
+						out_wall_index= ray_walls_indeces_[ i + j ];
+						found= true;
+					}
+				}
+#else
+				for( unsigned int j= i; j < i + c_ray_walls_batch_size; j++ )
+				{
+					const float vec_x= ray_walls_x_[j] - pos.x;
+					const float vec_y= ray_walls_y_[j] - pos.y;
+					const float wall_dx= ray_walls_dx_[j];
+					const float wall_dy= ray_walls_dy_[j];
+
+					const float denominator= dir_normalized.x * wall_dy - dir_normalized.y * wall_dx;
+					if( denominator == 0.0f )
+						continue;
+
+					const float t= ( vec_x * wall_dy - vec_y * wall_dx ) / denominator;
+					if( t <= 0.0f || t > nearest_t )
+						continue;
+
+					const float s= ( vec_x * dir_normalized.y - vec_y * dir_normalized.x ) / denominator;
+					if( s < 0.0f || s > 1.0f )
+						continue;
+
+					const float z= pos.z + dir_normalized.z * t;
+					if( z < 0.0f || z > GameConstants::walls_height )
+						continue;
+
+					nearest_t= t;
+					out_wall_index= ray_walls_indeces_[j];
+					found= true;
+				}
+#endif
+			}
+
+			// Walls in next cells can not be nearer, than intersection inside this cell.
+			return found && nearest_t <= t_cell_exit;
+		} );
+
+	if( found )
+		out_distance= nearest_t;
+	return found;
+}
+
+void CollisionIndex::UpdateDynamicWall( const unsigned int wall_index, const m_Vec2& vert_pos0, const m_Vec2& vert_pos1 )
+{
+	PC_ASSERT( wall_index < dynamic_walls_count_ );
+
+	SetDynamicElementCells(
+		wall_index,
+		static_cast<int>( std::floor( std::min( vert_pos0.x, vert_pos1.x ) - c_fetch_distance_eps_ ) ),
+		static_cast<int>( std::floor( std::min( vert_pos0.y, vert_pos1.y ) - c_fetch_distance_eps_ ) ),
+		static_cast<int>( std::floor( std::max( vert_pos0.x, vert_pos1.x ) + c_fetch_distance_eps_ ) ),
+		static_cast<int>( std::floor( std::max( vert_pos0.y, vert_pos1.y ) + c_fetch_distance_eps_ ) ) );
+}
+
+void CollisionIndex::UpdateDynamicModel( const unsigned int model_index, const m_Vec2& pos, const float radius )
+{
+	PC_ASSERT( model_index < models_dynamic_elements_.size() );
+
+	const unsigned short dynamic_element_index= models_dynamic_elements_[ model_index ];
+	if( dynamic_element_index == IndexElement::c_dummy_next )
+		return;
+
+	const float radius_extended= std::max( radius, 0.0f ) + c_fetch_distance_eps_;
+	SetDynamicElementCells(
+		dynamic_element_index,
+		static_cast<int>( std::floor( pos.x - radius_extended ) ),
+		static_cast<int>( std::floor( pos.y - radius_extended ) ),
+		static_cast<int>( std::floor( pos.x + radius_extended ) ),
+		static_cast<int>( std::floor( pos.y + radius_extended ) ) );
+}
+
+void CollisionIndex::SetDynamicElementCells(
+	const unsigned int dynamic_element_index,
+	int x_min, int y_min, int x_max, int y_max )
+{
+	PC_ASSERT( dynamic_element_index < dynamic_elements_.size() );
+	DynamicElement& element= dynamic_elements_[ dynamic_element_index ];
+
+	x_min= std::max( x_min, 0 );
+	y_min= std::max( y_min, 0 );
+	x_max= std::min( x_max, int(MapData::c_map_size - 1u) );
+	y_max= std::min( y_max, int(MapData::c_map_size - 1u) );
+	if( x_min > x_max || y_min > y_max )
+	{
+		// Element is outside map.
+		x_min= y_min= 1;
+		x_max= y_max= 0;
+	}
+
+	if( x_min == int(element.x_min) && y_min == int(element.y_min) &&
+		x_max == int(element.x_max) && y_max == int(element.y_max) )
+		return; // Most of time elements stay in same cells.
+
+	// Remove from cells outside new range.
+	for( int y= element.y_min; y <= int(element.y_max); y++ )
+	for( int x= element.x_min; x <= int(element.x_max); x++ )
+	{
+		if( x >= x_min && x <= x_max && y >= y_min && y <= y_max )
+			continue;
+
+		std::vector<unsigned short>& cell= dynamic_index_field_[ x + y * int(MapData::c_map_size) ];
+		for( unsigned short& i : cell )
+		{
+			if( i == dynamic_element_index )
+			{
+				i= cell.back();
+				cell.pop_back();
+				break;
+			}
+		}
+	}
+
+	// Add to cells outside old range.
+	for( int y= y_min; y <= y_max; y++ )
+	for( int x= x_min; x <= x_max; x++ )
+	{
+		if( x >= int(element.x_min) && x <= int(element.x_max) && y >= int(element.y_min) && y <= int(element.y_max) )
+			continue;
+
+		dynamic_index_field_[ x + y * int(MapData::c_map_size) ].push_back( dynamic_element_index );
+	}
+
+	element.x_min= x_min;
+	element.y_min= y_min;
+	element.x_max= x_max;
+	element.y_max= y_max;
+}
+
+bool CollisionIndex::MarkDynamicElementFetched( const unsigned short dynamic_element_index ) const
+{
+	PC_ASSERT( dynamic_element_index < dynamic_elements_.size() );
+	unsigned int& last_query_id= dynamic_elements_[ dynamic_element_index ].last_query_id;
+
+	if( last_query_id == current_query_id_ )
+		return false;
+	last_query_id= current_query_id_;
+	return true;
+}
+
+void CollisionIndex::BeginDynamicElementsQuery() const
+{
+	current_query_id_++;
+	if( current_query_id_ == 0u )
+	{
+		// Overflow - reset ids of all elements.
+		for( const DynamicElement& element : dynamic_elements_ )
+			element.last_query_id= 0u;
+		current_query_id_= 1u;
+	}
+}
+
 } // namespace PanzerChasm
@@ -1,25 +1,53 @@
 #pragma once
 #include "../map_loader.hpp"
 #include "../math_utils.hpp"
+#include "collisions.hpp"
 
 namespace PanzerChasm
 {
 
 // Class for collisions calculations optimization.
 // It can fast fetch only potential-collidable objects.
-// Supported only "static walls" and "models" from map data.
-// Dynamic walls not supported.
+// Static walls and static models are placed in index once.
+// Dynamic walls and dynamic (or breakable) models must be updated after each movement.
+// Each query fetches every dynamic element only once.
+// Radius queries are thread-safe. Ray queries are not - they mark fetched dynamic elements.
 class CollisionIndex final
 {
 public:
 	explicit CollisionIndex( const MapDataConstPtr& map_data );
 	~CollisionIndex();
 
+	void UpdateDynamicWall( unsigned int wall_index, const m_Vec2& vert_pos0, const m_Vec2& vert_pos1 );
+	// Does nothing for models, placed in index statically.
+	void UpdateDynamicModel( unsigned int model_index, const m_Vec2& pos, float radius );
+
 	template<class Func>
 	void ProcessElementsInRadius(
 		const m_Vec2& pos, float radius,
 		const Func& func ) const;
 
+	// Static walls of cell, which can collide, in SoA form. Count is multiple of c_line_segments_batch_size.
+	struct StaticWallsBatch
+	{
+		const float* x;
+		const float* y;
+		const float* dx;
+		const float* dy;
+		const unsigned short* indeces;
+		unsigned int count;
+	};
+
+	// Same as ProcessElementsInRadius, but static walls are not passed to "func".
+	// Instead, static walls of each cell, except non-collidable walls, are passed to "static_walls_func" in SoA form,
+	// before other elements of this cell.
+	template<class StaticWallsFunc, class Func>
+	void ProcessElementsInRadiusBatched(
+		const m_Vec2& pos, float radius,
+		const StaticWallsFunc& static_walls_func,
+		const Func& func ) const;
+
+	// Fetch all elements, except static walls, in cells along ray, in order of distance.
 	// Func must return true, if need abort.
 	template<class Func>
 	void RayCast(
@@ -27,9 +55,49 @@ public:
 		const Func& func,
 		float max_cast_distance= Constants::max_float ) const;
 
+	// Fetch all elements, except static walls, in cells along several rays from same point.
+	// Each element is fetched at least once for all rays together.
+	template<class Func>
+	void RayCastBundle(
+		const m_Vec3& pos,
+		const m_Vec3* dirs_normalized,
+		const float* max_cast_distances,
+		unsigned int ray_count,
+		const Func& func ) const;
+
+	// Find nearest intersection of ray with static walls, which are not transparent for rays.
+	// Returns distance along ray and index of wall.
+	bool RayCastStaticWalls(
+		const m_Vec3& pos, const m_Vec3& dir_normalized,
+		float max_cast_distance,
+		float& out_distance, unsigned int& out_wall_index ) const;
+
 private:
 	void AddElementToIndex( unsigned int x, unsigned int y, const MapData::IndexElement& element );
 
+	void SetDynamicElementCells( unsigned int dynamic_element_index, int x_min, int y_min, int x_max, int y_max );
+
+	// Returns false, if element already fetched in current query.
+	bool MarkDynamicElementFetched( unsigned short dynamic_element_index ) const;
+	void BeginDynamicElementsQuery() const;
+
+	// Func must return true, if need abort.
+	template<class Func>
+	bool ProcessDynamicElementsInCell( unsigned int cell_index, const Func& func ) const;
+
+	// Process static models and dynamic elements of cell.
+	// Func must return true, if need abort.
+	template<class Func>
+	bool ProcessCellElementsForRay( unsigned int cell_index, const Func& func ) const;
+
+	// Calls func( cell_index, t_cell_exit ) for cells, crossed by ray, in order of distance.
+	// Func must return true, if need abort.
+	template<class Func>
+	void TraverseRayCells(
+		const m_Vec3& pos, const m_Vec3& dir_normalized,
+		float max_cast_distance,
+		const Func& func ) const;
+
 private:
 	struct IndexElement
 	{
@@ -41,6 +109,16 @@ private:
 
 	SIZE_ASSERT( IndexElement, 4u );
 
+	struct DynamicElement
+	{
+		MapData::IndexElement index_element;
+
+		// Inclusive range of cells. Element is not in index, if x_min > x_max.
+		unsigned char x_min= 1u, y_min= 1u, x_max= 0u, y_max= 0u;
+
+		mutable unsigned int last_query_id= 0u;
+	};
+
 private:
 	static constexpr float c_fetch_distance_eps_= 0.1f;
 
@@ -48,8 +126,29 @@ private:
 	// Linked lists data.
 	std::vector<IndexElement> index_elements_;
 
-	// Indeces of models, which can`t be placed in index - dynamic, breakable, etc.
-	std::vector<unsigned short> dynamic_models_indeces_;
+	// Static walls, not transparent for rays, in SoA form - for batched ray intersection.
+	// Walls of each cell are contiguous, count of walls in cell is padded up to c_ray_walls_batch_size with degenerate walls.
+	static constexpr unsigned int c_ray_walls_batch_size= 4u;
+	std::vector<float> ray_walls_x_, ray_walls_y_, ray_walls_dx_, ray_walls_dy_;
+	std::vector<unsigned short> ray_walls_indeces_;
+	std::vector<unsigned int> ray_walls_cells_offsets_; // Cell walls range is [ offsets[i], offsets[i+1] ).
+
+	// Static walls, which can collide, in same SoA form. Padding walls are placed far outside map.
+	std::vector<float> collision_walls_x_, collision_walls_y_, collision_walls_dx_, collision_walls_dy_;
+	std::vector<unsigned short> collision_walls_indeces_;
+	std::vector<unsigned int> collision_walls_cells_offsets_;
+
+	// Moving walls - first, dynamic models (with "is_dynamic" flag, breakable, etc.) - after walls.
+	std::vector<DynamicElement> dynamic_elements_;
+	unsigned int dynamic_walls_count_= 0u;
+
+	// Index of dynamic element for each map model. c_dummy_next for models in static index.
+	std::vector<unsigned short> models_dynamic_elements_;
+
+	// Indeces of dynamic elements in each cell.
+	std::vector< std::vector<unsigned short> > dynamic_index_field_;
+
+	mutable unsigned int current_query_id_= 0u;
 
 	// Linked lists heads.
 	unsigned short index_field_[ MapData::c_map_size * MapData::c_map_size ];
@@ -1,4 +1,8 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "../assert.hpp"
 #include "../game_constants.hpp"
 #include "collisions.hpp"
 
@@ -19,10 +23,17 @@ void CollisionIndex::ProcessElementsInRadius(
 	const int y_start= std::max( static_cast<int>( std::floor( pos.y - radius_extended ) ), 0 );
 	const int y_end  = std::min( static_cast<int>( std::floor( pos.y + radius_extended ) ), int(MapData::c_map_size - 1u) );
 
+	// Remember fetched dynamic elements locally, not in index, because radius queries may be called from several threads.
+	constexpr unsigned int c_max_fetched_dynamic_elements= 64u;
+	unsigned short fetched_dynamic_elements[ c_max_fetched_dynamic_elements ];
+	unsigned int fetched_dynamic_element_count= 0u;
+
 	for( int y= y_start; y <= y_end; y++ )
 	for( int x= x_start; x <= x_end; x++ )
 	{
-		unsigned short i= index_field_[ x + y * int(MapData::c_map_size) ];
+		const unsigned int cell_index= x + y * int(MapData::c_map_size);
+
+		unsigned short i= index_field_[ cell_index ];
 		while( i != IndexElement::c_dummy_next )
 		{
 			PC_ASSERT( i <= index_elements_.size() );
@@ -31,15 +42,102 @@ void CollisionIndex::ProcessElementsInRadius(
 			func( element.index_element );
 			i= element.next;
 		}
+
+		for( const unsigned short dynamic_element_index : dynamic_index_field_[ cell_index ] )
+		{
+			bool already_fetched= false;
+			for( unsigned int j= 0u; j < fetched_dynamic_element_count; j++ )
+			{
+				if( fetched_dynamic_elements[j] == dynamic_element_index )
+				{
+					already_fetched= true;
+					break;
+				}
+			}
+			if( already_fetched )
+				continue;
+
+			// If list is full, some elements may be fetched twice. It is not critical.
+			if( fetched_dynamic_element_count < c_max_fetched_dynamic_elements )
+			{
+				fetched_dynamic_elements[ fetched_dynamic_element_count ]= dynamic_element_index;
+				fetched_dynamic_element_count++;
+			}
+
+			func( dynamic_elements_[ dynamic_element_index ].index_element );
+		}
 	}
+}
 
-	// Process dynamic models without any optimizations
-	for( const unsigned short dynamic_model_index : dynamic_models_indeces_ )
+template<class StaticWallsFunc, class Func>
+void CollisionIndex::ProcessElementsInRadiusBatched(
+	const m_Vec2& pos, const float radius,
+	const StaticWallsFunc& static_walls_func,
+	const Func& func ) const
+{
+	const float radius_extended= radius + c_fetch_distance_eps_;
+
+	const int x_start= std::max( static_cast<int>( std::floor( pos.x - radius_extended ) ), 0 );
+	const int x_end  = std::min( static_cast<int>( std::floor( pos.x + radius_extended ) ), int(MapData::c_map_size - 1u) );
+	const int y_start= std::max( static_cast<int>( std::floor( pos.y - radius_extended ) ), 0 );
+	const int y_end  = std::min( static_cast<int>( std::floor( pos.y + radius_extended ) ), int(MapData::c_map_size - 1u) );
+
+	constexpr unsigned int c_max_fetched_dynamic_elements= 64u;
+	unsigned short fetched_dynamic_elements[ c_max_fetched_dynamic_elements ];
+	unsigned int fetched_dynamic_element_count= 0u;
+
+	for( int y= y_start; y <= y_end; y++ )
+	for( int x= x_start; x <= x_end; x++ )
 	{
-		MapData::IndexElement element;
-		element.type= MapData::IndexElement::StaticModel;
-		element.index= dynamic_model_index;
-		func( element );
+		const unsigned int cell_index= x + y * int(MapData::c_map_size);
+
+		const unsigned int walls_begin= collision_walls_cells_offsets_[ cell_index      ];
+		const unsigned int walls_end  = collision_walls_cells_offsets_[ cell_index + 1u ];
+		if( walls_begin < walls_end )
+		{
+			StaticWallsBatch batch;
+			batch.x= collision_walls_x_.data() + walls_begin;
+			batch.y= collision_walls_y_.data() + walls_begin;
+			batch.dx= collision_walls_dx_.data() + walls_begin;
+			batch.dy= collision_walls_dy_.data() + walls_begin;
+			batch.indeces= collision_walls_indeces_.data() + walls_begin;
+			batch.count= walls_end - walls_begin;
+			static_walls_func( batch );
+		}
+
+		unsigned short i= index_field_[ cell_index ];
+		while( i != IndexElement::c_dummy_next )
+		{
+			PC_ASSERT( i <= index_elements_.size() );
+			const IndexElement& element= index_elements_[i];
+
+			if( element.index_element.type != MapData::IndexElement::StaticWall )
+				func( element.index_element );
+			i= element.next;
+		}
+
+		for( const unsigned short dynamic_element_index : dynamic_index_field_[ cell_index ] )
+		{
+			bool already_fetched= false;
+			for( unsigned int j= 0u; j < fetched_dynamic_element_count; j++ )
+			{
+				if( fetched_dynamic_elements[j] == dynamic_element_index )
+				{
+					already_fetched= true;
+					break;
+				}
+			}
+			if( already_fetched )
+				continue;
+
+			if( fetched_dynamic_element_count < c_max_fetched_dynamic_elements )
+			{
+				fetched_dynamic_elements[ fetched_dynamic_element_count ]= dynamic_element_index;
+				fetched_dynamic_element_count++;
+			}
+
+			func( dynamic_elements_[ dynamic_element_index ].index_element );
+		}
 	}
 }
 
@@ -49,110 +147,185 @@ void CollisionIndex::RayCast(
 	const Func& func,
 	const float max_cast_distance ) const
 {
-	float end_distance_xy=
-		std::min(
-			max_cast_distance * dir_normalized.xy().Length(),
-			float( MapData::c_map_size * 2u ) );
+	BeginDynamicElementsQuery();
 
-	if( pos.z >= 0.0f && pos.z <= GameConstants::walls_height )
+	TraverseRayCells(
+		pos, dir_normalized, max_cast_distance,
+		[&]( const unsigned int cell_index, const float t_cell_exit ) -> bool
+		{
+			PC_UNUSED( t_cell_exit );
+			return ProcessCellElementsForRay( cell_index, func );
+		} );
+}
+
+template<class Func>
+void CollisionIndex::RayCastBundle(
+	const m_Vec3& pos,
+	const m_Vec3* const dirs_normalized,
+	const float* const max_cast_distances,
+	const unsigned int ray_count,
+	const Func& func ) const
+{
+	BeginDynamicElementsQuery();
+
+	const auto func_without_abort=
+	[&]( const MapData::IndexElement& element ) -> bool
+	{
+		func( element );
+		return false;
+	};
+
+	// Rays from same point mostly cross same cells. Process each cell only once.
+	uint32_t processed_cells[ MapData::c_map_size * MapData::c_map_size / 32u ];
+	std::memset( processed_cells, 0, sizeof(processed_cells) );
+
+	for( unsigned int i= 0u; i < ray_count; i++ )
 	{
-		m_Vec3 end_pos;
+		TraverseRayCells(
+			pos, dirs_normalized[i], max_cast_distances[i],
+			[&]( const unsigned int cell_index, const float t_cell_exit ) -> bool
+			{
+				PC_UNUSED( t_cell_exit );
 
-		if( dir_normalized.z > 0.0f )
-		{
-			if( RayIntersectXYPlane(
-					GameConstants::walls_height,
-					pos, dir_normalized,
-					end_pos ) )
-				end_distance_xy= std::min( ( end_pos - pos ).xy().Length(), end_distance_xy );
-		}
-		else
-		{
-			if( RayIntersectXYPlane(
-					0.0f,
-					pos, dir_normalized,
-					end_pos ) )
-				end_distance_xy= std::min( ( end_pos - pos ).xy().Length(), end_distance_xy );
-		}
+				uint32_t& cells_bits= processed_cells[ cell_index >> 5u ];
+				const uint32_t cell_bit= 1u << ( cell_index & 31u );
+				if( ( cells_bits & cell_bit ) != 0u )
+					return false;
+				cells_bits|= cell_bit;
+
+				return ProcessCellElementsForRay( cell_index, func_without_abort );
+			} );
 	}
-	else
+}
+
+template<class Func>
+bool CollisionIndex::ProcessCellElementsForRay( const unsigned int cell_index, const Func& func ) const
+{
+	unsigned short index= index_field_[ cell_index ];
+	while( index != IndexElement::c_dummy_next )
 	{
-		// TODO
+		PC_ASSERT( index <= index_elements_.size() );
+		const IndexElement& element= index_elements_[index];
+
+		// Static walls are processed in "RayCastStaticWalls".
+		if( element.index_element.type != MapData::IndexElement::StaticWall &&
+			func( element.index_element ) )
+			return true;
+
+		index= element.next;
 	}
 
-	m_Vec2 dir_xy= dir_normalized.xy();
-	dir_xy.Normalize();
+	return ProcessDynamicElementsInCell( cell_index, func );
+}
 
-	int prev_x= std::numeric_limits<int>::max();
-	int prev_y= std::numeric_limits<int>::max();
+template<class Func>
+void CollisionIndex::TraverseRayCells(
+	const m_Vec3& pos, const m_Vec3& dir_normalized,
+	const float max_cast_distance,
+	const Func& func ) const
+{
+	const int c_map_size= int(MapData::c_map_size);
 
-	const unsigned int max_distance_xy_i= static_cast<unsigned int>( std::ceil( end_distance_xy ) );
-	for( unsigned int i= 0u; i <= max_distance_xy_i; i++ )
+	float t_min= 0.0f;
+	float t_max= max_cast_distance;
+
+	// Nothing can be hit behind floor or ceiling.
+	if( pos.z >= 0.0f && pos.z <= GameConstants::walls_height )
 	{
-		const m_Vec2 sample_pos= pos.xy() + dir_xy * float(i);
-		const int x= static_cast<int>( std::floor( sample_pos.x ) );
-		const int y= static_cast<int>( std::floor( sample_pos.y ) );
+		if( dir_normalized.z > 0.0f )
+			t_max= std::min( t_max, ( GameConstants::walls_height - pos.z ) / dir_normalized.z );
+		else if( dir_normalized.z < 0.0f )
+			t_max= std::min( t_max, -pos.z / dir_normalized.z );
+	}
 
-		if( x == prev_x && y == prev_y )
-		{
-			// Nothing to do - already checked.
-		}
-		else if( x != prev_x && y != prev_y && i != 0u )
-		{
-			// Check this and neighbor cells.
-			const int cells[6]= { x, y,   prev_x, y,  x, prev_y };
+	// Clip ray by map borders.
+	const auto clip_ray=
+	[&]( const float p, const float d ) -> bool
+	{
+		if( d == 0.0f )
+			return p >= 0.0f && p <= float(c_map_size);
 
-			for( unsigned int c= 0u; c < 6u; c+= 2u )
-			{
-				if( cells[c+0u] >= 0 && cells[c+0u] < int(MapData::c_map_size) &&
-					cells[c+1u] >= 0 && cells[c+1u] < int(MapData::c_map_size) )
-				{
-					unsigned short index= index_field_[ cells[c] + cells[c+1u] * int(MapData::c_map_size) ];
-					while( index != IndexElement::c_dummy_next )
-					{
-						PC_ASSERT( index <= index_elements_.size() );
-						const IndexElement& element= index_elements_[index];
+		float t0= ( 0.0f - p ) / d;
+		float t1= ( float(c_map_size) - p ) / d;
+		if( t0 > t1 )
+			std::swap( t0, t1 );
 
-						if( func( element.index_element ) )
-							return;
+		t_min= std::max( t_min, t0 );
+		t_max= std::min( t_max, t1 );
+		return t_min <= t_max;
+	};
+	if( !clip_ray( pos.x, dir_normalized.x ) ||
+		!clip_ray( pos.y, dir_normalized.y ) )
+		return;
 
-						index= element.next;
-					}
-				}
-			}
+	// Walk cells, crossed by ray, in order of distance.
+	int x= static_cast<int>( std::floor( pos.x + dir_normalized.x * t_min ) );
+	int y= static_cast<int>( std::floor( pos.y + dir_normalized.y * t_min ) );
+	x= std::max( 0, std::min( x, c_map_size - 1 ) );
+	y= std::max( 0, std::min( y, c_map_size - 1 ) );
+
+	const int step_x= dir_normalized.x > 0.0f ? 1 : -1;
+	const int step_y= dir_normalized.y > 0.0f ? 1 : -1;
+
+	const float t_delta_x= dir_normalized.x != 0.0f ? std::abs( 1.0f / dir_normalized.x ) : Constants::max_float;
+	const float t_delta_y= dir_normalized.y != 0.0f ? std::abs( 1.0f / dir_normalized.y ) : Constants::max_float;
+
+	float t_next_x;
+	if( dir_normalized.x > 0.0f )
+		t_next_x= ( float(x + 1) - pos.x ) / dir_normalized.x;
+	else if( dir_normalized.x < 0.0f )
+		t_next_x= ( float(x) - pos.x ) / dir_normalized.x;
+	else
+		t_next_x= Constants::max_float;
+
+	float t_next_y;
+	if( dir_normalized.y > 0.0f )
+		t_next_y= ( float(y + 1) - pos.y ) / dir_normalized.y;
+	else if( dir_normalized.y < 0.0f )
+		t_next_y= ( float(y) - pos.y ) / dir_normalized.y;
+	else
+		t_next_y= Constants::max_float;
+
+	while(true)
+	{
+		const float t_cell_exit= std::min( std::min( t_next_x, t_next_y ), t_max );
+		if( func( static_cast<unsigned int>( x + y * c_map_size ), t_cell_exit ) )
+			return;
+
+		if( t_cell_exit >= t_max )
+			return;
+
+		if( t_next_x < t_next_y )
+		{
+			x+= step_x;
+			t_next_x+= t_delta_x;
 		}
 		else
 		{
-			// Check one cell.
-			if( x >= 0 && x < int(MapData::c_map_size) &&
-				y >= 0 && y < int(MapData::c_map_size) )
-			{
-				unsigned short index= index_field_[ x + y * int(MapData::c_map_size) ];
-				while( index != IndexElement::c_dummy_next )
-				{
-					PC_ASSERT( index <= index_elements_.size() );
-					const IndexElement& element= index_elements_[index];
-
-					if( func( element.index_element ) )
-						return;
-
-					index= element.next;
-				}
-			}
+			y+= step_y;
+			t_next_y+= t_delta_y;
 		}
 
-		prev_x= x;
-		prev_y= y;
-	} // line trace
+		if( x < 0 || x >= c_map_size || y < 0 || y >= c_map_size )
+			return;
+	}
+}
+
+template<class Func>
+bool CollisionIndex::ProcessDynamicElementsInCell( const unsigned int cell_index, const Func& func ) const
+{
+	PC_ASSERT( cell_index < dynamic_index_field_.size() );
 
-	// Process dynamic models without any optimizations.
-	for( const unsigned short dynamic_model_index : dynamic_models_indeces_ )
+	for( const unsigned short dynamic_element_index : dynamic_index_field_[ cell_index ] )
 	{
-		MapData::IndexElement element;
-		element.type= MapData::IndexElement::StaticModel;
-		element.index= dynamic_model_index;
-		func( element );
+		if( !MarkDynamicElementFetched( dynamic_element_index ) )
+			continue;
+
+		if( func( dynamic_elements_[ dynamic_element_index ].index_element ) )
+			return true;
 	}
+
+	return false;
 }
 
 } // namespace PanzerChasm
@@ -1,5 +1,9 @@
 #include <algorithm>
 
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
+
 #include <matrix.hpp>
 
 #include "../assert.hpp"
@@ -79,6 +83,55 @@ bool CollideCircleWithLineSegment(
 	return false;
 }
 
+unsigned int CircleMayCollideWithLineSegmentsBatch(
+	const float* const segments_x, const float* const segments_y,
+	const float* const segments_dx, const float* const segments_dy,
+	const m_Vec2& circle_center,
+	const float circle_radius )
+{
+	// Extend radius for case of rounding differences with exact collision function.
+	const float c_radius_eps= 1.0f / 1024.0f;
+	const float radius_extended= circle_radius + c_radius_eps;
+	// Avoid division by zero for degenerate segments.
+	const float c_min_square_length= 1.0e-12f;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	static_assert( c_line_segments_batch_size == 4u, "Invalid batch size" );
+
+	const __m128 dx= _mm_loadu_ps( segments_dx );
+	const __m128 dy= _mm_loadu_ps( segments_dy );
+	const __m128 vec_x= _mm_sub_ps( _mm_set1_ps( circle_center.x ), _mm_loadu_ps( segments_x ) );
+	const __m128 vec_y= _mm_sub_ps( _mm_set1_ps( circle_center.y ), _mm_loadu_ps( segments_y ) );
+
+	// Parameter of nearest to circle center point of segment.
+	const __m128 square_length= _mm_max_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_set1_ps( c_min_square_length ) );
+	__m128 k= _mm_div_ps( _mm_add_ps( _mm_mul_ps( vec_x, dx ), _mm_mul_ps( vec_y, dy ) ), square_length );
+	k= _mm_min_ps( _mm_max_ps( k, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+
+	const __m128 dist_x= _mm_sub_ps( vec_x, _mm_mul_ps( dx, k ) );
+	const __m128 dist_y= _mm_sub_ps( vec_y, _mm_mul_ps( dy, k ) );
+	const __m128 square_distance= _mm_add_ps( _mm_mul_ps( dist_x, dist_x ), _mm_mul_ps( dist_y, dist_y ) );
+
+	return static_cast<unsigned int>(
+		_mm_movemask_ps( _mm_cmplt_ps( square_distance, _mm_set1_ps( radius_extended * radius_extended ) ) ) );
+#else
+	unsigned int result= 0u;
+	for( unsigned int i= 0u; i < c_line_segments_batch_size; i++ )
+	{
+		const float vec_x= circle_center.x - segments_x[i];
+		const float vec_y= circle_center.y - segments_y[i];
+		const float square_length= std::max( segments_dx[i] * segments_dx[i] + segments_dy[i] * segments_dy[i], c_min_square_length );
+		const float k= std::min( std::max( ( vec_x * segments_dx[i] + vec_y * segments_dy[i] ) / square_length, 0.0f ), 1.0f );
+
+		const float dist_x= vec_x - segments_dx[i] * k;
+		const float dist_y= vec_y - segments_dy[i] * k;
+		if( dist_x * dist_x + dist_y * dist_y < radius_extended * radius_extended )
+			result|= 1u << i;
+	}
+	return result;
+#endif
+}
+
 bool CollideCircleWithSquare(
 	const m_Vec2& square_center,
 	const float angle,
@@ -13,6 +13,18 @@ bool CollideCircleWithLineSegment(
 	float circle_radius,
 	m_Vec2& out_pos );
 
+// Segments count for CircleMayCollideWithLineSegmentsBatch.
+constexpr unsigned int c_line_segments_batch_size= 4u;
+
+// Test circle against batch of segments in SoA form - start points and vectors from start to end points.
+// Returns bit mask of segments, which circle may collide. Test is conservative -
+// CollideCircleWithLineSegment may reject segments in mask, but never collides with segments outside mask.
+unsigned int CircleMayCollideWithLineSegmentsBatch(
+	const float* segments_x, const float* segments_y,
+	const float* segments_dx, const float* segments_dy,
+	const m_Vec2& circle_center,
+	float circle_radius );
+
 bool CollideCircleWithSquare(
 	const m_Vec2& square_center,
 	float angle,
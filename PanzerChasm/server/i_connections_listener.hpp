@@ -13,6 +13,16 @@ public:
 	// Returns nullptr, if there is no new connections.
 	// If there are many connections, this mehon need to call multiple times.
 	virtual IConnectionPtr GetNewConnection()= 0;
+
+	// Wait for events of listener and its connections. Call it once per server loop, before reading of connections.
+	virtual void PollEvents() {}
+
+	// Send data, queued by connections. Call it once per server loop, after sending of messages.
+	virtual void SendQueuedPackets() {}
+
+	// Block until listener or its connections have incoming data, or until timeout.
+	// Returns false, if waiting is not supported. In this case caller must wait itself.
+	virtual bool WaitForEvents( unsigned int /*timeout_ms*/ ) { return false; }
 };
 
 typedef std::shared_ptr<IConnectionsListener> IConnectionsListenerPtr;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include <matrix.hpp>
@@ -5,11 +6,14 @@
 #include "../game_constants.hpp"
 #include "../math_utils.hpp"
 #include "../particles.hpp"
+#include "../profiler.hpp"
 #include "../sound/sound_id.hpp"
 #include "a_code.hpp"
 #include "collisions.hpp"
 #include "collision_index.inl"
+#include "map_collision.inl"
 #include "monster.hpp"
+#include "monsters_index.inl"
 #include "player.hpp"
 
 #include "map.hpp"
@@ -19,6 +23,35 @@ namespace PanzerChasm
 
 static const float g_commands_coords_scale= 1.0f / 256.0f;
 
+// Parallel processing of small count of monsters is not profitable.
+static const unsigned int g_min_monsters_for_parallel_collisions= 16u;
+
+// Enough for all players in multiplayer and some targets of monsters.
+static const unsigned int g_max_navigation_flow_fields= 16u;
+
+// Shots of players with bigger lag are processed as shots with this lag.
+static const int g_max_lag_compensation_ms= 300;
+
+// Limits for births of gibs bunches and monsters body parts between sendings of update events.
+static const unsigned int g_max_gibs_births_in_update= 16u;
+static const unsigned int g_max_body_parts_births_in_update= 32u;
+
+static unsigned int CountTrailingZeros( uint64_t x )
+{
+	PC_ASSERT( x != 0u );
+#ifdef __GNUC__
+	return static_cast<unsigned int>( __builtin_ctzll( x ) );
+#else
+	unsigned int count= 0u;
+	while( ( x & 1u ) == 0u )
+	{
+		x>>= 1u;
+		count++;
+	}
+	return count;
+#endif
+}
+
 static unsigned int AnimationNumberToModelNumber( const unsigned int animation_number )
 {
 	// Animations for models starts with 33. But, sometimes, animation number bigger, then total amount of models on map.
@@ -28,20 +61,6 @@ static unsigned int AnimationNumberToModelNumber( const unsigned int animation_n
 	return animation_number - 33u;
 }
 
-template<class Wall>
-static m_Vec3 GetNormalForWall( const Wall& wall )
-{
-	m_Vec3 n( wall.vert_pos[0].y - wall.vert_pos[1].y, wall.vert_pos[1].x - wall.vert_pos[0].x, 0.0f );
-	return n / n.xy().Length();
-}
-
-static bool CollideWithSquare( const MapData::ModelDescription& model_description )
-{
-	// CYKABLAT!
-	// It seems, that original game uses cicrcles collision, if lower radius bit is 0, and square, if this bit is 1.
-	return ( int(model_description.radius * 256.0f) & 1 ) == 1;
-}
-
 Map::Rocket::Rocket(
 	const EntityId in_rocket_id,
 	const EntityId in_owner_id,
@@ -55,7 +74,6 @@ Map::Rocket::Rocket(
 	, rocket_id( in_rocket_id )
 	, owner_id( in_owner_id )
 	, rocket_type_id( in_rocket_type_id )
-	, previous_position( in_start_point )
 	, track_length( 0.0f )
 {}
 
@@ -71,6 +89,45 @@ bool Map::Rocket::DealsExplosionDamage( const GameResources& game_resources ) co
 			game_resources.rockets_description[ rocket_type_id ].explosion_radius > (200.0f / 256.0f);
 }
 
+unsigned int Map::Rockets::Size() const
+{
+	return rockets.size();
+}
+
+void Map::Rockets::Add( const Rocket& rocket, const m_Vec3& velocity )
+{
+	rockets.push_back( rocket );
+	positions.push_back( rocket.start_point );
+	velocities.push_back( velocity );
+	// Rockets, created during tick, start moving in next tick.
+	new_positions.push_back( rocket.start_point );
+}
+
+void Map::Rockets::Remove( const unsigned int index )
+{
+	PC_ASSERT( index < rockets.size() );
+
+	if( index != rockets.size() - 1u )
+	{
+		rockets[ index ]= rockets.back();
+		positions[ index ]= positions.back();
+		velocities[ index ]= velocities.back();
+		new_positions[ index ]= new_positions.back();
+	}
+	rockets.pop_back();
+	positions.pop_back();
+	velocities.pop_back();
+	new_positions.pop_back();
+}
+
+void Map::Rockets::Resize( const unsigned int size )
+{
+	rockets.resize( size );
+	positions.resize( size );
+	velocities.resize( size );
+	new_positions.resize( size );
+}
+
 template<class Func>
 void Map::ProcessElementLinks(
 	const MapData::IndexElement::Type element_type,
@@ -92,6 +149,7 @@ Map::Map(
 	const MapDataConstPtr& map_data,
 	const GameResourcesConstPtr& game_resources,
 	const Time map_start_time,
+	WorkersPool& workers_pool,
 	MapEndCallback map_end_callback,
 	TextMessageCallback text_message_callback )
 	: difficulty_(difficulty)
@@ -101,15 +159,56 @@ Map::Map(
 	, map_end_callback_( std::move( map_end_callback ) )
 	, text_message_callback_(std::move(text_message_callback) )
 	, random_generator_( std::make_shared<LongRand>() )
+	, workers_pool_( workers_pool )
 	, collision_index_( map_data )
+	, navigation_grid_( *map_data, collision_index_ )
 {
 	PC_ASSERT( map_data_ != nullptr );
 	PC_ASSERT( game_resources_ != nullptr );
 
-	unsigned int difficulty_mask= static_cast<unsigned int>( difficulty_ );
+	const unsigned int difficulty_mask= static_cast<unsigned int>( difficulty_ );
+
+	InitStaticEntities( map_start_time );
+
+	// Spawn monsters
+	if( game_rules_ != GameRules::Deathmatch )
+	{
+		for( const MapData::Monster& map_monster : map_data_->monsters )
+		{
+			// Skip players
+			if( map_monster.monster_id == 0u )
+				continue;
+
+			if( ( map_monster.difficulty_flags & difficulty_mask ) == 0u )
+				continue;
+
+			const EntityId& monster_id= GetNextMonsterId();
+			const MonsterBasePtr& monster=
+				monsters_[ monster_id ]=
+					std::allocate_shared<Monster>(
+						ArenaAllocator<Monster>( monsters_arena_ ),
+						map_monster,
+						GetFloorLevel( map_monster.pos ),
+						game_resources_,
+						random_generator_,
+						map_start_time );
+
+			Messages::MonsterBirth message;
+
+			monster->BuildStateMessage( message.initial_state );
+			message.initial_state.monster_id= monster_id;
+			message.monster_id= monster_id;
+
+			update_events_messages_.AddReliableMessage( message );
+		}
+	}
+}
+
+void Map::InitStaticEntities( const Time map_start_time )
+{
+	map_start_time_= map_start_time;
 
-	std::memset( wind_field_, 0, sizeof(wind_field_) );
-	std::memset( death_field_, 0, sizeof(death_field_) );
+	const unsigned int difficulty_mask= static_cast<unsigned int>( difficulty_ );
 
 	procedures_.resize( map_data_->procedures.size() );
 	for( unsigned int p= 0u; p < procedures_.size(); p++ )
@@ -117,11 +216,20 @@ Map::Map(
 		if( map_data_->procedures[p].locked )
 			procedures_[p].locked= true;
 	}
+	active_procedures_.resize( ( procedures_.size() + 63u ) / 64u, 0u );
 
 	dynamic_walls_.resize( map_data_->dynamic_walls.size() );
 	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
 	{
-		dynamic_walls_[w].texture_id= map_data_->dynamic_walls[w].texture_id;
+		const MapData::Wall& map_wall= map_data_->dynamic_walls[w];
+		DynamicWall& wall= dynamic_walls_[w];
+
+		wall.vert_pos[0]= map_wall.vert_pos[0];
+		wall.vert_pos[1]= map_wall.vert_pos[1];
+		// Initialize all saved fields, because initial state is compared with current state in saves.
+		wall.vert_move_speed[0]= wall.vert_move_speed[1]= m_Vec2( 0.0f, 0.0f );
+		wall.z= 0.0f;
+		wall.texture_id= map_wall.texture_id;
 	}
 
 	static_models_.resize( map_data_->static_models.size() );
@@ -130,7 +238,7 @@ Map::Map(
 		const MapData::StaticModel& in_model= map_data_->static_models[m];
 		StaticModel& out_model= static_models_[m];
 
-		if( !( in_model.difficulty_flags == 0u && game_rules == GameRules::Deathmatch ) &&
+		if( !( in_model.difficulty_flags == 0u && game_rules_ == GameRules::Deathmatch ) &&
 			( in_model.difficulty_flags & difficulty_mask ) == 0u )
 			out_model.model_id= 255; // Disable model for current difficulty. TODO - maybe tihs is not enough.
 		else
@@ -143,6 +251,7 @@ Map::Map(
 		out_model.health= model_description == nullptr ? 0 : model_description->break_limit;
 
 		out_model.pos= m_Vec3( in_model.pos, 0.0f );
+		out_model.move_speed= m_Vec2( 0.0f, 0.0f );
 		out_model.angle= in_model.angle;
 		out_model.baze_z= 0.0f;
 
@@ -154,6 +263,7 @@ Map::Map(
 
 		out_model.animation_start_time= map_start_time;
 		out_model.animation_start_frame= 0u;
+		out_model.current_animation_frame= 0u;
 	}
 
 	// Stop some models on map start.
@@ -181,10 +291,12 @@ Map::Map(
 		out_item.pos= m_Vec3( in_item.pos, 0.0f );
 		out_item.picked_up= false;
 		out_item.enabled=
-			( in_item.difficulty_flags == 0u && game_rules == GameRules::Deathmatch ) ||
+			( in_item.difficulty_flags == 0u && game_rules_ == GameRules::Deathmatch ) ||
 			( in_item.difficulty_flags & difficulty_mask ) != 0u;
 	}
 
+	UpdateDynamicElementsInCollisionIndex();
+
 	// Pull up items, which placed atop of models
 	for( Item& item : items_ )
 	{
@@ -202,37 +314,7 @@ Map::Map(
 		model.pos.z= model.baze_z= GetFloorLevel( model.pos.xy(), description.radius );
 	}
 
-	// Spawn monsters
-	if( game_rules_ != GameRules::Deathmatch )
-	{
-		for( const MapData::Monster& map_monster : map_data_->monsters )
-		{
-			// Skip players
-			if( map_monster.monster_id == 0u )
-				continue;
-
-			if( ( map_monster.difficulty_flags & difficulty_mask ) == 0u )
-				continue;
-
-			const EntityId& monster_id= GetNextMonsterId();
-			const MonsterBasePtr& monster=
-				monsters_[ monster_id ]=
-					MonsterPtr(
-						new Monster(
-							map_monster,
-							GetFloorLevel( map_monster.pos ),
-							game_resources_,
-							random_generator_,
-							map_start_time ) );
-
-			monsters_birth_messages_.emplace_back();
-			Messages::MonsterBirth& message= monsters_birth_messages_.back();
-
-			monster->BuildStateMessage( message.initial_state );
-			message.initial_state.monster_id= monster_id;
-			message.monster_id= monster_id;
-		}
-	}
+	SaveInitialStaticEntitiesState();
 }
 
 Map::~Map()
@@ -302,13 +384,14 @@ EntityId Map::SpawnPlayer( const PlayerPtr& player )
 	const MonstersContainer::value_type& monster_value=
 		* monsters_.emplace( player_id, player ).first;
 
-	monsters_birth_messages_.emplace_back();
-	Messages::MonsterBirth& message= monsters_birth_messages_.back();
+	Messages::MonsterBirth message;
 
 	monster_value.second->BuildStateMessage( message.initial_state );
 	message.initial_state.monster_id= monster_value.first;
 	message.monster_id= monster_value.first;
 
+	update_events_messages_.AddReliableMessage( message );
+
 	return player_id;
 }
 
@@ -319,9 +402,9 @@ void Map::DespawnPlayer( const EntityId player_id )
 
 	if( erased )
 	{
-		monsters_death_messages_.emplace_back();
-		Messages::MonsterDeath& message= monsters_death_messages_.back();
+		Messages::MonsterDeath message;
 		message.monster_id= player_id;
+		update_events_messages_.AddReliableMessage( message );
 	}
 }
 
@@ -332,10 +415,20 @@ void Map::Shoot(
 	const m_Vec3& normalized_direction,
 	const Time current_time )
 {
-	rockets_.emplace_back( next_rocket_id_, owner_id, rocket_id, from, normalized_direction, current_time );
+	const Rocket rocket( next_rocket_id_, owner_id, rocket_id, from, normalized_direction, current_time );
 	next_rocket_id_++;
 
-	Rocket& rocket= rockets_.back();
+	// Set initial speed for jumping rockets.
+	m_Vec3 velocity( 0.0f, 0.0f, 0.0f );
+	const GameResources::RocketDescription& description= game_resources_->rockets_description[ rocket.rocket_type_id ];
+	if( description.reflect )
+	{
+		const float speed= description.fast ? GameConstants::fast_rockets_speed : GameConstants::rockets_speed;
+		velocity= rocket.normalized_direction * speed;
+	}
+
+	rockets_.Add( rocket, velocity );
+
 	if( !rocket.HasInfiniteSpeed( *game_resources_ ) )
 	{
 		Messages::RocketBirth message;
@@ -350,15 +443,7 @@ void Map::Shoot(
 		for( unsigned int j= 0u; j < 2u; j++ )
 			message.angle[j]= AngleToMessageAngle( angle[j] );
 
-		rockets_birth_messages_.emplace_back( message );
-	}
-
-	// Set initial speed for jumping rockets.
-	const GameResources::RocketDescription& description= game_resources_->rockets_description[ rocket.rocket_type_id ];
-	if( description.reflect )
-	{
-		const float speed= description.fast ? GameConstants::fast_rockets_speed : GameConstants::rockets_speed;
-		rocket.speed= rocket.normalized_direction * speed;
+		update_events_messages_.AddUnreliableMessage( message );
 	}
 }
 
@@ -376,79 +461,106 @@ void Map::PlantMine(
 	mine.owner_id= owner_monster_id;
 	next_rocket_id_++;
 
-	dynamic_items_birth_messages_.emplace_back();
-	PrepareMineBirthMessage( mine, dynamic_items_birth_messages_.back() );
+	Messages::DynamicItemBirth message;
+	PrepareMineBirthMessage( mine, message );
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
-void Map::SpawnBackpack( BackpackPtr backpack )
+void Map::SpawnBackpack( const Backpack& backpack )
 {
 	const EntityId id= next_rocket_id_;
 	next_rocket_id_++;
 
 	Backpack& inserted_backpack=
-		*backpacks_.emplace( id, std::move(backpack) ).first->second;
+		backpacks_.emplace( id, backpack ).first->second;
 
 	inserted_backpack.min_z= GetFloorLevel( inserted_backpack.pos.xy(), 0.2f/* TODO - select correct radius*/ );
 
 	// Let backpacks jump up after spawn.
 	inserted_backpack.vertical_speed= GameConstants::vertical_acceleration * -0.2f;
 
-	dynamic_items_birth_messages_.emplace_back();
-	PrepareBackpackBirthMessage( inserted_backpack, id, dynamic_items_birth_messages_.back() );
+	Messages::DynamicItemBirth message;
+	PrepareBackpackBirthMessage( inserted_backpack, id, message );
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::SpawnMonsterBodyPart(
 	const unsigned char monster_type_id, const unsigned char body_part_id,
 	const m_Vec3& pos, float angle )
 {
-	monsters_parts_birth_messages_.emplace_back();
-	Messages::MonsterPartBirth& message= monsters_parts_birth_messages_.back();
+	if( body_parts_births_in_update_ >= g_max_body_parts_births_in_update )
+		return;
+	body_parts_births_in_update_++;
+
+	Messages::MonsterPartBirth message;
 
 	message.monster_type= monster_type_id;
 	message.part_id= body_part_id;
 
 	PositionToMessagePosition( pos, message.xyz );
 	message.angle= AngleToMessageAngle( angle );
+	message.seed= next_gibs_seed_++;
+
+	update_events_messages_.AddUnreliableMessage( message );
+}
+
+void Map::SpawnGibs( const m_Vec3& pos, const unsigned int gib_id )
+{
+	if( gibs_births_in_update_ >= g_max_gibs_births_in_update )
+		return;
+	gibs_births_in_update_++;
+
+	Messages::GibsBirth message;
+
+	PositionToMessagePosition( pos, message.xyz );
+	message.gib_id= gib_id;
+	message.seed= next_gibs_seed_++;
+
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::PlayMonsterLinkedSound(
 	const EntityId monster_id,
 	const unsigned int sound_id )
 {
-	monster_linked_sounds_messages_.emplace_back();
-	Messages::MonsterLinkedSound& message= monster_linked_sounds_messages_.back();
+	Messages::MonsterLinkedSound message;
 
 	message.monster_id= monster_id;
 	message.sound_id= sound_id;
+
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::PlayMonsterSound(
 	const EntityId monster_id,
 	const unsigned int monster_sound_id )
 {
-	monsters_sounds_messages_.emplace_back();
-	Messages::MonsterSound& message= monsters_sounds_messages_.back();
+	Messages::MonsterSound message;
 
 	message.monster_id= monster_id;
 	message.monster_sound_id= monster_sound_id;
+
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::PlayMapEventSound( const m_Vec3& pos, const unsigned int sound_id )
 {
-	map_events_sounds_messages_.emplace_back();
-	Messages::MapEventSound& message= map_events_sounds_messages_.back();
+	Messages::MapEventSound message;
 
 	PositionToMessagePosition( pos, message.xyz );
 	message.sound_id= sound_id;
+
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::AddParticleEffect( const m_Vec3& pos, const ParticleEffect particle_effect )
 {
-	particles_effects_messages_.emplace_back();
-	Messages::ParticleEffectBirth& message= particles_effects_messages_.back();
+	Messages::ParticleEffectBirth message;
 
 	PositionToMessagePosition( pos, message.xyz );
 	message.effect_id= static_cast<unsigned char>( particle_effect );
+
+	update_events_messages_.AddUnreliableMessage( message );
 }
 
 void Map::AddTextMessage( const char* const text )
@@ -462,200 +574,11 @@ m_Vec3 Map::CollideWithMap(
 	const Time tick_delta,
 	bool& out_on_floor, MovementRestriction& out_movement_restriction ) const
 {
-	m_Vec2 pos= in_pos.xy();
-	out_on_floor= false;
-
-	const float z_bottom= in_pos.z;
-	const float z_top= z_bottom + height;
-	float new_z= in_pos.z;
-
-	// Store list of objects, collisions with which alread processed.
-	constexpr unsigned int c_max_collisions= 32u;
-	MapData::IndexElement processed_collisions[ c_max_collisions ];
-	unsigned int processed_collisions_count= 0u;
-	const auto collision_processed=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		if( processed_collisions_count == c_max_collisions )
-			return true;
-		for( unsigned int i= 0u; i < processed_collisions_count; i++ )
-			if( std::memcmp( &processed_collisions[i], &index_element, sizeof(MapData::IndexElement) ) == 0 )
-				return true;
-		return false;
-	};
-	const auto process_collision=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		PC_ASSERT( processed_collisions_count < c_max_collisions );
-		processed_collisions[ processed_collisions_count ]= index_element;
-		processed_collisions_count++;
-	};
-
-	const auto elements_process_func=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		if( collision_processed(index_element) )
-			return;
-
-		if( index_element.type == MapData::IndexElement::StaticWall )
-		{
-			PC_ASSERT( index_element.index < map_data_->static_walls.size() );
-			const MapData::Wall& wall= map_data_->static_walls[ index_element.index ];
-
-			const MapData::WallTextureDescription& tex= map_data_->walls_textures[ wall.texture_id ];
-			if( tex.gso[0] )
-				return;
-
-			// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
-			if( wall.texture_id < MapData::c_first_transparent_texture_id &&
-				mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
-				return;
-
-			m_Vec2 new_pos;
-			if( CollideCircleWithLineSegment(
-					wall.vert_pos[0], wall.vert_pos[1],
-					pos, radius,
-					new_pos ) )
-			{
-				process_collision( index_element );
-				pos= new_pos;
-				out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
-			}
-		}
-		else if( index_element.type == MapData::IndexElement::StaticModel )
-		{
-			const StaticModel& model= static_models_[ index_element.index ];
-			if( model.model_id >= map_data_->models_description.size() )
-				return;
-
-			const MapData::ModelDescription& model_description= map_data_->models_description[ model.model_id ];
-			if( model_description.radius <= 0.0f )
-				return;
-
-			const ACode a_code= static_cast<ACode>( model_description.ac );
-			if( a_code >= ACode::RedKey && a_code <= ACode::BlueKey )
-				return; // Skip keys
-
-			const Model& model_geometry= map_data_->models[ model.model_id ];
-
-			const float model_z_min= model_geometry.z_min + model.pos.z;
-			const float model_z_max= model_geometry.z_max + model.pos.z;
-			if( z_top < model_z_min || z_bottom > model_z_max )
-				return;
-
-			bool collided= false;
-
-			m_Vec2 collide_pos;
-			if( CollideWithSquare( model_description ) )
-			{
-				collided=
-					CollideCircleWithSquare(
-						model.pos.xy(), model.angle, model_description.radius,
-						pos, radius,
-						collide_pos );
-			}
-			else
-			{
-				const float min_distance= radius + model_description.radius;
-				const m_Vec2 vec_to_pos= pos - model.pos.xy();
-				const float square_distance= vec_to_pos.SquareLength();
-				if( square_distance > 0.0f && square_distance < min_distance * min_distance )
-				{
-					collided= true;
-					collide_pos= model.pos.xy() + vec_to_pos * min_distance / std::sqrt( square_distance );
-				}
-			}
-
-			if( collided )
-			{
-				process_collision( index_element );
-				// Pull up or down player.
-				if( model_z_max - z_bottom <= GameConstants::z_pull_distance &&
-					model_z_max + height <= GameConstants::walls_height )
-				{
-					if( new_z < model_z_max )
-					{
-						new_z+= GameConstants::z_pull_speed * tick_delta.ToSeconds();
-						new_z= std::min( new_z, model_z_max );
-						if( new_z >= model_z_max )
-							out_on_floor= true;
-					}
-				}
-				else if( z_top - model_z_min <= GameConstants::z_pull_distance &&
-					model_z_min - height >= 0.0f )
-				{
-					if( new_z > model_z_min - height )
-					{
-						new_z-= GameConstants::z_pull_speed * tick_delta.ToSeconds();
-						new_z= std::max( new_z, model_z_min - height );
-					}
-				}
-				// Push sideways.
-				else
-				{
-					const m_Vec2 normal= collide_pos - pos;
-					const float normal_square_length= normal.SquareLength();
-					if( normal_square_length > 0.0f )
-						out_movement_restriction.AddRestriction( normal / normal_square_length );
-
-					pos.x= collide_pos.x;
-					pos.y= collide_pos.y;
-				}
-			}
-		}
-		else
-		{
-			// TODO
-		}
-	};
-
-	collision_index_.ProcessElementsInRadius(
-		pos, radius,
-		elements_process_func );
-
-	// Dynamic walls
-	for( const DynamicWall& wall : dynamic_walls_ )
-	{
-		if( wall.vert_pos[0] == wall.vert_pos[1] )
-			continue;
-
-		const MapData::WallTextureDescription& tex= map_data_->walls_textures[ wall.texture_id ];
-		if( tex.gso[0] )
-			continue;
-
-		// PROCESS.05:
-		// ;  up            [ x,y] [ H]   [s:num]     ,if H>=80 then walktrough
-		if( wall.z >= 80.0f / 64.0f )
-			continue;
-
-		if( z_top < wall.z || z_bottom > wall.z + GameConstants::walls_height )
-			continue;
-
-		// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
-		if( wall.texture_id < MapData::c_first_transparent_texture_id &&
-			mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
-			continue;
-
-		m_Vec2 new_pos;
-		if( CollideCircleWithLineSegment(
-				wall.vert_pos[0], wall.vert_pos[1],
-				pos, radius,
-				new_pos ) )
-		{
-			pos= new_pos;
-			out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
-		}
-	}
-
-	if( new_z <= 0.0f )
-	{
-		out_on_floor= true;
-		new_z= 0.0f;
-	}
-	else if( new_z + height > GameConstants::walls_height )
-		new_z= GameConstants::walls_height - height;
-
-	return m_Vec3( pos, new_z );
+	return
+		CollideCylinderWithMap(
+			*map_data_, collision_index_, static_models_, dynamic_walls_,
+			in_pos, height, radius, tick_delta,
+			out_on_floor, out_movement_restriction );
 }
 
 bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
@@ -667,6 +590,13 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 	const float max_see_distance= direction.Length();
 	direction.Normalize();
 
+	float static_wall_distance;
+	unsigned int static_wall_index;
+	if( collision_index_.RayCastStaticWalls(
+			from, direction, max_see_distance,
+			static_wall_distance, static_wall_index ) )
+		return false;
+
 	bool can_see= true;
 	const auto try_set_occluder=
 	[&]( const m_Vec3& intersection_point ) -> bool
@@ -682,27 +612,7 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 	const auto element_process_func=
 	[&]( const MapData::IndexElement& element ) -> bool
 	{
-		if( element.type == MapData::IndexElement::StaticWall )
-		{
-			PC_ASSERT( element.index < map_data_->static_walls.size() );
-			const MapData::Wall& wall= map_data_->static_walls[ element.index ];
-
-			const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
-			if( wall_texture.gso[1] )
-				return false;
-
-			m_Vec3 candidate_pos;
-			if( RayIntersectWall(
-					wall.vert_pos[0], wall.vert_pos[1],
-					0.0f, 2.0f,
-					from, direction,
-					candidate_pos ) )
-			{
-				if( try_set_occluder( candidate_pos ) )
-					return true;
-			}
-		}
-		else if( element.type == MapData::IndexElement::StaticModel )
+		if( element.type == MapData::IndexElement::StaticModel )
 		{
 			PC_ASSERT( element.index < static_models_.size() );
 			const StaticModel& model= static_models_[ element.index ];
@@ -728,6 +638,26 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 					return true;
 			}
 		}
+		else if( element.type == MapData::IndexElement::DynamicWall )
+		{
+			PC_ASSERT( element.index < dynamic_walls_.size() );
+			const DynamicWall& wall= dynamic_walls_[ element.index ];
+
+			const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
+			if( wall_texture.gso[1] )
+				return false;
+
+			m_Vec3 candidate_pos;
+			if( RayIntersectWall(
+					wall.vert_pos[0], wall.vert_pos[1],
+					wall.z, wall.z + 2.0f,
+					from, direction,
+					candidate_pos ) )
+			{
+				if( try_set_occluder( candidate_pos ) )
+					return true;
+			}
+		}
 		else
 		{
 			PC_ASSERT( false );
@@ -735,32 +665,68 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 		return false;
 	};
 
-	// Static walls and map models.
 	collision_index_.RayCast(
 		from, direction,
 		element_process_func,
 		max_see_distance );
 
-	// Dynamic walls.
-	for( const DynamicWall& wall : dynamic_walls_ )
-	{
-		const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
-		if( wall_texture.gso[1] )
-			continue;
+	return can_see;
+}
 
-		m_Vec3 candidate_pos;
-		if( RayIntersectWall(
-				wall.vert_pos[0], wall.vert_pos[1],
-				wall.z, wall.z + 2.0f,
-				from, direction,
-				candidate_pos ) )
-		{
-			if( try_set_occluder( candidate_pos ) )
-				break;
-		}
-	}
+static bool GetSeeCachePointKey( const m_Vec3& pos, uint32_t& out_key )
+{
+	// 1/2 unit for x and y, 1/4 unit for z in range [-1; 3).
+	const int x= static_cast<int>( std::floor( pos.x * 2.0f ) );
+	const int y= static_cast<int>( std::floor( pos.y * 2.0f ) );
+	const int z= static_cast<int>( std::floor( ( pos.z + 1.0f ) * 4.0f ) );
+	if( x < 0 || x >= int(MapData::c_map_size * 2u) ||
+		y < 0 || y >= int(MapData::c_map_size * 2u) ||
+		z < 0 || z >= 16 )
+		return false;
 
-	return can_see;
+	out_key= uint32_t(x) | ( uint32_t(y) << 8u ) | ( uint32_t(z) << 16u );
+	return true;
+}
+
+bool Map::CanSeeCached( const m_Vec3& from, const m_Vec3& to ) const
+{
+	// Results live some random number of ticks, so, checks of monsters are spread over several ticks.
+	constexpr unsigned int c_min_lifetime_ticks= 2u;
+	constexpr unsigned int c_lifetime_spread_ticks= 4u;
+
+	uint32_t from_key, to_key;
+	if( !GetSeeCachePointKey( from, from_key ) ||
+		!GetSeeCachePointKey( to  , to_key   ) )
+		return CanSee( from, to );
+
+	// Visibility is symmetric.
+	if( from_key > to_key )
+		std::swap( from_key, to_key );
+	const uint64_t key= ( uint64_t(from_key) << 32u ) | uint64_t(to_key);
+
+	const auto it= see_cache_.find( key );
+	if( it != see_cache_.end() && it->second.expiration_tick > see_cache_tick_ )
+		return it->second.can_see;
+
+	SeeCacheEntry& entry= see_cache_[ key ];
+	entry.can_see= CanSee( from, to );
+	entry.expiration_tick=
+		see_cache_tick_ + c_min_lifetime_ticks +
+		( ( from_key ^ to_key ^ see_cache_tick_ ) * 2654435761u >> 28u ) % c_lifetime_spread_ticks;
+
+	return entry.can_see;
+}
+
+bool Map::GetNavigationDirection( const m_Vec2& from, const m_Vec2& to, m_Vec2& out_direction ) const
+{
+	if( navigation_grid_.IsPathFree( from, to ) )
+		return false;
+
+	unsigned int target_cell;
+	if( !NavigationGrid::GetCell( to, target_cell ) )
+		return false;
+
+	return NavigationGrid::GetFlowDirection( GetNavigationFlowField( target_cell ), from, out_direction );
 }
 
 const Map::MonstersContainer& Map::GetMonsters() const
@@ -773,6 +739,11 @@ const Map::PlayersContainer& Map::GetPlayers() const
 	return players_;
 }
 
+unsigned int Map::GetRocketsCount() const
+{
+	return rockets_.Size();
+}
+
 void Map::ProcessPlayerPosition(
 	const Time current_time,
 	const EntityId player_monster_id,
@@ -1035,7 +1006,7 @@ void Map::ProcessPlayerPosition(
 	auto backpack_it= backpacks_.begin();
 	while( backpack_it != backpacks_.end() )
 	{
-		const Backpack& backpack= *backpack_it->second;
+		const Backpack& backpack= backpack_it->second;
 
 		const float square_distance= ( backpack.pos.xy() - pos ).SquareLength();
 		if( square_distance <= GameConstants::player_interact_radius * GameConstants::player_interact_radius )
@@ -1044,8 +1015,9 @@ void Map::ProcessPlayerPosition(
 			{
 				PlayMonsterLinkedSound( player_monster_id, Sound::SoundId::ItemUp );
 
-				dynamic_items_death_messages_.emplace_back();
-				dynamic_items_death_messages_.back().item_id= backpack_it->first;
+				Messages::DynamicItemDeath message;
+				message.item_id= backpack_it->first;
+				update_events_messages_.AddUnreliableMessage( message );
 
 				backpack_it= backpacks_.erase( backpack_it );
 				continue;
@@ -1058,6 +1030,8 @@ void Map::ProcessPlayerPosition(
 
 void Map::Tick( const Time current_time, const Time last_tick_delta )
 {
+	PC_PROFILE_SCOPE( "Map::Tick" );
+
 	const Time prev_tick_time= current_time - last_tick_delta;
 	const unsigned int death_ticks=
 		static_cast<unsigned int>( GameConstants::death_ticks_per_second * current_time  .ToSeconds() ) -
@@ -1065,8 +1039,11 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 
 	const float last_tick_delta_s= last_tick_delta.ToSeconds();
 
-	// Update state of procedures
-	for( unsigned int p= 0u; p < procedures_.size(); p++ )
+	Profiler::ScopedPhases phases( "Map::Tick procedures" );
+
+	// Update state of procedures.
+	// Procedures, activated here, are processed in this tick, if their numbers are greater, than number of current procedure.
+	for( unsigned int p= GetNextActiveProcedure( 0u ); p < procedures_.size(); p= GetNextActiveProcedure( p + 1u ) )
 	{
 		const MapData::Procedure& procedure= map_data_->procedures[p];
 		ProcedureState& procedure_state= procedures_[p];
@@ -1148,10 +1125,17 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				procedure_state.movement_stage= new_stage;
 			break;
 		}; // switch state
+
+		if( procedure_state.movement_state == ProcedureState::MovementState::None )
+			SetProcedureActive( p, false );
 	} // for procedures
 
+	see_cache_tick_++;
+	RemoveExpiredSeeCacheEntries();
+
 	MoveMapObjects( current_time );
 
+	phases.Next( "Map::Tick static models" );
 	// Process static models
 	for( StaticModel& model : static_models_ )
 	{
@@ -1218,10 +1202,21 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			model.current_animation_frame= model.animation_start_frame;
 	} // for static models
 
+	phases.Next( "Map::Tick shots" );
+	// Monsters do not move during shots and mines processing.
+	monsters_index_.Rebuild( monsters_, *game_resources_ );
+	RecordMonstersPositionHistory( current_time );
+
+	PrepareInstantShotsResults();
+
+	MoveRockets( current_time, last_tick_delta_s );
+
 	// Process shots
-	for( unsigned int r= 0u; r < rockets_.size(); )
+	for( unsigned int r= 0u; r < rockets_.Size(); )
 	{
-		Rocket& rocket= rockets_[r];
+		Rocket& rocket= rockets_.rockets[r];
+		m_Vec3& rocket_position= rockets_.positions[r];
+		const m_Vec3 new_pos= rockets_.new_positions[r];
 		const GameResources::RocketDescription& rocket_description= game_resources_->rockets_description[ rocket.rocket_type_id ];
 
 		const bool has_infinite_speed= rocket.HasInfiniteSpeed( *game_resources_ );
@@ -1230,64 +1225,22 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		HitResult hit_result;
 
 		if( has_infinite_speed )
-			hit_result= ProcessShot( rocket.start_point, rocket.normalized_direction, Constants::max_float, rocket.owner_id );
+		{
+			const InstantShotResult* const instant_shot_result= FindInstantShotResult( rocket.rocket_id );
+			if( instant_shot_result != nullptr )
+				hit_result= instant_shot_result->hit_result;
+			else
+				hit_result= ProcessShot( rocket.start_point, rocket.normalized_direction, Constants::max_float, rocket.owner_id );
+		}
 		else
 		{
 			const float c_length_eps= 1.0f / 64.0f;
-			const float gravity_force= GameConstants::rockets_gravity_scale * float( rocket_description.gravity_force );
-			const float speed= rocket_description.fast ? GameConstants::fast_rockets_speed : GameConstants::rockets_speed;
-
-			m_Vec3 new_pos;
-			if( rocket_description.reflect )
-			{
-				rocket.speed.z-= gravity_force * last_tick_delta_s;
-				new_pos= rocket.previous_position + rocket.speed * last_tick_delta_s;
-
-				if( new_pos.z < 0.0f ) // Reflect.
-				{
-					new_pos.z= 0.0f;
-					rocket.speed.z= std::abs( rocket.speed.z );
-				}
-
-				rocket.normalized_direction= rocket.speed;
-				rocket.normalized_direction.Normalize();
-			}
-			else if( rocket_description.Auto2 )
-			{
-				m_Vec3 target_pos;
-				if( FindNearestPlayerPos( rocket.previous_position, target_pos ) )
-				{
-					m_Vec3 dir_to_target= target_pos - rocket.previous_position;
-					dir_to_target.Normalize();
-
-					m_Vec3 rot_axis= mVec3Cross( rocket.normalized_direction, dir_to_target );
-					const float rot_axis_square_length= rot_axis.SquareLength();
-					if( rot_axis_square_length < 0.001f * 0.001f )
-						rot_axis= m_Vec3( 0.0f, 0.0f, 1.0f );
 
-					const float c_rot_speed= Constants::half_pi;
-					m_Mat4 mat;
-					mat.Rotate( rot_axis, last_tick_delta_s * c_rot_speed );
-
-					rocket.normalized_direction= rocket.normalized_direction * mat;
-					rocket.normalized_direction.Normalize();
-				}
-
-				new_pos= rocket.previous_position + rocket.normalized_direction * speed * last_tick_delta_s;
-			}
-			else
-			{
-				new_pos=
-					rocket.start_point +
-					rocket.normalized_direction * ( time_delta_s * speed ) +
-					m_Vec3( 0.0f, 0.0f, -1.0f ) * ( gravity_force * time_delta_s * time_delta_s * 0.5f );
-			}
-
-			m_Vec3 dir= new_pos - rocket.previous_position;
+			m_Vec3 dir= new_pos - rocket_position;
 			const float max_distance= dir.Length() + c_length_eps;
 			dir.Normalize();
 
-			hit_result= ProcessShot( rocket.previous_position, dir, max_distance, rocket.owner_id );
+			hit_result= ProcessShot( rocket_position, dir, max_distance, rocket.owner_id );
 
 			if( rocket_description.reflect &&
 				hit_result.object_type == HitResult::ObjectType::Floor && hit_result.object_index == 0u )
@@ -1301,7 +1254,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				{
 					rocket.owner_id= it->first;
 					rocket.start_time= current_time;
-					rocket.start_point= rocket.previous_position= hit_result.pos;
+					rocket.start_point= rocket_position= hit_result.pos;
 					rocket.track_length= 0.0f;
 
 					// Use direction from player position to hit position as new rocket direction.
@@ -1331,25 +1284,25 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				game_resources_->rockets_description[ rocket.rocket_type_id ].smoke_trail_effect_id;
 			if( sprite_effect_id != 0u )
 			{
+				Messages::SpriteEffectBirth message;
+				message.effect_id= sprite_effect_id;
+
 				const float c_particels_per_unit= 2.0f; // TODO - calibrate
-				const float length_delta= ( new_pos - rocket.previous_position ).Length() * c_particels_per_unit;
+				const float length_delta= ( new_pos - rocket_position ).Length() * c_particels_per_unit;
 				const float new_track_length= rocket.track_length + length_delta;
 				for( unsigned int i= static_cast<unsigned int>( rocket.track_length ) + 1u;
 					i <= static_cast<unsigned int>( new_track_length ); i++ )
 				{
 					const float part= ( float(i) - rocket.track_length ) / length_delta;
 
-					sprite_effects_.emplace_back();
-					SpriteEffect& effect= sprite_effects_.back();
-
-					effect.pos= ( 1.0f - part ) * rocket.previous_position + part * new_pos;
-					effect.effect_id= sprite_effect_id;
+					PositionToMessagePosition( ( 1.0f - part ) * rocket_position + part * new_pos, message.xyz );
+					update_events_messages_.AddUnreliableMessage( message );
 				}
 
 				rocket.track_length= new_track_length;
 			}
 
-			rocket.previous_position= new_pos;
+			rocket_position= new_pos;
 		}
 
 		// Calculate shifted hit pos.
@@ -1389,10 +1342,13 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 
 		const bool process_explosion= rocket.DealsExplosionDamage(*game_resources_);
 		if( hit_result.object_type != HitResult::ObjectType::None && process_explosion )
+		{
 			DoExplosionDamage(
 				hit_result.pos, rocket_description.explosion_radius,
 				GetRocketDamage( rocket_description.power ),
 				rocket.owner_id, current_time );
+			instant_shots_results_valid_= false;
+		}
 
 		// Gen hit effect.
 		if( hit_result.object_type == HitResult::ObjectType::Monster )
@@ -1414,6 +1370,9 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		// Try break breakable models.
 		if( hit_result.object_type == HitResult::ObjectType::Model )
 		{
+			// Model may be destroyed, procedures may be activated.
+			instant_shots_results_valid_= false;
+
 			StaticModel& model= static_models_[ hit_result.object_index ];
 
 			if( model.model_id >= map_data_->models_description.size() )
@@ -1462,7 +1421,10 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				[&]( const MapData::Link& link )
 				{
 					if( link.type == MapData::Link::Shoot )
+					{
 						ProcedureProcessShoot( link.proc_id, current_time );
+						instant_shots_results_valid_= false;
+					}
 				} );
 		}
 		else if( hit_result.object_type == HitResult::ObjectType::Floor )
@@ -1483,6 +1445,10 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 					rocket.normalized_direction.xy(), rocket.owner_id,
 					*this,
 					hit_result.object_index ,current_time );
+
+				// Next pellets must fly through killed monster.
+				if( monster->Health() <= 0 )
+					instant_shots_results_valid_= false;
 			}
 		}
 
@@ -1494,18 +1460,18 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		{
 			if( !has_infinite_speed )
 			{
-				rockets_death_messages_.emplace_back();
-				rockets_death_messages_.back().rocket_id= rocket.rocket_id;
+				Messages::RocketDeath message;
+				message.rocket_id= rocket.rocket_id;
+				update_events_messages_.AddUnreliableMessage( message );
 			}
 
-			if( r != rockets_.size() - 1u )
-				rockets_[r]= rockets_.back();
-			rockets_.pop_back();
+			rockets_.Remove( r );
 		}
 		else
 			r++;
 	} // for rockets
 
+	phases.Next( "Map::Tick mines" );
 	// Process mines
 	for( unsigned int m= 0u; m < mines_.size(); )
 	{
@@ -1526,23 +1492,23 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 
 			// Try activate mine.
 			bool activated= false;
-			for( const MonstersContainer::value_type& monster_value : monsters_ )
-			{
-				MonsterBase& monster= *monster_value.second;
+			monsters_index_.ProcessMonstersInRadius(
+				mine.pos.xy(), GameConstants::mines_activation_radius,
+				[&]( const EntityId monster_id, const MonsterBase& monster )
+				{
+					PC_UNUSED( monster_id );
 
-				const float square_distance= ( monster.Position().xy() - mine.pos.xy() ).SquareLength();
-				if( square_distance > 8.0f * 8.0f ) // Too far, early reject.
-					continue;
+					const float square_distance= ( monster.Position().xy() - mine.pos.xy() ).SquareLength();
 
-				const float monster_radius=
-					monster.MonsterId() == 0u
-						? GameConstants::player_radius :
-						game_resources_->monsters_description[ monster.MonsterId() ].w_radius;
+					const float monster_radius=
+						monster.MonsterId() == 0u
+							? GameConstants::player_radius :
+							game_resources_->monsters_description[ monster.MonsterId() ].w_radius;
 
-				const float activation_distance= GameConstants::mines_activation_radius + monster_radius;
-				if( square_distance < activation_distance * activation_distance )
-					activated= true;
-			}
+					const float activation_distance= GameConstants::mines_activation_radius + monster_radius;
+					if( square_distance < activation_distance * activation_distance )
+						activated= true;
+				} );
 
 			if( activated )
 			{
@@ -1554,19 +1520,16 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 					GameConstants::mines_damage,
 					mine.owner_id, current_time );
 
-				particles_effects_messages_.emplace_back();
-				Messages::ParticleEffectBirth& message= particles_effects_messages_.back();
-				message.effect_id= static_cast<unsigned char>(ParticleEffect::Explosion);
-				PositionToMessagePosition( mine.pos, message.xyz );
-
+				AddParticleEffect( mine.pos, ParticleEffect::Explosion );
 				PlayMapEventSound( mine.pos, 40u );
 			}
 		}
 
 		if( need_kill )
 		{
-			dynamic_items_death_messages_.emplace_back();
-			dynamic_items_death_messages_.back().item_id= mine.id;
+			Messages::DynamicItemDeath message;
+			message.item_id= mine.id;
+			update_events_messages_.AddUnreliableMessage( message );
 
 			if( m != mines_.size() - 1u )
 				mine= mines_.back();
@@ -1576,6 +1539,17 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			m++;
 	}
 
+	phases.Next( "Map::Tick navigation" );
+	// Keep flow fields to players actual. Fields are rebuilt only when player moves into other map cell.
+	navigation_tick_++;
+	for( const PlayersContainer::value_type& player_value : players_ )
+	{
+		unsigned int player_cell;
+		if( NavigationGrid::GetCell( player_value.second->Position().xy(), player_cell ) )
+			GetNavigationFlowField( player_cell );
+	}
+
+	phases.Next( "Map::Tick monsters" );
 	// Process monsters
 	for( MonstersContainer::value_type& monster_value : monsters_ )
 	{
@@ -1619,15 +1593,18 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		// TODO - select more correct way to do this.
 		const int wind_x= static_cast<int>( monster.Position().x - 0.5f );
 		const int wind_y= static_cast<int>( monster.Position().y - 0.5f );
-		if( wind_x >= 0 && wind_x < int(MapData::c_map_size - 1u) &&
+		if( !wind_field_.Empty() &&
+			wind_x >= 0 && wind_x < int(MapData::c_map_size - 1u) &&
 			wind_y >= 0 && wind_y < int(MapData::c_map_size - 1u) )
 		{
 			// Find interpolated value of wind in 4 cells, nearest to monster center.
 			const auto wind_fetch=
 			[&]( int x, int y )
 			{
-				const char* const wind_cell= wind_field_[ x + y * int(MapData::c_map_size) ];
-				return m_Vec2( wind_cell[0], wind_cell[1] );
+				const WindFieldCell* const wind_cell= wind_field_.Get( x, y );
+				if( wind_cell == nullptr )
+					return m_Vec2( 0.0f, 0.0f );
+				return m_Vec2( wind_cell->dir[0], wind_cell->dir[1] );
 			};
 			const float dx= monster.Position().x - 0.5f - float(wind_x);
 			const float dy= monster.Position().y - 0.5f - float(wind_y);
@@ -1652,12 +1629,15 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		// TODO - make death zone intersection calculation correct, like with wind zones.
 		const int monster_x= static_cast<int>( monster.Position().x );
 		const int monster_y= static_cast<int>( monster.Position().y );
-		if( monster_x >= 0 && monster_x < int(MapData::c_map_size) &&
+		if( death_ticks > 0u && !death_field_.Empty() &&
+			monster_x >= 0 && monster_x < int(MapData::c_map_size) &&
 			monster_y >= 0 && monster_y < int(MapData::c_map_size) )
 		{
-			const DamageFiledCell& cell= death_field_[ monster_x + monster_y * int(MapData::c_map_size) ];
-			if( cell.damage > 0u && death_ticks > 0u )
+			const DamageFiledCell* const cell_ptr= death_field_.Get( monster_x, monster_y );
+			if( cell_ptr != nullptr )
 			{
+				const DamageFiledCell& cell= *cell_ptr;
+
 				// It looks, like damage field with "z_bottom" == -1 does not damage players.
 				if( monster.MonsterId() == 0u && cell.z_bottom < 0 )
 					continue;
@@ -1673,7 +1653,11 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		}
 	}
 
-	// Collide monsters with map
+	phases.Next( "Map::Tick monsters collisions" );
+	// Collide monsters with map.
+	// Collisions of monsters with map are independent, so, calculate them in parallel.
+	// Results are applied serially, in order of monsters container.
+	monsters_map_collisions_.clear();
 	for( MonstersContainer::value_type& monster_value : monsters_ )
 	{
 		MonsterBase& monster= *monster_value.second;
@@ -1682,6 +1666,17 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		if( is_player && static_cast<const Player&>(monster).IsNoclip() )
 			continue;
 
+		monsters_map_collisions_.emplace_back();
+		monsters_map_collisions_.back().monster= &monster;
+	}
+
+	const auto collide_monster_with_map=
+	[&]( const unsigned int collision_index )
+	{
+		MonsterMapCollision& collision= monsters_map_collisions_[ collision_index ];
+		const MonsterBase& monster= *collision.monster;
+		const bool is_player= monster.MonsterId() == 0u;
+
 		const EntityId mosnter_id= monster.MonsterId();
 
 		const float height=
@@ -1690,15 +1685,26 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				: std::max( GameConstants::player_height, game_resources_->monsters_models[ mosnter_id ].z_max );
 		const float radius= is_player ? GameConstants::player_radius : game_resources_->monsters_description[ mosnter_id ].w_radius;
 
-		MovementRestriction movement_restriction;
-		bool on_floor= false;
-		const m_Vec3 old_monster_pos= monster.Position();
-		const m_Vec3 new_monster_pos=
+		collision.on_floor= false;
+		collision.new_pos=
 			CollideWithMap(
-				old_monster_pos, height, radius, last_tick_delta,
-				on_floor, movement_restriction );
+				monster.Position(), height, radius, last_tick_delta,
+				collision.on_floor, collision.movement_restriction );
+	};
+
+	if( monsters_map_collisions_.size() >= g_min_monsters_for_parallel_collisions )
+		workers_pool_.ParallelFor( monsters_map_collisions_.size(), collide_monster_with_map );
+	else
+	{
+		for( unsigned int i= 0u; i < monsters_map_collisions_.size(); i++ )
+			collide_monster_with_map(i);
+	}
 
-		const m_Vec3 position_delta= new_monster_pos - old_monster_pos;
+	for( const MonsterMapCollision& collision : monsters_map_collisions_ )
+	{
+		MonsterBase& monster= *collision.monster;
+
+		const m_Vec3 position_delta= collision.new_pos - monster.Position();
 
 		if( position_delta.z != 0.0f ) // Vertical clamp
 			monster.ClampSpeed( m_Vec3( 0.0f, 0.0f, position_delta.z > 0.0f ? 1.0f : -1.0f ) );
@@ -1707,9 +1713,9 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		if( position_delta_length != 0.0f ) // Horizontal clamp
 			monster.ClampSpeed( m_Vec3( position_delta.xy() / position_delta_length, 0.0f ) );
 
-		monster.SetPosition( new_monster_pos );
-		monster.SetOnFloor( on_floor );
-		monster.SetMovementRestriction( movement_restriction );
+		monster.SetPosition( collision.new_pos );
+		monster.SetOnFloor( collision.on_floor );
+		monster.SetMovementRestriction( collision.movement_restriction );
 	}
 
 	// Process mortal walls for monsters.
@@ -1825,6 +1831,9 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 	}
 
 	// Collide monsters together
+	monsters_index_.Rebuild( monsters_, *game_resources_ );
+	const float c_max_collide_distance= 8.0f;
+
 	for( MonstersContainer::value_type& first_monster_value : monsters_ )
 	{
 		MonsterBase& first_monster= *first_monster_value.second;
@@ -1835,65 +1844,68 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		const m_Vec2 first_monster_z_minmax=
 			first_monster.GetZMinMax() + m_Vec2( first_monster.Position().z, first_monster.Position().z );
 
-		for( MonstersContainer::value_type& second_monster_value : monsters_ )
-		{
-			MonsterBase& second_monster= *second_monster_value.second;
-			if( &second_monster == &first_monster )
-				continue;
+		monsters_index_.ProcessMonstersInRadius(
+			first_monster.Position().xy(), c_max_collide_distance,
+			[&]( const EntityId second_monster_id, MonsterBase& second_monster )
+			{
+				PC_UNUSED( second_monster_id );
 
-			if( second_monster.Health() <= 0 )
-				continue;
+				if( &second_monster == &first_monster )
+					return;
 
-			const float square_distance= ( first_monster.Position().xy() - second_monster.Position().xy() ).SquareLength();
+				if( second_monster.Health() <= 0 )
+					return;
 
-			const float c_max_collide_distance= 8.0f;
-			if( square_distance > c_max_collide_distance * c_max_collide_distance )
-				continue;
+				const float square_distance= ( first_monster.Position().xy() - second_monster.Position().xy() ).SquareLength();
 
-			const float second_monster_radius= game_resources_->monsters_description[ second_monster.MonsterId() ].w_radius;
-			const float min_distance= second_monster_radius + first_monster_radius;
-			if( square_distance > min_distance * min_distance )
-				continue;
+				if( square_distance > c_max_collide_distance * c_max_collide_distance )
+					return;
 
-			const m_Vec2 second_monster_z_minmax=
-				second_monster.GetZMinMax() + m_Vec2( second_monster.Position().z, second_monster.Position().z );
-			if(  first_monster_z_minmax.y < second_monster_z_minmax.x ||
-				second_monster_z_minmax.y <  first_monster_z_minmax.x ) // Z check
-				continue;
+				const float second_monster_radius= game_resources_->monsters_description[ second_monster.MonsterId() ].w_radius;
+				const float min_distance= second_monster_radius + first_monster_radius;
+				if( square_distance > min_distance * min_distance )
+					return;
 
-			// Collide here
-			m_Vec2 collide_vec= second_monster.Position().xy() - first_monster.Position().xy();
-			collide_vec.Normalize();
+				const m_Vec2 second_monster_z_minmax=
+					second_monster.GetZMinMax() + m_Vec2( second_monster.Position().z, second_monster.Position().z );
+				if(  first_monster_z_minmax.y < second_monster_z_minmax.x ||
+					second_monster_z_minmax.y <  first_monster_z_minmax.x ) // Z check
+					return;
 
-			const float move_delta= min_distance - std::sqrt( square_distance );
+				// Collide here
+				m_Vec2 collide_vec= second_monster.Position().xy() - first_monster.Position().xy();
+				collide_vec.Normalize();
 
-			float first_monster_k;
-			if( first_monster.MonsterId() == 0u && second_monster.MonsterId() != 0u )
-				first_monster_k= 1.0f;
-			else if( first_monster.MonsterId() != 0u && second_monster.MonsterId() == 0u )
-				first_monster_k= 0.0f;
-			else
-				first_monster_k= 0.5f;
+				const float move_delta= min_distance - std::sqrt( square_distance );
 
-			const bool  first_blocked=  first_monster.GetMovementRestriction().MovementIsBlocked( -collide_vec );
-			const bool second_blocked= second_monster.GetMovementRestriction().MovementIsBlocked(  collide_vec );
-			if(  first_blocked && !second_blocked )
-				first_monster_k= 0.0f;
-			if( !first_blocked &&  second_blocked )
-				first_monster_k= 1.0f;
+				float first_monster_k;
+				if( first_monster.MonsterId() == 0u && second_monster.MonsterId() != 0u )
+					first_monster_k= 1.0f;
+				else if( first_monster.MonsterId() != 0u && second_monster.MonsterId() == 0u )
+					first_monster_k= 0.0f;
+				else
+					first_monster_k= 0.5f;
 
-			const m_Vec2  first_monster_pos=  first_monster.Position().xy() - collide_vec * move_delta * first_monster_k;
-			const m_Vec2 second_monster_pos= second_monster.Position().xy() + collide_vec * move_delta * ( 1.0f - first_monster_k );
+				const bool  first_blocked=  first_monster.GetMovementRestriction().MovementIsBlocked( -collide_vec );
+				const bool second_blocked= second_monster.GetMovementRestriction().MovementIsBlocked(  collide_vec );
+				if(  first_blocked && !second_blocked )
+					first_monster_k= 0.0f;
+				if( !first_blocked &&  second_blocked )
+					first_monster_k= 1.0f;
 
-			 first_monster.SetPosition( m_Vec3( first_monster_pos ,  first_monster.Position().z ) );
-			second_monster.SetPosition( m_Vec3( second_monster_pos, second_monster.Position().z ) );
-		}
+				const m_Vec2  first_monster_pos=  first_monster.Position().xy() - collide_vec * move_delta * first_monster_k;
+				const m_Vec2 second_monster_pos= second_monster.Position().xy() + collide_vec * move_delta * ( 1.0f - first_monster_k );
+
+				 first_monster.SetPosition( m_Vec3( first_monster_pos ,  first_monster.Position().z ) );
+				second_monster.SetPosition( m_Vec3( second_monster_pos, second_monster.Position().z ) );
+			} );
 	}
 
+	phases.Next( "Map::Tick backpacks and lights" );
 	// Process backpacks
 	for( auto& backpack_value : backpacks_ )
 	{
-		Backpack& backpack= *backpack_value.second;
+		Backpack& backpack= backpack_value.second;
 
 		backpack.vertical_speed+= GameConstants::vertical_acceleration * last_tick_delta_s;
 		backpack.pos.z+= backpack.vertical_speed * last_tick_delta_s;
@@ -1908,9 +1920,9 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			if( current_time >= model.linked_rotating_light->end_time )
 			{
 				// Kill expired rotating light source.
-				rotating_light_sources_death_messages_.emplace_back();
-				Messages::RotatingLightSourceDeath& message= rotating_light_sources_death_messages_.back();
+				Messages::RotatingLightSourceDeath message;
 				message.light_source_id= &model - static_models_.data();
+				update_events_messages_.AddReliableMessage( message );
 
 				model.linked_rotating_light= nullptr;
 			}
@@ -1943,11 +1955,12 @@ void Map::SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender )
 	}
 
 	// TODO - rockets, light sources, dynamic items
-	for( const Rocket& rocket : rockets_ )
+	for( unsigned int r= 0u; r < rockets_.Size(); r++ )
 	{
+		const Rocket& rocket= rockets_.rockets[r];
 		Messages::RocketBirth message;
 		message.rocket_type= rocket.rocket_type_id;
-		PrepareRocketStateMessage( rocket, message );
+		PrepareRocketStateMessage( rocket, rockets_.positions[r], message );
 
 		messages_sender.SendUnreliableMessage( message );
 	}
@@ -1959,10 +1972,10 @@ void Map::SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender )
 		messages_sender.SendUnreliableMessage( message );
 	}
 
-	for( const std::unordered_map<EntityId, BackpackPtr>::value_type& backpack_value : backpacks_ )
+	for( const BackpacksContainer::value_type& backpack_value : backpacks_ )
 	{
 		Messages::DynamicItemBirth message;
-		PrepareBackpackBirthMessage( *backpack_value.second, backpack_value.first, message );
+		PrepareBackpackBirthMessage( backpack_value.second, backpack_value.first, message );
 		messages_sender.SendUnreliableMessage( message );
 	}
 
@@ -1988,145 +2001,175 @@ void Map::SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender )
 	}
 }
 
-void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
+// Send messages, which differ from baseline, and update baseline.
+// Unchanged messages are resent once per "resend_period" updates.
+template<class Message>
+static void SendChangedMessages(
+	MessagesSender& messages_sender,
+	const std::vector<Message>& messages,
+	std::vector<Message>& baseline_messages,
+	const unsigned int update_number,
+	const unsigned int resend_period )
 {
-	Messages::WallPosition wall_message;
+	// Send all messages, if baseline is empty.
+	const bool baseline_valid= baseline_messages.size() == messages.size();
+	baseline_messages.resize( messages.size() );
 
-	for( const DynamicWall& wall : dynamic_walls_ )
+	for( unsigned int i= 0u; i < messages.size(); i++ )
 	{
-		wall_message.wall_index= &wall - dynamic_walls_.data();
+		const Message& message= messages[i];
+		Message& baseline_message= baseline_messages[i];
 
-		PositionToMessagePosition( wall.vert_pos[0], wall_message.vertices_xy[0] );
-		PositionToMessagePosition( wall.vert_pos[1], wall_message.vertices_xy[1] );
-		wall_message.z= CoordToMessageCoord( wall.z );
-		wall_message.texture_id= wall.texture_id;
-
-		messages_sender.SendUnreliableMessage( wall_message );
+		if( !baseline_valid ||
+			std::memcmp( &message, &baseline_message, sizeof(Message) ) != 0 ||
+			( i + update_number ) % resend_period == 0u )
+		{
+			baseline_message= message;
+			messages_sender.SendUnreliableMessage( message );
+		}
 	}
+}
 
-	Messages::StaticModelState model_message;
+void Map::UpdateMessagesBaseline::Clear()
+{
+	walls.clear();
+	static_models.clear();
+	items.clear();
+	update_number= 0u;
+}
 
+void Map::PrepareUpdateMessages()
+{
+	// Rebuild messages only for walls, changed since previous update.
+	walls_state_messages_.resize( dynamic_walls_.size() );
+	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
+	{
+		DynamicWall& wall= dynamic_walls_[w];
+		if( !wall.state_message_dirty )
+			continue;
+		wall.state_message_dirty= false;
+
+		Messages::WallPosition& message= walls_state_messages_[w];
+
+		message.wall_index= w;
+		PositionToMessagePosition( wall.vert_pos[0], message.vertices_xy[0] );
+		PositionToMessagePosition( wall.vert_pos[1], message.vertices_xy[1] );
+		message.z= CoordToMessageCoord( wall.z );
+		message.texture_id= wall.texture_id;
+	}
+
+	static_models_state_messages_.resize( static_models_.size() );
 	for( unsigned int m= 0u; m < static_models_.size(); m++ )
 	{
 		const StaticModel& model= static_models_[m];
+		Messages::StaticModelState& message= static_models_state_messages_[m];
 
-		model_message.static_model_index= m;
-		model_message.animation_frame= model.current_animation_frame;
-		model_message.animation_playing= model.animation_state == StaticModel::AnimationState::Animation;
-		model_message.model_id= model.model_id;
-		model_message.visible= !model.picked;
+		message.static_model_index= m;
+		message.animation_frame= model.current_animation_frame;
+		message.animation_playing= model.animation_state == StaticModel::AnimationState::Animation;
+		message.model_id= model.model_id;
+		message.visible= !model.picked;
 
-		PositionToMessagePosition( model.pos, model_message.xyz );
-		model_message.angle= AngleToMessageAngle( model.angle );
-
-		messages_sender.SendUnreliableMessage( model_message );
+		PositionToMessagePosition( model.pos, message.xyz );
+		message.angle= AngleToMessageAngle( model.angle );
 	}
 
-	for( const Item& item : items_ )
+	items_state_messages_.resize( items_.size() );
+	for( unsigned int i= 0u; i < items_.size(); i++ )
 	{
-		Messages::ItemState message;
-		message.item_index= &item - items_.data();
+		const Item& item= items_[i];
+		Messages::ItemState& message= items_state_messages_[i];
+
+		message.item_index= i;
 		message.z= CoordToMessageCoord( item.pos.z );
 		message.picked= item.picked_up || !item.enabled; // TODO - transfer enabled flag separately.
-
-		messages_sender.SendUnreliableMessage( message );
 	}
 
-	Messages::SpriteEffectBirth sprite_message;
-
-	for( const SpriteEffect& effect : sprite_effects_ )
+	monsters_state_messages_.clear();
+	for( const MonstersContainer::value_type& monster_value : monsters_ )
 	{
-		sprite_message.effect_id= effect.effect_id;
-		PositionToMessagePosition( effect.pos, sprite_message.xyz );
+		monsters_state_messages_.emplace_back();
+		Messages::MonsterState& message= monsters_state_messages_.back();
 
-		messages_sender.SendUnreliableMessage( sprite_message );
+		monster_value.second->BuildStateMessage( message );
+		message.monster_id= monster_value.first;
 	}
 
-	for( const MonstersContainer::value_type& monster_value : monsters_ )
-	{
-		Messages::MonsterState monster_message;
+	rockets_state_messages_.resize( rockets_.Size() );
+	for( unsigned int r= 0u; r < rockets_.Size(); r++ )
+		PrepareRocketStateMessage( rockets_.rockets[r], rockets_.positions[r], rockets_state_messages_[r] );
 
-		monster_value.second->BuildStateMessage( monster_message );
-		monster_message.monster_id= monster_value.first;
+	// Events are already in buffer. Add here updates of backpacks, which are sent like events.
+	MessagesBuffer& events= update_events_messages_;
 
-		messages_sender.SendUnreliableMessage( monster_message );
+	for( const auto& backpack_value : backpacks_ )
+	{
+		Messages::DynamicItemUpdate message;
+		message.item_id= backpack_value.first;
+		PositionToMessagePosition( backpack_value.second.pos, message.xyz );
+
+		events.AddUnreliableMessage( message );
 	}
+}
 
-	for( const Messages::MonsterBirth& message : monsters_birth_messages_ )
-		messages_sender.SendReliableMessage( message );
-	for( const Messages::MonsterDeath& message : monsters_death_messages_ )
-		messages_sender.SendReliableMessage( message );
+void Map::SendUpdateMessages(
+	MessagesSender& messages_sender,
+	UpdateMessagesBaseline& baseline,
+	const m_Vec3* const player_pos ) const
+{
+	// Each unchanged entity is resent once per this number of updates.
+	const unsigned int c_unchanged_entities_resend_period= 32u;
 
-	for( const Messages::RocketBirth& message : rockets_birth_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::RocketDeath& message : rockets_death_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+	// Monsters and rockets, which are far from player or invisible for him, are sent once per this number of updates.
+	const unsigned int c_irrelevant_entities_update_period= 4u;
+	const float c_full_rate_distance= 6.0f;
+	const float c_max_relevant_distance= 32.0f;
 
-	for( const Messages::DynamicItemBirth& message : dynamic_items_birth_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::DynamicItemDeath& message : dynamic_items_death_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+	baseline.update_number++;
 
-	for( const Messages::LightSourceBirth& message : light_sources_birth_messages_ )
-		messages_sender.SendReliableMessage( message );
-	for( const Messages::LightSourceDeath& message : light_sources_death_messages_ )
-		messages_sender.SendReliableMessage( message );
+	// Send events before states, because states may be related to entities, born in this tick.
+	messages_sender.SendMessages( update_events_messages_ );
 
-	for( const Messages::RotatingLightSourceBirth& message : rotating_light_sources_birth_messages_ )
-		messages_sender.SendReliableMessage( message );
-	for( const Messages::RotatingLightSourceDeath& message : rotating_light_sources_death_messages_ )
-		messages_sender.SendReliableMessage( message );
+	const auto need_send_moving_entity=
+	[&]( const Messages::CoordType* const message_pos, const EntityId id ) -> bool
+	{
+		if( player_pos == nullptr ||
+			( id + baseline.update_number ) % c_irrelevant_entities_update_period == 0u )
+			return true;
 
-	for( const Messages::ParticleEffectBirth& message : particles_effects_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::FullscreenBlendEffect& message : fullscreen_blend_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::MonsterPartBirth& message : monsters_parts_birth_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+		m_Vec3 pos;
+		MessagePositionToPosition( message_pos, pos );
 
-	for( const Messages::MapEventSound& message : map_events_sounds_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::MonsterLinkedSound& message : monster_linked_sounds_messages_ )
-		messages_sender.SendUnreliableMessage( message );
-	for( const Messages::MonsterSound& message : monsters_sounds_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+		const float square_distance= ( pos - *player_pos ).SquareLength();
+		if( square_distance <= c_full_rate_distance * c_full_rate_distance )
+			return true;
+		if( square_distance > c_max_relevant_distance * c_max_relevant_distance )
+			return false;
+		return CanSee( *player_pos, pos );
+	};
+
+	SendChangedMessages( messages_sender, walls_state_messages_, baseline.walls, baseline.update_number, c_unchanged_entities_resend_period );
+	SendChangedMessages( messages_sender, static_models_state_messages_, baseline.static_models, baseline.update_number, c_unchanged_entities_resend_period );
+	SendChangedMessages( messages_sender, items_state_messages_, baseline.items, baseline.update_number, c_unchanged_entities_resend_period );
 
-	for( const Rocket& rocket : rockets_ )
+	for( const Messages::MonsterState& message : monsters_state_messages_ )
 	{
-		Messages::RocketState rocket_message;
-		PrepareRocketStateMessage( rocket, rocket_message );
-		messages_sender.SendUnreliableMessage( rocket_message );
+		if( need_send_moving_entity( message.xyz, message.monster_id ) )
+			messages_sender.SendUnreliableMessage( message );
 	}
 
-	for( const auto& backpack_value : backpacks_ )
+	for( const Messages::RocketState& message : rockets_state_messages_ )
 	{
-		Messages::DynamicItemUpdate message;
-		message.item_id= backpack_value.first;
-		PositionToMessagePosition( backpack_value.second->pos, message.xyz );
-
-		messages_sender.SendUnreliableMessage( message );
+		if( need_send_moving_entity( message.xyz, message.rocket_id ) )
+			messages_sender.SendUnreliableMessage( message );
 	}
 }
 
 void Map::ClearUpdateEvents()
 {
-	sprite_effects_.clear();
-	monsters_birth_messages_.clear();
-	monsters_death_messages_.clear();
-	rockets_birth_messages_.clear();
-	rockets_death_messages_.clear();
-	dynamic_items_birth_messages_.clear();
-	dynamic_items_death_messages_.clear();
-	light_sources_birth_messages_.clear();
-	light_sources_death_messages_.clear();
-	rotating_light_sources_birth_messages_.clear();
-	rotating_light_sources_death_messages_.clear();
-	particles_effects_messages_.clear();
-	fullscreen_blend_messages_.clear();
-	monsters_parts_birth_messages_.clear();
-	map_events_sounds_messages_.clear();
-	monster_linked_sounds_messages_.clear();
-	monsters_sounds_messages_.clear();
+	update_events_messages_.Clear();
+	gibs_births_in_update_= 0u;
+	body_parts_births_in_update_= 0u;
 }
 
 void Map::ActivateProcedure( const unsigned int procedure_number, const Time current_time )
@@ -2136,6 +2179,37 @@ void Map::ActivateProcedure( const unsigned int procedure_number, const Time cur
 	procedure_state.movement_stage= 0.0f;
 	procedure_state.movement_state= ProcedureState::MovementState::StartWait;
 	procedure_state.last_state_change_time= current_time;
+
+	SetProcedureActive( procedure_number, true );
+}
+
+void Map::SetProcedureActive( const unsigned int procedure_number, const bool active )
+{
+	PC_ASSERT( procedure_number < procedures_.size() );
+
+	const uint64_t bit= uint64_t(1u) << ( procedure_number & 63u );
+	if( active )
+		active_procedures_[ procedure_number >> 6u ]|= bit;
+	else
+		active_procedures_[ procedure_number >> 6u ]&= ~bit;
+}
+
+unsigned int Map::GetNextActiveProcedure( const unsigned int start_procedure_number ) const
+{
+	unsigned int word= start_procedure_number >> 6u;
+	if( word >= active_procedures_.size() )
+		return procedures_.size();
+
+	uint64_t mask= active_procedures_[ word ] & ( ~uint64_t(0u) << ( start_procedure_number & 63u ) );
+	while( mask == 0u )
+	{
+		word++;
+		if( word >= active_procedures_.size() )
+			return procedures_.size();
+		mask= active_procedures_[ word ];
+	}
+
+	return word * 64u + CountTrailingZeros( mask );
 }
 
 void Map::TryActivateProcedure(
@@ -2373,11 +2447,15 @@ void Map::DoProcedureImmediateCommands( const MapData::Procedure& procedure, con
 					}
 
 					model.model_id= id - 163u;
+					UpdateModelInCollisionIndex( index_element.index );
+					InvalidateSeeCache();
 				}
 				else if( index_element.type == MapData::IndexElement::DynamicWall )
 				{
 					PC_ASSERT( index_element.index < dynamic_walls_.size() );
 					dynamic_walls_[ index_element.index ].texture_id= id;
+					dynamic_walls_[ index_element.index ].state_message_dirty= true;
+					InvalidateSeeCache();
 				}
 			}
 		}
@@ -2418,13 +2496,14 @@ void Map::DoProcedureImmediateCommands( const MapData::Procedure& procedure, con
 
 						model.linked_rotating_light.reset( light );
 
-						rotating_light_sources_birth_messages_.emplace_back();
-						Messages::RotatingLightSourceBirth& message= rotating_light_sources_birth_messages_.back();
+						Messages::RotatingLightSourceBirth message;
 
 						message.light_source_id= index_element.index;
 						PositionToMessagePosition( model.pos.xy(), message.xy );
 						message.brightness= static_cast<unsigned char>( light->brightness );
 						message.radius= CoordToMessageCoord( light->radius );
+
+						update_events_messages_.AddReliableMessage( message );
 					}
 				}
 			}
@@ -2451,9 +2530,9 @@ void Map::DoProcedureImmediateCommands( const MapData::Procedure& procedure, con
 			source.turn_on_time_ms= static_cast<unsigned short>(command.args[4]);
 
 			// Send light birth message.
-			light_sources_birth_messages_.emplace_back();
-			Messages::LightSourceBirth& message= light_sources_birth_messages_.back();
+			Messages::LightSourceBirth message;
 			PrepareLightSourceBirthMessage( source, id, message );
+			update_events_messages_.AddReliableMessage( message );
 		}
 		// TODO - process other commands
 		else
@@ -2493,8 +2572,9 @@ void Map::DeactivateProcedureLightSources( const MapData::Procedure& procedure )
 
 			// Remove light source om procedure deactivation, send death message.
 			light_sources_.erase(id);
-			light_sources_death_messages_.emplace_back();
-			light_sources_death_messages_.back().light_source_id= id;
+			Messages::LightSourceDeath message;
+			message.light_source_id= id;
+			update_events_messages_.AddReliableMessage( message );
 		}
 	}
 }
@@ -2627,17 +2707,17 @@ void Map::ProcessWind( const MapData::Procedure::ActionCommand& command, bool ac
 	const int dir_x= static_cast<int>( command.args[4] );
 	const int dir_y= static_cast<int>( command.args[5] );
 
+	WindFieldCell cell;
+	cell.dir[0]= static_cast<signed char>( dir_x );
+	cell.dir[1]= static_cast<signed char>( dir_y );
+
 	for( unsigned int y= y0; y <= y1 && y < MapData::c_map_size; y++ )
 	for( unsigned int x= x0; x <= x1 && x < MapData::c_map_size; x++ )
 	{
-		char* const cell= wind_field_[ x + y * MapData::c_map_size ];
-		if( activate )
-		{
-			cell[0]= dir_x;
-			cell[1]= dir_y;
-		}
+		if( activate && ( dir_x != 0 || dir_y != 0 ) )
+			wind_field_.Set( x, y, cell );
 		else
-			cell[0]= cell[1]= 0;
+			wind_field_.Reset( x, y );
 	}
 }
 
@@ -2653,18 +2733,19 @@ void Map::ProcessDeathZone( const MapData::Procedure::ActionCommand& command, co
 	const int z_1= static_cast<int>( command.args[5] );
 	const unsigned char damage= static_cast<unsigned char>( command.args[6] );
 
+	DamageFiledCell cell;
+	cell.damage= damage;
+	cell.z_bottom= std::max( std::min( z_0, 127 ), -128 );
+	cell.z_top   = std::max( std::min( z_1, 127 ), -128 );
+
 	for( unsigned int y= y0; y <= y1 && y < MapData::c_map_size; y++ )
 	for( unsigned int x= x0; x <= x1 && x < MapData::c_map_size; x++ )
 	{
-		DamageFiledCell& cell= death_field_[ x + y * MapData::c_map_size ];
-		if( activate )
-		{
-			cell.damage= damage;
-			cell.z_bottom= std::max( std::min( z_0, 127 ), -128 );
-			cell.z_top   = std::max( std::min( z_1, 127 ), -128 );
-		}
+		// Cells without damage are not stored.
+		if( activate && damage > 0u )
+			death_field_.Set( x, y, cell );
 		else
-			cell.damage= 0u;
+			death_field_.Reset( x, y );
 	}
 }
 
@@ -2676,6 +2757,8 @@ void Map::DestroyModel( const unsigned int model_index )
 	EmitModelDestructionEffects( model_index );
 
 	model.model_id++; // now, this model has other model type
+	UpdateModelInCollisionIndex( model_index );
+	InvalidateSeeCache();
 
 	// Reset animation. Animation must be consistent with model.
 	model.animation_start_frame= 0u;
@@ -2701,32 +2784,33 @@ void Map::DoExplosionDamage(
 		return std::round( float(base_damage) * ( 1.0f - distance / explosion_radius ) );
 	};
 
-	for( MonstersContainer::value_type& monster_value : monsters_ )
-	{
-		MonsterBase& monster= *monster_value.second;
-		const float monster_radius=
-			monster.MonsterId() == 0u
-			? GameConstants::player_radius
-			: game_resources_->monsters_description[ monster.MonsterId() ].w_radius;
+	monsters_index_.ProcessMonstersInRadius(
+		explosion_center.xy(), explosion_radius,
+		[&]( const EntityId monster_id, MonsterBase& monster )
+		{
+			const float monster_radius=
+				monster.MonsterId() == 0u
+				? GameConstants::player_radius
+				: game_resources_->monsters_description[ monster.MonsterId() ].w_radius;
 
-		const m_Vec2 monster_z_minmax= monster.GetZMinMax();
+			const m_Vec2 monster_z_minmax= monster.GetZMinMax();
 
-		const float distance=
-			DistanceToCylinder(
-				monster.Position().xy(), monster_radius,
-				monster.Position().z + monster_z_minmax.x, monster.Position().z + monster_z_minmax.y,
-				explosion_center );
+			const float distance=
+				DistanceToCylinder(
+					monster.Position().xy(), monster_radius,
+					monster.Position().z + monster_z_minmax.x, monster.Position().z + monster_z_minmax.y,
+					explosion_center );
 
-		if( distance > explosion_radius )
-			continue;
+			if( distance > explosion_radius )
+				return;
 
-		const int damage= distance_to_damage(distance);
-		if( damage > 0 )
-			monster.Hit(
-				damage, ( monster.Position().xy() - explosion_center.xy() ), explosion_owner_monster_id,
-				*this,
-				monster_value.first, current_time );
-	}
+			const int damage= distance_to_damage(distance);
+			if( damage > 0 )
+				monster.Hit(
+					damage, ( monster.Position().xy() - explosion_center.xy() ), explosion_owner_monster_id,
+					*this,
+					monster_id, current_time );
+		} );
 
 	for( StaticModel& model : static_models_ )
 	{
@@ -2782,21 +2866,17 @@ void Map::TryWarnMonsters( const m_Vec3& pos, const Time current_time )
 
 void Map::MoveMapObjects( const Time current_time )
 {
-	// Zero objects transformations. Set mortal flag to false.
-	for( DynamicWall& wall : dynamic_walls_ )
-	{
-		wall.transformation.Clear();
-		wall.vert_move_speed[0]= wall.vert_move_speed[1]= m_Vec2( 0.0f, 0.0f );
-		wall.mortal= false;
-	}
-
-	for( StaticModel& model : static_models_ )
-	{
-		model.transformation.Clear();
-		model.transformation_angle_delta= 0.0f;
-		model.move_speed= m_Vec2( 0.0f, 0.0f );
-		model.mortal= false;
-	}
+	// Only objects, linked to active procedures, have non-identity transformations.
+	// Objects, moved in previous tick, are reset here. If they are not linked to active procedures now, they are returned into initial positions.
+	previous_moving_walls_.swap( moving_walls_ );
+	moving_walls_.clear();
+	for( const unsigned int w : previous_moving_walls_ )
+		ResetWallTransformation( dynamic_walls_[w] );
+
+	previous_moving_models_.swap( moving_models_ );
+	moving_models_.clear();
+	for( const unsigned int m : previous_moving_models_ )
+		ResetModelTransformation( static_models_[m] );
 
 	/* Accumulate transformations from procedures on objects.
 	 * Several transformations can be applied for one object.
@@ -2804,7 +2884,8 @@ void Map::MoveMapObjects( const Time current_time )
 	 * Examples of "bad" transformations combination:
 	 * Rotate + Move, Rotate + Rotate with different center, etc.
 	 */
-	for( unsigned int p= 0u; p < procedures_.size(); p++ )
+	// Idle procedures have zero stage. Transformations for them are identity, so, skip them.
+	for( unsigned int p= GetNextActiveProcedure( 0u ); p < procedures_.size(); p= GetNextActiveProcedure( p + 1u ) )
 	{
 		const MapData::Procedure& procedure= map_data_->procedures[p];
 		const ProcedureState& procedure_state= procedures_[p];
@@ -2900,7 +2981,7 @@ void Map::MoveMapObjects( const Time current_time )
 				if( index_element.type == MapData::IndexElement::DynamicWall )
 				{
 					PC_ASSERT( index_element.index < map_data_->dynamic_walls.size() );
-					DynamicWall& wall= dynamic_walls_[ index_element.index ];
+					DynamicWall& wall= GetMovingWall( index_element.index );
 					wall.transformation.mat= wall.transformation.mat * mat;
 					wall.vert_move_speed[0]+= move_dir;
 					wall.vert_move_speed[1]+= move_dir;
@@ -2909,7 +2990,7 @@ void Map::MoveMapObjects( const Time current_time )
 				else if( index_element.type == MapData::IndexElement::StaticModel )
 				{
 					PC_ASSERT( index_element.index < static_models_.size() );
-					StaticModel& model= static_models_[ index_element.index ];
+					StaticModel& model= GetMovingModel( index_element.index );
 					model.transformation.mat= model.transformation.mat * mat;
 					model.move_speed+= move_dir;
 					if( mortal ) model.mortal= true;
@@ -2942,7 +3023,7 @@ void Map::MoveMapObjects( const Time current_time )
 				if( index_element.type == MapData::IndexElement::DynamicWall )
 				{
 					PC_ASSERT( index_element.index < map_data_->dynamic_walls.size() );
-					DynamicWall& wall= dynamic_walls_[ index_element.index ];
+					DynamicWall& wall= GetMovingWall( index_element.index );
 					wall.transformation.mat= wall.transformation.mat * mat;
 					if( mortal ) wall.mortal= true;
 
@@ -2959,7 +3040,7 @@ void Map::MoveMapObjects( const Time current_time )
 				else if( index_element.type == MapData::IndexElement::StaticModel )
 				{
 					PC_ASSERT( index_element.index < static_models_.size() );
-					StaticModel& model= static_models_[ index_element.index ];
+					StaticModel& model= GetMovingModel( index_element.index );
 					model.transformation.mat= model.transformation.mat * mat;
 					model.transformation_angle_delta+= angle_delta;
 					if( mortal ) model.mortal= true;
@@ -2983,13 +3064,13 @@ void Map::MoveMapObjects( const Time current_time )
 				if( index_element.type == MapData::IndexElement::DynamicWall )
 				{
 					PC_ASSERT( index_element.index < map_data_->dynamic_walls.size() );
-					DynamicWall& wall= dynamic_walls_[ index_element.index ];
+					DynamicWall& wall= GetMovingWall( index_element.index );
 					wall.transformation.d_z+= dz;
 				}
 				else if( index_element.type == MapData::IndexElement::StaticModel )
 				{
 					PC_ASSERT( index_element.index < static_models_.size() );
-					StaticModel& model= static_models_[ index_element.index ];
+					StaticModel& model= GetMovingModel( index_element.index );
 					model.transformation.d_z+= dz;
 				}
 			}
@@ -3003,10 +3084,11 @@ void Map::MoveMapObjects( const Time current_time )
 	} // for procedures
 
 	// Rotating lights effect models. Models rotating together with their lights.
-	for( StaticModel& model : static_models_ )
+	for( unsigned int m= 0u; m < static_models_.size(); m++ )
 	{
-		if( model.linked_rotating_light != nullptr )
+		if( static_models_[m].linked_rotating_light != nullptr )
 		{
+			StaticModel& model= GetMovingModel( m );
 			const float c_speed= Constants::two_pi; // TODO - check speeed. Maybe it depends on light source parameters.
 			const float angle_delta= c_speed * ( current_time - model.linked_rotating_light->start_time ).ToSeconds();
 			model.transformation_angle_delta+= angle_delta;
@@ -3014,29 +3096,255 @@ void Map::MoveMapObjects( const Time current_time )
 	}
 
 	// Apply objects transformations.
-	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
+	// Objects, which stopped in this tick, are still in previous lists, so, apply their identity transformations too.
+	bool objects_moved= false;
+	for( const unsigned int w : moving_walls_ )
+		objects_moved|= ApplyWallTransformation( w );
+	for( const unsigned int w : previous_moving_walls_ )
+	{
+		if( !dynamic_walls_[w].moving )
+			objects_moved|= ApplyWallTransformation( w );
+	}
+
+	for( const unsigned int m : moving_models_ )
+		objects_moved|= ApplyModelTransformation( m );
+	for( const unsigned int m : previous_moving_models_ )
 	{
-		const MapData::Wall& map_wall= map_data_->dynamic_walls[ w ];
-		DynamicWall& wall= dynamic_walls_[ w ];
+		if( !static_models_[m].moving )
+			objects_moved|= ApplyModelTransformation( m );
+	}
 
-		for( unsigned int j= 0u; j < 2u; j++ )
-			wall.vert_pos[j]= map_wall.vert_pos[j] * wall.transformation.mat;
+	if( objects_moved )
+		InvalidateSeeCache();
+}
+
+Map::DynamicWall& Map::GetMovingWall( const unsigned int wall_index )
+{
+	PC_ASSERT( wall_index < dynamic_walls_.size() );
+	DynamicWall& wall= dynamic_walls_[ wall_index ];
+	if( !wall.moving )
+	{
+		ResetWallTransformation( wall );
+		wall.moving= true;
+		moving_walls_.push_back( wall_index );
+	}
+	return wall;
+}
+
+Map::StaticModel& Map::GetMovingModel( const unsigned int model_index )
+{
+	PC_ASSERT( model_index < static_models_.size() );
+	StaticModel& model= static_models_[ model_index ];
+	if( !model.moving )
+	{
+		ResetModelTransformation( model );
+		model.moving= true;
+		moving_models_.push_back( model_index );
+	}
+	return model;
+}
+
+void Map::ResetWallTransformation( DynamicWall& wall )
+{
+	wall.transformation.Clear();
+	wall.vert_move_speed[0]= wall.vert_move_speed[1]= m_Vec2( 0.0f, 0.0f );
+	wall.mortal= false;
+	wall.moving= false;
+}
+
+void Map::ResetModelTransformation( StaticModel& model )
+{
+	model.transformation.Clear();
+	model.transformation_angle_delta= 0.0f;
+	model.move_speed= m_Vec2( 0.0f, 0.0f );
+	model.mortal= false;
+	model.moving= false;
+}
+
+bool Map::ApplyWallTransformation( const unsigned int wall_index )
+{
+	const MapData::Wall& map_wall= map_data_->dynamic_walls[ wall_index ];
+	DynamicWall& wall= dynamic_walls_[ wall_index ];
+
+	bool moved= false;
+	for( unsigned int j= 0u; j < 2u; j++ )
+	{
+		const m_Vec2 new_pos= map_wall.vert_pos[j] * wall.transformation.mat;
+		if( !( new_pos == wall.vert_pos[j] ) )
+			moved= true;
+		wall.vert_pos[j]= new_pos;
+	}
+
+	if( wall.z != wall.transformation.d_z )
+		moved= true;
+	wall.z= wall.transformation.d_z;
+
+	if( moved )
+	{
+		wall.state_message_dirty= true;
+		collision_index_.UpdateDynamicWall( wall_index, wall.vert_pos[0], wall.vert_pos[1] );
+	}
+	return moved;
+}
+
+bool Map::ApplyModelTransformation( const unsigned int model_index )
+{
+	const MapData::StaticModel& map_model= map_data_->static_models[ model_index ];
+	StaticModel& model= static_models_[ model_index ];
+
+	const m_Vec2 xy= map_model.pos * model.transformation.mat;
+	const float z= model.baze_z + model.transformation.d_z;
+	const bool moved= xy.x != model.pos.x || xy.y != model.pos.y || z != model.pos.z;
+
+	model.pos.x= xy.x;
+	model.pos.y= xy.y;
+	model.pos.z= z;
+
+	model.angle= map_model.angle + model.transformation_angle_delta;
+
+	if( moved )
+		UpdateModelInCollisionIndex( model_index );
+	return moved;
+}
+
+void Map::MoveRockets( const Time current_time, const float last_tick_delta_s )
+{
+	for( unsigned int r= 0u; r < rockets_.Size(); r++ )
+	{
+		Rocket& rocket= rockets_.rockets[r];
+		const m_Vec3& position= rockets_.positions[r];
+		m_Vec3& velocity= rockets_.velocities[r];
+		m_Vec3& new_pos= rockets_.new_positions[r];
+
+		const GameResources::RocketDescription& rocket_description= game_resources_->rockets_description[ rocket.rocket_type_id ];
+		if( rocket.HasInfiniteSpeed( *game_resources_ ) )
+		{
+			new_pos= position;
+			continue;
+		}
+
+		const float gravity_force= GameConstants::rockets_gravity_scale * float( rocket_description.gravity_force );
+		const float speed= rocket_description.fast ? GameConstants::fast_rockets_speed : GameConstants::rockets_speed;
+
+		if( rocket_description.reflect )
+		{
+			velocity.z-= gravity_force * last_tick_delta_s;
+			new_pos= position + velocity * last_tick_delta_s;
+
+			if( new_pos.z < 0.0f ) // Reflect.
+			{
+				new_pos.z= 0.0f;
+				velocity.z= std::abs( velocity.z );
+			}
+
+			rocket.normalized_direction= velocity;
+			rocket.normalized_direction.Normalize();
+		}
+		else if( rocket_description.Auto2 )
+		{
+			m_Vec3 target_pos;
+			if( FindNearestPlayerPos( position, target_pos ) )
+			{
+				m_Vec3 dir_to_target= target_pos - position;
+				dir_to_target.Normalize();
+
+				m_Vec3 rot_axis= mVec3Cross( rocket.normalized_direction, dir_to_target );
+				const float rot_axis_square_length= rot_axis.SquareLength();
+				if( rot_axis_square_length < 0.001f * 0.001f )
+					rot_axis= m_Vec3( 0.0f, 0.0f, 1.0f );
+
+				const float c_rot_speed= Constants::half_pi;
+				m_Mat4 mat;
+				mat.Rotate( rot_axis, last_tick_delta_s * c_rot_speed );
+
+				rocket.normalized_direction= rocket.normalized_direction * mat;
+				rocket.normalized_direction.Normalize();
+			}
 
-		wall.z= wall.transformation.d_z;
+			new_pos= position + rocket.normalized_direction * speed * last_tick_delta_s;
+		}
+		else
+		{
+			const float time_delta_s= ( current_time - rocket.start_time ).ToSeconds();
+			new_pos=
+				rocket.start_point +
+				rocket.normalized_direction * ( time_delta_s * speed ) +
+				m_Vec3( 0.0f, 0.0f, -1.0f ) * ( gravity_force * time_delta_s * time_delta_s * 0.5f );
+		}
 	}
+}
+
+void Map::UpdateDynamicElementsInCollisionIndex()
+{
+	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
+		collision_index_.UpdateDynamicWall( w, dynamic_walls_[w].vert_pos[0], dynamic_walls_[w].vert_pos[1] );
 
 	for( unsigned int m= 0u; m < static_models_.size(); m++ )
+		UpdateModelInCollisionIndex( m );
+}
+
+void Map::InvalidateSeeCache()
+{
+	see_cache_.clear();
+}
+
+void Map::RemoveExpiredSeeCacheEntries()
+{
+	for( auto it= see_cache_.begin(); it != see_cache_.end(); )
 	{
-		const MapData::StaticModel& map_model= map_data_->static_models[ m ];
-		StaticModel& model= static_models_[ m ];
+		if( it->second.expiration_tick <= see_cache_tick_ )
+			it= see_cache_.erase( it );
+		else
+			++it;
+	}
+}
 
-		const m_Vec2 xy= map_model.pos * model.transformation.mat;
-		model.pos.x= xy.x;
-		model.pos.y= xy.y;
-		model.pos.z= model.baze_z + model.transformation.d_z;
+const NavigationGrid::FlowField& Map::GetNavigationFlowField( const unsigned int target_cell ) const
+{
+	NavigationFlowField* least_recently_used= nullptr;
+	for( NavigationFlowField& flow_field : navigation_flow_fields_ )
+	{
+		if( flow_field.field.target_cell == target_cell )
+		{
+			flow_field.last_use_tick= navigation_tick_;
+			return flow_field.field;
+		}
+		if( least_recently_used == nullptr || flow_field.last_use_tick < least_recently_used->last_use_tick )
+			least_recently_used= &flow_field;
+	}
 
-		model.angle= map_model.angle + model.transformation_angle_delta;
+	if( navigation_flow_fields_.size() < g_max_navigation_flow_fields )
+	{
+		navigation_flow_fields_.emplace_back();
+		least_recently_used= &navigation_flow_fields_.back();
 	}
+
+	least_recently_used->last_use_tick= navigation_tick_;
+	navigation_grid_.BuildFlowField( target_cell, least_recently_used->field );
+	return least_recently_used->field;
+}
+
+void Map::UpdateModelInCollisionIndex( const unsigned int model_index )
+{
+	PC_ASSERT( model_index < static_models_.size() );
+	const StaticModel& model= static_models_[ model_index ];
+
+	const float radius=
+		model.model_id < map_data_->models_description.size()
+			? map_data_->models_description[ model.model_id ].radius
+			: 0.0f;
+
+	collision_index_.UpdateDynamicModel( model_index, model.pos.xy(), radius );
+}
+
+bool Map::TraceShot( const m_Vec3& from, const m_Vec3& normalized_direction, const float max_distance, m_Vec3& out_hit_pos ) const
+{
+	const HitResult hit_result= ProcessShot( from, normalized_direction, max_distance, 0u );
+	if( hit_result.object_type == HitResult::ObjectType::None )
+		return false;
+
+	out_hit_pos= hit_result.pos;
+	return true;
 }
 
 Map::HitResult Map::ProcessShot(
@@ -3046,146 +3354,342 @@ Map::HitResult Map::ProcessShot(
 	const EntityId skip_monster_id ) const
 {
 	HitResult result;
-	float nearest_shot_point_square_distance= max_distance * max_distance;
+	ProcessShots( shot_start_point, &shot_direction_normalized, 1u, max_distance, skip_monster_id, &result );
+	return result;
+}
+
+void Map::ProcessShots(
+	const m_Vec3& shot_start_point,
+	const m_Vec3* const shots_directions_normalized,
+	const unsigned int shot_count,
+	const float max_distance,
+	const EntityId skip_monster_id,
+	HitResult* const out_results,
+	const ShotLagCompensation* const lag_compensation ) const
+{
+	PC_ASSERT( shot_count <= c_max_shots_in_bundle );
+
+	float nearest_shot_point_square_distance[ c_max_shots_in_bundle ];
+	for( unsigned int s= 0u; s < shot_count; s++ )
+	{
+		out_results[s]= HitResult();
+		nearest_shot_point_square_distance[s]= max_distance * max_distance;
+	}
 
 	const auto process_candidate_shot_pos=
-	[&]( const m_Vec3& candidate_pos, const HitResult::ObjectType object_type, const unsigned int object_index )
+	[&]( const unsigned int shot, const m_Vec3& candidate_pos, const HitResult::ObjectType object_type, const unsigned int object_index )
 	{
 		const float square_distance= ( candidate_pos - shot_start_point ).SquareLength();
-		if( square_distance < nearest_shot_point_square_distance )
+		if( square_distance < nearest_shot_point_square_distance[shot] )
 		{
+			HitResult& result= out_results[shot];
 			result.pos= candidate_pos;
-			nearest_shot_point_square_distance= square_distance;
+			nearest_shot_point_square_distance[shot]= square_distance;
 
 			result.object_type= object_type;
 			result.object_index= object_index;
 		}
 	};
 
-	const auto func=
-	[&]( const MapData::IndexElement& element ) -> bool
+	for( unsigned int s= 0u; s < shot_count; s++ )
 	{
-		if( element.type == MapData::IndexElement::StaticWall )
-		{
-			PC_ASSERT( element.index < map_data_->static_walls.size() );
-			const MapData::Wall& wall= map_data_->static_walls[ element.index ];
-
-			const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
-			if( wall_texture.gso[1] )
-				return false;
+		float static_wall_distance;
+		unsigned int static_wall_index;
+		if( collision_index_.RayCastStaticWalls(
+				shot_start_point, shots_directions_normalized[s], max_distance,
+				static_wall_distance, static_wall_index ) )
+			process_candidate_shot_pos(
+				s,
+				shot_start_point + shots_directions_normalized[s] * static_wall_distance,
+				HitResult::ObjectType::StaticWall, static_wall_index );
+	}
 
-			m_Vec3 candidate_pos;
-			if( RayIntersectWall(
-					wall.vert_pos[0], wall.vert_pos[1],
-					0.0f, 2.0f,
-					shot_start_point, shot_direction_normalized,
-					candidate_pos ) )
-			{
-				process_candidate_shot_pos( candidate_pos, HitResult::ObjectType::StaticWall, &wall - map_data_->static_walls.data() );
-			}
-		}
-		else if( element.type == MapData::IndexElement::StaticModel )
+	const auto func=
+	[&]( const MapData::IndexElement& element )
+	{
+		if( element.type == MapData::IndexElement::StaticModel )
 		{
 			PC_ASSERT( element.index < static_models_.size() );
 			const StaticModel& model= static_models_[ element.index ];
 
 			if( model.model_id >= map_data_->models_description.size() )
-				return false;
+				return;
 
 			const MapData::ModelDescription& model_description= map_data_->models_description[ model.model_id ];
 			if( model_description.radius <= 0.0f )
-				return false;
+				return;
 
 			const Model& model_data= map_data_->models[ model.model_id ];
 
-			m_Vec3 candidate_pos;
-			if( RayIntersectCylinder(
-					model.pos.xy(), model_description.radius,
-					model_data.z_min + model.pos.z,
-					model_data.z_max + model.pos.z,
-					shot_start_point, shot_direction_normalized,
-					candidate_pos ) )
+			for( unsigned int s= 0u; s < shot_count; s++ )
+			{
+				m_Vec3 candidate_pos;
+				if( RayIntersectCylinder(
+						model.pos.xy(), model_description.radius,
+						model_data.z_min + model.pos.z,
+						model_data.z_max + model.pos.z,
+						shot_start_point, shots_directions_normalized[s],
+						candidate_pos ) )
+				{
+					process_candidate_shot_pos( s, candidate_pos, HitResult::ObjectType::Model, element.index );
+				}
+			}
+		}
+		else if( element.type == MapData::IndexElement::DynamicWall )
+		{
+			PC_ASSERT( element.index < dynamic_walls_.size() );
+			const DynamicWall& wall= dynamic_walls_[ element.index ];
+
+			const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
+			if( wall_texture.gso[1] )
+				return;
+
+			for( unsigned int s= 0u; s < shot_count; s++ )
 			{
-				process_candidate_shot_pos( candidate_pos, HitResult::ObjectType::Model, &model - static_models_.data() );
+				m_Vec3 candidate_pos;
+				if( RayIntersectWall(
+						wall.vert_pos[0], wall.vert_pos[1],
+						wall.z, wall.z + 2.0f,
+						shot_start_point, shots_directions_normalized[s],
+						candidate_pos ) )
+				{
+					process_candidate_shot_pos( s, candidate_pos, HitResult::ObjectType::DynamicWall, element.index );
+				}
 			}
 		}
 		else
 		{
 			// TODO
 		}
+	};
 
-		// TODO - return true, sometimes.
-		return false;
+	// Objects behind nearest hit point can not be hit.
+	const auto get_cast_distance=
+	[&]( const unsigned int shot ) -> float
+	{
+		if( nearest_shot_point_square_distance[shot] < max_distance * max_distance )
+			return std::sqrt( nearest_shot_point_square_distance[shot] );
+		return max_distance;
 	};
 
-	collision_index_.RayCast(
-		shot_start_point, shot_direction_normalized,
-		func,
-		max_distance );
+	float cast_distances[ c_max_shots_in_bundle ];
+	for( unsigned int s= 0u; s < shot_count; s++ )
+		cast_distances[s]= get_cast_distance(s);
 
-	// Dynamic walls
-	for( const DynamicWall& wall : dynamic_walls_ )
+	collision_index_.RayCastBundle(
+		shot_start_point, shots_directions_normalized, cast_distances, shot_count,
+		func );
+
+	for( unsigned int s= 0u; s < shot_count; s++ )
 	{
-		const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
-		if( wall_texture.gso[1] )
-			continue;
+		const m_Vec3& shot_direction_normalized= shots_directions_normalized[s];
 
-		m_Vec3 candidate_pos;
-		if( RayIntersectWall(
-				wall.vert_pos[0], wall.vert_pos[1],
-				wall.z, wall.z + 2.0f,
-				shot_start_point, shot_direction_normalized,
-				candidate_pos ) )
+		// Monsters
+		monsters_index_.RayCast(
+			shot_start_point, shot_direction_normalized,
+			[&]( const EntityId monster_id, const MonsterBase& monster )
+			{
+				if( monster_id == skip_monster_id )
+					return;
+
+				const m_Vec3 monster_pos=
+					lag_compensation == nullptr
+						? monster.Position()
+						: GetLagCompensatedPosition( monster, *lag_compensation );
+
+				m_Vec3 candidate_pos;
+				if( monster.TryShotAt(
+						monster_pos,
+						shot_start_point, shot_direction_normalized,
+						candidate_pos ) )
+				{
+					process_candidate_shot_pos(
+						s, candidate_pos, HitResult::ObjectType::Monster,
+						monster_id );
+				}
+			},
+			get_cast_distance(s),
+			lag_compensation == nullptr ? 0.0f : lag_compensation->max_displacement );
+
+		// Floors, ceilings
+		for( unsigned int z= 0u; z <= 2u; z+= 2u )
 		{
-			process_candidate_shot_pos( candidate_pos, HitResult::ObjectType::DynamicWall, &wall - dynamic_walls_.data() );
+			m_Vec3 candidate_pos;
+			if( RayIntersectXYPlane(
+					float(z),
+					shot_start_point, shot_direction_normalized,
+					candidate_pos ) )
+			{
+				const int x= static_cast<int>( std::floor(candidate_pos.x) );
+				const int y= static_cast<int>( std::floor(candidate_pos.y) );
+				if( x < 0 || x >= int(MapData::c_map_size) ||
+					y < 0 || y >= int(MapData::c_map_size) )
+					continue;
+
+				const int coord= x + y * int(MapData::c_map_size);
+				const unsigned char texture_id=
+					( z == 0 ? map_data_->floor_textures : map_data_->ceiling_textures )[ coord ];
+
+				if( texture_id == MapData::c_empty_floor_texture_id ||
+					texture_id == MapData::c_sky_floor_texture_id )
+					continue;
+
+				process_candidate_shot_pos( s, candidate_pos, HitResult::ObjectType::Floor, z >> 1u );
+			}
 		}
-	}
+	} // for shots
+}
 
-	// Monsters
-	for( const MonstersContainer::value_type& monster_value : monsters_ )
+void Map::PrepareInstantShotsResults()
+{
+	instant_shots_results_.clear();
+
+	m_Vec3 shots_directions[ c_max_shots_in_bundle ];
+	HitResult shots_results[ c_max_shots_in_bundle ];
+
+	// Pellets of one shot are added together, so, they are neighbors in rockets list.
+	for( unsigned int r= 0u; r < rockets_.Size(); )
 	{
-		if( monster_value.first == skip_monster_id )
+		const Rocket& first_rocket= rockets_.rockets[r];
+		if( !first_rocket.HasInfiniteSpeed( *game_resources_ ) )
+		{
+			r++;
 			continue;
+		}
 
-		m_Vec3 candidate_pos;
-		if( monster_value.second->TryShot(
-				shot_start_point, shot_direction_normalized,
-				candidate_pos ) )
+		unsigned int shot_count= 0u;
+		while(
+			shot_count < c_max_shots_in_bundle && r + shot_count < rockets_.Size() &&
+			rockets_.rockets[ r + shot_count ].start_point == first_rocket.start_point &&
+			rockets_.rockets[ r + shot_count ].owner_id == first_rocket.owner_id &&
+			rockets_.rockets[ r + shot_count ].HasInfiniteSpeed( *game_resources_ ) )
 		{
-			process_candidate_shot_pos(
-				candidate_pos, HitResult::ObjectType::Monster,
-				monster_value.first );
+			shots_directions[ shot_count ]= rockets_.rockets[ r + shot_count ].normalized_direction;
+			shot_count++;
+		}
+
+		ShotLagCompensation lag_compensation;
+		const bool have_lag_compensation= GetShotLagCompensation( first_rocket.owner_id, lag_compensation );
+
+		ProcessShots(
+			first_rocket.start_point, shots_directions, shot_count,
+			Constants::max_float, first_rocket.owner_id,
+			shots_results,
+			have_lag_compensation ? &lag_compensation : nullptr );
+
+		for( unsigned int s= 0u; s < shot_count; s++ )
+		{
+			instant_shots_results_.emplace_back();
+			instant_shots_results_.back().rocket_id= rockets_.rockets[ r + s ].rocket_id;
+			instant_shots_results_.back().hit_result= shots_results[s];
 		}
+
+		r+= shot_count;
 	}
 
-	// Floors, ceilings
-	for( unsigned int z= 0u; z <= 2u; z+= 2u )
-	{
-		m_Vec3 candidate_pos;
-		if( RayIntersectXYPlane(
-				float(z),
-				shot_start_point, shot_direction_normalized,
-				candidate_pos ) )
+	std::sort(
+		instant_shots_results_.begin(), instant_shots_results_.end(),
+		[]( const InstantShotResult& a, const InstantShotResult& b )
 		{
-			const int x= static_cast<int>( std::floor(candidate_pos.x) );
-			const int y= static_cast<int>( std::floor(candidate_pos.y) );
-			if( x < 0 || x >= int(MapData::c_map_size) ||
-				y < 0 || y >= int(MapData::c_map_size) )
-				continue;
+			return a.rocket_id < b.rocket_id;
+		} );
 
-			const int coord= x + y * int(MapData::c_map_size);
-			const unsigned char texture_id=
-				( z == 0 ? map_data_->floor_textures : map_data_->ceiling_textures )[ coord ];
+	instant_shots_results_valid_= true;
+}
 
-			if( texture_id == MapData::c_empty_floor_texture_id ||
-				texture_id == MapData::c_sky_floor_texture_id )
-				continue;
+void Map::RecordMonstersPositionHistory( const Time current_time )
+{
+	position_history_tick_++;
+	position_history_times_[ position_history_tick_ % MonsterBase::c_position_history_size ]= current_time.GetInternalRepresentation();
+	position_history_tick_count_= std::min( position_history_tick_count_ + 1u, MonsterBase::c_position_history_size );
+
+	for( const MonstersContainer::value_type& monster_value : monsters_ )
+		monster_value.second->RecordPositionHistory( position_history_tick_ );
+}
+
+bool Map::GetShotLagCompensation( const EntityId shooter_id, ShotLagCompensation& out_lag_compensation ) const
+{
+	const auto it= players_.find( shooter_id );
+	if( it == players_.end() || position_history_tick_count_ < 2u )
+		return false;
+
+	unsigned int view_time_ms;
+	if( !it->second->GetViewServerTimeMs( view_time_ms ) )
+		return false;
+
+	// Server time in messages is same, as map time, so, calculate lag in milliseconds with same wraparound.
+	const int64_t units_in_second= Time::FromSeconds(1).GetInternalRepresentation();
+	const int64_t current_time= position_history_times_[ position_history_tick_ % MonsterBase::c_position_history_size ];
+	const unsigned int current_time_ms= static_cast<unsigned int>( current_time * 1000 / units_in_second );
+
+	const int lag_ms= std::min( static_cast<int>( current_time_ms - view_time_ms ), g_max_lag_compensation_ms );
+	if( lag_ms <= 0 )
+		return false;
+
+	const int64_t view_time= current_time - int64_t(lag_ms) * units_in_second / 1000;
 
-			process_candidate_shot_pos( candidate_pos, HitResult::ObjectType::Floor, z >> 1u );
+	// Find newest tick, not after view time. If view time is older, than history, take oldest tick.
+	unsigned int tick= position_history_tick_ - ( position_history_tick_count_ - 1u );
+	for( unsigned int i= 1u; i < position_history_tick_count_; i++ )
+	{
+		if( position_history_times_[ ( position_history_tick_ - i ) % MonsterBase::c_position_history_size ] <= view_time )
+		{
+			tick= position_history_tick_ - i;
+			break;
 		}
 	}
 
-	return result;
+	const int64_t tick_time= position_history_times_[ tick % MonsterBase::c_position_history_size ];
+	const int64_t next_tick_time= position_history_times_[ ( tick + 1u ) % MonsterBase::c_position_history_size ];
+
+	out_lag_compensation.tick= tick;
+	out_lag_compensation.lerp=
+		next_tick_time > tick_time
+			? std::max( 0.0f, std::min( float( view_time - tick_time ) / float( next_tick_time - tick_time ), 1.0f ) )
+			: 0.0f;
+
+	// Monsters index contains current positions. Cast near ray must be extended by displacement of rewound monsters.
+	out_lag_compensation.max_displacement= 0.0f;
+	for( const MonstersContainer::value_type& monster_value : monsters_ )
+	{
+		const MonsterBase& monster= *monster_value.second;
+		const float displacement= ( GetLagCompensatedPosition( monster, out_lag_compensation ).xy() - monster.Position().xy() ).Length();
+		out_lag_compensation.max_displacement= std::max( out_lag_compensation.max_displacement, displacement );
+	}
+
+	return true;
+}
+
+m_Vec3 Map::GetLagCompensatedPosition( const MonsterBase& monster, const ShotLagCompensation& lag_compensation ) const
+{
+	m_Vec3 pos, next_pos;
+	const bool have_pos= monster.GetHistoryPosition( lag_compensation.tick, pos );
+	const bool have_next_pos= monster.GetHistoryPosition( lag_compensation.tick + 1u, next_pos );
+
+	if( have_pos && have_next_pos )
+		return pos + ( next_pos - pos ) * lag_compensation.lerp;
+	if( have_next_pos ) // Monster born after view time.
+		return next_pos;
+	return monster.Position();
+}
+
+const Map::InstantShotResult* Map::FindInstantShotResult( const EntityId rocket_id ) const
+{
+	if( !instant_shots_results_valid_ )
+		return nullptr;
+
+	const auto it=
+		std::lower_bound(
+			instant_shots_results_.begin(), instant_shots_results_.end(),
+			rocket_id,
+			[]( const InstantShotResult& result, const EntityId id )
+			{
+				return result.rocket_id < id;
+			} );
+
+	if( it == instant_shots_results_.end() || it->rocket_id != rocket_id )
+		return nullptr;
+	return &*it;
 }
 
 bool Map::FindNearestPlayerPos( const m_Vec3& pos, m_Vec3& out_pos ) const
@@ -3288,10 +3792,10 @@ EntityId Map::GetLightSourceId(
 	return parent_procedure_number * 256u + light_source_coomand_number;
 }
 
-void Map::PrepareRocketStateMessage( const Rocket& rocket, Messages::RocketState& message )
+void Map::PrepareRocketStateMessage( const Rocket& rocket, const m_Vec3& position, Messages::RocketState& message )
 {
 	message.rocket_id= rocket.rocket_id;
-	PositionToMessagePosition( rocket.previous_position, message.xyz );
+	PositionToMessagePosition( position, message.xyz );
 
 	float angle[2];
 	VecToAngles( rocket.normalized_direction, angle );
@@ -3348,11 +3852,18 @@ void Map::EmitModelDestructionEffects( const unsigned int model_number )
 	// TODO - tune this formula. It can be invalid.
 	pos.z+= ( model_data.z_min + model_data.z_max ) * 0.5f + float( description.bmpz ) / 128.0f;
 
-	particles_effects_messages_.emplace_back();
-	Messages::ParticleEffectBirth& message= particles_effects_messages_.back();
+	if( blow_effect_id >= game_resources_->sprites_effects_description.size() &&
+		blow_effect_id >= GameResources::c_first_gib_number )
+		SpawnGibs( pos, blow_effect_id - GameResources::c_first_gib_number );
+	else
+	{
+		Messages::ParticleEffectBirth message;
+
+		PositionToMessagePosition( pos, message.xyz );
+		message.effect_id= static_cast<unsigned char>( ParticleEffect::FirstBlowEffect ) + blow_effect_id;
 
-	PositionToMessagePosition( pos, message.xyz );
-	message.effect_id= static_cast<unsigned char>( ParticleEffect::FirstBlowEffect ) + blow_effect_id;
+		update_events_messages_.AddUnreliableMessage( message );
+	}
 
 	if( description.break_sfx_number != 0 )
 		PlayMapEventSound( pos, description.break_sfx_number );
@@ -3363,45 +3874,26 @@ void Map::GenParticleEffectForRocketHit( const m_Vec3& pos, const unsigned int r
 	PC_ASSERT( rocket_type_id < game_resources_->rockets_description.size() );
 	const GameResources::RocketDescription& description= game_resources_->rockets_description[ rocket_type_id ];
 
-	Messages::ParticleEffectBirth* message= nullptr;
-
 	if( description.model_file_name[0] == '\0' )
 	{ // bullet
 		if( description.blow_effect == 1 )
-		{
-			//bullet
-			particles_effects_messages_.emplace_back();
-			message= & particles_effects_messages_.back();
-			message->effect_id= static_cast<unsigned char>( ParticleEffect::Bullet );
-		}
+			AddParticleEffect( pos, ParticleEffect::Bullet ); //bullet
 	}
 	else
 	{
 		if( description.blow_effect == 1 || description.blow_effect == 3 || description.blow_effect == 4 )
-		{
-			// sparcles
-			particles_effects_messages_.emplace_back();
-			message= & particles_effects_messages_.back();
-			message->effect_id= static_cast<unsigned char>( ParticleEffect::Sparkles );
-		}
+			AddParticleEffect( pos, ParticleEffect::Sparkles ); // sparcles
 		if( description.blow_effect == 2 )
-		{
-			//explosion
-			particles_effects_messages_.emplace_back();
-			message= & particles_effects_messages_.back();
-			message->effect_id= static_cast<unsigned char>( ParticleEffect::Explosion );
-		}
+			AddParticleEffect( pos, ParticleEffect::Explosion ); //explosion
 		if( description.blow_effect == 4 )
 		{
 			// Mega destroyer flash.
-			fullscreen_blend_messages_.emplace_back();
-			fullscreen_blend_messages_.back().color_index= 23u; // white flash.
-			fullscreen_blend_messages_.back().intensity= 255u;
+			Messages::FullscreenBlendEffect message;
+			message.color_index= 23u; // white flash.
+			message.intensity= 255u;
+			update_events_messages_.AddUnreliableMessage( message );
 		}
 	}
-
-	if( message != nullptr )
-		PositionToMessagePosition( pos, message->xyz );
 }
 
 } // PanzerChasm
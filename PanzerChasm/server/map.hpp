@@ -1,17 +1,25 @@
 #pragma once
+#include <cstdint>
 #include <unordered_map>
 
 #include <matrix.hpp>
 
+#include "../entities_container.hpp"
 #include "../map_loader.hpp"
 #include "../messages_sender.hpp"
 #include "../particles.hpp"
 #include "../rand.hpp"
 #include "../time.hpp"
+#include "../workers_pool.hpp"
 #include "collision_index.hpp"
 #include "backpack.hpp"
+#include "memory_arena.hpp"
 #include "fwd.hpp"
+#include "monster_base.hpp"
+#include "monsters_index.hpp"
 #include "movement_restriction.hpp"
+#include "navigation_grid.hpp"
+#include "sparse_map_field.hpp"
 
 namespace PanzerChasm
 {
@@ -23,8 +31,22 @@ public:
 	typedef std::function<void()> MapEndCallback;
 	typedef std::function<void(const char*)> TextMessageCallback;
 
-	typedef std::unordered_map< EntityId, MonsterBasePtr > MonstersContainer;
-	typedef std::unordered_map< EntityId, PlayerPtr > PlayersContainer;
+	typedef EntitiesContainer<MonsterBasePtr> MonstersContainer;
+	typedef EntitiesContainer<PlayerPtr> PlayersContainer;
+
+	// Last state of map entities, sent to one client.
+	// Only changed entities are sent to client. Unchanged entities are resent sometimes, because state messages are unreliable.
+	// Monsters and rockets, irrelevant for client player, are sent with lower rate.
+	// Clear baseline, when client gets new map.
+	struct UpdateMessagesBaseline
+	{
+		std::vector<Messages::WallPosition> walls;
+		std::vector<Messages::StaticModelState> static_models;
+		std::vector<Messages::ItemState> items;
+		unsigned int update_number= 0u;
+
+		void Clear();
+	};
 
 	Map(
 		DifficultyType difficulty,
@@ -32,6 +54,7 @@ public:
 		const MapDataConstPtr& map_data,
 		const GameResourcesConstPtr& game_resources,
 		Time map_start_time,
+		WorkersPool& workers_pool,
 		MapEndCallback map_end_callback,
 		TextMessageCallback text_message_callback );
 
@@ -42,6 +65,7 @@ public:
 		const MapDataConstPtr& map_data,
 		LoadStream& load_stream,
 		const GameResourcesConstPtr& game_resources,
+		WorkersPool& workers_pool,
 		MapEndCallback map_end_callback,
 		TextMessageCallback text_message_callback );
 
@@ -63,11 +87,12 @@ public:
 		Time current_time );
 
 	void PlantMine( EntityId owner_monster_id, const m_Vec3& pos, Time current_time );
-	void SpawnBackpack( BackpackPtr backpack );
+	void SpawnBackpack( const Backpack& backpack );
 
 	void SpawnMonsterBodyPart(
 		unsigned char monster_type_id, unsigned char body_part_id,
 		const m_Vec3& pos, float angle );
+	void SpawnGibs( const m_Vec3& pos, unsigned int gib_id );
 
 	void PlayMonsterLinkedSound(
 		EntityId monster_id,
@@ -87,15 +112,31 @@ public:
 		bool& out_on_floor, MovementRestriction& out_movement_restriction ) const;
 
 	bool CanSee( const m_Vec3& from, const m_Vec3& to ) const;
+	// Approximate version for monsters AI. Result for nearby points is reused during several ticks.
+	bool CanSeeCached( const m_Vec3& from, const m_Vec3& to ) const;
+	// Returns true, if shot hits something (wall, model, monster, floor). Same hit test, as for instant weapons.
+	bool TraceShot( const m_Vec3& from, const m_Vec3& normalized_direction, float max_distance, m_Vec3& out_hit_pos ) const;
+
+	// Returns direction for walking around static walls.
+	// Returns false, if monster can go straight to target or if there is no way to target.
+	bool GetNavigationDirection( const m_Vec2& from, const m_Vec2& to, m_Vec2& out_direction ) const;
 
 	const MonstersContainer& GetMonsters() const;
 	const PlayersContainer& GetPlayers() const;
+	unsigned int GetRocketsCount() const;
 
 	void ProcessPlayerPosition( Time current_time, EntityId player_monster_id, MessagesSender& messages_sender );
 	void Tick( Time current_time, Time last_tick_delta );
 
 	void SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender ) const;
-	void SendUpdateMessages( MessagesSender& messages_sender ) const;
+
+	// Build update messages once per server tick, than send it to each player.
+	// If "player_pos" is null, all monsters and rockets are relevant (for spectator relays).
+	void PrepareUpdateMessages();
+	void SendUpdateMessages(
+		MessagesSender& messages_sender,
+		UpdateMessagesBaseline& baseline,
+		const m_Vec3* player_pos ) const;
 
 	void ClearUpdateEvents();
 
@@ -139,6 +180,8 @@ private:
 		float z;
 		unsigned char texture_id;
 		bool mortal= false;
+		bool moving= false; // Linked to active procedure in current tick.
+		bool state_message_dirty= true;
 	};
 
 	typedef std::vector<DynamicWall> DynamicWalls;
@@ -172,6 +215,7 @@ private:
 
 		bool picked= false; // For keys.
 		bool mortal= false;
+		bool moving= false; // Linked to active procedure or rotating light in current tick.
 		bool switch_activated= false;
 		std::unique_ptr<RotatingLightEffect> linked_rotating_light;
 	};
@@ -211,13 +255,23 @@ private:
 		EntityId owner_id; // owner - monster
 		unsigned char rocket_type_id;
 
-		m_Vec3 previous_position;
 		float track_length;
-
-		m_Vec3 speed; // For reflecting rockets.
 	};
 
-	typedef std::vector<Rocket> Rockets;
+	// Structure of arrays for rockets. Movement data is stored in separate contiguous arrays.
+	// Removing of rocket moves last rocket into its place.
+	struct Rockets
+	{
+		std::vector<Rocket> rockets;
+		std::vector<m_Vec3> positions; // Positions after previous tick.
+		std::vector<m_Vec3> velocities; // For reflecting rockets.
+		std::vector<m_Vec3> new_positions; // Result of movement step of current tick.
+
+		unsigned int Size() const;
+		void Add( const Rocket& rocket, const m_Vec3& velocity );
+		void Remove( unsigned int index );
+		void Resize( unsigned int size );
+	};
 
 	struct Mine
 	{
@@ -230,14 +284,6 @@ private:
 
 	typedef std::vector<Mine> Mines;
 
-	struct SpriteEffect
-	{
-		m_Vec3 pos;
-		unsigned char effect_id;
-	};
-
-	typedef std::vector<SpriteEffect> SpriteEffects;
-
 	struct RotatingLightEffect
 	{
 		Time start_time= Time::FromSeconds(0);
@@ -254,7 +300,7 @@ private:
 		float brightness;
 		unsigned short turn_on_time_ms;
 	};
-	typedef std::unordered_map< EntityId, LightSource > LightSourcesContainer;
+	typedef EntitiesContainer<LightSource> LightSourcesContainer;
 
 	struct HitResult
 	{
@@ -272,14 +318,78 @@ private:
 		m_Vec3 pos;
 	};
 
+	// Result of bullet or pellet, calculated together with other pellets of same shot.
+	struct InstantShotResult
+	{
+		EntityId rocket_id;
+		HitResult hit_result;
+	};
+
+	struct MonsterMapCollision
+	{
+		MonsterBase* monster;
+		m_Vec3 new_pos;
+		MovementRestriction movement_restriction;
+		bool on_floor;
+	};
+
+	struct SeeCacheEntry
+	{
+		unsigned int expiration_tick;
+		bool can_see;
+	};
+
+	// Key - pair of quantized positions.
+	typedef std::unordered_map< uint64_t, SeeCacheEntry > SeeCache;
+
+	struct NavigationFlowField
+	{
+		NavigationGrid::FlowField field;
+		unsigned int last_use_tick;
+	};
+
+	// Max pellets count, processed together.
+	static constexpr unsigned int c_max_shots_in_bundle= 32u;
+
+	// Monsters positions for shot, rewound to time, which shooter saw.
+	// Position is interpolated between recorded ticks "tick" and "tick + 1".
+	struct ShotLagCompensation
+	{
+		unsigned int tick;
+		float lerp;
+		float max_displacement; // Maximum xy distance between current and rewound positions of all monsters.
+	};
+
+	struct WindFieldCell
+	{
+		signed char dir[2];
+	};
+
 	struct DamageFiledCell
 	{
-		unsigned char damage; // 0 - means no damage
+		unsigned char damage;
 		signed char z_bottom, z_top; // 64 units/m
 	};
 
 private:
+	// Set initial state of dynamic walls, procedures, static models and items. Used both for new map and for map loading.
+	void InitStaticEntities( Time map_start_time );
+	// Remember serialized initial state of static entities. Only changed entities are written into save.
+	void SaveInitialStaticEntitiesState();
+
+	static void SaveDynamicWall( const DynamicWall& wall, SaveStream& save_stream );
+	static void LoadDynamicWall( DynamicWall& wall, LoadStream& load_stream );
+	static void SaveProcedureState( const ProcedureState& procedure_state, SaveStream& save_stream );
+	static void LoadProcedureState( ProcedureState& procedure_state, LoadStream& load_stream );
+	static void SaveStaticModel( const StaticModel& model, SaveStream& save_stream );
+	static void LoadStaticModel( StaticModel& model, LoadStream& load_stream );
+	static void SaveItem( const Item& item, SaveStream& save_stream );
+	static void LoadItem( Item& item, LoadStream& load_stream );
+
 	void ActivateProcedure( unsigned int procedure_number, Time current_time );
+	void SetProcedureActive( unsigned int procedure_number, bool active );
+	// Returns number of first active procedure, starting from given, or procedures count.
+	unsigned int GetNextActiveProcedure( unsigned int start_procedure_number ) const;
 	void TryActivateProcedure( unsigned int procedure_number, Time current_time, Player& player, MessagesSender& messages_sender );
 	void ProcedureProcessDestroy( unsigned int procedure_number, Time current_time );
 	void ProcedureProcessShoot( unsigned int procedure_number, Time current_time );
@@ -299,6 +409,23 @@ private:
 
 	void TryWarnMonsters( const m_Vec3& pos, Time current_time );
 	void MoveMapObjects( Time current_time );
+	// Returns object and adds it into list of moving objects.
+	DynamicWall& GetMovingWall( unsigned int wall_index );
+	StaticModel& GetMovingModel( unsigned int model_index );
+	static void ResetWallTransformation( DynamicWall& wall );
+	static void ResetModelTransformation( StaticModel& model );
+	// Returns true, if object really moved.
+	bool ApplyWallTransformation( unsigned int wall_index );
+	bool ApplyModelTransformation( unsigned int model_index );
+	// Calculates new positions of all not instant rockets, before hit tests.
+	void MoveRockets( Time current_time, float last_tick_delta_s );
+	void UpdateDynamicElementsInCollisionIndex();
+	// Call it, when walls or models, which can occlude view, changed.
+	void InvalidateSeeCache();
+	void RemoveExpiredSeeCacheEntries();
+	void UpdateModelInCollisionIndex( unsigned int model_index );
+	// Builds flow field, if it is not cached. Least recently used field is replaced.
+	const NavigationGrid::FlowField& GetNavigationFlowField( unsigned int target_cell ) const;
 
 	template<class Func>
 	void ProcessElementLinks(
@@ -312,6 +439,25 @@ private:
 		float max_distance,
 		EntityId skip_monster_id ) const;
 
+	// Process several shots from same point. Map cells along shots are traversed once for all shots.
+	void ProcessShots(
+		const m_Vec3& shot_start_point,
+		const m_Vec3* shots_directions_normalized,
+		unsigned int shot_count,
+		float max_distance,
+		EntityId skip_monster_id,
+		HitResult* out_results,
+		const ShotLagCompensation* lag_compensation= nullptr ) const;
+
+	void RecordMonstersPositionHistory( Time current_time );
+	// Returns false, if there is no need to rewind monsters for shots of this shooter.
+	bool GetShotLagCompensation( EntityId shooter_id, ShotLagCompensation& out_lag_compensation ) const;
+	m_Vec3 GetLagCompensatedPosition( const MonsterBase& monster, const ShotLagCompensation& lag_compensation ) const;
+
+	// Calculate hits for all bullets and pellets before rockets processing.
+	void PrepareInstantShotsResults();
+	const InstantShotResult* FindInstantShotResult( EntityId rocket_id ) const;
+
 	bool FindNearestPlayerPos( const m_Vec3& pos, m_Vec3& out_pos ) const;
 
 	float GetFloorLevel( const m_Vec2& pos, float radius= 0.0f ) const;
@@ -319,7 +465,7 @@ private:
 	EntityId GetNextMonsterId();
 	EntityId GetLightSourceId( unsigned int parent_procedure_number, unsigned int light_source_coomand_number ) const;
 
-	static void PrepareRocketStateMessage( const Rocket& rocket, Messages::RocketState& message );
+	static void PrepareRocketStateMessage( const Rocket& rocket, const m_Vec3& position, Messages::RocketState& message );
 	static void PrepareMineBirthMessage( const Mine& mine, Messages::DynamicItemBirth& message );
 	static void PrepareBackpackBirthMessage( const Backpack& backpack, EntityId backpack_id, Messages::DynamicItemBirth& message );
 	static void PrepareLightSourceBirthMessage( const LightSource& light_source, EntityId light_source_id, Messages::LightSourceBirth& message );
@@ -343,18 +489,45 @@ private:
 	DynamicWalls dynamic_walls_;
 
 	std::vector<ProcedureState> procedures_;
+	// Bit for each procedure, which may be not in "None" state. Idle procedures are skipped in ticks.
+	std::vector<uint64_t> active_procedures_;
 
 	bool map_end_triggered_= false;
 
 	StaticModels static_models_;
 	Items items_;
 
+	Time map_start_time_= Time::FromSeconds(0);
+	// Serialized initial state of dynamic walls, procedures, static models and items (in this order) with "map_start_time_" as base time.
+	// Offsets contain start of each entity data and end of data.
+	SaveLoadBuffer initial_static_entities_data_;
+	std::vector<unsigned int> initial_static_entities_offsets_;
+
+	// Indeces of objects, moved by procedures in current and previous ticks.
+	std::vector<unsigned int> moving_walls_, previous_moving_walls_;
+	std::vector<unsigned int> moving_models_, previous_moving_models_;
+
 	Rockets rockets_;
 	Mines mines_;
-	std::unordered_map<EntityId, BackpackPtr> backpacks_;
+	BackpacksContainer backpacks_;
 	EntityId next_rocket_id_= 1u; // Common id for rockets, mines, backpacks, etc.
 
-	SpriteEffects sprite_effects_;
+	// Sorted by rocket id. Invalid after shots, which change map objects or kill monsters.
+	std::vector<InstantShotResult> instant_shots_results_;
+	bool instant_shots_results_valid_= false;
+
+	std::vector<MonsterMapCollision> monsters_map_collisions_;
+	WorkersPool& workers_pool_; // Owned by server, shared between maps.
+
+	mutable SeeCache see_cache_; // Do not save.
+	unsigned int see_cache_tick_= 0u;
+
+	mutable std::vector<NavigationFlowField> navigation_flow_fields_; // Do not save.
+	unsigned int navigation_tick_= 0u;
+
+	// Monsters of map are allocated here, together with shared pointers control blocks.
+	// Declared before monsters container, because it must be destroyed after monsters.
+	MemoryArena monsters_arena_;
 
 	PlayersContainer players_;
 	MonstersContainer monsters_; // + players
@@ -362,30 +535,40 @@ private:
 
 	LightSourcesContainer light_sources_;
 
-	std::vector<Messages::MonsterBirth> monsters_birth_messages_;
-	std::vector<Messages::MonsterDeath> monsters_death_messages_;
-	std::vector<Messages::RocketBirth> rockets_birth_messages_;
-	std::vector<Messages::RocketDeath> rockets_death_messages_;
-	std::vector<Messages::DynamicItemBirth> dynamic_items_birth_messages_;
-	std::vector<Messages::DynamicItemDeath> dynamic_items_death_messages_;
-	std::vector<Messages::LightSourceBirth> light_sources_birth_messages_;
-	std::vector<Messages::LightSourceDeath> light_sources_death_messages_;
-	std::vector<Messages::RotatingLightSourceBirth> rotating_light_sources_birth_messages_;
-	std::vector<Messages::RotatingLightSourceDeath> rotating_light_sources_death_messages_;
-	std::vector<Messages::ParticleEffectBirth> particles_effects_messages_;
-	std::vector<Messages::FullscreenBlendEffect> fullscreen_blend_messages_; // Global blends - for all players.
-	std::vector<Messages::MonsterPartBirth> monsters_parts_birth_messages_;
-	std::vector<Messages::MapEventSound> map_events_sounds_messages_;
-	std::vector<Messages::MonsterLinkedSound> monster_linked_sounds_messages_;
-	std::vector<Messages::MonsterSound> monsters_sounds_messages_;
+	// Events (births, deaths, sounds, effects) are serialized here in order of emission, same for all players.
+	// Buffer is filled during tick and cleared after sending.
+	MessagesBuffer update_events_messages_;
+
+	// Births of gibs and body parts in update events buffer. Extra births are dropped, so, traffic of massacres is bounded.
+	unsigned int gibs_births_in_update_= 0u;
+	unsigned int body_parts_births_in_update_= 0u;
+	unsigned char next_gibs_seed_= 0u; // Seeds for client-side gibs and body parts parameters.
+
+	// Update messages, prepared for all players.
+	std::vector<Messages::WallPosition> walls_state_messages_;
+	std::vector<Messages::StaticModelState> static_models_state_messages_;
+	std::vector<Messages::ItemState> items_state_messages_;
+	std::vector<Messages::MonsterState> monsters_state_messages_;
+	std::vector<Messages::RocketState> rockets_state_messages_;
+
+	SparseMapField<WindFieldCell> wind_field_;
+	SparseMapField<DamageFiledCell> death_field_;
 
 	// Put large objects here.
 
-	// TODO - compress this fields
-	char wind_field_[ MapData::c_map_size * MapData::c_map_size ][2];
-	DamageFiledCell death_field_[ MapData::c_map_size * MapData::c_map_size ];
+	// Dynamic elements updated after map objects movement.
+	CollisionIndex collision_index_;
+
+	// Built from static walls at map start.
+	const NavigationGrid navigation_grid_;
+
+	// Rebuilt before shots processing and monsters collisions.
+	MonstersIndex monsters_index_;
 
-	const CollisionIndex collision_index_;
+	// Times (in internal representation) of ticks, for which monsters positions are recorded. Do not save.
+	int64_t position_history_times_[ MonsterBase::c_position_history_size ];
+	unsigned int position_history_tick_= 0u;
+	unsigned int position_history_tick_count_= 0u; // Limited by history size.
 };
 
 } // PanzerChasm
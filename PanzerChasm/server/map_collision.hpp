@@ -0,0 +1,24 @@
+#pragma once
+#include "../map_loader.hpp"
+#include "../time.hpp"
+#include "collision_index.hpp"
+#include "movement_restriction.hpp"
+
+namespace PanzerChasm
+{
+
+// Collision of vertical cylinder with map walls and models.
+// Shared between server map and client movement prediction, so, client predicts same movement, as server calculates.
+// Static models and dynamic walls containers must have elements with same layout, as map data static models and dynamic walls.
+// Returns new position of cylinder.
+template<class StaticModels, class DynamicWalls>
+m_Vec3 CollideCylinderWithMap(
+	const MapData& map_data,
+	const CollisionIndex& collision_index,
+	const StaticModels& static_models,
+	const DynamicWalls& dynamic_walls,
+	const m_Vec3& in_pos, float height, float radius,
+	Time tick_delta,
+	bool& out_on_floor, MovementRestriction& out_movement_restriction );
+
+} // namespace PanzerChasm
@@ -0,0 +1,266 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "a_code.hpp"
+#include "collisions.hpp"
+#include "collision_index.inl"
+
+#include "map_collision.hpp"
+
+namespace PanzerChasm
+{
+
+template<class Wall>
+m_Vec3 GetNormalForWall( const Wall& wall )
+{
+	m_Vec3 n( wall.vert_pos[0].y - wall.vert_pos[1].y, wall.vert_pos[1].x - wall.vert_pos[0].x, 0.0f );
+	return n / n.xy().Length();
+}
+
+inline bool CollideWithSquare( const MapData::ModelDescription& model_description )
+{
+	// CYKABLAT!
+	// It seems, that original game uses cicrcles collision, if lower radius bit is 0, and square, if this bit is 1.
+	return ( int(model_description.radius * 256.0f) & 1 ) == 1;
+}
+
+template<class StaticModels, class DynamicWalls>
+m_Vec3 CollideCylinderWithMap(
+	const MapData& map_data,
+	const CollisionIndex& collision_index,
+	const StaticModels& static_models,
+	const DynamicWalls& dynamic_walls,
+	const m_Vec3& in_pos, const float height, const float radius,
+	const Time tick_delta,
+	bool& out_on_floor, MovementRestriction& out_movement_restriction )
+{
+	m_Vec2 pos= in_pos.xy();
+	out_on_floor= false;
+
+	const float z_bottom= in_pos.z;
+	const float z_top= z_bottom + height;
+	float new_z= in_pos.z;
+
+	// Store list of objects, collisions with which alread processed.
+	constexpr unsigned int c_max_collisions= 32u;
+	MapData::IndexElement processed_collisions[ c_max_collisions ];
+	unsigned int processed_collisions_count= 0u;
+	const auto collision_processed=
+	[&]( const MapData::IndexElement& index_element )
+	{
+		if( processed_collisions_count == c_max_collisions )
+			return true;
+		for( unsigned int i= 0u; i < processed_collisions_count; i++ )
+			if( std::memcmp( &processed_collisions[i], &index_element, sizeof(MapData::IndexElement) ) == 0 )
+				return true;
+		return false;
+	};
+	const auto process_collision=
+	[&]( const MapData::IndexElement& index_element )
+	{
+		PC_ASSERT( processed_collisions_count < c_max_collisions );
+		processed_collisions[ processed_collisions_count ]= index_element;
+		processed_collisions_count++;
+	};
+
+	// Static walls are tested in batches. Only walls, which circle may touch, are processed precisely.
+	// Position changes after each collision, so, recalculate candidates of rest of batch after it.
+	const auto static_walls_process_func=
+	[&]( const CollisionIndex::StaticWallsBatch& batch )
+	{
+		for( unsigned int b= 0u; b < batch.count; b+= c_line_segments_batch_size )
+		{
+			unsigned int candidates_mask=
+				CircleMayCollideWithLineSegmentsBatch(
+					batch.x + b, batch.y + b, batch.dx + b, batch.dy + b,
+					pos, radius );
+
+			while( candidates_mask != 0u )
+			{
+				const unsigned int j= static_cast<unsigned int>( __builtin_ctz( candidates_mask ) );
+				candidates_mask&= candidates_mask - 1u;
+
+				MapData::IndexElement index_element;
+				index_element.type= MapData::IndexElement::StaticWall;
+				index_element.index= batch.indeces[ b + j ];
+				if( collision_processed(index_element) )
+					continue;
+
+				PC_ASSERT( index_element.index < map_data.static_walls.size() );
+				const MapData::Wall& wall= map_data.static_walls[ index_element.index ];
+
+				// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
+				if( wall.texture_id < MapData::c_first_transparent_texture_id &&
+					mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
+					continue;
+
+				m_Vec2 new_pos;
+				if( CollideCircleWithLineSegment(
+						wall.vert_pos[0], wall.vert_pos[1],
+						pos, radius,
+						new_pos ) )
+				{
+					process_collision( index_element );
+					pos= new_pos;
+					out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
+
+					// Position changed - search candidates among rest of walls of batch again.
+					candidates_mask=
+						CircleMayCollideWithLineSegmentsBatch(
+							batch.x + b, batch.y + b, batch.dx + b, batch.dy + b,
+							pos, radius ) &
+						~( ( 2u << j ) - 1u );
+				}
+			}
+		}
+	};
+
+	const auto elements_process_func=
+	[&]( const MapData::IndexElement& index_element )
+	{
+		if( collision_processed(index_element) )
+			return;
+
+		if( index_element.type == MapData::IndexElement::StaticModel )
+		{
+			const auto& model= static_models[ index_element.index ];
+			if( model.model_id >= map_data.models_description.size() )
+				return;
+
+			const MapData::ModelDescription& model_description= map_data.models_description[ model.model_id ];
+			if( model_description.radius <= 0.0f )
+				return;
+
+			const ACode a_code= static_cast<ACode>( model_description.ac );
+			if( a_code >= ACode::RedKey && a_code <= ACode::BlueKey )
+				return; // Skip keys
+
+			const Model& model_geometry= map_data.models[ model.model_id ];
+
+			const float model_z_min= model_geometry.z_min + model.pos.z;
+			const float model_z_max= model_geometry.z_max + model.pos.z;
+			if( z_top < model_z_min || z_bottom > model_z_max )
+				return;
+
+			bool collided= false;
+
+			m_Vec2 collide_pos;
+			if( CollideWithSquare( model_description ) )
+			{
+				collided=
+					CollideCircleWithSquare(
+						model.pos.xy(), model.angle, model_description.radius,
+						pos, radius,
+						collide_pos );
+			}
+			else
+			{
+				const float min_distance= radius + model_description.radius;
+				const m_Vec2 vec_to_pos= pos - model.pos.xy();
+				const float square_distance= vec_to_pos.SquareLength();
+				if( square_distance > 0.0f && square_distance < min_distance * min_distance )
+				{
+					collided= true;
+					collide_pos= model.pos.xy() + vec_to_pos * min_distance / std::sqrt( square_distance );
+				}
+			}
+
+			if( collided )
+			{
+				process_collision( index_element );
+				// Pull up or down player.
+				if( model_z_max - z_bottom <= GameConstants::z_pull_distance &&
+					model_z_max + height <= GameConstants::walls_height )
+				{
+					if( new_z < model_z_max )
+					{
+						new_z+= GameConstants::z_pull_speed * tick_delta.ToSeconds();
+						new_z= std::min( new_z, model_z_max );
+						if( new_z >= model_z_max )
+							out_on_floor= true;
+					}
+				}
+				else if( z_top - model_z_min <= GameConstants::z_pull_distance &&
+					model_z_min - height >= 0.0f )
+				{
+					if( new_z > model_z_min - height )
+					{
+						new_z-= GameConstants::z_pull_speed * tick_delta.ToSeconds();
+						new_z= std::max( new_z, model_z_min - height );
+					}
+				}
+				// Push sideways.
+				else
+				{
+					const m_Vec2 normal= collide_pos - pos;
+					const float normal_square_length= normal.SquareLength();
+					if( normal_square_length > 0.0f )
+						out_movement_restriction.AddRestriction( normal / normal_square_length );
+
+					pos.x= collide_pos.x;
+					pos.y= collide_pos.y;
+				}
+			}
+		}
+		else if( index_element.type == MapData::IndexElement::DynamicWall )
+		{
+			PC_ASSERT( index_element.index < dynamic_walls.size() );
+			const auto& wall= dynamic_walls[ index_element.index ];
+
+			if( wall.vert_pos[0] == wall.vert_pos[1] )
+				return;
+
+			const MapData::WallTextureDescription& tex= map_data.walls_textures[ wall.texture_id ];
+			if( tex.gso[0] )
+				return;
+
+			// PROCESS.05:
+			// ;  up            [ x,y] [ H]   [s:num]     ,if H>=80 then walktrough
+			if( wall.z >= 80.0f / 64.0f )
+				return;
+
+			if( z_top < wall.z || z_bottom > wall.z + GameConstants::walls_height )
+				return;
+
+			// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
+			if( wall.texture_id < MapData::c_first_transparent_texture_id &&
+				mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
+				return;
+
+			m_Vec2 new_pos;
+			if( CollideCircleWithLineSegment(
+					wall.vert_pos[0], wall.vert_pos[1],
+					pos, radius,
+					new_pos ) )
+			{
+				process_collision( index_element );
+				pos= new_pos;
+				out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
+			}
+		}
+		else
+		{
+			// TODO
+		}
+	};
+
+	collision_index.ProcessElementsInRadiusBatched(
+		pos, radius,
+		static_walls_process_func,
+		elements_process_func );
+
+	if( new_z <= 0.0f )
+	{
+		out_on_floor= true;
+		new_z= 0.0f;
+	}
+	else if( new_z + height > GameConstants::walls_height )
+		new_z= GameConstants::walls_height - height;
+
+	return m_Vec3( pos, new_z );
+}
+
+} // namespace PanzerChasm
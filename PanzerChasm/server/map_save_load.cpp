@@ -1,3 +1,6 @@
+#include <cstring>
+
+#include "../assert.hpp"
 #include "../save_load_streams.hpp"
 #include "map.hpp"
 #include "monster.hpp"
@@ -6,93 +9,271 @@
 namespace PanzerChasm
 {
 
-void Map::Save( SaveStream& save_stream ) const
+// Writes flag for each entity. Entity data is written only if it differs from initial entity data.
+template<class Entity>
+static void SaveStaticEntitiesDiff(
+	const std::vector<Entity>& entities,
+	void (* const save_func)( const Entity&, SaveStream& ),
+	const SaveLoadBuffer& initial_data,
+	const std::vector<unsigned int>& initial_offsets,
+	unsigned int& initial_entity_index,
+	const Time map_start_time,
+	SaveStream& save_stream )
 {
-	// Random generator.
-	save_stream.WriteUInt32( random_generator_->GetInnerState() );
+	save_stream.WriteUInt32( static_cast<uint32_t>( entities.size() ) );
 
-	// Dynamic walls
-	save_stream.WriteUInt32( static_cast<uint32_t>( dynamic_walls_.size() ) );
-	for( const DynamicWall& wall : dynamic_walls_ )
+	SaveLoadBuffer entity_data;
+	for( const Entity& entity : entities )
 	{
-		save_stream.WriteVec2( wall.vert_pos[0] );
-		save_stream.WriteVec2( wall.vert_pos[1] );
-		save_stream.WriteVec2( wall.vert_move_speed[0] );
-		save_stream.WriteVec2( wall.vert_move_speed[1] );
-		save_stream.WriteFloat( wall.z );
-		save_stream.WriteUInt8( wall.texture_id );
-		save_stream.WriteBool( wall.mortal );
+		// Serialize entity with same base time, as initial state.
+		entity_data.clear();
+		SaveStream entity_stream( entity_data, map_start_time );
+		save_func( entity, entity_stream );
+
+		PC_ASSERT( initial_entity_index + 1u < initial_offsets.size() );
+		const unsigned int initial_begin= initial_offsets[ initial_entity_index ];
+		const unsigned int initial_end= initial_offsets[ initial_entity_index + 1u ];
+		initial_entity_index++;
+
+		const bool changed=
+			entity_data.size() != initial_end - initial_begin ||
+			std::memcmp( entity_data.data(), initial_data.data() + initial_begin, entity_data.size() ) != 0;
+
+		save_stream.WriteBool( changed );
+		if( changed )
+			save_func( entity, save_stream );
 	}
+}
 
-	// Procedures
-	save_stream.WriteUInt32( static_cast<uint32_t>( procedures_.size() ) );
-	for( const ProcedureState& procedure_state : procedures_ )
+// Entities must be in initial state before loading.
+template<class Entity>
+static void LoadStaticEntitiesDiff(
+	std::vector<Entity>& entities,
+	void (* const load_func)( Entity&, LoadStream& ),
+	LoadStream& load_stream )
+{
+	unsigned int entity_count;
+	load_stream.ReadUInt32( entity_count );
+	PC_ASSERT( entity_count == entities.size() );
+
+	for( unsigned int i= 0u; i < entity_count; i++ )
 	{
-		save_stream.WriteBool( procedure_state.locked );
-		save_stream.WriteBool( procedure_state.first_message_printed );
-		save_stream.WriteUInt32( static_cast<uint32_t>( procedure_state.movement_state ) );
-		save_stream.WriteFloat( procedure_state.movement_stage );
-		save_stream.WriteTime( procedure_state.last_state_change_time );
+		bool changed;
+		load_stream.ReadBool( changed );
+		if( changed )
+			load_func( entities[i], load_stream );
 	}
+}
 
-	// Map end flag
-	save_stream.WriteBool( map_end_triggered_ );
+void Map::SaveInitialStaticEntitiesState()
+{
+	initial_static_entities_data_.clear();
+	initial_static_entities_offsets_.clear();
+
+	SaveStream save_stream( initial_static_entities_data_, map_start_time_ );
+	const auto add_offset=
+	[&]
+	{
+		initial_static_entities_offsets_.push_back( static_cast<unsigned int>( initial_static_entities_data_.size() ) );
+	};
 
-	// Static models
-	save_stream.WriteUInt32( static_cast<uint32_t>( static_models_.size() ) );
+	for( const DynamicWall& wall : dynamic_walls_ )
+	{
+		add_offset();
+		SaveDynamicWall( wall, save_stream );
+	}
+	for( const ProcedureState& procedure_state : procedures_ )
+	{
+		add_offset();
+		SaveProcedureState( procedure_state, save_stream );
+	}
 	for( const StaticModel& model : static_models_ )
 	{
-		// TODO - add save-load methods for vectors
-		save_stream.WriteVec3( model.pos );
-		save_stream.WriteVec2( model.move_speed );
-		save_stream.WriteFloat( model.baze_z );
-		save_stream.WriteFloat( model.angle );
-		save_stream.WriteUInt8( model.model_id );
-		save_stream.WriteInt32( model.health );
-		save_stream.WriteUInt32( static_cast<uint32_t>(model.animation_state) );
-		save_stream.WriteTime( model.animation_start_time );
-		save_stream.WriteUInt32( model.animation_start_frame );
-		save_stream.WriteUInt32( model.current_animation_frame );
-		save_stream.WriteBool( model.picked );
-		save_stream.WriteBool( model.mortal );
-		save_stream.WriteBool( model.switch_activated );
-
-		// Save optional rotating light
-		save_stream.WriteBool( model.linked_rotating_light != nullptr );
-		if( model.linked_rotating_light != nullptr )
-		{
-			save_stream.WriteTime( model.linked_rotating_light->start_time );
-			save_stream.WriteTime( model.linked_rotating_light->end_time );
-			save_stream.WriteFloat( model.linked_rotating_light->radius );
-			save_stream.WriteFloat( model.linked_rotating_light->brightness );
-		}
+		add_offset();
+		SaveStaticModel( model, save_stream );
 	}
-
-	// Items
-	save_stream.WriteUInt32( static_cast<uint32_t>( items_.size() ) );
 	for( const Item& item : items_ )
 	{
-		// TODO - position really needs?
-		save_stream.WriteVec3( item.pos );
-		// TODO - item id is constant. remove it ?
-		save_stream.WriteUInt8( item.item_id );
-		save_stream.WriteBool( item.picked_up );
-		save_stream.WriteBool( item.enabled );
+		add_offset();
+		SaveItem( item, save_stream );
+	}
+	add_offset();
+}
+
+void Map::SaveDynamicWall( const DynamicWall& wall, SaveStream& save_stream )
+{
+	save_stream.WriteVec2( wall.vert_pos[0] );
+	save_stream.WriteVec2( wall.vert_pos[1] );
+	save_stream.WriteVec2( wall.vert_move_speed[0] );
+	save_stream.WriteVec2( wall.vert_move_speed[1] );
+	save_stream.WriteFloat( wall.z );
+	save_stream.WriteUInt8( wall.texture_id );
+	save_stream.WriteBool( wall.mortal );
+}
+
+void Map::LoadDynamicWall( DynamicWall& wall, LoadStream& load_stream )
+{
+	load_stream.ReadVec2( wall.vert_pos[0] );
+	load_stream.ReadVec2( wall.vert_pos[1] );
+	load_stream.ReadVec2( wall.vert_move_speed[0] );
+	load_stream.ReadVec2( wall.vert_move_speed[1] );
+	load_stream.ReadFloat( wall.z );
+	load_stream.ReadUInt8( wall.texture_id );
+	load_stream.ReadBool( wall.mortal );
+}
+
+void Map::SaveProcedureState( const ProcedureState& procedure_state, SaveStream& save_stream )
+{
+	save_stream.WriteBool( procedure_state.locked );
+	save_stream.WriteBool( procedure_state.first_message_printed );
+	save_stream.WriteUInt32( static_cast<uint32_t>( procedure_state.movement_state ) );
+	save_stream.WriteFloat( procedure_state.movement_stage );
+	save_stream.WriteTime( procedure_state.last_state_change_time );
+}
+
+void Map::LoadProcedureState( ProcedureState& procedure_state, LoadStream& load_stream )
+{
+	load_stream.ReadBool( procedure_state.locked );
+	load_stream.ReadBool( procedure_state.first_message_printed );
+	unsigned int movement_state;
+	load_stream.ReadUInt32( movement_state );
+	procedure_state.movement_state= static_cast<ProcedureState::MovementState>( movement_state );
+	load_stream.ReadFloat( procedure_state.movement_stage );
+	load_stream.ReadTime( procedure_state.last_state_change_time );
+}
+
+void Map::SaveStaticModel( const StaticModel& model, SaveStream& save_stream )
+{
+	// TODO - add save-load methods for vectors
+	save_stream.WriteVec3( model.pos );
+	save_stream.WriteVec2( model.move_speed );
+	save_stream.WriteFloat( model.baze_z );
+	save_stream.WriteFloat( model.angle );
+	save_stream.WriteUInt8( model.model_id );
+	save_stream.WriteInt32( model.health );
+	save_stream.WriteUInt32( static_cast<uint32_t>(model.animation_state) );
+	save_stream.WriteTime( model.animation_start_time );
+	save_stream.WriteUInt32( model.animation_start_frame );
+	save_stream.WriteUInt32( model.current_animation_frame );
+	save_stream.WriteBool( model.picked );
+	save_stream.WriteBool( model.mortal );
+	save_stream.WriteBool( model.switch_activated );
+
+	// Save optional rotating light
+	save_stream.WriteBool( model.linked_rotating_light != nullptr );
+	if( model.linked_rotating_light != nullptr )
+	{
+		save_stream.WriteTime( model.linked_rotating_light->start_time );
+		save_stream.WriteTime( model.linked_rotating_light->end_time );
+		save_stream.WriteFloat( model.linked_rotating_light->radius );
+		save_stream.WriteFloat( model.linked_rotating_light->brightness );
+	}
+}
+
+void Map::LoadStaticModel( StaticModel& model, LoadStream& load_stream )
+{
+	load_stream.ReadVec3( model.pos );
+	load_stream.ReadVec2( model.move_speed );
+	load_stream.ReadFloat( model.baze_z );
+	load_stream.ReadFloat( model.angle );
+	load_stream.ReadUInt8( model.model_id );
+	load_stream.ReadInt32( model.health );
+	unsigned int animation_state;
+	load_stream.ReadUInt32( animation_state );
+	model.animation_state= static_cast<StaticModel::AnimationState>(animation_state);
+	load_stream.ReadTime( model.animation_start_time );
+	load_stream.ReadUInt32( model.animation_start_frame );
+	load_stream.ReadUInt32( model.current_animation_frame );
+	load_stream.ReadBool( model.picked );
+	load_stream.ReadBool( model.mortal );
+	load_stream.ReadBool( model.switch_activated );
+
+	// Load optional rotating light
+	bool is_rotating_light;
+	load_stream.ReadBool( is_rotating_light );
+	if( is_rotating_light )
+	{
+		model.linked_rotating_light.reset( new RotatingLightEffect );
+		load_stream.ReadTime( model.linked_rotating_light->start_time );
+		load_stream.ReadTime( model.linked_rotating_light->end_time );
+		load_stream.ReadFloat( model.linked_rotating_light->radius );
+		load_stream.ReadFloat( model.linked_rotating_light->brightness );
 	}
+	else
+		model.linked_rotating_light= nullptr;
+}
+
+void Map::SaveItem( const Item& item, SaveStream& save_stream )
+{
+	// TODO - position really needs?
+	save_stream.WriteVec3( item.pos );
+	// TODO - item id is constant. remove it ?
+	save_stream.WriteUInt8( item.item_id );
+	save_stream.WriteBool( item.picked_up );
+	save_stream.WriteBool( item.enabled );
+}
+
+void Map::LoadItem( Item& item, LoadStream& load_stream )
+{
+	load_stream.ReadVec3( item.pos );
+	load_stream.ReadUInt8( item.item_id );
+	load_stream.ReadBool( item.picked_up );
+	load_stream.ReadBool( item.enabled );
+}
+
+void Map::Save( SaveStream& save_stream ) const
+{
+	// Reserve buffer for whole map at once. Entity save size is approximate.
+	const unsigned int c_approximate_entity_save_size= 128u;
+	save_stream.Reserve(
+		c_approximate_entity_save_size * static_cast<unsigned int>(
+			dynamic_walls_.size() + procedures_.size() + static_models_.size() + items_.size() +
+			rockets_.Size() + mines_.size() + backpacks_.size() + monsters_.size() + light_sources_.size() ) +
+		5u * static_cast<unsigned int>( wind_field_.ActiveCellCount() + death_field_.ActiveCellCount() ) );
+
+	// Random generator.
+	save_stream.WriteUInt32( random_generator_->GetInnerState() );
+
+	save_stream.WriteTime( map_start_time_ );
+
+	// Static entities. Write only entities, changed since map start.
+	unsigned int initial_entity_index= 0u;
+	SaveStaticEntitiesDiff(
+		dynamic_walls_, SaveDynamicWall,
+		initial_static_entities_data_, initial_static_entities_offsets_, initial_entity_index,
+		map_start_time_, save_stream );
+	SaveStaticEntitiesDiff(
+		procedures_, SaveProcedureState,
+		initial_static_entities_data_, initial_static_entities_offsets_, initial_entity_index,
+		map_start_time_, save_stream );
+
+	// Map end flag
+	save_stream.WriteBool( map_end_triggered_ );
+
+	SaveStaticEntitiesDiff(
+		static_models_, SaveStaticModel,
+		initial_static_entities_data_, initial_static_entities_offsets_, initial_entity_index,
+		map_start_time_, save_stream );
+	SaveStaticEntitiesDiff(
+		items_, SaveItem,
+		initial_static_entities_data_, initial_static_entities_offsets_, initial_entity_index,
+		map_start_time_, save_stream );
+	PC_ASSERT( initial_entity_index + 1u == initial_static_entities_offsets_.size() );
 
 	// Rockets
-	save_stream.WriteUInt32( static_cast<uint32_t>( rockets_.size() ) );
-	for( const Rocket& rocket : rockets_ )
+	save_stream.WriteUInt32( static_cast<uint32_t>( rockets_.Size() ) );
+	for( unsigned int r= 0u; r < rockets_.Size(); r++ )
 	{
+		const Rocket& rocket= rockets_.rockets[r];
 		save_stream.WriteTime( rocket.start_time );
 		save_stream.WriteVec3( rocket.start_point );
 		save_stream.WriteVec3( rocket.normalized_direction );
 		save_stream.WriteUInt16( rocket.rocket_id );
 		save_stream.WriteUInt16( rocket.owner_id );
 		save_stream.WriteUInt8( rocket.rocket_type_id );
-		save_stream.WriteVec3( rocket.previous_position );
+		save_stream.WriteVec3( rockets_.positions[r] );
 		save_stream.WriteFloat( rocket.track_length );
-		save_stream.WriteVec3( rocket.speed );
+		save_stream.WriteVec3( rockets_.velocities[r] );
 	}
 
 	// Mines
@@ -108,20 +289,17 @@ void Map::Save( SaveStream& save_stream ) const
 
 	// Backpacks
 	save_stream.WriteUInt32( static_cast<uint32_t>( backpacks_.size() ) );
-	for( const std::unordered_map<EntityId, BackpackPtr>::value_type& backpack_value : backpacks_ )
+	for( const BackpacksContainer::value_type& backpack_value : backpacks_ )
 	{
-		const Backpack& backpack = *backpack_value.second;
+		const Backpack& backpack = backpack_value.second;
 
 		save_stream.WriteUInt16( backpack_value.first );
 
 		save_stream.WriteVec3( backpack.pos );
 		save_stream.WriteFloat( backpack.vertical_speed );
 		save_stream.WriteFloat( backpack.min_z );
-		for( unsigned int i= 0u; i < GameConstants::weapon_count; i++ )
-		{
-			save_stream.WriteBool( backpack.weapon[i] );
-			save_stream.WriteUInt8( backpack.ammo[i] );
-		}
+		save_stream.WriteArray( backpack.weapon, GameConstants::weapon_count );
+		save_stream.WriteArray( backpack.ammo, GameConstants::weapon_count );
 		save_stream.WriteBool( backpack.red_key   );
 		save_stream.WriteBool( backpack.green_key );
 		save_stream.WriteBool( backpack.blue_key  );
@@ -160,21 +338,28 @@ void Map::Save( SaveStream& save_stream ) const
 		save_stream.WriteUInt16( light_source.turn_on_time_ms );
 	}
 
-	// Wind field
-	// TODO - optimize large arrays saving
-	for( const char* const wind_field_cell : wind_field_ )
-	{
-		save_stream.WriteInt8( int8_t( wind_field_cell[0] ) );
-		save_stream.WriteInt8( int8_t( wind_field_cell[1] ) );
-	}
+	// Wind field. Save only active cells.
+	save_stream.WriteUInt32( static_cast<uint32_t>( wind_field_.ActiveCellCount() ) );
+	wind_field_.ForEachActiveCell(
+		[&]( const unsigned int x, const unsigned int y, const WindFieldCell& cell )
+		{
+			save_stream.WriteUInt8( static_cast<uint8_t>(x) );
+			save_stream.WriteUInt8( static_cast<uint8_t>(y) );
+			save_stream.WriteInt8( cell.dir[0] );
+			save_stream.WriteInt8( cell.dir[1] );
+		} );
 
 	// Death field
-	for( const DamageFiledCell& damage_field_cell : death_field_ )
-	{
-		save_stream.WriteUInt8( damage_field_cell.damage );
-		save_stream.WriteInt8( damage_field_cell.z_bottom );
-		save_stream.WriteInt8( damage_field_cell.z_top );
-	}
+	save_stream.WriteUInt32( static_cast<uint32_t>( death_field_.ActiveCellCount() ) );
+	death_field_.ForEachActiveCell(
+		[&]( const unsigned int x, const unsigned int y, const DamageFiledCell& cell )
+		{
+			save_stream.WriteUInt8( static_cast<uint8_t>(x) );
+			save_stream.WriteUInt8( static_cast<uint8_t>(y) );
+			save_stream.WriteUInt8( cell.damage );
+			save_stream.WriteInt8( cell.z_bottom );
+			save_stream.WriteInt8( cell.z_top );
+		} );
 }
 
 Map::Map(
@@ -183,6 +368,7 @@ Map::Map(
 	const MapDataConstPtr& map_data,
 	LoadStream& load_stream,
 	const GameResourcesConstPtr& game_resources,
+	WorkersPool& workers_pool,
 	MapEndCallback map_end_callback,
 	TextMessageCallback text_message_callback )
 	: difficulty_(difficulty)
@@ -192,7 +378,9 @@ Map::Map(
 	, map_end_callback_( std::move( map_end_callback ) )
 	, text_message_callback_( std::move(text_message_callback) )
 	, random_generator_( std::make_shared<LongRand>() )
+	, workers_pool_( workers_pool )
 	, collision_index_( map_data )
+	, navigation_grid_( *map_data, collision_index_ )
 {
 	PC_ASSERT( map_data_ != nullptr );
 	PC_ASSERT( game_resources_ != nullptr );
@@ -202,107 +390,44 @@ Map::Map(
 	load_stream.ReadUInt32( rand_state );
 	random_generator_->SetInnerState( rand_state );
 
-	// Dynamic walls
-	unsigned int dynamic_walls_count;
-	load_stream.ReadUInt32( dynamic_walls_count );
-	PC_ASSERT( dynamic_walls_count == map_data_->dynamic_walls.size() );
-	dynamic_walls_.resize( dynamic_walls_count );
-	for( DynamicWall& wall : dynamic_walls_ )
-	{
-		load_stream.ReadVec2( wall.vert_pos[0] );
-		load_stream.ReadVec2( wall.vert_pos[1] );
-		load_stream.ReadVec2( wall.vert_move_speed[0] );
-		load_stream.ReadVec2( wall.vert_move_speed[1] );
-		load_stream.ReadFloat( wall.z );
-		load_stream.ReadUInt8( wall.texture_id );
-		load_stream.ReadBool( wall.mortal );
-	}
+	// Static entities. Set initial state and than apply changes.
+	Time map_start_time= Time::FromSeconds(0);
+	load_stream.ReadTime( map_start_time );
+	InitStaticEntities( map_start_time );
 
-	// Procedures
-	unsigned int procedures_count;
-	load_stream.ReadUInt32( procedures_count );
-	PC_ASSERT( procedures_count == map_data_->procedures.size() );
-	procedures_.resize( procedures_count );
-	for( ProcedureState& procedure_state : procedures_ )
+	LoadStaticEntitiesDiff( dynamic_walls_, LoadDynamicWall, load_stream );
+	LoadStaticEntitiesDiff( procedures_, LoadProcedureState, load_stream );
+
+	for( unsigned int p= 0u; p < procedures_.size(); p++ )
 	{
-		load_stream.ReadBool( procedure_state.locked );
-		load_stream.ReadBool( procedure_state.first_message_printed );
-		unsigned int movement_state;
-		load_stream.ReadUInt32( movement_state );
-		procedure_state.movement_state= static_cast<ProcedureState::MovementState>( movement_state );
-		load_stream.ReadFloat( procedure_state.movement_stage );
-		load_stream.ReadTime( procedure_state.last_state_change_time );
+		if( procedures_[p].movement_state != ProcedureState::MovementState::None )
+			SetProcedureActive( p, true );
 	}
 
 	// Map end flag
 	load_stream.ReadBool( map_end_triggered_ );
 
-	// Static models
-	unsigned int static_models_count;
-	load_stream.ReadUInt32( static_models_count );
-	PC_ASSERT( static_models_count == map_data_->static_models.size() );
-	static_models_.resize( static_models_count );
-	for( StaticModel& model : static_models_ )
-	{
-		load_stream.ReadVec3( model.pos );
-		load_stream.ReadVec2( model.move_speed );
-		load_stream.ReadFloat( model.baze_z );
-		load_stream.ReadFloat( model.angle );
-		load_stream.ReadUInt8( model.model_id );
-		load_stream.ReadInt32( model.health );
-		unsigned int animation_state;
-		load_stream.ReadUInt32( animation_state );
-		model.animation_state= static_cast<StaticModel::AnimationState>(animation_state);
-		load_stream.ReadTime( model.animation_start_time );
-		load_stream.ReadUInt32( model.animation_start_frame );
-		load_stream.ReadUInt32( model.current_animation_frame );
-		load_stream.ReadBool( model.picked );
-		load_stream.ReadBool( model.mortal );
-		load_stream.ReadBool( model.switch_activated );
-
-		// Load optional rotating light
-		bool is_rotating_light;
-		load_stream.ReadBool( is_rotating_light );
-		if( is_rotating_light )
-		{
-			model.linked_rotating_light.reset( new RotatingLightEffect );
-			load_stream.ReadTime( model.linked_rotating_light->start_time );
-			load_stream.ReadTime( model.linked_rotating_light->end_time );
-			load_stream.ReadFloat( model.linked_rotating_light->radius );
-			load_stream.ReadFloat( model.linked_rotating_light->brightness );
-		}
-	}
+	LoadStaticEntitiesDiff( static_models_, LoadStaticModel, load_stream );
+	UpdateDynamicElementsInCollisionIndex();
 
-	// Items
-	unsigned int item_count;
-	load_stream.ReadUInt32( item_count );
-	PC_ASSERT( item_count == map_data_->items.size() );
-	items_.resize( item_count );
-	for( Item& item : items_ )
-	{
-		// TODO - position really needs?
-		load_stream.ReadVec3( item.pos );
-		// TODO - item id is constant. remove it ?
-		load_stream.ReadUInt8( item.item_id );
-		load_stream.ReadBool( item.picked_up );
-		load_stream.ReadBool( item.enabled );
-	}
+	LoadStaticEntitiesDiff( items_, LoadItem, load_stream );
 
 	// Rockets
 	unsigned int rocket_count;
 	load_stream.ReadUInt32( rocket_count );
-	rockets_.resize( rocket_count );
-	for( Rocket& rocket : rockets_ )
+	rockets_.Resize( rocket_count );
+	for( unsigned int r= 0u; r < rocket_count; r++ )
 	{
+		Rocket& rocket= rockets_.rockets[r];
 		load_stream.ReadTime( rocket.start_time );
 		load_stream.ReadVec3( rocket.start_point );
 		load_stream.ReadVec3( rocket.normalized_direction );
 		load_stream.ReadUInt16( rocket.rocket_id );
 		load_stream.ReadUInt16( rocket.owner_id );
 		load_stream.ReadUInt8( rocket.rocket_type_id );
-		load_stream.ReadVec3( rocket.previous_position );
+		load_stream.ReadVec3( rockets_.positions[r] );
 		load_stream.ReadFloat( rocket.track_length );
-		load_stream.ReadVec3( rocket.speed );
+		load_stream.ReadVec3( rockets_.velocities[r] );
 	}
 
 	// Mines
@@ -326,18 +451,13 @@ Map::Map(
 		EntityId id;
 		load_stream.ReadUInt16( id );
 
-		BackpackPtr& backpack_ptr= backpacks_[id];
-		backpack_ptr.reset( new Backpack );
-		Backpack& backpack= *backpack_ptr;
+		Backpack& backpack= backpacks_[id];
 
 		load_stream.ReadVec3( backpack.pos );
 		load_stream.ReadFloat( backpack.vertical_speed );
 		load_stream.ReadFloat( backpack.min_z );
-		for( unsigned int i= 0u; i < GameConstants::weapon_count; i++ )
-		{
-			load_stream.ReadBool( backpack.weapon[i] );
-			load_stream.ReadUInt8( backpack.ammo[i] );
-		}
+		load_stream.ReadArray( backpack.weapon, GameConstants::weapon_count );
+		load_stream.ReadArray( backpack.ammo, GameConstants::weapon_count );
 		load_stream.ReadBool( backpack.red_key   );
 		load_stream.ReadBool( backpack.green_key );
 		load_stream.ReadBool( backpack.blue_key  );
@@ -369,7 +489,10 @@ Map::Map(
 		}
 		else
 		{
-			const MonsterPtr monster= std::make_shared<Monster>( monster_id, game_resources_, random_generator_, load_stream );
+			const MonsterPtr monster=
+				std::allocate_shared<Monster>(
+					ArenaAllocator<Monster>( monsters_arena_ ),
+					monster_id, game_resources_, random_generator_, load_stream );
 			monsters_[id]= monster;
 		}
 	}
@@ -394,19 +517,36 @@ Map::Map(
 	}
 
 	// Wind field
-	// TODO - optimize large arrays saving
-	for( char* const wind_field_cell : wind_field_ )
+	unsigned int wind_cell_count;
+	load_stream.ReadUInt32( wind_cell_count );
+	for( unsigned int i= 0u; i < wind_cell_count; i++ )
 	{
-		load_stream.ReadInt8( reinterpret_cast<int8_t&>(wind_field_cell[0]) );
-		load_stream.ReadInt8( reinterpret_cast<int8_t&>(wind_field_cell[1]) );
+		uint8_t x, y;
+		WindFieldCell cell;
+		load_stream.ReadUInt8( x );
+		load_stream.ReadUInt8( y );
+		load_stream.ReadInt8( cell.dir[0] );
+		load_stream.ReadInt8( cell.dir[1] );
+
+		if( x < MapData::c_map_size && y < MapData::c_map_size )
+			wind_field_.Set( x, y, cell );
 	}
 
 	// Death field
-	for( DamageFiledCell& damage_field_cell : death_field_ )
+	unsigned int death_cell_count;
+	load_stream.ReadUInt32( death_cell_count );
+	for( unsigned int i= 0u; i < death_cell_count; i++ )
 	{
-		load_stream.ReadUInt8( damage_field_cell.damage );
-		load_stream.ReadInt8( damage_field_cell.z_bottom );
-		load_stream.ReadInt8( damage_field_cell.z_top );
+		uint8_t x, y;
+		DamageFiledCell cell;
+		load_stream.ReadUInt8( x );
+		load_stream.ReadUInt8( y );
+		load_stream.ReadUInt8( cell.damage );
+		load_stream.ReadInt8( cell.z_bottom );
+		load_stream.ReadInt8( cell.z_top );
+
+		if( x < MapData::c_map_size && y < MapData::c_map_size )
+			death_field_.Set( x, y, cell );
 	}
 }
 
@@ -489,11 +629,8 @@ void Player::Save( SaveStream& save_stream )
 	save_stream.WriteBool( noclip_ );
 	save_stream.WriteBool( god_mode_ );
 	save_stream.WriteBool( teleported_ );
-	for( unsigned int i= 0u; i < GameConstants::weapon_count; i++ )
-	{
-		save_stream.WriteUInt8( ammo_[i] );
-		save_stream.WriteBool( have_weapon_[i] );
-	}
+	save_stream.WriteArray( ammo_, GameConstants::weapon_count );
+	save_stream.WriteArray( have_weapon_, GameConstants::weapon_count );
 	save_stream.WriteInt32( armor_ );
 	save_stream.WriteBool( have_red_key_   );
 	save_stream.WriteBool( have_green_key_ );
@@ -536,11 +673,8 @@ Player::Player( const GameResourcesConstPtr& game_resources, LoadStream& load_st
 	load_stream.ReadBool( noclip_ );
 	load_stream.ReadBool( god_mode_ );
 	load_stream.ReadBool( teleported_ );
-	for( unsigned int i= 0u; i < GameConstants::weapon_count; i++ )
-	{
-		load_stream.ReadUInt8( ammo_[i] );
-		load_stream.ReadBool( have_weapon_[i] );
-	}
+	load_stream.ReadArray( ammo_, GameConstants::weapon_count );
+	load_stream.ReadArray( have_weapon_, GameConstants::weapon_count );
 	load_stream.ReadInt32( armor_ );
 	load_stream.ReadBool( have_red_key_   );
 	load_stream.ReadBool( have_green_key_ );
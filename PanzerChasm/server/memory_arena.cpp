@@ -0,0 +1,56 @@
+#include <cstdint>
+
+#include "../assert.hpp"
+
+#include "memory_arena.hpp"
+
+namespace PanzerChasm
+{
+
+MemoryArena::MemoryArena( const std::size_t block_size )
+	: block_size_( block_size )
+	, current_block_offset_( block_size )
+{}
+
+MemoryArena::~MemoryArena()
+{}
+
+void* MemoryArena::Allocate( const std::size_t size, const std::size_t alignment )
+{
+	PC_ASSERT( alignment != 0u && ( alignment & ( alignment - 1u ) ) == 0u );
+
+	if( !blocks_.empty() )
+	{
+		unsigned char* const block= blocks_.back().get();
+		const std::uintptr_t address= reinterpret_cast<std::uintptr_t>( block + current_block_offset_ );
+		const std::size_t padding= ( alignment - address % alignment ) % alignment;
+
+		if( current_block_offset_ + padding + size <= block_size_ )
+		{
+			void* const result= block + current_block_offset_ + padding;
+			current_block_offset_+= padding + size;
+			return result;
+		}
+	}
+
+	// Large objects get own blocks.
+	if( size + alignment > block_size_ )
+	{
+		unsigned char* const block= new unsigned char[ size + alignment ];
+		large_blocks_.emplace_back( block );
+
+		const std::uintptr_t address= reinterpret_cast<std::uintptr_t>( block );
+		return block + ( alignment - address % alignment ) % alignment;
+	}
+
+	unsigned char* const block= new unsigned char[ block_size_ ];
+	blocks_.emplace_back( block );
+
+	const std::uintptr_t address= reinterpret_cast<std::uintptr_t>( block );
+	const std::size_t padding= ( alignment - address % alignment ) % alignment;
+	current_block_offset_= padding + size;
+
+	return block + padding;
+}
+
+} // namespace PanzerChasm
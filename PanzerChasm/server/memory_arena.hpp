@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace PanzerChasm
+{
+
+// Linear allocator for objects of map.
+// Memory is released only together with arena, so, arena must outlive all objects, allocated in it.
+class MemoryArena final
+{
+public:
+	explicit MemoryArena( std::size_t block_size= 64u * 1024u );
+	MemoryArena( const MemoryArena& other )= delete;
+	~MemoryArena();
+
+	MemoryArena& operator=( const MemoryArena& other )= delete;
+
+	void* Allocate( std::size_t size, std::size_t alignment );
+
+private:
+	const std::size_t block_size_;
+	std::vector< std::unique_ptr<unsigned char[]> > blocks_;
+	std::vector< std::unique_ptr<unsigned char[]> > large_blocks_;
+	std::size_t current_block_offset_;
+};
+
+// Allocator for standard containers and std::allocate_shared. Deallocation does nothing.
+template<class T>
+class ArenaAllocator final
+{
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator( MemoryArena& arena )
+		: arena_( &arena )
+	{}
+
+	template<class U>
+	ArenaAllocator( const ArenaAllocator<U>& other )
+		: arena_( other.GetArena() )
+	{}
+
+	T* allocate( const std::size_t n )
+	{
+		return static_cast<T*>( arena_->Allocate( n * sizeof(T), alignof(T) ) );
+	}
+
+	void deallocate( T* const p, const std::size_t n )
+	{
+		// Memory is released together with arena.
+		(void)p;
+		(void)n;
+	}
+
+	MemoryArena* GetArena() const
+	{
+		return arena_;
+	}
+
+private:
+	MemoryArena* arena_;
+};
+
+template<class T, class U>
+bool operator==( const ArenaAllocator<T>& l, const ArenaAllocator<U>& r )
+{
+	return l.GetArena() == r.GetArena();
+}
+
+template<class T, class U>
+bool operator!=( const ArenaAllocator<T>& l, const ArenaAllocator<U>& r )
+{
+	return l.GetArena() != r.GetArena();
+}
+
+} // namespace PanzerChasm
@@ -96,6 +96,11 @@ static const ShootInfo g_shoot_info[]=
 
 static const m_Vec3 g_see_point_delta( 0.0f, 0.0f, 0.5f );
 
+// Dormant monsters think once in this number of ticks. Phase depends on monster id, so, dormant monsters think in different ticks.
+static const unsigned int g_dormant_think_interval_ticks= 8u;
+// Monsters nearer to some player are never dormant.
+static const float g_dormant_min_distance_to_player= 16.0f;
+
 // Position of aiming on target.
 static const m_Vec3 g_target_shoot_point_delta( 0.0f, 0.0f, 0.5f );
 
@@ -129,6 +134,10 @@ void Monster::Tick(
 	const Time current_time,
 	const Time last_tick_delta )
 {
+	ticks_counter_++;
+	if( ( ticks_counter_ + monster_id ) % g_dormant_think_interval_ticks != 0u && IsDormant( map ) )
+		return;
+
 	const GameResources::MonsterDescription& description= game_resources_->monsters_description[ monster_id_ ];
 	const Model& model= game_resources_->monsters_models[ monster_id_ ];
 
@@ -233,7 +242,7 @@ void Monster::Tick(
 			}
 
 			if( state_ == State::MoveToTarget )
-				MoveToTarget( last_tick_delta_s );
+				MoveToTarget( map, last_tick_delta_s );
 		}
 	}
 		break;
@@ -521,9 +530,9 @@ void Monster::Hit(
 				// Produce simple gibs.
 				// TODO - make more complex gibs.
 				const m_Vec2 z_min_max= GetZMinMax();
-				map.AddParticleEffect(
+				map.SpawnGibs(
 					pos_ + m_Vec3( 0.0f, 0.0f, 0.5f * ( z_min_max.x + z_min_max.y ) ),
-					static_cast<ParticleEffect>( static_cast<unsigned char>(ParticleEffect::FirstBlowEffect) + 72u ) );
+					72u - GameResources::c_first_gib_number );
 
 				SpawnBodyPart( map, BodyPartSubmodelId::Head );
 			}
@@ -544,34 +553,35 @@ void Monster::Hit(
 
 			map.PlayMonsterSound( monster_id, Sound::MonsterSoundId::Death );
 
-			BackpackPtr backpack;
+			Backpack backpack;
+			bool drop_backpack= false;
 			if( is_boss )
 			{
 				// Bosses drops packs with keys.
-				backpack.reset( new Backpack );
-				backpack->red_key= backpack->green_key= backpack->blue_key= true;
+				drop_backpack= true;
+				backpack.red_key= backpack.green_key= backpack.blue_key= true;
 			}
 			else if( monster_id_ == 3u || monster_id_ == 6u )
 			{
 				// Wing-Man and MongF drop shotgun shells and armor.
-				backpack.reset( new Backpack );
-				backpack->ammo[1u]= 5u;
-				backpack->armor= 2u;
+				drop_backpack= true;
+				backpack.ammo[1u]= 5u;
+				backpack.armor= 2u;
 			}
 			else if( monster_id_ == 7u )
 			{
 				// Faust drops armor and grenades.
-				backpack.reset( new Backpack );
-				backpack->ammo[5u]= 3u;
-				backpack->armor= 2u;
+				drop_backpack= true;
+				backpack.ammo[5u]= 3u;
+				backpack.armor= 2u;
 			}
 
-			if( backpack != nullptr )
+			if( drop_backpack )
 			{
 				const m_Vec2 z_minmax= GetZMinMax();
-				backpack->pos= pos_;
-				backpack->pos.z+= ( z_minmax.x + z_minmax.y ) * 0.5f;
-				map.SpawnBackpack( std::move( backpack ) );
+				backpack.pos= pos_;
+				backpack.pos.z+= ( z_minmax.x + z_minmax.y ) * 0.5f;
+				map.SpawnBackpack( backpack );
 			}
 		}
 	}
@@ -678,7 +688,7 @@ bool Monster::IsFinalBoss() const
 
 bool Monster::CanSee( const Map& map, const m_Vec3& pos ) const
 {
-	return map.CanSee( pos_ + g_see_point_delta, pos + g_see_point_delta );
+	return map.CanSeeCached( pos_ + g_see_point_delta, pos + g_see_point_delta );
 }
 
 unsigned int Monster::GetIdleAnimation() const
@@ -724,7 +734,7 @@ void Monster::FallDown( const float time_delta_s )
 	pos_.z+= vertical_speed_ * time_delta_s;
 }
 
-void Monster::MoveToTarget( const float time_delta_s )
+void Monster::MoveToTarget( const Map& map, const float time_delta_s )
 {
 	if( !target_.have_position )
 		return;
@@ -750,7 +760,13 @@ void Monster::MoveToTarget( const float time_delta_s )
 	pos_.x+= std::cos(angle_) * distance_delta;
 	pos_.y+= std::sin(angle_) * distance_delta;
 
-	RotateToTarget( time_delta_s );
+	// Walk around walls, if target is not directly reachable.
+	m_Vec2 navigation_direction;
+	if( target_.have_position && speed_corrected > 0.0f &&
+		map.GetNavigationDirection( pos_.xy(), target_.position.xy(), navigation_direction ) )
+		RotateToDirection( navigation_direction, time_delta_s );
+	else
+		RotateToTarget( time_delta_s );
 }
 
 void Monster::RotateToTarget( float time_delta_s )
@@ -758,11 +774,15 @@ void Monster::RotateToTarget( float time_delta_s )
 	if( !target_.have_position )
 		return;
 
-	const m_Vec2 vec_to_target= target_.position.xy() - pos_.xy();
-	if( vec_to_target.SquareLength() == 0.0f )
+	RotateToDirection( target_.position.xy() - pos_.xy(), time_delta_s );
+}
+
+void Monster::RotateToDirection( const m_Vec2& direction, const float time_delta_s )
+{
+	if( direction.SquareLength() == 0.0f )
 		return;
 
-	const float target_angle= NormalizeAngle( std::atan2( vec_to_target.y, vec_to_target.x ) );
+	const float target_angle= NormalizeAngle( std::atan2( direction.y, direction.x ) );
 	float target_angle_delta= target_angle - angle_;
 	if( target_angle_delta > +Constants::pi )
 		target_angle_delta-= Constants::two_pi;
@@ -786,6 +806,28 @@ void Monster::RotateToTarget( float time_delta_s )
 	}
 }
 
+bool Monster::IsDormant( const Map& map ) const
+{
+	// Process falling monsters each tick, because collisions are processed each tick.
+	if( vertical_speed_ != 0.0f )
+		return false;
+
+	if( state_ == State::Dead )
+		return true;
+	if( state_ != State::Idle )
+		return false;
+
+	for( const Map::PlayersContainer::value_type& player_value : map.GetPlayers() )
+	{
+		PC_ASSERT( player_value.second != nullptr );
+		if( ( player_value.second->Position().xy() - pos_.xy() ).SquareLength() <
+			g_dormant_min_distance_to_player * g_dormant_min_distance_to_player )
+			return false;
+	}
+
+	return true;
+}
+
 bool Monster::SelectTarget( const Map& map )
 {
 	{
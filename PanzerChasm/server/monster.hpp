@@ -77,12 +77,15 @@ private:
 	bool IsFinalBoss() const;
 
 	bool CanSee( const Map& map, const m_Vec3& pos ) const;
+	// Dormant monsters - idle or dead, standing on floor and far from all players. They think not every tick.
+	bool IsDormant( const Map& map ) const;
 
 	unsigned int GetIdleAnimation() const;
 	void DoShoot( const m_Vec3& target_pos, Map& map, EntityId monster_id, Time current_time );
 	void FallDown( float time_delta_s );
-	void MoveToTarget( float time_delta_s );
+	void MoveToTarget( const Map& map, float time_delta_s );
 	void RotateToTarget( float time_delta_s );
+	void RotateToDirection( const m_Vec2& direction, float time_delta_s );
 	bool SelectTarget( const Map& map ); // returns true, if selected
 	int SelectMeleeAttackAnimation();
 	void SpawnBodyPart( Map& map, unsigned char part_id );
@@ -98,6 +101,8 @@ private:
 
 	bool attack_was_done_;
 
+	unsigned int ticks_counter_= 0u;
+
 	struct
 	{
 		EntityId monster_id= 0u;
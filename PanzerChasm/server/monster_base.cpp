@@ -9,6 +9,8 @@
 namespace PanzerChasm
 {
 
+constexpr unsigned int MonsterBase::c_position_history_size;
+
 MonsterBase::MonsterBase(
 	const GameResourcesConstPtr& game_resources,
 	const unsigned char monster_id,
@@ -100,6 +102,11 @@ unsigned char MonsterBase::GetBodyPartsMask() const
 }
 
 bool MonsterBase::TryShot( const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const
+{
+	return TryShotAt( pos_, from, direction_normalized, out_pos );
+}
+
+bool MonsterBase::TryShotAt( const m_Vec3& monster_pos, const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const
 {
 	if( health_ <= 0 )
 		return false;
@@ -109,12 +116,37 @@ bool MonsterBase::TryShot( const m_Vec3& from, const m_Vec3& direction_normalize
 
 	return
 		RayIntersectCylinder(
-			pos_.xy(), description.w_radius,
-			pos_.z + model.z_min, pos_.z + model.z_max,
+			monster_pos.xy(), description.w_radius,
+			monster_pos.z + model.z_min, monster_pos.z + model.z_max,
 			from, direction_normalized,
 			out_pos );
 }
 
+void MonsterBase::RecordPositionHistory( const unsigned int history_tick )
+{
+	if( position_history_empty_ || history_tick != position_history_last_tick_ + 1u )
+	{
+		position_history_first_tick_= history_tick;
+		position_history_empty_= false;
+	}
+	position_history_last_tick_= history_tick;
+
+	PositionToMessagePosition( pos_, position_history_[ history_tick % c_position_history_size ] );
+}
+
+bool MonsterBase::GetHistoryPosition( const unsigned int history_tick, m_Vec3& out_pos ) const
+{
+	// Ticks after last recorded tick give huge age.
+	const unsigned int age= position_history_last_tick_ - history_tick;
+	if( position_history_empty_ ||
+		age > position_history_last_tick_ - position_history_first_tick_ ||
+		age >= c_position_history_size )
+		return false;
+
+	MessagePositionToPosition( position_history_[ history_tick % c_position_history_size ], out_pos );
+	return true;
+}
+
 void MonsterBase::SetMovementRestriction( const MovementRestriction& restriction )
 {
 	movement_restriction_= restriction;
@@ -42,6 +42,15 @@ public:
 	unsigned char GetBodyPartsMask() const;
 
 	bool TryShot( const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const;
+	// Same, but monster is placed at given position.
+	bool TryShotAt( const m_Vec3& monster_pos, const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const;
+
+	// Positions of last map ticks, for lag compensation of shots.
+	// Ticks are numbered by map. Tick, which is not next after last recorded tick, starts new history.
+	static constexpr unsigned int c_position_history_size= 64u;
+	void RecordPositionHistory( unsigned int history_tick );
+	// Returns false, if position for this tick is not recorded.
+	bool GetHistoryPosition( unsigned int history_tick, m_Vec3& out_pos ) const;
 
 	void SetMovementRestriction( const MovementRestriction& restriction );
 	const MovementRestriction& GetMovementRestriction() const;
@@ -148,6 +157,12 @@ protected:
 	unsigned int current_animation_frame_= 0u;
 
 	MovementRestriction movement_restriction_;
+
+	// Quantized, like positions in messages, for compactness. Clients see positions with same precision.
+	Messages::CoordType position_history_[ c_position_history_size ][3];
+	unsigned int position_history_first_tick_= 0u;
+	unsigned int position_history_last_tick_= 0u;
+	bool position_history_empty_= true;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,62 @@
+#include <cmath>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "../game_resources.hpp"
+#include "monster_base.hpp"
+
+#include "monsters_index.hpp"
+
+namespace PanzerChasm
+{
+
+MonstersIndex::MonstersIndex()
+{
+	for( unsigned short& i : index_field_ )
+		i= IndexElement::c_dummy_next;
+}
+
+MonstersIndex::~MonstersIndex()
+{}
+
+void MonstersIndex::Rebuild( const MonstersContainer& monsters, const GameResources& game_resources )
+{
+	for( unsigned short& i : index_field_ )
+		i= IndexElement::c_dummy_next;
+	index_elements_.clear();
+	max_monster_radius_= 0.0f;
+
+	PC_ASSERT( monsters.size() < IndexElement::c_dummy_next );
+
+	for( const MonstersContainer::value_type& monster_value : monsters )
+	{
+		MonsterBase& monster= *monster_value.second;
+
+		const float monster_radius=
+			monster.MonsterId() == 0u
+				? GameConstants::player_radius
+				: game_resources.monsters_description[ monster.MonsterId() ].w_radius;
+		max_monster_radius_= std::max( max_monster_radius_, monster_radius );
+
+		const unsigned int cell_index=
+			GetCellCoord( monster.Position().x ) +
+			GetCellCoord( monster.Position().y ) * int(c_size);
+
+		IndexElement element;
+		element.monster= &monster;
+		element.monster_id= monster_value.first;
+		element.next= index_field_[ cell_index ];
+
+		index_field_[ cell_index ]= static_cast<unsigned short>( index_elements_.size() );
+		index_elements_.push_back( element );
+	}
+}
+
+int MonstersIndex::GetCellCoord( const float coord )
+{
+	// Monsters outside map are placed into border cells.
+	const int cell= static_cast<int>( std::floor( coord ) ) >> int(c_cell_size_log2);
+	return std::max( 0, std::min( cell, int(c_size - 1u) ) );
+}
+
+} // namespace PanzerChasm
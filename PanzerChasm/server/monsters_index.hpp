@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+
+#include "../entities_container.hpp"
+#include "../fwd.hpp"
+#include "../map_loader.hpp"
+#include "../math_utils.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Uniform grid of monsters (and players), for optimization of shots and explosions.
+// Each monster is placed into cell of its center. Fetch functions extend query by radius of biggest monster.
+// Index is not updated automatically - rebuild it, when monsters positions are changed.
+// Fetch functions may return monsters, which are not actually in query area.
+class MonstersIndex final
+{
+public:
+	MonstersIndex();
+	~MonstersIndex();
+
+	typedef EntitiesContainer<MonsterBasePtr> MonstersContainer;
+
+	void Rebuild( const MonstersContainer& monsters, const GameResources& game_resources );
+
+	// Func( EntityId monster_id, MonsterBase& monster )
+	template<class Func>
+	void ProcessMonstersInRadius(
+		const m_Vec2& pos, float radius,
+		const Func& func ) const;
+
+	// Fetch monsters near ray. Func( EntityId monster_id, MonsterBase& monster )
+	// Extra radius allows to fetch monsters, which are tested at positions other, than indexed.
+	template<class Func>
+	void RayCast(
+		const m_Vec3& pos, const m_Vec3& dir_normalized,
+		const Func& func,
+		float max_cast_distance= Constants::max_float,
+		float extra_radius= 0.0f ) const;
+
+private:
+	static constexpr unsigned int c_cell_size_log2= 2u;
+	static constexpr unsigned int c_cell_size= 1u << c_cell_size_log2;
+	static constexpr unsigned int c_size= MapData::c_map_size >> c_cell_size_log2;
+
+	struct IndexElement
+	{
+		MonsterBase* monster;
+		EntityId monster_id;
+		unsigned short next; // Index of next element in this linked list.
+
+		static constexpr unsigned short c_dummy_next= 0xFFFFu;
+	};
+
+private:
+	static int GetCellCoord( float coord );
+
+	template<class Func>
+	void ProcessCell( unsigned int cell_index, const Func& func ) const;
+
+private:
+	// Linked lists data.
+	std::vector<IndexElement> index_elements_;
+
+	// Linked lists heads.
+	unsigned short index_field_[ c_size * c_size ];
+
+	float max_monster_radius_= 0.0f;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,87 @@
+#pragma once
+#include <cmath>
+
+#include "../assert.hpp"
+#include "monsters_index.hpp"
+
+namespace PanzerChasm
+{
+
+template<class Func>
+void MonstersIndex::ProcessMonstersInRadius(
+	const m_Vec2& pos, const float radius,
+	const Func& func ) const
+{
+	const float radius_extended= radius + max_monster_radius_;
+
+	const int x_start= GetCellCoord( pos.x - radius_extended );
+	const int x_end  = GetCellCoord( pos.x + radius_extended );
+	const int y_start= GetCellCoord( pos.y - radius_extended );
+	const int y_end  = GetCellCoord( pos.y + radius_extended );
+
+	for( int y= y_start; y <= y_end; y++ )
+	for( int x= x_start; x <= x_end; x++ )
+		ProcessCell( x + y * int(c_size), func );
+}
+
+template<class Func>
+void MonstersIndex::RayCast(
+	const m_Vec3& pos, const m_Vec3& dir_normalized,
+	const Func& func,
+	const float max_cast_distance,
+	const float extra_radius ) const
+{
+	// Whole map is smaller, than this distance.
+	const float end_distance_xy=
+		std::min(
+			max_cast_distance * dir_normalized.xy().Length(),
+			float( MapData::c_map_size * 2u ) );
+
+	m_Vec2 dir_xy= dir_normalized.xy();
+	if( end_distance_xy > 0.0f )
+		dir_xy.Normalize();
+
+	// Sample ray with step of half of cell. Monster, intersected by ray, is near to one of samples.
+	const float c_step= float(c_cell_size) * 0.5f;
+	const float radius_extended= max_monster_radius_ + extra_radius + c_step * 0.5f;
+
+	bool cells_processed[ c_size * c_size ]= { false };
+
+	const unsigned int sample_count= static_cast<unsigned int>( std::ceil( end_distance_xy / c_step ) ) + 1u;
+	for( unsigned int i= 0u; i < sample_count; i++ )
+	{
+		const m_Vec2 sample_pos= pos.xy() + dir_xy * std::min( float(i) * c_step, end_distance_xy );
+
+		const int x_start= GetCellCoord( sample_pos.x - radius_extended );
+		const int x_end  = GetCellCoord( sample_pos.x + radius_extended );
+		const int y_start= GetCellCoord( sample_pos.y - radius_extended );
+		const int y_end  = GetCellCoord( sample_pos.y + radius_extended );
+
+		for( int y= y_start; y <= y_end; y++ )
+		for( int x= x_start; x <= x_end; x++ )
+		{
+			const unsigned int cell_index= x + y * int(c_size);
+			if( cells_processed[ cell_index ] )
+				continue;
+
+			cells_processed[ cell_index ]= true;
+			ProcessCell( cell_index, func );
+		}
+	}
+}
+
+template<class Func>
+void MonstersIndex::ProcessCell( const unsigned int cell_index, const Func& func ) const
+{
+	unsigned short i= index_field_[ cell_index ];
+	while( i != IndexElement::c_dummy_next )
+	{
+		PC_ASSERT( i < index_elements_.size() );
+		const IndexElement& element= index_elements_[i];
+
+		func( element.monster_id, *element.monster );
+		i= element.next;
+	}
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "collision_index.inl"
+
+#include "navigation_grid.hpp"
+
+namespace PanzerChasm
+{
+
+// Orthogonal directions first - for more straight ways.
+static const int g_directions_offsets[8][2]=
+{
+	{ +1,  0 }, {  0, +1 }, { -1,  0 }, {  0, -1 },
+	{ +1, +1 }, { -1, +1 }, { -1, -1 }, { +1, -1 },
+};
+
+static unsigned int GetOppositeDirection( const unsigned int direction )
+{
+	return direction < 4u ? ( ( direction + 2u ) & 3u ) : ( 4u + ( ( direction - 4u + 2u ) & 3u ) );
+}
+
+static bool SegmentsIntersects( const m_Vec2& a0, const m_Vec2& a1, const m_Vec2& b0, const m_Vec2& b1 )
+{
+	const m_Vec2 a_vec= a1 - a0;
+	const m_Vec2 b_vec= b1 - b0;
+
+	const float b0_side= mVec2Cross( a_vec, b0 - a0 );
+	const float b1_side= mVec2Cross( a_vec, b1 - a0 );
+	if( ( b0_side > 0.0f && b1_side > 0.0f ) || ( b0_side < 0.0f && b1_side < 0.0f ) )
+		return false;
+
+	const float a0_side= mVec2Cross( b_vec, a0 - b0 );
+	const float a1_side= mVec2Cross( b_vec, a1 - b0 );
+	if( ( a0_side > 0.0f && a1_side > 0.0f ) || ( a0_side < 0.0f && a1_side < 0.0f ) )
+		return false;
+
+	return true;
+}
+
+NavigationGrid::NavigationGrid( const MapData& map_data, const CollisionIndex& collision_index )
+{
+	const int c_map_size= int(MapData::c_map_size);
+
+	for( int y= 0; y < c_map_size; y++ )
+	for( int x= 0; x < c_map_size; x++ )
+	{
+		const m_Vec2 cell_center( float(x) + 0.5f, float(y) + 0.5f );
+
+		unsigned char& directions= walkable_directions_[ x + y * c_map_size ];
+		directions= 0u;
+
+		for( unsigned int d= 0u; d < 4u; d++ )
+		{
+			const int neighbor_x= x + g_directions_offsets[d][0];
+			const int neighbor_y= y + g_directions_offsets[d][1];
+			if( neighbor_x < 0 || neighbor_x >= c_map_size ||
+				neighbor_y < 0 || neighbor_y >= c_map_size )
+				continue;
+
+			const m_Vec2 neighbor_center( float(neighbor_x) + 0.5f, float(neighbor_y) + 0.5f );
+
+			bool blocked= false;
+			collision_index.ProcessElementsInRadius(
+				( cell_center + neighbor_center ) * 0.5f, 0.5f,
+				[&]( const MapData::IndexElement& element )
+				{
+					if( blocked || element.type != MapData::IndexElement::StaticWall )
+						return;
+
+					const MapData::Wall& wall= map_data.static_walls[ element.index ];
+					if( map_data.walls_textures[ wall.texture_id ].gso[0] )
+						return;
+
+					// Same rule, as in map collisions - opaque walls are not collidable from back side.
+					if( wall.texture_id < MapData::c_first_transparent_texture_id &&
+						mVec2Cross( cell_center - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
+						return;
+
+					if( SegmentsIntersects( cell_center, neighbor_center, wall.vert_pos[0], wall.vert_pos[1] ) )
+						blocked= true;
+				} );
+
+			if( !blocked )
+				directions|= 1u << d;
+		}
+	}
+
+	// Diagonal movement is possible only if both orthogonal ways are free. Do not cut corners.
+	for( int y= 0; y < c_map_size; y++ )
+	for( int x= 0; x < c_map_size; x++ )
+	{
+		unsigned char& directions= walkable_directions_[ x + y * c_map_size ];
+		for( unsigned int d= 4u; d < 8u; d++ )
+		{
+			const int dx= g_directions_offsets[d][0];
+			const int dy= g_directions_offsets[d][1];
+			const unsigned int x_direction= dx > 0 ? 0u : 2u;
+			const unsigned int y_direction= dy > 0 ? 1u : 3u;
+
+			if( ( directions & ( 1u << x_direction ) ) == 0u ||
+				( directions & ( 1u << y_direction ) ) == 0u )
+				continue;
+
+			const unsigned char x_neighbor_directions= walkable_directions_[ ( x + dx ) + y * c_map_size ];
+			const unsigned char y_neighbor_directions= walkable_directions_[ x + ( y + dy ) * c_map_size ];
+			if( ( x_neighbor_directions & ( 1u << y_direction ) ) != 0u &&
+				( y_neighbor_directions & ( 1u << x_direction ) ) != 0u )
+				directions|= 1u << d;
+		}
+	}
+}
+
+NavigationGrid::~NavigationGrid()
+{}
+
+bool NavigationGrid::GetCell( const m_Vec2& pos, unsigned int& out_cell )
+{
+	const int x= static_cast<int>( std::floor( pos.x ) );
+	const int y= static_cast<int>( std::floor( pos.y ) );
+	if( x < 0 || x >= int(MapData::c_map_size) ||
+		y < 0 || y >= int(MapData::c_map_size) )
+		return false;
+
+	out_cell= static_cast<unsigned int>( x + y * int(MapData::c_map_size) );
+	return true;
+}
+
+bool NavigationGrid::IsPathFree( const m_Vec2& from, const m_Vec2& to ) const
+{
+	unsigned int from_cell, to_cell;
+	if( !GetCell( from, from_cell ) || !GetCell( to, to_cell ) )
+		return true;
+
+	int x= from_cell % MapData::c_map_size;
+	int y= from_cell / MapData::c_map_size;
+	const int end_x= to_cell % MapData::c_map_size;
+	const int end_y= to_cell / MapData::c_map_size;
+
+	const m_Vec2 dir= to - from;
+	const int step_x= dir.x > 0.0f ? 1 : -1;
+	const int step_y= dir.y > 0.0f ? 1 : -1;
+	const float t_delta_x= dir.x != 0.0f ? std::abs( 1.0f / dir.x ) : Constants::max_float;
+	const float t_delta_y= dir.y != 0.0f ? std::abs( 1.0f / dir.y ) : Constants::max_float;
+	float t_next_x= dir.x > 0.0f ? ( float(x + 1) - from.x ) / dir.x : dir.x < 0.0f ? ( float(x) - from.x ) / dir.x : Constants::max_float;
+	float t_next_y= dir.y > 0.0f ? ( float(y + 1) - from.y ) / dir.y : dir.y < 0.0f ? ( float(y) - from.y ) / dir.y : Constants::max_float;
+
+	// Walk cells along segment, check borders between them.
+	const unsigned int max_steps= MapData::c_map_size * 2u;
+	for( unsigned int i= 0u; i < max_steps && !( x == end_x && y == end_y ); i++ )
+	{
+		unsigned int direction;
+		if( t_next_x < t_next_y )
+		{
+			direction= step_x > 0 ? 0u : 2u;
+			t_next_x+= t_delta_x;
+		}
+		else
+		{
+			direction= step_y > 0 ? 1u : 3u;
+			t_next_y+= t_delta_y;
+		}
+
+		if( ( walkable_directions_[ x + y * int(MapData::c_map_size) ] & ( 1u << direction ) ) == 0u )
+			return false;
+
+		x+= g_directions_offsets[direction][0];
+		y+= g_directions_offsets[direction][1];
+		if( x < 0 || x >= int(MapData::c_map_size) || y < 0 || y >= int(MapData::c_map_size) )
+			return true;
+	}
+
+	return true;
+}
+
+void NavigationGrid::BuildFlowField( const unsigned int target_cell, FlowField& out_field ) const
+{
+	PC_ASSERT( target_cell < MapData::c_map_size * MapData::c_map_size );
+
+	out_field.target_cell= target_cell;
+	std::memset( out_field.directions, c_no_direction, sizeof(out_field.directions) );
+	out_field.directions[ target_cell ]= c_target_direction;
+
+	unsigned short queue[ MapData::c_map_size * MapData::c_map_size ];
+	unsigned int queue_start= 0u, queue_end= 0u;
+	queue[ queue_end++ ]= target_cell;
+
+	while( queue_start < queue_end )
+	{
+		const unsigned int cell= queue[ queue_start++ ];
+		const int x= cell % MapData::c_map_size;
+		const int y= cell / MapData::c_map_size;
+
+		for( unsigned int d= 0u; d < 8u; d++ )
+		{
+			const int neighbor_x= x + g_directions_offsets[d][0];
+			const int neighbor_y= y + g_directions_offsets[d][1];
+			if( neighbor_x < 0 || neighbor_x >= int(MapData::c_map_size) ||
+				neighbor_y < 0 || neighbor_y >= int(MapData::c_map_size) )
+				continue;
+
+			const unsigned int neighbor_cell= neighbor_x + neighbor_y * int(MapData::c_map_size);
+			if( out_field.directions[ neighbor_cell ] != c_no_direction )
+				continue;
+
+			// Monster moves from neighbor to this cell.
+			const unsigned int back_direction= GetOppositeDirection(d);
+			if( ( walkable_directions_[ neighbor_cell ] & ( 1u << back_direction ) ) == 0u )
+				continue;
+
+			out_field.directions[ neighbor_cell ]= back_direction;
+			queue[ queue_end++ ]= neighbor_cell;
+		}
+	}
+}
+
+bool NavigationGrid::GetFlowDirection( const FlowField& field, const m_Vec2& pos, m_Vec2& out_direction )
+{
+	unsigned int cell;
+	if( !GetCell( pos, cell ) )
+		return false;
+
+	const unsigned char direction= field.directions[ cell ];
+	if( direction == c_no_direction || direction == c_target_direction )
+		return false;
+
+	const m_Vec2 next_cell_center(
+		float( int( cell % MapData::c_map_size ) + g_directions_offsets[direction][0] ) + 0.5f,
+		float( int( cell / MapData::c_map_size ) + g_directions_offsets[direction][1] ) + 0.5f );
+
+	out_direction= next_cell_center - pos;
+	return true;
+}
+
+} // namespace PanzerChasm
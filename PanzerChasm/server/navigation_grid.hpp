@@ -0,0 +1,45 @@
+#pragma once
+#include "../map_loader.hpp"
+#include "collision_index.hpp"
+
+namespace PanzerChasm
+{
+
+// Coarse navigation grid for monsters, built from static walls of map.
+// Each cell of map knows, in which of 8 neighbor cells monster can walk from it.
+// Dynamic walls and models are ignored - monsters collide with them as usual.
+class NavigationGrid final
+{
+public:
+	static constexpr unsigned char c_no_direction= 0xFFu;
+	static constexpr unsigned char c_target_direction= 0xFEu;
+
+	// Directions to next cell on shortest way to target, for each cell.
+	struct FlowField
+	{
+		unsigned int target_cell;
+		unsigned char directions[ MapData::c_map_size * MapData::c_map_size ];
+	};
+
+	NavigationGrid( const MapData& map_data, const CollisionIndex& collision_index );
+	~NavigationGrid();
+
+	// Returns false, if position outside map.
+	static bool GetCell( const m_Vec2& pos, unsigned int& out_cell );
+
+	// Returns true, if straight way between points does not cross any not walkable cells border.
+	bool IsPathFree( const m_Vec2& from, const m_Vec2& to ) const;
+
+	// Breadth-first search from target cell. Cost - O(map cells).
+	void BuildFlowField( unsigned int target_cell, FlowField& out_field ) const;
+
+	// Returns vector from position to center of next cell on way.
+	// Returns false, if target is unreachable or position is inside target cell.
+	static bool GetFlowDirection( const FlowField& field, const m_Vec2& pos, m_Vec2& out_direction );
+
+private:
+	// Bit for each direction, where it is possible to walk.
+	unsigned char walkable_directions_[ MapData::c_map_size * MapData::c_map_size ];
+};
+
+} // namespace PanzerChasm
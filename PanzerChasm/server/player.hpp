@@ -69,6 +69,8 @@ public:
 
 	void OnMapChange();
 	void UpdateMovement( const Messages::PlayerMove& move_message );
+	// Returns false, if client does not know, which server time it shows.
+	bool GetViewServerTimeMs( unsigned int& out_time_ms ) const;
 
 	void SetNoclip( bool noclip );
 	bool IsNoclip() const;
@@ -138,6 +140,11 @@ private:
 	float mevement_acceleration_= 0.0f;
 	float movement_direction_= 0.0f;
 	bool jump_pessed_= false;
+	unsigned short last_move_sequence_= 0u;
+
+	// Server time of entities, shown by client, from last move message. Used for lag compensation.
+	unsigned int view_server_time_ms_= 0u;
+	bool view_server_time_valid_= false;
 
 	State state_= State::Alive;
 	Time last_state_change_time_= Time::FromSeconds(0);
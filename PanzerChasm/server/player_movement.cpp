@@ -0,0 +1,133 @@
+#include <cmath>
+
+#include "../game_constants.hpp"
+
+#include "player_movement.hpp"
+
+namespace PanzerChasm
+{
+
+bool MovePlayer(
+	const PlayerMovementInput& input,
+	const bool alive, const bool noclip, const bool on_floor,
+	const Time time_delta,
+	m_Vec3& pos, m_Vec3& speed )
+{
+	const float time_delta_s= time_delta.ToSeconds();
+
+	// TODO - calibrate this
+	const float c_acceleration= 40.0f;
+	const float c_deceleration= 20.0f;
+	const float c_jump_speed_delta= 2.9f;
+
+	const float speed_delta= time_delta_s * input.acceleration * c_acceleration;
+	const float deceleration_speed_delta= time_delta_s * c_deceleration;
+
+	// Accelerate
+	m_Vec2 acceleration( 0.0f, 0.0f );
+	if( alive )
+	{
+		acceleration.x= std::cos( input.direction ) * speed_delta;
+		acceleration.y= std::sin( input.direction ) * speed_delta;
+	}
+
+	// Decelerate
+	const float new_speed_length= speed.xy().Length();
+	if( new_speed_length >= deceleration_speed_delta )
+	{
+		const float k= ( new_speed_length - deceleration_speed_delta ) / new_speed_length;
+		speed.x*= k;
+		speed.y*= k;
+	}
+	else
+		speed.x= speed.y= 0.0f;
+
+	const m_Vec2 current_speed_xy= speed.xy();
+	const float acceleration_projection_to_current_speed= acceleration * current_speed_xy;
+	if( acceleration_projection_to_current_speed > 0.0f )
+	{
+		const float max_square_speed= GameConstants::player_max_speed * GameConstants::player_max_speed;
+
+		const float current_speed_square_length= current_speed_xy.SquareLength();
+		const m_Vec2 acceleration_projection= current_speed_xy * ( acceleration_projection_to_current_speed / current_speed_square_length );
+		const m_Vec2 acceleration_orthogonal= acceleration - acceleration_projection;
+
+		// If speed greater, then maximal speed by player, just add only orthogonal to current speed aceleration part.
+		if( current_speed_square_length >= max_square_speed )
+		{
+			speed.x+= acceleration_orthogonal.x;
+			speed.y+= acceleration_orthogonal.y;
+		}
+		else
+		{
+			// Extend current speed as much, as can and add orthogonal ecceleration component.
+			m_Vec2 speed_plus_acceleration_projection= current_speed_xy + acceleration_projection;
+			const float speed_plus_acceleration_projection_squar_length= speed_plus_acceleration_projection.SquareLength();
+			if( speed_plus_acceleration_projection_squar_length > max_square_speed )
+				speed_plus_acceleration_projection*=
+					GameConstants::player_max_speed / std::sqrt( speed_plus_acceleration_projection_squar_length );
+
+			speed.x= speed_plus_acceleration_projection.x + acceleration_orthogonal.x;
+			speed.y= speed_plus_acceleration_projection.y + acceleration_orthogonal.y;
+		}
+	}
+	else
+	{
+		speed.x+= acceleration.x;
+		speed.y+= acceleration.y;
+	}
+
+	// If speed is veery hight - clamp it.
+	const float new_speed_square_length= speed.xy().SquareLength();
+	if( new_speed_square_length > GameConstants::player_max_absolute_speed * GameConstants::player_max_absolute_speed )
+	{
+		const float k= GameConstants::player_max_absolute_speed / std::sqrt( new_speed_square_length );
+		speed.x*= k;
+		speed.y*= k;
+	}
+
+	// Fall down
+	speed.z+= GameConstants::vertical_acceleration * time_delta_s;
+
+	bool jumped= false;
+
+	// Jump
+	if( alive )
+	{
+		if( input.jump_pressed && noclip )
+			speed.z-= 2.0f * GameConstants::vertical_acceleration * time_delta_s;
+		else if( input.jump_pressed && on_floor && speed.z <= 0.0f )
+		{
+			jumped= true;
+			speed.z+= c_jump_speed_delta;
+		}
+	}
+
+	// Clamp vertical speed
+	if( std::abs( speed.z ) > GameConstants::max_vertical_speed )
+		speed.z*= GameConstants::max_vertical_speed / std::abs( speed.z );
+
+	pos+= speed * time_delta_s;
+
+	if( noclip && pos.z < 0.0f )
+	{
+		pos.z= 0.0f;
+		speed.z= 0.0f;
+	}
+	return jumped;
+}
+
+void ClampPlayerSpeed( const m_Vec3& clamp_surface_normal, m_Vec3& speed )
+{
+	const float projection= clamp_surface_normal * speed;
+	if( projection < 0.0f )
+		speed-= clamp_surface_normal * projection;
+}
+
+void SetPlayerOnFloor( const bool on_floor, m_Vec3& speed )
+{
+	if( on_floor && speed.z < 0.0f )
+		speed.z= 0.0f;
+}
+
+} // namespace PanzerChasm
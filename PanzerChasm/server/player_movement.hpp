@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vec.hpp>
+
+#include "../time.hpp"
+
+namespace PanzerChasm
+{
+
+// Player movement physics.
+// Shared between server player and client movement prediction, so, client predicts same movement, as server calculates.
+
+struct PlayerMovementInput
+{
+	float acceleration= 0.0f; // 0 - stay, 1 - run
+	float direction= 0.0f;
+	bool jump_pressed= false;
+};
+
+// Accelerates player and moves it without collisions. Returns true, if jumped.
+bool MovePlayer(
+	const PlayerMovementInput& input,
+	bool alive, bool noclip, bool on_floor,
+	Time time_delta,
+	m_Vec3& pos, m_Vec3& speed );
+
+// Removes speed component, directed into surface.
+void ClampPlayerSpeed( const m_Vec3& clamp_surface_normal, m_Vec3& speed );
+
+void SetPlayerOnFloor( bool on_floor, m_Vec3& speed );
+
+} // namespace PanzerChasm
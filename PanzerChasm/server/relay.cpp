@@ -0,0 +1,490 @@
+#include <cstdio>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "../log.hpp"
+#include "../messages_extractor.inl"
+
+#include "relay.hpp"
+
+namespace PanzerChasm
+{
+
+static const unsigned int g_max_spectators= 1024u;
+
+// Same, as on server map.
+static const unsigned int g_unchanged_entities_resend_period= 32u;
+
+// Nonzero health of spectator hides body of followed player from spectator camera.
+static const unsigned char g_spectator_health= 100u;
+
+template<class Message>
+static void StoreIndexedMessage( std::vector<Message>& messages, const unsigned int index, const Message& message )
+{
+	if( index >= messages.size() )
+	{
+		const unsigned int prev_size= messages.size();
+		messages.resize( index + 1u );
+		for( unsigned int i= prev_size; i < messages.size(); i++ )
+			messages[i].message_id= MessageId::Unknown; // Not received yet.
+	}
+
+	messages[ index ]= message;
+}
+
+// Send messages, which differ from baseline, and update baseline.
+// Unchanged messages are resent once per "resend_period" updates. Messages, not received yet, are skipped.
+template<class Message>
+static void SendChangedMessages(
+	MessagesSender& messages_sender,
+	const std::vector<Message>& messages,
+	std::vector<Message>& baseline_messages,
+	const unsigned int update_number,
+	const unsigned int resend_period )
+{
+	// Send all messages, if baseline is empty.
+	const bool baseline_valid= baseline_messages.size() == messages.size();
+	baseline_messages.resize( messages.size() );
+
+	for( unsigned int i= 0u; i < messages.size(); i++ )
+	{
+		const Message& message= messages[i];
+		Message& baseline_message= baseline_messages[i];
+		if( message.message_id == MessageId::Unknown )
+			continue;
+
+		if( !baseline_valid ||
+			std::memcmp( &message, &baseline_message, sizeof(Message) ) != 0 ||
+			( i + update_number ) % resend_period == 0u )
+		{
+			baseline_message= message;
+			messages_sender.SendUnreliableMessage( message );
+		}
+	}
+}
+
+void Relay::UpdateMessagesBaseline::Clear()
+{
+	walls.clear();
+	static_models.clear();
+	items.clear();
+	update_number= 0u;
+}
+
+Relay::Spectator::Spectator( const IConnectionPtr& connection )
+	: connection_info( connection )
+{}
+
+Relay::Relay(
+	const IConnectionPtr& server_connection,
+	const char* const password,
+	const IConnectionsListenerPtr& spectators_listener )
+	: server_connection_info_( server_connection )
+	, spectators_listener_( spectators_listener )
+{
+	PC_ASSERT( server_connection != nullptr );
+	PC_ASSERT( spectators_listener_ != nullptr );
+
+	Messages::RelayJoin message;
+	std::snprintf( message.password, sizeof(message.password), "%s", password );
+	server_connection_info_.messages_sender.SendReliableMessage( message );
+	server_connection_info_.messages_sender.Flush();
+
+	std::memset( server_state_message_.frags, 0, sizeof(server_state_message_.frags) );
+	server_state_message_.map_time_s= 0u;
+	server_state_message_.server_time_ms= 0u;
+	server_state_message_.player_count= 0u;
+	server_state_message_.game_rules= GameRules::Deathmatch;
+}
+
+Relay::~Relay()
+{}
+
+bool Relay::Loop()
+{
+	// Receive world state from server.
+	server_connection_info_.messages_extractor.ProcessMessages( *this );
+
+	if( server_connection_info_.messages_extractor.IsBroken() )
+	{
+		Log::Warning( "Messages from server was broken" );
+		server_connection_info_.connection->Disconnect();
+	}
+	if( server_connection_info_.connection->Disconnected() )
+	{
+		Log::Info( "Relay disconnected from server" );
+		return false;
+	}
+
+	spectators_listener_->PollEvents();
+
+	// Disconnect spectators.
+	for( unsigned int s= 0u; s < spectators_.size(); )
+	{
+		SpectatorPtr& spectator= spectators_[s];
+
+		if( spectator->connection_info.messages_extractor.IsBroken() )
+		{
+			Log::Info( "Messages from spectator \"", spectator->connection_info.connection->GetConnectionInfo(), "\" was broken" );
+			spectator->connection_info.connection->Disconnect();
+		}
+
+		if( spectator->connection_info.connection->Disconnected() )
+		{
+			Log::Info( "Spectator \"", spectator->connection_info.connection->GetConnectionInfo(), "\" disconnected from relay" );
+			if( s < spectators_.size() - 1u )
+				spectator= std::move( spectators_.back() );
+			spectators_.pop_back();
+		}
+		else
+			s++;
+	}
+
+	// Receive spectators messages.
+	for( const SpectatorPtr& spectator : spectators_ )
+	{
+		current_spectator_= spectator.get();
+		current_spectator_->connection_info.messages_extractor.ProcessMessages( *this );
+		current_spectator_= nullptr;
+	}
+
+	// Resend update of server only once, even if many updates received in this loop.
+	// Events of all received updates are accumulated, for states only last values are sent.
+	if( update_received_ )
+	{
+		for( const SpectatorPtr& spectator : spectators_ )
+			SendUpdate( *spectator );
+
+		events_.Clear();
+		update_received_= false;
+	}
+
+	// Accept new spectators after sending of update, because events of update are already applied to world state.
+	while( const IConnectionPtr connection= spectators_listener_->GetNewConnection() )
+	{
+		if( spectators_.size() >= g_max_spectators )
+		{
+			connection->Disconnect();
+			continue;
+		}
+
+		Log::Info( "Spectator \"", connection->GetConnectionInfo(), "\" connected to relay" );
+
+		spectators_.emplace_back( new Spectator( connection ) );
+		SendWorldStateForNewSpectator( *spectators_.back() );
+	}
+
+	spectators_listener_->SendQueuedPackets();
+
+	return true;
+}
+
+void Relay::DisconnectAllSpectators()
+{
+	for( const SpectatorPtr& spectator : spectators_ )
+		spectator->connection_info.connection->Disconnect();
+
+	spectators_.clear();
+	server_connection_info_.connection->Disconnect();
+}
+
+void Relay::operator()( const Messages::MessageBase& message )
+{
+	Log::Warning( "Unknown message for relay: ", int(message.message_id) );
+}
+
+void Relay::operator()( const Messages::ServerState& message )
+{
+	server_state_message_= message;
+	update_received_= true;
+}
+
+void Relay::operator()( const Messages::MonsterState& message )
+{
+	const auto it= monsters_.find( message.monster_id );
+	if( it != monsters_.end() )
+		it->second= message;
+}
+
+void Relay::operator()( const Messages::WallPosition& message )
+{
+	StoreIndexedMessage( walls_, message.wall_index, message );
+}
+
+void Relay::operator()( const Messages::ItemState& message )
+{
+	StoreIndexedMessage( items_, message.item_index, message );
+}
+
+void Relay::operator()( const Messages::StaticModelState& message )
+{
+	StoreIndexedMessage( static_models_, message.static_model_index, message );
+}
+
+void Relay::operator()( const Messages::RocketState& message )
+{
+	const auto it= rockets_.find( message.rocket_id );
+	if( it == rockets_.end() )
+		return;
+
+	// Copy only fields of state, birth message must keep own id.
+	std::memcpy( it->second.xyz, message.xyz, sizeof(message.xyz) );
+	std::memcpy( it->second.angle, message.angle, sizeof(message.angle) );
+}
+
+void Relay::operator()( const Messages::RocketBirth& message )
+{
+	rockets_[ message.rocket_id ]= message;
+	events_.AddUnreliableMessage( message );
+}
+
+void Relay::operator()( const Messages::RocketDeath& message )
+{
+	rockets_.erase( message.rocket_id );
+	events_.AddUnreliableMessage( message );
+}
+
+void Relay::operator()( const Messages::DynamicItemBirth& message )
+{
+	dynamic_items_[ message.item_id ]= message;
+	events_.AddUnreliableMessage( message );
+}
+
+void Relay::operator()( const Messages::DynamicItemUpdate& message )
+{
+	const auto it= dynamic_items_.find( message.item_id );
+	if( it != dynamic_items_.end() )
+		std::memcpy( it->second.xyz, message.xyz, sizeof(message.xyz) );
+
+	events_.AddUnreliableMessage( message );
+}
+
+void Relay::operator()( const Messages::DynamicItemDeath& message )
+{
+	dynamic_items_.erase( message.item_id );
+	events_.AddUnreliableMessage( message );
+}
+
+void Relay::operator()( const Messages::LightSourceBirth& message )
+{
+	light_sources_[ message.light_source_id ]= message;
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::LightSourceDeath& message )
+{
+	light_sources_.erase( message.light_source_id );
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::RotatingLightSourceBirth& message )
+{
+	rotating_light_sources_[ message.light_source_id ]= message;
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::RotatingLightSourceDeath& message )
+{
+	rotating_light_sources_.erase( message.light_source_id );
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::MapChange& message )
+{
+	Log::Info( "Relay map changed to ", message.map_number );
+
+	ClearWorldState();
+
+	have_map_= true;
+	map_change_message_= message;
+	map_change_message_.need_play_cutscene= false;
+
+	// Send map change immediately. Births of entities of new map follows it in events.
+	for( const SpectatorPtr& spectator : spectators_ )
+	{
+		spectator->connection_info.messages_sender.SendReliableMessage( map_change_message_ );
+		spectator->update_messages_baseline.Clear();
+		spectator->followed_player_monster_id= 0u;
+	}
+}
+
+void Relay::operator()( const Messages::MonsterBirth& message )
+{
+	monsters_[ message.monster_id ]= message.initial_state;
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::MonsterDeath& message )
+{
+	monsters_.erase( message.monster_id );
+	events_.AddReliableMessage( message );
+}
+
+void Relay::operator()( const Messages::PlayerMove& message )
+{
+	if( current_spectator_ == nullptr )
+	{
+		Log::Warning( "Unexpected PlayerMove message from server" );
+		return;
+	}
+
+	// Switch to next player by shoot button press.
+	if( message.shoot_pressed && !current_spectator_->shoot_pressed )
+		current_spectator_->need_follow_next_player= true;
+	current_spectator_->shoot_pressed= message.shoot_pressed;
+
+	current_spectator_->last_move_sequence= message.sequence;
+}
+
+void Relay::ClearWorldState()
+{
+	have_map_= false;
+	walls_.clear();
+	static_models_.clear();
+	items_.clear();
+	monsters_.clear();
+	rockets_.clear();
+	dynamic_items_.clear();
+	light_sources_.clear();
+	rotating_light_sources_.clear();
+	events_.Clear();
+}
+
+void Relay::SendWorldStateForNewSpectator( Spectator& spectator )
+{
+	MessagesSender& messages_sender= spectator.connection_info.messages_sender;
+
+	if( have_map_ )
+	{
+		// Same messages, as server sends for newly connected player, but built from mirror of world state.
+		messages_sender.SendReliableMessage( map_change_message_ );
+
+		for( const auto& monster_value : monsters_ )
+		{
+			Messages::MonsterBirth message;
+			message.monster_id= monster_value.first;
+			message.initial_state= monster_value.second;
+			messages_sender.SendReliableMessage( message );
+		}
+		for( const auto& rocket_value : rockets_ )
+			messages_sender.SendUnreliableMessage( rocket_value.second );
+		for( const auto& item_value : dynamic_items_ )
+			messages_sender.SendUnreliableMessage( item_value.second );
+		for( const auto& light_value : light_sources_ )
+			messages_sender.SendReliableMessage( light_value.second );
+		for( const auto& light_value : rotating_light_sources_ )
+			messages_sender.SendReliableMessage( light_value.second );
+
+		UpdateFollowedPlayer( spectator );
+	}
+
+	messages_sender.SendReliableMessage( server_state_message_ );
+	messages_sender.Flush();
+}
+
+void Relay::SendUpdate( Spectator& spectator )
+{
+	MessagesSender& messages_sender= spectator.connection_info.messages_sender;
+	UpdateMessagesBaseline& baseline= spectator.update_messages_baseline;
+
+	baseline.update_number++;
+
+	// Send server state first, because client assigns its time to following entities states.
+	messages_sender.SendUnreliableMessage( server_state_message_ );
+
+	// Send events before states, because states may be related to entities, born in this update.
+	messages_sender.SendMessages( events_ );
+
+	SendChangedMessages( messages_sender, walls_, baseline.walls, baseline.update_number, g_unchanged_entities_resend_period );
+	SendChangedMessages( messages_sender, static_models_, baseline.static_models, baseline.update_number, g_unchanged_entities_resend_period );
+	SendChangedMessages( messages_sender, items_, baseline.items, baseline.update_number, g_unchanged_entities_resend_period );
+
+	// Spectator camera moves over whole map, so, all monsters and rockets are relevant.
+	for( const auto& monster_value : monsters_ )
+		messages_sender.SendUnreliableMessage( monster_value.second );
+
+	for( const auto& rocket_value : rockets_ )
+	{
+		const Messages::RocketBirth& rocket= rocket_value.second;
+
+		Messages::RocketState message;
+		message.rocket_id= rocket.rocket_id;
+		std::memcpy( message.xyz, rocket.xyz, sizeof(rocket.xyz) );
+		std::memcpy( message.angle, rocket.angle, sizeof(rocket.angle) );
+		messages_sender.SendUnreliableMessage( message );
+	}
+
+	UpdateFollowedPlayer( spectator );
+
+	const auto it= monsters_.find( spectator.followed_player_monster_id );
+	if( it != monsters_.end() )
+	{
+		// Spectator is not alive, so, client does not predict movement and just uses position of followed player.
+		Messages::PlayerPosition position_message;
+		std::memcpy( position_message.xyz, it->second.xyz, sizeof(position_message.xyz) );
+		position_message.speed= 0;
+		std::memset( position_message.speed_xyz, 0, sizeof(position_message.speed_xyz) );
+		position_message.last_move_sequence= spectator.last_move_sequence;
+		position_message.on_floor= true;
+		position_message.alive= false;
+		position_message.noclip= false;
+		messages_sender.SendUnreliableMessage( position_message );
+	}
+
+	Messages::PlayerState state_message;
+	std::memset( state_message.ammo, 0, sizeof(state_message.ammo) );
+	state_message.health= g_spectator_health;
+	state_message.armor= 0u;
+	state_message.keys_mask= 0u;
+	state_message.weapons_mask= 0u;
+	state_message.index= GameConstants::max_players; // Spectator has no score.
+	state_message.is_invisible= false;
+	state_message.show_shield= false;
+	state_message.show_chojin= false;
+	messages_sender.SendUnreliableMessage( state_message );
+
+	messages_sender.Flush();
+}
+
+void Relay::UpdateFollowedPlayer( Spectator& spectator )
+{
+	const auto followed_it= monsters_.find( spectator.followed_player_monster_id );
+	const bool followed_valid= followed_it != monsters_.end() && followed_it->second.monster_type == 0u;
+	if( followed_valid && !spectator.need_follow_next_player )
+		return;
+
+	spectator.need_follow_next_player= false;
+
+	// Select player with next id, or player with smallest id. Monster type of players is zero.
+	EntityId next_id= 0u, first_id= 0u;
+	for( const auto& monster_value : monsters_ )
+	{
+		if( monster_value.second.monster_type != 0u )
+			continue;
+
+		const EntityId id= monster_value.first;
+		if( id > spectator.followed_player_monster_id && ( next_id == 0u || id < next_id ) )
+			next_id= id;
+		if( first_id == 0u || id < first_id )
+			first_id= id;
+	}
+
+	const EntityId new_id= next_id != 0u ? next_id : first_id;
+	if( new_id == spectator.followed_player_monster_id && followed_valid )
+		return;
+
+	spectator.followed_player_monster_id= new_id;
+	if( new_id == 0u )
+		return;
+
+	const Messages::MonsterState& state= monsters_[ new_id ];
+
+	Messages::PlayerSpawn message;
+	std::memcpy( message.xyz, state.xyz, sizeof(message.xyz) );
+	message.direction= state.angle;
+	message.player_monster_id= new_id;
+	spectator.connection_info.messages_sender.SendReliableMessage( message );
+}
+
+} // namespace PanzerChasm
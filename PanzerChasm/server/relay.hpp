@@ -0,0 +1,135 @@
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../connection_info.hpp"
+#include "i_connections_listener.hpp"
+
+namespace PanzerChasm
+{
+
+// Spectator relay. Connects to server as one client, receives world state from it and resends it to many spectators.
+// Server sends update to relay once, so, cost of server tick does not depend on count of spectators.
+// Relay stores last state of world, for newly connected spectators, and own baseline for each spectator.
+// Spectators are usual clients, relay moves them together with one of players on map.
+class Relay final
+{
+public:
+	Relay(
+		const IConnectionPtr& server_connection,
+		const char* password,
+		const IConnectionsListenerPtr& spectators_listener );
+	~Relay();
+
+	// Returns false, if connection with server is lost.
+	bool Loop();
+
+	void DisconnectAllSpectators();
+
+public: // Messages handlers
+	void operator()( const Messages::MessageBase& message );
+	void operator()( const Messages::DummyNetMessage& ) {}
+
+	// From server.
+	void operator()( const Messages::ServerState& message );
+	void operator()( const Messages::MonsterState& message );
+	void operator()( const Messages::WallPosition& message );
+	void operator()( const Messages::ItemState& message );
+	void operator()( const Messages::StaticModelState& message );
+	void operator()( const Messages::RocketState& message );
+	void operator()( const Messages::RocketBirth& message );
+	void operator()( const Messages::RocketDeath& message );
+	void operator()( const Messages::DynamicItemBirth& message );
+	void operator()( const Messages::DynamicItemUpdate& message );
+	void operator()( const Messages::DynamicItemDeath& message );
+	void operator()( const Messages::LightSourceBirth& message );
+	void operator()( const Messages::LightSourceDeath& message );
+	void operator()( const Messages::RotatingLightSourceBirth& message );
+	void operator()( const Messages::RotatingLightSourceDeath& message );
+	void operator()( const Messages::MapChange& message );
+	void operator()( const Messages::MonsterBirth& message );
+	void operator()( const Messages::MonsterDeath& message );
+
+	// Messages of player of relay itself. Relay has no player, these messages are sent before server accepts relay.
+	void operator()( const Messages::PlayerSpawn& ) {}
+	void operator()( const Messages::PlayerPosition& ) {}
+	void operator()( const Messages::PlayerState& ) {}
+	void operator()( const Messages::PlayerWeapon& ) {}
+	void operator()( const Messages::PlayerItemPickup& ) {}
+
+	// Events without state, which are just resent to spectators.
+	void operator()( const Messages::SpriteEffectBirth& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::FullscreenBlendEffect& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::ParticleEffectBirth& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::MonsterPartBirth& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::GibsBirth& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::MapEventSound& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::MonsterLinkedSound& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::MonsterSound& message ) { events_.AddUnreliableMessage( message ); }
+	void operator()( const Messages::TextMessage& message ) { events_.AddReliableMessage( message ); }
+	void operator()( const Messages::DynamicTextMessage& message ) { events_.AddReliableMessage( message ); }
+
+	// From spectators.
+	void operator()( const Messages::PlayerMove& message );
+	void operator()( const Messages::PlayerName& ) {}
+
+private:
+	// Last state of map entities, sent to one spectator. Same as baseline of server map.
+	struct UpdateMessagesBaseline
+	{
+		std::vector<Messages::WallPosition> walls;
+		std::vector<Messages::StaticModelState> static_models;
+		std::vector<Messages::ItemState> items;
+		unsigned int update_number= 0u;
+
+		void Clear();
+	};
+
+	struct Spectator final
+	{
+		explicit Spectator( const IConnectionPtr& connection );
+
+		ConnectionInfo connection_info;
+		UpdateMessagesBaseline update_messages_baseline;
+		EntityId followed_player_monster_id= 0u; // Zero - not following anyone.
+		unsigned short last_move_sequence= 0u;
+		bool shoot_pressed= false;
+		bool need_follow_next_player= false;
+	};
+
+	typedef std::unique_ptr<Spectator> SpectatorPtr;
+
+private:
+	void ClearWorldState();
+	void SendWorldStateForNewSpectator( Spectator& spectator );
+	void SendUpdate( Spectator& spectator );
+	void UpdateFollowedPlayer( Spectator& spectator );
+
+private:
+	ConnectionInfo server_connection_info_;
+	const IConnectionsListenerPtr spectators_listener_;
+
+	std::vector<SpectatorPtr> spectators_;
+	Spectator* current_spectator_= nullptr;
+
+	// Mirror of world state, built from server messages.
+	// Entries of indexed entities, which are not yet received, have unknown message id.
+	bool have_map_= false;
+	Messages::MapChange map_change_message_;
+	Messages::ServerState server_state_message_;
+	std::vector<Messages::WallPosition> walls_;
+	std::vector<Messages::StaticModelState> static_models_;
+	std::vector<Messages::ItemState> items_;
+	std::unordered_map<EntityId, Messages::MonsterState> monsters_;
+	std::unordered_map<EntityId, Messages::RocketBirth> rockets_;
+	std::unordered_map<EntityId, Messages::DynamicItemBirth> dynamic_items_;
+	std::unordered_map<EntityId, Messages::LightSourceBirth> light_sources_;
+	std::unordered_map<EntityId, Messages::RotatingLightSourceBirth> rotating_light_sources_;
+
+	// Events since last update of spectators.
+	MessagesBuffer events_;
+	bool update_received_= false; // Server sent new update since last update of spectators.
+};
+
+} // namespace PanzerChasm
@@ -1,9 +1,18 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
 #include "../assert.hpp"
 #include "../game_constants.hpp"
 #include "../log.hpp"
 #include "../math_utils.hpp"
 #include "../messages_extractor.inl"
+#include "../profiler.hpp"
 #include "../save_load_streams.hpp"
+#include "../settings.hpp"
+#include "../shared_settings_keys.hpp"
 #include "player.hpp"
 
 #include "server.hpp"
@@ -11,28 +20,84 @@
 namespace PanzerChasm
 {
 
+static const int g_default_metrics_interval_s= 10;
+
+static const unsigned int g_max_relays= 16u;
+
+// Shorter variable ticks are skipped, time is accumulated for next tick.
+static const float g_min_tick_duration_s= 4.0f / 1000.0f;
+
+static const char* GameRulesName( const GameRules game_rules )
+{
+	switch( game_rules )
+	{
+	case GameRules::SinglePlayer: return "single";
+	case GameRules::Cooperative: return "coop";
+	case GameRules::Deathmatch: return "deathmatch";
+	};
+	return "unknown";
+}
+
+// Escape spaces, commas and equal signs for line protocol tags.
+static std::string EscapeMetricsTag( const std::string& str )
+{
+	std::string result;
+	for( const char c : str )
+	{
+		if( c == ' ' || c == ',' || c == '=' || c == '\\' )
+			result.push_back( '\\' );
+		result.push_back( c );
+	}
+	return result.empty() ? "none" : result;
+}
+
+// Escape quotes for line protocol string fields.
+static std::string EscapeMetricsString( const std::string& str )
+{
+	std::string result;
+	for( const char c : str )
+	{
+		if( c == '"' || c == '\\' )
+			result.push_back( '\\' );
+		result.push_back( c );
+	}
+	return result;
+}
+
+static uint64_t TotalBytes( const NetTrafficCounters& counters )
+{
+	return counters.reliable_bytes + counters.unreliable_bytes;
+}
+
 Server::ConnectedPlayer::ConnectedPlayer(
 	const IConnectionPtr& connection,
 	const GameResourcesConstPtr& game_resoruces,
 	const Time current_time )
 	: connection_info( connection )
+	, last_move_time( Time::FrameTime() )
 	, player( std::make_shared<Player>( game_resoruces, current_time ) )
 {}
 
 Server::Server(
+	Settings& settings,
 	CommandsProcessor& commands_processor,
 	const GameResourcesConstPtr& game_resources,
 	const MapLoaderPtr& map_loader,
 	const IConnectionsListenerPtr& connections_listener,
 	const DrawLoadingCallback& draw_loading_callback )
-	: game_resources_(game_resources)
+	: settings_(settings)
+	, game_resources_(game_resources)
 	, map_loader_(map_loader)
 	, connections_listener_(connections_listener)
 	, draw_loading_callback_(draw_loading_callback)
 	, map_end_callback_( [this]{ map_end_triggered_= true; } )
 	, text_message_callback_( std::bind( &Server::AddTextMessage, this, std::placeholders::_1 ) )
-	, last_tick_( Time::CurrentTime() )
+	, workers_pool_( static_cast<unsigned int>( std::max( settings.GetOrSetInt( SettingsKeys::server_workers_threads, 0 ), 0 ) ) )
+	, last_tick_( Time::FrameTime() )
 	, server_accumulated_time_( Time::FromSeconds(0) )
+	, fixed_ticks_accumulated_time_( Time::FromSeconds(0) )
+	, last_updates_send_time_( Time::FromSeconds(0) )
+	, last_metrics_time_( Time::FrameTime() )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 	PC_ASSERT( map_loader_ != nullptr );
@@ -46,10 +111,13 @@ Server::Server(
 	commands->emplace( "keys", std::bind( &Server::GiveKeys, this ) );
 	commands->emplace( "chojin", std::bind( &Server::ToggleGodMode, this ) );
 	commands->emplace( "noclip", std::bind( &Server::ToggleNoclip, this ) );
+	commands->emplace( "sv_net_stats", std::bind( &Server::PrintNetStats, this ) );
+	commands->emplace( "sv_metrics", std::bind( &Server::PrintMetrics, this ) );
 
 	commands_= std::move( commands );
 	commands_processor.RegisterCommands( commands_ );
 
+	UpdateSettings();
 	UpdateTimes();
 }
 
@@ -58,13 +126,22 @@ Server::~Server()
 
 void Server::Loop( bool paused )
 {
+	PC_PROFILE_SCOPE( "Server::Loop" );
+
+	// Server may run in own thread, so, sample time here, not in host loop.
+	Time::SampleFrameTime();
+
 	if( paused )
 	{
-		last_tick_= Time::CurrentTime();
+		last_tick_= Time::FrameTime();
 		return;
 	}
 
+	const uint64_t loop_start_time_ns= Profiler::GetTimeNs();
+	Profiler::ScopedPhases phases( "Server::Loop connections" );
+
 	// Accept new connections.
+	connections_listener_->PollEvents();
 	while( const IConnectionPtr connection= connections_listener_->GetNewConnection() )
 	{
 		if( players_.size() >= GameConstants::max_players )
@@ -109,6 +186,7 @@ void Server::Loop( bool paused )
 			connected_player.connection_info.messages_sender.SendReliableMessage( map_change_msg );
 		}
 
+		connected_player.update_messages_baseline.Clear();
 		if( map_ != nullptr )
 			map_->SendMessagesForNewlyConnectedPlayer( connected_player.connection_info.messages_sender );
 
@@ -152,14 +230,71 @@ void Server::Loop( bool paused )
 			p++;
 	}
 
+	// Disconnect relays.
+	for( unsigned int r= 0u; r < relays_.size(); )
+	{
+		ConnectedPlayerPtr& relay= relays_[r];
+
+		if( relay->connection_info.messages_extractor.IsBroken() )
+		{
+			Log::Info( "Messages from relay \"", relay->connection_info.connection->GetConnectionInfo(), "\" was broken" );
+			relay->connection_info.connection->Disconnect();
+		}
+
+		if( relay->connection_info.connection->Disconnected() )
+		{
+			Log::Info( "Relay \"" + relay->connection_info.connection->GetConnectionInfo(), "\" disconnected from server" );
+			if( r < relays_.size() - 1u )
+				relay= std::move( relays_.back() );
+			relays_.pop_back();
+		}
+		else
+			r++;
+	}
+
+	phases.Next( "Server::Loop receive messages" );
+
 	// Recieve messages.
 	for( const ConnectedPlayerPtr& connected_player : players_ )
 	{
 		current_player_= connected_player.get();
 		current_player_->connection_info.messages_extractor.ProcessMessages( *this );
 		current_player_= nullptr;
+
+		connected_player->net_statistics.Update(
+			connected_player->connection_info.messages_sender.GetTrafficCounters(),
+			connected_player->connection_info.messages_extractor.GetTrafficCounters(),
+			Time::FrameTime() );
+	}
+
+	for( const ConnectedPlayerPtr& relay : relays_ )
+	{
+		current_player_= relay.get();
+		current_player_->connection_info.messages_extractor.ProcessMessages( *this );
+		current_player_= nullptr;
+
+		relay->net_statistics.Update(
+			relay->connection_info.messages_sender.GetTrafficCounters(),
+			relay->connection_info.messages_extractor.GetTrafficCounters(),
+			Time::FrameTime() );
+	}
+
+	// Move new relays from players list. Players are not moved during messages processing, because list is iterated.
+	for( unsigned int p= 0u; p < players_.size(); )
+	{
+		if( players_[p]->is_relay )
+		{
+			relays_.push_back( std::move( players_[p] ) );
+			if( p < players_.size() - 1u )
+				players_[p]= std::move( players_.back() );
+			players_.pop_back();
+		}
+		else
+			p++;
 	}
 
+	phases.Next( "Server::Loop map ticks" );
+
 	// Do server logic
 	UpdateTimes();
 
@@ -181,15 +316,35 @@ void Server::Loop( bool paused )
 		}
 	}
 
-	// Send messages
+	// Send messages. If send rate is limited, events and messages are accumulated until next send.
+	if( !NeedSendUpdates() )
+	{
+		connections_listener_->SendQueuedPackets();
+		ProcessMapEnd();
+		UpdateMetrics( loop_start_time_ns );
+		return;
+	}
+
+	phases.Next( "Server::Loop send messages" );
+
 	Messages::ServerState server_state_message;
 	BuildServerStateMessage( server_state_message );
 
+	if( map_ != nullptr )
+		map_->PrepareUpdateMessages();
+
 	for( const ConnectedPlayerPtr& connected_player : players_ )
 	{
 		MessagesSender& messages_sender= connected_player->connection_info.messages_sender;
+
+		// Send server state first, because client assigns its time to following entities states.
+		messages_sender.SendUnreliableMessage( server_state_message );
+
 		if( map_ != nullptr )
-			map_->SendUpdateMessages( messages_sender );
+			map_->SendUpdateMessages(
+				messages_sender,
+				connected_player->update_messages_baseline,
+				&connected_player->player->Position() );
 
 		Messages::PlayerPosition position_msg;
 		Messages::PlayerState state_msg;
@@ -212,16 +367,39 @@ void Server::Loop( bool paused )
 		messages_sender.SendUnreliableMessage( position_msg );
 		messages_sender.SendUnreliableMessage( state_msg );
 		messages_sender.SendUnreliableMessage( weapon_msg );
-		messages_sender.SendUnreliableMessage( server_state_message );
 		connected_player->player->SendInternalMessages( messages_sender );
 		messages_sender.Flush();
 	}
 
+	// Relays get same update, as players, but without relevance filtering and without player messages.
+	// So, cost of this loop does not depend on count of spectators of each relay.
+	for( const ConnectedPlayerPtr& relay : relays_ )
+	{
+		MessagesSender& messages_sender= relay->connection_info.messages_sender;
+
+		messages_sender.SendUnreliableMessage( server_state_message );
+
+		if( map_ != nullptr )
+			map_->SendUpdateMessages( messages_sender, relay->update_messages_baseline, nullptr );
+
+		for( const Messages::DynamicTextMessage& message : text_massages_ )
+			messages_sender.SendReliableMessage( message );
+
+		messages_sender.Flush();
+	}
+
 	if( map_ != nullptr )
 		map_->ClearUpdateEvents();
 
 	text_massages_.clear();
 
+	connections_listener_->SendQueuedPackets();
+	ProcessMapEnd();
+	UpdateMetrics( loop_start_time_ns );
+}
+
+void Server::ProcessMapEnd()
+{
 	// Change map, if needed at end of this loop
 	if( map_end_triggered_ )
 	{
@@ -244,6 +422,48 @@ void Server::Loop( bool paused )
 	}
 }
 
+void Server::PrefetchNextMap()
+{
+	// Map end triggers change to next map only for first maps, see ProcessMapEnd.
+	if( current_map_data_ == nullptr || current_map_data_->number >= 16u )
+		return;
+
+	// Load next map in background, while current map is running.
+	map_loader_->PrefetchMap( map_loader_->GetNextMapInfo( current_map_data_->number ).number );
+}
+
+void Server::UpdateSettings()
+{
+	cached_settings_.tick_rate= settings_.GetOrSetInt( SettingsKeys::server_tick_rate, 0 );
+	cached_settings_.send_rate= settings_.GetOrSetInt( SettingsKeys::server_send_rate, 0 );
+	cached_settings_.metrics_interval_s=
+		std::max( 1, settings_.GetOrSetInt( SettingsKeys::server_metrics_interval, g_default_metrics_interval_s ) );
+	cached_settings_.metrics_file= settings_.GetOrSetString( SettingsKeys::server_metrics_file, "" );
+	cached_settings_.relay_password= settings_.GetOrSetString( SettingsKeys::server_relay_password, "" );
+}
+
+void Server::SetRoomNumber( const unsigned int room_number )
+{
+	room_number_= room_number;
+}
+
+bool Server::WaitForEvents()
+{
+	// Do not sleep longer, than until next map tick.
+	const int tick_rate= cached_settings_.tick_rate;
+	const Time until_next_tick=
+		( tick_rate > 0
+			? Time::FromSeconds( 1.0 / double( tick_rate ) ) - fixed_ticks_accumulated_time_
+			: Time::FromSeconds( double(g_min_tick_duration_s) ) ) -
+		( Time::CurrentTime() - last_tick_ );
+
+	const float until_next_tick_s= until_next_tick.ToSeconds();
+	if( until_next_tick_s <= 0.0f )
+		return true;
+
+	return connections_listener_->WaitForEvents( static_cast<unsigned int>( std::ceil( until_next_tick_s * 1000.0f ) ) );
+}
+
 bool Server::ChangeMap(
 	const unsigned int map_number,
 	const DifficultyType difficulty,
@@ -283,6 +503,7 @@ bool Server::ChangeMap(
 			map_data,
 			game_resources_,
 			server_accumulated_time_,
+			workers_pool_,
 			map_end_callback_,
 			text_message_callback_ ) );
 
@@ -308,6 +529,7 @@ bool Server::ChangeMap(
 
 		messages_sender.SendReliableMessage( message );
 		map_->SendMessagesForNewlyConnectedPlayer( messages_sender );
+		connected_player->update_messages_baseline.Clear();
 
 		Messages::PlayerSpawn spawn_message;
 		connected_player->player->BuildSpawnMessage( spawn_message, true );
@@ -317,6 +539,22 @@ bool Server::ChangeMap(
 		messages_sender.Flush();
 	}
 
+	for( const ConnectedPlayerPtr& relay : relays_ )
+	{
+		Messages::MapChange message;
+		message.map_number= current_map_data_->number;
+		message.need_play_cutscene= false;
+
+		MessagesSender& messages_sender= relay->connection_info.messages_sender;
+
+		messages_sender.SendReliableMessage( message );
+		map_->SendMessagesForNewlyConnectedPlayer( messages_sender );
+		relay->update_messages_baseline.Clear();
+
+		messages_sender.Flush();
+	}
+
+	PrefetchNextMap();
 	show_progress( 1.0f );
 
 	return true;
@@ -392,12 +630,19 @@ bool Server::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 			map_data,
 			load_stream,
 			game_resources_,
+			workers_pool_,
 			map_end_callback_,
 			text_message_callback_ ) );
 
 	map_end_triggered_= false;
 	join_first_client_with_existing_player_= true;
 
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+		connected_player->update_messages_baseline.Clear();
+	for( const ConnectedPlayerPtr& relay : relays_ )
+		relay->update_messages_baseline.Clear();
+
+	PrefetchNextMap();
 	show_progress( 1.0f );
 
 	buffer_pos= load_stream.GetBufferPos();
@@ -407,7 +652,7 @@ bool Server::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 
 void Server::DisconnectAllClients()
 {
-	if( players_.empty() )
+	if( players_.empty() && relays_.empty() )
 		return;
 
 	Log::Info( "All clients disconnected from server" );
@@ -418,8 +663,11 @@ void Server::DisconnectAllClients()
 			map_->DespawnPlayer( player->player_monster_id );
 		player->connection_info.connection->Disconnect();
 	}
+	for( const ConnectedPlayerPtr& relay : relays_ )
+		relay->connection_info.connection->Disconnect();
 
 	players_.clear();
+	relays_.clear();
 }
 
 void Server::operator()( const Messages::MessageBase& message )
@@ -431,6 +679,9 @@ void Server::operator()( const Messages::MessageBase& message )
 void Server::operator()( const Messages::PlayerMove& message )
 {
 	PC_ASSERT( current_player_ != nullptr );
+	if( current_player_->is_relay )
+		return;
+	current_player_->last_move_time= Time::FrameTime();
 	if( current_map_data_ == nullptr )
 		return;
 
@@ -473,6 +724,8 @@ void Server::operator()( const Messages::PlayerMove& message )
 void Server::operator()( const Messages::PlayerName& message )
 {
 	PC_ASSERT( current_player_ != nullptr );
+	if( current_player_->is_relay )
+		return;
 
 	if( !current_player_->name.empty() && current_player_->name != message.name )
 		AddTextMessage( ( "Player \"" + current_player_->name + "\" changed his name to \"" + message.name + "\"" ).c_str() );
@@ -488,17 +741,49 @@ void Server::operator()( const Messages::PlayerName& message )
 	}
 }
 
+void Server::operator()( const Messages::RelayJoin& message )
+{
+	PC_ASSERT( current_player_ != nullptr );
+	if( current_player_->is_relay )
+		return;
+
+	const char* const password= cached_settings_.relay_password.c_str();
+	if( password[0] == '\0' ||
+		std::strncmp( password, message.password, sizeof(message.password) ) != 0 ||
+		game_rules_ == GameRules::SinglePlayer ||
+		relays_.size() >= g_max_relays )
+	{
+		Log::Info( "Relay \"", current_player_->connection_info.connection->GetConnectionInfo(), "\" rejected" );
+		current_player_->connection_info.connection->Disconnect();
+		return;
+	}
+
+	Log::Info( "Client \"", current_player_->connection_info.connection->GetConnectionInfo(), "\" is spectator relay now" );
+
+	if( map_ != nullptr )
+		map_->DespawnPlayer( current_player_->player_monster_id );
+
+	current_player_->is_relay= true;
+	current_player_->update_messages_baseline.Clear();
+}
+
 void Server::UpdateTimes()
 {
-	const Time current_time= Time::CurrentTime();
+	const int tick_rate= cached_settings_.tick_rate;
+	if( tick_rate > 0 )
+	{
+		UpdateTimesFixed( static_cast<unsigned int>( tick_rate ) );
+		return;
+	}
+
+	const Time current_time= Time::FrameTime();
 	Time dt= current_time - last_tick_;
 
 	const float dt_s= dt.ToSeconds();
-	const float c_min_tick_duration_s=  4.0f / 1000.0f;
 	const float c_max_tick_duration_s= 30.0f / 1000.0f;
 	const float c_time_eps= 2.0f / 1000.0f;
 
-	if( dt_s < c_min_tick_duration_s )
+	if( dt_s < g_min_tick_duration_s )
 	{
 		// Skip this tick, accumulate more delta.
 		map_tick_count_= 0u;
@@ -555,11 +840,58 @@ void Server::UpdateTimes()
 	last_tick_= current_time;
 }
 
+void Server::UpdateTimesFixed( const unsigned int tick_rate )
+{
+	// All ticks have same duration, so, simulation does not depend on frame rate.
+	const Time current_time= Time::FrameTime();
+	fixed_ticks_accumulated_time_+= current_time - last_tick_;
+	last_tick_= current_time;
+
+	const Time map_tick_dt= Time::FromSeconds( 1.0 / double( tick_rate ) );
+
+	map_tick_count_= 0u;
+	while( fixed_ticks_accumulated_time_ >= map_tick_dt && map_tick_count_ < c_max_multiple_map_ticks )
+	{
+		fixed_ticks_accumulated_time_-= map_tick_dt;
+		server_accumulated_time_+= map_tick_dt;
+
+		map_ticks_[ map_tick_count_ ].end= server_accumulated_time_;
+		map_ticks_[ map_tick_count_ ].duration= map_tick_dt;
+		map_tick_count_++;
+	}
+
+	// If server is too slow, slow down game time, instead of accumulating more and more ticks.
+	if( fixed_ticks_accumulated_time_ >= map_tick_dt )
+		fixed_ticks_accumulated_time_= Time::FromSeconds(0);
+}
+
+bool Server::NeedSendUpdates()
+{
+	const int send_rate= cached_settings_.send_rate;
+	if( send_rate <= 0 )
+		return true;
+
+	const Time send_dt= Time::FromSeconds( 1.0 / double( send_rate ) );
+	if( server_accumulated_time_ - last_updates_send_time_ < send_dt )
+		return false;
+
+	// Advance send time by fixed step, for keeping of average send rate. Do not try to catch up after long pauses.
+	last_updates_send_time_+= send_dt;
+	if( server_accumulated_time_ - last_updates_send_time_ >= send_dt )
+		last_updates_send_time_= server_accumulated_time_;
+
+	return true;
+}
+
 void Server::BuildServerStateMessage( Messages::ServerState& message )
 {
 	PC_ASSERT( players_.size() <= GameConstants::max_players );
 
 	message.map_time_s= 0; // TODO - calculate time.
+	message.server_time_ms=
+		static_cast<unsigned int>(
+			server_accumulated_time_.GetInternalRepresentation() * 1000 /
+			Time::FromSeconds(1).GetInternalRepresentation() );
 	message.game_rules= game_rules_;
 	message.player_count= players_.size();
 	for( unsigned int i= 0u; i < players_.size(); i++ )
@@ -568,6 +900,100 @@ void Server::BuildServerStateMessage( Messages::ServerState& message )
 	}
 }
 
+void Server::UpdateMetrics( const uint64_t loop_start_time_ns )
+{
+	loop_durations_ms_.push_back( float( double( Profiler::GetTimeNs() - loop_start_time_ns ) / 1000000.0 ) );
+
+	const Time current_time= Time::FrameTime();
+	if( current_time - last_metrics_time_ < Time::FromSeconds( cached_settings_.metrics_interval_s ) )
+		return;
+
+	// Loop durations are collected even without metrics file, for "sv_metrics" command.
+	const char* const metrics_file_name= cached_settings_.metrics_file.c_str();
+	std::vector<std::string> lines;
+	if( metrics_file_name[0] != '\0' )
+		BuildMetricsLines( lines );
+	loop_durations_ms_.clear();
+	last_metrics_time_= current_time;
+	if( lines.empty() )
+		return;
+
+	// Reopen file each time, so, it may be rotated or removed by external tools.
+	std::FILE* const file= std::fopen( metrics_file_name, "a" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not open metrics file \"", metrics_file_name, "\"" );
+		return;
+	}
+	for( const std::string& line : lines )
+		std::fprintf( file, "%s\n", line.c_str() );
+	std::fclose( file );
+}
+
+void Server::BuildMetricsLines( std::vector<std::string>& out_lines ) const
+{
+	// Line protocol - "measurement,tags fields timestamp_ns".
+	const unsigned long long timestamp_ns=
+		static_cast<unsigned long long>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch() ).count() );
+	const Time current_time= Time::CurrentTime();
+
+	std::vector<float> sorted_durations= loop_durations_ms_;
+	std::sort( sorted_durations.begin(), sorted_durations.end() );
+	const auto percentile=
+	[&]( const unsigned int p ) -> float
+	{
+		return sorted_durations.empty() ? 0.0f : sorted_durations[ ( sorted_durations.size() - 1u ) * p / 100u ];
+	};
+
+	const unsigned int players= map_ == nullptr ? 0u : map_->GetPlayers().size();
+	const unsigned int monsters= map_ == nullptr ? 0u : map_->GetMonsters().size() - players;
+	const unsigned int rockets= map_ == nullptr ? 0u : map_->GetRocketsCount();
+
+	char str[512];
+	std::snprintf(
+		str, sizeof(str),
+		"panzerchasm_server,room=%u,map=%u,rules=%s "
+		"clients=%ui,relays=%ui,players=%ui,monsters=%ui,rockets=%ui,ticks=%ui,"
+		"tick_p50_ms=%.3f,tick_p95_ms=%.3f,tick_p99_ms=%.3f,tick_max_ms=%.3f %llu",
+		room_number_,
+		current_map_data_ == nullptr ? 0u : current_map_data_->number,
+		GameRulesName( game_rules_ ),
+		static_cast<unsigned int>( players_.size() ), static_cast<unsigned int>( relays_.size() ), players, monsters, rockets,
+		static_cast<unsigned int>( sorted_durations.size() ),
+		percentile(50u), percentile(95u), percentile(99u), sorted_durations.empty() ? 0.0f : sorted_durations.back(),
+		timestamp_ns );
+	out_lines.emplace_back( str );
+
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		const ConnectionInfo& connection_info= connected_player->connection_info;
+		std::snprintf(
+			str, sizeof(str),
+			"panzerchasm_client,room=%u,client=%u,address=%s "
+			"name=\"%s\",bytes_in=%llui,bytes_out=%llui,reliable_backlog=%ui,since_last_move_ms=%.1f %llu",
+			room_number_,
+			static_cast<unsigned int>( &connected_player - players_.data() ),
+			EscapeMetricsTag( connection_info.connection->GetConnectionInfo() ).c_str(),
+			EscapeMetricsString( connected_player->name ).c_str(),
+			static_cast<unsigned long long>( TotalBytes( connection_info.messages_extractor.GetTrafficCounters() ) ),
+			static_cast<unsigned long long>( TotalBytes( connection_info.messages_sender.GetTrafficCounters() ) ),
+			connection_info.connection->GetReliableBacklogSize(),
+			( current_time - connected_player->last_move_time ).ToSeconds() * 1000.0f,
+			timestamp_ns );
+		out_lines.emplace_back( str );
+	}
+}
+
+void Server::PrintMetrics()
+{
+	std::vector<std::string> lines;
+	BuildMetricsLines( lines );
+	for( const std::string& line : lines )
+		Log::Info( line );
+}
+
 void Server::AddTextMessage( const char* const text )
 {
 	text_massages_.emplace_back();
@@ -626,4 +1052,21 @@ void Server::ToggleNoclip()
 	Log::Info( noclip_ ? "noclip on" : "noclip off" );
 }
 
+void Server::PrintNetStats()
+{
+	if( players_.empty() )
+		Log::Info( "No connected players" );
+
+	std::vector<std::string> stats_lines;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		Log::Info( "Player \"", connected_player->name, "\", client \"", connected_player->connection_info.connection->GetConnectionInfo(), "\"" );
+
+		stats_lines.clear();
+		connected_player->net_statistics.GetStatsLines( stats_lines, true );
+		for( const std::string& line : stats_lines )
+			Log::Info( line );
+	}
+}
+
 } // namespace PanzerChasm
@@ -3,6 +3,7 @@
 #include "../commands_processor.hpp"
 #include "../connection_info.hpp"
 #include "../time.hpp"
+#include "../workers_pool.hpp"
 #include "i_connections_listener.hpp"
 #include "fwd.hpp"
 #include "map.hpp"
@@ -14,6 +15,7 @@ class Server final
 {
 public:
 	Server(
+		Settings& settings,
 		CommandsProcessor& commands_processor,
 		const GameResourcesConstPtr& game_resources,
 		const MapLoaderPtr& map_loader,
@@ -23,6 +25,10 @@ public:
 
 	void Loop( bool paused );
 
+	// Blocks until network events or until time of next map tick.
+	// Returns false, if connections listener can not wait. In this case caller must sleep itself.
+	bool WaitForEvents();
+
 	// Returns true, if map successfully changed or restarted.
 	bool ChangeMap( unsigned int map_number, DifficultyType difficulty, GameRules game_rules, bool is_next_map_change= false );
 	void StopMap();
@@ -32,11 +38,19 @@ public:
 
 	void DisconnectAllClients();
 
+	// Server reads settings only here, loop uses cached values.
+	// Call it, when no other thread may change settings - settings are not thread-safe.
+	void UpdateSettings();
+
+	// Room number for metrics, if process hosts several rooms.
+	void SetRoomNumber( unsigned int room_number );
+
 public: // Messages handlers
 	void operator()( const Messages::MessageBase& message );
 	void operator()( const Messages::DummyNetMessage& ) {}
 	void operator()( const Messages::PlayerMove& message );
 	void operator()( const Messages::PlayerName& message );
+	void operator()( const Messages::RelayJoin& message );
 
 private:
 	struct ConnectedPlayer final
@@ -47,10 +61,14 @@ private:
 			Time current_time );
 
 		ConnectionInfo connection_info;
+		NetStatistics net_statistics;
+		Time last_move_time; // Real time of last PlayerMove message.
 		PlayerPtr player;
 		EntityId player_monster_id;
 		std::string name;
 		bool entered_message_printed= false;
+		bool is_relay= false; // Set by RelayJoin. Such client is moved from players to relays after messages receiving.
+		Map::UpdateMessagesBaseline update_messages_baseline;
 	};
 
 	typedef std::unique_ptr<ConnectedPlayer> ConnectedPlayerPtr;
@@ -64,8 +82,16 @@ private:
 
 private:
 	void UpdateTimes();
+	void UpdateTimesFixed( unsigned int tick_rate );
+	bool NeedSendUpdates();
+	void ProcessMapEnd();
+	void PrefetchNextMap();
 	void BuildServerStateMessage( Messages::ServerState& message );
 
+	void UpdateMetrics( uint64_t loop_start_time_ns );
+	void BuildMetricsLines( std::vector<std::string>& out_lines ) const;
+	void PrintMetrics();
+
 	void AddTextMessage( const char* text );
 
 	void GiveAmmo();
@@ -75,7 +101,10 @@ private:
 	void ToggleGodMode();
 	void ToggleNoclip();
 
+	void PrintNetStats();
+
 private:
+	Settings& settings_;
 	const GameResourcesConstPtr game_resources_;
 	const MapLoaderPtr map_loader_;
 	const IConnectionsListenerPtr connections_listener_;
@@ -89,12 +118,15 @@ private:
 	GameRules game_rules_= GameRules::SinglePlayer;
 	bool map_changed_from_previous_map_= false;
 	MapDataConstPtr current_map_data_;
+	WorkersPool workers_pool_; // For parallel tasks of map. Threads are not recreated at map change.
 	std::unique_ptr<Map> map_;
 
 	bool map_end_triggered_= false;
 	bool join_first_client_with_existing_player_= false;
 
 	std::vector<ConnectedPlayerPtr> players_;
+	// Spectator relays. They have no players on map and get full world state, which they resend to own spectators.
+	std::vector<ConnectedPlayerPtr> relays_;
 	ConnectedPlayer* current_player_= nullptr;
 
 	Time last_tick_; // Real time
@@ -103,8 +135,26 @@ private:
 	TickTime map_ticks_[ c_max_multiple_map_ticks ];
 	unsigned int map_tick_count_;
 
+	Time fixed_ticks_accumulated_time_; // Real time, not yet simulated in fixed ticks mode.
+	Time last_updates_send_time_; // Server time
+
 	std::vector<Messages::DynamicTextMessage> text_massages_;
 
+	struct CachedSettings
+	{
+		int tick_rate= 0;
+		int send_rate= 0;
+		int metrics_interval_s= 0;
+		std::string metrics_file;
+		std::string relay_password;
+	};
+	CachedSettings cached_settings_;
+
+	// Metrics
+	unsigned int room_number_= 0u;
+	std::vector<float> loop_durations_ms_; // Since last metrics writing.
+	Time last_metrics_time_; // Real time
+
 	// Cheats
 	bool noclip_= false;
 	bool god_mode_= false;
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../assert.hpp"
+#include "../map_loader.hpp"
+
+namespace PanzerChasm
+{
+
+// Field with value for some cells of map. Usually, only few cells have values.
+// Each row of map has bitmask of active cells. Values of active cells are stored compactly, in cells order.
+// Index of value is row offset plus number of active cells before given cell in row.
+template<class T>
+class SparseMapField final
+{
+public:
+	SparseMapField();
+
+	bool Empty() const;
+	unsigned int ActiveCellCount() const;
+
+	// Returns nullptr, if cell is not active.
+	const T* Get( unsigned int x, unsigned int y ) const;
+
+	void Set( unsigned int x, unsigned int y, const T& value );
+	void Reset( unsigned int x, unsigned int y );
+	void Clear();
+
+	// Func( unsigned int x, unsigned int y, const T& value ). Cells are visited in order of rows.
+	template<class Func>
+	void ForEachActiveCell( const Func& func ) const;
+
+private:
+	static unsigned int BitCount( uint64_t bits );
+	unsigned int GetValueIndex( unsigned int x, unsigned int y ) const;
+
+private:
+	uint64_t rows_masks_[ MapData::c_map_size ];
+	unsigned short rows_offsets_[ MapData::c_map_size + 1u ]; // Index of first value of each row.
+	std::vector<T> values_;
+};
+
+template<class T>
+SparseMapField<T>::SparseMapField()
+{
+	static_assert( MapData::c_map_size == 64u, "Row mask must contain bits for all cells of row" );
+	Clear();
+}
+
+template<class T>
+bool SparseMapField<T>::Empty() const
+{
+	return values_.empty();
+}
+
+template<class T>
+unsigned int SparseMapField<T>::ActiveCellCount() const
+{
+	return values_.size();
+}
+
+template<class T>
+const T* SparseMapField<T>::Get( const unsigned int x, const unsigned int y ) const
+{
+	PC_ASSERT( x < MapData::c_map_size && y < MapData::c_map_size );
+
+	if( ( rows_masks_[y] & ( uint64_t(1u) << x ) ) == 0u )
+		return nullptr;
+	return &values_[ GetValueIndex( x, y ) ];
+}
+
+template<class T>
+void SparseMapField<T>::Set( const unsigned int x, const unsigned int y, const T& value )
+{
+	PC_ASSERT( x < MapData::c_map_size && y < MapData::c_map_size );
+
+	const unsigned int index= GetValueIndex( x, y );
+	const uint64_t bit= uint64_t(1u) << x;
+	if( ( rows_masks_[y] & bit ) != 0u )
+	{
+		values_[ index ]= value;
+		return;
+	}
+
+	rows_masks_[y]|= bit;
+	values_.insert( values_.begin() + index, value );
+	for( unsigned int i= y + 1u; i <= MapData::c_map_size; i++ )
+		rows_offsets_[i]++;
+}
+
+template<class T>
+void SparseMapField<T>::Reset( const unsigned int x, const unsigned int y )
+{
+	PC_ASSERT( x < MapData::c_map_size && y < MapData::c_map_size );
+
+	const uint64_t bit= uint64_t(1u) << x;
+	if( ( rows_masks_[y] & bit ) == 0u )
+		return;
+
+	values_.erase( values_.begin() + GetValueIndex( x, y ) );
+	rows_masks_[y]&= ~bit;
+	for( unsigned int i= y + 1u; i <= MapData::c_map_size; i++ )
+		rows_offsets_[i]--;
+}
+
+template<class T>
+void SparseMapField<T>::Clear()
+{
+	for( uint64_t& mask : rows_masks_ )
+		mask= 0u;
+	for( unsigned short& offset : rows_offsets_ )
+		offset= 0u;
+	values_.clear();
+}
+
+template<class T>
+template<class Func>
+void SparseMapField<T>::ForEachActiveCell( const Func& func ) const
+{
+	for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+	{
+		unsigned int index= rows_offsets_[y];
+		for( unsigned int x= 0u; x < MapData::c_map_size; x++ )
+		{
+			if( ( rows_masks_[y] & ( uint64_t(1u) << x ) ) != 0u )
+			{
+				func( x, y, values_[index] );
+				index++;
+			}
+		}
+	}
+}
+
+template<class T>
+unsigned int SparseMapField<T>::BitCount( uint64_t bits )
+{
+#ifdef __GNUC__
+	return static_cast<unsigned int>( __builtin_popcountll( bits ) );
+#else
+	unsigned int count= 0u;
+	while( bits != 0u )
+	{
+		bits&= bits - 1u;
+		count++;
+	}
+	return count;
+#endif
+}
+
+template<class T>
+unsigned int SparseMapField<T>::GetValueIndex( const unsigned int x, const unsigned int y ) const
+{
+	return rows_offsets_[y] + BitCount( rows_masks_[y] & ( ( uint64_t(1u) << x ) - 1u ) );
+}
+
+} // namespace PanzerChasm
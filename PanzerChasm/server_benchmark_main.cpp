@@ -0,0 +1,321 @@
+// server_benchmark_main.cpp - entry point of headless server benchmark.
+// Loads map, connects to server synthetic players (bots), which move and shoot, and measures server loops.
+// Bots and server are in same thread and communicate via in-memory connections, so, no network is used.
+// Reports loop time distribution, traffic per bot and memory allocations per loop.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+#include "commands_processor.hpp"
+#include "connection_info.hpp"
+#include "game_constants.hpp"
+#include "game_resources.hpp"
+#include "log.hpp"
+#include "map_loader.hpp"
+#include "math_utils.hpp"
+#include "messages_extractor.inl"
+#include "profiler.hpp"
+#include "program_arguments.hpp"
+#include "server/i_connections_listener.hpp"
+#include "server/server.hpp"
+#include "settings.hpp"
+#include "shared_settings_keys.hpp"
+#include "vfs.hpp"
+
+using namespace PanzerChasm;
+
+namespace
+{
+
+// Pair of in-memory connections. Not thread-safe.
+class MemoryConnection final : public IConnection
+{
+public:
+	struct Queues
+	{
+		std::vector<unsigned char> reliable;
+		unsigned int reliable_pos= 0u;
+		std::deque< std::vector<unsigned char> > unreliable;
+		uint64_t bytes_sent= 0u;
+		bool disconnected= false;
+	};
+
+	typedef std::shared_ptr<Queues> QueuesPtr;
+
+	MemoryConnection( const QueuesPtr& in_queues, const QueuesPtr& out_queues, std::string info )
+		: in_(in_queues), out_(out_queues), info_(std::move(info))
+	{}
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* const data, const unsigned int data_size ) override
+	{
+		if( out_->disconnected ) return;
+		out_->reliable.insert( out_->reliable.end(), static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + data_size );
+		out_->bytes_sent+= data_size;
+	}
+
+	virtual void SendUnreliablePacket( const void* const data, const unsigned int data_size ) override
+	{
+		if( out_->disconnected ) return;
+		out_->unreliable.emplace_back( static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + data_size );
+		out_->bytes_sent+= data_size;
+	}
+
+	virtual unsigned int ReadRealiableData( void* const out_data, const unsigned int buffer_size ) override
+	{
+		const unsigned int result_size= std::min( buffer_size, static_cast<unsigned int>( in_->reliable.size() - in_->reliable_pos ) );
+		std::memcpy( out_data, in_->reliable.data() + in_->reliable_pos, result_size );
+		in_->reliable_pos+= result_size;
+		if( in_->reliable_pos == in_->reliable.size() )
+		{
+			in_->reliable.clear();
+			in_->reliable_pos= 0u;
+		}
+		return result_size;
+	}
+
+	virtual unsigned int ReadUnrealiableData( void* const out_data, const unsigned int buffer_size ) override
+	{
+		// Drop packets, which do not fit into buffer, like real network does.
+		while( !in_->unreliable.empty() )
+		{
+			const std::vector<unsigned char> packet= std::move( in_->unreliable.front() );
+			in_->unreliable.pop_front();
+			if( packet.size() <= buffer_size )
+			{
+				std::memcpy( out_data, packet.data(), packet.size() );
+				return packet.size();
+			}
+		}
+		return 0u;
+	}
+
+	virtual void Disconnect() override
+	{
+		in_->disconnected= out_->disconnected= true;
+	}
+
+	virtual bool Disconnected() override
+	{
+		return in_->disconnected;
+	}
+
+	virtual std::string GetConnectionInfo() override
+	{
+		return info_;
+	}
+
+private:
+	const QueuesPtr in_;
+	const QueuesPtr out_;
+	const std::string info_;
+};
+
+class MemoryConnectionsListener final : public IConnectionsListener
+{
+public:
+	void AddConnection( const IConnectionPtr& connection )
+	{
+		new_connections_.push_back( connection );
+	}
+
+public: // IConnectionsListener
+	virtual IConnectionPtr GetNewConnection() override
+	{
+		if( new_connections_.empty() )
+			return nullptr;
+
+		const IConnectionPtr result= new_connections_.back();
+		new_connections_.pop_back();
+		return result;
+	}
+
+private:
+	std::vector<IConnectionPtr> new_connections_;
+};
+
+// Bot ignores all messages from server, it only moves and shoots by script.
+struct Bot
+{
+	explicit Bot( const IConnectionPtr& connection )
+		: connection_info( connection )
+	{}
+
+	template<class Message>
+	void operator()( const Message& ) {}
+
+	ConnectionInfo connection_info;
+	MemoryConnection::QueuesPtr server_to_client_queues;
+	unsigned short move_sequence= 0u;
+};
+
+DifficultyType DifficultyNumberToDifficulty( const unsigned int n )
+{
+	switch( n )
+	{
+	case 0: return Difficulty::Easy;
+	case 1: return Difficulty::Normal;
+	case 2: return Difficulty::Hard;
+	default: return Difficulty::Normal;
+	};
+}
+
+float GetPercentile( const std::vector<float>& sorted_values, const unsigned int p )
+{
+	return sorted_values[ ( sorted_values.size() - 1u ) * p / 100u ];
+}
+
+} // namespace
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	const ProgramArguments program_arguments( argc, argv );
+
+	Settings settings( "PanzerChasmServerBenchmark.cfg" );
+	// Use fixed ticks by default, so, each loop is one map tick.
+	if( !settings.IsValue( SettingsKeys::server_tick_rate ) )
+		settings.SetSetting( SettingsKeys::server_tick_rate, 60 );
+	const unsigned int tick_rate= static_cast<unsigned int>( std::max( settings.GetOrSetInt( SettingsKeys::server_tick_rate, 60 ), 1 ) );
+
+	unsigned int bot_count= 8u;
+	if( const char* const bots_str= program_arguments.GetParamValue( "bots" ) )
+		bot_count= static_cast<unsigned int>( std::max( 1, std::min( std::atoi( bots_str ), int(GameConstants::max_players) ) ) );
+
+	float duration_s= 30.0f;
+	if( const char* const duration_str= program_arguments.GetParamValue( "duration" ) )
+		duration_s= std::max( float( std::atof( duration_str ) ), 1.0f );
+
+	const char* const map_number_str= program_arguments.GetParamValue( "map" );
+	const char* const difficulty_str= program_arguments.GetParamValue( "difficulty" );
+	const unsigned int map_number= map_number_str == nullptr ? 1u : static_cast<unsigned int>( std::atoi( map_number_str ) );
+	const DifficultyType difficulty=
+		difficulty_str == nullptr ? Difficulty::Normal : DifficultyNumberToDifficulty( std::atoi( difficulty_str ) );
+	const GameRules game_rules= program_arguments.HasParam( "coop" ) ? GameRules::Cooperative : GameRules::Deathmatch;
+
+	Log::Info( "Read game archive" );
+	const char* csm_file= "CSM.BIN";
+	if( const char* const overrided_csm_file = program_arguments.GetParamValue( "csm" ) )
+		csm_file= overrided_csm_file;
+	const VfsPtr vfs= std::make_shared<Vfs>( csm_file, program_arguments.GetParamValue( "addon" ) );
+
+	Log::Info( "Loading game resources" );
+	const GameResourcesConstPtr game_resources= LoadGameResources( vfs, LoadProfile::ServerOnly );
+	const MapLoaderPtr map_loader= std::make_shared<MapLoader>( vfs, 0u, LoadProfile::ServerOnly );
+
+	const std::shared_ptr<MemoryConnectionsListener> listener= std::make_shared<MemoryConnectionsListener>();
+
+	CommandsProcessor commands_processor( settings );
+	Server server( settings, commands_processor, game_resources, map_loader, listener, nullptr );
+	if( !server.ChangeMap( map_number, difficulty, game_rules ) )
+		return -1;
+
+	std::vector< std::unique_ptr<Bot> > bots;
+	for( unsigned int i= 0u; i < bot_count; i++ )
+	{
+		const MemoryConnection::QueuesPtr client_to_server= std::make_shared<MemoryConnection::Queues>();
+		const MemoryConnection::QueuesPtr server_to_client= std::make_shared<MemoryConnection::Queues>();
+		const std::string info= "bot " + std::to_string(i);
+
+		listener->AddConnection( std::make_shared<MemoryConnection>( client_to_server, server_to_client, info ) );
+
+		bots.emplace_back( new Bot( std::make_shared<MemoryConnection>( server_to_client, client_to_server, info ) ) );
+		bots.back()->server_to_client_queues= server_to_client;
+	}
+
+	// Count all allocations of program, including allocations in workers threads of server.
+	Profiler::SetAllocationsTrackingEnabled( true );
+
+	Log::Info( "Running benchmark with ", bot_count, " bots for ", duration_s, " s at ", tick_rate, " ticks per second" );
+
+	const auto tick_period= std::chrono::duration<double>( 1.0 / double(tick_rate) );
+	const auto start_time= std::chrono::steady_clock::now();
+	auto next_loop_time= start_time;
+
+	std::vector<float> loop_times_ms;
+	uint64_t total_allocations= 0u;
+	unsigned int loop_number= 0u;
+
+	while( std::chrono::steady_clock::now() - start_time < std::chrono::duration<double>( duration_s ) )
+	{
+		// Bots read server messages and send moves. Each bot walks in circle, periodically shoots and jumps.
+		for( unsigned int i= 0u; i < bots.size(); i++ )
+		{
+			Bot& bot= *bots[i];
+			bot.connection_info.messages_extractor.ProcessMessages( bot );
+
+			const float phase= float(loop_number) / float(tick_rate) + float(i) * 0.7f;
+
+			Messages::PlayerMove message;
+			message.sequence= ++bot.move_sequence;
+			message.view_direction= AngleToMessageAngle( phase + Constants::half_pi );
+			message.move_direction= AngleToMessageAngle( phase * 0.5f );
+			message.acceleration= ( loop_number / tick_rate + i ) % 4u == 0u ? 0u : 255u;
+			message.weapon_index= ( loop_number / ( tick_rate * 5u ) + i ) % GameConstants::weapon_count;
+			message.view_dir_angle_x= AngleToMessageAngle( 0.2f * std::sin( phase ) );
+			message.view_dir_angle_z= AngleToMessageAngle( phase );
+			message.shoot_pressed= ( loop_number + i * 7u ) % 32u < 16u;
+			message.jump_pressed= ( loop_number + i * 13u ) % 128u == 0u;
+			message.color= i % 16u;
+
+			bot.connection_info.messages_sender.SendUnreliableMessage( message );
+			bot.connection_info.messages_sender.Flush();
+		}
+
+		const uint64_t allocations_before= Profiler::GetTotalAllocations().count;
+		const auto loop_start_time= std::chrono::steady_clock::now();
+
+		server.Loop( false );
+
+		const auto loop_end_time= std::chrono::steady_clock::now();
+		total_allocations+= Profiler::GetTotalAllocations().count - allocations_before;
+
+		loop_times_ms.push_back( float( std::chrono::duration<double, std::milli>( loop_end_time - loop_start_time ).count() ) );
+		loop_number++;
+
+		// Run loops with tick rate, like real server does.
+		next_loop_time+= std::chrono::duration_cast<std::chrono::steady_clock::duration>( tick_period );
+		if( next_loop_time > loop_end_time )
+			std::this_thread::sleep_until( next_loop_time );
+		else
+			next_loop_time= loop_end_time;
+	}
+
+	if( loop_times_ms.empty() )
+		return -1;
+
+	float total_loops_time_ms= 0.0f;
+	for( const float loop_time : loop_times_ms )
+		total_loops_time_ms+= loop_time;
+
+	std::sort( loop_times_ms.begin(), loop_times_ms.end() );
+
+	const double real_time_s= std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+	const float avg_loop_time_ms= total_loops_time_ms / float(loop_times_ms.size());
+
+	uint64_t total_bytes_sent= 0u;
+	for( const std::unique_ptr<Bot>& bot : bots )
+		total_bytes_sent+= bot->server_to_client_queues->bytes_sent;
+
+	Log::Info( "Loops: ", loop_times_ms.size(), ", bots: ", bot_count );
+	Log::Info( "Loop time ms - avg: ", avg_loop_time_ms, " min: ", loop_times_ms.front(), " max: ", loop_times_ms.back() );
+	Log::Info(
+		"Loop time ms - 50%: ", GetPercentile( loop_times_ms, 50u ),
+		" 90%: ", GetPercentile( loop_times_ms, 90u ),
+		" 99%: ", GetPercentile( loop_times_ms, 99u ) );
+	Log::Info( "Server load: ", 100.0f * avg_loop_time_ms * float(tick_rate) / 1000.0f, "% of tick period" );
+	Log::Info(
+		"Sent per bot: ", double(total_bytes_sent) / double(bot_count) / 1024.0, " KB total, ",
+		double(total_bytes_sent) / double(bot_count) / real_time_s / 1024.0, " KB/s" );
+	Log::Info( "Allocations per loop: ", double(total_allocations) / double(loop_times_ms.size()) );
+
+	return 0;
+}
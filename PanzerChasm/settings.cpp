@@ -4,6 +4,7 @@
 #include "../Common/files.hpp"
 using namespace ChasmReverse;
 
+#include "assert.hpp"
 #include "log.hpp"
 
 #include "settings.hpp"
@@ -183,11 +184,13 @@ Settings::~Settings()
 void Settings::SetSetting( const char* const name, const char* const value )
 {
 	map_[ SettingsStringContainer(name) ]= std::string(value);
+	OnSettingChanged( name );
 }
 
 void Settings::SetSetting( const char* const name, const int value )
 {
 	map_[ SettingsStringContainer(name) ]= std::to_string(value);
+	OnSettingChanged( name );
 }
 
 void Settings::SetSetting( const char* const name, const bool value )
@@ -198,6 +201,7 @@ void Settings::SetSetting( const char* const name, const bool value )
 void Settings::SetSetting( const char* const name, const float value )
 {
 	map_[ SettingsStringContainer(name) ]= FloatToStr( value );
+	OnSettingChanged( name );
 }
 
 bool Settings::IsValue( const char* const name ) const
@@ -259,6 +263,7 @@ const char* Settings::GetOrSetString( const char* const name, const char* const
 	if ( it == map_.cend() )
 	{
 		map_[ SettingsStringContainer(name) ]= std::string( default_value );
+		OnSettingChanged( name );
 		return default_value;
 	}
 
@@ -276,6 +281,7 @@ int Settings::GetOrSetInt( const char* const name, const int default_value )
 	}
 
 	map_[ SettingsStringContainer(name) ]= std::to_string( default_value );
+	OnSettingChanged( name );
 	return default_value;
 }
 
@@ -290,6 +296,7 @@ float Settings::GetOrSetFloat( const char* const name, const float default_value
 	}
 
 	map_[ SettingsStringContainer(name) ]= FloatToStr( default_value );
+	OnSettingChanged( name );
 	return default_value;
 }
 
@@ -310,6 +317,123 @@ void Settings::GetSettingsKeysStartsWith(
 	}
 }
 
+Settings::BoolHandle Settings::RegisterBool( const char* const name, const bool default_value )
+{
+	GetOrSetBool( name, default_value );
+
+	BoolHandle handle;
+	handle.index= RegisterSetting( name, default_value ? 1 : 0, default_value ? 1.0f : 0.0f );
+	return handle;
+}
+
+Settings::IntHandle Settings::RegisterInt( const char* const name, const int default_value )
+{
+	GetOrSetInt( name, default_value );
+
+	IntHandle handle;
+	handle.index= RegisterSetting( name, default_value, float(default_value) );
+	return handle;
+}
+
+Settings::FloatHandle Settings::RegisterFloat( const char* const name, const float default_value )
+{
+	GetOrSetFloat( name, default_value );
+
+	FloatHandle handle;
+	handle.index= RegisterSetting( name, int(default_value), default_value );
+	return handle;
+}
+
+unsigned int Settings::AddChangeCallback( const Handle handle, ChangeCallback callback )
+{
+	PC_ASSERT( handle.index < registered_settings_.size() );
+
+	ChangeCallbackEntry entry;
+	entry.id= next_change_callback_id_;
+	entry.setting_index= handle.index;
+	entry.callback= std::move(callback);
+	change_callbacks_.push_back( std::move(entry) );
+
+	next_change_callback_id_++;
+	return change_callbacks_.back().id;
+}
+
+void Settings::RemoveChangeCallback( const unsigned int callback_id )
+{
+	for( unsigned int i= 0u; i < change_callbacks_.size(); i++ )
+	{
+		if( change_callbacks_[i].id == callback_id )
+		{
+			change_callbacks_.erase( change_callbacks_.begin() + i );
+			return;
+		}
+	}
+}
+
+unsigned int Settings::RegisterSetting( const char* const name, const int default_int_value, const float default_float_value )
+{
+	const auto it= registered_settings_indices_.find( SettingsStringContainer(name) );
+	if( it != registered_settings_indices_.end() )
+		return it->second;
+
+	const unsigned int index= registered_settings_.size();
+
+	RegisteredSetting setting;
+	setting.name= name;
+	setting.default_int_value= default_int_value;
+	setting.default_float_value= default_float_value;
+	registered_settings_.push_back( std::move(setting) );
+
+	registered_values_.emplace_back();
+	registered_settings_indices_.emplace( SettingsStringContainer( std::string(name) ), index );
+
+	UpdateRegisteredValue( index );
+	return index;
+}
+
+void Settings::UpdateRegisteredValue( const unsigned int index )
+{
+	const RegisteredSetting& setting= registered_settings_[index];
+	RegisteredValue& value= registered_values_[index];
+
+	value.int_value= setting.default_int_value;
+	value.float_value= setting.default_float_value;
+
+	const auto it= map_.find( SettingsStringContainer( setting.name.c_str() ) );
+	if( it == map_.cend() )
+		return;
+
+	int int_value;
+	if( StrToInt( it->second.data(), &int_value ) )
+		value.int_value= int_value;
+	float float_value;
+	if( StrToFloat( it->second.data(), &float_value ) )
+		value.float_value= float_value;
+}
+
+void Settings::OnSettingChanged( const char* const name )
+{
+	if( registered_settings_indices_.empty() )
+		return;
+
+	const auto it= registered_settings_indices_.find( SettingsStringContainer(name) );
+	if( it == registered_settings_indices_.end() )
+		return;
+
+	const unsigned int index= it->second;
+	UpdateRegisteredValue( index );
+
+	// Callbacks list may change inside callbacks, so, access it via index.
+	for( unsigned int i= 0u; i < change_callbacks_.size(); i++ )
+	{
+		if( change_callbacks_[i].setting_index == index )
+		{
+			const ChangeCallback callback= change_callbacks_[i].callback;
+			callback();
+		}
+	}
+}
+
 /*
 ------------------SettingsStringContainer-----------------------
 */
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -39,6 +40,32 @@ public:
 		const char* settings_key_start,
 		std::vector<std::string>& out_seettings_keys ) const;
 
+	// Registered settings - for frequent reading, without lookups by name.
+	// Value of registered setting is parsed at registration and at each change of setting and stored in flat array.
+	// If value can not be converted to number, default value of first registration is used.
+	struct Handle
+	{
+		unsigned int index;
+	};
+	struct BoolHandle : public Handle {};
+	struct IntHandle : public Handle {};
+	struct FloatHandle : public Handle {};
+
+	typedef std::function<void()> ChangeCallback;
+
+	// Like GetOrSet methods, sets value to default, if it does not exist. Repeated registration returns same handle.
+	BoolHandle RegisterBool( const char* name, bool default_value= false );
+	IntHandle RegisterInt( const char* name, int default_value= 0 );
+	FloatHandle RegisterFloat( const char* name, float default_value= 0.0f );
+
+	bool Get( const BoolHandle handle ) const { return registered_values_[ handle.index ].int_value != 0; }
+	int Get( const IntHandle handle ) const { return registered_values_[ handle.index ].int_value; }
+	float Get( const FloatHandle handle ) const { return registered_values_[ handle.index ].float_value; }
+
+	// Callback is called after each change of setting value. Returns id of callback for removing.
+	unsigned int AddChangeCallback( Handle handle, ChangeCallback callback );
+	void RemoveChangeCallback( unsigned int callback_id );
+
 private:
 	Settings( const Settings& )= delete;
 	Settings& operator=( const Settings )= delete;
@@ -70,9 +97,41 @@ private:
 
 	typedef std::map< SettingsStringContainer, std::string > MapType;
 
+	struct RegisteredValue
+	{
+		int int_value;
+		float float_value;
+	};
+
+	struct RegisteredSetting
+	{
+		std::string name;
+		int default_int_value;
+		float default_float_value;
+	};
+
+	struct ChangeCallbackEntry
+	{
+		unsigned int id;
+		unsigned int setting_index;
+		ChangeCallback callback;
+	};
+
+private:
+	unsigned int RegisterSetting( const char* name, int default_int_value, float default_float_value );
+	void UpdateRegisteredValue( unsigned int index );
+	void OnSettingChanged( const char* name );
+
 private:
 	MapType map_;
 	std::string file_name_;
+
+	std::vector<RegisteredValue> registered_values_;
+	std::vector<RegisteredSetting> registered_settings_;
+	std::map< SettingsStringContainer, unsigned int > registered_settings_indices_;
+
+	std::vector<ChangeCallbackEntry> change_callbacks_;
+	unsigned int next_change_callback_id_= 0u;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,404 @@
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "assert.hpp"
+#include "cache_files.hpp"
+#include "log.hpp"
+#include "save_load.hpp"
+
+#include "shader_program_gl.hpp"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace PanzerChasm
+{
+
+namespace
+{
+
+// Functions of "GL_ARB_get_program_binary". They are not loaded by panzer_ogl_lib, so, load them here.
+typedef void (APIENTRY *GetProgramBinaryFunc)( GLuint program, GLsizei buf_size, GLsizei* length, GLenum* binary_format, void* binary );
+typedef void (APIENTRY *ProgramBinaryFunc)( GLuint program, GLenum binary_format, const void* binary, GLsizei length );
+typedef void (APIENTRY *ProgramParameteriFunc)( GLuint program, GLenum pname, GLint value );
+
+GetProgramBinaryFunc g_get_program_binary= nullptr;
+ProgramBinaryFunc g_program_binary= nullptr;
+ProgramParameteriFunc g_program_parameteri= nullptr;
+
+// Binary is valid only for exact driver, which produced it.
+std::string g_driver_string;
+
+ShaderProgramGL::LogCallback g_build_log_callback;
+
+struct ProgramBinaryHeader
+{
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 1u;
+
+	char id[8];
+	unsigned int version;
+	unsigned int source_hash;
+	unsigned int binary_format;
+	unsigned int data_size;
+	unsigned int content_hash;
+};
+
+SIZE_ASSERT( ProgramBinaryHeader, 28u );
+
+const char ProgramBinaryHeader::c_expected_id[8]= "PanShdC";
+
+bool BinariesCacheEnabled()
+{
+	return g_get_program_binary != nullptr && g_program_binary != nullptr && g_program_parameteri != nullptr;
+}
+
+bool IsExtensionSupported( const char* const extension_name )
+{
+	GLint extension_count= 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &extension_count );
+	for( GLint i= 0; i < extension_count; i++ )
+	{
+		const char* const extension= reinterpret_cast<const char*>( glGetStringi( GL_EXTENSIONS, i ) );
+		if( extension != nullptr && std::strcmp( extension, extension_name ) == 0 )
+			return true;
+	}
+	return false;
+}
+
+void GetCacheFileName( const unsigned int source_hash, char* const out_file_name, const size_t size )
+{
+	std::snprintf( out_file_name, size, CACHE_FILES_DIR"/shader_%08x.pcs", source_hash );
+}
+
+void PrintShaderLog( const GLuint shader )
+{
+	GLint log_length= 0;
+	glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &log_length );
+	if( log_length <= 1 || g_build_log_callback == nullptr )
+		return;
+
+	std::vector<char> log( log_length );
+	glGetShaderInfoLog( shader, log_length, nullptr, log.data() );
+	g_build_log_callback( log.data() );
+}
+
+void PrintProgramLog( const GLuint program )
+{
+	GLint log_length= 0;
+	glGetProgramiv( program, GL_INFO_LOG_LENGTH, &log_length );
+	if( log_length <= 1 || g_build_log_callback == nullptr )
+		return;
+
+	std::vector<char> log( log_length );
+	glGetProgramInfoLog( program, log_length, nullptr, log.data() );
+	g_build_log_callback( log.data() );
+}
+
+} // namespace
+
+void ShaderProgramGL::SetProgramBuildLogOutCallback( LogCallback callback )
+{
+	g_build_log_callback= std::move(callback);
+}
+
+void ShaderProgramGL::InitBinariesCache( const GetProcAddressFunc get_proc_address_func )
+{
+	g_get_program_binary= nullptr;
+	g_program_binary= nullptr;
+	g_program_parameteri= nullptr;
+	g_driver_string.clear();
+
+	if( !IsExtensionSupported( "GL_ARB_get_program_binary" ) )
+	{
+		Log::Info( "GL_ARB_get_program_binary not supported, shaders binaries cache disabled" );
+		return;
+	}
+
+	// Driver may support extension, but not support any binary format.
+	GLint binary_format_count= 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &binary_format_count );
+	if( binary_format_count <= 0 )
+	{
+		Log::Info( "No program binary formats supported, shaders binaries cache disabled" );
+		return;
+	}
+
+	g_get_program_binary= reinterpret_cast<GetProgramBinaryFunc>( get_proc_address_func( "glGetProgramBinary" ) );
+	g_program_binary= reinterpret_cast<ProgramBinaryFunc>( get_proc_address_func( "glProgramBinary" ) );
+	g_program_parameteri= reinterpret_cast<ProgramParameteriFunc>( get_proc_address_func( "glProgramParameteri" ) );
+	if( !BinariesCacheEnabled() )
+	{
+		Log::Warning( "Can not load GL_ARB_get_program_binary functions, shaders binaries cache disabled" );
+		g_get_program_binary= nullptr;
+		g_program_binary= nullptr;
+		g_program_parameteri= nullptr;
+		return;
+	}
+
+	for( const GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION } )
+	{
+		if( const GLubyte* const str= glGetString( name ) )
+			g_driver_string+= reinterpret_cast<const char*>( str );
+		g_driver_string.push_back( '\n' );
+	}
+}
+
+ShaderProgramGL::ShaderProgramGL()
+{}
+
+ShaderProgramGL::~ShaderProgramGL()
+{
+	if( program_id_ != 0u )
+		glDeleteProgram( program_id_ );
+}
+
+void ShaderProgramGL::SetAttribLocation( const char* const name, const unsigned int location )
+{
+	attributes_.emplace_back( name, location );
+}
+
+void ShaderProgramGL::Create()
+{
+	PC_ASSERT( program_id_ == 0u );
+
+	unsigned int source_hash= 0u;
+	if( BinariesCacheEnabled() )
+	{
+		source_hash= CalculateSourceHash();
+		if( LoadBinary( source_hash ) )
+			return;
+	}
+
+	program_id_= glCreateProgram();
+	if( !CompileAndLink() )
+		return;
+
+	if( BinariesCacheEnabled() )
+		SaveBinary( source_hash );
+}
+
+void ShaderProgramGL::Bind() const
+{
+	glUseProgram( program_id_ );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const int i )
+{
+	glUniform1i( GetUniformLocation( name ), i );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const float f )
+{
+	glUniform1f( GetUniformLocation( name ), f );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const m_Vec2& v )
+{
+	glUniform2f( GetUniformLocation( name ), v.x, v.y );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const m_Vec3& v )
+{
+	glUniform3f( GetUniformLocation( name ), v.x, v.y, v.z );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const float x, const float y, const float z, const float w )
+{
+	glUniform4f( GetUniformLocation( name ), x, y, z, w );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const m_Mat3& m )
+{
+	glUniformMatrix3fv( GetUniformLocation( name ), 1, GL_FALSE, m.value );
+}
+
+void ShaderProgramGL::Uniform( const char* const name, const m_Mat4& m )
+{
+	glUniformMatrix4fv( GetUniformLocation( name ), 1, GL_FALSE, m.value );
+}
+
+GLint ShaderProgramGL::GetUniformLocation( const char* const name )
+{
+	// Programs have only few uniforms, so, linear search is faster, than "glGetUniformLocation" call.
+	for( const UniformLocation& uniform_location : uniforms_locations_ )
+		if( uniform_location.first == name )
+			return uniform_location.second;
+
+	const GLint location= glGetUniformLocation( program_id_, name );
+	uniforms_locations_.emplace_back( name, location );
+	return location;
+}
+
+void ShaderProgramGL::SetSources( std::string frag_source, std::string vert_source, std::string geom_source )
+{
+	frag_source_= std::move(frag_source);
+	vert_source_= std::move(vert_source);
+	geom_source_= std::move(geom_source);
+}
+
+unsigned int ShaderProgramGL::CalculateSourceHash() const
+{
+	// Sources are already preprocessed by loader, so, they contain version and defines.
+	std::string key= g_driver_string;
+	for( const std::string* const source : { &vert_source_, &geom_source_, &frag_source_ } )
+	{
+		key+= *source;
+		key.push_back( '\0' );
+	}
+	for( const std::pair< std::string, unsigned int >& attribute : attributes_ )
+	{
+		key+= attribute.first;
+		key.push_back( '\0' );
+		key+= std::to_string( attribute.second );
+		key.push_back( '\0' );
+	}
+
+	return SaveHeader::CalculateHash( reinterpret_cast<const unsigned char*>( key.data() ), key.size() );
+}
+
+bool ShaderProgramGL::LoadBinary( const unsigned int source_hash )
+{
+	char file_name[128];
+	GetCacheFileName( source_hash, file_name, sizeof(file_name) );
+
+	ProgramBinaryHeader header;
+	std::vector<unsigned char> data;
+	if( !ReadCacheFile( file_name, &header, sizeof(ProgramBinaryHeader), data ) )
+		return false;
+
+	if( std::memcmp( header.id, ProgramBinaryHeader::c_expected_id, sizeof(header.id) ) != 0 ||
+		header.version != ProgramBinaryHeader::c_expected_version ||
+		header.source_hash != source_hash ||
+		header.data_size != data.size() )
+		return false;
+
+	if( SaveHeader::CalculateHash( data.data(), data.size() ) != header.content_hash )
+	{
+		Log::Warning( "Shaders cache \"", file_name, "\" is broken" );
+		return false;
+	}
+
+	// Driver may reject binary, for example, after driver update. Compile program from sources in such case.
+	const GLuint program_id= glCreateProgram();
+	g_program_binary( program_id, header.binary_format, data.data(), GLsizei( data.size() ) );
+
+	GLint link_status= 0;
+	glGetProgramiv( program_id, GL_LINK_STATUS, &link_status );
+	if( link_status == 0 )
+	{
+		glDeleteProgram( program_id );
+		return false;
+	}
+
+	program_id_= program_id;
+	return true;
+}
+
+void ShaderProgramGL::SaveBinary( const unsigned int source_hash ) const
+{
+	GLint binary_length= 0;
+	glGetProgramiv( program_id_, GL_PROGRAM_BINARY_LENGTH, &binary_length );
+	if( binary_length <= 0 )
+		return;
+
+	std::vector<unsigned char> data( binary_length );
+	GLsizei actual_length= 0;
+	GLenum binary_format= 0;
+	g_get_program_binary( program_id_, binary_length, &actual_length, &binary_format, data.data() );
+	if( actual_length <= 0 )
+		return;
+	data.resize( actual_length );
+
+	char file_name[128];
+	GetCacheFileName( source_hash, file_name, sizeof(file_name) );
+
+	ProgramBinaryHeader header;
+	std::memcpy( header.id, ProgramBinaryHeader::c_expected_id, sizeof(header.id) );
+	header.version= ProgramBinaryHeader::c_expected_version;
+	header.source_hash= source_hash;
+	header.binary_format= binary_format;
+	header.data_size= data.size();
+	header.content_hash= SaveHeader::CalculateHash( data.data(), data.size() );
+
+	WriteCacheFile(
+		file_name,
+		{
+			{ &header, sizeof(ProgramBinaryHeader) },
+			{ data.data(), data.size() },
+		} );
+}
+
+bool ShaderProgramGL::CompileAndLink()
+{
+	const std::pair< GLenum, const std::string* > stages[]=
+	{
+		{ GL_VERTEX_SHADER, &vert_source_ },
+		{ GL_GEOMETRY_SHADER, &geom_source_ },
+		{ GL_FRAGMENT_SHADER, &frag_source_ },
+	};
+
+	bool ok= true;
+	GLuint shaders[3]= { 0u, 0u, 0u };
+	for( unsigned int i= 0u; i < 3u; i++ )
+	{
+		const std::string& source= *stages[i].second;
+		if( source.empty() )
+			continue;
+
+		shaders[i]= glCreateShader( stages[i].first );
+		const char* const source_data= source.data();
+		const GLint source_size= GLint( source.size() );
+		glShaderSource( shaders[i], 1, &source_data, &source_size );
+		glCompileShader( shaders[i] );
+
+		GLint compile_status= 0;
+		glGetShaderiv( shaders[i], GL_COMPILE_STATUS, &compile_status );
+		if( compile_status == 0 )
+		{
+			PrintShaderLog( shaders[i] );
+			ok= false;
+		}
+
+		glAttachShader( program_id_, shaders[i] );
+	}
+
+	for( const std::pair< std::string, unsigned int >& attribute : attributes_ )
+		glBindAttribLocation( program_id_, attribute.second, attribute.first.c_str() );
+
+	if( BinariesCacheEnabled() )
+		g_program_parameteri( program_id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+
+	if( ok )
+	{
+		glLinkProgram( program_id_ );
+
+		GLint link_status= 0;
+		glGetProgramiv( program_id_, GL_LINK_STATUS, &link_status );
+		if( link_status == 0 )
+		{
+			PrintProgramLog( program_id_ );
+			ok= false;
+		}
+	}
+
+	for( const GLuint shader : shaders )
+	{
+		if( shader == 0u )
+			continue;
+		glDetachShader( program_id_, shader );
+		glDeleteShader( shader );
+	}
+
+	return ok;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,95 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <matrix.hpp>
+#include <panzer_ogl_lib.hpp>
+#include <vec.hpp>
+
+namespace PanzerChasm
+{
+
+// GLSL program with cache of linked program binaries.
+// Has same interface, as r_GLSLProgram from panzer_ogl_lib, which compiles programs inside "Create" and has no way to load binaries.
+// Binaries are keyed by hash of sources, attributes locations and driver strings and are stored in "cache" directory.
+// So, programs are compiled only once - not on each start and video restart. If binary loading fails, program is compiled from sources.
+// Uniforms locations are cached too, so, setting uniforms in hot loops does not query driver.
+class ShaderProgramGL final
+{
+public:
+	typedef std::function<void(const char*)> LogCallback;
+	typedef void* (*GetProcAddressFunc)( const char* name );
+
+	static void SetProgramBuildLogOutCallback( LogCallback callback );
+
+	// Call it after creation of each OpenGL context. Binaries cache is enabled only if "GL_ARB_get_program_binary" is supported.
+	static void InitBinariesCache( GetProcAddressFunc get_proc_address_func );
+
+	ShaderProgramGL();
+	ShaderProgramGL( const ShaderProgramGL& other )= delete;
+	~ShaderProgramGL();
+
+	ShaderProgramGL& operator=( const ShaderProgramGL& other )= delete;
+
+	// Accepts sources in any container of chars, like result of "rLoadShader".
+	template<class Source>
+	void ShaderSource( const Source& frag_source, const Source& vert_source )
+	{
+		SetSources( SourceToString( frag_source ), SourceToString( vert_source ), std::string() );
+	}
+
+	template<class Source>
+	void ShaderSource( const Source& frag_source, const Source& vert_source, const Source& geom_source )
+	{
+		SetSources( SourceToString( frag_source ), SourceToString( vert_source ), SourceToString( geom_source ) );
+	}
+
+	void SetAttribLocation( const char* name, unsigned int location );
+
+	void Create();
+	void Bind() const;
+
+	// Program must be bound.
+	void Uniform( const char* name, int i );
+	void Uniform( const char* name, float f );
+	void Uniform( const char* name, const m_Vec2& v );
+	void Uniform( const char* name, const m_Vec3& v );
+	void Uniform( const char* name, float x, float y, float z, float w );
+	void Uniform( const char* name, const m_Mat3& m );
+	void Uniform( const char* name, const m_Mat4& m );
+
+private:
+	template<class Source>
+	static std::string SourceToString( const Source& source )
+	{
+		std::string result( source.begin(), source.end() );
+		// Loaded sources may be null-terminated.
+		while( !result.empty() && result.back() == '\0' )
+			result.pop_back();
+		return result;
+	}
+
+	void SetSources( std::string frag_source, std::string vert_source, std::string geom_source );
+
+	// Returns cached location, or queries it from driver for first use of uniform.
+	GLint GetUniformLocation( const char* name );
+
+	unsigned int CalculateSourceHash() const;
+	bool LoadBinary( unsigned int source_hash );
+	void SaveBinary( unsigned int source_hash ) const;
+	bool CompileAndLink();
+
+private:
+	std::string frag_source_;
+	std::string vert_source_;
+	std::string geom_source_; // May be empty.
+	std::vector< std::pair< std::string, unsigned int > > attributes_;
+
+	typedef std::pair< std::string, GLint > UniformLocation;
+	std::vector<UniformLocation> uniforms_locations_;
+
+	GLuint program_id_= 0u;
+};
+
+} // namespace PanzerChasm
@@ -14,8 +14,28 @@ const char old_style_perspective[]= "cl_old_style_perspective";
 const char player_color[]= "cl_color";
 const char player_name[]= "cl_name";
 
+// Ticks per second. If zero - tick duration is variable, one tick (or some ticks) per frame.
+const char server_tick_rate[]= "sv_tick_rate";
+// Updates per second, sent to clients. If zero - send updates at each loop.
+const char server_send_rate[]= "sv_send_rate";
+// Threads for parallel tasks of server map. If zero - select count of threads, using hardware concurrency.
+const char server_workers_threads[]= "sv_workers_threads";
+// If true - server uses one udp socket for all clients, instead of udp port for each client.
+const char server_shared_udp_socket[]= "sv_shared_udp_socket";
+// If true - network input and output of server is performed in separate thread.
+const char server_net_thread[]= "sv_net_thread";
+// File for periodic server metrics in line protocol. If empty - metrics are not written.
+const char server_metrics_file[]= "sv_metrics_file";
+// Interval of metrics writing, in seconds.
+const char server_metrics_interval[]= "sv_metrics_interval";
+// Password of spectator relays. Server accepts relays only with same password. If empty - relays are not accepted.
+const char server_relay_password[]= "sv_relay_password";
+// Memory budget in megabytes for cache of recently used maps.
+const char map_cache_size[]= "map_cache_size";
+
 const char fx_volume[]= "s_volume";
 const char cd_volume[]= "cd_volume";
+const char sound_resample_on_load[]= "s_resample_on_load";
 const char mouse_sensetivity[]= "cl_mouse_speed";
 const char fov[]= "cl_fov";
 
@@ -39,12 +59,28 @@ const char fullscreen_frequency[]= "r_fullscreen_frequency";
 
 const char software_rendering[]= "r_software_rendering";
 const char software_scale[]= "r_software_scale";
+const char software_rendering_threads[]= "r_software_threads";
+const char software_rendering_simd[]= "r_software_simd";
+const char software_surfaces_prefetch[]= "r_software_surfaces_prefetch";
+const char software_surfaces_cache_size[]= "r_software_surfaces_cache_size";
+const char software_pvs[]= "r_software_pvs";
+const char software_dynamic_resolution[]= "r_software_dynamic_resolution";
+const char software_dynamic_resolution_fps[]= "r_software_dynamic_resolution_fps";
+const char software_dynamic_lights[]= "r_software_dynamic_lights";
+const char software_smooth_lighting[]= "r_software_smooth_lighting";
 
 const char opengl_dynamic_lighting[]= "r_dynamic_lighting";
+const char opengl_geometry_shaders[]= "r_geometry_shaders";
 const char opengl_textures_filtering[]= "r_filter_textures";
 const char opengl_menu_textures_filtering[]= "r_filter_menu_textures";
 const char opengl_hud_textures_filtering[]= "r_filter_hud_textures";
 const char opengl_msaa_level[]= "r_msaa_level";
+const char opengl_occlusion_culling[]= "r_occlusion_culling";
+const char opengl_textures_compression[]= "r_textures_compression";
+const char opengl_progressive_loading[]= "r_progressive_loading";
+const char opengl_compressed_monsters_animations[]= "r_compressed_monsters_animations";
+const char opengl_dynamic_resolution[]= "r_dynamic_resolution";
+const char opengl_dynamic_resolution_fps[]= "r_dynamic_resolution_fps";
 
 const char shadows[]= "r_shadows";
 const char brightness[]= "r_brightness";
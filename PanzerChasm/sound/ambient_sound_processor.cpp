@@ -9,7 +9,7 @@ namespace Sound
 {
 
 AmbientSoundProcessor::AmbientSoundProcessor()
-	: prev_tick_time_( Time::CurrentTime() )
+	: prev_tick_time_( Time::FrameTime() )
 {}
 
 AmbientSoundProcessor::~AmbientSoundProcessor()
@@ -27,12 +27,14 @@ void AmbientSoundProcessor::UpdatePosition( const m_Vec2& pos )
 {
 	const float c_change_time_s= 0.5f;
 
-	const Time current_tick_time= Time::CurrentTime();
+	const Time current_tick_time= Time::FrameTime();
 	const float tick_delta_s= ( current_tick_time - prev_tick_time_ ).ToSeconds();
 	prev_tick_time_= current_tick_time;
 
 	unsigned int next_sound_id= 0u;
 
+	// Ambient sound is taken from single cell under listener, volume is smoothed in time, not in space.
+	// So, this is only one lookup per update.
 	if( map_data_ != nullptr )
 	{
 		unsigned int x= static_cast<unsigned int>( std::floor( pos.x ) );
@@ -22,10 +22,31 @@ struct Channel
 
 	unsigned int position_samples;
 	bool looped;
+	unsigned int play_id= 0u;
 
 	ISoundData* src_sound_data= nullptr;
 };
 
+// Command from game thread to audio thread.
+struct ChannelCommand
+{
+	enum class Type
+	{
+		Play, // Start playing "sound" from given position.
+		Stop,
+		Update, // Set volume and looping.
+	};
+
+	Type type= Type::Stop;
+	unsigned int channel= 0u;
+
+	unsigned int play_id= 0u; // Play only. Reported back by driver, when non-looped sound ends.
+	ISoundData* sound= nullptr; // Play only.
+	unsigned int position_samples= 0u; // Play only.
+	bool looped= false;
+	float volume[2]= { 0.0f, 0.0f };
+};
+
 typedef std::array<Channel, Channel::c_max_channels> Channels;
 
 } // namespace Sound
@@ -1,4 +1,4 @@
-#include <limits>
+#include <algorithm>
 
 #include <SDL.h>
 
@@ -25,16 +25,37 @@ static int NearestPowerOfTwoFloor( int x )
 	return r;
 }
 
-static const unsigned int g_frac_bits= 10u;
-static const unsigned int g_frac= 1u << g_frac_bits;
-static const unsigned int g_frac_minus_one= g_frac - 1u;
-static_assert( g_frac_bits >= 8u, "Too low fractional bits" );
+Driver::CommandsQueue::CommandsQueue()
+	: write_pos_(0u), read_pos_(0u)
+{}
 
-const int g_volume_bits= 8;
-const int g_volume_scale= 1 << g_volume_bits;
+bool Driver::CommandsQueue::Push( const ChannelCommand& command )
+{
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	if( write_pos - read_pos_.load( std::memory_order_acquire ) >= c_size )
+		return false;
+
+	commands_[ write_pos & ( c_size - 1u ) ]= command;
+	write_pos_.store( write_pos + 1u, std::memory_order_release );
+	return true;
+}
+
+bool Driver::CommandsQueue::Pop( ChannelCommand& out_command )
+{
+	const unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+	if( read_pos == write_pos_.load( std::memory_order_acquire ) )
+		return false;
+
+	out_command= commands_[ read_pos & ( c_size - 1u ) ];
+	read_pos_.store( read_pos + 1u, std::memory_order_release );
+	return true;
+}
 
 Driver::Driver()
 {
+	for( std::atomic<unsigned int>& play_id : finished_play_ids_ )
+		play_id.store( 0u );
+
 	SDL_InitSubSystem( SDL_INIT_AUDIO );
 
 	SDL_AudioSpec requested_format;
@@ -78,8 +99,7 @@ Driver::Driver()
 	}
 
 	frequency_= obtained_format.freq;
-
-	mix_buffer_.resize( obtained_format.samples * g_left_and_right );
+	mixer_.reset( new Mixer( frequency_, obtained_format.samples ) );
 
 	// Run
 	SDL_PauseAudioDevice( device_id_ , 0 );
@@ -94,6 +114,42 @@ Driver::~Driver()
 	SDL_QuitSubSystem( SDL_INIT_AUDIO );
 }
 
+bool Driver::PushCommand( const ChannelCommand& command )
+{
+	PC_ASSERT( command.channel < Channel::c_max_channels );
+	return commands_queue_.Push( command );
+}
+
+unsigned int Driver::GetFinishedPlayId( const unsigned int channel ) const
+{
+	PC_ASSERT( channel < Channel::c_max_channels );
+	return finished_play_ids_[ channel ].load( std::memory_order_acquire );
+}
+
+void Driver::StopChannelSync( const unsigned int channel )
+{
+	PC_ASSERT( channel < Channel::c_max_channels );
+
+	// Audio callback is not running under lock, so, we can act as queue consumer here.
+	LockChannels();
+	ApplyCommands();
+	channels_[ channel ].is_active= false;
+	channels_[ channel ].src_sound_data= nullptr;
+	UnlockChannels();
+}
+
+void Driver::StopAllChannelsSync()
+{
+	LockChannels();
+	ApplyCommands();
+	for( Channel& channel : channels_ )
+	{
+		channel.is_active= false;
+		channel.src_sound_data= nullptr;
+	}
+	UnlockChannels();
+}
+
 void Driver::LockChannels()
 {
 	if( device_id_ >= g_first_valid_device_id )
@@ -106,9 +162,42 @@ void Driver::UnlockChannels()
 		SDL_UnlockAudioDevice( device_id_ );
 }
 
-Channels& Driver::GetChannels()
+void Driver::ApplyCommands()
 {
-	return channels_;
+	ChannelCommand command;
+	while( commands_queue_.Pop( command ) )
+	{
+		Channel& channel= channels_[ command.channel ];
+		switch( command.type )
+		{
+		case ChannelCommand::Type::Play:
+			channel.is_active= true;
+			channel.position_samples=
+				command.sound == nullptr ? 0u : std::min( command.position_samples, command.sound->sample_count_ );
+			channel.play_id= command.play_id;
+			channel.src_sound_data= command.sound;
+			channel.looped= command.looped;
+			channel.volume[0]= command.volume[0];
+			channel.volume[1]= command.volume[1];
+			break;
+
+		case ChannelCommand::Type::Stop:
+			channel.is_active= false;
+			channel.src_sound_data= nullptr;
+			break;
+
+		case ChannelCommand::Type::Update:
+			channel.looped= command.looped;
+			channel.volume[0]= command.volume[0];
+			channel.volume[1]= command.volume[1];
+			break;
+		};
+	}
+}
+
+unsigned int Driver::GetFrequency() const
+{
+	return frequency_;
 }
 
 void SDLCALL Driver::AudioCallback( void* userdata, Uint8* stream, int len_bytes )
@@ -122,116 +211,15 @@ void SDLCALL Driver::AudioCallback( void* userdata, Uint8* stream, int len_bytes
 
 void Driver::FillAudioBuffer( SampleType* const buffer, const unsigned int sample_count )
 {
-	PC_ASSERT( sample_count * g_left_and_right <= mix_buffer_.size() );
-
-	// Zero mix buffer.
-	for( unsigned int i= 0u; i < sample_count * g_left_and_right; i++ )
-		mix_buffer_[i]= 0;
-
-	for( Channel& channel : channels_ )
-	{
-		if( !channel.is_active || channel.src_sound_data == nullptr )
-			continue;
-
-		// Fill destination audio buffer with iterpolation,
-		// because original game sounds have frequency about 11025 Hz, but destination buffer have frequency 22050 - 44100 Hz.
-		const unsigned int freq_ratio_f= ( channel.src_sound_data->frequency_ << g_frac_bits ) / frequency_;
-		const int volume[2]=
-		{
-			static_cast<int>( channel.volume[0] * float( g_volume_scale ) ),
-			static_cast<int>( channel.volume[1] * float( g_volume_scale ) ),
-		};
-
-		unsigned int channel_dst_samples_processed= 0u;
-		do
-		{
-			const auto max_dst_sample_for_src_sample=
-			[&]( const unsigned int i ) -> unsigned int
-			{
-				if( i == 0u ) return 0u;
-				const unsigned int result= ( ( i << g_frac_bits ) - 1u ) / freq_ratio_f;
-				PC_ASSERT( ( ( result * freq_ratio_f ) >> g_frac_bits ) < i );
-				return result + 1u;
-			};
-
-			int* const dst= mix_buffer_.data() + channel_dst_samples_processed * g_left_and_right;
-			const unsigned int can_read_src_samples= std::max( int( channel.src_sound_data->sample_count_ - channel.position_samples ) - 1, 0 );
-			const unsigned int dst_samples_to_write=
-				std::min(
-					sample_count - channel_dst_samples_processed,
-					max_dst_sample_for_src_sample( can_read_src_samples ) );
-
-			switch( channel.src_sound_data->data_type_ )
-			{
-			case ISoundData::DataType::Unsigned8:
-				{
-					const unsigned char* const src=
-						static_cast<const unsigned char*>( channel.src_sound_data->data_ ) + channel.position_samples;
-
-					for( unsigned int i= 0u; i < dst_samples_to_write; i++ )
-					{
-						const unsigned int sample_coord_f= i * freq_ratio_f;
-						const unsigned int sample_coord= sample_coord_f >> g_frac_bits;
-						const unsigned int part= sample_coord_f & ( g_frac - 1u );
-						PC_ASSERT( sample_coord + 1u < channel.src_sound_data->sample_count_ - channel.position_samples );
-
-						// Value in range [ 0; 255 * g_frac ]
-						const unsigned int mixed_src_sample=
-							src[ sample_coord ] * ( g_frac - part ) + src[ sample_coord + 1u ] * part;
-						const int signed_sample= int( mixed_src_sample ) - ( 128 << g_frac_bits );
-
-						dst[ i * 2u      ]+= ( signed_sample * volume[0] ) >> ( int(g_frac_bits) + g_volume_bits - 8 );
-						dst[ i * 2u + 1u ]+= ( signed_sample * volume[1] ) >> ( int(g_frac_bits) + g_volume_bits - 8  );
-					}
-				}
-				break;
-
-			case ISoundData::DataType::Signed8:
-			{
-				const char* const src=
-					static_cast<const char*>( channel.src_sound_data->data_ ) + channel.position_samples;
-
-				for( unsigned int i= 0u; i < dst_samples_to_write; i++ )
-				{
-					const unsigned int sample_coord_f= i * freq_ratio_f;
-					const unsigned int sample_coord= sample_coord_f >> g_frac_bits;
-					const unsigned int part= sample_coord_f & ( g_frac - 1u );
-					PC_ASSERT( sample_coord + 1u < channel.src_sound_data->sample_count_ - channel.position_samples );
-
-					// Value in range [ -128 * g_frac; 127 * g_frac ]
-					const int signed_sample=
-						int( src[ sample_coord ] * ( g_frac - part ) ) + int( src[ sample_coord + 1u ] * part );
-
-					dst[ i * 2u      ]+= ( signed_sample * volume[0] ) >> ( int(g_frac_bits) + g_volume_bits - 8 );
-					dst[ i * 2u + 1u ]+= ( signed_sample * volume[1] ) >> ( int(g_frac_bits) + g_volume_bits - 8 );
-				}
-			}
-			break;
-
-			case ISoundData::DataType::Signed16:
-			case ISoundData::DataType::Unsigned16:
-				PC_ASSERT( false ); // TODO
-				break;
-			};
-
-			channel.position_samples+= ( ( sample_count - channel_dst_samples_processed ) * freq_ratio_f ) >> g_frac_bits;
-			channel.position_samples= std::min( channel.position_samples, channel.src_sound_data->sample_count_ );
-			channel_dst_samples_processed+= dst_samples_to_write;
-
-			if( channel.looped &&
-				( channel.position_samples >= channel.src_sound_data->sample_count_ || dst_samples_to_write == 0u ) )
-				channel.position_samples= 0u;
+	ApplyCommands();
 
-			} while( channel.looped && channel_dst_samples_processed < sample_count );
-	} // for channels
+	unsigned int finished_channels_mask= mixer_->Mix( channels_, buffer, sample_count );
 
-	// Copy mix buffer to result buffer.
-	for( unsigned int i= 0u; i < sample_count * g_left_and_right; i++ )
+	// Report finished sounds to game thread.
+	for( unsigned int i= 0u; finished_channels_mask != 0u; i++, finished_channels_mask>>= 1u )
 	{
-		int s= mix_buffer_[i];
-		if( s > +32767 ) s= +32767;
-		if( s < -32767 ) s= -32767;
-		buffer[i]= s;
+		if( ( finished_channels_mask & 1u ) != 0u )
+			finished_play_ids_[i].store( channels_[i].play_id, std::memory_order_release );
 	}
 }
 
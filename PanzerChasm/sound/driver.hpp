@@ -1,9 +1,12 @@
 #pragma once
-#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
 
 #include <SDL_audio.h>
 
 #include "channel.hpp"
+#include "mixer.hpp"
 
 namespace PanzerChasm
 {
@@ -17,21 +20,59 @@ public:
 	Driver();
 	~Driver();
 
-	void LockChannels();
-	void UnlockChannels();
-	Channels& GetChannels();
+	// Never blocks. Commands are applied by audio thread at start of next callback.
+	// Returns false, if commands queue is full - caller should retry later.
+	bool PushCommand( const ChannelCommand& command );
+
+	// Returns "play_id" of last non-looped sound, which reached its end in given channel.
+	unsigned int GetFinishedPlayId( unsigned int channel ) const;
+
+	// Apply pending commands and stop channels immediately. Blocks audio thread for short time.
+	// Use it before destroying sound data, which channels may still play.
+	void StopChannelSync( unsigned int channel );
+	void StopAllChannelsSync();
+
+	// Sounds with this frequency and signed 16-bit samples are mixed without resampling.
+	unsigned int GetFrequency() const;
+
+private:
+	// Lock-free queue for one producer (game thread) and one consumer (audio thread).
+	class CommandsQueue final
+	{
+	public:
+		CommandsQueue();
+
+		bool Push( const ChannelCommand& command );
+		bool Pop( ChannelCommand& out_command );
+
+	private:
+		static constexpr unsigned int c_size= 256u; // Must be power of two.
+
+		std::array<ChannelCommand, c_size> commands_;
+		// Free-running positions. Difference of positions is count of commands in queue.
+		std::atomic<unsigned int> write_pos_;
+		std::atomic<unsigned int> read_pos_;
+	};
 
 private:
 	static void SDLCALL AudioCallback( void* userdata, Uint8* stream, int len_bytes );
 	void FillAudioBuffer( SampleType* buffer, unsigned int sample_count );
+	void ApplyCommands();
+
+	void LockChannels();
+	void UnlockChannels();
 
 private:
+	// Accessed only from audio thread, or under audio lock.
 	Channels channels_;
 
+	CommandsQueue commands_queue_;
+	std::array< std::atomic<unsigned int>, Channel::c_max_channels > finished_play_ids_;
+
 	SDL_AudioDeviceID device_id_= 0u;
-	unsigned int frequency_; // samples per second
+	unsigned int frequency_= 22050u; // samples per second
 
-	std::vector<int> mix_buffer_;
+	std::unique_ptr<Mixer> mixer_; // Created after device opening.
 };
 
 } // namespace Sound
@@ -0,0 +1,265 @@
+#include <algorithm>
+
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
+
+#include "../assert.hpp"
+
+#include "sounds_loader.hpp"
+
+#include "mixer.hpp"
+
+namespace PanzerChasm
+{
+
+namespace Sound
+{
+
+static const unsigned int g_left_and_right= 2u;
+
+static const unsigned int g_frac_bits= 10u;
+static const unsigned int g_frac= 1u << g_frac_bits;
+static const unsigned int g_frac_minus_one= g_frac - 1u;
+static_assert( g_frac_bits >= 8u, "Too low fractional bits" );
+
+static const int g_volume_bits= 8;
+static const int g_volume_scale= 1 << g_volume_bits;
+static const int g_mix_shift= int(g_frac_bits) + g_volume_bits - 8;
+
+// Resample channel with linear interpolation, apply volume and add result to stereo mix buffer.
+// "c_zero_level" - value of silence for source sample type.
+// "c_interpolation_shift" - shift of interpolated sample before volume applying, needed for 16-bit samples to prevent overflow.
+// "c_volume_shift" - shift of result, scales sample to 16-bit range.
+// Scalar code here is faster, than SSE2 - source samples gathering takes more time, than vectorized arithmetic saves.
+template<class SrcSample, int c_zero_level, int c_interpolation_shift, int c_volume_shift>
+static void MixChannel(
+	const SrcSample* const src,
+	const unsigned int src_samples_left,
+	const unsigned int dst_samples,
+	const unsigned int freq_ratio_f,
+	const int* const volume,
+	int* const dst )
+{
+	PC_UNUSED( src_samples_left );
+
+	for( unsigned int i= 0u; i < dst_samples; i++ )
+	{
+		const unsigned int sample_coord_f= i * freq_ratio_f;
+		const unsigned int sample_coord= sample_coord_f >> g_frac_bits;
+		const unsigned int part= sample_coord_f & ( g_frac - 1u );
+		PC_ASSERT( sample_coord + 1u < src_samples_left );
+
+		// Value in range [ c_min_sample * g_frac; c_max_sample * g_frac ] >> c_interpolation_shift
+		const int signed_sample=
+			( ( int( src[ sample_coord ] ) - c_zero_level ) * int( g_frac - part ) +
+			  ( int( src[ sample_coord + 1u ] ) - c_zero_level ) * int( part ) ) >> c_interpolation_shift;
+
+		dst[ i * 2u      ]+= ( signed_sample * volume[0] ) >> c_volume_shift;
+		dst[ i * 2u + 1u ]+= ( signed_sample * volume[1] ) >> c_volume_shift;
+	}
+}
+
+template<class SrcSample, int c_zero_level>
+static void MixChannel8(
+	const SrcSample* const src,
+	const unsigned int src_samples_left,
+	const unsigned int dst_samples,
+	const unsigned int freq_ratio_f,
+	const int* const volume,
+	int* const dst )
+{
+	MixChannel<SrcSample, c_zero_level, 0, g_mix_shift>( src, src_samples_left, dst_samples, freq_ratio_f, volume, dst );
+}
+
+template<class SrcSample, int c_zero_level>
+static void MixChannel16(
+	const SrcSample* const src,
+	const unsigned int src_samples_left,
+	const unsigned int dst_samples,
+	const unsigned int freq_ratio_f,
+	const int* const volume,
+	int* const dst )
+{
+	// Interpolated 16-bit sample, multiplied by volume, does not fit into 32 bits, so, remove fractional part before volume applying.
+	MixChannel<SrcSample, c_zero_level, int(g_frac_bits), g_volume_bits>( src, src_samples_left, dst_samples, freq_ratio_f, volume, dst );
+}
+
+// Apply volume to signed 16-bit samples with device frequency and add result to stereo mix buffer.
+static void MixChannelWithoutResampling(
+	const short* const src,
+	const unsigned int dst_samples,
+	const int* const volume,
+	int* const dst )
+{
+	unsigned int i= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	// Process 4 destination samples per iteration. Products of 16-bit sample and volume are calculated via "madd" with zero high halves.
+	const __m128i zero= _mm_setzero_si128();
+	const __m128i volume_vec= _mm_setr_epi32( volume[0], volume[1], volume[0], volume[1] );
+	for( ; i + 4u <= dst_samples; i+= 4u )
+	{
+		const __m128i samples= _mm_unpacklo_epi16( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( src + i ) ), zero );
+		const __m128i lo= _mm_srai_epi32( _mm_madd_epi16( _mm_unpacklo_epi32( samples, samples ), volume_vec ), g_volume_bits );
+		const __m128i hi= _mm_srai_epi32( _mm_madd_epi16( _mm_unpackhi_epi32( samples, samples ), volume_vec ), g_volume_bits );
+
+		__m128i* const dst_vec= reinterpret_cast<__m128i*>( dst + i * 2u );
+		_mm_storeu_si128( dst_vec     , _mm_add_epi32( _mm_loadu_si128( dst_vec      ), lo ) );
+		_mm_storeu_si128( dst_vec + 1u, _mm_add_epi32( _mm_loadu_si128( dst_vec + 1u ), hi ) );
+	}
+#endif
+
+	for( ; i < dst_samples; i++ )
+	{
+		dst[ i * 2u      ]+= ( int( src[i] ) * volume[0] ) >> g_volume_bits;
+		dst[ i * 2u + 1u ]+= ( int( src[i] ) * volume[1] ) >> g_volume_bits;
+	}
+}
+
+// Convert mixed samples into output format with saturation.
+static void PackMixBuffer( const int* const mix_buffer, const unsigned int count, SampleType* const out_buffer )
+{
+	unsigned int i= 0u;
+
+#ifdef PC_SSE2_INSTRUCTIONS
+	const __m128i min_value= _mm_set1_epi16( -32767 );
+	for( ; i + 8u <= count; i+= 8u )
+	{
+		const __m128i packed=
+			_mm_packs_epi32(
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( mix_buffer + i      ) ),
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( mix_buffer + i + 4u ) ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( out_buffer + i ), _mm_max_epi16( packed, min_value ) );
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		int s= mix_buffer[i];
+		if( s > +32767 ) s= +32767;
+		if( s < -32767 ) s= -32767;
+		out_buffer[i]= s;
+	}
+}
+
+Mixer::Mixer( const unsigned int frequency, const unsigned int max_sample_count )
+	: frequency_(frequency)
+	, mix_buffer_( max_sample_count * g_left_and_right )
+{
+	PC_ASSERT( frequency_ > 0u );
+}
+
+unsigned int Mixer::Mix( Channels& channels, SampleType* const buffer, const unsigned int sample_count )
+{
+	PC_ASSERT( sample_count * g_left_and_right <= mix_buffer_.size() );
+
+	unsigned int finished_channels_mask= 0u;
+
+	// Zero mix buffer.
+	std::fill( mix_buffer_.begin(), mix_buffer_.begin() + sample_count * g_left_and_right, 0 );
+
+	for( unsigned int channel_index= 0u; channel_index < Channel::c_max_channels; channel_index++ )
+	{
+		Channel& channel= channels[ channel_index ];
+		if( !channel.is_active || channel.src_sound_data == nullptr )
+			continue;
+
+		// Fill destination audio buffer with iterpolation,
+		// because original game sounds have frequency about 11025 Hz, but destination buffer have frequency 22050 - 44100 Hz.
+		const unsigned int freq_ratio_f= ( channel.src_sound_data->frequency_ << g_frac_bits ) / frequency_;
+		const int volume[2]=
+		{
+			static_cast<int>( channel.volume[0] * float( g_volume_scale ) ),
+			static_cast<int>( channel.volume[1] * float( g_volume_scale ) ),
+		};
+		// Pre-resampled sounds are just added to mix buffer.
+		const bool without_resampling=
+			channel.src_sound_data->data_type_ == ISoundData::DataType::Signed16 &&
+			channel.src_sound_data->frequency_ == frequency_;
+
+		unsigned int channel_dst_samples_processed= 0u;
+		do
+		{
+			const auto max_dst_sample_for_src_sample=
+			[&]( const unsigned int i ) -> unsigned int
+			{
+				if( i == 0u ) return 0u;
+				const unsigned int result= ( ( i << g_frac_bits ) - 1u ) / freq_ratio_f;
+				PC_ASSERT( ( ( result * freq_ratio_f ) >> g_frac_bits ) < i );
+				return result + 1u;
+			};
+
+			int* const dst= mix_buffer_.data() + channel_dst_samples_processed * g_left_and_right;
+			const unsigned int src_samples_left= channel.src_sound_data->sample_count_ - channel.position_samples;
+			// Interpolation needs next sample.
+			const unsigned int can_read_src_samples=
+				without_resampling ? src_samples_left : std::max( int( src_samples_left ) - 1, 0 );
+			const unsigned int dst_samples_to_write=
+				std::min(
+					sample_count - channel_dst_samples_processed,
+					max_dst_sample_for_src_sample( can_read_src_samples ) );
+
+			switch( channel.src_sound_data->data_type_ )
+			{
+			case ISoundData::DataType::Unsigned8:
+				MixChannel8<unsigned char, 128>(
+					static_cast<const unsigned char*>( channel.src_sound_data->data_ ) + channel.position_samples,
+					src_samples_left, dst_samples_to_write, freq_ratio_f, volume, dst );
+				break;
+
+			case ISoundData::DataType::Signed8:
+				MixChannel8<signed char, 0>(
+					static_cast<const signed char*>( channel.src_sound_data->data_ ) + channel.position_samples,
+					src_samples_left, dst_samples_to_write, freq_ratio_f, volume, dst );
+				break;
+
+			case ISoundData::DataType::Signed16:
+				if( without_resampling )
+				{
+					MixChannelWithoutResampling(
+						static_cast<const short*>( channel.src_sound_data->data_ ) + channel.position_samples,
+						dst_samples_to_write, volume, dst );
+				}
+				else
+				{
+					MixChannel16<short, 0>(
+						static_cast<const short*>( channel.src_sound_data->data_ ) + channel.position_samples,
+						src_samples_left, dst_samples_to_write, freq_ratio_f, volume, dst );
+				}
+				break;
+
+			case ISoundData::DataType::Unsigned16:
+				MixChannel16<unsigned short, 32768>(
+					static_cast<const unsigned short*>( channel.src_sound_data->data_ ) + channel.position_samples,
+					src_samples_left, dst_samples_to_write, freq_ratio_f, volume, dst );
+				break;
+			};
+
+			channel.position_samples+= ( ( sample_count - channel_dst_samples_processed ) * freq_ratio_f ) >> g_frac_bits;
+			channel.position_samples= std::min( channel.position_samples, channel.src_sound_data->sample_count_ );
+			channel_dst_samples_processed+= dst_samples_to_write;
+
+			if( channel.looped &&
+				( channel.position_samples >= channel.src_sound_data->sample_count_ || dst_samples_to_write == 0u ) )
+				channel.position_samples= 0u;
+
+			} while( channel.looped && channel_dst_samples_processed < sample_count );
+
+		// Sound is over - report it to game thread.
+		if( !channel.looped && channel.position_samples >= channel.src_sound_data->sample_count_ )
+		{
+			channel.is_active= false;
+			finished_channels_mask|= 1u << channel_index;
+		}
+	} // for channels
+
+	// Copy mix buffer to result buffer.
+	PackMixBuffer( mix_buffer_.data(), sample_count * g_left_and_right, buffer );
+
+	return finished_channels_mask;
+}
+
+} // namespace Sound
+
+} // namespace PanzerChasm
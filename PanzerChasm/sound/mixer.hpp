@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+
+#include "channel.hpp"
+
+namespace PanzerChasm
+{
+
+namespace Sound
+{
+
+// Mixes channels into stereo output buffer. Does not depend on audio device.
+class Mixer final
+{
+public:
+	Mixer( unsigned int frequency, unsigned int max_sample_count );
+
+	unsigned int GetFrequency() const { return frequency_; }
+
+	// "sample_count" - count of stereo samples, must be not greater, than "max_sample_count".
+	// Returns mask of channels, where non-looped sounds are over.
+	unsigned int Mix( Channels& channels, SampleType* buffer, unsigned int sample_count );
+
+private:
+	const unsigned int frequency_; // samples per second
+	std::vector<int> mix_buffer_;
+};
+
+static_assert( Channel::c_max_channels <= 32u, "Too many channels for finished channels mask" );
+
+} // namespace Sound
+
+} // namespace PanzerChasm
@@ -12,7 +12,7 @@ namespace Sound
 
 ObjectsSoundsProcessor::ObjectsSoundsProcessor( const GameResourcesConstPtr& game_resources )
 	: game_resources_(game_resources)
-	, prev_tick_time_( Time::CurrentTime() )
+	, prev_tick_time_( Time::FrameTime() )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 }
@@ -33,7 +33,7 @@ void ObjectsSoundsProcessor::Update( const MapState& map_state, const m_Vec3& he
 {
 	const float c_change_time_s= 0.5f;
 
-	const Time current_tick_time= Time::CurrentTime();
+	const Time current_tick_time= Time::FrameTime();
 	const float tick_delta_s= ( current_tick_time - prev_tick_time_ ).ToSeconds();
 	prev_tick_time_= current_tick_time;
 
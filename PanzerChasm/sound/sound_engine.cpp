@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <matrix.hpp>
 
 #include "../assert.hpp"
 #include "../client/map_state.hpp"
 #include "../log.hpp"
 #include "../math_utils.hpp"
+#include "../profiler.hpp"
 #include "../settings.hpp"
 #include "../shared_settings_keys.hpp"
 
@@ -23,16 +28,25 @@ static const float g_ears_angle= 160.0f * Constants::to_rad;
 static const float g_ears_half_angle= 0.5f * g_ears_angle;
 static const float g_volume_oversaturation_level= 1.4f;
 static const float g_ambient_sounds_volume_scale= 0.6f;
+static const float g_playing_source_audibility_scale= 1.25f;
+static const float g_min_audible_volume= 1.0f / 256.0f; // Mixer volume precision.
+static const float g_hearing_distance_margin= 4.0f;
+static const unsigned int g_far_sources_update_period= 16u;
 
 SoundEngine::SoundEngine(
 	Settings& settings,
 	const GameResourcesConstPtr& game_resources )
 	: game_resources_( game_resources )
 	, settings_( settings )
+	, resample_sounds_on_load_( settings.GetOrSetBool( SettingsKeys::sound_resample_on_load, false ) )
 	, objects_sounds_processor_( game_resources )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 
+	for( std::atomic<bool>& ready : map_sounds_ready_ )
+		ready.store( false );
+	map_sounds_loading_cancel_.store( false );
+
 	Log::Info( "Start loading sounds" );
 
 	unsigned int total_sounds_loaded= 0u;
@@ -44,7 +58,7 @@ SoundEngine::SoundEngine(
 		if( sound.file_name[0] == '\0' )
 			continue;
 
-		sounds_[s]= LoadSound( sound.file_name, *game_resources_->vfs );
+		sounds_[s]= PrepareSound( LoadSound( sound.file_name, *game_resources_->vfs ) );
 
 		if( sounds_[s] != nullptr )
 		{
@@ -61,7 +75,7 @@ SoundEngine::SoundEngine(
 		for( unsigned int j= 0; j < model.sounds.size() && j < c_max_monster_sounds; j++ )
 		{
 			ISoundDataConstPtr& sound= sounds_[ first_monster_sound + j ];
-			sound= LoadRawMonsterSound( model.sounds[j] );
+			sound= PrepareSound( LoadRawMonsterSound( model.sounds[j] ) );
 
 			if( sound != nullptr )
 			{
@@ -77,68 +91,224 @@ SoundEngine::SoundEngine(
 
 SoundEngine::~SoundEngine()
 {
+	StopMapSoundsLoading();
 	ForceStopAllChannels();
 }
 
 void SoundEngine::Tick()
 {
+	PC_PROFILE_SCOPE( "SoundEngine::Tick" );
+
 	UpdateAmbientSoundState();
 	UpdateObjectSoundState();
 	UpdateOneTimeSoundSource();
 	CalculateSourcesVolume();
 
-	driver_.LockChannels();
+	const std::chrono::steady_clock::time_point current_time= std::chrono::steady_clock::now();
 
-	Channels& channels= driver_.GetChannels();
+	for( Source& source : sources_ )
+	{
+		if( source.is_free )
+			continue;
+
+		if( source.start_pending )
+		{
+			// Map sound is not loaded yet - play it a bit later.
+			if( SoundIsLoading( source.sound_id ) )
+				continue;
+
+			source.start_pending= false;
+			source.start_time= current_time;
+			source.play_id= next_play_id_;
+			next_play_id_++;
+		}
+		else if( !source.looped && source.channel == c_no_channel )
+		{
+			// Virtual source is over. For sources, playing in driver channels, driver reports end of sound.
+			const ISoundData* const sound= GetSourceSound( source );
+			if( sound == nullptr || GetSourcePositionSamples( source, *sound, current_time ) >= sound->sample_count_ )
+				source.is_free= true;
+		}
+	}
 
-	for( unsigned int i= 0u; i < Channel::c_max_channels; i++ )
+	// Select most audible sources for mixing.
+	// Other sources are virtual - they are not mixed, but their playing position is still advancing.
+	const auto get_audibility=
+	[&]( const unsigned int source_index ) -> float
 	{
-		Channel& channel= channels[i];
-		Source& source= sources_[i];
+		const Source& source= sources_[ source_index ];
+		// Prefer already playing sources, to prevent switching of almost equally audible sources each tick.
+		return
+			std::max( source.volume[0], source.volume[1] ) *
+			( source.channel == c_no_channel ? 1.0f : g_playing_source_audibility_scale );
+	};
+
+	unsigned int audible_sources[ c_max_sources ];
+	unsigned int audible_source_count= 0u;
+	for( unsigned int i= 0u; i < c_max_sources; i++ )
+	{
+		if( !sources_[i].is_free && GetSourceSound( sources_[i] ) != nullptr && get_audibility(i) > 0.0f )
+		{
+			audible_sources[ audible_source_count ]= i;
+			audible_source_count++;
+		}
+	}
 
-		if( source.is_free )
-			channel.is_active= false;
-		else
+	if( audible_source_count > Channel::c_max_channels )
+	{
+		std::nth_element(
+			audible_sources,
+			audible_sources + Channel::c_max_channels,
+			audible_sources + audible_source_count,
+			[&]( const unsigned int a, const unsigned int b ) { return get_audibility(a) > get_audibility(b); } );
+		audible_source_count= Channel::c_max_channels;
+	}
+
+	bool source_is_mixed[ c_max_sources ]= { false };
+	for( unsigned int i= 0u; i < audible_source_count; i++ )
+		source_is_mixed[ audible_sources[i] ]= true;
+
+	// Send only changes to audio thread. If commands queue is full, state is not changed and command is retried next tick.
+
+	// Release channels of freed, restarted and not enough audible sources.
+	for( unsigned int c= 0u; c < Channel::c_max_channels; c++ )
+	{
+		ChannelState& channel= channels_states_[c];
+		if( channel.source == c_no_source )
+			continue;
+
+		Source& source= sources_[ channel.source ];
+		if( !source.is_free &&
+			source_is_mixed[ channel.source ] &&
+			channel.play_id == source.play_id &&
+			channel.sound == GetSourceSound( source ) )
+			continue;
+
+		ChannelCommand command;
+		command.type= ChannelCommand::Type::Stop;
+		command.channel= c;
+		if( driver_.PushCommand( command ) )
 		{
-			channel.volume[0]= source.volume[0];
-			channel.volume[1]= source.volume[1];
+			source.channel= c_no_channel;
+			channel.source= c_no_source;
+		}
+	}
+
+	unsigned int next_free_channel= 0u;
+	for( unsigned int i= 0u; i < audible_source_count; i++ )
+	{
+		const unsigned int source_index= audible_sources[i];
+		Source& source= sources_[ source_index ];
+		ISoundData* const sound= GetSourceSound( source );
 
-			if( !channel.is_active )
-				channel.position_samples= 0u;
+		ChannelCommand command;
+		command.looped= source.looped;
+		command.volume[0]= source.volume[0];
+		command.volume[1]= source.volume[1];
 
-			channel.is_active= true;
-			channel.looped= source.looped;
+		if( source.channel == c_no_channel )
+		{
+			while( next_free_channel < Channel::c_max_channels && channels_states_[ next_free_channel ].source != c_no_source )
+				next_free_channel++;
+			if( next_free_channel == Channel::c_max_channels )
+				break; // Channels are not released yet.
+
+			ChannelState& channel= channels_states_[ next_free_channel ];
+
+			// Continue playing of virtual source from its current position.
+			command.type= ChannelCommand::Type::Play;
+			command.channel= next_free_channel;
+			command.play_id= source.play_id;
+			command.sound= sound;
+			command.position_samples= GetSourcePositionSamples( source, *sound, current_time );
+			if( source.looped && sound->sample_count_ > 0u )
+				command.position_samples%= sound->sample_count_;
+
+			if( driver_.PushCommand( command ) )
+			{
+				source.channel= next_free_channel;
+				channel.source= source_index;
+				channel.sound= sound;
+				channel.play_id= source.play_id;
+				channel.looped= command.looped;
+				channel.volume[0]= command.volume[0];
+				channel.volume[1]= command.volume[1];
+			}
+			continue;
+		}
 
-			if( &source == one_time_sound_source_ )
-				channel.src_sound_data= one_time_sound_source_data_.get();
-			else
-				channel.src_sound_data= sounds_[ source.sound_id ].get();
+		ChannelState& channel= channels_states_[ source.channel ];
+		if( channel.play_id != source.play_id || channel.sound != sound )
+			continue; // Channel is not released yet.
 
-			// Source is over
-			if( channel.is_active &&
-				channel.src_sound_data != nullptr &&
-				( !channel.looped && channel.position_samples >= channel.src_sound_data->sample_count_ ) )
+		if( channel.looped != source.looped ||
+			channel.volume[0] != source.volume[0] ||
+			channel.volume[1] != source.volume[1] )
+		{
+			command.type= ChannelCommand::Type::Update;
+			command.channel= source.channel;
+			if( driver_.PushCommand( command ) )
 			{
-				source.is_free= true;
-				channel.is_active= false;
+				channel.looped= command.looped;
+				channel.volume[0]= command.volume[0];
+				channel.volume[1]= command.volume[1];
 			}
 		}
+
+		// Source is over. Channel will be released next tick.
+		if( !channel.looped && driver_.GetFinishedPlayId( source.channel ) == source.play_id )
+			source.is_free= true;
 	}
+}
 
-	driver_.UnlockChannels();
+ISoundData* SoundEngine::GetSound( const unsigned int sound_id ) const
+{
+	if( SoundIsLoading( sound_id ) )
+		return nullptr;
+	return sounds_[ sound_id ].get();
+}
+
+bool SoundEngine::SoundIsLoading( const unsigned int sound_id ) const
+{
+	return
+		sound_id >= c_first_map_sound && sound_id < c_first_monster_sound &&
+		!map_sounds_ready_[ sound_id - c_first_map_sound ].load( std::memory_order_acquire );
+}
+
+ISoundData* SoundEngine::GetSourceSound( const Source& source ) const
+{
+	if( &source == one_time_sound_source_ )
+		return one_time_sound_source_data_.get();
+	return GetSound( source.sound_id );
+}
+
+unsigned int SoundEngine::GetSourcePositionSamples(
+	const Source& source,
+	const ISoundData& sound,
+	const std::chrono::steady_clock::time_point& current_time )
+{
+	const double elapsed_seconds= std::chrono::duration<double>( current_time - source.start_time ).count();
+	return static_cast<unsigned int>( std::min( elapsed_seconds * double( sound.frequency_ ), double( std::numeric_limits<unsigned int>::max() ) ) );
 }
 
 void SoundEngine::UpdateMapState( const MapState& map_state )
 {
 	// Update sounds, linked with mosnters
 	const MapState::MonstersContainer& monsters= map_state.GetMonsters();
-	for( Source& source : sources_ )
+	for( unsigned int i= 0u; i < c_max_sources; i++ )
 	{
+		Source& source= sources_[i];
 		if( source.is_free )
 			continue;
 
 		if( source.monster_id != 0u )
 		{
+			// Do not search monsters, which are too far to be heard.
+			// Still update such sources sometimes, because monsters are moving.
+			if( source.distance_beyond_hearing > g_hearing_distance_margin &&
+				( map_state_updates_counter_ + i ) % g_far_sources_update_period != 0u )
+				continue;
+
 			const auto it= monsters.find( source.monster_id );
 			if( it != monsters.end() )
 			{
@@ -148,6 +318,8 @@ void SoundEngine::UpdateMapState( const MapState& map_state )
 		}
 	}
 
+	map_state_updates_counter_++;
+
 	objects_sounds_processor_.Update( map_state, head_position_ );
 }
 
@@ -158,37 +330,21 @@ void SoundEngine::SetMap( const MapDataConstPtr& map_data )
 	// Reload sounds only if map changed.
 	if( map_data != current_map_data_ )
 	{
-		current_map_data_= map_data;
+		// Sounds are loaded asynchronously, so, only loading start is measured here.
+		PC_PROFILE_LOAD_STEP( "SoundEngine::SetMap" );
 
-		if( current_map_data_ != nullptr )
-		{
-			Log::Info( "Loading sounds for map" );
+		StopMapSoundsLoading();
 
-			// TODO reuse old sounds
-			for( unsigned int s= 0u; s < MapData::c_max_map_sounds; s++ )
-			{
-				ISoundDataConstPtr& sound= sounds_[ c_first_map_sound + s ];
-				sound= nullptr; // remove old
-
-				const GameResources::SoundDescription& sound_description= map_data->map_sounds[s];
-				if( sound_description.file_name[0] == '\0' )
-					continue;
-
-				sound= LoadSound( sound_description.file_name, *game_resources_->vfs );
-			}
-
-			for( unsigned int s= 0u; s < MapData::c_max_map_ambients; s++ )
-			{
-				ISoundDataConstPtr& sound= sounds_[ c_first_map_ambient_sound + s ];
-				sound= nullptr; // remove old
-
-				const GameResources::SoundDescription& sound_description= map_data->ambients[s];
-				if( sound_description.file_name[0] == '\0' )
-					continue;
-
-				sound= LoadSound( sound_description.file_name, *game_resources_->vfs );
-			}
+		// TODO reuse old sounds
+		for( unsigned int s= 0u; s < c_map_sounds_count; s++ )
+		{
+			sounds_[ c_first_map_sound + s ]= nullptr; // remove old
+			map_sounds_ready_[s].store( false, std::memory_order_relaxed );
 		}
+
+		current_map_data_= map_data;
+		if( current_map_data_ != nullptr )
+			StartMapSoundsLoading();
 	}
 
 	ambient_sound_processor_.SetMap( map_data );
@@ -234,13 +390,13 @@ void SoundEngine::PlayWorldSound(
 	if( source == nullptr )
 		return;
 
-	if( sounds_[ sound_number ] == nullptr )
+	if( GetSound( sound_number ) == nullptr && !SoundIsLoading( sound_number ) )
 		return;
 
 	source->is_free= false;
 	source->looped= false;
 	source->sound_id= sound_number;
-	source->pos_samples= 0u;
+	source->start_pending= true;
 	source->is_head_relative= false;
 	source->pos= position;
 	source->monster_id= 0u;
@@ -262,7 +418,7 @@ void SoundEngine::PlayMonsterLinkedSound(
 	source->is_free= false;
 	source->looped= false;
 	source->sound_id= sound_number;
-	source->pos_samples= 0u;
+	source->start_pending= true;
 	source->is_head_relative= false;
 	source->pos= monster.pos; // TODO - correct z coordinate
 	source->monster_id= monster_value.first;
@@ -289,7 +445,7 @@ void SoundEngine::PlayMonsterSound(
 	source->is_free= false;
 	source->looped= false;
 	source->sound_id= sound_number;
-	source->pos_samples= 0u;
+	source->start_pending= true;
 	source->is_head_relative= false;
 	source->pos= monster.pos; // TODO - correct z coordinate
 	source->monster_id= monster_value.first;
@@ -304,45 +460,44 @@ void SoundEngine::PlayHeadSound( const unsigned int sound_number )
 	if( source == nullptr )
 		return;
 
-	if( sounds_[ sound_number ] == nullptr )
+	if( GetSound( sound_number ) == nullptr && !SoundIsLoading( sound_number ) )
 		return;
 
 	source->is_free= false;
 	source->looped= false;
 	source->sound_id= sound_number;
-	source->pos_samples= 0u;
+	source->start_pending= true;
 	source->is_head_relative= true;
 	source->monster_id= 0u;
 }
 
 void SoundEngine::PlayOneTimeSound( const char* const sound_data_file )
 {
-	ISoundDataConstPtr sound_data= LoadSound( sound_data_file,* game_resources_->vfs );
+	PlayOneTimeSound( LoadOneTimeSound( sound_data_file ) );
+}
+
+void SoundEngine::PlayOneTimeSound( ISoundDataConstPtr sound_data )
+{
 	if( sound_data == nullptr )
 		return;
 
 	if( one_time_sound_source_ != nullptr ) // Free and kill old sound.
+	{
+		// Stop channel, which can play now old OneTimeSoundSource, before old sound data destruction.
+		if( one_time_sound_source_->channel != c_no_channel )
+		{
+			driver_.StopChannelSync( one_time_sound_source_->channel );
+			channels_states_[ one_time_sound_source_->channel ].source= c_no_source;
+			one_time_sound_source_->channel= c_no_channel;
+		}
+
 		one_time_sound_source_->is_free= true;
+	}
 
 	one_time_sound_source_= GetFreeSource();
 	if( one_time_sound_source_ == nullptr )
 		return;
 
-	{ // Stop channel, which can play now old OneTimeSoundSource.
-		driver_.LockChannels();
-		Channels& channels= driver_.GetChannels();
-		for( unsigned int i= 0u; i < Channel::c_max_channels; i++ )
-		{
-			if( &sources_[i] == one_time_sound_source_ )
-			{
-				channels[i].is_active= false;
-				channels[i].src_sound_data= nullptr;
-				break;
-			}
-		}
-		driver_.UnlockChannels();
-	}
-
 	one_time_sound_source_data_= std::move(sound_data);
 
 	one_time_sound_source_->is_free= false;
@@ -350,7 +505,24 @@ void SoundEngine::PlayOneTimeSound( const char* const sound_data_file )
 	one_time_sound_source_->looped= false;
 	one_time_sound_source_->monster_id= 0u;
 	one_time_sound_source_->sound_id= 0u;
-	one_time_sound_source_->pos_samples= 0u;
+	one_time_sound_source_->start_pending= true;
+}
+
+ISoundDataConstPtr SoundEngine::LoadOneTimeSound( const char* const sound_data_file ) const
+{
+	return PrepareSound( LoadSound( sound_data_file, *game_resources_->vfs ) );
+}
+
+ISoundDataConstPtr SoundEngine::PrepareSound( ISoundDataConstPtr sound ) const
+{
+	if( !resample_sounds_on_load_ || sound == nullptr )
+		return sound;
+
+	ISoundDataConstPtr resampled_sound= ResampleSound( *sound, driver_.GetFrequency() );
+	if( resampled_sound == nullptr )
+		return sound;
+
+	return resampled_sound;
 }
 
 SoundEngine::Source* SoundEngine::GetFreeSource()
@@ -386,7 +558,7 @@ void SoundEngine::UpdateAmbientSoundState()
 
 				ambient_sound_source_->looped= true;
 				ambient_sound_source_->is_head_relative= true;
-				ambient_sound_source_->pos_samples= 0u;
+				ambient_sound_source_->start_pending= true;
 				ambient_sound_source_->sound_id= sound_number;
 				ambient_sound_source_->monster_id= 0u;
 			}
@@ -396,7 +568,7 @@ void SoundEngine::UpdateAmbientSoundState()
 			if( ambient_sound_source_->sound_id != sound_number )
 			{
 				ambient_sound_source_->sound_id= sound_number;
-				ambient_sound_source_->pos_samples= 0u;
+				ambient_sound_source_->start_pending= true;
 			}
 		}
 	}
@@ -424,7 +596,7 @@ void SoundEngine::UpdateObjectSoundState()
 
 				object_sound_source_->looped= true;
 				object_sound_source_->is_head_relative= false;
-				object_sound_source_->pos_samples= 0u;
+				object_sound_source_->start_pending= true;
 				object_sound_source_->pos= objects_sounds_processor_.GetCurrentSoundPosition();
 				object_sound_source_->sound_id= sound_number;
 				object_sound_source_->monster_id= 0u;
@@ -435,7 +607,7 @@ void SoundEngine::UpdateObjectSoundState()
 			if( object_sound_source_->sound_id != sound_number )
 			{
 				object_sound_source_->sound_id= sound_number;
-				object_sound_source_->pos_samples= 0u;
+				object_sound_source_->start_pending= true;
 			}
 			object_sound_source_->pos= objects_sounds_processor_.GetCurrentSoundPosition();
 		}
@@ -458,8 +630,22 @@ void SoundEngine::UpdateOneTimeSoundSource()
 
 void SoundEngine::CalculateSourcesVolume()
 {
-	for( Source& source : sources_ )
+	// Read master volume.
+	float master_volume= settings_.GetFloat( SettingsKeys::fx_volume, 0.5f );
+	master_volume= std::max( 0.0f, std::min( master_volume, 1.0f ) );
+	settings_.SetSetting( SettingsKeys::fx_volume, master_volume );
+
+	// Gather positional sources into arrays, for batched volume computation.
+	unsigned int batch_sources[ c_max_sources ];
+	float batch_vec_x[ c_max_sources ], batch_vec_y[ c_max_sources ], batch_vec_z[ c_max_sources ];
+	float batch_base_volume[ c_max_sources ];
+	float batch_volume[2][ c_max_sources ];
+	float batch_distance[ c_max_sources ];
+	unsigned int batch_size= 0u;
+
+	for( unsigned int i= 0u; i < c_max_sources; i++ )
 	{
+		Source& source= sources_[i];
 		if( source.is_free )
 			continue;
 
@@ -478,29 +664,57 @@ void SoundEngine::CalculateSourcesVolume()
 			float( base_sound_volume_value ) / float( GameResources::SoundDescription::c_max_volume );
 
 		if( source.is_head_relative )
-			source.volume[0]= source.volume[1]= base_sound_volume;
-		else
 		{
-			const m_Vec3 vec_to_source= source.pos - head_position_;
-			const float disntance_to_source= vec_to_source.Length();
+			source.volume[0]= source.volume[1]= base_sound_volume;
+			source.distance_beyond_hearing= 0.0f;
+			continue;
+		}
 
-			// Linear attenuation.
-			const float sound_volume= std::min( base_sound_volume * g_volume_distance_scale / disntance_to_source, g_volume_oversaturation_level );
+		const m_Vec3 vec_to_source= source.pos - head_position_;
+		batch_sources[ batch_size ]= i;
+		batch_vec_x[ batch_size ]= vec_to_source.x;
+		batch_vec_y[ batch_size ]= vec_to_source.y;
+		batch_vec_z[ batch_size ]= vec_to_source.z;
+		batch_base_volume[ batch_size ]= base_sound_volume;
+		batch_size++;
+	}
 
-			for( unsigned int j= 0u; j < 2u; j++ )
-			{
-				const float angle_cos= ( vec_to_source * ears_vectors_[j] ) / disntance_to_source;
-				const float ear_volume=
-					0.5f * (
-						angle_cos * ( g_max_ear_volume - g_min_ear_volume )
-						+ g_min_ear_volume + g_max_ear_volume );
-
-				const float channel_volume= sound_volume * ear_volume;
-				source.volume[j]= std::min( std::max( channel_volume, 0.0f ), 1.0f );
-			}
+	// Calculate volume for all positional sources. Loop has no branches, so, compiler can vectorize it.
+	for( unsigned int k= 0u; k < batch_size; k++ )
+	{
+		const float disntance_to_source=
+			std::sqrt( batch_vec_x[k] * batch_vec_x[k] + batch_vec_y[k] * batch_vec_y[k] + batch_vec_z[k] * batch_vec_z[k] );
+		const float inv_distance= 1.0f / disntance_to_source;
+		batch_distance[k]= disntance_to_source;
+
+		// Linear attenuation.
+		const float sound_volume= std::min( batch_base_volume[k] * g_volume_distance_scale * inv_distance, g_volume_oversaturation_level );
+
+		for( unsigned int j= 0u; j < 2u; j++ )
+		{
+			const float angle_cos=
+				( batch_vec_x[k] * ears_vectors_[j].x + batch_vec_y[k] * ears_vectors_[j].y + batch_vec_z[k] * ears_vectors_[j].z ) * inv_distance;
+			const float ear_volume=
+				0.5f * (
+					angle_cos * ( g_max_ear_volume - g_min_ear_volume )
+					+ g_min_ear_volume + g_max_ear_volume );
+
+			const float channel_volume= sound_volume * ear_volume;
+			batch_volume[j][k]= std::min( std::max( channel_volume, 0.0f ), 1.0f );
 		}
 	}
 
+	for( unsigned int k= 0u; k < batch_size; k++ )
+	{
+		Source& source= sources_[ batch_sources[k] ];
+		source.volume[0]= batch_volume[0][k];
+		source.volume[1]= batch_volume[1][k];
+
+		// Sound volume with maximum ear volume is less, than minimal audible volume, outside this radius.
+		const float hearing_radius= batch_base_volume[k] * g_volume_distance_scale * g_max_ear_volume * master_volume / g_min_audible_volume;
+		source.distance_beyond_hearing= batch_distance[k] - hearing_radius;
+	}
+
 	if( ambient_sound_source_ != nullptr )
 	{
 		const float volume_scale= g_ambient_sounds_volume_scale * ambient_sound_processor_.GetCurrentSoundVolume();
@@ -518,18 +732,15 @@ void SoundEngine::CalculateSourcesVolume()
 	if( one_time_sound_source_ != nullptr )
 		one_time_sound_source_->volume[0]= one_time_sound_source_->volume[1]= 1.0f;
 
-	// Read master volume.
-	float master_volume= settings_.GetFloat( SettingsKeys::fx_volume, 0.5f );
-	master_volume= std::max( 0.0f, std::min( master_volume, 1.0f ) );
-	settings_.SetSetting( SettingsKeys::fx_volume, master_volume );
-
-	// Apply master volume.
+	// Apply master volume. Drop volume of sources, which are too quiet for mixer.
 	for( Source& source : sources_ )
 	{
 		if( source.is_free )
 			continue;
 		source.volume[0]*= master_volume;
 		source.volume[1]*= master_volume;
+		if( std::max( source.volume[0], source.volume[1] ) < g_min_audible_volume )
+			source.volume[0]= source.volume[1]= 0.0f;
 	}
 }
 
@@ -543,17 +754,70 @@ void SoundEngine::ForceStopAllChannels()
 
 	// Force stop all channels.
 	// This need, because driver life is longer, than life of sound data (global or map).
+	driver_.StopAllChannelsSync();
+	for( ChannelState& channel : channels_states_ )
+		channel.source= c_no_source;
 
-	driver_.LockChannels();
+	for( Source& source : sources_ )
+	{
+		source.is_free= true;
+		source.channel= c_no_channel;
+	}
+}
 
-	Channels& channels= driver_.GetChannels();
-	for( Channel& channel : channels )
-		channel.is_active= false;
+void SoundEngine::StartMapSoundsLoading()
+{
+	PC_ASSERT( current_map_data_ != nullptr );
+	PC_ASSERT( !map_sounds_loading_future_.valid() );
 
-	driver_.UnlockChannels();
+	Log::Info( "Start loading sounds for map" );
 
-	for( Source& source : sources_ )
-		source.is_free= true;
+	map_sounds_loading_future_=
+		std::async(
+			std::launch::async,
+			[this]( const MapDataConstPtr map_data )
+			{
+				unsigned int total_sounds_loaded= 0u;
+				unsigned int sound_data_size= 0u;
+
+				for( unsigned int s= 0u; s < c_map_sounds_count; s++ )
+				{
+					if( map_sounds_loading_cancel_.load( std::memory_order_relaxed ) )
+						return;
+
+					const GameResources::SoundDescription& sound_description=
+						s < MapData::c_max_map_sounds
+							? map_data->map_sounds[s]
+							: map_data->ambients[ s - MapData::c_max_map_sounds ];
+
+					if( sound_description.file_name[0] != '\0' )
+					{
+						ISoundDataConstPtr& sound= sounds_[ c_first_map_sound + s ];
+						sound= PrepareSound( LoadSound( sound_description.file_name, *game_resources_->vfs ) );
+						if( sound != nullptr )
+						{
+							total_sounds_loaded++;
+							sound_data_size+= sound->GetDataSize();
+						}
+					}
+
+					// Publish sound for game thread.
+					map_sounds_ready_[s].store( true, std::memory_order_release );
+				}
+
+				Log::Info( "End loading sounds for map. Total ", total_sounds_loaded, " sounds. Sound data size: ", sound_data_size / 1024u, "kb" );
+			},
+			current_map_data_ );
+}
+
+void SoundEngine::StopMapSoundsLoading()
+{
+	if( !map_sounds_loading_future_.valid() )
+		return;
+
+	map_sounds_loading_cancel_.store( true, std::memory_order_relaxed );
+	map_sounds_loading_future_.get();
+	map_sounds_loading_cancel_.store( false, std::memory_order_relaxed );
 }
 
 } // namespace Sound
@@ -1,4 +1,8 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <future>
+
 #include <vec.hpp>
 
 #include "../fwd.hpp"
@@ -49,24 +53,52 @@ public:
 
 	// TODO - make non-head-relaive, create position source.
 	void PlayOneTimeSound( const char* sound_data_file );
+	void PlayOneTimeSound( ISoundDataConstPtr sound_data );
+
+	// Load and convert sound for PlayOneTimeSound. May be called from any thread.
+	ISoundDataConstPtr LoadOneTimeSound( const char* sound_data_file ) const;
 
 private:
+	static constexpr unsigned int c_max_sources= 128u;
+	static constexpr unsigned int c_no_source= ~0u;
+	static constexpr unsigned int c_no_channel= ~0u;
+
 	struct Source
 	{
 		bool is_free= true;
 
 		bool looped;
 		unsigned int sound_id;
-		unsigned int pos_samples;
+		bool start_pending; // Set for playing sound from beginning.
 		bool is_head_relative;
 		m_Vec3 pos;
 		EntityId monster_id;
 
 		float volume[2]; // calculated each tick
+
+		// Source may be not mixed, if it is not audible enough. Playing position of such source is calculated from start time.
+		std::chrono::steady_clock::time_point start_time;
+		unsigned int play_id= 0u;
+		unsigned int channel= c_no_channel;
+
+		// Distance from hearing radius to source. Negative, if source is inside radius. Calculated each tick.
+		float distance_beyond_hearing= 0.0f;
 	};
 
 private:
 
+	// Convert sound into device format, if this enabled.
+	ISoundDataConstPtr PrepareSound( ISoundDataConstPtr sound ) const;
+
+	ISoundData* GetSound( unsigned int sound_id ) const;
+	// Returns true, if map sound is not loaded yet. Sources with such sounds start playing after loading.
+	bool SoundIsLoading( unsigned int sound_id ) const;
+	ISoundData* GetSourceSound( const Source& source ) const;
+	static unsigned int GetSourcePositionSamples(
+		const Source& source,
+		const ISoundData& sound,
+		const std::chrono::steady_clock::time_point& current_time );
+
 	Source* GetFreeSource();
 	void UpdateAmbientSoundState();
 	void UpdateObjectSoundState();
@@ -74,6 +106,9 @@ private:
 	void CalculateSourcesVolume();
 	void ForceStopAllChannels();
 
+	void StartMapSoundsLoading();
+	void StopMapSoundsLoading();
+
 private:
 	// TODO - check this numbers
 	static constexpr unsigned int c_max_monsters= 24u;
@@ -83,10 +118,13 @@ private:
 	static constexpr unsigned int c_first_map_sound= GameResources::c_max_global_sounds;
 	static constexpr unsigned int c_first_map_ambient_sound= c_first_map_sound + MapData::c_max_map_sounds;
 	static constexpr unsigned int c_first_monster_sound= c_first_map_ambient_sound + MapData::c_max_map_ambients;
+	static constexpr unsigned int c_map_sounds_count= c_first_monster_sound - c_first_map_sound;
 
 private:
 	const GameResourcesConstPtr game_resources_;
 	Settings& settings_;
+	// Convert all sounds into device frequency and signed 16-bit samples. Costs memory, but reduces mixing cost.
+	const bool resample_sounds_on_load_;
 	Driver driver_;
 
 	MapDataConstPtr current_map_data_;
@@ -98,7 +136,27 @@ private:
 			c_max_total_monsters_sounds >
 		sounds_;
 
-	Source sources_[ Channel::c_max_channels ];
+	// Map sounds are loaded in background. Loading thread writes sound into "sounds_" and than sets ready flag.
+	// Game thread reads map sound only after ready flag is set.
+	std::array< std::atomic<bool>, c_map_sounds_count > map_sounds_ready_;
+	std::atomic<bool> map_sounds_loading_cancel_;
+	std::future<void> map_sounds_loading_future_;
+
+	// Most audible sources are mixed in driver channels, other sources are virtual.
+	Source sources_[ c_max_sources ];
+
+	// Game thread copy of driver channels state.
+	struct ChannelState
+	{
+		unsigned int source= c_no_source;
+		const ISoundData* sound= nullptr;
+		unsigned int play_id= 0u;
+		bool looped= false;
+		float volume[2]= { 0.0f, 0.0f };
+	};
+	ChannelState channels_states_[ Channel::c_max_channels ];
+	unsigned int map_state_updates_counter_= 0u;
+	unsigned int next_play_id_= 1u;
 
 	m_Vec3 head_position_;
 	m_Vec3 ears_vectors_[2];
@@ -1,4 +1,6 @@
+#include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include <SDL_audio.h>
 
@@ -27,23 +29,24 @@ const char* ExtractExtension( const char* const file_path )
 	return file_path + pos + 1u;
 }
 
+// Sound data is not copied - samples are read directly from file mapping.
+// Pages of mapping are loaded by system on demand, so, long sounds do not occupy memory entirely.
 class RawPCMSoundData final : public ISoundData
 {
 public:
-	RawPCMSoundData( Vfs::FileContent data )
+	RawPCMSoundData( Vfs::MappedFile file )
+		: file_( std::move( file ) )
 	{
-		pcm_data_= std::move( data );
-
 		frequency_= 11025u;
 		data_type_= DataType::Unsigned8;
-		data_= pcm_data_.data();
-		sample_count_= pcm_data_.size();
+		data_= file_.data();
+		sample_count_= file_.size();
 	}
 
 	virtual ~RawPCMSoundData() override {}
 
 private:
-	Vfs::FileContent pcm_data_;
+	const Vfs::MappedFile file_;
 };
 
 class RawMonsterSoundData final : public ISoundData
@@ -69,7 +72,7 @@ private:
 class WavSoundData final : public ISoundData
 {
 public:
-	WavSoundData( const Vfs::FileContent& data )
+	WavSoundData( const Vfs::FileView& data )
 	{
 		bool ok= false;
 
@@ -133,11 +136,131 @@ private:
 	Uint8* wav_buffer_= nullptr;
 };
 
+class ResampledSoundData final : public ISoundData
+{
+public:
+	ResampledSoundData( std::vector<short> samples, const unsigned int frequency )
+	{
+		samples_= std::move( samples );
+
+		frequency_= frequency;
+		data_type_= DataType::Signed16;
+		data_= samples_.data();
+		sample_count_= samples_.size();
+	}
+
+	virtual ~ResampledSoundData() override {}
+
+private:
+	std::vector<short> samples_;
+};
+
+// Returns sample, scaled to signed 16-bit range.
+int GetSample16( const ISoundData& sound, const unsigned int i )
+{
+	switch( sound.data_type_ )
+	{
+	case ISoundData::DataType::Signed8:
+		return int( static_cast<const signed char*>( sound.data_ )[i] ) << 8;
+	case ISoundData::DataType::Unsigned8:
+		return ( int( static_cast<const unsigned char*>( sound.data_ )[i] ) - 128 ) << 8;
+	case ISoundData::DataType::Signed16:
+		return int( static_cast<const short*>( sound.data_ )[i] );
+	case ISoundData::DataType::Unsigned16:
+		return int( static_cast<const unsigned short*>( sound.data_ )[i] ) - 32768;
+	};
+
+	PC_ASSERT( false );
+	return 0;
+}
+
+// Mapped PCM wav file. Returns null, if file is not simple PCM wav - such files are decoded via SDL.
+class MappedWavSoundData final : public ISoundData
+{
+public:
+	static ISoundDataConstPtr Create( Vfs::MappedFile& file )
+	{
+		const unsigned char* const data= file.data();
+		const size_t size= file.size();
+		if( size < 12u || std::memcmp( data, "RIFF", 4u ) != 0 || std::memcmp( data + 8u, "WAVE", 4u ) != 0 )
+			return nullptr;
+
+		bool format_found= false;
+		unsigned short channels= 0u, bits_per_sample= 0u, format= 0u;
+		unsigned int frequency= 0u;
+
+		size_t pos= 12u;
+		while( pos + 8u <= size )
+		{
+			const unsigned char* const chunk= data + pos;
+			unsigned int chunk_size;
+			std::memcpy( &chunk_size, chunk + 4u, sizeof(unsigned int) );
+			if( chunk_size > size - pos - 8u )
+				return nullptr;
+
+			if( std::memcmp( chunk, "fmt ", 4u ) == 0 && chunk_size >= 16u )
+			{
+				std::memcpy( &format, chunk + 8u, sizeof(unsigned short) );
+				std::memcpy( &channels, chunk + 10u, sizeof(unsigned short) );
+				std::memcpy( &frequency, chunk + 12u, sizeof(unsigned int) );
+				std::memcpy( &bits_per_sample, chunk + 22u, sizeof(unsigned short) );
+				format_found= true;
+			}
+			else if( std::memcmp( chunk, "data", 4u ) == 0 )
+			{
+				const unsigned int c_wav_pcm_format= 1u;
+				if( !format_found || format != c_wav_pcm_format || channels != 1u || frequency == 0u ||
+					!( bits_per_sample == 8u || bits_per_sample == 16u ) )
+					return nullptr;
+
+				const unsigned char* const samples= chunk + 8u;
+				// 16-bit samples must be aligned.
+				if( bits_per_sample == 16u && reinterpret_cast<uintptr_t>( samples ) % sizeof(short) != 0u )
+					return nullptr;
+
+				// In wav files 8-bit samples are unsigned, 16-bit samples are signed.
+				return
+					ISoundDataConstPtr(
+						new MappedWavSoundData(
+							std::move( file ),
+							samples,
+							chunk_size / ( bits_per_sample / 8u ),
+							frequency,
+							bits_per_sample == 8u ? DataType::Unsigned8 : DataType::Signed16 ) );
+			}
+
+			pos+= 8u + chunk_size + ( chunk_size & 1u ); // Chunks are aligned to 2 bytes.
+		}
+
+		return nullptr;
+	}
+
+	virtual ~MappedWavSoundData() override {}
+
+private:
+	MappedWavSoundData(
+		Vfs::MappedFile file,
+		const unsigned char* const samples,
+		const unsigned int sample_count,
+		const unsigned int frequency,
+		const DataType data_type )
+		: file_( std::move( file ) )
+	{
+		frequency_= frequency;
+		data_type_= data_type;
+		data_= samples;
+		sample_count_= sample_count;
+	}
+
+private:
+	const Vfs::MappedFile file_;
+};
+
 } // namespace
 
 ISoundDataConstPtr LoadSound( const char* file_path, Vfs& vfs )
 {
-	Vfs::FileContent file_content= vfs.ReadFile( file_path );
+	Vfs::MappedFile file_content= vfs.MapFile( file_path );
 	if( file_content.empty() )
 	{
 		Log::Warning( "Can not load \"", file_path, "\"" );
@@ -149,9 +272,13 @@ ISoundDataConstPtr LoadSound( const char* file_path, Vfs& vfs )
 	if( std::strcmp( extension, "WAV" ) == 0 ||
 		std::strcmp( extension, "wav" ) == 0 )
 	{
+		// Play simple PCM files directly from mapping, decode other files via SDL.
+		ISoundDataConstPtr mapped_sound= MappedWavSoundData::Create( file_content );
+		if( mapped_sound != nullptr )
+			return mapped_sound;
 		return ISoundDataConstPtr( new WavSoundData( file_content ) );
 	}
-	else // *.SFX, *.PCM, *.RAW files
+	else // *.SFX, *.PCM, *.RAW files.
 		return ISoundDataConstPtr( new RawPCMSoundData( std::move( file_content ) ) );
 
 	return nullptr;
@@ -165,6 +292,40 @@ ISoundDataConstPtr LoadRawMonsterSound( const Vfs::FileContent& raw_sound_data )
 	return ISoundDataConstPtr( new RawMonsterSoundData( raw_sound_data ) );
 }
 
+ISoundDataConstPtr ResampleSound( const ISoundData& sound, const unsigned int frequency )
+{
+	PC_ASSERT( frequency > 0u );
+
+	// Same fixed point interpolation, as in driver mixer.
+	const unsigned int c_frac_bits= 10u;
+	const unsigned int c_frac= 1u << c_frac_bits;
+
+	std::vector<short> samples;
+	if( sound.sample_count_ >= 2u ) // Need two source samples for interpolation.
+	{
+		const unsigned int freq_ratio_f= ( sound.frequency_ << c_frac_bits ) / frequency;
+		if( freq_ratio_f == 0u )
+			return nullptr;
+
+		samples.resize( ( ( ( sound.sample_count_ - 1u ) << c_frac_bits ) - 1u ) / freq_ratio_f + 1u );
+		for( unsigned int i= 0u; i < samples.size(); i++ )
+		{
+			// Use 64 bits, because sounds may be long.
+			const unsigned long long sample_coord_f= static_cast<unsigned long long>(i) * freq_ratio_f;
+			const unsigned int sample_coord= static_cast<unsigned int>( sample_coord_f >> c_frac_bits );
+			const int part= int( sample_coord_f & ( c_frac - 1u ) );
+			PC_ASSERT( sample_coord + 1u < sound.sample_count_ );
+
+			samples[i]=
+				short(
+					( GetSample16( sound, sample_coord ) * ( int(c_frac) - part ) +
+					  GetSample16( sound, sample_coord + 1u ) * part ) >> c_frac_bits );
+		}
+	}
+
+	return ISoundDataConstPtr( new ResampledSoundData( std::move( samples ), frequency ) );
+}
+
 } // namespace Sound
 
 } // namespace PanzerChasm
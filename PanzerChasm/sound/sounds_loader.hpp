@@ -45,6 +45,10 @@ typedef std::unique_ptr<ISoundData> ISoundDataConstPtr;
 ISoundDataConstPtr LoadSound( const char* file_path, Vfs& vfs );
 ISoundDataConstPtr LoadRawMonsterSound( const Vfs::FileContent& raw_sound_data );
 
+// Convert sound into signed 16-bit samples with given frequency, using linear interpolation.
+// Such sounds are mixed without resampling.
+ISoundDataConstPtr ResampleSound( const ISoundData& sound, unsigned int frequency );
+
 } // namespace Sound
 
 } // namespace PanzerChasm
@@ -121,6 +121,9 @@ struct InputState
 {
 	KeyboardState keyboard;
 	MouseState mouse;
+
+	// Mouse movement, accumulated after events polling. Sampled just before client loop.
+	int mouse_dx= 0, mouse_dy= 0;
 };
 
 const char* GetKeyName( SystemEvent::KeyEvent::KeyCode key_code );
@@ -1,12 +1,18 @@
 #include <cmath>
 #include <cstring>
 
+#ifdef PC_SSE2_INSTRUCTIONS
+#include <emmintrin.h>
+#endif
+
 #include <panzer_ogl_lib.hpp>
 
 #include "assert.hpp"
+#include "frame_pacing.hpp"
 #include "game_constants.hpp"
 #include "log.hpp"
 #include "settings.hpp"
+#include "shader_program_gl.hpp"
 #include "shared_settings_keys.hpp"
 
 #include "system_window.hpp"
@@ -116,8 +122,118 @@ static void APIENTRY GLDebugMessageCallback(
 #endif
 
 
+#ifdef PC_SSE2_INSTRUCTIONS
+
+// Replicate each of 4 pixels "scale" times. Result - "scale" vectors.
+template<unsigned int scale>
+static void ReplicatePixels( __m128i pixels, __m128i* out );
+
+template<>
+void ReplicatePixels<2u>( const __m128i pixels, __m128i* const out )
+{
+	out[0]= _mm_unpacklo_epi32( pixels, pixels );
+	out[1]= _mm_unpackhi_epi32( pixels, pixels );
+}
+
+template<>
+void ReplicatePixels<3u>( const __m128i pixels, __m128i* const out )
+{
+	out[0]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 1, 0, 0, 0 ) );
+	out[1]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 2, 2, 1, 1 ) );
+	out[2]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 3, 3, 3, 2 ) );
+}
+
+template<>
+void ReplicatePixels<4u>( const __m128i pixels, __m128i* const out )
+{
+	out[0]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+	out[1]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+	out[2]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+	out[3]= _mm_shuffle_epi32( pixels, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+}
+
+// Streaming stores bypass cache - destination is not needed by us anymore, so, do not pollute cache.
+// Streaming stores require aligned destination.
+template<bool streaming>
+static void StorePixels( uint32_t* const dst, const __m128i pixels )
+{
+	if( streaming )
+		_mm_stream_si128( reinterpret_cast<__m128i*>(dst), pixels );
+	else
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(dst), pixels );
+}
+
+// Single pixels stores are streaming too, so, cache lines of row are never partially written via cache.
+template<bool streaming>
+static void StorePixel( uint32_t* const dst, const uint32_t pixel )
+{
+	if( streaming )
+		_mm_stream_si32( reinterpret_cast<int*>(dst), static_cast<int>(pixel) );
+	else
+		*dst= pixel;
+}
+
+// "tail_count" - number of extra pixels after scaled pixels, filled with color of pixel after last source pixel.
+template<unsigned int scale, bool streaming>
+static void ScalePixelsRowSSE2( const uint32_t* const src, const unsigned int src_count, const unsigned int tail_count, uint32_t* const dst )
+{
+	const unsigned int vector_count= src_count / 4u;
+	for( unsigned int i= 0u; i < vector_count; i++ )
+	{
+		__m128i replicated[ scale ];
+		ReplicatePixels<scale>( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i * 4u ) ), replicated );
+
+		uint32_t* const dst_vector= dst + i * 4u * scale;
+		for( unsigned int j= 0u; j < scale; j++ )
+			StorePixels<streaming>( dst_vector + j * 4u, replicated[j] );
+	}
+
+	for( unsigned int x= vector_count * 4u; x < src_count; x++ )
+	for( unsigned int dx= 0u; dx < scale; dx++ )
+		StorePixel<streaming>( dst + x * scale + dx, src[x] );
+
+	for( unsigned int x= 0u; x < tail_count; x++ )
+		StorePixel<streaming>( dst + src_count * scale + x, src[src_count] );
+}
+
+template<unsigned int scale>
+static void ScalePixelsRowSSE2( const uint32_t* const src, const unsigned int src_count, const unsigned int tail_count, uint32_t* const dst )
+{
+	// Row start alignment is enough, because we write 16 * scale bytes for each 4 source pixels.
+	if( ( reinterpret_cast<uintptr_t>(dst) & 15u ) == 0u )
+		ScalePixelsRowSSE2<scale, true >( src, src_count, tail_count, dst );
+	else
+		ScalePixelsRowSSE2<scale, false>( src, src_count, tail_count, dst );
+}
+
+#endif // PC_SSE2_INSTRUCTIONS
+
+static void ScalePixelsRow( const uint32_t* const src, const unsigned int src_count, const unsigned int scale, const unsigned int tail_count, uint32_t* const dst )
+{
+	#ifdef PC_SSE2_INSTRUCTIONS
+	if( scale == 2u )
+		ScalePixelsRowSSE2<2u>( src, src_count, tail_count, dst );
+	else if( scale == 3u )
+		ScalePixelsRowSSE2<3u>( src, src_count, tail_count, dst );
+	else if( scale == 4u )
+		ScalePixelsRowSSE2<4u>( src, src_count, tail_count, dst );
+	else
+	#endif
+	{
+		for( unsigned int x= 0u; x < src_count; x++ )
+		{
+			const uint32_t color= src[x];
+			for( unsigned int dx= 0u; dx < scale; dx++ )
+				dst[ x * scale + dx ]= color;
+		}
+
+		for( unsigned int x= 0u; x < tail_count; x++ )
+			dst[ src_count * scale + x ]= src[src_count];
+	}
+}
+
 template<class ScaleGetter>
-void SystemWindow::CopyAndScaleViewportToSystemViewport( const ScaleGetter& scale_getter )
+void SystemWindow::CopyAndScaleViewportToSystemViewport( const ScaleGetter& scale_getter, const uint32_t* const src_buffer )
 {
 	PC_ASSERT( !IsOpenGLRenderer() );
 	PC_ASSERT( pixel_size_ > 1u );
@@ -125,42 +241,34 @@ void SystemWindow::CopyAndScaleViewportToSystemViewport( const ScaleGetter& scal
 	const unsigned int scale= scale_getter();
 	const unsigned int dst_width= surface_->pitch / sizeof(uint32_t);
 
+	const unsigned int pixels_left= dst_width - viewport_size_.Width() * scale;
+
+	// Scale each destination row directly from source row.
+	// Destination is written with streaming stores, so, never read it back - reading of just streamed rows is slow.
 	for( unsigned int y= 0u; y < viewport_size_.Height(); y++ )
 	{
-		const uint32_t* const src= scaled_viewport_color_buffer_.data() + y * scaled_viewport_buffer_width_;
+		const uint32_t* const src= src_buffer + y * scaled_viewport_buffer_width_;
 		uint32_t* const dst=  static_cast<uint32_t*>(surface_->pixels) + dst_width * y * scale ;
 
-		for( unsigned int x= 0u; x < viewport_size_.Width(); x++ )
-		{
-			const uint32_t color= src[x];
-			for( unsigned int dy= 0u; dy < scale; dy++ )
-			for( unsigned int dx= 0u; dx < scale; dx++ )
-				dst[ x * scale + dx + dy * dst_width ]= color;
-		}
-
-		unsigned int pixels_left= dst_width - viewport_size_.Width() * scale;
-		if( pixels_left > 0u )
-		{
-			unsigned int x= viewport_size_.Width();
-			const uint32_t color= src[x];
-
-			for( unsigned int dy= 0u; dy < scale; dy++ )
-			for( unsigned int dx= 0u; dx < pixels_left; dx++ )
-				dst[ x * scale + dx + dy * dst_width ]= color;
-		}
+		for( unsigned int dy= 0u; dy < scale; dy++ )
+			ScalePixelsRow( src, viewport_size_.Width(), scale, pixels_left, dst + dy * dst_width );
 	}
 
+	// Fill rows below viewport with last source row.
 	unsigned int rows_left= surface_->h - viewport_size_.Height() * scale;
-	if( rows_left > 0u )
+	if( rows_left > 0u && viewport_size_.Height() > 0u )
 	{
-		uint32_t* const dst= reinterpret_cast<uint32_t*>( static_cast<unsigned char*>(surface_->pixels) + dst_width * viewport_size_.Height() * scale );
+		const uint32_t* const src= src_buffer + ( viewport_size_.Height() - 1u ) * scaled_viewport_buffer_width_;
+		uint32_t* const dst= static_cast<uint32_t*>(surface_->pixels) + dst_width * viewport_size_.Height() * scale;
 
 		for( unsigned int y= 0u; y < rows_left; y++ )
-			std::memcpy(
-				dst + y * dst_width,
-				dst - dst_width,
-				sizeof(uint32_t) * dst_width );
+			ScalePixelsRow( src, viewport_size_.Width(), scale, pixels_left, dst + y * dst_width );
 	}
+
+	#ifdef PC_SSE2_INSTRUCTIONS
+	// Make streaming stores visible for other threads and for SDL.
+	_mm_sfence();
+	#endif
 }
 
 SystemWindow::SystemWindow( Settings& settings )
@@ -169,6 +277,9 @@ SystemWindow::SystemWindow( Settings& settings )
 	if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
 		Log::FatalError( "Can not initialize sdl video" );
 
+	// Use raw mouse input in relative mode, instead of cursor warping, where it is possible.
+	SDL_SetHint( SDL_HINT_MOUSE_RELATIVE_MODE_WARP, "0" );
+
 	GetVideoModes();
 
 	const bool is_opengl= ! settings.GetOrSetBool( SettingsKeys::software_rendering, true );
@@ -308,10 +419,7 @@ windowed:
 		Log::Info( "Version: ", glGetString( GL_VERSION ) );
 		Log::Info("");
 
-		if( settings_.GetOrSetBool( "r_gl_vsync", true ) )
-			SDL_GL_SetSwapInterval(1);
-		else
-			SDL_GL_SetSwapInterval(0);
+		UpdateVsync();
 	}
 
 	if( fullscreen )
@@ -349,6 +457,7 @@ windowed:
 	if( is_opengl )
 	{
 		GetGLFunctions( SDL_GL_GetProcAddress );
+		ShaderProgramGL::InitBinariesCache( SDL_GL_GetProcAddress );
 
 		#ifdef DEBUG
 		// Do reinterpret_cast, because on different platforms arguments of GLDEBUGPROC have
@@ -436,12 +545,29 @@ windowed:
 		{
 			scaled_viewport_buffer_width_= ( viewport_size_.Width () + 3u ) & (~3u);
 			scaled_viewport_color_buffer_.resize( scaled_viewport_buffer_width_ * viewport_size_.Height() );
+
+			async_present_= settings_.GetOrSetBool( "r_software_async_present", true );
+			if( async_present_ )
+			{
+				present_viewport_color_buffer_.resize( scaled_viewport_color_buffer_.size() );
+				present_thread_= std::thread( &SystemWindow::PresentThreadFunc, this );
+			}
 		}
 	}
 }
 
 SystemWindow::~SystemWindow()
 {
+	if( present_thread_.joinable() )
+	{
+		{
+			std::unique_lock<std::mutex> lock( present_mutex_ );
+			present_quit_= true;
+		}
+		present_condition_.notify_all();
+		present_thread_.join();
+	}
+
 	if( software_renderer_gl_texture_ != ~0u )
 		glDeleteTextures( 1u, &software_renderer_gl_texture_ );
 
@@ -557,6 +683,7 @@ void SystemWindow::EndFrame()
 	if( IsOpenGLRenderer() )
 	{
 		SDL_GL_SwapWindow( window_ );
+		FramePacing::MarkEvent( FramePacing::Event::Swap );
 	}
 	else if( use_gl_context_for_software_renderer_ )
 	{
@@ -576,33 +703,110 @@ void SystemWindow::EndFrame()
 		glEnd();
 
 		SDL_GL_SwapWindow( window_ );
+		FramePacing::MarkEvent( FramePacing::Event::Swap );
 	}
 	else
 	{
 		if( pixel_size_ == 1u && SDL_MUSTLOCK( surface_ ) )
 			SDL_UnlockSurface( surface_ );
 
+		if( async_present_ )
+		{
+			// Previous frame is shown here, current frame is only started scaling.
+			PresentAsync();
+			FramePacing::MarkEvent( FramePacing::Event::Swap );
+			return;
+		}
+
 		if( pixel_size_ > 1u )
 		{
 			if( SDL_MUSTLOCK( surface_ ) )
 				SDL_LockSurface( surface_ );
 
-			// Optimization.
-			// Generate different functions (via template parameter) for some useful scales.
-			// Compiler may optimize inner loops, if scale is constant.
-			switch( pixel_size_ )
-			{
-			case 2u: CopyAndScaleViewportToSystemViewport( []{ return 2u; } ); break;
-			case 3u: CopyAndScaleViewportToSystemViewport( []{ return 3u; } ); break;
-			case 4u: CopyAndScaleViewportToSystemViewport( []{ return 4u; } ); break;
-			default: CopyAndScaleViewportToSystemViewport( [this]{ return pixel_size_; } );  break;
-			};
+			ScaleViewportToSystemViewport( scaled_viewport_color_buffer_.data() );
 
 			if( SDL_MUSTLOCK( surface_ ) )
 				SDL_UnlockSurface( surface_ );
 		}
 
 		SDL_UpdateWindowSurface( window_ );
+		FramePacing::MarkEvent( FramePacing::Event::Swap );
+	}
+}
+
+void SystemWindow::ScaleViewportToSystemViewport( const uint32_t* const src_buffer )
+{
+	// Optimization.
+	// Generate different functions (via template parameter) for some useful scales.
+	// Compiler may optimize inner loops, if scale is constant.
+	switch( pixel_size_ )
+	{
+	case 2u: CopyAndScaleViewportToSystemViewport( []{ return 2u; }, src_buffer ); break;
+	case 3u: CopyAndScaleViewportToSystemViewport( []{ return 3u; }, src_buffer ); break;
+	case 4u: CopyAndScaleViewportToSystemViewport( []{ return 4u; }, src_buffer ); break;
+	default: CopyAndScaleViewportToSystemViewport( [this]{ return pixel_size_; }, src_buffer );  break;
+	};
+}
+
+void SystemWindow::PresentAsync()
+{
+	PC_ASSERT( async_present_ );
+
+	// Previous frame must be scaled before we touch present buffer and window surface.
+	WaitForPresentThread();
+
+	if( present_frame_scaled_ )
+	{
+		if( SDL_MUSTLOCK( surface_ ) )
+			SDL_UnlockSurface( surface_ );
+
+		// Update window surface only in main thread, SDL does not allow to do this in other threads.
+		SDL_UpdateWindowSurface( window_ );
+		present_frame_scaled_= false;
+	}
+
+	// Renderers have pointer to drawing buffer, so, copy frame instead of swapping buffers.
+	// Unscaled copy is much cheaper, than scaling.
+	std::memcpy(
+		present_viewport_color_buffer_.data(),
+		scaled_viewport_color_buffer_.data(),
+		present_viewport_color_buffer_.size() * sizeof(uint32_t) );
+
+	if( SDL_MUSTLOCK( surface_ ) )
+		SDL_LockSurface( surface_ );
+
+	{
+		std::unique_lock<std::mutex> lock( present_mutex_ );
+		present_requested_= true;
+	}
+	present_condition_.notify_all();
+}
+
+void SystemWindow::WaitForPresentThread()
+{
+	std::unique_lock<std::mutex> lock( present_mutex_ );
+	present_condition_.wait( lock, [this]{ return !present_requested_; } );
+}
+
+void SystemWindow::PresentThreadFunc()
+{
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock( present_mutex_ );
+			present_condition_.wait( lock, [this]{ return present_quit_ || present_requested_; } );
+			if( present_quit_ )
+				return;
+		}
+
+		ScaleViewportToSystemViewport( present_viewport_color_buffer_.data() );
+
+		{
+			std::unique_lock<std::mutex> lock( present_mutex_ );
+			present_requested_= false;
+			present_frame_scaled_= true;
+		}
+		present_condition_.notify_all();
 	}
 }
 
@@ -611,8 +815,21 @@ void SystemWindow::SetTitle( const std::string& title )
 	SDL_SetWindowTitle( window_, title.c_str() );
 }
 
+void SystemWindow::UpdateVsync()
+{
+	if( gl_context_ == nullptr )
+		return;
+
+	if( settings_.GetOrSetBool( "r_gl_vsync", true ) )
+		SDL_GL_SetSwapInterval(1);
+	else
+		SDL_GL_SetSwapInterval(0);
+}
+
 void SystemWindow::GetInput( SystemEvents& out_events )
 {
+	FramePacing::MarkEvent( FramePacing::Event::InputPoll );
+
 	out_events.clear();
 
 	SDL_Event event;
@@ -653,10 +870,7 @@ void SystemWindow::GetInput( SystemEvents& out_events )
 			break;
 
 		case SDL_MOUSEMOTION:
-			out_events.emplace_back();
-			out_events.back().type= SystemEvent::Type::MouseMove;
-			out_events.back().event.mouse_move.dx= event.motion.xrel;
-			out_events.back().event.mouse_move.dy= event.motion.yrel;
+			// Motion is taken from accumulated mouse state, because mice with high polling rate produce too many events.
 			break;
 
 		case SDL_TEXTINPUT:
@@ -676,6 +890,16 @@ void SystemWindow::GetInput( SystemEvents& out_events )
 			break;
 		};
 	} // while events
+
+	int dx= 0, dy= 0;
+	SDL_GetRelativeMouseState( &dx, &dy );
+	if( dx != 0 || dy != 0 )
+	{
+		out_events.emplace_back();
+		out_events.back().type= SystemEvent::Type::MouseMove;
+		out_events.back().event.mouse_move.dx= dx;
+		out_events.back().event.mouse_move.dy= dy;
+	}
 }
 
 void SystemWindow::GetInputState( InputState& out_input_state )
@@ -702,6 +926,17 @@ void SystemWindow::GetInputState( InputState& out_input_state )
 	}
 }
 
+void SystemWindow::SampleMouseMove( InputState& input_state )
+{
+	// Read new input from system. Other events stay in queue, until next GetInput.
+	SDL_PumpEvents();
+
+	int dx= 0, dy= 0;
+	SDL_GetRelativeMouseState( &dx, &dy );
+	input_state.mouse_dx+= dx;
+	input_state.mouse_dy+= dy;
+}
+
 void SystemWindow::CaptureMouse( const bool need_capture )
 {
 	if( need_capture != mouse_captured_ )
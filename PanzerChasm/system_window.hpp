@@ -1,4 +1,7 @@
 #pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <SDL.h>
 
@@ -41,8 +44,14 @@ public:
 
 	void SetTitle( const std::string& title );
 
+	// Apply vsync setting to existing context.
+	void UpdateVsync();
+
+	// Mouse motion is accumulated and returned as single MouseMove event.
 	void GetInput( SystemEvents& out_events );
 	void GetInputState( InputState& out_input_state );
+	// Get mouse motion, accumulated since last GetInput or SampleMouseMove call.
+	void SampleMouseMove( InputState& input_state );
 	void CaptureMouse( bool need_capture );
 
 private:
@@ -57,7 +66,12 @@ private:
 	void UpdateBrightness();
 
 	template<class ScaleGetter>
-	void CopyAndScaleViewportToSystemViewport( const ScaleGetter& scale_getter );
+	void CopyAndScaleViewportToSystemViewport( const ScaleGetter& scale_getter, const uint32_t* src_buffer );
+	void ScaleViewportToSystemViewport( const uint32_t* src_buffer );
+
+	void PresentAsync();
+	void WaitForPresentThread();
+	void PresentThreadFunc();
 
 private:
 	Settings& settings_;
@@ -76,6 +90,18 @@ private:
 	std::vector<uint32_t> scaled_viewport_color_buffer_;
 	unsigned int scaled_viewport_buffer_width_= 0u;
 
+	// Asynchronous scaling of software frames.
+	// Finished frame is copied into present buffer, then present thread scales it into window surface,
+	// while next frame is drawing. Scaled frame is shown at end of next frame.
+	bool async_present_= false;
+	std::vector<uint32_t> present_viewport_color_buffer_;
+	std::thread present_thread_;
+	std::mutex present_mutex_;
+	std::condition_variable present_condition_;
+	bool present_requested_= false;
+	bool present_frame_scaled_= false;
+	bool present_quit_= false;
+
 	bool mouse_captured_= false;
 
 	float previous_brightness_= -1.0f;
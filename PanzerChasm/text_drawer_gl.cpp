@@ -14,6 +14,10 @@ namespace PanzerChasm
 {
 
 const unsigned int g_max_letters_per_print= 2048u;
+// Cached glyph runs are stored in same vertex buffer, after letters of current print.
+// Total number of vertices must fit into 16-bit indices.
+const unsigned int g_max_cached_letters= 65536u / 4u - g_max_letters_per_print;
+const unsigned int g_total_letters= g_max_letters_per_print + g_max_cached_letters;
 
 static const GLenum g_gl_state_blend_func[2]= { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
 static const r_OGLState g_gl_state(
@@ -75,10 +79,10 @@ TextDrawerGL::TextDrawerGL(
 		r_Texture::Filtration::Nearest );
 
 	// Vertex buffer
-	std::vector<unsigned short> indeces( 6u * g_max_letters_per_print );
-	vertex_buffer_.resize( 4u * g_max_letters_per_print );
+	std::vector<unsigned short> indeces( 6u * g_total_letters );
+	vertex_buffer_.resize( 4u * g_total_letters );
 
-	for( unsigned int i= 0u; i < g_max_letters_per_print; i++ )
+	for( unsigned int i= 0u; i < g_total_letters; i++ )
 	{
 		unsigned short* const ind= indeces.data() + 6u * i;
 		ind[0]= 4u * i + 0u;  ind[1]= 4u * i + 1u;  ind[2]= 4u * i + 2u;
@@ -126,28 +130,107 @@ unsigned int TextDrawerGL::GetLineHeight() const
 
 void TextDrawerGL::Print(
 	const int x, const int y,
-	const char* text,
+	const char* const text,
 	const unsigned int scale,
 	const FontColor color,
 	const Alignment alignment )
+{
+	// Console, menu and hud print same texts in many frames.
+	// Glyph runs are laid out relative to print point, so, we can store it in vertex buffer and reuse for any position.
+	glyph_run_key_.assign( text );
+	glyph_run_key_.push_back( '\0' );
+	glyph_run_key_.push_back( static_cast<char>(scale) );
+	glyph_run_key_.push_back( static_cast<char>(color) );
+	glyph_run_key_.push_back( static_cast<char>(alignment) );
+
+	unsigned int first_letter, letter_count;
+
+	const auto it= glyph_runs_.find( glyph_run_key_ );
+	if( it != glyph_runs_.end() )
+	{
+		first_letter= it->second.first_letter;
+		letter_count= it->second.letter_count;
+	}
+	else
+	{
+		letter_count= LayoutGlyphs( text, scale, color, alignment, vertex_buffer_.data() );
+
+		if( letter_count > g_max_cached_letters - cached_letters_ )
+		{
+			// Cache is full - just drop all runs.
+			glyph_runs_.clear();
+			cached_letters_= 0u;
+		}
+
+		first_letter= g_max_letters_per_print + cached_letters_;
+		cached_letters_+= letter_count;
+
+		GlyphRun& run= glyph_runs_[ glyph_run_key_ ];
+		run.first_letter= first_letter;
+		run.letter_count= letter_count;
+
+		polygon_buffer_.VertexSubData(
+			vertex_buffer_.data(),
+			letter_count * 4u * sizeof(Vertex),
+			first_letter * 4u * sizeof(Vertex) );
+	}
+
+	if( letter_count == 0u )
+		return;
+
+	// Draw
+	r_OGLStateManager::UpdateState( g_gl_state );
+
+	shader_.Bind();
+
+	texture_.Bind(0u);
+	shader_.Uniform( "tex", int(0) );
+
+	shader_.Uniform(
+		"inv_viewport_size",
+		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
+
+	shader_.Uniform(
+		"inv_texture_size",
+		m_Vec2( 1.0f / float(texture_.Width()), 1.0f / float(texture_.Height()) ) );
+
+	shader_.Uniform(
+		"pos_offset",
+		m_Vec2( float(x), float( int(viewport_size_.Height()) - y ) ) );
+
+	polygon_buffer_.Bind();
+	glDrawElements(
+		GL_TRIANGLES,
+		letter_count * 6u,
+		GL_UNSIGNED_SHORT,
+		reinterpret_cast<void*>( first_letter * 6u * sizeof(unsigned short) ) );
+}
+
+unsigned int TextDrawerGL::LayoutGlyphs(
+	const char* text,
+	const unsigned int scale,
+	const FontColor color,
+	const Alignment alignment,
+	Vertex* const out_vertices ) const
 {
 	const int scale_i= int(scale);
 	const int d_tc_v= int(color) * int(FontParams::atlas_height);
 
-	Vertex* v= vertex_buffer_.data();
-	int current_x= x;
-	int current_y= viewport_size_.Height() - y - scale * FontParams::letter_height;
+	Vertex* v= out_vertices;
+	Vertex* const v_end= out_vertices + 4u * g_max_letters_per_print;
+	int current_x= 0;
+	int current_y= -int( scale * FontParams::letter_height );
 
 	Vertex* last_newline_vertex_index= v;
 	while( 1 )
 	{
 		const unsigned int code= static_cast<unsigned char>(*text); // Convert to unsigned - allow chars with codes 128 - 255.
-		if( code == '\n' || code == '\0' )
+		if( code == '\n' || code == '\0' || v == v_end )
 		{
 			if( alignment == Alignment::Center )
 			{
 				const int center_x= ( last_newline_vertex_index->xy[0] + current_x ) / 2;
-				const int delta_x= x - center_x;
+				const int delta_x= -center_x;
 				while( last_newline_vertex_index < v )
 				{
 					last_newline_vertex_index->xy[0]+= delta_x;
@@ -163,13 +246,14 @@ void TextDrawerGL::Print(
 					last_newline_vertex_index++;
 				}
 			}
+			last_newline_vertex_index= v;
 
-			current_x= x;
+			if( code == '\0' || v == v_end ) break;
+
+			current_x= 0;
 			current_y-= int(FontParams::letter_height * scale);
 			text++;
-
-			if( code == '\0' ) break;
-			else continue;
+			continue;
 		}
 
 		const unsigned int tc_u= ( code & 15u ) * FontParams::letter_place_width  + FontParams::letter_u_offset;
@@ -201,32 +285,7 @@ void TextDrawerGL::Print(
 		text++;
 	}
 
-	const unsigned int vertex_count= v - vertex_buffer_.data();
-	const unsigned int index_count= vertex_count / 4u * 6u;
-
-
-	polygon_buffer_.VertexSubData(
-		vertex_buffer_.data(),
-		vertex_count * sizeof(Vertex),
-		0u );
-
-	// Draw
-	r_OGLStateManager::UpdateState( g_gl_state );
-
-	shader_.Bind();
-
-	texture_.Bind(0u);
-	shader_.Uniform( "tex", int(0) );
-
-	shader_.Uniform(
-		"inv_viewport_size",
-		m_Vec2( 1.0f / float(viewport_size_.xy[0]), 1.0f / float(viewport_size_.xy[1]) ) );
-
-	shader_.Uniform(
-		"inv_texture_size",
-		m_Vec2( 1.0f / float(texture_.Width()), 1.0f / float(texture_.Height()) ) );
-
-	glDrawElements( GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr );
+	return static_cast<unsigned int>( v - out_vertices ) / 4u;
 }
 
 } // namespace PanzerChasm
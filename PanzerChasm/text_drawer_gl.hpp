@@ -1,12 +1,14 @@
 #pragma once
+#include <string>
+#include <unordered_map>
 
-#include <glsl_program.hpp>
 #include <polygon_buffer.hpp>
 #include <texture.hpp>
 
 #include "fwd.hpp"
 #include "i_text_drawer.hpp"
 #include "rendering_context.hpp"
+#include "shader_program_gl.hpp"
 
 namespace PanzerChasm
 {
@@ -35,16 +37,35 @@ private:
 		short tex_coord[2];
 	};
 
+	struct GlyphRun
+	{
+		unsigned int first_letter;
+		unsigned int letter_count;
+	};
+
+private:
+	// Returns number of letters. Vertices are relative to print point.
+	unsigned int LayoutGlyphs(
+		const char* text,
+		unsigned int scale,
+		FontColor color,
+		Alignment alignment,
+		Vertex* out_vertices ) const;
+
 private:
 	const Size2 viewport_size_;
 	unsigned char letters_width_[256];
 
-	r_GLSLProgram shader_;
+	ShaderProgramGL shader_;
 	r_Texture texture_;
 
 	r_PolygonBuffer polygon_buffer_;
 	std::vector<Vertex> vertex_buffer_;
 
+	// Laid out texts in polygon buffer. Key - text, scale, color and alignment.
+	std::unordered_map< std::string, GlyphRun > glyph_runs_;
+	std::string glyph_run_key_;
+	unsigned int cached_letters_= 0u;
 };
 
 } // namespace PanzerChasm
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include "assert.hpp"
@@ -10,6 +11,8 @@
 namespace PanzerChasm
 {
 
+static constexpr unsigned int g_max_text_layers= 512u;
+
 TextDrawerSoft::TextDrawerSoft(
 	const RenderingContextSoft& rendering_context,
 	const GameResources& game_resources )
@@ -61,12 +64,104 @@ void TextDrawerSoft::Print(
 	const unsigned int scale,
 	const FontColor color,
 	const Alignment alignment )
+{
+	print_counter_++;
+
+	// Same texts ( console lines, menu items, hud ) are printed in many frames.
+	// Draw each text into layer once and than just copy it.
+	text_layer_key_.assign( text );
+	text_layer_key_.push_back( '\0' );
+	text_layer_key_.push_back( static_cast<char>(scale) );
+	text_layer_key_.push_back( static_cast<char>(color) );
+	text_layer_key_.push_back( static_cast<char>(alignment) );
+
+	auto it= text_layers_.find( text_layer_key_ );
+	if( it == text_layers_.end() )
+	{
+		if( text_layers_.size() >= g_max_text_layers )
+		{
+			// Remove layers, unused recently.
+			for( auto layer_it= text_layers_.begin(); layer_it != text_layers_.end(); )
+			{
+				if( layer_it->second.last_use_counter + g_max_text_layers < print_counter_ )
+					layer_it= text_layers_.erase( layer_it );
+				else
+					++layer_it;
+			}
+			if( text_layers_.size() >= g_max_text_layers )
+				text_layers_.clear();
+		}
+
+		it= text_layers_.emplace( text_layer_key_, TextLayer() ).first;
+		DrawTextLayer( text, scale, color, alignment, it->second );
+	}
+
+	TextLayer& text_layer= it->second;
+	text_layer.last_use_counter= print_counter_;
+	text_layer.layer.Draw( rendering_context_, x + text_layer.x_offset, y );
+}
+
+void TextDrawerSoft::DrawTextLayer(
+	const char* const text,
+	const unsigned int scale,
+	const FontColor color,
+	const Alignment alignment,
+	TextLayer& out_layer )
+{
+	// Calculate bounds of all lines, relative to print point.
+	int x_min= 0, x_max= 0;
+	unsigned int line_count= 0u;
+	const char* c= text;
+	while( *c != '\0' )
+	{
+		unsigned int line_width= 0u;
+		while( ! ( *c == '\n' || *c == '\0' ) )
+		{
+			line_width+= letters_width_[ static_cast<unsigned char>(*c) ];
+			c++;
+		}
+		if( *c == '\n' ) c++;
+		line_count++;
+
+		int line_x;
+		if( alignment == Alignment::Center )
+			line_x= -int( scale * line_width / 2u );
+		else if( alignment == Alignment::Right )
+			line_x= -int( scale * line_width );
+		else
+			line_x= 0;
+
+		x_min= std::min( x_min, line_x );
+		x_max= std::max( x_max, line_x + int( scale * line_width ) );
+	}
+
+	const unsigned int glyph_height= std::max( FontParams::letter_height, FontParams::letter_place_height - FontParams::letter_v_offset );
+	const unsigned int height= line_count == 0u ? 0u : scale * ( ( line_count - 1u ) * FontParams::letter_height + glyph_height );
+
+	out_layer.x_offset= x_min;
+	out_layer.layer.Reset( static_cast<unsigned int>( x_max - x_min ), height );
+
+	DrawText(
+		out_layer.layer.GetPixels(),
+		int(out_layer.layer.GetSizeX()), int(out_layer.layer.GetSizeX()), int(out_layer.layer.GetSizeY()),
+		-x_min, 0,
+		text, scale, color, alignment );
+
+	out_layer.layer.BuildSpans();
+}
+
+void TextDrawerSoft::DrawText(
+	uint32_t* const dst_pixels,
+	const int dst_row_pixels,
+	const int max_x,
+	const int max_y,
+	const int x, const int y,
+	const char* const text,
+	const unsigned int scale,
+	const FontColor color,
+	const Alignment alignment )
 {
 	const PaletteTransformed& palette= *rendering_context_.palette_transformed;
-	uint32_t* const dst_pixels= rendering_context_.window_surface_data;
-	const int dst_row_pixels= rendering_context_.row_pixels;
-	const int max_x= int( rendering_context_.viewport_size.Width () );
-	const int max_y= int( rendering_context_.viewport_size.Height() );
 
 	const int scale_i= int(scale);
 	const int d_tc_v= int(color) * int(FontParams::atlas_height);
@@ -83,7 +178,7 @@ void TextDrawerSoft::Print(
 		const char* line_end_c= c;
 		while( ! ( *line_end_c == '\n' || *line_end_c == '\0' ) )
 		{
-			line_width+= letters_width_[ int(*line_end_c) ];
+			line_width+= letters_width_[ static_cast<unsigned char>(*line_end_c) ];
 			line_end_c++;
 		}
 
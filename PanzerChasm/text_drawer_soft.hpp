@@ -1,8 +1,11 @@
 #pragma once
+#include <string>
+#include <unordered_map>
 
 #include "fwd.hpp"
 #include "i_text_drawer.hpp"
 #include "rendering_context.hpp"
+#include "retained_layer_soft.hpp"
 #include "text_drawers_common.hpp"
 
 namespace PanzerChasm
@@ -25,11 +28,41 @@ public:
 		FontColor color,
 		Alignment alignment ) override;
 
+private:
+	struct TextLayer
+	{
+		RetainedLayerSoft layer;
+		int x_offset; // Layer position relative to print point.
+		unsigned int last_use_counter= 0u;
+	};
+
+private:
+	void DrawTextLayer(
+		const char* text,
+		unsigned int scale,
+		FontColor color,
+		Alignment alignment,
+		TextLayer& out_layer );
+
+	void DrawText(
+		uint32_t* dst_pixels, int dst_row_pixels,
+		int max_x, int max_y,
+		int x, int y,
+		const char* text,
+		unsigned int scale,
+		FontColor color,
+		Alignment alignment );
+
 private:
 	const RenderingContextSoft rendering_context_;
 	unsigned char letters_width_[256];
 
 	unsigned char font_texture_data_[ FontParams::atlas_width * FontParams::atlas_height * FontParams::colors_variations ];
+
+	// Retained layers of printed texts. Key - text, scale, color and alignment.
+	std::unordered_map< std::string, TextLayer > text_layers_;
+	std::string text_layer_key_;
+	unsigned int print_counter_= 0u;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "text_tokenizer.hpp"
+
+namespace PanzerChasm
+{
+
+static bool IsSpace( const char c )
+{
+	return std::isspace( static_cast<unsigned char>(c) ) != 0;
+}
+
+static char ToLower( const char c )
+{
+	return static_cast<char>( std::tolower( static_cast<unsigned char>(c) ) );
+}
+
+// Numbers are short, so, just copy them into null-terminated buffer for standard parsing functions.
+template<class T, class Func>
+static bool ParseNumber( const TextSpan& span, T& out_value, const Func& parse_func )
+{
+	char str[64];
+	span.CopyTo( str, sizeof(str) );
+
+	char* str_end= str;
+	const T value= static_cast<T>( parse_func( str, &str_end ) );
+	if( str_end == str )
+		return false;
+
+	out_value= value;
+	return true;
+}
+
+TextSpan::TextSpan( const char* const in_begin, const char* const in_end )
+	: begin(in_begin), end(in_end)
+{}
+
+bool TextSpan::Equals( const char* const str ) const
+{
+	const size_t length= std::strlen( str );
+	return length == size() && std::memcmp( begin, str, length ) == 0;
+}
+
+bool TextSpan::EqualsIgnoreCase( const char* const str ) const
+{
+	const size_t length= std::strlen( str );
+	if( length != size() )
+		return false;
+
+	for( size_t i= 0u; i < length; i++ )
+		if( ToLower( begin[i] ) != ToLower( str[i] ) )
+			return false;
+	return true;
+}
+
+bool TextSpan::StartsWith( const char* const str ) const
+{
+	const size_t length= std::strlen( str );
+	return length <= size() && std::memcmp( begin, str, length ) == 0;
+}
+
+const char* TextSpan::Find( const char* const str ) const
+{
+	const char* const result= std::search( begin, end, str, str + std::strlen( str ) );
+	return result == end ? nullptr : result;
+}
+
+const char* TextSpan::FindIgnoreCase( const char* const str ) const
+{
+	const char* const result=
+		std::search(
+			begin, end, str, str + std::strlen( str ),
+			[]( const char a, const char b ) { return ToLower(a) == ToLower(b); } );
+	return result == end ? nullptr : result;
+}
+
+bool TextSpan::ToNumber( int& out_value ) const
+{
+	return ParseNumber( *this, out_value, []( const char* s, char** s_end ){ return std::strtol( s, s_end, 10 ); } );
+}
+
+bool TextSpan::ToNumber( unsigned int& out_value ) const
+{
+	return ParseNumber( *this, out_value, []( const char* s, char** s_end ){ return std::strtoul( s, s_end, 10 ); } );
+}
+
+bool TextSpan::ToNumber( float& out_value ) const
+{
+	return ParseNumber( *this, out_value, []( const char* s, char** s_end ){ return std::strtof( s, s_end ); } );
+}
+
+void TextSpan::CopyTo( char* const out_str, const size_t out_str_size ) const
+{
+	if( out_str_size == 0u )
+		return;
+
+	const size_t length= std::min( size(), out_str_size - 1u );
+	std::memcpy( out_str, begin, length );
+	out_str[ length ]= '\0';
+}
+
+TextSpan TextSpan::TrimSpaces() const
+{
+	TextSpan result= *this;
+	while( result.begin < result.end && IsSpace( *result.begin ) )
+		result.begin++;
+	while( result.begin < result.end && IsSpace( result.end[-1] ) )
+		result.end--;
+	return result;
+}
+
+TextTokenizer::TextTokenizer( const TextSpan& text )
+	: text_end_(text.end)
+	, next_line_(text.begin)
+	, line_( text.begin, text.begin )
+	, line_pos_(text.begin)
+{}
+
+bool TextTokenizer::NextLine()
+{
+	if( next_line_ >= text_end_ )
+		return false;
+
+	const char* line_end= next_line_;
+	while( line_end < text_end_ && *line_end != '\n' )
+		line_end++;
+
+	line_= TextSpan( next_line_, line_end );
+	line_pos_= line_.begin;
+	next_line_= line_end < text_end_ ? line_end + 1 : line_end;
+	return true;
+}
+
+TextSpan TextTokenizer::NextToken()
+{
+	while( line_pos_ < line_.end && IsSpace( *line_pos_ ) )
+		line_pos_++;
+
+	const char* const token_begin= line_pos_;
+	while( line_pos_ < line_.end && !IsSpace( *line_pos_ ) )
+		line_pos_++;
+
+	return TextSpan( token_begin, line_pos_ );
+}
+
+TextSpan TextTokenizer::RestOfLine()
+{
+	const TextSpan result= TextSpan( line_pos_, line_.end ).TrimSpaces();
+	line_pos_= line_.end;
+	return result;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+
+namespace PanzerChasm
+{
+
+// Non-owning view of text. Text is not null-terminated.
+struct TextSpan
+{
+	const char* begin= nullptr;
+	const char* end= nullptr;
+
+	TextSpan()= default;
+	TextSpan( const char* in_begin, const char* in_end );
+
+	bool empty() const { return begin == end; }
+	size_t size() const { return size_t( end - begin ); }
+
+	bool Equals( const char* str ) const;
+	bool EqualsIgnoreCase( const char* str ) const;
+	bool StartsWith( const char* str ) const;
+
+	// Returns pointer to first occurence of "str", or nullptr, if not found.
+	const char* Find( const char* str ) const;
+	const char* FindIgnoreCase( const char* str ) const;
+
+	// Does not change "out_value", if span starts not with number. Trailing symbols are ignored.
+	bool ToNumber( int& out_value ) const;
+	bool ToNumber( unsigned int& out_value ) const;
+	bool ToNumber( float& out_value ) const;
+
+	// Writes null-terminated string. Truncates text, if it is too long.
+	void CopyTo( char* out_str, size_t out_str_size ) const;
+
+	TextSpan TrimSpaces() const;
+};
+
+// Splits text into lines and lines into space-separated tokens. Does not allocate memory.
+class TextTokenizer final
+{
+public:
+	explicit TextTokenizer( const TextSpan& text );
+
+	// Moves to next line. Returns false, if text ended.
+	bool NextLine();
+
+	// Returns whole current line, including already readed tokens.
+	const TextSpan& GetLine() const { return line_; }
+
+	// Returns empty span, if current line ended.
+	TextSpan NextToken();
+
+	// Returns rest of current line without leading and trailing spaces.
+	TextSpan RestOfLine();
+
+	// Reads next token as number. Token is consumed even if it is not number.
+	template<class T>
+	bool ReadNumber( T& out_value )
+	{
+		return NextToken().ToNumber( out_value );
+	}
+
+private:
+	const char* const text_end_;
+	const char* next_line_;
+	TextSpan line_;
+	const char* line_pos_;
+};
+
+} // namespace PanzerChasm
@@ -10,7 +10,7 @@ TicksCounter::TicksCounter( const Time frequency_calc_interval )
 	, total_ticks_(0u)
 	, output_ticks_frequency_(0.0f)
 	, current_sample_ticks_(0u)
-	, last_update_time_( Time::CurrentTime() )
+	, last_update_time_( Time::FrameTime() )
 {}
 
 TicksCounter::~TicksCounter()
@@ -21,7 +21,7 @@ void TicksCounter::Tick( const unsigned int count )
 	total_ticks_+= count;
 	current_sample_ticks_+= count;
 
-	const Time current_time= Time::CurrentTime();
+	const Time current_time= Time::FrameTime();
 	const Time dt= current_time - last_update_time_;
 
 	if( dt >= frequency_calc_interval_ )
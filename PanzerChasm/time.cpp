@@ -6,6 +6,9 @@
 namespace PanzerChasm
 {
 
+static thread_local bool g_frame_time_sampled= false;
+static thread_local int64_t g_frame_time= 0;
+
 Time Time::CurrentTime()
 {
 	const auto current_time= std::chrono::steady_clock::now();
@@ -19,6 +22,19 @@ Time Time::CurrentTime()
 	return Time( now_points.count() );
 }
 
+void Time::SampleFrameTime()
+{
+	g_frame_time= CurrentTime().time_;
+	g_frame_time_sampled= true;
+}
+
+Time Time::FrameTime()
+{
+	if( !g_frame_time_sampled )
+		return CurrentTime();
+	return Time( g_frame_time );
+}
+
 Time Time::FromSeconds( double seconds )
 {
 	return
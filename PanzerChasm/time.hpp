@@ -11,6 +11,13 @@ class Time final
 public:
 	static Time CurrentTime();
 
+	// Frame clock. Loops sample time once at start and all code of loop uses this sample.
+	// So, clock is read only once per loop and all times within one loop are same.
+	// Sample is per-thread. If current thread never sampled time, current time is returned.
+	// Use "CurrentTime" for measurement of durations inside loop and for waiting.
+	static void SampleFrameTime();
+	static Time FrameTime();
+
 	static Time FromSeconds( double seconds );
 	static Time FromSeconds( int seconds );
 	static Time FromSeconds( int64_t seconds );
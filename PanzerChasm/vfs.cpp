@@ -1,11 +1,24 @@
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
 #include <cstring>
 
+// Include OS-dependend stuff for files mapping.
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../Common/files.hpp"
 using namespace ChasmReverse;
 
 #include "log.hpp"
+#include "profiler.hpp"
 
 #include "vfs.hpp"
 
@@ -74,6 +87,106 @@ static std::string PrepareAddonPath( const char* const addon_path )
 	return result;
 }
 
+// Returns mapping of whole file or null, if file does not exist, is empty or can not be mapped.
+static void* MapWholeFile( const char* const file_name, size_t& out_size )
+{
+#ifdef _WIN32
+	const HANDLE file= ::CreateFileA( file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE )
+		return nullptr;
+
+	LARGE_INTEGER file_size;
+	if( ::GetFileSizeEx( file, &file_size ) == 0 || file_size.QuadPart <= 0 )
+	{
+		::CloseHandle( file );
+		return nullptr;
+	}
+
+	const HANDLE mapping= ::CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	::CloseHandle( file );
+	if( mapping == nullptr )
+		return nullptr;
+
+	// View keeps mapping alive, so, mapping handle is not needed anymore.
+	void* const data= ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	::CloseHandle( mapping );
+	if( data == nullptr )
+		return nullptr;
+
+	out_size= static_cast<size_t>( file_size.QuadPart );
+	return data;
+#else
+	const int file= ::open( file_name, O_RDONLY );
+	if( file == -1 )
+		return nullptr;
+
+	struct stat file_stat;
+	if( ::fstat( file, &file_stat ) != 0 || file_stat.st_size <= 0 )
+	{
+		::close( file );
+		return nullptr;
+	}
+
+	// Mapping stays valid after closing of file.
+	void* const data= ::mmap( nullptr, static_cast<size_t>( file_stat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	::close( file );
+	if( data == MAP_FAILED )
+		return nullptr;
+
+	out_size= static_cast<size_t>( file_stat.st_size );
+	return data;
+#endif
+}
+
+static void UnmapFile( void* const data, const size_t size )
+{
+#ifdef _WIN32
+	(void)size;
+	::UnmapViewOfFile( data );
+#else
+	::munmap( data, size );
+#endif
+}
+
+Vfs::FileView::FileView( const unsigned char* const data, const size_t size )
+	: data_(data), size_(size)
+{}
+
+Vfs::FileView::FileView( const FileContent& content )
+	: data_(content.data()), size_(content.size())
+{}
+
+Vfs::MappedFile::MappedFile( MappedFile&& other )
+{
+	*this= std::move(other);
+}
+
+Vfs::MappedFile::~MappedFile()
+{
+	if( own_mapping_ != nullptr )
+		UnmapFile( own_mapping_, own_mapping_size_ );
+}
+
+Vfs::MappedFile& Vfs::MappedFile::operator=( MappedFile&& other )
+{
+	if( this == &other )
+		return *this;
+
+	if( own_mapping_ != nullptr )
+		UnmapFile( own_mapping_, own_mapping_size_ );
+
+	// Moving of vector does not change its data pointer, so, view stays valid.
+	view_= other.view_;
+	own_mapping_= other.own_mapping_;
+	own_mapping_size_= other.own_mapping_size_;
+	content_= std::move( other.content_ );
+
+	other.view_= FileView();
+	other.own_mapping_= nullptr;
+	other.own_mapping_size_= 0u;
+	return *this;
+}
+
 Vfs::VurtualFileName::VurtualFileName( const char* const in_text )
 {
 	size_t i= 0u;
@@ -145,10 +258,18 @@ Vfs::Vfs(
 
 		virtual_files_[ VurtualFileName( file_info_packed.name, file_info_packed.name_length ) ]= file;
 	}
+
+	size_t archive_mapping_size= 0u;
+	archive_mapping_= static_cast<const unsigned char*>( MapWholeFile( archive_file_name, archive_mapping_size ) );
+	archive_mapping_size_= archive_mapping_size;
+	if( archive_mapping_ == nullptr )
+		Log::Warning( "Could not map file \"", archive_file_name, "\", reading it via stdio" );
 }
 
 Vfs::~Vfs()
 {
+	if( archive_mapping_ != nullptr )
+		UnmapFile( const_cast<unsigned char*>( archive_mapping_ ), archive_mapping_size_ );
 	if( archive_file_ != nullptr )
 		std::fclose( archive_file_ );
 }
@@ -173,9 +294,7 @@ void Vfs::ReadFile( const char* const file_path, FileContent& out_file_content )
 	// Try read from real file system.
 	if( !addon_path_.empty() )
 	{
-		std::string fs_file_path= addon_path_ + ToUpper(file_path); // Use ToUpper, because files in addons are in upper case.
-		std::replace(fs_file_path.begin(), fs_file_path.end(), '\\', '/' ); // Change shitty DOS/Windows path separators to universal windows/unix separators.
-
+		const std::string fs_file_path= GetAddonFilePath( file_path );
 		std::FILE* const fs_file= std::fopen( fs_file_path.c_str(), "rb" );
 
 		if( fs_file != nullptr )
@@ -188,22 +307,121 @@ void Vfs::ReadFile( const char* const file_path, FileContent& out_file_content )
 			FileRead( fs_file, out_file_content.data(), file_size );
 
 			std::fclose( fs_file );
+			Profiler::CountFileBytesRead( file_size );
 			return;
 		}
 	}
 
-	const auto it= virtual_files_.find( VurtualFileName( file_name ) );
-	if( it != virtual_files_.end() )
+	if( const VirtualFile* const file= FindVirtualFile( file_path ) )
 	{
-		const VirtualFile& file= it->second;
-		out_file_content.resize( file.size );
-		std::fseek( archive_file_, file.offset, SEEK_SET );
-		FileRead( archive_file_, out_file_content.data(), out_file_content.size() );
-
+		out_file_content.resize( file->size );
+		ReadArchiveData( file->offset, out_file_content.data(), file->size );
+		Profiler::CountFileBytesRead( file->size );
 		return;
 	}
 
 	out_file_content.clear();
 }
 
+Vfs::MappedFile Vfs::MapFile( const char* const file_path ) const
+{
+	MappedFile result;
+
+	const char* const file_name= ExtractFileName( file_path );
+	if( file_name[0] == '\0' )
+		return result; // Do not load files with empty path.
+
+	// Try map file from real file system.
+	bool addon_file_exists= false;
+	if( !addon_path_.empty() )
+	{
+		const std::string fs_file_path= GetAddonFilePath( file_path );
+		result.own_mapping_= MapWholeFile( fs_file_path.c_str(), result.own_mapping_size_ );
+		if( result.own_mapping_ != nullptr )
+		{
+			result.view_= FileView( static_cast<const unsigned char*>( result.own_mapping_ ), result.own_mapping_size_ );
+			Profiler::CountFileBytesRead( result.own_mapping_size_ );
+			return result;
+		}
+
+		if( std::FILE* const fs_file= std::fopen( fs_file_path.c_str(), "rb" ) )
+		{
+			addon_file_exists= true;
+			std::fclose( fs_file );
+		}
+	}
+
+	if( !addon_file_exists && archive_mapping_ != nullptr )
+	{
+		if( const VirtualFile* const file= FindVirtualFile( file_path ) )
+		{
+			result.view_= FileView( archive_mapping_ + file->offset, file->size );
+			Profiler::CountFileBytesRead( file->size );
+		}
+		return result;
+	}
+
+	// Fallback - read file, if it is in addons, but can not be mapped, or if archive is not mapped.
+	ReadFile( file_path, result.content_ );
+	result.view_= result.content_;
+	return result;
+}
+
+void Vfs::ReadArchiveData( const unsigned int offset, unsigned char* const out_data, const unsigned int size ) const
+{
+	if( archive_mapping_ != nullptr )
+	{
+		std::memcpy( out_data, archive_mapping_ + offset, size );
+		return;
+	}
+
+#ifdef _WIN32
+	// Shared file position - serialize reads.
+	std::unique_lock<std::mutex> lock( archive_file_mutex_ );
+	std::fseek( archive_file_, offset, SEEK_SET );
+	FileRead( archive_file_, out_data, size );
+#else
+	// Positional read does not touch shared file position, so, no lock needed.
+	const int file= ::fileno( archive_file_ );
+	unsigned int bytes_read= 0u;
+	while( bytes_read < size )
+	{
+		const ssize_t result= ::pread( file, out_data + bytes_read, size - bytes_read, off_t(offset) + off_t(bytes_read) );
+		if( result <= 0 )
+		{
+			if( result < 0 && errno == EINTR )
+				continue;
+
+			Log::Warning( "Could not read archive data" );
+			std::memset( out_data + bytes_read, 0, size - bytes_read );
+			return;
+		}
+		bytes_read+= static_cast<unsigned int>(result);
+	}
+#endif
+}
+
+const Vfs::VirtualFile* Vfs::FindVirtualFile( const char* const file_path ) const
+{
+	const auto it= virtual_files_.find( VurtualFileName( ExtractFileName( file_path ) ) );
+	if( it == virtual_files_.end() )
+		return nullptr;
+
+	const VirtualFile& file= it->second;
+	if( archive_mapping_ != nullptr && size_t(file.offset) + size_t(file.size) > archive_mapping_size_ )
+	{
+		Log::Warning( "File \"", file_path, "\" is out of archive bounds" );
+		return nullptr;
+	}
+
+	return &file;
+}
+
+std::string Vfs::GetAddonFilePath( const char* const file_path ) const
+{
+	std::string fs_file_path= addon_path_ + ToUpper(file_path); // Use ToUpper, because files in addons are in upper case.
+	std::replace(fs_file_path.begin(), fs_file_path.end(), '\\', '/' ); // Change shitty DOS/Windows path separators to universal windows/unix separators.
+	return fs_file_path;
+}
+
 } // namespace PanzerChasm
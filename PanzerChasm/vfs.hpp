@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdio>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -8,17 +10,66 @@ namespace PanzerChasm
 {
 
 // Virtual file system
+// All reading methods are thread-safe and may be called concurrently, for example, by loaders in workers pool.
 class Vfs final
 {
 public:
 	typedef std::vector<unsigned char> FileContent;
 
+	// Read-only view of file content. Does not own data.
+	class FileView final
+	{
+	public:
+		FileView()= default;
+		FileView( const unsigned char* data, size_t size );
+		FileView( const FileContent& content ); // Implicit, for loading from owned data.
+
+		const unsigned char* data() const { return data_; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0u; }
+
+	private:
+		const unsigned char* data_= nullptr;
+		size_t size_= 0u;
+	};
+
+	// Mapped file content. Files from archive are views into archive mapping, addon files have own mappings.
+	// Valid only while Vfs exists.
+	class MappedFile final
+	{
+	public:
+		MappedFile()= default;
+		MappedFile( const MappedFile& )= delete;
+		MappedFile( MappedFile&& other );
+		~MappedFile();
+
+		MappedFile& operator=( const MappedFile& )= delete;
+		MappedFile& operator=( MappedFile&& other );
+
+		operator FileView() const { return view_; }
+
+		const unsigned char* data() const { return view_.data(); }
+		size_t size() const { return view_.size(); }
+		bool empty() const { return view_.empty(); }
+
+	private:
+		friend class Vfs;
+
+		FileView view_;
+		void* own_mapping_= nullptr; // Null for archive files.
+		size_t own_mapping_size_= 0u;
+		FileContent content_; // Used, if file can not be mapped.
+	};
+
 	explicit Vfs( const char* archive_file_name, const char* addon_path= nullptr );
 	~Vfs();
 
 	FileContent ReadFile( const char* file_path ) const;
 	void ReadFile( const char* file_path, FileContent& out_file_content ) const;
 
+	// Zero-copy read. Prefer this for files, which are just parsed during loading.
+	MappedFile MapFile( const char* file_path ) const;
+
 private:
 	struct VirtualFile
 	{
@@ -43,7 +94,16 @@ private:
 	typedef std::unordered_map< VurtualFileName, VirtualFile, VurtualFileNameHasher > VirtualFiles;
 
 private:
+	const VirtualFile* FindVirtualFile( const char* file_path ) const;
+	void ReadArchiveData( unsigned int offset, unsigned char* out_data, unsigned int size ) const;
+	std::string GetAddonFilePath( const char* file_path ) const;
+
 	std::FILE* const archive_file_;
+	mutable std::mutex archive_file_mutex_; // Used only if archive is not mapped and positional reads are not available.
+
+	// Whole archive is mapped into memory, if possible. Reading of mapped archive does not need lock.
+	const unsigned char* archive_mapping_= nullptr;
+	size_t archive_mapping_size_= 0u;
 	const std::string addon_path_;
 
 	VirtualFiles virtual_files_;
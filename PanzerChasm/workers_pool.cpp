@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include "workers_pool.hpp"
+
+namespace PanzerChasm
+{
+
+static const unsigned int g_max_threads= 8u;
+
+WorkersPool::WorkersPool( unsigned int thread_count )
+	: next_task_(0u)
+{
+	if( thread_count == 0u )
+		thread_count= std::min( std::max( std::thread::hardware_concurrency(), 1u ), g_max_threads );
+
+	for( unsigned int i= 1u; i < thread_count; i++ )
+		threads_.emplace_back( &WorkersPool::WorkerThreadFunc, this );
+}
+
+WorkersPool::~WorkersPool()
+{
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		quit_= true;
+	}
+	work_condition_.notify_all();
+
+	for( std::thread& thread : threads_ )
+		thread.join();
+}
+
+unsigned int WorkersPool::GetThreadCount() const
+{
+	return threads_.size() + 1u;
+}
+
+void WorkersPool::ParallelFor( const unsigned int task_count, const std::function<void(unsigned int)>& func )
+{
+	if( threads_.empty() || task_count <= 1u )
+	{
+		for( unsigned int i= 0u; i < task_count; i++ )
+			func(i);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		func_= &func;
+		task_count_= task_count;
+		next_task_.store( 0u );
+		busy_workers_= threads_.size();
+		generation_++;
+	}
+	work_condition_.notify_all();
+
+	ProcessTasks();
+
+	std::unique_lock<std::mutex> lock( mutex_ );
+	done_condition_.wait( lock, [this]{ return busy_workers_ == 0u; } );
+	func_= nullptr;
+}
+
+void WorkersPool::WorkerThreadFunc()
+{
+	unsigned int processed_generation= 0u;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			work_condition_.wait( lock, [&]{ return quit_ || generation_ != processed_generation; } );
+			if( quit_ )
+				return;
+			processed_generation= generation_;
+		}
+
+		ProcessTasks();
+
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			busy_workers_--;
+		}
+		done_condition_.notify_one();
+	}
+}
+
+void WorkersPool::ProcessTasks()
+{
+	while(true)
+	{
+		const unsigned int task= next_task_.fetch_add( 1u );
+		if( task >= task_count_ )
+			break;
+		(*func_)( task );
+	}
+}
+
+} // namespace PanzerChasm
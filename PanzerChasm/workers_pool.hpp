@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PanzerChasm
+{
+
+// Pool of threads for parallel processing of independent tasks.
+// Calling thread also processes tasks.
+class WorkersPool final
+{
+public:
+	// Zero - select count of threads, using hardware concurrency.
+	explicit WorkersPool( unsigned int thread_count= 0u );
+	WorkersPool( const WorkersPool& other )= delete;
+	~WorkersPool();
+
+	WorkersPool& operator=( const WorkersPool& other )= delete;
+
+	// Count of threads, including calling thread.
+	unsigned int GetThreadCount() const;
+
+	// Calls func(i) for each i in range [0; task_count) and returns after all calls finished.
+	// Order of calls and threads are unspecified. Func must not call ParallelFor.
+	void ParallelFor( unsigned int task_count, const std::function<void(unsigned int)>& func );
+
+private:
+	void WorkerThreadFunc();
+	void ProcessTasks();
+
+private:
+	std::vector<std::thread> threads_;
+
+	std::mutex mutex_;
+	std::condition_variable work_condition_;
+	std::condition_variable done_condition_;
+
+	// Protected by mutex.
+	unsigned int generation_= 0u; // Incremented for each ParallelFor call.
+	unsigned int busy_workers_= 0u;
+	bool quit_= false;
+
+	// Constant during ParallelFor call.
+	const std::function<void(unsigned int)>* func_= nullptr;
+	unsigned int task_count_= 0u;
+
+	std::atomic<unsigned int> next_task_;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,17 @@
+include(../Common/Common.pri)
+
+#MMX and SSE2 instructions here.
+# remove compiler options and defines, if you do not need mmx and sse2, or if build target is not x86.
+QMAKE_CXXFLAGS += -mmmx -msse2
+DEFINES+= PC_MMX_INSTRUCTIONS PC_SSE2_INSTRUCTIONS
+
+SOURCES+= \
+	main.cpp \
+
+SOURCES+= \
+	../PanzerChasm/client/software_renderer/rasterizer.cpp \
+
+HEADERS+= \
+	../PanzerChasm/client/software_renderer/fixed.hpp \
+	../PanzerChasm/client/software_renderer/rasterizer.hpp \
+	../PanzerChasm/client/software_renderer/rasterizer.inl \
@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../PanzerChasm/client/software_renderer/rasterizer.hpp"
+#include "../PanzerChasm/client/software_renderer/rasterizer.inl"
+using namespace PanzerChasm;
+
+namespace
+{
+
+typedef Rasterizer R;
+
+// Primitives are regular-ish polygons with radius in given range.
+struct SizeClass
+{
+	const char* name;
+	float min_radius;
+	float max_radius;
+};
+
+const SizeClass g_size_classes[]=
+{
+	{ "small", 2.0f, 8.0f }, // Distant models, sprites.
+	{ "medium", 8.0f, 48.0f }, // Models, wall segments.
+	{ "large", 48.0f, 256.0f }, // Near walls and floors.
+};
+
+const unsigned int g_texture_size_log2= 6u;
+const unsigned int g_texture_size= 1u << g_texture_size_log2;
+
+// Each round draws so many primitives, that they cover viewport several times.
+const unsigned int g_viewport_fill_factor= 4u;
+const unsigned int g_max_primitives_per_round= 200000u;
+
+const unsigned int g_polygon_vertex_count= 6u;
+
+struct Primitive
+{
+	RasterizerVertex vertices[ R::c_max_polygon_vertices ];
+	unsigned int vertex_count;
+};
+
+struct Primitives
+{
+	std::vector<Primitive> primitives;
+	double pixels= 0.0; // Sum of areas.
+};
+
+Primitives GeneratePrimitives(
+	const unsigned int viewport_size_x, const unsigned int viewport_size_y,
+	const unsigned int vertex_count,
+	const SizeClass& size_class,
+	const unsigned int seed )
+{
+	std::mt19937 generator( seed );
+	const auto random=
+	[&]( const float min, const float max ) -> float
+	{
+		return min + ( max - min ) * float( generator() - generator.min() ) / float( generator.max() - generator.min() );
+	};
+
+	// Primitives lie fully inside viewport.
+	const float max_radius= std::min( size_class.max_radius, float( std::min( viewport_size_x, viewport_size_y ) ) * 0.5f - 1.0f );
+	const float min_radius= std::min( size_class.min_radius, max_radius );
+	const double target_pixels= double( g_viewport_fill_factor ) * double( viewport_size_x ) * double( viewport_size_y );
+
+	Primitives result;
+	while( result.pixels < target_pixels && result.primitives.size() < g_max_primitives_per_round )
+	{
+		// Log-uniform size distribution - small primitives are more frequent.
+		const float radius= min_radius * std::pow( max_radius / min_radius, random( 0.0f, 1.0f ) );
+		const float center_x= random( radius, float(viewport_size_x) - radius );
+		const float center_y= random( radius, float(viewport_size_y) - radius );
+		const float z= random( 1.0f, 16.0f );
+
+		// Angles increase, so, polygons are anticlockwise.
+		float angles[ R::c_max_polygon_vertices ];
+		const float start_angle= random( 0.0f, 6.283185f );
+		for( unsigned int v= 0u; v < vertex_count; v++ )
+		{
+			const float step= 6.283185f / float(vertex_count);
+			angles[v]= start_angle + step * ( float(v) + random( -0.25f, 0.25f ) );
+		}
+
+		result.primitives.emplace_back();
+		Primitive& primitive= result.primitives.back();
+		primitive.vertex_count= vertex_count;
+
+		for( unsigned int v= 0u; v < vertex_count; v++ )
+		{
+			const float dx= radius * std::cos( angles[v] );
+			const float dy= radius * std::sin( angles[v] );
+
+			RasterizerVertex& vertex= primitive.vertices[v];
+			vertex.x= fixed16_t( ( center_x + dx ) * 65536.0f );
+			vertex.y= fixed16_t( ( center_y + dy ) * 65536.0f );
+			vertex.z= fixed16_t( z * random( 0.9f, 1.1f ) * 65536.0f );
+			vertex.u= fixed16_t( ( dx / radius * 0.5f + 0.5f ) * float( g_texture_size - 1u ) * 65536.0f );
+			vertex.v= fixed16_t( ( dy / radius * 0.5f + 0.5f ) * float( g_texture_size - 1u ) * 65536.0f );
+		}
+
+		double area= 0.0;
+		for( unsigned int v= 0u; v < vertex_count; v++ )
+		{
+			const RasterizerVertex& v0= primitive.vertices[v];
+			const RasterizerVertex& v1= primitive.vertices[ ( v + 1u ) % vertex_count ];
+			area+= ( double(v0.x) * double(v1.y) - double(v1.x) * double(v0.y) ) / ( 65536.0 * 65536.0 );
+		}
+		result.pixels+= std::abs( area ) * 0.5;
+	}
+
+	return result;
+}
+
+struct Kernel
+{
+	enum class Type
+	{
+		Triangle,
+		ConvexPolygon,
+		OcclusionHierarchyUpdate,
+	};
+
+	std::string name;
+	Type type;
+	R::TriangleDrawFunc triangle_func;
+	R::ConvexPolygonDrawFunc polygon_func;
+};
+
+Kernel TriangleKernel( std::string name, const R::TriangleDrawFunc func )
+{
+	Kernel kernel;
+	kernel.name= std::move(name);
+	kernel.type= Kernel::Type::Triangle;
+	kernel.triangle_func= func;
+	kernel.polygon_func= nullptr;
+	return kernel;
+}
+
+Kernel ConvexPolygonKernel( std::string name, const R::ConvexPolygonDrawFunc func )
+{
+	Kernel kernel;
+	kernel.name= std::move(name);
+	kernel.type= Kernel::Type::ConvexPolygon;
+	kernel.triangle_func= nullptr;
+	kernel.polygon_func= func;
+	return kernel;
+}
+
+std::vector<Kernel> CreateKernels( const std::vector<R::InstructionSet>& instruction_sets )
+{
+	std::vector<Kernel> kernels;
+
+	kernels.push_back(
+		TriangleKernel(
+			"affine triangle",
+			&R::DrawAffineTexturedTriangle<
+				R::DepthTest::Yes, R::DepthWrite::Yes,
+				R::AlphaTest::No,
+				R::OcclusionTest::No, R::OcclusionWrite::No,
+				R::Lighting::Yes> ) );
+
+	kernels.push_back(
+		TriangleKernel(
+			"per-line corrected triangle",
+			&R::DrawTexturedTrianglePerLineCorrected<
+				R::DepthTest::Yes, R::DepthWrite::Yes,
+				R::AlphaTest::No,
+				R::OcclusionTest::No, R::OcclusionWrite::No,
+				R::Lighting::Yes> ) );
+
+	for( const R::InstructionSet instruction_set : instruction_sets )
+	{
+		const std::string suffix= instruction_set == R::InstructionSet::SSE2 ? " (SSE2)" : " (scalar)";
+
+		kernels.push_back(
+			TriangleKernel(
+				"span corrected triangle" + suffix,
+				R::GetTexturedTriangleSpanCorrectedFunc<
+					R::DepthTest::Yes, R::DepthWrite::Yes,
+					R::AlphaTest::No,
+					R::OcclusionTest::No, R::OcclusionWrite::No,
+					R::Lighting::Yes>( instruction_set ) ) );
+
+		kernels.push_back(
+			TriangleKernel(
+				"span corrected triangle, alpha test, blending" + suffix,
+				R::GetTexturedTriangleSpanCorrectedFunc<
+					R::DepthTest::Yes, R::DepthWrite::Yes,
+					R::AlphaTest::Yes,
+					R::OcclusionTest::No, R::OcclusionWrite::No,
+					R::Lighting::Yes, R::Blending::Yes>( instruction_set ) ) );
+	}
+
+	kernels.push_back( TriangleKernel( "shadow triangle", &R::DrawShadowTriangle ) );
+
+	kernels.push_back(
+		ConvexPolygonKernel(
+			"per-line corrected polygon",
+			&R::DrawTexturedConvexPolygonPerLineCorrected<
+				R::DepthTest::Yes, R::DepthWrite::Yes,
+				R::AlphaTest::No,
+				R::OcclusionTest::No, R::OcclusionWrite::No> ) );
+
+	for( const R::InstructionSet instruction_set : instruction_sets )
+	{
+		const std::string suffix= instruction_set == R::InstructionSet::SSE2 ? " (SSE2)" : " (scalar)";
+
+		kernels.push_back(
+			ConvexPolygonKernel(
+				"span corrected polygon" + suffix,
+				R::GetTexturedConvexPolygonSpanCorrectedFunc<
+					R::DepthTest::Yes, R::DepthWrite::Yes,
+					R::AlphaTest::No,
+					R::OcclusionTest::No, R::OcclusionWrite::No>( instruction_set ) ) );
+	}
+
+	Kernel occlusion_kernel;
+	occlusion_kernel.name= "occlusion hierarchy update";
+	occlusion_kernel.type= Kernel::Type::OcclusionHierarchyUpdate;
+	occlusion_kernel.triangle_func= nullptr;
+	occlusion_kernel.polygon_func= nullptr;
+	kernels.push_back( occlusion_kernel );
+
+	return kernels;
+}
+
+double GetSeconds( const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end )
+{
+	return double( std::chrono::duration_cast<std::chrono::nanoseconds>( end - start ).count() ) / 1.0e9;
+}
+
+// Returns time of drawing in seconds.
+double RunKernel( Rasterizer& rasterizer, const Kernel& kernel, const Primitives& primitives, const unsigned int rounds )
+{
+	double total_time= 0.0;
+	for( unsigned int round= 0u; round < rounds; round++ )
+	{
+		// Each round starts with empty buffers, like frame.
+		rasterizer.ClearDepthBuffer();
+		rasterizer.ClearOcclusionBuffer();
+
+		const auto start_time= std::chrono::steady_clock::now();
+		switch( kernel.type )
+		{
+		case Kernel::Type::Triangle:
+			for( const Primitive& primitive : primitives.primitives )
+				(rasterizer.*kernel.triangle_func)( primitive.vertices );
+			break;
+
+		case Kernel::Type::ConvexPolygon:
+			for( const Primitive& primitive : primitives.primitives )
+				(rasterizer.*kernel.polygon_func)( primitive.vertices, primitive.vertex_count, true );
+			break;
+
+		case Kernel::Type::OcclusionHierarchyUpdate:
+			for( const Primitive& primitive : primitives.primitives )
+				rasterizer.UpdateOcclusionHierarchy( primitive.vertices, primitive.vertex_count, false );
+			break;
+		};
+		total_time+= GetSeconds( start_time, std::chrono::steady_clock::now() );
+	}
+
+	return total_time;
+}
+
+void PrintResult( const std::string& name, const double pixels, const double primitives, const double time_s )
+{
+	std::cout
+		<< std::left << std::setw(56) << name << std::right << std::fixed
+		<< std::setw(10) << std::setprecision(1) << pixels / time_s / 1.0e6 << " Mpixels/s"
+		<< std::setw(10) << std::setprecision(3) << primitives / time_s / 1.0e6 << " Mprimitives/s"
+		<< std::endl;
+}
+
+unsigned int ParseNumber( const char* const str, const unsigned int default_value )
+{
+	const int value= std::atoi( str );
+	return value > 0 ? static_cast<unsigned int>( value ) : default_value;
+}
+
+} // namespace
+
+int main( const int argc, const char* const argv[] )
+{
+	unsigned int viewport_size_x= 640u;
+	unsigned int viewport_size_y= 480u;
+	unsigned int rounds= 20u;
+	const char* kernel_filter= nullptr;
+
+	for( int i= 1; i < argc; i++ )
+	{
+		const char* const arg= argv[i];
+		if( i == argc - 1 )
+		{
+			std::cout << "Error, expected value, after " << arg << std::endl;
+			break;
+		}
+
+		if( std::strcmp( arg, "-w" ) == 0 )
+			viewport_size_x= ParseNumber( argv[ i + 1 ], viewport_size_x );
+		else if( std::strcmp( arg, "-h" ) == 0 )
+			viewport_size_y= ParseNumber( argv[ i + 1 ], viewport_size_y );
+		else if( std::strcmp( arg, "-r" ) == 0 )
+			rounds= ParseNumber( argv[ i + 1 ], rounds );
+		else if( std::strcmp( arg, "-k" ) == 0 )
+			kernel_filter= argv[ i + 1 ];
+		else
+			continue;
+		i++;
+	}
+
+	const unsigned int c_max_viewport_size= R::c_max_viewport_size_with_guard_band - R::c_guard_band_size * 2;
+	viewport_size_x= std::min( viewport_size_x, c_max_viewport_size );
+	viewport_size_y= std::min( viewport_size_y, c_max_viewport_size );
+
+	std::vector<R::InstructionSet> instruction_sets;
+	instruction_sets.push_back( R::InstructionSet::Scalar );
+	if( R::GetBestInstructionSet() == R::InstructionSet::SSE2 )
+		instruction_sets.push_back( R::InstructionSet::SSE2 );
+
+	// Noise texture. Quarter of texels is transparent, for alpha-test kernels.
+	std::vector<uint32_t> texture( g_texture_size * g_texture_size );
+	{
+		std::mt19937 generator( 0u );
+		for( uint32_t& texel : texture )
+		{
+			texel= generator() | R::c_alpha_mask;
+			if( ( generator() & 3u ) == 0u )
+				texel&= ~R::c_alpha_mask;
+		}
+	}
+
+	std::vector<uint32_t> color_buffer( viewport_size_x * viewport_size_y );
+	Rasterizer rasterizer( viewport_size_x, viewport_size_y, viewport_size_x, color_buffer.data() );
+	rasterizer.SetTexture( g_texture_size, g_texture_size, texture.data() );
+	rasterizer.SetLight( g_fixed16_one * 3 / 4 );
+
+	std::cout << "Viewport: " << viewport_size_x << "x" << viewport_size_y << ", rounds: " << rounds << std::endl;
+
+	const std::vector<Kernel> kernels= CreateKernels( instruction_sets );
+	for( const SizeClass& size_class : g_size_classes )
+	{
+		const Primitives triangles= GeneratePrimitives( viewport_size_x, viewport_size_y, 3u, size_class, 1u );
+		const Primitives polygons= GeneratePrimitives( viewport_size_x, viewport_size_y, g_polygon_vertex_count, size_class, 2u );
+
+		std::cout << std::endl << size_class.name << " primitives - radius " << int(size_class.min_radius) << "-" << int(size_class.max_radius) << " pixels, "
+			<< triangles.primitives.size() << " triangles, " << polygons.primitives.size() << " polygons per round" << std::endl;
+
+		for( const Kernel& kernel : kernels )
+		{
+			if( kernel_filter != nullptr && kernel.name.find( kernel_filter ) == std::string::npos )
+				continue;
+
+			const Primitives& primitives= kernel.type == Kernel::Type::Triangle ? triangles : polygons;
+
+			// Warm up caches.
+			RunKernel( rasterizer, kernel, primitives, 1u );
+
+			const double time_s= RunKernel( rasterizer, kernel, primitives, rounds );
+			PrintResult(
+				kernel.name,
+				primitives.pixels * double(rounds),
+				double( primitives.primitives.size() ) * double(rounds),
+				time_s );
+		}
+	}
+
+	// Depth hierarchy is built once per frame for whole viewport.
+	std::cout << std::endl;
+	for( const R::InstructionSet instruction_set : instruction_sets )
+	{
+		const std::string name=
+			std::string( "depth buffer hierarchy build" ) + ( instruction_set == R::InstructionSet::SSE2 ? " (SSE2)" : " (scalar)" );
+		if( kernel_filter != nullptr && name.find( kernel_filter ) == std::string::npos )
+			continue;
+
+		const unsigned int c_builds_per_round= 16u;
+		rasterizer.BuildDepthBufferHierarchy( instruction_set );
+
+		const auto start_time= std::chrono::steady_clock::now();
+		for( unsigned int i= 0u; i < rounds * c_builds_per_round; i++ )
+			rasterizer.BuildDepthBufferHierarchy( instruction_set );
+		const double time_s= GetSeconds( start_time, std::chrono::steady_clock::now() );
+
+		const double builds= double(rounds) * double(c_builds_per_round);
+		PrintResult( name, double(viewport_size_x) * double(viewport_size_y) * builds, builds, time_s );
+	}
+
+	return 0;
+}
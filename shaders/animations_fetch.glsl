@@ -0,0 +1,55 @@
+// Fetching of models animations vertices.
+// Requires "ANIMATION_TEXTURE_WIDTH" with "USE_2D_TEXTURES_FOR_ANIMATIONS".
+// With "COMPRESSED_ANIMATIONS" each vertex is 32-bit word in RGBA8 texel: 11 bits x, 11 bits y, 10 bits z.
+// Each frame is preceded by 6 words - frame quantization minimum and step (float bits).
+
+#ifdef COMPRESSED_ANIMATIONS
+
+#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
+uniform sampler2D animations_vertices_buffer;
+#else
+uniform samplerBuffer animations_vertices_buffer;
+#endif
+
+uint FetchAnimationWord( int index )
+{
+#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
+	ivec2 animation_vertex_coord= ivec2( index & (ANIMATION_TEXTURE_WIDTH-1), index / ANIMATION_TEXTURE_WIDTH );
+	vec4 texel= texelFetch( animations_vertices_buffer, animation_vertex_coord, 0 );
+#else
+	vec4 texel= texelFetch( animations_vertices_buffer, index );
+#endif
+	uvec4 b= uvec4( round( texel * 255.0 ) );
+	return b.x | ( b.y << 8u ) | ( b.z << 16u ) | ( b.w << 24u );
+}
+
+vec3 FetchAnimationVertex( int frame_start, int vertex_id )
+{
+	vec3 quantization_min= uintBitsToFloat( uvec3( FetchAnimationWord( frame_start - 6 ), FetchAnimationWord( frame_start - 5 ), FetchAnimationWord( frame_start - 4 ) ) );
+	vec3 quantization_step= uintBitsToFloat( uvec3( FetchAnimationWord( frame_start - 3 ), FetchAnimationWord( frame_start - 2 ), FetchAnimationWord( frame_start - 1 ) ) );
+
+	uint packed= FetchAnimationWord( frame_start + vertex_id );
+	uvec3 quantized= uvec3( packed & 2047u, ( packed >> 11u ) & 2047u, packed >> 22u );
+	return quantization_min + vec3( quantized ) * quantization_step;
+}
+
+#else
+
+#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
+uniform isampler2D animations_vertices_buffer;
+#else
+uniform isamplerBuffer animations_vertices_buffer;
+#endif
+
+vec3 FetchAnimationVertex( int frame_start, int vertex_id )
+{
+	int index= frame_start + vertex_id;
+#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
+	ivec2 animation_vertex_coord= ivec2( index & (ANIMATION_TEXTURE_WIDTH-1), index / ANIMATION_TEXTURE_WIDTH );
+	return vec3( texelFetch( animations_vertices_buffer, animation_vertex_coord, 0 ).xyz );
+#else
+	return vec3( texelFetch( animations_vertices_buffer, index ).xyz );
+#endif
+}
+
+#endif
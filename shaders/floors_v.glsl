@@ -1,4 +1,4 @@
-uniform mat4 view_matrix;
+#include "view_params.glsl"
 uniform float pos_z;
 
 in vec2 pos;
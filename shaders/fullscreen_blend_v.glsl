@@ -1,6 +1,5 @@
-const vec2 coord[6]= vec2[6](
-vec2( -1.0, -1.0 ), vec2( -1.0, +1.0 ), vec2( +1.0, +1.0 ),
-vec2( -1.0, -1.0 ), vec2( +1.0, -1.0 ), vec2( +1.0, +1.0 ) );
+// One triangle, covering whole screen.
+const vec2 coord[3]= vec2[3]( vec2( -1.0, -1.0 ), vec2( +3.0, -1.0 ), vec2( -1.0, +3.0 ) );
 
 void main()
 {
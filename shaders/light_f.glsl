@@ -1,4 +1,7 @@
 uniform sampler2D shadowmap;
+// Convert world coordinates to shadowmap coordinates.
+uniform vec2 shadowmap_scale;
+uniform vec2 shadowmap_shift;
 
 uniform vec2 light_pos;
 uniform float light_power;
@@ -18,7 +21,7 @@ void main()
 
 	float light_fraction= 1.0 - min( max( distance_to_light - min_radius, 0.0 ) / ( max_radius - min_radius ), 1.0 );
 
-	float shadow_factor= 1.0 - texture( shadowmap, f_world_coord / 64.0 ).x;
+	float shadow_factor= 1.0 - texture( shadowmap, f_world_coord * shadowmap_scale + shadowmap_shift ).x;
 
 	float l= shadow_factor * min( light_power * light_fraction, max_light_level );
 
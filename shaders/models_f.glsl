@@ -5,13 +5,23 @@ uniform sampler2D lightmap;
 
 in vec3 f_tex_coord;
 in vec2 f_lightmap_coord;
+#ifdef NO_GEOMETRY_SHADER
+in vec3 f_world_pos;
+#else
 in vec3 f_normal;
+#endif
 in float f_alpha_test_mask;
 
 out vec4 color;
 
 void main()
 {
+#ifdef NO_GEOMETRY_SHADER
+	// Flat normal of polygon. Calculate it before discard, because derivatives are undefined after it.
+	// Like normal from geometry shader, it faces camera on visible polygons.
+	vec3 f_normal= normalize( cross( dFdx( f_world_pos ), dFdy( f_world_pos ) ) );
+#endif
+
 	vec4 c= texture( tex, f_tex_coord );
 	if( c.a < 0.5 && f_alpha_test_mask > 0.5 )
 		discard;
@@ -4,11 +4,7 @@ uniform mat4 view_matrix;
 uniform int enabled_groups_mask;
 uniform vec3 light_pos; // Model space light position.
 
-#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
-uniform isampler2D animations_vertices_buffer;
-#else
-uniform isamplerBuffer animations_vertices_buffer;
-#endif
+#include "animations_fetch.glsl"
 uniform int first_animation_vertex_number;
 
 in int vertex_id;
@@ -18,19 +14,7 @@ out float f_discard_mask; // Polygon discard
 
 void main()
 {
-#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
-	int final_vertex_id= first_animation_vertex_number + vertex_id;
-	ivec2 animation_vertex_coord= ivec2( final_vertex_id & (ANIMATION_TEXTURE_WIDTH-1), final_vertex_id / ANIMATION_TEXTURE_WIDTH );
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			animation_vertex_coord, 0 ).xyz ) * c_models_coordinates_scale;
-#else
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			first_animation_vertex_number + vertex_id ).xyz ) * c_models_coordinates_scale;
-#endif
+	vec3 pos= FetchAnimationVertex( first_animation_vertex_number, vertex_id ) * c_models_coordinates_scale;
 
 	f_discard_mask= ( enabled_groups_mask & groups_mask ) == 0 ? 0.0 : 1.0;
 
@@ -1,21 +1,54 @@
 #include "constants.glsl"
 
+#ifdef INSTANCED
+#include "view_params.glsl"
+#else
 uniform mat4 view_matrix;
+#endif
+
+#ifdef INSTANCED
+in mat4 model_matrix;
+in mat3 rotation_matrix;
+in mat3 lightmap_matrix;
+in ivec4 instance_params; // x - first animation vertex, y - zero if instance is culled, z - next frame animation vertex, w - frames lerp in 16.16 format
+#define first_animation_vertex_number instance_params.x
+#define next_animation_vertex_number instance_params.z
+#define animation_lerp ( float(instance_params.w) / 65536.0 )
+#else
 uniform mat4 rotation_matrix;
 uniform mat3 lightmap_matrix;
+uniform int first_animation_vertex_number;
+#endif
 
 #ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
 uniform isampler2D animations_vertices_buffer;
 #else
 uniform isamplerBuffer animations_vertices_buffer;
 #endif
-uniform int first_animation_vertex_number;
+
+vec3 FetchAnimationVertex( int index )
+{
+#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
+	ivec2 animation_vertex_coord= ivec2( index & (ANIMATION_TEXTURE_WIDTH-1), index / ANIMATION_TEXTURE_WIDTH );
+	return vec3( texelFetch( animations_vertices_buffer, animation_vertex_coord, 0 ).xyz );
+#else
+	return vec3( texelFetch( animations_vertices_buffer, index ).xyz );
+#endif
+}
 
 in int vertex_id;
 in vec2 tex_coord;
 in int tex_id;
 in float alpha_test_mask;
 
+#ifdef NO_GEOMETRY_SHADER
+// Pass outputs directly to fragment shader, which calculates flat normal itself.
+#define g_world_pos f_world_pos
+#define g_tex_coord f_tex_coord
+#define g_lightmap_coord f_lightmap_coord
+#define g_alpha_test_mask f_alpha_test_mask
+#endif
+
 out vec3 g_world_pos;
 out vec3 g_tex_coord;
 out vec2 g_lightmap_coord;
@@ -23,24 +56,30 @@ out float g_alpha_test_mask;
 
 void main()
 {
-#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
-	int final_vertex_id= first_animation_vertex_number + vertex_id;
-	ivec2 animation_vertex_coord= ivec2( final_vertex_id & (ANIMATION_TEXTURE_WIDTH-1), final_vertex_id / ANIMATION_TEXTURE_WIDTH );
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			animation_vertex_coord, 0 ).xyz ) * c_models_coordinates_scale;
-#else
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			first_animation_vertex_number + vertex_id ).xyz ) * c_models_coordinates_scale;
+#ifdef INSTANCED
+	if( instance_params.y == 0 )
+	{
+		// Move culled instance outside clip volume.
+		gl_Position= vec4( 2.0, 2.0, 2.0, 1.0 );
+		return;
+	}
+#endif
+
+	vec3 pos= FetchAnimationVertex( first_animation_vertex_number + vertex_id );
+#ifdef INSTANCED
+	if( animation_lerp > 0.0 )
+		pos= mix( pos, FetchAnimationVertex( next_animation_vertex_number + vertex_id ), animation_lerp );
 #endif
+	pos*= c_models_coordinates_scale;
 
-	g_world_pos= ( rotation_matrix * vec4( pos, 1.0 ) ).xyz;
+	g_world_pos= mat3( rotation_matrix ) * pos;
 
 	g_tex_coord= vec3( tex_coord, float(tex_id) + 0.01 );
 	g_lightmap_coord= ( lightmap_matrix * vec3( pos.xy, 1.0 ) ).xy;
 	g_alpha_test_mask= alpha_test_mask;
+#ifdef INSTANCED
+	gl_Position= view_matrix * ( model_matrix * vec4( pos, 1.0 ) );
+#else
 	gl_Position= view_matrix * vec4( pos, 1.0 );
+#endif
 }
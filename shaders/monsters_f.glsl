@@ -5,7 +5,11 @@ uniform sampler2D lightmap;
 
 in vec2 f_tex_coord;
 in vec2 f_lightmap_coord;
+#ifdef NO_GEOMETRY_SHADER
+in vec3 f_world_pos;
+#else
 in vec3 f_normal;
+#endif
 in float f_alpha_test_mask;
 in float f_discard_mask;
 
@@ -13,6 +17,12 @@ out vec4 color;
 
 void main()
 {
+#ifdef NO_GEOMETRY_SHADER
+	// Flat normal of polygon. Calculate it before discard, because derivatives are undefined after it.
+	// Like normal from geometry shader, it faces camera on visible polygons.
+	vec3 f_normal= normalize( cross( dFdx( f_world_pos ), dFdy( f_world_pos ) ) );
+#endif
+
 	vec4 c= texture( tex, f_tex_coord );
 
 	// TODO - optimize discard operation here
@@ -0,0 +1,7 @@
+out vec4 color;
+
+void main()
+{
+	// Color writes are disabled, only depth test matters.
+	color= vec4( 1.0, 1.0, 1.0, 1.0 );
+}
@@ -0,0 +1,22 @@
+uniform mat4 view_matrix;
+uniform vec3 bbox_min;
+uniform vec3 bbox_max;
+
+// Corners of unit cube. 0 - bbox min, 1 - bbox max.
+const vec3 c_corners[8]= vec3[8](
+vec3( 0.0, 0.0, 0.0 ), vec3( 1.0, 0.0, 0.0 ), vec3( 0.0, 1.0, 0.0 ), vec3( 1.0, 1.0, 0.0 ),
+vec3( 0.0, 0.0, 1.0 ), vec3( 1.0, 0.0, 1.0 ), vec3( 0.0, 1.0, 1.0 ), vec3( 1.0, 1.0, 1.0 ) );
+
+const int c_indices[36]= int[36](
+0, 2, 1,  1, 2, 3, // bottom
+4, 5, 6,  5, 7, 6, // top
+0, 1, 4,  1, 5, 4, // front
+2, 6, 3,  3, 6, 7, // back
+0, 4, 2,  2, 4, 6, // left
+1, 3, 5,  3, 7, 5 ); // right
+
+void main()
+{
+	vec3 corner= c_corners[ c_indices[ gl_VertexID ] ];
+	gl_Position= view_matrix * vec4( mix( bbox_min, bbox_max, corner ), 1.0 );
+}
@@ -0,0 +1,12 @@
+uniform sampler2D tex;
+uniform vec4 blend_color;
+
+in vec2 f_tex_coord;
+
+out vec4 color;
+
+void main()
+{
+	// Fullscreen blend is combined with upscale.
+	color= vec4( mix( texture( tex, f_tex_coord ).rgb, blend_color.rgb, blend_color.a ), 1.0 );
+}
@@ -1,8 +1,20 @@
 uniform mat4 view_matrix;
 
+#ifdef NO_GEOMETRY_SHADER
+// Shadow polygons are extruded from walls segments here, same as in geometry shader.
+uniform vec2 light_pos;
+uniform float offset;
+
+in float extrude; // 0 - segment vertex, 1 - far vertex of shadow polygon.
+#endif
+
 in vec2 pos;
 
 void main()
 {
 	gl_Position= view_matrix * vec4( pos, 0.0, 1.0 );
+#ifdef NO_GEOMETRY_SHADER
+	vec2 dir= normalize( gl_Position.xy - light_pos );
+	gl_Position.xy+= dir * mix( offset, 1.0, extrude );
+#endif
 }
@@ -1,6 +1,6 @@
 uniform sampler2D tex;
 
-in vec3 f_pos;
+in vec4 f_pos;
 
 out vec4 color;
 
@@ -11,7 +11,7 @@ void main()
 	const float pi= 3.1415926535;
 	const float half_pi= pi * 0.5;
 
-	vec3 dir= normalize( f_pos );
+	vec3 dir= normalize( f_pos.xyz / f_pos.w );
 	float xy= length( dir.xy );
 
 #ifdef CONE_PROJECTION
@@ -1,11 +1,14 @@
 uniform mat4 view_matrix;
 
-in vec3 pos;
+out vec4 f_pos;
 
-out vec3 f_pos;
+// Fullscreen triangle on far plane. It is drawn after opaque geometry, so, depth test rejects covered pixels.
+const vec2 coord[3]= vec2[3]( vec2( -1.0, -1.0 ), vec2( 3.0, -1.0 ), vec2( -1.0, 3.0 ) );
 
 void main()
 {
-	f_pos= pos;
-	gl_Position= view_matrix * vec4( pos, 1.0 );
+	// View matrix contains only rotation and projection, so, unprojected point is direction from camera.
+	// Pass homogeneous point - it is linear in screen space.
+	f_pos= inverse( view_matrix ) * vec4( coord[ gl_VertexID ], 0.0, 1.0 );
+	gl_Position= vec4( coord[ gl_VertexID ], 1.0, 1.0 );
 }
@@ -1,14 +1,14 @@
 uniform sampler2DArray tex;
-uniform float frame;
 
 in vec2 f_tex_coord;
 in float f_light;
+flat in float f_layer;
 
 out vec4 color;
 
 void main()
 {
-	vec4 tex_value= texture( tex, vec3( f_tex_coord, frame ) );
+	vec4 tex_value= texture( tex, vec3( f_tex_coord, f_layer ) );
 	if( tex_value.a < 0.01 )
 		discard;
 	color= vec4( tex_value.xyz * f_light, tex_value.a * 0.4 );
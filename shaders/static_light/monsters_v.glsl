@@ -1,15 +1,26 @@
 #include "constants.glsl"
 
+#ifdef INSTANCED
+#include "view_params.glsl"
+#else
 uniform mat4 view_matrix;
-uniform mat3 lightmap_matrix;
-uniform int enabled_groups_mask;
+#endif
 
-#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
-uniform isampler2D animations_vertices_buffer;
+#ifdef INSTANCED
+in mat4 model_matrix;
+in mat3 lightmap_matrix;
+in ivec4 instance_params; // x - first animation vertex, y - enabled groups mask, z - next frame animation vertex, w - frames lerp in 16.16 format
+#define first_animation_vertex_number instance_params.x
+#define next_animation_vertex_number instance_params.z
+#define animation_lerp ( float(instance_params.w) / 65536.0 )
+#define enabled_groups_mask instance_params.y
 #else
-uniform isamplerBuffer animations_vertices_buffer;
-#endif
+uniform mat3 lightmap_matrix;
+uniform int enabled_groups_mask;
 uniform int first_animation_vertex_number;
+#endif
+
+#include "animations_fetch.glsl"
 
 in int vertex_id;
 in vec2 tex_coord;
@@ -23,23 +34,20 @@ out float f_discard_mask; // Polygon discard
 
 void main()
 {
-#ifdef USE_2D_TEXTURES_FOR_ANIMATIONS
-	int final_vertex_id= first_animation_vertex_number + vertex_id;
-	ivec2 animation_vertex_coord= ivec2( final_vertex_id & (ANIMATION_TEXTURE_WIDTH-1), final_vertex_id / ANIMATION_TEXTURE_WIDTH );
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			animation_vertex_coord, 0 ).xyz ) * c_models_coordinates_scale;
-#else
-	vec3 pos=
-		vec3( texelFetch(
-			animations_vertices_buffer,
-			first_animation_vertex_number + vertex_id ).xyz ) * c_models_coordinates_scale;
+	vec3 pos= FetchAnimationVertex( first_animation_vertex_number, vertex_id );
+#ifdef INSTANCED
+	if( animation_lerp > 0.0 )
+		pos= mix( pos, FetchAnimationVertex( next_animation_vertex_number, vertex_id ), animation_lerp );
 #endif
+	pos*= c_models_coordinates_scale;
 
 	f_tex_coord= tex_coord;
 	f_lightmap_coord= ( lightmap_matrix * vec3( pos.xy, 1.0 ) ).xy;
 	f_alpha_test_mask= alpha_test_mask;
 	f_discard_mask= ( enabled_groups_mask & groups_mask ) == 0 ? 0.0 : 1.0;
+#ifdef INSTANCED
+	gl_Position= view_matrix * ( model_matrix * vec4( pos, 1.0 ) );
+#else
 	gl_Position= view_matrix * vec4( pos, 1.0 );
+#endif
 }
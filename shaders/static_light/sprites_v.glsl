@@ -1,8 +1,12 @@
 #include "constants.glsl"
 
-uniform mat4 view_matrix;
-uniform vec2 lightmap_coord;
+#include "view_params.glsl"
 uniform sampler2D lightmap;
+uniform sampler2D fullbright_lightmap;
+
+in mat4 model_matrix;
+in vec4 sprite_params; // xy - lightmap coord, z - texture array layer, w - fullbright flag
+in vec2 tex_coord_scale;
 
 const vec2 coord[6]= vec2[6](
 vec2( -1.0, -1.0 ), vec2( -1.0, +1.0 ), vec2( +1.0, +1.0 ),
@@ -14,11 +18,19 @@ vec2( 0.0, 0.0 ), vec2( 1.0, 0.0 ), vec2( 1.0, 1.0 ) );
 
 out vec2 f_tex_coord;
 out float f_light;
+flat out float f_layer;
 
 void main()
 {
-	f_tex_coord= tex_coord[ gl_VertexID ];
-	f_light= c_static_light_scale * texture( lightmap, lightmap_coord ).x;
+	f_tex_coord= tex_coord[ gl_VertexID ] * tex_coord_scale;
+	f_layer= sprite_params.z;
+
+	float light=
+		mix(
+			texture( lightmap, sprite_params.xy ).x,
+			texture( fullbright_lightmap, sprite_params.xy ).x,
+			sprite_params.w );
+	f_light= c_static_light_scale * light;
 
-	gl_Position= view_matrix * vec4( coord[ gl_VertexID ].x, 0.0, coord[ gl_VertexID ].y, 1.0 );
+	gl_Position= view_matrix * ( model_matrix * vec4( coord[ gl_VertexID ].x, 0.0, coord[ gl_VertexID ].y, 1.0 ) );
 }
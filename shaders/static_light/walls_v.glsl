@@ -1,4 +1,4 @@
-uniform mat4 view_matrix;
+#include "view_params.glsl"
 
 in vec3 pos;
 in vec2 tex_coord;
@@ -13,5 +13,5 @@ void main()
 	f_tex_coord= vec3( tex_coord / 256.0, float( tex_id ) + 0.01 );
 	f_lightmap_coord= ( pos.xy / 256.0 + normal / 16.0 ) * LIGHTMAP_SCALE;
 
-	gl_Position= view_matrix * vec4( pos, 1.0f );
+	gl_Position= view_matrix * vec4( pos / 256.0, 1.0 );
 }
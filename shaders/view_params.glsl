@@ -0,0 +1,5 @@
+// Per-frame view parameters, shared between map shaders.
+layout(std140) uniform ViewParams
+{
+	mat4 view_matrix;
+};
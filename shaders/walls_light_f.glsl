@@ -1,4 +1,7 @@
 uniform sampler2D shadowmap;
+// Convert world coordinates to shadowmap coordinates.
+uniform vec2 shadowmap_scale;
+uniform vec2 shadowmap_shift;
 
 uniform vec2 light_pos;
 uniform float light_power;
@@ -20,7 +23,7 @@ void main()
 	float light_fraction= 1.0 - min( max( distance_to_light - min_radius, 0.0 ) / ( max_radius - min_radius ), 1.0 );
 
 	vec2 shadow_fetch_pos= f_world_coord + normalized_dir_to_light / 8.0; // TODO - calibrate this.
-	float shadow_factor= 1.0 - texture( shadowmap, shadow_fetch_pos / 64.0 ).x;
+	float shadow_factor= 1.0 - texture( shadowmap, shadow_fetch_pos * shadowmap_scale + shadowmap_shift ).x;
 
 	float normal_factor= max( 0, dot( f_normal, normalized_dir_to_light ) );
 	normal_factor= sqrt( normal_factor ); // hack for light sources, too near to walls.
@@ -1,4 +1,4 @@
-uniform mat4 view_matrix;
+#include "view_params.glsl"
 
 in vec3 pos;
 in vec2 tex_coord;
@@ -15,5 +15,5 @@ void main()
 	//f_lightmap_coord= ( pos.xy / 256.0 + normal / 8.0 ) * LIGHTMAP_SCALE;
 	f_lightmap_coord= vec2( lightmap_coord.x, lightmap_coord.y + 0.5 ) / 64.0;
 
-	gl_Position= view_matrix * vec4( pos, 1.0f );
+	gl_Position= view_matrix * vec4( pos / 256.0, 1.0 );
 }